@@ -13,6 +13,9 @@ CONFIG += NO_UNIT_TESTS
 
 DEFINES += QCUSTOMPLOT_USE_OPENGL
 
+#qmake CONFIG+=pipeline_trace builds in the trace points for File > Record Pipeline Trace
+pipeline_trace:DEFINES += SAVVYCAN_TRACE
+
 TARGET = SavvyCAN
 TEMPLATE = app
 
@@ -22,11 +25,18 @@ ICON = icons/SavvyIcon.icns
 SOURCES += main.cpp\
     canbridgewindow.cpp \
     connections/canlogserver.cpp \
+    connections/capturelink.cpp \
+    connections/captureagent.cpp \
+    connections/frameserver.cpp \
+    connections/capturelinkclient.cpp \
+    connections/sharedcapture.cpp \
+    connections/sharedcaptureclient.cpp \
     connections/canserver.cpp \
     connections/lawicel_serial.cpp \
     connections/mqtt_bus.cpp \
     dbc/dbcnodeduplicateeditor.cpp \
     framesenderobject.cpp \
+    modifierprogram.cpp \
     mqtt/qmqtt_client.cpp \
     mqtt/qmqtt_client_p.cpp \
     mqtt/qmqtt_frame.cpp \
@@ -41,15 +51,41 @@ SOURCES += main.cpp\
     mqtt/qmqtt_websocketiodevice.cpp \
     qcpaxistickerhex.cpp \
     re/dbccomparatorwindow.cpp \
+    re/dbcdiff.cpp \
     mainwindow.cpp \
     canframemodel.cpp \
+    canframeview.cpp \
+    canframestore.cpp \
+    framestorefollower.cpp \
+    canfiltertable.cpp \
+    payloadchangetable.cpp \
+    binarycapture.cpp \
+    workspace.cpp \
+    textlogindex.cpp \
+    lograngedialog.cpp \
+    memoryaccounting.cpp \
+    memorydiagnosticsdialog.cpp \
+    capturestreamer.cpp \
     simplecrypt.cpp \
     triggerdialog.cpp \
+    triggeredcapturewindow.cpp \
     utility.cpp \
     qcustomplot.cpp \
     frameplaybackwindow.cpp \
+    frameviewwindow.cpp \
     candatagrid.cpp \
     framesenderwindow.cpp \
+    sendgridmodel.cpp \
+    restbusengine.cpp \
+    restbuswindow.cpp \
+    filterexpression.cpp \
+    framebus.cpp \
+    windowupdategate.cpp \
+    trafficoverview.cpp \
+    trafficoverviewstrip.cpp \
+    framesearch.cpp \
+    framesearchdialog.cpp \
+    framequery.cpp \
     framefileio.cpp \
     mainsettingsdialog.cpp \
     firmwareuploaderwindow.cpp \
@@ -59,16 +95,29 @@ SOURCES += main.cpp\
     can_structs.cpp \
     motorcontrollerconfigwindow.cpp \
     connections/canconnection.cpp \
+    connections/canconworkers.cpp \
+    connections/busloadmeter.cpp \
+    connections/debuglog.cpp \
+    connections/clocksync.cpp \
+    connections/cangateway.cpp \
+    connections/liveframetable.cpp \
+    connections/triggeredcapture.cpp \
     connections/serialbusconnection.cpp \
     connections/canconfactory.cpp \
+    pipelinetrace.cpp \
     connections/gvretserial.cpp \
     connections/socketcand.cpp \
+    connections/trafficgenerator.cpp \
+    connections/logreplay.cpp \
     connections/canconmanager.cpp \
+    connections/txscheduler.cpp \
     re/sniffer/snifferitem.cpp \
     re/sniffer/sniffermodel.cpp \
     re/sniffer/snifferwindow.cpp \
     dbc/dbcmessageeditor.cpp \
     dbc/dbc_classes.cpp \
+    dbc/dbccache.cpp \
+    dbc/dbcsignalindex.cpp \
     dbc/dbchandler.cpp \
     dbc/dbcloadsavewindow.cpp \
     dbc/dbcmaineditor.cpp \
@@ -76,45 +125,98 @@ SOURCES += main.cpp\
     dbc/dbcsignaleditor.cpp \
     dbc/dbcnoderebaseeditor.cpp \
     re/discretestatewindow.cpp \
+    re/discreterangesets.cpp \
     re/filecomparatorwindow.cpp \
     re/flowviewwindow.cpp \
     re/frameinfowindow.cpp \
+    re/framestats.cpp \
+    re/periodicity.cpp \
     re/fuzzingwindow.cpp \
+    re/fuzzengine.cpp \
     re/isotp_interpreterwindow.cpp \
+    re/isotpmessagemodel.cpp \
     re/rangestatewindow.cpp \
+    re/rangecolumns.cpp \
+    re/columnstore.cpp \
+    re/signalcorrelator.cpp \
+    re/correlationwindow.cpp \
+    re/integrityscan.cpp \
+    re/counterchecksumwindow.cpp \
+    re/errorstats.cpp \
+    re/errorstatswindow.cpp \
+    re/latency.cpp \
+    re/latencywindow.cpp \
+    re/nodeload.cpp \
+    re/nodeloadwindow.cpp \
+    re/querywindow.cpp \
     re/udsscanwindow.cpp \
     connections/canbus.cpp \
     connections/canconnectionmodel.cpp \
     connections/connectionwindow.cpp \
     re/graphingwindow.cpp \
+    re/graphlod.cpp \
+    re/graphsamples.cpp \
+    re/graphexport.cpp \
+    re/replotscheduler.cpp \
+    re/offscreenplot.cpp \
     re/newgraphdialog.cpp \
     bisectwindow.cpp \
+    signalseriesstore.cpp \
     signalviewerwindow.cpp \
+    signalviewermodel.cpp \
     bus_protocols/isotp_handler.cpp \
     bus_protocols/j1939_handler.cpp \
     bus_protocols/uds_handler.cpp \
     jsedit.cpp \
     frameplaybackobject.cpp \
+    playbacktransform.cpp \
+    threadpolicy.cpp \
     helpwindow.cpp \
     blfhandler.cpp \
+    compressedlog.cpp \
     re/sniffer/SnifferDelegate.cpp \
     connections/newconnectiondialog.cpp \
     re/temporalgraphwindow.cpp \
     filterutility.cpp \
+    filterlistmodel.cpp \
     pcaplite.cpp
 
 HEADERS  += mainwindow.h \
     can_structs.h \
     canbridgewindow.h \
     canframemodel.h \
+    canframeview.h \
+    canframestore.h \
+    framestorefollower.h \
+    canfiltertable.h \
+    payloadchangetable.h \
+    binarycapture.h \
+    workspace.h \
+    textlogindex.h \
+    frameloadoptions.h \
+    lograngedialog.h \
+    memoryaccounting.h \
+    memorydiagnosticsdialog.h \
+    capturestreamer.h \
+    pipelinetrace.h \
     connections/canlogserver.h \
+    connections/capturelink.h \
+    connections/captureagent.h \
+    connections/frameserver.h \
+    connections/capturelinkclient.h \
+    connections/sharedcapture.h \
+    connections/sharedcaptureclient.h \
     connections/canserver.h \
     connections/lawicel_serial.h \
     connections/socketcand.h \
+    connections/trafficgenerator.h \
+    connections/logreplay.h \
     connections/mqtt_bus.h \
     dbc/dbcnodeduplicateeditor.h \
     dbc/dbcnoderebaseeditor.h \
     framesenderobject.h \
+    modifierprogram.h \
+    objectarena.h \
     mqtt/qmqtt.h \
     mqtt/qmqtt_client.h \
     mqtt/qmqtt_client_p.h \
@@ -136,14 +238,28 @@ HEADERS  += mainwindow.h \
     mqtt/qmqtt_websocketiodevice_p.h \
     qcpaxistickerhex.h \
     re/dbccomparatorwindow.h \
+    re/dbcdiff.h \
     simplecrypt.h \
     triggerdialog.h \
+    triggeredcapturewindow.h \
     utility.h \
     qcustomplot.h \
     frameplaybackwindow.h \
+    frameviewwindow.h \
     candatagrid.h \
     framesenderwindow.h \
+    sendgridmodel.h \
+    restbusengine.h \
+    restbuswindow.h \
     can_trigger_structs.h \
+    filterexpression.h \
+    framebus.h \
+    windowupdategate.h \
+    trafficoverview.h \
+    trafficoverviewstrip.h \
+    framesearch.h \
+    framesearchdialog.h \
+    framequery.h \
     framefileio.h \
     config.h \
     mainsettingsdialog.h \
@@ -154,15 +270,25 @@ HEADERS  += mainwindow.h \
     utils/lfqueue.h \
     motorcontrollerconfigwindow.h \
     connections/canconnection.h \
+    connections/busloadmeter.h \
+    connections/debuglog.h \
+    connections/clocksync.h \
+    connections/cangateway.h \
+    connections/liveframetable.h \
+    connections/triggeredcapture.h \
     connections/serialbusconnection.h \
     connections/canconconst.h \
     connections/canconfactory.h \
     connections/gvretserial.h \
     connections/canconmanager.h \
+    connections/canconworkers.h \
+    connections/txscheduler.h \
     re/sniffer/snifferitem.h \
     re/sniffer/sniffermodel.h \
     re/sniffer/snifferwindow.h \
     dbc/dbc_classes.h \
+    dbc/dbccache.h \
+    dbc/dbcsignalindex.h \
     dbc/dbchandler.h \
     dbc/dbcloadsavewindow.h \
     dbc/dbcmaineditor.h \
@@ -170,37 +296,72 @@ HEADERS  += mainwindow.h \
     dbc/dbcmessageeditor.h \
     dbc/dbcnodeeditor.h \
     re/discretestatewindow.h \
+    re/discreterangesets.h \
     re/filecomparatorwindow.h \
     re/flowviewwindow.h \
     re/frameinfowindow.h \
+    re/framestats.h \
+    re/periodicity.h \
     re/fuzzingwindow.h \
+    re/fuzzengine.h \
     re/isotp_interpreterwindow.h \
+    re/isotpmessagemodel.h \
     re/rangestatewindow.h \
+    re/rangecolumns.h \
+    re/columnstore.h \
+    re/signalcorrelator.h \
+    re/correlationwindow.h \
+    re/integrityscan.h \
+    re/counterchecksumwindow.h \
+    re/errorstats.h \
+    re/errorstatswindow.h \
+    re/latency.h \
+    re/latencywindow.h \
+    re/nodeload.h \
+    re/nodeloadwindow.h \
+    re/querywindow.h \
     re/udsscanwindow.h \
     connections/canbus.h \
     connections/canconnectionmodel.h \
     connections/connectionwindow.h \
     re/graphingwindow.h \
+    re/graphlod.h \
+    re/graphsamples.h \
+    re/graphexport.h \
+    re/replotscheduler.h \
+    re/offscreenplot.h \
     re/newgraphdialog.h \
     bisectwindow.h \
+    signalseriesstore.h \
     signalviewerwindow.h \
+    signalviewermodel.h \
     bus_protocols/isotp_handler.h \
     bus_protocols/j1939_handler.h \
     bus_protocols/uds_handler.h \
     bus_protocols/isotp_message.h \
+    bus_protocols/j1939_message.h \
+    bus_protocols/canidparts.h \
     jsedit.h \
     frameplaybackobject.h \
+    playbacktransform.h \
+    threadpolicy.h \
     helpwindow.h \
     blfhandler.h \
+    compressedlog.h \
     re/sniffer/SnifferDelegate.h \
     connections/newconnectiondialog.h \
     re/temporalgraphwindow.h \
     filterutility.h \
+    filterlistmodel.h \
     pcaplite.h
 
 FORMS    += ui/candatagrid.ui \
     triggerdialog.ui \
     ui/canbridgewindow.ui \
+    ui/triggeredcapturewindow.ui \
+    ui/lograngedialog.ui \
+    ui/memorydiagnosticsdialog.ui \
+    ui/framesearchdialog.ui \
     ui/dbcnodeduplicateeditor.ui \
     ui/dbccomparatorwindow.ui \
     ui/dbcmessageeditor.ui \
@@ -216,8 +377,10 @@ FORMS    += ui/candatagrid.ui \
     ui/flowviewwindow.ui \
     ui/frameinfowindow.ui \
     ui/frameplaybackwindow.ui \
+    ui/frameviewwindow.ui \
     ui/framesenderwindow.ui \
     ui/fuzzingwindow.ui \
+    ui/restbuswindow.ui \
     ui/graphingwindow.ui \
     ui/isotp_interpreterwindow.ui \
     ui/mainsettingsdialog.ui \
@@ -225,6 +388,12 @@ FORMS    += ui/candatagrid.ui \
     ui/motorcontrollerconfigwindow.ui \
     ui/newgraphdialog.ui \
     ui/rangestatewindow.ui \
+    ui/correlationwindow.ui \
+    ui/counterchecksumwindow.ui \
+    ui/errorstatswindow.ui \
+    ui/latencywindow.ui \
+    ui/nodeloadwindow.ui \
+    ui/querywindow.ui \
     ui/scriptingwindow.ui \
     ui/snifferwindow.ui \
     ui/udsscanwindow.ui \
@@ -239,11 +408,33 @@ RESOURCES += \
     images.qrc
 
 win32-msvc* {
-   LIBS += opengl32.lib
+   LIBS += opengl32.lib avrt.lib
 }
 
 win32-g++ {
-   LIBS += libopengl32
+   LIBS += libopengl32 -lavrt
+}
+
+linux {
+   SOURCES += connections/socketcan.cpp
+   HEADERS += connections/socketcan.h
+}
+
+# compressed logs, each format is built in when its library is found
+unix {
+   CONFIG += link_pkgconfig
+   packagesExist(zlib) {
+      PKGCONFIG += zlib
+      DEFINES += HAVE_ZLIB
+   }
+   packagesExist(libzstd) {
+      PKGCONFIG += libzstd
+      DEFINES += HAVE_ZSTD
+   }
+   packagesExist(liblz4) {
+      PKGCONFIG += liblz4
+      DEFINES += HAVE_LZ4
+   }
 }
 
 unix {
@@ -0,0 +1,194 @@
+#include "binarycapture.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+static const uint8_t zeroPayload[CANFrameRecord::MAX_BYTES] = {0};
+
+MappedCapture::MappedCapture()
+{
+    mapped = nullptr;
+    base = nullptr;
+    size = 0;
+    totalFrames = 0;
+    damaged = false;
+    extraOffset = 0;
+    extraLength = 0;
+}
+
+MappedCapture::~MappedCapture()
+{
+    close();
+}
+
+void MappedCapture::close()
+{
+    if (mapped) file.unmap(mapped);
+    mapped = nullptr;
+    if (file.isOpen()) file.close();
+    fallback.clear();
+    base = nullptr;
+    size = 0;
+    blocks.clear();
+    blockStart.clear();
+    totalFrames = 0;
+    damaged = false;
+    extraOffset = 0;
+    extraLength = 0;
+}
+
+bool MappedCapture::addBlock(quint64 offset)
+{
+    BinaryBlockHeader header;
+
+    if (offset + sizeof(BinaryBlockHeader) > size) return false;
+    memcpy(&header, base + offset, sizeof(header));
+    if (header.magic != BINARY_BLOCK_MAGIC) return false;
+
+    quint64 recordBytes = static_cast<quint64>(header.frameCount) * sizeof(CANFrameRecord);
+    quint64 fdBytes = static_cast<quint64>(header.fdCount) * CANFrameRecord::MAX_BYTES;
+    if (offset + sizeof(header) + recordBytes + fdBytes > size) return false;
+    if (static_cast<quint64>(totalFrames) + header.frameCount > static_cast<quint64>(INT_MAX)) return false;
+    if (header.frameCount == 0) return true;
+
+    //every structure in the file is a multiple of 8 bytes so records in the mapping are properly aligned
+    Block block;
+    block.header = reinterpret_cast<const BinaryBlockHeader *>(base + offset);
+    block.records = reinterpret_cast<const CANFrameRecord *>(base + offset + sizeof(header));
+    block.fdPayloads = reinterpret_cast<const uint8_t *>(base + offset + sizeof(header) + recordBytes);
+    block.fdCount = header.fdCount;
+    blocks.append(block);
+    blockStart.append(totalFrames);
+    totalFrames += static_cast<int>(header.frameCount);
+    return true;
+}
+
+bool MappedCapture::open(const QString &filename)
+{
+    close();
+
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    size = static_cast<quint64>(file.size());
+    if (size < sizeof(BinaryFileHeader))
+    {
+        close();
+        return false;
+    }
+
+    mapped = file.map(0, static_cast<qint64>(size));
+    base = mapped;
+    if (!mapped)
+    {
+        qDebug() << "Could not map" << filename << "so reading it into memory instead";
+        fallback = file.readAll();
+        base = reinterpret_cast<const uchar *>(fallback.constData());
+        size = static_cast<quint64>(fallback.size());
+        file.close();
+    }
+
+    BinaryFileHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, BINARY_FILE_MAGIC, sizeof(header.magic)) != 0 || header.byteOrder != BINARY_BYTE_ORDER
+            || header.recordSize != sizeof(CANFrameRecord) || header.version > BINARY_VERSION)
+    {
+        close();
+        return false;
+    }
+
+    if (header.extraOffset > 0 && header.extraOffset + sizeof(BinaryExtraHeader) <= size)
+    {
+        BinaryExtraHeader extra;
+        memcpy(&extra, base + header.extraOffset, sizeof(extra));
+        quint64 start = header.extraOffset + sizeof(extra);
+        if (memcmp(extra.magic, BINARY_EXTRA_MAGIC, sizeof(extra.magic)) == 0 && extra.length <= size - start)
+        {
+            extraOffset = start;
+            extraLength = extra.length;
+        }
+    }
+
+    //a cleanly closed file has the block index at the end
+    bool indexed = false;
+    if (size >= sizeof(BinaryFileHeader) + sizeof(BinaryFileTrailer))
+    {
+        BinaryFileTrailer trailer;
+        memcpy(&trailer, base + size - sizeof(trailer), sizeof(trailer));
+        if (memcmp(trailer.magic, BINARY_INDEX_MAGIC, sizeof(trailer.magic)) == 0
+                && trailer.indexOffset + static_cast<quint64>(trailer.blockCount) * sizeof(BinaryIndexEntry) + sizeof(trailer) == size)
+        {
+            indexed = true;
+            blocks.reserve(static_cast<int>(trailer.blockCount));
+            blockStart.reserve(static_cast<int>(trailer.blockCount));
+            BinaryIndexEntry entry;
+            for (uint32_t i = 0; i < trailer.blockCount; i++)
+            {
+                memcpy(&entry, base + trailer.indexOffset + i * sizeof(BinaryIndexEntry), sizeof(entry));
+                if (!addBlock(entry.offset)) damaged = true;
+            }
+        }
+    }
+
+    //No index means the capture never got closed. Walk the block headers and stop at the first one that isn't all
+    //there. This only touches one header per block so it's quick even on huge files.
+    if (!indexed)
+    {
+        quint64 pos = sizeof(BinaryFileHeader);
+        BinaryBlockHeader block;
+        while (pos + sizeof(BinaryBlockHeader) <= size && (header.extraOffset == 0 || pos < header.extraOffset))
+        {
+            memcpy(&block, base + pos, sizeof(block));
+            if (!addBlock(pos))
+            {
+                damaged = true;
+                break;
+            }
+            pos += sizeof(block) + static_cast<quint64>(block.frameCount) * sizeof(CANFrameRecord)
+                   + static_cast<quint64>(block.fdCount) * CANFrameRecord::MAX_BYTES;
+        }
+    }
+
+    return true;
+}
+
+QByteArray MappedCapture::extraSection() const
+{
+    if (extraLength == 0) return QByteArray();
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(base + extraOffset), static_cast<int>(extraLength));
+}
+
+int MappedCapture::blockOf(int idx) const
+{
+    //blocks are mostly full size but continuous logging flushes short ones so binary search the start indices
+    auto it = std::upper_bound(blockStart.constBegin(), blockStart.constEnd(), idx);
+    return static_cast<int>(it - blockStart.constBegin()) - 1;
+}
+
+const CANFrameRecord &MappedCapture::record(int idx) const
+{
+    int b = blockOf(idx);
+    return blocks.at(b).records[idx - blockStart.at(b)];
+}
+
+const uint8_t *MappedCapture::payloadData(int idx) const
+{
+    int b = blockOf(idx);
+    const Block &block = blocks.at(b);
+    const CANFrameRecord &rec = block.records[idx - blockStart.at(b)];
+    if (rec.isInline()) return rec.data;
+    if (rec.fdSlot >= block.fdCount) return zeroPayload; //bad slot, don't read off the end of the block
+    return block.fdPayloads + static_cast<quint64>(rec.fdSlot) * CANFrameRecord::MAX_BYTES;
+}
+
+CANFrame MappedCapture::at(int idx) const
+{
+    CANFrame frame;
+    CANFrameRecord rec = record(idx);
+    const uint8_t *payload = payloadData(idx);
+    if (rec.len > CANFrameRecord::MAX_BYTES) rec.len = CANFrameRecord::MAX_BYTES;
+    rec.toFrame(frame, payload);
+    return frame;
+}
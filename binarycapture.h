@@ -0,0 +1,150 @@
+#ifndef BINARYCAPTURE_H
+#define BINARYCAPTURE_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "can_structs.h"
+
+/*
+ * SavvyCAN binary capture (.scb). Meant for logging at full bus load and loading big captures without parsing
+ * text. Everything is in host byte order (a byte order marker in the header lets the loader refuse files from a
+ * machine that disagrees) and every structure is a multiple of 8 bytes so the file can be mapped and the
+ * records read in place.
+ *
+ *  BinaryFileHeader
+ *  block: BinaryBlockHeader, frameCount x CANFrameRecord, fdCount x 64 byte FD payloads
+ *  block ...
+ *  frameCount/fdCount of each block are in its header. Records with more than 8 bytes of payload have fdSlot
+ *  set to the payload's index within the FD area of their own block.
+ *  extra: BinaryExtraHeader then its bytes, only in files that have one (workspaces, see workspace.h)
+ *  footer: blockCount x BinaryIndexEntry then a BinaryFileTrailer as the very last bytes in the file
+ *
+ * The extra section sits between the last block and the footer and only gets found through extraOffset in the
+ * file header, so anything that only wants the frames never sees it.
+ * The footer only gets written when the file is closed properly. If SavvyCAN dies mid capture the loader just
+ * walks the blocks from the front instead so nothing already flushed is lost.
+ */
+static const char BINARY_FILE_MAGIC[8] = {'S', 'V', 'C', 'A', 'N', 'B', 'I', 'N'};
+static const char BINARY_INDEX_MAGIC[8] = {'S', 'V', 'C', 'A', 'N', 'I', 'D', 'X'};
+static const char BINARY_EXTRA_MAGIC[8] = {'S', 'V', 'C', 'A', 'N', 'E', 'X', 'T'};
+static const uint32_t BINARY_BLOCK_MAGIC = 0x4B4C4253; //"SBLK" on little endian machines
+static const uint32_t BINARY_BYTE_ORDER = 0x01020304;
+static const uint32_t BINARY_VERSION = 1;
+static const int BINARY_FRAMES_PER_BLOCK = 4096;
+static const int BINARY_ID_BLOOM_BITS = 256;
+
+struct BinaryFileHeader
+{
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t framesPerBlock;
+    uint64_t extraOffset; //file position of the BinaryExtraHeader, 0 if there's no extra section
+};
+
+struct BinaryBlockHeader
+{
+    uint32_t magic;
+    uint32_t frameCount;
+    uint32_t fdCount;
+    uint32_t reserved;
+    uint64_t firstTimestamp;
+    uint64_t lastTimestamp;
+    uint32_t idMin;
+    uint32_t idMax;
+    uint64_t idBloom[BINARY_ID_BLOOM_BITS / 64]; //one bit per hashed ID so a reader can skip blocks that can't hold an ID
+};
+
+struct BinaryIndexEntry
+{
+    uint64_t offset; //file position of the block header
+    BinaryBlockHeader header;
+};
+
+struct BinaryExtraHeader
+{
+    char magic[8];
+    uint64_t length; //bytes that follow, padded up to a multiple of 8 in the file
+};
+
+struct BinaryFileTrailer
+{
+    uint64_t indexOffset;
+    uint64_t totalFrames;
+    uint32_t blockCount;
+    uint32_t reserved;
+    char magic[8];
+};
+
+static_assert(sizeof(BinaryFileHeader) == 32, "binary capture layout changed");
+static_assert(sizeof(BinaryBlockHeader) == 72, "binary capture layout changed");
+static_assert(sizeof(BinaryIndexEntry) == 80, "binary capture layout changed");
+static_assert(sizeof(BinaryExtraHeader) == 16, "binary capture layout changed");
+static_assert(sizeof(BinaryFileTrailer) == 32, "binary capture layout changed");
+
+static inline int binaryBloomBit(uint32_t id)
+{
+    return static_cast<int>((id * 2654435761u) >> 24);
+}
+
+/*
+ * Read only view of a binary capture that stays on disk. The file is mapped and only the block headers get looked
+ * at up front so opening a multi gigabyte capture costs a few KB of index. Records are handed out straight from the
+ * mapping and only turned into a CANFrame when somebody asks for one so memory use follows whatever is actually
+ * being looked at, not the size of the file. If the OS won't map the file it gets read into memory instead.
+ */
+class MappedCapture
+{
+public:
+    MappedCapture();
+    ~MappedCapture();
+
+    bool open(const QString &filename);
+    void close();
+    QString fileName() const { return file.fileName(); }
+    bool isDamaged() const { return damaged; } //some block was cut short or didn't check out. Everything before it is fine
+    //the extra section, straight out of the mapping so it's only good for as long as the capture is open. Empty if
+    //the file doesn't have one
+    QByteArray extraSection() const;
+
+    int count() const { return totalFrames; }
+    const CANFrameRecord &record(int idx) const;
+    const uint8_t *payloadData(int idx) const;
+    CANFrame at(int idx) const;
+
+    //the blocks as they are in the file, for readers that want to skip whole blocks by their header
+    int blockCount() const { return blocks.count(); }
+    int blockFirst(int b) const { return blockStart.at(b); } //index of the block's first frame
+    const BinaryBlockHeader &blockHeader(int b) const { return *blocks.at(b).header; }
+
+private:
+    struct Block
+    {
+        const BinaryBlockHeader *header;
+        const CANFrameRecord *records;
+        const uint8_t *fdPayloads;
+        uint32_t fdCount;
+    };
+
+    int blockOf(int idx) const;
+    bool addBlock(quint64 offset);
+
+    QFile file;
+    uchar *mapped;
+    QByteArray fallback;
+    const uchar *base;
+    quint64 size;
+    QVector<Block> blocks;
+    QVector<int> blockStart; //index of the first frame in each block, ascending
+    int totalFrames;
+    bool damaged;
+    quint64 extraOffset; //of the extra bytes themselves, past their header
+    quint64 extraLength;
+
+    Q_DISABLE_COPY(MappedCapture)
+};
+
+#endif // BINARYCAPTURE_H
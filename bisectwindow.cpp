@@ -2,13 +2,16 @@
 #include "ui_bisectwindow.h"
 
 #include "mainwindow.h"
+#include "windowupdategate.h"
 #include "framefileio.h"
 #include "helpwindow.h"
+#include "pipelinetrace.h"
 
 #include <QDebug>
 #include <algorithm>
+#include <limits>
 
-BisectWindow::BisectWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+BisectWindow::BisectWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::BisectWindow)
 {
@@ -16,11 +19,14 @@ BisectWindow::BisectWindow(const QVector<CANFrame> *frames, QWidget *parent) :
     setWindowFlags(Qt::Window);
 
     modelFrames = frames;
+    resetWorking();
 
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
     connect(ui->btnCalculate, &QAbstractButton::clicked, this, &BisectWindow::handleCalculateButton);
     connect(ui->btnReplaceFrames, &QAbstractButton::clicked, this, &BisectWindow::handleReplaceButton);
     connect(ui->btnSaveFrames, &QAbstractButton::clicked, this, &BisectWindow::handleSaveButton);
+    connect(ui->btnNarrow, &QAbstractButton::clicked, this, &BisectWindow::handleNarrowButton);
+    connect(ui->btnStartOver, &QAbstractButton::clicked, this, &BisectWindow::handleStartOverButton);
     connect(ui->slideFrameNumber, &QSlider::sliderReleased, this, &BisectWindow::updateFrameNumText);
     connect(ui->slidePercentage, &QSlider::sliderReleased, this, &BisectWindow::updatePercentText);
     connect(ui->editFrameNumber, &QLineEdit::editingFinished, this, &BisectWindow::updateFrameNumSlider);
@@ -99,9 +105,9 @@ void BisectWindow::refreshIDList()
     foundID.clear();
     ui->cbIDLower->clear();
     ui->cbIDUpper->clear();
-    for (int i = 0; i < modelFrames->count(); i++)
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
     {
-        id = modelFrames->at(i).frameId();
+        id = info.id;
         if (!foundID.contains(id))
         {
             foundID.append(id);
@@ -118,19 +124,92 @@ void BisectWindow::refreshIDList()
 
 void BisectWindow::refreshFrameNumbers()
 {
-    ui->labelMainListNum->setText(QString::number(modelFrames->count()));
-    ui->labelSplitNum->setText(QString::number(splitFrames.count()));
-    ui->slideFrameNumber->setMaximum(modelFrames->count());
+    if (working.rules.isEmpty()) workingCount = countFrames(working); //free, and keeps up with frames coming in
+    QString mainText = QString::number(modelFrames->count());
+    if (workingCount != modelFrames->count()) mainText = QString::number(workingCount) + " of " + mainText;
+    ui->labelMainListNum->setText(mainText);
+    ui->labelSplitNum->setText(QString::number(haveSplit ? splitCount : 0));
+    ui->slideFrameNumber->setMaximum(workingCount);
+    ui->btnNarrow->setEnabled(haveSplit);
+    ui->btnStartOver->setEnabled(workingCount != modelFrames->count() || !working.rules.isEmpty());
+}
+
+//back to splitting everything in the main list, including whatever comes in later
+void BisectWindow::resetWorking()
+{
+    working = BisectSection();
+    working.end = std::numeric_limits<quint64>::max();
+    workingCount = modelFrames->count();
+    haveSplit = false;
+    splitCount = 0;
+}
+
+//rows of the main list the section's range covers right now, first up to but not including last
+void BisectWindow::sectionRows(const BisectSection &section, int &first, int &last) const
+{
+    quint64 base = modelFrames->baseSequence();
+    quint64 top = base + static_cast<quint64>(modelFrames->count());
+    quint64 from = qBound(base, section.begin, top);
+    quint64 to = qBound(from, section.end, top);
+    first = static_cast<int>(from - base);
+    last = static_cast<int>(to - base);
+}
+
+//a plain range is free. Rules need a look at every record in it but that's just the IDs and buses, nothing copied
+int BisectWindow::countFrames(const BisectSection &section) const
+{
+    int first, last;
+    sectionRows(section, first, last);
+    if (section.rules.isEmpty()) return last - first;
+    int count = 0;
+    for (int i = first; i < last; i++)
+    {
+        if (section.accepts(modelFrames->record(i))) count++;
+    }
+    return count;
+}
+
+//sequence number of the pos'th frame of the section (counting from 0), or the end of the section if there aren't that many
+quint64 BisectWindow::sequenceAt(const BisectSection &section, int pos) const
+{
+    int first, last;
+    sectionRows(section, first, last);
+    if (section.rules.isEmpty()) return modelFrames->sequenceOf(qMin(first + qMax(pos, 0), last));
+    int seen = 0;
+    for (int i = first; i < last; i++)
+    {
+        if (!section.accepts(modelFrames->record(i))) continue;
+        if (seen == pos) return modelFrames->sequenceOf(i);
+        seen++;
+    }
+    return modelFrames->sequenceOf(last);
+}
+
+//the only place frames actually get copied, for saving or replacing the main list
+QVector<CANFrame> BisectWindow::materialize(const BisectSection &section) const
+{
+    QVector<CANFrame> out;
+    int first, last;
+    sectionRows(section, first, last);
+    out.reserve(section.rules.isEmpty() ? last - first : splitCount);
+    for (int i = first; i < last; i++)
+    {
+        if (section.accepts(modelFrames->record(i))) out.append(modelFrames->at(i));
+    }
+    return out;
 }
 
 void BisectWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("BisectWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted
     {
+        resetWorking();
         refreshFrameNumbers();
     }
     else if (numFrames == -2) //all new set of frames. Reset
     {
+        resetWorking();
         refreshFrameNumbers();
         refreshIDList();
     }
@@ -142,63 +221,63 @@ void BisectWindow::updatedFrames(int numFrames)
 
 void BisectWindow::handleCalculateButton()
 {
-    splitFrames.clear();
     bool saveLower = ui->rbLowerSection->isChecked();
     int targetFrameNum = 0;
+    split = working;
+    //a split is of the frames there right now, same as when it was a copy
+    split.end = qMin(split.end, modelFrames->baseSequence() + static_cast<quint64>(modelFrames->count()));
     if (ui->rbFrameNumber->isChecked() || ui->rbPercentage->isChecked())
     {
+        //frame numbers and percentages count within what's being split, not the whole main list
         if (ui->rbFrameNumber->isChecked()) targetFrameNum = ui->slideFrameNumber->value();
-        else targetFrameNum = modelFrames->count() * (ui->slidePercentage->value() / 10000.0);
+        else targetFrameNum = workingCount * (ui->slidePercentage->value() / 10000.0);
         qDebug() << "Target frame num " << targetFrameNum;
-        if (saveLower)
-        {
-            for (int i = 0; i < targetFrameNum; i++) splitFrames.append(modelFrames->at(i));
-        }
-        else
-        {
-            for (int i = targetFrameNum; i < modelFrames->count(); i++) splitFrames.append(modelFrames->at(i));
-        }
+        quint64 boundary = sequenceAt(working, targetFrameNum);
+        if (saveLower) split.end = boundary;
+        else split.begin = boundary;
     }
     else if (ui->rbIDRange->isChecked())
     {
         uint32_t lowerID = Utility::ParseStringToNum2(ui->cbIDLower->currentText());
         uint32_t upperID = Utility::ParseStringToNum2(ui->cbIDUpper->currentText());
-        for (int i = 0; i < modelFrames->count(); i++)
-        {
-            if (modelFrames->at(i).frameId() >= lowerID && modelFrames->at(i).frameId() <= upperID)
-            {
-                if (saveLower) splitFrames.append(modelFrames->at(i));
-            }
-            else
-            {
-                if (!saveLower) splitFrames.append(modelFrames->at(i));
-            }
-        }
+        split.rules.append({false, lowerID, upperID, saveLower});
     }
     else if (ui->rbBusNum->isChecked())
     {
-        int targetBus = Utility::ParseStringToNum(ui->editBusNum->text());
-        for (int i = 0; i < modelFrames->count(); i++)
-        {
-            if (modelFrames->at(i).bus == targetBus)
-            {
-                if (saveLower) splitFrames.append(modelFrames->at(i));
-            }
-            else
-            {
-                if (!saveLower) splitFrames.append(modelFrames->at(i));
-            }
-        }
+        uint32_t targetBus = static_cast<uint32_t>(Utility::ParseStringToNum(ui->editBusNum->text()));
+        split.rules.append({true, targetBus, targetBus, saveLower});
     }
+    haveSplit = true;
+    splitCount = countFrames(split);
+    refreshFrameNumbers();
+}
+
+//the split becomes what gets split next. Nothing is copied so this can be repeated as often as needed
+void BisectWindow::handleNarrowButton()
+{
+    if (!haveSplit) return;
+    working = split;
+    workingCount = splitCount;
+    haveSplit = false;
+    splitCount = 0;
+    refreshFrameNumbers();
+}
+
+void BisectWindow::handleStartOverButton()
+{
+    resetWorking();
     refreshFrameNumbers();
 }
 
 void BisectWindow::handleReplaceButton()
 {
+    if (!haveSplit) return;
+    QVector<CANFrame> splitFrames = materialize(split);
     CANFrameModel *model;
     model = MainWindow::getReference()->getCANFrameModel();
     model->clearFrames();
     model->insertFrames(splitFrames);
+    resetWorking();
     refreshFrameNumbers();
     refreshIDList();
 }
@@ -207,6 +286,8 @@ void BisectWindow::handleSaveButton()
 {
     QMessageBox msg;
     QString filename;
+    QVector<CANFrame> splitFrames;
+    if (haveSplit) splitFrames = materialize(split);
     if (FrameFileIO::saveFrameFile(filename, &splitFrames))
     {
         msg.setText(tr("Successfully saved file"));
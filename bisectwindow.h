@@ -3,17 +3,47 @@
 
 #include <QDialog>
 #include "can_structs.h"
+#include "canframestore.h"
 
 namespace Ui {
 class BisectWindow;
 }
 
+/*
+ * One side of a bisection without copying any frames: the frames of the main list from sequence number begin up to
+ * (not including) end that pass every rule. Sequence numbers rather than rows so frames evicted off the front or
+ * appended behind don't move it. Splitting a section again just narrows the range or adds a rule.
+ */
+struct BisectSection
+{
+    struct Rule
+    {
+        bool byBus; //otherwise by ID
+        uint32_t lower, upper; //inclusive. A bus rule has both set to the bus
+        bool inside; //keep the frames inside the range, otherwise the ones outside it
+    };
+
+    quint64 begin = 0;
+    quint64 end = 0;
+    QVector<Rule> rules;
+
+    bool accepts(const CANFrameRecord &rec) const
+    {
+        for (const Rule &rule : rules)
+        {
+            uint32_t val = rule.byBus ? static_cast<uint32_t>(rec.bus) : rec.frameId();
+            if ((val >= rule.lower && val <= rule.upper) != rule.inside) return false;
+        }
+        return true;
+    }
+};
+
 class BisectWindow : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit BisectWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit BisectWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~BisectWindow();
     void showEvent(QShowEvent*);
 
@@ -31,15 +61,26 @@ private slots:
     void updateFrameNumText();
     void updatePercentText();
     void updateSectionsText();
+    void handleNarrowButton();
+    void handleStartOverButton();
 
 private:
     Ui::BisectWindow *ui;
-    const QVector<CANFrame> *modelFrames;
-    QVector<CANFrame> splitFrames;
+    const CANFrameStore *modelFrames;
+    BisectSection working; //what gets split. The whole main list until narrowed
+    BisectSection split;
+    bool haveSplit;
+    int workingCount;
+    int splitCount;
     QList<int> foundID;
 
     void refreshIDList();
     void refreshFrameNumbers();
+    void resetWorking();
+    void sectionRows(const BisectSection &section, int &first, int &last) const;
+    int countFrames(const BisectSection &section) const;
+    quint64 sequenceAt(const BisectSection &section, int pos) const;
+    QVector<CANFrame> materialize(const BisectSection &section) const;
     bool eventFilter(QObject *obj, QEvent *event);
 };
 
@@ -1,16 +1,117 @@
 #include "blfhandler.h"
+#include <QCoreApplication>
+#include <QDateTime>
 #include <QDebug>
 #include <QFile>
+#include <QMutex>
+#include <QRunnable>
 #include <QString>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QtEndian>
+#include <cstring>
+#include <deque>
+#include <memory>
 
 #define BLF_REMOTE_FLAG 0x80
+#define BLF_TX_FLAG 0x01
+#define BLF_FD64_REMOTE_FLAG 0x0010
+#define BLF_FD64_EDL_FLAG 0x1000
+#define BLF_FD64_BRS_FLAG 0x2000
+#define BLF_TIME_ONE_NANS 2
+#define BLF_EPOCH_CUTOFF_US 946684800000000ull //timestamps past 2000-01-01 are taken to be wall clock time
 
 BLFHandler::BLFHandler()
 {
 
 }
 
+namespace
+{
+//one LOGCONTAINER on its way through the pool
+class BLFContainerJob : public QRunnable
+{
+public:
+    BLFContainerJob(QMutex *lock, QWaitCondition *finished) : lock(lock), finished(finished)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        if (deflate) output = qCompress(input); //comes back with the 4 byte size header, left off when written
+        else output = compressed ? qUncompress(input) : input;
+        input.clear();
+        QMutexLocker locker(lock);
+        done = true;
+        finished->wakeAll();
+    }
+
+    QByteArray input; //compressed ones start with the 4 byte big endian size qUncompress wants
+    bool compressed = false;
+    bool deflate = false; //writing, input is a block of objects to compress
+    int uncompressedSize = 0;
+    QByteArray output;
+    bool done = false; //under lock
+
+private:
+    QMutex *lock;
+    QWaitCondition *finished;
+};
+
+//FD DLC code for a payload length, padded is rounded up to the next length an FD frame can have
+uint8_t fdDlcFor(int len, int &padded)
+{
+    static const int sizes[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    for (int i = 0; i < 16; i++)
+    {
+        if (len <= sizes[i])
+        {
+            padded = sizes[i];
+            return static_cast<uint8_t>(i);
+        }
+    }
+    padded = 64;
+    return 15;
+}
+
+void toSystemTime(const QDateTime &time, uint8_t *out)
+{
+    uint16_t fields[8];
+    fields[0] = static_cast<uint16_t>(time.date().year());
+    fields[1] = static_cast<uint16_t>(time.date().month());
+    fields[2] = static_cast<uint16_t>(time.date().dayOfWeek() % 7); //Sunday is 0
+    fields[3] = static_cast<uint16_t>(time.date().day());
+    fields[4] = static_cast<uint16_t>(time.time().hour());
+    fields[5] = static_cast<uint16_t>(time.time().minute());
+    fields[6] = static_cast<uint16_t>(time.time().second());
+    fields[7] = static_cast<uint16_t>(time.time().msec());
+    for (int i = 0; i < 8; i++) qToLittleEndian<quint16>(fields[i], out + i * 2);
+}
+
+//channels in BLF start at 1
+int busFromChannel(int channel)
+{
+    return channel > 0 ? channel - 1 : 0;
+}
+
+void appendFrame(const CANFrame &frame, QVector<CANFrame> &chunk, const BLFHandler::FrameSink &sink)
+{
+    chunk.append(frame);
+    if (chunk.count() >= BLF_FRAME_CHUNK)
+    {
+        sink(chunk);
+        chunk.clear();
+    }
+}
+}
+
+bool BLFHandler::loadBLF(QString filename, QVector<CANFrame>* frames)
+{
+    return loadBLF(filename, [frames](QVector<CANFrame> &chunk) { frames->append(chunk); });
+}
+
 /*
  Written while peeking at source code here:
 https://python-can.readthedocs.io/en/latest/_modules/can/io/blf.html
@@ -19,158 +120,389 @@ https://bitbucket.org/tobylorenz/vector_blf/
 All the code actually below is freshly written but heavily based upon things seen in those
 two source repos.
 */
-bool BLFHandler::loadBLF(QString filename, QVector<CANFrame>* frames)
+bool BLFHandler::loadBLF(QString filename, const FrameSink &sink, QAtomicInt *progress)
 {
-    BLF_OBJ_HEADER objHeader;
-    QByteArray fileData;
-    QByteArray uncompressedData;
-    QByteArray junk;
-    BLF_OBJECT obj;
-    uint32_t pos;
-    BLF_CAN_OBJ canObject;
-    BLF_CAN_OBJ2 canObject2;
-
-    QFile *inFile = new QFile(filename);
-
-    if (!inFile->open(QIODevice::ReadOnly))
-    {
-        delete inFile;
-        return false;
-    }
-    inFile->read((char *)&header, sizeof(header));
-    if (qFromLittleEndian(header.sig) == 0x47474F4C)
+    QFile inFile(filename);
+
+    if (!inFile.open(QIODevice::ReadOnly)) return false;
+    if (inFile.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)) return false;
+    if (qFromLittleEndian(header.sig) == BLF_FILE_SIG)
     {
         qDebug() << "Proper BLF file header token";
     }
     else return false;
 
-    while (!inFile->atEnd())
+    int threads = qMax(1, QThread::idealThreadCount());
+    size_t maxPending = static_cast<size_t>(threads) * 2;
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QMutex lock;
+    QWaitCondition finished;
+    std::deque<std::unique_ptr<BLFContainerJob>> pending;
+    bool onGuiThread = QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread();
+
+    QByteArray carry;
+    int skip = 0;
+    QVector<CANFrame> chunk;
+    chunk.reserve(BLF_FRAME_CHUNK);
+    qint64 fileSize = qMax<qint64>(inFile.size(), 1);
+    bool ok = true;
+
+    //waits for the oldest container to come back from the pool and parses it
+    auto parseOldest = [&]() -> bool
     {
-        qDebug() << "Position within file: " << inFile->pos();
-        inFile->read((char *)&objHeader.base, sizeof(BLF_OBJ_HEADER_BASE));
-        if (qFromLittleEndian(objHeader.base.sig) == 0x4A424F4C)
+        BLFContainerJob *job = pending.front().get();
         {
-            int readSize = objHeader.base.objSize - sizeof(BLF_OBJ_HEADER_BASE);
-            qDebug() << "Proper object header token. Read Size: " << readSize;
-            fileData = inFile->read(readSize);
-            junk = inFile->read(readSize % 4); //file is padded so sizes must always end up on even multiple of 4
-            //qDebug() << "Fudge bytes in readSize: " << (readSize % 4);
-
-            switch (objHeader.base.objType)
+            QMutexLocker locker(&lock);
+            while (!job->done)
             {
-                case BLF_CONTAINER:
-                qDebug() << "Object is a container.";
-                memcpy(&objHeader.containerObj, fileData.constData(), sizeof(BLF_OBJ_HEADER_CONTAINER));
-                fileData.remove(0, sizeof(BLF_OBJ_HEADER_CONTAINER));
-                if (objHeader.containerObj.compressionMethod == BLF_CONT_NO_COMPRESSION)
-                {
-                    qDebug() << "Container is not compressed";
-                    uncompressedData = fileData;
-                }
-                else if (objHeader.containerObj.compressionMethod == BLF_CONT_ZLIB_COMPRESSION)
+                finished.wait(&lock, 50);
+                if (onGuiThread)
                 {
-                    qDebug() << "Compressed container. Unpacking it.";
-                    fileData.prepend(objHeader.containerObj.uncompressedSize & 0xFF);
-                    fileData.prepend((objHeader.containerObj.uncompressedSize >> 8) & 0xFF);
-                    fileData.prepend((objHeader.containerObj.uncompressedSize >> 16) & 0xFF);
-                    fileData.prepend((objHeader.containerObj.uncompressedSize >> 24) & 0xFF);
-                    uncompressedData += qUncompress(fileData);
+                    locker.unlock();
+                    QCoreApplication::processEvents();
+                    locker.relock();
                 }
-                else
-                {
-                    qDebug() << "Dunno what this is... " << objHeader.containerObj.compressionMethod;
-                }
-                qDebug() << "Uncompressed size: " << uncompressedData.count();
-                qDebug() << "Currently loaded frames at this point: " << frames->count();
-                pos = 0;
-                //bool foundHeader = false;
-                //first skip forward to find a header signature - usually not necessary
-                while ( (int)(pos + sizeof(BLF_OBJ_HEADER)) < uncompressedData.count())
-                {
-                    int32_t *headerSig = (int32_t *)(uncompressedData.constData() + pos);
-                    if (*headerSig == 0x4A424F4C) break;
-                    pos += 4;
+            }
+        }
+        if (carry.isEmpty()) carry = job->output;
+        else carry.append(job->output);
+        pending.pop_front();
+        return parseObjects(carry, skip, chunk, sink);
+    };
+
+    while (ok && !inFile.atEnd())
+    {
+        BLF_OBJ_HEADER_BASE base;
+        if (inFile.read(reinterpret_cast<char *>(&base), sizeof(base)) != sizeof(base)) break;
+        if (qFromLittleEndian(base.sig) != BLF_OBJ_SIG)
+        {
+            qDebug() << "Unexpected object header signature at" << inFile.pos() - static_cast<qint64>(sizeof(base)) << ", aborting";
+            ok = false;
+            break;
+        }
+        qint64 readSize = static_cast<qint64>(base.objSize) - static_cast<qint64>(sizeof(base));
+        qint64 padding = readSize % 4; //file is padded so sizes must always end up on even multiple of 4
+        if (readSize < 0)
+        {
+            ok = false;
+            break;
+        }
+
+        BLF_OBJ_HEADER_CONTAINER container;
+        if (base.objType != BLF_CONTAINER || readSize < static_cast<qint64>(sizeof(container))
+                || inFile.read(reinterpret_cast<char *>(&container), sizeof(container)) != sizeof(container))
+        {
+            //only containers hold frames
+            inFile.seek(qMin(inFile.pos() + readSize + padding, inFile.size()));
+            continue;
+        }
+
+        qint64 payloadSize = readSize - static_cast<qint64>(sizeof(container));
+        std::unique_ptr<BLFContainerJob> job(new BLFContainerJob(&lock, &finished));
+        if (container.compressionMethod == BLF_CONT_ZLIB_COMPRESSION)
+        {
+            //read straight in behind the size header instead of prepending to it afterward
+            job->compressed = true;
+            job->input.resize(static_cast<int>(payloadSize + 4));
+            qToBigEndian<quint32>(container.uncompressedSize, reinterpret_cast<uchar *>(job->input.data()));
+            qint64 got = inFile.read(job->input.data() + 4, payloadSize);
+            job->input.resize(static_cast<int>(qMax<qint64>(got, 0) + 4));
+        }
+        else if (container.compressionMethod == BLF_CONT_NO_COMPRESSION)
+        {
+            job->input = inFile.read(payloadSize);
+        }
+        else
+        {
+            qDebug() << "Dunno what this is... " << container.compressionMethod;
+            inFile.seek(qMin(inFile.pos() + payloadSize + padding, inFile.size()));
+            continue;
+        }
+        if (padding) inFile.seek(qMin(inFile.pos() + padding, inFile.size()));
+
+        pool.start(job.get());
+        pending.push_back(std::move(job));
+        while (ok && pending.size() >= maxPending) ok = parseOldest();
+
+        if (progress) progress->storeRelaxed(static_cast<int>(inFile.pos() * 1000 / fileSize));
+    }
+    while (ok && !pending.empty()) ok = parseOldest();
+    pool.waitForDone(); //anything still out there after a failure has to finish before its job goes away
+
+    if (!chunk.isEmpty()) sink(chunk);
+    if (progress) progress->storeRelaxed(1000);
+    return ok;
+}
+
+bool BLFHandler::parseObjects(QByteArray &buffer, int &skip, QVector<CANFrame> &chunk, const FrameSink &sink)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(buffer.constData());
+    int len = buffer.length();
+    int pos = qMin(skip, len);
+    skip -= pos;
+
+    //first skip forward to find a header signature - usually not necessary
+    while (pos + 4 <= len && qFromLittleEndian<quint32>(data + pos) != BLF_OBJ_SIG) pos += 4;
+
+    while (pos + static_cast<int>(sizeof(BLF_OBJ_HEADER_BASE)) <= len)
+    {
+        BLF_OBJ_HEADER_BASE base;
+        memcpy(&base, data + pos, sizeof(base));
+        if (qFromLittleEndian(base.sig) != BLF_OBJ_SIG)
+        {
+            qDebug() << "Unexpected object header signature, aborting";
+            return false;
+        }
+        if (base.objSize < sizeof(BLF_OBJ_HEADER_BASE) + sizeof(BLF_OBJ_HEADER_V1)) return false;
+        if (static_cast<qint64>(pos) + base.objSize > len) break; //rest of it is in the next container
+
+        if (base.objType == BLF_CAN_MSG || base.objType == BLF_CAN_MSG2)
+        {
+            BLF_OBJ_HEADER_V1 v1;
+            memcpy(&v1, data + pos + sizeof(BLF_OBJ_HEADER_BASE), sizeof(v1));
+            //CAN_MESSAGE2 only adds fields after the payload so both start out the same
+            int dataOffset = qMax<int>(base.headerSize, sizeof(BLF_OBJ_HEADER_BASE) + sizeof(BLF_OBJ_HEADER_V1));
+            if (static_cast<qint64>(dataOffset) + static_cast<qint64>(sizeof(BLF_CAN_OBJ)) <= base.objSize)
+            {
+                BLF_CAN_OBJ canObject;
+                memcpy(&canObject, data + pos + dataOffset, sizeof(canObject));
+                CANFrame frame;
+                frame.bus = busFromChannel(canObject.channel);
+                frame.setExtendedFrameFormat((canObject.id & 0x80000000ull)?true:false);
+                frame.setFrameId(canObject.id & 0x1FFFFFFFull);
+                frame.isReceived = !(canObject.flags & BLF_TX_FLAG);
+                int dlc = qMin<int>(canObject.dlc, 8);
+                if (canObject.flags & BLF_REMOTE_FLAG) {
+                    frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+                    frame.setPayload(QByteArray(dlc, 0));
+                } else {
+                    frame.setFrameType(QCanBusFrame::DataFrame);
+                    frame.setPayload(QByteArray(reinterpret_cast<const char *>(canObject.data), dlc));
                 }
-                //then process all the objects
-                while ( (int)(pos + sizeof(BLF_OBJ_HEADER)) < uncompressedData.count())
-                {
-                    memcpy(&obj.header.base, (uncompressedData.constData() + pos), sizeof(BLF_OBJ_HEADER_BASE));
-                    memcpy(&obj.header.v1Obj, (uncompressedData.constData() + pos) + sizeof(BLF_OBJ_HEADER_BASE), sizeof(BLF_OBJ_HEADER_V1));
-                    //if (obj.header.base.objType != 1)
-                        //qDebug() << "Pos: " << pos << " Type: " << obj.header.base.objType << "Obj Size: " << obj.header.base.objSize;
-                    if (qFromLittleEndian(objHeader.base.sig) == 0x4A424F4C)
-                    {
-                        fileData = uncompressedData.mid(pos + sizeof(BLF_OBJ_HEADER_BASE) + sizeof(BLF_OBJ_HEADER_V1), obj.header.base.objSize - sizeof(BLF_OBJ_HEADER_BASE) - sizeof(BLF_OBJ_HEADER_V1));
-                        if (obj.header.base.objType == BLF_CAN_MSG)
-                        {
-                            memcpy(&canObject, fileData.constData(), sizeof(BLF_CAN_OBJ));
-                            CANFrame frame;
-                            frame.bus = canObject.channel;
-                            frame.setExtendedFrameFormat((canObject.id & 0x80000000ull)?true:false);
-                            frame.setFrameId(canObject.id & 0x1FFFFFFFull);
-                            frame.isReceived = true;
-                            QByteArray bytes(canObject.dlc, 0);
-
-                            if (canObject.flags & BLF_REMOTE_FLAG) {
-                                frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
-                            } else {
-                                frame.setFrameType(QCanBusFrame::DataFrame);
-                                for (int i = 0; i < canObject.dlc; i++) bytes[i] = canObject.data[i];
-                            }
-                            frame.setPayload(bytes);
-                            //Should we divide by a thousand or a million? Unsure here. It appears some logs are stamped in microseconds and some in milliseconds?
-                            frame.setTimeStamp(QCanBusFrame::TimeStamp(0, obj.header.v1Obj.uncompSize / 1000.0)); //uncompsize field also used for timestamp oddly enough
-                            frames->append(frame);
-                        }
-                        else if (obj.header.base.objType == BLF_CAN_MSG2)
-                        {
-                            memcpy(&canObject2, fileData.constData(), sizeof(BLF_CAN_OBJ2));
-                            CANFrame frame;
-                            frame.bus = canObject2.channel;
-                            frame.setExtendedFrameFormat((canObject2.id & 0x80000000ull)?true:false);
-                            frame.setFrameId(canObject2.id & 0x1FFFFFFFull);
-                            frame.isReceived = true;
-                            QByteArray bytes(canObject2.dlc, 0);
-
-                            if (canObject2.flags & BLF_REMOTE_FLAG) {
-                                frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
-                            } else {
-                                frame.setFrameType(QCanBusFrame::DataFrame);
-                                for (int i = 0; i < canObject2.dlc; i++) bytes[i] = canObject2.data[i];
-                            }
-                            frame.setPayload(bytes);
-                            //Should we divide by a thousand or a million? Unsure here. It appears some logs are stamped in microseconds and some in milliseconds?
-                            frame.setTimeStamp(QCanBusFrame::TimeStamp(0, obj.header.v1Obj.uncompSize / 1000.0)); //uncompsize field also used for timestamp oddly enough
-                            frames->append(frame);
-                        }
-                        else
-                        {
-                            qDebug() << "Not a can frame! ObjType: " << obj.header.base.objType;
-                            if (obj.header.base.objType > 0xFFFF)
-                                return false;
-                        }
-                        pos += obj.header.base.objSize + (obj.header.base.objSize % 4);
-                    }
-                    else
-                    {
-                        qDebug() << "Unexpected object header signature, aborting";
-                        return false;
-                    }
+                //Should we divide by a thousand or a million? Unsure here. It appears some logs are stamped in microseconds and some in milliseconds?
+                frame.setTimeStamp(QCanBusFrame::TimeStamp(0, v1.uncompSize / 1000.0)); //uncompsize field also used for timestamp oddly enough
+                appendFrame(frame, chunk, sink);
+            }
+        }
+        else if (base.objType == BLF_CAN_FD_MSG64)
+        {
+            BLF_OBJ_HEADER_V1 v1;
+            memcpy(&v1, data + pos + sizeof(BLF_OBJ_HEADER_BASE), sizeof(v1));
+            int dataOffset = qMax<int>(base.headerSize, sizeof(BLF_OBJ_HEADER_BASE) + sizeof(BLF_OBJ_HEADER_V1));
+            BLF_CANFD64_OBJ fdObject;
+            if (static_cast<qint64>(dataOffset) + static_cast<qint64>(sizeof(fdObject)) <= base.objSize)
+            {
+                memcpy(&fdObject, data + pos + dataOffset, sizeof(fdObject));
+                int valid = qMin<int>(fdObject.validDataBytes, 64);
+                valid = qMin<int>(valid, static_cast<int>(base.objSize) - dataOffset - static_cast<int>(sizeof(fdObject)));
+                CANFrame frame;
+                frame.bus = busFromChannel(fdObject.channel);
+                frame.setExtendedFrameFormat((fdObject.id & 0x80000000ull)?true:false);
+                frame.setFrameId(fdObject.id & 0x1FFFFFFFull);
+                frame.isReceived = fdObject.dir == 0;
+                if (fdObject.flags & BLF_FD64_REMOTE_FLAG) {
+                    frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+                    frame.setPayload(QByteArray(qMin<int>(fdObject.dlc, 8), 0));
+                } else {
+                    frame.setFrameType(QCanBusFrame::DataFrame);
+                    frame.setFlexibleDataRateFormat((fdObject.flags & BLF_FD64_EDL_FLAG) != 0);
+                    frame.setBitrateSwitch((fdObject.flags & BLF_FD64_BRS_FLAG) != 0);
+                    frame.setPayload(QByteArray(reinterpret_cast<const char *>(data + pos + dataOffset + sizeof(fdObject)), valid));
                 }
-                uncompressedData.remove(0, pos);
-                qDebug() << "After removing used data uncompressedData is now this big: " << uncompressedData.count();
-
-                break;
+                frame.setTimeStamp(QCanBusFrame::TimeStamp(0, v1.uncompSize / 1000.0));
+                appendFrame(frame, chunk, sink);
             }
         }
-        else return false;
+        else if (base.objType > 0xFFFF)
+        {
+            qDebug() << "Not a can frame! ObjType: " << base.objType;
+            return false;
+        }
+        pos += static_cast<int>(base.objSize + (base.objSize % 4));
     }
+
+    //padding of the last object can run past the end, it comes off the front of the next container
+    if (pos > len)
+    {
+        skip = pos - len;
+        pos = len;
+    }
+    buffer.remove(0, pos);
     return true;
 }
 
-bool BLFHandler::saveBLF(QString filename, QVector<CANFrame> *frames)
+bool BLFHandler::saveBLF(QString filename, const QVector<CANFrame> *frames, QAtomicInt *progress, const QAtomicInt *cancel)
 {
-    Q_UNUSED(filename)
-    Q_UNUSED(frames)
-    return false;
+    QFile outFile(filename);
+    if (!frames || !outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    memset(&header, 0, sizeof(header));
+    header.sig = BLF_FILE_SIG;
+    header.headerSize = sizeof(header);
+    header.binLogVerMajor = 2;
+    header.binLogVerMinor = 6;
+    header.binLogVerBuild = 8;
+    header.binLogVerPatch = 1;
+    //gets written again at the end once the sizes and counts are known
+    if (outFile.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) return false;
+
+    //objects are stamped relative to the start time in the header. Frames captured against the wall clock give the
+    //start time themselves, ones that count from the start of a capture get today
+    quint64 baseUs = 0;
+    quint64 lastUs = 0;
+    QDateTime startTime = QDateTime::currentDateTime();
+    if (!frames->isEmpty())
+    {
+        quint64 firstUs = static_cast<quint64>(frames->first().timeStamp().microSeconds());
+        lastUs = static_cast<quint64>(frames->last().timeStamp().microSeconds());
+        if (firstUs >= BLF_EPOCH_CUTOFF_US)
+        {
+            baseUs = firstUs;
+            startTime = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(firstUs / 1000));
+        }
+    }
+    QDateTime stopTime = startTime.addMSecs(static_cast<qint64>((lastUs > baseUs ? lastUs - baseUs : 0) / 1000));
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    size_t maxPending = static_cast<size_t>(threads) * 2;
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QMutex lock;
+    QWaitCondition finished;
+    std::deque<std::unique_ptr<BLFContainerJob>> pending;
+
+    quint64 uncompressedTotal = sizeof(header);
+    quint32 objectCount = 0;
+    QByteArray block;
+    block.reserve(BLF_CONTAINER_SIZE + 256);
+    static const char zeros[4] = {0, 0, 0, 0};
+    bool ok = true;
+
+    //no processEvents while waiting here, the frames being saved could be the live capture the GUI appends to
+    auto writeOldest = [&]() -> bool
+    {
+        BLFContainerJob *job = pending.front().get();
+        {
+            QMutexLocker locker(&lock);
+            while (!job->done) finished.wait(&lock);
+        }
+        bool written = false;
+        int compressedSize = job->output.size() - 4;
+        if (compressedSize >= 0)
+        {
+            BLF_OBJ_HEADER_BASE base;
+            base.sig = BLF_OBJ_SIG;
+            base.headerSize = sizeof(BLF_OBJ_HEADER_BASE);
+            base.headerVersion = 1;
+            base.objSize = static_cast<uint32_t>(sizeof(BLF_OBJ_HEADER_BASE) + sizeof(BLF_OBJ_HEADER_CONTAINER) + compressedSize);
+            base.objType = BLF_CONTAINER;
+            BLF_OBJ_HEADER_CONTAINER container;
+            memset(&container, 0, sizeof(container));
+            container.compressionMethod = BLF_CONT_ZLIB_COMPRESSION;
+            container.uncompressedSize = static_cast<uint32_t>(job->uncompressedSize);
+
+            written = outFile.write(reinterpret_cast<const char *>(&base), sizeof(base)) == sizeof(base)
+                    && outFile.write(reinterpret_cast<const char *>(&container), sizeof(container)) == sizeof(container)
+                    && outFile.write(job->output.constData() + 4, compressedSize) == compressedSize
+                    && outFile.write(zeros, base.objSize % 4) == base.objSize % 4;
+            uncompressedTotal += sizeof(BLF_OBJ_HEADER_BASE) + sizeof(BLF_OBJ_HEADER_CONTAINER) + job->uncompressedSize;
+        }
+        pending.pop_front();
+        return written;
+    };
+
+    //the first len bytes of the block become a container. Objects are cut wherever the block ends, like Vector does
+    auto compressBlock = [&](int len)
+    {
+        std::unique_ptr<BLFContainerJob> job(new BLFContainerJob(&lock, &finished));
+        job->deflate = true;
+        job->input = block.left(len);
+        job->uncompressedSize = len;
+        block.remove(0, len);
+        pool.start(job.get());
+        pending.push_back(std::move(job));
+        while (ok && pending.size() >= maxPending) ok = writeOldest();
+    };
+
+    for (int i = 0; ok && i < frames->count(); i++)
+    {
+        if ((i & 4095) == 0)
+        {
+            if (cancel && cancel->loadRelaxed()) break;
+            if (progress) progress->storeRelaxed(static_cast<int>(static_cast<qint64>(i) * 1000 / frames->count()));
+        }
+        const CANFrame &frame = frames->at(i);
+        const QByteArray payload = frame.payload();
+        bool remote = frame.frameType() == QCanBusFrame::RemoteRequestFrame;
+        bool fd = !remote && (frame.hasFlexibleDataRateFormat() || payload.length() > 8);
+        uint32_t id = frame.frameId() | (frame.hasExtendedFrameFormat() ? 0x80000000u : 0);
+        uint8_t channel = static_cast<uint8_t>(qBound(0, frame.bus + 1, 255));
+
+        BLF_OBJ_HEADER_BASE base;
+        base.sig = BLF_OBJ_SIG;
+        base.headerSize = sizeof(BLF_OBJ_HEADER_BASE) + sizeof(BLF_OBJ_HEADER_V1);
+        base.headerVersion = 1;
+        BLF_OBJ_HEADER_V1 v1;
+        v1.flags = BLF_TIME_ONE_NANS;
+        v1.clientIdx = 0;
+        v1.objVer = 0;
+        quint64 stampUs = static_cast<quint64>(frame.timeStamp().microSeconds());
+        v1.uncompSize = (stampUs > baseUs ? stampUs - baseUs : 0) * 1000;
+
+        if (fd)
+        {
+            BLF_CANFD64_OBJ fdObject;
+            memset(&fdObject, 0, sizeof(fdObject));
+            int padded = 0;
+            fdObject.channel = channel;
+            fdObject.dlc = fdDlcFor(payload.length(), padded);
+            fdObject.validDataBytes = static_cast<uint8_t>(padded);
+            fdObject.id = id;
+            fdObject.flags = BLF_FD64_EDL_FLAG | (frame.hasBitrateSwitch() ? BLF_FD64_BRS_FLAG : 0);
+            fdObject.dir = frame.isReceived ? 0 : 1;
+            base.objSize = static_cast<uint32_t>(base.headerSize + sizeof(fdObject) + padded);
+            base.objType = BLF_CAN_FD_MSG64;
+            block.append(reinterpret_cast<const char *>(&base), sizeof(base));
+            block.append(reinterpret_cast<const char *>(&v1), sizeof(v1));
+            block.append(reinterpret_cast<const char *>(&fdObject), sizeof(fdObject));
+            block.append(payload.constData(), qMin(payload.length(), padded));
+            if (padded > payload.length()) block.append(padded - payload.length(), 0);
+        }
+        else
+        {
+            BLF_CAN_OBJ2 canObject;
+            memset(&canObject, 0, sizeof(canObject));
+            canObject.channel = channel;
+            canObject.flags = (frame.isReceived ? 0 : BLF_TX_FLAG) | (remote ? BLF_REMOTE_FLAG : 0);
+            canObject.dlc = static_cast<uint8_t>(qMin(payload.length(), 8));
+            canObject.id = id;
+            if (!remote) memcpy(canObject.data, payload.constData(), canObject.dlc);
+            base.objSize = static_cast<uint32_t>(base.headerSize + sizeof(canObject));
+            base.objType = BLF_CAN_MSG2;
+            block.append(reinterpret_cast<const char *>(&base), sizeof(base));
+            block.append(reinterpret_cast<const char *>(&v1), sizeof(v1));
+            block.append(reinterpret_cast<const char *>(&canObject), sizeof(canObject));
+        }
+        block.append(zeros, base.objSize % 4);
+        objectCount++;
+
+        while (ok && block.size() >= BLF_CONTAINER_SIZE) compressBlock(BLF_CONTAINER_SIZE);
+    }
+    if (ok && !block.isEmpty()) compressBlock(block.size());
+    while (!pending.empty())
+    {
+        bool written = writeOldest();
+        ok = ok && written;
+    }
+    pool.waitForDone();
+    if (!ok) return false;
+
+    header.fileSize = static_cast<uint64_t>(outFile.pos());
+    header.uncompressedFileSize = uncompressedTotal;
+    header.countObjs = objectCount;
+    toSystemTime(startTime, header.startTime);
+    toSystemTime(stopTime, header.stopTime);
+    if (!outFile.seek(0)) return false;
+    return outFile.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
 }
@@ -2,10 +2,18 @@
 #define BLFHANDLER_H
 
 #include <Qt>
+#include <QAtomicInt>
 #include <QByteArray>
 #include <QList>
+#include <QVector>
+#include <functional>
 #include "can_structs.h"
 
+#define BLF_FILE_SIG 0x47474F4C //"LOGG"
+#define BLF_OBJ_SIG 0x4A424F4C //"LOBJ"
+#define BLF_FRAME_CHUNK 65536 //frames handed to the sink at a time
+#define BLF_CONTAINER_SIZE 131072 //uncompressed bytes per LOGCONTAINER when writing, same as Vector's tools
+
 enum
 {
     BLF_CAN_MSG = 1,
@@ -146,6 +154,26 @@ struct BLF_CANFD_OBJ
     uint8_t data[64];
 };
 
+//CAN_FD_MESSAGE_64, what current Vector tools write for FD frames. validDataBytes of data follow it
+struct BLF_CANFD64_OBJ
+{
+    uint8_t channel;
+    uint8_t dlc;
+    uint8_t validDataBytes;
+    uint8_t txCount;
+    uint32_t id;
+    uint32_t frameLength;
+    uint32_t flags; //0x10 = RTR, 0x1000 = EDL (FD frame), 0x2000 = BRS, 0x4000 = ESI
+    uint32_t btrCfgArb;
+    uint32_t btrCfgData;
+    uint32_t timeOffsetBrsNs;
+    uint32_t timeOffsetCrcDelNs;
+    uint16_t bitCount;
+    uint8_t dir; //0 = Rx, 1 = Tx
+    uint8_t extDataOffset;
+    uint32_t crc;
+}; //40 bytes
+
 struct BLF_ERROR_EXT
 {
     uint16_t channel;
@@ -175,14 +203,32 @@ struct BLF_GLOBAL_MARKER
     uint8_t ignore2[12];
 };
 
+/*
+ * Reads BLF files as a stream. The file is walked one object at a time and every LOGCONTAINER is inflated on a
+ * thread pool, several at once but never more than a couple per thread so memory doesn't run away on big files.
+ * Containers are then parsed in file order on the calling thread. Objects can straddle containers, the part that's
+ * left over is carried into the next one. Frames go to the sink BLF_FRAME_CHUNK at a time.
+ *
+ * Writing goes the other way around: frames are laid out as objects in BLF_CONTAINER_SIZE blocks on the calling
+ * thread and each block is deflated on the pool, then written out in order as zlib LOGCONTAINERs. The file header is
+ * filled in last with the real sizes, object count and start / stop times.
+ */
 class BLFHandler
 {
 public:
+    typedef std::function<void(QVector<CANFrame> &)> FrameSink; //may take the frames out of the vector
+
     BLFHandler();
     bool loadBLF(QString filename, QVector<CANFrame>* frames);
-    bool saveBLF(QString filename, QVector<CANFrame>* frames);
+    //progress, if given, is set to how far through the file the reader is in 1/1000ths
+    bool loadBLF(QString filename, const FrameSink &sink, QAtomicInt *progress = nullptr);
+    //progress as for loading, and the save stops early once cancel is set
+    bool saveBLF(QString filename, const QVector<CANFrame>* frames, QAtomicInt *progress = nullptr, const QAtomicInt *cancel = nullptr);
 
 private:
+    //complete objects at the front of buffer become frames, whatever is left is the start of one in the next container
+    bool parseObjects(QByteArray &buffer, int &skip, QVector<CANFrame> &chunk, const FrameSink &sink);
+
     BLF_FILE_HEADER header;
     QList<BLF_OBJECT> objects;
 };
@@ -0,0 +1,27 @@
+#ifndef CANIDPARTS_H
+#define CANIDPARTS_H
+
+#include <stdint.h>
+
+/*
+ * The fields J1939 and GMLAN pack into a 29 bit ID. Only shifts and masks, so the frame list, filter expressions and
+ * the protocol handlers all work them out on the spot from the ID rather than storing them anywhere.
+ *
+ * J1939: priority in bits 26-28, then the PGN (data page, PDU format and PDU specific) and the source address in the
+ * low byte. A PDU format below 0xF0 is PDU1, where PDU specific is the destination and not part of the PGN. PDU2
+ * PGNs go to everyone and keep it as their group extension.
+ * GMLAN: the same priority bits, the arbitration ID in bits 13-25 and the sender in the low 13 bits.
+ */
+class CANIdParts
+{
+public:
+    static uint32_t priority(uint32_t id) { return (id >> 26) & 0x7; }
+    static bool isJ1939Broadcast(uint32_t id) { return ((id >> 16) & 0xFF) > 0xEF; }
+    static uint32_t j1939Pgn(uint32_t id) { return (id >> 8) & (isJ1939Broadcast(id) ? 0x3FFFF : 0x3FF00); }
+    static uint32_t j1939Source(uint32_t id) { return id & 0xFF; }
+    static uint32_t j1939Dest(uint32_t id) { return isJ1939Broadcast(id) ? 0xFF : (id >> 8) & 0xFF; } //0xFF is everyone
+    static uint32_t gmlanArbitrationId(uint32_t id) { return (id >> 13) & 0x1FFF; }
+    static uint32_t gmlanSenderId(uint32_t id) { return id & 0x1FFF; }
+};
+
+#endif // CANIDPARTS_H
@@ -1,51 +1,105 @@
 #include "isotp_handler.h"
 #include "connections/canconmanager.h"
+#include "pipelinetrace.h"
+#include "threadpolicy.h"
+
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+//a share of the pairs of a capture, see reassemble()
+class ReassembleTask : public QRunnable
+{
+public:
+    explicit ReassembleTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() override { task(); }
+private:
+    std::function<void()> task;
+};
+}
 
 ISOTP_HANDLER::ISOTP_HANDLER()
 {
-    useExtendedAddressing = false;
     isReceiving = false;
     issueFlowMsgs = false;
     processAll = false;
-    sendPartialMessages = false;
     lastSenderBus = 0;
     lastSenderID = 0;
+    txPacer = nullptr;
+    txStopping = false;
+    txState = TX_IDLE;
+    txNext = 0;
+    txBlockLeft = -1;
+    txSeparationUs = 0;
+    txDueUs = 0;
+    txConn = nullptr;
 
     modelFrames = MainWindow::getReference()->getCANFrameModel()->getListReference();
 
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    frameTimer.setTimerType(Qt::PreciseTimer);
     connect(&frameTimer, SIGNAL(timeout()), this, SLOT(frameTimerTick()));
+    //targetted frames only reach connections that exist when they're added, so new ones need them again
+    connect(CANConManager::getInstance(), &CANConManager::connectionStatusUpdated, this, &ISOTP_HANDLER::registerTargets);
 }
 
 ISOTP_HANDLER::~ISOTP_HANDLER()
 {
     disconnect(&frameTimer, SIGNAL(timeout()), this, SLOT(frameTimerTick()));
+    CANConManager::getInstance()->removeAllTargettedFrames(this);
+    if (txPacer)
+    {
+        txLock.lock();
+        txStopping = true;
+        txWake.wakeAll();
+        txLock.unlock();
+        txPacer->wait();
+        delete txPacer;
+    }
 }
 
 void ISOTP_HANDLER::setExtendedAddressing(bool mode)
 {
-    useExtendedAddressing = mode;
+    QMutexLocker lock(&sessionLock);
+    live.extendedAddressing = mode;
 }
 
 void ISOTP_HANDLER::setFlowCtrl(bool state)
 {
+    QMutexLocker lock(&sessionLock);
     issueFlowMsgs = state;
 }
 
+void ISOTP_HANDLER::setEmitPartials(bool mode)
+{
+    QMutexLocker lock(&sessionLock);
+    live.emitPartials = mode;
+}
+
 void ISOTP_HANDLER::setReception(bool mode)
 {
     if (isReceiving == mode) return;
     isReceiving = mode;
+    registerTargets();
+    qDebug() << (isReceiving ? "Enabling" : "Disabling") << "reception in ISOTP handler";
+}
 
-    if (isReceiving)
-    {
-        connect(CANConManager::getInstance(), &CANConManager::framesReceived, this, &ISOTP_HANDLER::rapidFrames);
-        qDebug() << "Enabling reception in ISOTP handler";
-    }
-    else
+//the filters (or everything, with processAll) as targetted frames so the connections hand them over as they arrive
+void ISOTP_HANDLER::registerTargets()
+{
+    CANConManager *manager = CANConManager::getInstance();
+    manager->removeAllTargettedFrames(this);
+    if (!isReceiving) return;
+    if (processAll)
     {
-        disconnect(CANConManager::getInstance(), &CANConManager::framesReceived, this, &ISOTP_HANDLER::rapidFrames);
-        qDebug() << "Disabling reception in ISOTP handler";
+        manager->addTargettedFrame(-1, 0, 0, this);
+        return;
     }
+    for (const CANFilter &filt : qAsConst(filters)) manager->addTargettedFrame(filt.bus, filt.ID, filt.mask, this);
 }
 
 void ISOTP_HANDLER::sendISOTPFrame(int bus, int ID, QByteArray data)
@@ -57,8 +111,11 @@ void ISOTP_HANDLER::sendISOTPFrame(int bus, int ID, QByteArray data)
     if (bus < 0) return;
     if (bus >= CANConManager::getInstance()->getNumBuses()) return;
 
-    lastSenderID = ID;
-    lastSenderBus = bus;
+    {
+        QMutexLocker lock(&sessionLock);
+        lastSenderID = ID;
+        lastSenderBus = bus;
+    }
 
     frame.bus = bus;
     frame.setFrameId(ID);
@@ -72,7 +129,7 @@ void ISOTP_HANDLER::sendISOTPFrame(int bus, int ID, QByteArray data)
         bytes[0] = data.length();
         for (int i = 0; i < data.length(); i++) bytes[i + 1] = data[i];
         frame.setPayload(bytes);
-        CANConManager::getInstance()->sendFrame(frame);
+        CANConManager::getInstance()->sendFrame(frame, TX_PROTOCOL);
     }
     else //need to send a multi-part ISO_TP message - Respects timing and frame number based flow control
     {
@@ -80,13 +137,11 @@ void ISOTP_HANDLER::sendISOTPFrame(int bus, int ID, QByteArray data)
         bytes[0] = 0x10 + (data.length() / 256);
         bytes[1] = data.length() & 0xFF;
         for (int i = 0; i < 6; i++) bytes[2 + i] = data[currByte++];
-        frame.setPayload(bytes);
-        CANConManager::getInstance()->sendFrame(frame);
-        //Queue up the rest of the frames
-        waitingForFlow = true;
-        frameTimer.setInterval(200); //wait a while for the flow frame to come in
-        frameTimer.setTimerType(Qt::PreciseTimer);
-        frameTimer.start();
+        QByteArray firstBytes = bytes;
+        //Queue up the rest of the frames. They're all made before the first frame goes out since the flow control
+        //can come back on a reading thread before sendFrame even returns
+        QVector<CANFrame> rest;
+        rest.reserve((data.length() - 6) / 7 + 1);
         while (currByte < data.length())
         {
             for (int b = 0; b < 8; b++) bytes[b] = 0x00;
@@ -95,287 +150,572 @@ void ISOTP_HANDLER::sendISOTPFrame(int bus, int ID, QByteArray data)
             int bytesToGo = data.length() - currByte;
             if (bytesToGo > 7) bytesToGo = 7;
             for (int i = 0; i < bytesToGo; i++) bytes[1 + i] = data[currByte++];
-            frame.setPayload(bytes);
-            sendingFrames.append(frame);
-            //CANConManager::getInstance()->sendFrame(frame);
+            CANFrame consecutive = frame;
+            consecutive.setPayload(bytes);
+            rest.append(consecutive);
+        }
+        {
+            QMutexLocker lock(&txLock);
+            txFrames = rest;
+            txNext = 0;
+            txBlockLeft = -1;
+            txState = TX_WAIT_FLOW;
         }
+        frameTimer.start(200); //wait a while for the flow frame to come in
+        frame.setPayload(firstBytes);
+        CANConManager::getInstance()->sendFrame(frame, TX_PROTOCOL);
     }
 }
 
 //remember, negative numbers are special -1 = all frames deleted, -2 = totally new set of frames.
 void ISOTP_HANDLER::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("ISOTP_HANDLER::updatedFrames");
+    QMutexLocker lock(&sessionLock);
     if (numFrames == -1) //all frames deleted. Kill the display
     {
-        messageBuffer.clear();
+        for (ISOTP_SESSION *session : qAsConst(live.sessions)) session->active = false;
     }
     else if (numFrames == -2) //all new set of frames. Reset
     {
-        messageBuffer.clear();
-        for (int i = 0; i < modelFrames->length(); i++) processFrame(modelFrames->at(i));
+        for (ISOTP_SESSION *session : qAsConst(live.sessions)) session->active = false;
+        for (int i = 0; i < modelFrames->length(); i++) processFrame(live, modelFrames->at(i), nullptr);
     }
-    else //just got some new frames. See if they are relevant.
+    //new frames were already taken from the connections as they came in
+}
+
+QVector<ISOTP_MESSAGE> ISOTP_HANDLER::reassemble(const CANFrameSnapshot &frames, const QVector<quint32> &keys,
+                                                const std::function<bool()> &keepGoing)
+{
+    QVector<ISOTP_MESSAGE> out;
+    Reassembly settings;
+    {
+        QMutexLocker lock(&sessionLock);
+        settings.extendedAddressing = live.extendedAddressing;
+        settings.emitPartials = live.emitPartials;
+    }
+
+    int total = keys.isEmpty() ? frames.count() : keys.count();
+    quint32 base = static_cast<quint32>(frames.baseSequence());
+    auto rowOf = [&](int i)
+    {
+        if (keys.isEmpty()) return i;
+        quint32 offset = keys.at(i) - base;
+        return offset < static_cast<quint32>(frames.count()) ? static_cast<int>(offset) : -1; //-1 is evicted since
+    };
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    if (total < ISOTP_PARALLEL_MIN_FRAMES || threads == 1)
+    {
+        Reassembly r;
+        r.extendedAddressing = settings.extendedAddressing;
+        r.emitPartials = settings.emitPartials;
+        r.collect = &out;
+        for (int i = 0; i < total; i++)
+        {
+            if ((i & 0xFFF) == 0 && !keepGoing()) break;
+            int idx = rowOf(i);
+            if (idx < 0) continue;
+            processFrame(r, frames.at(idx), nullptr);
+        }
+        return out;
+    }
+
+    //the frames of each bus / ID pair, going by the records alone so no frame gets built for this
+    QHash<quint64, int> partOf;
+    QVector<QVector<int>> parts;
+    quint64 lastKey = ~0ull;
+    int lastPart = -1;
+    for (int i = 0; i < total; i++)
     {
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        if ((i & 0xFFFF) == 0 && !keepGoing()) return out;
+        int idx = rowOf(i);
+        if (idx < 0) continue;
+        const CANFrameRecord &rec = frames.record(idx);
+        if (rec.len <= (settings.extendedAddressing ? 1 : 0)) continue; //processFrame would skip it too
+        quint64 key = CANFrameStore::idKey(rec.frameId(), rec.bus);
+        if (key != lastKey)
         {
-            //processFrame(modelFrames->at(i));  //accepting these frames in rapidFrames instead
+            lastKey = key;
+            lastPart = partOf.value(key, -1);
+            if (lastPart < 0)
+            {
+                lastPart = parts.count();
+                partOf.insert(key, lastPart);
+                parts.append(QVector<int>());
+            }
         }
+        parts[lastPart].append(idx);
+    }
+
+    //biggest pairs first, each onto whichever thread has the fewest frames so far
+    QVector<int> order(parts.count());
+    for (int p = 0; p < order.count(); p++) order[p] = p;
+    std::sort(order.begin(), order.end(), [&parts](int a, int b) { return parts.at(a).count() > parts.at(b).count(); });
+    threads = qMin(threads, qMax(1, static_cast<int>(parts.count())));
+    QVector<QVector<int>> assigned(threads);
+    QVector<qint64> load(threads, 0);
+    for (int p : qAsConst(order))
+    {
+        int t = static_cast<int>(std::min_element(load.constBegin(), load.constEnd()) - load.constBegin());
+        assigned[t].append(p);
+        load[t] += parts.at(p).count();
+    }
+
+    QVector<QVector<ISOTP_MESSAGE>> found(threads);
+    QVector<QVector<int>> foundRows(threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for (int t = 0; t < threads; t++)
+    {
+        QVector<ISOTP_MESSAGE> *collect = &found[t];
+        QVector<int> *collectRows = &foundRows[t];
+        const QVector<int> *mine = &assigned.at(t);
+        pool.start(new ReassembleTask([&, collect, collectRows, mine]()
+        {
+            Reassembly r;
+            r.extendedAddressing = settings.extendedAddressing;
+            r.emitPartials = settings.emitPartials;
+            r.collect = collect;
+            r.collectRows = collectRows;
+            for (int p : *mine) reassembleRows(r, frames, parts.at(p), keepGoing);
+        }));
     }
+    pool.waitForDone();
+
+    //back into the order of the frames that finished them. Stable, so two from one frame keep theirs
+    struct Found
+    {
+        int row;
+        int thread;
+        int idx;
+    };
+    QVector<Found> merged;
+    for (int t = 0; t < threads; t++)
+    {
+        for (int i = 0; i < found.at(t).count(); i++) merged.append({foundRows.at(t).at(i), t, i});
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const Found &a, const Found &b) { return a.row < b.row; });
+    out.reserve(merged.count());
+    for (const Found &f : qAsConst(merged)) out.append(found.at(f.thread).at(f.idx));
+    return out;
 }
 
-void ISOTP_HANDLER::rapidFrames(const CANConnection* conn, const QVector<CANFrame>& pFrames)
+//one pair's frames, oldest first, on a worker of reassemble()
+void ISOTP_HANDLER::reassembleRows(Reassembly &r, const CANFrameSnapshot &frames, const QVector<int> &rows,
+                                   const std::function<bool()> &keepGoing)
 {
-    Q_UNUSED(conn)
-    if (pFrames.length() <= 0) return;
+    for (int i = 0; i < rows.count(); i++)
+    {
+        if ((i & 0xFFF) == 0xFFF && !keepGoing()) return;
+        r.row = rows.at(i);
+        processFrame(r, frames.at(r.row), nullptr);
+    }
+}
 
-    qDebug() << "received " << QString::number(pFrames.count()) << " messages in ISOTP handler";
+void ISOTP_HANDLER::reactToFrame(const CANFrame &frame)
+{
+    reactToFrameFrom(frame, nullptr);
+}
 
-    foreach(const CANFrame& thisFrame, pFrames)
+//connection thread. Only frames that passed one of the filters get here
+void ISOTP_HANDLER::reactToFrameFrom(const CANFrame &frame, CANConnection *pFrom)
+{
+    FlowControl fc;
     {
-        //only process frames that we've marked are ISOTP frames
-        //unless processAll is true
-        if (processAll) processFrame(thisFrame);
-        else
-        {
-            for (int i = 0; i < filters.count(); i++)
-            {
-                if ((thisFrame.bus == filters[i].bus) && ((thisFrame.frameId() & filters[i].mask) == filters[i].ID))
-                {
-                    processFrame(thisFrame);
-                    break;
-                }
-            }
+        QMutexLocker lock(&sessionLock);
+        processFrame(live, frame, pFrom, &fc);
+    }
+    //outside the session lock since this can end up sending a whole block
+    if (fc.seen) handleFlowControl(fc.type, fc.blockSize, fc.separation, pFrom);
+}
 
-        }
+ISOTP_SESSION *ISOTP_HANDLER::sessionFor(Reassembly &r, const CANFrame &frame, uint64_t ID)
+{
+    quint64 key = (static_cast<quint64>(static_cast<quint32>(frame.bus) & 0xFFFFFF) << 40) | (ID & 0xFFFFFFFFFFull);
+    ISOTP_SESSION *&session = r.sessions[key];
+    if (!session)
+    {
+        session = r.arena.create();
+        session->bus = frame.bus;
+        session->id = ID;
+        session->active = false;
     }
+    return session;
 }
 
-void ISOTP_HANDLER::processFrame(const CANFrame &frame)
+//the handler's own thread gets it in one go, whichever thread finished the message
+void ISOTP_HANDLER::deliver(Reassembly &r, const ISOTP_MESSAGE &msg)
 {
-    uint64_t ID = frame.frameId();
-    int frameType;
-    int frameLen;
-    int ln;
-    //int offset;
+    if (r.collect)
+    {
+        r.collect->append(msg);
+        if (r.collectRows) r.collectRows->append(r.row);
+        return;
+    }
+    QMetaObject::invokeMethod(this, [this, msg]() { emit newISOMessage(msg); }, Qt::QueuedConnection);
+}
+
+//a new message from the same sender while one was still being put together. What there is of it might be wanted
+void ISOTP_HANDLER::flushSession(Reassembly &r, ISOTP_SESSION *session)
+{
+    if (!session->active) return;
+    session->active = false;
+    if (!r.emitPartials || session->received == 0)
+    {
+        if (!r.collect) qDebug() << "Have a partial message but sending of such is disabled. Throwing it away";
+        return;
+    }
+    if (!r.collect) qDebug() << "Flushing a partial frame " << QString::number(session->id, 16) << "  " << session->expected << "  " << session->received;
     ISOTP_MESSAGE msg;
-    ISOTP_MESSAGE *pMsg;
-    QByteArray dataBytes;
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(frame.payload().constData());
-    //qDebug() << frame.payload().count();
-    //int dataLen = frame.payload().count();
+    msg.bus = session->bus;
+    msg.setFrameType(QCanBusFrame::FrameType::DataFrame);
+    msg.setExtendedFrameFormat(session->extended);
+    msg.setFrameId(static_cast<QCanBusFrame::FrameId>(session->id));
+    msg.isReceived = session->isReceived;
+    msg.setTimeStamp(session->started);
+    msg.reportedLength = session->expected;
+    msg.lastSequence = -1;
+    msg.isMultiframe = true;
+    msg.setPayload(QByteArray(reinterpret_cast<const char *>(session->data), session->received));
+    deliver(r, msg);
+}
 
-    frameType = 0;
-    frameLen = 0;
+/*
+ * With live, called with sessionLock held from a reading thread (pFrom set) or the handler's own thread for loaded
+ * frames. reassemble() calls it with its own Reassembly and no lock.
+ * Flow control only goes out for live frames, straight back out of the connection the first frame came in on.
+ */
+void ISOTP_HANDLER::processFrame(Reassembly &r, const CANFrame &frame, CANConnection *pFrom, FlowControl *fc)
+{
+    uint64_t ID = frame.frameId();
+    const QByteArray payload = frame.payload();
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(payload.constData());
+    int dataLen = payload.length();
+    int pci = r.extendedAddressing ? 1 : 0; //where the protocol control info is
+    if (dataLen <= pci) return;
 
-    if (useExtendedAddressing)
+    if (r.extendedAddressing)
     {
         ID = ID << 8;
         ID += data[0];
-        frameType = data[1] >> 4;
-        frameLen = data[1] & 0xF;
-    }
-    else
-    {
-        frameType = data[0] >> 4;
-        frameLen = data[0] & 0xF;
     }
+    int frameType = data[pci] >> 4;
+    int frameLen = data[pci] & 0xF;
+    ISOTP_SESSION *session;
 
     switch(frameType)
     {
     case 0: //single frame message
-        checkNeedFlush(ID);
+    {
+        //a sender that never sent a multi-frame message doesn't need a session for this
+        quint64 key = (static_cast<quint64>(static_cast<quint32>(frame.bus) & 0xFFFFFF) << 40) | (ID & 0xFFFFFFFFFFull);
+        ISOTP_SESSION *existing = r.sessions.value(key, nullptr);
+        if (existing) flushSession(r, existing);
 
         if (frameLen == 0) return; //length of zero isn't valid.
-        if (frameLen > 6 && useExtendedAddressing) return; //impossible
-        if (frameLen > 7) return;
+        if (frameLen > 7 - pci) return; //impossible
+        if (dataLen < pci + 1 + frameLen) return;
 
+        ISOTP_MESSAGE msg;
         msg.bus = frame.bus;
         msg.setFrameType(QCanBusFrame::FrameType::DataFrame);
         msg.setExtendedFrameFormat( frame.hasExtendedFrameFormat() );
-        msg.setFrameId(ID);
+        msg.setFrameId(static_cast<QCanBusFrame::FrameId>(ID));
         msg.isReceived = frame.isReceived;
-        dataBytes.reserve(frameLen);
         msg.reportedLength = frameLen;
+        msg.lastSequence = -1;
         msg.setTimeStamp(frame.timeStamp());
         msg.isMultiframe = false;
-        if (useExtendedAddressing)
-        {       
-            for (int j = 0; j < frameLen; j++)
-            {
-                if (frame.payload().count() > (j+2))
-                    dataBytes.append(data[j+2]);
-            }
-        }
-        else
-        {
-            for (int j = 0; j < frameLen; j++)
-            {
-                if (frame.payload().count() > (j+1))
-                    dataBytes.append(data[j+1]);
-            }
-        }
-        qDebug() << "Emitting single frame ISOTP message";
-        msg.setPayload(dataBytes);
-        emit newISOMessage(msg);
+        msg.setPayload(QByteArray(reinterpret_cast<const char *>(data + pci + 1), frameLen));
+        deliver(r, msg);
         break;
+    }
     case 1: //first frame of a multi-frame message
-        checkNeedFlush(ID);
-        msg.bus = frame.bus;
-        if (frame.payload().count() < 8) return; //MUST have all 8 data bytes in this first frame.
-        msg.setExtendedFrameFormat( frame.hasExtendedFrameFormat() );
-        msg.setFrameId(ID);
-        msg.setTimeStamp(frame.timeStamp());
-        msg.isReceived = frame.isReceived;
-        msg.isMultiframe = true;
-        frameLen = frameLen << 8;
-        if (useExtendedAddressing)
-        {
-            frameLen += data[2];
-            frameLen = frameLen & 0xFFF;
-            dataBytes.reserve(frameLen);
-            msg.reportedLength = frameLen;
-            for (int j = 0; j < 5; j++) dataBytes.append(frame.payload()[3 + j]);
-        }
-        else
-        {
-            frameLen += data[1];
-            frameLen = frameLen & 0xFFF;
-            msg.payload().reserve(frameLen);
-            msg.reportedLength = frameLen;
-            for (int j = 0; j < 6; j++) dataBytes.append(frame.payload()[2 + j]);
-        }
-        msg.lastSequence = -1;
-        msg.setPayload(dataBytes);
-        messageBuffer.insert(msg.frameId(), msg);
+    {
+        if (dataLen < 8) return; //MUST have all 8 data bytes in this first frame.
+        session = sessionFor(r, frame, ID);
+        flushSession(r, session);
+
+        int expected = ((frameLen << 8) + data[pci + 1]) & 0xFFF;
+        if (expected == 0) return;
+        session->extended = frame.hasExtendedFrameFormat();
+        session->isReceived = frame.isReceived;
+        session->started = frame.timeStamp();
+        session->expected = expected;
+        session->received = std::min(6 - pci, expected);
+        memcpy(session->data, data + pci + 2, session->received);
+        session->nextSeq = 1;
+        session->active = true;
+
         //The sending ID is set to the last ID we used to send from this class which is
         //very likely to be correct. But, caution, there is a chance that it isn't. Beware.
-        if (issueFlowMsgs && lastSenderID > 0 && lastSenderBus==static_cast<uint32_t>(frame.bus))
+        //Anybody talking to more than one ID at a time says which ID answers which with setFlowControlID
+        if (!pFrom || !issueFlowMsgs) break;
+        quint64 key = (static_cast<quint64>(static_cast<quint32>(frame.bus) & 0xFFFFFF) << 40) | (ID & 0xFFFFFFFFFFull);
+        auto flow = flowIDs.constFind(key);
+        uint32_t flowID = (flow != flowIDs.constEnd()) ? flow.value() : lastSenderID;
+        bool known = flow != flowIDs.constEnd() || (lastSenderID > 0 && lastSenderBus == static_cast<uint32_t>(frame.bus));
+        if (known)
         {
             CANFrame outFrame;
-            outFrame.bus = lastSenderBus;
-            outFrame.setExtendedFrameFormat(false);
-            outFrame.setFrameId(lastSenderID);
+            outFrame.bus = frame.bus - pFrom->getBusBase();
+            outFrame.isReceived = false;
+            outFrame.setExtendedFrameFormat(flowID > 0x7FF);
+            outFrame.setFrameId(flowID);
             QByteArray bytes(8, 0);
             bytes[0] = 0x30; //flow control, go ahead and send
             bytes[1] = 0; //dont ask again about flow control
             bytes[2] = 3; //separation time in milliseconds between messages.
             outFrame.setPayload(bytes);
-            CANConManager::getInstance()->sendFrame(outFrame);
+            pFrom->sendFrame(outFrame);
         }
         break;
+    }
     case 2: //subsequent frames for multi-frame messages
-        pMsg = nullptr;
-        if (messageBuffer.contains(ID))
-        {
-            pMsg = &messageBuffer[ID];
-        }
-        if (!pMsg) return;
-        if (!pMsg->isMultiframe) return; //if we didn't get a frame type 1 (start of multiframe) first then ignore this frame.
-        dataBytes.clear();
-        dataBytes.append(pMsg->payload());
-        ln = pMsg->reportedLength - pMsg->payload().count();
-        //offset = pMsg->data.count();
-        if (useExtendedAddressing)
+    {
+        quint64 key = (static_cast<quint64>(static_cast<quint32>(frame.bus) & 0xFFFFFF) << 40) | (ID & 0xFFFFFFFFFFull);
+        session = r.sessions.value(key, nullptr);
+        if (!session || !session->active) return; //if we didn't get a frame type 1 (start of multiframe) first then ignore this frame.
+        if (frameLen != session->nextSeq)
         {
-            if (ln > 6) ln = 6;
-            for (int j = 0; j < ln; j++) dataBytes.append(frame.payload()[j+2]);
+            //lost a frame somewhere, what's there can't be trusted to line up any more
+            qDebug() << "ISOTP sequence error on" << QString::number(ID, 16) << "expected" << session->nextSeq << "got" << frameLen;
+            flushSession(r, session);
+            return;
         }
-        else
+        session->nextSeq = (session->nextSeq + 1) & 0xF;
+
+        int ln = std::min(std::min(session->expected - session->received, 7 - pci), dataLen - pci - 1);
+        if (ln > 0)
         {
-            if (ln > 7) ln = 7;
-            for (int j = 0; j < ln; j++) dataBytes.append(frame.payload()[j+1]);
+            memcpy(session->data + session->received, data + pci + 1, ln);
+            session->received += ln;
         }
-        pMsg->setPayload(dataBytes);
-        if (pMsg->reportedLength <= pMsg->payload().count())
+        if (session->received >= session->expected)
         {
-            qDebug() << "Emitting multiframe ISOTP message";
-            checkNeedFlush(pMsg->frameId());
+            if (!r.collect) qDebug() << "Emitting multiframe ISOTP message";
+            ISOTP_MESSAGE msg;
+            msg.bus = session->bus;
+            msg.setFrameType(QCanBusFrame::FrameType::DataFrame);
+            msg.setExtendedFrameFormat(session->extended);
+            msg.setFrameId(static_cast<QCanBusFrame::FrameId>(session->id));
+            msg.isReceived = session->isReceived;
+            msg.setTimeStamp(session->started);
+            msg.reportedLength = session->expected;
+            msg.lastSequence = frameLen;
+            msg.isMultiframe = true;
+            msg.setPayload(QByteArray(reinterpret_cast<const char *>(session->data), session->expected));
+            session->active = false;
+            deliver(r, msg);
         }
         break;
-    case 3: //flow control messages
-        switch (frameLen) //actually flow control type in this case
+    }
+    case 3: //flow control messages, for what sendISOTPFrame is sending. Loaded frames don't get to steer that
+        if (!fc || !pFrom || dataLen < pci + 3) return;
+        fc->seen = true;
+        fc->type = frameLen; //actually flow control type in this case
+        fc->blockSize = data[pci + 1];
+        fc->separation = data[pci + 2];
+        break;
+    }
+}
+
+static inline quint64 steadyUs()
+{
+    return static_cast<quint64>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//STmin byte to microseconds. 0xF1 through 0xF9 are 100 to 900us, anything reserved is taken as the longest there is
+static quint32 separationUs(int separation)
+{
+    if (separation <= 0x7F) return static_cast<quint32>(separation) * 1000;
+    if (separation >= 0xF1 && separation <= 0xF9) return static_cast<quint32>(separation - 0xF0) * 100;
+    return 127000;
+}
+
+bool ISOTP_HANDLER::isSending()
+{
+    QMutexLocker lock(&txLock);
+    return txState != TX_IDLE;
+}
+
+//nothing goes out until the next flow control, and if that takes too long frameTimer gives up waiting
+void ISOTP_HANDLER::waitForFlow()
+{
+    txState = TX_WAIT_FLOW;
+    QMetaObject::invokeMethod(this, [this]() { frameTimer.start(200); }, Qt::QueuedConnection);
+}
+
+/*
+ * Reading thread of pFrom. A separation time of 0 sends the block right here in one batch, back out of the
+ * connection the flow control came in on. Otherwise the pacer is told when the first frame is due.
+ */
+void ISOTP_HANDLER::handleFlowControl(int type, int blockSize, int separation, CANConnection *pFrom)
+{
+    QList<CANFrame> burst;
+    {
+        QMutexLocker lock(&txLock);
+        if (txState != TX_WAIT_FLOW && txState != TX_PACED) return;
+
+        switch (type)
         {
-        case 0: //continue to send frames but maybe change inter-frame delay
-            waitingForFlow = false;
-            //data[1] contains number of frames to send before waiting for next flow control
-            framesUntilFlow = data[1];
-            if (framesUntilFlow == 0) framesUntilFlow = -1; //-1 means don't count frames and just keep going
-            //data[2] contains the interframe delay to use (0xF1 through 0xF9 are special through - 100 to 900us)
-            if (data[2] < 0xF1) frameTimer.start(data[2]); //set proper delay between frames
-            else frameTimer.start(1); //can't do sub-millisecond sending with this code so just use 1ms timing
+        case 0: //clear to send, maybe with a new block size and separation time
+            txBlockLeft = blockSize ? blockSize : -1;
+            txSeparationUs = separationUs(separation);
             break;
         case 1: //wait - do not send any more frames until other side says so
-            waitingForFlow = true;
-            frameTimer.stop(); //quit sending frames for now
-            break;
-        case 2: //overflow or abort. Assume this means abort and quit sending
-            frameTimer.stop();
-            sendingFrames.clear();
-            waitingForFlow = false;
-            break;
+            txState = TX_WAIT_FLOW;
+            return;
+        default: //overflow or abort. Assume this means abort and quit sending
+            txState = TX_IDLE;
+            txFrames.clear();
+            return;
         }
-        waitingForFlow = false;
 
-        break;
+        //the flow control might have come in on another connection, the timer can still send through CANConManager
+        int busBase = pFrom->getBusBase();
+        int bus = txFrames.isEmpty() ? -1 : txFrames[0].bus;
+        if (bus < busBase || bus >= busBase + pFrom->getNumBuses())
+        {
+            txState = TX_FALLBACK;
+            int ms = static_cast<int>(qMax(1u, txSeparationUs / 1000));
+            QMetaObject::invokeMethod(this, [this, ms]() { frameTimer.start(ms); }, Qt::QueuedConnection);
+            return;
+        }
+        txConn = pFrom;
+
+        if (txSeparationUs == 0)
+        {
+            while (txNext < txFrames.count() && txBlockLeft != 0)
+            {
+                CANFrame frame = txFrames[txNext++];
+                frame.bus -= busBase;
+                burst.append(frame);
+                if (txBlockLeft > 0) txBlockLeft--;
+            }
+            if (txNext >= txFrames.count())
+            {
+                txState = TX_IDLE;
+                txFrames.clear();
+            }
+            else waitForFlow();
+        }
+        else
+        {
+            txState = TX_PACED;
+            txDueUs = steadyUs() + txSeparationUs;
+            if (!txPacer)
+            {
+                txPacer = QThread::create([this]{ runPacer(); });
+                txPacer->start(QThread::TimeCriticalPriority);
+            }
+            txWake.wakeAll();
+        }
     }
+    if (!burst.isEmpty()) pFrom->sendFrames(burst);
 }
 
-void ISOTP_HANDLER::checkNeedFlush(uint64_t ID)
+/*
+ * One frame every separation time while paced. Sleeps to within a couple of milliseconds and spins the rest so
+ * sub-millisecond separation times are kept too.
+ */
+void ISOTP_HANDLER::runPacer()
 {
-    ISOTP_MESSAGE *msg;
-    if (messageBuffer.contains(ID))
+    ThreadPolicy::apply(ThreadPolicy::ISOTP);
+    QMutexLocker locker(&txLock);
+    while (!txStopping)
     {
-        msg = &messageBuffer[ID];
-        if (msg->reportedLength <= msg->payload().count())
+        if (txState != TX_PACED)
         {
-            qDebug() << "Flushing full frame" << QString::number(msg->frameId(), 16) << "  " << msg->reportedLength << "  " << msg->payload().count();
-            if (msg->reportedLength > 0) emit newISOMessage(*msg);
+            txWake.wait(&txLock);
+            continue;
         }
-        else
+        quint64 now = steadyUs();
+        if (txDueUs > now)
         {
-            if (sendPartialMessages)
+            if (txDueUs - now > 2000) txWake.wait(&txLock, static_cast<unsigned long>((txDueUs - now) / 1000 - 1));
+            else
             {
-                qDebug() << "Flushing a partial frame " << QString::number(msg->frameId(), 16) << "  " << msg->reportedLength << "  " << msg->payload().count();
-                if (msg->reportedLength > 0) emit newISOMessage(*msg);
+                locker.unlock();
+                QThread::yieldCurrentThread();
+                locker.relock();
             }
-            else qDebug() << "Have a partial message but sending of such is disabled. Throwing it away";
-        }        
-        messageBuffer.remove(ID);
+            continue;
+        }
+        ThreadPolicy::recordWakeup(ThreadPolicy::ISOTP, static_cast<qint64>(now - txDueUs));
+
+        CANFrame frame = txFrames[txNext++];
+        frame.bus -= txConn->getBusBase();
+        if (txBlockLeft > 0) txBlockLeft--;
+        if (txNext >= txFrames.count())
+        {
+            txState = TX_IDLE;
+            txFrames.clear();
+        }
+        else if (txBlockLeft == 0) waitForFlow();
+        else txDueUs += txSeparationUs;
+        CANConnection *conn = txConn;
+
+
+        //posted rather than called, the connection might not have a thread of its own to switch to
+        QMetaObject::invokeMethod(conn, "sendFrame", Qt::QueuedConnection, Q_ARG(CANFrame, frame));
     }
 }
 
+//handler's thread. Either flow control never came or the frames have to go out through CANConManager
 void ISOTP_HANDLER::frameTimerTick()
 {
     CANFrame frame;
-    if (!waitingForFlow)
     {
-        if (!sendingFrames.isEmpty())
+        QMutexLocker lock(&txLock);
+        if (txState == TX_WAIT_FLOW)
         {
-            frame = sendingFrames.takeFirst();
-            CANConManager::getInstance()->sendFrame(frame);
-            if (framesUntilFlow > -1) framesUntilFlow--;
-            if (framesUntilFlow == 0) //stop sending and wait for another flow control message
-            {
-                frameTimer.stop(); //we absolutely will not send anything until other side says to.
-                waitingForFlow = true;
-            }
+            //while waiting for a flow frame we didn't get one during timeout period. Try to send anyway with default timeout
+            txState = TX_FALLBACK;
+            txBlockLeft = -1; //don't count frames, just keep sending
+            frameTimer.setInterval(20); //pretty slow sending which should be OK as a default
+            return;
         }
-        else //no more frames to send
+        if (txState != TX_FALLBACK || txNext >= txFrames.count())
         {
             frameTimer.stop();
+            return;
+        }
+        frame = txFrames[txNext++];
+        if (txBlockLeft > 0) txBlockLeft--;
+        if (txNext >= txFrames.count())
+        {
+            txState = TX_IDLE;
+            txFrames.clear();
+            frameTimer.stop();
+        }
+        else if (txBlockLeft == 0)
+        {
+            frameTimer.stop(); //we absolutely will not send anything until other side says to.
+            txState = TX_WAIT_FLOW;
         }
     }
-    else //while waiting for a flow frame we didn't get one during timeout period. Try to send anyway with default timeout
-    {
-        waitingForFlow = false;
-        framesUntilFlow = -1; //don't count frames, just keep sending
-        frameTimer.setInterval(20); //pretty slow sending which should be OK as a default
-    }
+    CANConManager::getInstance()->sendFrame(frame, TX_PROTOCOL); //the other side timed its flow control on these
 }
 
 void ISOTP_HANDLER::setProcessAll(bool state)
 {
     processAll = state;
+    registerTargets();
+}
+
+void ISOTP_HANDLER::setFlowControlID(int bus, uint32_t replyID, uint32_t flowID)
+{
+    QMutexLocker lock(&sessionLock);
+    flowIDs.insert((static_cast<quint64>(static_cast<quint32>(bus) & 0xFFFFFF) << 40) | replyID, flowID);
+}
+
+void ISOTP_HANDLER::clearFlowControlIDs()
+{
+    QMutexLocker lock(&sessionLock);
+    flowIDs.clear();
 }
 
 void ISOTP_HANDLER::addFilter(int pBusId, uint32_t ID, uint32_t mask)
@@ -386,6 +726,7 @@ void ISOTP_HANDLER::addFilter(int pBusId, uint32_t ID, uint32_t mask)
     filt.mask = mask;
 
     filters.append(filt);
+    registerTargets();
 }
 
 void ISOTP_HANDLER::removeFilter(int pBusId, uint32_t ID, uint32_t mask)
@@ -394,11 +735,11 @@ void ISOTP_HANDLER::removeFilter(int pBusId, uint32_t ID, uint32_t mask)
     {
         if (filters[i].bus == pBusId && filters[i].ID == ID && filters[i].mask == mask) filters.removeAt(i);
     }
+    registerTargets();
 }
 
 void ISOTP_HANDLER::clearAllFilters()
 {
     filters.clear();
+    registerTargets();
 }
-
-void setEmitPartials(bool mode);
@@ -3,16 +3,64 @@
 #include <Qt>
 #include <QObject>
 #include <QDebug>
+#include <QMutex>
+#include <QThread>
 #include <QTimer>
+#include <QWaitCondition>
+#include <functional>
 #include "can_structs.h"
+#include "objectarena.h"
 #include "mainwindow.h"
 #include "canframemodel.h"
 #include "isotp_message.h"
 #include "canfilter.h"
+#include "connections/canconnection.h"
 
-class ISOTP_HANDLER : public QObject
+//biggest payload a classic ISO-TP first frame can announce
+#define ISOTP_MAX_PAYLOAD   4095
+//reassemble() splits captures with at least this many frames across threads, smaller ones aren't worth starting them for
+#define ISOTP_PARALLEL_MIN_FRAMES   65536
+
+/*
+ * Reassembly state of one sender, its bus plus its ID (and the address byte with extended addressing). Made the
+ * first time that sender starts a multi-frame message and reused for every message after that, so receiving doesn't
+ * allocate anything per frame.
+ */
+struct ISOTP_SESSION
+{
+    int bus;
+    uint64_t id;
+    bool extended;
+    bool isReceived;
+    QCanBusFrame::TimeStamp started;
+    bool active; //between a first frame and the last consecutive one
+    int expected; //length the first frame announced
+    int received;
+    int nextSeq; //sequence number the next consecutive frame should have
+    uint8_t data[ISOTP_MAX_PAYLOAD];
+};
+
+/*
+ * Incoming frames are taken straight from the connections' reading threads as a targetted frame reactor, so
+ * sessions move along and flow control goes back out the same connection the moment a first frame shows up, however
+ * busy the GUI is. Every finished message is handed to the handler's own thread in one event and comes out of
+ * newISOMessage there. Frames of a loaded capture (updatedFrames with -2) go through the same sessions on the
+ * handler's thread, without sending any flow control. reassemble() does the same for a snapshot on any thread with
+ * sessions of its own, so a big capture neither holds up the reading threads nor fills the event queue. Every session
+ * is within one bus / ID pair, so for a big capture it sorts the frames into their pairs, puts the pairs together on
+ * all the cores at once and merges what they found back into the order a single pass would have found it in.
+ *
+ * Consecutive frames of a message being sent go out as soon as the other side's flow control allows. With a
+ * separation time of 0 a whole block (the whole message if it didn't set a block size) is handed to the connection
+ * in one sendFrames call from the reading thread the flow control came in on, so the connection's batched TX puts it
+ * on the wire at line rate. Any other separation time is kept by a pacer thread that sleeps to just before each
+ * frame and spins the rest, sub-millisecond times included. Only if no flow control comes at all does the old timer
+ * on the handler's thread send the rest slowly.
+ */
+class ISOTP_HANDLER : public QObject, public CANFrameReactor
 {
     Q_OBJECT
+    Q_INTERFACES(CANFrameReactor)
 
 public:
     ISOTP_HANDLER();
@@ -23,34 +71,94 @@ public:
     void sendISOTPFrame(int bus, int ID, QByteArray data);
     void setProcessAll(bool state);
     void setFlowCtrl(bool state);
+    bool isSending(); //a multi-frame message still has frames to go
+    //flow control for first frames from replyID goes to flowID, instead of the last ID anything was sent from
+    void setFlowControlID(int bus, uint32_t replyID, uint32_t flowID);
+    void clearFlowControlIDs();
     void addFilter(int pBusId, uint32_t ID, uint32_t mask);
     void removeFilter(int pBusId, uint32_t ID, uint32_t mask);
     void clearAllFilters();
 
+    /**
+     * @brief reassemble puts a capture's messages together on the calling thread, apart from the live sessions
+     * @param keys - only these frames (see CANFrameStore::keyOf), for a snapshot of a view's source. Empty for all
+     * @param keepGoing - asked every few thousand frames, returning false gives up with what there is so far
+     * @return every message, in the order they finished. keepGoing can be asked from several threads at once
+     */
+    QVector<ISOTP_MESSAGE> reassemble(const CANFrameSnapshot &frames, const QVector<quint32> &keys,
+                                      const std::function<bool()> &keepGoing);
+
+    //connection thread
+    void reactToFrame(const CANFrame &frame) override;
+    void reactToFrameFrom(const CANFrame &frame, CANConnection *pFrom) override;
+
 public slots:
     void updatedFrames(int);
-    void rapidFrames(const CANConnection* conn, const QVector<CANFrame>& pFrames);
     void frameTimerTick();
 
 signals:
     void newISOMessage(ISOTP_MESSAGE msg);
 
+private slots:
+    void registerTargets();
+
 private:
-    QHash<uint32_t, ISOTP_MESSAGE> messageBuffer;
-    QList<CANFrame> sendingFrames;
+    //where processFrame keeps its sessions and the settings it goes by. The live one is under sessionLock,
+    //reassemble() makes its own from a copy of the settings
+    struct Reassembly
+    {
+        QHash<quint64, ISOTP_SESSION *> sessions;
+        ObjectArena<ISOTP_SESSION> arena; //the sessions live here, 4k each and only ever freed all together
+        bool extendedAddressing = false;
+        bool emitPartials = false;
+        QVector<ISOTP_MESSAGE> *collect = nullptr; //finished messages go here instead of out of newISOMessage
+        QVector<int> *collectRows = nullptr; //and the row of the frame that finished each, to merge them by
+        int row = 0; //of the frame being processed
+    };
+
+    QMutex sessionLock; //live and everything the reading threads look at
+    Reassembly live;
+    QHash<quint64, uint32_t> flowIDs; //same keys as sessions
     QList<CANFilter> filters;
-    const QVector<CANFrame> *modelFrames;
-    bool useExtendedAddressing;
+    const CANFrameStore *modelFrames;
     bool isReceiving;
-    bool waitingForFlow;
-    int framesUntilFlow;
     bool processAll;
     bool issueFlowMsgs;
-    bool sendPartialMessages;
     QTimer frameTimer;
     uint32_t lastSenderID;
     uint32_t lastSenderBus;
 
-    void processFrame(const CANFrame &frame);
-    void checkNeedFlush(uint64_t ID);
+    enum TxState
+    {
+        TX_IDLE,
+        TX_WAIT_FLOW, //first frame or a whole block sent, nothing more until flow control says so
+        TX_PACED, //the pacer is sending one frame every txSeparationUs
+        TX_FALLBACK //flow control never came, frameTimer sends the rest
+    };
+    QMutex txLock; //everything tx below, shared by the handler's thread, the reading threads and the pacer
+    QWaitCondition txWake;
+    QThread *txPacer;
+    bool txStopping;
+    TxState txState;
+    QVector<CANFrame> txFrames; //consecutive frames of the message, global bus numbers
+    int txNext;
+    int txBlockLeft; //frames until the next flow control, -1 for no limit
+    quint32 txSeparationUs;
+    quint64 txDueUs;
+    CANConnection *txConn; //where the flow control came from, the paced frames go back out of it
+
+    struct FlowControl
+    {
+        bool seen = false;
+        int type, blockSize, separation;
+    };
+    void processFrame(Reassembly &r, const CANFrame &frame, CANConnection *pFrom, FlowControl *fc = nullptr);
+    void reassembleRows(Reassembly &r, const CANFrameSnapshot &frames, const QVector<int> &rows,
+                        const std::function<bool()> &keepGoing);
+    ISOTP_SESSION *sessionFor(Reassembly &r, const CANFrame &frame, uint64_t ID);
+    void flushSession(Reassembly &r, ISOTP_SESSION *session);
+    void deliver(Reassembly &r, const ISOTP_MESSAGE &msg);
+    void handleFlowControl(int type, int blockSize, int separation, CANConnection *pFrom);
+    void runPacer();
+    void waitForFlow(); //called with txLock held
 };
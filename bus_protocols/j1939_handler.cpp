@@ -1,2 +1,454 @@
 #include "j1939_handler.h"
+#include "mainwindow.h"
+#include "canframemodel.h"
+#include "connections/canconmanager.h"
+#include "pipelinetrace.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+//TP.CM control bytes
+#define TP_CM_RTS       16
+#define TP_CM_CTS       17
+#define TP_CM_EOMA      19
+#define TP_CM_BAM       32
+#define TP_CM_ABORT     255
+
+//J1939-21 timeouts, in microseconds
+#define TP_T1_US        750000  //between data packets
+#define TP_T2_US        1250000 //after a CTS until its first packet
+#define TP_T3_US        1250000 //after the last packet of a window until the next CTS
+#define TP_T4_US        1050000 //after a CTS asking the sender to hold
+
+static inline quint64 steadyUs()
+{
+    return static_cast<quint64>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+J1939_HANDLER::J1939_HANDLER()
+{
+    isReceiving = false;
+    processAll = false;
+    sendPartialMessages = false;
+    localAddress = -1;
+    active = 0;
+
+    modelFrames = MainWindow::getReference()->getCANFrameModel()->getListReference();
+
+    connect(&sweepTimer, &QTimer::timeout, this, &J1939_HANDLER::sweepSessions);
+    sweepTimer.start(100);
+    //targetted frames only reach connections that exist when they're added, so new ones need them again
+    connect(CANConManager::getInstance(), &CANConManager::connectionStatusUpdated, this, &J1939_HANDLER::registerTargets);
+}
+
+J1939_HANDLER::~J1939_HANDLER()
+{
+    sweepTimer.stop();
+    CANConManager::getInstance()->removeAllTargettedFrames(this);
+}
+
+void J1939_HANDLER::setReception(bool mode)
+{
+    if (isReceiving == mode) return;
+    isReceiving = mode;
+    registerTargets();
+    qDebug() << (isReceiving ? "Enabling" : "Disabling") << "reception in J1939 handler";
+}
+
+void J1939_HANDLER::setProcessAll(bool state)
+{
+    {
+        QMutexLocker lock(&sessionLock);
+        processAll = state;
+    }
+    registerTargets();
+}
+
+void J1939_HANDLER::setLocalAddress(int address)
+{
+    QMutexLocker lock(&sessionLock);
+    localAddress = (address >= 0 && address < 0xFE) ? address : -1; //0xFE is the null address, 0xFF global
+}
+
+void J1939_HANDLER::setEmitPartials(bool mode)
+{
+    QMutexLocker lock(&sessionLock);
+    sendPartialMessages = mode;
+}
+
+void J1939_HANDLER::addPGNFilter(int pBusId, int pgn)
+{
+    {
+        QMutexLocker lock(&sessionLock);
+        QVector<int> &buses = pgnFilters[pgn & 0x3FFFF];
+        if (!buses.contains(pBusId)) buses.append(pBusId);
+    }
+    registerTargets();
+}
+
+void J1939_HANDLER::removePGNFilter(int pBusId, int pgn)
+{
+    {
+        QMutexLocker lock(&sessionLock);
+        auto it = pgnFilters.find(pgn & 0x3FFFF);
+        if (it == pgnFilters.end()) return;
+        it.value().removeAll(pBusId);
+        if (it.value().isEmpty()) pgnFilters.erase(it);
+    }
+    registerTargets();
+}
+
+void J1939_HANDLER::clearAllFilters()
+{
+    {
+        QMutexLocker lock(&sessionLock);
+        pgnFilters.clear();
+    }
+    registerTargets();
+}
+
+int J1939_HANDLER::activeSessions()
+{
+    QMutexLocker lock(&sessionLock);
+    return active;
+}
+
+/*
+ * The transport protocol frames of every bus plus the single frame PGNs in the filters. PDU1 PGNs have the
+ * destination in the low byte of the ID so only the data page and PF of those are matched.
+ */
+void J1939_HANDLER::registerTargets()
+{
+    CANConManager *manager = CANConManager::getInstance();
+    manager->removeAllTargettedFrames(this);
+    if (!isReceiving) return;
+
+    QHash<int, QVector<int>> filters;
+    {
+        QMutexLocker lock(&sessionLock);
+        if (processAll)
+        {
+            lock.unlock();
+            manager->addTargettedFrame(-1, 0, 0, this);
+            return;
+        }
+        filters = pgnFilters;
+    }
+    if (filters.isEmpty()) return;
+
+    manager->addTargettedFrame(-1, J1939_PGN_TP_CM << 8, 0x3FF0000, this);
+    manager->addTargettedFrame(-1, J1939_PGN_TP_DT << 8, 0x3FF0000, this);
+    for (auto it = filters.constBegin(); it != filters.constEnd(); ++it)
+    {
+        int pgn = it.key();
+        bool pdu2 = ((pgn >> 8) & 0xFF) > 0xEF;
+        uint32_t id = static_cast<uint32_t>(pdu2 ? pgn : (pgn & 0x3FF00)) << 8;
+        uint32_t mask = pdu2 ? 0x3FFFF00 : 0x3FF0000;
+        for (int bus : it.value()) manager->addTargettedFrame(bus, id, mask, this);
+    }
+}
+
+//called with sessionLock held
+bool J1939_HANDLER::wants(int bus, int pgn) const
+{
+    if (processAll) return true;
+    auto it = pgnFilters.constFind(pgn);
+    if (it == pgnFilters.constEnd()) return false;
+    return it.value().contains(-1) || it.value().contains(bus);
+}
+
+//remember, negative numbers are special -1 = all frames deleted, -2 = totally new set of frames.
+void J1939_HANDLER::updatedFrames(int numFrames)
+{
+    TRACE_SCOPE("J1939_HANDLER::updatedFrames");
+    if (numFrames != -1 && numFrames != -2) return; //new frames were already taken from the connections as they came in
+
+    QMutexLocker lock(&sessionLock);
+    for (J1939_SESSION *session : qAsConst(sessions)) session->active = false;
+    active = 0;
+    if (numFrames == -2)
+    {
+        //loaded frames time out against their own timestamps
+        for (int i = 0; i < modelFrames->length(); i++)
+        {
+            const CANFrame &frame = modelFrames->at(i);
+            processFrame(frame, nullptr, static_cast<quint64>(frame.timeStamp().microSeconds()));
+        }
+    }
+}
+
+void J1939_HANDLER::reactToFrame(const CANFrame &frame)
+{
+    reactToFrameFrom(frame, nullptr);
+}
+
+//connection thread. Only frames that passed one of the targets get here
+void J1939_HANDLER::reactToFrameFrom(const CANFrame &frame, CANConnection *pFrom)
+{
+    QMutexLocker lock(&sessionLock);
+    processFrame(frame, pFrom, steadyUs());
+}
+
+//the handler's own thread gets it in one go, whichever thread finished the message
+void J1939_HANDLER::deliver(const J1939_MESSAGE &msg)
+{
+    QMetaObject::invokeMethod(this, [this, msg]() { emit newJ1939Message(msg); }, Qt::QueuedConnection);
+}
+
+//called with sessionLock held
+void J1939_HANDLER::processFrame(const CANFrame &frame, CANConnection *pFrom, quint64 nowUs)
+{
+    if (!frame.hasExtendedFrameFormat()) return;
+    J1939ID jid = J1939ID::fromFrameId(frame.frameId());
+    const QByteArray payload = frame.payload();
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(payload.constData());
+
+    int group = jid.pgn & 0x3FF00;
+    if (group == J1939_PGN_TP_CM || group == J1939_PGN_TP_DT)
+    {
+        if (payload.length() < 8) return; //transport frames always have all 8 bytes
+        if (group == J1939_PGN_TP_CM) connectionManagement(frame, jid, data, pFrom, nowUs);
+        else dataTransfer(frame, jid, data, nowUs);
+        return;
+    }
+
+    if (!wants(frame.bus, jid.pgn)) return;
+    J1939_MESSAGE msg;
+    msg.bus = frame.bus;
+    msg.setFrameType(QCanBusFrame::DataFrame);
+    msg.setExtendedFrameFormat(true);
+    msg.setFrameId(frame.frameId());
+    msg.isReceived = frame.isReceived;
+    msg.setTimeStamp(frame.timeStamp());
+    msg.setPayload(payload);
+    msg.pgn = jid.pgn;
+    msg.src = jid.src;
+    msg.dest = jid.dest;
+    msg.priority = jid.priority;
+    msg.isBroadcast = jid.isBroadcast;
+    msg.isMultiPacket = false;
+    deliver(msg);
+}
+
+J1939_SESSION *J1939_HANDLER::sessionFor(int bus, int src, int dest, bool create)
+{
+    quint64 key = (static_cast<quint64>(static_cast<quint32>(bus)) << 16) | (static_cast<quint64>(src & 0xFF) << 8) | (dest & 0xFF);
+    if (!create) return sessions.value(key, nullptr);
+    J1939_SESSION *&session = sessions[key];
+    if (!session)
+    {
+        session = sessionArena.create();
+        session->bus = bus;
+        session->src = src & 0xFF;
+        session->dest = dest & 0xFF;
+        session->active = false;
+    }
+    return session;
+}
+
+void J1939_HANDLER::connectionManagement(const CANFrame &frame, const J1939ID &jid, const uint8_t *data, CANConnection *pFrom, quint64 nowUs)
+{
+    int pgn = data[5] | (data[6] << 8) | ((data[7] & 0x03) << 16);
+    J1939_SESSION *session;
+
+    switch (data[0])
+    {
+    case TP_CM_RTS:
+    case TP_CM_BAM:
+    {
+        bool bam = data[0] == TP_CM_BAM;
+        if (bam && jid.dest != 0xFF) return;
+        if (!bam && jid.dest == 0xFF) return; //connection mode has to go to somebody
+        //a new transfer between the same pair replaces whatever was going on
+        session = sessionFor(frame.bus, jid.src, jid.dest, false);
+        if (session) endSession(session, false);
+
+        int size = data[1] | (data[2] << 8);
+        int packets = data[3];
+        if (size < 9 || size > J1939_MAX_PAYLOAD || packets != (size + 6) / 7) return;
+        if (!wants(frame.bus, pgn)) return;
+
+        session = sessionFor(frame.bus, jid.src, jid.dest, true);
+        session->pgn = pgn;
+        session->priority = jid.priority;
+        session->isReceived = frame.isReceived;
+        session->started = frame.timeStamp();
+        session->conn = pFrom;
+        session->size = size;
+        session->packets = packets;
+        session->nextSeq = 1;
+        session->maxPerCts = bam ? 0xFF : data[4];
+        session->lastUs = nowUs;
+        session->answering = !bam && pFrom && localAddress >= 0 && jid.dest == localAddress;
+        session->active = true;
+        active++;
+
+        if (session->answering)
+        {
+            int count = std::min(packets, std::max(1, session->maxPerCts));
+            session->windowEnd = count;
+            session->timeoutUs = TP_T2_US;
+            sendControl(session, TP_CM_CTS, static_cast<uint8_t>(count), 1, 0xFF, 0xFF);
+        }
+        else
+        {
+            //just listening in, the receiver's CTS frames say what comes next
+            session->windowEnd = packets;
+            session->timeoutUs = bam ? TP_T1_US : TP_T3_US;
+        }
+        break;
+    }
+    case TP_CM_CTS: //from the receiver of a transfer back to its sender
+    {
+        session = sessionFor(frame.bus, jid.dest, jid.src, false);
+        if (!session || !session->active || session->answering || session->pgn != pgn) return;
+        int count = data[1];
+        session->lastUs = nowUs;
+        if (count == 0) //hold
+        {
+            session->timeoutUs = TP_T4_US;
+            return;
+        }
+        if (data[2] < 1 || data[2] > session->packets) return;
+        session->nextSeq = data[2]; //can go backwards to have packets sent again
+        session->windowEnd = std::min(session->packets, data[2] + count - 1);
+        session->timeoutUs = TP_T2_US;
+        break;
+    }
+    case TP_CM_EOMA: //all packets were already counted, nothing more to do
+        break;
+    case TP_CM_ABORT: //can come from either side
+        session = sessionFor(frame.bus, jid.src, jid.dest, false);
+        if (session && session->active && session->pgn == pgn) endSession(session, false);
+        session = sessionFor(frame.bus, jid.dest, jid.src, false);
+        if (session && session->active && session->pgn == pgn) endSession(session, false);
+        break;
+    }
+}
+
+void J1939_HANDLER::dataTransfer(const CANFrame &frame, const J1939ID &jid, const uint8_t *data, quint64 nowUs)
+{
+    J1939_SESSION *session = sessionFor(frame.bus, jid.src, jid.dest, false);
+    if (!session || !session->active) return;
+    if (nowUs - session->lastUs > session->timeoutUs)
+    {
+        endSession(session, false);
+        return;
+    }
+
+    int seq = data[0];
+    if (seq < 1 || seq > session->packets) return;
+    if (seq > session->nextSeq)
+    {
+        //lost one. When it's ours to answer the sender can be asked for it again, otherwise the rest can't be trusted
+        if (!session->answering)
+        {
+            qDebug() << "J1939 TP sequence error from" << session->src << "PGN" << QString::number(session->pgn, 16) << "expected" << session->nextSeq << "got" << seq;
+            endSession(session, false);
+            return;
+        }
+        session->lastUs = nowUs;
+        session->timeoutUs = TP_T2_US;
+        sendControl(session, TP_CM_CTS, static_cast<uint8_t>(session->windowEnd - session->nextSeq + 1), static_cast<uint8_t>(session->nextSeq), 0xFF, 0xFF);
+        return;
+    }
+
+    //packets go where their number says, so one that's sent again just writes the same bytes over
+    int offset = (seq - 1) * 7;
+    memcpy(session->data + offset, data + 1, std::min(7, session->size - offset));
+    session->lastUs = nowUs;
+    if (seq < session->nextSeq) return;
+    session->nextSeq++;
+
+    if (session->nextSeq > session->packets)
+    {
+        if (session->answering) sendControl(session, TP_CM_EOMA, session->size & 0xFF, session->size >> 8, static_cast<uint8_t>(session->packets), 0xFF);
+        endSession(session, true);
+    }
+    else if (session->nextSeq > session->windowEnd)
+    {
+        session->timeoutUs = TP_T3_US;
+        if (session->answering)
+        {
+            int count = std::min(session->packets - session->nextSeq + 1, std::max(1, session->maxPerCts));
+            session->windowEnd = session->nextSeq + count - 1;
+            session->timeoutUs = TP_T2_US;
+            sendControl(session, TP_CM_CTS, static_cast<uint8_t>(count), static_cast<uint8_t>(session->nextSeq), 0xFF, 0xFF);
+        }
+    }
+    else session->timeoutUs = TP_T1_US;
+}
+
+//the whole transfer, or what there is of it if partials are wanted. Called with sessionLock held
+void J1939_HANDLER::endSession(J1939_SESSION *session, bool complete)
+{
+    if (!session->active) return;
+    session->active = false;
+    active--;
+
+    int len = complete ? session->size : std::min(session->size, (session->nextSeq - 1) * 7);
+    if (!complete && (!sendPartialMessages || len == 0)) return;
+
+    J1939_MESSAGE msg;
+    msg.bus = session->bus;
+    msg.setFrameType(QCanBusFrame::DataFrame);
+    msg.setExtendedFrameFormat(true);
+    bool pdu2 = ((session->pgn >> 8) & 0xFF) > 0xEF;
+    uint32_t id = (static_cast<uint32_t>(session->priority) << 26) | (static_cast<uint32_t>(session->pgn) << 8) | static_cast<uint32_t>(session->src);
+    if (!pdu2) id |= static_cast<uint32_t>(session->dest) << 8;
+    msg.setFrameId(id);
+    msg.isReceived = session->isReceived;
+    msg.setTimeStamp(session->started);
+    msg.setPayload(QByteArray(reinterpret_cast<const char *>(session->data), len));
+    msg.pgn = session->pgn;
+    msg.src = session->src;
+    msg.dest = session->dest;
+    msg.priority = session->priority;
+    msg.isBroadcast = session->dest == 0xFF;
+    msg.isMultiPacket = true;
+    deliver(msg);
+}
+
+/*
+ * TP.CM from our address back to the sender of the session, out of the connection its RTS came in on. Called with
+ * sessionLock held, from that connection's reading thread unless queued.
+ */
+void J1939_HANDLER::sendControl(J1939_SESSION *session, uint8_t control, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, bool queued)
+{
+    CANFrame out;
+    out.bus = session->bus - session->conn->getBusBase();
+    out.isReceived = false;
+    out.setFrameType(QCanBusFrame::DataFrame);
+    out.setExtendedFrameFormat(true);
+    out.setFrameId((7u << 26) | (static_cast<uint32_t>(J1939_PGN_TP_CM) << 8) | (static_cast<uint32_t>(session->src) << 8) | static_cast<uint32_t>(localAddress));
+    QByteArray bytes(8, 0);
+    bytes[0] = static_cast<char>(control);
+    bytes[1] = static_cast<char>(b1);
+    bytes[2] = static_cast<char>(b2);
+    bytes[3] = static_cast<char>(b3);
+    bytes[4] = static_cast<char>(b4);
+    bytes[5] = static_cast<char>(session->pgn & 0xFF);
+    bytes[6] = static_cast<char>((session->pgn >> 8) & 0xFF);
+    bytes[7] = static_cast<char>((session->pgn >> 16) & 0xFF);
+    out.setPayload(bytes);
+    if (queued) QMetaObject::invokeMethod(session->conn, "sendFrame", Qt::QueuedConnection, Q_ARG(CANFrame, out));
+    else session->conn->sendFrame(out);
+}
+
+//handler's thread. Live transfers that went quiet, loaded ones time out as their frames are gone through
+void J1939_HANDLER::sweepSessions()
+{
+    QMutexLocker lock(&sessionLock);
+    if (active == 0) return;
+    quint64 now = steadyUs();
+    for (J1939_SESSION *session : qAsConst(sessions))
+    {
+        if (!session->active || !session->conn || now - session->lastUs <= session->timeoutUs) continue;
+        qDebug() << "J1939 TP timed out from" << session->src << "to" << session->dest << "PGN" << QString::number(session->pgn, 16);
+        //abort, reason 3 is a timeout. Not on a reading thread here so it's posted to the connection
+        if (session->answering) sendControl(session, TP_CM_ABORT, 3, 0xFF, 0xFF, 0xFF, true);
+        endSession(session, false);
+    }
+}
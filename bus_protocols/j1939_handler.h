@@ -4,7 +4,19 @@
 #include <Qt>
 #include <QObject>
 #include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
 #include "can_structs.h"
+#include "objectarena.h"
+#include "j1939_message.h"
+#include "canidparts.h"
+#include "connections/canconnection.h"
+
+//transport protocol connection management and data transfer PGNs
+#define J1939_PGN_TP_CM     0xEC00
+#define J1939_PGN_TP_DT     0xEB00
+#define J1939_MAX_PAYLOAD   1785 //255 packets of 7 bytes
 
 struct J1939ID
 {
@@ -16,6 +28,112 @@ public:
     int ps;
     int priority;
     bool isBroadcast;
+
+    //pulls the fields out of a 29 bit ID. PDU1 PGNs have the destination where PDU2 ones keep their group extension
+    static J1939ID fromFrameId(uint32_t id)
+    {
+        J1939ID jid;
+        jid.src = CANIdParts::j1939Source(id);
+        jid.priority = CANIdParts::priority(id);
+        jid.pf = (id >> 16) & 0xFF;
+        jid.ps = (id >> 8) & 0xFF;
+        jid.isBroadcast = CANIdParts::isJ1939Broadcast(id);
+        jid.pgn = CANIdParts::j1939Pgn(id);
+        jid.dest = CANIdParts::j1939Dest(id);
+        return jid;
+    }
+};
+
+/*
+ * One transport protocol transfer in progress. A source can only have one going to each destination (0xFF being
+ * the BAM one) so that's what sessions are found by, the data transfer frames don't say which PGN they belong to.
+ * Made the first time a pair talks and reused after that, the same as ISO-TP sessions.
+ */
+struct J1939_SESSION
+{
+    int bus;
+    int src;
+    int dest;
+    int pgn; //what the RTS or BAM announced
+    int priority;
+    bool active;
+    bool isReceived;
+    bool answering; //an RTS to our own address, CTS and EoMA go back from here
+    CANConnection *conn; //where to answer through
+    QCanBusFrame::TimeStamp started;
+    int size; //bytes announced
+    int packets; //packets announced
+    int nextSeq; //next data transfer packet expected, from 1
+    int windowEnd; //last packet the current CTS allows, packets for BAM
+    int maxPerCts; //what the sender asked for in its RTS, 0xFF for no limit
+    quint64 lastUs; //newest frame of the transfer, in the clock of the frames it's made from
+    quint64 timeoutUs; //allowed after lastUs before the transfer is given up on
+    uint8_t data[J1939_MAX_PAYLOAD];
+};
+
+/*
+ * Puts J1939 parameter groups back together, broadcast (BAM) and connection mode (RTS/CTS) alike, and hands them
+ * out through newJ1939Message along with every single frame PGN that was asked for. Consumers say which PGNs they
+ * want with addPGNFilter (or setProcessAll), and transfers of any other PGN are never even reassembled.
+ *
+ * Like ISOTP_HANDLER it's a targetted frame reactor, so frames are taken on the connections' reading threads and
+ * every session of every source and destination on the bus moves along as its frames arrive. CTS and EoMA for
+ * transfers to our own address (setLocalAddress) go straight back out the connection the RTS came from. Timeouts
+ * follow J1939-21: T1 between data packets, T2 after a CTS, T3 waiting on the next CTS. The transfers nobody sends
+ * another frame for are swept up by a timer on the handler's thread.
+ */
+class J1939_HANDLER : public QObject, public CANFrameReactor
+{
+    Q_OBJECT
+    Q_INTERFACES(CANFrameReactor)
+
+public:
+    J1939_HANDLER();
+    ~J1939_HANDLER();
+    void setReception(bool mode);
+    void setProcessAll(bool state); //every PGN, not just the filtered ones
+    void setLocalAddress(int address); //-1 to only listen
+    void setEmitPartials(bool mode); //hand out what there is of a transfer that was aborted or timed out
+    void addPGNFilter(int pBusId, int pgn);
+    void removePGNFilter(int pBusId, int pgn);
+    void clearAllFilters();
+    int activeSessions();
+
+    //connection thread
+    void reactToFrame(const CANFrame &frame) override;
+    void reactToFrameFrom(const CANFrame &frame, CANConnection *pFrom) override;
+
+public slots:
+    void updatedFrames(int);
+
+signals:
+    void newJ1939Message(J1939_MESSAGE msg);
+
+private slots:
+    void registerTargets();
+    void sweepSessions();
+
+private:
+    QMutex sessionLock; //everything below, shared by the reading threads and the handler's thread
+    QHash<quint64, J1939_SESSION *> sessions;
+    ObjectArena<J1939_SESSION> sessionArena;
+    QHash<int, QVector<int>> pgnFilters; //PGN -> buses that want it, -1 for any
+    const CANFrameStore *modelFrames;
+    bool isReceiving;
+    bool processAll;
+    bool sendPartialMessages;
+    int localAddress;
+    int active; //sessions with active set, so the sweep has nothing to do most of the time
+    QTimer sweepTimer;
+
+    bool wants(int bus, int pgn) const;
+    void processFrame(const CANFrame &frame, CANConnection *pFrom, quint64 nowUs);
+    void connectionManagement(const CANFrame &frame, const J1939ID &jid, const uint8_t *data, CANConnection *pFrom, quint64 nowUs);
+    void dataTransfer(const CANFrame &frame, const J1939ID &jid, const uint8_t *data, quint64 nowUs);
+    J1939_SESSION *sessionFor(int bus, int src, int dest, bool create);
+    void endSession(J1939_SESSION *session, bool complete);
+    void sendControl(J1939_SESSION *session, uint8_t control, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, bool queued = false);
+    void deliver(const J1939_MESSAGE &msg);
 };
 
 #endif // J1939_HANDLER_H
@@ -0,0 +1,20 @@
+#ifndef J1939_MESSAGE_H
+#define J1939_MESSAGE_H
+
+#include <Qt>
+#include <can_structs.h>
+
+//Like ISOTP_MESSAGE, a CANFrame plus what J1939 says about it. The payload is the whole parameter group, put back
+//together if it came over the transport protocol. The frame ID is what the PGN would have had as a single frame.
+class J1939_MESSAGE : public CANFrame
+{
+public:
+    int pgn;
+    int src;
+    int dest; //0xFF for broadcast
+    int priority;
+    bool isBroadcast;
+    bool isMultiPacket; //came in over BAM or RTS/CTS
+};
+
+#endif // J1939_MESSAGE_H
@@ -4,14 +4,16 @@
 #include "isotp_handler.h"
 #include <QDebug>
 
-static QVector<CODE_STRUCT> UDS_DIAG_CTRL_SUB = {
+#include <algorithm>
+
+static constexpr CODE_STRUCT UDS_DIAG_CTRL_SUB_CODES[] = {
     {1,"DFLT_SESS", "Default session"},
     {2,"PROG_SESS", "Programming Session"},
     {3,"EXT_SESS", "Extended Diagnostics Session"},
     {4,"SAFETY_SESS", "Safety System Diagnostics Session"},
 };
 
-static QVector<CODE_STRUCT> UDS_ECU_RESET_SUB = {
+static constexpr CODE_STRUCT UDS_ECU_RESET_SUB_CODES[] = {
     {1,"HARD_RESET", "Hard reset of ECU"},
     {2,"KEYOFFON_RESET", "Simulated key off then on reset"},
     {3,"SOFT_RESET", "Soft reset - leaving RAM intact"},
@@ -19,7 +21,7 @@ static QVector<CODE_STRUCT> UDS_ECU_RESET_SUB = {
     {5,"DIS_POWERDOWN_RESET", "Disable sleep mode"},
 };
 
-static QVector<CODE_STRUCT> UDS_COMM_CTRL_SUB = {
+static constexpr CODE_STRUCT UDS_COMM_CTRL_SUB_CODES[] = {
     {0,"COMM_NORMAL", "Enable both Rx and Tx of normal messages"},
     {1,"COMM_DIS_TX", "Enable reception of normal messages but don't Tx them"},
     {3,"COMM_DIS_ALL", "Disable both Rx and Tx of non-diagnostics messages"},
@@ -27,13 +29,13 @@ static QVector<CODE_STRUCT> UDS_COMM_CTRL_SUB = {
     {5,"COMM_ENHANC", "Addressed bus master should set related sub-bus to app scheduling mode"},
 };
 
-static QVector<CODE_STRUCT> UDS_ROUTINE_SUB = {
+static constexpr CODE_STRUCT UDS_ROUTINE_SUB_CODES[] = {
     {1,"START_ROUTINE", "Start routine by given ID"},
     {2,"STOP_ROUTINE", "Stop routine by given ID"},
     {3,"GET_ROUTINE_RESULTS", "Get results from routine specified by ID"},
 };
 
-static QVector<CODE_STRUCT> UDS_FILE_MODEOFOP = {
+static constexpr CODE_STRUCT UDS_FILE_MODEOFOP_CODES[] = {
     {1, "ADDFILE", "Add file to file system"},
     {2, "DELETEFILE", "Add file to file system"},
     {3, "REPLACEFILE", "Add file to file system"},
@@ -41,7 +43,7 @@ static QVector<CODE_STRUCT> UDS_FILE_MODEOFOP = {
     {5, "READDIR", "Add file to file system"}
 };
 
-static QVector<CODE_STRUCT> UDS_SERVICE_DESC = {
+static constexpr CODE_STRUCT UDS_SERVICE_DESC_CODES[] = {
     {1, "OBDII_SHOW_CURRENT", "OBDII - Show current data"},
     {2, "OBDII_SHOW_FREEZE", "OBDII - Show freeze data"},
     {3, "OBDII_SHOW_STORED_DTC", "OBDII - Show stored DTC codes"},
@@ -93,8 +95,7 @@ static QVector<CODE_STRUCT> UDS_SERVICE_DESC = {
     {0xFF, "UNKNOWN_CODE", "Unknown, likely proprietary UDS function code"}
 };
 
-static QVector<CODE_STRUCT> UDS_NEG_RESPONSE =
-{
+static constexpr CODE_STRUCT UDS_NEG_RESPONSE_CODES[] = {
     {0x10, "GENERAL_REJECT", "General rejection (no other codes matched)"},
     {0x11, "SERVICE_NOTSUPP", "ECU does not support this service code"},
     {0x12, "SUBFUNCT_NOTSUPP", "ECU does not support the requested sub function"},
@@ -161,6 +162,84 @@ static QVector<CODE_STRUCT> UDS_NEG_RESPONSE =
     {0x93, "VOLTAGE_LOW", "Cannot execute request until voltage is higher"},
 };
 
+static constexpr CODE_STRUCT UDS_IDENT_DID[] = {
+    {0xF180, "BOOT_SW_ID", "Boot software identification"},
+    {0xF181, "APP_SW_ID", "Application software identification"},
+    {0xF182, "APP_DATA_ID", "Application data identification"},
+    {0xF183, "BOOT_SW_FINGERPRINT", "Boot software fingerprint"},
+    {0xF184, "APP_SW_FINGERPRINT", "Application software fingerprint"},
+    {0xF185, "APP_DATA_FINGERPRINT", "Application data fingerprint"},
+    {0xF186, "ACTIVE_DIAG_SESS", "Active diagnostic session"},
+    {0xF187, "SPARE_PART_NUM", "Vehicle manufacturer spare part number"},
+    {0xF188, "ECU_SW_NUM", "Vehicle manufacturer ECU software number"},
+    {0xF189, "ECU_SW_VERSION", "Vehicle manufacturer ECU software version number"},
+    {0xF18A, "SUPPLIER_ID", "System supplier identifier"},
+    {0xF18B, "ECU_MANUF_DATE", "ECU manufacturing date"},
+    {0xF18C, "ECU_SERIAL", "ECU serial number"},
+    {0xF18D, "SUPP_FUNC_UNITS", "Supported functional units"},
+    {0xF18E, "KIT_PART_NUM", "Vehicle manufacturer kit assembly part number"},
+    {0xF190, "VIN", "Vehicle identification number"},
+    {0xF191, "ECU_HW_NUM", "Vehicle manufacturer ECU hardware number"},
+    {0xF192, "SUPPLIER_HW_NUM", "System supplier ECU hardware number"},
+    {0xF193, "SUPPLIER_HW_VERSION", "System supplier ECU hardware version number"},
+    {0xF194, "SUPPLIER_SW_NUM", "System supplier ECU software number"},
+    {0xF195, "SUPPLIER_SW_VERSION", "System supplier ECU software version number"},
+    {0xF196, "TYPE_APPROVAL_NUM", "Exhaust regulation or type approval number"},
+    {0xF197, "SYSTEM_NAME", "System name or engine type"},
+    {0xF198, "TESTER_SERIAL", "Repair shop code or tester serial number"},
+    {0xF199, "PROG_DATE", "Programming date"},
+    {0xF19A, "CALIB_TESTER_SERIAL", "Calibration repair shop code or equipment serial number"},
+    {0xF19B, "CALIB_DATE", "Calibration date"},
+    {0xF19C, "CALIB_EQUIP_SW_NUM", "Calibration equipment software number"},
+    {0xF19D, "ECU_INSTALL_DATE", "ECU installation date"},
+    {0xF19E, "ODX_FILE", "ODX file"},
+    {0xF19F, "ENTITY", "Entity"},
+};
+
+/*
+ * A code table found in one step: codes from base up to base + 255 index straight into it. The QStrings are made
+ * once, the first time each table is needed, and every lookup after that hands out a shared copy, so decoding a
+ * message doesn't build any strings just to name its codes.
+ */
+class UDSCodeTable
+{
+public:
+    template <size_t N>
+    explicit UDSCodeTable(const CODE_STRUCT (&pCodes)[N], int pBase = 0)
+    {
+        base = pBase;
+        std::fill(index, index + 256, static_cast<qint16>(-1));
+        for (size_t i = 0; i < N; i++)
+        {
+            int slot = pCodes[i].code - base;
+            if (slot < 0 || slot > 255) continue;
+            index[slot] = static_cast<qint16>(shortDescs.count());
+            shortDescs.append(QString::fromLatin1(pCodes[i].shortDesc));
+            longDescs.append(QString::fromLatin1(pCodes[i].longDesc));
+        }
+    }
+    bool contains(int code) const { return find(code) >= 0; }
+    QString shortDesc(int code) const { int i = find(code); return i < 0 ? QString() : shortDescs[i]; }
+    QString longDesc(int code) const { int i = find(code); return i < 0 ? QString() : longDescs[i]; }
+
+private:
+    int find(int code) const { code -= base; return (code < 0 || code > 255) ? -1 : index[code]; }
+
+    int base;
+    qint16 index[256];
+    QVector<QString> shortDescs;
+    QVector<QString> longDescs;
+};
+
+//made on first use, function statics are safe to start from any thread
+static const UDSCodeTable &diagCtrlSubTable() { static const UDSCodeTable table(UDS_DIAG_CTRL_SUB_CODES); return table; }
+static const UDSCodeTable &ecuResetSubTable() { static const UDSCodeTable table(UDS_ECU_RESET_SUB_CODES); return table; }
+static const UDSCodeTable &commCtrlSubTable() { static const UDSCodeTable table(UDS_COMM_CTRL_SUB_CODES); return table; }
+static const UDSCodeTable &routineSubTable() { static const UDSCodeTable table(UDS_ROUTINE_SUB_CODES); return table; }
+static const UDSCodeTable &serviceTable() { static const UDSCodeTable table(UDS_SERVICE_DESC_CODES); return table; }
+static const UDSCodeTable &negResponseTable() { static const UDSCodeTable table(UDS_NEG_RESPONSE_CODES); return table; }
+static const UDSCodeTable &identDIDTable() { static const UDSCodeTable table(UDS_IDENT_DID, 0xF100); return table; }
+
 UDS_MESSAGE::UDS_MESSAGE()
 {
     subFunc = 0;
@@ -230,6 +309,16 @@ void UDS_HANDLER::setFlowCtrl(bool state)
     isoHandler->setFlowCtrl(state);
 }
 
+void UDS_HANDLER::setFlowControlID(int bus, uint32_t replyID, uint32_t requestID)
+{
+    isoHandler->setFlowControlID(bus, replyID, requestID);
+}
+
+void UDS_HANDLER::clearFlowControlIDs()
+{
+    isoHandler->clearFlowControlIDs();
+}
+
 void UDS_HANDLER::setReception(bool mode)
 {
     if (isReceiving == mode) return;
@@ -271,54 +360,36 @@ void UDS_HANDLER::sendUDSFrame(const UDS_MESSAGE &msg)
     qDebug() << "Sent UDS service: " << getServiceShortDesc(msg.service) << " on bus " << msg.bus;
 }
 
-QString UDS_HANDLER::getShortDesc(QVector<CODE_STRUCT> &codeVector, int code)
+QString UDS_HANDLER::getServiceShortDesc(int service)
 {
-    foreach (CODE_STRUCT codeRec, codeVector)
-    {
-        if (codeRec.code == code) return codeRec.shortDesc;
-    }
-    return QString();
+    const UDSCodeTable &table = serviceTable();
+    return table.contains(service) ? table.shortDesc(service) : table.shortDesc(service + 0x40);
 }
 
-QString UDS_HANDLER::getLongDesc(QVector<CODE_STRUCT> &codeVector, int code)
+QString UDS_HANDLER::getServiceLongDesc(int service)
 {
-    foreach (CODE_STRUCT codeRec, codeVector)
-    {
-        if (codeRec.code == code) return codeRec.longDesc;
-    }
-    return QString();
+    const UDSCodeTable &table = serviceTable();
+    return table.contains(service) ? table.longDesc(service) : table.longDesc(service + 0x40);
 }
 
-QString UDS_HANDLER::getServiceShortDesc(int service)
+QString UDS_HANDLER::getNegativeResponseShort(int respCode)
 {
-    QString ret;
-    ret = getShortDesc(UDS_SERVICE_DESC, service);
-    if (ret.length() == 0)
-        ret = getShortDesc(UDS_SERVICE_DESC, service + 0x40);
-    return ret;
+    return negResponseTable().shortDesc(respCode);
 }
 
-QString UDS_HANDLER::getServiceLongDesc(int service)
+QString UDS_HANDLER::getNegativeResponseLong(int respCode)
 {
-    QString ret;
-    ret = getLongDesc(UDS_SERVICE_DESC, service);
-    if (ret.length() == 0)
-        ret = getLongDesc(UDS_SERVICE_DESC, service + 0x40);
-    return ret;
+    return negResponseTable().longDesc(respCode);
 }
 
-QString UDS_HANDLER::getNegativeResponseShort(int respCode)
+QString UDS_HANDLER::getDIDShortDesc(int did)
 {
-    QString ret;
-    ret = getShortDesc(UDS_NEG_RESPONSE, respCode);
-    return ret;
+    return identDIDTable().shortDesc(did);
 }
 
-QString UDS_HANDLER::getNegativeResponseLong(int respCode)
+QString UDS_HANDLER::getDIDLongDesc(int did)
 {
-    QString ret;
-    ret = getLongDesc(UDS_NEG_RESPONSE, respCode);
-    return ret;
+    return identDIDTable().longDesc(did);
 }
 
 /*
@@ -334,6 +405,7 @@ QString UDS_HANDLER::getNegativeResponseLong(int respCode)
 QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
 {
     QString buildString;
+    buildString.reserve(256);
     int dataSize;
     int addrSize;
     int compType, encType;
@@ -358,7 +430,7 @@ QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
     if (msg.isErrorReply)
     {
         //Negative responses replace the sub function with an error code instead
-        buildString.append("Negative response: " + getLongDesc(UDS_NEG_RESPONSE, msg.subFunc) + "\n");
+        buildString.append("Negative response: " + negResponseTable().longDesc(msg.subFunc) + "\n");
     }
     else
     {
@@ -366,10 +438,10 @@ QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
         {
         case UDS_SERVICES::DIAG_CONTROL:
             //diag control requests have one parameter - which type of session we want.
-            buildString.append("Session Request: " + getLongDesc(UDS_DIAG_CTRL_SUB, msg.subFunc));
+            buildString.append("Session Request: " + diagCtrlSubTable().longDesc(msg.subFunc));
             break;
         case UDS_SERVICES::DIAG_CONTROL + 0x40: //positive response
-            buildString.append("Session Request: " + getLongDesc(UDS_DIAG_CTRL_SUB, msg.subFunc));
+            buildString.append("Session Request: " + diagCtrlSubTable().longDesc(msg.subFunc));
             //there should be four extra bytes now
             if (dataLen < 5) //5 because subfunc codes are left in data so it starts with one subfunc byte
             {
@@ -385,10 +457,10 @@ QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
             break;
         case UDS_SERVICES::ECU_RESET:
             //ECU reset has one parameter - which reset type to ask for
-            buildString.append("Reset Type: " + getLongDesc(UDS_ECU_RESET_SUB, msg.subFunc));
+            buildString.append("Reset Type: " + ecuResetSubTable().longDesc(msg.subFunc));
             break;
         case UDS_SERVICES::ECU_RESET + 0x40:
-            buildString.append("Reset Type: " + getLongDesc(UDS_ECU_RESET_SUB, msg.subFunc));
+            buildString.append("Reset Type: " + ecuResetSubTable().longDesc(msg.subFunc));
             //There should be one additional byte which encodes power down time
             if (dataLen > 1)
             {
@@ -402,7 +474,7 @@ QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
             break;
         case UDS_SERVICES::COMM_CTRL:
             //Comm control has potentially a lot of parameters. control type, comm type, nodeID
-            buildString.append("Control type: " + getLongDesc(UDS_COMM_CTRL_SUB, msg.subFunc));
+            buildString.append("Control type: " + commCtrlSubTable().longDesc(msg.subFunc));
             if (dataLen > 1)
                 buildString.append("\nComm Type: " + QString::number(data[1])); //TODO: no attempt to interpret yet
             if (dataLen > 3)
@@ -456,6 +528,7 @@ QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
                 {
                     id = (data[i] * 256) + data[i+1];
                     buildString.append("\nID to read: " + Utility::formatHexNum(id));
+                    if (identDIDTable().contains(id)) buildString.append(" (" + identDIDTable().longDesc(id) + ")");
                 }
             }
             break;
@@ -508,7 +581,7 @@ QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
             }
             break;
         case UDS_SERVICES::ROUTINE_CTRL:
-            buildString.append("Routine Control: " + getLongDesc(UDS_ROUTINE_SUB, msg.subFunc));
+            buildString.append("Routine Control: " + routineSubTable().longDesc(msg.subFunc));
             if (dataLen > 3)
             {
                 int routineID;
@@ -525,7 +598,7 @@ QString UDS_HANDLER::getDetailedMessageAnalysis(const UDS_MESSAGE &msg)
             }
             break;
         case UDS_SERVICES::ROUTINE_CTRL + 0x40:
-            buildString.append("Routine Control: " + getLongDesc(UDS_ROUTINE_SUB, msg.subFunc));
+            buildString.append("Routine Control: " + routineSubTable().longDesc(msg.subFunc));
             if (dataLen > 2)
             {
                 int routineID;
@@ -5,6 +5,7 @@
 #include <QObject>
 #include <QDebug>
 #include "can_structs.h"
+#include "canframestore.h"
 #include "isotp_message.h"
 
 class ISOTP_HANDLER;
@@ -63,11 +64,12 @@ namespace UDS_SERVICES
     };
 }
 
+//one entry of the code tables in uds_handler.cpp. Plain strings so the tables are built at compile time
 struct CODE_STRUCT
 {
     int code;
-    QString shortDesc;
-    QString longDesc;
+    const char *shortDesc;
+    const char *longDesc;
 };
 
 class UDS_MESSAGE: public ISOTP_MESSAGE
@@ -94,16 +96,19 @@ public:
     void sendUDSFrame(const UDS_MESSAGE &msg);
     void setProcessAllIDs(bool state);
     void setFlowCtrl(bool state);
+    void setFlowControlID(int bus, uint32_t replyID, uint32_t requestID); //see ISOTP_HANDLER::setFlowControlID
+    void clearFlowControlIDs();
     void addFilter(uint32_t pBusId, uint32_t ID, uint32_t mask);
     void removeFilter(uint32_t pBusId, uint32_t ID, uint32_t mask);
     void clearAllFilters();
 
-    QString getServiceShortDesc(int service);
-    QString getServiceLongDesc(int service);
-    QString getNegativeResponseShort(int respCode);
-    QString getNegativeResponseLong(int respCode);
-    QString getShortDesc(QVector<CODE_STRUCT> &codeVector, int code);
-    QString getLongDesc(QVector<CODE_STRUCT> &codeVector, int code);
+    //table lookups, empty if the code isn't known. Cheap enough to call for every message
+    static QString getServiceShortDesc(int service);
+    static QString getServiceLongDesc(int service);
+    static QString getNegativeResponseShort(int respCode);
+    static QString getNegativeResponseLong(int respCode);
+    static QString getDIDShortDesc(int did); //the standard identification DIDs, 0xF180 - 0xF19F
+    static QString getDIDLongDesc(int did);
     QString getDetailedMessageAnalysis(const UDS_MESSAGE &msg);
 
 public slots:
@@ -114,7 +119,7 @@ signals:
 
 private:
     QList<ISOTP_MESSAGE> messageBuffer;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     bool isReceiving;
     bool useExtendedAddressing;
 
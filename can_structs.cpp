@@ -1,2 +1,54 @@
 #include "can_structs.h"
 
+#include <cstring>
+
+void CANFrameRecord::setFrom(const CANFrame &frame)
+{
+    //the rest of the program keeps everything in the microseconds field but frames that came straight from
+    //QtSerialBus can have seconds filled in too so fold both in.
+    timestamp = static_cast<uint64_t>(frame.timeStamp().seconds() * 1000000 + frame.timeStamp().microSeconds());
+    frameType = static_cast<uint8_t>(frame.frameType());
+    if (frame.frameType() == QCanBusFrame::ErrorFrame)
+        idFlags = static_cast<uint32_t>(frame.error()) & ID_MASK;
+    else
+        idFlags = frame.frameId() & ID_MASK;
+    if (frame.hasExtendedFrameFormat()) idFlags |= EXTENDED_BIT;
+    bus = static_cast<uint8_t>(frame.bus);
+
+    flags = 0;
+    if (frame.isReceived) flags |= FLAG_RECEIVED;
+    if (frame.hasFlexibleDataRateFormat()) flags |= FLAG_FD;
+    if (frame.hasBitrateSwitch()) flags |= FLAG_BRS;
+    if (frame.hasErrorStateIndicator()) flags |= FLAG_ESI;
+    if (frame.hasLocalEcho()) flags |= FLAG_LOCAL_ECHO;
+
+    const QByteArray &payload = frame.payload();
+    int payloadLen = payload.length();
+    if (payloadLen > MAX_BYTES) payloadLen = MAX_BYTES;
+    len = static_cast<uint8_t>(payloadLen);
+
+    memset(data, 0, INLINE_BYTES);
+    if (payloadLen <= INLINE_BYTES) memcpy(data, payload.constData(), payloadLen);
+}
+
+void CANFrameRecord::toFrame(CANFrame &frame, const uint8_t *payload) const
+{
+    frame.setFrameType(type());
+    if (type() == QCanBusFrame::ErrorFrame)
+    {
+        frame.setError(QCanBusFrame::FrameErrors(QFlag(static_cast<int>(idFlags & ID_MASK))));
+    }
+    else frame.setFrameId(frameId());
+    //setFrameId turns on extended format by itself for big IDs so set the flag afterward
+    frame.setExtendedFrameFormat(isExtended());
+    frame.setFlexibleDataRateFormat(flags & FLAG_FD);
+    frame.setBitrateSwitch(flags & FLAG_BRS);
+    frame.setErrorStateIndicator(flags & FLAG_ESI);
+    frame.setLocalEcho(flags & FLAG_LOCAL_ECHO);
+    frame.setPayload(QByteArray(reinterpret_cast<const char *>(payload), len));
+    frame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(timestamp)));
+    frame.bus = bus;
+    frame.isReceived = isReceived();
+    frame.timedelta = 0;
+    frame.frameCount = 1;
+}
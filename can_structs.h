@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QVector>
 #include <stdint.h>
+#include <type_traits>
 #include <QCanBusFrame>
 
 //Now inherits from the built-in CAN frame class from Qt. This should be more future proof and easier to integrate with other code
@@ -35,6 +36,57 @@ public:
     }
 };
 
+/*
+ * Packed, trivially copyable version of a frame used for bulk storage. CANFrame drags along an implicitly shared
+ * QByteArray for the payload plus the overwrite mode bookkeeping so keeping ten million of them around costs
+ * gigabytes and every copy bangs on a refcount. This is 24 bytes flat, never allocates and can be memcpy'd.
+ * Payloads up to 8 bytes live inline. Longer (CAN-FD) payloads don't fit so whatever container holds the record
+ * stores them elsewhere and keeps the slot number in fdSlot instead. Convert back to CANFrame only at the edges.
+ */
+struct CANFrameRecord
+{
+    enum Flags : uint8_t
+    {
+        FLAG_RECEIVED   = 0x01,
+        FLAG_FD         = 0x02,
+        FLAG_BRS        = 0x04,
+        FLAG_ESI        = 0x08,
+        FLAG_LOCAL_ECHO = 0x10
+    };
+
+    static const uint32_t ID_MASK      = 0x1FFFFFFFu;
+    static const uint32_t EXTENDED_BIT = 0x80000000u;
+    static const int      INLINE_BYTES = 8;
+    static const int      MAX_BYTES    = 64;
+
+    uint64_t timestamp;     //microseconds
+    uint32_t idFlags;       //29 bit ID (error bits for error frames) in the low bits, extended flag in bit 31
+    uint8_t  bus;
+    uint8_t  len;           //payload length in bytes, 0 - 64
+    uint8_t  frameType;     //QCanBusFrame::FrameType
+    uint8_t  flags;         //see Flags above
+    union
+    {
+        uint8_t  data[INLINE_BYTES];
+        uint32_t fdSlot;    //only valid when len > INLINE_BYTES
+    };
+
+    inline uint32_t frameId() const { return idFlags & ID_MASK; }
+    inline bool isExtended() const { return (idFlags & EXTENDED_BIT) != 0; }
+    inline bool isReceived() const { return (flags & FLAG_RECEIVED) != 0; }
+    inline bool isInline() const { return len <= INLINE_BYTES; }
+    inline QCanBusFrame::FrameType type() const { return static_cast<QCanBusFrame::FrameType>(frameType); }
+
+    //Fill in the header and up to INLINE_BYTES of payload. Caller deals with FD payloads that don't fit
+    void setFrom(const CANFrame &frame);
+    //Build a full frame. payload must point at len bytes (data for inline records, the FD slot otherwise)
+    void toFrame(CANFrame &frame, const uint8_t *payload) const;
+};
+
+static_assert(sizeof(CANFrameRecord) == 24, "CANFrameRecord should stay packed into 24 bytes");
+static_assert(std::is_trivially_copyable<CANFrameRecord>::value, "CANFrameRecord must be trivially copyable");
+Q_DECLARE_TYPEINFO(CANFrameRecord, Q_PRIMITIVE_TYPE);
+
 class CANFltObserver
 {
 public:
@@ -50,5 +102,13 @@ public:
     }
 };
 
+//A filter handed down to the hardware. Frames pass when (ID & mask) == (id & mask). A device that can't express a
+//set of these exactly may pass extra frames but must never drop one that matches.
+struct CANAcceptanceFilter
+{
+    quint32 id;
+    quint32 mask;
+};
+
 #endif // CAN_STRUCTS_H
 
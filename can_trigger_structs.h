@@ -4,8 +4,11 @@
 #include "can_structs.h"
 
 #include <QList>
+#include <QSharedPointer>
 #include <QUuid>
 
+class ModifierProgram;
+
 enum TriggerMask
 {
     TRG_ID = 1,
@@ -40,6 +43,7 @@ public:
 //register used to accumulate the results of a multi operation modifier.
 //if ID is -2 then this is a look up of our own data bytes stored in the class data.
 //Of course, if the ID is positive then we grab bytes or signals from newest message with that ID
+//-3 is the send count of the record, -4 a CRC-8 and -5 an XOR of our own data bytes (see modifierprogram.h)
 class ModifierOperand
 {
 public:
@@ -47,7 +51,7 @@ public:
     int bus;
     int databyte;
     bool notOper; //should a bitwise NOT be applied to this prior to doing the actual calculation?
-    QString signalName; //if ID is positive and there is text in here then we'll look up the signal and use its value
+    QString signalName; //if ID is positive or -2 and there is text in here then we'll look up the signal and use its value
 };
 
 //list of operations that can be done between the two operands
@@ -90,6 +94,7 @@ public:
     int count;
     QList<Trigger> triggers;
     QList<Modifier> modifiers;
+    QSharedPointer<const ModifierProgram> program; //modifiers compiled, reset it whenever they change
 };
 
 #endif // CAN_TRIGGER_STRUCTS_H
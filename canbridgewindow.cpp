@@ -4,8 +4,9 @@
 #include "ui_canbridgewindow.h"
 #include "filterutility.h"
 #include "mainwindow.h"
+#include "pipelinetrace.h"
 
-CANBridgeWindow::CANBridgeWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+CANBridgeWindow::CANBridgeWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::CANBridgeWindow)
 {
@@ -18,6 +19,12 @@ CANBridgeWindow::CANBridgeWindow(const QVector<CANFrame> *frames, QWidget *paren
 
     connect(ui->cbSide1, &QComboBox::currentTextChanged, this, &CANBridgeWindow::recalcSides);
     connect(ui->cbSide2, &QComboBox::currentTextChanged, this, &CANBridgeWindow::recalcSides);
+    connect(ui->ckEnableSide1, &QCheckBox::toggled, this, &CANBridgeWindow::applyRoutes);
+    connect(ui->ckEnableSide2, &QCheckBox::toggled, this, &CANBridgeWindow::applyRoutes);
+    connect(ui->spinRateSide1, QOverload<int>::of(&QSpinBox::valueChanged), this, &CANBridgeWindow::applyRoutes);
+    connect(ui->spinRateSide2, QOverload<int>::of(&QSpinBox::valueChanged), this, &CANBridgeWindow::applyRoutes);
+    connect(ui->btnRulesSide1, &QPushButton::clicked, [this] { applyRules(1); });
+    connect(ui->btnRulesSide2, &QPushButton::clicked, [this] { applyRules(2); });
     connect(MainWindow::getReference(), &MainWindow::framesUpdated, this, &CANBridgeWindow::updatedFrames);
     connect(ui->listSide1, &QListWidget::itemChanged,
         [this] (QListWidgetItem *item)
@@ -26,6 +33,7 @@ CANBridgeWindow::CANBridgeWindow(const QVector<CANFrame> *frames, QWidget *paren
             int IDval = FilterUtility::getIdAsInt(item);
             qDebug() << "ID " << IDval << " set to " << checked;
             foundIDSide1[IDval] = checked;
+            applyRoutes();
         });
     connect(ui->listSide2, &QListWidget::itemChanged,
         [this] (QListWidgetItem *item)
@@ -33,11 +41,18 @@ CANBridgeWindow::CANBridgeWindow(const QVector<CANFrame> *frames, QWidget *paren
             bool checked = item->checkState() == Qt::Checked ? true:false;
             int IDval = FilterUtility::getIdAsInt(item);
             foundIDSide2[IDval] = checked;
+            applyRoutes();
         });
+
+    //the forwarding itself happens in the connections, all this window does is show how it's going
+    counterTimer.setInterval(250);
+    connect(&counterTimer, &QTimer::timeout, this, &CANBridgeWindow::updateCounters);
+    counterTimer.start();
 }
 
 CANBridgeWindow::~CANBridgeWindow()
 {
+    CANConManager::getInstance()->setGatewayRoutes(QVector<CANGatewayRoute>());
     delete ui;
 }
 
@@ -77,11 +92,111 @@ void CANBridgeWindow::recalcSides()
 {
     side1BusNum = ui->cbSide1->currentText().toInt();
     side2BusNum = ui->cbSide2->currentText().toInt();
+    applyRoutes();
+}
+
+CANGatewayRoute CANBridgeWindow::makeRoute(int fromBus, int toBus, const QMap<int, bool> &ids, int maxRate, const QVector<CANGatewayRule> &rules) const
+{
+    CANGatewayRoute route;
+    route.fromBus = fromBus;
+    route.toBus = toBus;
+    for (QMap<int, bool>::const_iterator it = ids.constBegin(); it != ids.constEnd(); ++it)
+    {
+        if (!it.value()) route.blocked.insert(static_cast<uint32_t>(it.key()));
+    }
+    if (maxRate > 0) route.defaultMinIntervalUs = static_cast<quint32>(1000000 / maxRate);
+    route.rules = rules;
+    return route;
+}
+
+//hand whatever the window is set to over to the gateway. Routes between a bus and itself are never set up
+void CANBridgeWindow::applyRoutes()
+{
+    QVector<CANGatewayRoute> routes;
+    if (side1BusNum != side2BusNum)
+    {
+        if (ui->ckEnableSide1->isChecked()) routes.append(makeRoute(side1BusNum, side2BusNum, foundIDSide1, ui->spinRateSide1->value(), rulesSide1));
+        if (ui->ckEnableSide2->isChecked()) routes.append(makeRoute(side2BusNum, side1BusNum, foundIDSide2, ui->spinRateSide2->value(), rulesSide2));
+    }
+    CANConManager::getInstance()->setGatewayRoutes(routes);
+}
+
+//nothing changes unless every line parses, the first bad one is shown instead
+void CANBridgeWindow::applyRules(int side)
+{
+    QPlainTextEdit *edit = (side == 1) ? ui->txtRulesSide1 : ui->txtRulesSide2;
+    QString &error = (side == 1) ? rulesErrorSide1 : rulesErrorSide2;
+    QVector<CANGatewayRule> rules;
+    error.clear();
+    QStringList lines = edit->toPlainText().split('\n');
+    for (int i = 0; i < lines.count(); i++)
+    {
+        QString line = lines[i].trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        CANGatewayRule rule;
+        QString why;
+        if (!CANGatewayRule::parse(line, rule, why))
+        {
+            error = tr("Line %1: %2").arg(i + 1).arg(why);
+            updateCounters();
+            return;
+        }
+        rules.append(rule);
+    }
+    if (side == 1) rulesSide1 = rules;
+    else rulesSide2 = rules;
+    applyRoutes();
+    updateCounters();
+}
+
+QString CANBridgeWindow::counterText(int fromBus, int toBus) const
+{
+    QSharedPointer<const CANGatewayCounters> counters = CANConManager::getInstance()->getGatewayCounters(fromBus, toBus);
+    if (!counters) return tr("Forwarded: 0");
+    QString text = tr("Forwarded: %1  Blocked: %2  Rate limited: %3  Failed: %4")
+            .arg(counters->forwarded.loadRelaxed()).arg(counters->blocked.loadRelaxed())
+            .arg(counters->rateLimited.loadRelaxed()).arg(counters->failed.loadRelaxed());
+    if (counters->dropped.loadRelaxed() || counters->delayed.loadRelaxed() || counters->injected.loadRelaxed())
+    {
+        text += tr("\nDropped: %1  Delayed: %2 (up to %3 us late)  Injected: %4")
+                .arg(counters->dropped.loadRelaxed()).arg(counters->delayed.loadRelaxed())
+                .arg(counters->delayLateMaxUs.loadRelaxed()).arg(counters->injected.loadRelaxed());
+    }
+    return text;
+}
+
+QString CANBridgeWindow::ruleText(int fromBus, int toBus, const QVector<CANGatewayRule> &rules, const QString &error) const
+{
+    if (!error.isEmpty()) return error;
+    QVector<QSharedPointer<const CANGatewayRuleCounters>> counters = CANConManager::getInstance()->getGatewayRuleCounters(fromBus, toBus);
+    QStringList lines;
+    for (int r = 0; r < rules.count(); r++)
+    {
+        quint64 hits = 0, avgNs = 0, maxNs = 0;
+        if (r < counters.count() && counters[r])
+        {
+            hits = counters[r]->hits.loadRelaxed();
+            avgNs = hits ? counters[r]->totalNs.loadRelaxed() / hits : 0;
+            maxNs = counters[r]->maxNs.loadRelaxed();
+        }
+        lines.append(tr("%1 hits, avg %2 ns, max %3 ns: %4").arg(hits).arg(avgNs).arg(maxNs).arg(rules[r].text));
+    }
+    return lines.join("\n");
+}
+
+void CANBridgeWindow::updateCounters()
+{
+    if (!isVisible()) return;
+    ui->lblCountersSide1->setText(counterText(side1BusNum, side2BusNum));
+    ui->lblCountersSide2->setText(counterText(side2BusNum, side1BusNum));
+    ui->lblRulesSide1->setText(ruleText(side1BusNum, side2BusNum, rulesSide1, rulesErrorSide1));
+    ui->lblRulesSide2->setText(ruleText(side2BusNum, side1BusNum, rulesSide2, rulesErrorSide2));
 }
 
 
 void CANBridgeWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("CANBridgeWindow::updatedFrames");
     bool addedSide1 = false;
     bool addedSide2 = false;
 
@@ -91,16 +206,16 @@ void CANBridgeWindow::updatedFrames(int numFrames)
     else if (numFrames == -2) //all new set of frames. Reset
     {
     }
-    else //just got some new frames. See if they are relevant.
+    else //just got some new frames. Only here to fill in the ID lists, the frames were forwarded long ago
     {
         if (numFrames > modelFrames->count()) return;
 
-        for (int x = modelFrames->count() - numFrames; x < modelFrames->count(); x++)
+        for (int x = modelFrames->tailIndex(numFrames); x < modelFrames->count(); x++)
         {
-            CANFrame thisFrame = modelFrames->at(x);
-            int32_t id = static_cast<int32_t>(thisFrame.frameId());
+            const CANFrameRecord &rec = modelFrames->record(x);
+            int32_t id = static_cast<int32_t>(rec.frameId());
 
-            if (thisFrame.bus == side1BusNum)
+            if (rec.bus == side1BusNum)
             {
                 if  (!foundIDSide1.contains(id))
                 {
@@ -108,16 +223,8 @@ void CANBridgeWindow::updatedFrames(int numFrames)
                     FilterUtility::createCheckableFilterItem(id, true, ui->listSide1);
                     addedSide1 = true;
                 }
-                if (ui->ckEnableSide1->isChecked()) //if we're enabled to forward traffic on this bus to the other one
-                {
-                    if (foundIDSide1[id]) //and the checkbox for this particular ID is checked
-                    {
-                        thisFrame.bus = side2BusNum;
-                        CANConManager::getInstance()->sendFrame(thisFrame);
-                    }
-                }
             }
-            else if (thisFrame.bus == side2BusNum)
+            else if (rec.bus == side2BusNum)
             {
                 if  (!foundIDSide2.contains(id))
                 {
@@ -125,14 +232,6 @@ void CANBridgeWindow::updatedFrames(int numFrames)
                     FilterUtility::createCheckableFilterItem(id, true, ui->listSide2);
                     addedSide2 = true;
                 }
-                if (ui->ckEnableSide2->isChecked()) //if we're enabled to forward traffic on this bus to the other one
-                {
-                    if (foundIDSide2[id]) //and the checkbox for this particular ID is checked
-                    {
-                        thisFrame.bus = side1BusNum;
-                        CANConManager::getInstance()->sendFrame(thisFrame);
-                    }
-                }
             }
         }
         //default is to sort in ascending order
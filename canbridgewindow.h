@@ -2,7 +2,9 @@
 #define CANBRIDGEWINDOW_H
 
 #include <QDialog>
+#include <QTimer>
 #include "connections/canconmanager.h"
+#include "canframestore.h"
 
 namespace Ui {
 class CANBridgeWindow;
@@ -13,7 +15,7 @@ class CANBridgeWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit CANBridgeWindow(const QVector<CANFrame> *frames, QWidget *parent = nullptr);
+    explicit CANBridgeWindow(const CANFrameStore *frames, QWidget *parent = nullptr);
     ~CANBridgeWindow();
     void showEvent(QShowEvent*);
 
@@ -21,16 +23,26 @@ public:
 private slots:
     void updatedFrames(int);
     void recalcSides();
+    void applyRoutes();
+    void applyRules(int side);
+    void updateCounters();
 
 private:
     Ui::CANBridgeWindow *ui;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     QMap<int, bool> foundIDSide1;
     QMap<int, bool> foundIDSide2;
     int side1BusNum;
     int side2BusNum;
-
-    void processIncomingFrame(CANFrame *frame);
+    QVector<CANGatewayRule> rulesSide1;
+    QVector<CANGatewayRule> rulesSide2;
+    QString rulesErrorSide1; //shown instead of the rule counters until the rules parse
+    QString rulesErrorSide2;
+    QTimer counterTimer;
+
+    CANGatewayRoute makeRoute(int fromBus, int toBus, const QMap<int, bool> &ids, int maxRate, const QVector<CANGatewayRule> &rules) const;
+    QString counterText(int fromBus, int toBus) const;
+    QString ruleText(int fromBus, int toBus, const QVector<CANGatewayRule> &rules, const QString &error) const;
     bool eventFilter(QObject *obj, QEvent *event);
 
 };
@@ -5,6 +5,40 @@
 #include <QDebug>
 #include <QMouseEvent>
 #include <QRandomGenerator>
+#include <QPaintEvent>
+
+//cellLook() packs how a cell is drawn into one word. The fill is in the low 4 bits, the fill parameter (heat level
+//or signal color) above that, then the text state and whether the bit has stayed set (gray text)
+#define LOOK_PARAM_SHIFT    4
+#define LOOK_STATE_SHIFT    12
+#define LOOK_STEADY         0x4000
+#define LOOK_NONE           0xFFFFFFFFu
+
+namespace
+{
+enum CellFill
+{
+    FILL_WHITE,
+    FILL_BLACK,
+    FILL_GREEN,
+    FILL_RED,
+    FILL_GRAY_HASH,
+    FILL_BLACK_HASH,
+    FILL_GREEN_HASH,
+    FILL_SIGNAL,
+    FILL_HEAT
+};
+
+//see the comment above layoutGrid for why these are the only layouts
+void gridDivisions(int bytes, int &xDiv, int &yDiv)
+{
+    xDiv = 8;
+    yDiv = 8;
+    if (bytes > 8) xDiv = 16;
+    if (bytes > 16) yDiv = 16;
+    if (bytes > 32) xDiv = 32;
+}
+}
 
 //The program used to generate new colors every time the grid was displayed but that's ugly
 //and disorienting. Instead use this list colors I've picked because they're "bright".
@@ -84,8 +118,18 @@ CANDataGrid::CANDataGrid(QWidget *parent) :
     greenHashBrush = QBrush(QColor(0, 0xB6, 0), Qt::BDiagPattern);
     blackHashBrush = QBrush(QColor(0, 0, 0), Qt::FDiagPattern);
     grayBrush = QBrush(QColor(230,230,230));
+    grayHashBrush = QBrush(QColor(0xB6, 0xB6, 0xB6), Qt::BDiagPattern);
     xOffset = 0;
     yOffset = 0;
+    smallMetric = nullptr;
+    largeMetric = nullptr;
+    layoutValid = false;
+    overlayDirty = true;
+    fullDirty = true;
+    layoutDpr = 0.0;
+    layoutMode = gridMode;
+    for (int j = 0; j < 512; j++) cellLooks[j] = LOOK_NONE;
+    gridDivisions(bytesToDraw, neededXDivisions, neededYDivisions);
 
     //generate the palette
 
@@ -111,6 +155,8 @@ CANDataGrid::CANDataGrid(QWidget *parent) :
 
 CANDataGrid::~CANDataGrid()
 {
+    delete smallMetric;
+    delete largeMetric;
     delete ui;
 }
 
@@ -121,7 +167,9 @@ GridMode CANDataGrid::getMode()
 
 void CANDataGrid::setMode(GridMode mode)
 {
+    if (gridMode == mode) return;
     gridMode = mode;
+    fullDirty = true;
 }
 
 void CANDataGrid::setBytesToDraw(int num)
@@ -182,8 +230,11 @@ void CANDataGrid::setCellTextState(int bitPos, GridTextState state)
     //textStates has two dimensions but they are NOT X and Y and don't necessarily correspond to X and Y in the grid
     int byte = bitPos / 8;
     int bit = bitPos & 7;
+    if (textStates[byte][bit] == state) return;
     textStates[byte][bit] = state;
-    this->update();
+    if (layoutStale()) fullDirty = true;
+    else pendingDirty += byteRect(byte);
+    flushDirty();
 }
 
 GridTextState CANDataGrid::getCellTextState(int bitPos)
@@ -200,20 +251,25 @@ void CANDataGrid::setSignalNames(int sigIdx, const QString sigName)
     {
         signalNames.resize(sigIdx * 2);
     }
+    if (signalNames[sigIdx] == sigName) return;
     signalNames[sigIdx] = sigName;
+    markSignalsChanged();
 }
 
 void CANDataGrid::clearSignalNames()
 {
     signalNames.clear();
     signalNames.resize(40);
+    markSignalsChanged();
 }
 
 void CANDataGrid::setUsedSignalNum(int bit, int signal)
 {
     if (bit < 0) return;
     if (bit > 511) return;
+    if (usedSignalNum[bit] == signal) return;
     usedSignalNum[bit] = signal;
+    markSignalsChanged();
 }
 
 int CANDataGrid::getUsedSignalNum(int bit)
@@ -225,11 +281,29 @@ int CANDataGrid::getUsedSignalNum(int bit)
 
 void CANDataGrid::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event);
+    if (layoutStale()) layoutGrid();
+    QRegion redrawn = paintGridCells();
+    if (overlayDirty) paintSignalNames();
+
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, cellCache);
+    if ((signalNames.count() > 0) && (gridMode == GridMode::SIGNAL_VIEW)) painter.drawPixmap(0, 0, overlayCache);
+
+    //cells that changed without anybody asking for them to be shown yet still have to make it to the screen
+    fullDirty = false;
+    pendingDirty -= event->region();
+    redrawn -= event->region();
+    if (!redrawn.isEmpty()) update(redrawn);
+}
 
-    paintCommonBeginning();
-    paintGridCells();
-    paintCommonEnding();
+bool CANDataGrid::layoutStale()
+{
+    if (!layoutValid) return true;
+    int xDiv, yDiv;
+    gridDivisions(bytesToDraw, xDiv, yDiv);
+    return (xDiv != neededXDivisions) || (yDiv != neededYDivisions) || (size() != layoutSize)
+        || (devicePixelRatioF() != layoutDpr) || (gridMode != layoutMode)
+        || (QApplication::palette().color(QPalette::Text) != layoutTextColor);
 }
 
 /*
@@ -238,32 +312,16 @@ void CANDataGrid::paintEvent(QPaintEvent *event)
  * Then 12 is just 16 minus some bits that never can get used. Then jump to 32 drawn cells from there. That would be also
  * subdividing along the Y axis. Obviously, as before, 24 is just 32 but with unusable bits. Lastly, subdivide X yet again
  * so now it's in quarters. This allows for 64 bits (48 is likewise just 64 with unusable bits)
+ *
+ * Only runs when the size, mode or number of bytes changes. Everything drawn after this goes into the caches.
 */
-void CANDataGrid::paintCommonBeginning()
+void CANDataGrid::layoutGrid()
 {
-    int x;
-
-    painter = new QPainter(this);
-    viewport = painter->viewport();
-
-    neededXDivisions = 8;
-    neededYDivisions = 8;
+    viewport = rect();
 
-    int textRestrict = qMax(neededXDivisions, neededYDivisions);
+    gridDivisions(bytesToDraw, neededXDivisions, neededYDivisions);
 
-    if (bytesToDraw > 8)
-    {
-        neededXDivisions = 16;
-    }
-    if (bytesToDraw > 16)
-    {
-        neededXDivisions = 16;
-        neededYDivisions = 16;
-    }
-    if (bytesToDraw > 32)
-    {
-        neededXDivisions = 32;
-    }
+    int textRestrict = 8;
 
     if (gridMode != GridMode::SIGNAL_VIEW)
     {
@@ -277,14 +335,14 @@ void CANDataGrid::paintCommonBeginning()
     }
     sigNameTextSize = qMin(viewport.size().height(), viewport.size().width()) / (textRestrict * 5.0);
 
-    painter->setPen(QPen(QApplication::palette().color(QPalette::Text)));
-    mainFont.setPixelSize(bigTextSize);
-    painter->setFont(mainFont);
-    smallFont.setPixelSize(smallTextSize);
-    boldFont.setPixelSize(bigTextSize);
+    mainFont.setPixelSize(qMax(1, static_cast<int>(bigTextSize)));
+    smallFont.setPixelSize(qMax(1, static_cast<int>(smallTextSize)));
+    boldFont.setPixelSize(qMax(1, static_cast<int>(bigTextSize)));
     boldFont.setBold(true);
-    sigNameFont.setPixelSize(sigNameTextSize);
+    sigNameFont.setPixelSize(qMax(1, static_cast<int>(sigNameTextSize)));
 
+    delete smallMetric;
+    delete largeMetric;
     smallMetric = new QFontMetrics(sigNameFont);
     largeMetric = new QFontMetrics(mainFont);
 
@@ -294,218 +352,249 @@ void CANDataGrid::paintCommonBeginning()
     xSpan = viewport.right() - viewport.left() - xOffset;
     ySpan = viewport.bottom() - viewport.top() - yOffset;
 
-    qDebug() << "XSpan" << xSpan << " YSpan " << ySpan;
-
     xSector = xSpan / neededXDivisions;
     ySector = ySpan / neededYDivisions;
 
-    qDebug() << "XSector " << xSector << " YSector " << ySector;
-
     nearX = viewport.left() + xOffset;
     nearY = viewport.top() + yOffset;
     farX = nearX + xSector * neededXDivisions;
     farY = nearY + ySector * neededYDivisions;
 
-    //painter->setFont(boldFont);
-    painter->setFont(smallFont);
+    //these are used to make it easy to figure out which grid has been clicked on during mousedown events
+    upperLeft.setX(nearX);
+    upperLeft.setY(nearY);
+    gridSize.setX(xSector);
+    gridSize.setY(ySector);
+
+    layoutSize = size();
+    layoutDpr = devicePixelRatioF();
+    layoutMode = gridMode;
+    layoutTextColor = QApplication::palette().color(QPalette::Text);
+
+    cellCache = QPixmap(layoutSize * layoutDpr);
+    cellCache.setDevicePixelRatio(layoutDpr);
+    cellCache.fill(Qt::transparent);
+    overlayCache = QPixmap(layoutSize * layoutDpr);
+    overlayCache.setDevicePixelRatio(layoutDpr);
+
+    QPainter painter(&cellCache);
+    paintLabels(painter);
+
+    for (int j = 0; j < 512; j++) cellLooks[j] = LOOK_NONE;
+    overlayDirty = true;
+    layoutValid = true;
+}
+
+void CANDataGrid::paintLabels(QPainter &painter)
+{
+    painter.setPen(QPen(layoutTextColor));
+    painter.setFont(smallFont);
 
     //draw grid by doing vertical and horizontal lines. This is not needed normally but helps when developing new code. Only uncomment for testing
 /*
     for (int y = 0; y <= neededYDivisions; y++)
     {
-        painter->drawLine(nearX, nearY + (y * ySector), farX, nearY + (y * ySector) );
+        painter.drawLine(nearX, nearY + (y * ySector), farX, nearY + (y * ySector) );
     }
 
     for (int x = 0; x <= neededXDivisions; x++)
     {
-        painter->drawLine(nearX + (x * xSector), nearY, nearX + (x * xSector), farY);
+        painter.drawLine(nearX + (x * xSector), nearY, nearX + (x * xSector), farY);
     }
 */
 
-    for (x = 0; x < neededXDivisions; x++)
+    for (int x = 0; x < neededXDivisions; x++)
     {
         int num = (neededXDivisions - 1) - x;
         num = num & 7;
-        painter->drawText(QRect(nearX + (x * xSector), viewport.top(), xSector, viewport.top() + smallMetric->height()), Qt::AlignCenter, QString::number(num));
+        painter.drawText(QRect(nearX + (x * xSector), viewport.top(), xSector, viewport.top() + smallMetric->height()), Qt::AlignCenter, QString::number(num));
     }
 
     int skip = neededXDivisions / 8;
     for (int y = 0; y < neededYDivisions; y++)
     {
-        painter->drawText(QRect(viewport.left() + 2, nearY + (ySector * y), xOffset, ySector), Qt::AlignCenter, QString::number(y * skip));
+        painter.drawText(QRect(viewport.left() + 2, nearY + (ySector * y), xOffset, ySector), Qt::AlignCenter, QString::number(y * skip));
+    }
+}
+
+/*
+ * Color the bitfield by seeing if a given bit is freshly set/unset in the new data compared to the old. Bits that are not
+ * set in either are white, bits set in both are black bits that used to be set but now are unset are red, bits that used
+ * to be unset but now are set are green
+*/
+quint32 CANDataGrid::cellLook(int byteIdx, int bitIdx) const
+{
+    int bit = (byteIdx * 8) + bitIdx;
+    bool thisBit = (data[byteIdx] & (1 << bitIdx)) != 0;
+    bool prevBit = (refData[byteIdx] & (1 << bitIdx)) != 0;
+    bool hashed = (signalColors.count() > 0) && (gridMode == GridMode::SIGNAL_VIEW);
+    quint32 fill;
+    quint32 param = 0;
+
+    if (gridMode == GridMode::HEAT_VIEW)
+    {
+        fill = FILL_HEAT;
+        param = heatData[bit];
+    }
+    else if (thisBit)
+    {
+        if (prevBit) fill = hashed ? FILL_BLACK_HASH : FILL_BLACK;
+        else fill = hashed ? FILL_GREEN_HASH : FILL_GREEN;
+    }
+    else if (prevBit) fill = FILL_RED;
+    else if (usedData[byteIdx] & (1 << bitIdx))
+    {
+        int usedSigNum = (gridMode == GridMode::SIGNAL_VIEW) ? usedSignalNum[bit] : -1;
+        if (usedSigNum == -1) fill = FILL_GRAY_HASH;
+        else
+        {
+            fill = FILL_SIGNAL;
+            param = usedSigNum % signalColors.length(); //can only use as many colors as have been defined
+        }
     }
+    else fill = FILL_WHITE;
 
-    painter->setPen(QPen(Qt::black));
-    painter->setFont(mainFont);
+    quint32 look = fill | (param << LOOK_PARAM_SHIFT) | (static_cast<quint32>(textStates[byteIdx][bitIdx]) << LOOK_STATE_SHIFT);
+    if (thisBit && prevBit) look |= LOOK_STEADY;
+    return look;
 }
 
-void CANDataGrid::paintGridCells()
+void CANDataGrid::drawCell(QPainter &painter, const QRect &cell, int bit, quint32 look)
 {
-    int x, y, bit;
-    unsigned char prevByte, thisByte;
-    bool thisBit, prevBit;
-    int usedSigNum;
-    QString prevSigName;
+    quint32 param = (look >> LOOK_PARAM_SHIFT) & 0xFF;
+    QBrush brush;
+    switch (look & 0xF)
+    {
+    case FILL_WHITE: brush = whiteBrush; break;
+    case FILL_BLACK: brush = blackBrush; break;
+    case FILL_GREEN: brush = greenBrush; break;
+    case FILL_RED: brush = redBrush; break;
+    case FILL_GRAY_HASH: brush = grayHashBrush; break;
+    case FILL_BLACK_HASH: brush = blackHashBrush; break;
+    case FILL_GREEN_HASH: brush = greenHashBrush; break;
+    case FILL_SIGNAL: brush = QBrush(signalColors[param]); break;
+    case FILL_HEAT: brush = QBrush(fire[param]); break;
+    }
+
+    //the hashed brushes let whatever was there show through so clear the old cell out first
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(QRect(cell.x(), cell.y(), cell.width() + 1, cell.height() + 1), Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
 
-    //now, color the bitfield by seeing if a given bit is freshly set/unset in the new data
-    //compared to the old. Bits that are not set in either are white, bits set in both are black
-    //bits that used to be set but now are unset are red, bits that used to be unset but now are set
-    //are green
+    painter.setPen(QPen(Qt::black));
+    painter.setBrush(brush);
+    painter.drawRect(cell);
 
-    for (y = 0; y < neededYDivisions; y++)
+    switch (static_cast<GridTextState>((look >> LOOK_STATE_SHIFT) & 3))
     {
-        for (x = 0; x < neededXDivisions; x++)
+    case GridTextState::NORMAL:
+        if (look & LOOK_STEADY) painter.setPen(QPen(Qt::gray));
+        else painter.setPen(QPen(Qt::black));
+        painter.setFont(mainFont);
+        break;
+    case GridTextState::BOLD_BLUE:
+        painter.setPen(QPen(Qt::blue));
+        painter.setFont(boldFont);
+        break;
+    case GridTextState::INVERT:
+        painter.setFont(mainFont);
+        QColor brushColor = brush.color();
+        painter.setPen(QColor(255-brushColor.red(), 255-brushColor.green(), 255-brushColor.blue()));
+        break;
+    }
+    if (gridMode != GridMode::SIGNAL_VIEW)
+        painter.drawText(cell, Qt::AlignCenter, QString::number(bit)); //center center of grid
+    else
+        painter.drawText(cell, Qt::AlignLeft, QString::number(bit)); //upper left of grid
+}
+
+//redraws the cells that look different than last time into cellCache. Returns the area that changed
+QRegion CANDataGrid::paintGridCells()
+{
+    QRegion changed;
+    QPainter painter(&cellCache);
+
+    for (int y = 0; y < neededYDivisions; y++)
+    {
+        for (int x = 0; x < neededXDivisions; x++)
         {
             int byteIdx = (y * (neededXDivisions / 8) + (x / 8));
-            thisByte = data[byteIdx];
-            prevByte = refData[byteIdx];
             int bitIdx = ((neededXDivisions - 1) - x) & 7;
-            bit = (byteIdx * 8) + bitIdx;
-            thisBit = false;
-            prevBit = false;
-            if ((thisByte & (1 << bitIdx)) == (1 << bitIdx)) thisBit = true;
-            if ((prevByte & (1 << bitIdx)) == (1 << bitIdx)) prevBit = true;
-
-            if (gridMode == GridMode::HEAT_VIEW)
-            {
-                painter->setBrush(QBrush(fire[heatData[bit]]));
-            }
-            else
-            {
-                if (thisBit)
-                {
-                    if (prevBit)
-                    {
-                        if ((signalColors.count() > 0) && (gridMode == GridMode::SIGNAL_VIEW)) painter->setBrush(blackHashBrush);
-                        else painter->setBrush(blackBrush);
-                    }
-                    else
-                    {
-                        if ((signalColors.count() > 0) && (gridMode == GridMode::SIGNAL_VIEW)) painter->setBrush(greenHashBrush);
-                        else painter->setBrush(greenBrush);
-                    }
-                }
-                else
-                {
-                    if (prevBit)
-                    {
-                        painter->setBrush(redBrush);
-                    }
-                    else
-                    {
-                        usedSigNum = -1;
-                        if ((usedData[byteIdx] & (1 << bitIdx)) == (1 << bitIdx))
-                        {
-                            if (gridMode == GridMode::SIGNAL_VIEW) usedSigNum = getUsedSignalNum(bit);
-                            if (usedSigNum == -1)
-                            {
-                                grayBrush = QBrush(QColor(0xB6, 0xB6, 0xB6), Qt::BDiagPattern);
-                                painter->setBrush(grayBrush);
-                            }
-                            else
-                            {
-                                int idx = usedSigNum % signalColors.length(); //can only use as many colors as have been defined
-                                painter->setBrush(QBrush(signalColors[idx]));
-                            }
-                        }
-                        else painter->setBrush(whiteBrush);
-                    }
-                }
-            }
-
-            painter->drawRect(nearX + (x * xSector), nearY + (y * ySector), xSector, ySector);
-            switch (textStates[byteIdx][bitIdx])
-            {
-            case GridTextState::NORMAL:
-                if (thisBit && prevBit) painter->setPen(QPen(Qt::gray));
-                else painter->setPen(QPen(Qt::black));
-                painter->setFont(mainFont);
-                break;
-            case GridTextState::BOLD_BLUE:
-                painter->setPen(QPen(Qt::blue));
-                painter->setFont(boldFont);
-                break;
-            case GridTextState::INVERT:
-                painter->setFont(mainFont);
-                QColor brushColor = painter->brush().color();
-                painter->setPen(QColor(255-brushColor.red(), 255-brushColor.green(), 255-brushColor.blue()));
-                break;
-            }
-            //change style of bit number output for current signal
-            //if (thisBit) painter->setFont(boldFont);
-           // else painter->setFont(mainFont);
-            //painter->setFont(smallFont);
-            if (gridMode != GridMode::SIGNAL_VIEW)
-                painter->drawText(QRect(nearX + (x * xSector), nearY + (y * ySector), xSector, ySector), Qt::AlignCenter, QString::number(bit)); //center center of grid
-            else
-                painter->drawText(QRect(nearX + (x * xSector), nearY + (y * ySector), xSector, ySector), Qt::AlignLeft, QString::number(bit)); //upper left of grid
-
-            painter->setFont(mainFont);
-            painter->setPen(QPen(Qt::black));
+            int bit = (byteIdx * 8) + bitIdx;
+            quint32 look = cellLook(byteIdx, bitIdx);
+            if (look == cellLooks[bit]) continue;
+            cellLooks[bit] = look;
+            QRect cell = cellRect(x, y);
+            drawCell(painter, cell, bit, look);
+            changed += cell.adjusted(0, 0, 1, 1);
         }
     }
+    return changed;
+}
+
+/*
+ * now if signal names are loaded we'll go through all the bits again and try to label over top of the grid
+ * We already have a big bitmap that tells us which signals occupy which bits so every time there is a new
+ * signal look ahead to see if there's room in the row to just run the signal name through as long as needed.
+ * This goes into its own transparent pixmap drawn over the cells so changing cells never has to touch it.
+*/
+void CANDataGrid::paintSignalNames()
+{
+    overlayDirty = false;
+    overlayCache.fill(Qt::transparent);
+    if ( (signalNames.count() == 0) || (gridMode != GridMode::SIGNAL_VIEW) ) return;
 
+    QPainter painter(&overlayCache);
+    painter.setPen(QPen(Qt::black));
+    painter.setFont(sigNameFont);
+    QString prevSigName;
 
-    /*
-     * now if signal names are loaded we'll go through all the bits again and try to label over top of the grid
-     * We already have a big bitmap that tells us which signals occupy which bits so every time there is a new
-     * signal look ahead to see if there's room in the row to just run the signal name through as long as needed.
-    */
-    if ( (signalNames.count() > 0) && (gridMode == GridMode::SIGNAL_VIEW) )
+    for (int y = 0; y < neededYDivisions; y++)
     {
-        painter->setFont(sigNameFont);
-
-        for (y = 0; y < neededYDivisions; y++)
+        for (int x = 0; x < neededXDivisions; x++)
         {
-            for (x = 0; x < neededXDivisions; x++)
+            int byteIdx = (y * (neededXDivisions / 8) + (x / 8));
+            int bitIdx = ((neededXDivisions - 1) - x) & 7;
+            int bit = (byteIdx * 8) + bitIdx;
+            int usedSigNum = -1;
+            if ((usedData[byteIdx] & (1 << bitIdx)) == (1 << bitIdx))
             {
-                int byteIdx = (y * (neededXDivisions / 8) + (x / 8));
-                int bitIdx = ((neededXDivisions - 1) - x) & 7;
-                bit = (byteIdx * 8) + bitIdx;
-                usedSigNum = -1;
-                if ((usedData[byteIdx] & (1 << bitIdx)) == (1 << bitIdx))
+                usedSigNum = getUsedSignalNum(bit);
+                if ((usedSigNum > -1) && (usedSigNum < signalNames.count()) && (prevSigName != signalNames[usedSigNum]) )
                 {
-                    usedSigNum = getUsedSignalNum(bit);
-                    if ((usedSigNum > -1) && (prevSigName != signalNames[usedSigNum]) )
-                    {
-                        prevSigName = signalNames[usedSigNum];
+                    prevSigName = signalNames[usedSigNum];
 
-                        int textWidth = smallMetric->horizontalAdvance(prevSigName);
+                    int textWidth = smallMetric->horizontalAdvance(prevSigName);
 
-                        int usableWidth = getSignalRowRun(usedSigNum, bit);
-                        qDebug() << "Width this row: " << usableWidth;
-                        usableWidth *= xSector;
+                    int usableWidth = getSignalRowRun(usedSigNum, bit);
+                    usableWidth *= xSector;
 
-                        if (textWidth > usableWidth) //signal name is too long for space we've got on this row. Try to wrap it
+                    if (textWidth > usableWidth) //signal name is too long for space we've got on this row. Try to wrap it
+                    {
+                        int numAvgChars = xSector / smallMetric->averageCharWidth();
+                        painter.drawText(nearX + x * xSector + 5, nearY + (y * ySector) + smallMetric->height() * 1.6, prevSigName.left(numAvgChars - 1));
+                        QString remainder = prevSigName.mid(numAvgChars - 1, -1);
+                        textWidth = smallMetric->horizontalAdvance(prevSigName);
+                        if (textWidth > xSector)
                         {
-                            int numAvgChars = xSector / smallMetric->averageCharWidth();
-                            painter->drawText(nearX + x * xSector + 5, nearY + (y * ySector) + smallMetric->height() * 1.6, prevSigName.left(numAvgChars - 1));
-                            QString remainder = prevSigName.mid(numAvgChars - 1, -1);
-                            textWidth = smallMetric->horizontalAdvance(prevSigName);
-                            if (textWidth > xSector)
-                            {
-                                painter->drawText(nearX + x * xSector + 12, nearY + (y * ySector) + smallMetric->height() * 2.6, remainder.left(numAvgChars - 1));
-                            }
-                            else painter->drawText(nearX + x * xSector + 12, nearY + (y * ySector) + smallMetric->height() * 2.6, remainder);
-
+                            painter.drawText(nearX + x * xSector + 12, nearY + (y * ySector) + smallMetric->height() * 2.6, remainder.left(numAvgChars - 1));
                         }
-                        else
+                        else painter.drawText(nearX + x * xSector + 12, nearY + (y * ySector) + smallMetric->height() * 2.6, remainder);
+
+                    }
+                    else
+                    {
+                        //first see if we even have enough room to use a bigger font and use that if so. Otherwise stick with the normal font
+                        textWidth = largeMetric->horizontalAdvance(prevSigName);
+                        QSize size = QSize(usableWidth, ySector - smallMetric->height() * 1.0);
+                        QRect textRect(nearX + x * xSector, nearY + (y * ySector) + smallMetric->height() * 1.0, size.width(), size.height());
+                        if (textWidth < usableWidth)
                         {
-                            //first see if we even have enough room to use a bigger font and use that if so. Otherwise stick with the normal font
-                            textWidth = largeMetric->horizontalAdvance(prevSigName);
-                            if (textWidth < usableWidth)
-                            {
-                                painter->setFont(mainFont);
-                                QSize size = QSize(usableWidth, ySector - smallMetric->height() * 1.0);
-                                painter->drawText(QRect(nearX + x * xSector, nearY + (y * ySector) + smallMetric->height() * 1.0, size.width(), size.height()), Qt::AlignCenter, prevSigName);
-                                painter->setFont(sigNameFont);
-                            }
-                            else
-                            {
-                                QSize size = QSize(usableWidth, ySector - smallMetric->height() * 1.0);
-                                painter->drawText(QRect(nearX + x * xSector, nearY + (y * ySector) + smallMetric->height() * 1.0, size.width(), size.height()), Qt::AlignCenter, prevSigName);
-                            }
+                            painter.setFont(mainFont);
+                            painter.drawText(textRect, Qt::AlignCenter, prevSigName);
+                            painter.setFont(sigNameFont);
                         }
+                        else painter.drawText(textRect, Qt::AlignCenter, prevSigName);
                     }
                 }
             }
@@ -513,11 +602,56 @@ void CANDataGrid::paintGridCells()
     }
 }
 
+QRect CANDataGrid::cellRect(int x, int y) const
+{
+    return QRect(nearX + (x * xSector), nearY + (y * ySector), xSector, ySector);
+}
+
+//all 8 bits of a byte are always next to each other in one row
+QRect CANDataGrid::byteRect(int byteIdx) const
+{
+    int bytesPerRow = neededXDivisions / 8;
+    int row = byteIdx / bytesPerRow;
+    if (row >= neededYDivisions) return QRect();
+    int x = (byteIdx % bytesPerRow) * 8;
+    return QRect(nearX + (x * xSector), nearY + (row * ySector), 8 * xSector + 1, ySector + 1);
+}
+
+void CANDataGrid::markBytes(const unsigned char *before, const unsigned char *after, int count)
+{
+    if (layoutStale())
+    {
+        fullDirty = true;
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (before[i] != after[i]) pendingDirty += byteRect(i);
+    }
+}
+
+//the names run across cells so any change to which signal has which bits means redoing the overlay
+void CANDataGrid::markSignalsChanged()
+{
+    overlayDirty = true;
+    fullDirty = true;
+}
+
+void CANDataGrid::flushDirty()
+{
+    if (fullDirty || !layoutValid)
+    {
+        update();
+        fullDirty = false;
+    }
+    else if (!pendingDirty.isEmpty()) update(pendingDirty);
+    pendingDirty = QRegion();
+}
+
 //starting at the given coords, go right / increment X until either we hit the end of the signal or the end of the row, whichever is first.
 //return how many grid cells that was. The part that sucks is that bits aren't really in "bit" order so you can't just increment the bit number
 int CANDataGrid::getSignalRowRun(int sigNum, int startBit)
 {
-    qDebug() << "SigNum: " << sigNum << " startBit " << startBit;
     int width = 0;
     QPoint gridPt = getGridPointFromBitPosition(startBit);
     int x = gridPt.x();
@@ -532,19 +666,6 @@ int CANDataGrid::getSignalRowRun(int sigNum, int startBit)
     return width;
 }
 
-void CANDataGrid::paintCommonEnding()
-{
-    //these are used to make it easy to figure out which grid has been clicked on during mousedown events
-    upperLeft.setX(nearX);
-    upperLeft.setY(nearY);
-    gridSize.setX(xSector);
-    gridSize.setY(ySector);
-
-    //and we don't need these anymore after we're done drawing
-    delete painter;
-    delete smallMetric;
-}
-
 //given a grid cell we return which bit position that is within the CAN frame.
 int CANDataGrid::gridToBitPosition(int x, int y)
 {
@@ -598,33 +719,51 @@ void CANDataGrid::saveImage(QString filename, int width, int height)
 //have large enough buffers!
 void CANDataGrid::setReference(unsigned char *newRef, bool bUpdate = true)
 {
+    unsigned char before[64];
+    memcpy(before, refData, 64);
     int bytesToTransfer = (bytesToDraw + 7) & 0xF8; //force copying in 8 byte increments
     memcpy(refData, newRef, bytesToTransfer);
     //clear all data past that point just to be sure we don't have garbage left over
     if (bytesToTransfer < 64) memset(refData + bytesToTransfer, 0, 64 - bytesToTransfer);
-    if (bUpdate) this->update();
+    markBytes(before, refData, 64);
+    if (bUpdate) flushDirty();
 }
 
 void CANDataGrid::updateData(unsigned char *newData, bool bUpdate = true)
 {
+    unsigned char before[64];
+    memcpy(before, data, 64);
     int bytesToTransfer = (bytesToDraw + 7) & 0xF8; //force copying in 8 byte increments
     memcpy(data, newData, bytesToTransfer);
     //clear all data past that point just to be sure we don't have garbage left over
-    if (bytesToTransfer < 64) memset(refData + bytesToTransfer, 0, 64 - bytesToTransfer);
-    if (bUpdate) this->update();
+    if (bytesToTransfer < 64) memset(data + bytesToTransfer, 0, 64 - bytesToTransfer);
+    markBytes(before, data, 64);
+    if (bUpdate) flushDirty();
 }
 
 void CANDataGrid::setUsed(unsigned char *newData, bool bUpdate = false)
 {
+    unsigned char before[64];
+    memcpy(before, usedData, 64);
     int bytesToTransfer = (bytesToDraw + 7) & 0xF8; //force copying in 8 byte increments
     memcpy(usedData, newData, bytesToTransfer);
     //clear all data past that point just to be sure we don't have garbage left over
-    if (bytesToTransfer < 64) memset(refData + bytesToTransfer, 0, 64 - bytesToTransfer);
-    if (bUpdate) this->update();
+    if (bytesToTransfer < 64) memset(usedData + bytesToTransfer, 0, 64 - bytesToTransfer);
+    if ((gridMode == GridMode::SIGNAL_VIEW) && memcmp(before, usedData, 64)) markSignalsChanged();
+    else markBytes(before, usedData, 64);
+    if (bUpdate) flushDirty();
 }
 
 void CANDataGrid::setHeat(unsigned char *newData)
 {
+    if (!layoutStale())
+    {
+        for (int byteIdx = 0; byteIdx < 64; byteIdx++)
+        {
+            if (memcmp(heatData + byteIdx * 8, newData + byteIdx * 8, 8)) pendingDirty += byteRect(byteIdx);
+        }
+    }
+    else fullDirty = true;
     memcpy(heatData, newData, 512);
-    this->update();
+    flushDirty();
 }
@@ -2,6 +2,9 @@
 #define CANDATAGRID_H
 
 #include <QWidget>
+#include <QPainter>
+#include <QPixmap>
+#include <QRegion>
 
 namespace Ui {
 class CANDataGrid;
@@ -24,6 +27,11 @@ class CANDataGrid;
  * still needed. Also, it seems like it is necessary to allow for a variety of modes.
  *
  * And now, CAN-FD added as the cherry on top! It's a mess but really, all this functionality is handy to have.
+ *
+ * Painting goes through two cached pixmaps. cellCache has the labels and every cell, cellLooks remembers what each cell was
+ * drawn as so a repaint only redraws the cells that actually look different now. overlayCache has the signal names that get
+ * written across the cells in SIGNAL_VIEW, it's only redrawn when the signals or the layout change. The setters work out which
+ * cells they touched and only ask for those to be repainted.
  */
 
 enum GridTextState
@@ -75,6 +83,17 @@ signals:
 private:
     Ui::CANDataGrid *ui;
     int bytesToDraw;
+    QPixmap cellCache;
+    QPixmap overlayCache;
+    quint32 cellLooks[512]; //what each cell was last drawn as in cellCache, see cellLook()
+    bool layoutValid;
+    bool overlayDirty;
+    bool fullDirty; //something changed that isn't worth tracking down to single cells
+    QRegion pendingDirty; //cells changed by setters that were told not to update yet
+    QSize layoutSize;
+    qreal layoutDpr;
+    GridMode layoutMode;
+    QColor layoutTextColor;
     unsigned char refData[64];
     unsigned char data[64];
     unsigned char usedData[64];
@@ -85,8 +104,7 @@ private:
     QPoint upperLeft, gridSize;
     GridMode gridMode;
     QBrush blackBrush, whiteBrush, redBrush, greenBrush, grayBrush;
-    QBrush greenHashBrush, blackHashBrush;
-    QPainter *painter;
+    QBrush greenHashBrush, blackHashBrush, grayHashBrush;
     QRect viewport;
     int xSpan;
     int ySpan;
@@ -106,9 +124,18 @@ private:
     QFontMetrics *largeMetric;
     QColor fire[256];
 
-    void paintGridCells();
-    void paintCommonBeginning();
-    void paintCommonEnding();    
+    void layoutGrid();
+    bool layoutStale();
+    void paintLabels(QPainter &painter);
+    QRegion paintGridCells();
+    void paintSignalNames();
+    quint32 cellLook(int byteIdx, int bitIdx) const;
+    void drawCell(QPainter &painter, const QRect &cell, int bit, quint32 look);
+    QRect cellRect(int x, int y) const;
+    QRect byteRect(int byteIdx) const;
+    void markBytes(const unsigned char *before, const unsigned char *after, int count);
+    void markSignalsChanged();
+    void flushDirty();
     int gridToBitPosition(int x, int y);
     QPoint getGridPointFromBitPosition(int bitPos);
     int getSignalRowRun(int sigNum, int startBit);
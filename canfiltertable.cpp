@@ -0,0 +1,135 @@
+#include "canfiltertable.h"
+
+#include <cstring>
+
+CANFilterTable::CANFilterTable()
+{
+    clear();
+}
+
+void CANFilterTable::setId(uint32_t id, bool on)
+{
+    State old = idState(id);
+    if (old == Unknown) numIds++;
+    else if (old == Off) numIdsOff--;
+    if (!on) numIdsOff++;
+
+    if (id < STD_IDS)
+    {
+        uint32_t bit = 1u << (id & 31);
+        stdKnown[id >> 5] |= bit;
+        if (on) stdOn[id >> 5] |= bit;
+        else stdOn[id >> 5] &= ~bit;
+        return;
+    }
+
+    //keep the load at or under half so probe runs stay short
+    if (old == Unknown && (extUsed + 1) * 2 > extKeys.count()) growExt();
+    int slot = findSlot(id);
+    if (!extState[slot])
+    {
+        extKeys[slot] = id;
+        extUsed++;
+    }
+    extState[slot] = on ? SLOT_ON : SLOT_OFF;
+}
+
+void CANFilterTable::setBus(int bus, bool on)
+{
+    State old = busState(bus);
+    if (old == Unknown) numBuses++;
+    else if (old == Off) numBusesOff--;
+    if (!on) numBusesOff++;
+
+    if (bus >= 0 && bus < MASK_BUSES)
+    {
+        uint64_t bit = 1ull << bus;
+        busKnown |= bit;
+        if (on) busOn |= bit;
+        else busOn &= ~bit;
+        return;
+    }
+    otherBuses.insert(bus, on);
+}
+
+void CANFilterTable::setAllIds(bool on)
+{
+    for (uint32_t i = 0; i < STD_IDS / 32; i++) stdOn[i] = on ? stdKnown[i] : 0;
+    for (int i = 0; i < extState.count(); i++)
+    {
+        if (extState[i]) extState[i] = on ? SLOT_ON : SLOT_OFF;
+    }
+    numIdsOff = on ? 0 : numIds;
+}
+
+void CANFilterTable::growExt()
+{
+    QVector<uint32_t> oldKeys = extKeys;
+    QVector<uint8_t> oldState = extState;
+
+    int size = extKeys.isEmpty() ? 16 : extKeys.count() * 2;
+    extShift = 32;
+    for (int s = size; s > 1; s >>= 1) extShift--;
+    extKeys.fill(0, size);
+    extState.fill(0, size);
+
+    for (int i = 0; i < oldKeys.count(); i++)
+    {
+        if (!oldState[i]) continue;
+        int slot = findSlot(oldKeys[i]);
+        extKeys[slot] = oldKeys[i];
+        extState[slot] = oldState[i];
+    }
+}
+
+QMap<int, bool> CANFilterTable::ids() const
+{
+    QMap<int, bool> out;
+    for (uint32_t id = 0; id < STD_IDS; id++)
+    {
+        if (stdKnown[id >> 5] & (1u << (id & 31))) out.insert(static_cast<int>(id), (stdOn[id >> 5] >> (id & 31)) & 1);
+    }
+    for (int i = 0; i < extKeys.count(); i++)
+    {
+        if (extState[i]) out.insert(static_cast<int>(extKeys[i]), extState[i] == SLOT_ON);
+    }
+    return out;
+}
+
+QMap<int, bool> CANFilterTable::buses() const
+{
+    QMap<int, bool> out = otherBuses;
+    for (int bus = 0; bus < MASK_BUSES; bus++)
+    {
+        uint64_t bit = 1ull << bus;
+        if (busKnown & bit) out.insert(bus, (busOn & bit) != 0);
+    }
+    return out;
+}
+
+void CANFilterTable::clear()
+{
+    clearIds();
+    clearBuses();
+}
+
+void CANFilterTable::clearIds()
+{
+    memset(stdKnown, 0, sizeof(stdKnown));
+    memset(stdOn, 0, sizeof(stdOn));
+    extKeys.clear();
+    extState.clear();
+    extUsed = 0;
+    extShift = 32;
+    numIds = 0;
+    numIdsOff = 0;
+}
+
+void CANFilterTable::clearBuses()
+{
+    busKnown = 0;
+    busOn = 0;
+    otherBuses.clear();
+    numBuses = 0;
+    numBusesOff = 0;
+}
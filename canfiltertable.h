@@ -0,0 +1,111 @@
+#ifndef CANFILTERTABLE_H
+#define CANFILTERTABLE_H
+
+#include <QMap>
+#include <QVector>
+#include "can_structs.h"
+
+/*
+ * The ID and bus filters of the main frame list. These get checked for every frame that comes in and for every
+ * frame in the capture when filtering changes so they need to be cheap to look up:
+ * - IDs below 0x800 (all the standard ones) live in a pair of 2048 bit sets, one says the ID has been seen, the
+ *   other says it's switched on
+ * - anything higher goes in an open addressing hash set with linear probing
+ * - buses 0 to 63 are a pair of bitmasks. Anything outside that goes in a small map since it never happens
+ *
+ * Filters are keyed on the ID value alone, same as the filter list in the UI, so a standard and an extended frame
+ * with the same number share one entry.
+ *
+ * None of the lookups insert anything. Use setId / setBus for that.
+ */
+class CANFilterTable
+{
+public:
+    enum State
+    {
+        Unknown = -1,
+        Off = 0,
+        On = 1
+    };
+
+    CANFilterTable();
+
+    //whether a frame with this ID and bus passes. Unknown IDs and buses don't
+    bool accepts(uint32_t id, int bus) const { return idState(id) == On && busState(bus) == On; }
+    bool accepts(const CANFrameRecord &rec) const { return accepts(rec.frameId(), rec.bus); }
+    bool accepts(const CANFrame &frame) const { return accepts(frame.frameId(), frame.bus); }
+
+    State idState(uint32_t id) const
+    {
+        if (id < STD_IDS)
+        {
+            uint32_t bit = 1u << (id & 31);
+            if (!(stdKnown[id >> 5] & bit)) return Unknown;
+            return (stdOn[id >> 5] & bit) ? On : Off;
+        }
+        int slot = findSlot(id);
+        if (slot < 0 || !extState[slot]) return Unknown;
+        return (extState[slot] == SLOT_ON) ? On : Off;
+    }
+
+    State busState(int bus) const
+    {
+        if (bus >= 0 && bus < MASK_BUSES)
+        {
+            uint64_t bit = 1ull << bus;
+            if (!(busKnown & bit)) return Unknown;
+            return (busOn & bit) ? On : Off;
+        }
+        QMap<int, bool>::const_iterator it = otherBuses.constFind(bus);
+        if (it == otherBuses.constEnd()) return Unknown;
+        return it.value() ? On : Off;
+    }
+
+    void setId(uint32_t id, bool on); //adds the ID if it isn't there yet
+    void setBus(int bus, bool on);
+    void setAllIds(bool on);
+
+    int idCount() const { return numIds; }
+    int busCount() const { return numBuses; }
+    bool anyIdOff() const { return numIdsOff > 0; }
+    bool anyBusOff() const { return numBusesOff > 0; }
+
+    //in ID / bus order for the filter lists and the filter files
+    QMap<int, bool> ids() const;
+    QMap<int, bool> buses() const;
+
+    void clear();
+    void clearIds();
+    void clearBuses();
+
+private:
+    static constexpr uint32_t STD_IDS = 2048;
+    static constexpr int MASK_BUSES = 64;
+    static constexpr uint8_t SLOT_OFF = 1;
+    static constexpr uint8_t SLOT_ON = 2;
+
+    //slot holding id or the empty slot it would go in. -1 only when the table hasn't been allocated yet
+    int findSlot(uint32_t id) const
+    {
+        if (extKeys.isEmpty()) return -1;
+        uint32_t mask = static_cast<uint32_t>(extKeys.count() - 1);
+        uint32_t slot = (id * 0x9E3779B1u) >> extShift;
+        while (extState[slot] && extKeys[slot] != id) slot = (slot + 1) & mask;
+        return static_cast<int>(slot);
+    }
+    void growExt();
+
+    uint32_t stdKnown[STD_IDS / 32];
+    uint32_t stdOn[STD_IDS / 32];
+    QVector<uint32_t> extKeys;
+    QVector<uint8_t> extState; //0 = empty slot, otherwise SLOT_OFF / SLOT_ON
+    int extUsed;
+    int extShift; //32 - log2 of the table size, the hash is the top bits of a multiply
+    uint64_t busKnown;
+    uint64_t busOn;
+    QMap<int, bool> otherBuses;
+    int numIds, numIdsOff;
+    int numBuses, numBusesOff;
+};
+
+#endif // CANFILTERTABLE_H
@@ -4,30 +4,35 @@
 #include <QApplication>
 #include <QPalette>
 #include <QDateTime>
+#include <QDir>
 #include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#include <QVarLengthArray>
+#include <QRunnable>
+#include <algorithm>
+#include <functional>
 #include "utility.h"
+#include "framefileio.h"
+#include "pipelinetrace.h"
 
 CANFrameModel::~CANFrameModel()
 {
-    frames.clear();
+    //a prefetch in flight reads the model's settings and posts back to it
+    prefetchPool.clear();
+    prefetchPool.waitForDone();
+    FrameFileIO::closeSpillFile();
     filteredFrames.clear();
+    frames.clear();
     filters.clear();
-    busFilters.clear();
 }
 
 int CANFrameModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
-    if (filteredFrames.data())
-    {
-        int rows = filteredFrames.count();
-        return rows;
-    }
-
-     //just in case somehow data is invalid which I have seen before.
-    //But, this should not happen so issue a debugging message too
-    qDebug() << "Invalid data for filteredFrames. Returning 0.";
-    return 0;
+    //in overwrite mode new IDs are appended right away but only announced to the view once per GUI tick
+    if (overwriteDups) return qMin(overwriteVisibleRows, filteredFrames.count());
+    return filteredFrames.count();
 }
 
 int CANFrameModel::totalFrameCount()
@@ -61,32 +66,59 @@ CANFrameModel::CANFrameModel(QObject *parent)
     QSettings settings;
     preallocSize = settings.value("Main/MaximumFrames", maxFramesDefault).toInt();
 
-    //Each CANFrame object takes up 56 bytes and we're allocating two arrays here so take the
-    //# of pre-alloc frames and multiply by 112 to get the RAM usage. This is around 1GiB for the default.
+    //Frames are stored as packed 24 byte CANFrameRecord entries (FD payloads go to a side pool). The filtered list
+    //is just 4 byte keys into that and the per ID posting lists are another 4 so figure on 32 bytes per pre-alloc
+    //frame. This is around 320MiB for the default. It used to be two full copies at 56 bytes per frame plus a heap
+    //allocated payload for each one.
 
+    //frames is a ring capped at preallocSize. Once full the oldest frame gets overwritten by each new one
+    //which is O(1). It used to chop 5% off the front of a QVector which meant memmoving millions of frames.
+    frames.setMaxCapacity(preallocSize);
     //the goal is to prevent a reallocation from ever happening
     frames.reserve(preallocSize);
-    //this is pretty wasteful. We're storing all frames twice. It may be better for filteredFrames to be a list of pointers.
-    //Pointers take up 8 bytes instead of 56 so this is quite a savings for RAM usage. But, then filteredFrames would
-    //work differently from frames above so the two could not be used interchangeably. Still think about what can be done.
+    frames.setIndexed(true);
+    //periodic FD frames mostly repeat a few payloads. Those get one 64 byte slot each instead of one per frame
+    frames.setSharedPayloads(settings.value("Main/SharedPayloads", true).toBool());
+    filteredFrames.attachView(&frames);
     filteredFrames.reserve(preallocSize);
+    filteredSorted = false;
+    filteredStale = false;
 
     dbcHandler = DBCHandler::getReference();
     interpretFrames = false;
     overwriteDups = false;
+    changesOnly = false;
     filtersPersistDuringClear = false;
     useHexMode = true;
     timeStyle = TS_MICROS;
-    timeOffset = 0;
+    timingNormalized = false;
+    timeBase = 0;
+    jumpsScanned = 0;
+    jumpsLastStamp = 0;
     needFilterRefresh = false;
+    filterUsesDbc = false;
+    filterRevision = 0;
     lastUpdateNumFrames = 0;
+    retentionUs = 0;
+    retentionBytes = 0;
+    retentionSpill = false;
     timeFormat =  "MMM-dd HH:mm:ss.zzz";
     sortDirAsc = false;
+    sortColumn = -1;
     bytesPerLine = 8;
+    cellCache.setMaxCost(CANFRAMEMODEL_CELL_CACHE);
+    cacheGeneration.storeRelaxed(0);
+    cacheDbcRevision = DBCHandler::getRevision();
+    prefetchPool.setMaxThreadCount(1);
+    overwriteVisibleRows = 0;
+    overwriteIndexStale = false;
+    dirtyRowLow = 1;
+    dirtyRowHigh = 0;
 }
 
 void CANFrameModel::setBytesPerLine(int bpl)
 {
+    if (bytesPerLine != bpl) invalidateDisplayCache();
     bytesPerLine = bpl;
 }
 
@@ -97,6 +129,7 @@ void CANFrameModel::setHexMode(bool mode)
         this->beginResetModel();
         useHexMode = mode;
         Utility::decimalMode = !useHexMode;
+        invalidateDisplayCache();
         this->endResetModel();
     }
 }
@@ -108,6 +141,7 @@ void CANFrameModel::setTimeStyle(TimeStyle newStyle)
         this->beginResetModel();
         timeStyle = newStyle;
         Utility::timeStyle = newStyle;
+        invalidateDisplayCache();
         this->endResetModel();
     }
 }
@@ -120,6 +154,7 @@ void CANFrameModel::setInterpretMode(bool mode)
     {
         this->beginResetModel();
         interpretFrames = mode;
+        invalidateDisplayCache();
         this->endResetModel();
     }
 }
@@ -133,6 +168,7 @@ void CANFrameModel::setTimeFormat(QString format)
 {
     Utility::timeFormat = format;
     timeFormat = format;
+    invalidateDisplayCache();
     beginResetModel(); //reset model to show new time format
     endResetModel();
 }
@@ -148,7 +184,10 @@ void CANFrameModel::setIgnoreDBCColors(bool mode)
 }
 
 /*
- * Scan all frames for the smallest timestamp and offset all timestamps so that smallest one is at 0
+ * Shows the times from the first frame on, as if it came at 0, with any clock reset along the way closed up so time
+ * keeps going forward. Nothing in the store gets rewritten: saving and the other windows still go by the stamps the
+ * device sent, and a mapped capture stays mapped. Only the first frame is read here, rowStamp() finds the resets as
+ * far as it's asked to. Lasts until the frames are cleared.
 */
 void CANFrameModel::normalizeTiming()
 {
@@ -158,43 +197,115 @@ void CANFrameModel::normalizeTiming()
         mutex.unlock();
         return;
     }
-    timeOffset = frames[0].timeStamp().microSeconds();
-    qint64 prevStamp = 0;
+    timingNormalized = true;
+    timeBase = frames.record(0).timestamp;
+    resetTimeJumps();
+
+    //the text made from the old stamps is out of date, as is any sort on them
+    sortColumn = -1;
+    invalidateDisplayCache();
+    this->beginResetModel();
+    this->endResetModel();
+
+    mutex.unlock();
+}
+
+void CANFrameModel::resetTimeJumps()
+{
+    timeJumps.clear();
+    jumpsScanned = frames.count() ? frames.sequenceOf(0) : 0;
+    jumpsLastStamp = frames.count() ? frames.record(0).timestamp : 0;
+}
+
+uint64_t CANFrameModel::rowStamp(int row) const
+{
+    return frameStamp(filteredFrames.sourceRow(row));
+}
+
+uint64_t CANFrameModel::frameStamp(int idx) const
+{
+    if (idx < 0 || idx >= frames.count()) return 0;
+    if (!timingNormalized) return frames.record(idx).timestamp;
 
-    //find the absolute lowest timestamp in the whole time. Needed because maybe timestamp was reset in the middle.
-    for (int j = 0; j < frames.count(); j++)
+    //carry the search for resets on up to this frame. A frame's jump only depends on the ones before it so what
+    //was already shown never changes
+    quint64 first = frames.sequenceOf(0);
+    if (jumpsScanned < first)
     {
-        if (frames[j].timeStamp().microSeconds() < timeOffset) timeOffset = frames[j].timeStamp().microSeconds();
+        //the frames it had got to were evicted since, carry on from the oldest one left
+        jumpsScanned = first;
+        jumpsLastStamp = frames.record(0).timestamp;
     }
-
-    for (int i = 0; i < frames.count(); i++)
+    int64_t adjust = timeJumps.isEmpty() ? 0 : timeJumps.last().adjust;
+    for (int i = static_cast<int>(jumpsScanned - first); i <= idx; i++)
     {
-        qint64 thisStamp = frames[i].timeStamp().microSeconds() - timeOffset;
-        if (thisStamp <= prevStamp)
+        uint64_t stamp = frames.record(i).timestamp;
+        if (stamp + CANFRAMEMODEL_CLOCK_RESET_US < jumpsLastStamp)
         {
-            timeOffset -= prevStamp;
+            adjust += static_cast<int64_t>(jumpsLastStamp - stamp);
+            timeJumps.append({frames.sequenceOf(i), adjust});
         }
-        frames[i].setTimeStamp(QCanBusFrame::TimeStamp(0, thisStamp));
-    }
-
-    this->beginResetModel();
-    for (int i = 0; i < filteredFrames.count(); i++)
-    {
-        filteredFrames[i].setTimeStamp(QCanBusFrame::TimeStamp(0, filteredFrames[i].timeStamp().microSeconds() - timeOffset));
+        jumpsLastStamp = stamp;
+        jumpsScanned = frames.sequenceOf(i) + 1;
     }
-    this->endResetModel();
 
-    mutex.unlock();
+    //the newest jump at or before this frame. Nearly always there are none
+    quint64 seq = frames.sequenceOf(idx);
+    auto it = std::upper_bound(timeJumps.constBegin(), timeJumps.constEnd(), seq,
+                               [](quint64 s, const TimeJump &jump) { return s < jump.sequence; });
+    adjust = (it == timeJumps.constBegin()) ? 0 : (it - 1)->adjust;
+    int64_t stamp = static_cast<int64_t>(frames.record(idx).timestamp) + adjust - static_cast<int64_t>(timeBase);
+    return (stamp > 0) ? static_cast<uint64_t>(stamp) : 0;
 }
 
 void CANFrameModel::setOverwriteMode(bool mode)
 {
     beginResetModel();
     overwriteDups = mode;
-    recalcOverwrite();
+    invalidateDisplayCache(); //the time column turns into time deltas and back
+    if (mode) recalcOverwrite();
+    else
+    {
+        //the per ID rows are no use anymore, back to every frame that passes the filters
+        mutex.lock();
+        rebuildFiltered();
+        overwriteInfo.clear();
+        mutex.unlock();
+    }
     endResetModel();
 }
 
+void CANFrameModel::setChangesOnlyMode(bool mode)
+{
+    if (mode == changesOnly) return;
+    changesOnly = mode;
+    //the table only keeps up while the mode is on, rebuilding fills it in from the whole capture again
+    if (!mode)
+    {
+        mutex.lock();
+        changeTable.reset();
+        mutex.unlock();
+    }
+    if (!overwriteDups) sendRefresh();
+}
+
+void CANFrameModel::setChangeIgnoreMask(const QByteArray &mask)
+{
+    mutex.lock();
+    changeTable.setIgnoreMask(mask);
+    mutex.unlock();
+    if (changesOnly && !overwriteDups) sendRefresh();
+}
+
+void CANFrameModel::setChangeIgnoreMasks(const QHash<uint32_t, QByteArray> &masks)
+{
+    mutex.lock();
+    changeTable.clearIdMasks();
+    for (auto iter = masks.constBegin(); iter != masks.constEnd(); ++iter) changeTable.setIgnoreMask(iter.key(), iter.value());
+    mutex.unlock();
+    if (changesOnly && !overwriteDups) sendRefresh();
+}
+
 void CANFrameModel::setClearMode(bool mode)
 {
     filtersPersistDuringClear = mode;
@@ -202,146 +313,384 @@ void CANFrameModel::setClearMode(bool mode)
 
 void CANFrameModel::setFilterState(unsigned int ID, bool state)
 {
-    if (!filters.contains(ID)) return;
-    filters[ID] = state;
-    sendRefresh();
+    CANFilterTable::State old = filters.idState(ID);
+    if (old == CANFilterTable::Unknown) return;
+    filters.setId(ID, state);
+    if (old == (state ? CANFilterTable::On : CANFilterTable::Off)) return;
+
+    //overwrite mode and sorted lists get rebuilt. Otherwise only this ID's frames go in or come out
+    if (overwriteDups || filteredSorted)
+    {
+        sendRefresh();
+        return;
+    }
+    QVector<CANFrameStore::IdInfo> lists;
+    for (const CANFrameStore::IdInfo &info : frames.idList())
+    {
+        if (info.id == ID && filters.busState(info.bus) == CANFilterTable::On) lists.append(info);
+    }
+    mergeFiltered(lists, state);
 }
 
 void CANFrameModel::setBusFilterState(unsigned int BusID, bool state)
 {
-    if (!busFilters.contains(BusID)) return;
-    busFilters[BusID] = state;
-    sendRefresh();
+    CANFilterTable::State old = filters.busState(static_cast<int>(BusID));
+    if (old == CANFilterTable::Unknown) return;
+    filters.setBus(static_cast<int>(BusID), state);
+    if (old == (state ? CANFilterTable::On : CANFilterTable::Off)) return;
+
+    if (overwriteDups || filteredSorted)
+    {
+        sendRefresh();
+        return;
+    }
+    QVector<CANFrameStore::IdInfo> lists;
+    for (const CANFrameStore::IdInfo &info : frames.idList())
+    {
+        if (info.bus == static_cast<int>(BusID) && filters.idState(info.id) == CANFilterTable::On) lists.append(info);
+    }
+    mergeFiltered(lists, state);
 }
 
-void CANFrameModel::setAllFilters(bool state)
+/*
+ * Put the frames of the given bus / ID pairs into filteredFrames or take them out, using the posting lists of
+ * frames. filteredFrames has to be in frame order for this. It's one merge pass over two sorted lists of rows
+ * instead of running every frame through the filters again.
+ */
+void CANFrameModel::mergeFiltered(const QVector<CANFrameStore::IdInfo> &lists, bool add)
 {
-    QMap<int, bool>::iterator it;
-    for (it = filters.begin(); it != filters.end(); ++it)
+    if (lists.isEmpty()) return;
+
+    mutex.lock();
+    pruneFiltered(true);
+
+    QVector<int> touched;
+    for (const CANFrameStore::IdInfo &info : lists) touched.append(frames.rowsOf(info.id, info.bus));
+    if (lists.count() > 1) std::sort(touched.begin(), touched.end());
+    if (add && filterExpression)
+    {
+        //rows the expression turns down stay out. They aren't in filteredFrames either so nothing has to come out
+        int kept = 0;
+        for (int row : qAsConst(touched))
+        {
+            if (passesFilters(row)) touched[kept++] = row;
+        }
+        touched.resize(kept);
+    }
+    if (add && changesOnly)
+    {
+        //whether a frame changed only depends on the frames of its own pair, so walking just these pairs again
+        //with the same masks picks out the same rows changeTable did
+        PayloadChangeTable walk = changeTable;
+        walk.reset();
+        int kept = 0;
+        for (int row : qAsConst(touched))
+        {
+            if (walk.update(frames.record(row), frames.payloadData(row))) touched[kept++] = row;
+        }
+        touched.resize(kept);
+    }
+
+    int count = filteredFrames.count();
+    QVector<quint32> merged;
+    merged.reserve(add ? count + touched.count() : count);
+    int t = 0;
+    for (int i = 0; i < count; i++)
     {
-        it.value() = state;
+        int row = filteredFrames.sourceRow(i);
+        while (t < touched.count() && touched.at(t) < row)
+        {
+            if (add) merged.append(frames.keyOf(touched.at(t)));
+            t++;
+        }
+        if (t < touched.count() && touched.at(t) == row)
+        {
+            t++;
+            if (!add) continue;
+        }
+        merged.append(filteredFrames.sourceKey(i));
     }
+    if (add)
+    {
+        for (; t < touched.count(); t++) merged.append(frames.keyOf(touched.at(t)));
+    }
+
+    beginResetModel();
+    filteredFrames.setKeys(merged);
+    sortColumn = -1;
+    overwriteInfo.clear();
+    lastUpdateNumFrames = 0;
+    endResetModel();
+    mutex.unlock();
+}
+
+void CANFrameModel::setAllFilters(bool state)
+{
+    filters.setAllIds(state);
+    sendRefresh();
+}
+
+bool CANFrameModel::setFilterExpression(const QString &text, QString &error)
+{
+    QSharedPointer<const FilterExpression> expr = FilterExpression::compile(text, &error);
+    if (!error.isEmpty()) return false;
+    mutex.lock();
+    filterExpression = expr;
+    filterExpressionText = expr ? expr->text() : QString();
+    filterUsesDbc = expr && expr->needsDbc();
+    filterRevision = DBCHandler::getRevision();
+    mutex.unlock();
     sendRefresh();
+    return true;
+}
+
+bool CANFrameModel::passesFilters(int idx)
+{
+    const CANFrameRecord &rec = frames.record(idx);
+    if (!filters.accepts(rec)) return false;
+    const FilterExpression *expr = currentExpression();
+    return !expr || expr->matches(rec, frames.payloadData(idx));
+}
+
+bool CANFrameModel::passesFilters(const CANFrame &frame)
+{
+    if (!filters.accepts(frame)) return false;
+    const FilterExpression *expr = currentExpression();
+    return !expr || expr->matches(frame);
+}
+
+//the expression holds on to DBC signals, so it gets compiled again once the DBC files change
+const FilterExpression *CANFrameModel::currentExpression()
+{
+    if (!filterExpression || !filterUsesDbc || filterRevision == DBCHandler::getRevision()) return filterExpression.data();
+    filterRevision = DBCHandler::getRevision();
+    QString error;
+    QSharedPointer<const FilterExpression> expr = FilterExpression::compile(filterExpressionText, &error);
+    if (!expr)
+    {
+        //a signal it used is gone. Nothing matches until the expression gets fixed instead of everything showing
+        qDebug() << "Filter expression no longer compiles:" << error;
+        expr = FilterExpression::compile("0");
+    }
+    filterExpression = expr;
+    return filterExpression.data();
 }
 
 /*
- * There is probably a more correct way to have done this but below are several functions that collectively implement
- * quicksort on the columns and interpret the columns numerically. But, correct or not, this implementation is quite fast
- * and sorts the columns properly.
+ * Sorting interprets the columns numerically. Each row's sort key is pulled out once, then a list of row numbers is
+ * stable sorted by those keys in chunks spread across the cores and the chunks merged. Only filteredFrames' keys
+ * get rearranged at the end, the frames themselves never move.
 */
-uint64_t CANFrameModel::getCANFrameVal(QVector<CANFrame> *frames, int row, Column col)
+uint64_t CANFrameModel::getCANFrameVal(int row, Column col) const
+{
+    if (row >= filteredFrames.count()) return 0;
+    switch (col)
+    {
+    case Column::TimeStamp:
+        if (overwriteDups && row < overwriteInfo.count()) return overwriteInfo.at(row).timedelta;
+        if (timingNormalized) return rowStamp(row);
+        break;
+    case Column::Remote:
+        if (overwriteDups && row < overwriteInfo.count()) return overwriteInfo.at(row).frameCount;
+        break;
+    default:
+        break;
+    }
+    return recordValue(filteredFrames, row, col);
+}
+
+//works straight off the packed record. No CANFrame gets built per comparison
+uint64_t CANFrameModel::recordValue(const CANFrameStore &store, int row, Column col)
 {
     uint64_t temp = 0;
-    if (row >= frames->count()) return 0;
-    CANFrame frame = frames->at(row);
+    const CANFrameRecord &rec = store.record(row);
+    const uint8_t *payload;
     switch (col)
     {
     case Column::TimeStamp:
-        if (overwriteDups) return frame.timedelta;
-        return frame.timeStamp().microSeconds();
+        return rec.timestamp;
     case Column::FrameId:
-        return frame.frameId();
+        return rec.frameId();
     case Column::Extended:
-        if (frame.hasExtendedFrameFormat()) return 1;
+        if (rec.isExtended()) return 1;
         return 0;
     case Column::Remote:
-        if (overwriteDups) return frame.frameCount;
-        if (frame.frameType() == QCanBusFrame::RemoteRequestFrame) return 1;
+        if (rec.type() == QCanBusFrame::RemoteRequestFrame) return 1;
         return 0;
     case Column::Direction:
-        if (frame.isReceived) return 1;
+        if (rec.isReceived()) return 1;
         return 0;
     case Column::Bus:
-        return static_cast<uint64_t>(frame.bus);
+        return static_cast<uint64_t>(rec.bus);
     case Column::Length:
-        return static_cast<uint64_t>(frame.payload().length());
+        return static_cast<uint64_t>(rec.len);
     case Column::ASCII: //sort both the same for now
     case Column::Data:
-        for (int i = 0; i < std::min(frame.payload().length(), 8); i++) temp += (static_cast<uint64_t>(frame.payload()[i]) << (56 - (8 * i)));
+        payload = store.payloadData(row);
+        for (int i = 0; i < std::min(static_cast<int>(rec.len), 8); i++) temp += (static_cast<uint64_t>(payload[i]) << (56 - (8 * i)));
         //qDebug() << temp;
         return temp;
+    case Column::Priority:
+        return rec.isExtended() ? CANIdParts::priority(rec.frameId()) : 0;
+    case Column::PGN:
+        return rec.isExtended() ? CANIdParts::j1939Pgn(rec.frameId()) : 0;
+    case Column::Source:
+        return rec.isExtended() ? CANIdParts::j1939Source(rec.frameId()) : 0;
+    case Column::Dest:
+        return rec.isExtended() ? CANIdParts::j1939Dest(rec.frameId()) : 0;
+    case Column::GMLanArb:
+        return rec.isExtended() ? CANIdParts::gmlanArbitrationId(rec.frameId()) : 0;
+    case Column::GMLanSender:
+        return rec.isExtended() ? CANIdParts::gmlanSenderId(rec.frameId()) : 0;
     case Column::NUM_COLUMN:
         return 0;
     }
     return 0;
 }
 
-void CANFrameModel::qSortCANFrameAsc(QVector<CANFrame> *frames, Column column, int lowerBound, int upperBound)
+namespace
 {
-    int p, i, j;
-    qDebug() << "Lower " << lowerBound << " Upper" << upperBound;
-    if (lowerBound < upperBound)
-    {
-        uint64_t piv = getCANFrameVal(frames, lowerBound + (upperBound - lowerBound) / 2, column);
-        i = lowerBound - 1;
-        j = upperBound + 1;
-        for (;;){
-            do {
-                i++;
-            } while ((i < upperBound) && getCANFrameVal(frames, i, column) < piv);
+//a bit of work for a thread pool. Pieces of a parallel sort, prefetching cell text
+class PoolTask : public QRunnable
+{
+public:
+    explicit PoolTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() override { task(); }
+private:
+    std::function<void()> task;
+};
+}
 
-            do
-            {
-                j--;
-            } while ((j > lowerBound) && getCANFrameVal(frames, j, column) > piv);
-            if (i < j) {
-                CANFrame temp = frames->at(i);
-                frames->replace(i, frames->at(j));
-                frames->replace(j, temp);
-            }
-            else {p = j; break;}
-        }
+//below this many rows it isn't worth starting threads
+#define PARALLEL_SORT_MIN   65536
+
+/*
+ * Stable sort of rows 0..n-1 by keys. Each thread sorts its own chunk and then neighbouring runs get merged in
+ * rounds, also in parallel. Merging keeps the left run's rows first on ties so the whole thing stays stable.
+ */
+static void parallelStableSort(QVector<int> &rows, const QVector<uint64_t> &keys, bool ascending)
+{
+    auto less = [&keys, ascending](int a, int b)
+    {
+        return ascending ? keys[a] < keys[b] : keys[a] > keys[b];
+    };
 
-        qSortCANFrameAsc(frames, column, lowerBound, p);
-        qSortCANFrameAsc(frames, column, p+1, upperBound);
+    int n = rows.count();
+    int threads = qMax(1, QThread::idealThreadCount());
+    if (n < PARALLEL_SORT_MIN || threads == 1)
+    {
+        std::stable_sort(rows.begin(), rows.end(), less);
+        return;
     }
-}
 
-void CANFrameModel::qSortCANFrameDesc(QVector<CANFrame> *frames, Column column, int lowerBound, int upperBound)
-{
-    int p, i, j;
-    qDebug() << "Lower " << lowerBound << " Upper" << upperBound;
-    if (lowerBound < upperBound)
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QVector<int> bounds;
+    for (int t = 0; t <= threads; t++) bounds.append(static_cast<int>(static_cast<qint64>(n) * t / threads));
+    int *data = rows.data();
+    for (int t = 0; t < threads; t++)
     {
-        uint64_t piv = getCANFrameVal(frames, lowerBound + (upperBound - lowerBound) / 2, column);
-        i = lowerBound - 1;
-        j = upperBound + 1;
-        for (;;){
-            do {
-                i++;
-            } while ((i < upperBound) && getCANFrameVal(frames, i, column) > piv);
+        int lo = bounds[t], hi = bounds[t + 1];
+        pool.start(new PoolTask([data, lo, hi, less]() { std::stable_sort(data + lo, data + hi, less); }));
+    }
+    pool.waitForDone();
 
-            do
+    QVector<int> scratch(n);
+    int *from = rows.data();
+    int *to = scratch.data();
+    while (bounds.count() > 2)
+    {
+        QVector<int> merged;
+        for (int r = 0; r + 1 < bounds.count(); r += 2)
+        {
+            int lo = bounds[r], mid = bounds[r + 1];
+            int hi = (r + 2 < bounds.count()) ? bounds[r + 2] : mid;
+            merged.append(lo);
+            pool.start(new PoolTask([from, to, lo, mid, hi, less]()
             {
-                j--;
-            } while ((j > lowerBound) && getCANFrameVal(frames, j, column) < piv);
-            if (i < j) {
-                CANFrame temp = frames->at(i);
-                frames->replace(i, frames->at(j));
-                frames->replace(j, temp);
-            }
-            else {p = j; break;}
+                std::merge(from + lo, from + mid, from + mid, from + hi, to + lo, less);
+            }));
         }
-
-        qSortCANFrameDesc(frames, column, lowerBound, p);
-        qSortCANFrameDesc(frames, column, p+1, upperBound);
+        merged.append(n);
+        pool.waitForDone();
+        bounds = merged;
+        std::swap(from, to);
     }
+    if (from != rows.data()) rows = scratch;
 }
 
 void CANFrameModel::sortByColumn(int column)
 {
+    mutex.lock();
     sortDirAsc = !sortDirAsc;
-    if (sortDirAsc) qSortCANFrameAsc(&filteredFrames, Column(column), 0, filteredFrames.count()-1);
-    else qSortCANFrameDesc(&filteredFrames, Column(column), 0, filteredFrames.count()-1);
+    int count = filteredFrames.count();
+    QVector<quint32> keys = filteredFrames.keys();
+    bool reorderInfo = overwriteDups && overwriteInfo.count() == count;
+
+    if (column == sortColumn)
+    {
+        //same column as last time and nothing has changed since, the other direction is just the reverse
+        std::reverse(keys.begin(), keys.end());
+        if (reorderInfo) std::reverse(overwriteInfo.begin(), overwriteInfo.end());
+    }
+    else
+    {
+        QVector<uint64_t> sortKeys(count);
+        for (int i = 0; i < count; i++) sortKeys[i] = getCANFrameVal(i, Column(column));
+        QVector<int> rows(count);
+        for (int i = 0; i < count; i++) rows[i] = i;
+        parallelStableSort(rows, sortKeys, sortDirAsc);
+
+        QVector<quint32> sorted(count);
+        for (int i = 0; i < count; i++) sorted[i] = keys.at(rows.at(i));
+        keys = sorted;
+        if (reorderInfo)
+        {
+            QVector<OverwriteInfo> info(count);
+            for (int i = 0; i < count; i++) info[i] = overwriteInfo.at(rows.at(i));
+            overwriteInfo = info;
+        }
+    }
 
-    mutex.lock();
     beginResetModel();
+    filteredFrames.setKeys(keys);
+    filteredSorted = true;
+    sortColumn = column;
+    if (overwriteDups) rebuildOverwriteIndex(); //rows moved around
+    overwriteVisibleRows = filteredFrames.count();
+    dirtyRowLow = 1;
+    dirtyRowHigh = 0;
     endResetModel();
     mutex.unlock();
 }
 
 //End of custom sorting code
 
+//Recreate the ID -> row lookup for overwrite mode from whatever is in filteredFrames right now.
+void CANFrameModel::rebuildOverwriteIndex()
+{
+    overwriteRows.clear();
+    overwriteRows.reserve(filteredFrames.count());
+    for (int i = 0; i < filteredFrames.count(); i++)
+    {
+        const CANFrameRecord &rec = filteredFrames.record(i);
+        overwriteRows.insert(CANFrameStore::idKey(rec.frameId(), rec.bus), i);
+    }
+    if (overwriteInfo.count() < filteredFrames.count()) overwriteInfo.resize(filteredFrames.count());
+    overwriteIndexStale = false;
+}
+
+void CANFrameModel::markRowDirty(int row)
+{
+    if (dirtyRowLow > dirtyRowHigh)
+    {
+        dirtyRowLow = dirtyRowHigh = row;
+        return;
+    }
+    if (row < dirtyRowLow) dirtyRowLow = row;
+    if (row > dirtyRowHigh) dirtyRowHigh = row;
+}
+
 void CANFrameModel::recalcOverwrite()
 {
     if (!overwriteDups) return; //no need to do a thing if mode is disabled
@@ -350,48 +699,79 @@ void CANFrameModel::recalcOverwrite()
 
     mutex.lock();
     beginResetModel();
-
-    //Look at the current list of frames and turn it into just a list of unique IDs
-    QHash<uint64_t, CANFrame> overWriteFrames;
-    uint64_t idAugmented; //id in lower 29 bits, bus number shifted up 29 bits
-    foreach(CANFrame frame, frames)
+    invalidateDisplayCache();
+
+    /*
+     * One row per bus / ID pair, its newest frame. The store keeps a list of rows per pair up to date as frames
+     * come in so that's just the end of each list, however big the capture. Only a filter expression, which
+     * could turn down any frame, still needs every frame looked at.
+     */
+    filteredFrames.attachView(&frames);
+    overwriteInfo.clear();
+    if (!currentExpression())
     {
-        if (frame.frameType() != frame.DataFrame) continue;
-
-        idAugmented = frame.frameId();
-        idAugmented = idAugmented + (frame.bus << 29ull);
-        if (filters[frame.frameId()] && busFilters[frame.bus])
+        const QVector<CANFrameStore::IdLatest> latest = frames.latestList(QCanBusFrame::DataFrame);
+        filteredFrames.reserve(latest.count());
+        for (const CANFrameStore::IdLatest &pair : latest)
         {
-            if (!overWriteFrames.contains(idAugmented))
-            {
-                frame.timedelta = 0;
-                frame.frameCount = 1;
-                overWriteFrames.insert(idAugmented, frame);
-            }
-            else
-            {
-                frame.timedelta = frame.timeStamp().microSeconds() - overWriteFrames[idAugmented].timeStamp().microSeconds();
-                frame.frameCount = overWriteFrames[idAugmented].frameCount + 1;
-                overWriteFrames[idAugmented] = frame;
-            }
+            if (!filters.accepts(pair.id, pair.bus)) continue;
+            OverwriteInfo info;
+            info.frameCount = static_cast<uint32_t>(pair.count);
+            info.timedelta = (pair.previous < 0) ? 0 : frames.record(pair.row).timestamp - frames.record(pair.previous).timestamp;
+            filteredFrames.appendKey(frames.keyOf(pair.row));
+            overwriteInfo.append(info);
         }
     }
-    //Then replace the old list of frames with just the unique list
-    //frames.clear();
-    //frames.append(overWriteFrames.values().toVector());
-    //frames.reserve(preallocSize);
+    else
+    {
+        //Only the index of the newest frame for each ID is tracked
+        struct LatestFrame
+        {
+            int index;
+            OverwriteInfo info;
+        };
+        QHash<uint64_t, LatestFrame> overWriteFrames;
+        uint64_t idAugmented;
+        for (int i = 0; i < frames.count(); i++)
+        {
+            const CANFrameRecord &rec = frames.record(i);
+            if (rec.type() != QCanBusFrame::DataFrame) continue;
 
-    filteredFrames.clear();
-    filteredFrames.append(overWriteFrames.values().toVector());
-    filteredFrames.reserve(preallocSize);
+            idAugmented = CANFrameStore::idKey(rec.frameId(), rec.bus);
+            if (passesFilters(i))
+            {
+                auto it = overWriteFrames.find(idAugmented);
+                if (it == overWriteFrames.end())
+                {
+                    LatestFrame latest;
+                    latest.index = i;
+                    latest.info.timedelta = 0;
+                    latest.info.frameCount = 1;
+                    overWriteFrames.insert(idAugmented, latest);
+                }
+                else
+                {
+                    it->info.timedelta = rec.timestamp - frames.record(it->index).timestamp;
+                    it->info.frameCount++;
+                    it->index = i;
+                }
+            }
+        }
 
-    /*for (int i = 0; i < frames.count(); i++)
-    {
-        if (filters[frames[i].frameId()] && busFilters[frames[i].bus])
+        filteredFrames.reserve(overWriteFrames.count());
+        for (const LatestFrame &latest : overWriteFrames)
         {
-            filteredFrames.append(frames[i]);
+            filteredFrames.appendKey(frames.keyOf(latest.index));
+            overwriteInfo.append(latest.info);
         }
-    }*/
+    }
+    filteredSorted = false;
+    filteredStale = false;
+    sortColumn = -1;
+    rebuildOverwriteIndex();
+    overwriteVisibleRows = filteredFrames.count();
+    dirtyRowLow = 1;
+    dirtyRowHigh = 0;
 
     endResetModel();
     mutex.unlock();
@@ -399,10 +779,8 @@ void CANFrameModel::recalcOverwrite()
 
 QVariant CANFrameModel::data(const QModelIndex &index, int role) const
 {
-    QString tempString;
     CANFrame thisFrame;
     static bool rowFlip = false;
-    QVariant ts;
 
     if (!index.isValid())
         return QVariant();
@@ -410,10 +788,32 @@ QVariant CANFrameModel::data(const QModelIndex &index, int role) const
     if (index.row() >= (filteredFrames.count()))
         return QVariant();
 
+    //the text columns are by far the most expensive part of painting so check for them before building the frame
+    Column col = Column(index.column());
+    quint64 cacheKey = 0;
+    bool cacheable = (role == Qt::DisplayRole) && isCachedColumn(col);
+    if (cacheable)
+    {
+        checkDisplayCache();
+        cacheKey = cellKey(filteredFrames.sourceKey(index.row()), col);
+        QString *cached = cellCache.object(cacheKey);
+        if (cached) return *cached;
+    }
+
     thisFrame = filteredFrames.at(index.row());
+    if (timingNormalized) thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(rowStamp(index.row()))));
+    if (overwriteDups && index.row() < overwriteInfo.count())
+    {
+        thisFrame.timedelta = overwriteInfo[index.row()].timedelta;
+        thisFrame.frameCount = overwriteInfo[index.row()].frameCount;
+    }
 
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(thisFrame.payload().constData());
-    int dataLen = thisFrame.payload().count();
+    if (cacheable)
+    {
+        QString text = formatCell(thisFrame, col, cellFormat());
+        cellCache.insert(cacheKey, new QString(text));
+        return text;
+    }
 
     if (role == Qt::BackgroundRole)
     {
@@ -430,23 +830,7 @@ QVariant CANFrameModel::data(const QModelIndex &index, int role) const
         else return QApplication::palette().color(QPalette::AlternateBase);
     }
 
-    if (role == Qt::TextAlignmentRole)
-    {
-        switch(Column(index.column()))
-        {
-        case Column::TimeStamp:
-            return Qt::AlignRight;
-        case Column::FrameId:
-        case Column::Direction:
-        case Column::Extended:
-        case Column::Bus:
-        case Column::Remote:
-        case Column::Length:
-            return Qt::AlignHCenter;
-        default:
-            return Qt::AlignLeft;
-        }
-    }
+    if (role == Qt::TextAlignmentRole) return static_cast<int>(columnAlignment(col));
 
     if (role == Qt::ForegroundRole)
     {
@@ -461,196 +845,428 @@ QVariant CANFrameModel::data(const QModelIndex &index, int role) const
         return QApplication::palette().color(QPalette::WindowText);
     }
 
-    if (role == Qt::DisplayRole) {
-        switch (Column(index.column()))
-        {
-        case Column::TimeStamp:            
-            //Reformatting the output a bit with custom code
-            if (overwriteDups)
-            {
-                if (timeStyle == TS_SECONDS) return QString::number(thisFrame.timedelta / 1000000.0, 'f', 5);
-                return QString::number(thisFrame.timedelta);
-            }
-            else ts = Utility::formatTimestamp(thisFrame.timeStamp().microSeconds());
-            if (ts.type() == QVariant::Double) return QString::number(ts.toDouble(), 'f', 5); //never scientific notation, 5 decimal places
-            if (ts.type() == QVariant::LongLong) return QString::number(ts.toLongLong()); //never scientific notion, all digits shown
-            if (ts.type() == QVariant::DateTime) return ts.toDateTime().toString(timeFormat); //custom set format for dates and times
-            return Utility::formatTimestamp(thisFrame.timeStamp().microSeconds());
-        case Column::FrameId:
-            return Utility::formatCANID(thisFrame.frameId(), thisFrame.hasExtendedFrameFormat());
-        case Column::Extended:
-            return QString::number(thisFrame.hasExtendedFrameFormat());
-        case Column::Remote:
-            if (!overwriteDups) return QString::number(thisFrame.frameType() == QCanBusFrame::RemoteRequestFrame);
-            return QString::number(thisFrame.frameCount);
-        case Column::Direction:
-            if (thisFrame.isReceived) return QString(tr("Rx"));
-            return QString(tr("Tx"));
-        case Column::Bus:
-            return QString::number(thisFrame.bus);
-        case Column::Length:
-            return QString::number(dataLen);
-        case Column::ASCII:
-            if (thisFrame.frameId() >= 0x7FFFFFF0ull)
-            {
-                tempString.append("MARK ");
-                tempString.append(QString::number(thisFrame.frameId() & 0x7));
-                return tempString;
-            }
-            if (thisFrame.frameType() == QCanBusFrame::DataFrame) {
-                if (dataLen < 0) dataLen = 0;
-                //if (dLen > 8) dLen = 8;
-                for (int i = 0; i < dataLen; i++)
-                {
-                    char byt = thisFrame.payload()[i];
-                    //0x20 through 0x7E are printable characters. Outside of that range they aren't. So use dots instead
-                    if (byt < 0x20) byt = 0x2E; //dot character
-                    if (byt > 0x7E) byt = 0x2E;
-                    tempString.append(QString::fromUtf8(&byt, 1));
-                    if (!((i+1) % bytesPerLine) && (i != (dataLen - 1))) tempString.append("\n");
-                }
-            }
-            if (thisFrame.frameType() == QCanBusFrame::ErrorFrame)
-            {
-                 tempString = "ERROR";
-            }
-            return tempString;
-        case Column::Data:
-            if (dataLen < 0) dataLen = 0;
-            //if (useHexMode) tempString.append("0x ");
-            if (thisFrame.frameType() == QCanBusFrame::RemoteRequestFrame) {
-                return tempString;
-            }
-            for (int i = 0; i < dataLen; i++)
-            {
-                if (useHexMode) tempString.append( QString::number(data[i], 16).toUpper().rightJustified(2, '0'));
-                else tempString.append(QString::number(data[i], 10));
-                if (!((i+1) % bytesPerLine) && (i != (dataLen - 1))) tempString.append("\n");
-                else tempString.append(" ");
-            }
-            if (thisFrame.frameType() == thisFrame.ErrorFrame)
-            {
-                if (thisFrame.error() & thisFrame.TransmissionTimeoutError) tempString.append("\nTX Timeout");
-                if (thisFrame.error() & thisFrame.LostArbitrationError) tempString.append("\nLost Arbitration");
-                if (thisFrame.error() & thisFrame.ControllerError) tempString.append("\nController Error");
-                if (thisFrame.error() & thisFrame.ProtocolViolationError) tempString.append("\nProtocol Violation");
-                if (thisFrame.error() & thisFrame.TransceiverError) tempString.append("\nTransceiver Error");
-                if (thisFrame.error() & thisFrame.MissingAcknowledgmentError) tempString.append("\nMissing ACK");
-                if (thisFrame.error() & thisFrame.BusOffError) tempString.append("\nBus OFF");
-                if (thisFrame.error() & thisFrame.BusError) tempString.append("\nBus ERR");
-                if (thisFrame.error() & thisFrame.ControllerRestartError) tempString.append("\nController restart err");
-                if (thisFrame.error() & thisFrame.UnknownError) tempString.append("\nUnknown error type");
-            }
-            //TODO: technically the actual returned bytes for an error frame encode some more info. Not interpreting it yet.
-
-            //now, if we're supposed to interpret the data and the DBC handler is loaded then use it
-            if ( (dbcHandler != nullptr) && interpretFrames && (thisFrame.frameType() == thisFrame.DataFrame) )
-            {
-                DBC_MESSAGE *msg = dbcHandler->findMessage(thisFrame);
-                if (msg != nullptr)
-                {
-                    tempString.append("   <" + msg->name + ">\n");
-                    if (msg->comment.length() > 1) tempString.append(msg->comment + "\n");
-                    for (int j = 0; j < msg->sigHandler->getCount(); j++)
-                    {                        
-                        QString sigString;
-                        DBC_SIGNAL* sig = msg->sigHandler->findSignalByIdx(j);
-
-                        if ( (sig->multiplexParent == nullptr) && sig->processAsText(thisFrame, sigString))
-                        {
-                            tempString.append(sigString);
-                            tempString.append("\n");
-                            if (sig->isMultiplexor)
-                            {
-                                qDebug() << "Multiplexor. Diving into the tree";
-                                tempString.append(sig->processSignalTree(thisFrame));
-                            }
-                        }
-                        else if (sig->isMultiplexed && overwriteDups) //wasn't in this exact frame but is in the message. Use cached value
-                        {
-                            bool isInteger = false;
-                            if (sig->valType == UNSIGNED_INT || sig->valType == SIGNED_INT) isInteger = true;
-                            tempString.append(sig->makePrettyOutput(sig->cachedValue.toDouble(), sig->cachedValue.toLongLong(), true, isInteger));
-                            tempString.append("\n");
-                        }
-                    }
-                }
-            }
-            return tempString;
-        default:
-            return tempString;
-        }
-    }
+    if (role == Qt::DisplayRole) return cellText(thisFrame, col, cellFormat());
 
     return QVariant();
 }
 
-QVariant CANFrameModel::headerData(int section, Qt::Orientation orientation,
-                                     int role) const
+CANFrameModel::CellFormat CANFrameModel::cellFormat() const
 {
-    if (role != Qt::DisplayRole)
-        return QVariant();
-
-    if (orientation == Qt::Horizontal)
-    {
-        switch (Column(section))
-        {
-        case Column::TimeStamp:
-            if (overwriteDups) return QString(tr("Time Delta"));
-            return QString(tr("Timestamp"));
-        case Column::FrameId:
-            return QString(tr("ID"));
-        case Column::Extended:
-            return QString(tr("Ext"));
-        case Column::Remote:
-            if (!overwriteDups) return QString(tr("RTR"));
-            return QString(tr("Cnt"));
-        case Column::Direction:
-            return QString(tr("Dir"));
-        case Column::Bus:
-            return QString(tr("Bus"));
-        case Column::Length:
-            return QString(tr("Len"));
-        case Column::ASCII:
-            return QString(tr("ASCII"));
-        case Column::Data:
-            return QString(tr("Data"));
-        default:
-            return QString("");
-        }
-    }
-
-    else
-        return QString::number(section + 1);
-
-    return QVariant();
+    CellFormat fmt;
+    fmt.hexMode = useHexMode;
+    fmt.interpret = (dbcHandler != nullptr) && interpretFrames;
+    fmt.overwrite = overwriteDups;
+    fmt.timeStyle = timeStyle;
+    fmt.timeFormat = timeFormat;
+    fmt.bytesPerLine = bytesPerLine;
+    return fmt;
 }
 
-bool CANFrameModel::any_filters_are_configured(void)
+QString CANFrameModel::cellText(const CANFrame &thisFrame, Column col, const CellFormat &fmt)
 {
-    for (auto const &val : filters)
+    switch (col)
     {
-        if (val == true)
-            continue;
-        else
-            return true;
+    case Column::Extended:
+        return QString::number(thisFrame.hasExtendedFrameFormat());
+    case Column::Remote:
+        if (!fmt.overwrite) return QString::number(thisFrame.frameType() == QCanBusFrame::RemoteRequestFrame);
+        return QString::number(thisFrame.frameCount);
+    case Column::Direction:
+        if (thisFrame.isReceived) return QString(tr("Rx"));
+        return QString(tr("Tx"));
+    case Column::Bus:
+        return QString::number(thisFrame.bus);
+    case Column::Length:
+        return QString::number(thisFrame.payload().count());
+    case Column::Priority:
+        if (!thisFrame.hasExtendedFrameFormat()) return QString();
+        return QString::number(CANIdParts::priority(thisFrame.frameId()));
+    case Column::PGN:
+        if (!thisFrame.hasExtendedFrameFormat()) return QString();
+        return Utility::formatHexNum(CANIdParts::j1939Pgn(thisFrame.frameId()));
+    case Column::Source:
+        if (!thisFrame.hasExtendedFrameFormat()) return QString();
+        return Utility::formatHexNum(CANIdParts::j1939Source(thisFrame.frameId()));
+    case Column::Dest:
+        if (!thisFrame.hasExtendedFrameFormat()) return QString();
+        return Utility::formatHexNum(CANIdParts::j1939Dest(thisFrame.frameId()));
+    case Column::GMLanArb:
+        if (!thisFrame.hasExtendedFrameFormat()) return QString();
+        return Utility::formatHexNum(CANIdParts::gmlanArbitrationId(thisFrame.frameId()));
+    case Column::GMLanSender:
+        if (!thisFrame.hasExtendedFrameFormat()) return QString();
+        return Utility::formatHexNum(CANIdParts::gmlanSenderId(thisFrame.frameId()));
+    default:
+        return formatCell(thisFrame, col, fmt);
     }
-    return false;
 }
 
-bool CANFrameModel::any_busfilters_are_configured(void)
+Qt::Alignment CANFrameModel::columnAlignment(Column col)
 {
-    for (auto const &val : busFilters)
+    switch(col)
     {
-        if (val == true)
-            continue;
-        else
-            return true;
-    }
-    return false;
-}
-
-
+    case Column::TimeStamp:
+        return Qt::AlignRight;
+    case Column::FrameId:
+    case Column::Direction:
+    case Column::Extended:
+    case Column::Bus:
+    case Column::Remote:
+    case Column::Length:
+    case Column::Priority:
+    case Column::PGN:
+    case Column::Source:
+    case Column::Dest:
+    case Column::GMLanArb:
+    case Column::GMLanSender:
+        return Qt::AlignHCenter;
+    default:
+        return Qt::AlignLeft;
+    }
+}
+
+/*
+ * Text for the timestamp, ID, ASCII and data columns. Only reads the frame and fmt, and the DBC handler when
+ * fmt.interpret is set, so it's safe to run off the GUI thread as long as interpret is off.
+ */
+QString CANFrameModel::formatCell(const CANFrame &thisFrame, Column col, const CellFormat &fmt)
+{
+    QString tempString;
+    char text[UTILITY_FORMAT_CHARS];
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(thisFrame.payload().constData());
+    int dataLen = thisFrame.payload().count();
+
+    switch (col)
+    {
+    case Column::TimeStamp:
+        //Reformatting the output a bit with custom code. Never scientific notation, 5 decimal places or all the digits
+        if (fmt.overwrite)
+        {
+            if (fmt.timeStyle == TS_SECONDS) return QLatin1String(text, Utility::writeFixed(text, static_cast<int64_t>(thisFrame.timedelta), 6, 5));
+            return QLatin1String(text, Utility::writeDecimal(text, thisFrame.timedelta));
+        }
+        //custom set format for dates and times
+        if (fmt.timeStyle == TS_CLOCK) return QDateTime::fromMSecsSinceEpoch(thisFrame.timeStamp().microSeconds() / 1000).toString(fmt.timeFormat);
+        return QLatin1String(text, Utility::writeTimestamp(text, thisFrame.timeStamp().microSeconds(), fmt.timeStyle));
+    case Column::FrameId:
+        return Utility::canIDText(text, thisFrame.frameId(), thisFrame.hasExtendedFrameFormat());
+    case Column::ASCII:
+        if (thisFrame.frameId() >= 0x7FFFFFF0ull)
+        {
+            tempString.append("MARK ");
+            tempString.append(QString::number(thisFrame.frameId() & 0x7));
+            return tempString;
+        }
+        if (thisFrame.frameType() == QCanBusFrame::DataFrame) {
+            if (dataLen < 0) dataLen = 0;
+            //if (dLen > 8) dLen = 8;
+            QVarLengthArray<char, 160> line(dataLen * 2);
+            char *out = line.data();
+            for (int i = 0; i < dataLen; i++)
+            {
+                char byt = static_cast<char>(data[i]);
+                //0x20 through 0x7E are printable characters. Outside of that range they aren't. So use dots instead
+                if (byt < 0x20) byt = 0x2E; //dot character
+                if (byt > 0x7E) byt = 0x2E;
+                *out++ = byt;
+                if (!((i+1) % fmt.bytesPerLine) && (i != (dataLen - 1))) *out++ = '\n';
+            }
+            tempString = QString::fromLatin1(line.data(), static_cast<int>(out - line.data()));
+        }
+        if (thisFrame.frameType() == QCanBusFrame::ErrorFrame)
+        {
+             tempString = "ERROR";
+        }
+        return tempString;
+    case Column::Data:
+        if (dataLen < 0) dataLen = 0;
+        //if (useHexMode) tempString.append("0x ");
+        if (thisFrame.frameType() == QCanBusFrame::RemoteRequestFrame) {
+            return tempString;
+        }
+        {
+            //the whole row goes into one buffer and becomes one QString, up to three digits and a separator a byte
+            QVarLengthArray<char, 320> line(dataLen * 4);
+            char *out = line.data();
+            for (int i = 0; i < dataLen; i++)
+            {
+                if (fmt.hexMode) out = Utility::writeByteAsHex(out, data[i]);
+                else out = Utility::writeDecimal(out, data[i]);
+                if (!((i+1) % fmt.bytesPerLine) && (i != (dataLen - 1))) *out++ = '\n';
+                else *out++ = ' ';
+            }
+            tempString = QString::fromLatin1(line.data(), static_cast<int>(out - line.data()));
+        }
+        if (thisFrame.frameType() == thisFrame.ErrorFrame)
+        {
+            if (thisFrame.error() & thisFrame.TransmissionTimeoutError) tempString.append("\nTX Timeout");
+            if (thisFrame.error() & thisFrame.LostArbitrationError) tempString.append("\nLost Arbitration");
+            if (thisFrame.error() & thisFrame.ControllerError) tempString.append("\nController Error");
+            if (thisFrame.error() & thisFrame.ProtocolViolationError) tempString.append("\nProtocol Violation");
+            if (thisFrame.error() & thisFrame.TransceiverError) tempString.append("\nTransceiver Error");
+            if (thisFrame.error() & thisFrame.MissingAcknowledgmentError) tempString.append("\nMissing ACK");
+            if (thisFrame.error() & thisFrame.BusOffError) tempString.append("\nBus OFF");
+            if (thisFrame.error() & thisFrame.BusError) tempString.append("\nBus ERR");
+            if (thisFrame.error() & thisFrame.ControllerRestartError) tempString.append("\nController restart err");
+            if (thisFrame.error() & thisFrame.UnknownError) tempString.append("\nUnknown error type");
+        }
+        //TODO: technically the actual returned bytes for an error frame encode some more info. Not interpreting it yet.
+
+        //now, if we're supposed to interpret the data and the DBC handler is loaded then use it
+        if (fmt.interpret && (thisFrame.frameType() == thisFrame.DataFrame) )
+        {
+            DBC_MESSAGE *msg = DBCHandler::getReference()->findMessage(thisFrame);
+            if (msg != nullptr)
+            {
+                tempString.append("   <" + msg->name + ">\n");
+                if (msg->comment.length() > 1) tempString.append(msg->comment + "\n");
+                for (int j = 0; j < msg->sigHandler->getCount(); j++)
+                {
+                    QString sigString;
+                    DBC_SIGNAL* sig = msg->sigHandler->findSignalByIdx(j);
+
+                    if ( (sig->multiplexParent == nullptr) && sig->processAsText(thisFrame, sigString))
+                    {
+                        tempString.append(sigString);
+                        tempString.append("\n");
+                        if (sig->isMultiplexor)
+                        {
+                            qDebug() << "Multiplexor. Diving into the tree";
+                            tempString.append(sig->processSignalTree(thisFrame));
+                        }
+                    }
+                    else if (sig->isMultiplexed && fmt.overwrite) //wasn't in this exact frame but is in the message. Use cached value
+                    {
+                        bool isInteger = false;
+                        if (sig->valType == UNSIGNED_INT || sig->valType == SIGNED_INT) isInteger = true;
+                        tempString.append(sig->makePrettyOutput(sig->cachedValue.toDouble(), sig->cachedValue.toLongLong(), true, isInteger));
+                        tempString.append("\n");
+                    }
+                }
+            }
+        }
+        return tempString;
+    default:
+        return tempString;
+    }
+}
+
+/*
+ * The decoded data column in overwrite mode fills in multiplexed signals from whatever the last frame carrying
+ * them said so it can change without the frame changing. That one is always done fresh.
+ */
+bool CANFrameModel::isCachedColumn(Column col) const
+{
+    switch (col)
+    {
+    case Column::TimeStamp:
+    case Column::FrameId:
+    case Column::ASCII:
+        return true;
+    case Column::Data:
+        return !(overwriteDups && interpretFrames);
+    default:
+        return false;
+    }
+}
+
+//DBC edits don't go through the model so notice them here instead
+void CANFrameModel::checkDisplayCache() const
+{
+    quint32 revision = DBCHandler::getRevision();
+    if (cacheDbcRevision == revision) return;
+    QSet<uint32_t> ids;
+    bool scoped = DBCHandler::changedSince(cacheDbcRevision, ids);
+    cacheDbcRevision = revision;
+    if (!interpretFrames) return; //without interpreting none of the cached text came from a DBC
+    messageLines.clear(); //keyed by message, a reloaded file brings all new ones
+    cacheGeneration.fetchAndAddRelaxed(1);
+    if (!scoped)
+    {
+        cellCache.clear();
+        return;
+    }
+    //a DBC file reloaded from disk only changed some IDs, the text made for the rest is still right
+    const QList<quint64> keys = cellCache.keys();
+    for (quint64 key : keys)
+    {
+        int row = frames.indexOfKey(static_cast<quint32>(key >> 4));
+        if (row < 0 || ids.contains(frames.record(row).frameId())) cellCache.remove(key);
+    }
+}
+
+void CANFrameModel::invalidateDisplayCache()
+{
+    cellCache.clear();
+    messageLines.clear();
+    cacheGeneration.fetchAndAddRelaxed(1);
+    prefetchPool.clear();
+    emit displayChanged();
+}
+
+/*
+ * The bytes take a line per bytesPerLine. Decoded, a message adds the same lines to every one of its frames (its
+ * name, comment and one per signal) so that's counted once per message. Multiplexed messages depend on the frame
+ * and frames that aren't plain data have their own extra lines, those count the lines of the actual text.
+ */
+int CANFrameModel::dataLines(int row) const
+{
+    if (row < 0 || row >= filteredFrames.count()) return 1;
+    CANFrame thisFrame = filteredFrames.at(row);
+    int lines = qMax(1, (thisFrame.payload().count() + bytesPerLine - 1) / bytesPerLine);
+    bool plain = thisFrame.frameType() == QCanBusFrame::DataFrame;
+    if (plain && (dbcHandler == nullptr || !interpretFrames)) return lines;
+
+    if (plain)
+    {
+        checkDisplayCache();
+        DBC_MESSAGE *msg = dbcHandler->findMessage(thisFrame);
+        if (msg == nullptr) return lines;
+        auto it = messageLines.constFind(msg);
+        if (it == messageLines.constEnd())
+        {
+            int extra = (msg->comment.length() > 1) ? 2 : 1; //the name goes on the last line of bytes
+            for (int j = 0; j < msg->sigHandler->getCount() && extra >= 0; j++)
+            {
+                DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(j);
+                if (sig->isMultiplexor || sig->isMultiplexed) extra = -1;
+                else extra++;
+            }
+            it = messageLines.insert(msg, extra);
+        }
+        if (it.value() >= 0) return lines + it.value();
+    }
+
+    return data(index(row, int(Column::Data)), Qt::DisplayRole).toString().count('\n') + 1;
+}
+
+/*
+ * Format the rows a couple of screens either side of first..last so scrolling finds them already in the cache.
+ * The frames are copied out here on the GUI thread, the worker only turns them into text and the results come
+ * back as a queued call so the cache itself is only ever touched from the GUI thread. Decoded data needs the DBC
+ * handler which isn't thread safe so with interpreting on the data column is left for data() to do.
+ */
+void CANFrameModel::prefetchRows(int first, int last)
+{
+    int rows = rowCount();
+    if (rows == 0 || first < 0 || last < first) return;
+    checkDisplayCache();
+
+    int span = (last - first + 1) * CANFRAMEMODEL_PREFETCH_PAGES;
+    int low = qMax(0, first - span);
+    int high = qMin(rows - 1, last + span);
+
+    CellFormat fmt = cellFormat();
+    QVector<Column> cols = {Column::TimeStamp, Column::FrameId, Column::ASCII};
+    if (!fmt.interpret && isCachedColumn(Column::Data)) cols.append(Column::Data);
+
+    QVector<QPair<quint32, CANFrame>> todo;
+    for (int row = low; row <= high; row++)
+    {
+        quint32 key = filteredFrames.sourceKey(row);
+        bool missing = false;
+        for (Column col : cols)
+        {
+            if (!cellCache.contains(cellKey(key, col))) missing = true;
+        }
+        if (!missing) continue;
+
+        CANFrame frame = filteredFrames.at(row);
+        if (timingNormalized) frame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(rowStamp(row))));
+        if (overwriteDups && row < overwriteInfo.count())
+        {
+            frame.timedelta = overwriteInfo[row].timedelta;
+            frame.frameCount = overwriteInfo[row].frameCount;
+        }
+        todo.append(qMakePair(key, frame));
+    }
+    if (todo.isEmpty()) return;
+
+    prefetchPool.clear(); //anything still waiting is for where the view used to be
+    quint32 generation = cacheGeneration.loadRelaxed();
+    fmt.interpret = false;
+    prefetchPool.start(new PoolTask([this, todo, cols, fmt, generation]()
+    {
+        QVector<QPair<quint64, QString>> done;
+        done.reserve(todo.count() * cols.count());
+        for (const QPair<quint32, CANFrame> &item : todo)
+        {
+            if (cacheGeneration.loadRelaxed() != generation) return;
+            for (Column col : cols) done.append(qMakePair(cellKey(item.first, col), formatCell(item.second, col, fmt)));
+        }
+        QMetaObject::invokeMethod(this, [this, done, generation]()
+        {
+            if (cacheGeneration.loadRelaxed() != generation) return;
+            for (const QPair<quint64, QString> &cell : done)
+            {
+                if (!cellCache.contains(cell.first)) cellCache.insert(cell.first, new QString(cell.second));
+            }
+        }, Qt::QueuedConnection);
+    }));
+}
+
+QVariant CANFrameModel::headerData(int section, Qt::Orientation orientation,
+                                     int role) const
+{
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    if (orientation == Qt::Horizontal) return columnTitle(Column(section), overwriteDups);
+    return QString::number(section + 1);
+}
+
+QString CANFrameModel::columnTitle(Column col, bool overwrite)
+{
+    switch (col)
+    {
+    case Column::TimeStamp:
+        if (overwrite) return QString(tr("Time Delta"));
+        return QString(tr("Timestamp"));
+    case Column::FrameId:
+        return QString(tr("ID"));
+    case Column::Extended:
+        return QString(tr("Ext"));
+    case Column::Remote:
+        if (!overwrite) return QString(tr("RTR"));
+        return QString(tr("Cnt"));
+    case Column::Direction:
+        return QString(tr("Dir"));
+    case Column::Bus:
+        return QString(tr("Bus"));
+    case Column::Length:
+        return QString(tr("Len"));
+    case Column::ASCII:
+        return QString(tr("ASCII"));
+    case Column::Data:
+        return QString(tr("Data"));
+    case Column::Priority:
+        return QString(tr("Prio"));
+    case Column::PGN:
+        return QString(tr("PGN"));
+    case Column::Source:
+        return QString(tr("SA"));
+    case Column::Dest:
+        return QString(tr("DA"));
+    case Column::GMLanArb:
+        return QString(tr("GM Arb ID"));
+    case Column::GMLanSender:
+        return QString(tr("GM Sender"));
+    default:
+        return QString("");
+    }
+}
+
+bool CANFrameModel::any_filters_are_configured(void)
+{
+    return filters.anyIdOff();
+}
+
+bool CANFrameModel::any_busfilters_are_configured(void)
+{
+    return filters.anyBusOff();
+}
+
+
 void CANFrameModel::addFrame(const CANFrame& frame, bool autoRefresh = false)
 {
     /*TODO: remove mutex */
@@ -658,29 +1274,22 @@ void CANFrameModel::addFrame(const CANFrame& frame, bool autoRefresh = false)
     CANFrame tempFrame;
     tempFrame = frame;
 
-    tempFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, tempFrame.timeStamp().microSeconds() - timeOffset));
-
     lastUpdateNumFrames++;
+    sortColumn = -1; //the new frame isn't in sorted order
 
     //if this ID isn't found in the filters list then add it and show it by default
-    if (!filters.contains(tempFrame.frameId()))
+    if (filters.idState(tempFrame.frameId()) == CANFilterTable::Unknown)
     {
         // if there are any filters already configured, leave the new filter disabled
-        if (any_filters_are_configured())
-            filters.insert(tempFrame.frameId(), false);
-        else
-            filters.insert(tempFrame.frameId(), true);
+        filters.setId(tempFrame.frameId(), !any_filters_are_configured());
         needFilterRefresh = true;
     }
 
     //if this BusID isn't found in the busFilters list then add it and show it by default
-    if (!busFilters.contains(tempFrame.bus))
+    if (filters.busState(tempFrame.bus) == CANFilterTable::Unknown)
     {
         // if there are any busFilters already configured, leave the new filter disabled
-        if (any_busfilters_are_configured())
-            busFilters.insert(tempFrame.bus, false);
-        else
-            busFilters.insert(tempFrame.bus, true);
+        filters.setBus(tempFrame.bus, !any_busfilters_are_configured());
         needFilterRefresh = true;
     }
 
@@ -688,13 +1297,15 @@ void CANFrameModel::addFrame(const CANFrame& frame, bool autoRefresh = false)
     {
         try
         {
-            frames.append(tempFrame);
+            storeFrame(tempFrame);
+            pruneFiltered(autoRefresh);
 
-            if (filters[tempFrame.frameId()] && busFilters[tempFrame.bus])
+            //every frame goes through the change table, filtered or not, so it always has the last of each pair
+            bool changed = !changesOnly || changeTable.update(tempFrame);
+            if (changed && passesFilters(tempFrame))
             {
                 if (autoRefresh) beginInsertRows(QModelIndex(), filteredFrames.count(), filteredFrames.count());
-                tempFrame.frameCount = 1;
-                filteredFrames.append(tempFrame);
+                filteredFrames.appendKey(frames.keyOf(frames.count() - 1));
                 if (autoRefresh) endInsertRows();
             }
         }
@@ -705,53 +1316,39 @@ void CANFrameModel::addFrame(const CANFrame& frame, bool autoRefresh = false)
     }
     else //yes, overwrite dups
     {
-        bool found = false;
-//        for (int i = 0; i < frames.count(); i++)
-//        {
-//            if ( (frames[i].frameId() == tempFrame.frameId()) && (frames[i].bus == tempFrame.bus) )
-//            {
-//                tempFrame.frameCount = frames[i].frameCount + 1;
-//                tempFrame.timedelta = tempFrame.timeStamp().microSeconds() - frames[i].timeStamp().microSeconds();
-//                frames.replace(i, tempFrame);
-//                found = true;
-//                break;
-//            }
-//        }
-        for (int i = 0; i < filteredFrames.count(); i++)
+        //hash lookup of the row holding this ID. Frames bulk inserted while in overwrite mode won't be in there
+        //so rebuild first if insertFrames has been at it. Looked up after storing since evicting the oldest
+        //frame can take its row away.
+        storeFrame(tempFrame);
+        if (overwriteIndexStale) rebuildOverwriteIndex();
+        uint64_t idAugmented = CANFrameStore::idKey(tempFrame.frameId(), tempFrame.bus);
+        QHash<uint64_t, int>::const_iterator it = overwriteRows.constFind(idAugmented);
+        if (it == overwriteRows.constEnd())
         {
-            if ( (filteredFrames[i].frameId() == tempFrame.frameId()) && (filteredFrames[i].bus == tempFrame.bus) )
-            {
-                tempFrame.frameCount = filteredFrames[i].frameCount + 1;
-                tempFrame.timedelta = tempFrame.timeStamp().microSeconds() - filteredFrames[i].timeStamp().microSeconds();
-                filteredFrames.replace(i, tempFrame);
-                found = true;
-                break;
-            }
-        }
-        frames.append(tempFrame);
-        if (!found)
-        {
-            //frames.append(tempFrame);
-            if (filters[tempFrame.frameId()] && busFilters[tempFrame.bus])
+            if (passesFilters(tempFrame))
             {
                 if (autoRefresh) beginInsertRows(QModelIndex(), filteredFrames.count(), filteredFrames.count());
-                tempFrame.frameCount = 1;
-                tempFrame.timedelta = 0;
-                filteredFrames.append(tempFrame);
-                if (autoRefresh) endInsertRows();
+                OverwriteInfo info;
+                info.frameCount = 1;
+                info.timedelta = 0;
+                overwriteRows.insert(idAugmented, filteredFrames.count());
+                filteredFrames.appendKey(frames.keyOf(frames.count() - 1));
+                overwriteInfo.append(info);
+                if (autoRefresh)
+                {
+                    overwriteVisibleRows = filteredFrames.count();
+                    endInsertRows();
+                }
             }
         }
         else
         {
-            for (int j = 0; j < filteredFrames.count(); j++)
-            {
-                if ( (filteredFrames[j].frameId() == tempFrame.frameId()) && (filteredFrames[j].bus == tempFrame.bus) )
-                {
-                    if (autoRefresh) beginResetModel();
-                    filteredFrames.replace(j, tempFrame);
-                    if (autoRefresh) endResetModel();
-                }
-            }
+            int row = it.value();
+            overwriteInfo[row].frameCount++;
+            overwriteInfo[row].timedelta = tempFrame.timeStamp().microSeconds() - filteredFrames.record(row).timestamp;
+            filteredFrames.setKey(row, frames.keyOf(frames.count() - 1));
+            if (autoRefresh) emit dataChanged(index(row, 0), index(row, (int)Column::NUM_COLUMN - 1));
+            else markRowDirty(row);
         }
     }
 
@@ -759,39 +1356,58 @@ void CANFrameModel::addFrame(const CANFrame& frame, bool autoRefresh = false)
 }
 
 
-void CANFrameModel::addFrames(const CANConnection*, const QVector<CANFrame>& pFrames)
+void CANFrameModel::reportMemory(QVector<MemoryUsage> &out) const
 {
-    if(frames.length() > frames.capacity() * 0.99)
+    using MemoryAccounting::bytesOf;
+    qint64 cached = 0;
+    const QList<quint64> keys = cellCache.keys();
+    for (quint64 key : keys)
     {
-        mutex.lock();
-        qDebug() << "Frames count: " << frames.length() << " of " << frames.capacity() << " capacity, removing first " << (int)(frames.capacity() * 0.05) << " frames";
-        frames.remove(0, (int)(frames.capacity() * 0.05));
-        qDebug() << "Frames removed, new count: " << frames.length();
-        mutex.unlock();
+        const QString *text = cellCache.object(key);
+        if (text) cached += bytesOf(*text) + static_cast<qint64>(sizeof(quint64) + 4 * sizeof(void *));
     }
+    out.append({"Frame list", "frames", frames.memoryBytes()});
+    out.append({"Frame list", "filtered view", filteredFrames.memoryBytes()});
+    out.append({"Frame list", "overwrite mode tracking", bytesOf(overwriteInfo) + bytesOf(overwriteRows)});
+    out.append({"Frame list", "changes only tracking", changeTable.bytes()});
+    out.append({"Frame list", "formatted cell cache", cached});
+}
 
-    if(filteredFrames.length() > filteredFrames.capacity() * 0.99)
-    {
-        mutex.lock();
-        qDebug() << "filteredFrames count: " << filteredFrames.length() << " of " << filteredFrames.capacity() << " capacity, removing first " << (int)(filteredFrames.capacity() * 0.05) << " frames";
-        filteredFrames.remove(0, (int)(filteredFrames.capacity() * 0.05));
-        qDebug() << "filteredFrames removed, new count: " << filteredFrames.length();
-        mutex.unlock();
-    }
+qint64 CANFrameModel::purgeMemory()
+{
+    QVector<MemoryUsage> before;
+    reportMemory(before);
+    invalidateDisplayCache(); //filled in again for whatever is on screen next time round
+    frames.squeeze();
+    filteredFrames.squeeze();
+    overwriteInfo.squeeze();
+    QVector<MemoryUsage> after;
+    reportMemory(after);
+    qint64 freed = 0;
+    for (int i = 0; i < before.count(); i++) freed += before[i].bytes - after[i].bytes;
+    return freed;
+}
 
+void CANFrameModel::addFrames(const CANConnection*, const QVector<CANFrame>& pFrames)
+{
+    TRACE_SCOPE("CANFrameModel::addFrames");
+    //no need to trim anything here anymore. Once the stores fill up they overwrite their oldest frames as
+    //new ones get appended.
     foreach(const CANFrame& frame, pFrames)
     {
         addFrame(frame);
     }
-    if (overwriteDups) //if in overwrite mode we'll update every time frames come in
-    {
-        beginResetModel();
-        endResetModel();
-    }
+    mutex.lock();
+    if (retentionUs || retentionBytes) enforceRetention();
+    pruneFiltered(true);
+    mutex.unlock();
+    //Overwrite mode used to reset the whole model for every batch here. Now rows are updated in place and
+    //sendBulkRefresh tells the view about them once per GUI tick.
 }
 
 void CANFrameModel::sendRefresh()
 {
+    TRACE_SCOPE("CANFrameModel::sendRefresh");
     qDebug() << "Sending mass refresh";    
 
     if(overwriteDups)
@@ -800,27 +1416,224 @@ void CANFrameModel::sendRefresh()
     }
     else
     {
-        QVector<CANFrame> tempContainer;
-        int count = frames.count();
-        for (int i = 0; i < count; i++)
-        {
-            if (filters[frames[i].frameId()] && busFilters[frames[i].bus])
-            {
-                tempContainer.append(frames[i]);
-            }
-        }
-
+        //filteredFrames is only keys into frames so this doesn't copy any frames, mapped capture or not
         mutex.lock();
         beginResetModel();
-        filteredFrames.clear();
-        filteredFrames.append(tempContainer);
-        filteredFrames.reserve(preallocSize);
+        rebuildFiltered();
+        overwriteInfo.clear();
         lastUpdateNumFrames = 0;
         endResetModel();
         mutex.unlock();
     }
 }
 
+void CANFrameModel::rebuildFiltered()
+{
+    if (!changesOnly && rebuildFilteredByPairs(currentExpression())) return;
+    int count = frames.count();
+    QVector<quint32> keys;
+    keys.reserve(count);
+    if (changesOnly) changeTable.reset();
+    for (int i = 0; i < count; i++)
+    {
+        if (changesOnly && !changeTable.update(frames.record(i), frames.payloadData(i))) continue;
+        if (passesFilters(i)) keys.append(frames.keyOf(i));
+    }
+    filteredFrames.attachView(&frames);
+    filteredFrames.setKeys(keys);
+    filteredSorted = false;
+    filteredStale = false;
+    sortColumn = -1;
+}
+
+/*
+ * An expression like pgn == 0xFEF1 or sa in 0x00..0x0F holds or doesn't for whole bus / ID pairs, so for those the
+ * pairs get decided once each and only the rows of the ones that pass are taken, off the posting lists of frames,
+ * without reading any other frame. Only used when that's less than half the frames, past that sorting the rows
+ * back into frame order costs more than the plain pass. Changes only mode needs to see every frame so it's never
+ * used then. False if it didn't do it.
+ */
+bool CANFrameModel::rebuildFilteredByPairs(const FilterExpression *expr)
+{
+    if (!expr || !expr->readsIdOnly() || !frames.isIndexed()) return false;
+
+    QVector<CANFrameStore::IdInfo> pairs;
+    QVector<bool> checkRows; //parallel to pairs, the verdict depends on more than the pair
+    qint64 total = 0;
+    for (const CANFrameStore::IdInfo &info : frames.idList())
+    {
+        if (!filters.accepts(info.id, info.bus)) continue;
+        FilterExpression::Verdict verdict = expr->pairVerdict(info.id, info.bus);
+        if (verdict == FilterExpression::NoFrames) continue;
+        pairs.append(info);
+        checkRows.append(verdict == FilterExpression::SomeFrames);
+        total += info.count;
+    }
+    if (total * 2 > frames.count()) return false;
+
+    QVector<int> rows;
+    rows.reserve(static_cast<int>(total));
+    for (int p = 0; p < pairs.count(); p++)
+    {
+        for (int row : frames.rowsOf(pairs.at(p).id, pairs.at(p).bus))
+        {
+            if (!checkRows.at(p) || expr->matches(frames.record(row), frames.payloadData(row))) rows.append(row);
+        }
+    }
+    if (pairs.count() > 1) std::sort(rows.begin(), rows.end());
+
+    QVector<quint32> keys(rows.count());
+    for (int i = 0; i < rows.count(); i++) keys[i] = frames.keyOf(rows.at(i));
+    filteredFrames.attachView(&frames);
+    filteredFrames.setKeys(keys);
+    filteredSorted = false;
+    filteredStale = false;
+    sortColumn = -1;
+    return true;
+}
+
+//frames takes a new frame at the end and, once it's full, evicts its oldest one to make room
+void CANFrameModel::storeFrame(const CANFrame &frame)
+{
+    if (frames.isFull()) dropOldest();
+    frames.append(frame);
+}
+
+/*
+ * The oldest frame is about to be overwritten. In overwrite mode, if it's still the newest frame of its ID, that
+ * row goes since the ID isn't in the capture anymore. The normal filtered list catches up in pruneFiltered.
+ */
+void CANFrameModel::dropOldest()
+{
+    if (retentionSpill && (FrameFileIO::isSpilling() || openSpill())) FrameFileIO::spillFrame(&frames, 0);
+
+    const CANFrameRecord &rec = frames.record(0);
+    uint64_t key = CANFrameStore::idKey(rec.frameId(), rec.bus);
+    quint32 seqKey = frames.keyOf(0);
+    filteredStale = true;
+
+    if (!overwriteDups) return;
+    if (overwriteIndexStale) rebuildOverwriteIndex();
+    QHash<uint64_t, int>::const_iterator rowIt = overwriteRows.constFind(key);
+    if (rowIt == overwriteRows.constEnd()) return;
+    int row = rowIt.value();
+    if (filteredFrames.sourceKey(row) != seqKey) return;
+
+    bool visible = row < overwriteVisibleRows;
+    if (visible) beginRemoveRows(QModelIndex(), row, row);
+    filteredFrames.remove(row, 1);
+    if (row < overwriteInfo.count()) overwriteInfo.remove(row);
+    if (visible)
+    {
+        overwriteVisibleRows--;
+        endRemoveRows();
+    }
+    rebuildOverwriteIndex();
+    //everything below moved up one
+    if (row < filteredFrames.count())
+    {
+        markRowDirty(row);
+        markRowDirty(filteredFrames.count() - 1);
+    }
+}
+
+/*
+ * Retention for live captures. The front of the capture goes a whole block at a time, once even the newest frame of
+ * the block is older than the window or the capture is over its memory budget. Only the first block ever has to be
+ * looked at so this costs O(1) per frame, same as the ring overwriting its oldest frame. The size is an estimate:
+ * 32 bytes a frame (see the constructor) plus the FD payload slots in use.
+ * Only addFrames calls this. Files loaded with insertFrames are kept whole.
+ */
+void CANFrameModel::enforceRetention()
+{
+    while (frames.count() > CANFRAMEMODEL_RETENTION_BLOCK)
+    {
+        bool expired = false;
+        if (retentionUs)
+        {
+            uint64_t newest = frames.record(frames.count() - 1).timestamp;
+            uint64_t blockNewest = frames.record(CANFRAMEMODEL_RETENTION_BLOCK - 1).timestamp;
+            expired = newest > retentionUs && blockNewest < newest - retentionUs;
+        }
+        if (!expired && retentionBytes)
+        {
+            qint64 bytes = static_cast<qint64>(frames.count()) * 32 + static_cast<qint64>(frames.payloadSlots()) * CANFrameRecord::MAX_BYTES;
+            expired = bytes > retentionBytes;
+        }
+        if (!expired) break;
+
+        for (int i = 0; i < CANFRAMEMODEL_RETENTION_BLOCK; i++)
+        {
+            dropOldest();
+            frames.remove(0, 1);
+        }
+    }
+}
+
+//evicted frames go to a new log in the load/save directory, named for when it was started
+bool CANFrameModel::openSpill()
+{
+    QSettings settings;
+    QString dir = settings.value("FileIO/LoadSaveDirectory", QDir::homePath()).toString();
+    QString filename = dir + "/SavvyCAN-dropped-" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".scb";
+    if (FrameFileIO::openSpillFile(filename)) return true;
+    qDebug() << "Could not open" << filename << "to save dropped frames to. Not saving them";
+    retentionSpill = false;
+    return false;
+}
+
+void CANFrameModel::setRetention(int seconds, int megabytes, bool spill)
+{
+    mutex.lock();
+    retentionUs = static_cast<uint64_t>(qMax(seconds, 0)) * 1000000ull;
+    retentionBytes = static_cast<qint64>(qMax(megabytes, 0)) * 1024 * 1024;
+    retentionSpill = spill;
+    //the log is opened when the first frame has to go so turning this on doesn't leave empty files around
+    if (!spill) FrameFileIO::closeSpillFile();
+    mutex.unlock();
+}
+
+/*
+ * Take out the filtered rows whose frames have been evicted. In frame order they're all at the front which is
+ * cheap to check every time, and the view is told about just those rows. After a sort they could be anywhere so
+ * that full pass only happens when force is set, once per batch instead of once per frame, and resets the model.
+ */
+void CANFrameModel::pruneFiltered(bool force)
+{
+    if (!filteredStale || overwriteDups) return;
+    if (filteredSorted && !force) return;
+    if (!filteredSorted)
+    {
+        int stale = 0;
+        while (stale < filteredFrames.count() && frames.indexOfKey(filteredFrames.sourceKey(stale)) < 0) stale++;
+        if (stale > 0) beginRemoveRows(QModelIndex(), 0, stale - 1);
+        filteredFrames.pruneView(true);
+        if (stale > 0) endRemoveRows();
+    }
+    else
+    {
+        beginResetModel();
+        filteredFrames.pruneView(false);
+        endResetModel();
+    }
+    filteredStale = false;
+}
+
+//only the text changes unless the filter expression decodes signals, then which frames pass can change as well
+void CANFrameModel::redecode()
+{
+    mutex.lock();
+    bool refilter = filterExpression && filterUsesDbc;
+    mutex.unlock();
+    if (refilter)
+    {
+        sendRefresh();
+        return;
+    }
+    int rows = rowCount();
+    if (rows > 0) emit dataChanged(index(0, 0), index(rows - 1, (int)Column::NUM_COLUMN - 1));
+}
+
 void CANFrameModel::sendRefresh(int pos)
 {
     beginInsertRows(QModelIndex(), pos, pos);
@@ -835,13 +1648,41 @@ int CANFrameModel::sendBulkRefresh()
     //int num = filteredFrames.count() - lastUpdateNumFrames;
     if (lastUpdateNumFrames <= 0) return 0;
 
+    if (overwriteDups)
+    {
+        //one coalesced notification per tick. Newly seen IDs get inserted at the bottom and rows that changed
+        //get a single dataChanged over their range. Scroll position and selection survive this unlike a reset.
+        mutex.lock();
+        int newCount = filteredFrames.count();
+        if (newCount > overwriteVisibleRows)
+        {
+            beginInsertRows(QModelIndex(), overwriteVisibleRows, newCount - 1);
+            overwriteVisibleRows = newCount;
+            endInsertRows();
+        }
+        if (dirtyRowLow <= dirtyRowHigh)
+        {
+            int high = qMin(dirtyRowHigh, overwriteVisibleRows - 1);
+            if (high >= dirtyRowLow) emit dataChanged(index(dirtyRowLow, 0), index(high, (int)Column::NUM_COLUMN - 1));
+            dirtyRowLow = 1;
+            dirtyRowHigh = 0;
+        }
+        int num = lastUpdateNumFrames;
+        lastUpdateNumFrames = 0;
+        mutex.unlock();
+        return num;
+    }
+
     if (lastUpdateNumFrames == 0 && !overwriteDups) return 0;
     //if (filteredFrames.count() == 0) return 0;
 
     //qDebug() << "Bulk refresh of " << lastUpdateNumFrames;
 
+    mutex.lock();
+    pruneFiltered(true); //announces its own removals so it can't go inside the reset
     beginResetModel();
     endResetModel();
+    mutex.unlock();
 
     int num = lastUpdateNumFrames;
     lastUpdateNumFrames = 0;
@@ -853,12 +1694,24 @@ void CANFrameModel::clearFrames()
 {
     mutex.lock();
     this->beginResetModel();
+    filteredFrames.attachView(&frames);
     frames.clear();
-    filteredFrames.clear();
+    invalidateDisplayCache(); //keys start over from 0
+    timingNormalized = false;
+    resetTimeJumps();
+    filteredSorted = false;
+    filteredStale = false;
+    sortColumn = -1;
+    overwriteInfo.clear();
+    overwriteRows.clear();
+    overwriteVisibleRows = 0;
+    overwriteIndexStale = false;
+    dirtyRowLow = 1;
+    dirtyRowHigh = 0;
+    changeTable.reset();
     if(filtersPersistDuringClear == false)
     {
         filters.clear();
-        busFilters.clear();
     }
     frames.reserve(preallocSize);
     filteredFrames.reserve(preallocSize);
@@ -882,25 +1735,29 @@ void CANFrameModel::insertFrames(const QVector<CANFrame> &newFrames)
     //beginResetModel();
     mutex.lock();
     int insertedFiltered = 0;
+    sortColumn = -1;
     for (int i = 0; i < newFrames.count(); i++)
     {
-        frames.append(newFrames[i]);
-        if (!filters.contains(newFrames[i].frameId()))
+        storeFrame(newFrames[i]);
+        if (filters.idState(newFrames[i].frameId()) == CANFilterTable::Unknown)
         {
-            filters.insert(newFrames[i].frameId(), true);
+            filters.setId(newFrames[i].frameId(), true);
             needFilterRefresh = true;
         }
-        if (filters[newFrames[i].frameId()])
+        if (filters.busState(newFrames[i].bus) == CANFilterTable::Unknown)
         {
-            busFilters.insert(newFrames[i].bus, true);
+            filters.setBus(newFrames[i].bus, true);
             needFilterRefresh = true;
         }
-        if (filters[newFrames[i].frameId()] && busFilters[newFrames[i].bus])
+        if (changesOnly && !overwriteDups && !changeTable.update(newFrames[i])) continue;
+        if (passesFilters(newFrames[i]))
         {
             insertedFiltered++;
-            filteredFrames.append(newFrames[i]);
+            filteredFrames.appendKey(frames.keyOf(frames.count() - 1));
+            if (overwriteDups) overwriteIndexStale = true;
         }
     }
+    pruneFiltered(true);
     lastUpdateNumFrames = newFrames.count();
     mutex.unlock();
     //endResetModel();
@@ -909,19 +1766,135 @@ void CANFrameModel::insertFrames(const QVector<CANFrame> &newFrames)
     if (needFilterRefresh) emit updatedFiltersList();
 }
 
+/*
+ * Show a binary capture without loading it. The frame list becomes a view of the mapped file and rows are only
+ * turned into CANFrames as the view asks for them. One pass over the records is still needed to fill in the ID
+ * and bus filter lists (and by the store to index it) but that only reads the headers.
+ */
+bool CANFrameModel::loadMappedFile(const QString &filename)
+{
+    QSharedPointer<MappedCapture> capture(new MappedCapture);
+    if (!capture->open(filename)) return false;
+    if (capture->isDamaged()) qDebug() << filename << "is damaged. Only showing the frames before the bad block";
+
+    clearFrames();
+
+    mutex.lock();
+    beginResetModel();
+    frames.attach(capture);
+    for (int i = 0; i < frames.count(); i++)
+    {
+        const CANFrameRecord &rec = frames.record(i);
+        if (filters.idState(rec.frameId()) == CANFilterTable::Unknown) filters.setId(rec.frameId(), true);
+        if (filters.busState(rec.bus) == CANFilterTable::Unknown) filters.setBus(rec.bus, true);
+    }
+    needFilterRefresh = true;
+    mutex.unlock();
+
+    endResetModel();
+    sendRefresh();
+    lastUpdateNumFrames = frames.count();
+
+    emit updatedFiltersList();
+    return true;
+}
+
+void CANFrameModel::loadWorkspaceFrames(QSharedPointer<const MappedCapture> capture, const CANFrameStore::SavedIndex &index,
+                                        const QMap<int, bool> &idFilters, const QMap<int, bool> &busFilters)
+{
+    clearFrames();
+
+    mutex.lock();
+    beginResetModel();
+    frames.attach(capture, index);
+    for (QMap<int, bool>::const_iterator it = idFilters.constBegin(); it != idFilters.constEnd(); ++it)
+        filters.setId(static_cast<uint32_t>(it.key()), it.value());
+    for (QMap<int, bool>::const_iterator it = busFilters.constBegin(); it != busFilters.constEnd(); ++it)
+        filters.setBus(it.key(), it.value());
+    //anything the saved filters somehow don't know about gets shown, same as a fresh load. The index has every pair
+    for (const CANFrameStore::IdInfo &info : frames.idList())
+    {
+        if (filters.idState(info.id) == CANFilterTable::Unknown) filters.setId(info.id, true);
+        if (filters.busState(info.bus) == CANFilterTable::Unknown) filters.setBus(info.bus, true);
+    }
+    needFilterRefresh = true;
+    mutex.unlock();
+
+    endResetModel();
+    sendRefresh();
+    lastUpdateNumFrames = frames.count();
+
+    emit updatedFiltersList();
+}
+
+/*
+ * Row of the frame list, as shown, of the newest frame with this ID at or before timestamp (in seconds). The store's
+ * time index gets there in O(log n). -1 if there's no such frame or it's filtered out.
+ */
 int CANFrameModel::getIndexFromTimeID(unsigned int ID, double timestamp)
 {
-    int bestIndex = -1;
     int64_t intTimeStamp = static_cast<int64_t> (timestamp * 1000000l);
-    for (int i = 0; i < frames.count(); i++)
+    if (intTimeStamp < 0) return -1;
+    int idx = frames.lastRowAtTime(ID, -1, static_cast<uint64_t>(intTimeStamp));
+    if (idx < 0) return -1;
+    return rowOfFrame(idx);
+}
+
+//row of the frame list, as shown, of the frame with this store sequence number. -1 if it's gone or filtered out
+int CANFrameModel::getIndexFromSequence(quint64 sequence)
+{
+    int idx = frames.indexOfSequence(sequence);
+    if (idx < 0) return -1;
+    return rowOfFrame(idx);
+}
+
+//the last frame at or before stamp by way of the time index or, if the filters hide it, the next one shown
+int CANFrameModel::getIndexFromTime(uint64_t stamp)
+{
+    if (filteredFrames.count() == 0) return -1;
+    int idx = std::max(0, frames.lastRowAtTime(stamp));
+    if (overwriteDups || filteredSorted) return rowOfFrame(idx);
+
+    int lo = 0, hi = filteredFrames.count();
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (filteredFrames.sourceRow(mid) < idx) lo = mid + 1;
+        else hi = mid;
+    }
+    return std::min(lo, filteredFrames.count() - 1);
+}
+
+//which row of filteredFrames shows frames[idx]. In overwrite mode that's the row of its ID
+int CANFrameModel::rowOfFrame(int idx)
+{
+    if (overwriteDups)
+    {
+        if (overwriteIndexStale) rebuildOverwriteIndex();
+        const CANFrameRecord &rec = frames.record(idx);
+        return overwriteRows.value(CANFrameStore::idKey(rec.frameId(), rec.bus), -1);
+    }
+
+    if (filteredSorted)
     {
-        if ((frames[i].frameId() == ID))
+        quint32 key = frames.keyOf(idx);
+        for (int i = 0; i < filteredFrames.count(); i++)
         {
-            if (frames[i].timeStamp().microSeconds() <= intTimeStamp) bestIndex = i;
-            else break; //drop out of loop as soon as we pass the proper timestamp
+            if (filteredFrames.sourceKey(i) == key) return i;
         }
+        return -1;
+    }
+
+    //otherwise the rows are in frame order
+    int lo = 0, hi = filteredFrames.count();
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (filteredFrames.sourceRow(mid) < idx) lo = mid + 1;
+        else hi = mid;
     }
-    return bestIndex;
+    if (lo < filteredFrames.count() && filteredFrames.sourceRow(lo) == idx) return lo;
+    return -1;
 }
 
 void CANFrameModel::loadFilterFile(QString filename)
@@ -933,8 +1906,7 @@ void CANFrameModel::loadFilterFile(QString filename)
     if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
         return;
 
-    filters.clear();
-    busFilters.clear();
+    filters.clearIds(); //the file only has IDs, the bus filters stay as they are
 
     while (!inFile->atEnd()) {
         line = inFile->readLine().simplified();
@@ -942,8 +1914,7 @@ void CANFrameModel::loadFilterFile(QString filename)
         {
             QList<QByteArray> tokens = line.split(',');
             ID = tokens[0].toInt(nullptr, 16);
-            if (tokens[1].toUpper() == "T") filters.insert(ID, true);
-                else filters.insert(ID, false);
+            filters.setId(static_cast<uint32_t>(ID), tokens[1].toUpper() == "T");
         }
     }
     inFile->close();
@@ -960,8 +1931,9 @@ void CANFrameModel::saveFilterFile(QString filename)
     if (!outFile->open(QIODevice::WriteOnly | QIODevice::Text))
         return;
 
+    const QMap<int, bool> ids = filters.ids();
     QMap<int, bool>::const_iterator it;
-    for (it = filters.begin(); it != filters.end(); ++it)
+    for (it = ids.begin(); it != ids.end(); ++it)
     {
         outFile->write(QString::number(it.key(), 16).toUtf8());
         outFile->putChar(',');
@@ -986,22 +1958,17 @@ bool CANFrameModel::needsFilterRefresh()
  * external code that needs to access frames directly and doesn't care about
  * this model's normal output mechanism.
  */
-const QVector<CANFrame>* CANFrameModel::getListReference() const
+const CANFrameStore* CANFrameModel::getListReference() const
 {
     return &frames;
 }
 
-const QVector<CANFrame>* CANFrameModel::getFilteredListReference() const
+const CANFrameStore* CANFrameModel::getFilteredListReference() const
 {
     return &filteredFrames;
 }
 
-const QMap<int, bool>* CANFrameModel::getFiltersReference() const
+const CANFilterTable* CANFrameModel::getFilterTable() const
 {
     return &filters;
 }
-
-const QMap<int, bool>* CANFrameModel::getBusFiltersReference() const
-{
-    return &busFilters;
-}
@@ -6,10 +6,19 @@
 #include <QVector>
 #include <QDebug>
 #include <QMutex>
+#include <QCache>
+#include <QThreadPool>
+#include <QAtomicInteger>
 #include "can_structs.h"
+#include "canframestore.h"
+#include "canfiltertable.h"
+#include "payloadchangetable.h"
+#include "filterexpression.h"
 #include "dbc/dbchandler.h"
 #include "connections/canconnection.h"
 #include "utility.h"
+#include "memoryaccounting.h"
+#include "bus_protocols/canidparts.h"
 
 enum class Column {
     TimeStamp = 0, ///< The timestamp when the frame was transmitted or received
@@ -21,10 +30,29 @@ enum class Column {
     Length    = 6, ///< The frames payload data length
     ASCII     = 7, ///< The payload interpreted as ASCII characters
     Data      = 8, ///< The frames payload data
+    //worked out from extended IDs as they're shown or sorted, blank for standard ones. Hidden unless turned on
+    Priority  = 9,  ///< J1939 / GMLAN priority bits
+    PGN       = 10, ///< J1939 parameter group number
+    Source    = 11, ///< J1939 source address
+    Dest      = 12, ///< J1939 destination address, FF for broadcast PGNs
+    GMLanArb  = 13, ///< GMLAN arbitration ID
+    GMLanSender = 14, ///< GMLAN sender ID
     NUM_COLUMN
 };
+//cellKey() has four bits for the column
+static_assert(static_cast<int>(Column::NUM_COLUMN) <= 16, "too many frame list columns");
 
-class CANFrameModel: public QAbstractTableModel
+//cells worth of formatted text kept around. Roughly 10000 rows of the four columns that get cached
+#define CANFRAMEMODEL_CELL_CACHE    40000
+//how many screens above and below the visible rows prefetchRows() formats
+#define CANFRAMEMODEL_PREFETCH_PAGES    2
+//live capture retention drops frames this many at a time, see enforceRetention()
+#define CANFRAMEMODEL_RETENTION_BLOCK   1024
+//once timing is normalized, a stamp this far behind the one before it is taken as the device's clock starting over
+//rather than frames from two connections crossing
+#define CANFRAMEMODEL_CLOCK_RESET_US    1000000
+
+class CANFrameModel: public QAbstractTableModel, public MemoryReporter
 {
     Q_OBJECT
 
@@ -41,11 +69,20 @@ public:
 
     void sendRefresh();
     void sendRefresh(int);
+    void redecode(); //a DBC file was reloaded from disk. Redraws in place, keeping scroll position and selection
     int  sendBulkRefresh();
     void clearFrames();
     void setInterpretMode(bool);
     bool getInterpretMode();
     void setOverwriteMode(bool);
+    //only frames whose payload isn't the same as the one before from their bus / ID. Overwrite mode wins over it
+    void setChangesOnlyMode(bool);
+    bool getChangesOnlyMode() const { return changesOnly; }
+    //bits set in mask (byte 0 first) don't count as a change. Per ID ones are used instead of it for their IDs
+    //and replace whatever per ID masks there were
+    void setChangeIgnoreMask(const QByteArray &mask);
+    QByteArray getChangeIgnoreMask() const { return changeTable.ignoreMask(); }
+    void setChangeIgnoreMasks(const QHash<uint32_t, QByteArray> &masks);
     void setHexMode(bool);
     void setClearMode(bool mode);
     void setTimeStyle(TimeStyle newStyle);
@@ -53,6 +90,9 @@ public:
     void setFilterState(unsigned int ID, bool state);
     void setBusFilterState(unsigned int BusID, bool state);
     void setAllFilters(bool state);
+    //shown frames also have to match this, on top of the ID and bus filters. Blank text takes it off again
+    bool setFilterExpression(const QString &text, QString &error);
+    QString getFilterExpression() const { return filterExpressionText; }
     void setTimeFormat(QString);
     void setBytesPerLine(int bpl);
     void loadFilterFile(QString filename);
@@ -61,12 +101,48 @@ public:
     void recalcOverwrite();
     bool needsFilterRefresh();
     void insertFrames(const QVector<CANFrame> &newFrames);
+    bool loadMappedFile(const QString &filename); //view a binary capture in place instead of loading it
+    //a workspace's capture with the ID index and filters saved alongside it, so nothing goes through every frame
+    void loadWorkspaceFrames(QSharedPointer<const MappedCapture> capture, const CANFrameStore::SavedIndex &index,
+                             const QMap<int, bool> &idFilters, const QMap<int, bool> &busFilters);
     void sortByColumn(int column);
     int getIndexFromTimeID(unsigned int ID, double timestamp);
-    const QVector<CANFrame> *getListReference() const; //thou shalt not modify these frames externally!
-    const QVector<CANFrame> *getFilteredListReference() const; //Thus saith the Lord, NO.
-    const QMap<int, bool> *getFiltersReference() const; //this neither
-    const QMap<int, bool> *getBusFiltersReference() const; //this neither
+    int getIndexFromSequence(quint64 sequence);
+    int getIndexFromTime(uint64_t stamp); //shown row nearest that time, -1 if nothing is shown
+    const CANFrameStore *getListReference() const; //thou shalt not modify these frames externally!
+    const CANFrameStore *getFilteredListReference() const; //Thus saith the Lord, NO.
+    const CANFilterTable *getFilterTable() const; //this neither
+    void prefetchRows(int first, int last); //first..last are on screen. Formats the rows around them in the background
+    void invalidateDisplayCache();
+    int dataLines(int row) const; //lines of text the data column is for that row, for sizing it without measuring
+    void setRetention(int seconds, int megabytes, bool spill); //0 turns that limit off. spill logs what gets dropped
+
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+    qint64 purgeMemory() override; //drops the formatted cell cache and spare capacity, never frames
+
+    //everything the cell text depends on besides the frame. Copied so a worker can format while the settings change
+    struct CellFormat
+    {
+        bool hexMode;
+        bool interpret;
+        bool overwrite;
+        TimeStyle timeStyle;
+        QString timeFormat;
+        int bytesPerLine;
+    };
+    //the list's display settings as they are now. Frame views (CANFrameView) show their frames the same way
+    CellFormat cellFormat() const;
+    bool getIgnoreDBCColors() const { return ignoreDBCColors; }
+    //timestamp of a row of the frame store as the time column shows it, normalized or not
+    uint64_t frameStamp(int idx) const;
+    //text of any column. Only the data column with fmt.interpret set touches the DBC files, the rest is safe off
+    //the GUI thread. In overwrite mode the time and count columns come from the frame's timedelta and frameCount
+    static QString cellText(const CANFrame &frame, Column col, const CellFormat &fmt);
+    static QString formatCell(const CANFrame &frame, Column col, const CellFormat &fmt);
+    //what a column sorts on, straight from the packed record. Time and count as stored, without overwrite mode
+    static uint64_t recordValue(const CANFrameStore &store, int row, Column col);
+    static Qt::Alignment columnAlignment(Column col);
+    static QString columnTitle(Column col, bool overwrite);
 
 public slots:
     void addFrame(const CANFrame&, bool);
@@ -74,33 +150,93 @@ public slots:
 
 signals:
     void updatedFiltersList();
+    void displayChanged(); //the display settings changed, text made with the old ones is out of date
 
 private:
-    void qSortCANFrameAsc(QVector<CANFrame>* frames, Column column, int lowerBound, int upperBound);
-    void qSortCANFrameDesc(QVector<CANFrame>* frames, Column column, int lowerBound, int upperBound);
-    uint64_t getCANFrameVal(QVector<CANFrame> *frames, int row, Column col);
+    uint64_t getCANFrameVal(int row, Column col) const;
+    uint64_t rowStamp(int row) const; //timestamp of a row of filteredFrames as the time column shows it
+    void resetTimeJumps();
+    bool isCachedColumn(Column col) const;
+    void checkDisplayCache() const;
+    static quint64 cellKey(quint32 frameKey, Column col) { return (static_cast<quint64>(frameKey) << 4) | static_cast<quint64>(col); }
+    void rebuildOverwriteIndex();
+    int rowOfFrame(int idx);
+    void markRowDirty(int row);
+    void storeFrame(const CANFrame &frame);
+    void dropOldest();
+    void enforceRetention();
+    bool openSpill();
+    void pruneFiltered(bool force);
+    void rebuildFiltered();
+    bool rebuildFilteredByPairs(const FilterExpression *expr);
+    void mergeFiltered(const QVector<CANFrameStore::IdInfo> &lists, bool add);
     bool any_filters_are_configured(void);
     bool any_busfilters_are_configured(void);
+    bool passesFilters(int idx); //a row of frames
+    bool passesFilters(const CANFrame &frame);
+    const FilterExpression *currentExpression();
 
-    QVector<CANFrame> frames;
-    QVector<CANFrame> filteredFrames;
-    QMap<int, bool> filters;
-    QMap<int, bool> busFilters;
+    //overwrite mode bookkeeping. Only lives for the rows of filteredFrames, the store doesn't carry it
+    struct OverwriteInfo
+    {
+        uint64_t timedelta;
+        uint32_t frameCount;
+    };
+
+    CANFrameStore frames; //indexed. The per ID posting lists let a filter change touch just the frames it affects
+    CANFrameStore filteredFrames; //a view of frames, only the rows that pass the filters
+    bool filteredSorted; //filteredFrames isn't in frame order since a sort so evicted rows could be anywhere in it
+    bool filteredStale; //frames were evicted that filteredFrames might still list
+    QVector<OverwriteInfo> overwriteInfo; //parallel to filteredFrames, only filled in overwrite mode
+    QHash<uint64_t, int> overwriteRows; //CANFrameStore::idKey -> row of filteredFrames in overwrite mode
+    int overwriteVisibleRows; //rows the view has been told about. New IDs show up at the next bulk refresh
+    bool overwriteIndexStale; //insertFrames appended rows behind the index's back
+    int dirtyRowLow, dirtyRowHigh; //rows updated in place since the last bulk refresh. low > high means none
+    CANFilterTable filters; //ID and bus filters, checked for every frame
+    QSharedPointer<const FilterExpression> filterExpression; //null for none. Checked after filters
+    QString filterExpressionText;
+    bool filterUsesDbc;
+    quint32 filterRevision; //DBC revision filterExpression was compiled against
     DBCHandler *dbcHandler;
     QMutex mutex;
     bool interpretFrames; //should we use the dbcHandler?
     bool overwriteDups; //should we display all frames or only the newest for each ID?
+    bool changesOnly; //or only the ones that changed. Every frame goes through changeTable while it's on
+    PayloadChangeTable changeTable;
     bool filtersPersistDuringClear;
     QString timeFormat;
     TimeStyle timeStyle;
     bool useHexMode;
     bool needFilterRefresh;
     bool ignoreDBCColors;
-    int64_t timeOffset;
+    //normalized timing. The stored stamps never change, the time column shows them less timeBase and plus the jump
+    //they come after. The clock resets are looked for lazily, only as far into frames as rows have been asked for
+    struct TimeJump
+    {
+        quint64 sequence; //first frame after the reset
+        int64_t adjust; //added to it and everything after, up to the next one
+    };
+    bool timingNormalized;
+    uint64_t timeBase;
+    mutable QVector<TimeJump> timeJumps;
+    mutable quint64 jumpsScanned; //sequence of the next frame to look at for a reset
+    mutable uint64_t jumpsLastStamp; //stamp of the frame before it
     int lastUpdateNumFrames;
     uint32_t preallocSize;
     bool sortDirAsc;
+    int sortColumn; //what filteredFrames was last sorted on. -1 once anything has changed it since
     int bytesPerLine;
+    uint64_t retentionUs; //live frames older than this behind the newest one go. 0 = no time limit
+    qint64 retentionBytes; //rough memory budget of frames. 0 = no limit
+    bool retentionSpill; //evicted frames are written to a binary log before they go
+
+    //formatted text of the expensive columns, keyed on the frame's key in frames and the column. Going by the frame
+    //instead of the row means sorting and filtering don't throw any of it away
+    mutable QCache<quint64, QString> cellCache;
+    mutable QAtomicInteger<quint32> cacheGeneration; //bumped on every invalidate so late prefetch results get dropped
+    mutable quint32 cacheDbcRevision;
+    mutable QHash<const DBC_MESSAGE *, int> messageLines; //decoded lines each message adds. -1 if it's multiplexed
+    QThreadPool prefetchPool;
 };
 
 
@@ -0,0 +1,855 @@
+#include "canframestore.h"
+#include "memoryaccounting.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+CANFrameStore::CANFrameStore()
+{
+    used = 0;
+    maxFrames = 0;
+    evicted = 0;
+    source = nullptr;
+    viewHead = 0;
+    indexed = false;
+    timeHead = 0;
+    timeBase = 0;
+    timeStale = false;
+    sharePayloads = false;
+}
+
+int CANFrameStore::capacity() const
+{
+    if (maxFrames > 0) return maxFrames;
+    return records.capacity();
+}
+
+void CANFrameStore::reserve(int size)
+{
+    if (maxFrames > 0 && size > maxFrames) size = maxFrames;
+    if (source) viewKeys.reserve(size);
+    else records.reserve(size);
+}
+
+void CANFrameStore::setMaxCapacity(int maxFrames)
+{
+    this->maxFrames = maxFrames;
+    if (maxFrames <= 0 || mapped || source) return;
+    if (used > maxFrames) remove(0, used - maxFrames);
+}
+
+int CANFrameStore::indexOfSequence(quint64 seq) const
+{
+    if (seq < evicted) return -1;
+    if (seq - evicted >= static_cast<quint64>(used)) return -1;
+    return static_cast<int>(seq - evicted);
+}
+
+const uint8_t *CANFrameStore::payloadData(int idx) const
+{
+    if (source) return source->payloadData(sourceRow(idx));
+    if (mapped) return mapped->payloadData(idx);
+    const CANFrameRecord &rec = records.at(idx);
+    if (rec.isInline()) return rec.data;
+    return fdPool.at(rec.fdSlot).bytes;
+}
+
+CANFrame CANFrameStore::at(int idx) const
+{
+    if (source) return source->at(sourceRow(idx));
+    if (mapped) return mapped->at(idx);
+    CANFrame frame;
+    records.at(idx).toFrame(frame, payloadData(idx));
+    return frame;
+}
+
+CANFrameSnapshot CANFrameStore::snapshot(int rows) const
+{
+    CANFrameSnapshot snap;
+    if (source) return snap;
+    snap.used = (rows < 0 || rows > used) ? used : rows;
+    snap.evicted = evicted;
+    if (mapped) snap.mapped = mapped;
+    else
+    {
+        snap.records = records.share();
+        snap.fdPool = fdPool.share();
+    }
+    return snap;
+}
+
+const uint8_t *CANFrameSnapshot::payloadData(int idx) const
+{
+    if (mapped) return mapped->payloadData(idx);
+    const CANFrameRecord &rec = records.at(idx);
+    if (rec.isInline()) return rec.data;
+    return fdPool.at(rec.fdSlot).bytes;
+}
+
+CANFrame CANFrameSnapshot::at(int idx) const
+{
+    if (mapped) return mapped->at(idx);
+    CANFrame frame;
+    records.at(idx).toFrame(frame, payloadData(idx));
+    return frame;
+}
+
+uint32_t CANFrameStore::allocFDSlot()
+{
+    uint32_t slot;
+    if (!fdFreeSlots.isEmpty())
+    {
+        slot = fdFreeSlots.last();
+        fdFreeSlots.removeLast();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(fdPool.count());
+        fdPool.append(FDPayload());
+        fdRefs.append(0);
+    }
+    fdRefs[slot] = 1;
+    return slot;
+}
+
+//slots are zero filled past the payload so the whole 64 bytes can be hashed and compared. Two payloads that only
+//differ by trailing zeros can then share a slot, which is fine since each record knows its own length
+uint64_t CANFrameStore::payloadHash(const FDPayload &payload)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int i = 0; i < CANFrameRecord::MAX_BYTES; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, payload.bytes + i, 8);
+        hash = (hash ^ word) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+//put len payload bytes in a slot, or find the slot that already has them
+uint32_t CANFrameStore::storeFD(const uint8_t *bytes, int len)
+{
+    FDPayload payload;
+    memset(payload.bytes, 0, sizeof(payload.bytes));
+    memcpy(payload.bytes, bytes, static_cast<size_t>(len));
+    if (!sharePayloads)
+    {
+        uint32_t slot = allocFDSlot();
+        fdPool.write(slot) = payload;
+        return slot;
+    }
+
+    uint64_t hash = payloadHash(payload);
+    QHash<uint64_t, uint32_t>::const_iterator it = fdShared.constFind(hash);
+    if (it != fdShared.constEnd() && memcmp(fdPool.at(it.value()).bytes, payload.bytes, sizeof(payload.bytes)) == 0)
+    {
+        fdRefs[it.value()]++;
+        return it.value();
+    }
+    uint32_t slot = allocFDSlot();
+    fdPool.write(slot) = payload;
+    if (it == fdShared.constEnd()) fdShared.insert(hash, slot); //a hash collision just doesn't get shared
+    return slot;
+}
+
+void CANFrameStore::pack(const CANFrame &frame, CANFrameRecord &rec)
+{
+    rec.setFrom(frame);
+    if (rec.isInline()) return;
+
+    rec.fdSlot = storeFD(reinterpret_cast<const uint8_t *>(frame.payload().constData()), rec.len);
+}
+
+void CANFrameStore::release(const CANFrameRecord &rec)
+{
+    if (rec.isInline()) return;
+    if (--fdRefs[rec.fdSlot] > 0) return;
+    if (!fdShared.isEmpty())
+    {
+        QHash<uint64_t, uint32_t>::iterator it = fdShared.find(payloadHash(fdPool.at(rec.fdSlot)));
+        if (it != fdShared.end() && it.value() == rec.fdSlot) fdShared.erase(it);
+    }
+    fdFreeSlots.append(rec.fdSlot);
+}
+
+void CANFrameStore::attach(QSharedPointer<const MappedCapture> capture)
+{
+    clear();
+    mapped = capture;
+    if (mapped) used = mapped->count();
+    if (indexed) rebuildIndex();
+}
+
+CANFrameStore::SavedIndex CANFrameStore::savedIndex() const
+{
+    SavedIndex saved;
+    if (!indexed) return saved;
+    saved.pairs.reserve(idIndex.count());
+    saved.starts.reserve(idIndex.count() + 1);
+    saved.rows.reserve(used);
+    for (auto it = idIndex.constBegin(); it != idIndex.constEnd(); ++it)
+    {
+        saved.pairs.append(it.key());
+        saved.starts.append(static_cast<quint32>(saved.rows.count()));
+        const Postings &post = it.value();
+        for (int k = post.head; k < post.keys.count(); k++)
+        {
+            int row = indexOfKey(post.keys.at(k));
+            if (row >= 0) saved.rows.append(static_cast<quint32>(row));
+        }
+    }
+    saved.starts.append(static_cast<quint32>(saved.rows.count()));
+    return saved;
+}
+
+void CANFrameStore::attach(QSharedPointer<const MappedCapture> capture, const SavedIndex &index)
+{
+    clear();
+    mapped = capture;
+    if (mapped) used = mapped->count();
+    if (!indexed) return;
+
+    //has to account for every frame exactly as many times as there are frames, anything else and it's rebuilt
+    bool fits = index.rows.count() == used && index.starts.count() == index.pairs.count() + 1
+                && index.starts.constLast() == static_cast<quint32>(used);
+    for (int p = 0; fits && p < index.pairs.count(); p++)
+    {
+        if (index.starts.at(p) > index.starts.at(p + 1)) fits = false;
+    }
+    for (int r = 0; fits && r < index.rows.count(); r++)
+    {
+        if (index.rows.at(r) >= static_cast<quint32>(used)) fits = false;
+    }
+    if (!fits)
+    {
+        rebuildIndex();
+        return;
+    }
+
+    idIndex.reserve(index.pairs.count());
+    for (int p = 0; p < index.pairs.count(); p++)
+    {
+        Postings &post = idIndex[index.pairs.at(p)];
+        int start = static_cast<int>(index.starts.at(p));
+        int count = static_cast<int>(index.starts.at(p + 1)) - start;
+        post.keys.resize(count);
+        for (int k = 0; k < count; k++) post.keys[k] = keyOf(static_cast<int>(index.rows.at(start + k)));
+    }
+    rebuildTimeIndex();
+}
+
+void CANFrameStore::attachView(const CANFrameStore *viewSource)
+{
+    clear();
+    source = viewSource;
+    indexed = false;
+}
+
+void CANFrameStore::setKeys(const QVector<quint32> &keys)
+{
+    viewKeys = keys;
+    viewHead = 0;
+    used = viewKeys.count();
+}
+
+QVector<quint32> CANFrameStore::keys() const
+{
+    if (viewHead == 0) return viewKeys;
+    return viewKeys.mid(viewHead);
+}
+
+/*
+ * Frames leave the source oldest first. A view kept in frame order only ever has stale rows at its front so
+ * frontOnly just pops those off. A sorted view can have them anywhere and needs the full pass.
+ */
+int CANFrameStore::pruneView(bool frontOnly)
+{
+    if (!source) return 0;
+    int removed = 0;
+    while (used > 0 && source->indexOfKey(viewKeys.at(viewHead)) < 0)
+    {
+        viewHead++;
+        used--;
+        evicted++;
+        removed++;
+    }
+    //don't let the dead space at the front build up forever
+    if (viewHead > 4096 && viewHead > used)
+    {
+        viewKeys.remove(0, viewHead);
+        viewHead = 0;
+    }
+    if (frontOnly || used == 0) return removed;
+
+    int out = viewHead;
+    for (int i = viewHead; i < viewKeys.count(); i++)
+    {
+        if (source->indexOfKey(viewKeys.at(i)) >= 0) viewKeys[out++] = viewKeys.at(i);
+    }
+    removed += viewKeys.count() - out;
+    used = out - viewHead;
+    viewKeys.resize(out);
+    return removed;
+}
+
+//copy the records out of the mapped file into normal storage so they can be changed. Row numbers stay the same.
+//If the capture is bigger than maxFrames the ring just ends up that big and starts overwriting from there.
+//A view gets its own copies of the frames it was showing.
+void CANFrameStore::detach()
+{
+    if (source)
+    {
+        const CANFrameStore *from = source;
+        QVector<quint32> keys = this->keys();
+        source = nullptr;
+        viewKeys.clear();
+        viewHead = 0;
+        records.clear();
+        used = 0;
+        records.reserve(keys.count());
+        for (quint32 key : keys)
+        {
+            int idx = from->indexOfKey(key);
+            if (idx >= 0) append(*from, idx);
+        }
+        return;
+    }
+    if (!mapped) return;
+    QSharedPointer<const MappedCapture> capture = mapped;
+    int count = used;
+
+    mapped.reset();
+    records.clear();
+    fdPool.clear();
+    fdFreeSlots.clear();
+    fdRefs.clear();
+    fdShared.clear();
+    records.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        CANFrameRecord rec = capture->record(i);
+        if (!rec.isInline())
+        {
+            if (rec.len > CANFrameRecord::MAX_BYTES) rec.len = CANFrameRecord::MAX_BYTES;
+            rec.fdSlot = storeFD(capture->payloadData(i), rec.len);
+        }
+        records.append(rec);
+    }
+    used = records.count();
+}
+
+void CANFrameStore::push(const CANFrameRecord &rec)
+{
+    //full. The oldest frame goes to make room, its block is let go of once all of it has been
+    if (maxFrames > 0 && used >= maxFrames)
+    {
+        if (indexed) unindexFront(0);
+        release(records.at(0));
+        records.removeFirst(1);
+        used--;
+        evicted++;
+    }
+    records.append(rec);
+    used++;
+    indexLast();
+}
+
+void CANFrameStore::append(const CANFrame &frame)
+{
+    detach();
+    CANFrameRecord rec;
+    pack(frame, rec);
+    push(rec);
+}
+
+void CANFrameStore::append(const QVector<CANFrame> &frames)
+{
+    for (const CANFrame &frame : frames) append(frame);
+}
+
+void CANFrameStore::append(const CANFrameStore &other, int idx)
+{
+    detach();
+    CANFrameRecord rec = other.record(idx);
+    if (!rec.isInline())
+    {
+        CANFrame frame = other.at(idx);
+        pack(frame, rec);
+    }
+    push(rec);
+}
+
+void CANFrameStore::replace(int idx, const CANFrame &frame)
+{
+    detach();
+    uint64_t oldKey = idKey(records.at(idx).frameId(), records.at(idx).bus);
+    uint64_t oldStamp = records.at(idx).timestamp;
+    release(records.at(idx));
+    pack(frame, records.write(idx));
+    if (!indexed) return;
+    if (oldKey != idKey(records.at(idx).frameId(), records.at(idx).bus)) rebuildIndex();
+    else if (oldStamp != records.at(idx).timestamp) rebuildTimeIndex();
+}
+
+void CANFrameStore::setTimestamp(int idx, uint64_t timestamp)
+{
+    detach();
+    records.write(idx).timestamp = timestamp;
+    if (indexed) timeStale = true;
+}
+
+void CANFrameStore::swapItemsAt(int i, int j)
+{
+    if (source)
+    {
+        std::swap(viewKeys[viewHead + i], viewKeys[viewHead + j]);
+        return;
+    }
+    detach();
+    //FD slots travel with their record so a plain swap is fine
+    CANFrameRecord temp = records.at(i);
+    records.write(i) = records.at(j);
+    records.write(j) = temp;
+    //rows in the posting lists have to stay in order. Nothing that swaps rows keeps an index
+    if (indexed) rebuildIndex();
+}
+
+void CANFrameStore::remove(int idx, int num)
+{
+    if (idx < 0 || idx >= used || num <= 0) return;
+    if (idx + num > used) num = used - idx;
+    if (source)
+    {
+        if (idx == 0)
+        {
+            viewHead += num;
+            evicted += num;
+        }
+        else viewKeys.remove(viewHead + idx, num);
+        used -= num;
+        return;
+    }
+    detach();
+
+    if (!fdPool.isEmpty())
+    {
+        for (int i = idx; i < idx + num; i++) release(records.at(i));
+    }
+
+    //removing from the front is the common case and is just letting go of the front
+    if (idx == 0)
+    {
+        if (indexed)
+        {
+            for (int i = 0; i < num; i++) unindexFront(i);
+        }
+        records.removeFirst(num);
+        used -= num;
+        evicted += num;
+        return;
+    }
+
+    //so is chopping off the end
+    if (idx + num == used)
+    {
+        records.truncate(used - num);
+        used -= num;
+        if (indexed) rebuildIndex();
+        return;
+    }
+
+    records.remove(idx, num);
+    used -= num;
+    if (indexed) rebuildIndex(); //every row after idx has a new sequence number
+}
+
+void CANFrameStore::clear()
+{
+    mapped.reset();
+    source = nullptr;
+    viewKeys.clear();
+    viewHead = 0;
+    records.clear();
+    used = 0;
+    evicted = 0;
+    fdPool.clear();
+    fdFreeSlots.clear();
+    fdRefs.clear();
+    fdShared.clear();
+    idIndex.clear();
+    timeBlocks.clear();
+    timeHead = 0;
+    timeBase = 0;
+    timeStale = false;
+}
+
+qint64 CANFrameStore::memoryBytes() const
+{
+    using MemoryAccounting::bytesOf;
+    qint64 bytes = records.memoryBytes() + fdPool.memoryBytes() + bytesOf(fdFreeSlots) + bytesOf(fdRefs) + bytesOf(fdShared)
+                 + bytesOf(viewKeys) + bytesOf(timeBlocks) + bytesOf(idIndex);
+    for (auto it = idIndex.constBegin(); it != idIndex.constEnd(); ++it) bytes += bytesOf(it.value().keys);
+    return bytes;
+}
+
+qint64 CANFrameStore::squeeze()
+{
+    qint64 before = memoryBytes();
+    //a ring that's going to fill up to maxFrames anyway would only grow straight back
+    if (maxFrames <= 0 || used < maxFrames) records.squeeze();
+    fdPool.squeeze();
+    fdFreeSlots.squeeze();
+    fdRefs.squeeze();
+    viewKeys.squeeze();
+    timeBlocks.squeeze();
+    for (auto it = idIndex.begin(); it != idIndex.end(); ++it) it.value().keys.squeeze();
+    return before - memoryBytes();
+}
+
+void CANFrameStore::setIndexed(bool on)
+{
+    if (indexed == on) return;
+    indexed = on && !source;
+    idIndex.clear();
+    timeBlocks.clear();
+    timeHead = 0;
+    if (indexed) rebuildIndex();
+}
+
+//add the newest frame to its posting list
+void CANFrameStore::indexLast()
+{
+    if (!indexed) return;
+    const CANFrameRecord &rec = record(used - 1);
+    idIndex[idKey(rec.frameId(), rec.bus)].keys.append(keyOf(used - 1));
+    indexTime(used - 1);
+}
+
+//a frame at the front is going away. It's always the oldest one in its own list too
+void CANFrameStore::unindexFront(int idx)
+{
+    //last frame of its time block going means the whole block has
+    if (((sequenceOf(idx) + 1) & TIME_BLOCK_MASK) == 0 && timeHead < timeBlocks.count())
+    {
+        timeHead++;
+        timeBase++;
+        if (timeHead > 1024 && timeHead * 2 > timeBlocks.count())
+        {
+            timeBlocks.remove(0, timeHead);
+            timeHead = 0;
+        }
+    }
+
+    const CANFrameRecord &rec = record(idx);
+    QHash<uint64_t, Postings>::iterator it = idIndex.find(idKey(rec.frameId(), rec.bus));
+    if (it == idIndex.end()) return;
+    Postings &list = it.value();
+    if (list.head < list.keys.count() && list.keys.at(list.head) == keyOf(idx)) list.head++;
+    if (list.head >= list.keys.count()) idIndex.erase(it);
+    else if (list.head > 1024 && list.head * 2 > list.keys.count())
+    {
+        list.keys.remove(0, list.head);
+        list.head = 0;
+    }
+}
+
+void CANFrameStore::rebuildIndex()
+{
+    idIndex.clear();
+    for (int i = 0; i < used; i++)
+    {
+        const CANFrameRecord &rec = record(i);
+        idIndex[idKey(rec.frameId(), rec.bus)].keys.append(keyOf(i));
+    }
+    rebuildTimeIndex();
+}
+
+void CANFrameStore::rebuildTimeIndex()
+{
+    timeBlocks.clear();
+    timeHead = 0;
+    timeBase = 0;
+    timeStale = false;
+    if (!indexed) return;
+    timeBlocks.reserve(static_cast<int>((static_cast<quint64>(used) >> TIME_BLOCK_SHIFT) + 2));
+    for (int i = 0; i < used; i++) indexTime(i);
+}
+
+//fold row idx, which has to be the newest, into the time blocks
+void CANFrameStore::indexTime(int idx)
+{
+    quint64 block = sequenceOf(idx) >> TIME_BLOCK_SHIFT;
+    uint64_t stamp = record(idx).timestamp;
+    if (timeHead >= timeBlocks.count())
+    {
+        timeBlocks.clear();
+        timeHead = 0;
+        timeBase = block;
+    }
+    while (timeBase + static_cast<quint64>(timeBlocks.count() - timeHead) <= block)
+        timeBlocks.append(std::numeric_limits<uint64_t>::max());
+    //in order frames stop at the newest block. One older than what came before lowers the blocks back to it
+    for (int b = timeBlocks.count() - 1; b >= timeHead && timeBlocks.at(b) > stamp; b--) timeBlocks[b] = stamp;
+}
+
+/*
+ * The queries below work on any store. Only an indexed one answers them without going through every frame, a view
+ * or an unindexed store falls back to a scan of the records.
+ */
+QVector<CANFrameStore::IdInfo> CANFrameStore::idList() const
+{
+    QVector<IdInfo> out;
+    if (indexed)
+    {
+        out.reserve(idIndex.count());
+        for (QHash<uint64_t, Postings>::const_iterator it = idIndex.constBegin(); it != idIndex.constEnd(); ++it)
+        {
+            const Postings &list = it.value();
+            IdInfo info;
+            info.id = static_cast<uint32_t>(it.key());
+            info.bus = static_cast<int>(it.key() >> 32);
+            info.count = list.keys.count() - list.head;
+            info.firstStamp = record(indexOfKey(list.keys.at(list.head))).timestamp;
+            info.lastStamp = record(indexOfKey(list.keys.last())).timestamp;
+            out.append(info);
+        }
+    }
+    else
+    {
+        QHash<uint64_t, IdInfo> found;
+        for (int i = 0; i < used; i++)
+        {
+            const CANFrameRecord &rec = record(i);
+            QHash<uint64_t, IdInfo>::iterator it = found.find(idKey(rec.frameId(), rec.bus));
+            if (it == found.end())
+            {
+                IdInfo info;
+                info.id = rec.frameId();
+                info.bus = rec.bus;
+                info.count = 1;
+                info.firstStamp = info.lastStamp = rec.timestamp;
+                found.insert(idKey(rec.frameId(), rec.bus), info);
+            }
+            else
+            {
+                it->count++;
+                it->lastStamp = rec.timestamp;
+            }
+        }
+        out.reserve(found.count());
+        for (const IdInfo &info : found) out.append(info);
+    }
+    std::sort(out.begin(), out.end(), [](const IdInfo &a, const IdInfo &b)
+    {
+        if (a.id != b.id) return a.id < b.id;
+        return a.bus < b.bus;
+    });
+    return out;
+}
+
+QVector<CANFrameStore::IdLatest> CANFrameStore::latestList(QCanBusFrame::FrameType type) const
+{
+    QVector<IdLatest> out;
+    if (indexed)
+    {
+        out.reserve(idIndex.count());
+        for (QHash<uint64_t, Postings>::const_iterator it = idIndex.constBegin(); it != idIndex.constEnd(); ++it)
+        {
+            const Postings &list = it.value();
+            IdLatest latest;
+            latest.id = static_cast<uint32_t>(it.key());
+            latest.bus = static_cast<int>(it.key() >> 32);
+            latest.count = list.keys.count() - list.head;
+            latest.row = latest.previous = -1;
+            //nearly always the newest two, remote and error frames of an ID are rare
+            for (int i = list.keys.count() - 1; i >= list.head && latest.previous < 0; i--)
+            {
+                int row = indexOfKey(list.keys.at(i));
+                if (record(row).type() != type) continue;
+                if (latest.row < 0) latest.row = row;
+                else latest.previous = row;
+            }
+            if (latest.row >= 0) out.append(latest);
+        }
+    }
+    else
+    {
+        QHash<uint64_t, int> found; //idKey -> position in out
+        for (int i = 0; i < used; i++)
+        {
+            const CANFrameRecord &rec = record(i);
+            if (rec.type() != type) continue;
+            QHash<uint64_t, int>::const_iterator it = found.constFind(idKey(rec.frameId(), rec.bus));
+            if (it == found.constEnd())
+            {
+                IdLatest latest;
+                latest.id = rec.frameId();
+                latest.bus = rec.bus;
+                latest.count = 1;
+                latest.row = i;
+                latest.previous = -1;
+                found.insert(idKey(rec.frameId(), rec.bus), out.count());
+                out.append(latest);
+            }
+            else
+            {
+                IdLatest &latest = out[it.value()];
+                latest.count++;
+                latest.previous = latest.row;
+                latest.row = i;
+            }
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const IdLatest &a, const IdLatest &b)
+    {
+        if (a.id != b.id) return a.id < b.id;
+        return a.bus < b.bus;
+    });
+    return out;
+}
+
+bool CANFrameStore::idInfo(uint32_t id, int bus, IdInfo &info) const
+{
+    info.id = id;
+    info.bus = bus;
+    info.count = 0;
+    info.firstStamp = 0;
+    info.lastStamp = 0;
+    int firstRow = -1, lastRow = -1;
+    if (!indexed)
+    {
+        for (int i = 0; i < used; i++)
+        {
+            const CANFrameRecord &rec = record(i);
+            if (rec.frameId() != id || (bus != -1 && rec.bus != bus)) continue;
+            if (firstRow < 0) firstRow = i;
+            lastRow = i;
+            info.count++;
+        }
+    }
+    else
+    {
+        for (QHash<uint64_t, Postings>::const_iterator it = idIndex.constBegin(); it != idIndex.constEnd(); ++it)
+        {
+            if (static_cast<uint32_t>(it.key()) != id) continue;
+            if (bus != -1 && static_cast<int>(it.key() >> 32) != bus) continue;
+            const Postings &list = it.value();
+            int first = indexOfKey(list.keys.at(list.head));
+            int last = indexOfKey(list.keys.last());
+            info.count += list.keys.count() - list.head;
+            if (firstRow < 0 || first < firstRow) firstRow = first;
+            if (last > lastRow) lastRow = last;
+        }
+    }
+    if (info.count == 0) return false;
+    info.firstStamp = record(firstRow).timestamp;
+    info.lastStamp = record(lastRow).timestamp;
+    return true;
+}
+
+QVector<int> CANFrameStore::rowsOf(uint32_t id, int bus) const
+{
+    QVector<int> rows;
+    if (!indexed)
+    {
+        for (int i = 0; i < used; i++)
+        {
+            const CANFrameRecord &rec = record(i);
+            if (rec.frameId() == id && (bus == -1 || rec.bus == bus)) rows.append(i);
+        }
+        return rows;
+    }
+    int lists = 0;
+    for (QHash<uint64_t, Postings>::const_iterator it = idIndex.constBegin(); it != idIndex.constEnd(); ++it)
+    {
+        if (static_cast<uint32_t>(it.key()) != id) continue;
+        if (bus != -1 && static_cast<int>(it.key() >> 32) != bus) continue;
+        const Postings &list = it.value();
+        for (int i = list.head; i < list.keys.count(); i++) rows.append(indexOfKey(list.keys.at(i)));
+        lists++;
+    }
+    //one list per bus, each in order on its own
+    if (lists > 1) std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+/*
+ * Every block from the one upper_bound lands on is entirely after stamp, so the answer is in the block before it.
+ * The oldest block can still count frames that have been evicted which only makes it look earlier than it is, so
+ * the search below just carries on back if that block turns out not to have anything.
+ */
+int CANFrameStore::lastRowAtTime(uint64_t stamp) const
+{
+    int from = used - 1;
+    if (indexed && !timeStale && timeHead < timeBlocks.count())
+    {
+        QVector<uint64_t>::const_iterator first = timeBlocks.constBegin() + timeHead;
+        QVector<uint64_t>::const_iterator after = std::upper_bound(first, timeBlocks.constEnd(), stamp);
+        quint64 firstSeq = (timeBase + static_cast<quint64>(after - first)) << TIME_BLOCK_SHIFT;
+        if (firstSeq <= evicted) return -1;
+        if (firstSeq - evicted < static_cast<quint64>(used)) from = static_cast<int>(firstSeq - evicted) - 1;
+    }
+    for (int i = from; i >= 0; i--)
+    {
+        if (record(i).timestamp <= stamp) return i;
+    }
+    return -1;
+}
+
+int CANFrameStore::lastRowAtTime(uint32_t id, int bus, uint64_t stamp) const
+{
+    int limit = lastRowAtTime(stamp);
+    if (limit < 0) return -1;
+    if (!indexed)
+    {
+        for (int i = limit; i >= 0; i--)
+        {
+            const CANFrameRecord &rec = record(i);
+            if (rec.frameId() == id && (bus == -1 || rec.bus == bus) && rec.timestamp <= stamp) return i;
+        }
+        return -1;
+    }
+
+    //nothing after limit is early enough. Below it only frames that came in out of order can be too late
+    int best = -1;
+    for (QHash<uint64_t, Postings>::const_iterator it = idIndex.constBegin(); it != idIndex.constEnd(); ++it)
+    {
+        if (static_cast<uint32_t>(it.key()) != id) continue;
+        if (bus != -1 && static_cast<int>(it.key() >> 32) != bus) continue;
+        const Postings &list = it.value();
+        const quint32 *begin = list.keys.constData() + list.head;
+        const quint32 *pos = std::upper_bound(begin, list.keys.constData() + list.keys.count(), limit,
+                                              [this](int row, quint32 key) { return row < indexOfKey(key); });
+        while (pos != begin)
+        {
+            --pos;
+            int row = indexOfKey(*pos);
+            if (row <= best) break;
+            if (record(row).timestamp <= stamp)
+            {
+                best = row;
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+QVector<CANFrame> CANFrameStore::toVector() const
+{
+    return mid(0);
+}
+
+QVector<CANFrame> CANFrameStore::mid(int pos, int len) const
+{
+    QVector<CANFrame> out;
+    if (pos < 0) pos = 0;
+    int end = used;
+    if (len >= 0 && pos + len < end) end = pos + len;
+    if (end <= pos) return out;
+    out.reserve(end - pos);
+    for (int i = pos; i < end; i++) out.append(at(i));
+    return out;
+}
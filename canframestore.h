@@ -0,0 +1,465 @@
+#ifndef CANFRAMESTORE_H
+#define CANFRAMESTORE_H
+
+#include <QVector>
+#include <QHash>
+#include <QSharedPointer>
+#include "can_structs.h"
+#include "binarycapture.h"
+
+#include <memory>
+
+/*
+ * Array of fixed size blocks held by shared pointers, used for the store's records and FD payloads so a snapshot
+ * can hold on to the blocks it saw without copying them. Blocks never move or get resized so whoever holds a share
+ * can keep reading the items it was given while the owner appends past them. Anything the owner writes below the
+ * point the last share was taken (frozenEnd) copies that block first if somebody else still holds it. Dropping
+ * items off the front lets go of whole blocks, which are freed once no snapshot has them either. One block is kept
+ * spare so a store going round and round at its max capacity doesn't allocate once it's up to size.
+ *
+ * Copies are proper copies: full blocks are shared, copy on write like above, the partly filled last one is copied
+ * so the two can both append. share() is for read only holders and shares that last block too.
+ */
+template<typename T, int SHIFT>
+class SharedBlockArray
+{
+public:
+    static constexpr int BLOCK = 1 << SHIFT;
+
+    SharedBlockArray() : front(0), n(0), frozenEnd(0) {}
+    SharedBlockArray(const SharedBlockArray &other) : blocks(other.blocks), front(other.front), n(other.n)
+    {
+        other.frozenEnd = other.front + other.n;
+        frozenEnd = front + n;
+        int last = (front + n - 1) >> SHIFT;
+        if (n > 0 && ((front + n) & (BLOCK - 1)) != 0) blocks[last] = std::make_shared<Block>(*blocks.at(last));
+    }
+    SharedBlockArray(SharedBlockArray &&other) noexcept :
+        blocks(std::move(other.blocks)), front(other.front), n(other.n), frozenEnd(other.frozenEnd), spare(std::move(other.spare)) {}
+    SharedBlockArray &operator=(SharedBlockArray &&other) noexcept
+    {
+        blocks = std::move(other.blocks);
+        front = other.front;
+        n = other.n;
+        frozenEnd = other.frozenEnd;
+        spare = std::move(other.spare);
+        return *this;
+    }
+    SharedBlockArray &operator=(const SharedBlockArray &other)
+    {
+        if (this != &other)
+        {
+            SharedBlockArray copy(other);
+            blocks = copy.blocks;
+            front = copy.front;
+            n = copy.n;
+            frozenEnd = copy.frozenEnd;
+            spare.reset();
+        }
+        return *this;
+    }
+
+    //read only, shares everything including the block still being filled
+    SharedBlockArray share() const
+    {
+        SharedBlockArray out;
+        out.blocks = blocks;
+        out.front = front;
+        out.n = n;
+        out.frozenEnd = front + n;
+        frozenEnd = front + n;
+        return out;
+    }
+
+    int count() const { return n; }
+    bool isEmpty() const { return n == 0; }
+    int capacity() const { return blocks.count() * BLOCK - front; }
+    const T &at(int i) const
+    {
+        int p = front + i;
+        return blocks.at(p >> SHIFT)->items[p & (BLOCK - 1)];
+    }
+    T &write(int i)
+    {
+        int p = front + i;
+        std::shared_ptr<Block> &block = blocks[p >> SHIFT];
+        if (p < frozenEnd && block.use_count() > 1) block = std::make_shared<Block>(*block);
+        return block->items[p & (BLOCK - 1)];
+    }
+    void append(const T &item)
+    {
+        if (((front + n) >> SHIFT) >= blocks.count()) blocks.append(newBlock());
+        n++;
+        write(n - 1) = item;
+    }
+    void removeFirst(int num)
+    {
+        front += num;
+        n -= num;
+        int whole = front >> SHIFT;
+        if (whole == 0) return;
+        if (!spare && blocks.first().use_count() == 1) spare = blocks.first();
+        blocks.remove(0, whole);
+        front -= whole * BLOCK;
+        frozenEnd = qMax(0, frozenEnd - whole * BLOCK);
+    }
+    void truncate(int count)
+    {
+        if (count <= 0)
+        {
+            clear();
+            return;
+        }
+        n = qMin(n, count);
+        int needed = (front + n + BLOCK - 1) >> SHIFT;
+        if (needed < blocks.count()) blocks.resize(needed);
+    }
+    void remove(int idx, int num)
+    {
+        for (int i = idx; i + num < n; i++) write(i) = at(i + num);
+        truncate(n - num);
+    }
+    void reserve(int size) { blocks.reserve((front + size + BLOCK - 1) >> SHIFT); }
+    void clear()
+    {
+        blocks.clear();
+        front = 0;
+        n = 0;
+        frozenEnd = 0;
+    }
+    void squeeze()
+    {
+        blocks.squeeze();
+        spare.reset();
+    }
+    qint64 memoryBytes() const
+    {
+        return static_cast<qint64>(blocks.count() + (spare ? 1 : 0)) * static_cast<qint64>(sizeof(Block))
+             + static_cast<qint64>(blocks.capacity()) * static_cast<qint64>(sizeof(std::shared_ptr<Block>));
+    }
+
+private:
+    struct Block
+    {
+        T items[BLOCK];
+    };
+
+    std::shared_ptr<Block> newBlock()
+    {
+        if (spare && spare.use_count() == 1)
+        {
+            std::shared_ptr<Block> block = spare;
+            spare.reset();
+            return block;
+        }
+        return std::make_shared<Block>();
+    }
+
+    QVector<std::shared_ptr<Block>> blocks;
+    int front; //where item 0 is in blocks[0]
+    int n;
+    mutable int frozenEnd; //positions from blocks[0]'s start below this may be in a share
+    std::shared_ptr<Block> spare;
+};
+
+class CANFrameStore;
+
+/*
+ * What a store held at the moment CANFrameStore::snapshot was called, and it stays that way. Taking one costs a
+ * copy of the list of block pointers. Afterwards the store appends and evicts as usual without waiting on anybody,
+ * blocks the snapshot still needs are only freed once it's gone, and the first change to a frame the snapshot can
+ * see copies that frame's block. So a snapshot can be read from any thread while the GUI thread keeps ingesting.
+ *
+ * A snapshot on its own is safe to use from one thread at a time. Copies of it are cheap and can go to other threads.
+ */
+class CANFrameSnapshot
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const CANFrameSnapshot *snapshot, int idx) : s(snapshot), i(idx) {}
+        CANFrame operator*() const { return s->at(i); }
+        const_iterator &operator++() { ++i; return *this; }
+        bool operator==(const const_iterator &other) const { return i == other.i; }
+        bool operator!=(const const_iterator &other) const { return i != other.i; }
+        int index() const { return i; }
+    private:
+        const CANFrameSnapshot *s;
+        int i;
+    };
+
+    CANFrameSnapshot() : used(0), evicted(0) {}
+    //copies share every block, a plain copy would take its own copy of the block the store is still appending to
+    CANFrameSnapshot(const CANFrameSnapshot &other) :
+        records(other.records.share()), fdPool(other.fdPool.share()), mapped(other.mapped), used(other.used), evicted(other.evicted) {}
+    CANFrameSnapshot(CANFrameSnapshot &&other) = default;
+    CANFrameSnapshot &operator=(const CANFrameSnapshot &other)
+    {
+        records = other.records.share();
+        fdPool = other.fdPool.share();
+        mapped = other.mapped;
+        used = other.used;
+        evicted = other.evicted;
+        return *this;
+    }
+    CANFrameSnapshot &operator=(CANFrameSnapshot &&other) = default;
+
+    int count() const { return used; }
+    int size() const { return used; }
+    bool isEmpty() const { return used == 0; }
+    quint64 baseSequence() const { return evicted; }
+    quint64 sequenceOf(int idx) const { return evicted + static_cast<quint64>(idx); }
+    int indexOfSequence(quint64 seq) const
+    {
+        if (seq < evicted || seq - evicted >= static_cast<quint64>(used)) return -1;
+        return static_cast<int>(seq - evicted);
+    }
+
+    const CANFrameRecord &record(int idx) const { return mapped ? mapped->record(idx) : records.at(idx); }
+    const uint8_t *payloadData(int idx) const;
+    CANFrame at(int idx) const;
+    CANFrame operator[](int idx) const { return at(idx); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, used); }
+
+private:
+    friend class CANFrameStore;
+    struct FDPayload
+    {
+        uint8_t bytes[CANFrameRecord::MAX_BYTES];
+    };
+
+    SharedBlockArray<CANFrameRecord, 12> records;
+    SharedBlockArray<FDPayload, 8> fdPool;
+    QSharedPointer<const MappedCapture> mapped;
+    int used;
+    quint64 evicted;
+};
+
+/*
+ * Bulk frame storage. Frames go in as CANFrame and are packed down into CANFrameRecord. CAN-FD payloads that
+ * don't fit inline go into a side pool of 64 byte slots which get recycled as frames are removed.
+ *
+ * With a max capacity set (see setMaxCapacity) the store grows normally until it hits that size and then every
+ * append evicts the oldest frame in O(1) instead of shuffling the whole array down. Row 0 is always the oldest frame still held. Rows shift down as frames get evicted but the sequence
+ * number (baseSequence() + row) of a given frame never changes so anything that needs to remember a frame
+ * across updates should hang onto that instead of the row.
+ *
+ * Records are kept in blocks of 4096 so snapshot() can hand a frozen copy of the store to another thread in O(blocks)
+ * and so evicting frames off the front is dropping whole blocks. See CANFrameSnapshot.
+ *
+ * The read side purposely looks like QVector<CANFrame> (count, at, first, last, range for) so code that used to
+ * get a QVector reference from the model keeps working. at() has to build a CANFrame though, so hot loops that
+ * only need the ID, bus or a few bytes should use record() and payloadData() which don't allocate anything.
+ *
+ * With setSharedPayloads(true) identical FD payloads share one slot. Periodic FD traffic mostly repeats the same
+ * few payloads so a long capture ends up with a pool the size of its distinct payloads instead of its frame count.
+ * It's invisible to readers, payloadData() just points at the shared slot. Classic payloads are inline in the
+ * record either way so there's nothing to share for them.
+ *
+ * A store can also be attached to a MappedCapture. Then it holds nothing itself and every read goes straight to
+ * the mapped file so a huge binary capture can be browsed without loading it. Copies of the store share the
+ * mapping. The first thing that modifies a mapped store pulls the records into normal storage first.
+ *
+ * Or a store can be a view of another store (attachView). It then only holds a list of which of the source's frames
+ * it shows, in whatever order, 4 bytes each. Those are the low 32 bits of the frames' sequence numbers (a "key")
+ * so they stay correct while the source evicts frames off its front. The owner has to take rows out (pruneView)
+ * once their frames are evicted, and the source can't have more than 2^32 frames in it. swapItemsAt and remove
+ * work on the view itself. Anything else that modifies a view turns it back into a normal store with its own copies.
+ *
+ * With setIndexed(true) the store also keeps a posting list of rows for every bus / ID pair, updated as frames are
+ * appended and evicted, so idList / idInfo / rowsOf can answer without going through the whole store. Counts come
+ * from the lists and the first / last timestamps straight from the records so normalizing timestamps can't make
+ * them wrong. Views aren't indexed. Those queries still work on them, and on any other unindexed store, by scanning.
+ * An indexed store also keeps, for every block of 1024 frames, the lowest timestamp in that block or any later one.
+ * That only ever goes up even when a few frames from different connections arrive out of order so lastRowAtTime
+ * can binary search it and then only has to look through a single block.
+ */
+class CANFrameStore
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const CANFrameStore *store, int idx) : s(store), i(idx) {}
+        CANFrame operator*() const { return s->at(i); }
+        const_iterator &operator++() { ++i; return *this; }
+        bool operator==(const const_iterator &other) const { return i == other.i; }
+        bool operator!=(const const_iterator &other) const { return i != other.i; }
+        int index() const { return i; }
+    private:
+        const CANFrameStore *s;
+        int i;
+    };
+
+    CANFrameStore();
+
+    int count() const { return used; }
+    int size() const { return used; }
+    int length() const { return used; }
+    bool isEmpty() const { return used == 0; }
+    int capacity() const;
+    void reserve(int size);
+    void setMaxCapacity(int maxFrames); //0 = unbounded, otherwise oldest frames are overwritten past this
+    //Mapped stores aren't trimmed to the max capacity until something forces them into memory
+    int maxCapacity() const { return maxFrames; }
+    bool isFull() const { return maxFrames > 0 && used >= maxFrames; }
+    void setSharedPayloads(bool on) { sharePayloads = on; } //only affects payloads stored from then on
+    bool sharedPayloads() const { return sharePayloads; }
+    int payloadSlots() const { return fdPool.count() - fdFreeSlots.count(); } //FD payloads actually held
+
+    //sequence number of row 0. Goes up by one for every frame evicted off the front
+    quint64 baseSequence() const { return evicted; }
+    quint64 sequenceOf(int idx) const { return evicted + static_cast<quint64>(idx); }
+    int indexOfSequence(quint64 seq) const; //-1 if that frame has already been evicted or doesn't exist yet
+    //first row of the newest num frames. Windows use this to scan just what came in since their last update.
+    //If more than a store's worth arrived in one go the older ones are already gone so this never goes below 0
+    int tailIndex(int num) const { return (num >= used) ? 0 : used - num; }
+
+    CANFrame at(int idx) const;
+    CANFrame operator[](int idx) const { return at(idx); }
+    CANFrame first() const { return at(0); }
+    CANFrame last() const { return at(used - 1); }
+    const CANFrameRecord &record(int idx) const
+    {
+        if (source) return source->record(sourceRow(idx));
+        if (mapped) return mapped->record(idx);
+        return records.at(idx);
+    }
+    const uint8_t *payloadData(int idx) const;
+    int payloadLength(int idx) const { return record(idx).len; }
+
+    void attach(QSharedPointer<const MappedCapture> capture); //replaces the contents with a view of the capture
+    //the ID index as flat arrays, rows counted from row 0 as it is now. Kept next to a capture (see workspace.h) it
+    //lets attach skip going through every frame to build the index again. Empty for a store that isn't indexed
+    struct SavedIndex
+    {
+        QVector<uint64_t> pairs;    //idKey of each bus / ID pair
+        QVector<quint32> starts;    //where each pair's rows start in rows, with rows.count() on the end
+        QVector<quint32> rows;      //oldest first within each pair
+    };
+    SavedIndex savedIndex() const;
+    //same as attach but takes the ID index from index. One that doesn't fit the capture gets ignored and the index
+    //is built the usual way instead. The time index is always built, that's only one pass over the timestamps
+    void attach(QSharedPointer<const MappedCapture> capture, const SavedIndex &index);
+    bool isMapped() const { return !mapped.isNull(); }
+
+    //low 32 bits of a frame's sequence number and back. -1 if the frame isn't in the store anymore (or yet)
+    quint32 keyOf(int idx) const { return static_cast<quint32>(evicted + static_cast<quint64>(idx)); }
+    int indexOfKey(quint32 key) const
+    {
+        quint32 idx = key - static_cast<quint32>(evicted);
+        return (idx < static_cast<quint32>(used)) ? static_cast<int>(idx) : -1;
+    }
+
+    void attachView(const CANFrameStore *viewSource); //replaces the contents with an empty view of viewSource
+    bool isView() const { return source != nullptr; }
+    const CANFrameStore *viewSource() const { return source; }
+    int sourceRow(int idx) const { return static_cast<int>(viewKeys.at(viewHead + idx) - static_cast<quint32>(source->evicted)); }
+    quint32 sourceKey(int idx) const { return viewKeys.at(viewHead + idx); }
+    void appendKey(quint32 key) { viewKeys.append(key); used++; }
+    void setKey(int idx, quint32 key) { viewKeys[viewHead + idx] = key; }
+    void setKeys(const QVector<quint32> &keys); //the whole view in one go
+    QVector<quint32> keys() const;
+    int pruneView(bool frontOnly); //drop rows whose frames the source evicted. Returns how many went
+
+    struct IdInfo
+    {
+        uint32_t id;
+        int bus;
+        int count;
+        uint64_t firstStamp;
+        uint64_t lastStamp;
+    };
+    static uint64_t idKey(uint32_t id, int bus) { return id | (static_cast<uint64_t>(static_cast<uint32_t>(bus)) << 32); }
+    void setIndexed(bool on);
+    bool isIndexed() const { return indexed; }
+    QVector<IdInfo> idList() const; //every bus / ID pair in the store, by ID then bus
+    bool idInfo(uint32_t id, int bus, IdInfo &info) const; //bus -1 adds up all buses. False if the ID isn't there
+    QVector<int> rowsOf(uint32_t id, int bus = -1) const; //oldest first. bus -1 is any bus
+    //newest two frames of one type of every bus / ID pair, for overwrite mode. No frame count of its own
+    struct IdLatest
+    {
+        uint32_t id;
+        int bus;
+        int count;      //frames of the pair, any type. Of just that type when the store isn't indexed
+        int row;        //newest frame of the type
+        int previous;   //the one before it, -1 if there's only the one
+    };
+    //an indexed store only goes back along each pair's list until it has two. Pairs without the type are left out
+    QVector<IdLatest> latestList(QCanBusFrame::FrameType type) const;
+    int lastRowAtTime(uint64_t stamp) const; //newest row stamped at or before stamp. -1 if there isn't one
+    int lastRowAtTime(uint32_t id, int bus, uint64_t stamp) const; //same but only rows of this ID. bus -1 is any bus
+    void rebuildTimeIndex(); //after a run of setTimestamp. Until then the time lookups scan
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, used); }
+
+    void append(const CANFrame &frame);
+    void append(const QVector<CANFrame> &frames);
+    void append(const CANFrameStore &other, int idx); //copy one frame straight across without unpacking it
+    void replace(int idx, const CANFrame &frame);
+    void setTimestamp(int idx, uint64_t timestamp);
+    void swapItemsAt(int i, int j);
+    void remove(int idx, int num);
+    void clear();
+
+    QVector<CANFrame> toVector() const;
+    QVector<CANFrame> mid(int pos, int len = -1) const;
+
+    //the first rows frames (all of them for -1) as they are right now, for reading from another thread. Has to be
+    //called on the thread that modifies the store. A view can't be snapshotted and gives an empty one
+    CANFrameSnapshot snapshot(int rows = -1) const;
+
+    qint64 memoryBytes() const; //heap held by the store and its indexes. A mapped capture's file isn't counted
+    qint64 squeeze(); //give back spare capacity, returns about how many bytes that was
+
+private:
+    typedef CANFrameSnapshot::FDPayload FDPayload;
+
+    uint32_t allocFDSlot();
+    uint32_t storeFD(const uint8_t *bytes, int len);
+    static uint64_t payloadHash(const FDPayload &payload);
+    void pack(const CANFrame &frame, CANFrameRecord &rec);
+    void release(const CANFrameRecord &rec);
+    void push(const CANFrameRecord &rec);
+    void detach();
+    void indexLast();
+    void unindexFront(int idx);
+    void rebuildIndex();
+    void indexTime(int idx);
+
+    static constexpr int TIME_BLOCK_SHIFT = 10;
+    static constexpr quint64 TIME_BLOCK_MASK = (1ull << TIME_BLOCK_SHIFT) - 1;
+
+    //rows of one bus / ID pair as keys (see keyOf), oldest first
+    struct Postings
+    {
+        QVector<quint32> keys;
+        int head = 0; //keys before this were evicted
+    };
+
+    SharedBlockArray<CANFrameRecord, 12> records; //row 0 is the oldest frame held
+    int used;
+    int maxFrames;
+    quint64 evicted;
+    SharedBlockArray<FDPayload, 8> fdPool;
+    QVector<uint32_t> fdFreeSlots;
+    QVector<uint32_t> fdRefs; //records using each slot. Always 1 unless payloads are shared
+    QHash<uint64_t, uint32_t> fdShared; //payloadHash -> the slot holding that payload
+    bool sharePayloads;
+    QSharedPointer<const MappedCapture> mapped; //set while this store is just a view of a capture file
+    const CANFrameStore *source; //set while this store is a view of another one
+    QVector<quint32> viewKeys; //keys of the viewed frames. The live ones start at viewHead
+    int viewHead;
+    bool indexed;
+    QHash<uint64_t, Postings> idIndex; //idKey -> its rows
+    QVector<uint64_t> timeBlocks; //lowest stamp from each block of sequence numbers on. The live ones start at timeHead
+    int timeHead;
+    quint64 timeBase; //block number (sequence >> TIME_BLOCK_SHIFT) of timeBlocks[timeHead]
+    bool timeStale; //timestamps were changed in place since the blocks were worked out
+};
+
+#endif // CANFRAMESTORE_H
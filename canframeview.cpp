@@ -0,0 +1,468 @@
+#include "canframeview.h"
+#include "mainwindow.h"
+#include "pipelinetrace.h"
+
+#include <QApplication>
+#include <QPalette>
+#include <algorithm>
+
+namespace
+{
+quint64 cellKey(quint32 frameKey, Column col)
+{
+    return (static_cast<quint64>(frameKey) << 4) | static_cast<quint64>(col);
+}
+}
+
+CANFrameView::CANFrameView(CANFrameModel *list, QObject *parent)
+    : QAbstractTableModel(parent), list(list), frames(list->getListReference())
+{
+    rows.attachView(frames);
+    visibleRows = 0;
+    syncedTo = 0;
+    bus = -1;
+    overwrite = false;
+    changesOnly = false;
+    dirtyRowLow = 1;
+    dirtyRowHigh = 0;
+    sortColumn = -1;
+    sortAsc = false;
+    sorted = false;
+    fmt = list->cellFormat();
+    fmt.overwrite = false;
+    cellCache.setMaxCost(CANFRAMEVIEW_CELL_CACHE);
+    cacheDbcRevision = DBCHandler::getRevision();
+
+    connect(list, &CANFrameModel::displayChanged, this, &CANFrameView::displayChanged);
+    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    rebuild();
+}
+
+int CANFrameView::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return qMin(visibleRows, rows.count());
+}
+
+int CANFrameView::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return (int)Column::NUM_COLUMN;
+}
+
+int CANFrameView::sourceRow(int row) const
+{
+    if (row < 0 || row >= rows.count()) return -1;
+    return frames->indexOfKey(rows.sourceKey(row));
+}
+
+QVariant CANFrameView::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.count()) return QVariant();
+    //between the list being cleared and the update that says so the keys can point at nothing
+    int idx = sourceRow(index.row());
+    if (idx < 0) return QVariant();
+
+    Column col = Column(index.column());
+    quint64 cacheKey = 0;
+    bool cacheable = (role == Qt::DisplayRole) && isCachedColumn(col);
+    if (cacheable)
+    {
+        checkDisplayCache();
+        cacheKey = cellKey(rows.sourceKey(index.row()), col);
+        QString *cached = cellCache.object(cacheKey);
+        if (cached) return *cached;
+    }
+
+    if (role == Qt::TextAlignmentRole) return static_cast<int>(CANFrameModel::columnAlignment(col));
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole && role != Qt::BackgroundRole && role != Qt::ForegroundRole) return QVariant();
+    //the rows are one line high, the whole data column (decoded signals and all) is in the tooltip
+    if (role == Qt::ToolTipRole && col != Column::Data) return QVariant();
+
+    CANFrame thisFrame = frames->at(idx);
+    thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(list->frameStamp(idx))));
+    if (overwrite && index.row() < overwriteInfo.count())
+    {
+        thisFrame.timedelta = overwriteInfo[index.row()].timedelta;
+        thisFrame.frameCount = overwriteInfo[index.row()].frameCount;
+    }
+
+    if (role == Qt::BackgroundRole || role == Qt::ForegroundRole)
+    {
+        if (fmt.interpret && !list->getIgnoreDBCColors())
+        {
+            DBC_MESSAGE *msg = DBCHandler::getReference()->findMessage(thisFrame);
+            if (msg != nullptr) return (role == Qt::BackgroundRole) ? msg->bgColor : msg->fgColor;
+        }
+        if (role == Qt::ForegroundRole) return QApplication::palette().color(QPalette::WindowText);
+        if (index.row() % 2) return QApplication::palette().color(QPalette::Base);
+        return QApplication::palette().color(QPalette::AlternateBase);
+    }
+
+    QString text = CANFrameModel::cellText(thisFrame, col, fmt);
+    if (cacheable) cellCache.insert(cacheKey, new QString(text));
+    return text;
+}
+
+QVariant CANFrameView::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) return QVariant();
+    if (orientation == Qt::Horizontal) return CANFrameModel::columnTitle(Column(section), overwrite);
+    return QString::number(section + 1);
+}
+
+void CANFrameView::setBus(int newBus)
+{
+    if (bus == newBus) return;
+    bus = newBus;
+    rebuild();
+}
+
+bool CANFrameView::setFilterExpression(const QString &text, QString &error)
+{
+    QSharedPointer<const FilterExpression> expr = FilterExpression::compile(text, &error);
+    if (!expr && !text.trimmed().isEmpty()) return false;
+    filterExpression = expr;
+    filterExpressionText = text.trimmed();
+    rebuild();
+    return true;
+}
+
+void CANFrameView::setOverwriteMode(bool mode)
+{
+    if (overwrite == mode) return;
+    overwrite = mode;
+    fmt.overwrite = mode;
+    cellCache.clear(); //the time column turns into time deltas and back
+    rebuild();
+    emit headerDataChanged(Qt::Horizontal, 0, (int)Column::NUM_COLUMN - 1);
+}
+
+void CANFrameView::setChangesOnlyMode(bool mode)
+{
+    if (changesOnly == mode) return;
+    changesOnly = mode;
+    if (!overwrite) rebuild();
+}
+
+//the expression holds on to DBC signals, so it gets compiled again once the DBC files change
+const FilterExpression *CANFrameView::currentExpression()
+{
+    if (!filterExpression || filterExpression->isCurrent()) return filterExpression.data();
+    QString error;
+    QSharedPointer<const FilterExpression> expr = FilterExpression::compile(filterExpressionText, &error);
+    if (!expr)
+    {
+        //a signal it used is gone. Nothing matches until the expression gets fixed instead of everything showing
+        qDebug() << "Frame view filter expression no longer compiles:" << error;
+        expr = FilterExpression::compile("0");
+    }
+    filterExpression = expr;
+    return filterExpression.data();
+}
+
+/*
+ * Everything again from the start of the store. In overwrite mode without an expression that's just the newest
+ * frame of every bus / ID pair, which the store's index already has, so it doesn't depend on the capture's size.
+ */
+void CANFrameView::rebuild()
+{
+    TRACE_SCOPE("CANFrameView::rebuild");
+    beginResetModel();
+    rows.attachView(frames);
+    overwriteInfo.clear();
+    overwriteRows.clear();
+    changeTable.reset();
+    changeTable.setIgnoreMask(list->getChangeIgnoreMask());
+    sortColumn = -1;
+    sorted = false;
+    dirtyRowLow = 1;
+    dirtyRowHigh = 0;
+
+    if (overwrite && !currentExpression())
+    {
+        const QVector<CANFrameStore::IdLatest> latest = frames->latestList(QCanBusFrame::DataFrame);
+        rows.reserve(latest.count());
+        for (const CANFrameStore::IdLatest &pair : latest)
+        {
+            if (bus >= 0 && pair.bus != bus) continue;
+            OverwriteInfo info;
+            info.frameCount = static_cast<uint32_t>(pair.count);
+            info.timedelta = (pair.previous < 0) ? 0 : frames->record(pair.row).timestamp - frames->record(pair.previous).timestamp;
+            rows.appendKey(frames->keyOf(pair.row));
+            overwriteInfo.append(info);
+        }
+        rebuildOverwriteIndex();
+    }
+    else scan(0);
+
+    syncedTo = frames->baseSequence() + static_cast<quint64>(frames->count());
+    visibleRows = rows.count();
+    dirtyRowLow = 1;
+    dirtyRowHigh = 0;
+    endResetModel();
+}
+
+void CANFrameView::scan(int from)
+{
+    const FilterExpression *expr = currentExpression();
+    for (int i = from; i < frames->count(); i++)
+    {
+        const CANFrameRecord &rec = frames->record(i);
+        if (bus >= 0 && rec.bus != bus) continue;
+        if (overwrite && rec.type() != QCanBusFrame::DataFrame) continue;
+        if (expr && !expr->matches(rec, frames->payloadData(i))) continue;
+
+        if (!overwrite)
+        {
+            if (changesOnly && !changeTable.update(rec, frames->payloadData(i))) continue;
+            rows.appendKey(frames->keyOf(i));
+            continue;
+        }
+
+        uint64_t pair = CANFrameStore::idKey(rec.frameId(), rec.bus);
+        QHash<uint64_t, int>::const_iterator it = overwriteRows.constFind(pair);
+        if (it == overwriteRows.constEnd())
+        {
+            OverwriteInfo info;
+            info.timedelta = 0;
+            info.frameCount = 1;
+            overwriteRows.insert(pair, rows.count());
+            rows.appendKey(frames->keyOf(i));
+            overwriteInfo.append(info);
+            continue;
+        }
+        int row = it.value();
+        int previous = frames->indexOfKey(rows.sourceKey(row));
+        OverwriteInfo &info = overwriteInfo[row];
+        info.timedelta = (previous < 0) ? 0 : rec.timestamp - frames->record(previous).timestamp;
+        info.frameCount++;
+        rows.setKey(row, frames->keyOf(i));
+        markRowDirty(row);
+    }
+}
+
+void CANFrameView::updatedFrames(int numFrames)
+{
+    TRACE_SCOPE("CANFrameView::updatedFrames");
+    //a signal the expression decodes might have changed, which frames pass along with it
+    if (numFrames < 0 || (filterExpression && !filterExpression->isCurrent()))
+    {
+        rebuild();
+        return;
+    }
+
+    if (hasEvicted())
+    {
+        //rows go from anywhere, the view can't keep its place through that
+        beginResetModel();
+        dropEvicted();
+        int kept = rows.count();
+        int from = frames->indexOfSequence(syncedTo);
+        scan((from < 0) ? 0 : from);
+        syncedTo = frames->baseSequence() + static_cast<quint64>(frames->count());
+        if (rows.count() > kept) sortColumn = -1;
+        visibleRows = rows.count();
+        dirtyRowLow = 1;
+        dirtyRowHigh = 0;
+        endResetModel();
+        return;
+    }
+
+    int from = frames->indexOfSequence(syncedTo);
+    if (from < 0 && syncedTo < frames->baseSequence()) from = 0;
+    if (from >= 0) scan(from);
+    syncedTo = frames->baseSequence() + static_cast<quint64>(frames->count());
+
+    //new rows go on the bottom, even under a sort. The sort is stale from then on
+    if (rows.count() > visibleRows)
+    {
+        beginInsertRows(QModelIndex(), visibleRows, rows.count() - 1);
+        visibleRows = rows.count();
+        sortColumn = -1;
+        endInsertRows();
+    }
+    if (dirtyRowLow <= dirtyRowHigh)
+    {
+        int high = qMin(dirtyRowHigh, visibleRows - 1);
+        if (high >= dirtyRowLow) emit dataChanged(index(dirtyRowLow, 0), index(high, (int)Column::NUM_COLUMN - 1));
+        dirtyRowLow = 1;
+        dirtyRowHigh = 0;
+    }
+}
+
+//in frame order the oldest row is the one to go first, otherwise every row has to be looked at
+bool CANFrameView::hasEvicted() const
+{
+    if (rows.isEmpty()) return false;
+    if (!sorted && !overwrite) return frames->indexOfKey(rows.sourceKey(0)) < 0;
+    for (int i = 0; i < rows.count(); i++)
+    {
+        if (frames->indexOfKey(rows.sourceKey(i)) < 0) return true;
+    }
+    return false;
+}
+
+void CANFrameView::dropEvicted()
+{
+    if (!overwrite)
+    {
+        rows.pruneView(!sorted);
+        return;
+    }
+    //a pair that went a whole store without a frame. Its row and bookkeeping go together
+    QVector<quint32> keys;
+    QVector<OverwriteInfo> info;
+    keys.reserve(rows.count());
+    info.reserve(rows.count());
+    for (int i = 0; i < rows.count(); i++)
+    {
+        if (frames->indexOfKey(rows.sourceKey(i)) < 0) continue;
+        keys.append(rows.sourceKey(i));
+        if (i < overwriteInfo.count()) info.append(overwriteInfo.at(i));
+    }
+    rows.setKeys(keys);
+    overwriteInfo = info;
+    rebuildOverwriteIndex();
+}
+
+void CANFrameView::rebuildOverwriteIndex()
+{
+    overwriteRows.clear();
+    overwriteRows.reserve(rows.count());
+    for (int i = 0; i < rows.count(); i++)
+    {
+        const CANFrameRecord &rec = rows.record(i);
+        overwriteRows.insert(CANFrameStore::idKey(rec.frameId(), rec.bus), i);
+    }
+    if (overwriteInfo.count() < rows.count()) overwriteInfo.resize(rows.count());
+}
+
+void CANFrameView::markRowDirty(int row)
+{
+    if (dirtyRowLow > dirtyRowHigh)
+    {
+        dirtyRowLow = dirtyRowHigh = row;
+        return;
+    }
+    if (row < dirtyRowLow) dirtyRowLow = row;
+    if (row > dirtyRowHigh) dirtyRowHigh = row;
+}
+
+uint64_t CANFrameView::sortValue(int row, Column col) const
+{
+    switch (col)
+    {
+    case Column::TimeStamp:
+        if (overwrite && row < overwriteInfo.count()) return overwriteInfo.at(row).timedelta;
+        return list->frameStamp(rows.sourceRow(row));
+    case Column::Remote:
+        if (overwrite && row < overwriteInfo.count()) return overwriteInfo.at(row).frameCount;
+        break;
+    default:
+        break;
+    }
+    return CANFrameModel::recordValue(rows, row, col);
+}
+
+//only the keys (and overwrite bookkeeping) move, same as the list's sort
+void CANFrameView::sortByColumn(int column)
+{
+    TRACE_SCOPE("CANFrameView::sortByColumn");
+    sortAsc = !sortAsc;
+    int count = rows.count();
+    QVector<int> order(count);
+    for (int i = 0; i < count; i++) order[i] = i;
+
+    if (column == sortColumn) std::reverse(order.begin(), order.end());
+    else
+    {
+        QVector<uint64_t> sortKeys(count);
+        for (int i = 0; i < count; i++) sortKeys[i] = sortValue(i, Column(column));
+        bool ascending = sortAsc;
+        std::stable_sort(order.begin(), order.end(), [&sortKeys, ascending](int a, int b)
+        {
+            return ascending ? sortKeys[a] < sortKeys[b] : sortKeys[a] > sortKeys[b];
+        });
+    }
+
+    QVector<quint32> keys(count);
+    for (int i = 0; i < count; i++) keys[i] = rows.sourceKey(order.at(i));
+    beginResetModel();
+    rows.setKeys(keys);
+    if (overwrite && overwriteInfo.count() == count)
+    {
+        QVector<OverwriteInfo> info(count);
+        for (int i = 0; i < count; i++) info[i] = overwriteInfo.at(order.at(i));
+        overwriteInfo = info;
+        rebuildOverwriteIndex();
+    }
+    sorted = true;
+    sortColumn = column;
+    visibleRows = rows.count();
+    endResetModel();
+}
+
+//same rule as the list: the decoded data column in overwrite mode carries multiplexed values along, so it's fresh
+bool CANFrameView::isCachedColumn(Column col) const
+{
+    switch (col)
+    {
+    case Column::TimeStamp:
+    case Column::FrameId:
+    case Column::ASCII:
+        return true;
+    case Column::Data:
+        return !(overwrite && fmt.interpret);
+    default:
+        return false;
+    }
+}
+
+void CANFrameView::checkDisplayCache() const
+{
+    quint32 revision = DBCHandler::getRevision();
+    if (cacheDbcRevision == revision) return;
+    cacheDbcRevision = revision;
+    if (fmt.interpret) cellCache.clear();
+}
+
+void CANFrameView::displayChanged()
+{
+    fmt = list->cellFormat();
+    fmt.overwrite = overwrite;
+    cellCache.clear();
+    if (rowCount() > 0) emit dataChanged(index(0, 0), index(rowCount() - 1, (int)Column::NUM_COLUMN - 1));
+}
+
+void CANFrameView::reportMemory(QVector<MemoryUsage> &out) const
+{
+    using MemoryAccounting::bytesOf;
+    qint64 cached = 0;
+    const QList<quint64> keys = cellCache.keys();
+    for (quint64 key : keys)
+    {
+        const QString *text = cellCache.object(key);
+        if (text) cached += bytesOf(*text) + static_cast<qint64>(sizeof(quint64) + 4 * sizeof(void *));
+    }
+    QString owner = memoryOwner("Frame View");
+    out.append({owner, "shown frames", rows.memoryBytes()});
+    if (overwrite) out.append({owner, "overwrite mode tracking", bytesOf(overwriteInfo) + bytesOf(overwriteRows)});
+    if (changesOnly) out.append({owner, "changes only tracking", changeTable.bytes()});
+    out.append({owner, "formatted cell cache", cached});
+}
+
+qint64 CANFrameView::purgeMemory()
+{
+    QVector<MemoryUsage> before;
+    reportMemory(before);
+    cellCache.clear();
+    rows.squeeze();
+    overwriteInfo.squeeze();
+    QVector<MemoryUsage> after;
+    reportMemory(after);
+    qint64 freed = 0;
+    for (const MemoryUsage &usage : before) freed += usage.bytes;
+    for (const MemoryUsage &usage : after) freed -= usage.bytes;
+    return freed;
+}
@@ -0,0 +1,110 @@
+#ifndef CANFRAMEVIEW_H
+#define CANFRAMEVIEW_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QHash>
+#include <QSharedPointer>
+#include <QVector>
+#include "canframemodel.h"
+#include "canframestore.h"
+#include "filterexpression.h"
+#include "payloadchangetable.h"
+#include "memoryaccounting.h"
+
+//cells worth of formatted text each view keeps around
+#define CANFRAMEVIEW_CELL_CACHE     10000
+
+/*
+ * Another look at the main frame list's frames, with its own bus, filter expression, overwrite and changes only
+ * modes and sort. Any number of them can be open side by side (powertrain on one, body on another, diagnostics
+ * on a third) and none of them copies a frame: each is a view of the list's store (CANFrameStore::attachView),
+ * 4 bytes a shown frame, plus the overwrite bookkeeping for its rows and its own formatted text cache. The text
+ * itself comes from the same code as the main list (CANFrameModel::cellText) with the list's hex, time and
+ * interpret settings, so a frame looks the same wherever it's shown.
+ *
+ * Kept up to date from framesUpdated. Appended frames are looked at once each, from where the last update got
+ * to, and new rows announced with an insert so scroll position and selection stay put. Frames the store evicted
+ * get their rows taken out. A cleared or replaced list (-1 / -2) and any change to the view's own settings go
+ * through the whole store again.
+ *
+ * GUI thread only, like the list.
+ */
+class CANFrameView : public QAbstractTableModel, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    explicit CANFrameView(CANFrameModel *list, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setBus(int bus); //-1 for every bus
+    int getBus() const { return bus; }
+    //blank text takes it off again. False with what's wrong in error if it doesn't parse, the old one stays
+    bool setFilterExpression(const QString &text, QString &error);
+    QString getFilterExpression() const { return filterExpressionText; }
+    void setOverwriteMode(bool mode);
+    bool getOverwriteMode() const { return overwrite; }
+    //uses the list's ignore mask. Overwrite mode wins over it, as in the list
+    void setChangesOnlyMode(bool mode);
+    bool getChangesOnlyMode() const { return changesOnly; }
+    void sortByColumn(int column); //the same column again turns it around
+    int sourceRow(int row) const; //row of the list's store, -1 if the frame has been evicted
+    int totalFrameCount() const { return frames->count(); }
+
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+    qint64 purgeMemory() override; //the cell cache and spare capacity
+
+public slots:
+    void updatedFrames(int numFrames);
+
+private slots:
+    void displayChanged();
+
+private:
+    struct OverwriteInfo
+    {
+        uint64_t timedelta;
+        uint32_t frameCount;
+    };
+
+    void rebuild();
+    void scan(int from); //frames from that row of the store to the end
+    bool hasEvicted() const;
+    void dropEvicted();
+    void rebuildOverwriteIndex();
+    void markRowDirty(int row);
+    const FilterExpression *currentExpression();
+    bool isCachedColumn(Column col) const;
+    void checkDisplayCache() const;
+    uint64_t sortValue(int row, Column col) const;
+
+    CANFrameModel *list;
+    const CANFrameStore *frames; //the list's, never modified from here
+    CANFrameStore rows; //view of frames, the shown ones in shown order
+    int visibleRows; //rows the view has been told about, the rest get announced at the end of an update
+    quint64 syncedTo; //sequence of the next frame of the store to look at
+    int bus;
+    QSharedPointer<const FilterExpression> filterExpression; //null for none
+    QString filterExpressionText;
+    bool overwrite;
+    bool changesOnly;
+    PayloadChangeTable changeTable;
+    QVector<OverwriteInfo> overwriteInfo; //parallel to rows in overwrite mode
+    QHash<uint64_t, int> overwriteRows; //CANFrameStore::idKey -> row in overwrite mode
+    int dirtyRowLow, dirtyRowHigh; //rows updated in place during an update. low > high means none
+    int sortColumn; //-1 once rows were added since the last sort
+    bool sortAsc;
+    bool sorted; //rows aren't in frame order, evicted ones could be anywhere
+    CANFrameModel::CellFormat fmt; //the list's, with this view's overwrite mode
+
+    //keyed like the list's cache, on the frame's key and the column
+    mutable QCache<quint64, QString> cellCache;
+    mutable quint32 cacheDbcRevision;
+};
+
+#endif // CANFRAMEVIEW_H
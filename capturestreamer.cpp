@@ -0,0 +1,77 @@
+#include "capturestreamer.h"
+
+#include <QMutexLocker>
+
+CaptureStreamer::CaptureStreamer(QSharedPointer<const MappedCapture> capture) : capture(capture)
+{
+    active = 0;
+    requested = -1;
+    busy = false;
+    quit = false;
+    reader = QThread::create([this]{ readerLoop(); });
+    reader->start();
+}
+
+CaptureStreamer::~CaptureStreamer()
+{
+    mutex.lock();
+    quit = true;
+    wake.wakeAll();
+    mutex.unlock();
+    reader->wait();
+    delete reader;
+}
+
+const CANFrame &CaptureStreamer::at(int idx)
+{
+    Chunk *cur = &chunks[active];
+    if (cur->holds(idx)) return cur->frames[idx - cur->first];
+
+    int first = idx - idx % STREAM_CHUNK_FRAMES;
+    bool forward = (cur->first < 0) || (first > cur->first);
+
+    //the spare buffer has to be back from the reader before it can be touched
+    mutex.lock();
+    while (busy) done.wait(&mutex);
+    mutex.unlock();
+
+    Chunk &spare = chunks[1 - active];
+    if (spare.first != first) decode(spare, first); //not the next one along so the reader couldn't have had it ready
+    active = 1 - active;
+
+    int next = forward ? first + STREAM_CHUNK_FRAMES : first - STREAM_CHUNK_FRAMES;
+    if (next >= 0 && next < count())
+    {
+        mutex.lock();
+        requested = next;
+        busy = true;
+        wake.wakeOne();
+        mutex.unlock();
+    }
+    return chunks[active].frames[idx - first];
+}
+
+void CaptureStreamer::decode(Chunk &chunk, int first) const
+{
+    int num = qMin(STREAM_CHUNK_FRAMES, count() - first);
+    chunk.first = first;
+    chunk.frames.resize(num);
+    for (int i = 0; i < num; i++) chunk.frames[i] = capture->at(first + i);
+}
+
+void CaptureStreamer::readerLoop()
+{
+    QMutexLocker lock(&mutex);
+    for (;;)
+    {
+        while (!busy && !quit) wake.wait(&mutex);
+        if (quit) return;
+        Chunk &spare = chunks[1 - active];
+        int first = requested;
+        lock.unlock();
+        decode(spare, first);
+        lock.relock();
+        busy = false;
+        done.wakeAll();
+    }
+}
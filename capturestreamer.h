@@ -0,0 +1,60 @@
+#ifndef CAPTURESTREAMER_H
+#define CAPTURESTREAMER_H
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include "binarycapture.h"
+
+//frames decoded into each of the two buffers, one on disk block's worth
+#define STREAM_CHUNK_FRAMES     BINARY_FRAMES_PER_BLOCK
+
+/*
+ * Sequential access to a binary capture that stays on disk, for playback. Two buffers of decoded frames are kept:
+ * the one the cursor is in and the one next to it in the direction it's moving, which a reader thread decodes while
+ * the first is being played. Crossing into the next buffer swaps them and starts the reader on the one after that.
+ * Anything else (jumping somewhere, wrapping around at the end of a loop) decodes the buffer it lands in right
+ * away. The capture's own block index is what finds the records for any position, so there's nothing to build up
+ * front and memory use stays at two buffers whatever size the file is.
+ *
+ * at() is meant to be called from one thread at a time.
+ */
+class CaptureStreamer
+{
+public:
+    explicit CaptureStreamer(QSharedPointer<const MappedCapture> capture);
+    ~CaptureStreamer();
+
+    int count() const { return capture->count(); }
+    const MappedCapture &source() const { return *capture; }
+    //the reference is only good until the next call, buffers get reused
+    const CANFrame &at(int idx);
+
+private:
+    struct Chunk
+    {
+        int first = -1;
+        QVector<CANFrame> frames;
+        bool holds(int idx) const { return first >= 0 && idx >= first && idx < first + frames.count(); }
+    };
+
+    void decode(Chunk &chunk, int first) const;
+    void readerLoop();
+
+    QSharedPointer<const MappedCapture> capture;
+    Chunk chunks[2];
+    int active; //the one at() hands out of. The other belongs to the reader while busy is set
+    QThread *reader;
+    QMutex mutex;
+    QWaitCondition wake; //reader waits on this for work
+    QWaitCondition done; //at() waits on this for the reader to finish
+    int requested;
+    bool busy;
+    bool quit;
+
+    Q_DISABLE_COPY(CaptureStreamer)
+};
+
+#endif // CAPTURESTREAMER_H
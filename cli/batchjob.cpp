@@ -0,0 +1,342 @@
+#include "batchjob.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <algorithm>
+#include <climits>
+
+#include "framefileio.h"
+#include "compressedlog.h"
+#include "utility.h"
+#include "dbc/dbchandler.h"
+
+namespace {
+
+//each job's own (bus, ID) -> message table so an ID only goes through DBCHandler once. Lookups there only read so
+//the jobs don't have to take turns
+class MessageLookup
+{
+public:
+    DBC_MESSAGE *find(const CANFrame &frame)
+    {
+        quint64 key = (static_cast<quint64>(static_cast<quint32>(frame.bus)) << 32)
+                | frameLoadKey(frame.frameId(), frame.hasExtendedFrameFormat());
+        auto it = cache.constFind(key);
+        if (it != cache.constEnd()) return it.value();
+
+        DBC_MESSAGE *msg = DBCHandler::getReference()->findMessage(frame);
+        cache.insert(key, msg);
+        return msg;
+    }
+
+private:
+    QHash<quint64, DBC_MESSAGE *> cache;
+};
+
+//lines go into one buffer with the Utility::write* functions and out to the file a megabyte at a time
+class CsvOut
+{
+public:
+    bool open(const QString &name)
+    {
+        file.setFileName(name);
+        data.reserve(BATCHJOB_FLUSH_BYTES + 4096);
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+
+    void put(char c) { data.append(c); }
+    void put(const char *text) { data.append(text); }
+    void put(const QByteArray &text) { data.append(text); }
+    void putDec(uint64_t value)
+    {
+        char text[UTILITY_FORMAT_CHARS];
+        data.append(text, static_cast<int>(Utility::writeDecimal(text, value) - text));
+    }
+    void putID(uint32_t id, bool extended)
+    {
+        char text[UTILITY_FORMAT_CHARS];
+        char *end = Utility::writeHex(text + 2, id, extended ? 8 : 3);
+        text[0] = '0';
+        text[1] = 'x';
+        data.append(text, static_cast<int>(end - text));
+    }
+    //microseconds as seconds, all six places
+    void putSeconds(int64_t micros)
+    {
+        char text[UTILITY_FORMAT_CHARS];
+        data.append(text, static_cast<int>(Utility::writeFixed(text, micros, 6, 6) - text));
+    }
+    void putDouble(double value) { data.append(QByteArray::number(value, 'g', 12)); }
+
+    void lineDone()
+    {
+        put('\n');
+        if (data.size() >= BATCHJOB_FLUSH_BYTES) flush();
+    }
+    bool close()
+    {
+        flush();
+        file.close();
+        return ok;
+    }
+
+private:
+    void flush()
+    {
+        if (!data.isEmpty() && file.write(data) != data.size()) ok = false;
+        data.clear();
+    }
+
+    QFile file;
+    QByteArray data;
+    bool ok = true;
+};
+
+/*
+ * One column per signal of every message that turns up in the file, in the order the messages first turn up, and a
+ * row per frame that has a message. Only the frame's own message's columns are filled in, the rest stay empty, as do
+ * signals the frame doesn't have (multiplexed out or too short).
+ */
+bool writeSignals(const QString &name, const QVector<CANFrame> &frames, QString &error)
+{
+    MessageLookup lookup;
+    QVector<const DBC_MESSAGE *> messages;
+    QHash<const DBC_MESSAGE *, int> firstColumn;
+    int columns = 0;
+    for (const CANFrame &frame : frames)
+    {
+        const DBC_MESSAGE *msg = lookup.find(frame);
+        if (!msg || firstColumn.contains(msg)) continue;
+        firstColumn.insert(msg, columns);
+        messages.append(msg);
+        columns += qMin(msg->sigHandler->getCount(), BATCHJOB_MAX_SIGNALS);
+    }
+
+    CsvOut out;
+    if (!out.open(name))
+    {
+        error = QString("can't write %1").arg(name);
+        return false;
+    }
+
+    out.put("Time,Bus,ID,Message");
+    for (const DBC_MESSAGE *msg : messages)
+    {
+        const DBCSignalHandler *sigs = msg->sigHandler; //the const lookups, safe with the other jobs around
+        int count = qMin(sigs->getCount(), BATCHJOB_MAX_SIGNALS);
+        for (int i = 0; i < count; i++)
+        {
+            out.put(',');
+            out.put(msg->name.toUtf8());
+            out.put('.');
+            out.put(sigs->findSignalByIdx(i)->name.toUtf8());
+        }
+    }
+    out.lineDone();
+
+    double values[BATCHJOB_MAX_SIGNALS];
+    uint64_t valid[(BATCHJOB_MAX_SIGNALS + 63) / 64];
+    QHash<const DBC_MESSAGE *, QByteArray> names;
+    for (const CANFrame &frame : frames)
+    {
+        const DBC_MESSAGE *msg = lookup.find(frame);
+        if (!msg) continue;
+        int decoded = msg->decodeSignals(frame, values, valid, BATCHJOB_MAX_SIGNALS);
+
+        out.putSeconds(frame.timeStamp().microSeconds());
+        out.put(',');
+        out.putDec(static_cast<uint64_t>(frame.bus));
+        out.put(',');
+        out.putID(frame.frameId(), frame.hasExtendedFrameFormat());
+        out.put(',');
+        auto msgName = names.find(msg);
+        if (msgName == names.end()) msgName = names.insert(msg, msg->name.toUtf8());
+        out.put(msgName.value());
+
+        int first = firstColumn.value(msg);
+        for (int c = 0; c < first; c++) out.put(',');
+        for (int i = 0; i < decoded; i++)
+        {
+            out.put(',');
+            if (DBC_MESSAGE::isDecodedValid(valid, i)) out.putDouble(values[i]);
+        }
+        for (int c = first + decoded; c < columns; c++) out.put(',');
+        out.lineDone();
+    }
+
+    if (!out.close())
+    {
+        error = QString("couldn't finish writing %1").arg(name);
+        return false;
+    }
+    return true;
+}
+
+struct IdStats
+{
+    quint64 count = 0;
+    qint64 first = 0;
+    qint64 last = 0;
+    qint64 minGap = -1; //-1 until there are two frames
+    qint64 maxGap = 0;
+    int minLength = INT_MAX;
+    int maxLength = 0;
+};
+
+//a line per bus and ID, in that order. Gaps only count where the stamps went forward
+bool writeStats(const QString &name, const QVector<CANFrame> &frames, QString &error)
+{
+    QHash<quint64, IdStats> stats;
+    for (const CANFrame &frame : frames)
+    {
+        quint64 key = (static_cast<quint64>(static_cast<quint32>(frame.bus)) << 32)
+                | frameLoadKey(frame.frameId(), frame.hasExtendedFrameFormat());
+        IdStats &s = stats[key];
+        qint64 stamp = static_cast<qint64>(frame.timeStamp().microSeconds());
+        int length = frame.payload().length();
+        if (s.count == 0) s.first = stamp;
+        else if (stamp >= s.last)
+        {
+            qint64 gap = stamp - s.last;
+            if (s.minGap < 0 || gap < s.minGap) s.minGap = gap;
+            if (gap > s.maxGap) s.maxGap = gap;
+        }
+        s.last = stamp;
+        s.count++;
+        s.minLength = qMin(s.minLength, length);
+        s.maxLength = qMax(s.maxLength, length);
+    }
+
+    QVector<quint64> keys;
+    keys.reserve(stats.count());
+    for (auto it = stats.constBegin(); it != stats.constEnd(); ++it) keys.append(it.key());
+    std::sort(keys.begin(), keys.end());
+
+    CsvOut out;
+    if (!out.open(name))
+    {
+        error = QString("can't write %1").arg(name);
+        return false;
+    }
+    out.put("Bus,ID,Extended,Count,First,Last,MeanPeriodUs,MinPeriodUs,MaxPeriodUs,MinLength,MaxLength");
+    out.lineDone();
+    for (quint64 key : qAsConst(keys))
+    {
+        const IdStats &s = stats[key];
+        const quint32 idKey = static_cast<quint32>(key);
+        const bool extended = (idKey & 0x80000000u) != 0;
+        out.putDec(key >> 32);
+        out.put(',');
+        out.putID(idKey & FRAME_LOAD_ID_BITS, extended);
+        out.put(extended ? ",true," : ",false,");
+        out.putDec(s.count);
+        out.put(',');
+        out.putSeconds(s.first);
+        out.put(',');
+        out.putSeconds(s.last);
+        out.put(',');
+        if (s.count > 1) out.putDec(static_cast<uint64_t>(qMax<qint64>(0, s.last - s.first)) / (s.count - 1));
+        out.put(',');
+        if (s.minGap >= 0) out.putDec(static_cast<uint64_t>(s.minGap));
+        out.put(',');
+        if (s.minGap >= 0) out.putDec(static_cast<uint64_t>(s.maxGap));
+        out.put(',');
+        out.putDec(static_cast<uint64_t>(s.minLength));
+        out.put(',');
+        out.putDec(static_cast<uint64_t>(s.maxLength));
+        out.lineDone();
+    }
+
+    if (!out.close())
+    {
+        error = QString("couldn't finish writing %1").arg(name);
+        return false;
+    }
+    return true;
+}
+
+//where a file's outputs go, minus their endings. log.csv.gz comes out as <dir>/log
+QString outputBase(const QString &input, const QString &outputDir)
+{
+    QFileInfo info(input);
+    QString name = info.fileName();
+    LogCompression compression = CompressedLog::fromFileName(name);
+    if (compression != LogCompression::NONE) name.chop(CompressedLog::suffix(compression).length());
+    int dot = name.lastIndexOf('.');
+    if (dot > 0) name.truncate(dot);
+    QDir dir(outputDir.isEmpty() ? info.absolutePath() : outputDir);
+    return dir.filePath(name);
+}
+
+}
+
+void prepareBatchSignals()
+{
+    DBCHandler *dbc = DBCHandler::getReference();
+    for (int f = 0; f < dbc->getFileCount(); f++)
+    {
+        DBCMessageHandler *msgs = dbc->getFileByIdx(f)->messageHandler;
+        for (int m = 0; m < msgs->getCount(); m++)
+        {
+            DBCSignalHandler *sigs = msgs->findMsgByIdx(m)->sigHandler;
+            for (int s = 0; s < sigs->getCount(); s++) sigs->findSignalByIdx(s)->prepare();
+        }
+    }
+}
+
+BatchResult runBatchJob(const QString &input, const BatchSettings &settings)
+{
+    BatchResult result;
+    result.input = input;
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<CANFrame> frames;
+    const FrameLoadOptions *options = settings.load.isEverything() ? nullptr : &settings.load;
+    if (!FrameFileIO::loadWithFilter(input, settings.loadFilter, &frames, options))
+    {
+        result.error = "couldn't be loaded";
+        result.elapsedMs = timer.elapsed();
+        return result;
+    }
+    result.frames = frames.count();
+
+    const QString base = outputBase(input, settings.outputDir);
+    result.ok = true;
+
+    if (settings.saveFilter >= 0)
+    {
+        QString name = base + settings.saveSuffix;
+        if (QFileInfo(name).absoluteFilePath() == QFileInfo(input).absoluteFilePath())
+        {
+            result.error = "converting would overwrite it, give an output directory";
+            result.ok = false;
+        }
+        else if (!FrameFileIO::saveWithFilter(name, settings.saveFilter, &frames))
+        {
+            result.error = QString("couldn't be saved as %1").arg(name);
+            result.ok = false;
+        }
+        else result.outputs.append(name);
+    }
+
+    if (result.ok && settings.decode)
+    {
+        const QString name = base + ".signals.csv";
+        result.ok = writeSignals(name, frames, result.error);
+        if (result.ok) result.outputs.append(name);
+    }
+
+    if (result.ok && settings.stats)
+    {
+        const QString name = base + ".stats.csv";
+        result.ok = writeStats(name, frames, result.error);
+        if (result.ok) result.outputs.append(name);
+    }
+
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
@@ -0,0 +1,45 @@
+#ifndef BATCHJOB_H
+#define BATCHJOB_H
+
+#include <QString>
+#include <QStringList>
+#include "frameloadoptions.h"
+
+//the decode and stats outputs are written out whenever this much is waiting
+#define BATCHJOB_FLUSH_BYTES    1048576
+//how many signals one message may have decoded. Past that they're left out of the columns
+#define BATCHJOB_MAX_SIGNALS    512
+
+//what to do with every file, filled in from the command line
+struct BatchSettings
+{
+    QString outputDir;          //empty to write next to each input
+    int loadFilter = 0;         //index into FrameFileIO::loadFilters(), 0 autodetects
+    int saveFilter = -1;        //index into FrameFileIO::saveFilters(), -1 for no conversion
+    QString saveSuffix;         //extension the converted file gets, with the dot
+    FrameLoadOptions load;      //which frames are kept, see FrameLoadOptions
+    bool decode = false;        //signals to <name>.signals.csv, needs DBC files loaded
+    bool stats = false;         //per ID counts and timing to <name>.stats.csv
+};
+
+struct BatchResult
+{
+    QString input;
+    bool ok = false;
+    QString error;
+    int frames = 0;             //kept by the load
+    qint64 elapsedMs = 0;
+    QStringList outputs;
+};
+
+/*
+ * One file from start to finish: load it (partially, as settings.load says), then write whichever of the converted
+ * log, the decoded signals and the stats were asked for. Any thread, and several at once, as long as nothing changes
+ * the loaded DBC files while they run. Message lookups go through one lock, the decoding itself doesn't need it.
+ */
+BatchResult runBatchJob(const QString &input, const BatchSettings &settings);
+
+//compile every signal of the loaded DBC files up front so the decode threads only ever read them
+void prepareBatchSignals();
+
+#endif // BATCHJOB_H
@@ -0,0 +1,41 @@
+# savvycan-cli, the batch side of SavvyCAN for build servers and scripts. Converts logs between formats, loads them
+# partially, decodes signals and works out per ID stats without any windows. Builds against all of SavvyCAN's own
+# sources (everything SavvyCAN.pro lists except main.cpp) so the loaders and savers are exactly the app's.
+include(../SavvyCAN.pro)
+
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = savvycan-cli
+
+# SavvyCAN.pro's file lists are relative to the top of the tree
+APP_SOURCES = $$SOURCES
+APP_HEADERS = $$HEADERS
+APP_FORMS = $$FORMS
+APP_RESOURCES = $$RESOURCES
+SOURCES =
+HEADERS =
+FORMS =
+RESOURCES =
+for(file, APP_SOURCES): !equals(file, main.cpp): SOURCES += $$PWD/../$$file
+for(file, APP_HEADERS): HEADERS += $$PWD/../$$file
+for(file, APP_FORMS): FORMS += $$PWD/../$$file
+for(file, APP_RESOURCES): RESOURCES += $$PWD/../$$file
+
+INCLUDEPATH += $$PWD/.. $$PWD/../connections
+
+INSTALLS =
+QMAKE_INFO_PLIST =
+ICON =
+DISTFILES =
+
+unix:!macx {
+    target.path = $$PREFIX/bin
+    INSTALLS += target
+}
+
+SOURCES += \
+    main.cpp \
+    batchjob.cpp
+
+HEADERS += \
+    batchjob.h
@@ -0,0 +1,206 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <cstdio>
+
+#include "batchjob.h"
+#include "framefileio.h"
+#include "filterexpression.h"
+#include "lograngedialog.h"
+#include "dbc/dbchandler.h"
+
+namespace {
+
+QMutex printLock;
+
+void say(const QString &text)
+{
+    QMutexLocker lock(&printLock);
+    fprintf(stderr, "%s\n", qPrintable(text));
+    fflush(stderr);
+}
+
+class BatchTask : public QRunnable
+{
+public:
+    BatchTask(const QString &input, const BatchSettings &settings, BatchResult *result)
+        : input(input), settings(settings), result(result) {}
+
+    void run() override
+    {
+        *result = runBatchJob(input, settings);
+        if (result->ok)
+        {
+            say(QString("%1: %2 frames in %3 ms -> %4").arg(input).arg(result->frames).arg(result->elapsedMs)
+                .arg(result->outputs.isEmpty() ? QString("nothing written") : result->outputs.join(", ")));
+        }
+        else say(QString("%1: %2").arg(input, result->error));
+    }
+
+private:
+    QString input;
+    const BatchSettings &settings;
+    BatchResult *result;
+};
+
+//a format by its position in the list or by name. A name only has to start the entry, case doesn't matter, but it
+//has to pick out just the one
+int findFormat(const QStringList &formats, const QString &wanted)
+{
+    bool isNumber;
+    int idx = wanted.toInt(&isNumber);
+    if (isNumber) return (idx >= 0 && idx < formats.count()) ? idx : -1;
+
+    int found = -1;
+    for (int i = 0; i < formats.count(); i++)
+    {
+        QString name = formats.at(i).section(" (", 0, 0);
+        if (name.compare(wanted, Qt::CaseInsensitive) == 0) return i;
+        if (name.startsWith(wanted, Qt::CaseInsensitive))
+        {
+            if (found >= 0) return -1;
+            found = i;
+        }
+    }
+    return found;
+}
+
+void listFormats(const char *title, const QStringList &formats)
+{
+    printf("%s\n", title);
+    for (int i = 0; i < formats.count(); i++) printf("  %2d  %s\n", i, qPrintable(formats.at(i)));
+}
+
+}
+
+/*
+ * savvycan-cli loads each log given with FrameFileIO, optionally only part of it, and writes any of a converted copy,
+ * the decoded signals and per ID stats next to it or in --output-dir. Files are worked on in parallel, --jobs at a
+ * time. One line per file goes to stderr. The exit code is 0 if every file went through, 1 if any failed and 2 if the
+ * command line was no good. Nothing here opens a window, so it runs fine without a display.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    //own settings so it never picks up the DBC files or anything else the GUI had open
+    app.setOrganizationName("EVTV");
+    app.setApplicationName("SavvyCAN-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts, filters, decodes and summarizes CAN logs in bulk.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Logs to work on.", "files...");
+
+    QCommandLineOption outputOpt(QStringList() << "o" << "output-dir", "Write the outputs to <dir> instead of next to each log.", "dir");
+    QCommandLineOption fromOpt(QStringList() << "f" << "from", "Load as <format> (a number or name from --list-formats). Autodetected by default.", "format");
+    QCommandLineOption toOpt(QStringList() << "t" << "to", "Save a converted copy as <format>.", "format");
+    QCommandLineOption listOpt("list-formats", "List the formats that can be loaded and saved.");
+    QCommandLineOption idsOpt("ids", "Only keep these hex IDs, or ID/MASK pairs, separated by commas.", "ids");
+    QCommandLineOption busOpt("bus", "Only keep these buses, separated by commas.", "buses");
+    QCommandLineOption startOpt("start", "Only keep frames from <seconds> in, as the log has them.", "seconds");
+    QCommandLineOption endOpt("end", "Only keep frames up to <seconds>.", "seconds");
+    QCommandLineOption exprOpt("filter", "Only keep frames matching this filter expression.", "expression");
+    QCommandLineOption decimateOpt("decimate", "Keep one in every <n> frames of each ID.", "n");
+    QCommandLineOption dbcOpt("dbc", "Load a DBC file for --decode and --filter. Can be given more than once.", "file");
+    QCommandLineOption decodeOpt("decode", "Write every signal of the loaded DBC files to <name>.signals.csv, a column each.");
+    QCommandLineOption statsOpt("stats", "Write counts, timing and lengths per bus and ID to <name>.stats.csv.");
+    QCommandLineOption jobsOpt(QStringList() << "j" << "jobs", "Work on <n> files at once. Defaults to one per core.", "n");
+    parser.addOptions({outputOpt, fromOpt, toOpt, listOpt, idsOpt, busOpt, startOpt, endOpt, exprOpt, decimateOpt,
+                       dbcOpt, decodeOpt, statsOpt, jobsOpt});
+    parser.process(app);
+
+    const QStringList loadFormats = FrameFileIO::loadFilters();
+    const QStringList saveFormats = FrameFileIO::saveFilters();
+    if (parser.isSet(listOpt))
+    {
+        listFormats("Load (--from):", loadFormats);
+        listFormats("Save (--to):", saveFormats);
+        return 0;
+    }
+
+    const QStringList inputs = parser.positionalArguments();
+    auto usage = [](const QString &problem)
+    {
+        say(problem);
+        return 2;
+    };
+    if (inputs.isEmpty()) return usage("No files given, see --help");
+
+    BatchSettings settings;
+    if (parser.isSet(fromOpt))
+    {
+        settings.loadFilter = findFormat(loadFormats, parser.value(fromOpt));
+        if (settings.loadFilter < 0) return usage(QString("Unknown or ambiguous load format %1").arg(parser.value(fromOpt)));
+    }
+    if (parser.isSet(toOpt))
+    {
+        settings.saveFilter = findFormat(saveFormats, parser.value(toOpt));
+        if (settings.saveFilter < 0) return usage(QString("Unknown or ambiguous save format %1").arg(parser.value(toOpt)));
+        //the first pattern of the format, *.csv for "GVRET Logs (*.csv *.CSV)"
+        QRegularExpressionMatch ext = QRegularExpression("\\*(\\.\\w+)").match(saveFormats.at(settings.saveFilter));
+        settings.saveSuffix = ext.hasMatch() ? ext.captured(1) : QString(".log");
+    }
+    settings.decode = parser.isSet(decodeOpt);
+    settings.stats = parser.isSet(statsOpt);
+    if (settings.saveFilter < 0 && !settings.decode && !settings.stats) return usage("Nothing to do. Give --to, --decode or --stats");
+
+    if (parser.isSet(outputOpt))
+    {
+        settings.outputDir = parser.value(outputOpt);
+        if (!QDir().mkpath(settings.outputDir)) return usage(QString("Can't make %1").arg(settings.outputDir));
+    }
+
+    //the DBC files go first, the filter expression resolves its signals against them
+    DBCHandler *dbc = DBCHandler::getReference();
+    for (const QString &file : parser.values(dbcOpt))
+    {
+        int before = dbc->getFileCount();
+        QString faults;
+        dbc->loadDBCFile(file, &faults);
+        if (dbc->getFileCount() == before) return usage(QString("Couldn't load %1").arg(file));
+        if (!faults.isEmpty()) say(QString("%1: %2").arg(file, faults));
+    }
+    if (settings.decode && dbc->getFileCount() == 0) return usage("--decode needs at least one --dbc");
+    prepareBatchSignals();
+
+    if (parser.isSet(idsOpt) && !LogRangeDialog::parseIDs(parser.value(idsOpt), settings.load.ids))
+        return usage(QString("Bad ID list %1").arg(parser.value(idsOpt)));
+    if (parser.isSet(busOpt) && !LogRangeDialog::parseBuses(parser.value(busOpt), settings.load.buses))
+        return usage(QString("Bad bus list %1").arg(parser.value(busOpt)));
+    bool ok = true;
+    if (parser.isSet(startOpt)) settings.load.from = static_cast<qint64>(parser.value(startOpt).toDouble(&ok) * 1000000.0);
+    if (!ok) return usage("--start takes seconds");
+    if (parser.isSet(endOpt)) settings.load.to = static_cast<qint64>(parser.value(endOpt).toDouble(&ok) * 1000000.0);
+    if (!ok) return usage("--end takes seconds");
+    if (parser.isSet(decimateOpt)) settings.load.decimate = parser.value(decimateOpt).toInt(&ok);
+    if (!ok || settings.load.decimate < 1) return usage("--decimate takes a whole number of at least 1");
+    if (parser.isSet(exprOpt))
+    {
+        QString error;
+        settings.load.expression = FilterExpression::compile(parser.value(exprOpt), &error);
+        if (!error.isEmpty()) return usage(QString("Bad filter expression: %1").arg(error));
+    }
+
+    int jobs = QThread::idealThreadCount();
+    if (parser.isSet(jobsOpt)) jobs = parser.value(jobsOpt).toInt(&ok);
+    if (!ok || jobs < 1) return usage("--jobs takes a whole number of at least 1");
+
+    //the text loaders spread each file over the cores as well, so this mostly helps with many small files
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+    QVector<BatchResult> results(inputs.count());
+    for (int i = 0; i < inputs.count(); i++) pool.start(new BatchTask(inputs.at(i), settings, &results[i]));
+    pool.waitForDone();
+
+    int failed = 0;
+    for (const BatchResult &result : qAsConst(results))
+        if (!result.ok) failed++;
+    if (failed) say(QString("%1 of %2 files failed").arg(failed).arg(inputs.count()));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,474 @@
+#include "compressedlog.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <cstring>
+#include "utility.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#define CODEC_OUT_SIZE 262144 //output produced per codec call
+#define WRITER_MAX_BLOCKS 4 //blocks waiting for the writer thread before writes have to wait for it
+
+//one direction of one format. process() appends whatever came out of the data to out
+class LogCodec
+{
+public:
+    enum Mode
+    {
+        RUN,
+        FLUSH, //everything so far has to be decodable
+        FINISH
+    };
+
+    virtual ~LogCodec() {}
+    virtual bool process(const char *data, int len, Mode mode, QByteArray &out) = 0;
+
+protected:
+    QByteArray buffer = QByteArray(CODEC_OUT_SIZE, 0);
+    char *buf() { return buffer.data(); }
+};
+
+namespace
+{
+bool onGuiThread()
+{
+    return QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
+#ifdef HAVE_ZLIB
+//gzip when writing, gzip or zlib when reading. Files made of several gzip members are read through
+class GzipCodec : public LogCodec
+{
+public:
+    explicit GzipCodec(bool encode) : encode(encode)
+    {
+        memset(&stream, 0, sizeof(stream));
+        if (encode) ok = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        else ok = inflateInit2(&stream, 15 + 32) == Z_OK;
+    }
+    ~GzipCodec() override
+    {
+        if (encode) deflateEnd(&stream);
+        else inflateEnd(&stream);
+    }
+
+    bool process(const char *data, int len, Mode mode, QByteArray &out) override
+    {
+        if (!ok) return false;
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        stream.avail_in = static_cast<uInt>(len);
+        if (encode)
+        {
+            int flush = mode == FINISH ? Z_FINISH : (mode == FLUSH ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            do
+            {
+                stream.next_out = reinterpret_cast<Bytef *>(buf());
+                stream.avail_out = CODEC_OUT_SIZE;
+                if (deflate(&stream, flush) == Z_STREAM_ERROR) return false;
+                out.append(buf(), CODEC_OUT_SIZE - static_cast<int>(stream.avail_out));
+            } while (stream.avail_out == 0);
+            return true;
+        }
+
+        do
+        {
+            stream.next_out = reinterpret_cast<Bytef *>(buf());
+            stream.avail_out = CODEC_OUT_SIZE;
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) return false;
+            out.append(buf(), CODEC_OUT_SIZE - static_cast<int>(stream.avail_out));
+            if (result == Z_STREAM_END)
+            {
+                if (stream.avail_in == 0) break;
+                inflateReset(&stream); //next member
+            }
+        } while (stream.avail_in > 0 || stream.avail_out == 0);
+        return true;
+    }
+
+private:
+    z_stream stream;
+    bool encode;
+    bool ok = false;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ZstdCodec : public LogCodec
+{
+public:
+    explicit ZstdCodec(bool encode)
+    {
+        if (encode)
+        {
+            cctx = ZSTD_createCCtx();
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 3);
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+        }
+        else dctx = ZSTD_createDCtx();
+    }
+    ~ZstdCodec() override
+    {
+        if (cctx) ZSTD_freeCCtx(cctx);
+        if (dctx) ZSTD_freeDCtx(dctx);
+    }
+
+    bool process(const char *data, int len, Mode mode, QByteArray &out) override
+    {
+        ZSTD_inBuffer in = {data, static_cast<size_t>(len), 0};
+        if (cctx)
+        {
+            ZSTD_EndDirective directive = mode == FINISH ? ZSTD_e_end : (mode == FLUSH ? ZSTD_e_flush : ZSTD_e_continue);
+            for (;;)
+            {
+                ZSTD_outBuffer output = {buf(), CODEC_OUT_SIZE, 0};
+                size_t left = ZSTD_compressStream2(cctx, &output, &in, directive);
+                if (ZSTD_isError(left)) return false;
+                out.append(buf(), static_cast<int>(output.pos));
+                if (directive == ZSTD_e_continue ? in.pos == in.size : left == 0) return true;
+            }
+        }
+        if (!dctx) return false;
+        for (;;)
+        {
+            ZSTD_outBuffer output = {buf(), CODEC_OUT_SIZE, 0};
+            size_t result = ZSTD_decompressStream(dctx, &output, &in);
+            if (ZSTD_isError(result)) return false;
+            out.append(buf(), static_cast<int>(output.pos));
+            if (in.pos == in.size && output.pos < output.size) return true;
+        }
+    }
+
+private:
+    ZSTD_CCtx *cctx = nullptr;
+    ZSTD_DCtx *dctx = nullptr;
+};
+#endif
+
+#ifdef HAVE_LZ4
+//LZ4 frame format, the one the lz4 command line tool makes
+class Lz4Codec : public LogCodec
+{
+public:
+    explicit Lz4Codec(bool encode) : encode(encode)
+    {
+        memset(&prefs, 0, sizeof(prefs));
+        prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+        if (encode) ok = !LZ4F_isError(LZ4F_createCompressionContext(&cctx, LZ4F_VERSION));
+        else ok = !LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION));
+    }
+    ~Lz4Codec() override
+    {
+        if (cctx) LZ4F_freeCompressionContext(cctx);
+        if (dctx) LZ4F_freeDecompressionContext(dctx);
+    }
+
+    bool process(const char *data, int len, Mode mode, QByteArray &out) override
+    {
+        if (!ok) return false;
+        if (encode)
+        {
+            QByteArray frame(static_cast<int>(LZ4F_compressBound(static_cast<size_t>(len), &prefs) + LZ4F_HEADER_SIZE_MAX), 0);
+            size_t result;
+            if (!begun)
+            {
+                result = LZ4F_compressBegin(cctx, frame.data(), static_cast<size_t>(frame.size()), &prefs);
+                if (LZ4F_isError(result)) return false;
+                out.append(frame.constData(), static_cast<int>(result));
+                begun = true;
+            }
+            if (len > 0)
+            {
+                result = LZ4F_compressUpdate(cctx, frame.data(), static_cast<size_t>(frame.size()), data, static_cast<size_t>(len), nullptr);
+                if (LZ4F_isError(result)) return false;
+                out.append(frame.constData(), static_cast<int>(result));
+            }
+            if (mode == FLUSH) result = LZ4F_flush(cctx, frame.data(), static_cast<size_t>(frame.size()), nullptr);
+            else if (mode == FINISH) result = LZ4F_compressEnd(cctx, frame.data(), static_cast<size_t>(frame.size()), nullptr);
+            else return true;
+            if (LZ4F_isError(result)) return false;
+            out.append(frame.constData(), static_cast<int>(result));
+            return true;
+        }
+
+        const char *src = data;
+        size_t left = static_cast<size_t>(len);
+        for (;;)
+        {
+            size_t dstSize = CODEC_OUT_SIZE;
+            size_t srcSize = left;
+            size_t result = LZ4F_decompress(dctx, buf(), &dstSize, src, &srcSize, nullptr);
+            if (LZ4F_isError(result)) return false;
+            out.append(buf(), static_cast<int>(dstSize));
+            src += srcSize;
+            left -= srcSize;
+            if (left == 0 && dstSize < CODEC_OUT_SIZE) return true;
+        }
+    }
+
+private:
+    bool encode;
+    bool ok = false;
+    bool begun = false;
+    LZ4F_preferences_t prefs;
+    LZ4F_cctx *cctx = nullptr;
+    LZ4F_dctx *dctx = nullptr;
+};
+#endif
+
+//null when the format isn't built in
+std::unique_ptr<LogCodec> makeCodec(LogCompression type, bool encode)
+{
+    switch (type)
+    {
+#ifdef HAVE_ZLIB
+    case LogCompression::GZIP:
+        return std::unique_ptr<LogCodec>(new GzipCodec(encode));
+#endif
+#ifdef HAVE_ZSTD
+    case LogCompression::ZSTD:
+        return std::unique_ptr<LogCodec>(new ZstdCodec(encode));
+#endif
+#ifdef HAVE_LZ4
+    case LogCompression::LZ4:
+        return std::unique_ptr<LogCodec>(new Lz4Codec(encode));
+#endif
+    default:
+        Q_UNUSED(encode)
+        return nullptr;
+    }
+}
+}
+
+LogCompression CompressedLog::fromFileName(const QString &filename)
+{
+    QString suffix = QFileInfo(filename).suffix().toLower();
+    if (suffix == "gz") return LogCompression::GZIP;
+    if (suffix == "zst" || suffix == "zstd") return LogCompression::ZSTD;
+    if (suffix == "lz4") return LogCompression::LZ4;
+    return LogCompression::NONE;
+}
+
+LogCompression CompressedLog::fromFile(const QString &filename)
+{
+    QFile inFile(filename);
+    if (!inFile.open(QIODevice::ReadOnly)) return LogCompression::NONE;
+    const QByteArray magic = inFile.read(4);
+    if (magic.startsWith("\x1F\x8B")) return LogCompression::GZIP;
+    if (magic == QByteArray("\x28\xB5\x2F\xFD", 4)) return LogCompression::ZSTD;
+    if (magic == QByteArray("\x04\x22\x4D\x18", 4)) return LogCompression::LZ4;
+    return LogCompression::NONE;
+}
+
+bool CompressedLog::isSupported(LogCompression type)
+{
+    switch (type)
+    {
+    case LogCompression::NONE:
+        return true;
+#ifdef HAVE_ZLIB
+    case LogCompression::GZIP:
+        return true;
+#endif
+#ifdef HAVE_ZSTD
+    case LogCompression::ZSTD:
+        return true;
+#endif
+#ifdef HAVE_LZ4
+    case LogCompression::LZ4:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+QString CompressedLog::suffix(LogCompression type)
+{
+    switch (type)
+    {
+    case LogCompression::GZIP:
+        return ".gz";
+    case LogCompression::ZSTD:
+        return ".zst";
+    case LogCompression::LZ4:
+        return ".lz4";
+    default:
+        return QString();
+    }
+}
+
+bool CompressedLog::decompress(const QString &filename, QTemporaryFile &tmp, QAtomicInt *progress)
+{
+    std::unique_ptr<LogCodec> codec = makeCodec(fromFile(filename), false);
+    if (!codec)
+    {
+        qDebug() << "No decompressor built in for" << filename;
+        return false;
+    }
+
+    QFile inFile(filename);
+    if (!inFile.open(QIODevice::ReadOnly)) return false;
+    QString inner = QFileInfo(QFileInfo(filename).completeBaseName()).suffix();
+    tmp.setFileTemplate(QDir::temp().filePath("SavvyCAN-XXXXXX." + (inner.isEmpty() ? QString("log") : inner)));
+    if (!tmp.open()) return false;
+
+    bool gui = onGuiThread();
+    qint64 total = qMax<qint64>(inFile.size(), 1);
+    QByteArray out;
+    while (!inFile.atEnd())
+    {
+        const QByteArray chunk = inFile.read(COMPRESSED_LOG_CHUNK);
+        if (chunk.isEmpty()) break;
+        out.clear();
+        if (!codec->process(chunk.constData(), chunk.size(), LogCodec::RUN, out) || tmp.write(out) != out.size())
+        {
+            qDebug() << "Couldn't decompress" << filename;
+            return false;
+        }
+        if (progress) progress->storeRelaxed(static_cast<int>(inFile.pos() * 1000 / total));
+        if (gui) QCoreApplication::processEvents();
+    }
+    tmp.close(); //the file stays until tmp goes away, the loaders open it again by name
+    return true;
+}
+
+bool CompressedLog::compress(const QString &source, const QString &target)
+{
+    QFile inFile(source);
+    if (!inFile.open(QIODevice::ReadOnly)) return false;
+    CompressedLogWriter writer(target, fromFileName(target));
+    if (!writer.open(QIODevice::WriteOnly)) return false;
+
+    bool gui = onGuiThread();
+    bool ok = true;
+    while (ok && !inFile.atEnd())
+    {
+        const QByteArray chunk = inFile.read(COMPRESSED_LOG_CHUNK);
+        if (chunk.isEmpty()) break;
+        ok = writer.write(chunk) == chunk.size();
+        if (gui) QCoreApplication::processEvents();
+    }
+    writer.close();
+    return ok && !writer.failed();
+}
+
+CompressedLogWriter::CompressedLogWriter(const QString &filename, LogCompression type) : file(filename), type(type)
+{
+}
+
+CompressedLogWriter::~CompressedLogWriter()
+{
+    close();
+}
+
+bool CompressedLogWriter::open(OpenMode mode)
+{
+    if (worker || (mode & QIODevice::ReadOnly) || !(mode & QIODevice::WriteOnly)) return false;
+    codec = makeCodec(type, true);
+    if (!codec || !file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    error.storeRelaxed(0);
+    fileBytes.storeRelaxed(0);
+    pending.reserve(COMPRESSED_LOG_CHUNK);
+    worker = QThread::create([this]{ run(); });
+    worker->start();
+    return QIODevice::open(mode);
+}
+
+void CompressedLogWriter::close()
+{
+    if (worker)
+    {
+        queue(FINISH);
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+        file.close();
+    }
+    QIODevice::close();
+}
+
+bool CompressedLogWriter::flushBlock()
+{
+    if (!worker) return false;
+    queue(FLUSH);
+    QMutexLocker locker(&lock);
+    while (finished < queued) done.wait(&lock);
+    return !failed();
+}
+
+bool CompressedLogWriter::syncToDisk()
+{
+    //the thread is idle once flushBlock returns so the file is ours for the moment
+    return flushBlock() && Utility::syncToDisk(file);
+}
+
+qint64 CompressedLogWriter::readData(char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+qint64 CompressedLogWriter::writeData(const char *data, qint64 len)
+{
+    if (!worker || failed()) return -1;
+    pending.append(data, static_cast<int>(len));
+    if (pending.size() >= COMPRESSED_LOG_CHUNK) queue(RUN);
+    return len;
+}
+
+void CompressedLogWriter::queue(Mode mode)
+{
+    Block block;
+    block.data = pending;
+    block.mode = mode;
+    pending.clear();
+    if (mode == RUN) pending.reserve(COMPRESSED_LOG_CHUNK);
+
+    QMutexLocker locker(&lock);
+    while (blocks.size() >= WRITER_MAX_BLOCKS && !failed()) done.wait(&lock);
+    blocks.push_back(block);
+    queued++;
+    wake.wakeOne();
+}
+
+void CompressedLogWriter::run()
+{
+    for (;;)
+    {
+        Block block;
+        {
+            QMutexLocker locker(&lock);
+            while (blocks.empty()) wake.wait(&lock);
+            block = blocks.front();
+            blocks.pop_front();
+        }
+
+        LogCodec::Mode codecMode = block.mode == FINISH ? LogCodec::FINISH : (block.mode == FLUSH ? LogCodec::FLUSH : LogCodec::RUN);
+        QByteArray out;
+        bool ok = !failed() && codec->process(block.data.constData(), block.data.size(), codecMode, out)
+                && file.write(out) == out.size();
+        if (ok && block.mode != RUN) ok = file.flush();
+        if (!ok) error.storeRelaxed(1);
+        fileBytes.fetchAndAddRelaxed(out.size());
+
+        {
+            QMutexLocker locker(&lock);
+            finished++;
+            done.wakeAll();
+        }
+        if (block.mode == FINISH) return;
+    }
+}
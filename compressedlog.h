@@ -0,0 +1,102 @@
+#ifndef COMPRESSEDLOG_H
+#define COMPRESSEDLOG_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QMutex>
+#include <QString>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QWaitCondition>
+#include <deque>
+#include <memory>
+
+#define COMPRESSED_LOG_CHUNK 1048576 //bytes handed to the codec at a time
+
+//which of these are there depends on the libraries found when building, see SavvyCAN.pro
+enum class LogCompression
+{
+    NONE,
+    GZIP,
+    ZSTD,
+    LZ4
+};
+
+class LogCodec;
+
+/*
+ * gzip, zstd and LZ4 frame compressed logs. Reading always goes through decompress(): the loaders seek, map and split
+ * files for their worker threads, so the compressed file is streamed a chunk at a time into a temporary file which
+ * is then loaded like any other. Writing goes through CompressedLogWriter.
+ */
+class CompressedLog
+{
+public:
+    static LogCompression fromFileName(const QString &filename); //by the last suffix, for files about to be written
+    static LogCompression fromFile(const QString &filename); //by magic number, for files that are already there
+    static bool isSupported(LogCompression type);
+    static QString suffix(LogCompression type); //with the dot
+    //fills tmp, which keeps the name of the file it came from minus the compression suffix so extension checks still work
+    static bool decompress(const QString &filename, QTemporaryFile &tmp, QAtomicInt *progress = nullptr);
+    //compresses source into target, the type comes from target's suffix
+    static bool compress(const QString &source, const QString &target);
+};
+
+/*
+ * Write only device that compresses on its own thread. Writes are gathered into COMPRESSED_LOG_CHUNK blocks which the
+ * thread compresses and writes to the file, so whoever is writing only ever copies into a buffer. flushBlock() pushes
+ * out what's been written so far as something a decompressor can read up to, close() finishes the stream.
+ */
+class CompressedLogWriter : public QIODevice
+{
+public:
+    CompressedLogWriter(const QString &filename, LogCompression type);
+    ~CompressedLogWriter() override;
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    bool flushBlock(); //waits for the thread to get it all to the file
+    bool syncToDisk(); //flushBlock() and then fsync
+    bool failed() const { return error.loadRelaxed() != 0; }
+    qint64 compressedSize() const { return fileBytes.loadRelaxed(); } //what the thread has written to the file so far
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    enum Mode
+    {
+        RUN,
+        FLUSH,
+        FINISH
+    };
+    struct Block
+    {
+        QByteArray data;
+        Mode mode;
+    };
+
+    Q_DISABLE_COPY(CompressedLogWriter)
+    void run();
+    void queue(Mode mode);
+
+    QFile file;
+    LogCompression type;
+    std::unique_ptr<LogCodec> codec;
+    QThread *worker = nullptr;
+    QMutex lock;
+    QWaitCondition wake;
+    QWaitCondition done;
+    std::deque<Block> blocks; //under lock
+    quint64 queued = 0; //under lock, blocks ever queued and finished
+    quint64 finished = 0;
+    QByteArray pending; //writer side only
+    QAtomicInt error;
+    QAtomicInteger<qint64> fileBytes;
+};
+
+#endif // COMPRESSEDLOG_H
@@ -0,0 +1,292 @@
+#include "busloadmeter.h"
+
+#include <algorithm>
+
+namespace
+{
+//CRC delimiter, ACK slot, ACK delimiter, end of frame and the interframe space. Never stuffed, always nominal rate
+const int TAIL_BITS = 1 + 1 + 1 + 7 + 3;
+
+/*
+ * Running bit stuffing. After five equal bits the sender puts in one of the other polarity, which starts the next
+ * run itself. The bus idles recessive so the dominant start of frame always begins a fresh run.
+ */
+struct Stuffer
+{
+    int last = 1;
+    int run = 0;
+    int stuffed = 0;
+
+    inline void push(int bit)
+    {
+        if (bit != last)
+        {
+            last = bit;
+            run = 1;
+            return;
+        }
+        if (++run < 5) return;
+        stuffed++;
+        last = !bit;
+        run = 1;
+    }
+};
+
+/*
+ * Stuffing a whole byte at a time for FD payloads. A Stuffer's state going into a byte is which bit came last and
+ * how long the run of it is (1 to 4), eight possibilities, and that fixes both the stuff bits in the byte and the
+ * state coming out.
+ */
+struct ByteStuffTable
+{
+    quint8 next[8][256];
+    quint8 stuffed[8][256];
+
+    ByteStuffTable()
+    {
+        for (int state = 0; state < 8; state++)
+        {
+            for (int byte = 0; byte < 256; byte++)
+            {
+                Stuffer s;
+                s.last = state >> 2;
+                s.run = (state & 3) + 1;
+                for (int bit = 7; bit >= 0; bit--) s.push((byte >> bit) & 1);
+                next[state][byte] = static_cast<quint8>((s.last << 2) | (s.run - 1));
+                stuffed[state][byte] = static_cast<quint8>(s.stuffed);
+            }
+        }
+    }
+
+    static const ByteStuffTable &get()
+    {
+        static const ByteStuffTable table;
+        return table;
+    }
+};
+
+//the bit fields before the payload, most significant bit first
+struct HeaderWriter
+{
+    Stuffer stuff;
+    quint16 crc = 0;
+    bool classic = true; //classic frames run their CRC over everything up to it
+    int bits = 0;
+
+    inline void push(int bit)
+    {
+        bits++;
+        stuff.push(bit);
+        if (!classic) return;
+        int crcNext = bit ^ ((crc >> 14) & 1);
+        crc = static_cast<quint16>((crc << 1) & 0x7FFF);
+        if (crcNext) crc ^= 0x4599;
+    }
+
+    void push(quint32 value, int count)
+    {
+        for (int bit = count - 1; bit >= 0; bit--) push((value >> bit) & 1);
+    }
+};
+
+//FD payloads only come in these sizes. Anything in between is sent padded up to the next one
+int fdPayloadSize(int len, int &dlc)
+{
+    static const int sizes[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    for (dlc = 0; dlc < 15; dlc++)
+    {
+        if (sizes[dlc] >= len) break;
+    }
+    return sizes[dlc];
+}
+}
+
+CANFrameBits CANFrameBits::of(const CANFrame &frame)
+{
+    const QByteArray &payload = frame.payload();
+    return of(frame.frameType(), frame.frameId(), frame.hasExtendedFrameFormat(), frame.hasFlexibleDataRateFormat(),
+              frame.hasBitrateSwitch(), frame.hasErrorStateIndicator(),
+              reinterpret_cast<const uint8_t *>(payload.constData()), payload.length());
+}
+
+CANFrameBits CANFrameBits::of(const CANFrameRecord &rec, const uint8_t *payload)
+{
+    return of(rec.type(), rec.frameId(), rec.isExtended(), (rec.flags & CANFrameRecord::FLAG_FD) != 0,
+              (rec.flags & CANFrameRecord::FLAG_BRS) != 0, (rec.flags & CANFrameRecord::FLAG_ESI) != 0, payload, rec.len);
+}
+
+CANFrameBits CANFrameBits::of(QCanBusFrame::FrameType type, quint32 id, bool extended, bool fd, bool brs, bool esi,
+                              const uint8_t *data, int length)
+{
+    CANFrameBits out;
+    if (type != QCanBusFrame::DataFrame && type != QCanBusFrame::RemoteRequestFrame) return out;
+
+    HeaderWriter header;
+
+    if (!fd)
+    {
+        const bool remote = (type == QCanBusFrame::RemoteRequestFrame);
+        const int len = remote ? 0 : qMin(length, 8);
+        header.push(0, 1); //start of frame
+        if (extended)
+        {
+            header.push(id >> 18, 11);
+            header.push(1, 1); //SRR
+            header.push(1, 1); //IDE
+            header.push(id & 0x3FFFF, 18);
+            header.push(remote ? 1 : 0, 1);
+            header.push(0, 2); //r1, r0
+        }
+        else
+        {
+            header.push(id & 0x7FF, 11);
+            header.push(remote ? 1 : 0, 1);
+            header.push(0, 2); //IDE, r0
+        }
+        header.push(static_cast<quint32>(len), 4);
+        for (int i = 0; i < len; i++) header.push(data[i], 8);
+        header.push(header.crc, 15); //the CRC gets stuffed as well
+
+        out.stuffBits = header.stuff.stuffed;
+        out.nominal = header.bits + header.stuff.stuffed + TAIL_BITS;
+        return out;
+    }
+
+    //CAN-FD. Stuffing runs on up to the CRC field, which has fixed stuff bits instead so it doesn't need the CRC
+    int dlc;
+    const int size = fdPayloadSize(length, dlc);
+    header.classic = false;
+    header.push(0, 1);
+    if (extended)
+    {
+        header.push(id >> 18, 11);
+        header.push(1, 1); //SRR
+        header.push(1, 1); //IDE
+        header.push(id & 0x3FFFF, 18);
+    }
+    else
+    {
+        header.push(id & 0x7FF, 11);
+        header.push(0, 1); //RRS
+        header.push(0, 1); //IDE
+    }
+    if (extended) header.push(0, 1); //RRS
+    header.push(1, 1); //FDF
+    header.push(0, 1); //res
+    header.push(brs ? 1 : 0, 1);
+    //the data rate starts after the bit rate switch bit
+    const int arbitration = header.bits + header.stuff.stuffed;
+    header.push(esi ? 1 : 0, 1);
+    header.push(static_cast<quint32>(dlc), 4);
+
+    const ByteStuffTable &table = ByteStuffTable::get();
+    int state = (header.stuff.last << 2) | (header.stuff.run - 1);
+    int stuffed = header.stuff.stuffed;
+    for (int i = 0; i < size; i++)
+    {
+        const quint8 byte = (i < length) ? data[i] : 0; //padding is sent as zeros
+        stuffed += table.stuffed[state][byte];
+        state = table.next[state][byte];
+    }
+
+    //stuff count (3 bits and parity) and the CRC with a fixed stuff bit ahead of them and after every 4 bits
+    const int crcField = (size <= 16) ? (4 + 17 + 6) : (4 + 21 + 7);
+    const int dataPhase = header.bits + stuffed + size * 8 + crcField - arbitration;
+
+    out.stuffBits = stuffed + crcField - ((size <= 16) ? 21 : 25);
+    if (brs)
+    {
+        out.nominal = arbitration + TAIL_BITS;
+        out.data = dataPhase;
+    }
+    else out.nominal = arbitration + dataPhase + TAIL_BITS;
+    return out;
+}
+
+BusLoadMeter::BusLoadMeter(int pNumBuses) :
+    mBuses(static_cast<size_t>(qMax(0, pNumBuses))),
+    mHistory(qMax(0, pNumBuses))
+{
+    for (int i = 0; i < pNumBuses; i++) setRates(i, 0, 0);
+    mSinceSample.start();
+}
+
+void BusLoadMeter::setRates(int pBus, int pNominal, int pData)
+{
+    if (pBus < 0 || pBus >= numBuses()) return;
+    Counters &bus = mBuses[static_cast<size_t>(pBus)];
+    bus.psPerNominalBit.storeRelaxed(pNominal > 0 ? static_cast<quint32>(1000000000000ll / pNominal) : 0);
+    //a bus without a separate data rate sends the data phase at the nominal one
+    if (pData <= 0) pData = pNominal;
+    bus.psPerDataBit.storeRelaxed(pData > 0 ? static_cast<quint32>(1000000000000ll / pData) : 0);
+}
+
+void BusLoadMeter::add(const CANFrame &pFrame)
+{
+    if (pFrame.bus < 0 || pFrame.bus >= numBuses()) return;
+    Counters &bus = mBuses[static_cast<size_t>(pFrame.bus)];
+    bus.frames.fetchAndAddRelaxed(1);
+    quint64 ps = busTimePs(pFrame);
+    if (ps > 0) bus.busyPs.fetchAndAddRelaxed(ps);
+}
+
+quint64 BusLoadMeter::busTimePs(const CANFrame &pFrame) const
+{
+    if (pFrame.bus < 0 || pFrame.bus >= numBuses()) return 0;
+    const Counters &bus = mBuses[static_cast<size_t>(pFrame.bus)];
+    quint32 nominal = bus.psPerNominalBit.loadRelaxed();
+    if (nominal == 0) return 0;
+    CANFrameBits bits = CANFrameBits::of(pFrame);
+    return static_cast<quint64>(bits.nominal) * nominal + static_cast<quint64>(bits.data) * bus.psPerDataBit.loadRelaxed();
+}
+
+void BusLoadMeter::sample()
+{
+    qint64 elapsedNs = mSinceSample.nsecsElapsed();
+    if (elapsedNs <= 0) return;
+    mSinceSample.restart();
+    const double elapsedPs = static_cast<double>(elapsedNs) * 1000.0;
+
+    for (int i = 0; i < numBuses(); i++)
+    {
+        const Counters &bus = mBuses[static_cast<size_t>(i)];
+        History &hist = mHistory[i];
+        quint64 busy = bus.busyPs.loadRelaxed();
+        quint64 frames = bus.frames.loadRelaxed();
+        double current = qMin(100.0, static_cast<double>(busy - hist.lastBusyPs) * 100.0 / elapsedPs);
+        hist.load.framesPerSec = static_cast<double>(frames - hist.lastFrames) * 1e9 / static_cast<double>(elapsedNs);
+        hist.lastBusyPs = busy;
+        hist.lastFrames = frames;
+
+        if (hist.samples.count() < BUSLOAD_WINDOW_SAMPLES) hist.samples.append(current);
+        else hist.samples[hist.next] = current;
+        hist.next = (hist.next + 1) % BUSLOAD_WINDOW_SAMPLES;
+
+        double sum = 0.0;
+        for (double s : qAsConst(hist.samples)) sum += s;
+        hist.load.known = bus.psPerNominalBit.loadRelaxed() != 0;
+        hist.load.current = current;
+        hist.load.average = sum / hist.samples.count();
+        hist.load.peak = qMax(hist.load.peak, current);
+    }
+}
+
+void BusLoadMeter::reset()
+{
+    for (int i = 0; i < numBuses(); i++)
+    {
+        History &hist = mHistory[i];
+        hist.lastBusyPs = mBuses[static_cast<size_t>(i)].busyPs.loadRelaxed();
+        hist.lastFrames = mBuses[static_cast<size_t>(i)].frames.loadRelaxed();
+        hist.samples.clear();
+        hist.next = 0;
+        hist.load = CANBusLoad();
+    }
+    mSinceSample.restart();
+}
+
+CANBusLoad BusLoadMeter::load(int pBus) const
+{
+    if (pBus < 0 || pBus >= mHistory.count()) return CANBusLoad();
+    return mHistory.at(pBus).load;
+}
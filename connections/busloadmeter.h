@@ -0,0 +1,94 @@
+#ifndef BUSLOADMETER_H
+#define BUSLOADMETER_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QVector>
+#include <vector>
+#include "can_structs.h"
+
+//how often the GUI thread turns the running counters into load figures
+#define BUSLOAD_SAMPLE_MS       250
+//samples the moving average is over, 10 seconds
+#define BUSLOAD_WINDOW_SAMPLES  40
+
+//how long a frame keeps the bus busy, split into the part sent at the nominal rate and the CAN-FD data phase
+struct CANFrameBits
+{
+    int nominal = 0;    //arbitration, and for classic frames everything. Stuff bits, ACK, EOF and interframe space included
+    int data = 0;       //bits sent at the data rate. Only FD frames with the bit rate switch have any
+    int stuffBits = 0;  //of the above, how many were stuff bits
+
+    //the exact bit stream for the frame's ID and payload, stuff bits and all. Error frames take no time here
+    static CANFrameBits of(const CANFrame &frame);
+    //same for a stored frame, payload is rec.len bytes (CANFrameStore::payloadData)
+    static CANFrameBits of(const CANFrameRecord &rec, const uint8_t *payload);
+
+private:
+    static CANFrameBits of(QCanBusFrame::FrameType type, quint32 id, bool extended, bool fd, bool brs, bool esi,
+                           const uint8_t *data, int length);
+};
+
+//what one bus has been doing, as percentages of the time it's had
+struct CANBusLoad
+{
+    bool known = false;     //false until the bus has a bit rate to work from
+    double current = 0.0;   //over the last sample
+    double average = 0.0;   //over the last BUSLOAD_WINDOW_SAMPLES samples
+    double peak = 0.0;      //busiest sample since the meter was reset
+    double framesPerSec = 0.0; //over the last sample
+};
+
+/*
+ * Bus utilization for the buses of one connection. The connection's reading thread adds every frame it passes on
+ * (and the TX copies it queues itself) as it goes, which costs working out the frame's bit stream and two atomic
+ * adds, so it's on all the time. The bus time is in picoseconds from the bit rates the bus was set up with, FD
+ * data phases at the data rate.
+ *
+ * The GUI thread calls sample() every BUSLOAD_SAMPLE_MS or so, which turns the running totals into what share of
+ * the time since the last sample the bus was busy, and keeps the moving average and the peak from those. Frames
+ * come in batches from some devices so a single sample can read high or low, the average doesn't.
+ */
+class BusLoadMeter
+{
+public:
+    explicit BusLoadMeter(int pNumBuses = 0);
+
+    //any thread. rates in bits per second, 0 when not known
+    void setRates(int pBus, int pNominal, int pData);
+    //reading thread (or whichever thread queues the frame). frame.bus is the connection's own bus number
+    void add(const CANFrame &pFrame);
+    //any thread. How long the frame would keep its bus busy in ps, 0 if the bus has no bit rate to go by
+    quint64 busTimePs(const CANFrame &pFrame) const;
+
+    //GUI thread
+    void sample();
+    void reset();
+    CANBusLoad load(int pBus) const;
+    int numBuses() const { return static_cast<int>(mBuses.size()); }
+
+private:
+    struct Counters
+    {
+        QAtomicInteger<quint64> busyPs;
+        QAtomicInteger<quint64> frames;
+        QAtomicInteger<quint32> psPerNominalBit;
+        QAtomicInteger<quint32> psPerDataBit;
+    };
+
+    //GUI thread only
+    struct History
+    {
+        quint64 lastBusyPs = 0;
+        quint64 lastFrames = 0;
+        QVector<double> samples; //ring of the last BUSLOAD_WINDOW_SAMPLES
+        int next = 0;
+        CANBusLoad load;
+    };
+
+    std::vector<Counters> mBuses; //sized once, the reading thread uses it without a lock
+    QVector<History> mHistory;
+    QElapsedTimer mSinceSample;
+};
+
+#endif // BUSLOADMETER_H
@@ -9,7 +9,8 @@ namespace CANCon {
     enum status
     {
         NOT_CONNECTED,  /*!< device is not connected */
-        CONNECTED       /*!< device is connected */
+        CONNECTED,      /*!< device is connected */
+        CONNECTING      /*!< device is open and being validated, not answered yet */
     };
 
     enum type
@@ -23,6 +24,11 @@ namespace CANCon {
         LAWICEL,
         CANSERVER,
         CANLOGSERVER,
+        SOCKETCAN,
+        GENERATOR,
+        LOGREPLAY,
+        CAPTURE_LINK,
+        SHARED_CAPTURE,
         NONE
     };
 }
@@ -7,6 +7,13 @@
 #include "lawicel_serial.h"
 #include "canserver.h"
 #include "canlogserver.h"
+#include "trafficgenerator.h"
+#include "logreplay.h"
+#include "capturelinkclient.h"
+#include "sharedcaptureclient.h"
+#ifdef Q_OS_LINUX
+#include "socketcan.h"
+#endif
 
 using namespace CANCon;
 
@@ -32,6 +39,18 @@ CANConnection* CanConFactory::create(type pType, QString pPortName, QString pDri
         return new CANserver(pPortName);
     case CANLOGSERVER:
         return new CanLogServer(pPortName);
+#ifdef Q_OS_LINUX
+    case SOCKETCAN:
+        return new SocketCAN(pPortName);
+#endif
+    case GENERATOR:
+        return new TrafficGenerator(pPortName);
+    case LOGREPLAY:
+        return new LogReplay(pPortName);
+    case CAPTURE_LINK:
+        return new CaptureLinkClient(pPortName);
+    case SHARED_CAPTURE:
+        return new SharedCaptureClient(pPortName);
     default: {}
     }
 
@@ -1,9 +1,14 @@
 #include <QDateTime>
 #include <QSettings>
 #include <QCoreApplication>
+#include <QMutexLocker>
+#include <QThread>
 
 #include "canconmanager.h"
 #include "canconfactory.h"
+#include "dbc/dbchandler.h"
+#include "modifierprogram.h"
+#include "pipelinetrace.h"
 
 CANConManager* CANConManager::mInstance = nullptr;
 
@@ -17,12 +22,28 @@ CANConManager* CANConManager::getInstance()
 
 CANConManager::CANConManager(QObject *parent): QObject(parent)
 {
+    /*
+     * No more polling. Connections signal framesQueued when their queue goes from empty to not empty. On a quiet
+     * bus each frame is drained right away. Once the traffic picks up the drains get spaced out (up to 20ms like
+     * the old timer) so frames are handed on in big batches, unless a queue gets a quarter full first. Nothing
+     * runs at all while every bus is silent.
+     */
     connect(&mTimer, SIGNAL(timeout()), this, SLOT(refreshCanList()));
-    mTimer.setInterval(20); /*Tick 50 times per second to allow for good resolution in reception where needed. GUI updates *MUCH* more slowly*/
-    mTimer.setSingleShot(false);
-    mTimer.start();
+    mTimer.setSingleShot(true);
+    mTimer.setTimerType(Qt::PreciseTimer);
+    mBatchIntervalUs = 0;
+    mSinceDrain.start();
+    connect(&mLoadTimer, &QTimer::timeout, this, &CANConManager::sampleBusLoad);
+    mLoadTimer.setInterval(BUSLOAD_SAMPLE_MS);
+    connect(&mMergeTimer, &QTimer::timeout, this, &CANConManager::releaseMerged);
+    mMergeTimer.setSingleShot(true);
 
     mNumActiveBuses = 0;
+    mGatewayDbcRevision = 0;
+    mBuslessFrames = 0;
+    mPreviewEvery = 0;
+    mPreviewCountdown = 0;
+    mCaptureOnlyFrames = 0;
 
     resetTimeBasis();
 
@@ -33,17 +54,68 @@ CANConManager::CANConManager(QObject *parent): QObject(parent)
         useSystemTime = true;
     }
     else useSystemTime = false;
+    mMergeEnabled = settings.value("Main/MergeConnections", true).toBool();
+
+    //sends are queued by class and go out as the ceiling and the connections' backlogs allow
+    connect(&mTxTimer, &QTimer::timeout, this, &CANConManager::pumpTx);
+    mTxTimer.setSingleShot(true);
+    mTxTimer.setTimerType(Qt::PreciseTimer);
+    mTx.setCeiling(settings.value("Main/TxLoadCeiling", 0).toInt());
+    mTxBacklogLimit = settings.value("Main/TxBacklogLimit", 4096).toLongLong();
+    mBacklogCheckPosted = false;
 }
 
 void CANConManager::resetTimeBasis()
 {
+    //the host clock the merge goes by is about to jump so let go of everything held against the old one
+    releaseMergedFrames(true);
+    mMerge.reset();
     mTimestampBasis = QDateTime::currentMSecsSinceEpoch() * 1000;
     mElapsedTimer.restart();
 }
 
+//monotonic, but in the same microseconds since the epoch that most devices stamp with
+qint64 CANConManager::hostTimeUs() const
+{
+    return static_cast<qint64>(mTimestampBasis) + mElapsedTimer.nsecsElapsed() / 1000;
+}
+
+bool CANConManager::isMerging() const
+{
+    return mMergeEnabled && mConns.count() > 1;
+}
+
+ClockSyncStatus CANConManager::getClockSync(const CANConnection* pConn_p) const
+{
+    return mMerge.status(pConn_p);
+}
+
+quint64 CANConManager::getLateMergedFrames() const
+{
+    return mMerge.lateFrames();
+}
+
+void CANConManager::releaseMerged()
+{
+    releaseMergedFrames(!isMerging());
+}
+
+//hand on whatever's been held long enough, in time order. Checks again later if some has to wait longer
+void CANConManager::releaseMergedFrames(bool pAll)
+{
+    if (!mMerge.hasPending()) return;
+    QVector<CANFrame> frames;
+    frames.swap(mBatch);
+    mMerge.release(hostTimeUs(), frames, pAll);
+    if (!frames.isEmpty()) publishBatch(nullptr, frames);
+    else recycleBatch(frames);
+    if (mMerge.hasPending() && !mMergeTimer.isActive()) mMergeTimer.start(static_cast<int>(CLOCKSYNC_HOLD_US / 2000));
+}
+
 CANConManager::~CANConManager()
 {
     mTimer.stop();
+    mLoadTimer.stop();
     mInstance = nullptr;
 }
 
@@ -58,20 +130,47 @@ void CANConManager::stopAllConnections()
 void CANConManager::add(CANConnection* pConn_p)
 {
     mConns.append(pConn_p);
+    watchConnection(pConn_p);
+    if (!mLoadTimer.isActive()) mLoadTimer.start();
 }
 
 
 void CANConManager::remove(CANConnection* pConn_p)
 {
-    //disconnect(pConn_p, 0, this, 0);
+    releaseMergedFrames(true);
+    mMerge.forget(pConn_p);
+    disconnect(pConn_p, nullptr, this, nullptr);
     mConns.removeOne(pConn_p);
+    updateBusCount();
+    CANGatewayDelayLine::getReference()->forget(pConn_p);
+    if (mConns.isEmpty()) mLoadTimer.stop();
 }
 
 void CANConManager::replace(int idx, CANConnection* pConn_p)
 {
     CANConnection *original = mConns[idx];
+    releaseMergedFrames(true);
+    mMerge.forget(original);
+    disconnect(original, nullptr, this, nullptr);
     mConns.replace(idx, pConn_p);
+    updateBusCount(); //gateway routes can't point at the old one any more
+    CANGatewayDelayLine::getReference()->forget(original);
     delete original; original = NULL;
+    watchConnection(pConn_p);
+}
+
+void CANConManager::watchConnection(CANConnection* pConn_p)
+{
+    updateBusCount(); //so it knows its bus base
+    connect(pConn_p, &CANConnection::framesQueued, this, &CANConManager::handleFramesQueued, Qt::QueuedConnection);
+    connect(pConn_p, &CANConnection::status, this, &CANConManager::updateBusCount, Qt::QueuedConnection);
+    //anything queued before we were listening never got announced so pick it up now. This also re-arms the wakeup
+    refreshConnection(pConn_p);
+
+    if (!mAcceptanceFilters.isEmpty())
+    {
+        for (int bus = 0; bus < pConn_p->getNumBuses(); bus++) pConn_p->setAcceptanceFilters(bus, mAcceptanceFilters);
+    }
 }
 
 //Get total number of buses currently registered with the program
@@ -96,33 +195,76 @@ int CANConManager::getBusBase(CANConnection *which)
     return -1;
 }
 
+//deadline timer fired (or frames were sent with no connections at all). Drain everything that's waiting
 void CANConManager::refreshCanList()
 {
-    QObject* sender_p = QObject::sender();
-
+    TRACE_SCOPE("CANConManager::refreshCanList");
     if (mConns.count() == 0)
     {
-        tempFrames.clear();
-        //TODO: Seems to crash under heavy load. Find out why.
-        if(buslessFrames.size()) {            
-            tempFrames = buslessFrames; //make a copy and pass that copy
-            buslessFrames.clear(); //delete all frames from the original
-            emit framesReceived(nullptr, tempFrames);
+        //swap rather than copy. A listener that sends while we're emitting appends to the empty list, not the batch
+        if(buslessFrames.size()) {
+            QVector<CANFrame> frames;
+            frames.swap(mBatch);
+            frames.swap(buslessFrames);
+            publishBatch(nullptr, frames);
         }
         return;
     }
 
-    if( sender_p != &mTimer)
+    foreach (CANConnection* conn_p, mConns)
+        refreshConnection((CANConnection*)conn_p);
+}
+
+void CANConManager::handleFramesQueued()
+{
+    //compare pointers only. The connection may be gone by the time this queued call gets here
+    QObject *sender_p = QObject::sender();
+    CANConnection *conn_p = nullptr;
+    foreach (CANConnection* conn, mConns)
+    {
+        if (conn == sender_p) conn_p = conn;
+    }
+    if (!conn_p) return;
+
+    //quiet enough or the queue is filling up: hand the frames on right now
+    qint64 sinceDrainUs = mSinceDrain.nsecsElapsed() / 1000;
+    LFQueue<CANFrame> &queue = conn_p->getQueue();
+    if (sinceDrainUs >= mBatchIntervalUs || queue.count() >= queue.capacity() / 4)
+    {
+        refreshConnection(conn_p);
+        return;
+    }
+
+    //busy. Let this batch grow until the interval is up. The wakeup stays armed until then so no more events come in
+    if (!mTimer.isActive())
+    {
+        int waitMs = static_cast<int>((mBatchIntervalUs - sinceDrainUs + 999) / 1000);
+        mTimer.start(qMax(1, waitMs));
+    }
+}
+
+void CANConManager::updateBusCount()
+{
+    unsigned int buses = 0;
+    int busBase = 0;
+    QVector<QPair<CANConnection*, int>> layout;
+    foreach(CANConnection* conn_p, mConns)
     {
-        /* if we are not the sender, the signal is coming from a connection */
-        /* refresh only the given connection */
-        if(mConns.contains((CANConnection*) sender_p))
-            refreshConnection((CANConnection*)sender_p);
+        conn_p->setBusBase(busBase);
+        busBase += conn_p->getNumBuses();
+        if (conn_p->getStatus() == CANCon::CONNECTED) buses += conn_p->getNumBuses();
+        layout.append(qMakePair(conn_p, conn_p->getNumBuses()));
     }
-    else
+    //this runs on every drain so the gateway is only compiled again when the buses actually moved
+    if (layout != mGatewayLayout || (!mGatewayRoutes.isEmpty() && mGatewayDbcRevision != DBCHandler::getRevision()))
     {
-        foreach (CANConnection* conn_p, mConns)
-            refreshConnection((CANConnection*)conn_p);
+        mGatewayLayout = layout;
+        publishGateway();
+    }
+    if (buses != mNumActiveBuses)
+    {
+        mNumActiveBuses = buses;
+        emit connectionStatusUpdated(buses);
     }
 }
 
@@ -151,21 +293,13 @@ CANConnection* CANConManager::getByName(const QString& pName) const
 
 void CANConManager::refreshConnection(CANConnection* pConn_p)
 {
-    unsigned int buses = 0;
-    foreach(CANConnection* conn_p, mConns)
-    {
-        if (conn_p->getStatus() == CANCon::CONNECTED) buses += conn_p->getNumBuses();
-    }
-    if (buses != mNumActiveBuses)
-    {
-        mNumActiveBuses = buses;
-        emit connectionStatusUpdated(buses);
-    }
+    updateBusCount();
 
-    if (pConn_p->getQueue().peek() == nullptr) return;
+    //when the oldest waiting frame went in. Has to be read before the re-arm below or a new wakeup could replace it
+    qint64 queuedNs = pConn_p->queuedSince();
 
-    CANFrame* frame_p = nullptr;
-    QVector<CANFrame> frames;
+    //re-arm before draining so a frame queued while we're in here still wakes us up
+    pConn_p->resetFramesQueued();
 
     //Each connection only knows about its own bus numbers
     //so this variable is used to fix that up to turn local bus numbers
@@ -178,17 +312,255 @@ void CANConManager::refreshConnection(CANConnection* pConn_p)
         else break;
     }
 
+    if (pConn_p->getQueue().peek() == nullptr)
+    {
+        pConn_p->deliverTargettedFrames(busBase);
+        return;
+    }
+
+    int depth = pConn_p->getQueue().count();
+    CANFrame* frame_p = nullptr;
+    //take the spare vector for this batch. If something re-enters while we emit it just finds none and makes its own
+    QVector<CANFrame> frames;
+    frames.swap(mBatch);
+    frames.reserve(pConn_p->getQueue().count());
+
     //qDebug() << "Bus fixup number: " << busBase;
 
-    while( (frame_p = pConn_p->getQueue().peek() ) ) {
-        frame_p->bus += busBase;
-        //qDebug() << "Rx of frame from bus: " << frame_p->bus;
-        frames.append(*frame_p);
-        pConn_p->getQueue().dequeue();
+    //take whole runs of slots at a time. Only one index update per run instead of one per frame
+    int available = 0;
+    while( (frame_p = pConn_p->getQueue().peekSpan(available) ) ) {
+        for (int i = 0; i < available; i++)
+        {
+            frame_p[i].bus += busBase;
+            //qDebug() << "Rx of frame from bus: " << frame_p[i].bus;
+            //the copy shares the slot's payload buffer instead of duplicating it. Once the batch is cleared the slot
+            //owns that buffer alone again and producers that reuse it can write the next frame without allocating
+            frames.append(frame_p[i]);
+        }
+        pConn_p->getQueue().dequeue(available);
+    }
+
+    //big batches mean the bus is busy so wait longer next time. Small ones mean latency matters more than overhead
+    if (frames.size() >= 256) mBatchIntervalUs = qBound(1000, mBatchIntervalUs * 2, 20000);
+    else if (frames.size() < 32) mBatchIntervalUs /= 2;
+    if (mBatchIntervalUs < 500) mBatchIntervalUs = 0;
+    mSinceDrain.restart();
+
+    int drained = frames.size();
+    if(drained && isMerging())
+    {
+        mMerge.add(pConn_p, frames, hostTimeUs());
+        recycleBatch(frames);
+        releaseMergedFrames(false);
+    }
+    else if(drained)
+        publishBatch(pConn_p, frames);
+
+    //latency ends once every listener (the model included) is done with the batch
+    pConn_p->noteDrain(drained, depth, queuedNs);
+
+    //whatever matched a targetted frame filter in this batch goes out now too, one batch per receiver
+    pConn_p->deliverTargettedFrames(busBase);
+}
+
+static inline quint64 gatewayKey(int pFromBus, int pToBus)
+{
+    return (static_cast<quint64>(static_cast<quint32>(pFromBus)) << 32) | static_cast<quint32>(pToBus);
+}
+
+void CANConManager::setGatewayRoutes(const QVector<CANGatewayRoute>& pRoutes)
+{
+    mGatewayRoutes = pRoutes;
+    publishGateway();
+}
+
+QVector<CANGatewayRoute> CANConManager::getGatewayRoutes() const
+{
+    return mGatewayRoutes;
+}
+
+QSharedPointer<const CANGatewayCounters> CANConManager::getGatewayCounters(int pFromBus, int pToBus) const
+{
+    return mGatewayCounters.value(gatewayKey(pFromBus, pToBus));
+}
+
+QVector<QSharedPointer<const CANGatewayRuleCounters>> CANConManager::getGatewayRuleCounters(int pFromBus, int pToBus) const
+{
+    QVector<QSharedPointer<const CANGatewayRuleCounters>> counters;
+    for (const QPair<QString, QSharedPointer<CANGatewayRuleCounters>> &rule : mGatewayRuleCounters.value(gatewayKey(pFromBus, pToBus)))
+        counters.append(rule.second);
+    return counters;
+}
+
+void CANConManager::armTriggeredCapture(const TriggeredCaptureConfig& pConfig)
+{
+    mCapture.arm(pConfig);
+    emit triggeredCaptureChanged();
+}
+
+void CANConManager::disarmTriggeredCapture()
+{
+    mCapture.disarm();
+    emit triggeredCaptureChanged();
+}
+
+TriggeredCaptureStatus CANConManager::getTriggeredCaptureStatus() const
+{
+    return mCapture.getStatus();
+}
+
+//compile the routes against the current buses and hand the same table to every connection
+void CANConManager::publishGateway()
+{
+    QSharedPointer<CANGatewayTable> table;
+    mGatewayDbcRevision = DBCHandler::getRevision();
+    if (!mGatewayRoutes.isEmpty())
+    {
+        table.reset(new CANGatewayTable);
+        table->frames.reset(new LastFrameTable);
+        table->dbcRevision = mGatewayDbcRevision;
+        table->dbcMessages = DBCHandler::getReference()->sharedMessageSets();
+        for (const CANGatewayRoute &config : qAsConst(mGatewayRoutes))
+        {
+            if (config.fromBus < 0 || config.toBus < 0 || config.fromBus == config.toBus) continue;
+            CANGatewayTable::Route route;
+            route.config = config;
+            route.to = nullptr;
+            route.toLocalBus = 0;
+            int busBase = 0;
+            foreach (CANConnection* conn, mConns)
+            {
+                if (config.toBus < busBase + conn->getNumBuses())
+                {
+                    route.to = conn;
+                    route.toLocalBus = config.toBus - busBase;
+                    break;
+                }
+                busBase += conn->getNumBuses();
+            }
+            QSharedPointer<CANGatewayCounters> &counters = mGatewayCounters[gatewayKey(config.fromBus, config.toBus)];
+            if (!counters) counters.reset(new CANGatewayCounters);
+            route.counters = counters;
+
+            //counters stay with a rule as long as the same text is in the same place
+            QVector<QPair<QString, QSharedPointer<CANGatewayRuleCounters>>> &ruleCounters = mGatewayRuleCounters[gatewayKey(config.fromBus, config.toBus)];
+            ruleCounters.resize(config.rules.count());
+            QVector<QSharedPointer<CANGatewayRuleCounters>> lined;
+            for (int r = 0; r < config.rules.count(); r++)
+            {
+                if (!ruleCounters[r].second || ruleCounters[r].first != config.rules[r].text)
+                    ruleCounters[r] = qMakePair(config.rules[r].text, QSharedPointer<CANGatewayRuleCounters>(new CANGatewayRuleCounters));
+                lined.append(ruleCounters[r].second);
+            }
+            table->compileRules(route, lined);
+            table->routes.append(route);
+        }
+    }
+    foreach (CANConnection* conn, mConns) conn->setGateway(table);
+}
+
+CANConTelemetry CANConManager::getTelemetry()
+{
+    CANConTelemetry total;
+    foreach (CANConnection* conn_p, mConns) total.merge(conn_p->getTelemetry());
+    return total;
+}
+
+void CANConManager::resetTelemetry()
+{
+    foreach (CANConnection* conn_p, mConns) conn_p->resetTelemetry();
+    mBuslessFrames = 0;
+}
+
+void CANConManager::sampleBusLoad()
+{
+    foreach (CANConnection* conn_p, mConns) conn_p->sampleBusLoad();
+}
+
+CANBusLoad CANConManager::getBusLoad(int pBus)
+{
+    int busBase = 0;
+    foreach (CANConnection* conn_p, mConns)
+    {
+        if (pBus < (busBase + conn_p->getNumBuses())) return conn_p->getBusLoad(pBus - busBase);
+        busBase += conn_p->getNumBuses();
     }
+    return CANBusLoad();
+}
 
-    if(frames.size())
-        emit framesReceived(pConn_p, frames);
+quint64 CANConManager::getBuslessFrames() const
+{
+    return mBuslessFrames;
+}
+
+int CANConManager::getBatchInterval() const
+{
+    return mBatchIntervalUs;
+}
+
+//Hand a batch to all the listeners at once. If none of them kept a copy the vector is still ours alone so empty it
+//(which keeps the capacity) and put it back as the spare. If someone did keep it just let them have it.
+void CANConManager::publishBatch(CANConnection* pConn_p, QVector<CANFrame>& batch)
+{
+    if (mCapture.isActive())
+    {
+        TriggeredCaptureStatus::State before = mCapture.getState();
+        mCapture.process(batch);
+        if (mCapture.getState() != before) emit triggeredCaptureChanged();
+        if (batch.isEmpty()) return;
+    }
+
+    if (isSignalConnected(QMetaMethod::fromSignal(&CANConManager::framesCaptured))) emit framesCaptured(batch);
+
+    if (mCaptureSink)
+    {
+        mCaptureSink(batch);
+        mCaptureOnlyFrames += batch.size();
+        if (mPreviewEvery > 0)
+        {
+            mPreview.clear();
+            for (const CANFrame &frame : batch)
+            {
+                if (--mPreviewCountdown > 0) continue;
+                mPreview.append(frame);
+                mPreviewCountdown = mPreviewEvery;
+            }
+            if (!mPreview.isEmpty()) emit framesReceived(pConn_p, mPreview);
+        }
+        recycleBatch(batch);
+        return;
+    }
+
+    emit framesReceived(pConn_p, batch);
+    recycleBatch(batch);
+}
+
+//keeps the bigger of the two vectors as the spare, unless a listener still holds on to this one
+void CANConManager::recycleBatch(QVector<CANFrame>& batch)
+{
+    if (!batch.isDetached()) return;
+    batch.clear();
+    if (mBatch.capacity() < batch.capacity()) mBatch.swap(batch);
+}
+
+void CANConManager::setCaptureOnly(CaptureSink pSink, int pPreviewEvery)
+{
+    mCaptureSink = pSink;
+    mPreviewEvery = qMax(0, pPreviewEvery);
+    mPreviewCountdown = 1; //the first frame always shows so there's some sign of life
+    mCaptureOnlyFrames = 0;
+    mPreview.clear();
+}
+
+bool CANConManager::isCaptureOnly() const
+{
+    return static_cast<bool>(mCaptureSink);
+}
+
+quint64 CANConManager::getCaptureOnlyFrames() const
+{
+    return mCaptureOnlyFrames;
 }
 
 /*
@@ -197,55 +569,184 @@ void CANConManager::refreshConnection(CANConnection* pConn_p)
  * and there is a GVRET object first then a socketcan object it'll send on the socketcan object as
  * gvret will have claimed buses 0 and 1 and socketcan bus 2. But, each actual CANConnection expects
  * its own bus numbers to start at zero so the frame bus number has to be offset accordingly.
- * Also keep in mind that the CANConnection "sendFrame" function uses a blocking queued connection
- * and so will force the frame to be delivered before it keeps going. This allows on the stack variables
- * to be used but is slow. This function uses an on the stack copy of the frame so the way it works
- * is a good thing but performance will suffer. TODO: Investigate a way to use non-blocking calls.
 */
-bool CANConManager::sendFrame(const CANFrame& pFrame)
+CANConnection* CANConManager::connectionFor(int pBus, int& pBusBase) const
 {
-    int busBase = 0;
-    CANFrame workingFrame = pFrame;
+    pBusBase = 0;
+    foreach (CANConnection* conn, mConns)
+    {
+        if (pBus < (pBusBase + conn->getNumBuses())) return conn;
+        pBusBase += conn->getNumBuses();
+    }
+    return nullptr;
+}
 
+/*
+ * Sends don't go straight to the connection any more, they're queued in the TxScheduler by class and deadline and
+ * pumpTx hands on whatever may go right away. With no ceiling and nothing backed up that's everything, so the
+ * frame is out before this returns like it always was. Keep in mind that the CANConnection "sendFrames" function
+ * uses a blocking queued connection and so will force the frames to be delivered before it keeps going.
+*/
+bool CANConManager::sendFrame(const CANFrame& pFrame, TxClass pClass, qint64 pDeadlineUs)
+{
     if (mConns.count() == 0)
     {
         buslessFrames.append(pFrame);
+        mBuslessFrames++;
+        if (!mTimer.isActive()) mTimer.start(0);
         return true;
     }
 
-    foreach (CANConnection* conn, mConns)
+    int busBase;
+    if (!connectionFor(pFrame.bus, busBase)) return false;
+    bool ret = mTx.add(pFrame, pClass, pDeadlineUs, hostTimeUs());
+    pumpTx();
+    return ret;
+}
+
+qint64 CANConManager::getTxBacklog(int pBus)
+{
+    int busBase;
+    CANConnection *conn = connectionFor(pBus, busBase);
+    return conn ? conn->getTxBacklog() : -1;
+}
+
+//Same as sendFrame. What goes out in one pump is handed over a run per connection so the connection can encode
+//them all and write once (and there's one thread hop per run instead of one per frame)
+bool CANConManager::sendFrames(const QList<CANFrame>& pFrames, TxClass pClass, qint64 pDeadlineUs)
+{
+    if (mConns.count() == 0)
     {
-        //check if this CAN connection is supposed to handle the requested bus
-        if (pFrame.bus < (busBase + conn->getNumBuses()))
+        foreach(const CANFrame& frame, pFrames) buslessFrames.append(frame);
+        mBuslessFrames += static_cast<quint64>(pFrames.count());
+        if (!mTimer.isActive()) mTimer.start(0);
+        return true;
+    }
+
+    bool ret = true;
+    qint64 now = hostTimeUs();
+    foreach(const CANFrame& frame, pFrames)
+    {
+        int busBase;
+        if (!connectionFor(frame.bus, busBase))
         {
-            workingFrame.bus -= busBase;
-            workingFrame.isReceived = false;
-            if (useSystemTime)
-            {
-                workingFrame.setTimeStamp(QCanBusFrame::TimeStamp(0,QDateTime::currentMSecsSinceEpoch() * 1000));
-            }
-            else
+            //no such bus. What came before it still goes out like it used to
+            ret = false;
+            break;
+        }
+        if (!mTx.add(frame, pClass, pDeadlineUs, now)) ret = false;
+    }
+    pumpTx();
+    return ret;
+}
+
+TxSchedulerStats CANConManager::getTxStats() const
+{
+    return mTx.getStats();
+}
+
+/*
+ * Which of the buses are on a connection that's got more than mTxBacklogLimit bytes still to go out. Asking a
+ * connection is a trip to its thread so it's only done every TXSCHED_BACKLOG_RETRY_US and only from the manager's
+ * own thread. Any other thread takes the last answer and leaves the timer to ask again.
+ */
+QVector<bool> CANConManager::txBlocked(const QVector<int>& pBuses)
+{
+    bool ask = false;
+    {
+        QMutexLocker lock(&mTxBacklogLock);
+        if (!mSinceBacklogCheck.isValid() || mSinceBacklogCheck.nsecsElapsed() / 1000 >= TXSCHED_BACKLOG_RETRY_US)
+        {
+            if (QThread::currentThread() == thread()) ask = true;
+            else if (!mBacklogCheckPosted)
             {
-                workingFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, mElapsedTimer.nsecsElapsed() / 1000));
-                //workingFrame.timestamp -= mTimestampBasis;
+                mBacklogCheckPosted = true;
+                QMetaObject::invokeMethod(this, "armTxTimer", Qt::QueuedConnection, Q_ARG(int, 0));
             }
-
-            return conn->sendFrame(workingFrame);
         }
-        busBase += conn->getNumBuses();
+        if (!ask) return mTxBacklogged;
+    }
+
+    QVector<bool> blocked(getNumBuses(), false);
+    QHash<CANConnection*, bool> asked;
+    foreach (int bus, pBuses)
+    {
+        int busBase;
+        CANConnection *conn = connectionFor(bus, busBase);
+        if (!conn || bus >= blocked.count()) continue;
+        if (!asked.contains(conn)) asked[conn] = conn->getTxBacklog() > mTxBacklogLimit;
+        blocked[bus] = asked.value(conn);
     }
-    return false;
+
+    QMutexLocker lock(&mTxBacklogLock);
+    mTxBacklogged = blocked;
+    mSinceBacklogCheck.start();
+    mBacklogCheckPosted = false;
+    return blocked;
 }
 
-bool CANConManager::sendFrames(const QList<CANFrame>& pFrames)
+//hands the connections whatever the scheduler lets go now. Any thread, whoever just queued something
+void CANConManager::pumpTx()
 {
-    foreach(const CANFrame& frame, pFrames)
+    QVector<bool> blocked;
+    if (mTxBacklogLimit > 0)
     {
-        if(!sendFrame(frame))
-            return false;
+        QVector<int> held = mTx.heldBuses();
+        if (!held.isEmpty()) blocked = txBlocked(held);
     }
 
-    return true;
+    QVector<CANFrame> out;
+    qint64 wait = mTx.take(hostTimeUs(), [this](const CANFrame& frame) -> quint64
+    {
+        int busBase;
+        CANConnection *conn = connectionFor(frame.bus, busBase);
+        if (!conn) return 0;
+        CANFrame local = frame;
+        local.bus -= busBase;
+        return conn->getBusTimePs(local);
+    }, blocked, out);
+
+    QList<CANFrame> run;
+    CANConnection *runConn = nullptr;
+    foreach (const CANFrame& frame, out)
+    {
+        int busBase;
+        CANConnection *target = connectionFor(frame.bus, busBase);
+        if (!target) continue; //its connection went away while it waited
+
+        if (target != runConn && !run.isEmpty())
+        {
+            runConn->sendFrames(run);
+            run.clear();
+        }
+        runConn = target;
+
+        CANFrame workingFrame = frame;
+        workingFrame.bus -= busBase;
+        workingFrame.isReceived = false;
+        if (useSystemTime)
+        {
+            workingFrame.setTimeStamp(QCanBusFrame::TimeStamp(0,QDateTime::currentMSecsSinceEpoch() * 1000));
+        }
+        else
+        {
+            workingFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, mElapsedTimer.nsecsElapsed() / 1000));
+        }
+        run.append(workingFrame);
+    }
+    if (runConn && !run.isEmpty()) runConn->sendFrames(run);
+
+    if (wait < 0) return;
+    int ms = static_cast<int>(qMin<qint64>((wait + 999) / 1000, 1000));
+    if (QThread::currentThread() == thread()) armTxTimer(ms);
+    else QMetaObject::invokeMethod(this, "armTxTimer", Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+//never pushes a wakeup that's already due sooner further out
+void CANConManager::armTxTimer(int pMs)
+{
+    if (mTxTimer.isActive() && mTxTimer.remainingTime() <= pMs) return;
+    mTxTimer.start(pMs);
 }
 
 //For each device associated with buses go through and see if that device has a bus
@@ -298,3 +799,17 @@ bool CANConManager::removeAllTargettedFrames(QObject *receiver)
 
     return true;
 }
+
+int CANConManager::setAcceptanceFilters(const QVector<CANAcceptanceFilter>& pFilters)
+{
+    int filtering = 0;
+    mAcceptanceFilters = pFilters;
+    foreach (CANConnection* conn, mConns)
+    {
+        for (int bus = 0; bus < conn->getNumBuses(); bus++)
+        {
+            if (conn->setAcceptanceFilters(bus, pFilters) && !pFilters.isEmpty()) filtering++;
+        }
+    }
+    return filtering;
+}
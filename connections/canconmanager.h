@@ -4,8 +4,12 @@
 #include <QObject>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <functional>
 
 #include "canconnection.h"
+#include "clocksync.h"
+#include "triggeredcapture.h"
+#include "txscheduler.h"
 
 class CANConManager : public QObject
 {
@@ -26,19 +30,35 @@ public:
     uint64_t getTimeBasis();
     void resetTimeBasis();
 
+    /**
+     * @brief With more than one connection their frames are put on the host clock and handed on as one stream in
+     * time order, see MergedTimeline. framesReceived then comes with no connection. Main/MergeConnections turns it off
+     */
+    bool isMerging() const;
+    ClockSyncStatus getClockSync(const CANConnection* pConn_p) const; //how far off that connection's clock is
+    quint64 getLateMergedFrames() const; //frames that came in after later ones had already gone out
+
     int getNumBuses();
     int getBusBase(CANConnection *);
 
     /**
      * @brief sendFrame sends a single frame out the desired bus
      * @param pFrame - reference to a CANFrame struct that has been filled out for sending
-     * @return bool specifying whether the send succeeded or not
+     * @param pClass - which sends it goes ahead of or behind, see TxScheduler
+     * @param pDeadlineUs - how soon it should be out, 0 for the class's default
+     * @return false if there's no such bus or the frame had to be dropped. Queued counts as sent
      * @note Finds which CANConnection object is responsible for this bus and automatically converts bus number to pass properly to CANConnection
      */
-    bool sendFrame(const CANFrame& pFrame);
+    bool sendFrame(const CANFrame& pFrame, TxClass pClass = TX_PERIODIC, qint64 pDeadlineUs = 0);
 
     //just the multi-frame version of above function.
-    bool sendFrames(const QList<CANFrame>& pFrames);
+    bool sendFrames(const QList<CANFrame>& pFrames, TxClass pClass = TX_PERIODIC, qint64 pDeadlineUs = 0);
+
+    //sent, late and dropped by class since the program started, and what's waiting now
+    TxSchedulerStats getTxStats() const;
+
+    //TX backlog of whichever connection handles the bus, see CANConnection::getTxBacklog. -1 if it can't tell or there's no such bus
+    qint64 getTxBacklog(int pBus);
 
     /**
      * @brief Add a new filter for the targetted frames. If a frame matches it will immediately be sent via the targettedFrameReceived signal
@@ -62,26 +82,127 @@ public:
 
     bool removeAllTargettedFrames(QObject *receiver);
 
+    /**
+     * @brief Push an acceptance filter set down to every bus of every connection. Connections added later get it too.
+     * @param pFilters - frames to accept. Empty turns hardware filtering back off
+     * @return how many buses are filtering in hardware. The others still pass everything through
+     */
+    int setAcceptanceFilters(const QVector<CANAcceptanceFilter>& pFilters);
+
+    /**
+     * @brief Gateway mode. Frames received on a route's bus go straight out the other bus from the receiving
+     * connection's own thread as they arrive, without waiting for the GUI. Kept up to date as connections come and go
+     * @param pRoutes - replaces whatever routes there were. Empty turns the gateway off
+     */
+    void setGatewayRoutes(const QVector<CANGatewayRoute>& pRoutes);
+    QVector<CANGatewayRoute> getGatewayRoutes() const;
+    //totals for the route between two buses since it was first set up. Null if there never was one
+    QSharedPointer<const CANGatewayCounters> getGatewayCounters(int pFromBus, int pToBus) const;
+    //one per rule of the route between two buses, in the same order. A rule keeps its counters while its text doesn't change
+    QVector<QSharedPointer<const CANGatewayRuleCounters>> getGatewayRuleCounters(int pFromBus, int pToBus) const;
+
+    /**
+     * @brief Triggered capture. While armed, received frames only get as far as a pre-trigger ring per bus. Once a
+     * trigger fires the window around it is passed on like normal traffic (and / or saved), see TriggeredCapture
+     */
+    void armTriggeredCapture(const TriggeredCaptureConfig& pConfig);
+    void disarmTriggeredCapture(); //back to passing everything through
+    TriggeredCaptureStatus getTriggeredCaptureStatus() const;
+
+    /**
+     * @brief Capture only mode, for when frames are just being recorded. Received batches go to the sink instead of
+     * framesReceived so the frame model, its filters and the windows never see the traffic. One frame in every
+     * pPreviewEvery is still passed on as a live preview, 0 passes none. Triggered capture still comes first.
+     * The sink is called on the GUI thread with each batch so it should only queue the frames somewhere
+     * @param pSink - empty turns capture only mode back off
+     */
+    typedef std::function<void(const QVector<CANFrame>&)> CaptureSink;
+    void setCaptureOnly(CaptureSink pSink, int pPreviewEvery);
+    bool isCaptureOnly() const;
+    quint64 getCaptureOnlyFrames() const; //handed to the sink since capture only mode was last turned on
+
+    /**
+     * @brief Pipeline telemetry of all the connections added together. Each connection has its own too
+     */
+    CANConTelemetry getTelemetry();
+    void resetTelemetry();
+
+    //utilization of a global bus, see BusLoadMeter. Nothing known if there's no such bus
+    CANBusLoad getBusLoad(int pBus);
+
+    //frames sent while there were no connections at all. They're just handed back as if received
+    quint64 getBuslessFrames() const;
+
+    //how long frames are currently allowed to pile up before a drain, in us
+    int getBatchInterval() const;
+
 signals:
-    void framesReceived(CANConnection* pConn_p, QVector<CANFrame>& pFrames);
+    /*
+     * Every listener gets the same batch. It's only valid during the call but copying the QVector just bumps a
+     * reference count so anybody that needs the frames later can keep a copy cheaply. Don't cast away the const.
+     */
+    void framesReceived(CANConnection* pConn_p, const QVector<CANFrame>& pFrames);
+    //every frame kept after triggered capture, capture only or not. For things like CaptureAgent that need them all
+    void framesCaptured(const QVector<CANFrame>& pFrames);
     void connectionStatusUpdated(int conns);
+    void triggeredCaptureChanged(); //armed, triggered, window done or disarmed
 
 private slots:
     void refreshCanList();
+    void handleFramesQueued();
+    void updateBusCount();
+    void sampleBusLoad();
+    void releaseMerged();
+    void pumpTx();
+    void armTxTimer(int pMs);
 
 private:
     explicit CANConManager(QObject *parent = 0);
     void refreshConnection(CANConnection* pConn_p);
+    void watchConnection(CANConnection* pConn_p);
+    void publishBatch(CANConnection* pConn_p, QVector<CANFrame>& batch);
+    void recycleBatch(QVector<CANFrame>& batch);
+    void publishGateway();
+    void releaseMergedFrames(bool pAll);
+    qint64 hostTimeUs() const;
+    CANConnection* connectionFor(int pBus, int& pBusBase) const;
+    QVector<bool> txBlocked(const QVector<int>& pBuses);
 
     static CANConManager*  mInstance;
     QList<CANConnection*>  mConns;
-    QTimer                 mTimer;
+    QTimer                 mTimer; //single shot deadline for batched draining. Idle unless frames are waiting
+    QTimer                 mLoadTimer; //bus load samples, runs while there are connections
+    QElapsedTimer          mSinceDrain;
+    int                    mBatchIntervalUs; //how long frames may pile up before a drain. Adapts to the traffic
     QElapsedTimer          mElapsedTimer;
     uint64_t               mTimestampBasis;
     uint32_t               mNumActiveBuses;
     bool                   useSystemTime;
     QVector<CANFrame>      buslessFrames;
-    QVector<CANFrame>      tempFrames;
+    quint64                mBuslessFrames;
+    QVector<CANAcceptanceFilter> mAcceptanceFilters;
+    QVector<CANFrame>      mBatch; //spare batch vector. Reused every drain so steady traffic doesn't allocate
+    QVector<CANGatewayRoute> mGatewayRoutes;
+    QHash<quint64, QSharedPointer<CANGatewayCounters>> mGatewayCounters; //by from / to bus pair
+    QVector<QPair<CANConnection*, int>> mGatewayLayout; //connections and bus counts the routes were compiled for
+    QHash<quint64, QVector<QPair<QString, QSharedPointer<CANGatewayRuleCounters>>>> mGatewayRuleCounters; //rule text and its counters
+    quint32 mGatewayDbcRevision; //the rules looked their signals up in this
+    TriggeredCapture mCapture;
+    CaptureSink mCaptureSink; //empty unless capture only
+    int mPreviewEvery;
+    int mPreviewCountdown; //frames until the next one goes to the preview
+    quint64 mCaptureOnlyFrames;
+    QVector<CANFrame> mPreview; //reused like mBatch
+    MergedTimeline mMerge;
+    QTimer mMergeTimer; //releases held frames once their hold is up when nothing else comes in
+    bool mMergeEnabled;
+    TxScheduler mTx;
+    QTimer mTxTimer; //single shot, for when the scheduler held something back
+    qint64 mTxBacklogLimit; //bytes a connection may have waiting before it only gets protocol frames, 0 for no limit
+    QMutex mTxBacklogLock; //just for the two below, never held while asking a connection
+    QVector<bool> mTxBacklogged; //by global bus, as of the last check
+    QElapsedTimer mSinceBacklogCheck;
+    bool mBacklogCheckPosted; //another thread already asked the timer to check
 };
 
 #endif // CANCONNECTIONMODEL_H
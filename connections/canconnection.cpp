@@ -1,6 +1,51 @@
 #include <QSettings>
 #include <QThread>
+#include <QTimer>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include "canconnection.h"
+#include "canconworkers.h"
+#include "liveframetable.h"
+#include "threadpolicy.h"
+
+static inline qint64 steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CANConTelemetry::merge(const CANConTelemetry &other)
+{
+    framesIn += other.framesIn;
+    framesDropped += other.framesDropped;
+    drains += other.drains;
+    queueDepth += other.queueDepth;
+    queueHighWater = qMax(queueHighWater, other.queueHighWater);
+    queueCapacity += other.queueCapacity;
+    largestBatch = qMax(largestBatch, other.largestBatch);
+    framesSent += other.framesSent;
+    txPendingBytes += other.txPendingBytes;
+    if (other.txBacklogBytes >= 0) txBacklogBytes = qMax<qint64>(txBacklogBytes, 0) + other.txBacklogBytes;
+    for (int i = 0; i < CANCON_LATENCY_BUCKETS && i < other.latency.count(); i++) latency[i] += other.latency[i];
+}
+
+qint64 CANConTelemetry::latencyPercentile(double pFraction) const
+{
+    quint64 total = 0;
+    foreach (quint64 count, latency) total += count;
+    if (total == 0) return 0;
+
+    quint64 want = static_cast<quint64>(pFraction * total);
+    quint64 seen = 0;
+    for (int i = 0; i < latency.count(); i++)
+    {
+        seen += latency[i];
+        if (seen > want || seen == total) return static_cast<qint64>(1) << i;
+    }
+    return static_cast<qint64>(1) << (latency.count() - 1);
+}
 
 CANConnection::CANConnection(QString pPort,
                              QString pDriver,
@@ -14,24 +59,38 @@ CANConnection::CANConnection(QString pPort,
                              bool pUseThread) :
     mNumBuses(pNumBuses),
     mSerialSpeed(pSerialSpeed),
+    mLoad(pNumBuses),
     mQueue(),
     mPort(pPort),
     mDriver(pDriver),
     mType(pType),
     mIsCapSuspended(false),
     mStatus(CANCon::NOT_CONNECTED),
+    mWakePending(0),
     mStarted(false),
-    mThread_p(nullptr)
+    mThread_p(nullptr),
+    mPoolThread_p(nullptr),
+    mHomeThread_p(nullptr)
 {
     /* register types */
     qRegisterMetaType<CANBus>("CANBus");
     qRegisterMetaType<CANFrame>("CANFrame");
     qRegisterMetaType<CANConStatus>("CANConStatus");
     qRegisterMetaType<CANFltObserver>("CANFlt");
+    qRegisterMetaType<QVector<CANAcceptanceFilter>>("QVector<CANAcceptanceFilter>");
+    qRegisterMetaType<CANConTelemetry>("CANConTelemetry");
 
     /* set queue size */
     mQueue.setSize(pQueueLen); /*TODO add check on returned value */
 
+    mTxTimer_p = nullptr;
+    mTxDeadline = 0;
+    mTxHold = false;
+    mTxEcho = true;
+    mTxFrames = 0;
+    mDroppedBase = 0;
+    mWakeNs.storeRelaxed(0);
+
     /* allocate buses */
     /* TODO: change those tables for a vector */
     mBusData.resize(mNumBuses);
@@ -42,10 +101,13 @@ CANConnection::CANConnection(QString pPort,
     if (pBusSpeed > 0) mBusData[0].mBus.setSpeed(pBusSpeed);
     mBusData[0].mBus.setCanFD(pCanFd);
     if (pDataRate > 0) mBusData[0].mBus.setDataRate(pDataRate);
+    //other buses only get a rate once they're configured, until then their load isn't known
+    if (pBusSpeed > 0 && mNumBuses > 0) mLoad.setRates(0, pBusSpeed, pCanFd ? pDataRate : 0);
 
-    /* if needed, create a thread and move ourself into it */
+    /* if needed, create a thread (or take a shared one) and move ourself into it */
     if(pUseThread) {
-        mThread_p = new QThread();
+        mPoolThread_p = CANConWorkers::acquire();
+        if (!mPoolThread_p) mThread_p = new QThread();
     }
 }
 
@@ -53,7 +115,12 @@ CANConnection::CANConnection(QString pPort,
 CANConnection::~CANConnection()
 {
     /* stop and delete thread */
-    if(mThread_p) {
+    if (mPoolThread_p) {
+        //everybody else on it carries on
+        CANConWorkers::release(mPoolThread_p);
+        mPoolThread_p = nullptr;
+    }
+    else if(mThread_p) {
         mThread_p->quit();
         mThread_p->wait();
         delete mThread_p;
@@ -66,6 +133,16 @@ CANConnection::~CANConnection()
 
 void CANConnection::start()
 {
+    if (mPoolThread_p && !mThread_p)
+    {
+        /* the shared thread is already running, so just move over and start from its event loop */
+        mHomeThread_p = thread();
+        mThread_p = mPoolThread_p;
+        moveToThread(mThread_p);
+        QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection);
+        return;
+    }
+
     if( mThread_p && (mThread_p != QThread::currentThread()) )
     {
         /* move ourself to the thread */
@@ -79,6 +156,7 @@ void CANConnection::start()
 
     /* set started flag */
     mStarted = true;
+    if (mThread_p) ThreadPolicy::apply(ThreadPolicy::CAPTURE); //never the GUI thread
 
     QSettings settings;
 
@@ -88,6 +166,8 @@ void CANConnection::start()
     }
     else useSystemTime = false;
 
+    mTxDeadline = settings.value("Main/TXFlushDeadline", 0).toInt();
+
     /* in multithread case, this will be called before entering thread event loop */
     return piStarted();
 }
@@ -109,6 +189,24 @@ void CANConnection::suspend(bool pSuspend)
 
 void CANConnection::stop()
 {
+    if (mPoolThread_p)
+    {
+        /* stopped and handed back already */
+        if (!mThread_p) return;
+        /* a shared thread keeps running for the others, only this connection stops */
+        if (mThread_p != QThread::currentThread())
+        {
+            QMetaObject::invokeMethod(this, "stop", Qt::BlockingQueuedConnection);
+            return;
+        }
+        flushTx();
+        piStop();
+        /* back to where it was started from so it can be deleted or started again from there */
+        mThread_p = nullptr;
+        moveToThread(mHomeThread_p);
+        return;
+    }
+
     /* 1) execute in mThread_p context */
     if( mThread_p && mStarted && (mThread_p != QThread::currentThread()) )
     {
@@ -128,6 +226,7 @@ void CANConnection::stop()
     }
 
     /* 2) call piStop in mThread context */
+    flushTx(); //anything still waiting on the deadline goes out while the device is open
     return piStop();
 }
 
@@ -177,14 +276,10 @@ bool CANConnection::sendFrame(const CANFrame& pFrame)
         return ret;
     }
 
-    CANFrame *txFrame;
-    txFrame = getQueue().get();
-    if (txFrame)
-    {
-        *txFrame = pFrame;        
-    }    
-    getQueue().queue();
+    echoTxFrame(pFrame);
+    notifyFramesQueued();
 
+    mTxFrames++;
     return piSendFrame(pFrame);
 }
 
@@ -202,7 +297,83 @@ bool CANConnection::sendFrames(const QList<CANFrame>& pFrames)
         return ret;
     }
 
-    return piSendFrames(pFrames);
+    foreach(const CANFrame& frame, pFrames)
+        echoTxFrame(frame);
+    notifyFramesQueued();
+
+    /* everything piSendFrames encodes goes out in one write per bus at the end */
+    mTxFrames += static_cast<quint64>(pFrames.count());
+    mTxHold = true;
+    bool ret = piSendFrames(pFrames);
+    mTxHold = false;
+    flushTx();
+
+    return ret;
+}
+
+
+void CANConnection::echoTxFrame(const CANFrame& pFrame)
+{
+    if (!mTxEcho) return;
+    //a device that echoes sent frames itself has them counted when they come back in
+    mLoad.add(pFrame);
+
+    CANFrame *txFrame = getQueue().get();
+    if (!txFrame) return;
+    *txFrame = pFrame;
+    getQueue().queue();
+}
+
+
+void CANConnection::setTxEcho(bool pEcho)
+{
+    mTxEcho = pEcho;
+}
+
+
+QByteArray &CANConnection::txBuffer(int pBusIdx)
+{
+    if (pBusIdx < 0) pBusIdx = 0;
+    if (pBusIdx >= mTxPending.count()) mTxPending.resize(pBusIdx + 1);
+    return mTxPending[pBusIdx];
+}
+
+
+void CANConnection::txQueued()
+{
+    if (mTxHold) return;
+
+    int pending = 0;
+    foreach (const QByteArray &bytes, mTxPending) pending += bytes.count();
+
+    if (mTxDeadline <= 0 || pending >= CANCON_TX_FLUSH_BYTES)
+    {
+        flushTx();
+        return;
+    }
+
+    if (!mTxTimer_p)
+    {
+        mTxTimer_p = new QTimer(this);
+        mTxTimer_p->setSingleShot(true);
+        mTxTimer_p->setTimerType(Qt::PreciseTimer);
+        connect(mTxTimer_p, &QTimer::timeout, this, &CANConnection::flushTx);
+    }
+    /* the deadline counts from the first frame waiting, later ones don't push it back */
+    if (!mTxTimer_p->isActive()) mTxTimer_p->start(mTxDeadline);
+}
+
+
+void CANConnection::flushTx()
+{
+    if (mTxTimer_p) mTxTimer_p->stop();
+
+    for (int bus = 0; bus < mTxPending.count(); bus++)
+    {
+        if (mTxPending[bus].isEmpty()) continue;
+        piWriteTx(bus, mTxPending[bus]);
+        mTxPending[bus].clear();
+    }
 }
 
 
@@ -239,6 +410,7 @@ void CANConnection::setBusConfig(int pBusId, CANBus& pBus) {
 
     mBusData[pBusId].mConfigured = true;
     mBusData[pBusId].mBus = pBus;
+    mLoad.setRates(pBusId, pBus.getSpeed(), pBus.isCanFD() ? pBus.getDataRate() : 0);
 }
 
 
@@ -256,6 +428,151 @@ LFQueue<CANFrame>& CANConnection::getQueue() {
 }
 
 
+/*
+ * The reader clears the flag and then looks at the queue, the producer fills the queue and then looks at the flag.
+ * Each side's store has to be visible before its own load or both can miss the other and the frames sit there
+ * until the next one comes in. The seq_cst fences on both sides rule that out.
+ */
+void CANConnection::resetFramesQueued() {
+    mWakePending.fetchAndStoreOrdered(0);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+
+void CANConnection::notifyFramesQueued() {
+    /* only the first frame after a drain wakes the reader up, the rest just pile up until it gets to them */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(mWakePending.loadRelaxed() == 0 && mWakePending.testAndSetOrdered(0, 1))
+    {
+        mWakeNs.storeRelease(steadyNs());
+        emit framesQueued();
+    }
+}
+
+
+void CANConnection::fillPayload(CANFrame &frame, const void *pData, int len) {
+    QByteArray payload = frame.payload();
+    frame.setPayload(QByteArray()); //so payload is the only one holding the buffer and resize doesn't copy it
+    payload.resize(len);
+    if (len > 0) memcpy(payload.data(), pData, static_cast<size_t>(len));
+    frame.setPayload(payload);
+}
+
+
+qint64 CANConnection::queuedSince() {
+    if (mWakePending.loadAcquire() == 0) return 0;
+    return mWakeNs.loadAcquire();
+}
+
+
+void CANConnection::noteDrain(int pFrames, int pDepth, qint64 pQueuedNs)
+{
+    mTelemetry.framesIn += static_cast<quint64>(pFrames);
+    mTelemetry.drains++;
+    if (pDepth > mTelemetry.queueHighWater) mTelemetry.queueHighWater = pDepth;
+    if (pFrames > mTelemetry.largestBatch) mTelemetry.largestBatch = pFrames;
+    if (pQueuedNs <= 0 || pFrames == 0) return;
+
+    qint64 latencyUs = (steadyNs() - pQueuedNs) / 1000;
+    int bucket = 0;
+    while (bucket < CANCON_LATENCY_BUCKETS - 1 && latencyUs >= (static_cast<qint64>(1) << bucket)) bucket++;
+    mTelemetry.latency[bucket]++;
+}
+
+
+CANConTelemetry CANConnection::getTelemetry()
+{
+    CANConTelemetry telemetry = mTelemetry;
+    telemetry.framesDropped = mQueue.dropped() - mDroppedBase;
+    telemetry.queueDepth = mQueue.count();
+    telemetry.queueCapacity = mQueue.capacity();
+    getTxTelemetry(telemetry, false);
+    return telemetry;
+}
+
+
+void CANConnection::resetTelemetry()
+{
+    mTelemetry = CANConTelemetry();
+    mDroppedBase = mQueue.dropped();
+    mLoad.reset();
+    CANConTelemetry unused;
+    getTxTelemetry(unused, true);
+}
+
+
+CANBusLoad CANConnection::getBusLoad(int pBusIdx) const
+{
+    return mLoad.load(pBusIdx);
+}
+
+
+quint64 CANConnection::getBusTimePs(const CANFrame& pFrame) const
+{
+    return mLoad.busTimePs(pFrame);
+}
+
+
+void CANConnection::sampleBusLoad()
+{
+    mLoad.sample();
+}
+
+
+void CANConnection::getTxTelemetry(CANConTelemetry& pTelemetry, bool pReset)
+{
+    /* make sure we execute in mThread context. Once the thread is gone nothing else touches these */
+    if( mThread_p && mThread_p->isRunning() && (mThread_p != QThread::currentThread()) ) {
+        QMetaObject::invokeMethod(this, "getTxTelemetry",
+                                  Qt::BlockingQueuedConnection,
+                                  Q_ARG(CANConTelemetry&, pTelemetry),
+                                  Q_ARG(bool, pReset));
+        return;
+    }
+
+    pTelemetry.framesSent = mTxFrames;
+    pTelemetry.txPendingBytes = 0;
+    foreach (const QByteArray &bytes, mTxPending) pTelemetry.txPendingBytes += bytes.count();
+    pTelemetry.txBacklogBytes = piTxBacklog();
+    if (pReset) mTxFrames = 0;
+}
+
+
+void CANConnection::setBusBase(int pBusBase)
+{
+    mBusBase.storeRelaxed(pBusBase);
+}
+
+
+void CANConnection::setGateway(QSharedPointer<CANGatewayTable> pTable)
+{
+    QMutexLocker lock(&mTargetLock);
+    mNewGateway = pTable;
+    mGatewayChanged.storeRelease(1);
+}
+
+
+qint64 CANConnection::getTxBacklog()
+{
+    /* make sure we execute in mThread context */
+    if( mThread_p && mThread_p->isRunning() && (mThread_p != QThread::currentThread()) ) {
+        qint64 backlog = -1;
+        QMetaObject::invokeMethod(this, "getTxBacklog",
+                                  Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(qint64, backlog));
+        return backlog;
+    }
+
+    return piTxBacklog();
+}
+
+
+qint64 CANConnection::piTxBacklog()
+{
+    return -1;
+}
+
+
 CANCon::type CANConnection::getType() {
     return mType;
 }
@@ -281,6 +598,16 @@ void CANConnection::debugInput(QByteArray bytes) {
     Q_UNUSED(bytes)
 }
 
+void CANConnection::debugOutput(const QString &debugString)
+{
+    mDebugLog.addText(debugString);
+}
+
+void CANConnection::debugBytes(DebugKind pKind, const QByteArray &pBytes)
+{
+    mDebugLog.add(pKind, pBytes.constData(), pBytes.length());
+}
+
 bool CANConnection::addTargettedFrame(int pBusId, uint32_t ID, uint32_t mask, QObject *receiver)
 {
 /*
@@ -311,6 +638,7 @@ bool CANConnection::addTargettedFrame(int pBusId, uint32_t ID, uint32_t mask, QO
     {
         for (int i = 0; i < mBusData.count(); i++) mBusData[i].mTargettedFrames.append(target);
     }
+    rebuildTargets();
 
     return true;
 }
@@ -338,44 +666,250 @@ bool CANConnection::removeTargettedFrame(int pBusId, uint32_t ID, uint32_t mask,
     target.id = ID;
     target.mask = mask;
     target.observer = receiver;
-    mBusData[pBusId].mTargettedFrames.removeAll(target);
+    if (pBusId > -1)
+        mBusData[pBusId].mTargettedFrames.removeAll(target);
+    else
+    {
+        for (int i = 0; i < mBusData.count(); i++) mBusData[i].mTargettedFrames.removeAll(target);
+    }
+    rebuildTargets();
 
     return true;
 }
 
 bool CANConnection::removeAllTargettedFrames(QObject *receiver)
 {
-    for (int i = 0; i < getNumBuses(); i++) {
-        foreach (const CANFltObserver filt, mBusData[i].mTargettedFrames)
+    for (int i = 0; i < mBusData.count(); i++) {
+        QVector<CANFltObserver> &targets = mBusData[i].mTargettedFrames;
+        for (int j = targets.count() - 1; j >= 0; j--)
         {
-            if (filt.observer == receiver) mBusData[i].mTargettedFrames.removeOne(filt);
+            if (targets[j].observer == receiver) targets.remove(j);
         }
     }
+    rebuildTargets();
+
+    //this is usually called on the way out of the receiver's destructor so don't deliver anything else to it
+    QMutexLocker lock(&mTargetLock);
+    mPendingTargets.remove(receiver);
 
     return true;
 }
 
+//Compile the filter lists into lookup tables. The reading thread swaps the new tables in on its next frame so the
+//lists themselves are never touched from there.
+void CANConnection::rebuildTargets()
+{
+    QSharedPointer<QVector<TargetDispatch>> tables(new QVector<TargetDispatch>(mBusData.count()));
+    const quint32 allIDBits = 0x1FFFFFFF;
+
+    for (int bus = 0; bus < mBusData.count(); bus++)
+    {
+        TargetDispatch &dispatch = (*tables)[bus];
+        foreach (const CANFltObserver &filt, mBusData[bus].mTargettedFrames)
+        {
+            CANFrameReactor *reactor = qobject_cast<CANFrameReactor*>(filt.observer);
+            if (reactor) dispatch.reactors.insert(filt.observer, reactor);
+            if (filt.id & ~filt.mask) continue; //wants bits the mask throws away so it can never match
+            if ((filt.mask & allIDBits) == allIDBits)
+            {
+                QVector<QObject*> &observers = dispatch.exact[filt.id];
+                if (!observers.contains(filt.observer)) observers.append(filt.observer);
+            }
+            else if ((filt.mask & allIDBits) == 0)
+            {
+                if (!dispatch.all.contains(filt.observer)) dispatch.all.append(filt.observer);
+            }
+            else
+            {
+                int b = 0;
+                while (b < dispatch.masked.count() && dispatch.masked[b].mask != filt.mask) b++;
+                if (b == dispatch.masked.count())
+                {
+                    TargetBucket bucket;
+                    bucket.mask = filt.mask;
+                    dispatch.masked.append(bucket);
+                }
+                QVector<QObject*> &observers = dispatch.masked[b].ids[filt.id];
+                if (!observers.contains(filt.observer)) observers.append(filt.observer);
+            }
+        }
+    }
+
+    {
+        QMutexLocker lock(&mTargetLock);
+        mNewTargets = tables;
+        mTargetsChanged.storeRelease(1);
+    }
+
+    //hardware filtering has to keep letting the targetted frames through
+    for (int bus = 0; bus < mAcceptanceFilters.count(); bus++)
+    {
+        if (!mAcceptanceFilters[bus].isEmpty()) setAcceptanceFilters(bus, mAcceptanceFilters[bus]);
+    }
+}
+
 void CANConnection::checkTargettedFrame(CANFrame &frame)
 {
-    unsigned int maskedID;
     //qDebug() << "Got frame with ID " << frame.ID << " on bus " << frame.bus;
-    if (mBusData.count() == 0) return;
+    //every received frame passes through here on the reading thread, which makes it the place to keep the live table
+    //and to bridge frames straight to another bus
+    int busBase = mBusBase.loadRelaxed();
+    LiveFrameTable::getReference()->update(frame, busBase);
+    mLoad.add(frame);
+    if (mGatewayChanged.loadAcquire())
+    {
+        QMutexLocker lock(&mTargetLock);
+        mGateway = mNewGateway;
+        mGatewayChanged.storeRelease(0);
+    }
+    if (mGateway && !mGateway->isEmpty()) mGateway->forward(frame, frame.bus + busBase, this);
+    if (mTargetsChanged.loadAcquire())
+    {
+        QMutexLocker lock(&mTargetLock);
+        mTargets = mNewTargets;
+        mTargetsChanged.storeRelease(0);
+    }
+    if (!mTargets || mTargets->isEmpty()) return;
 
     int bus = frame.bus;
-    if (bus > (mBusData.length() - 1)) bus = mBusData.length() - 1;
+    if (bus > (mTargets->count() - 1)) bus = mTargets->count() - 1;
+
+    const TargetDispatch &dispatch = mTargets->at(bus);
+    if (dispatch.isEmpty()) return;
+
+    //an observer with more than one matching filter still only gets the frame once
+    QVarLengthArray<QObject*, 8> matched;
+    auto addMatches = [&matched](const QVector<QObject*> &observers)
+    {
+        for (QObject *observer : observers)
+        {
+            if (std::find(matched.begin(), matched.end(), observer) == matched.end()) matched.append(observer);
+        }
+    };
+
+    quint32 id = frame.frameId();
+    if (!dispatch.exact.isEmpty())
+    {
+        auto it = dispatch.exact.constFind(id);
+        if (it != dispatch.exact.constEnd()) addMatches(it.value());
+    }
+    for (const TargetBucket &bucket : dispatch.masked)
+    {
+        auto it = bucket.ids.constFind(id & bucket.mask);
+        if (it != bucket.ids.constEnd()) addMatches(it.value());
+    }
+    addMatches(dispatch.all);
+
+    if (matched.isEmpty()) return;
+
+    //reactors get it now, everybody else at the next drain
+    if (!dispatch.reactors.isEmpty())
+    {
+        CANFrame global = frame;
+        global.bus += busBase;
+        for (int i = matched.count() - 1; i >= 0; i--)
+        {
+            CANFrameReactor *reactor = dispatch.reactors.value(matched[i], nullptr);
+            if (!reactor) continue;
+            reactor->reactToFrameFrom(global, this);
+            matched.remove(i);
+        }
+        if (matched.isEmpty()) return;
+    }
 
-    if (mBusData[bus].mTargettedFrames.length() == 0) return;
-    foreach (const CANFltObserver filt, mBusData[frame.bus].mTargettedFrames)
+    QMutexLocker lock(&mTargetLock);
+    for (QObject *observer : matched) mPendingTargets[observer].append(frame);
+}
+
+void CANConnection::deliverTargettedFrames(int pBusBase)
+{
+    QHash<QObject*, QVector<CANFrame>> pending;
     {
-        //qDebug() << "Checking filter with id " << filt.id << " mask " << filt.mask;
-        maskedID = frame.frameId() & filt.mask;
-        if (maskedID == filt.id) {
-            qDebug() << "In connection object I got a targetted frame. Forwarding it.";
-            QMetaObject::invokeMethod(filt.observer, "gotTargettedFrame",Qt::QueuedConnection, Q_ARG(CANFrame, frame));
+        QMutexLocker lock(&mTargetLock);
+        if (mPendingTargets.isEmpty()) return;
+        pending.swap(mPendingTargets);
+    }
+
+    for (auto it = pending.begin(); it != pending.end(); ++it)
+    {
+        QObject *observer = it.key();
+        //an earlier receiver in this loop may have dropped this one (or deleted it) from its slot
+        bool stillWanted = false;
+        for (int i = 0; i < mBusData.count() && !stillWanted; i++)
+        {
+            foreach (const CANFltObserver &filt, mBusData[i].mTargettedFrames)
+            {
+                if (filt.observer == observer)
+                {
+                    stillWanted = true;
+                    break;
+                }
+            }
+        }
+        if (!stillWanted) continue;
+
+        QVector<CANFrame> &frames = it.value();
+        for (CANFrame &frame : frames) frame.bus += pBusBase;
+
+        if (observer->metaObject()->indexOfMethod("gotTargettedFrames(QVector<CANFrame>)") >= 0)
+        {
+            QMetaObject::invokeMethod(observer, "gotTargettedFrames", Qt::DirectConnection, Q_ARG(QVector<CANFrame>, frames));
+        }
+        else
+        {
+            for (const CANFrame &frame : frames)
+                QMetaObject::invokeMethod(observer, "gotTargettedFrame", Qt::DirectConnection, Q_ARG(CANFrame, frame));
         }
     }
 }
 
+bool CANConnection::setAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters)
+{
+    /* make sure we execute in mThread context */
+    if( mThread_p && (mThread_p != QThread::currentThread()) ) {
+        bool ret;
+        QMetaObject::invokeMethod(this, "setAcceptanceFilters",
+                                  Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(bool, ret),
+                                  Q_ARG(int, pBusIdx),
+                                  Q_ARG(QVector<CANAcceptanceFilter>, pFilters));
+        return ret;
+    }
+
+    /* sanity checks */
+    if(pBusIdx < 0 || pBusIdx >= mBusData.count())
+        return false;
+
+    if (mAcceptanceFilters.count() < mBusData.count()) mAcceptanceFilters.resize(mBusData.count());
+    mAcceptanceFilters[pBusIdx] = pFilters;
+
+    QVector<CANAcceptanceFilter> merged = pFilters;
+    if (!merged.isEmpty())
+    {
+        foreach (const CANFltObserver &filt, mBusData[pBusIdx].mTargettedFrames)
+        {
+            CANAcceptanceFilter accept;
+            accept.id = filt.id;
+            accept.mask = filt.mask;
+            merged.append(accept);
+        }
+    }
+
+    return piSetAcceptanceFilters(pBusIdx, merged);
+}
+
+bool CANConnection::piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters)
+{
+    Q_UNUSED(pBusIdx)
+    return pFilters.isEmpty();
+}
+
+void CANConnection::piWriteTx(int pBusIdx, const QByteArray& pBytes)
+{
+    Q_UNUSED(pBusIdx)
+    Q_UNUSED(pBytes)
+}
+
 bool CANConnection::piSendFrames(const QList<CANFrame>& pFrames)
 {
     foreach(const CANFrame& frame, pFrames)
@@ -3,12 +3,66 @@
 
 #include <Qt>
 #include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
 #include "utils/lfqueue.h"
 #include "can_structs.h"
 #include "canbus.h"
+#include "busloadmeter.h"
 #include "canconconst.h"
+#include "cangateway.h"
+#include "debuglog.h"
 
 struct BusData;
+class QTimer;
+
+/* pending transmit bytes past this get written out without waiting for the flush deadline */
+#define CANCON_TX_FLUSH_BYTES   4096
+
+/* latency histogram buckets. Bucket i counts waits under 2^i microseconds, the last one everything longer */
+#define CANCON_LATENCY_BUCKETS  24
+
+/*
+ * What a connection has been doing since it was opened (or its telemetry was last reset). RX is counted where the
+ * frames leave the queue so it's what the rest of the program actually got.
+ */
+struct CANConTelemetry
+{
+    quint64 framesIn = 0;       //taken out of the queue and handed on
+    quint64 framesDropped = 0;  //thrown away because the queue was full
+    quint64 drains = 0;         //times the queue was emptied
+    int queueDepth = 0;         //waiting in the queue right now
+    int queueHighWater = 0;     //most that were ever waiting at once
+    int queueCapacity = 0;
+    int largestBatch = 0;
+    quint64 framesSent = 0;
+    int txPendingBytes = 0;     //encoded and waiting for the flush deadline
+    qint64 txBacklogBytes = -1; //written but still sitting in the OS or driver. -1 if the device can't tell
+    //time from the first frame of a batch being queued until every framesReceived listener had the batch
+    QVector<quint64> latency = QVector<quint64>(CANCON_LATENCY_BUCKETS, 0);
+
+    void merge(const CANConTelemetry &other);
+    qint64 latencyPercentile(double pFraction) const; //upper edge of the bucket holding that fraction, in us
+};
+
+/*
+ * A targetted frame receiver that also implements this (and says so with Q_INTERFACES) doesn't wait for the next
+ * drain. reactToFrame is called straight from the connection's reading thread the moment a frame matches one of
+ * its filters, so it has to be quick and thread safe. The frame's bus is already the global bus number.
+ */
+class CANConnection;
+class CANFrameReactor
+{
+public:
+    virtual ~CANFrameReactor() {}
+    virtual void reactToFrame(const CANFrame &pFrame) = 0;
+    //the same with the connection the frame came in on, for reactors that answer straight back out of it
+    virtual void reactToFrameFrom(const CANFrame &pFrame, CANConnection *pFrom) { Q_UNUSED(pFrom); reactToFrame(pFrame); }
+};
+#define CANFrameReactor_iid "SavvyCAN.CANFrameReactor"
+Q_DECLARE_INTERFACE(CANFrameReactor, CANFrameReactor_iid)
 
 class CANConnection : public QObject
 {
@@ -25,7 +79,8 @@ protected:
      * @param pBusSpeed: set an initial speed when opening this connection
      * @param pNumBuses: the number of buses the device has
      * @param pQueueLen: the length of the lock free queue to use
-     * @param pUseThread: if set to true, object will be execute in a dedicated thread
+     * @param pUseThread: if set to true, object will be execute in a dedicated thread (or a shared worker thread
+     * when Main/ConnectionThreads is set, see CANConWorkers)
      */
     CANConnection(QString pPort,
                   QString pDriver,
@@ -71,6 +126,60 @@ public:
      */
     LFQueue<CANFrame>& getQueue();
 
+    /**
+     * @brief resetFramesQueued
+     * @note called by the reader right before it drains the queue. The next frame queued after this emits framesQueued again
+     */
+    void resetFramesQueued();
+
+    /**
+     * @brief queuedSince
+     * @return steady clock time in ns of the wakeup that is pending, 0 if none is
+     * @note read by the reader before resetFramesQueued
+     */
+    qint64 queuedSince();
+
+    /**
+     * @brief noteDrain records one drain of the queue in the telemetry
+     * @param pFrames: how many frames were taken out
+     * @param pDepth: how many were waiting when it started
+     * @param pQueuedNs: queuedSince() from before the drain, 0 if unknown. The latency runs from then until now so
+     * call this once the listeners are done with the frames
+     * @note called by the reader, from its own thread
+     */
+    void noteDrain(int pFrames, int pDepth, qint64 pQueuedNs);
+
+    /**
+     * @brief getTelemetry
+     * @return counters since the connection was opened or resetTelemetry. Call from the reader's thread
+     */
+    CANConTelemetry getTelemetry();
+
+    /**
+     * @brief resetTelemetry starts all counters from zero. Call from the reader's thread
+     */
+    void resetTelemetry();
+
+    /**
+     * @brief getBusLoad
+     * @param pBusIdx: local bus number
+     * @return utilization of the bus from the frames seen on it, see BusLoadMeter. Call from the GUI thread
+     */
+    CANBusLoad getBusLoad(int pBusIdx) const;
+
+    /**
+     * @brief getBusTimePs
+     * @param pFrame: frame with its local bus number
+     * @return how long the frame keeps its bus busy in ps, 0 if the bus has no bit rate set. Any thread
+     */
+    quint64 getBusTimePs(const CANFrame& pFrame) const;
+
+    /**
+     * @brief sampleBusLoad turns the bus time counted since the last call into load figures
+     * @note called by CANConManager every BUSLOAD_SAMPLE_MS, GUI thread
+     */
+    void sampleBusLoad();
+
     /**
      * @brief getType
      * @return the @ref CANCon::type of the device
@@ -89,6 +198,12 @@ public:
      */
     void setConsoleOutput(bool state);
 
+    /**
+     * @brief what the connection has to say to the debug console. The connection window turns capturing on for the
+     * connection it is showing and drains it from the GUI thread
+     */
+    DebugLog& getDebugLog() { return mDebugLog; }
+
 
 signals:
     /*not implemented yet */
@@ -113,10 +228,10 @@ signals:
     void status(CANConStatus pStatus);
 
     /**
-      * @brief Event sent when device has done something worthy of debugging output.
-      * @param debugString: String based output to show for debugging purposes
-      */
-    void debugOutput(QString debugString);
+     * @brief emitted from the thread that queued the frame when the queue goes from drained to having frames in it.
+     * Only fires once until the reader calls resetFramesQueued so a busy bus doesn't flood anyone with events
+     */
+    void framesQueued();
 
 public slots:
 
@@ -170,7 +285,7 @@ public slots:
      * @brief provides device with a list of frames to send
      * @param pFrame: the list of frames to send
      * @return false if parameter is invalid (bus id for instance)
-     * @note this calls piSendFrameBatch (in the working thread context if one has been started)
+     * @note this calls piSendFrames (in the working thread context if one has been started)
      */
     bool sendFrames(const QList<CANFrame>& pFrames);
 
@@ -201,6 +316,45 @@ public slots:
      */
     bool removeAllTargettedFrames(QObject *receiver);
 
+    /**
+     * @brief Hands every targetted frame matched since the last call to its receiver. Called once per drain cycle
+     * from the thread the receivers live in. A receiver with a gotTargettedFrames(const QVector<CANFrame>&) slot gets
+     * one call with the whole batch, otherwise gotTargettedFrame is called directly for each frame.
+     * @param pBusBase - added to the bus of each frame to turn local bus numbers into system wide ones
+     */
+    void deliverTargettedFrames(int pBusBase);
+
+    /**
+     * @brief Ask the device to only pass matching frames on a bus so the rest never have to cross the serial or USB
+     * link. Targetted frame filters registered on the bus are merged in so those keep working.
+     * @param pBusIdx - local bus number
+     * @param pFilters - frames to accept. Empty accepts everything again
+     * @return true if the device is filtering in hardware, false if it can't express the filters (or has no
+     * filtering at all) and everything still gets passed through
+     */
+    bool setAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters);
+
+    /**
+     * @brief the transmit half of the telemetry. It's owned by the working thread so it's read there
+     * @param pTelemetry: framesSent, txPendingBytes and txBacklogBytes are filled in
+     * @param pReset: start framesSent from zero again afterwards
+     */
+    void getTxTelemetry(CANConTelemetry& pTelemetry, bool pReset);
+
+    //global number of this connection's first bus, kept up to date by CANConManager. Reactors get global numbers
+    void setBusBase(int pBusBase);
+    int getBusBase() const { return mBusBase.loadRelaxed(); }
+
+    //bridge routes from CANConManager::setGatewayRoutes. The reading thread picks them up on its next frame
+    void setGateway(QSharedPointer<CANGatewayTable> pTable);
+
+    /**
+     * @brief bytes written but not yet out of the OS or driver, so a sender can hold back instead of piling on more
+     * @return -1 if the device can't tell
+     * @note runs in the working thread, so polling it is a thread hop each time
+     */
+    qint64 getTxBacklog();
+
     void debugInput(QByteArray bytes);
 
 protected:
@@ -209,15 +363,59 @@ protected:
     bool mConsoleOutput; //send debugging info to the console?
     int mSerialSpeed;
 
-    //determine if the passed frame is part of a filter or not.
+    /**
+     * @brief debugOutput puts text on the debug console, if the console is looking at this connection
+     * @note any thread. Never blocks, it's dropped when the console can't keep up
+     */
+    void debugOutput(const QString &debugString);
+    //raw bytes to or from the device. Only turned into hex if the console gets around to showing them
+    void debugBytes(DebugKind pKind, const QByteArray &pBytes);
+    //worth building a debug message at all?
+    bool debugCapturing() const { return mDebugLog.isCapturing(); }
+
+    //determine if the passed frame is part of a filter or not. Matches are held until deliverTargettedFrames.
+    //Every received frame comes through here so it's also where the live frame table and the gateway are fed
     void checkTargettedFrame(CANFrame &frame);
 
+    /**
+     * @brief notifyFramesQueued
+     * @note call after getQueue().queue(). Cheap when a wakeup is already pending so calling it for every frame is fine
+     */
+    void notifyFramesQueued();
+
+    /**
+     * @brief fillPayload
+     * @param frame: a queue slot being filled in
+     * @param pData: len bytes of payload
+     * @note reuses the payload buffer the slot already has. Only allocates if it's still shared with an old copy
+     */
+    static void fillPayload(CANFrame &frame, const void *pData, int len);
+
     /**
      * @brief setStatus
      * @param pStatus: the status to set
      */
     void setStatus(CANCon::status pStatus);
 
+    /**
+     * @brief setTxEcho
+     * @param pEcho: false if the device hands sent frames back itself so sendFrame(s) shouldn't queue a copy
+     * @note the copy is queued from the sending thread. Turn it off if the queue is fed from a thread of its own
+     */
+    void setTxEcho(bool pEcho);
+
+    /*
+     * Coalesced transmit for devices that talk over a byte stream. piSendFrame encodes the frame onto the end of
+     * txBuffer(bus) and calls txQueued(). The bytes go out through piWriteTx, one write for everything pending on
+     * that bus:
+     * - from sendFrames, once after the whole list has been encoded
+     * - from sendFrame, right away when the flush deadline (Main/TXFlushDeadline, ms) is 0, otherwise when the
+     *   deadline runs out or CANCON_TX_FLUSH_BYTES have built up, whichever is first
+     */
+    QByteArray &txBuffer(int pBusIdx = 0);
+    void txQueued();
+    void flushTx();
+
     /**
      * @brief isConfigured
      * @param pBusId
@@ -314,15 +512,89 @@ protected:
      */
     virtual bool piSendFrames(const QList<CANFrame>&);
 
+    /**
+     * @brief programs the device acceptance filters
+     * @param pBusIdx: the index of the bus to filter
+     * @param pFilters: frames to accept, empty to accept everything
+     * @return true if the device now filters exactly (or more loosely than) the list, false if it can't
+     * @note implementing this function is optional. The default can only accept everything
+     */
+    virtual bool piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters);
+
+    /**
+     * @brief writes out bytes collected in txBuffer()
+     * @param pBusIdx: the bus the bytes were collected for
+     * @param pBytes: everything encoded since the last flush
+     * @note only needed by devices that use txBuffer(). The default drops the bytes
+     */
+    virtual void piWriteTx(int pBusIdx, const QByteArray& pBytes);
+
+    /**
+     * @brief bytes handed to the OS or driver that it hasn't sent yet
+     * @return the number of bytes, -1 if the device has no way to tell
+     * @note implementing this function is optional
+     */
+    virtual qint64 piTxBacklog();
+
 private:
+    void echoTxFrame(const CANFrame& pFrame);
+
+    /*
+     * The targetted frame filters of one bus compiled down for quick matching. A filter matches when
+     * (ID & mask) == id so filters are grouped by mask and each group is a hash on id. Filters whose mask covers the
+     * whole ID are the common case and get a plain hash, mask 0 filters match everything. A frame costs one hash
+     * lookup per distinct mask instead of a compare per filter.
+     */
+    struct TargetBucket
+    {
+        quint32 mask;
+        QHash<quint32, QVector<QObject*>> ids;
+    };
+
+    struct TargetDispatch
+    {
+        QHash<quint32, QVector<QObject*>> exact;
+        QVector<TargetBucket> masked;
+        QVector<QObject*> all;
+        QHash<QObject*, CANFrameReactor*> reactors; //observers on this bus that want frames right away
+        bool isEmpty() const { return exact.isEmpty() && masked.isEmpty() && all.isEmpty(); }
+    };
+
+    void rebuildTargets();
+
+    QSharedPointer<const QVector<TargetDispatch>> mTargets; //what checkTargettedFrame uses. Only touched by the reading thread
+    QSharedPointer<const QVector<TargetDispatch>> mNewTargets; //set by rebuildTargets, picked up on the next frame
+    QAtomicInt          mTargetsChanged;
+    QSharedPointer<CANGatewayTable> mGateway; //reading thread only
+    QSharedPointer<CANGatewayTable> mNewGateway; //set by setGateway, guarded by mTargetLock
+    QAtomicInt          mGatewayChanged;
+    QAtomicInt          mBusBase;
+    QHash<QObject*, QVector<CANFrame>> mPendingTargets; //matched but not delivered yet
+    QMutex              mTargetLock; //guards mNewTargets, mNewGateway and mPendingTargets
+    QVector<QVector<CANAcceptanceFilter>> mAcceptanceFilters; //what was asked for per bus, before the targets go in
+    DebugLog            mDebugLog;
+    QVector<QByteArray> mTxPending; //encoded but not written yet, per bus
+    QTimer*             mTxTimer_p; //flush deadline. Created on first use so it lives in the working thread
+    int                 mTxDeadline;
+    bool                mTxHold; //set while sendFrames is encoding so each frame doesn't flush on its own
+    bool                mTxEcho;
+    quint64             mTxFrames; //working thread
+    CANConTelemetry     mTelemetry; //RX side, reader thread
+    BusLoadMeter        mLoad; //fed by the reading thread and TX echo, sampled by the GUI thread
+    quint32             mDroppedBase; //queue drop count at the last reset
+    QAtomicInteger<qint64> mWakeNs;
+
     LFQueue<CANFrame>   mQueue;
     const QString       mPort;
     const QString       mDriver;
     const CANCon::type  mType;
     bool                mIsCapSuspended;
     QAtomicInt          mStatus;
+    QAtomicInt          mWakePending; //1 once framesQueued has been emitted and the reader hasn't drained yet
     bool                mStarted;
     QThread*            mThread_p;
+    QThread*            mPoolThread_p; //shared worker from CANConWorkers. mThread_p is only set to it while started
+    QThread*            mHomeThread_p; //where a pooled connection goes back to once stopped
 };
 
 #endif // CANCONNECTION_H
@@ -89,6 +89,11 @@ QVariant CANConnectionModel::data(const QModelIndex &index, int role) const
                         case CANCon::LAWICEL: return "LAWICEL";
                         case CANCon::CANSERVER: return "CANserver";
                         case CANCon::CANLOGSERVER: return "CanLogServer";
+                        case CANCon::SOCKETCAN: return "SocketCAN";
+                        case CANCon::GENERATOR: return "Generator";
+                        case CANCon::LOGREPLAY: return "Log Replay";
+                        case CANCon::CAPTURE_LINK: return "Capture Link";
+                        case CANCon::SHARED_CAPTURE: return "Shared Capture";
                         default: {}
                     }
                 else qDebug() << "Tried to show connection type but connection was nullptr";
@@ -104,7 +109,15 @@ QVariant CANConnectionModel::data(const QModelIndex &index, int role) const
                 return conn_p->getNumBuses();
                 break;
             case Column::Status:
-                 return (conn_p->getStatus()==CANCon::CONNECTED) ? "Connected" : "Not Connected";
+                switch (conn_p->getStatus())
+                {
+                case CANCon::CONNECTED:
+                    return "Connected";
+                case CANCon::CONNECTING:
+                    return "Connecting...";
+                default:
+                    return "Not Connected";
+                }
         }
     }
     return QVariant();
@@ -0,0 +1,51 @@
+#include <QDebug>
+#include <QSettings>
+
+#include "canconworkers.h"
+
+QMutex CANConWorkers::mLock;
+QVector<CANConWorkers::Worker> CANConWorkers::mWorkers;
+
+QThread *CANConWorkers::acquire()
+{
+    QSettings settings;
+    int want = qMin(settings.value("Main/ConnectionThreads", 0).toInt(), CANCONWORKERS_MAX_THREADS);
+    if (want <= 0) return nullptr;
+
+    QMutexLocker locker(&mLock);
+    int best = -1;
+    for (int i = 0; i < mWorkers.count() && i < want; i++)
+    {
+        if (best < 0 || mWorkers[i].users < mWorkers[best].users) best = i;
+    }
+    //another thread is only worth it while every one there is already has something
+    if (best < 0 || (mWorkers[best].users > 0 && mWorkers.count() < want))
+    {
+        Worker worker;
+        worker.thread = new QThread();
+        worker.thread->setObjectName(QString("CANConWorker%1").arg(mWorkers.count()));
+        worker.thread->start(QThread::HighPriority);
+        worker.users = 0;
+        mWorkers.append(worker);
+        best = mWorkers.count() - 1;
+        qDebug() << "Started connection worker thread" << best;
+    }
+    mWorkers[best].users++;
+    return mWorkers[best].thread;
+}
+
+void CANConWorkers::release(QThread *pThread)
+{
+    if (!pThread) return;
+    QMutexLocker locker(&mLock);
+    for (int i = 0; i < mWorkers.count(); i++)
+    {
+        if (mWorkers[i].thread != pThread) continue;
+        if (--mWorkers[i].users > 0) return;
+        pThread->quit();
+        pThread->wait();
+        delete pThread;
+        mWorkers.remove(i);
+        return;
+    }
+}
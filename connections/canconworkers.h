@@ -0,0 +1,39 @@
+#ifndef CANCONWORKERS_H
+#define CANCONWORKERS_H
+
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+//connections per worker thread aren't capped, this is just how many threads there can be at most
+#define CANCONWORKERS_MAX_THREADS   16
+
+/*
+ * Worker threads shared between connections. With Main/ConnectionThreads at 0 (the default) every threaded
+ * connection keeps a thread of its own. Set to N, connections are spread over at most N threads instead, each new
+ * one going to the thread with the fewest. A thread's event loop already waits on all the serial ports, sockets and
+ * timers that live in it at once, so a handful of threads carry a rack of connections and only wake when one of
+ * them has something to do. Each connection still only ever runs on its own thread so nothing in the drivers
+ * changes.
+ *
+ * Threads start when they get their first connection and finish when they lose the last one.
+ */
+class CANConWorkers
+{
+public:
+    //a running thread to use or nullptr if connections are to have their own
+    static QThread *acquire();
+    static void release(QThread *pThread);
+
+private:
+    struct Worker
+    {
+        QThread *thread;
+        int users;
+    };
+
+    static QMutex mLock;
+    static QVector<Worker> mWorkers;
+};
+
+#endif // CANCONWORKERS_H
@@ -0,0 +1,426 @@
+#include "cangateway.h"
+#include "canconnection.h"
+#include "modifierprogram.h"
+#include "dbc/dbchandler.h"
+#include "utility.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+static inline quint64 steadyUs()
+{
+    return static_cast<quint64>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static inline quint64 steadyNs()
+{
+    return static_cast<quint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static inline void storeMax(QAtomicInteger<quint64> &max, quint64 value)
+{
+    quint64 current = max.loadRelaxed();
+    while (value > current && !max.testAndSetRelaxed(current, value, current)) {}
+}
+
+//a route back out the same connection sends right there, anything else is posted to the other connection's thread
+static bool sendOut(CANConnection *pTo, CANConnection *pFrom, const CANFrame &pFrame)
+{
+    if (pTo == pFrom) return pFrom->sendFrame(pFrame);
+    return QMetaObject::invokeMethod(pTo, "sendFrame", Qt::QueuedConnection, Q_ARG(CANFrame, pFrame));
+}
+
+/*
+ * One rule per line, words split on spaces and case doesn't matter except in signal names:
+ *   0x123 drop
+ *   0x200 rewrite D0=D0+1,D7=CRC8
+ *   0x200 delay 500
+ *   0x300 if Speed=0 inject 0x7DF 02 01 0D
+ *   * pass
+ * "if" takes a signal of the rule's ID, on its own it only has to be in the frame (for multiplexed signals) and
+ * with =value it has to decode to that value.
+ */
+bool CANGatewayRule::parse(const QString &line, CANGatewayRule &rule, QString &error)
+{
+    QStringList words = line.simplified().split(' ', Qt::SkipEmptyParts);
+    rule = CANGatewayRule();
+    rule.text = line.trimmed();
+    if (words.count() < 2)
+    {
+        error = "Expected an ID and an action";
+        return false;
+    }
+
+    int word = 0;
+    if (words[word] != "*")
+    {
+        rule.id = static_cast<int>(Utility::ParseStringToNum(words[word]));
+        if (rule.id < 0 || static_cast<uint32_t>(rule.id) > 0x1FFFFFFF)
+        {
+            error = "Bad ID " + words[word];
+            return false;
+        }
+    }
+    word++;
+
+    if (words[word].toUpper() == "IF")
+    {
+        if (rule.id < 0 || word + 1 >= words.count())
+        {
+            error = "Conditions need an exact ID and a signal";
+            return false;
+        }
+        QStringList sig = words[word + 1].split('=');
+        rule.condition.sigName = sig[0];
+        rule.condition.triggerMask = TriggerMask::TRG_SIGNAL;
+        if (sig.count() > 1)
+        {
+            bool ok;
+            rule.condition.sigValueDbl = sig[1].toDouble(&ok);
+            if (!ok)
+            {
+                error = "Bad signal value " + sig[1];
+                return false;
+            }
+            rule.condition.triggerMask |= TriggerMask::TRG_SIGVAL;
+        }
+        word += 2;
+        if (word >= words.count())
+        {
+            error = "Expected an action";
+            return false;
+        }
+    }
+
+    QString action = words[word++].toUpper();
+    if (action == "PASS") rule.action = PASS;
+    else if (action == "DROP") rule.action = DROP;
+    else if (action == "REWRITE")
+    {
+        rule.action = REWRITE;
+        rule.modifiers = ModifierProgram::parse(words.mid(word).join(""));
+        if (rule.modifiers.isEmpty())
+        {
+            error = "Rewrite needs modifiers";
+            return false;
+        }
+        word = words.count();
+    }
+    else if (action == "DELAY")
+    {
+        rule.action = DELAY;
+        bool ok = false;
+        if (word < words.count()) rule.delayUs = words[word++].toUInt(&ok);
+        if (!ok || !rule.delayUs)
+        {
+            error = "Delay needs a number of microseconds";
+            return false;
+        }
+    }
+    else if (action == "INJECT")
+    {
+        rule.action = INJECT;
+        if (word >= words.count())
+        {
+            error = "Inject needs an ID";
+            return false;
+        }
+        uint32_t injectId = Utility::ParseStringToNum(words[word++]);
+        QByteArray bytes;
+        while (word < words.count() && bytes.length() < 64)
+        {
+            bool ok;
+            uint value = words[word++].toUInt(&ok, 16);
+            if (!ok || value > 0xFF)
+            {
+                error = "Bad data byte " + words[word - 1];
+                return false;
+            }
+            bytes.append(static_cast<char>(value));
+        }
+        rule.inject.setFrameId(injectId);
+        rule.inject.setExtendedFrameFormat(injectId > 0x7FF);
+        rule.inject.setPayload(bytes);
+        rule.inject.isReceived = false;
+    }
+    else
+    {
+        error = "Unknown action " + action;
+        return false;
+    }
+
+    if (word < words.count())
+    {
+        error = "Unexpected " + words[word];
+        return false;
+    }
+    return true;
+}
+
+void CANGatewayTable::compileRules(Route &route, const QVector<QSharedPointer<CANGatewayRuleCounters>> &pCounters)
+{
+    DBCHandler *dbcHandler = DBCHandler::getReference();
+    for (int r = 0; r < route.config.rules.count(); r++)
+    {
+        const CANGatewayRule &config = route.config.rules[r];
+        Rule rule;
+        rule.action = config.action;
+        rule.sig = nullptr;
+        rule.matchValue = (config.condition.triggerMask & TriggerMask::TRG_SIGVAL) != 0;
+        rule.value = config.condition.sigValueDbl;
+        rule.delayUs = config.delayUs;
+        rule.inject = config.inject;
+        rule.counters = pCounters.value(r);
+        if (!rule.counters) rule.counters.reset(new CANGatewayRuleCounters);
+        rule.runs = 0;
+
+        if (config.condition.triggerMask & TriggerMask::TRG_SIGNAL)
+        {
+            DBC_MESSAGE *msg = dbcHandler->findMessage(static_cast<uint32_t>(config.id));
+            rule.sig = msg ? msg->sigHandler->findSignalByName(config.condition.sigName) : nullptr;
+            if (!rule.sig) continue; //can never pass
+        }
+        if (config.action == CANGatewayRule::REWRITE)
+        {
+            FrameSendData record;
+            record.setFrameId(config.id < 0 ? 0 : static_cast<uint32_t>(config.id));
+            record.modifiers = config.modifiers;
+            rule.program = ModifierProgram::compile(record, *frames);
+        }
+
+        if (config.id < 0) route.rulesAnyId.append(rule);
+        else route.rulesById[static_cast<uint32_t>(config.id)].append(rule);
+    }
+}
+
+bool CANGatewayTable::checkCondition(const Rule &rule, const CANFrame &frame) const
+{
+    if (!rule.sig) return true;
+    if (!rule.sig->isSignalInMessage(frame)) return false;
+    if (!rule.matchValue) return true;
+    double sigval = 0.0;
+    int32_t muxValue;
+    const QByteArray payload = frame.payload();
+    if (!rule.sig->decodeValue(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length(), sigval, muxValue))
+        return false;
+    return fabs(sigval - rule.value) <= 0.001;
+}
+
+bool CANGatewayTable::runRules(Route &route, CANFrame &pOut, quint32 &pDelayUs, CANConnection *pFrom)
+{
+    //a DBC change leaves signal lookups pointing at old definitions until CANConManager compiles the table again
+    bool dbcCurrent = (dbcRevision == DBCHandler::getRevision());
+    QVector<Rule> *lists[2] = { nullptr, &route.rulesAnyId };
+    QHash<uint32_t, QVector<Rule>>::iterator byId = route.rulesById.find(pOut.frameId());
+    if (byId != route.rulesById.end()) lists[0] = &byId.value();
+
+    for (QVector<Rule> *list : lists)
+    {
+        if (!list) continue;
+        for (Rule &rule : *list)
+        {
+            if (rule.sig && (!dbcCurrent || !checkCondition(rule, pOut))) continue;
+
+            quint64 started = steadyNs();
+            bool stop = false;
+            bool keep = true;
+            switch (rule.action)
+            {
+            case CANGatewayRule::PASS:
+                stop = true;
+                break;
+            case CANGatewayRule::DROP:
+                stop = true;
+                keep = false;
+                route.counters->dropped.fetchAndAddRelaxed(1);
+                break;
+            case CANGatewayRule::REWRITE:
+                if (!rule.program || (rule.program->needsDbc() && !dbcCurrent))
+                {
+                    rule.counters->skipped.fetchAndAddRelaxed(1);
+                    break;
+                }
+                {
+                    FrameSendData record;
+                    static_cast<CANFrame &>(record) = pOut;
+                    record.count = rule.runs++;
+                    rule.program->run(record);
+                    pOut.setPayload(record.payload());
+                }
+                break;
+            case CANGatewayRule::DELAY:
+                pDelayUs = std::max(pDelayUs, rule.delayUs);
+                break;
+            case CANGatewayRule::INJECT:
+                if (route.to)
+                {
+                    CANFrame inject = rule.inject;
+                    inject.bus = route.toLocalBus;
+                    if (sendOut(route.to, pFrom, inject)) route.counters->injected.fetchAndAddRelaxed(1);
+                    else route.counters->failed.fetchAndAddRelaxed(1);
+                }
+                else route.counters->failed.fetchAndAddRelaxed(1);
+                break;
+            }
+
+            quint64 spent = steadyNs() - started;
+            rule.counters->hits.fetchAndAddRelaxed(1);
+            rule.counters->totalNs.fetchAndAddRelaxed(spent);
+            storeMax(rule.counters->maxNs, spent);
+            if (stop) return keep;
+        }
+    }
+    return true;
+}
+
+void CANGatewayTable::forward(const CANFrame& pFrame, int pBus, CANConnection *pFrom)
+{
+    uint32_t id = pFrame.frameId();
+    for (Route &route : routes)
+    {
+        if (route.config.fromBus != pBus) continue;
+        if (route.config.blocked.contains(id))
+        {
+            route.counters->blocked.fetchAndAddRelaxed(1);
+            continue;
+        }
+
+        CANFrame out = pFrame;
+        quint32 delayUs = 0;
+        if (!route.rulesById.isEmpty() || !route.rulesAnyId.isEmpty())
+        {
+            if (!runRules(route, out, delayUs, pFrom)) continue;
+        }
+
+        quint32 interval = route.config.minIntervalUs.value(id, route.config.defaultMinIntervalUs);
+        if (interval)
+        {
+            quint64 now = steadyUs();
+            quint64 &last = route.lastSentUs[id];
+            if (last && now - last < interval)
+            {
+                route.counters->rateLimited.fetchAndAddRelaxed(1);
+                continue;
+            }
+            last = now;
+        }
+
+        if (!route.to)
+        {
+            route.counters->failed.fetchAndAddRelaxed(1);
+            continue;
+        }
+
+        out.bus = route.toLocalBus;
+        out.isReceived = false;
+        QHash<uint32_t, uint32_t>::const_iterator remapped = route.config.remap.constFind(id);
+        if (remapped != route.config.remap.constEnd())
+        {
+            out.setFrameId(remapped.value());
+            if (remapped.value() > 0x7FF) out.setExtendedFrameFormat(true);
+        }
+
+        if (delayUs)
+        {
+            route.counters->delayed.fetchAndAddRelaxed(1);
+            CANGatewayDelayLine::getReference()->schedule(steadyUs() + delayUs, route.to, out, route.counters);
+            continue;
+        }
+
+        if (sendOut(route.to, pFrom, out)) route.counters->forwarded.fetchAndAddRelaxed(1);
+        else route.counters->failed.fetchAndAddRelaxed(1);
+    }
+}
+
+//made the first time anyone wants it, lives as long as the program does
+CANGatewayDelayLine *CANGatewayDelayLine::getReference()
+{
+    static CANGatewayDelayLine line;
+    return &line;
+}
+
+CANGatewayDelayLine::CANGatewayDelayLine()
+{
+}
+
+CANGatewayDelayLine::~CANGatewayDelayLine()
+{
+    if (!thread) return;
+    lock.lock();
+    stopping = true;
+    wake.wakeAll();
+    lock.unlock();
+    thread->wait();
+    delete thread;
+}
+
+void CANGatewayDelayLine::schedule(quint64 pDueUs, CANConnection *pTo, const CANFrame &pFrame, const QSharedPointer<CANGatewayCounters> &pCounters)
+{
+    QMutexLocker locker(&lock);
+    if (!thread)
+    {
+        thread = QThread::create([this]{ run(); });
+        thread->start(QThread::TimeCriticalPriority);
+    }
+    Entry entry;
+    entry.dueUs = pDueUs;
+    entry.order = nextOrder++;
+    entry.to = pTo;
+    entry.frame = pFrame;
+    entry.counters = pCounters;
+    heap.push_back(entry);
+    std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    if (heap.front().order == entry.order) wake.wakeAll(); //new soonest, the thread might be sleeping past it
+}
+
+void CANGatewayDelayLine::forget(CANConnection *pConn)
+{
+    QMutexLocker locker(&lock);
+    heap.erase(std::remove_if(heap.begin(), heap.end(), [pConn](const Entry &entry) { return entry.to == pConn; }), heap.end());
+    std::make_heap(heap.begin(), heap.end(), std::greater<Entry>());
+}
+
+/*
+ * Frames are posted with the lock held so forget() can't return while one is still on its way to a connection
+ * that's about to be deleted.
+ */
+void CANGatewayDelayLine::run()
+{
+    QMutexLocker locker(&lock);
+    while (!stopping)
+    {
+        if (heap.empty())
+        {
+            wake.wait(&lock);
+            continue;
+        }
+        quint64 now = steadyUs();
+        quint64 due = heap.front().dueUs;
+        if (due > now)
+        {
+            //sleep to within a millisecond or so and spin the rest, sleeps aren't that accurate
+            if (due - now > 2000) wake.wait(&lock, static_cast<unsigned long>((due - now) / 1000 - 1));
+            else
+            {
+                locker.unlock();
+                QThread::yieldCurrentThread();
+                locker.relock();
+            }
+            continue;
+        }
+
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        Entry entry = heap.back();
+        heap.pop_back();
+        storeMax(entry.counters->delayLateMaxUs, now - entry.dueUs);
+        if (QMetaObject::invokeMethod(entry.to, "sendFrame", Qt::QueuedConnection, Q_ARG(CANFrame, entry.frame)))
+            entry.counters->forwarded.fetchAndAddRelaxed(1);
+        else entry.counters->failed.fetchAndAddRelaxed(1);
+    }
+}
@@ -0,0 +1,179 @@
+#ifndef CANGATEWAY_H
+#define CANGATEWAY_H
+
+#include <QAtomicInteger>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <vector>
+#include "can_structs.h"
+#include "can_trigger_structs.h"
+
+class CANConnection;
+class DBC_SIGNAL;
+class DBCMessageHandler;
+class LastFrameTable;
+class ModifierProgram;
+
+/*
+ * One line of a route's rules, see parse() for the text form. Rules for an exact ID are looked at before the ones
+ * for any ID, each lot in the order they were given. Pass and drop end the lookup, the others carry on to the next
+ * rule so a frame can be rewritten and then delayed. A frame no rule stopped is forwarded.
+ */
+struct CANGatewayRule
+{
+    enum Action
+    {
+        PASS,
+        DROP,
+        REWRITE, //modifiers run on the forwarded copy, same syntax as the frame sender
+        DELAY, //forwarded delayUs later instead of right away
+        INJECT //the inject frame goes out the route's destination as well
+    };
+
+    int id = -1; //-1 for any ID
+    Trigger condition; //only TRG_SIGNAL / TRG_SIGVAL with sigName and sigValueDbl are looked at, against the DBC of id
+    Action action = PASS;
+    QList<Modifier> modifiers;
+    quint32 delayUs = 0;
+    CANFrame inject;
+    QString text; //the line it came from
+
+    CANGatewayRule() { condition.triggerMask = 0; condition.sigValueDbl = 0.0; }
+    //"<ID|*> [if <signal>[=<value>]] <pass|drop|rewrite <modifiers>|delay <us>|inject <ID> <bytes>>"
+    static bool parse(const QString &line, CANGatewayRule &rule, QString &error);
+};
+
+struct CANGatewayRuleCounters
+{
+    QAtomicInteger<quint64> hits;
+    QAtomicInteger<quint64> totalNs; //time spent in the rule, for the average
+    QAtomicInteger<quint64> maxNs;
+    QAtomicInteger<quint64> skipped; //rewrites not run because the DBC changed under them
+};
+
+//one direction of a bridge. Buses are global bus numbers
+struct CANGatewayRoute
+{
+    int fromBus = -1;
+    int toBus = -1;
+    QSet<uint32_t> blocked; //IDs that don't get forwarded, everything else does
+    QHash<uint32_t, uint32_t> remap; //ID coming in -> ID going out
+    QHash<uint32_t, quint32> minIntervalUs; //per ID rate limit, missing uses defaultMinIntervalUs
+    quint32 defaultMinIntervalUs = 0; //0 is no limit
+    QVector<CANGatewayRule> rules; //only for frames that aren't blocked, before the rate limit
+};
+
+//running totals of one route. Kept across route changes for the same pair of buses
+struct CANGatewayCounters
+{
+    QAtomicInteger<quint64> forwarded;
+    QAtomicInteger<quint64> blocked;
+    QAtomicInteger<quint64> rateLimited;
+    QAtomicInteger<quint64> failed; //the other side wouldn't take it (or isn't there)
+    QAtomicInteger<quint64> dropped; //by a rule
+    QAtomicInteger<quint64> delayed;
+    QAtomicInteger<quint64> delayLateMaxUs; //worst a delayed frame went out after it was due
+    QAtomicInteger<quint64> injected;
+};
+
+/*
+ * The routes compiled for the reading threads, see CANConManager::setGatewayRoutes. Each route knows the connection
+ * and local bus it sends to. A frame is only ever forwarded from its own connection's reading thread, so the per
+ * ID rate limit state of a route never has more than one thread touching it.
+ *
+ * A route back out the same connection sends right there. Anything else is posted to the other connection's
+ * thread and never waited for, so one connection can't stall another's receiving and two bridged the opposite way
+ * can't deadlock each other.
+ *
+ * Rules are compiled into per ID lists when the table is made: signals are looked up in the DBC once and rewrites
+ * become ModifierPrograms over the table's own LastFrameTable, which reads other IDs straight from the live frame
+ * table. Delayed frames are handed to CANGatewayDelayLine.
+ */
+class CANGatewayTable
+{
+public:
+    struct Rule
+    {
+        CANGatewayRule::Action action;
+        const DBC_SIGNAL *sig; //condition, null if there is none
+        bool matchValue;
+        double value;
+        QSharedPointer<const ModifierProgram> program;
+        quint32 delayUs;
+        CANFrame inject;
+        QSharedPointer<CANGatewayRuleCounters> counters;
+        int runs; //send count the rewrite sees, for COUNTER
+    };
+
+    struct Route
+    {
+        CANGatewayRoute config;
+        CANConnection *to;
+        int toLocalBus;
+        QSharedPointer<CANGatewayCounters> counters;
+        QHash<uint32_t, quint64> lastSentUs;
+        QHash<uint32_t, QVector<Rule>> rulesById;
+        QVector<Rule> rulesAnyId;
+    };
+
+    QVector<Route> routes;
+    QSharedPointer<LastFrameTable> frames; //what rewrites read other IDs from
+    quint32 dbcRevision = 0; //signals in the rules were looked up against this
+    QVector<QSharedPointer<DBCMessageHandler>> dbcMessages; //and live in these, held so they can't go under a rule
+
+    //fills in the rule lists of a route from its config. pCounters lines up with config.rules
+    void compileRules(Route &route, const QVector<QSharedPointer<CANGatewayRuleCounters>> &pCounters);
+
+    bool isEmpty() const { return routes.isEmpty(); }
+    //pBus is the global bus the frame came in on, pFrom the connection whose reading thread this is
+    void forward(const CANFrame& pFrame, int pBus, CANConnection *pFrom);
+
+private:
+    //false if the frame shouldn't go out (yet). pDelayUs collects the longest delay asked for
+    bool runRules(Route &route, CANFrame &pOut, quint32 &pDelayUs, CANConnection *pFrom);
+    bool checkCondition(const Rule &rule, const CANFrame &frame) const;
+};
+
+/*
+ * Holds gateway frames that were delayed by a rule until they're due, then posts them to their connection. One
+ * thread for every route, sleeping on a min-heap of due times and spinning the last fraction of a millisecond so
+ * short delays come out close to when they were asked for.
+ */
+class CANGatewayDelayLine
+{
+public:
+    static CANGatewayDelayLine *getReference();
+    void schedule(quint64 pDueUs, CANConnection *pTo, const CANFrame &pFrame, const QSharedPointer<CANGatewayCounters> &pCounters);
+    //the connection is going away, throw out whatever is still waiting for it
+    void forget(CANConnection *pConn);
+
+private:
+    struct Entry
+    {
+        quint64 dueUs;
+        quint64 order; //keeps frames due at the same time in the order they came
+        CANConnection *to;
+        CANFrame frame;
+        QSharedPointer<CANGatewayCounters> counters;
+        bool operator>(const Entry &other) const { return dueUs != other.dueUs ? dueUs > other.dueUs : order > other.order; }
+    };
+
+    CANGatewayDelayLine();
+    ~CANGatewayDelayLine();
+    Q_DISABLE_COPY(CANGatewayDelayLine)
+    void run();
+
+    QMutex lock;
+    QWaitCondition wake;
+    std::vector<Entry> heap;
+    quint64 nextOrder = 0;
+    bool stopping = false;
+    QThread *thread = nullptr; //started the first time anything is scheduled
+};
+
+#endif // CANGATEWAY_H
@@ -8,8 +8,31 @@
 #include "utility.h"
 #include "canlogserver.h"
 
+#include <cstring>
+
+namespace
+{
+inline int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+//next space separated field from p up to end. Empty at the end of the line
+inline const char *nextField(const char *&p, const char *end, int &len)
+{
+    while (p < end && *p == ' ') p++;
+    const char *start = p;
+    while (p < end && *p != ' ') p++;
+    len = static_cast<int>(p - start);
+    return start;
+}
+}
+
 CanLogServer::CanLogServer(QString serverAddressString) :
-    CANConnection(serverAddressString, "CanLogserver", CANCon::CANLOGSERVER, 0, 0, false, 0, 1, 4000, true),
+    CANConnection(serverAddressString, "CanLogserver", CANCon::CANLOGSERVER, 0, 0, false, 0, CANLOGSERVER_BUSES, 4000, true),
     m_ptcpSocket(new QTcpSocket(this))
 {
 
@@ -20,7 +43,9 @@ CanLogServer::CanLogServer(QString serverAddressString) :
     bus_info.setListenOnly(true);
     bus_info.setSpeed(500000);
 
-    setBusConfig(0, bus_info);
+    for (int i = 0; i < CANLOGSERVER_BUSES; i++) setBusConfig(i, bus_info);
+    mRxBuffer.resize(CANLOGSERVER_MAX_LINE * 16);
+    readSettings();
 
     // Connect data ready signal
     connect(m_ptcpSocket, SIGNAL(readyRead()), this, SLOT(readNetworkData()));
@@ -46,59 +71,229 @@ CanLogServer::~CanLogServer()
 
 void CanLogServer::readNetworkData()
 {
-    // If capture is suspended bail out after reading the bytes from the network.  No need to parse them
-    if(isCapSuspended())
+    while (m_ptcpSocket->bytesAvailable() > 0)
+    {
+        //room for a good sized read after whatever's left over
+        if (mRxBuffer.size() - mRxUsed < CANLOGSERVER_MAX_LINE * 8) mRxBuffer.resize(mRxUsed + CANLOGSERVER_MAX_LINE * 16);
+        qint64 got = m_ptcpSocket->read(mRxBuffer.data() + mRxUsed, mRxBuffer.size() - mRxUsed);
+        if (got <= 0) break;
+        mRxUsed += static_cast<int>(got);
+
+        const char *data = mRxBuffer.constData();
+        int lineStart = 0;
+        for (const char *nl = static_cast<const char *>(memchr(data, '\n', static_cast<size_t>(mRxUsed))); nl;
+             nl = static_cast<const char *>(memchr(data + lineStart, '\n', static_cast<size_t>(mRxUsed - lineStart))))
+        {
+            int end = static_cast<int>(nl - data);
+            parseLine(data + lineStart, end - lineStart);
+            lineStart = end + 1;
+        }
+
+        //keep the unfinished end for next time. A line that never ends is noise, throw it away
+        mRxUsed -= lineStart;
+        if (mRxUsed > CANLOGSERVER_MAX_LINE)
+        {
+            mBadLines++;
+            mRxUsed = 0;
+        }
+        if (mRxUsed > 0 && lineStart > 0) memmove(mRxBuffer.data(), mRxBuffer.constData() + lineStart, static_cast<size_t>(mRxUsed));
+    }
+    flushSlots();
+}
+
+//"(1436509052.249713) can0 123#DEADBEEF", with ID#R for remote frames and ID##<flags><data> for CAN-FD
+void CanLogServer::parseLine(const char *line, int len)
+{
+    const char *p = line;
+    const char *end = line + len;
+    while (end > p && (end[-1] == '\r' || end[-1] == ' ')) end--;
+    if (p == end) return;
+
+    int tsLen, ifLen, frameLen;
+    const char *ts = nextField(p, end, tsLen);
+    const char *iface = nextField(p, end, ifLen);
+    const char *frame = nextField(p, end, frameLen);
+    if (frameLen == 0 || tsLen < 3 || ts[0] != '(' || ts[tsLen - 1] != ')')
+    {
+        mBadLines++;
         return;
+    }
 
-    while (m_ptcpSocket->canReadLine()) {
-        // Get a complete line and remove whitespace at the start and at the end of the string
-        QString data = QString(m_ptcpSocket->readLine()).trimmed();
-        // Split to space (obtain "<(time)> <canID> <msgId#data>")
-        QStringList lstData = data.split(" ");
-        // Expect 3 item in list
-        if(lstData.size() == 3){
-            // Obtain the timestamp. Remove '(', ')' and '.' (logserver send as "(time.fraction)").
-            QString qstrTs = lstData[0].remove(QChar('(')).remove(QChar('.')).remove(QChar(')'));
-            // One bus only. TODO: Use another parameter in connection conf for spcify can bus id to capture.
-            QString qstrCanId = "0";
-            // Split frame
-            QStringList lstMsg = lstData[2].split("#");
-            // Expect 2 item (<id>#<payload>)
-            if(lstMsg.size() == 2){
-                // Extract id
-                QString qstrId = lstMsg[0];
-                // Extract payload
-                QString qstrPayload = lstMsg[1];
-                // Support only normal can message. Extended CAN not supported.
-                if(qstrId.size() <= 4){
-                    // Prepare the frame
-                    CANFrame* frame_p = getQueue().get();
-                    // Check for frame existence
-                    if(frame_p){
-                        // Set frame ID
-                        frame_p->setFrameId(qstrId.toInt(nullptr, 16));
-                        // Extended frame NOT SUPPORTED
-                        frame_p->setExtendedFrameFormat(0);
-                        // Set bus id
-                        frame_p->bus = qstrCanId.toInt();
-                        // Set frame type
-                        frame_p->setFrameType(QCanBusFrame::DataFrame);
-                        // Frame is recived
-                        frame_p->isReceived = true;
-                        // Set timestamp
-                        frame_p->setTimeStamp(QCanBusFrame::TimeStamp(0, qstrTs.toULongLong()));
-                        // Set payload
-                        frame_p->setPayload(QByteArray::fromHex(qstrPayload.toUtf8()));
-                        // Elaborate frame
-                        checkTargettedFrame(*frame_p);
-                        /* enqueue frame */
-                        getQueue().queue();
-                    }
-                    qDebug() << data << "---" << qstrTs << " - " << qstrId << " + " << qstrPayload;
-                }
+    //seconds and the fraction, whatever number of digits the server used for it
+    quint64 seconds = 0, fraction = 0;
+    int fractionDigits = -1;
+    for (int i = 1; i < tsLen - 1; i++)
+    {
+        char c = ts[i];
+        if (c == '.' && fractionDigits < 0) fractionDigits = 0;
+        else if (c >= '0' && c <= '9')
+        {
+            if (fractionDigits < 0) seconds = seconds * 10 + static_cast<quint64>(c - '0');
+            else if (fractionDigits < 6)
+            {
+                fraction = fraction * 10 + static_cast<quint64>(c - '0');
+                fractionDigits++;
             }
         }
+        else
+        {
+            mBadLines++;
+            return;
+        }
+    }
+    for (int i = qMax(fractionDigits, 0); i < 6; i++) fraction *= 10;
+
+    const char *hash = static_cast<const char *>(memchr(frame, '#', static_cast<size_t>(frameLen)));
+    if (!hash)
+    {
+        mBadLines++;
+        return;
+    }
+    const int idDigits = static_cast<int>(hash - frame);
+    if (idDigits != 3 && idDigits != 8)
+    {
+        mBadLines++;
+        return;
+    }
+    quint32 id = 0;
+    for (int i = 0; i < idDigits; i++)
+    {
+        int nibble = hexNibble(frame[i]);
+        if (nibble < 0)
+        {
+            mBadLines++;
+            return;
+        }
+        id = (id << 4) | static_cast<quint32>(nibble);
+    }
+
+    const char *d = hash + 1;
+    const char *frameEnd = frame + frameLen;
+    bool fd = false, remote = false;
+    int flags = 0;
+    if (d < frameEnd && *d == '#')
+    {
+        fd = true;
+        if (++d >= frameEnd || (flags = hexNibble(*d)) < 0)
+        {
+            mBadLines++;
+            return;
+        }
+        d++;
     }
+    else if (d < frameEnd && *d == 'R') remote = true;
+
+    const int bus = busForInterface(iface, ifLen);
+    if (bus < 0)
+    {
+        mOtherInterfaceFrames++;
+        return;
+    }
+    if (isCapSuspended()) return;
+
+    CANFrame *frame_p = nextSlot();
+    if (!frame_p) return;
+
+    //error frames carry the socketcan error flag in an extended ID
+    bool error = (idDigits == 8) && (id & 0x20000000u);
+    if (error)
+    {
+        frame_p->setFrameType(QCanBusFrame::ErrorFrame);
+        frame_p->setError(QCanBusFrame::FrameErrors(QFlag(static_cast<int>(id & 0x1FFFFFFFu))));
+        frame_p->setExtendedFrameFormat(false);
+    }
+    else
+    {
+        frame_p->setFrameType(remote ? QCanBusFrame::RemoteRequestFrame : QCanBusFrame::DataFrame);
+        frame_p->setFrameId(id & (idDigits == 8 ? 0x1FFFFFFFu : 0x7FFu));
+        frame_p->setExtendedFrameFormat(idDigits == 8);
+    }
+    frame_p->setFlexibleDataRateFormat(fd);
+    frame_p->setBitrateSwitch(fd && (flags & 1));
+    frame_p->setErrorStateIndicator(fd && (flags & 2));
+    frame_p->setLocalEcho(false);
+    frame_p->bus = bus;
+    frame_p->isReceived = true;
+    frame_p->timedelta = 0;
+    frame_p->frameCount = 1;
+    frame_p->setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(seconds * 1000000 + fraction)));
+
+    char payload[64];
+    const int maxBytes = fd ? 64 : 8;
+    int bytes = 0;
+    if (!remote)
+    {
+        while (d + 1 < frameEnd && bytes < maxBytes)
+        {
+            if (*d == '.') //candump can put dots between the bytes
+            {
+                d++;
+                continue;
+            }
+            int high = hexNibble(d[0]);
+            int low = hexNibble(d[1]);
+            if (high < 0 || low < 0) break;
+            payload[bytes++] = static_cast<char>((high << 4) | low);
+            d += 2;
+        }
+    }
+    fillPayload(*frame_p, payload, bytes);
+
+    checkTargettedFrame(*frame_p);
+}
+
+int CanLogServer::busForInterface(const char *name, int len)
+{
+    for (int i = 0; i < mInterfaces.count(); i++)
+    {
+        const QByteArray &known = mInterfaces.at(i);
+        if (known.length() == len && memcmp(known.constData(), name, static_cast<size_t>(len)) == 0) return i;
+    }
+    if (mInterfaces.count() >= CANLOGSERVER_BUSES || len == 0) return -1;
+    mInterfaces.append(QByteArray(name, len));
+    sendDebug("Canlogserver: interface " + QString::fromLatin1(name, len) + " is bus " + QString::number(mInterfaces.count() - 1));
+    return mInterfaces.count() - 1;
+}
+
+CANFrame *CanLogServer::nextSlot()
+{
+    if (mSlotsUsed == mSlotsGranted)
+    {
+        flushSlots();
+        mSlots = getQueue().reserve(CANLOGSERVER_RX_BATCH, mSlotsGranted);
+        if (!mSlots)
+        {
+            mSlotsGranted = 0;
+            mSlotsDropped++;
+            return nullptr;
+        }
+    }
+    return &mSlots[mSlotsUsed++];
+}
+
+//publish whatever was filled in this read and say how many didn't fit
+void CanLogServer::flushSlots()
+{
+    if (mSlotsUsed > 0)
+    {
+        getQueue().commit(mSlotsUsed);
+        notifyFramesQueued();
+    }
+    if (mSlotsDropped > 0)
+    {
+        qDebug() << "can't get a frame, ERROR";
+        getQueue().drop(mSlotsDropped);
+    }
+    mSlots = nullptr;
+    mSlotsGranted = 0;
+    mSlotsUsed = 0;
+    mSlotsDropped = 0;
+}
+
+void CanLogServer::sendDebug(const QString &debugText)
+{
+    qDebug() << debugText;
+    debugOutput(debugText);
 }
 
 void CanLogServer::networkConnected()
@@ -108,7 +303,7 @@ void CanLogServer::networkConnected()
 
     setStatus(CANCon::CONNECTED);
     stats.conStatus = getStatus();
-    stats.numHardwareBuses = 1;
+    stats.numHardwareBuses = CANLOGSERVER_BUSES;
     emit status(stats);
 }
 
@@ -172,15 +367,35 @@ void CanLogServer::connectToDevice()
     qDebug() << "Port:" << url.port();
     // Set status at not connected
     setStatus(CANCon::NOT_CONNECTED);
+    // Nothing left over from an earlier connection
+    mRxUsed = 0;
     // No proxy for connection
     m_ptcpSocket->setProxy(QNetworkProxy::NoProxy);
     // Connect to log server
     m_ptcpSocket->connectToHost(url.host(), url.port());
 }
 
+void CanLogServer::readSettings()
+{
+    QSettings settings;
+    mInterfaces.clear();
+    QStringList names = settings.value("CanLogServer/Interfaces").toString().split(',', Qt::SkipEmptyParts);
+    for (const QString &name : names)
+    {
+        if (mInterfaces.count() < CANLOGSERVER_BUSES) mInterfaces.append(name.trimmed().toLatin1());
+    }
+}
+
 void CanLogServer::disconnectFromDevice()
 {
     qDebug() << "Canlogserver: " << "Disconnecting...";
+    if (mOtherInterfaceFrames > 0 || mBadLines > 0)
+    {
+        sendDebug(QString("Canlogserver: %1 frames from interfaces past the last bus, %2 lines that couldn't be read")
+                      .arg(mOtherInterfaceFrames).arg(mBadLines));
+        mOtherInterfaceFrames = 0;
+        mBadLines = 0;
+    }
     // Close socket
     m_ptcpSocket->close();
 }
@@ -7,6 +7,7 @@
 #include <QThread>
 #include <QTimer>
 #include <QTcpSocket>
+#include <QVector>
 
 /*************/
 #include <QDateTime>
@@ -16,6 +17,24 @@
 #include "canconnection.h"
 #include "canconmanager.h"
 
+//interfaces the server can send that get a bus each. The rest are counted and dropped
+#define CANLOGSERVER_BUSES      4
+//longest line worth keeping: timestamp, a long interface name and an FD frame with 64 bytes
+#define CANLOGSERVER_MAX_LINE   256
+//queue slots asked for at a time while a read is being parsed
+#define CANLOGSERVER_RX_BATCH   64
+
+/*
+ * Client for can-utils' canlogserver, which sends candump log lines: "(seconds.fraction) interface frame" where the
+ * frame is ID#data, ID#R for a remote frame or ID##flags data for CAN-FD, and an 8 digit ID is extended.
+ *
+ * Each read is appended to one receive buffer that's kept between reads and the complete lines are parsed where
+ * they sit, so a line split across reads is fine and nothing is allocated per frame. Frames go into queue slots
+ * reserved a batch at a time.
+ *
+ * Interfaces get bus numbers in the order they're listed in the CanLogServer/Interfaces setting (comma separated)
+ * and after that in the order they first show up, up to CANLOGSERVER_BUSES.
+ */
 class CanLogServer : public CANConnection
 {
     Q_OBJECT
@@ -44,12 +63,29 @@ private:
     void connectToDevice();
     void disconnectFromDevice();
     void heartbeat();
+    void parseLine(const char *line, int len);
+    int busForInterface(const char *name, int len);
+    CANFrame *nextSlot();
+    void flushSlots();
+    void sendDebug(const QString &debugText);
 
 // Attributes
 protected:
      QTcpSocket *m_ptcpSocket = nullptr;
      QString m_qsAddress;
 
+     QByteArray mRxBuffer;  //unparsed bytes, the start of a line that hasn't finished yet
+     int mRxUsed = 0;
+     QVector<QByteArray> mInterfaces; //index is the bus number
+     quint64 mOtherInterfaceFrames = 0;
+     quint64 mBadLines = 0;
+
+     //slots reserved from the queue during one read
+     CANFrame *mSlots = nullptr;
+     int mSlotsGranted = 0;
+     int mSlotsUsed = 0;
+     int mSlotsDropped = 0;
+
 //    QUdpSocket *_udpClient;
 
 //    QTimer  *_heartbeatTimer;
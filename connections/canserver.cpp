@@ -10,7 +10,9 @@
 #include <QCanBusFrame>
 #include <QSettings>
 #include <QStringBuilder>
+#include <QtEndian>
 #include <QtNetwork>
+#include <cstring>
 
 #include "utility.h"
 #include "canserver.h"
@@ -103,6 +105,8 @@ void CANserver::connectToDevice()
     
     bool bindResult = _udpClient->bind(1338);
     qDebug() << "CANserver: " << "UDP Bind result: " << bindResult;
+    _udpClient->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, CANSERVER_RCVBUF_BYTES);
+    _sources.clear();
     
     heartbeat();
     
@@ -141,90 +145,104 @@ void CANserver::heartbeat()
 
     qDebug() << "CANserver: " << "Sending a heartbeat...";
     _udpClient->writeDatagram(datagram);
+    reportSources();
 }
 
 void CANserver::readNetworkData()
 {
-    QByteArray datagram;
-    do {
-        datagram.resize(_udpClient->pendingDatagramSize());
-        _udpClient->readDatagram(datagram.data(), datagram.size());
-    } while (_udpClient->hasPendingDatagrams());
+    //everything that's pending, not just the last one. The socket only signals again once it's been emptied
+    while (_udpClient->hasPendingDatagrams())
+    {
+        qint64 size = _udpClient->pendingDatagramSize();
+        if (size < 0) break;
+        if (_rxBuffer.size() < size) _rxBuffer.resize(static_cast<int>(size));
+
+        QHostAddress sender;
+        quint16 port = 0;
+        qint64 got = _udpClient->readDatagram(_rxBuffer.data(), _rxBuffer.size(), &sender, &port);
+        if (got < 0) break;
+        processDatagram(_rxBuffer.constData(), got, sender, port);
+    }
+}
+
+void CANserver::processDatagram(const char *pData, qint64 pSize, const QHostAddress &pSender, quint16 pPort)
+{
+    static_assert(sizeof(Record) == 16, "CANserver records are 16 bytes on the wire");
+
+    SourceStats &source = _sources[pSender.toString() + ":" + QString::number(pPort)];
+    source.datagrams++;
 
-    
     // If capture is suspended bail out after reading the bytes from the network.  No need to parse them
-    if(isCapSuspended())
+    if (isCapSuspended())
+    {
+        source.suspendedDrops++;
         return;
+    }
 
-    
-    uint16_t packetCount = datagram.length() / 16;
-    //qDebug() << "Processing " << packetCount << " packets";
+    const int count = static_cast<int>(pSize / static_cast<qint64>(sizeof(Record)));
+    source.strayBytes += static_cast<quint64>(pSize % static_cast<qint64>(sizeof(Record)));
+    if (count == 0) return;
 
-    //Process this chunk of data
-    for (int i = 0 ; i < packetCount; i++)
+    //the whole datagram arrived at once so its frames share a timestamp
+    const QCanBusFrame::TimeStamp stamp(0, QDateTime::currentMSecsSinceEpoch() * 1000ul);
+    int done = 0;
+    while (done < count)
     {
-        uint16_t headerByteLocation = (i*16);
-        uint16_t dataByteLocation = (i*16) + 8;
-
-        
-        uint32_t headerData1Byte1 = datagram.at(headerByteLocation + 0) & 0xFF;
-        uint32_t headerData1Byte2 = datagram.at(headerByteLocation + 1) & 0xFF;
-        uint32_t headerData1Byte3 = datagram.at(headerByteLocation + 2) & 0xFF;
-        uint32_t headerData1Byte4 = datagram.at(headerByteLocation + 3) & 0xFF;
-        
-        uint32_t headerData2Byte1 = datagram.at(headerByteLocation + 4) & 0xFF;
-        uint32_t headerData2Byte2 = datagram.at(headerByteLocation + 5) & 0xFF;
-        uint32_t headerData2Byte3 = datagram.at(headerByteLocation + 6) & 0xFF;
-        uint32_t headerData2Byte4 = datagram.at(headerByteLocation + 7) & 0xFF;
-        
-        
-        //printf("HB1: %02X, %02X, %02X, %02X\n", headerData1Byte1, headerData1Byte2, headerData1Byte3, headerData1Byte4);
-        //printf("HB2: %02X, %02X, %02X, %02X\n", headerData2Byte1, headerData2Byte2, headerData2Byte3, headerData2Byte4);
-
-        uint32_t headerData1 = headerData1Byte1;
-        headerData1 += headerData1Byte2 << 8;
-        headerData1 += headerData1Byte3 << 16;
-        headerData1 += headerData1Byte4 << 24;
-
-        uint32_t headerData2 = headerData2Byte1;
-        headerData2 += headerData2Byte2 << 8;
-        headerData2 += headerData2Byte3 << 16;
-        headerData2 += headerData2Byte4 << 24;
-
-        uint32_t frameId = headerData1 >> 21;
-        uint32_t length = (headerData2 & 0x0F);
-        uint32_t busId = (headerData2 >> 4);
-
-        //printf("frameId: %02X, busId: %d, length: %d\n", frameId, busId, length);
-        
-        CANFrame* frame_p = getQueue().get();
-        if(frame_p)
+        int granted = 0;
+        CANFrame *slot_p = getQueue().reserve(count - done, granted);
+        if (!slot_p)
+        {
+            getQueue().drop(count - done);
+            source.queueDrops += static_cast<quint64>(count - done);
+            break;
+        }
+        for (int i = 0; i < granted; i++)
         {
-            frame_p->setFrameId(frameId);
-            frame_p->setExtendedFrameFormat(0);
+            Record rec;
+            memcpy(&rec, pData + static_cast<size_t>(done + i) * sizeof(Record), sizeof(Record));
+            const quint32 header = qFromLittleEndian(rec.header);
+            const quint32 info = qFromLittleEndian(rec.info);
+            int length = qMin<int>(info & 0x0F, 8);
+            int busId = static_cast<int>(info >> 4);
 
             // We need to change the bus id if it is the special CANserver bus id.
             // This keeps us from needing to define 15 busses just to get access to our special one
-            if (busId == 15)
-            {
-                busId = 2;
-            }
-            frame_p->bus = busId;
-            
-            frame_p->setFrameType(QCanBusFrame::DataFrame);
-            frame_p->isReceived = true;
-        
-            frame_p->setTimeStamp(QCanBusFrame::TimeStamp(0, QDateTime::currentMSecsSinceEpoch() * 1000ul));
-
-            frame_p->setPayload(datagram.mid(dataByteLocation, length));
-        
-            checkTargettedFrame(*frame_p);
-
-            /* enqueue frame */
-            getQueue().queue();
+            if (busId == 15) busId = 2;
+
+            CANFrame &frame = slot_p[i];
+            frame.setFrameId(header >> 21);
+            frame.setExtendedFrameFormat(false);
+            frame.bus = busId;
+            frame.setFrameType(QCanBusFrame::DataFrame);
+            frame.isReceived = true;
+            frame.setTimeStamp(stamp);
+            frame.setPayload(QByteArray(reinterpret_cast<const char *>(rec.data), length));
+            checkTargettedFrame(frame);
         }
+        getQueue().commit(granted);
+        done += granted;
+    }
+    source.frames += static_cast<quint64>(done);
+    notifyFramesQueued();
+}
+
+void CANserver::reportSources()
+{
+    for (auto it = _sources.begin(); it != _sources.end(); ++it)
+    {
+        SourceStats &source = it.value();
+        if (source.datagrams == source.reported) continue; //nothing new from this one
+        source.reported = source.datagrams;
+        sendDebug(QString("CANserver: %1: %2 datagrams, %3 frames, %4 stray bytes, %5 frames dropped (queue full), %6 datagrams dropped (suspended)")
+                      .arg(it.key()).arg(source.datagrams).arg(source.frames).arg(source.strayBytes)
+                      .arg(source.queueDrops).arg(source.suspendedDrops));
     }
+}
 
+void CANserver::sendDebug(const QString &debugText)
+{
+    qDebug() << debugText;
+    debugOutput(debugText);
 }
 
 void CANserver::heartbeatTimerSlot()
@@ -11,6 +11,7 @@
 #include <stdio.h>
 
 #include <QCanBusDevice>
+#include <QHash>
 #include <QThread>
 #include <QTimer>
 #include <QUdpSocket>
@@ -23,6 +24,18 @@
 #include "canconnection.h"
 #include "canconmanager.h"
 
+//the socket's receive buffer, so a burst that comes in while the thread is busy waits in the kernel
+#define CANSERVER_RCVBUF_BYTES  (1024 * 1024)
+
+/*
+ * Panda protocol v1 over UDP. Each datagram is a run of fixed 16 byte records, two little endian header words and
+ * eight data bytes. readNetworkData drains every pending datagram each time the socket signals, reusing one receive
+ * buffer, and queues a datagram's records with a single reserve / commit.
+ *
+ * The protocol has no sequence numbers so lost datagrams can't be seen on the wire. What can be seen is counted per
+ * sender instead: datagrams and frames received, bytes that weren't a whole record, frames the queue had no room
+ * for and datagrams dropped while capture was suspended. They go to the debug console with each heartbeat.
+ */
 class CANserver : public CANConnection
 {
     Q_OBJECT
@@ -52,6 +65,27 @@ private:
     void disconnectFromDevice();
 
     void heartbeat();
+    void processDatagram(const char *pData, qint64 pSize, const QHostAddress &pSender, quint16 pPort);
+    void reportSources();
+    void sendDebug(const QString &debugText);
+
+    //raw record as it comes off the network
+    struct Record
+    {
+        quint32 header; //frame ID in the top 11 bits
+        quint32 info;   //length in the low nibble, bus above it
+        quint8 data[8];
+    };
+
+    struct SourceStats
+    {
+        quint64 datagrams = 0;
+        quint64 frames = 0;
+        quint64 strayBytes = 0;     //trailing bytes that weren't a whole record
+        quint64 queueDrops = 0;     //frames there was no room for
+        quint64 suspendedDrops = 0; //datagrams thrown away while capture was suspended
+        quint64 reported = 0;       //datagrams as of the last report
+    };
     
 protected:
     QHostAddress _canserverAddress;
@@ -59,6 +93,9 @@ protected:
     QUdpSocket *_udpClient;
 
     QTimer  *_heartbeatTimer;
+
+    QByteArray _rxBuffer; //reused for every datagram, grown to the largest one seen
+    QHash<QString, SourceStats> _sources; //keyed by "address:port"
 };
 
 #endif /* canserver_h */
@@ -0,0 +1,207 @@
+#include <QDebug>
+#include <QSettings>
+
+#include "captureagent.h"
+#include "canconmanager.h"
+
+CaptureAgent::CaptureAgent(QObject *parent) :
+    QObject(parent),
+    mNextSequence(1)
+{
+    connect(&mServer, &QTcpServer::newConnection, this, &CaptureAgent::newConnection);
+}
+
+CaptureAgent::~CaptureAgent()
+{
+    stop();
+}
+
+bool CaptureAgent::start(quint16 pPort, QString &pError)
+{
+    if (mServer.isListening()) return true;
+    if (!mServer.listen(QHostAddress::Any, pPort))
+    {
+        pError = mServer.errorString();
+        return false;
+    }
+
+    QSettings settings;
+    int size = qMax(CAPTURELINK_BATCH_FRAMES, settings.value("CaptureAgent/BufferFrames", CAPTUREAGENT_BUFFER_FRAMES).toInt());
+    mRing.clear();
+    mRing.resize(size);
+    mNextSequence = 1;
+    connect(CANConManager::getInstance(), &CANConManager::framesCaptured, this, &CaptureAgent::framesCaptured);
+    qDebug() << QString("Capture agent: serving on port %1, keeping %2 frames").arg(pPort).arg(size);
+    return true;
+}
+
+void CaptureAgent::stop()
+{
+    disconnect(CANConManager::getInstance(), &CANConManager::framesCaptured, this, &CaptureAgent::framesCaptured);
+    mServer.close();
+    for (Client *client : qAsConst(mClients))
+    {
+        client->socket->disconnect(this);
+        client->socket->abort();
+        client->socket->deleteLater();
+        delete client;
+    }
+    mClients.clear();
+    mRing.clear();
+    mRing.squeeze();
+}
+
+void CaptureAgent::newConnection()
+{
+    while (QTcpSocket *socket = mServer.nextPendingConnection())
+    {
+        Client *client = new Client;
+        client->socket = socket;
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::readyRead, this, &CaptureAgent::clientReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &CaptureAgent::clientGone);
+        mClients.append(client);
+        qDebug() << "Capture agent: client connected from " + socket->peerAddress().toString();
+    }
+}
+
+CaptureAgent::Client *CaptureAgent::clientFor(QObject *pSocket)
+{
+    for (Client *client : qAsConst(mClients))
+    {
+        if (client->socket == pSocket) return client;
+    }
+    return nullptr;
+}
+
+void CaptureAgent::clientGone()
+{
+    Client *client = clientFor(sender());
+    if (!client) return;
+    qDebug() << "Capture agent: client at " + client->socket->peerAddress().toString() + " went away";
+    mClients.removeOne(client);
+    client->socket->deleteLater();
+    delete client;
+}
+
+void CaptureAgent::clientReadyRead()
+{
+    Client *client = clientFor(sender());
+    if (!client) return;
+    client->rx.append(client->socket->readAll());
+
+    int pos = 0, type, result;
+    QByteArray body;
+    while ((result = CaptureLink::nextMessage(client->rx, pos, type, body)) > 0)
+    {
+        if (!handleMessage(*client, type, body))
+        {
+            result = -1;
+            break;
+        }
+    }
+    if (result < 0)
+    {
+        //out of step, there's no finding the next message again. It'll reconnect and resume
+        qDebug() << "Capture agent: dropping client at " + client->socket->peerAddress().toString() + ", bad message";
+        client->socket->abort();
+        return;
+    }
+    client->rx.remove(0, pos);
+    pump(*client);
+}
+
+bool CaptureAgent::handleMessage(Client &pClient, int pType, const QByteArray &pBody)
+{
+    switch (pType)
+    {
+    case CaptureLink::HELLO:
+    {
+        quint32 version, window;
+        quint64 resumeFrom;
+        if (!CaptureLink::readHello(pBody, version, resumeFrom, window) || version != CAPTURELINK_VERSION) return false;
+        //0 is only new frames. Anything past the end is from before this agent started, so also just new ones
+        pClient.nextSequence = (resumeFrom == 0 || resumeFrom > mNextSequence) ? mNextSequence : resumeFrom;
+        pClient.window = qMax<quint32>(window, 64 * 1024);
+        pClient.greeted = true;
+        QByteArray welcome = CaptureLink::welcome(CANConManager::getInstance()->getNumBuses(), oldestSequence(), mNextSequence);
+        pClient.socket->write(welcome);
+        pClient.bytesSent += static_cast<quint64>(welcome.size());
+        return true;
+    }
+    case CaptureLink::FILTER:
+    {
+        int bus;
+        QVector<CANAcceptanceFilter> filters;
+        if (!CaptureLink::readFilter(pBody, bus, filters)) return false;
+        if (pClient.filters.count() <= bus) pClient.filters.resize(bus + 1);
+        pClient.filters[bus] = filters;
+        return true;
+    }
+    case CaptureLink::ACK:
+    {
+        quint64 bytes, next;
+        if (!CaptureLink::readAck(pBody, bytes, next)) return false;
+        pClient.bytesAcked = qMin(bytes, pClient.bytesSent);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+quint64 CaptureAgent::oldestSequence() const
+{
+    const quint64 size = static_cast<quint64>(mRing.size());
+    return (mNextSequence > size) ? mNextSequence - size : 1;
+}
+
+void CaptureAgent::framesCaptured(const QVector<CANFrame> &pFrames)
+{
+    if (mRing.isEmpty()) return;
+    const quint64 size = static_cast<quint64>(mRing.size());
+    for (const CANFrame &frame : pFrames)
+    {
+        mRing[static_cast<int>(mNextSequence % size)] = frame;
+        mNextSequence++;
+    }
+    for (Client *client : qAsConst(mClients)) pump(*client);
+}
+
+//sends the client frames while its window has room
+void CaptureAgent::pump(Client &pClient)
+{
+    if (!pClient.greeted || mRing.isEmpty()) return;
+    const quint64 size = static_cast<quint64>(mRing.size());
+
+    while (pClient.nextSequence < mNextSequence && pClient.bytesSent - pClient.bytesAcked < pClient.window)
+    {
+        //fell so far behind the ring went round on it. Say what's missing and go on from the oldest still here
+        const quint64 oldest = oldestSequence();
+        if (pClient.nextSequence < oldest)
+        {
+            QByteArray gap = CaptureLink::gap(pClient.nextSequence, oldest - 1);
+            pClient.socket->write(gap);
+            pClient.bytesSent += static_cast<quint64>(gap.size());
+            pClient.nextSequence = oldest;
+        }
+
+        mBatch.clear();
+        const quint64 first = pClient.nextSequence;
+        quint64 seq = first;
+        for (; seq < mNextSequence && mBatch.count() < CAPTURELINK_BATCH_FRAMES; seq++)
+        {
+            const CANFrame &frame = mRing.at(static_cast<int>(seq % size));
+            if (frame.bus >= 0 && frame.bus < pClient.filters.count() && !CaptureLink::accepts(pClient.filters.at(frame.bus), frame)) continue;
+            mBatch.append(&frame);
+        }
+        pClient.nextSequence = seq;
+        //all filtered out. Nothing to send, the next batch's first sequence says they went by
+        if (mBatch.isEmpty()) continue;
+
+        QByteArray batch = CaptureLink::batch(first, seq, mBatch);
+        pClient.socket->write(batch);
+        pClient.bytesSent += static_cast<quint64>(batch.size());
+    }
+    mBatch.clear();
+}
@@ -0,0 +1,65 @@
+#ifndef CAPTUREAGENT_H
+#define CAPTUREAGENT_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QVector>
+
+#include "can_structs.h"
+#include "capturelink.h"
+
+//frames kept for clients that reconnect, unless the CaptureAgent/BufferFrames setting says otherwise
+#define CAPTUREAGENT_BUFFER_FRAMES  262144
+
+/*
+ * Serves what this SavvyCAN captures to CaptureLinkClient connections on other machines, see CaptureLink for the
+ * protocol. Frames come from CANConManager::framesCaptured so everything is served, capture only mode included,
+ * and go into a ring that every client reads from at its own pace. Filters a client sends are applied here so only
+ * what it wants goes over the link.
+ */
+class CaptureAgent : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureAgent(QObject *parent = nullptr);
+    ~CaptureAgent();
+
+    bool start(quint16 pPort, QString &pError);
+    void stop();
+    bool isRunning() const { return mServer.isListening(); }
+    int clientCount() const { return mClients.count(); }
+
+private slots:
+    void newConnection();
+    void framesCaptured(const QVector<CANFrame> &pFrames);
+    void clientReadyRead();
+    void clientGone();
+
+private:
+    struct Client
+    {
+        QTcpSocket *socket;
+        QByteArray rx;
+        bool greeted = false;   //nothing is sent until the HELLO
+        quint64 nextSequence = 0;
+        quint64 bytesSent = 0;
+        quint64 bytesAcked = 0;
+        quint32 window = CAPTURELINK_WINDOW;
+        QVector<QVector<CANAcceptanceFilter>> filters; //by bus, empty passes everything
+    };
+
+    Client *clientFor(QObject *pSocket);
+    bool handleMessage(Client &pClient, int pType, const QByteArray &pBody);
+    void pump(Client &pClient);
+    quint64 oldestSequence() const;
+
+    QTcpServer mServer;
+    QVector<Client *> mClients;
+    QVector<CANFrame> mRing;    //frame with sequence s is at s % size
+    quint64 mNextSequence;
+    QVector<const CANFrame *> mBatch; //reused while building batches
+};
+
+#endif // CAPTUREAGENT_H
@@ -0,0 +1,290 @@
+#include "capturelink.h"
+
+#include <QDataStream>
+#include <QHash>
+#include <QtEndian>
+
+namespace
+{
+enum FrameFlags
+{
+    FLAG_EXTENDED   = 0x01,
+    FLAG_FD         = 0x02,
+    FLAG_BRS        = 0x04,
+    FLAG_ESI        = 0x08,
+    FLAG_REMOTE     = 0x10,
+    FLAG_ERROR      = 0x20,
+    FLAG_RECEIVED   = 0x40,
+    FLAG_XOR        = 0x80  //payload is XORed with the last one of the same ID in this batch
+};
+
+QByteArray message(CaptureLink::MessageType type, const QByteArray &body)
+{
+    QByteArray out;
+    out.reserve(5 + body.size());
+    quint32 len = qToLittleEndian(static_cast<quint32>(body.size() + 1));
+    out.append(reinterpret_cast<const char *>(&len), 4);
+    out.append(static_cast<char>(type));
+    out.append(body);
+    return out;
+}
+
+inline void putVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        out.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+inline bool getVarint(const uchar *&p, const uchar *end, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p >= end) return false;
+        uchar b = *p++;
+        value |= static_cast<quint64>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline quint64 zigzag(qint64 v) { return (static_cast<quint64>(v) << 1) ^ static_cast<quint64>(v >> 63); }
+inline qint64 unzigzag(quint64 v) { return static_cast<qint64>(v >> 1) ^ -static_cast<qint64>(v & 1); }
+
+inline quint64 idKey(quint32 id, int bus) { return (static_cast<quint64>(static_cast<quint8>(bus)) << 32) | id; }
+
+QDataStream &littleEndian(QDataStream &stream)
+{
+    stream.setByteOrder(QDataStream::LittleEndian);
+    return stream;
+}
+}
+
+QByteArray CaptureLink::hello(quint64 resumeFrom, quint32 window)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    littleEndian(stream) << static_cast<quint32>(CAPTURELINK_VERSION) << resumeFrom << window;
+    return message(HELLO, body);
+}
+
+QByteArray CaptureLink::filter(int bus, const QVector<CANAcceptanceFilter> &filters)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    littleEndian(stream) << static_cast<quint8>(bus) << static_cast<quint16>(filters.count());
+    for (const CANAcceptanceFilter &f : filters) stream << f.id << f.mask;
+    return message(FILTER, body);
+}
+
+QByteArray CaptureLink::ack(quint64 bytesReceived, quint64 nextSequence)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    littleEndian(stream) << bytesReceived << nextSequence;
+    return message(ACK, body);
+}
+
+QByteArray CaptureLink::welcome(int buses, quint64 oldest, quint64 next)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    littleEndian(stream) << static_cast<quint32>(CAPTURELINK_VERSION) << static_cast<quint8>(buses) << oldest << next;
+    return message(WELCOME, body);
+}
+
+QByteArray CaptureLink::gap(quint64 first, quint64 last)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    littleEndian(stream) << first << last;
+    return message(GAP, body);
+}
+
+QByteArray CaptureLink::batch(quint64 firstSequence, quint64 endSequence, const QVector<const CANFrame *> &frames)
+{
+    QByteArray raw;
+    raw.reserve(frames.count() * 16);
+    QHash<quint64, QByteArray> last; //payloads by ID so far in this batch
+    qint64 prevUs = 0;
+    for (const CANFrame *frame : frames)
+    {
+        const QByteArray &payload = frame->payload();
+        const int len = qMin(payload.length(), 64);
+        const bool error = frame->frameType() == QCanBusFrame::ErrorFrame;
+        quint8 flags = 0;
+        if (frame->hasExtendedFrameFormat()) flags |= FLAG_EXTENDED;
+        if (frame->hasFlexibleDataRateFormat()) flags |= FLAG_FD;
+        if (frame->hasBitrateSwitch()) flags |= FLAG_BRS;
+        if (frame->hasErrorStateIndicator()) flags |= FLAG_ESI;
+        if (frame->frameType() == QCanBusFrame::RemoteRequestFrame) flags |= FLAG_REMOTE;
+        if (error) flags |= FLAG_ERROR;
+        if (frame->isReceived) flags |= FLAG_RECEIVED;
+
+        const quint32 id = error ? static_cast<quint32>(frame->error()) : frame->frameId();
+        auto prev = last.find(idKey(id, frame->bus));
+        const bool xored = prev != last.end() && prev->length() == len;
+        if (xored) flags |= FLAG_XOR;
+
+        const qint64 us = static_cast<qint64>(frame->timeStamp().microSeconds());
+        raw.append(static_cast<char>(flags));
+        raw.append(static_cast<char>(frame->bus));
+        putVarint(raw, zigzag(us - prevUs));
+        prevUs = us;
+        putVarint(raw, id);
+        raw.append(static_cast<char>(len));
+        if (xored)
+        {
+            const char *prior = prev->constData();
+            for (int i = 0; i < len; i++) raw.append(static_cast<char>(payload.at(i) ^ prior[i]));
+            *prev = payload.left(len);
+        }
+        else
+        {
+            raw.append(payload.constData(), len);
+            last.insert(idKey(id, frame->bus), payload.left(len));
+        }
+    }
+
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    littleEndian(stream) << firstSequence << endSequence << static_cast<quint32>(frames.count());
+    body.append(qCompress(raw, 6));
+    return message(BATCH, body);
+}
+
+int CaptureLink::nextMessage(const QByteArray &buffer, int &pos, int &type, QByteArray &body)
+{
+    if (buffer.size() - pos < 4) return 0;
+    quint32 len = qFromLittleEndian<quint32>(buffer.constData() + pos);
+    if (len < 1 || len > CAPTURELINK_MAX_MESSAGE) return -1;
+    if (static_cast<quint32>(buffer.size() - pos - 4) < len) return 0;
+    type = static_cast<quint8>(buffer.at(pos + 4));
+    body = buffer.mid(pos + 5, static_cast<int>(len) - 1);
+    pos += 4 + static_cast<int>(len);
+    return 1;
+}
+
+bool CaptureLink::readHello(const QByteArray &body, quint32 &version, quint64 &resumeFrom, quint32 &window)
+{
+    QDataStream stream(body);
+    littleEndian(stream) >> version >> resumeFrom >> window;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool CaptureLink::readFilter(const QByteArray &body, int &bus, QVector<CANAcceptanceFilter> &filters)
+{
+    QDataStream stream(body);
+    quint8 b;
+    quint16 count;
+    littleEndian(stream) >> b >> count;
+    bus = b;
+    filters.clear();
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        CANAcceptanceFilter f;
+        stream >> f.id >> f.mask;
+        filters.append(f);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool CaptureLink::readAck(const QByteArray &body, quint64 &bytesReceived, quint64 &nextSequence)
+{
+    QDataStream stream(body);
+    littleEndian(stream) >> bytesReceived >> nextSequence;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool CaptureLink::readWelcome(const QByteArray &body, quint32 &version, int &buses, quint64 &oldest, quint64 &next)
+{
+    QDataStream stream(body);
+    quint8 b;
+    littleEndian(stream) >> version >> b >> oldest >> next;
+    buses = b;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool CaptureLink::readGap(const QByteArray &body, quint64 &first, quint64 &last)
+{
+    QDataStream stream(body);
+    littleEndian(stream) >> first >> last;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool CaptureLink::readBatch(const QByteArray &body, Batch &batch)
+{
+    const int headerLen = 8 + 8 + 4;
+    if (body.size() < headerLen) return false;
+    const char *h = body.constData();
+    batch.firstSequence = qFromLittleEndian<quint64>(h);
+    batch.endSequence = qFromLittleEndian<quint64>(h + 8);
+    const quint32 count = qFromLittleEndian<quint32>(h + 16);
+    if (count > CAPTURELINK_BATCH_FRAMES || batch.endSequence < batch.firstSequence) return false;
+
+    const QByteArray raw = qUncompress(reinterpret_cast<const uchar *>(h + headerLen), body.size() - headerLen);
+    if (raw.isEmpty() && count > 0) return false;
+
+    batch.frames.resize(static_cast<int>(count));
+    QHash<quint64, QByteArray> last;
+    const uchar *p = reinterpret_cast<const uchar *>(raw.constData());
+    const uchar *end = p + raw.size();
+    qint64 us = 0;
+    for (quint32 i = 0; i < count; i++)
+    {
+        if (end - p < 2) return false;
+        const quint8 flags = *p++;
+        const int bus = *p++;
+        quint64 delta, id;
+        if (!getVarint(p, end, delta) || !getVarint(p, end, id) || p >= end) return false;
+        const int len = *p++;
+        if (len > 64 || end - p < len || id > 0xFFFFFFFFu) return false;
+
+        QByteArray payload(reinterpret_cast<const char *>(p), len);
+        p += len;
+        const quint64 key = idKey(static_cast<quint32>(id), bus);
+        if (flags & FLAG_XOR)
+        {
+            auto prev = last.find(key);
+            if (prev == last.end() || prev->length() != len) return false;
+            for (int b = 0; b < len; b++) payload[b] = static_cast<char>(payload.at(b) ^ prev->at(b));
+        }
+        last.insert(key, payload);
+
+        us += unzigzag(delta);
+        CANFrame &frame = batch.frames[static_cast<int>(i)];
+        if (flags & FLAG_ERROR)
+        {
+            frame.setFrameType(QCanBusFrame::ErrorFrame);
+            frame.setError(QCanBusFrame::FrameErrors(QFlag(static_cast<int>(id))));
+        }
+        else
+        {
+            frame.setFrameType((flags & FLAG_REMOTE) ? QCanBusFrame::RemoteRequestFrame : QCanBusFrame::DataFrame);
+            frame.setFrameId(static_cast<quint32>(id));
+        }
+        frame.setExtendedFrameFormat(flags & FLAG_EXTENDED);
+        frame.setFlexibleDataRateFormat(flags & FLAG_FD);
+        frame.setBitrateSwitch(flags & FLAG_BRS);
+        frame.setErrorStateIndicator(flags & FLAG_ESI);
+        frame.isReceived = (flags & FLAG_RECEIVED) != 0;
+        frame.bus = bus;
+        frame.setTimeStamp(QCanBusFrame::TimeStamp(0, us));
+        frame.setPayload(payload);
+    }
+    return p == end;
+}
+
+bool CaptureLink::accepts(const QVector<CANAcceptanceFilter> &filters, const CANFrame &frame)
+{
+    if (filters.isEmpty()) return true;
+    for (const CANAcceptanceFilter &f : filters)
+    {
+        if (((frame.frameId() ^ f.id) & f.mask) == 0) return true;
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#ifndef CAPTURELINK_H
+#define CAPTURELINK_H
+
+#include <QByteArray>
+#include <QVector>
+#include "can_structs.h"
+
+#define CAPTURELINK_PORT            23460
+#define CAPTURELINK_VERSION         1
+//a length prefix past this can't be a real message, the stream is out of step
+#define CAPTURELINK_MAX_MESSAGE     (8 * 1024 * 1024)
+//frames per batch at most. Busier links just send more of them
+#define CAPTURELINK_BATCH_FRAMES    4096
+//bytes a client lets the agent have in flight before it has to wait for an ACK
+#define CAPTURELINK_WINDOW          (1024 * 1024)
+//buses a client connection has, whatever the agent has
+#define CAPTURELINK_MAX_BUSES       8
+
+/*
+ * The capture link protocol, used by CaptureAgent (the SavvyCAN doing the capturing) and CaptureLinkClient (the one
+ * watching) over TCP. Every message is a 32 bit little endian length of what follows, a type byte and the body:
+ *
+ *  HELLO    client  version, sequence to resume from (0 for only new frames), window in bytes
+ *  FILTER   client  bus, then ID / mask pairs frames on that bus have to match one of. None passes everything
+ *  ACK      client  bytes received so far, next sequence wanted
+ *  WELCOME  agent   version, number of buses, oldest sequence it still holds, the next one it will give out
+ *  BATCH    agent   first sequence, sequence after the batch, frame count, compressed frames
+ *  GAP      agent   first and last sequence of frames it no longer had when they were asked for
+ *
+ * Every frame the agent captures gets the next sequence number. Frames filtered out use theirs up too so a client
+ * can resume after any batch without the agent sending it anything twice. The agent keeps a ring of recent frames
+ * so a client that reconnects (with its next sequence in HELLO) gets what it missed, and only sends while the
+ * client's window has room, so a slow link backs up into the ring rather than into socket buffers.
+ *
+ * Batches are each decodable on their own. Per frame there's a flags byte, the bus, the timestamp as a zigzag
+ * varint difference from the frame before, the ID as a varint, the length and the payload. A payload the same length
+ * as the last one of its ID in the batch is sent XORed with it, which turns the bytes that didn't change into zeros.
+ * The whole batch then goes through qCompress.
+ */
+class CaptureLink
+{
+public:
+    enum MessageType
+    {
+        HELLO = 1,
+        FILTER,
+        ACK,
+        WELCOME,
+        BATCH,
+        GAP
+    };
+
+    struct Batch
+    {
+        quint64 firstSequence = 0;
+        quint64 endSequence = 0;
+        QVector<CANFrame> frames;
+    };
+
+    static QByteArray hello(quint64 resumeFrom, quint32 window);
+    static QByteArray filter(int bus, const QVector<CANAcceptanceFilter> &filters);
+    static QByteArray ack(quint64 bytesReceived, quint64 nextSequence);
+    static QByteArray welcome(int buses, quint64 oldest, quint64 next);
+    static QByteArray batch(quint64 firstSequence, quint64 endSequence, const QVector<const CANFrame *> &frames);
+    static QByteArray gap(quint64 first, quint64 last);
+
+    /*
+     * The next whole message in buffer from pos on. pos moves past it. Returns 0 if the message isn't all there yet
+     * and -1 if the stream can't be read any further, otherwise 1 with the type and body filled in
+     */
+    static int nextMessage(const QByteArray &buffer, int &pos, int &type, QByteArray &body);
+
+    //false for a body that isn't what the type says
+    static bool readHello(const QByteArray &body, quint32 &version, quint64 &resumeFrom, quint32 &window);
+    static bool readFilter(const QByteArray &body, int &bus, QVector<CANAcceptanceFilter> &filters);
+    static bool readAck(const QByteArray &body, quint64 &bytesReceived, quint64 &nextSequence);
+    static bool readWelcome(const QByteArray &body, quint32 &version, int &buses, quint64 &oldest, quint64 &next);
+    static bool readBatch(const QByteArray &body, Batch &batch);
+    static bool readGap(const QByteArray &body, quint64 &first, quint64 &last);
+
+    static bool accepts(const QVector<CANAcceptanceFilter> &filters, const CANFrame &frame);
+};
+
+#endif // CAPTURELINK_H
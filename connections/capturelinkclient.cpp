@@ -0,0 +1,236 @@
+#include <QDebug>
+#include <QNetworkProxy>
+#include <QUrl>
+
+#include "capturelinkclient.h"
+
+CaptureLinkClient::CaptureLinkClient(QString pAddress) :
+    CANConnection(pAddress, "CaptureLink", CANCon::CAPTURE_LINK, 0, 0, false, 0, CAPTURELINK_MAX_BUSES, 4000, true),
+    mSocket(new QTcpSocket(this)),
+    mRetryTimer(this), /*NB: set this as parent of timer to manage it from working thread */
+    mFilters(CAPTURELINK_MAX_BUSES)
+{
+    qDebug() << "CaptureLink: " << "Constructing new Connection...";
+
+    CANBus bus_info;
+    bus_info.setActive(true);
+    bus_info.setListenOnly(true);
+    bus_info.setSpeed(500000);
+    for (int i = 0; i < CAPTURELINK_MAX_BUSES; i++) setBusConfig(i, bus_info);
+
+    mRetryTimer.setSingleShot(true);
+    mRetryTimer.setInterval(CAPTURELINKCLIENT_RETRY_MS);
+    connect(&mRetryTimer, &QTimer::timeout, this, &CaptureLinkClient::connectToAgent);
+    connect(mSocket, &QTcpSocket::readyRead, this, &CaptureLinkClient::readNetworkData);
+    connect(mSocket, &QTcpSocket::connected, this, &CaptureLinkClient::networkConnected);
+    //a connect that fails never gets to disconnected, so go by the state for retrying
+    connect(mSocket, &QTcpSocket::stateChanged, this, [this](QAbstractSocket::SocketState state)
+    {
+        if (state == QAbstractSocket::UnconnectedState) networkDisconnected();
+    });
+}
+
+CaptureLinkClient::~CaptureLinkClient()
+{
+    qDebug() << "CaptureLink: " << "Deconstructing Connection...";
+    stop();
+}
+
+void CaptureLinkClient::piStarted()
+{
+    mStopping = false;
+    connectToAgent();
+}
+
+void CaptureLinkClient::piStop()
+{
+    mStopping = true;
+    mRetryTimer.stop();
+    mSocket->abort();
+    if (mLostFrames > 0) sendDebug(QString("CaptureLink: %1 frames were gone from the agent before they could be sent").arg(mLostFrames));
+}
+
+void CaptureLinkClient::connectToAgent()
+{
+    if (mStopping) return;
+    QUrl url("tcp://" + getPort());
+    setStatus(CANCon::NOT_CONNECTED);
+    mRx.clear();
+    mBytesReceived = 0;
+    mSocket->setProxy(QNetworkProxy::NoProxy);
+    mSocket->connectToHost(url.host(), static_cast<quint16>(url.port(CAPTURELINK_PORT)));
+}
+
+void CaptureLinkClient::networkConnected()
+{
+    mSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    QByteArray hello = CaptureLink::hello(mNextSequence, CAPTURELINK_WINDOW);
+    for (int bus = 0; bus < mFilters.count(); bus++)
+    {
+        if (!mFilters.at(bus).isEmpty()) hello.append(CaptureLink::filter(bus, mFilters.at(bus)));
+    }
+    mSocket->write(hello);
+
+    setStatus(CANCon::CONNECTED);
+    CANConStatus stats;
+    stats.conStatus = getStatus();
+    stats.numHardwareBuses = CAPTURELINK_MAX_BUSES;
+    emit status(stats);
+}
+
+void CaptureLinkClient::networkDisconnected()
+{
+    if (getStatus() == CANCon::CONNECTED)
+    {
+        setStatus(CANCon::NOT_CONNECTED);
+        CANConStatus stats;
+        stats.conStatus = getStatus();
+        stats.numHardwareBuses = CAPTURELINK_MAX_BUSES;
+        emit status(stats);
+    }
+    if (!mStopping && !mRetryTimer.isActive()) mRetryTimer.start();
+}
+
+void CaptureLinkClient::readNetworkData()
+{
+    QByteArray got = mSocket->readAll();
+    mBytesReceived += static_cast<quint64>(got.size());
+    mRx.append(got);
+
+    int pos = 0, type, result;
+    bool batches = false;
+    QByteArray body;
+    while ((result = CaptureLink::nextMessage(mRx, pos, type, body)) > 0)
+    {
+        if (!handleMessage(type, body))
+        {
+            result = -1;
+            break;
+        }
+        if (type == CaptureLink::BATCH) batches = true;
+    }
+    if (result < 0)
+    {
+        //start over on a fresh connection, which resumes after the last batch that made sense
+        sendDebug("CaptureLink: unreadable message from the agent, reconnecting");
+        mSocket->abort();
+        return;
+    }
+    mRx.remove(0, pos);
+
+    //one ACK for everything read this time, which opens the window again
+    if (batches) mSocket->write(CaptureLink::ack(mBytesReceived, mNextSequence));
+}
+
+bool CaptureLinkClient::handleMessage(int pType, const QByteArray &pBody)
+{
+    switch (pType)
+    {
+    case CaptureLink::WELCOME:
+    {
+        quint32 version;
+        int buses;
+        quint64 oldest, next;
+        if (!CaptureLink::readWelcome(pBody, version, buses, oldest, next) || version != CAPTURELINK_VERSION) return false;
+        if (mNextSequence > next)
+        {
+            //the agent was restarted, its numbers started over
+            sendDebug("CaptureLink: agent was restarted, taking new frames from now on");
+            mNextSequence = next;
+        }
+        if (buses > CAPTURELINK_MAX_BUSES)
+            sendDebug(QString("CaptureLink: agent has %1 buses, frames past bus %2 are dropped").arg(buses).arg(CAPTURELINK_MAX_BUSES - 1));
+        return true;
+    }
+    case CaptureLink::BATCH:
+        if (!CaptureLink::readBatch(pBody, mBatch)) return false;
+        queueBatch();
+        mNextSequence = mBatch.endSequence;
+        return true;
+    case CaptureLink::GAP:
+    {
+        quint64 first, last;
+        if (!CaptureLink::readGap(pBody, first, last) || last < first) return false;
+        mLostFrames += last - first + 1;
+        sendDebug(QString("CaptureLink: link was down too long, %1 frames lost").arg(last - first + 1));
+        mNextSequence = last + 1;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void CaptureLinkClient::queueBatch()
+{
+    if (isCapSuspended()) return;
+    int granted = 0, used = 0, dropped = 0;
+    CANFrame *slots = nullptr;
+    for (const CANFrame &frame : qAsConst(mBatch.frames))
+    {
+        if (frame.bus < 0 || frame.bus >= CAPTURELINK_MAX_BUSES) continue;
+        if (used == granted)
+        {
+            if (used > 0) getQueue().commit(used);
+            used = 0;
+            slots = getQueue().reserve(mBatch.frames.count(), granted);
+            if (!slots)
+            {
+                granted = 0;
+                dropped++;
+                continue;
+            }
+        }
+        CANFrame *frame_p = &slots[used++];
+        *frame_p = frame;
+        frame_p->setLocalEcho(false);
+        frame_p->timedelta = 0;
+        frame_p->frameCount = 1;
+        checkTargettedFrame(*frame_p);
+    }
+    if (used > 0) getQueue().commit(used);
+    if (dropped > 0)
+    {
+        qDebug() << "can't get a frame, ERROR";
+        getQueue().drop(dropped);
+    }
+    notifyFramesQueued();
+}
+
+bool CaptureLinkClient::piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters)
+{
+    if (pBusIdx < 0 || pBusIdx >= mFilters.count()) return false;
+    mFilters[pBusIdx] = pFilters;
+    //the agent does the filtering. Not connected, it gets them with the next HELLO
+    if (mSocket->state() == QAbstractSocket::ConnectedState) mSocket->write(CaptureLink::filter(pBusIdx, pFilters));
+    return true;
+}
+
+void CaptureLinkClient::piSuspend(bool pSuspend)
+{
+    setCapSuspended(pSuspend);
+    if (isCapSuspended()) getQueue().flush();
+}
+
+bool CaptureLinkClient::piGetBusSettings(int pBusIdx, CANBus& pBus)
+{
+    return getBusConfig(pBusIdx, pBus);
+}
+
+void CaptureLinkClient::piSetBusSettings(int pBusIdx, CANBus pBus)
+{
+    if (pBusIdx < 0 || pBusIdx >= getNumBuses()) return;
+    setBusConfig(pBusIdx, pBus);
+}
+
+bool CaptureLinkClient::piSendFrame(const CANFrame&)
+{
+    //the agent only serves its capture
+    return true;
+}
+
+void CaptureLinkClient::sendDebug(const QString &debugText)
+{
+    qDebug() << debugText;
+    debugOutput(debugText);
+}
@@ -0,0 +1,60 @@
+#ifndef CAPTURELINKCLIENT_H
+#define CAPTURELINKCLIENT_H
+
+#include <QTcpSocket>
+#include <QTimer>
+#include <QVector>
+
+#include "canconnection.h"
+#include "capturelink.h"
+
+//wait before trying again after the link drops or can't be made
+#define CAPTURELINKCLIENT_RETRY_MS  2000
+
+/*
+ * Watches the capture of another SavvyCAN running a CaptureAgent ("host" or "host:port"). Acceptance filters are
+ * sent to the agent, so only matching frames come over the link at all. It remembers the next sequence number while
+ * connected, so after the link drops it asks for whatever went by in the meantime, and the frames the agent
+ * no longer had are counted as lost. Sending isn't supported, the agent's buses are its own.
+ */
+class CaptureLinkClient : public CANConnection
+{
+    Q_OBJECT
+
+public:
+    CaptureLinkClient(QString pAddress);
+    virtual ~CaptureLinkClient();
+
+protected:
+    virtual void piStarted();
+    virtual void piStop();
+    virtual void piSetBusSettings(int pBusIdx, CANBus pBus);
+    virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
+    virtual void piSuspend(bool pSuspend);
+    virtual bool piSendFrame(const CANFrame&);
+    virtual bool piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters);
+
+private slots:
+    void readNetworkData();
+    void networkConnected();
+    void networkDisconnected();
+    void connectToAgent();
+
+private:
+    bool handleMessage(int pType, const QByteArray &pBody);
+    void queueBatch();
+    void sendDebug(const QString &debugText);
+
+    QTcpSocket *mSocket;
+    QTimer mRetryTimer;
+    bool mStopping = false;
+
+    QByteArray mRx;
+    quint64 mBytesReceived = 0;     //this connection, the window the agent has goes by it
+    quint64 mNextSequence = 0;      //0 until the first batch, then where to resume
+    quint64 mLostFrames = 0;
+    CaptureLink::Batch mBatch;      //reused for every batch decoded
+    QVector<QVector<CANAcceptanceFilter>> mFilters;
+};
+
+#endif // CAPTURELINKCLIENT_H
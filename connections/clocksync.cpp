@@ -0,0 +1,247 @@
+#include "clocksync.h"
+
+#include <cmath>
+#include <limits>
+
+ClockSync::ClockSync()
+{
+    mBuckets.reserve(CLOCKSYNC_BUCKETS);
+    reset();
+}
+
+void ClockSync::reset()
+{
+    mBuckets.clear();
+    mNext = 0;
+    mCurrent = {0, 0};
+    mCurrentStartUs = -1;
+    mLastDeviceUs = 0;
+    mValid = false;
+    mRefDeviceUs = 0;
+    mOffsetUs = 0.0;
+    mDrift = 0.0;
+}
+
+void ClockSync::observe(qint64 pDeviceUs, qint64 pHostUs)
+{
+    const qint64 offset = pHostUs - pDeviceUs;
+    //a frame can't get here before it was stamped. This far under means the device clock jumped ahead
+    if (mValid && offset < offsetAt(pDeviceUs) - CLOCKSYNC_STEP_US) reset();
+
+    if (mCurrentStartUs >= 0 && pHostUs - mCurrentStartUs >= CLOCKSYNC_BUCKET_US) closeBucket();
+    if (mCurrentStartUs < 0)
+    {
+        mCurrent = {pDeviceUs, offset};
+        mCurrentStartUs = pHostUs;
+    }
+    else if (offset < mCurrent.offsetUs) mCurrent = {pDeviceUs, offset};
+    mLastDeviceUs = pDeviceUs;
+
+    if (mBuckets.isEmpty())
+    {
+        //nothing to fit yet, go by the best sample so far
+        mRefDeviceUs = mCurrent.deviceUs;
+        mOffsetUs = static_cast<double>(mCurrent.offsetUs);
+        mDrift = 0.0;
+        mValid = true;
+    }
+    else if (offset < offsetAt(pDeviceUs))
+    {
+        //under the line, so the line's too high. Lower it until the next fit
+        mOffsetUs -= offsetAt(pDeviceUs) - static_cast<double>(offset);
+    }
+}
+
+void ClockSync::closeBucket()
+{
+    //even the best frame of a whole second was this late, so the device clock went back (it was reset or reconnected)
+    if (mValid && !mBuckets.isEmpty() && mCurrent.offsetUs > offsetAt(mCurrent.deviceUs) + CLOCKSYNC_STEP_US)
+    {
+        Sample keep = mCurrent;
+        reset();
+        mCurrent = keep;
+    }
+
+    if (mBuckets.count() < CLOCKSYNC_BUCKETS) mBuckets.append(mCurrent);
+    else mBuckets[mNext] = mCurrent;
+    mNext = (mNext + 1) % CLOCKSYNC_BUCKETS;
+    mCurrentStartUs = -1;
+    fit();
+}
+
+void ClockSync::fit()
+{
+    const int count = mBuckets.count();
+    //relative to the newest bucket so the doubles keep their precision
+    mRefDeviceUs = mBuckets.at((mNext + CLOCKSYNC_BUCKETS - 1) % CLOCKSYNC_BUCKETS).deviceUs;
+
+    double sumX = 0.0, sumY = 0.0;
+    for (const Sample &s : qAsConst(mBuckets))
+    {
+        sumX += static_cast<double>(s.deviceUs - mRefDeviceUs);
+        sumY += static_cast<double>(s.offsetUs);
+    }
+    const double meanX = sumX / count;
+    const double meanY = sumY / count;
+    double sxx = 0.0, sxy = 0.0;
+    for (const Sample &s : qAsConst(mBuckets))
+    {
+        const double dx = static_cast<double>(s.deviceUs - mRefDeviceUs) - meanX;
+        sxx += dx * dx;
+        sxy += dx * (static_cast<double>(s.offsetUs) - meanY);
+    }
+    mDrift = (sxx > 0.0) ? sxy / sxx : 0.0;
+    mDrift = qBound(-CLOCKSYNC_MAX_PPM * 1e-6, mDrift, CLOCKSYNC_MAX_PPM * 1e-6);
+
+    //through the middle of the samples, then down so none of them is under it
+    mOffsetUs = meanY - mDrift * meanX;
+    for (const Sample &s : qAsConst(mBuckets))
+        mOffsetUs = qMin(mOffsetUs, static_cast<double>(s.offsetUs) - mDrift * static_cast<double>(s.deviceUs - mRefDeviceUs));
+    mValid = true;
+}
+
+double ClockSync::offsetAt(qint64 pDeviceUs) const
+{
+    return mOffsetUs + mDrift * static_cast<double>(pDeviceUs - mRefDeviceUs);
+}
+
+qint64 ClockSync::toHost(qint64 pDeviceUs) const
+{
+    if (!mValid) return pDeviceUs;
+    return pDeviceUs + std::llround(offsetAt(pDeviceUs));
+}
+
+ClockSyncStatus ClockSync::status() const
+{
+    ClockSyncStatus out;
+    out.valid = mValid;
+    if (!mValid) return out;
+    out.offsetUs = std::llround(offsetAt(mLastDeviceUs));
+    out.driftPpm = mDrift * 1e6;
+    out.buckets = mBuckets.count();
+    return out;
+}
+
+MergedTimeline::MergedTimeline(qint64 pHoldUs) :
+    mHoldUs(pHoldUs)
+{
+    reset();
+}
+
+void MergedTimeline::reset()
+{
+    mSources.clear();
+    mReleasedUs = std::numeric_limits<qint64>::min();
+    mLateFrames = 0;
+}
+
+MergedTimeline::Source &MergedTimeline::source(const CANConnection *pConn_p)
+{
+    for (Source &src : mSources)
+    {
+        if (src.conn == pConn_p) return src;
+    }
+    Source src;
+    src.conn = pConn_p;
+    src.head = 0;
+    src.lastUs = std::numeric_limits<qint64>::min();
+    mSources.append(src);
+    return mSources.last();
+}
+
+void MergedTimeline::add(const CANConnection *pConn_p, QVector<CANFrame> &pFrames, qint64 pHostNowUs)
+{
+    if (pFrames.isEmpty()) return;
+    Source &src = source(pConn_p);
+
+    //the newest frame of each kind had certainly come in by now, which is what the clocks go by
+    const qint64 none = std::numeric_limits<qint64>::min();
+    qint64 newestRx = none, newestTx = none;
+    for (const CANFrame &frame : qAsConst(pFrames))
+    {
+        qint64 us = static_cast<qint64>(frame.timeStamp().microSeconds());
+        if (frame.isReceived) newestRx = qMax(newestRx, us);
+        else newestTx = qMax(newestTx, us);
+    }
+    if (newestRx != none) src.rx.observe(newestRx, pHostNowUs);
+    if (newestTx != none) src.tx.observe(newestTx, pHostNowUs);
+
+    src.pending.reserve(src.pending.count() + pFrames.count());
+    for (const CANFrame &frame : qAsConst(pFrames))
+    {
+        qint64 us = (frame.isReceived ? src.rx : src.tx).toHost(static_cast<qint64>(frame.timeStamp().microSeconds()));
+        us = qMax(us, src.lastUs);
+        src.lastUs = us;
+        src.pending.append(frame);
+        src.pending.last().setTimeStamp(QCanBusFrame::TimeStamp(0, us));
+    }
+    pFrames.clear();
+}
+
+void MergedTimeline::release(qint64 pHostNowUs, QVector<CANFrame> &pOut, bool pAll)
+{
+    const qint64 watermark = pAll ? std::numeric_limits<qint64>::max() : pHostNowUs - mHoldUs;
+    //only a handful of connections, so just look at the head of each for the oldest
+    for (;;)
+    {
+        Source *best = nullptr;
+        qint64 bestUs = 0;
+        for (Source &src : mSources)
+        {
+            if (src.head >= src.pending.count()) continue;
+            qint64 us = static_cast<qint64>(src.pending.at(src.head).timeStamp().microSeconds());
+            if (us > watermark) continue;
+            if (!best || us < bestUs)
+            {
+                best = &src;
+                bestUs = us;
+            }
+        }
+        if (!best) break;
+
+        pOut.append(best->pending.at(best->head++));
+        if (bestUs < mReleasedUs)
+        {
+            pOut.last().setTimeStamp(QCanBusFrame::TimeStamp(0, mReleasedUs));
+            mLateFrames++;
+        }
+        else mReleasedUs = bestUs;
+    }
+
+    for (Source &src : mSources)
+    {
+        if (src.head == 0) continue;
+        src.pending.remove(0, src.head);
+        src.head = 0;
+    }
+}
+
+bool MergedTimeline::hasPending() const
+{
+    for (const Source &src : mSources)
+    {
+        if (src.head < src.pending.count()) return true;
+    }
+    return false;
+}
+
+void MergedTimeline::forget(const CANConnection *pConn_p)
+{
+    for (int i = 0; i < mSources.count(); i++)
+    {
+        if (mSources.at(i).conn == pConn_p)
+        {
+            mSources.remove(i);
+            return;
+        }
+    }
+}
+
+ClockSyncStatus MergedTimeline::status(const CANConnection *pConn_p) const
+{
+    for (const Source &src : mSources)
+    {
+        if (src.conn == pConn_p) return src.rx.status();
+    }
+    return ClockSyncStatus();
+}
@@ -0,0 +1,111 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <QVector>
+#include "can_structs.h"
+
+class CANConnection;
+
+//host time each offset sample covers. The smallest offset seen in it is the one kept
+#define CLOCKSYNC_BUCKET_US     1000000
+//buckets the drift is fitted over, about half a minute
+#define CLOCKSYNC_BUCKETS       32
+//a whole bucket this far above the estimate (or one frame this far below it) means the device clock was reset
+#define CLOCKSYNC_STEP_US       500000
+//crystals are good to a few tens of ppm. Anything past this is noise in the fit, not drift
+#define CLOCKSYNC_MAX_PPM       1000.0
+//how long merged frames wait for a slower connection's frames from the same time
+#define CLOCKSYNC_HOLD_US       50000
+
+//what a ClockSync currently thinks of its device, for display
+struct ClockSyncStatus
+{
+    bool valid = false;     //false until the first frame
+    qint64 offsetUs = 0;    //host time minus device time, now
+    double driftPpm = 0.0;  //how much faster the host clock runs than the device's
+    int buckets = 0;        //one second samples the fit is over
+};
+
+/*
+ * Follows one device clock against the host clock. Every drain gives one sample: the newest frame's timestamp and
+ * the host time it had certainly been received by. The difference is the clock offset plus however long the frame
+ * took to get here, so the smallest difference in each second is the best one. Offset and drift come from a line
+ * fitted through the last CLOCKSYNC_BUCKETS of those, lowered until no sample is below it.
+ */
+class ClockSync
+{
+public:
+    ClockSync();
+
+    void observe(qint64 pDeviceUs, qint64 pHostUs);
+    qint64 toHost(qint64 pDeviceUs) const; //device time unchanged until there's been a sample
+    ClockSyncStatus status() const;
+    void reset();
+
+private:
+    struct Sample
+    {
+        qint64 deviceUs;
+        qint64 offsetUs;
+    };
+
+    void closeBucket();
+    void fit();
+    double offsetAt(qint64 pDeviceUs) const;
+
+    QVector<Sample> mBuckets; //ring, mNext is the oldest once it's full
+    int mNext;
+    Sample mCurrent;        //smallest offset in the bucket being filled
+    qint64 mCurrentStartUs; //host time that bucket started, -1 if there isn't one
+    qint64 mLastDeviceUs;
+
+    bool mValid;
+    qint64 mRefDeviceUs;    //the line is offset + drift * (device - ref)
+    double mOffsetUs;
+    double mDrift;
+};
+
+/*
+ * Frames from every connection in one stream ordered by time. Each connection's frames are moved onto the host
+ * clock by their own ClockSync (one for received frames and one for the TX copies, which were stamped by the host)
+ * and held for CLOCKSYNC_HOLD_US so frames another connection has yet to hand over can still go in ahead of them.
+ * After that they're released oldest first. A frame that turns up after later ones were already released is
+ * stamped with the last released time so the stream never goes backwards, and counted.
+ */
+class MergedTimeline
+{
+public:
+    explicit MergedTimeline(qint64 pHoldUs = CLOCKSYNC_HOLD_US);
+
+    //takes the frames out of pFrames, leaving it empty
+    void add(const CANConnection *pConn_p, QVector<CANFrame> &pFrames, qint64 pHostNowUs);
+    //appends everything stamped before pHostNowUs less the hold to pOut, oldest first. pAll releases the lot
+    void release(qint64 pHostNowUs, QVector<CANFrame> &pOut, bool pAll = false);
+    bool hasPending() const;
+
+    void forget(const CANConnection *pConn_p); //drops its clocks. Release its frames first
+    void reset();
+
+    ClockSyncStatus status(const CANConnection *pConn_p) const;
+    quint64 lateFrames() const { return mLateFrames; }
+
+private:
+    struct Source
+    {
+        const CANConnection *conn;
+        ClockSync rx;
+        ClockSync tx;
+        QVector<CANFrame> pending;
+        int head;
+        qint64 lastUs; //keeps the connection's own frames in the order it sent them
+    };
+
+    Source &source(const CANConnection *pConn_p);
+
+    QVector<Source> mSources;
+    qint64 mHoldUs;
+    qint64 mReleasedUs; //time of the last frame released
+    quint64 mLateFrames;
+};
+
+#endif // CLOCKSYNC_H
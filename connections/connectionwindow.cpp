@@ -10,11 +10,14 @@
 #include "connections/canconmanager.h"
 #include "canbus.h"
 #include <QSettings>
+#include <QFile>
+#include <QFileDialog>
 #include <connections/newconnectiondialog.h>
 
 ConnectionWindow::ConnectionWindow(QWidget *parent) :
     QDialog(parent),
-    ui(new Ui::ConnectionWindow)
+    ui(new Ui::ConnectionWindow),
+    consoleDropped(0)
 {
     ui->setupUi(this);
     setWindowFlags(Qt::Window);
@@ -45,9 +48,10 @@ ConnectionWindow::ConnectionWindow(QWidget *parent) :
 
     if (settings.value("Main/SaveRestoreConnections", false).toBool())
     {
-        /* load connection configuration */
-        loadConnections();
-    }    
+        /* load connection configuration once the event loop runs. Each connection opens and validates on its own
+           thread and shows up in the table as it resolves, so a missing adapter doesn't hold up the main window */
+        QTimer::singleShot(0, this, &ConnectionWindow::loadConnections);
+    }
 
     connect(ui->btnDisconnect, &QPushButton::clicked, this, &ConnectionWindow::handleRemoveConn);
     connect(ui->btnSendHex, &QPushButton::clicked, this, &ConnectionWindow::handleSendHex);
@@ -61,6 +65,18 @@ ConnectionWindow::ConnectionWindow(QWidget *parent) :
     connect(ui->btnSaveBus, &QPushButton::clicked, this, &ConnectionWindow::saveBusSettings);
     connect(ui->btnMoveUp, &QPushButton::clicked, this, &ConnectionWindow::moveConnUp);
     connect(ui->btnMoveDown, &QPushButton::clicked, this, &ConnectionWindow::moveConnDown);
+    connect(ui->btnResetTelemetry, &QPushButton::clicked, this, &ConnectionWindow::handleResetTelemetry);
+    connect(ui->btnExportTelemetry, &QPushButton::clicked, this, &ConnectionWindow::handleExportTelemetry);
+
+    //only ticks while the window is showing
+    telemetryTimer.setInterval(1000);
+    connect(&telemetryTimer, &QTimer::timeout, this, &ConnectionWindow::refreshTelemetry);
+    ui->tableTelemetry->verticalHeader()->hide();
+
+    //the console is only filled from here, a tick's worth at a time, so a chatty device can't swamp the GUI
+    consoleTimer.setInterval(CONNECTIONWINDOW_CONSOLE_MS);
+    connect(&consoleTimer, &QTimer::timeout, this, &ConnectionWindow::drainConsole);
+    ui->textConsole->document()->setMaximumBlockCount(CONNECTIONWINDOW_CONSOLE_LINES);
 
     ui->cbBusSpeed->addItem("33333");
     ui->cbBusSpeed->addItem("50000");
@@ -173,15 +189,201 @@ void ConnectionWindow::showEvent(QShowEvent* event)
     readSettings();
     ui->tableConnections->selectRow(0);
     currentRowChanged(ui->tableConnections->currentIndex(), ui->tableConnections->currentIndex());
+    refreshTelemetry();
+    telemetryTimer.start();
+    consoleTimer.start();
 }
 
 void ConnectionWindow::closeEvent(QCloseEvent *event)
 {
     Q_UNUSED(event);
+    telemetryTimer.stop();
+    consoleTimer.stop();
+    attachConsole(nullptr); //nobody would see it
     removeEventFilter(this);
     writeSettings();
 }
 
+//One column per connection plus the total. The table and the export are built from this so they always agree
+QVector<QStringList> ConnectionWindow::telemetryTable(bool pHistogram)
+{
+    QList<CANConnection*> conns = CANConManager::getInstance()->getConnections();
+    QVector<CANConTelemetry> stats;
+    CANConTelemetry total;
+    foreach (CANConnection *conn_p, conns)
+    {
+        stats.append(conn_p->getTelemetry());
+        total.merge(stats.last());
+    }
+    stats.append(total);
+
+    QVector<QStringList> table;
+    QStringList header;
+    header << tr("Counter");
+    foreach (CANConnection *conn_p, conns) header << conn_p->getPort();
+    header << tr("All");
+    table.append(header);
+
+    auto addRow = [&](const QString &name, auto value)
+    {
+        QStringList row;
+        row << name;
+        foreach (const CANConTelemetry &stat, stats) row << value(stat);
+        table.append(row);
+    };
+
+    addRow(tr("Frames in"), [](const CANConTelemetry &t) { return QString::number(t.framesIn); });
+    addRow(tr("Frames dropped"), [](const CANConTelemetry &t) { return QString::number(t.framesDropped); });
+    addRow(tr("Queue depth"), [](const CANConTelemetry &t) { return QString::number(t.queueDepth); });
+    addRow(tr("Queue high water"), [](const CANConTelemetry &t) { return QString::number(t.queueHighWater); });
+    addRow(tr("Queue capacity"), [](const CANConTelemetry &t) { return QString::number(t.queueCapacity); });
+    addRow(tr("Drains"), [](const CANConTelemetry &t) { return QString::number(t.drains); });
+    addRow(tr("Largest batch"), [](const CANConTelemetry &t) { return QString::number(t.largestBatch); });
+    addRow(tr("Latency 50% (us)"), [](const CANConTelemetry &t) { return QString::number(t.latencyPercentile(0.5)); });
+    addRow(tr("Latency 99% (us)"), [](const CANConTelemetry &t) { return QString::number(t.latencyPercentile(0.99)); });
+    addRow(tr("Latency max (us)"), [](const CANConTelemetry &t) { return QString::number(t.latencyPercentile(1.0)); });
+    addRow(tr("Frames sent"), [](const CANConTelemetry &t) { return QString::number(t.framesSent); });
+    addRow(tr("TX pending bytes"), [](const CANConTelemetry &t) { return QString::number(t.txPendingBytes); });
+    addRow(tr("TX backlog bytes"), [](const CANConTelemetry &t) { return (t.txBacklogBytes < 0) ? QString("-") : QString::number(t.txBacklogBytes); });
+
+    //bus load rows go by the connection's own bus numbers, as many as the connection with the most buses has
+    int maxBuses = 0;
+    foreach (CANConnection *conn_p, conns) maxBuses = qMax(maxBuses, conn_p->getNumBuses());
+    for (int bus = 0; bus < maxBuses; bus++)
+    {
+        QStringList row;
+        row << tr("Bus %1 load %, now / avg / peak").arg(bus);
+        foreach (CANConnection *conn_p, conns)
+        {
+            CANBusLoad load = conn_p->getBusLoad(bus);
+            if (bus >= conn_p->getNumBuses() || !load.known) row << QString("-");
+            else row << QString("%1 / %2 / %3").arg(load.current, 0, 'f', 1).arg(load.average, 0, 'f', 1).arg(load.peak, 0, 'f', 1);
+        }
+        row << QString();
+        table.append(row);
+    }
+
+    //connection clocks are only followed while their frames are being merged
+    QStringList clock;
+    clock << tr("Clock offset (us) / drift (ppm)");
+    foreach (CANConnection *conn_p, conns)
+    {
+        ClockSyncStatus sync = CANConManager::getInstance()->getClockSync(conn_p);
+        if (!sync.valid) clock << QString("-");
+        else clock << QString("%1 / %2").arg(sync.offsetUs).arg(sync.driftPpm, 0, 'f', 1);
+    }
+    clock << QString();
+    table.append(clock);
+
+    if (pHistogram)
+    {
+        for (int i = 0; i < CANCON_LATENCY_BUCKETS; i++)
+        {
+            QString name = (i < CANCON_LATENCY_BUCKETS - 1) ? tr("Latency < %1 us").arg(static_cast<qint64>(1) << i)
+                                                            : tr("Latency >= %1 us").arg(static_cast<qint64>(1) << (i - 1));
+            addRow(name, [i](const CANConTelemetry &t) { return QString::number(t.latency.value(i)); });
+        }
+    }
+
+    //the manager's own numbers only make sense for the total
+    QStringList busless;
+    busless << tr("Frames sent with no connection");
+    for (int i = 0; i < conns.count(); i++) busless << QString();
+    busless << QString::number(CANConManager::getInstance()->getBuslessFrames());
+    table.append(busless);
+    QStringList interval;
+    interval << tr("Batch interval (us)");
+    for (int i = 0; i < conns.count(); i++) interval << QString();
+    interval << QString::number(CANConManager::getInstance()->getBatchInterval());
+    table.append(interval);
+    QStringList late;
+    late << tr("Frames merged late");
+    for (int i = 0; i < conns.count(); i++) late << QString();
+    late << QString::number(CANConManager::getInstance()->getLateMergedFrames());
+    table.append(late);
+    TxSchedulerStats tx = CANConManager::getInstance()->getTxStats();
+    const QString txNames[TX_CLASSES] = { tr("TX protocol sent / late / dropped"), tr("TX periodic sent / late / dropped"),
+                                          tr("TX bulk sent / late / dropped") };
+    for (int c = 0; c < TX_CLASSES; c++)
+    {
+        QStringList row;
+        row << txNames[c];
+        for (int i = 0; i < conns.count(); i++) row << QString();
+        row << QString("%1 / %2 / %3").arg(tx.classes[c].sent).arg(tx.classes[c].late).arg(tx.classes[c].dropped);
+        table.append(row);
+    }
+    QStringList waiting;
+    waiting << tr("TX frames waiting");
+    for (int i = 0; i < conns.count(); i++) waiting << QString();
+    waiting << QString::number(tx.waiting);
+    table.append(waiting);
+
+    return table;
+}
+
+void ConnectionWindow::refreshTelemetry()
+{
+    QVector<QStringList> table = telemetryTable(false);
+    const QStringList &header = table.first();
+
+    ui->tableTelemetry->setColumnCount(header.count());
+    ui->tableTelemetry->setRowCount(table.count() - 1);
+    ui->tableTelemetry->setHorizontalHeaderLabels(header);
+    for (int row = 1; row < table.count(); row++)
+    {
+        for (int col = 0; col < table[row].count(); col++)
+        {
+            QTableWidgetItem *item = ui->tableTelemetry->item(row - 1, col);
+            if (!item)
+            {
+                item = new QTableWidgetItem();
+                ui->tableTelemetry->setItem(row - 1, col, item);
+            }
+            item->setText(table[row][col]);
+        }
+    }
+}
+
+void ConnectionWindow::handleResetTelemetry()
+{
+    CANConManager::getInstance()->resetTelemetry();
+    refreshTelemetry();
+}
+
+void ConnectionWindow::handleExportTelemetry()
+{
+    QFileDialog dialog(this);
+    QSettings settings;
+
+    QStringList filters;
+    filters.append(QString(tr("Spreadsheet (*.csv)")));
+
+    dialog.setFileMode(QFileDialog::AnyFile);
+    dialog.setNameFilters(filters);
+    dialog.setViewMode(QFileDialog::Detail);
+    dialog.setAcceptMode(QFileDialog::AcceptSave);
+    dialog.setDirectory(settings.value("Connections/LoadSaveDirectory", dialog.directory().path()).toString());
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    QString filename = dialog.selectedFiles().constFirst();
+    settings.setValue("Connections/LoadSaveDirectory", dialog.directory().path());
+    if (!filename.contains('.')) filename += ".csv";
+
+    QFile outFile(filename);
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text)) return;
+
+    //port names can have commas in them (socketcand, native SocketCAN) so every cell is quoted
+    foreach (const QStringList &row, telemetryTable(true))
+    {
+        QStringList quoted;
+        foreach (QString cell, row) quoted << "\"" + cell.replace("\"", "\"\"") + "\"";
+        outFile.write(quoted.join(',').toUtf8());
+        outFile.write("\n");
+    }
+    outFile.close();
+}
+
 bool ConnectionWindow::eventFilter(QObject *obj, QEvent *event)
 {
     if (event->type() == QEvent::KeyRelease) {
@@ -236,11 +438,11 @@ void ConnectionWindow::consoleEnableChanged(bool checked) {
     CANConnection* conn_p = connModel->getAtIdx(selIdx);
 
     if (checked) { //enable console
-        connect(conn_p, &CANConnection::debugOutput, this, &ConnectionWindow::getDebugText, Qt::UniqueConnection);
+        attachConsole(conn_p);
         connect(this, &ConnectionWindow::sendDebugData, conn_p, &CANConnection::debugInput, Qt::UniqueConnection);
     }
     else { //turn it off
-        disconnect(conn_p, &CANConnection::debugOutput, nullptr, nullptr);
+        attachConsole(nullptr);
         disconnect(this, &ConnectionWindow::sendDebugData, conn_p, &CANConnection::debugInput);
     }
 }
@@ -452,13 +654,12 @@ void ConnectionWindow::currentTabChanged(int newIdx)
 void ConnectionWindow::currentRowChanged(const QModelIndex &current, const QModelIndex &previous)
 {
     int selIdx = current.row();
-    CANConnection* prevConn = connModel->getAtIdx(previous.row());
-    if(prevConn != nullptr)
-        disconnect(prevConn, &CANConnection::debugOutput, nullptr, nullptr);
+    Q_UNUSED(previous);
     disconnect(this, &ConnectionWindow::sendDebugData, nullptr, nullptr);
 
     /* set parameters */
     if (selIdx == -1) {
+        attachConsole(nullptr);
         ui->groupBus->setEnabled(false);
         return;
     }
@@ -469,11 +670,10 @@ void ConnectionWindow::currentRowChanged(const QModelIndex &current, const QMode
         int numBuses;
 
         CANConnection* conn_p = connModel->getAtIdx(selIdx);
+        //switching straight over, so a connection that was already capturing keeps what it has
+        attachConsole(ui->ckEnableConsole->isChecked() ? conn_p : nullptr);
         if(!conn_p) return;
 
-        //because this might have already been setup during the initial setup so tear that one down and then create the normal one.
-        //disconnect(conn_p, &CANConnection::debugOutput, 0, 0);
-
         numBuses = conn_p->getNumBuses();
         int numB = ui->tabBuses->count();
         for (int i = 0; i < numB; i++) ui->tabBuses->removeTab(0);
@@ -485,14 +685,41 @@ void ConnectionWindow::currentRowChanged(const QModelIndex &current, const QMode
         populateBusDetails(0);
         if (ui->ckEnableConsole->isChecked())
         {
-            connect(conn_p, &CANConnection::debugOutput, this, &ConnectionWindow::getDebugText, Qt::UniqueConnection);
             connect(this, &ConnectionWindow::sendDebugData, conn_p, &CANConnection::debugInput, Qt::UniqueConnection);
         }
     }
 }
 
-void ConnectionWindow::getDebugText(QString debugText) {
-    ui->textConsole->append(debugText);
+//only one connection captures at a time. Whatever one had left from the last time it was shown is stale by now
+void ConnectionWindow::attachConsole(CANConnection *conn_p)
+{
+    if (consoleConn == conn_p) return;
+    if (consoleConn) consoleConn->getDebugLog().setCapturing(false);
+    consoleConn = conn_p;
+    if (!conn_p) return;
+
+    DebugLog &log = conn_p->getDebugLog();
+    log.discard();
+    consoleDropped = log.dropped();
+    log.setCapturing(true);
+}
+
+void ConnectionWindow::drainConsole()
+{
+    if (!consoleConn) return;
+    DebugLog &log = consoleConn->getDebugLog();
+
+    QString text;
+    log.drain(text, DEBUGLOG_RECORDS);
+    const quint32 dropped = log.dropped();
+    if (dropped != consoleDropped)
+    {
+        if (!text.isEmpty()) text += QLatin1Char('\n');
+        text += tr("(%1 debug messages dropped)").arg(dropped - consoleDropped);
+        consoleDropped = dropped;
+    }
+    //one append for the whole tick rather than a layout per line
+    if (!text.isEmpty()) ui->textConsole->append(text);
 }
 
 void ConnectionWindow::handleClearDebugText() {
@@ -528,7 +755,7 @@ CANConnection* ConnectionWindow::create(CANCon::type pTye, QString pPortName, QS
         if (ui->ckEnableConsole->isChecked())
         {            
             //set up the debug console to operate if we've selected it. Doing so here allows debugging right away during set up
-            connect(conn_p, &CANConnection::debugOutput, this, &ConnectionWindow::getDebugText, Qt::UniqueConnection);
+            attachConsole(conn_p);
         }
         /*TODO add return value and checks */
         conn_p->start();
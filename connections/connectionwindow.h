@@ -9,11 +9,16 @@
 #include <QSettings>
 #include <QTimer>
 #include <QItemSelection>
+#include <QPointer>
 #include <QCanBusDeviceInfo>
 #include <QUdpSocket>
 #include "canconnectionmodel.h"
 #include "connections/canconnection.h"
 
+//how often the console takes what the connection it shows has to say
+#define CONNECTIONWINDOW_CONSOLE_MS     100
+//lines the console keeps, the oldest go once it has more
+#define CONNECTIONWINDOW_CONSOLE_LINES  2000
 
 class CANConnectionModel;
 
@@ -36,7 +41,6 @@ signals:
     void sendDebugData(QByteArray bytes);
 
 public slots:
-    void getDebugText(QString debugText);
     void setSuspendAll(bool pSuspend);
 
 
@@ -55,6 +59,10 @@ private slots:
     void moveConnDown();
     void connectionStatus(CANConStatus);
     void readPendingDatagrams();
+    void refreshTelemetry();
+    void handleResetTelemetry();
+    void handleExportTelemetry();
+    void drainConsole();
 
 private:
     Ui::ConnectionWindow *ui;    
@@ -64,9 +72,15 @@ private:
     QUdpSocket *rxBroadcastKayak;
     QVector<QString> remoteDeviceIPGVRET;
     QVector<QString> remoteDeviceKayak;
+    QTimer telemetryTimer;
+    QTimer consoleTimer;
+    QPointer<CANConnection> consoleConn; //the one capturing for the console, if any
+    quint32 consoleDropped; //its drop count as of the last line about it
 
     CANConnection* create(CANCon::type pTye, QString pPortName, QString pDriver, int pSerialSpeed, int pBusSpeed, bool pCanFd, int pDataRate);
     void populateBusDetails(int offset);
+    void attachConsole(CANConnection *conn_p);
+    QVector<QStringList> telemetryTable(bool pHistogram);
     void loadConnections();
     void saveConnections();
     void showEvent(QShowEvent *);
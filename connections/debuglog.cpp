@@ -0,0 +1,107 @@
+#include "debuglog.h"
+
+#include <cstring>
+
+DebugLog::DebugLog() :
+    mCapturing(0),
+    mWriting(0),
+    mWindowStart(0),
+    mWindowCount(0)
+{
+    mRing.setSize(DEBUGLOG_RECORDS);
+    mClock.start();
+}
+
+void DebugLog::setCapturing(bool pCapturing)
+{
+    mCapturing.storeRelaxed(pCapturing ? 1 : 0);
+}
+
+void DebugLog::add(DebugKind pKind, const char *pData, int pLen)
+{
+    if (!isCapturing() || pLen < 0) return;
+
+    //somebody else is adding. Dropping it beats making a device thread wait on the console
+    if (!mWriting.testAndSetAcquire(0, 1))
+    {
+        mRing.drop();
+        return;
+    }
+
+    const qint64 now = mClock.elapsed();
+    if (now - mWindowStart >= DEBUGLOG_WINDOW_MS)
+    {
+        mWindowStart = now;
+        mWindowCount = 0;
+    }
+
+    if (mWindowCount >= DEBUGLOG_WINDOW_RECORDS) mRing.drop();
+    else if (DebugRecord *record = mRing.get()) //counts it as dropped itself when full
+    {
+        const int length = qMin(pLen, DEBUGLOG_RECORD_BYTES);
+        record->fullLength = static_cast<quint32>(pLen);
+        record->length = static_cast<quint16>(length);
+        record->kind = static_cast<quint8>(pKind);
+        if (length > 0) memcpy(record->bytes, pData, static_cast<size_t>(length));
+        mRing.queue();
+        mWindowCount++;
+    }
+
+    mWriting.storeRelease(0);
+}
+
+void DebugLog::addText(const QString &pText)
+{
+    if (!isCapturing()) return;
+    const QByteArray utf8 = pText.toUtf8();
+    add(DEBUG_TEXT, utf8.constData(), utf8.length());
+}
+
+int DebugLog::drain(QString &pOut, int pMax)
+{
+    int taken = 0;
+    while (taken < pMax)
+    {
+        int available;
+        const DebugRecord *records = mRing.peekSpan(available);
+        if (!records) break;
+
+        available = qMin(available, pMax - taken);
+        for (int i = 0; i < available; i++)
+        {
+            if (!pOut.isEmpty()) pOut += QLatin1Char('\n');
+            pOut += format(records[i]);
+        }
+        mRing.dequeue(available);
+        taken += available;
+    }
+    return taken;
+}
+
+void DebugLog::discard()
+{
+    int available;
+    while (mRing.peekSpan(available)) mRing.dequeue(available);
+}
+
+QString DebugLog::format(const DebugRecord &pRecord)
+{
+    const QByteArray bytes = QByteArray::fromRawData(pRecord.bytes, pRecord.length);
+    const bool cut = pRecord.fullLength > pRecord.length;
+
+    QString text;
+    switch (pRecord.kind)
+    {
+    case DEBUG_RX_BYTES:
+        text = QStringLiteral("Got data from serial. Len = %1 -> ").arg(pRecord.fullLength) + QString::fromLatin1(bytes.toHex(' '));
+        break;
+    case DEBUG_TX_BYTES:
+        text = QStringLiteral("Write to serial -> ") + QString::fromLatin1(bytes.toHex(' '));
+        break;
+    default:
+        text = QString::fromUtf8(bytes);
+        break;
+    }
+    if (cut) text += QStringLiteral(" ... (%1 bytes)").arg(pRecord.fullLength);
+    return text;
+}
@@ -0,0 +1,72 @@
+#ifndef DEBUGLOG_H
+#define DEBUGLOG_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include "utils/lfqueue.h"
+
+//records a console can have waiting. Past that new ones are dropped and counted
+#define DEBUGLOG_RECORDS            1024
+//text or raw bytes a record keeps. Longer ones are cut short but still say how long they were
+#define DEBUGLOG_RECORD_BYTES       244
+//no more than this many records get in per window, so one chatty device can't bury the console
+#define DEBUGLOG_WINDOW_MS          100
+#define DEBUGLOG_WINDOW_RECORDS     50
+
+enum DebugKind
+{
+    DEBUG_TEXT = 0,
+    DEBUG_RX_BYTES,     //raw bytes read from the device
+    DEBUG_TX_BYTES      //raw bytes written to it
+};
+
+struct DebugRecord
+{
+    quint32 fullLength;
+    quint16 length;
+    quint8 kind;
+    char bytes[DEBUGLOG_RECORD_BYTES];
+};
+
+/*
+ * What a connection has to say to the console. Nothing is recorded unless capturing is on, which the connection
+ * window only does for the connection its console is showing, so everything else costs one atomic load. What is
+ * recorded goes into a fixed ring as the raw text or bytes. The hex dumps and the QStrings are only made by the
+ * console when it takes them out, and only as many as it is going to show.
+ *
+ * Usually it's the working thread that adds, but anything may. A flag keeps it to one producer at a time and whoever
+ * finds it taken drops the record instead of waiting. Drops from that, a full ring or the rate limit all land in
+ * dropped(). drain() and discard() are for the GUI thread only.
+ */
+class DebugLog
+{
+public:
+    DebugLog();
+
+    void setCapturing(bool pCapturing);
+    bool isCapturing() const { return mCapturing.loadRelaxed() != 0; }
+
+    void add(DebugKind pKind, const char *pData, int pLen);
+    void addText(const QString &pText);
+
+    //formats up to pMax records onto the end of pOut, a line each. Returns how many
+    int drain(QString &pOut, int pMax);
+    void discard(); //throws out whatever is waiting
+
+    //records that never made it in. Wraps at 2^32, take differences
+    quint32 dropped() const { return mRing.dropped(); }
+
+    static QString format(const DebugRecord &pRecord);
+
+private:
+    LFQueue<DebugRecord> mRing;
+    QAtomicInt mCapturing;
+    QAtomicInt mWriting;
+    QElapsedTimer mClock;
+    qint64 mWindowStart; //the rest are only touched by whoever holds mWriting
+    int mWindowCount;
+};
+
+#endif // DEBUGLOG_H
@@ -0,0 +1,402 @@
+#include <QDebug>
+#include <QSettings>
+
+#include "frameserver.h"
+#include "canconmanager.h"
+
+namespace
+{
+const char hexDigits[] = "0123456789ABCDEF";
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+const char *skipSpaces(const char *p, const char *end)
+{
+    while (p < end && *p == ' ') p++;
+    return p;
+}
+
+//the word at p, p moved past it
+QByteArray nextWord(const char *&p, const char *end)
+{
+    p = skipSpaces(p, end);
+    const char *start = p;
+    while (p < end && *p != ' ') p++;
+    return QByteArray(start, static_cast<int>(p - start));
+}
+
+bool parseHex(const QByteArray &word, quint32 &value)
+{
+    if (word.isEmpty() || word.size() > 8) return false;
+    value = 0;
+    for (char c : word)
+    {
+        int v = hexValue(c);
+        if (v < 0) return false;
+        value = (value << 4) | static_cast<quint32>(v);
+    }
+    return true;
+}
+}
+
+FrameServer::FrameServer(QObject *parent) :
+    QObject(parent),
+    mQueueLimit(FRAMESERVER_QUEUE_BYTES),
+    mMulticast(nullptr),
+    mGroupPort(0)
+{
+    connect(&mServer, &QTcpServer::newConnection, this, &FrameServer::newConnection);
+}
+
+FrameServer::~FrameServer()
+{
+    stop();
+}
+
+bool FrameServer::start(quint16 pPort, QString &pError)
+{
+    if (mServer.isListening()) return true;
+    if (!mServer.listen(QHostAddress::Any, pPort))
+    {
+        pError = mServer.errorString();
+        return false;
+    }
+
+    QSettings settings;
+    mQueueLimit = qMax(64 * 1024, settings.value("FrameServer/QueueBytes", FRAMESERVER_QUEUE_BYTES).toInt());
+    QString group = settings.value("FrameServer/MulticastGroup", "").toString().trimmed();
+    if (!group.isEmpty())
+    {
+        if (!mGroup.setAddress(group) || !mGroup.isMulticast())
+        {
+            mServer.close();
+            pError = tr("%1 is not a multicast address").arg(group);
+            return false;
+        }
+        mGroupPort = static_cast<quint16>(settings.value("FrameServer/MulticastPort", FRAMESERVER_PORT + 1).toUInt());
+        mMulticast = new QUdpSocket(this);
+        mMulticast->setSocketOption(QAbstractSocket::MulticastTtlOption, settings.value("FrameServer/MulticastTTL", 1).toInt());
+        qDebug() << QString("Frame server: multicasting to %1 from port %2").arg(group).arg(mGroupPort);
+    }
+
+    connect(CANConManager::getInstance(), &CANConManager::framesCaptured, this, &FrameServer::framesCaptured);
+    qDebug() << QString("Frame server: serving socketcand raw mode on port %1").arg(pPort);
+    return true;
+}
+
+void FrameServer::stop()
+{
+    disconnect(CANConManager::getInstance(), &CANConManager::framesCaptured, this, &FrameServer::framesCaptured);
+    mServer.close();
+    for (Client *client : qAsConst(mClients))
+    {
+        client->socket->disconnect(this);
+        client->socket->abort();
+        client->socket->deleteLater();
+        delete client;
+    }
+    mClients.clear();
+    delete mMulticast;
+    mMulticast = nullptr;
+    mEncoded.clear();
+    mClientOut.clear();
+    mDatagrams.clear();
+}
+
+void FrameServer::newConnection()
+{
+    while (QTcpSocket *socket = mServer.nextPendingConnection())
+    {
+        Client *client = new Client;
+        client->socket = socket;
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::readyRead, this, &FrameServer::clientReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &FrameServer::clientGone);
+        mClients.append(client);
+        reply(*client, "< hi >");
+        qDebug() << "Frame server: client connected from " + socket->peerAddress().toString();
+    }
+}
+
+FrameServer::Client *FrameServer::clientFor(QObject *pSocket)
+{
+    for (Client *client : qAsConst(mClients))
+    {
+        if (client->socket == pSocket) return client;
+    }
+    return nullptr;
+}
+
+void FrameServer::clientGone()
+{
+    Client *client = clientFor(sender());
+    if (!client) return;
+    qDebug() << "Frame server: client at " + client->socket->peerAddress().toString() + " went away";
+    mClients.removeOne(client);
+    client->socket->deleteLater();
+    delete client;
+}
+
+void FrameServer::reply(Client &pClient, const char *pText)
+{
+    pClient.socket->write(pText);
+}
+
+void FrameServer::clientReadyRead()
+{
+    Client *client = clientFor(sender());
+    if (!client) return;
+    client->rx.append(client->socket->readAll());
+
+    const char *start = client->rx.constData();
+    const char *p = start;
+    const char *end = start + client->rx.size();
+    while (p < end)
+    {
+        const char *open = static_cast<const char *>(memchr(p, '<', static_cast<size_t>(end - p)));
+        if (!open)
+        {
+            p = end;
+            break;
+        }
+        const char *close = static_cast<const char *>(memchr(open, '>', static_cast<size_t>(end - open)));
+        if (!close)
+        {
+            p = open;
+            break;
+        }
+        handleCommand(*client, open + 1, close);
+        p = close + 1;
+    }
+    client->rx.remove(0, static_cast<int>(p - start));
+    //nobody sends a command this long, it's not talking socketcand
+    if (client->rx.size() > 4096)
+    {
+        qDebug() << "Frame server: dropping client at " + client->socket->peerAddress().toString() + ", not a socketcand client";
+        client->socket->abort();
+    }
+}
+
+void FrameServer::handleCommand(Client &pClient, const char *p, const char *end)
+{
+    while (end > p && end[-1] == ' ') end--;
+    const QByteArray command = nextWord(p, end);
+
+    if (command == "open")
+    {
+        //"can0", "vcan1" and so on, the number at the end is the bus. "any" is all of them
+        const QByteArray channel = nextWord(p, end);
+        int digits = channel.size();
+        while (digits > 0 && channel[digits - 1] >= '0' && channel[digits - 1] <= '9') digits--;
+        bool ok = false;
+        int bus = channel.mid(digits).toInt(&ok);
+        if (channel == "any") pClient.bus = -1;
+        else if (ok && bus < CANConManager::getInstance()->getNumBuses()) pClient.bus = bus;
+        else
+        {
+            reply(pClient, "< error could not open bus >");
+            return;
+        }
+        pClient.state = OPENED;
+        reply(pClient, "< ok >");
+    }
+    else if (command == "rawmode")
+    {
+        if (pClient.state == GREETED)
+        {
+            reply(pClient, "< error open a bus first >");
+            return;
+        }
+        pClient.state = RAW;
+        reply(pClient, "< ok >");
+    }
+    else if (command == "send")
+    {
+        CANFrame frame;
+        if (pClient.state != RAW || !parseSend(p, end, frame))
+        {
+            reply(pClient, "< error bad send command >");
+            return;
+        }
+        frame.bus = qMax(0, pClient.bus);
+        CANConManager::getInstance()->sendFrame(frame);
+    }
+    else if (command == "filter")
+    {
+        const QByteArray idWord = nextWord(p, end);
+        if (idWord.isEmpty())
+        {
+            pClient.filters.clear();
+            reply(pClient, "< ok >");
+            return;
+        }
+        CANAcceptanceFilter filter;
+        const QByteArray maskWord = nextWord(p, end);
+        if (!parseHex(idWord, filter.id) || (!maskWord.isEmpty() && !parseHex(maskWord, filter.mask)))
+        {
+            reply(pClient, "< error bad filter >");
+            return;
+        }
+        if (maskWord.isEmpty()) filter.mask = 0x1FFFFFFF;
+        pClient.filters.append(filter);
+        reply(pClient, "< ok >");
+    }
+    else if (command == "echo") reply(pClient, "< echo >");
+    else reply(pClient, "< error unknown command >");
+}
+
+//"<id> <len> <byte> <byte>..." all in hex except len. An ID written with 8 digits or with bit 31 set is extended
+bool FrameServer::parseSend(const char *p, const char *end, CANFrame &frame) const
+{
+    const QByteArray idWord = nextWord(p, end);
+    quint32 id;
+    if (!parseHex(idWord, id)) return false;
+    bool ok;
+    const int len = nextWord(p, end).toInt(&ok);
+    if (!ok || len < 0 || len > 64) return false;
+
+    QByteArray payload;
+    payload.reserve(len);
+    for (int i = 0; i < len; i++)
+    {
+        quint32 byte;
+        if (!parseHex(nextWord(p, end), byte) || byte > 0xFF) return false;
+        payload.append(static_cast<char>(byte));
+    }
+
+    const bool extended = idWord.size() == 8 || (id & 0x80000000u) || (id & 0x1FFFFFFF) > 0x7FF;
+    frame.setFrameType(QCanBusFrame::DataFrame);
+    frame.setExtendedFrameFormat(extended);
+    frame.setFrameId(id & 0x1FFFFFFF);
+    frame.setFlexibleDataRateFormat(len > 8);
+    frame.isReceived = false;
+    frame.setPayload(payload);
+    return true;
+}
+
+//"< frame 123 1700000000.123456 DEADBEEF >", extended IDs always with 8 digits like socketcand does
+void FrameServer::appendFrame(QByteArray &pOut, const CANFrame &frame)
+{
+    char buf[64 * 2 + 64];
+    char *w = buf;
+    memcpy(w, "< frame ", 8);
+    w += 8;
+    const quint32 id = frame.frameId();
+    for (int shift = frame.hasExtendedFrameFormat() ? 28 : 8; shift >= 0; shift -= 4) *w++ = hexDigits[(id >> shift) & 0xF];
+    *w++ = ' ';
+
+    const qint64 stamp = qMax<qint64>(0, static_cast<qint64>(frame.timeStamp().microSeconds()));
+    char digits[24];
+    int n = 0;
+    qint64 secs = stamp / 1000000;
+    do
+    {
+        digits[n++] = static_cast<char>('0' + secs % 10);
+        secs /= 10;
+    } while (secs);
+    while (n) *w++ = digits[--n];
+    *w++ = '.';
+    int micros = static_cast<int>(stamp % 1000000);
+    for (int div = 100000; div; div /= 10) *w++ = static_cast<char>('0' + (micros / div) % 10);
+    *w++ = ' ';
+
+    const QByteArray payload = frame.payload();
+    const int len = qMin(payload.size(), 64);
+    for (int i = 0; i < len; i++)
+    {
+        const uint8_t b = static_cast<uint8_t>(payload[i]);
+        *w++ = hexDigits[b >> 4];
+        *w++ = hexDigits[b & 0xF];
+    }
+    memcpy(w, " >", 2);
+    w += 2;
+    pOut.append(buf, static_cast<int>(w - buf));
+}
+
+void FrameServer::framesCaptured(const QVector<CANFrame> &pFrames)
+{
+    if (mClients.isEmpty() && !mMulticast) return;
+
+    //formatted once, every client gets its frames as slices of the same bytes
+    mEncoded.clear();
+    mOffsets.clear();
+    for (const CANFrame &frame : pFrames)
+    {
+        mOffsets.append(mEncoded.size());
+        if (frame.frameType() == QCanBusFrame::DataFrame) appendFrame(mEncoded, frame);
+    }
+    mOffsets.append(mEncoded.size());
+
+    for (Client *client : qAsConst(mClients))
+    {
+        if (client->state != RAW) continue;
+        //a full queue means it isn't keeping up. It misses these rather than holding anyone up
+        if (client->socket->bytesToWrite() >= mQueueLimit)
+        {
+            client->dropped += static_cast<quint64>(pFrames.count());
+            continue;
+        }
+        if (client->dropped)
+        {
+            qDebug() << QString("Frame server: client at %1 was too slow, dropped %2 frames")
+                        .arg(client->socket->peerAddress().toString()).arg(client->dropped);
+            client->dropped = 0;
+        }
+
+        if (client->bus < 0 && client->filters.isEmpty())
+        {
+            client->socket->write(mEncoded);
+            continue;
+        }
+        mClientOut.clear();
+        for (int i = 0; i < pFrames.count(); i++)
+        {
+            const CANFrame &frame = pFrames.at(i);
+            if (client->bus >= 0 && frame.bus != client->bus) continue;
+            bool pass = client->filters.isEmpty();
+            for (const CANAcceptanceFilter &f : client->filters)
+            {
+                if (((frame.frameId() ^ f.id) & f.mask) == 0)
+                {
+                    pass = true;
+                    break;
+                }
+            }
+            if (pass) mClientOut.append(mEncoded.constData() + mOffsets[i], mOffsets[i + 1] - mOffsets[i]);
+        }
+        if (!mClientOut.isEmpty()) client->socket->write(mClientOut);
+    }
+
+    if (mMulticast) sendMulticast(pFrames);
+}
+
+//a datagram per bus per batch, or more when they'd go over FRAMESERVER_DATAGRAM_BYTES
+void FrameServer::sendMulticast(const QVector<CANFrame> &pFrames)
+{
+    for (int i = 0; i < pFrames.count(); i++)
+    {
+        const int len = mOffsets[i + 1] - mOffsets[i];
+        const int bus = pFrames.at(i).bus;
+        if (len == 0 || bus < 0 || bus > 0xFFFF - mGroupPort) continue;
+        if (mDatagrams.count() <= bus) mDatagrams.resize(bus + 1);
+        QByteArray &datagram = mDatagrams[bus];
+        if (datagram.size() + len > FRAMESERVER_DATAGRAM_BYTES)
+        {
+            mMulticast->writeDatagram(datagram, mGroup, static_cast<quint16>(mGroupPort + bus));
+            datagram.clear();
+        }
+        datagram.append(mEncoded.constData() + mOffsets[i], len);
+    }
+    for (int bus = 0; bus < mDatagrams.count(); bus++)
+    {
+        if (mDatagrams[bus].isEmpty()) continue;
+        mMulticast->writeDatagram(mDatagrams[bus], mGroup, static_cast<quint16>(mGroupPort + bus));
+        mDatagrams[bus].clear();
+    }
+}
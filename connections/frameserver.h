@@ -0,0 +1,93 @@
+#ifndef FRAMESERVER_H
+#define FRAMESERVER_H
+
+#include <QHostAddress>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QVector>
+
+#include "can_structs.h"
+
+//socketcand's own port, so tools find it where they look by default. The FrameServer/Port setting changes it
+#define FRAMESERVER_PORT            29536
+//bytes a client may have waiting to go out before its frames are dropped, unless the FrameServer/QueueBytes setting says otherwise
+#define FRAMESERVER_QUEUE_BYTES     (1024 * 1024)
+//multicast datagrams are kept under the usual ethernet MTU so they don't fragment
+#define FRAMESERVER_DATAGRAM_BYTES  1400
+
+/*
+ * Fans what this SavvyCAN captures out to other tools, speaking socketcand's raw mode so anything that can talk to
+ * socketcand (SavvyCAN's own socketcand connection, python-can, socketcandcl and so on) can watch it live.
+ * A client gets "< hi >", opens a channel with "< open can0 >" (the number is the bus, "any" is every bus), switches
+ * to "< rawmode >" and from then on gets "< frame id secs.usecs data >" for each frame. "< send id len bytes >" puts
+ * a frame out on its bus. "< filter id mask >" is ours, each one adds an acceptance filter to that client and a
+ * bare "< filter >" clears them.
+ *
+ * Frames come from CANConManager::framesCaptured like CaptureAgent's. Each one is formatted once per batch and the
+ * same bytes go to every client that wants it. A client that can't keep up isn't waited for: once it has
+ * FRAMESERVER_QUEUE_BYTES queued its frames are dropped until it catches up, and the count of what it missed
+ * goes to the debug output. Capture never slows down for a client.
+ *
+ * The same frames can also go to a UDP multicast group (the FrameServer/MulticastGroup setting, off when empty),
+ * each bus to its own port counting up from FrameServer/MulticastPort so a receiver joins only the buses it wants.
+ * Datagrams hold whole frame messages in the same text format.
+ */
+class FrameServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameServer(QObject *parent = nullptr);
+    ~FrameServer();
+
+    bool start(quint16 pPort, QString &pError);
+    void stop();
+    bool isRunning() const { return mServer.isListening(); }
+    int clientCount() const { return mClients.count(); }
+
+private slots:
+    void newConnection();
+    void framesCaptured(const QVector<CANFrame> &pFrames);
+    void clientReadyRead();
+    void clientGone();
+
+private:
+    enum State
+    {
+        GREETED,    //said hi, waiting for the open
+        OPENED,     //waiting for rawmode
+        RAW         //frames flow
+    };
+
+    struct Client
+    {
+        QTcpSocket *socket;
+        QByteArray rx;
+        State state = GREETED;
+        int bus = -1;   //-1 is every bus
+        QVector<CANAcceptanceFilter> filters; //empty passes everything
+        quint64 dropped = 0; //since it last caught up
+    };
+
+    Client *clientFor(QObject *pSocket);
+    void handleCommand(Client &pClient, const char *p, const char *end);
+    bool parseSend(const char *p, const char *end, CANFrame &frame) const;
+    void reply(Client &pClient, const char *pText);
+    void sendMulticast(const QVector<CANFrame> &pFrames);
+    static void appendFrame(QByteArray &pOut, const CANFrame &frame);
+
+    QTcpServer mServer;
+    QVector<Client *> mClients;
+    qint64 mQueueLimit;
+    QUdpSocket *mMulticast;
+    QHostAddress mGroup;
+    quint16 mGroupPort;
+    QByteArray mEncoded;        //the batch formatted once, reused between batches
+    QVector<int> mOffsets;      //where each frame starts in mEncoded, one past the end last
+    QByteArray mClientOut;      //a filtered client's share of the batch
+    QVector<QByteArray> mDatagrams; //by bus
+};
+
+#endif // FRAMESERVER_H
@@ -3,7 +3,7 @@
 #include <QCanBusFrame>
 #include <QSerialPortInfo>
 #include <QSettings>
-#include <QStringBuilder>
+#include <QtEndian>
 #include <QtNetwork>
 
 #include "gvretserial.h"
@@ -11,6 +11,7 @@
 GVRetSerial::GVRetSerial(QString portName, bool useTcp) :
     CANConnection(portName, "gvret", CANCon::GVRET_SERIAL, 0, 0, false, 0, 3, 4000, true),
     mTimer(this), /*NB: set this as parent of timer to manage it from working thread */
+    mReconnectTimer(this),
     useTcp(useTcp)
 {
     sendDebug("GVRetSerial()");
@@ -28,6 +29,21 @@ GVRetSerial::GVRetSerial(QString portName, bool useTcp) :
     lastSystemTimeBasis = 0;
     timeAtGVRETSync = 0;
 
+    stopping = false;
+    reconnectDelay = GVRET_RECONNECT_MIN_MS;
+    seqMode = false;
+    seqEverStarted = false;
+    seqKnown = false;
+    resendPending = false;
+    seqWindow = GVRET_SEQ_WINDOW;
+    nextSeq = 0;
+    rxSeq = 0;
+    framesSinceAck = 0;
+    lostFrames = 0;
+
+    mReconnectTimer.setSingleShot(true);
+    connect(&mReconnectTimer, &QTimer::timeout, this, &GVRetSerial::connectDevice);
+
     readSettings();
 }
 
@@ -70,13 +86,7 @@ void GVRetSerial::sendToSerial(const QByteArray &bytes)
         return;
     }
 
-    QString buildDebug;
-    buildDebug = "Write to serial -> ";
-    foreach (int byt, bytes) {
-        byt = (unsigned char)byt;
-        buildDebug = buildDebug % QString::number(byt, 16) % " ";
-    }
-    sendDebug(buildDebug);
+    debugBytes(DEBUG_TX_BYTES, bytes);
 
     if (serial) serial->write(bytes);
     if (tcpClient) tcpClient->write(bytes);
@@ -85,6 +95,7 @@ void GVRetSerial::sendToSerial(const QByteArray &bytes)
 
 void GVRetSerial::piStarted()
 {    
+    stopping = false;
     connectDevice();
 }
 
@@ -102,8 +113,11 @@ void GVRetSerial::piSuspend(bool pSuspend)
 
 void GVRetSerial::piStop()
 {
+    stopping = true;
     mTimer.stop();
+    mReconnectTimer.stop();
     disconnectDevice();
+    if (lostFrames > 0) sendDebug(QString("GVRET: %1 frames were lost in all").arg(lostFrames));
 }
 
 
@@ -230,8 +244,6 @@ void GVRetSerial::piSetBusSettings(int pBusIdx, CANBus bus)
 
 bool GVRetSerial::piSendFrame(const CANFrame& frame)
 {
-    QByteArray buffer;
-    int c;
     quint32 ID;
 
     //qDebug() << "Sending out GVRET frame with id " << frame.ID << " on bus " << frame.bus;
@@ -252,26 +264,42 @@ bool GVRetSerial::piSendFrame(const CANFrame& frame)
     ID = frame.frameId();
     if (frame.hasExtendedFrameFormat()) ID |= 1u << 31;
 
-    buffer[0] = (char)0xF1; //start of a command over serial
-    buffer[1] = 0; //command ID for sending a CANBUS frame
-    buffer[2] = (char)(ID & 0xFF); //four bytes of ID LSB first
-    buffer[3] = (char)(ID >> 8);
-    buffer[4] = (char)(ID >> 16);
-    buffer[5] = (char)(ID >> 24);
-    buffer[6] = (char)((frame.bus) & 3);
-    buffer[7] = (char)frame.payload().length();
-    for (c = 0; c < frame.payload().length(); c++)
-    {
-        buffer[8 + c] = frame.payload()[c];
-    }
-    buffer[8 + frame.payload().length()] = 0;
-
-    sendToSerial(buffer);
+    //goes on the end of whatever else is waiting to be written
+    QByteArray &buffer = txBuffer();
+    const QByteArray payload = frame.payload();
+    buffer.append((char)0xF1); //start of a command over serial
+    buffer.append((char)0); //command ID for sending a CANBUS frame
+    buffer.append((char)(ID & 0xFF)); //four bytes of ID LSB first
+    buffer.append((char)(ID >> 8));
+    buffer.append((char)(ID >> 16));
+    buffer.append((char)(ID >> 24));
+    buffer.append((char)((frame.bus) & 3));
+    buffer.append((char)payload.length());
+    buffer.append(payload);
+    buffer.append((char)0);
+
+    txQueued();
 
     return true;
 }
 
 
+void GVRetSerial::piWriteTx(int pBusIdx, const QByteArray& pBytes)
+{
+    Q_UNUSED(pBusIdx)
+    sendToSerial(pBytes);
+}
+
+
+qint64 GVRetSerial::piTxBacklog()
+{
+    if (serial) return serial->bytesToWrite();
+    if (tcpClient) return tcpClient->bytesToWrite();
+    if (udpClient) return udpClient->bytesToWrite();
+    return -1;
+}
+
+
 
 /****************************************************************/
 
@@ -301,25 +329,25 @@ void GVRetSerial::connectDevice()
 
     /* open new device */
 
-    if (useTcp)
+    if (useTcp && getPort().startsWith("udp://", Qt::CaseInsensitive))
+    {
+        sendDebug("UDP Connection to a GVRET device");
+        udpClient = new QUdpSocket();
+        udpClient->connectToHost(getPort().mid(6), GVRET_UDP_PORT);
+        connect(udpClient, SIGNAL(readyRead()), this, SLOT(readSerialData()));
+        sendDebug("Created UDP Socket");
+        //nothing to wait for, whether anybody is there shows when the validation replies do or don't come
+        deviceConnected();
+    }
+    else if (useTcp)
     {
-        // /*
         sendDebug("TCP Connection to a GVRET device");
         tcpClient = new QTcpSocket();
         tcpClient->connectToHost(getPort(), 23);
         connect(tcpClient, SIGNAL(readyRead()), this, SLOT(readSerialData()));
         connect(tcpClient, SIGNAL(connected()), this, SLOT(deviceConnected()));
+        connect(tcpClient, &QTcpSocket::stateChanged, this, &GVRetSerial::linkStateChanged);
         sendDebug("Created TCP Socket");
-        // */
-        /*
-        qDebug() << "UDP Connection to a GVRET device";
-        udpClient = new QUdpSocket();
-        udpClient->connectToHost(getPort(), 17222);
-        connect(udpClient, SIGNAL(readyRead()), this, SLOT(readSerialData()));
-        //connect(udpClient, SIGNAL(connected()), this, SLOT(tcpConnected()));
-        debugOutput("Created UDP Socket");
-        tcpConnected();
-        */
     }
     else {
         sendDebug("Serial connection to a GVRET device");
@@ -405,11 +433,25 @@ void GVRetSerial::deviceConnected()
     output.append((char)0xF1); //yet another command
     output.append((char)0x09); //comm validation command
 
+    output.append((char)0xF1);
+    output.append((char)0x18); //sequenced streaming query. Stock firmware doesn't answer and nothing changes
+
     continuousTimeSync = true;
+    validationCounter = 10;
+    seqKnown = false;
+    resendPending = false;
+    framesSinceAck = 0;
+    if (isNetwork()) reconnectDelay = GVRET_RECONNECT_MIN_MS;
 
     sendToSerial(output);
 
     if(doValidation) {
+        //shown as connecting until the device answers, it's all asynchronous from here
+        setStatus(CANCon::CONNECTING);
+        CANConStatus stats;
+        stats.conStatus = getStatus();
+        stats.numHardwareBuses = mNumBuses;
+        emit status(stats);
         QTimer::singleShot(5000, this, SLOT(connectionTimeout()));
     }
     else {
@@ -436,11 +478,11 @@ void GVRetSerial::disconnectDevice() {
     }
     if (tcpClient != nullptr)
     {
+        tcpClient->disconnect(); //before closing, so closing it doesn't look like the link dropping
         if (tcpClient->isOpen())
         {
             tcpClient->close();
         }
-        tcpClient->disconnect();
         delete tcpClient;
         tcpClient = nullptr;
     }
@@ -549,8 +591,8 @@ void GVRetSerial::serialError(QSerialPort::SerialPortError err)
 
 void GVRetSerial::connectionTimeout()
 {
-    //one second after trying to connect are we actually connected?
-    if (CANCon::NOT_CONNECTED==getStatus()) //no?
+    //five seconds after trying to connect are we actually connected?
+    if (CANCon::CONNECTED!=getStatus()) //no?
     {
         //then emit the the failure signal and see if anyone cares
         sendDebug("Failed to connect to GVRET at that com port");
@@ -563,7 +605,8 @@ void GVRetSerial::connectionTimeout()
     else
     {
         /* start timer */
-        connect(&mTimer, SIGNAL(timeout()), this, SLOT(handleTick()));
+        //unique as this runs again after every reconnect
+        connect(&mTimer, &QTimer::timeout, this, &GVRetSerial::handleTick, Qt::UniqueConnection);
         mTimer.setInterval(250); //tick four times per second
         mTimer.setSingleShot(false); //keep ticking
         mTimer.start();
@@ -574,23 +617,124 @@ void GVRetSerial::connectionTimeout()
 void GVRetSerial::readSerialData()
 {
     QByteArray data;
-    unsigned char c;
-    QString debugBuild;
 
     if (serial) data = serial->readAll();
     if (tcpClient) data = tcpClient->readAll();
-    if (udpClient) data = udpClient->readAll();
+    if (udpClient)
+    {
+        //a datagram at a time, each one starts with its own sequence marker
+        while (udpClient->hasPendingDatagrams())
+        {
+            QByteArray datagram(static_cast<int>(udpClient->pendingDatagramSize()), 0);
+            udpClient->readDatagram(datagram.data(), datagram.size());
+            data.append(datagram);
+        }
+    }
+
+    //only the raw bytes are kept, the console makes the hex out of the few it actually shows
+    debugBytes(DEBUG_RX_BYTES, data);
 
-    sendDebug("Got data from serial. Len = " % QString::number(data.length()));
-    for (int i = 0; i < data.length(); i++)
+    procRXData(reinterpret_cast<const uint8_t *>(data.constData()), data.length());
+}
+
+/*
+ * Chew through a whole read at once. Whenever the state machine is idle and a complete CAN or CAN-FD frame is
+ * sitting in the buffer it gets decoded in one go straight into a queue slot. Everything else (replies, frames that
+ * are split across reads) goes through procRXChar a byte at a time like always.
+ */
+void GVRetSerial::procRXData(const uint8_t *data, int len)
+{
+    int i = 0;
+    while (i < len)
     {
-        c = data.at(i);
-        //qDebug() << c << "    " << QString::number(c, 16) << "     " << QString(c);
-        debugBuild = debugBuild % QString::number(c, 16).rightJustified(2,'0') % " ";
-        procRXChar(c);
+        if (rx_state == IDLE && data[i] == 0xF1 && i + 1 < len && (data[i + 1] == 0 || data[i + 1] == 20))
+        {
+            int used = procRXFrame(data + i + 2, len - i - 2, data[i + 1] == 20);
+            if (used > 0)
+            {
+                i += 2 + used;
+                continue;
+            }
+        }
+        procRXChar(data[i]);
+        i++;
+    }
+}
+
+/*
+ * data points just past the command byte. Layout is timestamp (4), ID (4, bit 31 = extended) then for standard
+ * frames one byte of bus << 4 | length, for FD frames a length byte and a bus byte, then the data bytes.
+ * Returns how many bytes the frame took or 0 if it isn't all there yet.
+ */
+int GVRetSerial::procRXFrame(const uint8_t *data, int avail, bool fd)
+{
+    int headerLen = fd ? 10 : 9;
+    if (avail < headerLen) return 0;
+    int dataLen = fd ? (data[8] & 0x3F) : (data[8] & 0xF);
+    if (avail < headerLen + dataLen) return 0;
+
+    //counted whether it's kept or not so the sequence stays right
+    if (!takeSequenced() || isCapSuspended()) return headerLen + dataLen;
+
+    CANFrame *frame_p = getQueue().get();
+    if (!frame_p)
+    {
+        qDebug() << "can't get a frame, ERROR";
+        return headerLen + dataLen;
+    }
+
+    qint64 timestamp = qFromLittleEndian<quint32>(data) + timeBasis;
+    if (useSystemTime) timestamp = QDateTime::currentMSecsSinceEpoch() * 1000l;
+    quint32 id = qFromLittleEndian<quint32>(data + 4);
+    bool extended = (id & 0x80000000u) != 0;
+
+    frame_p->setTimeStamp(QCanBusFrame::TimeStamp(0, timestamp));
+    frame_p->setFrameType(QCanBusFrame::FrameType::DataFrame);
+    frame_p->setFrameId(id & 0x7FFFFFFF);
+    frame_p->setExtendedFrameFormat(extended);
+    frame_p->setFlexibleDataRateFormat(fd);
+    frame_p->setBitrateSwitch(false);
+    frame_p->setErrorStateIndicator(false);
+    frame_p->setLocalEcho(false);
+    frame_p->bus = fd ? data[9] : ((data[8] & 0xF0) >> 4);
+    frame_p->isReceived = true;
+    frame_p->timedelta = 0;
+    frame_p->frameCount = 1;
+
+    fillPayload(*frame_p, data + headerLen, dataLen);
+
+    checkTargettedFrame(*frame_p);
+    getQueue().queue();
+    notifyFramesQueued();
+    return headerLen + dataLen;
+}
+
+//procRXChar finished a frame in buildFrame/buildData. Hand it off to the queue
+void GVRetSerial::queueBuiltFrame()
+{
+    rx_state = IDLE;
+    rx_step = 0;
+    buildFrame.isReceived = true;
+    buildFrame.setPayload(buildData);
+    buildFrame.setFrameType(QCanBusFrame::FrameType::DataFrame);
+    if (takeSequenced() && !isCapSuspended())
+    {
+        /* get frame from queue */
+        CANFrame* frame_p = getQueue().get();
+        if(frame_p) {
+            /* copy frame */
+            *frame_p = buildFrame;
+            checkTargettedFrame(buildFrame);
+            /* enqueue frame */
+            getQueue().queue();
+            notifyFramesQueued();
+        }
+        else
+            qDebug() << "can't get a frame, ERROR";
+
+        //take the time the frame came in and try to resync the time base.
+        //if (continuousTimeSync) txTimestampBasis = QDateTime::currentMSecsSinceEpoch() - (buildFrame.timestamp / 1000);
     }
-    debugOutput(debugBuild);
-    //qDebug() << debugBuild;
 }
 
 //Debugging data sent from connection window. Inject it into Comm traffic.
@@ -665,6 +809,21 @@ void GVRetSerial::procRXChar(unsigned char c)
             rx_step = 0;
             qDebug() << "Got FD settings reply";
             break;
+        case 24:
+            rx_state = GET_SEQ_INFO;
+            rx_step = 0;
+            seqBytes.clear();
+            break;
+        case 25:
+            rx_state = GET_SEQ_START;
+            rx_step = 0;
+            seqBytes.clear();
+            break;
+        case 26:
+            rx_state = GET_SEQ_MARK;
+            rx_step = 0;
+            seqBytes.clear();
+            break;
         }
         break;
     case BUILD_CAN_FRAME:
@@ -711,6 +870,12 @@ void GVRetSerial::procRXChar(unsigned char c)
         case 8:
             buildData.resize(c & 0xF);
             buildFrame.bus = (c & 0xF0) >> 4;
+            buildFrame.setFlexibleDataRateFormat(false);
+            if (buildData.length() == 0) //no data bytes coming so the frame is already done
+            {
+                queueBuiltFrame();
+                return;
+            }
             break;
         default:
             if (rx_step < buildData.length() + 9)
@@ -718,29 +883,8 @@ void GVRetSerial::procRXChar(unsigned char c)
                 buildData[rx_step - 9] = c;
                 if (rx_step == buildData.length() + 8) //it's the last data byte so immediately process the frame
                 {
-                    rx_state = IDLE;
-                    rx_step = 0;
-                    buildFrame.isReceived = true;
-                    buildFrame.setPayload(buildData);
-                    buildFrame.setFrameType(QCanBusFrame::FrameType::DataFrame);
-                    if (!isCapSuspended())
-                    {
-                        /* get frame from queue */
-                        CANFrame* frame_p = getQueue().get();
-                        if(frame_p) {
-                            //qDebug() << "GVRET got frame on bus " << frame_p->bus;
-                            /* copy frame */
-                            *frame_p = buildFrame;
-                            checkTargettedFrame(buildFrame);
-                            /* enqueue frame */
-                            getQueue().queue();
-                        }
-                        else
-                            qDebug() << "can't get a frame, ERROR";
-
-                        //take the time the frame came in and try to resync the time base.
-                        //if (continuousTimeSync) txTimestampBasis = QDateTime::currentMSecsSinceEpoch() - (buildFrame.timestamp / 1000);
-                    }
+                    queueBuiltFrame();
+                    return;
                 }
             }
             else //should never get here! But, just in case, reset the comm
@@ -798,37 +942,28 @@ void GVRetSerial::procRXChar(unsigned char c)
             break;
         case 9:
             buildFrame.bus = c;
+            buildFrame.setFlexibleDataRateFormat(true);
+            if (buildData.length() == 0)
+            {
+                queueBuiltFrame();
+                return;
+            }
             break;
         default:
+            //data starts right after the bus byte at step 10
             if (rx_step < buildData.length() + 10)
             {
-                buildData[rx_step - 9] = c;
+                buildData[rx_step - 10] = c;
+                if (rx_step == buildData.length() + 9)
+                {
+                    queueBuiltFrame();
+                    return;
+                }
             }
             else
             {
                 rx_state = IDLE;
                 rx_step = 0;
-                buildFrame.isReceived = true;
-                buildFrame.setPayload(buildData);
-                buildFrame.setFrameType(QCanBusFrame::FrameType::DataFrame);
-                if (!isCapSuspended())
-                {
-                    /* get frame from queue */
-                    CANFrame* frame_p = getQueue().get();
-                    if(frame_p) {
-                        //qDebug() << "GVRET got frame on bus " << frame_p->bus;
-                        /* copy frame */
-                        *frame_p = buildFrame;
-                        checkTargettedFrame(buildFrame);
-                        /* enqueue frame */
-                        getQueue().queue();
-                    }
-                    else
-                        qDebug() << "can't get a frame, ERROR";
-
-                    //take the time the frame came in and try to resync the time base.
-                    //if (continuousTimeSync) txTimestampBasis = QDateTime::currentMSecsSinceEpoch() - (buildFrame.timestamp / 1000);
-                }
             }
             break;
         }
@@ -1013,6 +1148,35 @@ void GVRetSerial::procRXChar(unsigned char c)
         break;
     case GET_FD_SETTINGS:
         break;
+    case GET_SEQ_INFO: //version and how many frames it can keep
+        seqBytes.append(static_cast<char>(c));
+        if (seqBytes.length() == 3)
+        {
+            rx_state = IDLE;
+            quint16 window = qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(seqBytes.constData()) + 1);
+            seqWindow = qBound<quint32>(1, window, GVRET_SEQ_WINDOW);
+            sendDebug(QString("GVRET: device does sequenced streaming (version %1), keeping %2 frames for resends")
+                      .arg(static_cast<uint8_t>(seqBytes.at(0))).arg(seqWindow));
+            sendSeqStart(seqEverStarted, nextSeq);
+        }
+        break;
+    case GET_SEQ_START: //oldest frame it has and the next one's number
+        seqBytes.append(static_cast<char>(c));
+        if (seqBytes.length() == 8)
+        {
+            rx_state = IDLE;
+            const uchar *b = reinterpret_cast<const uchar *>(seqBytes.constData());
+            seqStarted(qFromLittleEndian<quint32>(b), qFromLittleEndian<quint32>(b + 4));
+        }
+        break;
+    case GET_SEQ_MARK:
+        seqBytes.append(static_cast<char>(c));
+        if (seqBytes.length() == 4)
+        {
+            rx_state = IDLE;
+            seqMarker(qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(seqBytes.constData())));
+        }
+        break;
     case GET_EXT_BUSES:
         switch (rx_step)
         {
@@ -1110,7 +1274,7 @@ void GVRetSerial::handleTick()
         //qDebug() << validationCounter;
         if (validationCounter == 0 && doValidation)
         {
-            if (serial == nullptr && tcpClient == nullptr) return;
+            if (serial == nullptr && tcpClient == nullptr && udpClient == nullptr) return;
             if ( (serial && serial->isOpen()) || (tcpClient && tcpClient->isOpen()) || (udpClient && udpClient->isOpen())) //if it's still false we have a problem...
             {
                 sendDebug("Comm validation failed.");
@@ -1118,9 +1282,10 @@ void GVRetSerial::handleTick()
                 setStatus(CANCon::NOT_CONNECTED);
                 //emit status(getStatus());
 
+                //network devices come back by themselves once the link does, so keep trying for them
+                bool reconnect = isNetwork();
                 disconnectDevice(); //start by stopping everything.
-                //Then wait 500ms and restart the connection automatically
-                //QTimer::singleShot(500, this, SLOT(connectDevice()));
+                if (reconnect) scheduleReconnect();
                 return;
             }
         }
@@ -1132,6 +1297,8 @@ void GVRetSerial::handleTick()
     if (doValidation && serial && serial->isOpen()) sendCommValidation();
     if (doValidation && tcpClient && tcpClient->isOpen()) sendCommValidation();
     if (doValidation && udpClient && udpClient->isOpen()) sendCommValidation();
+
+    if (seqMode && framesSinceAck > 0) sendSeqAck();
 }
 
 
@@ -1147,3 +1314,125 @@ void GVRetSerial::sendCommValidation()
 
 
 
+
+//the socket went away under us. Only TCP can tell, UDP finds out by the validation replies stopping
+void GVRetSerial::linkStateChanged(QAbstractSocket::SocketState state)
+{
+    if (state != QAbstractSocket::UnconnectedState || stopping) return;
+    sendDebug("GVRET: lost the connection to the device");
+    mTimer.stop();
+    //not deleted from inside its own signal, the reconnect does that
+    scheduleReconnect();
+}
+
+void GVRetSerial::scheduleReconnect()
+{
+    if (stopping || mReconnectTimer.isActive()) return;
+    if (getStatus() != CANCon::NOT_CONNECTED)
+    {
+        setStatus(CANCon::NOT_CONNECTED);
+        CANConStatus stats;
+        stats.conStatus = getStatus();
+        stats.numHardwareBuses = mNumBuses;
+        emit status(stats);
+    }
+    sendDebug(QString("GVRET: reconnecting in %1 ms").arg(reconnectDelay));
+    mReconnectTimer.start(reconnectDelay);
+    reconnectDelay = qMin(reconnectDelay * 2, GVRET_RECONNECT_MAX_MS);
+}
+
+void GVRetSerial::sendSeqStart(bool resume, quint32 from)
+{
+    QByteArray output;
+    uchar field[4];
+    output.append((char)0xF1);
+    output.append((char)0x19);
+    output.append(resume ? (char)1 : (char)0);
+    qToLittleEndian<quint32>(from, field);
+    output.append(reinterpret_cast<const char *>(field), 4);
+    qToLittleEndian<quint16>(static_cast<quint16>(seqWindow), field);
+    output.append(reinterpret_cast<const char *>(field), 2);
+    sendToSerial(output);
+}
+
+void GVRetSerial::sendSeqAck()
+{
+    QByteArray output;
+    uchar field[4];
+    output.append((char)0xF1);
+    output.append((char)0x1B);
+    qToLittleEndian<quint32>(nextSeq, field);
+    output.append(reinterpret_cast<const char *>(field), 4);
+    sendToSerial(output);
+    framesSinceAck = 0;
+}
+
+//the device's answer to a start or resend request
+void GVRetSerial::seqStarted(quint32 oldest, quint32 next)
+{
+    if (!seqEverStarted)
+    {
+        nextSeq = next;
+        seqEverStarted = true;
+    }
+    else if (static_cast<qint32>(next - nextSeq) < 0)
+    {
+        //its numbers went backward so it was restarted, whatever it had kept went with it
+        sendDebug("GVRET: device was restarted, frames from while it was away are lost");
+        nextSeq = next;
+    }
+    else if (static_cast<qint32>(oldest - nextSeq) > 0)
+    {
+        reportGap(nextSeq, oldest - nextSeq);
+        nextSeq = oldest;
+    }
+    seqMode = true;
+    seqKnown = false;
+    resendPending = false;
+}
+
+void GVRetSerial::seqMarker(quint32 seq)
+{
+    if (!seqMode) return;
+    rxSeq = seq;
+    seqKnown = true;
+    qint32 ahead = static_cast<qint32>(seq - nextSeq);
+    if (ahead <= 0)
+    {
+        resendPending = false; //might be the resend, the ones already had get skipped
+        return;
+    }
+
+    //frames went missing before this one
+    if (!resendPending)
+    {
+        sendDebug(QString("GVRET: %1 frames went missing, asking for them again").arg(ahead));
+        resendPending = true;
+        resendTimer.start();
+        sendSeqStart(true, nextSeq);
+    }
+    else if (resendTimer.elapsed() >= GVRET_RESEND_WAIT_MS)
+    {
+        //it isn't coming, carry on from here
+        reportGap(nextSeq, static_cast<quint32>(ahead));
+        nextSeq = seq;
+        resendPending = false;
+    }
+}
+
+//for every frame that comes in. False if it's one the capture already has or one past a hole being filled again
+bool GVRetSerial::takeSequenced()
+{
+    if (!seqMode || !seqKnown) return true;
+    quint32 seq = rxSeq++;
+    if (seq != nextSeq) return false;
+    nextSeq++;
+    if (++framesSinceAck >= qMax<quint32>(seqWindow / 4, 1)) sendSeqAck();
+    return true;
+}
+
+void GVRetSerial::reportGap(quint32 first, quint32 count)
+{
+    lostFrames += count;
+    sendDebug(QString("GVRET: gap in the capture, %1 frames lost (%2 to %3)").arg(count).arg(first).arg(first + count - 1));
+}
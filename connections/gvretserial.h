@@ -5,6 +5,7 @@
 #include <QCanBusDevice>
 #include <QThread>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QTcpSocket>
 #include <QUdpSocket>
 
@@ -34,11 +35,41 @@ enum STATE
     GET_NUM_BUSES,
     GET_EXT_BUSES,
     BUILD_FD_FRAME,
-    GET_FD_SETTINGS
+    GET_FD_SETTINGS,
+    GET_SEQ_INFO,
+    GET_SEQ_START,
+    GET_SEQ_MARK
 };
 
 }
 
+//network GVRET devices on UDP are given as udp://address, anything else is TCP on port 23
+#define GVRET_UDP_PORT          17222
+//frames asked for the device to keep around for resending. It can say it keeps fewer
+#define GVRET_SEQ_WINDOW        8192
+//a resend that hasn't shown up by then isn't coming, the frames are counted lost
+#define GVRET_RESEND_WAIT_MS    500
+//between tries to get a network device back, doubling from the first up to the last
+#define GVRET_RECONNECT_MIN_MS  250
+#define GVRET_RECONNECT_MAX_MS  5000
+
+/*
+ * Sequenced streaming is an extension firmware can opt into. Stock firmware never answers the query so nothing
+ * changes for it. All numbers are little endian and the commands are numbered past the stock ones:
+ *
+ *  host   F1 18                                    which sequencing the device does, if any
+ *  device F1 18 u8 version, u16 window             the most frames it can keep for resending
+ *  host   F1 19 u8 resume, u32 from, u16 window    start (resume = 0) or carry on resending from frame 'from' (1)
+ *  device F1 19 u32 oldest, u32 next               oldest frame it still has and the number the next one gets
+ *  device F1 1A u32 sequence                       the number of the next frame it sends. At least once per
+ *                                                  packet and first thing in every UDP datagram
+ *  host   F1 1B u32 next                           everything before next arrived, the device can let it go
+ *
+ * A marker past the next expected frame means frames went missing (a lost datagram, or the device ran out of
+ * room). Everything after it is ignored while the missing ones are asked for again. Whatever doesn't come back
+ * within GVRET_RESEND_WAIT_MS, or that the device no longer has, is reported as a gap.
+ */
+
 using namespace SERIALSTATE;
 class GVRetSerial : public CANConnection
 {
@@ -56,6 +87,8 @@ protected:
     virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
     virtual void piSuspend(bool pSuspend);
     virtual bool piSendFrame(const CANFrame&) ;
+    virtual void piWriteTx(int pBusIdx, const QByteArray& pBytes);
+    virtual qint64 piTxBacklog();
 
     void disconnectDevice();
 
@@ -69,17 +102,30 @@ private slots:
     void serialError(QSerialPort::SerialPortError err);
     void deviceConnected();
     void handleTick();
+    void linkStateChanged(QAbstractSocket::SocketState state);
 
 private:
     void readSettings();
+    void procRXData(const uint8_t *data, int len);
+    int procRXFrame(const uint8_t *data, int avail, bool fd);
     void procRXChar(unsigned char);
+    void queueBuiltFrame();
     void sendCommValidation();
     void rebuildLocalTimeBasis();
     void sendToSerial(const QByteArray &bytes);
     void sendDebug(const QString debugText);
+    bool isNetwork() const { return tcpClient || udpClient; }
+    void scheduleReconnect();
+    void sendSeqStart(bool resume, quint32 from);
+    void sendSeqAck();
+    void seqMarker(quint32 seq);
+    void seqStarted(quint32 oldest, quint32 next);
+    bool takeSequenced();
+    void reportGap(quint32 first, quint32 count);
 
 protected:
     QTimer             mTimer;
+    QTimer             mReconnectTimer;
     QThread            mThread;
 
     bool doValidation;
@@ -107,6 +153,24 @@ protected:
     int32_t timeBasis;
     uint64_t lastSystemTimeBasis;
     uint64_t timeAtGVRETSync;
+
+    //link recovery. Network devices get reconnected until the connection is stopped
+    bool stopping;
+    int reconnectDelay;
+
+    //sequenced streaming, only once the device has answered the query. Sequence numbers wrap and are compared
+    //by their signed difference
+    bool seqMode;
+    bool seqEverStarted;    //nextSeq means something, so a reconnect resumes from it
+    bool seqKnown;          //a marker came since the last start so rxSeq is good
+    bool resendPending;
+    quint32 seqWindow;
+    quint32 nextSeq;        //the frame the capture wants next
+    quint32 rxSeq;          //the number of the next frame off the wire
+    quint32 framesSinceAck;
+    quint64 lostFrames;
+    QElapsedTimer resendTimer;
+    QByteArray seqBytes;    //replies being put together
 };
 
 #endif // GVRETSERIAL_H
@@ -3,12 +3,38 @@
 #include <QCanBusFrame>
 #include <QSerialPortInfo>
 #include <QSettings>
-#include <QStringBuilder>
 #include <QtNetwork>
 
 #include "lawicel_serial.h"
 #include "utility.h"
 
+//an adapter timestamp this far behind the read it came in is taken as the adapter's clock having wandered off
+#define LAWICEL_MAX_LAG_US  1000000
+
+namespace
+{
+inline int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+//count hex digits at p as one number. -1 if any of them isn't one
+inline qint64 hexValue(const char *p, int count)
+{
+    qint64 value = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int nibble = hexNibble(p[i]);
+        if (nibble < 0) return -1;
+        value = (value << 4) | nibble;
+    }
+    return value;
+}
+}
+
 LAWICELSerial::LAWICELSerial(QString portName, int serialSpeed, int lawicelSpeed, bool canFd, int dataRate) :
     CANConnection(portName, "LAWICEL", CANCon::LAWICEL,serialSpeed, lawicelSpeed, canFd, dataRate, 3, 4000, true),
     mTimer(this) /*NB: set this as parent of timer to manage it from working thread */
@@ -17,6 +43,19 @@ LAWICELSerial::LAWICELSerial(QString portName, int serialSpeed, int lawicelSpeed
 
     serial = nullptr;
     isAutoRestart = false;
+    useAcceptance = false;
+    acceptCode = 0;
+    acceptMask = 0xFFFFFFFF;
+
+    mHostBaseUs = 0;
+    mAdapterOffsetUs = 0;
+    mLastAdapterMs = -1;
+    mSlots = nullptr;
+    mSlotsGranted = 0;
+    mSlotsUsed = 0;
+    mSlotsDropped = 0;
+    badLines = 0;
+    mLine.reserve(LAWICEL_MAX_LINE);
 
     readSettings();
 }
@@ -48,13 +87,7 @@ void LAWICELSerial::sendToSerial(const QByteArray &bytes)
         return;
     }
 
-    QString buildDebug;
-    buildDebug = "Write to serial -> ";
-    foreach (int byt, bytes) {
-        byt = (unsigned char)byt;
-        buildDebug = buildDebug % QString::number(byt, 16) % " ";
-    }
-    sendDebug(buildDebug);
+    debugBytes(DEBUG_TX_BYTES, bytes);
 
     if (serial) serial->write(bytes);
 }
@@ -129,10 +162,76 @@ void LAWICELSerial::piSetBusSettings(int pBusIdx, CANBus bus)
 }
 
 
+/*
+ * LAWICEL adapters have one SJA1000 style acceptance code and mask (the M and m commands) and run the filter in dual
+ * mode where each half only looks at the 11 bit ID. So extended IDs can't be filtered, and a list of filters gets
+ * folded into one that passes all of them: only the ID bits every filter cares about and agrees on get checked.
+ */
+bool LAWICELSerial::piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters)
+{
+    if (pBusIdx != 0) return false;
+
+    bool wasUsing = useAcceptance;
+    useAcceptance = false;
+    acceptCode = 0;
+    acceptMask = 0xFFFFFFFF;
+
+    if (!pFilters.isEmpty())
+    {
+        quint32 firstID = pFilters.first().id & pFilters.first().mask;
+        quint32 careBits = 0x7FF;
+        bool standardOnly = true;
+        foreach (const CANAcceptanceFilter &accept, pFilters)
+        {
+            quint32 id = accept.id & accept.mask;
+            if (id > 0x7FF) standardOnly = false;
+            careBits &= accept.mask;
+            careBits &= ~(id ^ firstID);
+        }
+
+        //a filter that ends up checking nothing isn't worth reopening the bus for
+        if (standardOnly && careBits != 0)
+        {
+            //each 16 bit half is ID10..0 then RTR and the top nibble of the first data byte. Mask bits set = don't care
+            quint32 code16 = (firstID & careBits) << 5;
+            quint32 mask16 = ((~careBits & 0x7FF) << 5) | 0x1F;
+            acceptCode = (code16 << 16) | code16;
+            acceptMask = (mask16 << 16) | mask16;
+            useAcceptance = true;
+        }
+    }
+
+    //the filter only takes effect while the channel is closed
+    if ((useAcceptance || wasUsing) && getStatus() == CANCon::CONNECTED)
+    {
+        QByteArray output;
+        output.append('C');
+        output.append(13);
+        sendToSerial(output);
+        sendAcceptanceFilter();
+        output.clear();
+        output.append('O');
+        output.append(13);
+        sendToSerial(output);
+    }
+
+    return useAcceptance || pFilters.isEmpty();
+}
+
+void LAWICELSerial::sendAcceptanceFilter()
+{
+    QByteArray output;
+    output.append('M');
+    output.append(QByteArray::number(acceptCode, 16).rightJustified(8, '0').toUpper());
+    output.append(13);
+    output.append('m');
+    output.append(QByteArray::number(acceptMask, 16).rightJustified(8, '0').toUpper());
+    output.append(13);
+    sendToSerial(output);
+}
+
 bool LAWICELSerial::piSendFrame(const CANFrame& frame)
 {
-    QByteArray buffer;
-    int c;
     quint32 ID;
 
     //qDebug() << "Sending out lawicel frame with id " << frame.ID << " on bus " << frame.bus;
@@ -152,7 +251,6 @@ bool LAWICELSerial::piSendFrame(const CANFrame& frame)
     ID = frame.frameId();
     if (frame.hasExtendedFrameFormat()) ID |= 1u << 31;
 
-    int idx = 0;
     QString buildStr;
     if(frame.hasFlexibleDataRateFormat()){
         if (frame.hasExtendedFrameFormat())
@@ -180,32 +278,40 @@ bool LAWICELSerial::piSendFrame(const CANFrame& frame)
             buildStr = QString::asprintf("t%03X%u", ID, frame.payload().length());
         }
     }
-    foreach (QChar chr, buildStr)
-    {
-        buffer[idx] = chr.toLatin1();
-        idx++;
-    }
+    //goes on the end of whatever else is waiting to be written
+    QByteArray &buffer = txBuffer();
+    buffer.append(buildStr.toLatin1());
+    buffer.append(frame.payload().toHex().toUpper());
+    buffer.append((char)13); //CR
 
-    for (c = 0; c < frame.payload().length(); c++)
-    {
-        QString byt = Utility::formatByteAsHex(frame.payload()[c]);
-        buffer[idx + (c * 2)] = byt[0].toLatin1();
-        buffer[idx + (c * 2) + 1] = byt[1].toLatin1();
-    }
-    buffer[idx + (frame.payload().length() * 2)] = 13; //CR
-
-    sendToSerial(buffer);
+    txQueued();
 
     return true;
 }
 
 
+void LAWICELSerial::piWriteTx(int pBusIdx, const QByteArray& pBytes)
+{
+    Q_UNUSED(pBusIdx)
+    sendToSerial(pBytes);
+}
+
+
+qint64 LAWICELSerial::piTxBacklog()
+{
+    if (serial) return serial->bytesToWrite();
+    return -1;
+}
+
+
 
 /****************************************************************/
 
 void LAWICELSerial::readSettings()
 {
     QSettings settings;
+    useAutoPoll = settings.value("LAWICEL/AutoPoll", true).toBool();
+    useAdapterTimestamps = settings.value("LAWICEL/AdapterTimestamps", true).toBool();
 }
 
 
@@ -328,6 +434,24 @@ void LAWICELSerial::deviceConnected()
         output.clear();
     }
 
+    if (useAcceptance) sendAcceptanceFilter();
+
+    //both only take while the channel is closed
+    if (useAutoPoll)
+    {
+        output.append("X1"); //send frames as they come in instead of waiting to be polled
+        output.append(13);
+    }
+    output.append(useAdapterTimestamps ? "Z1" : "Z0");
+    output.append(13);
+    sendToSerial(output);
+    output.clear();
+
+    mLine.clear();
+    mHostBaseUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    mHostClock.start();
+    mLastAdapterMs = -1;
+
     output.append('O'); //open bus now that we set the speed
     output.append(13);
 
@@ -345,6 +469,11 @@ void LAWICELSerial::deviceConnected()
 }
 
 void LAWICELSerial::disconnectDevice() {
+    if (badLines > 0)
+    {
+        sendDebug("LAWICEL: " + QString::number(badLines) + " lines from the adapter couldn't be read");
+        badLines = 0;
+    }
     if (serial != nullptr)
     {
         if (serial->isOpen())
@@ -472,153 +601,190 @@ void LAWICELSerial::connectionTimeout()
 void LAWICELSerial::readSerialData()
 {
     QByteArray data;
-    unsigned char c;
-    QString debugBuild;
-    CANFrame buildFrame;
-    QByteArray buildData;
-
     if (serial) data = serial->readAll();
 
-    sendDebug("Got data from serial. Len = " % QString::number(data.length()));
-    for (int i = 0; i < data.length(); i++)
+    //only the raw bytes are kept, the console makes the hex out of the few it actually shows
+    debugBytes(DEBUG_RX_BYTES, data);
+
+    //everything in one read was there by the time it was read
+    const qint64 hostNowUs = hostTimeUs();
+    const char *bytes = data.constData();
+    const int len = data.length();
+    int lineStart = 0;
+    for (int i = 0; i < len; i++)
     {
-        c = data.at(i);
-        //qDebug() << c << "    " << QString::number(c, 16) << "     " << QString(c);
-        debugBuild = debugBuild % QString::number(c, 16).rightJustified(2,'0') % " ";
-        //procRXChar(c);
-        mBuildLine.append(c);
-        if (c == 13) //all lawicel commands end in CR
-        {
-            qDebug() << "Got CR!";
+        const char c = bytes[i];
+        if (c != 13 && c != 7) continue; //all lawicel commands end in CR. A bell is the reply to one that failed
 
-            buildFrame.setTimeStamp(QDateTime::currentMSecsSinceEpoch() * 1000l);
-            switch (mBuildLine[0].toLatin1())
+        if (c == 13)
+        {
+            if (mLine.isEmpty()) parseLine(bytes + lineStart, i - lineStart, hostNowUs);
+            else
             {
-            case 't': //standard frame
-                //tIIILDD
-                buildFrame.setFrameId(mBuildLine.mid(1, 3).toInt(nullptr, 16));
-                buildFrame.isReceived = true;
-                buildFrame.setFrameType(QCanBusFrame::FrameType::DataFrame);
-                buildData.resize(mBuildLine.mid(4, 1).toInt());
-                for (int c = 0; c < buildData.size(); c++)
-                {
-                    buildData[c] = mBuildLine.mid(5 + (c*2), 2).toInt(nullptr, 16);
-                }
-                buildFrame.setPayload(buildData);
-                if (!isCapSuspended())
-                {
-                    /* get frame from queue */
-                    CANFrame* frame_p = getQueue().get();
-                    if(frame_p) {
-                        //qDebug() << "Lawicel got frame on bus " << frame_p->bus;
-                        /* copy frame */
-                        *frame_p = buildFrame;
-                        checkTargettedFrame(buildFrame);
-                        /* enqueue frame */
-                        getQueue().queue();
-                    }
-                    else
-                        qDebug() << "can't get a frame, ERROR";
-                }
-                break;
-            case 'T': //extended frame
-                //TIIIIIIIILDD.
-                buildFrame.setFrameId(mBuildLine.mid(1, 8).toInt(nullptr, 16));
-                buildFrame.isReceived = true;
-                buildFrame.setFrameType(QCanBusFrame::FrameType::DataFrame);
-                buildFrame.setExtendedFrameFormat(true);
-                buildData.resize(mBuildLine.mid(9, 1).toInt());
-                for (int c = 0; c < buildData.size(); c++)
-                {
-                    buildData[c] = mBuildLine.mid(10 + (c*2), 2).toInt(nullptr, 16);
-                }
-                buildFrame.setPayload(buildData);
-                if (!isCapSuspended())
-                {
-                    /* get frame from queue */
-                    CANFrame* frame_p = getQueue().get();
-                    if(frame_p) {
-                        //qDebug() << "Lawicel got frame on bus " << frame_p->bus;
-                        /* copy frame */
-                        *frame_p = buildFrame;
-                        checkTargettedFrame(buildFrame);
-                        /* enqueue frame */
-                        getQueue().queue();
-                    }
-                    else
-                        qDebug() << "can't get a frame, ERROR";
-                }
-                break;
-            case 'b':
-                buildFrame.setBitrateSwitch(true); //BRS enabled
-                [[fallthrough]];
-            case 'd': //standard fd frame, BRS disabled
-                //tIIILDD
-                buildFrame.setFlexibleDataRateFormat(true);
-                buildFrame.setFrameId(mBuildLine.mid(1, 3).toInt(nullptr, 16));
-                buildFrame.isReceived = true;
-                buildFrame.setFrameType(QCanBusFrame::FrameType::DataFrame);
-                buildData.resize(LAWICELSerial::dlc_code_to_bytes(mBuildLine.mid(4, 1).toInt(nullptr, 16)));
-                for (int c = 0; c < buildData.size(); c++)
-                {
-                    buildData[c] = mBuildLine.mid(5 + (c*2), 2).toInt(nullptr, 16);
-                }
-                buildFrame.setPayload(buildData);
-                if (!isCapSuspended())
-                {
-                    /* get frame from queue */
-                    CANFrame* frame_p = getQueue().get();
-                    if(frame_p) {
-                        //qDebug() << "Lawicel got frame on bus " << frame_p->bus;
-                        /* copy frame */
-                        *frame_p = buildFrame;
-                        checkTargettedFrame(buildFrame);
-                        /* enqueue frame */
-                        getQueue().queue();
-                    }
-                    else
-                        qDebug() << "can't get a frame, ERROR";
-                }
-                break;
-            case 'B':
-                buildFrame.setBitrateSwitch(true); //BRS enabled
-                [[fallthrough]];
-            case 'D': //extended fd frame
-                //TIIIIIIIILDD.
-                buildFrame.setFlexibleDataRateFormat(true);
-                buildFrame.setBitrateSwitch(true);
-                buildFrame.setFrameId(mBuildLine.mid(1, 8).toInt(nullptr, 16));
-                buildFrame.isReceived = true;
-                buildFrame.setFrameType(QCanBusFrame::FrameType::DataFrame);
-                buildFrame.setExtendedFrameFormat(true);
-                buildData.resize(LAWICELSerial::dlc_code_to_bytes(mBuildLine.mid(4, 1).toInt(nullptr, 16)));
-                for (int c = 0; c < buildData.size(); c++)
-                {
-                    buildData[c] = mBuildLine.mid(10 + (c*2), 2).toInt(nullptr, 16);
-                }
-                buildFrame.setPayload(buildData);
-                if (!isCapSuspended())
-                {
-                    /* get frame from queue */
-                    CANFrame* frame_p = getQueue().get();
-                    if(frame_p) {
-                        //qDebug() << "Lawicel got frame on bus " << frame_p->bus;
-                        /* copy frame */
-                        *frame_p = buildFrame;
-                        checkTargettedFrame(buildFrame);
-                        /* enqueue frame */
-                        getQueue().queue();
-                    }
-                    else
-                        qDebug() << "can't get a frame, ERROR";
-                }
-                break;
+                //the start of this line came in with the last read
+                mLine.append(bytes + lineStart, qMin(i - lineStart, LAWICEL_MAX_LINE));
+                parseLine(mLine.constData(), mLine.length(), hostNowUs);
             }
-            mBuildLine.clear();
         }
+        mLine.clear();
+        lineStart = i + 1;
+    }
+    //keep the unfinished end for next time. Anything that runs on past the longest real line is noise
+    if (lineStart < len && mLine.length() < LAWICEL_MAX_LINE)
+        mLine.append(bytes + lineStart, qMin(len - lineStart, LAWICEL_MAX_LINE - mLine.length()));
+
+    flushSlots();
+}
+
+/*
+ * One line without its CR. Frames are a letter for the type, the ID (3 or 8 hex digits), the length (a digit, or a
+ * DLC code for FD) and the data as hex, then with Z1 four hex digits of milliseconds. Anything else the adapter says
+ * (z / Z for a sent frame, status replies) is ignored.
+ */
+void LAWICELSerial::parseLine(const char *line, int len, qint64 hostNowUs)
+{
+    if (len < 1) return;
+
+    const char type = line[0];
+    bool extended, fd, brs = false, remote = false;
+    switch (type)
+    {
+    case 't': extended = false; fd = false; break;
+    case 'T': extended = true; fd = false; break;
+    case 'r': extended = false; fd = false; remote = true; break;
+    case 'R': extended = true; fd = false; remote = true; break;
+    case 'b': brs = true; [[fallthrough]];
+    case 'd': extended = false; fd = true; break;
+    case 'B': brs = true; [[fallthrough]];
+    case 'D': extended = true; fd = true; break;
+    default:
+        return;
+    }
+
+    const int idDigits = extended ? 8 : 3;
+    if (len < 2 + idDigits)
+    {
+        badLines++;
+        return;
+    }
+    const qint64 id = hexValue(line + 1, idDigits);
+    const int lengthCode = hexNibble(line[1 + idDigits]);
+    if (id < 0 || lengthCode < 0 || (!fd && lengthCode > 8))
+    {
+        badLines++;
+        return;
+    }
+    const int dataLen = fd ? dlc_code_to_bytes(lengthCode) : lengthCode;
+    const int dataStart = 2 + idDigits;
+    const int dataChars = remote ? 0 : dataLen * 2;
+    const int extra = len - dataStart - dataChars;
+    if (extra != 0 && extra != 4)
+    {
+        badLines++;
+        return;
+    }
+
+    if (isCapSuspended()) return;
+
+    qint64 stampUs = hostNowUs;
+    if (extra == 4)
+    {
+        qint64 adapterMs = hexValue(line + dataStart + dataChars, 4);
+        if (adapterMs >= 0 && adapterMs < 60000) stampUs = adapterTimeUs(static_cast<int>(adapterMs), hostNowUs);
+    }
+
+    CANFrame *frame_p = nextSlot();
+    if (!frame_p) return;
+
+    frame_p->setTimeStamp(QCanBusFrame::TimeStamp(0, stampUs));
+    frame_p->setFrameType(remote ? QCanBusFrame::RemoteRequestFrame : QCanBusFrame::DataFrame);
+    frame_p->setFrameId(static_cast<quint32>(id) & (extended ? 0x1FFFFFFFu : 0x7FFu));
+    frame_p->setExtendedFrameFormat(extended);
+    frame_p->setFlexibleDataRateFormat(fd);
+    frame_p->setBitrateSwitch(brs);
+    frame_p->setErrorStateIndicator(false);
+    frame_p->setLocalEcho(false);
+    frame_p->bus = 0;
+    frame_p->isReceived = true;
+    frame_p->timedelta = 0;
+    frame_p->frameCount = 1;
+
+    char bytes[64];
+    const int count = remote ? 0 : dataLen;
+    const char *hex = line + dataStart;
+    for (int i = 0; i < count; i++)
+    {
+        int high = hexNibble(hex[i * 2]);
+        int low = hexNibble(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) badLines++; //keep the frame, the ID and length were fine
+        bytes[i] = static_cast<char>(((high & 0xF) << 4) | (low & 0xF));
+    }
+    fillPayload(*frame_p, bytes, count);
+
+    checkTargettedFrame(*frame_p);
+}
+
+CANFrame *LAWICELSerial::nextSlot()
+{
+    if (mSlotsUsed == mSlotsGranted)
+    {
+        flushSlots();
+        mSlots = getQueue().reserve(LAWICEL_RX_BATCH, mSlotsGranted);
+        if (!mSlots)
+        {
+            mSlotsGranted = 0;
+            mSlotsDropped++;
+            return nullptr;
+        }
+    }
+    return &mSlots[mSlotsUsed++];
+}
+
+//publish whatever was filled in this read and say how many didn't fit
+void LAWICELSerial::flushSlots()
+{
+    if (mSlotsUsed > 0)
+    {
+        getQueue().commit(mSlotsUsed);
+        notifyFramesQueued();
+    }
+    if (mSlotsDropped > 0)
+    {
+        qDebug() << "can't get a frame, ERROR";
+        getQueue().drop(mSlotsDropped);
+    }
+    mSlots = nullptr;
+    mSlotsGranted = 0;
+    mSlotsUsed = 0;
+    mSlotsDropped = 0;
+}
+
+qint64 LAWICELSerial::hostTimeUs() const
+{
+    if (!mHostClock.isValid()) return QDateTime::currentMSecsSinceEpoch() * 1000;
+    return mHostBaseUs + mHostClock.nsecsElapsed() / 1000;
+}
+
+/*
+ * The adapter counts milliseconds from 0 to 59999 and starts over. Going backwards is taken as a wrap. The first one
+ * gets lined up with the host clock and the rest follow the adapter from there, unless that puts a frame after the
+ * read it came in (the adapter's clock runs fast) or well before it (it runs slow, or whole minutes went by without
+ * a frame), which lines them up again.
+ */
+qint64 LAWICELSerial::adapterTimeUs(int adapterMs, qint64 hostNowUs)
+{
+    const qint64 rawUs = static_cast<qint64>(adapterMs) * 1000;
+    if (mLastAdapterMs < 0) mAdapterOffsetUs = hostNowUs - rawUs;
+    else if (adapterMs < mLastAdapterMs) mAdapterOffsetUs += 60000000;
+    mLastAdapterMs = adapterMs;
+
+    qint64 stampUs = mAdapterOffsetUs + rawUs;
+    if (stampUs > hostNowUs || stampUs < hostNowUs - LAWICEL_MAX_LAG_US)
+    {
+        mAdapterOffsetUs = hostNowUs - rawUs;
+        stampUs = hostNowUs;
     }
-    debugOutput(debugBuild);
-    //qDebug() << debugBuild;
+    return stampUs;
 }
 
 //Debugging data sent from connection window. Inject it into Comm traffic.
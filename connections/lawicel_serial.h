@@ -3,6 +3,7 @@
 
 #include <QSerialPort>
 #include <QCanBusDevice>
+#include <QElapsedTimer>
 #include <QThread>
 #include <QTimer>
 
@@ -14,6 +15,22 @@
 #include "canconnection.h"
 #include "canconmanager.h"
 
+//longest line worth keeping: an extended FD frame with 64 bytes and a timestamp is 142 characters
+#define LAWICEL_MAX_LINE    160
+//queue slots asked for at a time while a read is being parsed
+#define LAWICEL_RX_BATCH    64
+
+/*
+ * LAWICEL / slcan adapters. Received frames come in as lines of ASCII hex ending in CR. readSerialData parses them
+ * straight out of the bytes read, keeping only a partial line between reads, and writes the frames into queue slots
+ * reserved a batch at a time.
+ *
+ * The adapter is asked for auto-poll (X1) so it sends frames as they come in rather than waiting to be polled, and
+ * for its own timestamps (Z1), four hex digits of milliseconds on the end of each frame that wrap every minute.
+ * Adapters that don't know a command answer with a bell and carry on. When a frame has a timestamp it's unwrapped
+ * and lined up against the host clock, otherwise the frame is stamped with the host clock when the read came in.
+ * Both are in the settings as LAWICEL/AutoPoll and LAWICEL/AdapterTimestamps.
+ */
 class LAWICELSerial : public CANConnection
 {
     Q_OBJECT
@@ -30,6 +47,9 @@ protected:
     virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
     virtual void piSuspend(bool pSuspend);
     virtual bool piSendFrame(const CANFrame&) ;
+    virtual void piWriteTx(int pBusIdx, const QByteArray& pBytes);
+    virtual qint64 piTxBacklog();
+    virtual bool piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters);
 
     void disconnectDevice();
 
@@ -49,22 +69,47 @@ private:
     void rebuildLocalTimeBasis();
     void sendToSerial(const QByteArray &bytes);
     void sendDebug(const QString debugText);
+    void sendAcceptanceFilter();
     uint8_t dlc_code_to_bytes(int dlc_code);
     uint8_t bytes_to_dlc_code(uint8_t bytes);
+    void parseLine(const char *line, int len, qint64 hostNowUs);
+    CANFrame *nextSlot();
+    void flushSlots();
+    qint64 hostTimeUs() const;
+    qint64 adapterTimeUs(int adapterMs, qint64 hostNowUs);
 
 protected:
     QTimer             mTimer;
     QThread            mThread;
-    QString            mBuildLine;
+    QByteArray         mLine; //partial line left over from the last read
+
+    //host clock, monotonic but starting from the wall time when the device connected
+    QElapsedTimer mHostClock;
+    qint64 mHostBaseUs;
+    //adapter timestamps, unwrapped. -1 until the first one comes in
+    qint64 mAdapterOffsetUs;
+    int mLastAdapterMs;
+
+    //slots reserved from the queue during one read
+    CANFrame *mSlots;
+    int mSlotsGranted;
+    int mSlotsUsed;
+    int mSlotsDropped;
+
+    bool useAutoPoll;
+    bool useAdapterTimestamps;
+    quint64 badLines;
 
     bool isAutoRestart;
     QSerialPort *serial;
     int framesRapid;
-    CANFrame buildFrame;
     bool can0Enabled;
     bool can0ListenOnly;
     bool canFd;
     int dataRate;
+    bool useAcceptance; //false = the adapter default of accepting everything
+    quint32 acceptCode;
+    quint32 acceptMask;
 };
 
 #endif // LAWICELSERIAL_H
@@ -0,0 +1,139 @@
+#include "liveframetable.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+//meta is the length in the low byte, bit 8 for extended IDs and the bus in the top half
+quint64 packMeta(int len, bool extended, int bus)
+{
+    return static_cast<quint64>(len & 0xFF) | (extended ? 0x100ull : 0ull) | (static_cast<quint64>(static_cast<quint32>(bus)) << 32);
+}
+
+//bus is offset by one so -1 (any bus) works, and the top bit is set so no key is ever 0
+quint64 makeKey(int bus, uint32_t id)
+{
+    return (1ull << 63) | (static_cast<quint64>(static_cast<quint32>(bus + 1)) << 32) | id;
+}
+
+int slotOf(quint64 key)
+{
+    return static_cast<int>((key * 0x9E3779B97F4A7C15ull) >> 40) & (LIVE_FRAME_SLOTS - 1);
+}
+}
+
+int LiveFrameSlot::byteAt(int idx) const
+{
+    if (!isSet() || idx < 0 || idx >= static_cast<int>(meta.loadRelaxed() & 0xFF)) return -1;
+    return static_cast<int>((words[idx >> 3].loadRelaxed() >> ((idx & 7) * 8)) & 0xFF);
+}
+
+//made the first time anyone wants it, lives as long as the program does
+LiveFrameTable *LiveFrameTable::getReference()
+{
+    static LiveFrameTable table;
+    return &table;
+}
+
+LiveFrameTable::LiveFrameTable()
+{
+    entries = new LiveFrameSlot[LIVE_FRAME_SLOTS];
+    for (int i = 0; i < LIVE_FRAME_SLOTS; i++)
+    {
+        entries[i].key.storeRelaxed(0);
+        entries[i].seq.storeRelaxed(0);
+        entries[i].meta.storeRelaxed(0);
+        entries[i].timestamp.storeRelaxed(0);
+        for (int w = 0; w < 8; w++) entries[i].words[w].storeRelaxed(0);
+    }
+}
+
+LiveFrameSlot *LiveFrameTable::find(quint64 key, bool insert) const
+{
+    int idx = slotOf(key);
+    for (int probe = 0; probe < LIVE_FRAME_MAX_PROBE; probe++, idx = (idx + 1) & (LIVE_FRAME_SLOTS - 1))
+    {
+        LiveFrameSlot *slot = &entries[idx];
+        quint64 current = slot->key.loadAcquire();
+        if (current == key) return slot;
+        if (current != 0) continue;
+        if (!insert) return nullptr;
+        //free, try to claim it. Somebody else might get there first, possibly with the same key
+        if (slot->key.testAndSetOrdered(0, key, current) || current == key) return slot;
+    }
+    return nullptr;
+}
+
+void LiveFrameTable::write(LiveFrameSlot *slot, const CANFrame &frame, int bus)
+{
+    //more than one connection can write the any bus entry of an ID so the writer takes the odd count with a CAS
+    quint32 seq = slot->seq.loadRelaxed();
+    while ((seq & 1) || !slot->seq.testAndSetAcquire(seq, seq + 1, seq))
+    {
+        if (seq & 1) seq = slot->seq.loadRelaxed();
+    }
+    //the odd count has to be visible before any of the data changes, an acquire CAS doesn't keep later stores after it
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const QByteArray payload = frame.payload();
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(payload.constData());
+    int len = std::min(static_cast<int>(payload.length()), 64);
+    slot->meta.storeRelaxed(packMeta(len, frame.hasExtendedFrameFormat(), bus));
+    slot->timestamp.storeRelaxed(frame.timeStamp().microSeconds());
+    for (int w = 0; w < (len + 7) / 8; w++)
+    {
+        quint64 word = 0;
+        for (int b = 0; b < 8 && w * 8 + b < len; b++) word |= static_cast<quint64>(bytes[w * 8 + b]) << (b * 8);
+        slot->words[w].storeRelaxed(word);
+    }
+
+    quint32 done = seq + 2;
+    if (done == 0) done = 2; //0 means never written
+    slot->seq.storeRelease(done);
+}
+
+void LiveFrameTable::update(const CANFrame &frame, int busOffset)
+{
+    int bus = frame.bus + busOffset;
+    LiveFrameSlot *slot = find(makeKey(bus, frame.frameId()), true);
+    if (slot) write(slot, frame, bus);
+    slot = find(makeKey(-1, frame.frameId()), true);
+    if (slot) write(slot, frame, bus);
+}
+
+const LiveFrameSlot *LiveFrameTable::slot(int bus, uint32_t id)
+{
+    return find(makeKey(bus, id), true);
+}
+
+bool LiveFrameTable::latest(int bus, uint32_t id, LiveFrame &out) const
+{
+    const LiveFrameSlot *slot = find(makeKey(bus, id), false);
+    return slot && read(slot, out);
+}
+
+bool LiveFrameTable::read(const LiveFrameSlot *slot, LiveFrame &out)
+{
+    for (;;)
+    {
+        quint32 before = slot->seq.loadAcquire();
+        if (before == 0) return false;
+        if (before & 1) continue;
+
+        quint64 meta = slot->meta.loadRelaxed();
+        out.len = static_cast<int>(meta & 0xFF);
+        out.extended = (meta & 0x100) != 0;
+        out.bus = static_cast<int>(static_cast<quint32>(meta >> 32));
+        out.id = static_cast<uint32_t>(slot->key.loadRelaxed() & 0xFFFFFFFF);
+        out.timestamp = slot->timestamp.loadRelaxed();
+        for (int w = 0; w < (out.len + 7) / 8; w++)
+        {
+            quint64 word = slot->words[w].loadRelaxed();
+            for (int b = 0; b < 8; b++) out.data[w * 8 + b] = static_cast<uint8_t>(word >> (b * 8));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq.loadRelaxed() == before) return true;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef LIVEFRAMETABLE_H
+#define LIVEFRAMETABLE_H
+
+#include <QAtomicInteger>
+#include "can_structs.h"
+
+//number of bus / ID pairs (plus one "any bus" entry per ID) that can be tracked. Power of two, about 100 bytes each
+#define LIVE_FRAME_SLOTS        16384
+//how far an insert or lookup probes from where the key hashes to before giving up
+#define LIVE_FRAME_MAX_PROBE    64
+
+//a copy of what a slot held at one moment
+struct LiveFrame
+{
+    int bus;
+    uint32_t id;
+    int len;
+    bool extended;
+    uint64_t timestamp;
+    uint8_t data[64];
+};
+
+/*
+ * One bus / ID pair. Written under a sequence lock: the writer makes seq odd, stores everything, then makes it even
+ * again. Readers copy and retry if seq moved or was odd along the way. Everything is stored as atomics so the
+ * copying itself is never a data race, just possibly torn, which the retry takes care of.
+ */
+struct LiveFrameSlot
+{
+    QAtomicInteger<quint64> key; //0 while the slot is free
+    QAtomicInteger<quint32> seq; //0 until the first frame, odd while being written
+    QAtomicInteger<quint64> meta; //length, extended flag and bus, see the .cpp
+    QAtomicInteger<quint64> timestamp;
+    QAtomicInteger<quint64> words[8];
+
+    bool isSet() const { return seq.loadAcquire() != 0; }
+    //one byte without the sequence lock, a single word load can't tear. -1 past the end or before the first frame
+    int byteAt(int idx) const;
+};
+
+/*
+ * Newest frame of every bus / ID pair the connections have received, plus the newest of each ID whatever bus it was
+ * on. Filled in straight from the connections' reading threads as frames arrive (CANConnection::checkTargettedFrame)
+ * so anyone can look at the latest payload of an ID without waiting for the GUI to get the frame, and without
+ * copying frames out of the frame store.
+ *
+ * Fixed size open addressing, no locks anywhere. Slots are never freed, so a pointer from slot() stays good for the
+ * life of the program and can be kept around by things like compiled modifiers. A slot can be asked for before its
+ * ID has ever been seen, it's just not set until then. Once the table is full new pairs simply aren't tracked.
+ *
+ * Buses are the global bus numbers CANConManager hands out. Only frames coming in from connections get here, not
+ * ones loaded from files.
+ */
+class LiveFrameTable
+{
+public:
+    static LiveFrameTable *getReference();
+
+    //bus is added to the frame's own bus number, the connection's first global bus
+    void update(const CANFrame &frame, int busOffset);
+    //bus -1 is the newest of that ID on any bus. Null if there's no room for it
+    const LiveFrameSlot *slot(int bus, uint32_t id);
+    //false if the pair hasn't been seen yet
+    bool latest(int bus, uint32_t id, LiveFrame &out) const;
+    static bool read(const LiveFrameSlot *slot, LiveFrame &out);
+
+private:
+    LiveFrameTable();
+    Q_DISABLE_COPY(LiveFrameTable)
+    LiveFrameSlot *find(quint64 key, bool insert) const;
+    static void write(LiveFrameSlot *slot, const CANFrame &frame, int bus);
+
+    LiveFrameSlot *entries;
+};
+
+#endif // LIVEFRAMETABLE_H
@@ -0,0 +1,281 @@
+#include "logreplay.h"
+#include "canconmanager.h"
+#include "framefileio.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <limits>
+
+LogReplay::Config LogReplay::Config::parse(const QString &portName)
+{
+    Config config;
+    QString settings = portName;
+    //file= is last and takes the rest so paths with spaces or commas in them work
+    int fileAt = portName.indexOf(QRegularExpression("(^|[,;\\s])file="));
+    if (fileAt >= 0)
+    {
+        int valueAt = portName.indexOf("file=", fileAt) + 5;
+        config.file = portName.mid(valueAt).trimmed();
+        settings = portName.left(fileAt);
+    }
+
+    const QStringList pairs = settings.split(QRegularExpression("[,;\\s]+"), Qt::SkipEmptyParts);
+    for (const QString &pair : pairs)
+    {
+        QString key = pair.section('=', 0, 0).trimmed().toLower();
+        QString value = pair.section('=', 1).trimmed().toLower();
+        bool ok = true;
+        if (key == "speed")
+        {
+            if (value == "max") config.speed = 0.0;
+            else config.speed = value.toDouble(&ok);
+        }
+        else if (key == "loop") config.loop = (value == "1" || value == "true" || value == "yes");
+        else if (key == "buses") config.buses = value.toInt(&ok);
+        else ok = false;
+        if (!ok) qDebug() << "Log replay: ignoring" << pair;
+    }
+    if (config.speed < 0.0) config.speed = 1.0;
+    config.buses = qBound(1, config.buses, 16);
+    return config;
+}
+
+LogReplay::LogReplay(QString portName) :
+    CANConnection(portName, "replay", CANCon::LOGREPLAY, 0, 0, false, 0,
+                  Config::parse(portName).buses, 65536, false),
+    mConfig(Config::parse(portName)),
+    mMapped(false),
+    mStartUs(0),
+    mReader_p(nullptr),
+    mStopReader(0)
+{
+    /* the reader thread owns the producer side of the queue so sent frames can't be echoed into it */
+    setTxEcho(false);
+}
+
+
+LogReplay::~LogReplay()
+{
+    stop();
+}
+
+
+void LogReplay::piStarted()
+{
+    //loading happens here on the GUI thread, the text loaders show their own progress and error boxes
+    mMapped = mCapture.open(mConfig.file);
+    if (!mMapped)
+    {
+        mFrames.clear();
+        if (!QFileInfo::exists(mConfig.file) || !FrameFileIO::autoDetectLoadFile(mConfig.file, &mFrames))
+        {
+            qDebug() << "Log replay: could not load" << mConfig.file;
+            mFrames.clear();
+            updateStatus(CANCon::NOT_CONNECTED);
+            return;
+        }
+    }
+    else if (mCapture.isDamaged()) qDebug() << "Log replay:" << mConfig.file << "is damaged, replaying what could be read";
+    qDebug() << "Log replay:" << frameCount() << "frames from" << mConfig.file;
+
+    for (int i = 0; i < mNumBuses; i++)
+    {
+        mBusData[i].mConfigured = true;
+        mBusData[i].mBus.setActive(true);
+    }
+
+    mStartUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    if (!useSystemTime) mStartUs -= static_cast<qint64>(CANConManager::getInstance()->getTimeBasis());
+
+    mStopReader.storeRelease(0);
+    mReader_p = QThread::create([this]{ replayLoop(); });
+    mReader_p->start(QThread::HighPriority);
+    updateStatus(CANCon::CONNECTED);
+}
+
+
+void LogReplay::piStop()
+{
+    if (mReader_p)
+    {
+        mStopReader.storeRelease(1);
+        mReader_p->wait();
+        delete mReader_p;
+        mReader_p = nullptr;
+    }
+    mCapture.close();
+    mFrames.clear();
+    mFrames.squeeze();
+    mMapped = false;
+    updateStatus(CANCon::NOT_CONNECTED);
+}
+
+
+void LogReplay::piSetBusSettings(int pBusIdx, CANBus bus)
+{
+    if( (pBusIdx < 0) || pBusIdx >= getNumBuses())
+        return;
+    setBusConfig(pBusIdx, bus);
+}
+
+
+bool LogReplay::piGetBusSettings(int pBusIdx, CANBus& pBus)
+{
+    return getBusConfig(pBusIdx, pBus);
+}
+
+
+void LogReplay::piSuspend(bool pSuspend)
+{
+    setCapSuspended(pSuspend);
+    if(isCapSuspended())
+        getQueue().flush();
+}
+
+
+//a recording can't be sent to. Taken as sent so whatever is sending doesn't stall
+bool LogReplay::piSendFrame(const CANFrame& pFrame)
+{
+    return pFrame.bus >= 0 && pFrame.bus < getNumBuses();
+}
+
+
+/***********************************/
+/****   private methods         ****/
+/***********************************/
+
+
+int LogReplay::frameCount() const
+{
+    return mMapped ? mCapture.count() : mFrames.count();
+}
+
+
+void LogReplay::readFrame(int idx, CANFrame &frame) const
+{
+    if (mMapped)
+    {
+        CANFrameRecord rec = mCapture.record(idx);
+        if (rec.len > CANFrameRecord::MAX_BYTES) rec.len = CANFrameRecord::MAX_BYTES;
+        rec.toFrame(frame, mCapture.payloadData(idx));
+    }
+    else frame = mFrames.at(idx);
+    frame.bus = frame.bus % mNumBuses;
+    frame.timedelta = 0;
+    frame.frameCount = 1;
+}
+
+
+qint64 LogReplay::stampOf(int idx) const
+{
+    if (mMapped) return static_cast<qint64>(mCapture.record(idx).timestamp);
+    const QCanBusFrame::TimeStamp stamp = mFrames.at(idx).timeStamp();
+    return stamp.seconds() * 1000000 + stamp.microSeconds();
+}
+
+
+void LogReplay::updateStatus(CANCon::status pStatus)
+{
+    if (getStatus() == pStatus) return;
+    setStatus(pStatus);
+
+    CANConStatus stats;
+    stats.conStatus = getStatus();
+    stats.numHardwareBuses = mNumBuses;
+    emit status(stats);
+}
+
+
+void LogReplay::replayLoop()
+{
+    const int count = frameCount();
+    if (count == 0) return;
+
+    QElapsedTimer clock;
+    clock.start();
+    const bool flatOut = mConfig.speed <= 0.0;
+    const qint64 firstStamp = stampOf(0);
+    qint64 loopOffset = 0;  //log time added by the passes already played
+    qint64 lastOffset = 0;  //log time of the last frame queued, relative to the first frame. Never goes backward
+    int next = 0;
+
+    while (!mStopReader.loadAcquire())
+    {
+        if (next >= count)
+        {
+            if (!mConfig.loop)
+            {
+                QThread::msleep(50); //all played, stay connected until stopped
+                continue;
+            }
+            //the next pass starts a millisecond after the last frame of this one
+            loopOffset = lastOffset + 1000;
+            next = 0;
+        }
+
+        //how far into the log the replay should be by now
+        qint64 dueOffset = flatOut ? std::numeric_limits<qint64>::max()
+                                   : static_cast<qint64>(clock.nsecsElapsed() / 1000.0 * mConfig.speed);
+        qint64 offset = qMax(lastOffset, stampOf(next) - firstStamp + loopOffset);
+        if (offset > dueOffset)
+        {
+            qint64 waitUs = static_cast<qint64>((offset - dueOffset) / mConfig.speed);
+            if (waitUs > REPLAY_SLEEP_US) QThread::usleep(REPLAY_SLEEP_US / 2);
+            else QThread::usleep(REPLAY_IDLE_US);
+            continue;
+        }
+
+        int made = 0;
+        while (made < REPLAY_BATCH && next < count)
+        {
+            if (isCapSuspended())
+            {
+                //nothing goes in but the log keeps moving, like a bus that's still running
+                qint64 frameOffset = qMax(lastOffset, stampOf(next) - firstStamp + loopOffset);
+                if (frameOffset > dueOffset) break;
+                lastOffset = frameOffset;
+                next++;
+                made++;
+                continue;
+            }
+
+            int granted = 0;
+            CANFrame *slot_p = getQueue().reserve(REPLAY_BATCH - made, granted);
+            if (!slot_p)
+            {
+                //full. Flat out the reader just waits for room, at a set speed the frame is lost like on a bus
+                if (flatOut)
+                {
+                    QThread::usleep(REPLAY_IDLE_US);
+                    break;
+                }
+                getQueue().drop();
+                lastOffset = qMax(lastOffset, stampOf(next) - firstStamp + loopOffset);
+                next++;
+                made++;
+                continue;
+            }
+
+            int filled = 0;
+            while (filled < granted && next < count)
+            {
+                qint64 frameOffset = qMax(lastOffset, stampOf(next) - firstStamp + loopOffset);
+                if (frameOffset > dueOffset) break;
+                readFrame(next, slot_p[filled]);
+                slot_p[filled].setTimeStamp(QCanBusFrame::TimeStamp(0, mStartUs + frameOffset));
+                checkTargettedFrame(slot_p[filled]);
+                lastOffset = frameOffset;
+                next++;
+                filled++;
+            }
+            getQueue().commit(filled);
+            made += filled;
+            if (filled < granted) break;
+        }
+
+        if (made > 0) notifyFramesQueued();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef LOGREPLAY_H
+#define LOGREPLAY_H
+
+#include <QThread>
+#include <QVector>
+
+#include "canconnection.h"
+#include "binarycapture.h"
+
+/*
+ * A connection that plays a recorded log back as if it was coming in live. FramePlaybackObject sends a log out to
+ * a bus; this goes the other way, the frames come in through the connection queue like any received traffic so
+ * the sniffer, scripts, triggers, decoders and bridges all see them as they would with the car attached.
+ *
+ * Set through the port name as key=value pairs, file last since it takes the rest of the line:
+ * "speed=10 loop=1 buses=2 file=/home/me/logs/drive.csv"
+ *  speed  how many times real time to play at, fractions work (default 1). 0 or max plays as fast as the queue
+ *         takes the frames
+ *  loop   1 starts over at the end, the timeline carries on where it was (default 0)
+ *  buses  how many buses the connection has (default 1). Frames on a bus past that end up on bus % buses
+ *  file   the log, in any format that can be loaded
+ *
+ * A reader thread takes the frames in order, waits until each one is due and puts them straight into the queue in
+ * runs with reserve()/commit(). SavvyCAN binary captures (.scb) are streamed out of the mapped file so any size
+ * plays without being loaded. Every other format is parsed up front when the connection starts since those loaders
+ * only read whole files. Timestamps keep the log's spacing, shifted so the first frame is at the moment replay
+ * started, so intervals measured on replayed traffic are the logged ones whatever the speed.
+ */
+
+//frames handed over per reserve()/commit() round at most
+#define REPLAY_BATCH        1024
+//the thread sleeps when the next frame is further away than this and spins on short sleeps when it's closer
+#define REPLAY_SLEEP_US     2000
+#define REPLAY_IDLE_US      100
+
+class LogReplay : public CANConnection
+{
+    Q_OBJECT
+
+public:
+    struct Config
+    {
+        double speed = 1.0; //0 is as fast as possible
+        bool loop = false;
+        int buses = 1;
+        QString file;
+
+        static Config parse(const QString &portName);
+    };
+
+    LogReplay(QString portName);
+    virtual ~LogReplay();
+
+protected:
+    virtual void piStarted();
+    virtual void piStop();
+    virtual void piSetBusSettings(int pBusIdx, CANBus pBus);
+    virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
+    virtual void piSuspend(bool pSuspend);
+    virtual bool piSendFrame(const CANFrame&);
+
+private:
+    void replayLoop();
+    int frameCount() const;
+    void readFrame(int idx, CANFrame &frame) const;
+    qint64 stampOf(int idx) const;
+    void updateStatus(CANCon::status pStatus);
+
+    Config mConfig;
+    MappedCapture mCapture;     //used when the log is a binary capture
+    QVector<CANFrame> mFrames;  //any other log, loaded when starting
+    bool mMapped;
+    qint64 mStartUs;
+    QThread *mReader_p;
+    QAtomicInt mStopReader;
+};
+
+#endif // LOGREPLAY_H
@@ -3,6 +3,7 @@
 #include <QCanBusFrame>
 #include <QSettings>
 #include <QStringBuilder>
+#include <QtEndian>
 #include <QtNetwork>
 
 #include "utility.h"
@@ -10,7 +11,8 @@
 
 MQTT_BUS::MQTT_BUS(QString topicName) :
     CANConnection(topicName, "mqtt_client", CANCon::MQTT, 0, 0, false, 0, 1, 4000, true),
-    mTimer(this) /*NB: set this as parent of timer to manage it from working thread */
+    mTimer(this), /*NB: set this as parent of timer to manage it from working thread */
+    mPackTimer(this)
 {
 
     sendDebug("MQTT_BUS()");
@@ -18,11 +20,17 @@ MQTT_BUS::MQTT_BUS(QString topicName) :
     crypto = new SimpleCrypt(Q_UINT64_C(0xdeadbeefface6285));
 
     isAutoRestart = false;
+    mqttClient = nullptr;
     this->topicName = topicName;
 
     timeBasis = 0;
     lastSystemTimeBasis = 0;
 
+    packCount = 0;
+    packLastStamp = 0;
+    mPackTimer.setSingleShot(true);
+    connect(&mPackTimer, &QTimer::timeout, this, &MQTT_BUS::flushPacked);
+
     readSettings();
 }
 
@@ -70,6 +78,10 @@ void MQTT_BUS::piStarted()
     mqttClient->setClientId(genRandomClientID());
     if (userName.length() > 0) mqttClient->setUsername(userName);
     if (password.length() > 0) mqttClient->setPassword(password);
+    //everything published in one go through the event loop leaves in a single write, and right away since
+    //there's nothing to gain from Nagle holding it back for more
+    mqttClient->setWriteCoalescing(true);
+    mqttClient->setNoDelay(true);
     sendDebug("Attempting to connect to MQTT.");
     mqttClient->connectToHost();
 }
@@ -203,6 +215,7 @@ void MQTT_BUS::piSuspend(bool pSuspend)
 void MQTT_BUS::piStop()
 {
     mTimer.stop();
+    flushPacked();
     disconnectDevice();
 }
 
@@ -227,22 +240,56 @@ void MQTT_BUS::piSetBusSettings(int pBusIdx, CANBus bus)
 
 bool MQTT_BUS::piSendFrame(const CANFrame& frame)
 {
-    QByteArray buffer;
-    //int c;
-    //quint32 ID;
+    bool ret = publishFrame(frame, QDateTime::currentMSecsSinceEpoch() * 1000ull);
+    if (usePacked && packDelay <= 0) flushPacked();
+    return ret;
+}
+
 
+//Unpacked every frame is still its own message since the ID is in the topic. What a batch saves is the per frame
+//setup and the socket write: the client only buffers the messages and they leave together once we're back in the
+//event loop. Packed, the whole list goes into as few messages as the frame limit allows.
+bool MQTT_BUS::piSendFrames(const QList<CANFrame>& pFrames)
+{
+    uint64_t micros = QDateTime::currentMSecsSinceEpoch() * 1000ull;
+    bool ret = true;
+    foreach (const CANFrame &frame, pFrames)
+    {
+        if (!publishFrame(frame, micros))
+        {
+            ret = false;
+            break;
+        }
+    }
+    if (usePacked && packDelay <= 0) flushPacked();
+    return ret;
+}
+
+
+bool MQTT_BUS::publishFrame(const CANFrame& frame, uint64_t micros)
+{
     //qDebug() << "Sending out GVRET frame with id " << frame.ID << " on bus " << frame.bus;
 
     framesRapid++;
 
+    if (!mqttClient) return false;
+
     // Doesn't make sense to send an error frame
     // to an adapter
     if (frame.frameId() & 0x20000000) {
         return true;
     }
 
+    if (usePacked)
+    {
+        packFrame(frame, micros);
+        return true;
+    }
+
     QMQTT::Message msg;
     QByteArray bytes;
+    const QByteArray payload = frame.payload();
+    bytes.reserve(9 + payload.length());
 
     msg.setTopic(topicName + "/s/" + QString::number(frame.frameId()));
     uint8_t flags = 0;
@@ -251,14 +298,13 @@ bool MQTT_BUS::piSendFrame(const CANFrame& frame)
     if (frame.hasFlexibleDataRateFormat()) flags += 4;
     if (frame.frameType() == QCanBusFrame::ErrorFrame) flags += 8;
 
-    uint64_t micros = QDateTime::currentMSecsSinceEpoch() * 1000ull;
     for (int x = 0; x < 8; x++)
     {
         bytes.append(micros & 0xFF);
         micros = micros / 256;
     }
     bytes.append(flags);
-    bytes.append(frame.payload());
+    bytes.append(payload);
 
     msg.setPayload(bytes);
     mqttClient->publish(msg);
@@ -268,12 +314,182 @@ bool MQTT_BUS::piSendFrame(const CANFrame& frame)
 
 
 
+void MQTT_BUS::packFrame(const CANFrame& frame, uint64_t micros)
+{
+    if (packCount == 0)
+    {
+        packBuffer.clear();
+        packBuffer.reserve(MQTT_PACK_HEADER + packFrames * 8);
+        packBuffer.append((char)MQTT_PACK_VERSION);
+        packBuffer.append((char)0); //frame count, filled in by flushPacked
+        packBuffer.append((char)0);
+        uint8_t stamp[8];
+        qToLittleEndian<quint64>(micros, stamp);
+        packBuffer.append((const char *)stamp, 8);
+        packLastStamp = micros;
+        if (packDelay > 0) mPackTimer.start(packDelay);
+    }
+
+    uint64_t delta = (micros > packLastStamp) ? (micros - packLastStamp) : 0;
+    if (micros > packLastStamp) packLastStamp = micros;
+    do
+    {
+        uint8_t byt = delta & 0x7F;
+        delta >>= 7;
+        if (delta) byt |= 0x80;
+        packBuffer.append((char)byt);
+    } while (delta);
+
+    uint8_t flags = 0;
+    if (frame.hasExtendedFrameFormat()) flags |= 1;
+    if (frame.frameType() == QCanBusFrame::RemoteRequestFrame) flags |= 2;
+    if (frame.hasFlexibleDataRateFormat()) flags |= 4;
+    if (frame.frameType() == QCanBusFrame::ErrorFrame) flags |= 8;
+    if (frame.hasBitrateSwitch()) flags |= 16;
+    packBuffer.append((char)flags);
+
+    uint8_t id[4];
+    qToLittleEndian<quint32>(frame.frameId(), id);
+    packBuffer.append((const char *)id, (flags & 1) ? 4 : 2);
+
+    const QByteArray payload = frame.payload();
+    packBuffer.append((char)payload.length());
+    packBuffer.append(payload);
+
+    packCount++;
+    if (packCount >= packFrames) flushPacked();
+}
+
+
+void MQTT_BUS::flushPacked()
+{
+    mPackTimer.stop();
+    if (packCount == 0) return;
+
+    qToLittleEndian<quint16>(static_cast<quint16>(packCount), packBuffer.data() + 1);
+    packCount = 0;
+    if (!mqttClient) return;
+
+    QMQTT::Message msg;
+    msg.setTopic(topicName + "/s/b");
+    msg.setPayload(packBuffer);
+    mqttClient->publish(msg);
+}
+
+
+//Decodes straight into the queue a contiguous run at a time. Whatever doesn't fit is dropped, same as a single
+//frame arriving with the queue full
+void MQTT_BUS::unpackFrames(const QByteArray& bytes)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(bytes.constData());
+    const int len = bytes.count();
+
+    if (len < MQTT_PACK_HEADER || data[0] != MQTT_PACK_VERSION)
+    {
+        sendDebug("Dropping packed MQTT message with an unknown layout");
+        return;
+    }
+
+    int remaining = qFromLittleEndian<quint16>(data + 1);
+    uint64_t stamp = qFromLittleEndian<quint64>(data + 3);
+    int pos = MQTT_PACK_HEADER;
+
+    //on the system clock the first frame is stamped with the arrival time and the rest keep their spacing
+    int64_t shift = 0;
+    if (useSystemTime) shift = static_cast<int64_t>(QDateTime::currentMSecsSinceEpoch() * 1000ull - stamp);
+
+    bool queued = false;
+    bool bad = false;
+    while (remaining > 0 && !bad)
+    {
+        int granted = 0;
+        CANFrame *slots = getQueue().reserve(remaining, granted);
+        if (!slots)
+        {
+            getQueue().drop(remaining);
+            break;
+        }
+
+        int filled = 0;
+        while (filled < granted)
+        {
+            uint64_t delta = 0;
+            int shiftBits = 0;
+            bool more = true;
+            while (more && pos < len && shiftBits < 64)
+            {
+                delta |= static_cast<uint64_t>(data[pos] & 0x7F) << shiftBits;
+                more = (data[pos] & 0x80) != 0;
+                shiftBits += 7;
+                pos++;
+            }
+            if (more || pos >= len)
+            {
+                bad = true;
+                break;
+            }
+
+            uint8_t flags = data[pos++];
+            int idLen = (flags & 1) ? 4 : 2;
+            if (pos + idLen + 1 > len)
+            {
+                bad = true;
+                break;
+            }
+            uint32_t frameID = (flags & 1) ? qFromLittleEndian<quint32>(data + pos) : qFromLittleEndian<quint16>(data + pos);
+            pos += idLen;
+            int dataLen = data[pos++];
+            if (dataLen > 64 || pos + dataLen > len)
+            {
+                bad = true;
+                break;
+            }
+            stamp += delta;
+
+            CANFrame &frame = slots[filled];
+            if (flags & 8) frame.setFrameType(QCanBusFrame::ErrorFrame);
+            else if (flags & 2) frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+            else frame.setFrameType(QCanBusFrame::DataFrame);
+            frame.setExtendedFrameFormat(flags & 1);
+            frame.setFrameId(frameID);
+            frame.setFlexibleDataRateFormat(flags & 4);
+            frame.setBitrateSwitch(flags & 16);
+            frame.bus = 0;
+            frame.isReceived = true;
+            frame.timedelta = 0;
+            frame.frameCount = 1;
+            frame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(stamp + shift)));
+
+            fillPayload(frame, data + pos, dataLen);
+            pos += dataLen;
+
+            checkTargettedFrame(frame);
+            filled++;
+        }
+
+        if (filled > 0)
+        {
+            getQueue().commit(filled);
+            queued = true;
+        }
+        remaining -= filled;
+    }
+
+    if (bad) sendDebug("Packed MQTT message is cut short or corrupt. Kept what decoded");
+    if (queued) notifyFramesQueued();
+}
+
+
+
 /****************************************************************/
 
 void MQTT_BUS::readSettings()
 {
     QSettings settings;
 
+    usePacked = settings.value("Remote/Packed", false).toBool();
+    packFrames = qBound(1, settings.value("Remote/PackFrames", 256).toInt(), 65535);
+    packDelay = settings.value("Remote/PackDelay", 50).toInt();
 }
 
 void MQTT_BUS::clientMessageReceived(const QMQTT::Message& message)
@@ -285,10 +501,20 @@ void MQTT_BUS::clientMessageReceived(const QMQTT::Message& message)
     if(isCapSuspended())
         return;
 
+    //whatever comes after "<topic>/". The topic itself may have slashes in it
+    const QString subTopic = message.topic().mid(topicName.length() + 1);
+    if (subTopic == QLatin1String("b"))
+    {
+        unpackFrames(message.payload());
+        return;
+    }
+
+    if (message.payload().count() < 9) return;
+
     CANFrame* frame_p = getQueue().get();
     if(frame_p)
     {
-        uint32_t frameID = message.topic().split("/")[1].toInt();
+        uint32_t frameID = subTopic.toUInt();
 
         QByteArray timeStampBytes = message.payload().left(8);
         uint64_t timeStamp = qFromLittleEndian<uint64_t>(timeStampBytes.data());
@@ -310,6 +536,7 @@ void MQTT_BUS::clientMessageReceived(const QMQTT::Message& message)
 
         /* enqueue frame */
         getQueue().queue();
+        notifyFramesQueued();
     }
 }
 
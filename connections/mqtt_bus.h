@@ -15,6 +15,23 @@
 #include "canconmanager.h"
 #include "simplecrypt.h"
 
+/*
+ * Packed mode (Remote/Packed). Instead of one message per frame on <topic>/<id>, frames are sent many to a message
+ * on <topic>/s/b and received on <topic>/b. Everything is little endian:
+ *   u8  version (MQTT_PACK_VERSION)
+ *   u16 number of frames
+ *   u64 timestamp of the first frame in microseconds
+ * then for each frame
+ *   varint  microseconds since the previous frame (7 bits a byte, low bits first, top bit set = more to come)
+ *   u8      flags: 1 = extended, 2 = remote, 4 = FD, 8 = error, 16 = bitrate switch
+ *   u16/u32 ID. Four bytes if extended, two otherwise
+ *   u8      payload length, then the payload
+ * A message goes out once it has Remote/PackFrames frames or its first frame is Remote/PackDelay ms old.
+ * Incoming packed messages are always decoded, the setting only picks what we send.
+ */
+#define MQTT_PACK_VERSION   1
+#define MQTT_PACK_HEADER    11
+
 class MQTT_BUS : public CANConnection
 {
     Q_OBJECT
@@ -31,6 +48,7 @@ protected:
     virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
     virtual void piSuspend(bool pSuspend);
     virtual bool piSendFrame(const CANFrame&) ;
+    virtual bool piSendFrames(const QList<CANFrame>&);
 
     void disconnectDevice();
 
@@ -41,6 +59,10 @@ private slots:
 
 private:
     void readSettings();
+    bool publishFrame(const CANFrame& frame, uint64_t micros);
+    void packFrame(const CANFrame& frame, uint64_t micros);
+    void flushPacked();
+    void unpackFrames(const QByteArray& bytes);
     void rebuildLocalTimeBasis();
     void sendDebug(const QString debugText);
     QString genRandomClientID();
@@ -49,6 +71,7 @@ private:
 protected:
     QTimer             mTimer;
     QThread            mThread;
+    QTimer             mPackTimer;
 
     QMQTT::Client *mqttClient;
     QString topicName;
@@ -62,6 +85,13 @@ protected:
     uint32_t buildTimeBasis;
     int32_t timeBasis;
     uint64_t lastSystemTimeBasis;
+
+    bool usePacked;
+    int packFrames;
+    int packDelay;
+    QByteArray packBuffer; //message being built, header first
+    int packCount;
+    uint64_t packLastStamp;
 };
 
 #endif // MQTT_BUS_H
@@ -1,6 +1,10 @@
 #include <QCanBus>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
 #include "newconnectiondialog.h"
 #include "ui_newconnectiondialog.h"
+#include "trafficgenerator.h"
 
 NewConnectionDialog::NewConnectionDialog(QVector<QString>* gvretips, QVector<QString>* kayakhosts, QWidget *parent) :
     QDialog(parent),
@@ -22,6 +26,10 @@ NewConnectionDialog::NewConnectionDialog(QVector<QString>* gvretips, QVector<QSt
     }
 
 
+#ifndef Q_OS_LINUX
+    ui->rbNativeSocketCAN->setEnabled(false);
+#endif
+
     connect(ui->rbGVRET, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
     connect(ui->rbSocketCAN, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
     connect(ui->rbRemote, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
@@ -30,6 +38,11 @@ NewConnectionDialog::NewConnectionDialog(QVector<QString>* gvretips, QVector<QSt
     connect(ui->rbLawicel, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
     connect(ui->rbCANserver, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
     connect(ui->rbCanlogserver, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
+    connect(ui->rbNativeSocketCAN, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
+    connect(ui->rbGenerator, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
+    connect(ui->rbLogReplay, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
+    connect(ui->rbCaptureLink, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
+    connect(ui->rbSharedCapture, &QAbstractButton::clicked, this, &NewConnectionDialog::handleConnTypeChanged);
 
     connect(ui->cbDeviceType, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &NewConnectionDialog::handleDeviceTypeChanged);
     connect(ui->btnOK, &QPushButton::clicked, this, &NewConnectionDialog::handleCreateButton);
@@ -70,6 +83,11 @@ void NewConnectionDialog::handleConnTypeChanged()
     if (ui->rbMQTT->isChecked()) selectMQTT();
     if (ui->rbCANserver->isChecked()) selectCANserver();
     if (ui->rbCanlogserver->isChecked()) selectCANlogserver();
+    if (ui->rbNativeSocketCAN->isChecked()) selectNativeSocketCan();
+    if (ui->rbGenerator->isChecked()) selectGenerator();
+    if (ui->rbLogReplay->isChecked()) selectLogReplay();
+    if (ui->rbCaptureLink->isChecked()) selectCaptureLink();
+    if (ui->rbSharedCapture->isChecked()) selectSharedCapture();
 }
 
 void NewConnectionDialog::handleDeviceTypeChanged()
@@ -270,6 +288,112 @@ void NewConnectionDialog::selectCANlogserver()
     ui->cbPort->clear();
 }
 
+void NewConnectionDialog::selectNativeSocketCan()
+{
+    ui->lPort->setText("Interface(s), comma separated:");
+
+    ui->lblDeviceType->setHidden(true);
+    ui->cbDeviceType->setHidden(true);
+    ui->cbCANSpeed->setHidden(true);
+    ui->cbSerialSpeed->setHidden(true);
+    ui->lblCANSpeed->setHidden(true);
+    ui->lblSerialSpeed->setHidden(true);
+    ui->cbCanFd->setHidden(true);
+    ui->cbDataRate->setHidden(true);
+    ui->lblDataRate->setHidden(true);
+
+    //list the CAN interfaces the kernel knows about (link type 280 is ARPHRD_CAN) and offer all of them together too
+    ui->cbPort->clear();
+    QStringList interfaces;
+    QDir netDir("/sys/class/net");
+    foreach (const QString &name, netDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        QFile typeFile(netDir.filePath(name + "/type"));
+        if (!typeFile.open(QIODevice::ReadOnly)) continue;
+        if (typeFile.readAll().trimmed() == "280") interfaces.append(name);
+    }
+    for (int i = 0; i < interfaces.count(); i++)
+        ui->cbPort->addItem(interfaces[i]);
+    if (interfaces.count() > 1) ui->cbPort->addItem(interfaces.join(','));
+}
+
+void NewConnectionDialog::selectGenerator()
+{
+    ui->lPort->setText("Generator settings:");
+
+    ui->lblDeviceType->setHidden(true);
+    ui->cbDeviceType->setHidden(true);
+    ui->cbCANSpeed->setHidden(true);
+    ui->cbSerialSpeed->setHidden(true);
+    ui->lblCANSpeed->setHidden(true);
+    ui->lblSerialSpeed->setHidden(true);
+    ui->cbCanFd->setHidden(true);
+    ui->cbDataRate->setHidden(true);
+    ui->lblDataRate->setHidden(true);
+
+    //a few starting points, the box is editable so any of the settings can be changed
+    ui->cbPort->clear();
+    ui->cbPort->addItems(TrafficGenerator::examplePorts());
+}
+
+void NewConnectionDialog::selectLogReplay()
+{
+    ui->lPort->setText("Replay settings, file last:");
+
+    ui->lblDeviceType->setHidden(true);
+    ui->cbDeviceType->setHidden(true);
+    ui->cbCANSpeed->setHidden(true);
+    ui->cbSerialSpeed->setHidden(true);
+    ui->lblCANSpeed->setHidden(true);
+    ui->lblSerialSpeed->setHidden(true);
+    ui->cbCanFd->setHidden(true);
+    ui->cbDataRate->setHidden(true);
+    ui->lblDataRate->setHidden(true);
+
+    //start from the folder logs were last loaded from, the file name still has to be typed in after it
+    QSettings settings;
+    QString dir = settings.value("FileIO/LoadSaveDirectory", QDir::homePath()).toString();
+    ui->cbPort->clear();
+    ui->cbPort->addItem("speed=1 loop=0 file=" + QDir(dir).filePath(""));
+    ui->cbPort->addItem("speed=max loop=0 file=" + QDir(dir).filePath(""));
+}
+
+void NewConnectionDialog::selectCaptureLink()
+{
+    ui->lPort->setText("Capture agent host[:port]:");
+
+    ui->lblDeviceType->setHidden(true);
+    ui->cbDeviceType->setHidden(true);
+    ui->cbCANSpeed->setHidden(true);
+    ui->cbSerialSpeed->setHidden(true);
+    ui->lblCANSpeed->setHidden(true);
+    ui->lblSerialSpeed->setHidden(true);
+    ui->cbCanFd->setHidden(true);
+    ui->cbDataRate->setHidden(true);
+    ui->lblDataRate->setHidden(true);
+
+    ui->cbPort->clear();
+}
+
+void NewConnectionDialog::selectSharedCapture()
+{
+    ui->lPort->setText("Name the hub shares as:");
+
+    ui->lblDeviceType->setHidden(true);
+    ui->cbDeviceType->setHidden(true);
+    ui->cbCANSpeed->setHidden(true);
+    ui->cbSerialSpeed->setHidden(true);
+    ui->lblCANSpeed->setHidden(true);
+    ui->lblSerialSpeed->setHidden(true);
+    ui->cbCanFd->setHidden(true);
+    ui->cbDataRate->setHidden(true);
+    ui->lblDataRate->setHidden(true);
+
+    QSettings settings;
+    ui->cbPort->clear();
+    ui->cbPort->addItem(settings.value("SharedCapture/Name", "savvycan").toString());
+}
+
 void NewConnectionDialog::setPortName(CANCon::type pType, QString pPortName, QString pDriver)
 {
 
@@ -299,6 +423,21 @@ void NewConnectionDialog::setPortName(CANCon::type pType, QString pPortName, QSt
         case CANCon::CANLOGSERVER:
           ui->rbCanlogserver->setChecked(true);
           break;
+        case CANCon::SOCKETCAN:
+          ui->rbNativeSocketCAN->setChecked(true);
+          break;
+        case CANCon::GENERATOR:
+          ui->rbGenerator->setChecked(true);
+          break;
+        case CANCon::LOGREPLAY:
+          ui->rbLogReplay->setChecked(true);
+          break;
+        case CANCon::CAPTURE_LINK:
+          ui->rbCaptureLink->setChecked(true);
+          break;
+        case CANCon::SHARED_CAPTURE:
+          ui->rbSharedCapture->setChecked(true);
+          break;
         default: {}
     }
 
@@ -344,6 +483,11 @@ void NewConnectionDialog::setPortName(CANCon::type pType, QString pPortName, QSt
             break;
         case CANCon::CANSERVER:
         case CANCon::CANLOGSERVER:
+        case CANCon::SOCKETCAN:
+        case CANCon::GENERATOR:
+        case CANCon::LOGREPLAY:
+        case CANCon::CAPTURE_LINK:
+        case CANCon::SHARED_CAPTURE:
         {
             ui->cbPort->setCurrentText(pPortName);
             break;
@@ -365,6 +509,11 @@ QString NewConnectionDialog::getPortName()
         return ui->cbPort->currentText();
     case CANCon::CANSERVER:
     case CANCon::CANLOGSERVER:
+    case CANCon::SOCKETCAN:
+    case CANCon::GENERATOR:
+    case CANCon::LOGREPLAY:
+    case CANCon::CAPTURE_LINK:
+    case CANCon::SHARED_CAPTURE:
         return ui->cbPort->currentText();
 
     default:
@@ -411,6 +560,11 @@ CANCon::type NewConnectionDialog::getConnectionType()
     if (ui->rbLawicel->isChecked()) return CANCon::LAWICEL;
     if (ui->rbCANserver->isChecked()) return CANCon::CANSERVER;
     if (ui->rbCanlogserver->isChecked()) return CANCon::CANLOGSERVER;
+    if (ui->rbNativeSocketCAN->isChecked()) return CANCon::SOCKETCAN;
+    if (ui->rbGenerator->isChecked()) return CANCon::GENERATOR;
+    if (ui->rbLogReplay->isChecked()) return CANCon::LOGREPLAY;
+    if (ui->rbCaptureLink->isChecked()) return CANCon::CAPTURE_LINK;
+    if (ui->rbSharedCapture->isChecked()) return CANCon::SHARED_CAPTURE;
     qDebug() << "getConnectionType: error";
 
     return CANCon::NONE;
@@ -50,6 +50,11 @@ private:
     void selectLawicel();
     void selectCANserver();
     void selectCANlogserver();
+    void selectNativeSocketCan();
+    void selectGenerator();
+    void selectLogReplay();
+    void selectCaptureLink();
+    void selectSharedCapture();
     bool isSerialBusAvailable();
     void setPortName(CANCon::type pType, QString pPortName, QString pDriver);
 };
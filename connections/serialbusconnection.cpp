@@ -41,6 +41,7 @@ void SerialBusConnection::piStarted()
     connect(mDev_p, &QCanBusDevice::errorOccurred, this, &SerialBusConnection::errorReceived);
     connect(mDev_p, &QCanBusDevice::framesWritten, this, &SerialBusConnection::framesWritten);
     connect(mDev_p, &QCanBusDevice::framesReceived, this, &SerialBusConnection::framesReceived);
+    applyRawFilters();
 
     connect(&mTimer, SIGNAL(timeout()), this, SLOT(testConnection()));
     mTimer.setInterval(1000);
@@ -120,6 +121,32 @@ void SerialBusConnection::piSetBusSettings(int pBusIdx, CANBus bus)
 }
 
 
+/*
+ * Only the socketcan plugin is documented to honor RawFilterKey. The others would take the key and quietly go on
+ * passing everything so report those as not filtering.
+ */
+bool SerialBusConnection::piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters)
+{
+    if (0 != pBusIdx)
+        return false;
+    if (getDriver() != "socketcan")
+        return pFilters.isEmpty();
+
+    mRawFilters.clear();
+    foreach (const CANAcceptanceFilter &accept, pFilters)
+    {
+        QCanBusDevice::Filter filter;
+        filter.frameId = accept.id & accept.mask;
+        filter.frameIdMask = accept.mask;
+        filter.type = QCanBusFrame::InvalidFrame; //any frame type
+        filter.format = QCanBusDevice::Filter::MatchBaseAndExtendedFormat;
+        mRawFilters.append(filter);
+    }
+    applyRawFilters();
+    return true;
+}
+
+
 bool SerialBusConnection::piSendFrame(const CANFrame& pFrame)
 {
     /* sanity checks */
@@ -136,6 +163,25 @@ bool SerialBusConnection::piSendFrame(const CANFrame& pFrame)
 /***********************************/
 
 
+void SerialBusConnection::applyRawFilters()
+{
+    if (!mDev_p || getDriver() != "socketcan") return;
+
+    //an empty list would make socketcan reject everything. A single match-all filter is how to accept it all again
+    QList<QCanBusDevice::Filter> filters = mRawFilters;
+    if (filters.isEmpty())
+    {
+        QCanBusDevice::Filter all;
+        all.frameId = 0;
+        all.frameIdMask = 0;
+        all.type = QCanBusFrame::InvalidFrame;
+        all.format = QCanBusDevice::Filter::MatchBaseAndExtendedFormat;
+        filters.append(all);
+    }
+    mDev_p->setConfigurationParameter(QCanBusDevice::RawFilterKey, QVariant::fromValue(filters));
+}
+
+
 /* disconnect device */
 void SerialBusConnection::disconnectDevice() {
     if(mDev_p) {
@@ -219,6 +265,7 @@ void SerialBusConnection::framesReceived()
 
                 /* enqueue frame */
                 getQueue().queue();
+                notifyFramesQueued();
             }
             else
                 qDebug() << "can't get a frame, ERROR";
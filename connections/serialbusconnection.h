@@ -38,8 +38,10 @@ protected:
     virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
     virtual void piSuspend(bool pSuspend);
     virtual bool piSendFrame(const CANFrame&);
+    virtual bool piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters);
 
     void disconnectDevice();
+    void applyRawFilters();
 
 private slots:
     void errorReceived(QCanBusDevice::CanBusError) const;
@@ -50,6 +52,7 @@ private slots:
 protected:
     QCanBusDevice     *mDev_p = nullptr;
     QTimer             mTimer;
+    QList<QCanBusDevice::Filter> mRawFilters; //empty = leave the plugin's default of accepting everything
 };
 
 
@@ -0,0 +1,152 @@
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+
+#include "sharedcapture.h"
+#include "canconmanager.h"
+
+#include <atomic>
+#include <cstring>
+
+SharedCaptureHub::SharedCaptureHub(QObject *parent) :
+    QObject(parent),
+    mHeader(nullptr),
+    mSlots(nullptr),
+    mMask(0),
+    mWriteIndex(0)
+{
+    mHeartbeat.setInterval(SHAREDCAPTURE_HEARTBEAT_MS);
+    connect(&mHeartbeat, &QTimer::timeout, this, &SharedCaptureHub::heartbeat);
+}
+
+SharedCaptureHub::~SharedCaptureHub()
+{
+    stop();
+}
+
+QString SharedCaptureHub::pathFor(const QString &pName)
+{
+    QDir shm("/dev/shm");
+    if (shm.exists()) return shm.filePath("savvycan-" + pName);
+    return QDir::temp().filePath("savvycan-" + pName + ".shm");
+}
+
+qint64 SharedCaptureHub::nowMs()
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+bool SharedCaptureHub::start(const QString &pName, int pSlots, QString &pError)
+{
+    if (mHeader) return true;
+
+    quint32 slots = 1024;
+    while (slots < static_cast<quint32>(qMax(pSlots, 1)) && slots < (1u << 24)) slots <<= 1;
+    const qint64 size = static_cast<qint64>(sizeof(SharedCaptureHeader)) + static_cast<qint64>(slots) * static_cast<qint64>(sizeof(SharedCaptureSlot));
+
+    mFile.setFileName(pathFor(pName));
+    if (!mFile.open(QIODevice::ReadWrite))
+    {
+        pError = mFile.errorString();
+        return false;
+    }
+    //readers may still have it mapped, so it only ever grows
+    if (mFile.size() < size && !mFile.resize(size))
+    {
+        pError = mFile.errorString();
+        mFile.close();
+        return false;
+    }
+    uchar *map = mFile.map(0, size);
+    if (!map)
+    {
+        pError = mFile.errorString();
+        mFile.close();
+        return false;
+    }
+
+    SharedCaptureHeader *header = reinterpret_cast<SharedCaptureHeader *>(map);
+    if (header->magic == SHAREDCAPTURE_MAGIC && nowMs() - header->heartbeatMs.loadRelaxed() < SHAREDCAPTURE_STALE_MS)
+    {
+        pError = tr("another SavvyCAN is already sharing its capture as \"%1\"").arg(pName);
+        mFile.unmap(map);
+        mFile.close();
+        return false;
+    }
+
+    //readers left from an earlier hub see the start time change and start over
+    header->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    memset(map + sizeof(SharedCaptureHeader), 0, static_cast<size_t>(size) - sizeof(SharedCaptureHeader));
+    header->version = SHAREDCAPTURE_VERSION;
+    header->slotCount = slots;
+    header->slotSize = sizeof(SharedCaptureSlot);
+    header->buses = static_cast<quint32>(CANConManager::getInstance()->getNumBuses());
+    header->reserved = 0;
+    header->startedMs = nowMs();
+    header->heartbeatMs.storeRelaxed(header->startedMs);
+    header->writeIndex.storeRelaxed(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHAREDCAPTURE_MAGIC;
+
+    mHeader = header;
+    mSlots = reinterpret_cast<SharedCaptureSlot *>(map + sizeof(SharedCaptureHeader));
+    mMask = slots - 1;
+    mWriteIndex = 0;
+    connect(CANConManager::getInstance(), &CANConManager::framesCaptured, this, &SharedCaptureHub::framesCaptured);
+    mHeartbeat.start();
+    qDebug() << "Shared capture: publishing" << slots << "slots at" << mFile.fileName();
+    return true;
+}
+
+void SharedCaptureHub::stop()
+{
+    if (!mHeader) return;
+    disconnect(CANConManager::getInstance(), &CANConManager::framesCaptured, this, &SharedCaptureHub::framesCaptured);
+    mHeartbeat.stop();
+    mHeader->heartbeatMs.storeRelease(0); //tells readers straight away rather than after the stale time
+    mFile.unmap(reinterpret_cast<uchar *>(mHeader));
+    mFile.close();
+    mHeader = nullptr;
+    mSlots = nullptr;
+}
+
+void SharedCaptureHub::heartbeat()
+{
+    if (!mHeader) return;
+    mHeader->buses = static_cast<quint32>(CANConManager::getInstance()->getNumBuses());
+    mHeader->heartbeatMs.storeRelease(nowMs());
+}
+
+void SharedCaptureHub::framesCaptured(const QVector<CANFrame> &pFrames)
+{
+    if (!mHeader) return;
+    for (const CANFrame &frame : pFrames)
+    {
+        SharedCaptureSlot &slot = mSlots[mWriteIndex & mMask];
+        slot.sequence.storeRelaxed(0);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const bool error = frame.frameType() == QCanBusFrame::ErrorFrame;
+        quint8 flags = 0;
+        if (frame.hasExtendedFrameFormat()) flags |= SHAREDCAPTURE_EXTENDED;
+        if (frame.hasFlexibleDataRateFormat()) flags |= SHAREDCAPTURE_FD;
+        if (frame.hasBitrateSwitch()) flags |= SHAREDCAPTURE_BRS;
+        if (frame.hasErrorStateIndicator()) flags |= SHAREDCAPTURE_ESI;
+        if (frame.frameType() == QCanBusFrame::RemoteRequestFrame) flags |= SHAREDCAPTURE_REMOTE;
+        if (error) flags |= SHAREDCAPTURE_ERROR;
+        if (frame.isReceived) flags |= SHAREDCAPTURE_RECEIVED;
+
+        const QByteArray &payload = frame.payload();
+        const int len = qMin(payload.length(), 64);
+        slot.timestampUs = static_cast<qint64>(frame.timeStamp().microSeconds());
+        slot.id = error ? static_cast<quint32>(frame.error()) : frame.frameId();
+        slot.flags = flags;
+        slot.bus = static_cast<quint8>(frame.bus);
+        slot.length = static_cast<quint8>(len);
+        memcpy(slot.data, payload.constData(), static_cast<size_t>(len));
+
+        slot.sequence.storeRelease(++mWriteIndex);
+    }
+    mHeader->writeIndex.storeRelease(mWriteIndex);
+}
@@ -0,0 +1,113 @@
+#ifndef SHAREDCAPTURE_H
+#define SHAREDCAPTURE_H
+
+#include <QAtomicInteger>
+#include <QFile>
+#include <QObject>
+#include <QTimer>
+
+#include "can_structs.h"
+
+#define SHAREDCAPTURE_MAGIC         0x48534353u //"SCSH"
+#define SHAREDCAPTURE_VERSION       1
+//slots in the ring unless the SharedCapture/Slots setting says otherwise. Rounded up to a power of two
+#define SHAREDCAPTURE_SLOTS         65536
+//the hub writes the time into the header this often. Readers give up on it after a few missed beats
+#define SHAREDCAPTURE_HEARTBEAT_MS  500
+#define SHAREDCAPTURE_STALE_MS      3000
+//buses a reader connection has, whatever the hub has
+#define SHAREDCAPTURE_MAX_BUSES     8
+
+/*
+ * Layout of the shared capture file. Everything is in the host's byte order and at fixed offsets so tools that
+ * aren't SavvyCAN (python's mmap for one) can read it too:
+ *
+ *  0   u32 magic, u32 version, u32 slot count (a power of two), u32 slot size, u32 hub buses, u32 reserved
+ *  24  i64 milliseconds since the epoch the hub started. Changes when a new hub takes the file over
+ *  32  i64 heartbeat, the hub's time in milliseconds since the epoch as of its last beat. 0 once it has stopped
+ *  64  u64 write index, how many frames were ever written. Frame n is in slot n % slot count
+ *  128 the slots
+ *
+ * A slot is u64 sequence, i64 timestamp in microseconds, u32 ID (error flags for an error frame), u8 flags (see
+ * SharedCaptureFlags), u8 bus, u8 length, a reserved byte and 64 bytes of payload. The sequence is 0 while the hub
+ * is writing the slot and n + 1 once it holds frame n, so a reader copies the slot out and then checks the sequence
+ * is still what it expects. If it isn't, the hub lapped the reader and the frame is gone.
+ */
+struct SharedCaptureHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 slotCount;
+    quint32 slotSize;
+    quint32 buses;
+    quint32 reserved;
+    qint64 startedMs;
+    QAtomicInteger<qint64> heartbeatMs;
+    char pad0[64 - 40];
+    QAtomicInteger<quint64> writeIndex; //own cache line, it's the one that changes all the time
+    char pad1[64 - 8];
+};
+
+struct SharedCaptureSlot
+{
+    QAtomicInteger<quint64> sequence;
+    qint64 timestampUs;
+    quint32 id;
+    quint8 flags;
+    quint8 bus;
+    quint8 length;
+    quint8 reserved;
+    quint8 data[64];
+};
+
+static_assert(sizeof(SharedCaptureHeader) == 128, "shared capture header layout is fixed");
+static_assert(sizeof(SharedCaptureSlot) == 88, "shared capture slot layout is fixed");
+
+enum SharedCaptureFlags
+{
+    SHAREDCAPTURE_EXTENDED  = 0x01,
+    SHAREDCAPTURE_FD        = 0x02,
+    SHAREDCAPTURE_BRS       = 0x04,
+    SHAREDCAPTURE_ESI       = 0x08,
+    SHAREDCAPTURE_REMOTE    = 0x10,
+    SHAREDCAPTURE_ERROR     = 0x20,
+    SHAREDCAPTURE_RECEIVED  = 0x40
+};
+
+/*
+ * Publishes everything this SavvyCAN captures into a ring in a memory mapped file so other SavvyCANs on the same
+ * machine can watch the same buses without opening the devices themselves (a SharedCaptureClient connection).
+ * There's one writer and any number of readers, each going at its own pace with its own read index. Readers never
+ * hold the hub up. One that falls a whole ring behind loses the frames it missed.
+ *
+ * The file is in /dev/shm where there is one, so it's only ever memory, and the temp folder otherwise.
+ */
+class SharedCaptureHub : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SharedCaptureHub(QObject *parent = nullptr);
+    ~SharedCaptureHub();
+
+    bool start(const QString &pName, int pSlots, QString &pError);
+    void stop();
+    bool isRunning() const { return mHeader != nullptr; }
+
+    static QString pathFor(const QString &pName);
+    static qint64 nowMs();
+
+private slots:
+    void framesCaptured(const QVector<CANFrame> &pFrames);
+    void heartbeat();
+
+private:
+    QFile mFile;
+    SharedCaptureHeader *mHeader;
+    SharedCaptureSlot *mSlots;
+    quint64 mMask;
+    quint64 mWriteIndex;
+    QTimer mHeartbeat;
+};
+
+#endif // SHAREDCAPTURE_H
@@ -0,0 +1,241 @@
+#include <QDebug>
+
+#include "sharedcaptureclient.h"
+
+#include <atomic>
+#include <cstring>
+
+SharedCaptureClient::SharedCaptureClient(QString pName) :
+    CANConnection(pName, "SharedCapture", CANCon::SHARED_CAPTURE, 0, 0, false, 0, SHAREDCAPTURE_MAX_BUSES, 16384, true),
+    mPollTimer(this) /*NB: set this as parent of timer to manage it from working thread */
+{
+    qDebug() << "SharedCapture: " << "Constructing new Connection...";
+
+    CANBus bus_info;
+    bus_info.setActive(true);
+    bus_info.setListenOnly(true);
+    bus_info.setSpeed(500000);
+    for (int i = 0; i < SHAREDCAPTURE_MAX_BUSES; i++) setBusConfig(i, bus_info);
+
+    mPollTimer.setInterval(SHAREDCAPTURECLIENT_POLL_MS);
+    mPollTimer.setTimerType(Qt::PreciseTimer);
+    connect(&mPollTimer, &QTimer::timeout, this, &SharedCaptureClient::poll);
+}
+
+SharedCaptureClient::~SharedCaptureClient()
+{
+    qDebug() << "SharedCapture: " << "Deconstructing Connection...";
+    stop();
+}
+
+void SharedCaptureClient::piStarted()
+{
+    attach();
+    mPollTimer.start();
+}
+
+void SharedCaptureClient::piStop()
+{
+    mPollTimer.stop();
+    detach();
+    if (mLostFrames > 0) sendDebug(QString("SharedCapture: fell too far behind the hub, %1 frames lost").arg(mLostFrames));
+}
+
+bool SharedCaptureClient::attach()
+{
+    mSinceAttempt.start();
+    mFile.setFileName(SharedCaptureHub::pathFor(getPort()));
+    if (!mFile.open(QIODevice::ReadOnly)) return false;
+
+    //the header first, for the size of the rest
+    const qint64 headerSize = static_cast<qint64>(sizeof(SharedCaptureHeader));
+    uchar *map = (mFile.size() >= headerSize) ? mFile.map(0, headerSize) : nullptr;
+    if (!map)
+    {
+        mFile.close();
+        return false;
+    }
+    const SharedCaptureHeader *header = reinterpret_cast<const SharedCaptureHeader *>(map);
+    const quint32 slots = header->slotCount;
+    const bool usable = header->magic == SHAREDCAPTURE_MAGIC && header->version == SHAREDCAPTURE_VERSION
+            && header->slotSize == sizeof(SharedCaptureSlot) && slots > 0 && (slots & (slots - 1)) == 0
+            && SharedCaptureHub::nowMs() - header->heartbeatMs.loadAcquire() < SHAREDCAPTURE_STALE_MS;
+    mFile.unmap(map);
+    const qint64 size = headerSize + static_cast<qint64>(slots) * static_cast<qint64>(sizeof(SharedCaptureSlot));
+    if (!usable || mFile.size() < size || !(map = mFile.map(0, size)))
+    {
+        mFile.close();
+        return false;
+    }
+
+    mHeader = reinterpret_cast<const SharedCaptureHeader *>(map);
+    mSlots = reinterpret_cast<const SharedCaptureSlot *>(map + headerSize);
+    mMask = slots - 1;
+    mStartedMs = mHeader->startedMs;
+    mReadIndex = mHeader->writeIndex.loadAcquire(); //only what comes in from now on
+    sendDebug(QString("SharedCapture: reading %1, hub has %2 buses").arg(mFile.fileName()).arg(mHeader->buses));
+    setConnected(true);
+    return true;
+}
+
+void SharedCaptureClient::detach()
+{
+    if (mHeader)
+    {
+        mFile.unmap(reinterpret_cast<uchar *>(const_cast<SharedCaptureHeader *>(mHeader)));
+        mHeader = nullptr;
+        mSlots = nullptr;
+    }
+    mFile.close();
+    setConnected(false);
+}
+
+void SharedCaptureClient::setConnected(bool pConnected)
+{
+    CANCon::status want = pConnected ? CANCon::CONNECTED : CANCon::NOT_CONNECTED;
+    if (getStatus() == want) return;
+    setStatus(want);
+    CANConStatus stats;
+    stats.conStatus = want;
+    stats.numHardwareBuses = SHAREDCAPTURE_MAX_BUSES;
+    emit status(stats);
+}
+
+void SharedCaptureClient::poll()
+{
+    if (!mHeader)
+    {
+        if (mSinceAttempt.elapsed() >= SHAREDCAPTURECLIENT_RETRY_MS) attach();
+        return;
+    }
+
+    const quint64 written = mHeader->writeIndex.loadAcquire();
+    if (written == mReadIndex)
+    {
+        //quiet, good time to check the hub is still there
+        if (mHeader->magic != SHAREDCAPTURE_MAGIC || mHeader->startedMs != mStartedMs
+                || SharedCaptureHub::nowMs() - mHeader->heartbeatMs.loadAcquire() >= SHAREDCAPTURE_STALE_MS)
+        {
+            sendDebug("SharedCapture: hub went away, waiting for it to come back");
+            detach();
+        }
+        return;
+    }
+    if (written < mReadIndex || mHeader->startedMs != mStartedMs)
+    {
+        detach(); //a new hub took the file over, pick it up fresh
+        return;
+    }
+
+    const quint64 slotCount = mMask + 1;
+    if (written - mReadIndex > slotCount)
+    {
+        //lapped. Leave some room as well, the hub is still writing over the oldest ones
+        quint64 resume = written - slotCount + slotCount / 8;
+        mLostFrames += resume - mReadIndex;
+        mReadIndex = resume;
+    }
+    if (isCapSuspended())
+    {
+        mReadIndex = written;
+        return;
+    }
+
+    int queued = 0, dropped = 0;
+    while (mReadIndex < written)
+    {
+        int granted;
+        CANFrame *slots = getQueue().reserve(static_cast<int>(qMin<quint64>(written - mReadIndex, SHAREDCAPTURECLIENT_RX_BATCH)), granted);
+        if (!slots)
+        {
+            dropped += static_cast<int>(written - mReadIndex);
+            mReadIndex = written;
+            break;
+        }
+
+        int used = 0;
+        for (; used < granted && mReadIndex < written; mReadIndex++)
+        {
+            const SharedCaptureSlot &slot = mSlots[mReadIndex & mMask];
+            if (slot.sequence.loadAcquire() != mReadIndex + 1)
+            {
+                mLostFrames++;
+                continue;
+            }
+            SharedCaptureSlot copy;
+            memcpy(static_cast<void *>(&copy), &slot, sizeof(copy));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            //written over while it was being copied
+            if (slot.sequence.loadRelaxed() != mReadIndex + 1)
+            {
+                mLostFrames++;
+                continue;
+            }
+            if (copy.bus >= SHAREDCAPTURE_MAX_BUSES) continue;
+
+            CANFrame *frame_p = &slots[used++];
+            if (copy.flags & SHAREDCAPTURE_ERROR)
+            {
+                frame_p->setFrameType(QCanBusFrame::ErrorFrame);
+                frame_p->setError(QCanBusFrame::FrameErrors(QFlag(static_cast<int>(copy.id))));
+            }
+            else
+            {
+                frame_p->setFrameType((copy.flags & SHAREDCAPTURE_REMOTE) ? QCanBusFrame::RemoteRequestFrame : QCanBusFrame::DataFrame);
+                frame_p->setFrameId(copy.id);
+            }
+            frame_p->setExtendedFrameFormat(copy.flags & SHAREDCAPTURE_EXTENDED);
+            frame_p->setFlexibleDataRateFormat(copy.flags & SHAREDCAPTURE_FD);
+            frame_p->setBitrateSwitch(copy.flags & SHAREDCAPTURE_BRS);
+            frame_p->setErrorStateIndicator(copy.flags & SHAREDCAPTURE_ESI);
+            frame_p->setLocalEcho(false);
+            frame_p->isReceived = (copy.flags & SHAREDCAPTURE_RECEIVED) != 0;
+            frame_p->bus = copy.bus;
+            frame_p->timedelta = 0;
+            frame_p->frameCount = 1;
+            frame_p->setTimeStamp(QCanBusFrame::TimeStamp(0, copy.timestampUs));
+
+            fillPayload(*frame_p, copy.data, qMin<int>(copy.length, 64));
+
+            checkTargettedFrame(*frame_p);
+        }
+        if (used > 0) getQueue().commit(used);
+        queued += used;
+    }
+
+    if (queued > 0) notifyFramesQueued();
+    if (dropped > 0)
+    {
+        qDebug() << "can't get a frame, ERROR";
+        getQueue().drop(dropped);
+    }
+}
+
+void SharedCaptureClient::piSuspend(bool pSuspend)
+{
+    setCapSuspended(pSuspend);
+    if (isCapSuspended()) getQueue().flush();
+}
+
+bool SharedCaptureClient::piGetBusSettings(int pBusIdx, CANBus& pBus)
+{
+    return getBusConfig(pBusIdx, pBus);
+}
+
+void SharedCaptureClient::piSetBusSettings(int pBusIdx, CANBus pBus)
+{
+    if (pBusIdx < 0 || pBusIdx >= getNumBuses()) return;
+    setBusConfig(pBusIdx, pBus);
+}
+
+bool SharedCaptureClient::piSendFrame(const CANFrame&)
+{
+    //the hub only shares its capture
+    return true;
+}
+
+void SharedCaptureClient::sendDebug(const QString &debugText)
+{
+    qDebug() << debugText;
+    debugOutput(debugText);
+}
@@ -0,0 +1,60 @@
+#ifndef SHAREDCAPTURECLIENT_H
+#define SHAREDCAPTURECLIENT_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
+
+#include "canconnection.h"
+#include "sharedcapture.h"
+
+//how often the ring is looked at. Nothing wakes a reader in another process so it has to go and look
+#define SHAREDCAPTURECLIENT_POLL_MS     2
+//between tries to find the hub while there isn't one
+#define SHAREDCAPTURECLIENT_RETRY_MS    1000
+//queue slots asked for at a time
+#define SHAREDCAPTURECLIENT_RX_BATCH    256
+
+/*
+ * Reads the capture another SavvyCAN on this machine publishes with SharedCaptureHub. The port is the name the hub
+ * shares as. Each slot is copied out of the mapping once and then straight into a queue slot. A reader that falls
+ * a whole ring behind skips to the frames still there and counts the rest as lost. Sending isn't supported, the
+ * hub's buses are its own.
+ */
+class SharedCaptureClient : public CANConnection
+{
+    Q_OBJECT
+
+public:
+    SharedCaptureClient(QString pName);
+    virtual ~SharedCaptureClient();
+
+protected:
+    virtual void piStarted();
+    virtual void piStop();
+    virtual void piSetBusSettings(int pBusIdx, CANBus pBus);
+    virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
+    virtual void piSuspend(bool pSuspend);
+    virtual bool piSendFrame(const CANFrame&);
+
+private slots:
+    void poll();
+
+private:
+    bool attach();
+    void detach();
+    void setConnected(bool pConnected);
+    void sendDebug(const QString &debugText);
+
+    QFile mFile;
+    const SharedCaptureHeader *mHeader = nullptr;
+    const SharedCaptureSlot *mSlots = nullptr;
+    quint64 mMask = 0;
+    qint64 mStartedMs = 0;      //which hub the read index belongs to
+    quint64 mReadIndex = 0;
+    quint64 mLostFrames = 0;
+    QTimer mPollTimer;
+    QElapsedTimer mSinceAttempt;
+};
+
+#endif // SHAREDCAPTURECLIENT_H
@@ -0,0 +1,428 @@
+#include "socketcan.h"
+#include "canconmanager.h"
+#include "threadpolicy.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+/* room for whichever timestamp message the socket ends up sending */
+#define SOCKETCAN_CTRL_SIZE (CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(struct timespec)))
+
+static inline qint64 timespecToUs(const struct timespec &ts)
+{
+    return static_cast<qint64>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+SocketCAN::SocketCAN(QString portName) :
+    CANConnection(portName, "socketcan", CANCon::SOCKETCAN, 0, 0, false, 0,
+                  qMax(1, portName.split(',', Qt::SkipEmptyParts).count()), 16384, false),
+    mReader_p(nullptr),
+    mStopReader(0)
+{
+    foreach (const QString &name, portName.split(',', Qt::SkipEmptyParts))
+    {
+        Interface iface;
+        iface.name = name.trimmed();
+        mInterfaces.append(iface);
+    }
+    if (mInterfaces.isEmpty()) mInterfaces.resize(1);
+
+    /* the reader thread owns the producer side of the queue. Sent frames come back from the kernel instead */
+    setTxEcho(false);
+    mFilters.resize(mInterfaces.count());
+}
+
+
+SocketCAN::~SocketCAN()
+{
+    stop();
+}
+
+
+void SocketCAN::piStarted()
+{
+    int opened = 0;
+    for (int i = 0; i < mInterfaces.count(); i++)
+    {
+        if (!openInterface(mInterfaces[i])) continue;
+        opened++;
+        applyFilters(i);
+        mBusData[i].mConfigured = true;
+        mBusData[i].mBus.setActive(true);
+    }
+
+    if (opened == 0)
+    {
+        updateStatus(CANCon::NOT_CONNECTED);
+        return;
+    }
+
+    mStopReader.storeRelease(0);
+    mReader_p = QThread::create([this]{ readLoop(); });
+    mReader_p->start(QThread::HighPriority);
+    updateStatus(CANCon::CONNECTED);
+}
+
+
+void SocketCAN::piStop()
+{
+    if (mReader_p)
+    {
+        mStopReader.storeRelease(1);
+        mReader_p->wait();
+        delete mReader_p;
+        mReader_p = nullptr;
+    }
+
+    for (int i = 0; i < mInterfaces.count(); i++)
+    {
+        if (mInterfaces[i].fd >= 0) close(mInterfaces[i].fd);
+        mInterfaces[i].fd = -1;
+        mInterfaces[i].hwOffsetValid = false;
+    }
+    updateStatus(CANCon::NOT_CONNECTED);
+}
+
+
+//You cannot set the speed of a socketcan interface from here, it has to be set with ip link
+void SocketCAN::piSetBusSettings(int pBusIdx, CANBus bus)
+{
+    /* sanity checks */
+    if( (pBusIdx < 0) || pBusIdx >= getNumBuses())
+        return;
+
+    /* copy bus config */
+    setBusConfig(pBusIdx, bus);
+}
+
+
+bool SocketCAN::piGetBusSettings(int pBusIdx, CANBus& pBus)
+{
+    return getBusConfig(pBusIdx, pBus);
+}
+
+
+void SocketCAN::piSuspend(bool pSuspend)
+{
+    /* update capSuspended */
+    setCapSuspended(pSuspend);
+
+    /* flush queue if we are suspended */
+    if(isCapSuspended())
+        getQueue().flush();
+}
+
+
+bool SocketCAN::piSendFrame(const CANFrame& pFrame)
+{
+    /* sanity checks */
+    if (pFrame.bus < 0 || pFrame.bus >= mInterfaces.count())
+        return false;
+    int fd = mInterfaces[pFrame.bus].fd;
+    if (fd < 0) return false;
+
+    const QByteArray &payload = pFrame.payload();
+    bool fdFrame = pFrame.hasFlexibleDataRateFormat() || payload.length() > CAN_MAX_DLEN;
+    if (payload.length() > (fdFrame ? CANFD_MAX_DLEN : CAN_MAX_DLEN))
+        return false;
+
+    struct canfd_frame raw;
+    memset(&raw, 0, sizeof(raw));
+    if (pFrame.hasExtendedFrameFormat()) raw.can_id = (pFrame.frameId() & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    else raw.can_id = pFrame.frameId() & CAN_SFF_MASK;
+    if (pFrame.frameType() == QCanBusFrame::RemoteRequestFrame) raw.can_id |= CAN_RTR_FLAG;
+    raw.len = static_cast<uint8_t>(payload.length());
+    if (fdFrame && pFrame.hasBitrateSwitch()) raw.flags |= CANFD_BRS;
+    memcpy(raw.data, payload.constData(), static_cast<size_t>(payload.length()));
+
+    if (write(fd, &raw, fdFrame ? CANFD_MTU : CAN_MTU) < 0)
+    {
+        qDebug() << "SocketCAN write to" << mInterfaces[pFrame.bus].name << "failed:" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+
+//The kernel filters per socket. Everything that doesn't match is dropped before it ever gets to us
+bool SocketCAN::piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters)
+{
+    if (pBusIdx < 0 || pBusIdx >= mInterfaces.count()) return false;
+    mFilters[pBusIdx] = pFilters;
+    applyFilters(pBusIdx);
+    return true;
+}
+
+
+/***********************************/
+/****   private methods         ****/
+/***********************************/
+
+
+bool SocketCAN::openInterface(Interface &iface)
+{
+    iface.fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (iface.fd < 0)
+    {
+        qWarning() << "SocketCAN could not create a socket for" << iface.name << ":" << strerror(errno);
+        return false;
+    }
+
+    /* older kernels don't do FD. Classic frames still work then */
+    int on = 1;
+    setsockopt(iface.fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on));
+
+    /* our own frames get read back (flagged as local echo) with a proper kernel timestamp */
+    setsockopt(iface.fd, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on));
+
+    /* pass error frames up like the SerialBus plugin does */
+    can_err_mask_t errMask = CAN_ERR_MASK;
+    setsockopt(iface.fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &errMask, sizeof(errMask));
+
+    /* hardware stamps if the driver has them, kernel receive time otherwise */
+    int stampFlags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+                   | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (setsockopt(iface.fd, SOL_SOCKET, SO_TIMESTAMPING, &stampFlags, sizeof(stampFlags)) < 0)
+        setsockopt(iface.fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+    /* a bigger receive buffer rides out the GUI thread being busy for a moment. The kernel caps it at rmem_max */
+    int rcvBuf = 4 * 1024 * 1024;
+    setsockopt(iface.fd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, iface.name.toLocal8Bit().constData(), IFNAMSIZ - 1);
+    if (ioctl(iface.fd, SIOCGIFINDEX, &ifr) < 0)
+    {
+        qWarning() << "SocketCAN has no interface called" << iface.name;
+        close(iface.fd);
+        iface.fd = -1;
+        return false;
+    }
+
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(iface.fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        qWarning() << "SocketCAN could not bind to" << iface.name << ":" << strerror(errno);
+        close(iface.fd);
+        iface.fd = -1;
+        return false;
+    }
+
+    qDebug() << "SocketCAN opened" << iface.name;
+    return true;
+}
+
+
+void SocketCAN::applyFilters(int pBusIdx)
+{
+    int fd = mInterfaces[pBusIdx].fd;
+    if (fd < 0) return;
+
+    /* no mask on the EFF flag so each filter matches standard and extended frames alike */
+    QVector<struct can_filter> raw;
+    foreach (const CANAcceptanceFilter &accept, mFilters[pBusIdx])
+    {
+        struct can_filter filter;
+        filter.can_id = accept.id & accept.mask & CAN_EFF_MASK;
+        filter.can_mask = accept.mask & CAN_EFF_MASK;
+        raw.append(filter);
+    }
+    if (raw.isEmpty())
+    {
+        struct can_filter all;
+        all.can_id = 0;
+        all.can_mask = 0;
+        raw.append(all);
+    }
+
+    if (setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, raw.constData(), static_cast<socklen_t>(raw.count() * sizeof(struct can_filter))) < 0)
+        qWarning() << "SocketCAN could not set filters on" << mInterfaces[pBusIdx].name << ":" << strerror(errno);
+}
+
+
+void SocketCAN::updateStatus(CANCon::status pStatus)
+{
+    if (getStatus() == pStatus) return;
+    setStatus(pStatus);
+
+    CANConStatus stats;
+    stats.conStatus = getStatus();
+    stats.numHardwareBuses = mNumBuses;
+    emit status(stats);
+}
+
+
+void SocketCAN::readLoop()
+{
+    struct canfd_frame frames[SOCKETCAN_RX_BATCH];
+    struct iovec iov[SOCKETCAN_RX_BATCH];
+    struct mmsghdr msgs[SOCKETCAN_RX_BATCH];
+    alignas(struct cmsghdr) char control[SOCKETCAN_RX_BATCH][SOCKETCAN_CTRL_SIZE];
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < SOCKETCAN_RX_BATCH; i++)
+    {
+        iov[i].iov_base = &frames[i];
+        iov[i].iov_len = sizeof(struct canfd_frame);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = control[i];
+    }
+
+    ThreadPolicy::apply(ThreadPolicy::CAPTURE);
+
+    QVector<struct pollfd> fds(mInterfaces.count());
+    for (int i = 0; i < mInterfaces.count(); i++)
+    {
+        fds[i].fd = mInterfaces[i].fd; //poll skips the ones that didn't open (-1)
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    while (!mStopReader.loadAcquire())
+    {
+        //wake up every so often to see if we should stop
+        int ready = poll(fds.data(), static_cast<nfds_t>(fds.count()), 100);
+        if (ready < 0)
+        {
+            if (errno == EINTR) continue;
+            qWarning() << "SocketCAN poll failed:" << strerror(errno);
+            break;
+        }
+        if (ready == 0) continue;
+
+        for (int bus = 0; bus < fds.count(); bus++)
+        {
+            if (fds[bus].revents & POLLERR)
+            {
+                //usually the interface went down. Reading the error clears it. Frames coming back reconnects us
+                int err = 0;
+                socklen_t errLen = sizeof(err);
+                getsockopt(fds[bus].fd, SOL_SOCKET, SO_ERROR, &err, &errLen);
+                if (err == ENETDOWN) updateStatus(CANCon::NOT_CONNECTED);
+            }
+            if (!(fds[bus].revents & POLLIN)) continue;
+
+            for (int i = 0; i < SOCKETCAN_RX_BATCH; i++)
+            {
+                msgs[i].msg_hdr.msg_controllen = SOCKETCAN_CTRL_SIZE;
+                msgs[i].msg_hdr.msg_flags = 0;
+            }
+            int got = recvmmsg(fds[bus].fd, msgs, SOCKETCAN_RX_BATCH, MSG_DONTWAIT, nullptr);
+            if (got <= 0) continue;
+            updateStatus(CANCon::CONNECTED);
+
+            /* drop frames if capture is suspended */
+            if (isCapSuspended()) continue;
+
+            uint64_t timeBasis = CANConManager::getInstance()->getTimeBasis();
+            int done = 0;
+            while (done < got)
+            {
+                int granted = 0;
+                CANFrame *slot_p = getQueue().reserve(got - done, granted);
+                if (!slot_p)
+                {
+                    qDebug() << "can't get a frame, ERROR";
+                    getQueue().drop(got - done);
+                    break;
+                }
+                for (int j = 0; j < granted; j++)
+                {
+                    fillFrame(slot_p[j], bus, frames[done + j], msgs[done + j].msg_hdr, msgs[done + j].msg_len, timeBasis);
+                    checkTargettedFrame(slot_p[j]);
+                }
+                getQueue().commit(granted);
+                done += granted;
+            }
+            notifyFramesQueued();
+        }
+    }
+}
+
+
+void SocketCAN::fillFrame(CANFrame &frame, int pBusIdx, const canfd_frame &raw, msghdr &msg, unsigned int mtu, uint64_t timeBasis)
+{
+    Interface &iface = mInterfaces[pBusIdx];
+    bool fd = (mtu == CANFD_MTU);
+    int len = qMin<int>(raw.len, fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN);
+
+    if (raw.can_id & CAN_ERR_FLAG)
+    {
+        frame.setFrameType(QCanBusFrame::ErrorFrame);
+        frame.setError(QCanBusFrame::FrameErrors(QFlag(static_cast<int>(raw.can_id & CAN_ERR_MASK))));
+        frame.setExtendedFrameFormat(false);
+    }
+    else
+    {
+        bool extended = (raw.can_id & CAN_EFF_FLAG) != 0;
+        frame.setFrameType((raw.can_id & CAN_RTR_FLAG) ? QCanBusFrame::RemoteRequestFrame : QCanBusFrame::DataFrame);
+        frame.setFrameId(raw.can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK));
+        frame.setExtendedFrameFormat(extended);
+        if (raw.can_id & CAN_RTR_FLAG) len = 0;
+    }
+    frame.setFlexibleDataRateFormat(fd);
+    frame.setBitrateSwitch(fd && (raw.flags & CANFD_BRS));
+    frame.setErrorStateIndicator(fd && (raw.flags & CANFD_ESI));
+    /* sent by something else on this machine */
+    bool localEcho = (msg.msg_flags & MSG_DONTROUTE) != 0;
+    frame.setLocalEcho(localEcho);
+    frame.isReceived = !localEcho;
+    frame.bus = pBusIdx;
+    frame.timedelta = 0;
+    frame.frameCount = 1;
+
+    fillPayload(frame, raw.data, len);
+
+    qint64 stampUs = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET) continue;
+        if (cmsg->cmsg_type == SO_TIMESTAMPING)
+        {
+            struct scm_timestamping stamps;
+            memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+            qint64 software = timespecToUs(stamps.ts[0]);
+            qint64 hardware = timespecToUs(stamps.ts[2]);
+            if (hardware)
+            {
+                //the hardware clock runs on its own so measure it against the system clock once and follow it from
+                //there. Measure again if it wanders far enough off that the two would be obviously out of step
+                qint64 reference = software ? software : QDateTime::currentMSecsSinceEpoch() * 1000;
+                if (!iface.hwOffsetValid || qAbs(hardware + iface.hwOffsetUs - reference) > 10000)
+                {
+                    iface.hwOffsetUs = reference - hardware;
+                    iface.hwOffsetValid = true;
+                }
+                stampUs = hardware + iface.hwOffsetUs;
+            }
+            else stampUs = software;
+        }
+        else if (cmsg->cmsg_type == SO_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            stampUs = timespecToUs(ts);
+        }
+    }
+    if (stampUs == 0) stampUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+
+    if (useSystemTime) frame.setTimeStamp(QCanBusFrame::TimeStamp(0, stampUs));
+    else frame.setTimeStamp(QCanBusFrame::TimeStamp(0, stampUs - static_cast<qint64>(timeBasis)));
+}
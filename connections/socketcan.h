@@ -0,0 +1,65 @@
+#ifndef SOCKETCAN_H
+#define SOCKETCAN_H
+
+#include <QThread>
+#include <QVector>
+
+#include "canconnection.h"
+
+struct canfd_frame;
+struct msghdr;
+
+/*
+ * Native Linux SocketCAN. Talks to the kernel directly instead of going through the QtSerialBus plugin so a capture
+ * box with several (FD) interfaces can keep up with them all:
+ * - one reader thread polls every interface and pulls frames out with recvmmsg, up to SOCKETCAN_RX_BATCH per call
+ * - frames go straight into the connection queue in contiguous runs using reserve()/commit()
+ * - timestamps come from the kernel (SO_TIMESTAMPING). Hardware stamps are used when the driver provides them,
+ *   lined up with the system clock so they can be mixed with other connections
+ * - acceptance filters become CAN_RAW_FILTER on the socket so unwanted frames never leave the kernel
+ *
+ * The port name is a comma separated list of interfaces ("can0,can1"). Each one is a bus, in that order.
+ * Bitrates have to be set up with ip link, same as with the SerialBus socketcan plugin.
+ */
+
+#define SOCKETCAN_RX_BATCH  64
+
+class SocketCAN : public CANConnection
+{
+    Q_OBJECT
+
+public:
+    SocketCAN(QString portName);
+    virtual ~SocketCAN();
+
+protected:
+    virtual void piStarted();
+    virtual void piStop();
+    virtual void piSetBusSettings(int pBusIdx, CANBus pBus);
+    virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
+    virtual void piSuspend(bool pSuspend);
+    virtual bool piSendFrame(const CANFrame&);
+    virtual bool piSetAcceptanceFilters(int pBusIdx, const QVector<CANAcceptanceFilter>& pFilters);
+
+private:
+    struct Interface
+    {
+        QString name;
+        int fd = -1;
+        qint64 hwOffsetUs = 0; //system clock minus hardware clock, measured on the first hardware stamp
+        bool hwOffsetValid = false;
+    };
+
+    bool openInterface(Interface &iface);
+    void applyFilters(int pBusIdx);
+    void readLoop();
+    void fillFrame(CANFrame &frame, int pBusIdx, const canfd_frame &raw, msghdr &msg, unsigned int mtu, uint64_t timeBasis);
+    void updateStatus(CANCon::status pStatus);
+
+    QVector<Interface> mInterfaces;
+    QVector<QVector<CANAcceptanceFilter>> mFilters;
+    QThread *mReader_p;
+    QAtomicInt mStopReader;
+};
+
+#endif // SOCKETCAN_H
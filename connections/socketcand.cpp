@@ -6,6 +6,7 @@
 #include <QStringBuilder>
 #include <QtNetwork>
 #include <QMetaObject>
+#include <cstring>
 
 #include "socketcand.h"
 
@@ -32,7 +33,7 @@ SocketCANd::SocketCANd(QString portName) :
     for (int i = 0; i < mNumBuses; i++)
     {
         rx_state.append(IDLE);
-        unprocessedData.append("");
+        rxBuffer.append(QByteArray());
     }
 
 }
@@ -58,13 +59,8 @@ void SocketCANd::sendBytesToTCP(const QByteArray &bytes, int busNum)
         return;
     }
 
-    QString buildDebug;
-    buildDebug = "Send data to " + hostIP.toString() + ":" + QString::number(hostPort) + " -> ";
-    foreach (int byt, bytes) {
-        byt = (unsigned char)byt;
-        buildDebug = buildDebug % QString::number(byt, 16) % " ";
-    }
-    //sendDebug(buildDebug);
+    //a whole batch of frames can come through here so don't build the hex dump unless it's going somewhere
+    //sendDebug("Send data to " + hostIP.toString() + ":" + QString::number(hostPort) + " -> " + QString::fromLatin1(bytes.toHex(' ')));
 
     if (tcpClient[busNum]) tcpClient[busNum]->write(bytes);
 }
@@ -124,9 +120,8 @@ void SocketCANd::piSetBusSettings(int pBusIdx, CANBus bus)
 
 bool SocketCANd::piSendFrame(const CANFrame& frame)
 {
-    QByteArray buffer;
     int c;
-    int ID;
+    quint32 ID;
 
 //    //calculate bus number offset (in case of multiple connections)
 //    //useless since SavvyCAN already delivers the right index in frame.bus
@@ -143,6 +138,7 @@ bool SocketCANd::piSendFrame(const CANFrame& frame)
 
     framesRapid++;
 
+    if (busNum < 0 || busNum >= tcpClient.length()) return false;
     if (tcpClient[busNum] && !tcpClient[busNum]->isOpen()) return false;
     //if (!isConnected) return false;
 
@@ -152,22 +148,48 @@ bool SocketCANd::piSendFrame(const CANFrame& frame)
         return true;
     }
     ID = frame.frameId();
-    if (frame.hasExtendedFrameFormat()) ID |= 1 << 31;
-
-    QString sendStr = "< send " + QString::number(ID, 16) + " " + QString::number(frame.payload().length()) + " ";
-    for (c = 0; c < frame.payload().length(); c++)
+    if (frame.hasExtendedFrameFormat()) ID |= 1u << 31;
+
+    //each bus has its own socket so each gets its own pending buffer
+    QByteArray &buffer = txBuffer(busNum);
+    const QByteArray payload = frame.payload();
+    buffer.append("< send ");
+    buffer.append(QByteArray::number(ID, 16));
+    buffer.append(' ');
+    buffer.append(QByteArray::number(payload.length()));
+    buffer.append(' ');
+    for (c = 0; c < payload.length(); c++)
     {
-       sendStr.append(QString::number(frame.payload()[c], 16) + " ");
+        buffer.append(QByteArray::number((uint8_t)payload[c], 16));
+        buffer.append(' ');
     }
-    sendStr.append(">");
-    std::string str = sendStr.toStdString();
-    const char* sendCmd = str.c_str();
-    sendStringToTCP(sendCmd, busNum);
+    buffer.append('>');
+
+    txQueued();
 
     return true;
 }
 
 
+void SocketCANd::piWriteTx(int pBusIdx, const QByteArray& pBytes)
+{
+    if (pBusIdx >= tcpClient.length()) return;
+    sendBytesToTCP(pBytes, pBusIdx);
+}
+
+
+qint64 SocketCANd::piTxBacklog()
+{
+    if (tcpClient.isEmpty()) return -1;
+    qint64 backlog = 0;
+    for (int i = 0; i < tcpClient.length(); i++)
+    {
+        if (tcpClient[i]) backlog += tcpClient[i]->bytesToWrite();
+    }
+    return backlog;
+}
+
+
 
 /****************************************************************/
 
@@ -202,10 +224,11 @@ void SocketCANd::connectDevice()
     for (int i = 0; i < mNumBuses; i++)
     {
         rx_state[i] = IDLE;
+        rxBuffer[i].clear();
         tcpClient.append(new QTcpSocket());
         tcpClient[i]->connectToHost(hostIP, hostPort);
-        //connect(tcpClient[i], SIGNAL(readyRead()), this, SLOT(readTCPData()));
-        connect(tcpClient[i], SIGNAL(readyRead()), this, SLOT(invokeReadTCPData()));
+        //the bus rides along with the signal so there's no looking the sender up again on every read
+        connect(tcpClient[i], &QTcpSocket::readyRead, this, [this, i]() { readTCPData(i); });
         sendDebug("Created TCP Socket to Kayak device " + hostCanIDs.at(i));
     }
     setStatus(CANCon::CONNECTED);
@@ -221,8 +244,6 @@ void SocketCANd::deviceConnected(int busNum)
     sendDebug("Opening CAN on Kayak Device!");
     QString openCanCmd("< open " % hostCanIDs[busNum] % " >");
     sendStringToTCP(openCanCmd.toUtf8().data(), busNum);
-
-    QCoreApplication::processEvents();
 }
 
 void SocketCANd::checkConnection()
@@ -247,92 +268,6 @@ void SocketCANd::switchToRawMode(int busNum)
     sendDebug("Switching to rawmode...");
     const char* rawmodeCmd = "< rawmode >";
     sendStringToTCP(rawmodeCmd, busNum);
-    QCoreApplication::processEvents();
-}
-
-QString SocketCANd::decodeFrames(QString data, int busNum)
-{
-    if (data.indexOf("<") == -1)
-        return "";
-    else if(data.length() >= 8 && data.indexOf("< frame ") == -1)
-        return "";
-
-    int firstIndex = data.indexOf("< frame ");
-    if(firstIndex > 0)
-    {
-        QString framePartial = data.left(firstIndex);
-        qDebug() << "Received datagramm that starts with fragment (missing '< frame'), this should only occur on startup, removing...: " << framePartial;
-    }
-    QString framePart = data.mid(firstIndex); //remove starting beginning of payload if not < frame >
-    const QString frameStrConst = framePart.left(framePart.indexOf(">")+1);
-    QString frameStr = frameStrConst;
-    QStringList frameParsed = (frameStr.remove(QRegularExpression("^<")).remove(QRegularExpression(">$"))).simplified().split(' ');
-
-    if(frameParsed.length() < 3)
-    {
-        //qDebug() << "Received datagramm is an incomplete frame: " << data;
-
-        //ok great, need to leave it in the buffer in case it can be combined with what comes next
-        //but if there was a fragment that did not have a starting token then we don't want it so only return
-        //known good data...again this should only happen on startup, but just in case we need to remove it
-        //so the data buffer doesn't grow uncontrolled.
-        return framePart;
-    }
-
-    buildFrame.setFrameId(frameParsed[1].toUInt(nullptr, 16));
-    buildFrame.bus = busNum;
-
-    if (buildFrame.frameId() > 0x7FF) buildFrame.setExtendedFrameFormat(true);
-    else buildFrame.setExtendedFrameFormat(false);
-
-    buildFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, frameParsed[2].toDouble() * 1000000l));
-    //buildFrame.len =  frameParsed[3].length() * 0.5;
-
-    int framelength = 0;
-
-    if(frameParsed.length() == 4)
-    {
-        framelength = frameParsed[3].length() * 0.5;
-    }
-
-    QByteArray buildData;
-    buildData.resize(framelength);
-
-    int c;
-    for (c = 0; c < framelength; c++)
-    {
-        bool ok;
-        unsigned char byteVal = frameParsed[3].mid(c*2, 2).toUInt(&ok, 16);
-        buildData[c] = byteVal;
-    }
-    buildFrame.setPayload(buildData);
-//        buildFrame.isReceived = true;
-
-    if (!isCapSuspended())
-    {
-        /* get frame from queue */
-        CANFrame* frame_p = getQueue().get();
-        if(frame_p) {
-            /* copy frame */
-            *frame_p = buildFrame;
-            //frame_p->remote = false;
-            frame_p->setFrameType(QCanBusFrame::DataFrame);
-            checkTargettedFrame(buildFrame);
-            /* enqueue frame */
-            getQueue().queue();
-        }
-    }
-    //else
-    //    qDebug() << "can't get a frame, capture suspended";
-
-    //take out the data that we just processed and anything that is in front of it
-    //this should keep broken frames from accumulating at in the data buffer
-    if (framePart.length() > frameStrConst.length())
-    {
-        return decodeFrames(framePart.right(framePart.length() - frameStrConst.length()), busNum);
-    }
-
-    return "";
 }
 
 void SocketCANd::disconnectDevice() {
@@ -358,84 +293,244 @@ void SocketCANd::disconnectDevice() {
     emit status(stats);
 }
 
-void SocketCANd::invokeReadTCPData()
+void SocketCANd::readTCPData(int busNum)
 {
-    QTcpSocket* signalSender = qobject_cast<QTcpSocket*>(QObject::sender());
-    int busNum = tcpClient.indexOf(signalSender);
-    QMetaObject::invokeMethod(this, "readTCPData", Qt::QueuedConnection, Q_ARG(int, busNum));
+    QTcpSocket* socket = tcpClient.value(busNum);
+    if (!socket) return;
+
+    //read onto the end of whatever partial message was left last time. Once the buffer has grown to its working
+    //size this doesn't allocate
+    QByteArray &buf = rxBuffer[busNum];
+    qint64 avail = socket->bytesAvailable();
+    if (avail <= 0) return;
+    int old = buf.size();
+    buf.resize(old + static_cast<int>(avail));
+    qint64 got = socket->read(buf.data() + old, avail);
+    buf.resize(old + static_cast<int>(qMax<qint64>(got, 0)));
+    if (got <= 0) return;
+
+    //sendDebug("Got data from TCP. Len = " % QString::number(got));
+    mTimer.stop();
+    mTimer.start();
+    procRXData(busNum);
 }
 
-void SocketCANd::readTCPData(int busNum)
+static inline const char *skipSpaces(const char *p, const char *end)
 {
-    QString data;
+    while (p < end && *p == ' ') p++;
+    return p;
+}
 
-    if (QTcpSocket* socket = tcpClient.value(busNum))
-        data = QString(socket->readAll());
-    //sendDebug("Got data from TCP. Len = " % QString::number(data.length()));
-    //qDebug() << "Received datagramm: " << data;
-    procRXData(data, busNum);
+static inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
 }
 
-void SocketCANd::procRXData(QString data, int busNum)
+//the first word of a message, e.g. "ok" for "< ok >"
+static inline bool isWord(const char *p, const char *end, const char *word)
 {
-    if (data != "")
-    {
-        mTimer.stop();
-        mTimer.start();
-    }
-    switch (rx_state.at(busNum))
+    p = skipSpaces(p, end);
+    int len = static_cast<int>(strlen(word));
+    if (end - p < len || memcmp(p, word, static_cast<size_t>(len)) != 0) return false;
+    return (p + len == end) || (p[len] == ' ');
+}
+
+//Takes whole "< ... >" messages off the front of the bus's buffer. The handshake is checked a message at a time,
+//after that every message should be a frame and gets parsed straight from the bytes into queue slots reserved
+//SOCKETCAND_RX_BATCH at a time. One wakeup for everything that came in.
+void SocketCANd::procRXData(int busNum)
+{
+    QByteArray &buf = rxBuffer[busNum];
+    const char *data = buf.constData();
+    const char *end = data + buf.size();
+    const char *p = data;
+
+    CANFrame *slots = nullptr;
+    int granted = 0;
+    int filled = 0;
+    bool queued = false;
+
+    while (p < end)
     {
-    case IDLE:
-        qDebug() << "Received datagramm: " << data;
-        if (data == "< hi >")
+        const char *open = static_cast<const char *>(memchr(p, '<', static_cast<size_t>(end - p)));
+        if (!open)
         {
-            deviceConnected(busNum);
-            rx_state[busNum] = BCM;
+            //nothing in what's left is the start of a message so it's junk
+            p = end;
+            break;
         }
-        else qInfo() << hostCanIDs[busNum] << ": Could not open bus. Host did not greet with ""< hi >"": " << data;
-        break;
-    case BCM:
-        qDebug() << "Received datagramm: " << data;
-        if (data == "< ok >")
+        const char *close = static_cast<const char *>(memchr(open, '>', static_cast<size_t>(end - open)));
+        if (!close)
         {
-            switchToRawMode(busNum);
-            rx_state[busNum] = SWITCHING2RAW;
-            unprocessedData[busNum].clear();
+            //the rest of this one hasn't arrived yet
+            p = open;
+            break;
         }
-        else qInfo() << hostCanIDs[busNum] << ": Could not open bus. Host did not respond with ""< ok >"": " << data;
-        break;
-    case SWITCHING2RAW:
-        qDebug() << "Received datagramm: " << data;
-        if (data == "< ok >")
+        p = close + 1;
+
+        switch (rx_state.at(busNum))
         {
-            rx_state[busNum] = RAWMODE;
+        case IDLE:
+            qDebug() << "Received datagramm: " << QByteArray(open, static_cast<int>(close - open) + 1);
+            if (isWord(open + 1, close, "hi"))
+            {
+                deviceConnected(busNum);
+                rx_state[busNum] = BCM;
+            }
+            else qInfo() << hostCanIDs[busNum] << ": Could not open bus. Host did not greet with ""< hi >"": " << QByteArray(open, static_cast<int>(close - open) + 1);
+            continue;
+        case BCM:
+            qDebug() << "Received datagramm: " << QByteArray(open, static_cast<int>(close - open) + 1);
+            if (isWord(open + 1, close, "ok"))
+            {
+                switchToRawMode(busNum);
+                rx_state[busNum] = SWITCHING2RAW;
+            }
+            else qInfo() << hostCanIDs[busNum] << ": Could not open bus. Host did not respond with ""< ok >"": " << QByteArray(open, static_cast<int>(close - open) + 1);
+            continue;
+        case SWITCHING2RAW:
+            //frames can follow in the same segment, they're picked up on the next time round
+            qDebug() << "Received datagramm: " << QByteArray(open, static_cast<int>(close - open) + 1);
+            if (isWord(open + 1, close, "ok")) rx_state[busNum] = RAWMODE;
+            continue;
+        case RAWMODE:
+            break;
+        case ISOTP:
+            continue;
         }
-        else if(data.indexOf("< ok >", 0, Qt::CaseSensitivity::CaseInsensitive) == 0)
+
+        if (isCapSuspended()) continue;
+
+        if (filled == granted)
+        {
+            if (filled > 0)
+            {
+                getQueue().commit(filled);
+                queued = true;
+            }
+            filled = 0;
+            slots = getQueue().reserve(SOCKETCAND_RX_BATCH, granted);
+            if (!slots)
+            {
+                //queue is full, this one is dropped
+                getQueue().drop();
+                continue;
+            }
+        }
+
+        if (parseFrame(open + 1, close, busNum, slots[filled]))
+        {
+            checkTargettedFrame(slots[filled]);
+            filled++;
+        }
+    }
+
+    if (filled > 0)
+    {
+        getQueue().commit(filled);
+        queued = true;
+    }
+    if (queued) notifyFramesQueued();
+
+    buf.remove(0, static_cast<int>(p - data));
+    if (buf.size() > SOCKETCAND_RX_MAX)
+    {
+        qDebug() << "busNum: " << busNum << "- " << buf.size() << " bytes without a complete message, something is wrong, clearing...";
+        buf.clear();
+    }
+}
+
+//"frame <id> <seconds>.<fraction> <data>" with the ID and data in hex. Anything else (echoes of our own commands,
+//errors, frames that don't parse) is skipped
+bool SocketCANd::parseFrame(const char *p, const char *end, int busNum, CANFrame &frame)
+{
+    p = skipSpaces(p, end);
+    if (end - p < 6 || memcmp(p, "frame ", 6) != 0) return false;
+    p = skipSpaces(p + 6, end);
+
+    //socketcand prints extended IDs with all 8 digits so a long ID is extended even when its value is small
+    quint32 id = 0;
+    int idDigits = 0;
+    int v;
+    while (p < end && (v = hexValue(*p)) >= 0)
+    {
+        id = (id << 4) | static_cast<quint32>(v);
+        idDigits++;
+        p++;
+    }
+    if (idDigits == 0 || idDigits > 8 || p >= end || *p != ' ') return false;
+    p = skipSpaces(p, end);
+
+    quint64 secs = 0;
+    quint64 micros = 0;
+    int secDigits = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        secs = secs * 10 + static_cast<quint64>(*p - '0');
+        secDigits++;
+        p++;
+    }
+    if (secDigits == 0) return false;
+    if (p < end && *p == '.')
+    {
+        p++;
+        int fracDigits = 0;
+        while (p < end && *p >= '0' && *p <= '9')
         {
-            qDebug() << "Ok found at start of compound message, switching to RAW and decoding immediately";
-            rx_state[busNum] = RAWMODE;
-            unprocessedData[busNum] = decodeFrames(data, busNum);
+            if (fracDigits < 6)
+            {
+                micros = micros * 10 + static_cast<quint64>(*p - '0');
+                fracDigits++;
+            }
+            p++;
         }
-        else if(data.indexOf("< ok >", 0, Qt::CaseSensitivity::CaseInsensitive) > 0)
+        while (fracDigits < 6)
         {
-            qDebug() << "Ok found at in middle of compound message, switching to RAW and decoding immediately";
-            rx_state[busNum] = RAWMODE;
-            unprocessedData[busNum] = decodeFrames(data, busNum);
+            micros *= 10;
+            fracDigits++;
         }
-        break;
-    case RAWMODE:
-        unprocessedData[busNum] = decodeFrames(unprocessedData[busNum] + data, busNum);
+    }
+    p = skipSpaces(p, end);
 
-        if(unprocessedData[busNum].length() > 128)
+    //normally one run of hex digits but spaces between the bytes are fine too
+    uint8_t bytes[64];
+    int len = 0;
+    int high = -1;
+    while (p < end)
+    {
+        if (*p == ' ')
         {
-            //the buffer has grown too much we need to clear it out, but what is good logic for that?
-            //the decodeFrames function strips out datat that doesn't have a '< frame' starting token, and in its
-            //recursive calling of itself it strips out data that preceedes valid frames, so this should never happen
-            qDebug() << "busNum: " << busNum << "- " << unprocessedData[busNum].length() << " bytes in unprocessedData, something is wrong, clearing...";
-            unprocessedData[busNum].clear();
+            if (high >= 0) return false;
+            p++;
+            continue;
         }
-        break;
-    case ISOTP:
-        break;
+        v = hexValue(*p);
+        if (v < 0) return false;
+        if (high < 0) high = v;
+        else
+        {
+            if (len >= 64) return false;
+            bytes[len++] = static_cast<uint8_t>((high << 4) | v);
+            high = -1;
+        }
+        p++;
     }
+    if (high >= 0) return false;
+
+    frame.setFrameType(QCanBusFrame::DataFrame);
+    frame.setFrameId(id);
+    frame.setExtendedFrameFormat(idDigits > 3 || id > 0x7FF);
+    frame.setFlexibleDataRateFormat(len > 8);
+    frame.bus = busNum;
+    frame.isReceived = true;
+    frame.timedelta = 0;
+    frame.frameCount = 1;
+    frame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(secs * 1000000ull + micros)));
+
+    fillPayload(frame, bytes, len);
+
+    return true;
 }
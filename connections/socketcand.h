@@ -30,6 +30,11 @@ enum MODE
 
 }
 
+/* frames reserved in the queue at a time while parsing */
+#define SOCKETCAND_RX_BATCH 64
+/* a partial message longer than this can't be a frame, so it gets thrown away instead of waiting for its '>' */
+#define SOCKETCAND_RX_MAX   512
+
 using namespace KAYAKSTATE;
 class SocketCANd : public CANConnection
 {
@@ -47,6 +52,8 @@ protected:
     virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
     virtual void piSuspend(bool pSuspend);
     virtual bool piSendFrame(const CANFrame&);
+    virtual void piWriteTx(int pBusIdx, const QByteArray& pBytes);
+    virtual qint64 piTxBacklog();
 
     void disconnectDevice();
 
@@ -54,13 +61,12 @@ private slots:
     void connectDevice();
     void checkConnection();
     void readTCPData(int busNum);
-    void invokeReadTCPData();
     void deviceConnected(int busNum);
     void switchToRawMode(int busNum);
-    QString decodeFrames(QString, int busNum);
 
 private:
-    void procRXData(QString, int busNum);
+    void procRXData(int busNum);
+    bool parseFrame(const char *p, const char *end, int busNum, CANFrame &frame);
     void sendBytesToTCP(const QByteArray &bytes, int busNum);
     void sendStringToTCP(const char* data, int busNum);
     void sendDebug(const QString debugText);
@@ -74,8 +80,7 @@ protected:
     QList<QString> hostCanIDs;
     int framesRapid;
     QVarLengthArray<MODE> rx_state;
-    CANFrame buildFrame;
-    QVarLengthArray<QString> unprocessedData;
+    QVarLengthArray<QByteArray> rxBuffer; //bytes read but not parsed yet, the start of a message split across reads
 };
 
 
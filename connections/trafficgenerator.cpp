@@ -0,0 +1,574 @@
+#include "trafficgenerator.h"
+#include "canconmanager.h"
+#include "dbc/dbchandler.h"
+#include "threadpolicy.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <cmath>
+#include <queue>
+
+//xorshift64*. Small, quick and the same on every platform, which std's distributions don't promise
+class GeneratorRandom
+{
+public:
+    explicit GeneratorRandom(quint64 seed) : state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+
+    quint32 next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<quint32>((state * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+    int range(int n) { return static_cast<int>(next() % static_cast<quint32>(n)); } //0 to n - 1
+    double unit() { return next() / 4294967296.0; } //0 up to 1
+
+private:
+    quint64 state;
+};
+
+//reuses the payload buffer the queue slot already has, it only allocates if the buffer is still shared with an old copy
+static void fillPayload(CANFrame &frame, const uint8_t *data, int len)
+{
+    QByteArray payload = frame.payload();
+    frame.setPayload(QByteArray());
+    payload.resize(len);
+    if (len > 0) memcpy(payload.data(), data, static_cast<size_t>(len));
+    frame.setPayload(payload);
+}
+
+static void fillHeader(CANFrame &frame, uint32_t id, bool extended, int bus, bool fd)
+{
+    frame.setFrameType(QCanBusFrame::DataFrame);
+    frame.setExtendedFrameFormat(extended);
+    frame.setFrameId(id);
+    frame.setFlexibleDataRateFormat(fd);
+    frame.setBitrateSwitch(fd);
+    frame.setErrorStateIndicator(false);
+    frame.setLocalEcho(false);
+    frame.isReceived = true;
+    frame.bus = bus;
+    frame.timedelta = 0;
+    frame.frameCount = 1;
+}
+
+//the smallest payload length CAN FD can send that holds len bytes
+static int fdLength(int len)
+{
+    static const int sizes[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    for (int size : sizes) if (size >= len) return size;
+    return 64;
+}
+
+/*
+ * One source of traffic. Each has its own share of the rate and the time its next frame is due, in microseconds
+ * from the start. The generator always takes the frame from whichever stream is due first.
+ */
+class GeneratorStream
+{
+public:
+    virtual ~GeneratorStream() {}
+    virtual void make(CANFrame &frame) = 0; //fill in the next frame and move nextUs on
+
+    double nextUs = 0.0;
+};
+
+/*
+ * Picks which of a set of messages goes next so each comes up in proportion to one over its cycle time. Every
+ * message has a due time in its own cycles, the earliest goes and is pushed one cycle on. Ties go to the lower index
+ * so the order is fixed.
+ */
+class CycleSchedule
+{
+public:
+    void add(double cycle)
+    {
+        cycles.append(cycle);
+        due.push(qMakePair(0.0, cycles.count() - 1));
+    }
+    int next()
+    {
+        QPair<double, int> top = due.top();
+        due.pop();
+        due.push(qMakePair(top.first + cycles[top.second], top.second));
+        return top.second;
+    }
+    bool isEmpty() const { return cycles.isEmpty(); }
+
+private:
+    QVector<double> cycles;
+    std::priority_queue<QPair<double, int>, std::vector<QPair<double, int>>, std::greater<QPair<double, int>>> due;
+};
+
+//the usual ECU traffic: fixed IDs at 10 to 1000ms, a rolling counter in byte 6 and a checksum in byte 7
+class PeriodicStream : public GeneratorStream
+{
+public:
+    PeriodicStream(const TrafficGenerator::Config &config, double rate, GeneratorRandom &random) : interval(1000000.0 / rate)
+    {
+        static const int periods[] = {10, 10, 20, 20, 50, 100, 100, 200, 500, 1000};
+        QSet<quint32> used;
+        for (int k = 0; k < qMax(1, config.ids); k++)
+        {
+            Slot slot;
+            slot.extended = random.range(4) == 0;
+            do slot.id = slot.extended ? (0x18000000u | (random.next() & 0xFFFFFF)) : (0x100u + random.range(0x600));
+            while (used.contains(slot.id));
+            used.insert(slot.id);
+            slot.bus = k % config.buses;
+            slot.len = (random.range(5) == 0) ? 2 + random.range(6) : 8;
+            for (int b = 0; b < 8; b++) slot.base[b] = static_cast<uint8_t>(random.next());
+            slot.counter = 0;
+            slots_.append(slot);
+            schedule.add(periods[random.range(sizeof(periods) / sizeof(periods[0]))]);
+        }
+    }
+
+    void make(CANFrame &frame) override
+    {
+        Slot &slot = slots_[schedule.next()];
+        uint8_t data[8];
+        //the data bytes drift slowly so the values look alive, not random
+        for (int b = 0; b < 8; b++) data[b] = static_cast<uint8_t>(slot.base[b] + (slot.counter >> (b & 3)));
+        data[slot.len - 2] = static_cast<uint8_t>((data[slot.len - 2] & 0xF0) | (slot.counter & 0x0F));
+        uint8_t sum = static_cast<uint8_t>(slot.id) + static_cast<uint8_t>(slot.id >> 8);
+        for (int b = 0; b < slot.len - 1; b++) sum += data[b];
+        data[slot.len - 1] = static_cast<uint8_t>(sum ^ 0xFF);
+        slot.counter++;
+
+        fillHeader(frame, slot.id, slot.extended, slot.bus, false);
+        fillPayload(frame, data, slot.len);
+        nextUs += interval;
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t id;
+        bool extended;
+        int bus;
+        int len;
+        uint8_t base[8];
+        uint32_t counter;
+    };
+
+    QVector<Slot> slots_;
+    CycleSchedule schedule;
+    double interval;
+};
+
+//diagnostics and flashing look like this: runs of random frames 8 times faster than the average, then nothing
+class BurstStream : public GeneratorStream
+{
+public:
+    BurstStream(const TrafficGenerator::Config &config, double rate, quint64 seed)
+        : random(seed), interval(1000000.0 / rate), buses(config.buses), fd(config.fd), left(0) {}
+
+    void make(CANFrame &frame) override
+    {
+        if (left == 0)
+        {
+            left = 8 + random.range(249);
+            burstStartUs = nextUs;
+            burstSize = left;
+        }
+
+        bool extended = random.range(2) == 0;
+        uint32_t id = extended ? (random.next() & 0x1FFFFFFF) : (random.next() & 0x7FF);
+        bool fdFrame = fd && random.range(4) == 0;
+        int len = fdFrame ? fdLength(random.range(65)) : random.range(9);
+        uint8_t data[64];
+        for (int b = 0; b < len; b++) data[b] = static_cast<uint8_t>(random.next());
+
+        fillHeader(frame, id, extended, random.range(buses), fdFrame);
+        fillPayload(frame, data, len);
+
+        //inside a burst frames come 8 times as fast. The gap after it brings the average back to the rate
+        left--;
+        if (left > 0) nextUs += interval / 8.0;
+        else nextUs = burstStartUs + burstSize * interval;
+    }
+
+private:
+    GeneratorRandom random; //its own so the periodic side of mixed traffic doesn't shift it
+    double interval;
+    int buses;
+    bool fd;
+    int left;
+    int burstSize = 0;
+    double burstStartUs = 0.0;
+};
+
+/*
+ * The messages of the loaded DBC files with their signals following waveforms over time. Signals called something
+ * with counter in the name count up instead and ones with checksum or crc in the name get the sum of the other
+ * bytes. Multiplexed signals are left at zero since which of them should be there is up to the multiplexor.
+ */
+class DbcStream : public GeneratorStream
+{
+public:
+    DbcStream(const TrafficGenerator::Config &config, double rate, GeneratorRandom &random) : interval(1000000.0 / rate)
+    {
+        DBCHandler *dbc = DBCHandler::getReference();
+        for (int f = 0; f < dbc->getFileCount(); f++)
+        {
+            DBCFile *file = dbc->getFileByIdx(f);
+            DBCMessageHandler *messages = file->messageHandler;
+            for (int m = 0; m < messages->getCount(); m++)
+            {
+                DBC_MESSAGE *msg = messages->findMsgByIdx(m);
+                if (!msg) continue;
+                Message out;
+                out.id = msg->ID & 0x1FFFFFFF;
+                out.extended = msg->extendedID || out.id > 0x7FF;
+                out.len = qBound(0, static_cast<int>(msg->len), 64);
+                out.bus = (file->getAssocBus() >= 0 && file->getAssocBus() < config.buses) ? file->getAssocBus() : m % config.buses;
+                double cycle = 100.0;
+                DBC_ATTRIBUTE_VALUE *attr = msg->findAttrValByName("GenMsgCycleTime");
+                if (attr && attr->value.toDouble() > 0.0) cycle = attr->value.toDouble();
+
+                for (int s = 0; s < msg->sigHandler->getCount(); s++)
+                {
+                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(s);
+                    if (!sig || sig->isMultiplexed || sig->valType == STRING) continue;
+                    Signal wave;
+                    wave.sig = *sig;
+                    wave.sig.prepare();
+                    QString name = sig->name.toLower();
+                    wave.kind = name.contains("counter") ? COUNTER
+                              : (name.contains("checksum") || name.contains("crc")) ? CHECKSUM
+                              : static_cast<Kind>(random.range(4));
+                    if (sig->max > sig->min)
+                    {
+                        wave.low = sig->min;
+                        wave.high = sig->max;
+                    }
+                    else
+                    {
+                        //no range in the DBC, use what the raw bits can hold
+                        double rawMax = std::ldexp(1.0, qMin(sig->signalSize, 52)) - 1.0;
+                        wave.low = sig->bias;
+                        wave.high = sig->bias + rawMax * sig->factor;
+                    }
+                    wave.periodUs = (1.0 + random.unit() * 9.0) * 1000000.0;
+                    wave.phase = random.unit();
+                    out.waves.append(wave);
+                }
+                messageList.append(out);
+                schedule.add(cycle);
+            }
+        }
+        if (messageList.isEmpty()) qDebug() << "Traffic generator: no DBC messages loaded, the dbc pattern won't send anything";
+    }
+
+    bool isEmpty() const { return messageList.isEmpty(); }
+
+    void make(CANFrame &frame) override
+    {
+        Message &msg = messageList[schedule.next()];
+        uint8_t data[64];
+        memset(data, 0, sizeof(data));
+        const Signal *checksum = nullptr;
+        for (Signal &wave : msg.waves)
+        {
+            double value;
+            if (wave.kind == COUNTER) value = wave.low + (msg.counter % static_cast<quint64>(qMax(1.0, wave.high - wave.low + 1.0)));
+            else if (wave.kind == CHECKSUM)
+            {
+                checksum = &wave;
+                continue;
+            }
+            else
+            {
+                double t = std::fmod(nextUs / wave.periodUs + wave.phase, 1.0);
+                double w;
+                switch (wave.kind)
+                {
+                case SINE: w = 0.5 + 0.5 * std::sin(t * 2.0 * M_PI); break;
+                case TRIANGLE: w = (t < 0.5) ? t * 2.0 : 2.0 - t * 2.0; break;
+                case SQUARE: w = (t < 0.5) ? 0.0 : 1.0; break;
+                default: w = t; break; //ramp
+                }
+                value = wave.low + w * (wave.high - wave.low);
+            }
+            wave.sig.encodeValue(value, data, msg.len);
+        }
+        if (checksum)
+        {
+            uint32_t sum = 0;
+            for (int b = 0; b < msg.len; b++) sum += data[b];
+            checksum->sig.encodeValue(checksum->low + (sum % static_cast<uint32_t>(qMax(1.0, checksum->high - checksum->low + 1.0))), data, msg.len);
+        }
+        msg.counter++;
+
+        fillHeader(frame, msg.id, msg.extended, msg.bus, msg.len > 8);
+        fillPayload(frame, data, msg.len);
+        nextUs += interval;
+    }
+
+private:
+    enum Kind
+    {
+        SINE,
+        TRIANGLE,
+        SQUARE,
+        RAMP,
+        COUNTER,
+        CHECKSUM
+    };
+
+    struct Signal
+    {
+        DBC_SIGNAL sig; //a copy, the DBC can change while we run
+        Kind kind;
+        double low;
+        double high;
+        double periodUs;
+        double phase; //0 to 1, so signals don't all start together
+    };
+
+    struct Message
+    {
+        uint32_t id;
+        bool extended;
+        int len;
+        int bus;
+        quint64 counter = 0;
+        QVector<Signal> waves;
+    };
+
+    QVector<Message> messageList;
+    CycleSchedule schedule;
+    double interval;
+};
+
+TrafficGenerator::Config TrafficGenerator::Config::parse(const QString &portName)
+{
+    Config config;
+    const QStringList pairs = portName.split(QRegularExpression("[,;\\s]+"), Qt::SkipEmptyParts);
+    for (const QString &pair : pairs)
+    {
+        QString key = pair.section('=', 0, 0).trimmed().toLower();
+        QString value = pair.section('=', 1).trimmed().toLower();
+        bool ok = true;
+        if (key == "rate") config.rate = value.toInt(&ok);
+        else if (key == "buses") config.buses = value.toInt(&ok);
+        else if (key == "ids") config.ids = value.toInt(&ok);
+        else if (key == "fd") config.fd = (value == "1" || value == "true" || value == "yes");
+        else if (key == "seed") config.seed = value.toULongLong(&ok);
+        else if (key == "pattern")
+        {
+            if (value == "periodic") config.pattern = PERIODIC;
+            else if (value == "bursts" || value == "burst") config.pattern = BURSTS;
+            else if (value == "dbc") config.pattern = DBC;
+            else if (value == "mixed") config.pattern = MIXED;
+            else ok = false;
+        }
+        else ok = false;
+        if (!ok) qDebug() << "Traffic generator: ignoring" << pair;
+    }
+    config.rate = qBound(1, config.rate, 10000000);
+    config.buses = qBound(1, config.buses, 16);
+    config.ids = qBound(1, config.ids, 2048);
+    return config;
+}
+
+QStringList TrafficGenerator::examplePorts()
+{
+    return QStringList() << "rate=1000 buses=1 pattern=periodic seed=1"
+                         << "rate=50000 buses=2 pattern=mixed seed=1"
+                         << "rate=20000 buses=1 pattern=bursts fd=1 seed=1"
+                         << "rate=2000 buses=1 pattern=dbc seed=1";
+}
+
+TrafficGenerator::TrafficGenerator(QString portName) :
+    CANConnection(portName, "generator", CANCon::GENERATOR, 0, 0, false, 0,
+                  Config::parse(portName).buses, GENERATOR_QUEUE_LEN, false),
+    mConfig(Config::parse(portName)),
+    mStartUs(0),
+    mGenerator_p(nullptr),
+    mStopGenerator(0)
+{
+    /* the generator thread owns the producer side of the queue so sent frames can't be echoed into it */
+    setTxEcho(false);
+}
+
+
+TrafficGenerator::~TrafficGenerator()
+{
+    stop();
+}
+
+
+void TrafficGenerator::piStarted()
+{
+    //built here on the GUI thread, the DBC stream copies what it needs out of the loaded files
+    GeneratorRandom random(mConfig.seed);
+    switch (mConfig.pattern)
+    {
+    case Config::PERIODIC:
+        mStreams.append(new PeriodicStream(mConfig, mConfig.rate, random));
+        break;
+    case Config::BURSTS:
+        mStreams.append(new BurstStream(mConfig, mConfig.rate, random.next()));
+        break;
+    case Config::DBC:
+    {
+        DbcStream *stream = new DbcStream(mConfig, mConfig.rate, random);
+        if (!stream->isEmpty()) mStreams.append(stream);
+        else delete stream;
+        break;
+    }
+    case Config::MIXED:
+        mStreams.append(new PeriodicStream(mConfig, mConfig.rate * 0.7, random));
+        mStreams.append(new BurstStream(mConfig, mConfig.rate * 0.3, random.next()));
+        break;
+    }
+
+    for (int i = 0; i < mNumBuses; i++)
+    {
+        mBusData[i].mConfigured = true;
+        mBusData[i].mBus.setActive(true);
+    }
+
+    mStartUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    if (!useSystemTime) mStartUs -= static_cast<qint64>(CANConManager::getInstance()->getTimeBasis());
+
+    mStopGenerator.storeRelease(0);
+    mGenerator_p = QThread::create([this]{ generateLoop(); });
+    mGenerator_p->start(QThread::HighPriority);
+    updateStatus(CANCon::CONNECTED);
+}
+
+
+void TrafficGenerator::piStop()
+{
+    if (mGenerator_p)
+    {
+        mStopGenerator.storeRelease(1);
+        mGenerator_p->wait();
+        delete mGenerator_p;
+        mGenerator_p = nullptr;
+    }
+    qDeleteAll(mStreams);
+    mStreams.clear();
+    updateStatus(CANCon::NOT_CONNECTED);
+}
+
+
+void TrafficGenerator::piSetBusSettings(int pBusIdx, CANBus bus)
+{
+    if( (pBusIdx < 0) || pBusIdx >= getNumBuses())
+        return;
+    setBusConfig(pBusIdx, bus);
+}
+
+
+bool TrafficGenerator::piGetBusSettings(int pBusIdx, CANBus& pBus)
+{
+    return getBusConfig(pBusIdx, pBus);
+}
+
+
+void TrafficGenerator::piSuspend(bool pSuspend)
+{
+    setCapSuspended(pSuspend);
+    if(isCapSuspended())
+        getQueue().flush();
+}
+
+
+//there's no bus to send to. Taken as sent so senders and scripts can be load tested too
+bool TrafficGenerator::piSendFrame(const CANFrame& pFrame)
+{
+    return pFrame.bus >= 0 && pFrame.bus < getNumBuses();
+}
+
+
+/***********************************/
+/****   private methods         ****/
+/***********************************/
+
+
+GeneratorStream *TrafficGenerator::nextStream() const
+{
+    GeneratorStream *next = mStreams.first();
+    for (GeneratorStream *stream : mStreams)
+        if (stream->nextUs < next->nextUs) next = stream;
+    return next;
+}
+
+
+void TrafficGenerator::updateStatus(CANCon::status pStatus)
+{
+    if (getStatus() == pStatus) return;
+    setStatus(pStatus);
+
+    CANConStatus stats;
+    stats.conStatus = getStatus();
+    stats.numHardwareBuses = mNumBuses;
+    emit status(stats);
+}
+
+
+void TrafficGenerator::generateLoop()
+{
+    ThreadPolicy::apply(ThreadPolicy::CAPTURE);
+    QElapsedTimer clock;
+    clock.start();
+    CANFrame scratch;
+
+    while (!mStopGenerator.loadAcquire())
+    {
+        if (mStreams.isEmpty())
+        {
+            QThread::msleep(100);
+            continue;
+        }
+
+        double nowUs = clock.nsecsElapsed() / 1000.0;
+        int made = 0;
+        while (made < GENERATOR_BATCH && nextStream()->nextUs <= nowUs)
+        {
+            //suspended still makes the frames so the pattern carries on from where it would have been
+            if (isCapSuspended())
+            {
+                nextStream()->make(scratch);
+                made++;
+                continue;
+            }
+
+            int granted = 0;
+            CANFrame *slot_p = getQueue().reserve(GENERATOR_BATCH - made, granted);
+            if (!slot_p)
+            {
+                //the queue is full, this frame is lost the way it would be on a real bus
+                nextStream()->make(scratch);
+                getQueue().drop();
+                made++;
+                continue;
+            }
+
+            int filled = 0;
+            while (filled < granted)
+            {
+                GeneratorStream *stream = nextStream();
+                if (stream->nextUs > nowUs) break;
+                qint64 stampUs = mStartUs + static_cast<qint64>(stream->nextUs);
+                stream->make(slot_p[filled]);
+                slot_p[filled].setTimeStamp(QCanBusFrame::TimeStamp(0, stampUs));
+                checkTargettedFrame(slot_p[filled]);
+                filled++;
+            }
+            getQueue().commit(filled);
+            made += filled;
+            if (filled < granted) break;
+        }
+
+        if (made > 0) notifyFramesQueued();
+        else QThread::usleep(GENERATOR_IDLE_US);
+    }
+}
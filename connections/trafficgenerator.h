@@ -0,0 +1,92 @@
+#ifndef TRAFFICGENERATOR_H
+#define TRAFFICGENERATOR_H
+
+#include <QThread>
+#include <QVector>
+
+#include "canconnection.h"
+
+/*
+ * A connection with no device behind it, for load testing without hardware. A generator thread makes frames up at
+ * the set rate and puts them straight into the queue in runs with reserve()/commit(), the same as a real reader
+ * thread does, so everything from the queue on sees what it would with a busy bus. Frames that don't fit in the
+ * queue count as dropped like they would for any other connection.
+ *
+ * Everything is set through the port name as key=value pairs separated by spaces or commas, for example
+ * "rate=50000 buses=2 pattern=mixed seed=7":
+ *  rate     frames per second over all buses together (default 1000)
+ *  buses    how many buses the traffic is spread over (default 1)
+ *  pattern  periodic - a fixed set of IDs at different periods, each with a rolling counter and a checksum
+ *           bursts   - random IDs, lengths and payloads coming in bursts with gaps in between
+ *           dbc      - the messages of the loaded DBC files with every signal following a waveform
+ *           mixed    - periodic traffic with bursts on top
+ *  ids      how many IDs periodic traffic cycles through (default 64)
+ *  fd       1 lets random traffic use CAN FD frames of up to 64 bytes (default 0)
+ *  seed     the same seed always gives the same frames (default 1). Timestamps are the times the frames were due
+ *           at the set rate, counted from when the connection started, so they're the same every run as well
+ *
+ * The rate is what gets sent whatever the pattern. DBC cycle times (GenMsgCycleTime, 100ms if a message has none)
+ * only decide how often each message comes up compared to the rest. If the generator thread can't keep up it just
+ * runs flat out and the timestamps fall further behind the clock.
+ */
+
+#define GENERATOR_QUEUE_LEN     65536
+//frames made per reserve()/commit() round before the thread looks at the clock again
+#define GENERATOR_BATCH         1024
+//how long the thread sleeps when nothing is due yet
+#define GENERATOR_IDLE_US       200
+
+class GeneratorStream;
+
+class TrafficGenerator : public CANConnection
+{
+    Q_OBJECT
+
+public:
+    struct Config
+    {
+        enum Pattern
+        {
+            PERIODIC,
+            BURSTS,
+            DBC,
+            MIXED
+        };
+
+        int rate = 1000;
+        int buses = 1;
+        Pattern pattern = PERIODIC;
+        int ids = 64;
+        bool fd = false;
+        quint64 seed = 1;
+
+        static Config parse(const QString &portName);
+    };
+
+    TrafficGenerator(QString portName);
+    virtual ~TrafficGenerator();
+
+    //a few port names to start from, for the connection dialog
+    static QStringList examplePorts();
+
+protected:
+    virtual void piStarted();
+    virtual void piStop();
+    virtual void piSetBusSettings(int pBusIdx, CANBus pBus);
+    virtual bool piGetBusSettings(int pBusIdx, CANBus& pBus);
+    virtual void piSuspend(bool pSuspend);
+    virtual bool piSendFrame(const CANFrame&);
+
+private:
+    void generateLoop();
+    GeneratorStream *nextStream() const;
+    void updateStatus(CANCon::status pStatus);
+
+    Config mConfig;
+    QVector<GeneratorStream *> mStreams; //only touched by the generator thread while it runs
+    qint64 mStartUs;
+    QThread *mGenerator_p;
+    QAtomicInt mStopGenerator;
+};
+
+#endif // TRAFFICGENERATOR_H
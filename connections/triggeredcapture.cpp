@@ -0,0 +1,194 @@
+#include "triggeredcapture.h"
+#include "dbc/dbchandler.h"
+#include "framefileio.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cmath>
+
+void TriggeredCapture::arm(const TriggeredCaptureConfig &pConfig)
+{
+    disarm();
+    config = pConfig;
+    if (config.maxFramesPerBus < 1) config.maxFramesPerBus = 1;
+    compile();
+    windows = 0;
+    lastFile.clear();
+    lastError.clear();
+    state = TriggeredCaptureStatus::ARMED;
+}
+
+void TriggeredCapture::disarm()
+{
+    state = TriggeredCaptureStatus::IDLE;
+    rings.clear();
+    buffered = 0;
+    window.clear();
+}
+
+TriggeredCaptureStatus TriggeredCapture::getStatus() const
+{
+    TriggeredCaptureStatus status;
+    status.state = state;
+    status.buffered = buffered;
+    status.windows = windows;
+    status.triggerTimeUs = triggerTimeUs;
+    status.triggerId = triggerId;
+    status.triggerBus = triggerBus;
+    status.lastFile = lastFile;
+    status.lastError = lastError;
+    return status;
+}
+
+//signals are looked up once here and again whenever the DBC changes, not for every frame
+void TriggeredCapture::compile()
+{
+    DBCHandler *dbcHandler = DBCHandler::getReference();
+    dbcRevision = DBCHandler::getRevision();
+    dbcMessages = dbcHandler->sharedMessageSets();
+    conditions.clear();
+    for (const Trigger &trig : qAsConst(config.triggers))
+    {
+        //something to look for has to be there or it'd fire on the very first frame
+        if (!(trig.triggerMask & (TriggerMask::TRG_ID | TriggerMask::TRG_SIGNAL))) continue;
+
+        Condition cond;
+        cond.matchId = (trig.triggerMask & (TriggerMask::TRG_ID | TriggerMask::TRG_SIGNAL)) != 0;
+        cond.id = static_cast<uint32_t>(trig.ID);
+        cond.bus = (trig.triggerMask & TriggerMask::TRG_BUS) ? trig.bus : -1;
+        cond.sig = nullptr;
+        cond.matchValue = (trig.triggerMask & TriggerMask::TRG_SIGVAL) != 0;
+        cond.value = trig.sigValueDbl;
+        if (trig.triggerMask & TriggerMask::TRG_SIGNAL)
+        {
+            DBC_MESSAGE *msg = dbcHandler->findMessage(cond.id);
+            cond.sig = msg ? msg->sigHandler->findSignalByName(trig.sigName) : nullptr;
+            if (!cond.sig) continue; //can never pass
+        }
+        conditions.append(cond);
+    }
+    //the window checked it before arming. If a signal it used has gone since then it just never fires
+    expression = FilterExpression::compile(config.expression);
+}
+
+bool TriggeredCapture::fires(const CANFrame &frame) const
+{
+    if (expression && expression->matches(frame)) return true;
+    for (const Condition &cond : conditions)
+    {
+        if (cond.matchId && cond.id != frame.frameId()) continue;
+        if (cond.bus >= 0 && cond.bus != frame.bus) continue;
+        if (cond.sig)
+        {
+            if (!cond.sig->isSignalInMessage(frame)) continue;
+            if (cond.matchValue)
+            {
+                double sigval = 0.0;
+                int32_t muxValue;
+                const QByteArray payload = frame.payload();
+                if (!cond.sig->decodeValue(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length(), sigval, muxValue))
+                    continue;
+                if (fabs(sigval - cond.value) > 0.001) continue;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+//into its bus's ring. Whatever is too old or doesn't fit any more falls off the other end
+void TriggeredCapture::push(const CANFrame &frame)
+{
+    std::deque<CANFrame> &ring = rings[frame.bus];
+    qint64 now = frame.timeStamp().microSeconds();
+    ring.push_back(frame);
+    buffered++;
+    while (!ring.empty() && (static_cast<int>(ring.size()) > config.maxFramesPerBus
+                             || now - ring.front().timeStamp().microSeconds() > static_cast<qint64>(config.preTriggerUs)))
+    {
+        ring.pop_front();
+        buffered--;
+    }
+}
+
+void TriggeredCapture::trigger(const CANFrame &frame, QVector<CANFrame> &out)
+{
+    triggerTimeUs = frame.timeStamp().microSeconds();
+    triggerId = frame.frameId();
+    triggerBus = frame.bus;
+    state = TriggeredCaptureStatus::TRIGGERED;
+
+    //each ring is in order already, the buses just have to be put together
+    QVector<CANFrame> before;
+    before.reserve(buffered);
+    for (auto it = rings.begin(); it != rings.end(); ++it)
+    {
+        for (const CANFrame &old : it.value())
+        {
+            if (triggerTimeUs - old.timeStamp().microSeconds() <= static_cast<qint64>(config.preTriggerUs)) before.append(old);
+        }
+    }
+    rings.clear();
+    buffered = 0;
+    std::stable_sort(before.begin(), before.end(), [](const CANFrame &a, const CANFrame &b)
+        { return a.timeStamp().microSeconds() < b.timeStamp().microSeconds(); });
+    before.append(frame);
+
+    if (config.toModel) out += before;
+    window.clear();
+    if (!config.fileName.isEmpty()) window.swap(before);
+}
+
+void TriggeredCapture::finish()
+{
+    windows++;
+    if (!config.fileName.isEmpty())
+    {
+        QFileInfo info(config.fileName);
+        QString stamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss");
+        if (config.rearm) stamp += "-" + QString::number(windows);
+        lastFile = info.path() + "/" + info.completeBaseName() + "_" + stamp + ".csv";
+        if (!FrameFileIO::saveNativeCSVFile(lastFile, &window)) lastError = "Couldn't write " + lastFile;
+        window.clear();
+    }
+    state = config.rearm ? TriggeredCaptureStatus::ARMED : TriggeredCaptureStatus::DONE;
+}
+
+void TriggeredCapture::take(const CANFrame &frame, QVector<CANFrame> &out)
+{
+    switch (state)
+    {
+    case TriggeredCaptureStatus::ARMED:
+        if (fires(frame)) trigger(frame, out);
+        else push(frame);
+        break;
+    case TriggeredCaptureStatus::TRIGGERED:
+        if (frame.timeStamp().microSeconds() - triggerTimeUs <= static_cast<qint64>(config.postTriggerUs))
+        {
+            if (config.toModel) out.append(frame);
+            if (!config.fileName.isEmpty()) window.append(frame);
+            break;
+        }
+        //the first frame past the window closes it, then counts for the next one if there is going to be one
+        finish();
+        if (state == TriggeredCaptureStatus::ARMED) take(frame, out);
+        break;
+    case TriggeredCaptureStatus::IDLE:
+        out.append(frame);
+        break;
+    case TriggeredCaptureStatus::DONE:
+        break;
+    }
+}
+
+void TriggeredCapture::process(QVector<CANFrame> &batch)
+{
+    if (state == TriggeredCaptureStatus::IDLE) return;
+    if (dbcRevision != DBCHandler::getRevision()) compile();
+
+    QVector<CANFrame> out;
+    for (const CANFrame &frame : qAsConst(batch)) take(frame, out);
+    batch.swap(out);
+}
@@ -0,0 +1,105 @@
+#ifndef TRIGGEREDCAPTURE_H
+#define TRIGGEREDCAPTURE_H
+
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <deque>
+#include "can_structs.h"
+#include "can_trigger_structs.h"
+#include "filterexpression.h"
+
+class DBC_SIGNAL;
+class DBCMessageHandler;
+
+//what a triggered capture keeps and where it goes
+struct TriggeredCaptureConfig
+{
+    QList<Trigger> triggers; //any one of them firing starts the window. ID, bus, signal and signal value are looked at
+    QString expression; //a frame matching this filter expression fires as well. Empty for none
+    quint64 preTriggerUs = 10000000;
+    quint64 postTriggerUs = 5000000;
+    int maxFramesPerBus = 250000; //size of each bus's pre-trigger ring, keeps memory bounded however long it waits
+    bool toModel = true; //the window goes on to everything listening for received frames
+    QString fileName; //and to a native CSV file if set, with the trigger time added to the name
+    bool rearm = false; //wait for the next trigger once a window is done instead of stopping
+};
+
+struct TriggeredCaptureStatus
+{
+    enum State
+    {
+        IDLE, //not capturing this way, frames go straight through
+        ARMED, //filling the rings, waiting for a trigger
+        TRIGGERED, //passing frames on until the post-trigger time is up
+        DONE //window captured, nothing goes through until it's disarmed
+    };
+
+    State state = IDLE;
+    int buffered = 0; //frames in all the rings
+    quint64 windows = 0; //finished since it was armed
+    qint64 triggerTimeUs = 0; //of the last trigger frame
+    uint32_t triggerId = 0;
+    int triggerBus = 0;
+    QString lastFile;
+    QString lastError;
+};
+
+/*
+ * Logic analyzer style capture: while armed every bus has a ring of its most recent frames, no older than the
+ * pre-trigger time and no more than maxFramesPerBus of them, and nothing is passed on. The first frame that passes
+ * one of the triggers takes the rings (in time order across buses) plus itself and everything up to the
+ * post-trigger time after it as the window. Times are the frames' own timestamps so the window is the same
+ * whatever the batching did to them.
+ *
+ * Sits in CANConManager's path from the connections to the rest of the program and is only used from that thread.
+ */
+class TriggeredCapture
+{
+public:
+    void arm(const TriggeredCaptureConfig &config);
+    void disarm(); //throws out whatever was buffered
+    bool isActive() const { return state != TriggeredCaptureStatus::IDLE; }
+    TriggeredCaptureStatus::State getState() const { return state; }
+    TriggeredCaptureStatus getStatus() const;
+    //a batch from the connections. Leaves in it only what should be passed on
+    void process(QVector<CANFrame> &batch);
+
+private:
+    struct Condition
+    {
+        bool matchId;
+        uint32_t id;
+        int bus; //-1 for any
+        const DBC_SIGNAL *sig; //has to be in the frame, if set
+        bool matchValue;
+        double value;
+    };
+
+    void compile();
+    bool fires(const CANFrame &frame) const;
+    void push(const CANFrame &frame);
+    void take(const CANFrame &frame, QVector<CANFrame> &out);
+    void trigger(const CANFrame &frame, QVector<CANFrame> &out);
+    void finish();
+
+    TriggeredCaptureConfig config;
+    QVector<Condition> conditions;
+    QSharedPointer<const FilterExpression> expression;
+    quint32 dbcRevision = 0;
+    QVector<QSharedPointer<DBCMessageHandler>> dbcMessages; //what the condition signals live in
+    TriggeredCaptureStatus::State state = TriggeredCaptureStatus::IDLE;
+    QHash<int, std::deque<CANFrame>> rings; //by bus
+    int buffered = 0;
+    QVector<CANFrame> window; //only kept when it's going to a file
+    quint64 windows = 0;
+    qint64 triggerTimeUs = 0;
+    uint32_t triggerId = 0;
+    int triggerBus = 0;
+    QString lastFile;
+    QString lastError;
+};
+
+#endif // TRIGGEREDCAPTURE_H
@@ -0,0 +1,156 @@
+#include <QMutexLocker>
+
+#include "txscheduler.h"
+
+#include <algorithm>
+
+static const qint64 defaultDeadlines[TX_CLASSES] = { TXSCHED_PROTOCOL_DEADLINE_US, TXSCHED_PERIODIC_DEADLINE_US, TXSCHED_BULK_DEADLINE_US };
+
+void TxScheduler::setCeiling(int pPercent)
+{
+    QMutexLocker lock(&mLock);
+    mCeiling = qBound(0, pPercent, 100);
+    for (Bus &bus : mBuses) bus.tokensPs = 0;
+}
+
+int TxScheduler::getCeiling() const
+{
+    QMutexLocker lock(&mLock);
+    return mCeiling;
+}
+
+bool TxScheduler::add(const CANFrame &pFrame, TxClass pClass, qint64 pDeadlineUs, qint64 pNowUs)
+{
+    if (pFrame.bus < 0 || pClass < 0 || pClass >= TX_CLASSES) return false;
+
+    QMutexLocker lock(&mLock);
+    if (pFrame.bus >= mBuses.count())
+    {
+        int first = mBuses.count();
+        mBuses.resize(pFrame.bus + 1);
+        for (int i = first; i < mBuses.count(); i++) mBuses[i].refilledUs = pNowUs;
+    }
+    TxClassCounters &counters = mCounters[pClass];
+    counters.queued++;
+    std::deque<Entry> &queue = mBuses[pFrame.bus].queues[pClass];
+    if (queue.size() >= TXSCHED_QUEUE_MAX)
+    {
+        counters.dropped++;
+        return false;
+    }
+
+    Entry entry;
+    entry.frame = pFrame;
+    entry.deadlineUs = pNowUs + (pDeadlineUs > 0 ? pDeadlineUs : defaultDeadlines[pClass]);
+    //nearly always just goes on the end, the same deadline after a later now
+    auto pos = std::upper_bound(queue.begin(), queue.end(), entry.deadlineUs,
+                                [](qint64 deadline, const Entry &e) { return deadline < e.deadlineUs; });
+    queue.insert(pos, entry);
+    mWaiting++;
+    return true;
+}
+
+bool TxScheduler::hasWaiting() const
+{
+    QMutexLocker lock(&mLock);
+    return mWaiting > 0;
+}
+
+QVector<int> TxScheduler::heldBuses() const
+{
+    QMutexLocker lock(&mLock);
+    QVector<int> held;
+    for (int i = 0; i < mBuses.count(); i++)
+    {
+        const Bus &bus = mBuses.at(i);
+        if (!bus.queues[TX_PERIODIC].empty() || !bus.queues[TX_BULK].empty()) held.append(i);
+    }
+    return held;
+}
+
+qint64 TxScheduler::take(qint64 pNowUs, const std::function<quint64(const CANFrame&)> &pCostPs,
+                         const QVector<bool> &pBlocked, QVector<CANFrame> &pOut)
+{
+    QMutexLocker lock(&mLock);
+    if (mWaiting == 0) return -1;
+
+    qint64 wait = -1;
+    auto waitAtLeast = [&wait](qint64 us)
+    {
+        if (wait < 0 || us < wait) wait = us;
+    };
+
+    //ps of bus time the ceiling lets through per us
+    const qint64 psPerUs = 1000000ll * mCeiling / 100;
+    const qint64 burstPs = psPerUs * TXSCHED_BURST_US;
+
+    for (int b = 0; b < mBuses.count(); b++)
+    {
+        Bus &bus = mBuses[b];
+        if (pNowUs > bus.refilledUs)
+        {
+            bus.tokensPs = qMin(burstPs, bus.tokensPs + (pNowUs - bus.refilledUs) * psPerUs);
+            bus.refilledUs = pNowUs;
+        }
+        const bool blocked = b < pBlocked.count() && pBlocked.at(b);
+
+        while (true)
+        {
+            int c = 0;
+            while (c < TX_CLASSES && bus.queues[c].empty()) c++;
+            if (c == TX_CLASSES) break;
+
+            std::deque<Entry> &queue = bus.queues[c];
+            const Entry &entry = queue.front();
+            TxClassCounters &counters = mCounters[c];
+
+            if (c == TX_PERIODIC && pNowUs > entry.deadlineUs + TXSCHED_PERIODIC_STALE_US)
+            {
+                counters.dropped++;
+                queue.pop_front();
+                mWaiting--;
+                continue;
+            }
+
+            quint64 cost = (mCeiling > 0) ? pCostPs(entry.frame) : 0;
+            if (c != TX_PROTOCOL)
+            {
+                if (blocked)
+                {
+                    waitAtLeast(TXSCHED_BACKLOG_RETRY_US);
+                    break;
+                }
+                if (cost > 0 && bus.tokensPs < static_cast<qint64>(cost))
+                {
+                    waitAtLeast((static_cast<qint64>(cost) - bus.tokensPs + psPerUs - 1) / psPerUs);
+                    break;
+                }
+            }
+            bus.tokensPs -= static_cast<qint64>(cost);
+
+            if (pNowUs > entry.deadlineUs) counters.late++;
+            counters.sent++;
+            pOut.append(entry.frame);
+            queue.pop_front();
+            mWaiting--;
+        }
+    }
+    return wait;
+}
+
+TxSchedulerStats TxScheduler::getStats() const
+{
+    QMutexLocker lock(&mLock);
+    TxSchedulerStats stats;
+    for (int c = 0; c < TX_CLASSES; c++) stats.classes[c] = mCounters[c];
+    stats.waiting = mWaiting;
+    return stats;
+}
+
+void TxScheduler::reset()
+{
+    QMutexLocker lock(&mLock);
+    mBuses.clear();
+    for (int c = 0; c < TX_CLASSES; c++) mCounters[c] = TxClassCounters();
+    mWaiting = 0;
+}
@@ -0,0 +1,110 @@
+#ifndef TXSCHEDULER_H
+#define TXSCHEDULER_H
+
+#include <QMutex>
+#include <QVector>
+#include <deque>
+#include <functional>
+#include "can_structs.h"
+
+//how long after being handed over a frame should be on the bus, by class, unless the sender says otherwise
+#define TXSCHED_PROTOCOL_DEADLINE_US    5000
+#define TXSCHED_PERIODIC_DEADLINE_US    20000
+#define TXSCHED_BULK_DEADLINE_US        1000000
+//a periodic frame this far past its deadline is only in the way of the next one, so it's dropped instead
+#define TXSCHED_PERIODIC_STALE_US       100000
+//frames a class may have waiting on one bus. Past that new ones are dropped
+#define TXSCHED_QUEUE_MAX               8192
+//bus time the rate limit lets through in one go after the bus was quiet, in us at the ceiling's rate
+#define TXSCHED_BURST_US                5000
+//how soon a bus whose connection was too backed up gets looked at again
+#define TXSCHED_BACKLOG_RETRY_US        1000
+
+//which sends get to go first. Lower goes first, whatever the deadlines
+enum TxClass
+{
+    TX_PROTOCOL = 0,    //flow control and other protocol replies somebody is waiting on. Never held back
+    TX_PERIODIC,        //the frame sender, scripts. Stale ones get dropped
+    TX_BULK,            //playback, fuzzing, firmware. Waits as long as it takes
+    TX_CLASSES
+};
+
+struct TxClassCounters
+{
+    quint64 queued = 0;
+    quint64 sent = 0;
+    quint64 late = 0;       //went out, but after its deadline
+    quint64 dropped = 0;    //never went out. Stale or the queue was full
+};
+
+struct TxSchedulerStats
+{
+    TxClassCounters classes[TX_CLASSES];
+    int waiting = 0;        //on all the buses right now
+};
+
+/*
+ * What CANConManager sends goes through here rather than straight to the connection. Every global bus has a queue
+ * per TxClass, each in deadline order (and in the order they came for the same deadline). take() hands out what may
+ * go now: protocol frames first and always, then periodic, then bulk, as long as the bus isn't held back.
+ *
+ * A bus is held back two ways. With a ceiling set, sends on it may only use that share of the bus time, going by the
+ * bit rate (a token bucket of picoseconds, with a little burst). And the manager marks a bus blocked while its
+ * connection already has more waiting to go out than it should. Protocol frames go either way, running the bucket
+ * into debt if they have to, since whatever waits on them times out otherwise.
+ *
+ * Any thread. Everything is under one lock that's never held while calling out to a connection.
+ */
+class TxScheduler
+{
+public:
+    //pPercent of each bus's time sends may use, 0 for no limit
+    void setCeiling(int pPercent);
+    int getCeiling() const;
+
+    /**
+     * @brief add queues a frame
+     * @param pFrame - frame.bus is the global bus
+     * @param pDeadlineUs - how long after now it should be out, 0 for the class's default
+     * @return false if its queue was full and it was dropped
+     */
+    bool add(const CANFrame &pFrame, TxClass pClass, qint64 pDeadlineUs, qint64 pNowUs);
+    bool hasWaiting() const;
+
+    /**
+     * @brief take moves what may go out now to pOut, each bus's frames in the order they should go
+     * @param pCostPs - bus time of a frame in ps, 0 if not known. Such frames aren't rate limited
+     * @param pBlocked - by global bus, true if only protocol frames may go on it now. Missing ones aren't
+     * @return us until something held back could go, -1 if nothing is waiting
+     */
+    qint64 take(qint64 pNowUs, const std::function<quint64(const CANFrame&)> &pCostPs,
+                const QVector<bool> &pBlocked, QVector<CANFrame> &pOut);
+
+    //buses with anything but protocol frames waiting, which are all the blocked flags are looked at for
+    QVector<int> heldBuses() const;
+
+    TxSchedulerStats getStats() const;
+    void reset(); //throws out everything waiting and zeroes the counters
+
+private:
+    struct Entry
+    {
+        CANFrame frame;
+        qint64 deadlineUs;
+    };
+
+    struct Bus
+    {
+        std::deque<Entry> queues[TX_CLASSES];
+        qint64 tokensPs = 0;
+        qint64 refilledUs = 0;
+    };
+
+    mutable QMutex mLock;
+    QVector<Bus> mBuses;
+    TxClassCounters mCounters[TX_CLASSES];
+    int mWaiting = 0;
+    int mCeiling = 0;
+};
+
+#endif // TXSCHEDULER_H
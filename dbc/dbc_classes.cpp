@@ -2,6 +2,10 @@
 #include "dbchandler.h"
 #include "utility.h"
 #include <QtMath>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 DBC_MESSAGE::DBC_MESSAGE()
 {
@@ -29,9 +33,109 @@ DBC_SIGNAL::DBC_SIGNAL()
     signalSize = 1;
     startBit = 1;
     valType = DBC_SIG_VAL_TYPE::UNSIGNED_INT;
+    valIndexCount = -1;
+    muxTableCount = -1;
 }
 
-bool DBC_SIGNAL::isSignalInMessage(const CANFrame &frame)
+/*
+ * Returns the precompiled extractor for this signal, recompiling it first if any of the layout fields changed
+ * since last time. The editors poke at those fields directly so checking here is the only reliable way to stay
+ * in sync. Floats always pull 32 or 64 raw bits regardless of signalSize.
+*/
+const SignalExtractor &DBC_SIGNAL::getExtractor()
+{
+    int size = signalSize;
+    if (valType == SP_FLOAT) size = 32;
+    else if (valType == DP_FLOAT) size = 64;
+    bool isSigned = (valType == SIGNED_INT);
+    if (!extractor.matches(startBit, size, intelByteOrder, isSigned))
+        extractor.compile(startBit, size, intelByteOrder, isSigned);
+    return extractor;
+}
+
+/*
+ * Const flavor of getExtractor for the re-entrant decoders. Hands back the stored extractor if it still matches
+ * the layout, otherwise compiles a throwaway one into scratch. That's only a handful of operations but prepare()
+ * after loading or editing keeps it from happening on every decode.
+*/
+const SignalExtractor &DBC_SIGNAL::extractorFor(SignalExtractor &scratch) const
+{
+    int size = signalSize;
+    if (valType == SP_FLOAT) size = 32;
+    else if (valType == DP_FLOAT) size = 64;
+    bool isSigned = (valType == SIGNED_INT);
+    if (extractor.matches(startBit, size, intelByteOrder, isSigned)) return extractor;
+    scratch.compile(startBit, size, intelByteOrder, isSigned);
+    return scratch;
+}
+
+void DBC_SIGNAL::prepare()
+{
+    getExtractor();
+    rebuildValueIndex();
+    buildMuxTable();
+}
+
+/*
+ * Diagnostic multiplexors can have hundreds of children so instead of checking every child's range on every frame
+ * the ranges get cut into segments where the set of selected children doesn't change. A mux value is then a binary
+ * search over the segment starts and the children in that segment are exactly the ones present. Extended
+ * multiplexing ranges overlap freely, a child just shows up in every segment its range covers. Children keep
+ * their multiplexedChildren order within a segment.
+ */
+void DBC_SIGNAL::buildMuxTable()
+{
+    muxBounds.clear();
+    muxSegments.clear();
+    muxEntries.clear();
+    muxTableCount = multiplexedChildren.count();
+    if (multiplexedChildren.isEmpty()) return;
+
+    DBCSignalHandler *sigs = parentMessage ? parentMessage->sigHandler : nullptr;
+    QVector<int64_t> bounds;
+    for (int c = 0; c < multiplexedChildren.count(); c++)
+    {
+        const DBC_SIGNAL *child = multiplexedChildren.at(c);
+        if (child->multiplexHighValue < child->multiplexLowValue) continue;
+        bounds.append(child->multiplexLowValue);
+        bounds.append(static_cast<int64_t>(child->multiplexHighValue) + 1);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    for (int b = 0; b + 1 < bounds.count(); b++)
+    {
+        muxBounds.append(bounds[b]);
+        muxSegments.append(muxEntries.count());
+        for (int c = 0; c < multiplexedChildren.count(); c++)
+        {
+            DBC_SIGNAL *child = multiplexedChildren.at(c);
+            if (child->multiplexLowValue <= bounds[b] && child->multiplexHighValue >= bounds[b])
+                muxEntries.append({child, sigs ? sigs->indexOf(child) : -1});
+        }
+    }
+    if (!bounds.isEmpty()) muxBounds.append(bounds.last());
+    muxSegments.append(muxEntries.count());
+}
+
+/*
+ * The children of this multiplexor that a mux value selects, from the table above. Returns how many and points
+ * children at the first. -1 when the table is out of date, callers then fall back to checking every child's range.
+ * Never rebuilds so it is safe from several threads at once.
+ */
+int DBC_SIGNAL::activeChildren(int32_t muxValue, const MuxChild *&children) const
+{
+    children = nullptr;
+    if (muxTableCount != multiplexedChildren.count()) return -1;
+    if (muxBounds.count() < 2 || muxValue < muxBounds.first() || muxValue >= muxBounds.last()) return 0;
+    int seg = static_cast<int>(std::upper_bound(muxBounds.constBegin(), muxBounds.constEnd(), static_cast<int64_t>(muxValue))
+                               - muxBounds.constBegin()) - 1;
+    int first = muxSegments[seg];
+    children = muxEntries.constData() + first;
+    return muxSegments[seg + 1] - first;
+}
+
+bool DBC_SIGNAL::isSignalInMessage(const CANFrame &frame) const
 {
     if (isMultiplexor && !isMultiplexed) return true; //the root multiplexor is always in the message.
     if (isMultiplexed)
@@ -40,8 +144,10 @@ bool DBC_SIGNAL::isSignalInMessage(const CANFrame &frame)
         {
             if (multiplexParent->isSignalInMessage(frame)) //parent is in message so check if value is correct
             {
-                int val;
-                if (!multiplexParent->processAsInt(frame, val)) return false;
+                int32_t val;
+                const QByteArray &payload = frame.payload();
+                if (!multiplexParent->decodeInt(reinterpret_cast<const uint8_t *>(payload.constData()),
+                                                payload.length(), val)) return false;
                 if ((val >= multiplexLowValue) && (val <= multiplexHighValue))
                 {
                     return true;
@@ -65,28 +171,26 @@ QString DBC_SIGNAL::processSignalTree(const CANFrame &frame)
         qDebug() << "Could not process multiplexor as an integer.";
         return build;
     }
-    qDebug() << val;
 
-    foreach (DBC_SIGNAL *sig, multiplexedChildren)
+    //only the children this mux value selects, straight out of the lookup table
+    if (muxTableCount != multiplexedChildren.count()) buildMuxTable();
+    const MuxChild *children;
+    int numChildren = activeChildren(val, children);
+    for (int i = 0; i < numChildren; i++)
     {
-        if ( (val >= sig->multiplexLowValue) && (val <= sig->multiplexHighValue) )
+        DBC_SIGNAL *sig = children[i].sig;
+        QString sigString;
+        if (sig->processAsText(frame, sigString))
         {
-            qDebug() << "Found match for multiplex value range - " << sig->name;
-            QString sigString;
-            if (sig->processAsText(frame, sigString))
+            if (!build.isEmpty() && !sigString.isEmpty())
+                build.append("\n");
+            build.append(sigString);
+            if (sig->isMultiplexor)
             {
-                qDebug() << "Returned value: " << sigString;
-                if (!build.isEmpty() && !sigString.isEmpty())
+                auto subTreeString = sig->processSignalTree(frame);
+                if (!build.isEmpty() && !subTreeString.isEmpty())
                     build.append("\n");
-                build.append(sigString);
-                if (sig->isMultiplexor)
-                {
-                    qDebug() << "Spelunkin!";
-                    auto subTreeString = sig->processSignalTree(frame);
-                    if (!build.isEmpty() && !subTreeString.isEmpty())
-                        build.append("\n");
-                    build.append(subTreeString);
-                }
+                build.append(subTreeString);
             }
         }
     }
@@ -124,104 +228,184 @@ s 5   47 46 45 44 43 42 41 40
 */
 bool DBC_SIGNAL::processAsText(const CANFrame &frame, QString &outString, bool outputName, bool outputUnit)
 {
-    int64_t result = 0;
-    bool isSigned = false;
-    bool isInteger = false;
-    double endResult;
-
     //if (!isSignalInMessage(frame)) return false;
 
     if (valType == STRING)
     {
-        QString buildString;
-        int startByte = startBit / 8;
-        int bytes = signalSize / 8;
-        for (int x = 0; x < bytes; x++) buildString.append(frame.payload().data()[startByte + x]);
-        outString = buildString;
+        outString.clear();
+        decodeText(frame, outString);
         cachedValue = outString;
         return true;
     }
 
-    if (valType == SIGNED_INT) isSigned = true;
+    const QByteArray &payload = frame.payload();
+    double endResult;
+    int64_t result;
+    bool isInteger;
+    getExtractor(); //make sure the const decode below finds it compiled
+    if (!decodeForText(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length(), endResult, result, isInteger))
+        return false;
+
+    outString = makePrettyOutput(endResult, result, outputName, isInteger, outputUnit);
+    cachedValue = endResult;
+    return true;
+}
+
+/*
+ * The numbers processAsText shows. intResult is the scaled value truncated to an integer for integer signals but
+ * the raw bits for floats, which is what the value table lookup in makePrettyOutput has always been given.
+*/
+bool DBC_SIGNAL::decodeForText(const uint8_t *data, int len, double &endResult, int64_t &intResult, bool &isInteger) const
+{
+    SignalExtractor scratch;
+    const SignalExtractor &ext = extractorFor(scratch);
+    isInteger = false;
+
     if (valType == SIGNED_INT || valType == UNSIGNED_INT)
     {
-        result = Utility::processIntegerSignal(frame.payload(), startBit, signalSize, intelByteOrder, isSigned);
-        endResult = ((double)result * factor) + bias;
-        result = (int64_t)endResult;
+        intResult = ext.extract(data, len);
+        endResult = ((double)intResult * factor) + bias;
+        intResult = (int64_t)endResult;
         // if factor is an integer, we don't need the possibly human-unreadable float representation
         isInteger = (factor == qFloor(factor));
     }
     else if (valType == SP_FLOAT)
     {
-        //The theory here is that we force the integer signal code to treat this as
-        //a 32 bit unsigned integer. This integer is then cast into a float in such a way
-        //that the bytes that make up the integer are instead treated as having made up
-        //a 32 bit single precision float. That's evil incarnate but it is very fast and small
-        //in terms of new code.
-        result = Utility::processIntegerSignal(frame.payload(), startBit, 32, intelByteOrder, false);
-        endResult = (*((float *)(&result)) * factor) + bias; //look away! This is awful. I don't even know for sure if it works. Should test that.
+        //Pull the signal out as a 32 bit unsigned integer and then reinterpret those bits as
+        //a 32 bit single precision float.
+        intResult = ext.extract(data, len);
+        uint32_t bits = static_cast<uint32_t>(intResult);
+        float floatVal;
+        memcpy(&floatVal, &bits, sizeof(floatVal));
+        endResult = (floatVal * factor) + bias;
     }
-    else //double precision float
+    else if (valType == DP_FLOAT)
     {
-        if ( frame.payload().length() < 8 )
-        {
-            result = 0;
-            return false;
-        }
-        //like the above, this is rotten and evil and wrong in so many ways. Force
-        //calculation of a 64 bit integer and then cast it into a double.
-        result = Utility::processIntegerSignal(frame.payload(), startBit, 64, intelByteOrder, false);
-        endResult = (*((double *)(&result)) * factor) + bias;
+        if ( len < 8 ) return false;
+        //same idea as above but 64 bits reinterpreted as a double.
+        intResult = ext.extract(data, len);
+        double doubleVal;
+        memcpy(&doubleVal, &intResult, sizeof(doubleVal));
+        endResult = (doubleVal * factor) + bias;
     }
+    else return false; //strings are text only
+    return true;
+}
 
-    outString = makePrettyOutput(endResult, result, outputName, isInteger, outputUnit);
-    cachedValue = endResult;
+/*
+ * Re-entrant processAsText. Appends the same text processAsText would produce to outString and optionally hands
+ * back the number behind it (what processAsText would have put into cachedValue). String signals are never
+ * read past the end of the payload.
+*/
+bool DBC_SIGNAL::decodeText(const CANFrame &frame, QString &outString, bool outputName, bool outputUnit, double *outValue) const
+{
+    const QByteArray &payload = frame.payload();
+
+    if (valType == STRING)
+    {
+        int startByte = startBit / 8;
+        int bytes = signalSize / 8;
+        for (int x = 0; x < bytes && startByte + x < payload.length(); x++) outString.append(payload.constData()[startByte + x]);
+        if (outValue) *outValue = 0.0;
+        return true;
+    }
+
+    double endResult;
+    int64_t result;
+    bool isInteger;
+    if (!decodeForText(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length(), endResult, result, isInteger))
+        return false;
+    appendPrettyOutput(outString, endResult, result, outputName, isInteger, outputUnit);
+    if (outValue) *outValue = endResult;
     return true;
 }
 
-bool DBC_SIGNAL::getValueString(int64_t intVal, QString &outString)
+/*
+ * Value table lookup for every decoded enum value. Hashed on the value, the first entry with a value wins like the
+ * old linear search. The index gets rebuilt when valList changes size or a hit doesn't check out. Changing an
+ * entry's value in place needs invalidateValueIndex() since a miss can't be double checked.
+ */
+const DBC_VAL_ENUM_ENTRY *DBC_SIGNAL::findValue(int64_t intVal)
 {
-    if (valList.count() > 0) //if this is a value list type then look it up and display the proper string
+    if (valList.isEmpty()) return nullptr;
+    if (valIndexCount != valList.count()) rebuildValueIndex();
+
+    for (int attempt = 0; attempt < 2; attempt++)
     {
-        for (int x = 0; x < valList.count(); x++)
-        {
-            if (valList.at(x).value == intVal)
-            {
-                outString = valList.at(x).descript;
-                return true;
-            }
-        }
+        QHash<qint64, int>::const_iterator it = valIndex.constFind(intVal);
+        if (it == valIndex.constEnd()) return nullptr;
+        const DBC_VAL_ENUM_ENTRY &entry = valList.at(it.value());
+        if (entry.value == intVal) return &entry;
+        rebuildValueIndex();
     }
-    return false;
+    return nullptr;
+}
+
+//same lookup without fixing up the index. A stale index or a bad hit falls back to the linear search
+const DBC_VAL_ENUM_ENTRY *DBC_SIGNAL::findValue(int64_t intVal) const
+{
+    if (valList.isEmpty()) return nullptr;
+    if (valIndexCount == valList.count())
+    {
+        QHash<qint64, int>::const_iterator it = valIndex.constFind(intVal);
+        if (it == valIndex.constEnd()) return nullptr;
+        const DBC_VAL_ENUM_ENTRY &entry = valList.at(it.value());
+        if (entry.value == intVal) return &entry;
+    }
+    for (int x = 0; x < valList.count(); x++)
+    {
+        if (valList.at(x).value == intVal) return &valList.at(x);
+    }
+    return nullptr;
+}
+
+void DBC_SIGNAL::rebuildValueIndex()
+{
+    valIndex.clear();
+    valIndex.reserve(valList.count());
+    for (int x = 0; x < valList.count(); x++)
+    {
+        if (!valIndex.contains(valList.at(x).value)) valIndex.insert(valList.at(x).value, x);
+    }
+    valIndexCount = valList.count();
+}
+
+bool DBC_SIGNAL::getValueString(int64_t intVal, QString &outString)
+{
+    const DBC_VAL_ENUM_ENTRY *entry = findValue(intVal);
+    if (!entry) return false;
+    outString = entry->descript;
+    return true;
 }
 
 QString DBC_SIGNAL::makePrettyOutput(double floatVal, int64_t intVal, bool outputName, bool isInteger, bool outputUnit)
 {
     QString outputString;
+    if (!valList.isEmpty() && valIndexCount != valList.count()) rebuildValueIndex();
+    appendPrettyOutput(outputString, floatVal, intVal, outputName, isInteger, outputUnit);
+    return outputString;
+}
 
-    if (outputName) outputString = name + ": ";
+void DBC_SIGNAL::appendPrettyOutput(QString &outString, double floatVal, int64_t intVal, bool outputName, bool isInteger, bool outputUnit) const
+{
+    if (outputName)
+    {
+        outString += name;
+        outString += QLatin1String(": ");
+    }
 
     if (valList.count() > 0) //if this is a value list type then look it up and display the proper string
     {
-        bool foundVal = false;
-        for (int x = 0; x < valList.count(); x++)
-        {
-            if (valList.at(x).value == intVal)
-            {
-                outputString += valList.at(x).descript;
-                foundVal = true;
-                break;
-            }
-        }
-        if (!foundVal) outputString += QString::number(intVal);
-        if (outputUnit) outputString += unitName;
+        const DBC_VAL_ENUM_ENTRY *entry = findValue(intVal);
+        if (entry) outString += entry->descript;
+        else outString += QString::number(intVal);
+        if (outputUnit) outString += unitName;
     }
     else //otherwise display the actual number and unit (if it exists)
     {
-       outputString += (isInteger ? QString::number(intVal) : QString::number(floatVal));
-       if (outputUnit) outputString += unitName;
+       outString += (isInteger ? QString::number(intVal) : QString::number(floatVal));
+       if (outputUnit) outString += unitName;
     }
-    return outputString;
 }
 
 //Works quite a bit like the above version but this one is cut down and only will return int32_t which is perfect for
@@ -232,29 +416,33 @@ QString DBC_SIGNAL::makePrettyOutput(double floatVal, int64_t intVal, bool outpu
 //true or false to show whether the function succeeded. The variable to fill out is passed by reference.
 bool DBC_SIGNAL::processAsInt(const CANFrame &frame, int32_t &outValue)
 {
-    int32_t result = 0;
-    bool isSigned = false;
-
-    if (valType == STRING || valType == SP_FLOAT  || valType == DP_FLOAT)
-    {
-        return false;
-    }
-
     //if (!isSignalInMessage(frame)) return false;
 
-    if (valType == SIGNED_INT) isSigned = true;
     /*if ( static_cast<int>(frame.payload().length() * 8) <= (startBit + signalSize) )
     {
         result = 0;
         return false;
     }*/
 
-    result = static_cast<int32_t>(Utility::processIntegerSignal(frame.payload(), startBit, signalSize, intelByteOrder, isSigned));
+    const QByteArray &payload = frame.payload();
+    getExtractor();
+    if (!decodeInt(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length(), outValue)) return false;
+    cachedValue = outValue;
+    return true;
+}
+
+//the re-entrant part of processAsInt. No length check, short payloads decode as 0 like they always have
+bool DBC_SIGNAL::decodeInt(const uint8_t *data, int len, int32_t &outValue) const
+{
+    if (valType == STRING || valType == SP_FLOAT  || valType == DP_FLOAT)
+    {
+        return false;
+    }
 
+    SignalExtractor scratch;
+    int32_t result = static_cast<int32_t>(extractorFor(scratch).extract(data, len));
     double endResult = (result * factor) + bias;
-    result = static_cast<int32_t>(endResult);
-    cachedValue = result;
-    outValue = result;
+    outValue = static_cast<int32_t>(endResult);
     return true;
 }
 
@@ -264,60 +452,284 @@ bool DBC_SIGNAL::processAsInt(const CANFrame &frame, int32_t &outValue)
 //Similar syntax to processSignalInt but with double instead.
 bool DBC_SIGNAL::processAsDouble(const CANFrame &frame, double &outValue)
 {
-    int64_t result = 0;
-    bool isSigned = false;
-    double endResult;
+    //if (!isSignalInMessage(frame)) return false;
 
-    if (valType == STRING)
-    {
+    const QByteArray &payload = frame.payload();
+    int32_t muxValue;
+    getExtractor();
+    if (!decodeValue(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length(), outValue, muxValue))
         return false;
+    cachedValue = outValue;
+    return true;
+}
+
+/*
+ * The re-entrant part of processAsDouble, also used by DBC_MESSAGE::decodeSignals. Works on a raw payload with the
+ * same length checks and also hands back the value the way processAsInt would compute it so multiplexors can be
+ * resolved without extracting them a second time.
+*/
+bool DBC_SIGNAL::decodeValue(const uint8_t *data, int len, double &outValue, int32_t &muxValue) const
+{
+    SignalExtractor scratch;
+    const SignalExtractor &ext = extractorFor(scratch);
+    int64_t result;
+
+    if (valType == SIGNED_INT || valType == UNSIGNED_INT)
+    {
+        if ( len * 8 < (startBit + signalSize) ) return false;
+        result = ext.extract(data, len);
+        outValue = ((double)result * factor) + bias;
+        muxValue = static_cast<int32_t>((static_cast<int32_t>(result) * factor) + bias);
+        return true;
+    }
+    else if (valType == SP_FLOAT)
+    {
+        if ( len * 8 < (startBit + 32) ) return false;
+        uint32_t bits = static_cast<uint32_t>(ext.extract(data, len));
+        float floatVal;
+        memcpy(&floatVal, &bits, sizeof(floatVal));
+        outValue = (floatVal * factor) + bias;
+        muxValue = 0;
+        return true;
     }
+    else if (valType == DP_FLOAT)
+    {
+        if ( len < 8 ) return false;
+        result = ext.extract(data, len);
+        double doubleVal;
+        memcpy(&doubleVal, &result, sizeof(doubleVal));
+        outValue = (doubleVal * factor) + bias;
+        muxValue = 0;
+        return true;
+    }
+    return false; //strings don't have a numeric value
+}
 
-    //if (!isSignalInMessage(frame)) return false;
+double DBC_SIGNAL::physicalValue(int64_t raw) const
+{
+    if (valType == SP_FLOAT)
+    {
+        uint32_t bits = static_cast<uint32_t>(raw);
+        float floatVal;
+        memcpy(&floatVal, &bits, sizeof(floatVal));
+        return (floatVal * factor) + bias;
+    }
+    if (valType == DP_FLOAT)
+    {
+        double doubleVal;
+        memcpy(&doubleVal, &raw, sizeof(doubleVal));
+        return (doubleVal * factor) + bias;
+    }
+    return ((double)raw * factor) + bias;
+}
+
+/*
+ * Encoder counterpart of decodeValue for the frame sender and anything else building frames from physical values.
+ * The value is clamped to min / max when the signal has a range (plenty of DBC files leave both at 0), run back
+ * through factor and bias, rounded and clamped again to what fits in the bits. Floats are stored as their bit
+ * pattern. Returns false without touching the payload for strings, NaN, a zero factor or a payload too short for
+ * the signal.
+*/
+bool DBC_SIGNAL::encodeValue(double value, uint8_t *data, int len) const
+{
+    if (valType == STRING || std::isnan(value) || factor == 0.0) return false;
+    if (max > min) value = qBound(min, value, max);
+    double raw = (value - bias) / factor;
+
+    SignalExtractor scratch;
+    const SignalExtractor &ext = extractorFor(scratch);
+    uint64_t bits;
 
-    if (valType == SIGNED_INT) isSigned = true;
     if (valType == SIGNED_INT || valType == UNSIGNED_INT)
     {
-        if ( frame.payload().length() * 8 < (startBit+signalSize) )
+        if (signalSize <= 0 || signalSize > 64) return false;
+        raw = std::round(raw);
+        if (valType == SIGNED_INT)
         {
-            result = 0;
-            return false;
+            int64_t hi = (signalSize == 64) ? INT64_MAX : ((1LL << (signalSize - 1)) - 1);
+            int64_t lo = -hi - 1;
+            int64_t v;
+            if (raw >= static_cast<double>(hi)) v = hi;
+            else if (raw <= static_cast<double>(lo)) v = lo;
+            else v = static_cast<int64_t>(raw);
+            bits = static_cast<uint64_t>(v);
+        }
+        else
+        {
+            uint64_t hi = (signalSize == 64) ? UINT64_MAX : ((1ULL << signalSize) - 1);
+            if (raw <= 0.0) bits = 0;
+            else if (raw >= static_cast<double>(hi)) bits = hi;
+            else bits = static_cast<uint64_t>(raw);
         }
-        result = Utility::processIntegerSignal(frame.payload(), startBit, signalSize, intelByteOrder, isSigned);
-        endResult = ((double)result * factor) + bias;
-        result = (int64_t)endResult;
     }
-    /*TODO: It should be noted that the below floating point has not even been tested. For shame! Test it!*/
     else if (valType == SP_FLOAT)
     {
-        if ( frame.payload().length() * 8 < (startBit + 32) )
+        float floatVal = static_cast<float>(raw);
+        uint32_t floatBits;
+        memcpy(&floatBits, &floatVal, sizeof(floatBits));
+        bits = floatBits;
+    }
+    else //double precision float
+    {
+        if ( len < 8 ) return false;
+        memcpy(&bits, &raw, sizeof(bits));
+    }
+    return ext.insert(data, len, bits);
+}
+
+/*
+ * Decode every signal of this message out of a frame in one shot. Signal i (sigHandler index order) lands in
+ * values[i] and bit i of validBits says whether it was actually present. A signal is invalid if the payload is
+ * too short for it, it is a string, or it is multiplexed and its multiplexor chain doesn't select it in this
+ * frame. Signals that aren't present come back as 0. validBits needs (maxSignals + 63) / 64 words. No strings are
+ * created and nothing in the message or its signals is written so several threads can decode at once.
+ * Returns the number of signals written, which is the smaller of the signal count and maxSignals.
+*/
+int DBC_MESSAGE::decodeSignals(const CANFrame &frame, double *values, uint64_t *validBits, int maxSignals) const
+{
+    const DBCSignalHandler *sigHandler = this->sigHandler; //the const lookups only, those don't detach or reindex
+    int numSigs = qMin(sigHandler->getCount(), maxSignals);
+    if (numSigs <= 0) return 0;
+
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(frame.payload().constData());
+    int len = frame.payload().length();
+
+    //room on the stack for the usual case. Messages with huge signal counts fall back to the heap
+    QVarLengthArray<int32_t, 64> muxValues(numSigs);
+    QVarLengthArray<uint8_t, 64> state(numSigs); //0 = couldn't decode (or not reached yet), 1 = decoded
+    QVarLengthArray<int, 16> pending; //present multiplexors whose children haven't been looked at yet
+    bool anyMultiplexed = false;
+
+    for (int w = 0; w < (numSigs + 63) / 64; w++) validBits[w] = 0;
+
+    //everything that isn't multiplexed is always there
+    for (int i = 0; i < numSigs; i++)
+    {
+        const DBC_SIGNAL *sig = sigHandler->findSignalByIdx(i);
+        values[i] = 0.0;
+        muxValues[i] = 0;
+        state[i] = 0;
+        if (sig->isMultiplexed)
         {
-            result = 0;
-            return false;
+            anyMultiplexed = true;
+            continue;
         }
-        //The theory here is that we force the integer signal code to treat this as
-        //a 32 bit unsigned integer. This integer is then cast into a float in such a way
-        //that the bytes that make up the integer are instead treated as having made up
-        //a 32 bit single precision float. That's evil incarnate but it is very fast and small
-        //in terms of new code.
-        result = Utility::processIntegerSignal(frame.payload(), startBit, 32, false, false);
-        endResult = (*((float *)(&result)) * factor) + bias;
+        if (!sig->decodeValue(data, len, values[i], muxValues[i])) continue;
+        state[i] = 1;
+        validBits[i / 64] |= (1ULL << (i % 64));
+        if (sig->isMultiplexor) pending.append(i);
     }
-    else //double precision float
+    if (!anyMultiplexed) return numSigs;
+    if (multiplexorSignal == nullptr) return numSigs; //multiplexed signals with no multiplexor are never present
+
+    //multiplexed signals are only decoded when a present multiplexor selects them. The multiplexors' lookup tables
+    //say which children that is so a frame only costs the signals that are really in it
+    bool stale = false;
+    while (!pending.isEmpty() && !stale)
     {
-        if ( frame.payload().length() < 8 )
+        int p = pending.last();
+        pending.removeLast();
+        const DBC_SIGNAL *parent = sigHandler->findSignalByIdx(p);
+        //multiplexors have to be integers, same rule as processAsInt
+        if (parent->valType != SIGNED_INT && parent->valType != UNSIGNED_INT) continue;
+        const DBC_SIGNAL::MuxChild *children;
+        int numChildren = parent->activeChildren(muxValues[p], children);
+        if (numChildren < 0)
+        {
+            stale = true;
+            break;
+        }
+        for (int c = 0; c < numChildren; c++)
         {
-            result = 0;
-            return false;
+            const DBC_SIGNAL *child = children[c].sig;
+            int idx = children[c].idx;
+            if (sigHandler->findSignalByIdx(idx) != child) idx = sigHandler->indexOf(child); //signals got moved around
+            if (idx < 0 || idx >= numSigs || state[idx] || child->multiplexParent != parent || !child->isMultiplexed) continue;
+            if (!child->decodeValue(data, len, values[idx], muxValues[idx])) continue;
+            state[idx] = 1;
+            validBits[idx / 64] |= (1ULL << (idx % 64));
+            if (child->isMultiplexor) pending.append(idx);
         }
-        //like the above, this is rotten and evil and wrong in so many ways. Force
-        //calculation of a 64 bit integer and then cast it into a double.
-        result = Utility::processIntegerSignal(frame.payload(), startBit, 64, false, false);
-        endResult = (*((double *)(&result)) * factor) + bias;
     }
-    cachedValue = endResult;
-    outValue = endResult;
-    return true;
+    if (!stale) return numSigs;
+
+    //a table is out of date (the signal was edited and nothing has rebuilt it yet). Decode every multiplexed signal
+    //and walk up each one's chain of parents instead
+    for (int i = 0; i < numSigs; i++)
+    {
+        const DBC_SIGNAL *sig = sigHandler->findSignalByIdx(i);
+        if (sig->isMultiplexed) state[i] = sig->decodeValue(data, len, values[i], muxValues[i]) ? 1 : 0;
+    }
+    for (int i = 0; i < numSigs; i++)
+    {
+        const DBC_SIGNAL *sig = sigHandler->findSignalByIdx(i);
+        if (state[i] == 0 || !sig->isMultiplexed) continue;
+        bool present = true;
+        const DBC_SIGNAL *child = sig;
+        while (present && child && child->isMultiplexed)
+        {
+            if (child->multiplexParent == nullptr)
+            {
+                present = false;
+                break;
+            }
+            int parentIdx = sigHandler->indexOf(child->multiplexParent);
+            if (parentIdx < 0 || parentIdx >= numSigs || state[parentIdx] == 0)
+            {
+                present = false;
+                break;
+            }
+            if (child->multiplexParent->valType != SIGNED_INT && child->multiplexParent->valType != UNSIGNED_INT)
+            {
+                present = false;
+                break;
+            }
+            int32_t val = muxValues[parentIdx];
+            if (val < child->multiplexLowValue || val > child->multiplexHighValue) present = false;
+            child = child->multiplexParent;
+        }
+        if (present) validBits[i / 64] |= (1ULL << (i % 64));
+    }
+    return numSigs;
+}
+
+/*
+ * Pack a whole message from physical values, the reverse of decodeSignals. values[i] goes to signal i (sigHandler
+ * index order). Multiplexed signals are only written when the multiplexor values in the same array select them, so
+ * one array can describe every page of a multiplexed message. NaN means leave that signal's bits as they are.
+ * Returns the number of signals written.
+*/
+int DBC_MESSAGE::encodeSignals(const double *values, int numValues, uint8_t *data, int len) const
+{
+    const DBCSignalHandler *sigHandler = this->sigHandler;
+    int numSigs = qMin(sigHandler->getCount(), numValues);
+    int written = 0;
+
+    for (int i = 0; i < numSigs; i++)
+    {
+        const DBC_SIGNAL *sig = sigHandler->findSignalByIdx(i);
+        bool present = true;
+        const DBC_SIGNAL *child = sig;
+        while (present && child->isMultiplexed)
+        {
+            if (multiplexorSignal == nullptr || child->multiplexParent == nullptr)
+            {
+                present = false;
+                break;
+            }
+            int parentIdx = sigHandler->indexOf(child->multiplexParent);
+            if (parentIdx < 0 || parentIdx >= numSigs || std::isnan(values[parentIdx]))
+            {
+                present = false;
+                break;
+            }
+            int32_t val = static_cast<int32_t>(values[parentIdx]);
+            if (val < child->multiplexLowValue || val > child->multiplexHighValue) present = false;
+            child = child->multiplexParent;
+        }
+        if (present && sig->encodeValue(values[i], data, len)) written++;
+    }
+    return written;
 }
 
 DBC_ATTRIBUTE_VALUE *DBC_SIGNAL::findAttrValByName(QString name)
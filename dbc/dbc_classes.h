@@ -2,10 +2,13 @@
 #define DBC_CLASSES_H
 
 #include <QColor>
+#include <QHash>
 #include <QString>
 #include <QStringList>
 #include <QVariant>
+#include <QVector>
 #include "can_structs.h"
+#include "utility.h"
 
 /*classes to encapsulate data from a DBC file. Really, the stuff of interest
   are the nodes, messages, signals, attributes, and comments.
@@ -89,6 +92,13 @@ class DBC_SIGNAL;
 class DBC_SIGNAL
 {
 public: //TODO: this is sloppy. It shouldn't all be public!
+    //one entry of a multiplexor's lookup table. idx is the child's position in the message's sigHandler
+    struct MuxChild
+    {
+        DBC_SIGNAL *sig;
+        int idx;
+    };
+
     QString name;
     int startBit;
     int signalSize;
@@ -112,22 +122,59 @@ public: //TODO: this is sloppy. It shouldn't all be public!
     QList<DBC_SIGNAL *> multiplexedChildren;
     DBC_SIGNAL *multiplexParent;
     DBC_SIGNAL *self;
+    SignalExtractor extractor; //compiled from startBit/signalSize/etc by getExtractor(). Don't use directly
+    QHash<qint64, int> valIndex; //value -> position in valList, see findValue(). Don't use directly
+    int valIndexCount; //valList.count() when valIndex was built, -1 to force a rebuild
+    //multiplexor lookup table, see buildMuxTable(). Don't use directly
+    QVector<int64_t> muxBounds; //segment i covers mux values muxBounds[i] up to muxBounds[i + 1] - 1
+    QVector<int> muxSegments; //segment i's children are muxEntries[muxSegments[i]] up to muxSegments[i + 1] - 1
+    QVector<MuxChild> muxEntries;
+    int muxTableCount; //multiplexedChildren.count() when the table was built, -1 to force a rebuild
 
     DBC_SIGNAL();
+    //these store what they decoded in cachedValue so they can only be used from one thread at a time
     bool processAsText(const CANFrame &frame, QString &outString, bool outputName = true, bool outputUnit = true);
     bool processAsInt(const CANFrame &frame, int32_t &outValue);
     bool processAsDouble(const CANFrame &frame, double &outValue);
     bool getValueString(int64_t intVal, QString &outString);
+    const DBC_VAL_ENUM_ENTRY *findValue(int64_t intVal); //the valList entry for a value, nullptr if there isn't one
+    void rebuildValueIndex();
+    void invalidateValueIndex() { valIndexCount = -1; } //after changing the value of a valList entry in place
+    void prepare(); //compile the extractor, value index and mux table so the const decoders below get the fast path
+    void buildMuxTable();
+    void invalidateMuxTable() { muxTableCount = -1; } //after changing children or their mux ranges
+    int activeChildren(int32_t muxValue, const MuxChild *&children) const;
     QString makePrettyOutput(double floatVal, int64_t intVal, bool outputName = true, bool isInteger = false, bool outputUnit = true);
     QString processSignalTree(const CANFrame &frame);
     DBC_ATTRIBUTE_VALUE *findAttrValByName(QString name);
     DBC_ATTRIBUTE_VALUE *findAttrValByIdx(int idx);
-    bool isSignalInMessage(const CANFrame &frame);
+    bool isSignalInMessage(const CANFrame &frame) const;
+    const SignalExtractor &getExtractor();
+
+    //re-entrant decoding. Nothing in the signal gets written so any number of threads can decode with the same
+    //signal at once, as long as nobody is editing it at the same time. Results only go to the caller's buffers,
+    //cachedValue is left alone. decodeText appends to outString so one string can be reused for a whole export
+    bool decodeValue(const uint8_t *data, int len, double &outValue, int32_t &muxValue) const;
+    bool decodeInt(const uint8_t *data, int len, int32_t &outValue) const;
+    bool decodeText(const CANFrame &frame, QString &outString, bool outputName = true, bool outputUnit = true,
+                    double *outValue = nullptr) const;
+    const DBC_VAL_ENUM_ENTRY *findValue(int64_t intVal) const;
+    //physical value of what getExtractor() pulled out of a frame: floats reinterpreted, then factor and bias
+    double physicalValue(int64_t raw) const;
+    void appendPrettyOutput(QString &outString, double floatVal, int64_t intVal, bool outputName = true,
+                            bool isInteger = false, bool outputUnit = true) const;
+
+    //physical value into the payload, see the .cpp. Just as re-entrant as the decoders
+    bool encodeValue(double value, uint8_t *data, int len) const;
 
     friend bool operator<(const DBC_SIGNAL& l, const DBC_SIGNAL& r)
     {
         return (l.name.toLower() < r.name.toLower());
     }
+
+private:
+    const SignalExtractor &extractorFor(SignalExtractor &scratch) const;
+    bool decodeForText(const uint8_t *data, int len, double &endResult, int64_t &intResult, bool &isInteger) const;
 };
 
 class DBCSignalHandler; //forward declaration to keep from having to include dbchandler.h in this file and thus create a loop
@@ -151,6 +198,14 @@ public:
 
     DBC_ATTRIBUTE_VALUE *findAttrValByName(QString name);
     DBC_ATTRIBUTE_VALUE *findAttrValByIdx(int idx);
+    int decodeSignals(const CANFrame &frame, double *values, uint64_t *validBits, int maxSignals) const;
+    int encodeSignals(const double *values, int numValues, uint8_t *data, int len) const;
+
+    //helper for reading the validity bitmap filled in by decodeSignals
+    static inline bool isDecodedValid(const uint64_t *validBits, int idx)
+    {
+        return (validBits[idx / 64] >> (idx % 64)) & 1;
+    }
 
     friend bool operator<(const DBC_MESSAGE& l, const DBC_MESSAGE& r)
     {
@@ -0,0 +1,335 @@
+#include "dbccache.h"
+
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QPalette>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "dbchandler.h"
+
+#define DBC_CACHE_MAGIC     0x43424453 //"SDBC"
+//bump whenever what gets written changes. Older caches are simply parsed over
+#define DBC_CACHE_VERSION   1
+
+/*
+ * Everything that decides whether a cache file is still good. The palette colors are in here since loadFile uses
+ * them as the defaults of the message color attributes when a DBC doesn't define those itself.
+ */
+struct DBCCacheKey
+{
+    QString path;
+    qint64 size;
+    qint64 modified;
+    QString background;
+    QString foreground;
+
+    static DBCCacheKey of(const QString &dbcFilename)
+    {
+        QFileInfo info(dbcFilename);
+        DBCCacheKey key;
+        key.path = info.absoluteFilePath();
+        key.size = info.size();
+        key.modified = info.lastModified().toMSecsSinceEpoch();
+        key.background = QApplication::palette().color(QPalette::Base).name();
+        key.foreground = QApplication::palette().color(QPalette::WindowText).name();
+        return key;
+    }
+
+    bool operator==(const DBCCacheKey &o) const
+    {
+        return path == o.path && size == o.size && modified == o.modified && background == o.background && foreground == o.foreground;
+    }
+};
+
+static QDataStream &operator<<(QDataStream &out, const DBCCacheKey &key)
+{
+    return out << key.path << key.size << key.modified << key.background << key.foreground;
+}
+
+static QDataStream &operator>>(QDataStream &in, DBCCacheKey &key)
+{
+    return in >> key.path >> key.size >> key.modified >> key.background >> key.foreground;
+}
+
+static void writeAttrValues(QDataStream &out, const QList<DBC_ATTRIBUTE_VALUE> &vals)
+{
+    out << static_cast<qint32>(vals.count());
+    foreach (const DBC_ATTRIBUTE_VALUE &val, vals) out << val.attrName << val.value;
+}
+
+static void readAttrValues(QDataStream &in, QList<DBC_ATTRIBUTE_VALUE> &vals)
+{
+    qint32 count;
+    in >> count;
+    vals.clear();
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        DBC_ATTRIBUTE_VALUE val;
+        in >> val.attrName >> val.value;
+        vals.append(val);
+    }
+}
+
+QString DBCCache::cacheFilename(const QString &dbcFilename)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/dbc";
+    QByteArray hash = QCryptographicHash::hash(QFileInfo(dbcFilename).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+    return dir + "/" + QString::fromLatin1(hash.toHex()) + ".dbcc";
+}
+
+void DBCCache::invalidate(const QString &dbcFilename)
+{
+    QFile::remove(cacheFilename(dbcFilename));
+}
+
+void DBCCache::save(const QString &dbcFilename, DBCFile &file)
+{
+    QString cacheName = cacheFilename(dbcFilename);
+    QDir().mkpath(QFileInfo(cacheName).path());
+
+    //written to the side and renamed over the old one so a half written cache never gets read
+    QSaveFile out(cacheName);
+    if (!out.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Could not write DBC cache" << cacheName;
+        return;
+    }
+    QDataStream stream(&out);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    stream << static_cast<quint32>(DBC_CACHE_MAGIC) << static_cast<quint32>(DBC_CACHE_VERSION) << DBCCacheKey::of(dbcFilename);
+    writeContents(stream, file);
+
+    if (stream.status() != QDataStream::Ok || !out.commit()) qDebug() << "Could not write DBC cache" << cacheName;
+}
+
+QByteArray DBCCache::compile(const QString &dbcFilename, DBCFile &file)
+{
+    QByteArray compiled;
+    QDataStream stream(&compiled, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << static_cast<quint32>(DBC_CACHE_MAGIC) << static_cast<quint32>(DBC_CACHE_VERSION) << DBCCacheKey::of(dbcFilename);
+    writeContents(stream, file);
+    return compiled;
+}
+
+void DBCCache::writeContents(QDataStream &stream, DBCFile &file)
+{
+    stream << static_cast<qint32>(file.messageHandler->getMatchingCriteria()) << file.messageHandler->filterLabeling();
+
+    QHash<const DBC_NODE *, qint32> nodeIdx;
+    stream << static_cast<qint32>(file.dbc_nodes.count());
+    for (int i = 0; i < file.dbc_nodes.count(); i++)
+    {
+        const DBC_NODE &node = file.dbc_nodes.at(i); //at() so a shared list doesn't detach and move the nodes
+        nodeIdx.insert(&node, i);
+        stream << node.name << node.comment << node.sourceFileName;
+        writeAttrValues(stream, node.attributes);
+    }
+
+    stream << static_cast<qint32>(file.dbc_attributes.count());
+    foreach (const DBC_ATTRIBUTE &attr, file.dbc_attributes)
+    {
+        stream << attr.name << static_cast<qint32>(attr.valType) << static_cast<qint32>(attr.attrType)
+               << attr.upper << attr.lower << attr.enumVals << attr.defaultValue;
+    }
+
+    stream << static_cast<qint32>(file.messageHandler->getCount());
+    for (int m = 0; m < file.messageHandler->getCount(); m++)
+    {
+        DBC_MESSAGE *msg = file.messageHandler->findMsgByIdx(m);
+        DBCSignalHandler *sigs = msg->sigHandler;
+        QHash<const DBC_SIGNAL *, qint32> sigIdx;
+        for (int s = 0; s < sigs->getCount(); s++) sigIdx.insert(sigs->findSignalByIdx(s), s);
+
+        stream << msg->ID << msg->extendedID << msg->name << msg->comment << static_cast<quint32>(msg->len)
+               << nodeIdx.value(msg->sender, -1) << msg->bgColor << msg->fgColor;
+        writeAttrValues(stream, msg->attributes);
+        stream << sigIdx.value(msg->multiplexorSignal, -1);
+
+        stream << static_cast<qint32>(sigs->getCount());
+        for (int s = 0; s < sigs->getCount(); s++)
+        {
+            DBC_SIGNAL *sig = sigs->findSignalByIdx(s);
+            stream << sig->name << static_cast<qint32>(sig->startBit) << static_cast<qint32>(sig->signalSize)
+                   << sig->intelByteOrder << sig->isMultiplexor << sig->isMultiplexed
+                   << static_cast<qint32>(sig->multiplexHighValue) << static_cast<qint32>(sig->multiplexLowValue)
+                   << static_cast<qint32>(sig->valType) << sig->factor << sig->bias << sig->min << sig->max
+                   << nodeIdx.value(sig->receiver, -1) << sig->unitName << sig->comment;
+            writeAttrValues(stream, sig->attributes);
+            stream << static_cast<qint32>(sig->valList.count());
+            foreach (const DBC_VAL_ENUM_ENTRY &val, sig->valList) stream << static_cast<qint32>(val.value) << val.descript;
+            stream << sigIdx.value(sig->multiplexParent, -1);
+            stream << static_cast<qint32>(sig->multiplexedChildren.count());
+            foreach (const DBC_SIGNAL *child, sig->multiplexedChildren) stream << sigIdx.value(child, -1);
+        }
+    }
+}
+
+/*
+ * Fills in file the way loadFile would have. Returns false if there's no usable cache. file has been emptied out
+ * then if the cache turned out to be damaged part way through, ready for loadFile. restore works the same.
+ */
+bool DBCCache::load(const QString &dbcFilename, DBCFile &file)
+{
+    QFile in(cacheFilename(dbcFilename));
+    if (!in.open(QIODevice::ReadOnly)) return false;
+    QDataStream stream(&in);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version;
+    DBCCacheKey key;
+    stream >> magic >> version;
+    if (magic != DBC_CACHE_MAGIC || version != DBC_CACHE_VERSION) return false;
+    stream >> key;
+    if (stream.status() != QDataStream::Ok || !(key == DBCCacheKey::of(dbcFilename))) return false;
+    return readContents(stream, dbcFilename, file);
+}
+
+bool DBCCache::restore(const QByteArray &compiled, const QString &dbcFilename, DBCFile &file)
+{
+    QDataStream stream(compiled);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version;
+    DBCCacheKey key;
+    stream >> magic >> version;
+    if (magic != DBC_CACHE_MAGIC || version != DBC_CACHE_VERSION) return false;
+    stream >> key;
+    if (stream.status() != QDataStream::Ok) return false;
+    //a DBC that was changed since wins over the copy, one that's gone doesn't
+    if (QFileInfo::exists(dbcFilename))
+    {
+        DBCCacheKey now = DBCCacheKey::of(dbcFilename);
+        if (key.size != now.size || key.modified != now.modified) return false;
+    }
+    return readContents(stream, dbcFilename, file);
+}
+
+bool DBCCache::readContents(QDataStream &stream, const QString &dbcFilename, DBCFile &file)
+{
+    qint32 matching;
+    bool labeling;
+    stream >> matching >> labeling;
+
+    file.dbc_nodes.clear();
+    file.dbc_attributes.clear();
+    file.messageHandler->removeAllMessages();
+
+    qint32 count;
+    stream >> count;
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        DBC_NODE node;
+        stream >> node.name >> node.comment >> node.sourceFileName;
+        readAttrValues(stream, node.attributes);
+        file.dbc_nodes.append(node);
+    }
+
+    stream >> count;
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        DBC_ATTRIBUTE attr;
+        qint32 valType, attrType;
+        stream >> attr.name >> valType >> attrType >> attr.upper >> attr.lower >> attr.enumVals >> attr.defaultValue;
+        attr.valType = static_cast<DBC_ATTRIBUTE_VAL_TYPE>(valType);
+        attr.attrType = static_cast<DBC_ATTRIBUTE_TYPE>(attrType);
+        file.dbc_attributes.append(attr);
+    }
+
+    qint32 msgCount;
+    stream >> msgCount;
+    for (qint32 m = 0; m < msgCount && stream.status() == QDataStream::Ok; m++)
+    {
+        DBC_MESSAGE newMsg;
+        quint32 len;
+        qint32 sender, multiplexor, sigCount;
+        stream >> newMsg.ID >> newMsg.extendedID >> newMsg.name >> newMsg.comment >> len >> sender >> newMsg.bgColor >> newMsg.fgColor;
+        readAttrValues(stream, newMsg.attributes);
+        stream >> multiplexor >> sigCount;
+        newMsg.len = len;
+        newMsg.sender = file.findNodeByIdx(sender);
+        file.messageHandler->addMessage(newMsg);
+        DBC_MESSAGE *msg = file.messageHandler->findMsgByIdx(file.messageHandler->getCount() - 1);
+
+        //the links between signals can point either way so they're filled in once all of them are there
+        QVector<qint32> parents;
+        QVector<QVector<qint32>> children;
+        for (qint32 s = 0; s < sigCount && stream.status() == QDataStream::Ok; s++)
+        {
+            DBC_SIGNAL sig;
+            qint32 startBit, signalSize, high, low, valType, receiver, valCount, parent, childCount;
+            stream >> sig.name >> startBit >> signalSize >> sig.intelByteOrder >> sig.isMultiplexor >> sig.isMultiplexed
+                   >> high >> low >> valType >> sig.factor >> sig.bias >> sig.min >> sig.max >> receiver >> sig.unitName >> sig.comment;
+            readAttrValues(stream, sig.attributes);
+            stream >> valCount;
+            for (qint32 v = 0; v < valCount && stream.status() == QDataStream::Ok; v++)
+            {
+                DBC_VAL_ENUM_ENTRY val;
+                qint32 value;
+                stream >> value >> val.descript;
+                val.value = value;
+                sig.valList.append(val);
+            }
+            stream >> parent >> childCount;
+            QVector<qint32> kids;
+            for (qint32 c = 0; c < childCount && stream.status() == QDataStream::Ok; c++)
+            {
+                qint32 child;
+                stream >> child;
+                kids.append(child);
+            }
+
+            sig.startBit = startBit;
+            sig.signalSize = signalSize;
+            sig.multiplexHighValue = high;
+            sig.multiplexLowValue = low;
+            sig.valType = static_cast<DBC_SIG_VAL_TYPE>(valType);
+            sig.receiver = file.findNodeByIdx(receiver);
+            sig.parentMessage = msg;
+            msg->sigHandler->addSignal(sig);
+            parents.append(parent);
+            children.append(kids);
+        }
+        if (stream.status() != QDataStream::Ok) break;
+
+        DBCSignalHandler *sigs = msg->sigHandler;
+        msg->multiplexorSignal = sigs->findSignalByIdx(multiplexor);
+        for (int s = 0; s < sigs->getCount(); s++)
+        {
+            DBC_SIGNAL *sig = sigs->findSignalByIdx(s);
+            sig->multiplexParent = sigs->findSignalByIdx(parents[s]);
+            foreach (qint32 child, children[s])
+            {
+                DBC_SIGNAL *childSig = sigs->findSignalByIdx(child);
+                if (childSig) sig->multiplexedChildren.append(childSig);
+            }
+        }
+        for (int s = 0; s < sigs->getCount(); s++) sigs->findSignalByIdx(s)->prepare(); //once the mux tree is whole
+    }
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        qDebug() << "DBC cache for" << dbcFilename << "is damaged, parsing the file instead";
+        file.dbc_nodes.clear();
+        file.dbc_attributes.clear();
+        file.messageHandler->removeAllMessages();
+        return false;
+    }
+
+    file.messageHandler->setMatchingCriteria(static_cast<MatchingCriteria_t>(matching));
+    file.messageHandler->setFilterLabeling(labeling);
+    QFileInfo info(dbcFilename);
+    file.fileName = info.fileName();
+    file.filePath = dbcFilename.left(dbcFilename.length() - file.fileName.length());
+    file.assocBuses = -1;
+    file.isDirty = false;
+    return true;
+}
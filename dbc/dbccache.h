@@ -0,0 +1,37 @@
+#ifndef DBCCACHE_H
+#define DBCCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+class QDataStream;
+class DBCFile;
+
+/*
+ * Parsed DBC files saved in a binary form so the same big files don't have to be parsed again every start.
+ * One cache file per DBC, in the user's cache directory, named after a hash of the DBC's full path. It only counts
+ * if the path, size and modification time it was made from still match the DBC on disk and it was written by this
+ * version of the format. Anything else and the DBC gets parsed as usual and the cache rewritten.
+ *
+ * What's stored is DBCFile as loadFile leaves it: nodes, attribute definitions, messages, signals, value tables,
+ * the multiplexor tree and every attribute value. Pointers between them are stored as list positions. The ID lookup
+ * tables in DBCMessageHandler are built from the message list on the first lookup so they aren't stored.
+ */
+class DBCCache
+{
+public:
+    static bool load(const QString &dbcFilename, DBCFile &file);
+    static void save(const QString &dbcFilename, DBCFile &file);
+    static void invalidate(const QString &dbcFilename); //the DBC is being changed, don't trust what's cached for it
+    //the same in memory, for a workspace to carry its DBCs along. restore only takes it while the DBC on disk
+    //hasn't changed since, or if the DBC isn't there at all anymore. The palette doesn't count for these
+    static QByteArray compile(const QString &dbcFilename, DBCFile &file);
+    static bool restore(const QByteArray &compiled, const QString &dbcFilename, DBCFile &file);
+
+private:
+    static QString cacheFilename(const QString &dbcFilename);
+    static void writeContents(QDataStream &stream, DBCFile &file);
+    static bool readContents(QDataStream &stream, const QString &dbcFilename, DBCFile &file);
+};
+
+#endif // DBCCACHE_H
@@ -1,6 +1,7 @@
 #include "dbchandler.h"
 
 #include <QFile>
+#include <QFileInfo>
 #include <QRegularExpression>
 #include <QDebug>
 #include <QMessageBox>
@@ -11,11 +12,202 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <climits>
+#include <cstring>
+#include <functional>
 #include "utility.h"
+#include "dbccache.h"
 #include "connections/canconmanager.h"
+#include "re/dbcdiff.h"
 
 DBCHandler* DBCHandler::instance = nullptr;
 
+//runs a DBC load on the loader pool
+class DBCLoadTask : public QRunnable
+{
+public:
+    explicit DBCLoadTask(std::function<void()> fn) : fn(fn) {}
+    void run() override { fn(); }
+
+private:
+    std::function<void()> fn;
+};
+static QAtomicInteger<quint32> dbcRevision(0); //the loader thread bumps it too
+
+//revisions that came from touchIds and the IDs each one named. Only the last few are kept, a cache that's further
+//behind than that just starts over
+struct ScopedTouch
+{
+    quint32 revision;
+    QSet<uint32_t> ids;
+};
+static QVector<ScopedTouch> scopedTouches;
+static QMutex scopedTouchLock;
+#define DBC_SCOPED_TOUCH_MAX    16
+
+//the setters all touch() as they go, which a reparse that might get thrown away shouldn't do
+static thread_local int quietTouches = 0;
+struct QuietTouches
+{
+    QuietTouches() { quietTouches++; }
+    ~QuietTouches() { quietTouches--; }
+};
+
+//how files get read on the loader thread, the cache first and a full parse if that can't be used
+static DBCFile *readDBC(const QString &filename, QString &faults)
+{
+    DBCFile *file = new DBCFile;
+    bool loaded = DBCCache::load(filename, *file);
+    if (!loaded)
+    {
+        loaded = file->parseFile(filename, faults);
+        if (loaded) DBCCache::save(filename, *file);
+    }
+    if (!loaded)
+    {
+        delete file;
+        file = nullptr;
+    }
+    return file;
+}
+
+//IDs are at most 29 bits so bit 31 is free to mark the entries for lookups that don't care about the bus
+static inline quint64 messageKey(uint32_t id, int bus, bool anyBus)
+{
+    if (anyBus) return id | 0x80000000u;
+    return (static_cast<quint64>(static_cast<quint32>(bus)) << 32) | id;
+}
+
+/*
+ * Cursor over one line of a DBC file for DBCFile::parseLineFast. The regex parsers see each line after
+ * QString::simplified() so here a run of whitespace counts as one space: space() wants at least one, skipSpace()
+ * takes any number. Name and number runs use the same character classes as the regexes (\w is ASCII only there).
+ * Whatever the lexer isn't sure about makes the caller hand the line to the regex parsers instead, so it only has to
+ * get the common, well formed lines right.
+ */
+class DBCLineLexer
+{
+public:
+    DBCLineLexer(const char *begin, const char *end) : p(begin), end(end) {}
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f'; }
+    static bool isWord(char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+    static bool isName(char c) { return isWord(c) || c == '-'; }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static bool isNumber(char c) { return isDigit(c) || c == '.' || c == '+' || c == '-' || c == 'e' || c == 'E'; }
+    static bool isAttrValue(char c) { return isWord(c) || c == '#'; }
+
+    bool atEnd() const { return p >= end; }
+    char peek() const { return (p < end) ? *p : 0; }
+    const char *pos() const { return p; }
+    const char *lineEnd() const { return end; }
+
+    void skipSpace() { while (p < end && isSpace(*p)) p++; }
+    bool space()
+    {
+        if (p >= end || !isSpace(*p)) return false;
+        skipSpace();
+        return true;
+    }
+    void skip(char c) { while (p < end && *p == c) p++; }
+    bool expect(char c)
+    {
+        if (p >= end || *p != c) return false;
+        p++;
+        return true;
+    }
+    //a literal followed by whitespace, for the keyword at the start of a line
+    bool keyword(const char *kw)
+    {
+        const char *q = p;
+        for (; *kw; kw++, q++)
+        {
+            if (q >= end || *q != *kw) return false;
+        }
+        if (q >= end || !isSpace(*q)) return false;
+        p = q;
+        skipSpace();
+        return true;
+    }
+    //one or more characters of a class
+    bool run(bool (*cls)(char), QByteArray &out)
+    {
+        const char *start = p;
+        while (p < end && cls(*p)) p++;
+        if (p == start) return false;
+        out = QByteArray::fromRawData(start, static_cast<int>(p - start));
+        return true;
+    }
+    bool name(QString &out)
+    {
+        QByteArray tok;
+        if (!run(isName, tok)) return false;
+        out = QString::fromLatin1(tok);
+        return true;
+    }
+    bool integer(int &out)
+    {
+        QByteArray tok;
+        if (!run(isDigit, tok)) return false;
+        out = tok.toInt();
+        return true;
+    }
+    bool number(double &out)
+    {
+        QByteArray tok;
+        if (!run(isNumber, tok)) return false;
+        out = tok.toDouble();
+        return true;
+    }
+    //up to the next quote, which is skipped. The opening one has to have been read already
+    bool quoted(QString &out)
+    {
+        const char *close = static_cast<const char *>(memchr(p, '"', static_cast<size_t>(end - p)));
+        if (!close) return false;
+        out = text(p, close);
+        p = close + 1;
+        return true;
+    }
+
+    //text between quotes the way it would come out of a simplified() line: every whitespace run is one space
+    static QString text(const char *b, const char *e)
+    {
+        QString str = QString::fromUtf8(b, static_cast<int>(e - b));
+        bool clean = true;
+        for (int i = 0; i < str.length() && clean; i++)
+        {
+            if (str[i].isSpace() && (str[i] != QLatin1Char(' ') || (i > 0 && str[i - 1].isSpace()))) clean = false;
+        }
+        if (clean) return str;
+
+        QString out;
+        out.reserve(str.length());
+        bool inSpace = false;
+        for (int i = 0; i < str.length(); i++)
+        {
+            if (str[i].isSpace())
+            {
+                if (!inSpace) out.append(QLatin1Char(' '));
+                inSpace = true;
+            }
+            else
+            {
+                out.append(str[i]);
+                inSpace = false;
+            }
+        }
+        return out;
+    }
+
+private:
+    const char *p;
+    const char *end;
+};
+
 DBC_SIGNAL* DBCSignalHandler::findSignalByIdx(int idx)
 {
     if (sigs.count() == 0) return nullptr;
@@ -25,22 +217,80 @@ DBC_SIGNAL* DBCSignalHandler::findSignalByIdx(int idx)
     return &sigs[idx];
 }
 
+const DBC_SIGNAL* DBCSignalHandler::findSignalByIdx(int idx) const
+{
+    if (idx < 0 || idx >= sigs.count()) return nullptr;
+    return &sigs.at(idx);
+}
+
+int DBCSignalHandler::indexOf(const DBC_SIGNAL *sig) const
+{
+    for (int i = 0; i < sigs.count(); i++)
+    {
+        if (&sigs.at(i) == sig) return i;
+    }
+    return -1;
+}
+
+/*
+ * Signal names are looked up all the time at runtime (graphs, scripts, frame sender modifiers, triggers) so this
+ * goes through a hash of the case folded names instead of comparing against every signal. First one with a name
+ * wins, same as the linear search did. The index is only ever changed by the mutators below and
+ * DBCFile::setDirtyFlag, never by a lookup, so lookups can run on several threads at once. The editors rename
+ * signals through the pointers they get from here, so a hit is double checked against the signal itself and a
+ * stale one falls back to going through the list until setDirtyFlag catches up.
+ */
 DBC_SIGNAL* DBCSignalHandler::findSignalByName(QString name)
 {
     if (sigs.count() == 0) return nullptr;
+
+    QHash<QString, int>::const_iterator it = nameIndex.constFind(name.toCaseFolded());
+    if (it != nameIndex.constEnd())
+    {
+        DBC_SIGNAL *sig = &sigs[it.value()];
+        if (sig->name.compare(name, Qt::CaseInsensitive) == 0) return sig;
+    }
     for (int i = 0; i < sigs.count(); i++)
     {
-        if (sigs[i].name.compare(name, Qt::CaseInsensitive) == 0)
-        {
-            return &sigs[i];
-        }
+        if (sigs[i].name.compare(name, Qt::CaseInsensitive) == 0) return &sigs[i];
     }
     return nullptr;
 }
 
+void DBCSignalHandler::rebuildIndex()
+{
+    nameIndex.clear();
+    nameIndex.reserve(sigs.count());
+    for (int i = 0; i < sigs.count(); i++) indexSignal(i);
+}
+
+void DBCSignalHandler::indexSignal(int idx)
+{
+    QString key = sigs[idx].name.toCaseFolded();
+    if (!nameIndex.contains(key)) nameIndex.insert(key, idx);
+}
+
+/*
+ * The same signal names turn up in message after message (and file after file) so they all share one copy of the
+ * string. Loads run on the loader thread as well as the GUI thread, hence the lock.
+ */
+QString DBCSignalHandler::internName(const QString &name)
+{
+    static QMutex lock;
+    static QSet<QString> names;
+    QMutexLocker locker(&lock);
+    QSet<QString>::const_iterator it = names.constFind(name);
+    if (it != names.constEnd()) return *it;
+    names.insert(name);
+    return name;
+}
+
 bool DBCSignalHandler::addSignal(DBC_SIGNAL &sig)
 {
     sigs.append(sig);
+    DBC_SIGNAL &added = sigs.last();
+    added.name = internName(added.name);
+    indexSignal(sigs.count() - 1);
     return true;
 }
 
@@ -55,6 +305,7 @@ bool DBCSignalHandler::removeSignal(DBC_SIGNAL *sig)
             qDebug() << "Removed signal at idx " << i;
         }
     }
+    rebuildIndex();
     return true;
 }
 
@@ -64,6 +315,7 @@ bool DBCSignalHandler::removeSignal(int idx)
     if (idx < 0) return false;
     if (idx >= sigs.count()) return false;
     sigs.removeAt(idx);
+    rebuildIndex();
     return true;
 }
 
@@ -79,15 +331,17 @@ bool DBCSignalHandler::removeSignal(QString name)
             foundSome = true;
         }
     }
+    if (foundSome) rebuildIndex();
     return foundSome;
 }
 
 void DBCSignalHandler::removeAllSignals()
 {
     sigs.clear();
+    nameIndex.clear();
 }
 
-int DBCSignalHandler::getCount()
+int DBCSignalHandler::getCount() const
 {
     return sigs.count();
 }
@@ -95,51 +349,76 @@ int DBCSignalHandler::getCount()
 void DBCSignalHandler::sort()
 {
     std::sort(sigs.begin(), sigs.end());
+    rebuildIndex();
+}
+
+/*
+ * Lookups go through hash tables built from the message list instead of scanning every message. The rules are
+ * the same as when this was a linear scan: an exact ID match always wins, otherwise the J1939 or GMLAN masked match
+ * is used if that matching mode is on. When several messages share masked bits the last one in the list wins.
+*/
+void DBCMessageHandler::rebuildIndex()
+{
+    exactIndex.clear();
+    j1939PDU1Index.clear();
+    j1939PDU2Index.clear();
+    gmlanIndex.clear();
+    exactIndex.reserve(messages.count());
+
+    for (int i = 0; i < messages.count(); i++) indexMessage(i);
+}
+
+void DBCMessageHandler::indexMessage(int idx)
+{
+    uint32_t msgID = messages[idx].ID;
+    if (!exactIndex.contains(msgID)) exactIndex.insert(msgID, idx); //first one with a given ID wins
+
+    if (matchingCriteria == J1939)
+    {
+        j1939PDU1Index.insert(msgID & 0x3FF0000, idx);
+        j1939PDU2Index.insert(msgID & 0x3FFFF00, idx);
+    }
+    else if (matchingCriteria == GMLAN)
+    {
+        gmlanIndex.insert(msgID & 0x3FFE000, idx);
+    }
 }
 
 DBC_MESSAGE* DBCMessageHandler::findMsgByID(uint32_t id)
 {
     if (messages.count() == 0) return nullptr;
-    DBC_MESSAGE *bestMatch = nullptr;
 
-    for (int i = 0; i < messages.count(); i++)
+    QHash<uint32_t, int>::const_iterator it = exactIndex.constFind(id);
+    if (it != exactIndex.constEnd()) return &messages[it.value()];
+
+    if (matchingCriteria == J1939)
     {
-        if ( messages[i].ID == id )
+        // include data page and extended data page in the pgn
+        uint32_t pgn = (id & 0x3FFFF00) >> 8;
+        if ( (pgn & 0xFF00) <= 0xEF00 )
         {
-            return &messages[i];
+            // PDU1 format. Destination address isn't part of the PGN
+            it = j1939PDU1Index.constFind(id & 0x3FF0000);
+            if (it != j1939PDU1Index.constEnd()) return &messages[it.value()];
         }
-
-        if (matchingCriteria == J1939)
+        else
         {
-            // include data page and extended data page in the pgn
-            uint32_t pgn = (id & 0x3FFFF00) >> 8;
-            if ( (pgn & 0xFF00) <= 0xEF00 )
-            {
-                // PDU1 format
-                pgn &= 0x3FF00;
-                if ((messages[i].ID & 0x3FF0000) == (pgn << 8))
-                {
-                    bestMatch = &messages[i];
-                }
-            }
-            else
-            {
-                // PDU2 format
-                if ((messages[i].ID & 0x3FFFF00) == (pgn << 8))
-                {
-                    bestMatch = &messages[i];
-                }
-            }
+            // PDU2 format
+            it = j1939PDU2Index.constFind(id & 0x3FFFF00);
+            if (it != j1939PDU2Index.constEnd()) return &messages[it.value()];
         }
-        else if (matchingCriteria == GMLAN)
+    }
+    else if (matchingCriteria == GMLAN)
+    {
+        // Match the bits 14-26 (Arbitration Id) of GMLAN 29bit header
+        uint32_t arbId = id & 0x3FFE000;
+        if (arbId != 0)
         {
-            // Match the bits 14-26 (Arbitration Id) of GMLAN 29bit header
-            uint32_t arbId = id &0x3FFE000;
-            if ( (arbId != 0) && (messages[i].ID & 0x3FFE000) == arbId )
-                bestMatch = &messages[i];
+            it = gmlanIndex.constFind(arbId);
+            if (it != gmlanIndex.constEnd()) return &messages[it.value()];
         }
     }
-    return bestMatch;
+    return nullptr;
 }
 
 DBC_MESSAGE* DBCMessageHandler::findMsgByIdx(int idx)
@@ -198,6 +477,9 @@ QList<DBC_MESSAGE*> DBCMessageHandler::findMsgsByNode(DBC_NODE* node)
 bool DBCMessageHandler::addMessage(DBC_MESSAGE &msg)
 {
     messages.append(msg);
+    //appending can't move anything that's indexed already so just add this one. Loading a file looks every new
+    //message up right after adding it and rebuilding each time made that quadratic
+    indexMessage(messages.count() - 1);
     return true;
 }
 
@@ -209,6 +491,8 @@ bool DBCMessageHandler::removeMessage(DBC_MESSAGE *msg)
         if (messages[i].name == msg->name)
         {
             messages.removeAt(i);
+            rebuildIndex();
+            DBCHandler::touch(); //DBCHandler's (bus, ID) index points straight at messages
             qDebug() << "Removed message at idx " << i;
             break;
         }
@@ -222,6 +506,8 @@ bool DBCMessageHandler::removeMessageByIndex(int idx)
     if (idx < 0) return false;
     if (idx >= messages.count()) return false;
     messages.removeAt(idx);
+    rebuildIndex();
+    DBCHandler::touch();
     return true;
 }
 
@@ -237,6 +523,11 @@ bool DBCMessageHandler::removeMessage(uint32_t ID)
             foundSome = true;
         }
     }
+    if (foundSome)
+    {
+        rebuildIndex();
+        DBCHandler::touch();
+    }
     return foundSome;
 }
 
@@ -252,12 +543,19 @@ bool DBCMessageHandler::removeMessage(QString name)
             foundSome = true;
         }
     }
+    if (foundSome)
+    {
+        rebuildIndex();
+        DBCHandler::touch();
+    }
     return foundSome;
 }
 
 void DBCMessageHandler::removeAllMessages()
 {
     messages.clear();
+    rebuildIndex();
+    DBCHandler::touch();
 }
 
 int DBCMessageHandler::getCount()
@@ -268,6 +566,8 @@ int DBCMessageHandler::getCount()
 void DBCMessageHandler::sort()
 {
     std::sort(messages.begin(), messages.end());
+    rebuildIndex();
+    DBCHandler::touch();
     for (int i = 0; i < messages.count(); i++)
     {
         messages[i].sigHandler->sort();
@@ -292,32 +592,32 @@ MatchingCriteria_t DBCMessageHandler::getMatchingCriteria()
 void DBCMessageHandler::setMatchingCriteria(MatchingCriteria_t _matchingCriteria)
 {
     matchingCriteria = _matchingCriteria;
+    rebuildIndex();
+    DBCHandler::touch();
 }
 
 DBCFile::DBCFile()
 {
-    messageHandler = new DBCMessageHandler;
+    sharedMessages.reset(new DBCMessageHandler);
+    messageHandler = sharedMessages.data();
     messageHandler->setMatchingCriteria(EXACT);
     messageHandler->setFilterLabeling(false);
     isDirty = false;
+    assocBuses = -1;
     fileName = "<Unsaved File>";
 }
 
+//O(1), see the class comment. This used to copy every message into a new handler, but the copied signals kept
+//pointing at the original messages anyway
 DBCFile::DBCFile(const DBCFile& cpy) : QObject()
 {
-    messageHandler = new DBCMessageHandler;
-    for (int i = 0 ; i < cpy.messageHandler->getCount() ; i++)
-        messageHandler->addMessage(*cpy.messageHandler->findMsgByIdx(i));
-
-    messageHandler->setMatchingCriteria(cpy.messageHandler->getMatchingCriteria());
-    messageHandler->setFilterLabeling(cpy.messageHandler->filterLabeling());
+    sharedMessages = cpy.sharedMessages;
+    messageHandler = sharedMessages.data();
     fileName = cpy.fileName;
     filePath = cpy.filePath;
     assocBuses = cpy.assocBuses;
-    dbc_nodes.clear();
-    dbc_nodes.append(cpy.dbc_nodes);
-    dbc_attributes.clear();
-    dbc_attributes.append(cpy.dbc_attributes);
+    dbc_nodes = cpy.dbc_nodes;
+    dbc_attributes = cpy.dbc_attributes;
     isDirty = cpy.isDirty;
 }
 
@@ -325,24 +625,79 @@ DBCFile& DBCFile::operator=(const DBCFile& cpy)
 {
     if (this != &cpy) // protect against invalid self-assignment
     {
-        messageHandler = cpy.messageHandler;
+        sharedMessages = cpy.sharedMessages;
+        messageHandler = sharedMessages.data();
         fileName = cpy.fileName;
         filePath = cpy.filePath;
         assocBuses = cpy.assocBuses;
-        dbc_nodes.clear();
-        dbc_nodes.append(cpy.dbc_nodes);
-        dbc_attributes.clear();
-        dbc_attributes.append(cpy.dbc_attributes);
+        dbc_nodes = cpy.dbc_nodes;
+        dbc_attributes = cpy.dbc_attributes;
+        isDirty = cpy.isDirty;
     }
     return *this;
 }
 
+QSharedPointer<DBCMessageHandler> DBCFile::sharedMessageHandler() const
+{
+    return sharedMessages;
+}
+
 void DBCFile::sort()
 {
     std::sort(dbc_nodes.begin(), dbc_nodes.end()); //sort node names
     messageHandler->sort(); //sort messages, each of which sorts its signals too
 }
 
+//rough sizes for the memory usage dialog. Strings and lists are counted, QVariant contents aren't
+static qint64 attributeBytes(const QList<DBC_ATTRIBUTE_VALUE> &attributes)
+{
+    qint64 bytes = MemoryAccounting::bytesOf(attributes);
+    for (const DBC_ATTRIBUTE_VALUE &attr : attributes) bytes += MemoryAccounting::bytesOf(attr.attrName);
+    return bytes;
+}
+
+static qint64 signalBytes(const DBC_SIGNAL &sig)
+{
+    qint64 bytes = sizeof(DBC_SIGNAL) + MemoryAccounting::bytesOf(sig.name) + MemoryAccounting::bytesOf(sig.unitName)
+                 + MemoryAccounting::bytesOf(sig.comment) + attributeBytes(sig.attributes)
+                 + MemoryAccounting::bytesOf(sig.valList) + MemoryAccounting::bytesOf(sig.multiplexedChildren)
+                 + MemoryAccounting::bytesOf(sig.valIndex) + MemoryAccounting::bytesOf(sig.muxBounds)
+                 + MemoryAccounting::bytesOf(sig.muxSegments) + MemoryAccounting::bytesOf(sig.muxEntries);
+    for (const DBC_VAL_ENUM_ENTRY &val : sig.valList) bytes += MemoryAccounting::bytesOf(val.descript);
+    return bytes;
+}
+
+void DBCFile::reportMemory(QVector<MemoryUsage> &out, const QString &owner) const
+{
+    qint64 messageBytes = 0;
+    qint64 sigBytes = 0;
+    int sigCount = 0;
+    for (int i = 0; i < messageHandler->getCount(); i++)
+    {
+        const DBC_MESSAGE *msg = messageHandler->findMsgByIdx(i);
+        messageBytes += sizeof(DBC_MESSAGE) + MemoryAccounting::bytesOf(msg->name) + MemoryAccounting::bytesOf(msg->comment)
+                      + attributeBytes(msg->attributes);
+        const DBCSignalHandler *sigs = msg->sigHandler;
+        for (int j = 0; j < sigs->getCount(); j++) sigBytes += signalBytes(*sigs->findSignalByIdx(j));
+        sigCount += sigs->getCount();
+    }
+    //the lookup tables, about one hash node per message
+    messageBytes += static_cast<qint64>(messageHandler->getCount()) * static_cast<qint64>(sizeof(uint32_t) + sizeof(int) + 2 * sizeof(void *));
+
+    qint64 otherBytes = MemoryAccounting::bytesOf(dbc_nodes) + MemoryAccounting::bytesOf(dbc_attributes);
+    for (const DBC_NODE &node : dbc_nodes)
+        otherBytes += MemoryAccounting::bytesOf(node.name) + MemoryAccounting::bytesOf(node.comment) + attributeBytes(node.attributes);
+    for (const DBC_ATTRIBUTE &attr : dbc_attributes)
+    {
+        otherBytes += MemoryAccounting::bytesOf(attr.name);
+        for (const QString &val : attr.enumVals) otherBytes += MemoryAccounting::bytesOf(val);
+    }
+
+    out.append({owner, QString("%1: %2 messages").arg(fileName).arg(messageHandler->getCount()), messageBytes});
+    out.append({owner, QString("%1: %2 signals").arg(fileName).arg(sigCount), sigBytes});
+    out.append({owner, QString("%1: nodes and attributes").arg(fileName), otherBytes});
+}
+
 DBC_NODE* DBCFile::findNodeByIdx(int idx)
 {
     if (idx < 0) return nullptr;
@@ -414,6 +769,7 @@ void DBCFile::setAssocBus(int bus)
     //int numBuses = CANConManager::getInstance()->getNumBuses();
     //if (bus >= numBuses) return;
     assocBuses = bus;
+    DBCHandler::touch();
 }
 
 DBC_ATTRIBUTE *DBCFile::findAttributeByName(QString name, DBC_ATTRIBUTE_TYPE type)
@@ -448,7 +804,20 @@ void DBCFile::findAttributesByType(DBC_ATTRIBUTE_TYPE typ, QList<DBC_ATTRIBUTE>
 
 void DBCFile::setDirtyFlag()
 {
+    //what's cached is what was on disk. Once edits start that's on its way out
+    if (!isDirty) DBCCache::invalidate(filePath + fileName);
     isDirty = true;
+    //the editors flag the file dirty whenever they touch a message or signal so this is the spot to catch ID and
+    //name edits
+    messageHandler->rebuildIndex();
+    for (int i = 0; i < messageHandler->getCount(); i++)
+    {
+        DBCSignalHandler *sigs = messageHandler->findMsgByIdx(i)->sigHandler;
+        sigs->rebuildIndex();
+        //mux ranges and parents get edited in place too
+        for (int s = 0; s < sigs->getCount(); s++) sigs->findSignalByIdx(s)->invalidateMuxTable();
+    }
+    DBCHandler::touch();
 }
 
 //BE CAREFUL HERE. Do not clear the dirty flag unless you're absolutely sure nothing has changed.
@@ -482,21 +851,27 @@ DBC_MESSAGE* DBCFile::parseMessageLine(QString line)
     //captured 4 = the NODE responsible for this message
     if (match.hasMatch())
     {
-        DBC_MESSAGE msg;
-        uint32_t ID = match.captured(1).toULong(); //the ID is always stored in decimal format
-        msg.ID = ID & 0x1FFFFFFFul;
-        msg.extendedID = (ID & 0x80000000ul) ? true : false;
-        msg.name = match.captured(2);
-        msg.len = match.captured(3).toUInt();
-        msg.sender = findNodeByName(match.captured(4));
-        if (!msg.sender) msg.sender = findNodeByIdx(0);
-        messageHandler->addMessage(msg);
-        msgPtr = messageHandler->findMsgByID(msg.ID);
+        //the ID is always stored in decimal format
+        msgPtr = addParsedMessage(match.captured(1).toULong(), match.captured(2), match.captured(3).toUInt(), match.captured(4));
     }
     else msgPtr = nullptr;
     return msgPtr;
 }
 
+//the parts of a BO_ line, from either parser. Returns the message signals that follow get added to
+DBC_MESSAGE* DBCFile::addParsedMessage(uint32_t ID, const QString &name, unsigned int len, const QString &senderName)
+{
+    DBC_MESSAGE msg;
+    msg.ID = ID & 0x1FFFFFFFul;
+    msg.extendedID = (ID & 0x80000000ul) ? true : false;
+    msg.name = name;
+    msg.len = len;
+    msg.sender = findNodeByName(senderName);
+    if (!msg.sender) msg.sender = findNodeByIdx(0);
+    messageHandler->addMessage(msg);
+    return messageHandler->findMsgByID(msg.ID);
+}
+
 DBC_SIGNAL* DBCFile::parseSignalLine(QString line, DBC_MESSAGE *msg)
 {
     QRegularExpression regex;
@@ -577,62 +952,68 @@ DBC_SIGNAL* DBCFile::parseSignalLine(QString line, DBC_MESSAGE *msg)
         sig.name = match.captured(1);
         sig.startBit = match.captured(2 + offset).toInt();
         sig.signalSize = match.captured(3 + offset).toInt();
-        int val = match.captured(4 + offset).toInt();
-        if (val < 2)
-        {
-            if (match.captured(5 + offset) == "+") sig.valType = UNSIGNED_INT;
-            else sig.valType = SIGNED_INT;
-        }
-        switch (val)
-        {
-        case 0: //big endian mode
-            sig.intelByteOrder = false;
-            break;
-        case 1: //little endian mode
-            sig.intelByteOrder = true;
-            break;
-        case 2:
-            sig.valType = SP_FLOAT;
-            break;
-        case 3:
-            sig.valType = DP_FLOAT;
-            break;
-        case 4:
-            sig.valType = STRING;
-            break;
-        case 5: //single point float in little endian
-            sig.valType = SP_FLOAT;
-            sig.intelByteOrder = true;
-            break;
-        case 6: //double point float in little endian
-            sig.valType = DP_FLOAT;
-            sig.intelByteOrder = true;
-            break;
-        }
         sig.factor = match.captured(6 + offset).toDouble();
         sig.bias = match.captured(7 + offset).toDouble();
         sig.min = match.captured(8 + offset).toDouble();
         sig.max = match.captured(9 + offset).toDouble();
         sig.unitName = match.captured(10 + offset);
-        if (match.captured(11 + offset).contains(','))
-        {
-            QString tmp = match.captured(11 + offset).split(',')[0];
-            sig.receiver = findNodeByName(tmp);            
-        }
-        else sig.receiver = findNodeByName(match.captured(11 + offset));
+        return addParsedSignal(sig, match.captured(4 + offset).toInt(), match.captured(5 + offset) == "+",
+                               match.captured(11 + offset), msg, isMessageMultiplexor);
+    }
 
-        if (!sig.receiver) sig.receiver = findNodeByIdx(0); //apply default if there was no match
+    return nullptr;
+}
 
-        sig.parentMessage = msg;
-        if (msg)
-        {
-            msg->sigHandler->addSignal(sig);
-            if (isMessageMultiplexor) msg->multiplexorSignal = msg->sigHandler->findSignalByName(sig.name);
-            return msg->sigHandler->findSignalByName(sig.name);
-        }
-        else return nullptr;
+//the rest of an SG_ line, from either parser. valueType is the number after the @, unsignedInt is whether a + followed it
+DBC_SIGNAL* DBCFile::addParsedSignal(DBC_SIGNAL &sig, int valueType, bool unsignedInt, const QString &receivers, DBC_MESSAGE *msg, bool isMessageMultiplexor)
+{
+    if (valueType < 2)
+    {
+        if (unsignedInt) sig.valType = UNSIGNED_INT;
+        else sig.valType = SIGNED_INT;
     }
+    switch (valueType)
+    {
+    case 0: //big endian mode
+        sig.intelByteOrder = false;
+        break;
+    case 1: //little endian mode
+        sig.intelByteOrder = true;
+        break;
+    case 2:
+        sig.valType = SP_FLOAT;
+        break;
+    case 3:
+        sig.valType = DP_FLOAT;
+        break;
+    case 4:
+        sig.valType = STRING;
+        break;
+    case 5: //single point float in little endian
+        sig.valType = SP_FLOAT;
+        sig.intelByteOrder = true;
+        break;
+    case 6: //double point float in little endian
+        sig.valType = DP_FLOAT;
+        sig.intelByteOrder = true;
+        break;
+    }
+    if (receivers.contains(','))
+    {
+        QString tmp = receivers.split(',')[0];
+        sig.receiver = findNodeByName(tmp);
+    }
+    else sig.receiver = findNodeByName(receivers);
 
+    if (!sig.receiver) sig.receiver = findNodeByIdx(0); //apply default if there was no match
+
+    sig.parentMessage = msg;
+    if (msg)
+    {
+        msg->sigHandler->addSignal(sig);
+        if (isMessageMultiplexor) msg->multiplexorSignal = msg->sigHandler->findSignalByName(sig.name);
+        return msg->sigHandler->findSignalByName(sig.name);
+    }
     return nullptr;
 }
 
@@ -652,22 +1033,29 @@ bool DBCFile::parseSignalMultiplexValueLine(QString line)
     //captured 5 is the upper bound
     if (match.hasMatch())
     {
-        DBC_MESSAGE *msg = messageHandler->findMsgByID(match.captured(1).toULong() & 0x1FFFFFFFUL);
-        if (msg != nullptr)
+        return addMultiplexValue(match.captured(1).toULong(), match.captured(2), match.captured(3),
+                                 match.captured(4).toInt(), match.captured(5).toInt());
+    }
+    return false;
+}
+
+bool DBCFile::addMultiplexValue(uint32_t ID, const QString &sigName, const QString &parentName, int low, int high)
+{
+    DBC_MESSAGE *msg = messageHandler->findMsgByID(ID & 0x1FFFFFFFUL);
+    if (msg != nullptr)
+    {
+        DBC_SIGNAL *thisSignal = msg->sigHandler->findSignalByName(sigName);
+        if (thisSignal != nullptr)
         {
-            DBC_SIGNAL *thisSignal = msg->sigHandler->findSignalByName(match.captured(2));
-            if (thisSignal != nullptr)
+            DBC_SIGNAL *parentSignal = msg->sigHandler->findSignalByName(parentName);
+            if (parentSignal != nullptr)
             {
-                DBC_SIGNAL *parentSignal = msg->sigHandler->findSignalByName(match.captured(3));
-                if (parentSignal != nullptr)
-                {
-                    //now need to add "thisSignal" to the children multiplexed signals of "parentSignal"
-                    parentSignal->multiplexedChildren.append(thisSignal);
-                    thisSignal->multiplexParent = parentSignal;
-                    thisSignal->multiplexLowValue = match.captured(4).toInt();
-                    thisSignal->multiplexHighValue = match.captured(5).toInt();
-                    return true;
-                }
+                //now need to add "thisSignal" to the children multiplexed signals of "parentSignal"
+                parentSignal->multiplexedChildren.append(thisSignal);
+                thisSignal->multiplexParent = parentSignal;
+                thisSignal->multiplexLowValue = low;
+                thisSignal->multiplexHighValue = high;
+                return true;
             }
         }
     }
@@ -771,27 +1159,7 @@ bool DBCFile::parseAttributeLine(QString line)
     if (match.hasMatch())
     {
         qDebug() << "Found an attribute setting line for a message";
-        DBC_ATTRIBUTE *foundAttr = findAttributeByName(match.captured(1));
-        if (foundAttr)
-        {
-            qDebug() << "That message attribute does exist";
-            DBC_MESSAGE *foundMsg = messageHandler->findMsgByID(match.captured(2).toUInt() & 0x1FFFFFFFul);
-            if (foundMsg)
-            {
-                qDebug() << "It references a valid, registered message";
-                DBC_ATTRIBUTE_VALUE *foundAttrVal = foundMsg->findAttrValByName(match.captured(1));
-                if (foundAttrVal) {
-                    foundAttrVal->value = processAttributeVal(match.captured(3), foundAttr->valType);
-                }
-                else
-                {
-                    DBC_ATTRIBUTE_VALUE val;
-                    val.attrName = match.captured(1);
-                    val.value = processAttributeVal(match.captured(3), foundAttr->valType);
-                    foundMsg->attributes.append(val);
-                }
-            }
-        }
+        setMessageAttribute(match.captured(1), match.captured(2).toUInt(), match.captured(3));
     }
 
     regex.setPattern("^BA\\_ \\\"*([-\\w]+)\\\"* SG\\_ (\\d+) \\\"*([-\\w]+)\\\"* \\\"*([#\\w]+)\\\"*");
@@ -803,29 +1171,7 @@ bool DBCFile::parseAttributeLine(QString line)
     if (match.hasMatch())
     {
         qDebug() << "Found an attribute setting line for a signal";
-        DBC_ATTRIBUTE *foundAttr = findAttributeByName(match.captured(1));
-        if (foundAttr)
-        {
-            qDebug() << "That signal attribute does exist";
-            DBC_MESSAGE *foundMsg = messageHandler->findMsgByID(match.captured(2).toUInt() & 0x1FFFFFFFUL);
-            if (foundMsg)
-            {
-                qDebug() << "It references a valid, registered message";
-                DBC_SIGNAL *foundSig = foundMsg->sigHandler->findSignalByName(match.captured(3));
-                if (foundSig)
-                {
-                    DBC_ATTRIBUTE_VALUE *foundAttrVal = foundSig->findAttrValByName(match.captured(1));
-                    if (foundAttrVal) foundAttrVal->value = processAttributeVal(match.captured(3), foundAttr->valType);
-                    else
-                    {
-                        DBC_ATTRIBUTE_VALUE val;
-                        val.attrName = match.captured(1);
-                        val.value = processAttributeVal(match.captured(3), foundAttr->valType);
-                        foundSig->attributes.append(val);
-                    }
-                }
-            }
-        }
+        setSignalAttribute(match.captured(1), match.captured(2).toUInt(), match.captured(3), match.captured(4));
     }
 
     regex.setPattern("^BA\\_ \\\"*([-\\w]+)\\\"* BU\\_ \\\"*([-\\w]+)\\\"* \\\"*([#\\w]+)\\\"*");
@@ -836,31 +1182,80 @@ bool DBCFile::parseAttributeLine(QString line)
     if (match.hasMatch())
     {
         qDebug() << "Found an attribute setting line for a node";
-        DBC_ATTRIBUTE *foundAttr = findAttributeByName(match.captured(1));
-        if (foundAttr)
-        {
-            qDebug() << "That node attribute does exist";
-            DBC_NODE *foundNode = findNodeByName(match.captured(2));
-            if (foundNode)
-            {
-                qDebug() << "References a valid node name";
-                DBC_ATTRIBUTE_VALUE *foundAttrVal = foundNode->findAttrValByName(match.captured(1));
-                if (foundAttrVal) foundAttrVal->value = processAttributeVal(match.captured(3), foundAttr->valType);
-                else
-                {
-                    DBC_ATTRIBUTE_VALUE val;
-                    val.attrName = match.captured(1);
-                    val.value = processAttributeVal(match.captured(3), foundAttr->valType);
-                    foundNode->attributes.append(val);
-                }
-            }
-            return true;
-        }
+        return setNodeAttribute(match.captured(1), match.captured(2), match.captured(3));
     }
 
     return false;
 }
 
+//a value for an attribute somebody has. Replaces the one it had already
+template<class T> static void setAttrValue(T *owner, const QString &name, const QVariant &value)
+{
+    DBC_ATTRIBUTE_VALUE *foundAttrVal = owner->findAttrValByName(name);
+    if (foundAttrVal) foundAttrVal->value = value;
+    else
+    {
+        DBC_ATTRIBUTE_VALUE val;
+        val.attrName = name;
+        val.value = value;
+        owner->attributes.append(val);
+    }
+}
+
+//the BA_ setters for both parsers. The attribute has to have been defined and the message / signal / node has to exist
+bool DBCFile::setMessageAttribute(const QString &attrName, uint32_t ID, const QString &value)
+{
+    DBC_ATTRIBUTE *foundAttr = findAttributeByName(attrName);
+    if (!foundAttr) return false;
+    DBC_MESSAGE *foundMsg = messageHandler->findMsgByID(ID & 0x1FFFFFFFul);
+    if (!foundMsg) return false;
+    setAttrValue(foundMsg, attrName, processAttributeVal(value, foundAttr->valType));
+    return true;
+}
+
+bool DBCFile::setSignalAttribute(const QString &attrName, uint32_t ID, const QString &sigName, const QString &value)
+{
+    DBC_ATTRIBUTE *foundAttr = findAttributeByName(attrName);
+    if (!foundAttr) return false;
+    DBC_MESSAGE *foundMsg = messageHandler->findMsgByID(ID & 0x1FFFFFFFUL);
+    if (!foundMsg) return false;
+    DBC_SIGNAL *foundSig = foundMsg->sigHandler->findSignalByName(sigName);
+    if (!foundSig) return false;
+    setAttrValue(foundSig, attrName, processAttributeVal(value, foundAttr->valType));
+    return true;
+}
+
+bool DBCFile::setNodeAttribute(const QString &attrName, const QString &nodeName, const QString &value)
+{
+    DBC_ATTRIBUTE *foundAttr = findAttributeByName(attrName);
+    if (!foundAttr) return false;
+    DBC_NODE *foundNode = findNodeByName(nodeName);
+    if (foundNode) setAttrValue(foundNode, attrName, processAttributeVal(value, foundAttr->valType));
+    return true;
+}
+
+DBC_MESSAGE *DBCFile::setMessageString(uint32_t ID, unsigned int len, const QString &attrName, const QString &value)
+{
+    if (!findAttributeByName(attrName, ATTR_TYPE_MESSAGE))
+    {
+        DBC_ATTRIBUTE attr;
+        attr.attrType = ATTR_TYPE_MESSAGE;
+        attr.defaultValue = QString();
+        attr.lower = 0;
+        attr.upper = 0;
+        attr.name = attrName;
+        attr.valType = ATTR_STRING;
+        dbc_attributes.append(attr);
+    }
+
+    DBC_MESSAGE *msg = messageHandler->findMsgByID(ID & 0x1FFFFFFFul);
+    if (!msg) msg = addParsedMessage(ID, "Msg" + QString::number(ID & 0x1FFFFFFFul, 16).toUpper(), len, QString());
+    if (!msg) return nullptr;
+    setAttrValue(msg, attrName, value);
+    setDirtyFlag();
+    return msg;
+}
+
 bool DBCFile::parseDefaultAttrLine(QString line)
 {
     QRegularExpression regex;
@@ -906,10 +1301,267 @@ bool DBCFile::parseDefaultAttrLine(QString line)
     return false;
 }
 
+/*
+ * The lines that make up nearly all of a big DBC file, without any regular expressions: BO_, SG_, SG_MUL_VAL_,
+ * VAL_, CM_ BO_ / CM_ SG_ and BA_. begin..end is one line straight out of the file, no line break.
+ * Returns false if it isn't one of those or doesn't look the way these expect. loadFile then gives the line to the
+ * regex parsers which know all the odd cases. Nothing is changed until a line has been read completely so a line
+ * that gets handed over hasn't been half applied. Faults are counted the same way as for the regex parsers. BO_
+ * lines that can't be read here don't need counting, parseMessageLine counts them.
+ */
+bool DBCFile::parseLineFast(const char *begin, const char *end, DBC_MESSAGE *&currentMessage, int &numSigFaults)
+{
+    while (end > begin && DBCLineLexer::isSpace(end[-1])) end--;
+    DBCLineLexer lex(begin, end);
+    lex.skipSpace();
+
+    switch (lex.peek())
+    {
+    case 'B':
+        if (lex.keyword("BO_"))
+        {
+            DBC_MESSAGE *msg;
+            if (!fastMessageLine(lex, msg)) return false;
+            currentMessage = msg;
+            return true;
+        }
+        if (lex.keyword("BA_")) return fastAttributeLine(lex);
+        return false;
+    case 'S':
+        if (lex.keyword("SG_"))
+        {
+            bool added;
+            if (!fastSignalLine(lex, currentMessage, added)) return false;
+            if (!added) numSigFaults++;
+            return true;
+        }
+        if (lex.keyword("SG_MUL_VAL_"))
+        {
+            bool added;
+            if (!fastMultiplexValueLine(lex, added)) return false;
+            if (!added) numSigFaults++;
+            return true;
+        }
+        return false;
+    case 'V':
+        if (lex.keyword("VAL_")) return fastValueLine(lex);
+        return false;
+    case 'C':
+        if (lex.keyword("CM_")) return fastCommentLine(lex);
+        return false;
+    }
+    return false;
+}
+
+//BO_ 1234 Name: 8 Node
+bool DBCFile::fastMessageLine(DBCLineLexer &lex, DBC_MESSAGE *&msg)
+{
+    QByteArray id, len;
+    QString name, sender;
+    if (!lex.run(DBCLineLexer::isWord, id) || !lex.space() || !lex.name(name)) return false;
+    lex.skipSpace();
+    if (!lex.expect(':') || !lex.space() || !lex.run(DBCLineLexer::isWord, len) || !lex.space() || !lex.name(sender)) return false;
+    msg = addParsedMessage(id.toULong(), name, len.toUInt(), sender);
+    return true;
+}
+
+//SG_ Name [M|m2|m2M] : 0|8@1+ (1,0) [0|255] "unit" Receiver,Receiver
+bool DBCFile::fastSignalLine(DBCLineLexer &lex, DBC_MESSAGE *msg, bool &added)
+{
+    DBC_SIGNAL sig;
+    bool isMessageMultiplexor = false;
+    sig.multiplexLowValue = 0;
+    sig.multiplexHighValue = 0;
+    sig.isMultiplexed = false;
+    sig.isMultiplexor = false;
+
+    if (!lex.name(sig.name)) return false;
+    bool spaced = lex.space();
+    if (lex.peek() != ':')
+    {
+        if (!spaced) return false;
+        if (lex.expect('M'))
+        {
+            isMessageMultiplexor = true;
+            sig.isMultiplexor = true;
+        }
+        else if (lex.expect('m'))
+        {
+            if (!lex.integer(sig.multiplexLowValue)) return false;
+            sig.multiplexHighValue = sig.multiplexLowValue;
+            sig.isMultiplexed = true;
+            if (lex.expect('M')) sig.isMultiplexor = true; //extended multiplexing, switches more signals further down
+        }
+        else return false;
+        lex.skipSpace();
+    }
+    if (!lex.expect(':')) return false;
+    lex.skipSpace();
+
+    int valueType;
+    if (!lex.integer(sig.startBit) || !lex.expect('|') || !lex.integer(sig.signalSize) || !lex.expect('@')
+        || !lex.integer(valueType)) return false;
+    char sign = lex.peek();
+    if (sign != '+' && sign != '-' && sign != '|') return false;
+    lex.expect(sign);
+
+    if (!lex.space() || !lex.expect('(') || !lex.number(sig.factor) || !lex.expect(',') || !lex.number(sig.bias)
+        || !lex.expect(')')) return false;
+    if (!lex.space() || !lex.expect('[') || !lex.number(sig.min) || !lex.expect('|') || !lex.number(sig.max)
+        || !lex.expect(']')) return false;
+    if (!lex.space() || !lex.expect('"') || !lex.quoted(sig.unitName) || !lex.space() || lex.atEnd()) return false;
+
+    //the regex takes the unit up to the last quote on the line. Don't guess if there are more
+    if (memchr(lex.pos(), '"', static_cast<size_t>(lex.lineEnd() - lex.pos()))) return false;
+    QString receivers = DBCLineLexer::text(lex.pos(), lex.lineEnd());
+
+    added = addParsedSignal(sig, valueType, sign == '+', receivers, msg, isMessageMultiplexor) != nullptr;
+    return true;
+}
+
+//SG_MUL_VAL_ 2024 S1_PID_0D_VehicleSpeed S1 13-13;
+bool DBCFile::fastMultiplexValueLine(DBCLineLexer &lex, bool &added)
+{
+    QByteArray id;
+    QString sigName, parentName;
+    int low, high;
+    if (!lex.run(DBCLineLexer::isDigit, id) || !lex.space() || !lex.name(sigName) || !lex.space()
+        || !lex.name(parentName) || !lex.space() || !lex.integer(low) || !lex.expect('-') || !lex.integer(high)
+        || !lex.expect(';')) return false;
+    added = addMultiplexValue(id.toULong(), sigName, parentName, low, high);
+    return true;
+}
+
+//VAL_ 1090 VCUPresentParkLightOC 1 "Error present" 0 "Error not present" ;
+bool DBCFile::fastValueLine(DBCLineLexer &lex)
+{
+    QByteArray id;
+    QString sigName;
+    if (!lex.run(DBCLineLexer::isWord, id) || !lex.space() || !lex.name(sigName) || !lex.space()) return false;
+
+    QList<DBC_VAL_ENUM_ENTRY> vals;
+    while (lex.peek() != ';')
+    {
+        QByteArray num;
+        DBC_VAL_ENUM_ENTRY val;
+        if (!lex.run(DBCLineLexer::isDigit, num) || !lex.space() || !lex.expect('"') || !lex.quoted(val.descript)) return false;
+        if (!lex.atEnd() && lex.peek() != ';' && !lex.space()) return false;
+        val.value = num.toULong() & 0x1FFFFFFFul;
+        vals.append(val);
+    }
+    lex.expect(';');
+    if (!lex.atEnd()) return false;
+
+    DBC_MESSAGE *msg = messageHandler->findMsgByID(id.toULong() & 0x1FFFFFFFul);
+    if (msg == nullptr) return true;
+    DBC_SIGNAL *sig = msg->sigHandler->findSignalByName(sigName);
+    if (sig != nullptr) sig->valList.append(vals);
+    return true;
+}
+
+//CM_ BO_ 1234 "comment"; and CM_ SG_ 1234 Signal "comment";
+bool DBCFile::fastCommentLine(DBCLineLexer &lex)
+{
+    bool isSignal;
+    if (lex.keyword("SG_")) isSignal = true;
+    else if (lex.keyword("BO_")) isSignal = false;
+    else return false;
+
+    QByteArray id;
+    QString sigName;
+    if (!lex.run(DBCLineLexer::isWord, id)) return false;
+    lex.skipSpace();
+    if (isSignal)
+    {
+        if (!lex.name(sigName)) return false;
+        lex.skipSpace();
+    }
+    if (!lex.expect('"')) return false;
+
+    //the comment runs to the last "; on the line, it can have quotes of its own
+    const char *close = nullptr;
+    for (const char *c = lex.lineEnd() - 1; c > lex.pos(); c--)
+    {
+        if (c[0] == ';' && c[-1] == '"')
+        {
+            close = c - 1;
+            break;
+        }
+    }
+    if (!close) return false;
+
+    DBC_MESSAGE *msg = messageHandler->findMsgByID(id.toUInt());
+    if (msg == nullptr) return true;
+    if (!isSignal)
+    {
+        msg->comment = DBCLineLexer::text(lex.pos(), close);
+        return true;
+    }
+    DBC_SIGNAL *sig = msg->sigHandler->findSignalByName(sigName);
+    if (sig != nullptr) sig->comment = DBCLineLexer::text(lex.pos(), close);
+    return true;
+}
+
+//BA_ "GenMsgCycleTime" BO_ 101 100; and the SG_ and BU_ versions. Anything else (file wide values) is ignored
+bool DBCFile::fastAttributeLine(DBCLineLexer &lex)
+{
+    QString attrName;
+    lex.skip('"');
+    if (!lex.name(attrName)) return false;
+    lex.skip('"');
+    if (!lex.space()) return false;
+
+    QByteArray id, value;
+    QString ownerName;
+    if (lex.keyword("BO_"))
+    {
+        if (!lex.run(DBCLineLexer::isDigit, id) || !lex.space()) return false;
+        lex.skip('"');
+        if (!lex.run(DBCLineLexer::isAttrValue, value)) return false;
+        setMessageAttribute(attrName, id.toUInt(), QString::fromLatin1(value));
+    }
+    else if (lex.keyword("SG_"))
+    {
+        if (!lex.run(DBCLineLexer::isDigit, id) || !lex.space()) return false;
+        lex.skip('"');
+        if (!lex.name(ownerName)) return false;
+        lex.skip('"');
+        if (!lex.space()) return false;
+        lex.skip('"');
+        if (!lex.run(DBCLineLexer::isAttrValue, value)) return false;
+        setSignalAttribute(attrName, id.toUInt(), ownerName, QString::fromLatin1(value));
+    }
+    else if (lex.keyword("BU_"))
+    {
+        lex.skip('"');
+        if (!lex.name(ownerName)) return false;
+        lex.skip('"');
+        if (!lex.space()) return false;
+        lex.skip('"');
+        if (!lex.run(DBCLineLexer::isAttrValue, value)) return false;
+        setNodeAttribute(attrName, ownerName, QString::fromLatin1(value));
+    }
+    return true;
+}
+
+//parseFile, telling the user about any faulty entries straight away. Only for the GUI thread
 bool DBCFile::loadFile(QString fileName)
 {
+    QString faults;
+    if (!parseFile(fileName, faults)) return false;
+    if (!faults.isEmpty()) DBCHandler::showLoadFaults(faults);
+    return true;
+}
+
+/*
+ * Reads a DBC file into this one. Safe to run on a worker thread as long as nobody else looks at this DBCFile
+ * until it's done. If some entries couldn't be read faultReport says so, ready to show to the user.
+ */
+bool DBCFile::parseFile(QString fileName, QString &faultReport)
+{
+    bool onGuiThread = QThread::currentThread() == qApp->thread();
     QFile *inFile = new QFile(fileName);
-    QString line, rawLine;
+    QString line;
     QRegularExpression regex;
     QRegularExpressionMatch match;
     DBC_MESSAGE *currentMessage = nullptr;
@@ -922,13 +1574,27 @@ bool DBCFile::loadFile(QString fileName)
 
     qDebug() << "DBC File: " << fileName;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
+    if (!inFile->open(QIODevice::ReadOnly))
     {
         delete inFile;
         qDebug() << "Could not load the file!";
         return false;
     }
 
+    //lines are read in place out of the mapped file. Only the ones parseLineFast can't do become a QString
+    QByteArray contents;
+    qint64 fileSize = inFile->size();
+    const char *data = nullptr;
+    uchar *mapped = (fileSize > 0) ? inFile->map(0, fileSize) : nullptr;
+    if (mapped) data = reinterpret_cast<const char *>(mapped);
+    else
+    {
+        contents = inFile->readAll();
+        data = contents.constData();
+        fileSize = contents.size();
+    }
+    const char *dataEnd = data + fileSize;
+
     qDebug() << "Starting DBC load";
     dbc_nodes.clear();
     messageHandler->removeAllMessages();
@@ -940,30 +1606,37 @@ bool DBCFile::loadFile(QString fileName)
     falseNode.comment = "Default node if none specified";
     dbc_nodes.append(falseNode);
 
-    while (!inFile->atEnd()) {
-        rawLine = QString(inFile->readLine());
-        line = rawLine.simplified();
+    for (const char *lineStart = data; lineStart < dataEnd; )
+    {
+        const char *lineEnd = static_cast<const char *>(memchr(lineStart, '\n', static_cast<size_t>(dataEnd - lineStart)));
+        if (!lineEnd) lineEnd = dataEnd;
+        const char *rawLine = lineStart;
+        int rawLength = static_cast<int>(lineEnd - lineStart);
+        lineStart = (lineEnd < dataEnd) ? lineEnd + 1 : dataEnd;
 
         linesSinceYield++;
-        if (linesSinceYield > 100)
+        if (linesSinceYield > 100 && onGuiThread)
         {
+            linesSinceYield = 0;
             qApp->processEvents();
         }
 
         if (inMultilineBU)
         {
-            if (rawLine.startsWith("\t") || rawLine.startsWith("   "))
+            if ((rawLength >= 1 && rawLine[0] == '\t') || (rawLength >= 3 && !memcmp(rawLine, "   ", 3)))
             {
                 DBC_NODE node;
                 node.sourceFileName = fileBaseName;
-                node.name = line;
+                node.name = QString::fromUtf8(rawLine, rawLength).simplified();
                 dbc_nodes.append(node);
             }
             else inMultilineBU = false;
         }
 
-        if (!inMultilineBU)
+        if (!inMultilineBU && !parseLineFast(rawLine, rawLine + rawLength, currentMessage, numSigFaults))
         {
+            line = QString::fromUtf8(rawLine, rawLength).simplified();
+
             if (line.startsWith("BO_ ")) //defines a message
             {
                 currentMessage = parseMessageLine(line);
@@ -1210,18 +1883,18 @@ bool DBCFile::loadFile(QString fileName)
                 sig->isMultiplexed = false; //can't multiplex if there is no multiplexor!
             }
         }
+        //ready before anything decodes with them. Has to wait until the mux tree above is complete
+        for (int y = 0; y < msg->sigHandler->getCount(); y++) msg->sigHandler->findSignalByIdx(y)->prepare();
     }
 
+    faultReport.clear();
     if (numSigFaults > 0 || numMsgFaults > 0)
     {
-        QMessageBox msgBox;
-        QString msg = "DBC file loaded with errors!\n";
-        msg += "Number of faulty message entries: " + QString::number(numMsgFaults) + "\n";
-        msg += "Number of faulty signal entries: " + QString::number(numSigFaults) + "\n\n";
-        msg += "Faulty entries have not been loaded.\n\n";
-        msg += "All other entries are, however, loaded.";
-        msgBox.setText(msg);
-        msgBox.exec();
+        faultReport = "DBC file loaded with errors!\n";
+        faultReport += "Number of faulty message entries: " + QString::number(numMsgFaults) + "\n";
+        faultReport += "Number of faulty signal entries: " + QString::number(numSigFaults) + "\n\n";
+        faultReport += "Faulty entries have not been loaded.\n\n";
+        faultReport += "All other entries are, however, loaded.";
     }
     inFile->close();
     delete inFile;
@@ -1230,6 +1903,9 @@ bool DBCFile::loadFile(QString fileName)
     filePath = fileName.left(fileName.length() - this->fileName.length());
     assocBuses = -1;
     isDirty = false;
+    //anything the parse changed in place after adding it, like a message's ID, is in the lookups from here on
+    messageHandler->rebuildIndex();
+    for (int i = 0; i < messageHandler->getCount(); i++) messageHandler->findMsgByIdx(i)->sigHandler->rebuildIndex();
     return true;
 }
 
@@ -1690,6 +2366,7 @@ bool DBCFile::saveFile(QString fileName)
 
     outFile->close();
     delete outFile;
+    DBCCache::invalidate(fileName);
 
     isDirty = false;
 
@@ -1726,6 +2403,7 @@ void DBCHandler::saveDBCFile(int idx)
         if (!filename.contains('.')) filename += ".dbc";
         loadedFiles[idx].saveFile(filename);
         settings.setValue("DBC/LoadSaveDirectory", dialog.directory().path());
+        watchFiles();
     }
 }
 
@@ -1780,15 +2458,25 @@ int DBCHandler::createBlankFile()
     newFile.setAssocBus(-1);
 
     loadedFiles.append(newFile);
+    touch();
     return loadedFiles.count();
 }
 
-DBCFile* DBCHandler::loadDBCFile(QString filename)
+DBCFile* DBCHandler::loadDBCFile(QString filename, QString *faults)
 {
     DBCFile newFile;
-    if (newFile.loadFile(filename))
+    //big DBCs take seconds to parse. What came out of the last parse is kept and reused until the file changes
+    bool loaded = DBCCache::load(filename, newFile);
+    if (!loaded)
+    {
+        loaded = faults ? newFile.parseFile(filename, *faults) : newFile.loadFile(filename);
+        if (loaded) DBCCache::save(filename, newFile);
+    }
+    if (loaded)
     {
         loadedFiles.append(newFile);
+        touch();
+        watchFiles();
     }
     else
     {
@@ -1798,6 +2486,16 @@ DBCFile* DBCHandler::loadDBCFile(QString filename)
     else return nullptr;
 }
 
+DBCFile* DBCHandler::restoreDBCFile(const QString &filename, const QByteArray &compiled)
+{
+    DBCFile newFile;
+    if (compiled.isEmpty() || !DBCCache::restore(compiled, filename, newFile)) return loadDBCFile(filename);
+    loadedFiles.append(newFile);
+    touch();
+    watchFiles();
+    return &loadedFiles.last();
+}
+
 //the only reason to even bother sending the index is to see if
 //the user wants to replace an already loaded DBC.
 //Otherwise add a new one. Well, always add a new one.
@@ -2179,11 +2877,15 @@ void DBCHandler::removeDBCFile(int idx)
     if (idx < 0) return;
     if (idx >= loadedFiles.count()) return;
     loadedFiles.removeAt(idx);
+    touch();
+    watchFiles();
 }
 
 void DBCHandler::removeAllFiles()
 {
     loadedFiles.clear();
+    touch();
+    watchFiles();
 }
 
 void DBCHandler::swapFiles(int pos1, int pos2)
@@ -2195,6 +2897,7 @@ void DBCHandler::swapFiles(int pos1, int pos2)
     if (pos2 >= loadedFiles.count()) return;
 
     loadedFiles.swapItemsAt(pos1, pos2);
+    touch(); //earlier files win when more than one matches
 }
 
 /*
@@ -2205,28 +2908,77 @@ void DBCHandler::swapFiles(int pos1, int pos2)
 */
 DBC_MESSAGE* DBCHandler::findMessage(const CANFrame &frame)
 {
-    for(int i = 0; i < loadedFiles.count(); i++)
+    return lookupMessage(frame.frameId(), frame.bus, false);
+}
+
+DBC_MESSAGE* DBCHandler::findMessage(uint32_t id)
+{
+    return lookupMessage(id, -1, true);
+}
+
+DBC_MESSAGE* DBCHandler::findMessage(uint32_t id, int bus)
+{
+    return lookupMessage(id, bus, false);
+}
+
+/*
+ * Earlier files win, same as going through them in order. The exact index gives the first exact matching file that
+ * has the ID; only masked files ahead of that one can still beat it. Nothing is written here so the sender, script
+ * and batch job threads can look messages up alongside the GUI.
+ */
+DBC_MESSAGE* DBCHandler::lookupMessage(uint32_t id, int bus, bool anyBus)
+{
+    QSharedPointer<const MessageIndex> index;
     {
-        if (loadedFiles[i].getAssocBus() == -1 || frame.bus == loadedFiles[i].getAssocBus())
-        {
-            DBC_MESSAGE* msg = loadedFiles[i].messageHandler->findMsgByID(frame.frameId());
-            if (msg != nullptr) return msg;
-        }
+        QMutexLocker locker(&messageIndexLock);
+        index = messageIndex;
     }
-    return nullptr;
+    if (!index) return nullptr;
+
+    MessageIndex::Entry best = {INT_MAX, nullptr};
+    QHash<quint64, MessageIndex::Entry>::const_iterator it = index->exact.constFind(messageKey(id, bus, anyBus));
+    if (it != index->exact.constEnd()) best = it.value();
+    if (!anyBus && bus != -1)
+    {
+        it = index->exact.constFind(messageKey(id, -1, false));
+        if (it != index->exact.constEnd() && it.value().file < best.file) best = it.value();
+    }
+
+    for (const MessageIndex::MaskedFile &masked : index->masked)
+    {
+        if (masked.file >= best.file) break;
+        if (!anyBus && masked.bus != -1 && masked.bus != bus) continue;
+        DBC_MESSAGE *msg = masked.handler->findMsgByID(id);
+        if (msg) return msg;
+    }
+    return best.msg;
 }
 
-DBC_MESSAGE* DBCHandler::findMessage(uint32_t id)
+void DBCHandler::rebuildMessageIndex()
 {
-    for(int i = 0; i < loadedFiles.count(); i++)
+    QSharedPointer<MessageIndex> index(new MessageIndex);
+    index->sets = sharedMessageSets();
+    for (int f = 0; f < loadedFiles.count(); f++)
     {
-        DBC_MESSAGE* msg = loadedFiles[i].messageHandler->findMsgByID(id);
-        if (msg != nullptr)
+        DBCMessageHandler *handler = loadedFiles[f].messageHandler;
+        const int bus = loadedFiles[f].getAssocBus();
+        if (handler->getMatchingCriteria() != EXACT)
+        {
+            index->masked.append({f, bus, handler});
+            continue;
+        }
+        for (int m = 0; m < handler->getCount(); m++)
         {
-            return msg;
+            DBC_MESSAGE *msg = handler->findMsgByIdx(m);
+            const MessageIndex::Entry entry = {f, msg};
+            //files are gone through in order so whatever is there already came from an earlier file
+            if (!index->exact.contains(messageKey(msg->ID, bus, false))) index->exact.insert(messageKey(msg->ID, bus, false), entry);
+            if (!index->exact.contains(messageKey(msg->ID, -1, true))) index->exact.insert(messageKey(msg->ID, -1, true), entry);
         }
     }
-    return nullptr;
+
+    QMutexLocker locker(&messageIndexLock);
+    messageIndex = index;
 }
 
 // This function won't care which bus the DBC file is associated, but will return any message as long as ID matches and the file
@@ -2310,6 +3062,14 @@ int DBCHandler::getFileCount()
     return loadedFiles.count();
 }
 
+QVector<QSharedPointer<DBCMessageHandler>> DBCHandler::sharedMessageSets()
+{
+    QVector<QSharedPointer<DBCMessageHandler>> sets;
+    sets.reserve(loadedFiles.count());
+    for (const DBCFile &file : loadedFiles) sets.append(file.sharedMessageHandler());
+    return sets;
+}
+
 DBCFile* DBCHandler::getFileByIdx(int idx)
 {
     if (loadedFiles.count() == 0) return nullptr;
@@ -2333,6 +3093,14 @@ DBCFile* DBCHandler::getFileByName(QString name)
 
 DBCHandler::DBCHandler()
 {
+    //one loader thread so the files end up in the same order as before. Each one goes live as soon as it's parsed
+    loader.setMaxThreadCount(1);
+
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(500);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &DBCHandler::fileChanged);
+    connect(&reloadTimer, &QTimer::timeout, this, &DBCHandler::reloadPending);
+
     // Load previously saved DBC file settings
     QSettings settings;
     qDebug() <<"Settings file: " << settings.fileName();
@@ -2340,42 +3108,222 @@ DBCHandler::DBCHandler()
     qDebug() << "Previously loaded DBC file count: " << filecount;
     for (int i=0; i<filecount; i++)
     {
+        SavedFileSettings saved;
         QString filename = settings.value("DBC/Filename_" + QString::number(i),"").toString();
-        DBCFile * file = loadDBCFile(filename);
-        if (file)
+        saved.bus = settings.value("DBC/AssocBus_" + QString::number(i),0).toInt();
+        saved.matchingCriteria = (MatchingCriteria_t)settings.value("DBC/MatchingCriteria_" + QString::number(i),0).toInt();
+        saved.filterLabeling = settings.value("DBC/FilterLabeling_" + QString::number(i),0).toInt();
+        loadInBackground(filename, saved);
+    }
+}
+
+DBCHandler::~DBCHandler()
+{
+    //a file still being parsed would post itself back to a handler that's gone
+    loader.clear();
+    loader.waitForDone();
+}
+
+void DBCHandler::reportMemory(QVector<MemoryUsage> &out) const
+{
+    for (const DBCFile &file : loadedFiles) file.reportMemory(out, "DBC files");
+}
+
+void DBCHandler::showLoadFaults(const QString &faults)
+{
+    QMessageBox msgBox;
+    msgBox.setText(faults);
+    msgBox.exec();
+}
+
+/*
+ * Parse (or pull out of the cache) on the loader thread. The finished DBCFile is handed back to the GUI thread and
+ * added there in one go so nothing ever sees a half loaded file. Capture and everything else keep running meanwhile.
+ */
+void DBCHandler::loadInBackground(const QString &filename, const SavedFileSettings &saved)
+{
+    loader.start(new DBCLoadTask([this, filename, saved]()
+    {
+        QString faults;
+        DBCFile *file = readDBC(filename, faults);
+        QMetaObject::invokeMethod(this, [this, file, filename, saved, faults]()
         {
-            int bus = settings.value("DBC/AssocBus_" + QString::number(i),0).toInt();
-            file->setAssocBus(bus);
+            publishFile(file, filename, saved, faults);
+        }, Qt::QueuedConnection);
+    }));
+}
 
-            MatchingCriteria_t matchingCriteria = (MatchingCriteria_t)settings.value("DBC/MatchingCriteria_" + QString::number(i),0).toInt();
+void DBCHandler::publishFile(DBCFile *loaded, const QString &filename, const SavedFileSettings &saved, const QString &faults)
+{
+    if (!loaded)
+    {
+        qInfo() << "Could not load DBC file" << filename;
+        return;
+    }
+    loadedFiles.append(*loaded);
+    delete loaded;
+    DBCFile *file = &loadedFiles.last();
 
-            DBC_ATTRIBUTE attr;
+    file->setAssocBus(saved.bus);
 
-            attr.attrType = ATTR_TYPE_MESSAGE;
-            attr.defaultValue = matchingCriteria;
-            attr.enumVals.clear();
-            attr.lower = 0;
-            attr.upper = 0;
-            attr.name = "matchingcriteria";
-            attr.valType = ATTR_INT;
-            file->dbc_attributes.append(attr);
-            file->messageHandler->setMatchingCriteria(matchingCriteria);
+    DBC_ATTRIBUTE attr;
 
-            int filterLabeling = settings.value("DBC/FilterLabeling_" + QString::number(i),0).toInt();
-            attr.attrType = ATTR_TYPE_MESSAGE;
-            attr.defaultValue = filterLabeling;
-            attr.enumVals.clear();
-            attr.lower = 0;
-            attr.upper = 0;
-            attr.name = "filterlabeling";
-            attr.valType = ATTR_INT;
-            file->dbc_attributes.append(attr);
-            file->messageHandler->setFilterLabeling(filterLabeling);
+    attr.attrType = ATTR_TYPE_MESSAGE;
+    attr.defaultValue = saved.matchingCriteria;
+    attr.enumVals.clear();
+    attr.lower = 0;
+    attr.upper = 0;
+    attr.name = "matchingcriteria";
+    attr.valType = ATTR_INT;
+    file->dbc_attributes.append(attr);
+    file->messageHandler->setMatchingCriteria(saved.matchingCriteria);
+
+    attr.attrType = ATTR_TYPE_MESSAGE;
+    attr.defaultValue = saved.filterLabeling;
+    attr.enumVals.clear();
+    attr.lower = 0;
+    attr.upper = 0;
+    attr.name = "filterlabeling";
+    attr.valType = ATTR_INT;
+    file->dbc_attributes.append(attr);
+    file->messageHandler->setFilterLabeling(saved.filterLabeling);
 
-            qInfo() << "Loaded DBC file" << filename << " (bus:" << bus
-                << ", Matching Criteria:" << (int)matchingCriteria << "Filter labeling: " << (filterLabeling?"enabled":"disabled") << ")";
+    qInfo() << "Loaded DBC file" << filename << " (bus:" << saved.bus
+        << ", Matching Criteria:" << (int)saved.matchingCriteria << "Filter labeling: " << (saved.filterLabeling?"enabled":"disabled") << ")";
+
+    touch();
+    watchFiles();
+    emit fileLoaded(file);
+    if (!faults.isEmpty()) showLoadFaults(faults);
+}
+
+void DBCHandler::watchFiles()
+{
+    QStringList paths;
+    for (int i = 0; i < loadedFiles.count(); i++)
+    {
+        QString path = loadedFiles[i].getFullFilename();
+        if (QFileInfo::exists(path)) paths.append(path);
+    }
+    //files saved by writing a new one and renaming it over the old drop out of the watcher on their own
+    QStringList watched = watcher.files();
+    for (const QString &path : watched) if (!paths.contains(path)) watcher.removePath(path);
+    for (const QString &path : paths) if (!watched.contains(path)) watcher.addPath(path);
+}
+
+void DBCHandler::fileChanged(const QString &path)
+{
+    QSettings settings;
+    if (!settings.value("DBC/HotReload", true).toBool()) return;
+    pendingReloads.insert(path);
+    reloadTimer.start();
+}
+
+void DBCHandler::reloadPending()
+{
+    QSet<QString> paths = pendingReloads;
+    pendingReloads.clear();
+    watchFiles();
+    for (const QString &path : paths)
+    {
+        if (!QFileInfo::exists(path)) continue; //deleted, or renamed away and not back yet. What's loaded stays
+        loader.start(new DBCLoadTask([this, path]()
+        {
+            QString faults;
+            DBCFile *reparsed;
+            {
+                QuietTouches quiet;
+                reparsed = readDBC(path, faults);
+            }
+            //a file caught half written reads with faults. Keep what's loaded, finishing the write is another change
+            if (reparsed && !faults.isEmpty())
+            {
+                qInfo() << "Not reloading DBC file" << path << "as it has faults now";
+                delete reparsed;
+                reparsed = nullptr;
+            }
+            if (!reparsed) return;
+            QMetaObject::invokeMethod(this, [this, reparsed, path]()
+            {
+                applyReload(reparsed, path);
+            }, Qt::QueuedConnection);
+        }));
+    }
+}
+
+/*
+ * Messages and signals get handed around as raw pointers (the lookup index, decoded text, filters, graphs) so the
+ * changed ones can't be patched in place. The whole message set is swapped for the reparsed one in a single
+ * assignment on the GUI thread instead, and only if the comparator finds something different. The revision bump
+ * names the IDs that changed so the frame view can keep the text it already made for all the others.
+ *
+ * The gateway, frame sender, scripts, searches and queries hold pointers on their own threads and only notice by
+ * the revision. So it moves before the swap, for them to stop trusting what they compiled, and again after, so
+ * nothing compiled in between against the old set counts as current. Each of them also holds the message sets it
+ * compiled against (sharedMessageSets, DBCFile::sharedMessageHandler), so the old set goes with the last of them.
+ */
+void DBCHandler::applyReload(DBCFile *reparsed, const QString &path)
+{
+    int idx = -1;
+    for (int i = 0; i < loadedFiles.count(); i++)
+    {
+        if (loadedFiles[i].getFullFilename() == path)
+        {
+            idx = i;
+            break;
         }
     }
+    //removed meanwhile, or edited here and not saved yet. Edits made here win over the file on disk
+    if (idx < 0 || loadedFiles[idx].getDirtyFlag())
+    {
+        delete reparsed;
+        return;
+    }
+    DBCFile &file = loadedFiles[idx];
+
+    DBCDiff diff;
+    diff.compare(&file, reparsed);
+    if (diff.messages.isEmpty() && diff.nodesOnlyFirst.isEmpty() && diff.nodesOnlySecond.isEmpty())
+    {
+        delete reparsed; //written but not changed, saving it from here looks like this too
+        return;
+    }
+
+    QSet<uint32_t> ids;
+    for (const DBCMessageChange &change : diff.messages)
+    {
+        ids.insert(change.ID);
+        //matched up by name, so the ID itself may be what changed
+        if (change.inFirst && change.inSecond)
+        {
+            DBC_MESSAGE *msg = reparsed->messageHandler->findMsgByName(change.name);
+            if (msg) ids.insert(msg->ID);
+        }
+    }
+
+    //what the user set for the file stays, whatever the file itself says
+    MatchingCriteria_t criteria = file.messageHandler->getMatchingCriteria();
+    //exact matching is the only kind where a message decodes nothing but its own ID
+    auto bump = [&ids, criteria]()
+    {
+        if (criteria == EXACT) touchIds(ids);
+        else touch();
+    };
+
+    bump();
+    {
+        QuietTouches quiet;
+        int bus = file.getAssocBus();
+        bool labeling = file.messageHandler->filterLabeling();
+        file = *reparsed;
+        file.setAssocBus(bus);
+        file.messageHandler->setMatchingCriteria(criteria);
+        file.messageHandler->setFilterLabeling(labeling);
+    }
+    delete reparsed;
+    bump();
+    qInfo() << "Reloaded DBC file" << path << "," << diff.messages.count() << "messages changed";
+    emit fileReloaded(&file, ids);
 }
 
 DBCHandler* DBCHandler::getReference()
@@ -2383,3 +3331,42 @@ DBCHandler* DBCHandler::getReference()
     if (!instance) instance = new DBCHandler();
     return instance;
 }
+
+quint32 DBCHandler::getRevision()
+{
+    return dbcRevision;
+}
+
+void DBCHandler::touch()
+{
+    if (quietTouches) return;
+    dbcRevision++;
+    //the loader thread touches files that aren't in the list yet, only the GUI thread changes ones that are
+    if (instance && QThread::currentThread() == instance->thread()) instance->rebuildMessageIndex();
+}
+
+void DBCHandler::touchIds(const QSet<uint32_t> &ids)
+{
+    QMutexLocker locker(&scopedTouchLock);
+    ScopedTouch bump;
+    bump.revision = ++dbcRevision;
+    bump.ids = ids;
+    scopedTouches.append(bump);
+    if (scopedTouches.count() > DBC_SCOPED_TOUCH_MAX) scopedTouches.removeFirst();
+    locker.unlock();
+    if (instance && QThread::currentThread() == instance->thread()) instance->rebuildMessageIndex();
+}
+
+bool DBCHandler::changedSince(quint32 revision, QSet<uint32_t> &ids)
+{
+    QMutexLocker locker(&scopedTouchLock);
+    quint32 current = dbcRevision.loadRelaxed();
+    quint32 found = 0;
+    for (const ScopedTouch &bump : scopedTouches)
+    {
+        if (bump.revision - revision - 1 >= current - revision) continue; //outside (revision, current], wraps fine
+        ids.unite(bump.ids);
+        found++;
+    }
+    return found == current - revision;
+}
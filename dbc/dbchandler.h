@@ -2,8 +2,16 @@
 #define DBCHANDLER_H
 
 #include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
 #include "dbc_classes.h"
 #include "can_structs.h"
+#include "memoryaccounting.h"
 
     typedef enum
     {
@@ -23,16 +31,23 @@ class DBCSignalHandler: public QObject
 public:
     DBC_SIGNAL *findSignalByName(QString name);
     DBC_SIGNAL *findSignalByIdx(int idx);
+    const DBC_SIGNAL *findSignalByIdx(int idx) const; //safe from several threads at once, see DBC_SIGNAL::decodeValue
+    int indexOf(const DBC_SIGNAL *sig) const;
     bool addSignal(DBC_SIGNAL &sig);
     bool removeSignal(DBC_SIGNAL *sig);
     bool removeSignal(int idx);
     bool removeSignal(QString name);
     void removeAllSignals();
-    int getCount();
+    int getCount() const;
     void sort();
+    void rebuildIndex(); //call after renaming a signal from outside so lookups see it
+    static QString internName(const QString &name);
 
 private:
+    void indexSignal(int idx);
+
     QList<DBC_SIGNAL> sigs; //signals is a reserved word or I'd have used that
+    QHash<QString, int> nameIndex; //case folded name -> index into sigs. Kept up by the mutators like the message index
 };
 
 class DBCMessageHandler: public QObject
@@ -56,15 +71,32 @@ public:
     void setFilterLabeling( bool labelFiltering );
     bool filterLabeling();
     void sort();
+    void rebuildIndex(); //call after changing a message ID from outside so lookups see it
 
 private:
+    void indexMessage(int idx);
+
     QList<DBC_MESSAGE> messages;
     MatchingCriteria_t matchingCriteria;
     bool filterLabelingEnabled;
+
+    //ID lookup tables holding indices into messages. Every mutator brings them up to date before it returns (adds
+    //just index the new message) so lookups only ever read them and can run on several threads at once.
+    //The J1939 and GMLAN tables are keyed by the already masked message ID so a lookup is just a mask and a hash.
+    QHash<uint32_t, int> exactIndex;
+    QHash<uint32_t, int> j1939PDU1Index; //ID & 0x3FF0000 (DP, EDP and PF)
+    QHash<uint32_t, int> j1939PDU2Index; //ID & 0x3FFFF00 (DP, EDP, PF and PS)
+    QHash<uint32_t, int> gmlanIndex;     //ID & 0x3FFE000 (arbitration ID)
 };
 
+class DBCLineLexer;
+
 //technically there should be a node handler too but I'm sort of treating nodes as second class
 //citizens since they aren't really all that important (to me anyway)
+//Copies are cheap and share the messages and signals with the original (the message handler is reference counted
+//and freed with the last copy). The node and attribute lists are implicitly shared QLists. Messages and signals
+//point at each other and at the nodes so a copy that really owned its own messages would need all of those
+//pointers rewired. Nothing needs that, copies only ever move a file into the loaded list.
 class DBCFile: public QObject
 {
     Q_OBJECT
@@ -80,6 +112,7 @@ public:
     void findAttributesByType(DBC_ATTRIBUTE_TYPE typ, QList<DBC_ATTRIBUTE> *list);
     bool saveFile(QString);
     bool loadFile(QString);
+    bool parseFile(QString fileName, QString &faultReport);
     QString getFullFilename();
     QString getFilename();
     QString getFilenameNoExt();
@@ -90,11 +123,22 @@ public:
     bool getDirtyFlag();
     void clearDirtyFlag();
     void sort();
+    //what the messages, signals, nodes and attributes take up, as entries for the memory usage dialog
+    void reportMemory(QVector<MemoryUsage> &out, const QString &owner) const;
+    //a string attribute of one message, for the RE tools to leave what they found in. The attribute gets defined
+    //and a bare message of len bytes made first if the file doesn't have them. Returns the message
+    DBC_MESSAGE *setMessageString(uint32_t ID, unsigned int len, const QString &attrName, const QString &value);
+    //for holding on to messages from another thread past a reload of the file, which swaps in a new set
+    QSharedPointer<DBCMessageHandler> sharedMessageHandler() const;
 
-    DBCMessageHandler *messageHandler;
+    DBCMessageHandler *messageHandler; //always sharedMessages.data()
     QList<DBC_NODE> dbc_nodes;
     QList<DBC_ATTRIBUTE> dbc_attributes;
 private:
+    friend class DBCCache;
+
+    QSharedPointer<DBCMessageHandler> sharedMessages;
+
     QString fileName;
     QString filePath;
     int assocBuses; //-1 = all buses, 0 = first bus, 1 = second bus, etc.
@@ -109,13 +153,33 @@ private:
     bool parseSignalValueTypeLine(QString line);
     bool parseAttributeLine(QString line);
     bool parseDefaultAttrLine(QString line);
+
+    //single pass parser for the common lines, the regex parsers above are the fallback
+    bool parseLineFast(const char *begin, const char *end, DBC_MESSAGE *&currentMessage, int &numSigFaults);
+    bool fastMessageLine(DBCLineLexer &lex, DBC_MESSAGE *&msg);
+    bool fastSignalLine(DBCLineLexer &lex, DBC_MESSAGE *msg, bool &added);
+    bool fastMultiplexValueLine(DBCLineLexer &lex, bool &added);
+    bool fastValueLine(DBCLineLexer &lex);
+    bool fastCommentLine(DBCLineLexer &lex);
+    bool fastAttributeLine(DBCLineLexer &lex);
+
+    //where both parsers put what they read
+    DBC_MESSAGE* addParsedMessage(uint32_t ID, const QString &name, unsigned int len, const QString &senderName);
+    DBC_SIGNAL* addParsedSignal(DBC_SIGNAL &sig, int valueType, bool unsignedInt, const QString &receivers, DBC_MESSAGE *msg, bool isMessageMultiplexor);
+    bool addMultiplexValue(uint32_t ID, const QString &sigName, const QString &parentName, int low, int high);
+    bool setMessageAttribute(const QString &attrName, uint32_t ID, const QString &value);
+    bool setSignalAttribute(const QString &attrName, uint32_t ID, const QString &sigName, const QString &value);
+    bool setNodeAttribute(const QString &attrName, const QString &nodeName, const QString &value);
 };
 
-class DBCHandler: public QObject
+class DBCHandler: public QObject, public MemoryReporter
 {
     Q_OBJECT
 public:
-    DBCFile* loadDBCFile(QString filename);
+    //faults, if given, gets what couldn't be read instead of it being shown to the user
+    DBCFile* loadDBCFile(QString filename, QString *faults = nullptr);
+    //from what DBCCache::compile made of it, loadDBCFile if that can't be used
+    DBCFile* restoreDBCFile(const QString &filename, const QByteArray &compiled);
     DBCFile* loadDBCFile(int);
     void saveDBCFile(int);
     void removeDBCFile(int);
@@ -126,17 +190,87 @@ public:
     DBC_MESSAGE* findMessage(const QString msgName, const QString fullyQualifiedNodeName);
     DBC_MESSAGE* findMessage(const QString msgName, const QString nodeName, const QString fileNameNoExt);
     DBC_MESSAGE* findMessage(uint32_t id);
+    DBC_MESSAGE* findMessage(uint32_t id, int bus); //as findMessage(frame) would for a frame of that ID on that bus
     DBC_MESSAGE* findMessageForFilter(uint32_t id, MatchingCriteria_t * matchingCriteria);
     int getFileCount();
     DBCFile* getFileByIdx(int idx);
+    //the message set of every loaded file. What compiles signal pointers for another thread holds on to these so a
+    //reload or removal can't free what it points into, see applyReload
+    QVector<QSharedPointer<DBCMessageHandler>> sharedMessageSets();
     DBCFile* getFileByName(QString name);
     int createBlankFile();
     DBCFile* loadJSONFile(QString);
     DBCFile* loadSecretCSVFile(QString);
     static DBCHandler *getReference();
+    //bumped whenever anything that could change how a frame decodes changes. Lets caches of decoded text notice
+    static quint32 getRevision();
+    static void touch();
+    //a bump that only changed how these IDs decode, for caches that can afford to keep everything else
+    static void touchIds(const QSet<uint32_t> &ids);
+    //true if every bump after revision came from touchIds, with ids getting all the IDs they named
+    static bool changedSince(quint32 revision, QSet<uint32_t> &ids);
+    static void showLoadFaults(const QString &faults);
+    ~DBCHandler();
+
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+
+signals:
+    //a file the previous session had loaded has been parsed in the background and is now in the list
+    void fileLoaded(DBCFile *file);
+    //a loaded file changed on disk and its new contents have been swapped in. ids are the messages that differ
+    void fileReloaded(DBCFile *file, const QSet<uint32_t> &ids);
 
 private:
+    //what the previous session had set for a file, applied once it has loaded
+    struct SavedFileSettings
+    {
+        int bus;
+        MatchingCriteria_t matchingCriteria;
+        int filterLabeling;
+    };
+
+    void loadInBackground(const QString &filename, const SavedFileSettings &saved);
+    void publishFile(DBCFile *loaded, const QString &filename, const SavedFileSettings &saved, const QString &faults);
+    //(bus, ID) -> message for every file with exact matching, first file wins. Files with J1939 or GMLAN matching
+    //can't be listed out by ID so those go through their own handlers, in list order, at lookup time
+    struct MessageIndex
+    {
+        struct Entry
+        {
+            int file;
+            DBC_MESSAGE *msg;
+        };
+        struct MaskedFile
+        {
+            int file;
+            int bus;
+            DBCMessageHandler *handler;
+        };
+        QHash<quint64, Entry> exact;
+        QVector<MaskedFile> masked;
+        QVector<QSharedPointer<DBCMessageHandler>> sets; //what the entries point into, for as long as a lookup has it
+    };
+
+    DBC_MESSAGE *lookupMessage(uint32_t id, int bus, bool anyBus);
+    void rebuildMessageIndex();
+    void watchFiles();
+    void fileChanged(const QString &path);
+    void reloadPending();
+    void applyReload(DBCFile *reparsed, const QString &path);
+
     QList<DBCFile> loadedFiles;
+    QThreadPool loader;
+
+    //files on disk that change get parsed again on the loader thread and swapped in if their messages differ.
+    //Saves tend to come as several writes (or a delete and rename) so changes are collected for a moment first
+    QFileSystemWatcher watcher;
+    QTimer reloadTimer;
+    QSet<QString> pendingReloads;
+
+    //built on the GUI thread whenever the revision moves, which covers loading, removing, reordering and
+    //reassigning files as well as edits. Lookups from any thread only read it, a rebuild publishes a new one
+    QSharedPointer<const MessageIndex> messageIndex;
+    mutable QMutex messageIndexLock; //just for swapping and copying messageIndex
 
     DBCHandler();
     static DBCHandler *instance;
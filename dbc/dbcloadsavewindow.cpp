@@ -7,7 +7,7 @@
 #include "helpwindow.h"
 #include "connections/canconmanager.h"
 
-DBCLoadSaveWindow::DBCLoadSaveWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+DBCLoadSaveWindow::DBCLoadSaveWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::DBCLoadSaveWindow)
 {
@@ -33,31 +33,10 @@ DBCLoadSaveWindow::DBCLoadSaveWindow(const QVector<CANFrame> *frames, QWidget *p
     // Populate table
     for (int idx=0; idx<dbcHandler->getFileCount(); idx++)
     {
-        DBCFile * file = dbcHandler->getFileByIdx(idx);
-        ui->tableFiles->insertRow(ui->tableFiles->rowCount());
-        ui->tableFiles->setItem(idx, 0, new QTableWidgetItem(file->getFilename()));
-        QString bus = QString::number(file->getAssocBus() );
-        ui->tableFiles->setItem(idx, 1, new QTableWidgetItem(bus));
-
-        QComboBox * mc_item = addMatchingCriteriaCombobox(idx);
-        int mc = (int)file->messageHandler->getMatchingCriteria();
-        mc_item->setCurrentIndex(mc);
-
-        QTableWidgetItem *item = new QTableWidgetItem("");
-        ui->tableFiles->setItem(idx, 3, item);
-        bool filterLabeling = file->messageHandler->filterLabeling();
-        if (filterLabeling)
-        {
-            item->setCheckState(Qt::Checked);
-        }
-        else
-        {
-            item->setCheckState(Qt::Unchecked);
-        }
-
-        qDebug() << "Populate DBC table:" << file->getFullFilename() << " (bus:" << bus << " - Matching Criteria:" << mc 
-            << "Filter labeling: " << (filterLabeling?"enabled":"disabled") << ")";
+        addFileRow(dbcHandler->getFileByIdx(idx));
     }
+    //files from the last session can still be loading, they get a row once they're in
+    connect(dbcHandler, &DBCHandler::fileLoaded, this, &DBCLoadSaveWindow::addFileRow);
 
     connect(ui->btnEdit, &QAbstractButton::clicked, this, &DBCLoadSaveWindow::editFile);
     connect(ui->btnLoad, &QAbstractButton::clicked, this, &DBCLoadSaveWindow::loadFile);
@@ -77,6 +56,37 @@ DBCLoadSaveWindow::DBCLoadSaveWindow(const QVector<CANFrame> *frames, QWidget *p
     installEventFilter(this);
 }
 
+void DBCLoadSaveWindow::addFileRow(DBCFile *file)
+{
+    bool inhibit = inhibitCellProcessing;
+    inhibitCellProcessing = true;
+    int idx = ui->tableFiles->rowCount();
+    ui->tableFiles->insertRow(ui->tableFiles->rowCount());
+    ui->tableFiles->setItem(idx, 0, new QTableWidgetItem(file->getFilename()));
+    QString bus = QString::number(file->getAssocBus() );
+    ui->tableFiles->setItem(idx, 1, new QTableWidgetItem(bus));
+
+    QComboBox * mc_item = addMatchingCriteriaCombobox(idx);
+    int mc = (int)file->messageHandler->getMatchingCriteria();
+    mc_item->setCurrentIndex(mc);
+
+    QTableWidgetItem *item = new QTableWidgetItem("");
+    ui->tableFiles->setItem(idx, 3, item);
+    bool filterLabeling = file->messageHandler->filterLabeling();
+    if (filterLabeling)
+    {
+        item->setCheckState(Qt::Checked);
+    }
+    else
+    {
+        item->setCheckState(Qt::Unchecked);
+    }
+
+    qDebug() << "Populate DBC table:" << file->getFullFilename() << " (bus:" << bus << " - Matching Criteria:" << mc 
+        << "Filter labeling: " << (filterLabeling?"enabled":"disabled") << ")";
+    inhibitCellProcessing = inhibit;
+}
+
 QComboBox * DBCLoadSaveWindow::addMatchingCriteriaCombobox(int row)
 {
     QComboBox *item = new QComboBox();
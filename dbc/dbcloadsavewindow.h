@@ -16,7 +16,7 @@ class DBCLoadSaveWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit DBCLoadSaveWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit DBCLoadSaveWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~DBCLoadSaveWindow();
 
 private slots:
@@ -31,6 +31,7 @@ private slots:
     void cellDoubleClicked(int row, int col);
     void matchingCriteriaChanged(int index);
     void newFile();
+    void addFileRow(DBCFile *file);
 
 signals:
     void updatedDBCSettings();
@@ -39,7 +40,7 @@ private:
     Ui::DBCLoadSaveWindow *ui;
     DBCHandler *dbcHandler;
     DBCFile *currentlyEditingFile;
-    const QVector<CANFrame> *referenceFrames;
+    const CANFrameStore *referenceFrames;
     DBCMainEditor *editorWindow;
     bool inhibitCellProcessing;
 
@@ -7,10 +7,15 @@
 #include <QColorDialog>
 #include <QTableWidgetItem>
 #include <QRandomGenerator>
+#include <QHash>
+#include <QSet>
 #include <qevent.h>
 #include "helpwindow.h"
 
-DBCMainEditor::DBCMainEditor( const QVector<CANFrame> *frames, QWidget *parent) :
+//set on node, message and signal items whose children haven't been created yet, see populateItem
+#define DBC_ITEM_UNPOPULATED    (Qt::UserRole + 1)
+
+DBCMainEditor::DBCMainEditor( const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::DBCMainEditor)
 {
@@ -25,11 +30,13 @@ DBCMainEditor::DBCMainEditor( const QVector<CANFrame> *frames, QWidget *parent)
 
     connect(ui->btnSearch, &QAbstractButton::clicked, this, &DBCMainEditor::handleSearch);
     connect(ui->lineSearch, &QLineEdit::returnPressed, this, &DBCMainEditor::handleSearch);
+    connect(ui->lineSearch, &QLineEdit::textChanged, this, &DBCMainEditor::handleSearchIncremental);
     connect(ui->btnSearchNext, &QAbstractButton::clicked, this, &DBCMainEditor::handleSearchForward);
     connect(ui->btnSearchPrev, &QAbstractButton::clicked, this, &DBCMainEditor::handleSearchBackward);
     connect(ui->treeDBC, &QTreeWidget::doubleClicked, this, &DBCMainEditor::onTreeDoubleClicked);
     connect(ui->treeDBC, &QTreeWidget::customContextMenuRequested, this, &DBCMainEditor::onTreeContextMenu);
     connect(ui->treeDBC, &QTreeWidget::currentItemChanged, this, &DBCMainEditor::currentItemChanged);
+    connect(ui->treeDBC, &QTreeWidget::itemExpanded, this, &DBCMainEditor::populateItem);
     connect(ui->btnDelete, &QAbstractButton::clicked, this, &DBCMainEditor::deleteCurrentTreeItem);
     connect(ui->btnNewNode, &QAbstractButton::clicked, this, QOverload<>::of(&DBCMainEditor::newNode));
     connect(ui->btnNewMessage, &QAbstractButton::clicked, this, &DBCMainEditor::newMessage);
@@ -170,14 +177,80 @@ void DBCMainEditor::onCustomMenuTree(QPoint point)
 
 }
 
+/*
+ * Searches the database itself instead of the tree since most of the tree doesn't exist until it gets expanded.
+ * Matches the same text the tree shows, in roughly tree order. Items for a hit are only created when it is shown.
+ */
 void DBCMainEditor::handleSearch()
 {
-    searchItems = ui->treeDBC->findItems(ui->lineSearch->text(),Qt::MatchContains | Qt::MatchRecursive);
+    QString text = ui->lineSearch->text();
+    searchItems.clear();
+    searchText = text;
+    searchItemPos = 0;
+
+    if (!text.isEmpty())
+    {
+        //one pass to bucket the messages by sender instead of going over all of them for every node
+        QHash<QString, QList<DBC_MESSAGE *>> nodeMessages;
+        for (int x = 0; x < dbcFile->messageHandler->getCount(); x++)
+        {
+            DBC_MESSAGE *msg = dbcFile->messageHandler->findMsgByIdx(x);
+            if (msg->sender) nodeMessages[msg->sender->name].append(msg);
+        }
+
+        for (int n = 0; n < dbcFile->dbc_nodes.count(); n++)
+        {
+            DBC_NODE *node = &dbcFile->dbc_nodes[n];
+            if (createNodeText(node).contains(text, Qt::CaseInsensitive)) searchItems.append({node, nullptr, nullptr});
+            foreach (DBC_MESSAGE *msg, nodeMessages.value(node->name))
+            {
+                if (createMessageText(msg).contains(text, Qt::CaseInsensitive)) searchItems.append({node, msg, nullptr});
+                for (int i = 0; i < msg->sigHandler->getCount(); i++)
+                {
+                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
+                    if (createSignalText(sig).contains(text, Qt::CaseInsensitive)) searchItems.append({node, msg, sig});
+                }
+            }
+        }
+    }
     qDebug() << "Search returned " << searchItems.count() << "items.";
+    showSearchHit();
+}
+
+//search as you type. Adding to the search text can only drop hits so the last results just get narrowed down
+void DBCMainEditor::handleSearchIncremental(const QString &text)
+{
+    if (searchText.isEmpty() || text.isEmpty() || !text.contains(searchText, Qt::CaseInsensitive))
+    {
+        handleSearch();
+        return;
+    }
+
+    QList<SearchHit> narrowed;
+    foreach (const SearchHit &hit, searchItems)
+    {
+        QString hitText;
+        if (hit.sig) hitText = createSignalText(hit.sig);
+        else if (hit.msg) hitText = createMessageText(hit.msg);
+        else hitText = createNodeText(hit.node);
+        if (hitText.contains(text, Qt::CaseInsensitive)) narrowed.append(hit);
+    }
+    searchItems = narrowed;
+    searchText = text;
+    searchItemPos = 0;
+    showSearchHit();
+}
+
+void DBCMainEditor::showSearchHit()
+{
     if (searchItems.count() > 0)
     {
-        ui->treeDBC->setCurrentItem(searchItems[0]);
-        searchItemPos = 0;
+        QTreeWidgetItem *item = itemForHit(searchItems[searchItemPos]);
+        if (item)
+        {
+            ui->treeDBC->setCurrentItem(item);
+            ui->treeDBC->scrollToItem(item);
+        }
         ui->lblSearchPos->setText("Search Results: " + QString::number(searchItemPos + 1) + " of " + QString::number(searchItems.count()));
     }
     else
@@ -186,13 +259,28 @@ void DBCMainEditor::handleSearch()
     }
 }
 
+//creates whatever is missing on the way down to a search hit
+QTreeWidgetItem *DBCMainEditor::itemForHit(const SearchHit &hit)
+{
+    QTreeWidgetItem *item = nodeToItem.value(hit.node);
+    if (!hit.msg || !item) return item;
+    populateItem(item);
+    item = messageToItem.value(hit.msg);
+    if (!hit.sig || !item) return item;
+    populateItem(item);
+
+    QList<DBC_SIGNAL *> chain; //multiplex parents first
+    for (DBC_SIGNAL *sig = hit.sig->multiplexParent; sig; sig = sig->multiplexParent) chain.prepend(sig);
+    foreach (DBC_SIGNAL *sig, chain) populateItem(signalToItem.value(sig));
+    return signalToItem.value(hit.sig);
+}
+
 void DBCMainEditor::handleSearchForward()
 {
     if (searchItems.count() == 0) return;
     if (searchItemPos < searchItems.count() - 1) searchItemPos++;
     else searchItemPos = 0;
-    ui->treeDBC->setCurrentItem(searchItems[searchItemPos]);
-    ui->lblSearchPos->setText("Search Results: " + QString::number(searchItemPos + 1) + " of " + QString::number(searchItems.count()));
+    showSearchHit();
 }
 
 void DBCMainEditor::handleSearchBackward()
@@ -200,8 +288,7 @@ void DBCMainEditor::handleSearchBackward()
     if (searchItems.count() == 0) return;
     if (searchItemPos > 0) searchItemPos--;
     else searchItemPos = searchItems.count() - 1;
-    ui->treeDBC->setCurrentItem(searchItems[searchItemPos]);
-    ui->lblSearchPos->setText("Search Results: " + QString::number(searchItemPos + 1) + " of " + QString::number(searchItems.count()));
+    showSearchHit();
 }
 
 void DBCMainEditor::currentItemChanged(QTreeWidgetItem *current, QTreeWidgetItem *prev)
@@ -381,6 +468,9 @@ void DBCMainEditor::onDuplicateNode()
 /*
  * Recreate the whole tree with pretty icons and custom user roles that give the rest of code an easy way to figure out whether a given tree node
  * is a node, message, or signal.
+ * Only the nodes get items here. Their messages, and the messages' signals, are filled in by populateItem the first
+ * time something is expanded so opening a database with thousands of messages doesn't create hundreds of
+ * thousands of items up front.
 */
 void DBCMainEditor::refreshTree()
 {
@@ -391,6 +481,8 @@ void DBCMainEditor::refreshTree()
     itemToNode.clear();
     itemToMessage.clear();
     itemToSignal.clear();
+    searchItems.clear();
+    searchText.clear();
 
     if (dbcFile->findNodeByName("Vector__XXX") == nullptr)
     {
@@ -400,41 +492,93 @@ void DBCMainEditor::refreshTree()
         dbcFile->dbc_nodes.append(newNode);
     }
 
+    QSet<QString> senders;
+    for (int x = 0; x < dbcFile->messageHandler->getCount(); x++)
+    {
+        DBC_MESSAGE *msg = dbcFile->messageHandler->findMsgByIdx(x);
+        if (msg->sender) senders.insert(msg->sender->name);
+    }
+
     for (int n = 0; n < dbcFile->dbc_nodes.count(); n++)
     {
         DBC_NODE *node = &dbcFile->dbc_nodes[n];
         QTreeWidgetItem *nodeItem = new QTreeWidgetItem();
-        QString nodeInfo = node->name;
-        if (node->comment.count() > 0) nodeInfo.append(" - ").append(node->comment);
-        nodeItem->setText(0, nodeInfo);
+        nodeItem->setText(0, createNodeText(node));
         nodeItem->setIcon(0, nodeIcon);
         nodeItem->setData(0, Qt::UserRole, DBCItemTypes::NODE);
+        if (senders.contains(node->name))
+        {
+            nodeItem->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+            nodeItem->setData(0, DBC_ITEM_UNPOPULATED, true);
+        }
         nodeToItem.insert(node, nodeItem);
         itemToNode.insert(nodeItem, node);
+        ui->treeDBC->addTopLevelItem(nodeItem);
+    }
+    ui->treeDBC->sortItems(0, Qt::SortOrder::AscendingOrder); //sort the display list for ease in viewing by mere mortals, helps me a lot.
+}
+
+/*
+ * Creates the children of a node, message or multiplexor the first time it's needed (expanded, searched into or
+ * added to). Anything that already has an item, because an edit put it there, is skipped so calling this again
+ * is harmless.
+*/
+void DBCMainEditor::populateItem(QTreeWidgetItem *item)
+{
+    if (!item || !item->data(0, DBC_ITEM_UNPOPULATED).toBool()) return;
+    item->setData(0, DBC_ITEM_UNPOPULATED, false);
+
+    switch (item->data(0, Qt::UserRole).toInt())
+    {
+    case DBCItemTypes::NODE:
+    {
+        DBC_NODE *node = itemToNode.value(item);
+        if (!node) break;
         for (int x = 0; x < dbcFile->messageHandler->getCount(); x++)
         {
             DBC_MESSAGE *msg = dbcFile->messageHandler->findMsgByIdx(x);
-            if (msg->sender->name == node->name)
-            {
-                QTreeWidgetItem *msgItem = new QTreeWidgetItem(nodeItem);
-                QString msgInfo = Utility::formatCANID(msg->ID) + " " + msg->name;
-                if (msg->comment.count() > 0) msgInfo.append(" - ").append(msg->comment);
-                msgItem->setText(0, msgInfo);
-                msgItem->setIcon(0, messageIcon);
-                msgItem->setData(0, Qt::UserRole, DBCItemTypes::MESG);
-                messageToItem.insert(msg, msgItem);
-                itemToMessage.insert(msgItem, msg);
-                for (int i = 0; i < msg->sigHandler->getCount(); i++)
-                {
-                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
-                    //only process signals here which are "top" level
-                    if (sig->multiplexParent == nullptr) processSignalToTree(msgItem, sig);
-                }
-            }
+            if (msg->sender && msg->sender->name == node->name && !messageToItem.contains(msg)) createMessageItem(item, msg);
         }
-        ui->treeDBC->addTopLevelItem(nodeItem);
+        break;
     }
-    ui->treeDBC->sortItems(0, Qt::SortOrder::AscendingOrder); //sort the display list for ease in viewing by mere mortals, helps me a lot.
+    case DBCItemTypes::MESG:
+    {
+        DBC_MESSAGE *msg = itemToMessage.value(item);
+        if (!msg) break;
+        for (int i = 0; i < msg->sigHandler->getCount(); i++)
+        {
+            DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
+            //only process signals here which are "top" level
+            if (sig->multiplexParent == nullptr && !signalToItem.contains(sig)) createSignalItem(item, sig);
+        }
+        break;
+    }
+    case DBCItemTypes::SIG:
+    {
+        DBC_SIGNAL *sig = itemToSignal.value(item);
+        if (!sig) break;
+        for (int i = 0; i < sig->multiplexedChildren.count(); i++)
+        {
+            if (!signalToItem.contains(sig->multiplexedChildren[i])) createSignalItem(item, sig->multiplexedChildren[i]);
+        }
+        break;
+    }
+    }
+    item->sortChildren(0, Qt::AscendingOrder);
+}
+
+QString DBCMainEditor::createNodeText(DBC_NODE *node)
+{
+    QString nodeInfo = node->name;
+    if (node->comment.count() > 0) nodeInfo.append(" - ").append(node->comment);
+    return nodeInfo;
+}
+
+QString DBCMainEditor::createMessageText(DBC_MESSAGE *msg)
+{
+    QString msgInfo = Utility::formatCANID(msg->ID) + " " + msg->name;
+    if (msg->comment.count() > 0) msgInfo.append(" - ").append(msg->comment);
+    return msgInfo;
 }
 
 QString DBCMainEditor::createSignalText(DBC_SIGNAL *sig)
@@ -457,8 +601,24 @@ QString DBCMainEditor::createSignalText(DBC_SIGNAL *sig)
     return sigInfo;
 }
 
-//Signals can have a hierarchial relationship with other signals so this function is separate and calls itself recursively to build the tree
-void DBCMainEditor::processSignalToTree(QTreeWidgetItem *parent, DBC_SIGNAL *sig)
+QTreeWidgetItem *DBCMainEditor::createMessageItem(QTreeWidgetItem *parent, DBC_MESSAGE *msg)
+{
+    QTreeWidgetItem *msgItem = new QTreeWidgetItem(parent);
+    msgItem->setText(0, createMessageText(msg));
+    msgItem->setIcon(0, messageIcon);
+    msgItem->setData(0, Qt::UserRole, DBCItemTypes::MESG);
+    if (msg->sigHandler->getCount() > 0)
+    {
+        msgItem->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+        msgItem->setData(0, DBC_ITEM_UNPOPULATED, true);
+    }
+    messageToItem.insert(msg, msgItem);
+    itemToMessage.insert(msgItem, msg);
+    return msgItem;
+}
+
+//Signals can have a hierarchial relationship with other signals. Multiplexed children get their items once the multiplexor is expanded
+QTreeWidgetItem *DBCMainEditor::createSignalItem(QTreeWidgetItem *parent, DBC_SIGNAL *sig)
 {
     QTreeWidgetItem *sigItem = new QTreeWidgetItem(parent);
     QString sigInfo = createSignalText(sig);
@@ -467,15 +627,23 @@ void DBCMainEditor::processSignalToTree(QTreeWidgetItem *parent, DBC_SIGNAL *sig
     else if (sig->isMultiplexed) sigItem->setIcon(0, multiplexedSignalIcon);
     else sigItem->setIcon(0, signalIcon);
     sigItem->setData(0, Qt::UserRole, DBCItemTypes::SIG);
-    signalToItem.insert(sig, sigItem);
-    itemToSignal.insert(sigItem, sig);
     if (sig->multiplexedChildren.count() > 0)
     {
-        for (int i = 0; i < sig->multiplexedChildren.count(); i++)
-        {
-            processSignalToTree(sigItem, sig->multiplexedChildren[i]);
-        }
+        sigItem->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+        sigItem->setData(0, DBC_ITEM_UNPOPULATED, true);
     }
+    signalToItem.insert(sig, sigItem);
+    itemToSignal.insert(sigItem, sig);
+    return sigItem;
+}
+
+//drops an item and everything under it from the lookup maps. The item itself is left for the caller to delete
+void DBCMainEditor::forgetItem(QTreeWidgetItem *item)
+{
+    for (int i = 0; i < item->childCount(); i++) forgetItem(item->child(i));
+    if (itemToNode.contains(item)) nodeToItem.remove(itemToNode.take(item));
+    if (itemToMessage.contains(item)) messageToItem.remove(itemToMessage.take(item));
+    if (itemToSignal.contains(item)) signalToItem.remove(itemToSignal.take(item));
 }
 
 void DBCMainEditor::updatedNode(DBC_NODE *node)
@@ -483,9 +651,7 @@ void DBCMainEditor::updatedNode(DBC_NODE *node)
     if (nodeToItem.contains(node))
     {
         QTreeWidgetItem *item = nodeToItem[node];
-        QString nodeInfo = node->name;
-        if (node->comment.count() > 0) nodeInfo.append(" - ").append(node->comment);
-        item->setText(0, nodeInfo);
+        item->setText(0, createNodeText(node));
     }
     else qDebug() << "That node doesn't exist. That's a bug dude.";
 }
@@ -495,9 +661,7 @@ void DBCMainEditor::updatedMessage(DBC_MESSAGE *msg)
     if (messageToItem.contains(msg))
     {
         QTreeWidgetItem *item = messageToItem.value(msg);
-        QString msgInfo = Utility::formatCANID(msg->ID) + " " + msg->name;
-        if (msg->comment.count() > 0) msgInfo.append(" - ").append(msg->comment);
-        item->setText(0, msgInfo);
+        item->setText(0, createMessageText(msg));
         //editor could have changed the parent Node too. Have to figure out which node
         //is parent in the GUI and compare that to parent in the data.
         DBC_NODE *oldParent = dbcFile->findNodeByName(item->parent()->text(0).split(" - ")[0]);
@@ -550,9 +714,17 @@ void DBCMainEditor::updatedSignal(DBC_SIGNAL *sig)
                     newParent = signalToItem.value(sig->multiplexParent);
                     QTreeWidgetItem *prevParent = signalToItem.value(oldParent);
                     prevParent->removeChild(item);
-                    newParent->addChild(item);
-                    ui->treeDBC->setCurrentItem(item);
-                    ui->treeDBC->sortItems(0, Qt::AscendingOrder); //resort because we just moved an item
+                    if (newParent)
+                    {
+                        newParent->addChild(item);
+                        ui->treeDBC->setCurrentItem(item);
+                        ui->treeDBC->sortItems(0, Qt::AscendingOrder); //resort because we just moved an item
+                    }
+                    else //new parent hasn't been populated into the tree yet. It'll show up there when it is
+                    {
+                        forgetItem(item);
+                        delete item;
+                    }
                 }
             }
         }
@@ -644,15 +816,7 @@ void DBCMainEditor::copyMessageToNode(DBC_NODE *parentNode, DBC_MESSAGE *source,
 
     dbcFile->messageHandler->addMessage(msg);
     msgPtr = dbcFile->messageHandler->findMsgByIdx(dbcFile->messageHandler->getCount() - 1);
-    QTreeWidgetItem *newMsgItem = new QTreeWidgetItem();
-    QString msgInfo = Utility::formatCANID(msg.ID) + " " + msg.name;
-    if (msg.comment.count() > 0) msgInfo.append(" - ").append(msg.comment);
-    newMsgItem->setText(0, msgInfo);
-    newMsgItem->setIcon(0, messageIcon);
-    newMsgItem->setData(0, Qt::UserRole, DBCItemTypes::MESG);
-    messageToItem.insert(msgPtr, newMsgItem);
-    itemToMessage.insert(newMsgItem, msgPtr);
-    nodeItem->addChild(newMsgItem);
+    QTreeWidgetItem *newMsgItem = createMessageItem(nodeItem, msgPtr);
     //ui->treeDBC->setCurrentItem(newMsgItem);
     dbcFile->setDirtyFlag();
 }
@@ -724,15 +888,7 @@ void DBCMainEditor::newMessage()
 
     dbcFile->messageHandler->addMessage(msg);
     msgPtr = dbcFile->messageHandler->findMsgByIdx(dbcFile->messageHandler->getCount() - 1);
-    QTreeWidgetItem *newMsgItem = new QTreeWidgetItem();
-    QString msgInfo = Utility::formatCANID(msg.ID) + " " + msg.name;
-    if (msg.comment.count() > 0) msgInfo.append(" - ").append(msg.comment);
-    newMsgItem->setText(0, msgInfo);
-    newMsgItem->setIcon(0, messageIcon);
-    newMsgItem->setData(0, Qt::UserRole, DBCItemTypes::MESG);
-    messageToItem.insert(msgPtr, newMsgItem);
-    itemToMessage.insert(newMsgItem, msgPtr);
-    nodeItem->addChild(newMsgItem);
+    QTreeWidgetItem *newMsgItem = createMessageItem(nodeItem, msgPtr);
     ui->treeDBC->setCurrentItem(newMsgItem);
     dbcFile->setDirtyFlag();
 }
@@ -788,16 +944,7 @@ void DBCMainEditor::newSignal()
     if (!sig.receiver) sig.receiver = &dbcFile->dbc_nodes[0]; //if receiver not set then set it to... something.
     msg->sigHandler->addSignal(sig);
     sigPtr = msg->sigHandler->findSignalByIdx(msg->sigHandler->getCount() - 1);
-    QTreeWidgetItem *newSigItem = new QTreeWidgetItem();
-    QString sigInfo = createSignalText(&sig);
-    newSigItem->setText(0, sigInfo);
-    if (sig.isMultiplexed) newSigItem->setIcon(0, multiplexedSignalIcon);
-    else if (sig.isMultiplexor) newSigItem->setIcon(0, multiplexorSignalIcon);
-    else newSigItem->setIcon(0, signalIcon);
-    newSigItem->setData(0, Qt::UserRole, DBCItemTypes::SIG);
-    signalToItem.insert(sigPtr, newSigItem);
-    itemToSignal.insert(newSigItem, sigPtr);
-    parentItem->addChild(newSigItem);
+    QTreeWidgetItem *newSigItem = createSignalItem(parentItem, sigPtr);
     ui->treeDBC->setCurrentItem(newSigItem);
     dbcFile->setDirtyFlag();
 }
@@ -891,6 +1038,8 @@ void DBCMainEditor::deleteNode(DBC_NODE *node)
 {
     qDebug() << "Going through with it you mass deleter!";
     if (!nodeToItem.contains(node)) return;
+    searchItems.clear(); //hits could point at any of what's about to go
+    searchText.clear();
     QTreeWidgetItem *currItem = nodeToItem[node];
     //don't actually store which messages are associated to which nodes so just iterate through the messages list and whack the ones
     //that claim to be associated to this node.
@@ -934,8 +1083,9 @@ void DBCMainEditor::deleteNode(DBC_NODE *node)
 void DBCMainEditor::deleteMessage(DBC_MESSAGE *msg)
 {
     qDebug() << "Deleting the message and all signals. Bye bye!";
-    if (!messageToItem.contains(msg)) return;
-    QTreeWidgetItem *currItem = messageToItem[msg];
+    QTreeWidgetItem *currItem = messageToItem.value(msg); //null if its node was never expanded
+    searchItems.clear();
+    searchText.clear();
 
     int numItems = msg->sigHandler->getCount();
     for (int i = numItems - 1; i > -1; i--)
@@ -945,20 +1095,28 @@ void DBCMainEditor::deleteMessage(DBC_MESSAGE *msg)
 
     dbcFile->messageHandler->removeMessage(msg);
 
-    itemToMessage.remove(currItem);
-    messageToItem.remove(msg);
-    ui->treeDBC->removeItemWidget(currItem, 0);
-    delete currItem;
+    if (currItem)
+    {
+        forgetItem(currItem);
+        ui->treeDBC->removeItemWidget(currItem, 0);
+        delete currItem;
+    }
     dbcFile->setDirtyFlag();
 }
 
 void DBCMainEditor::deleteSignal(DBC_SIGNAL *sig)
 {
     qDebug() << "Signal about to vanish.";
-    if (!signalToItem.contains(sig)) return;
-    QTreeWidgetItem *currItem = signalToItem[sig];
+    QTreeWidgetItem *currItem = signalToItem.value(sig); //null if its message was never expanded
+    searchItems.clear();
+    searchText.clear();
     sig->parentMessage->sigHandler->removeSignal(sig);
 
+    if (!currItem)
+    {
+        dbcFile->setDirtyFlag();
+        return;
+    }
     itemToSignal.remove(currItem);
     signalToItem.remove(sig);
     ui->treeDBC->removeItemWidget(currItem, 0);
@@ -13,6 +13,7 @@
 #include "dbcnoderebaseeditor.h"
 #include "dbcnodeduplicateeditor.h"
 #include "utility.h"
+#include "canframestore.h"
 
 namespace Ui {
 class DBCMainEditor;
@@ -30,7 +31,7 @@ class DBCMainEditor : public QDialog
     Q_OBJECT
 
 public:
-    explicit DBCMainEditor(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit DBCMainEditor(const CANFrameStore *frames, QWidget *parent = 0);
     ~DBCMainEditor();
     void setFileIdx(int idx);
 
@@ -49,6 +50,7 @@ private slots:
     void deleteMessage(DBC_MESSAGE *msg);
     void deleteSignal(DBC_SIGNAL *sig);
     void handleSearch();
+    void handleSearchIncremental(const QString &text);
     void handleSearchForward();
     void handleSearchBackward();
     void newNode(QString nodeName);
@@ -58,11 +60,12 @@ private slots:
     void newSignal();    
     void onRebaseMessages();
     void onDuplicateNode();
+    void populateItem(QTreeWidgetItem *item);
 
 private:
     Ui::DBCMainEditor *ui;
     DBCHandler *dbcHandler;
-    const QVector<CANFrame> *referenceFrames;
+    const CANFrameStore *referenceFrames;
     DBCSignalEditor *sigEditor;
     DBCMessageEditor *msgEditor;
     DBCNodeEditor *nodeEditor;
@@ -75,7 +78,15 @@ private:
     QIcon signalIcon;
     QIcon multiplexorSignalIcon;
     QIcon multiplexedSignalIcon;
-    QList<QTreeWidgetItem *> searchItems;
+    //one search result. Only the most specific pointer matters, its tree item may not have been created yet
+    struct SearchHit
+    {
+        DBC_NODE *node;
+        DBC_MESSAGE *msg;
+        DBC_SIGNAL *sig;
+    };
+    QList<SearchHit> searchItems;
+    QString searchText; //what searchItems was found with, empty once anything changes
     int searchItemPos;
     //bidirectional mapping of QTreeWidget items back and forth to DBC objects
     QMap<DBC_NODE*, QTreeWidgetItem *> nodeToItem;
@@ -92,8 +103,14 @@ private:
     void readSettings();
     void writeSettings();
     void refreshTree();
-    void processSignalToTree(QTreeWidgetItem *parent, DBC_SIGNAL *sig);
+    QTreeWidgetItem *createMessageItem(QTreeWidgetItem *parent, DBC_MESSAGE *msg);
+    QTreeWidgetItem *createSignalItem(QTreeWidgetItem *parent, DBC_SIGNAL *sig);
+    QTreeWidgetItem *itemForHit(const SearchHit &hit);
+    void showSearchHit();
+    void forgetItem(QTreeWidgetItem *item);
     uint32_t getParentMessageID(QTreeWidgetItem *cell);
+    QString createNodeText(DBC_NODE *node);
+    QString createMessageText(DBC_MESSAGE *msg);
     QString createSignalText(DBC_SIGNAL *sig);
 };
 
@@ -540,6 +540,7 @@ void DBCSignalEditor::onValuesCellChanged(int row,int col)
     if (col == 0)
     {
         currentSignal->valList[row].value = Utility::ParseStringToNum(ui->valuesTable->item(row, col)->text());
+        currentSignal->invalidateValueIndex();
     }
     else if (col == 1)
     {
@@ -564,6 +565,7 @@ void DBCSignalEditor::deleteCurrentValue()
     {
         ui->valuesTable->removeRow(currIdx);
         currentSignal->valList.removeAt(currIdx);
+        currentSignal->invalidateValueIndex();
     }
 }
 
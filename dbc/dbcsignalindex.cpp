@@ -0,0 +1,184 @@
+#include "dbcsignalindex.h"
+#include "dbchandler.h"
+#include "utility.h"
+
+#include <algorithm>
+
+DBCSignalIndex::DBCSignalIndex()
+{
+    built = false;
+    builtRevision = 0;
+}
+
+DBCSignalIndex *DBCSignalIndex::getReference()
+{
+    static DBCSignalIndex index;
+    return &index;
+}
+
+void DBCSignalIndex::build()
+{
+    quint32 revision = DBCHandler::getRevision();
+    if (built && revision == builtRevision) return;
+    built = true;
+    builtRevision = revision;
+    entries.clear();
+    lastQuery.clear();
+    lastFuzzy.clear();
+
+    DBCHandler *handler = DBCHandler::getReference();
+    for (int f = 0; f < handler->getFileCount(); f++)
+    {
+        DBCMessageHandler *messages = handler->getFileByIdx(f)->messageHandler;
+        for (int m = 0; m < messages->getCount(); m++)
+        {
+            DBC_MESSAGE *msg = messages->findMsgByIdx(m);
+            QString msgName = msg->name.toLower() + ".";
+            for (int s = 0; s < msg->sigHandler->getCount(); s++)
+            {
+                Entry entry;
+                entry.sig = msg->sigHandler->findSignalByIdx(s);
+                if (!entry.sig) continue;
+                entry.name = entry.sig->name.toLower();
+                entry.full = msgName + entry.name;
+                entries.append(entry);
+            }
+        }
+    }
+
+    byName.resize(entries.count());
+    for (int i = 0; i < entries.count(); i++) byName[i] = i;
+    byFull = byName;
+    std::sort(byName.begin(), byName.end(), [this](int a, int b) { return entries.at(a).name < entries.at(b).name; });
+    std::sort(byFull.begin(), byFull.end(), [this](int a, int b) { return entries.at(a).full < entries.at(b).full; });
+}
+
+int DBCSignalIndex::count()
+{
+    build();
+    return entries.count();
+}
+
+//the characters of text in order somewhere in str, not necessarily next to each other
+static bool fuzzyMatch(const QString &str, const QString &text)
+{
+    int pos = 0;
+    for (QChar c : text)
+    {
+        pos = str.indexOf(c, pos);
+        if (pos < 0) return false;
+        pos++;
+    }
+    return true;
+}
+
+QVector<DBC_SIGNAL*> DBCSignalIndex::find(const QString &text, int maxMatches)
+{
+    build();
+    QVector<DBC_SIGNAL*> out;
+    QString query = text.trimmed().toLower();
+    if (query.isEmpty()) return out;
+
+    QVector<bool> taken(entries.count(), false);
+    auto takePrefixes = [&](const QVector<int> &sorted, QString Entry::*key)
+    {
+        auto it = std::lower_bound(sorted.constBegin(), sorted.constEnd(), query,
+                                   [this, key](int e, const QString &q) { return entries.at(e).*key < q; });
+        for (; it != sorted.constEnd() && out.count() < maxMatches; ++it)
+        {
+            if (!(entries.at(*it).*key).startsWith(query)) break;
+            if (taken.at(*it)) continue;
+            taken[*it] = true;
+            out.append(entries.at(*it).sig);
+        }
+    };
+    takePrefixes(byName, &Entry::name);
+    takePrefixes(byFull, &Entry::full);
+
+    //the fuzzy matches of a longer query can only be among those of a shorter one it starts with
+    QVector<int> fuzzy;
+    if (!lastQuery.isEmpty() && query.startsWith(lastQuery))
+    {
+        for (int e : qAsConst(lastFuzzy))
+        {
+            if (fuzzyMatch(entries.at(e).full, query)) fuzzy.append(e);
+        }
+    }
+    else
+    {
+        for (int e : qAsConst(byFull))
+        {
+            if (fuzzyMatch(entries.at(e).full, query)) fuzzy.append(e);
+        }
+    }
+    lastQuery = query;
+    lastFuzzy = fuzzy;
+
+    for (int e : qAsConst(fuzzy))
+    {
+        if (out.count() >= maxMatches) break;
+        if (!taken.at(e)) out.append(entries.at(e).sig);
+    }
+    return out;
+}
+
+DBCSignalPickerModel::DBCSignalPickerModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    shown = 0;
+    revision = 0;
+}
+
+void DBCSignalPickerModel::setQuery(const QString &text)
+{
+    beginResetModel();
+    matches = DBCSignalIndex::getReference()->find(text);
+    revision = DBCHandler::getRevision();
+    shown = qMin(matches.count(), DBCSIGNALINDEX_FETCH_ROWS);
+    endResetModel();
+}
+
+DBC_SIGNAL *DBCSignalPickerModel::signalAt(int row) const
+{
+    if (row < 0 || row >= shown || revision != DBCHandler::getRevision()) return nullptr;
+    return matches.at(row);
+}
+
+int DBCSignalPickerModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return shown;
+}
+
+QVariant DBCSignalPickerModel::data(const QModelIndex &index, int role) const
+{
+    DBC_SIGNAL *sig = signalAt(index.row());
+    if (!index.isValid() || !sig) return QVariant();
+
+    DBC_MESSAGE *msg = sig->parentMessage;
+    switch (role)
+    {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return msg->name + "." + sig->name;
+    case Qt::ToolTipRole:
+        return msg->sender->sourceFileName + Utility::fullyQualifiedNameSeperator + msg->sender->name + " - " + Utility::formatCANID(msg->ID);
+    }
+    return QVariant();
+}
+
+bool DBCSignalPickerModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return false;
+    return shown < matches.count();
+}
+
+void DBCSignalPickerModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid()) return;
+    int more = qMin(matches.count() - shown, DBCSIGNALINDEX_FETCH_ROWS);
+    if (more <= 0) return;
+    beginInsertRows(QModelIndex(), shown, shown + more - 1);
+    shown += more;
+    endInsertRows();
+}
@@ -0,0 +1,79 @@
+#ifndef DBCSIGNALINDEX_H
+#define DBCSIGNALINDEX_H
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QVector>
+
+class DBC_SIGNAL;
+
+//most signals one query hands back. Past that what was typed is too short to narrow anything down
+#define DBCSIGNALINDEX_MAX_MATCHES      2000
+//rows a picker shows at first and adds each time its view scrolls to the end
+#define DBCSIGNALINDEX_FETCH_ROWS       100
+
+/*
+ * Every signal of every loaded DBC file, searchable by name. Built the first time it's asked after the DBC revision
+ * moved: one pass over the messages and two sorts. A query matches, in this order, signals whose name starts with
+ * it, then signals whose "message.signal" starts with it (both a binary search in a sorted list), then fuzzy ones
+ * that have its characters in order somewhere in "message.signal". Case doesn't matter.
+ *
+ * When a query only adds characters to the one before, the fuzzy pass just goes through what matched last time, so
+ * typing a name out gets cheaper with every key instead of scanning every signal again.
+ *
+ * GUI thread only, like the DBC handler it reads. One instance is shared by everything that picks signals.
+ */
+class DBCSignalIndex
+{
+public:
+    static DBCSignalIndex *getReference();
+
+    QVector<DBC_SIGNAL*> find(const QString &text, int maxMatches = DBCSIGNALINDEX_MAX_MATCHES);
+    int count(); //signals in all the loaded files
+
+private:
+    struct Entry
+    {
+        DBC_SIGNAL *sig;
+        QString name; //all lowercase, as are the others
+        QString full; //message.signal
+    };
+
+    DBCSignalIndex();
+    void build();
+
+    QVector<Entry> entries;
+    QVector<int> byName; //entries sorted by signal name
+    QVector<int> byFull; //and by message.signal
+    bool built;
+    quint32 builtRevision;
+    QString lastQuery; //what lastFuzzy is for
+    QVector<int> lastFuzzy; //every entry that matched it fuzzily, uncapped
+};
+
+/*
+ * The matches of one query as a list for a completer or a view. Rows come out DBCSIGNALINDEX_FETCH_ROWS at a time
+ * as the view scrolls so a short query doesn't fill thousands of rows nobody looks at.
+ */
+class DBCSignalPickerModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit DBCSignalPickerModel(QObject *parent = nullptr);
+
+    void setQuery(const QString &text);
+    DBC_SIGNAL *signalAt(int row) const; //nullptr if the DBC files changed since the query
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+    QVector<DBC_SIGNAL*> matches;
+    int shown;
+    quint32 revision; //DBC revision the matches were found in. Pointers from any other are stale
+};
+
+#endif // DBCSIGNALINDEX_H
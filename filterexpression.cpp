@@ -0,0 +1,933 @@
+#include "filterexpression.h"
+#include "dbc/dbchandler.h"
+#include "bus_protocols/canidparts.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#define FILTER_MAX_NESTING  64
+
+namespace {
+
+const double NO_VALUE = std::numeric_limits<double>::quiet_NaN();
+
+inline bool truth(double v)
+{
+    return v != 0.0 && !std::isnan(v);
+}
+
+//bitwise operators and % work on whole numbers. False for no value and anything that won't fit
+inline bool toInt(double v, int64_t &out)
+{
+    if (!(v >= -9.2e18 && v <= 9.2e18)) return false;
+    out = static_cast<int64_t>(v);
+    return true;
+}
+
+//DBC_SIGNAL::isSignalInMessage but off a bare payload, so a stored record doesn't need turning into a CANFrame
+bool signalPresent(const DBC_SIGNAL *sig, const uint8_t *data, int len)
+{
+    if (sig->isMultiplexor && !sig->isMultiplexed) return true;
+    if (!sig->isMultiplexed) return true;
+    if (!sig->parentMessage->multiplexorSignal || !signalPresent(sig->multiplexParent, data, len)) return false;
+    int32_t val;
+    if (!sig->multiplexParent->decodeInt(data, len, val)) return false;
+    return val >= sig->multiplexLowValue && val <= sig->multiplexHighValue;
+}
+
+}
+
+/*
+ * Recursive descent over the text into a small tree, then the tree is flattened into the program. Precedence from
+ * loosest to tightest: || , && , comparisons and "in", | , ^ , & , << >> , + - , * / % , unary - ! ~
+ * Unlike C the bitwise operators bind tighter than the comparisons so d[0] & 0x80 == 0x80 means what it looks like.
+ */
+class FilterCompiler
+{
+public:
+    FilterCompiler(const QString &text, FilterExpression *out, bool asValue) : text(text), out(out), asValue(asValue) {}
+    bool build(QString &errorOut);
+
+private:
+    typedef FilterExpression FE;
+
+    struct Node
+    {
+        enum Kind { CONST, FIELD, BYTE, SIGNAL, UNARY, BINARY, IN, AND, OR };
+        Kind kind;
+        FE::OpCode op; //the field, or the unary / binary operator
+        double value;
+        int left;
+        int right;
+        int arg; //the byte, or the first of out's ranges / signalRefs
+        int count;
+    };
+
+    struct IdSet
+    {
+        bool any;
+        QVector<FE::IdRange> ranges; //sorted and merged
+    };
+
+    int add(Node::Kind kind, FE::OpCode op, int left = -1, int right = -1, double value = 0.0);
+    int fail(const QString &what);
+    void skip();
+    bool accept(const char *tok, const char *notBefore = nullptr);
+    bool acceptWord(const char *word);
+    QString word();
+    bool number(double &value);
+
+    int parseOr();
+    int parseAnd();
+    int parseCompare();
+    int parseBitOr();
+    int parseBitXor();
+    int parseBitAnd();
+    int parseShift();
+    int parseSum();
+    int parseProduct();
+    int parseUnary();
+    int parsePrimary();
+    int parseRanges(int left);
+    int parseSignal();
+
+    void emitNode(int n);
+    void step(FE::OpCode op, int arg = 0, int count = 0, double value = 0.0);
+
+    bool isIdTest(int n) const;
+    IdSet idSet(int n) const;
+    static void addIdRange(QVector<FE::IdRange> &ranges, double low, double high);
+    static void normalize(QVector<FE::IdRange> &ranges);
+    static QVector<FE::IdRange> intersect(const QVector<FE::IdRange> &a, const QVector<FE::IdRange> &b);
+
+    QString text;
+    FilterExpression *out;
+    bool asValue; //always emit the program, the ID set isn't enough to work out a value
+    int pos = 0;
+    int nesting = 0;
+    int depth = 0;
+    int maxDepth = 0;
+    QString error;
+    QVector<Node> nodes;
+};
+
+int FilterCompiler::add(Node::Kind kind, FE::OpCode op, int left, int right, double value)
+{
+    Node node;
+    node.kind = kind;
+    node.op = op;
+    node.value = value;
+    node.left = left;
+    node.right = right;
+    node.arg = 0;
+    node.count = 0;
+    nodes.append(node);
+    return nodes.count() - 1;
+}
+
+int FilterCompiler::fail(const QString &what)
+{
+    if (error.isEmpty())
+    {
+        if (pos >= text.length()) error = QObject::tr("%1 at the end").arg(what);
+        else error = QObject::tr("%1 at character %2").arg(what).arg(pos + 1);
+    }
+    return -1;
+}
+
+void FilterCompiler::skip()
+{
+    while (pos < text.length() && text[pos].isSpace()) pos++;
+}
+
+//the operator tok, as long as it isn't the start of a longer one (one of notBefore follows it)
+bool FilterCompiler::accept(const char *tok, const char *notBefore)
+{
+    skip();
+    int len = static_cast<int>(strlen(tok));
+    if (pos + len > text.length()) return false;
+    for (int i = 0; i < len; i++)
+    {
+        if (text[pos + i] != QLatin1Char(tok[i])) return false;
+    }
+    if (notBefore && pos + len < text.length())
+    {
+        char next = text[pos + len].toLatin1();
+        if (next && strchr(notBefore, next)) return false;
+    }
+    pos += len;
+    return true;
+}
+
+bool FilterCompiler::acceptWord(const char *w)
+{
+    skip();
+    int start = pos;
+    if (word().compare(QLatin1String(w), Qt::CaseInsensitive) == 0) return true;
+    pos = start;
+    return false;
+}
+
+QString FilterCompiler::word()
+{
+    skip();
+    int start = pos;
+    while (pos < text.length() && (text[pos].isLetterOrNumber() || text[pos] == '_')) pos++;
+    return text.mid(start, pos - start);
+}
+
+//decimal (with a fraction if need be), 0x hex or 0b binary
+bool FilterCompiler::number(double &value)
+{
+    skip();
+    int start = pos;
+    int base = 10;
+    if (pos + 1 < text.length() && text[pos] == '0' && (text[pos + 1] == 'x' || text[pos + 1] == 'X')) base = 16;
+    else if (pos + 1 < text.length() && text[pos] == '0' && (text[pos + 1] == 'b' || text[pos + 1] == 'B')) base = 2;
+    if (base != 10)
+    {
+        pos += 2;
+        int digits = pos;
+        while (pos < text.length() && (base == 16 ? isxdigit(static_cast<unsigned char>(text[pos].toLatin1())) : (text[pos] == '0' || text[pos] == '1'))) pos++;
+        bool ok = pos > digits;
+        if (ok) value = static_cast<double>(text.mid(digits, pos - digits).toULongLong(&ok, base));
+        if (!ok) pos = start;
+        return ok;
+    }
+
+    while (pos < text.length() && text[pos].isDigit()) pos++;
+    //a '.' is only a fraction with a digit after it, "10..20" is a range
+    if (pos + 1 < text.length() && text[pos] == '.' && text[pos + 1].isDigit())
+    {
+        pos++;
+        while (pos < text.length() && text[pos].isDigit()) pos++;
+    }
+    bool ok = pos > start;
+    if (ok) value = text.mid(start, pos - start).toDouble(&ok);
+    if (!ok) pos = start;
+    return ok;
+}
+
+int FilterCompiler::parseOr()
+{
+    int left = parseAnd();
+    while (left >= 0 && accept("||"))
+    {
+        int right = parseAnd();
+        if (right < 0) return -1;
+        left = add(Node::OR, FE::OP_BOOL, left, right);
+    }
+    return left;
+}
+
+int FilterCompiler::parseAnd()
+{
+    int left = parseCompare();
+    while (left >= 0 && accept("&&"))
+    {
+        int right = parseCompare();
+        if (right < 0) return -1;
+        left = add(Node::AND, FE::OP_BOOL, left, right);
+    }
+    return left;
+}
+
+//one comparison at most, a < b < c doesn't mean anything useful
+int FilterCompiler::parseCompare()
+{
+    int left = parseBitOr();
+    if (left < 0) return -1;
+    if (acceptWord("in")) return parseRanges(left);
+
+    FE::OpCode op;
+    if (accept("==")) op = FE::OP_EQ;
+    else if (accept("!=")) op = FE::OP_NE;
+    else if (accept("<=")) op = FE::OP_LE;
+    else if (accept(">=")) op = FE::OP_GE;
+    else if (accept("<", "<")) op = FE::OP_LT;
+    else if (accept(">", ">")) op = FE::OP_GT;
+    else return left;
+
+    int right = parseBitOr();
+    if (right < 0) return -1;
+    return add(Node::BINARY, op, left, right);
+}
+
+int FilterCompiler::parseBitOr()
+{
+    int left = parseBitXor();
+    while (left >= 0 && accept("|", "|"))
+    {
+        int right = parseBitXor();
+        if (right < 0) return -1;
+        left = add(Node::BINARY, FE::OP_BITOR, left, right);
+    }
+    return left;
+}
+
+int FilterCompiler::parseBitXor()
+{
+    int left = parseBitAnd();
+    while (left >= 0 && accept("^"))
+    {
+        int right = parseBitAnd();
+        if (right < 0) return -1;
+        left = add(Node::BINARY, FE::OP_BITXOR, left, right);
+    }
+    return left;
+}
+
+int FilterCompiler::parseBitAnd()
+{
+    int left = parseShift();
+    while (left >= 0 && accept("&", "&"))
+    {
+        int right = parseShift();
+        if (right < 0) return -1;
+        left = add(Node::BINARY, FE::OP_BITAND, left, right);
+    }
+    return left;
+}
+
+int FilterCompiler::parseShift()
+{
+    int left = parseSum();
+    while (left >= 0)
+    {
+        FE::OpCode op;
+        if (accept("<<")) op = FE::OP_SHL;
+        else if (accept(">>")) op = FE::OP_SHR;
+        else break;
+        int right = parseSum();
+        if (right < 0) return -1;
+        left = add(Node::BINARY, op, left, right);
+    }
+    return left;
+}
+
+int FilterCompiler::parseSum()
+{
+    int left = parseProduct();
+    while (left >= 0)
+    {
+        FE::OpCode op;
+        if (accept("+")) op = FE::OP_ADD;
+        else if (accept("-")) op = FE::OP_SUB;
+        else break;
+        int right = parseProduct();
+        if (right < 0) return -1;
+        left = add(Node::BINARY, op, left, right);
+    }
+    return left;
+}
+
+int FilterCompiler::parseProduct()
+{
+    int left = parseUnary();
+    while (left >= 0)
+    {
+        FE::OpCode op;
+        if (accept("*")) op = FE::OP_MUL;
+        else if (accept("/")) op = FE::OP_DIV;
+        else if (accept("%")) op = FE::OP_MOD;
+        else break;
+        int right = parseUnary();
+        if (right < 0) return -1;
+        left = add(Node::BINARY, op, left, right);
+    }
+    return left;
+}
+
+int FilterCompiler::parseUnary()
+{
+    if (++nesting > FILTER_MAX_NESTING) return fail(QObject::tr("Nested too deeply"));
+    FE::OpCode op;
+    if (accept("-")) op = FE::OP_NEG;
+    else if (accept("!", "=")) op = FE::OP_NOT;
+    else if (accept("~")) op = FE::OP_BITNOT;
+    else
+    {
+        int n = parsePrimary();
+        nesting--;
+        return n;
+    }
+    int operand = parseUnary();
+    nesting--;
+    return operand < 0 ? -1 : add(Node::UNARY, op, operand);
+}
+
+int FilterCompiler::parsePrimary()
+{
+    skip();
+    if (pos >= text.length()) return fail(QObject::tr("Expected a value"));
+    if (accept("("))
+    {
+        int n = parseOr();
+        if (n < 0) return -1;
+        if (!accept(")")) return fail(QObject::tr("Expected )"));
+        return n;
+    }
+    double value;
+    if (text[pos].isDigit())
+    {
+        if (!number(value)) return fail(QObject::tr("Bad number"));
+        return add(Node::CONST, FE::OP_CONST, -1, -1, value);
+    }
+
+    int start = pos;
+    QString name = word().toLower();
+    if (name.isEmpty()) return fail(QObject::tr("Unexpected '%1'").arg(text[pos]));
+    if (name == "id") return add(Node::FIELD, FE::OP_ID);
+    if (name == "bus") return add(Node::FIELD, FE::OP_BUS);
+    if (name == "len" || name == "dlc") return add(Node::FIELD, FE::OP_LEN);
+    if (name == "ext") return add(Node::FIELD, FE::OP_EXT);
+    if (name == "fd") return add(Node::FIELD, FE::OP_FD);
+    if (name == "rx") return add(Node::FIELD, FE::OP_RX);
+    if (name == "time") return add(Node::FIELD, FE::OP_TIME);
+    if (name == "pgn") return add(Node::FIELD, FE::OP_PGN);
+    if (name == "sa" || name == "src") return add(Node::FIELD, FE::OP_SA);
+    if (name == "da" || name == "dest") return add(Node::FIELD, FE::OP_DA);
+    if (name == "prio") return add(Node::FIELD, FE::OP_PRIO);
+    if (name == "gmarb") return add(Node::FIELD, FE::OP_GMARB);
+    if (name == "gmsender") return add(Node::FIELD, FE::OP_GMSENDER);
+    if (name == "sig") return parseSignal();
+    if (name == "d")
+    {
+        if (!accept("[")) return fail(QObject::tr("Expected [ after d"));
+        if (!number(value) || value != std::floor(value) || value < 0 || value >= CANFrameRecord::MAX_BYTES)
+            return fail(QObject::tr("Expected a byte number from 0 to 63"));
+        if (!accept("]")) return fail(QObject::tr("Expected ]"));
+        int n = add(Node::BYTE, FE::OP_BYTE);
+        nodes[n].arg = static_cast<int>(value);
+        return n;
+    }
+    pos = start;
+    return fail(QObject::tr("Unknown name '%1'").arg(name));
+}
+
+//"in" then one range, like 0x700..0x7FF or 5, or a list of them in braces
+int FilterCompiler::parseRanges(int left)
+{
+    bool list = accept("{");
+    int first = out->ranges.count();
+    do
+    {
+        double low, high;
+        bool negative = accept("-");
+        if (!number(low)) return fail(QObject::tr("Expected a number"));
+        if (negative) low = -low;
+        high = low;
+        if (accept(".."))
+        {
+            negative = accept("-");
+            if (!number(high)) return fail(QObject::tr("Expected a number"));
+            if (negative) high = -high;
+        }
+        if (high < low) std::swap(low, high);
+        out->ranges.append({low, high});
+    } while (list && accept(","));
+    if (list && !accept("}")) return fail(QObject::tr("Expected }"));
+
+    int n = add(Node::IN, FE::OP_IN, left);
+    nodes[n].arg = first;
+    nodes[n].count = out->ranges.count() - first;
+    return n;
+}
+
+//sig(Name) or sig(Message.Name). Without the message every message with a signal of that name counts
+int FilterCompiler::parseSignal()
+{
+    if (!accept("(")) return fail(QObject::tr("Expected ( after sig"));
+    skip();
+    int start = pos;
+    while (pos < text.length() && text[pos] != ')') pos++;
+    QString name = text.mid(start, pos - start).trimmed();
+    if (!accept(")")) return fail(QObject::tr("Expected )"));
+
+    QString msgName;
+    int dot = name.indexOf('.');
+    if (dot >= 0)
+    {
+        msgName = name.left(dot).trimmed();
+        name = name.mid(dot + 1).trimmed();
+    }
+
+    DBCHandler *dbc = DBCHandler::getReference();
+    int first = out->signalRefs.count();
+    for (int f = 0; f < dbc->getFileCount(); f++)
+    {
+        DBCFile *file = dbc->getFileByIdx(f);
+        DBCMessageHandler *messages = file->messageHandler;
+        bool found = false;
+        for (int m = 0; m < messages->getCount(); m++)
+        {
+            DBC_MESSAGE *msg = messages->findMsgByIdx(m);
+            if (!msg || (!msgName.isEmpty() && msg->name.compare(msgName, Qt::CaseInsensitive) != 0)) continue;
+            DBC_SIGNAL *sig = msg->sigHandler->findSignalByName(name);
+            if (!sig) continue;
+            out->signalRefs.append({msg->ID & CANFrameRecord::ID_MASK, sig});
+            found = true;
+        }
+        QSharedPointer<DBCMessageHandler> shared = file->sharedMessageHandler();
+        if (found && !out->dbcMessages.contains(shared)) out->dbcMessages.append(shared);
+    }
+    if (out->signalRefs.count() == first)
+    {
+        pos = start;
+        return fail(QObject::tr("No signal '%1' in the loaded DBC files").arg(dot >= 0 ? msgName + "." + name : name));
+    }
+    out->usesSignals = true;
+
+    int n = add(Node::SIGNAL, FE::OP_SIGNAL);
+    nodes[n].arg = first;
+    nodes[n].count = out->signalRefs.count() - first;
+    return n;
+}
+
+void FilterCompiler::step(FE::OpCode op, int arg, int count, double value)
+{
+    out->steps.append({op, arg, count, value});
+}
+
+void FilterCompiler::emitNode(int n)
+{
+    const Node node = nodes.at(n);
+    switch (node.kind)
+    {
+    case Node::CONST:
+    case Node::FIELD:
+    case Node::BYTE:
+    case Node::SIGNAL:
+        step(node.op, node.arg, node.count, node.value);
+        maxDepth = qMax(maxDepth, ++depth);
+        break;
+    case Node::UNARY:
+    case Node::IN:
+        emitNode(node.left);
+        step(node.op, node.arg, node.count);
+        break;
+    case Node::BINARY:
+        emitNode(node.left);
+        emitNode(node.right);
+        step(node.op);
+        depth--;
+        break;
+    case Node::AND:
+    case Node::OR:
+    {
+        emitNode(node.left);
+        int jump = out->steps.count();
+        step(node.kind == Node::AND ? FE::OP_AND_JUMP : FE::OP_OR_JUMP);
+        depth--; //going on drops the left value, the right one takes its place
+        emitNode(node.right);
+        step(FE::OP_BOOL);
+        out->steps[jump].arg = out->steps.count();
+        break;
+    }
+    }
+}
+
+//the node says nothing but which IDs pass, so the ID set can stand in for it
+bool FilterCompiler::isIdTest(int n) const
+{
+    const Node &node = nodes.at(n);
+    if (node.kind == Node::AND || node.kind == Node::OR) return isIdTest(node.left) && isIdTest(node.right);
+    const bool onId = node.left >= 0 && nodes.at(node.left).kind == Node::FIELD && nodes.at(node.left).op == FE::OP_ID;
+    if (node.kind == Node::IN) return onId;
+    if (node.kind != Node::BINARY || !onId || nodes.at(node.right).kind != Node::CONST) return false;
+    return node.op == FE::OP_EQ || node.op == FE::OP_LT || node.op == FE::OP_LE || node.op == FE::OP_GT || node.op == FE::OP_GE;
+}
+
+//every ID that could pass the node. any when it doesn't narrow the IDs down
+FilterCompiler::IdSet FilterCompiler::idSet(int n) const
+{
+    const Node &node = nodes.at(n);
+    IdSet set;
+    set.any = true;
+    if (node.kind == Node::AND || node.kind == Node::OR)
+    {
+        IdSet a = idSet(node.left);
+        IdSet b = idSet(node.right);
+        if (node.kind == Node::AND)
+        {
+            if (a.any) return b;
+            if (b.any) return a;
+            a.ranges = intersect(a.ranges, b.ranges);
+            return a;
+        }
+        if (a.any || b.any) return set;
+        a.ranges += b.ranges;
+        normalize(a.ranges);
+        return a;
+    }
+    if (!isIdTest(n)) return set;
+
+    set.any = false;
+    const double maxId = CANFrameRecord::ID_MASK;
+    if (node.kind == Node::IN)
+    {
+        for (int i = node.arg; i < node.arg + node.count; i++) addIdRange(set.ranges, out->ranges[i].low, out->ranges[i].high);
+    }
+    else
+    {
+        double v = nodes.at(node.right).value;
+        switch (node.op)
+        {
+        case FE::OP_EQ: addIdRange(set.ranges, v, v); break;
+        case FE::OP_LT: addIdRange(set.ranges, 0, std::ceil(v) - 1); break;
+        case FE::OP_LE: addIdRange(set.ranges, 0, v); break;
+        case FE::OP_GT: addIdRange(set.ranges, std::floor(v) + 1, maxId); break;
+        case FE::OP_GE: addIdRange(set.ranges, v, maxId); break;
+        default: break;
+        }
+    }
+    normalize(set.ranges);
+    return set;
+}
+
+void FilterCompiler::addIdRange(QVector<FE::IdRange> &ranges, double low, double high)
+{
+    low = qMax(std::ceil(low), 0.0);
+    high = qMin(std::floor(high), static_cast<double>(CANFrameRecord::ID_MASK));
+    if (low <= high) ranges.append({static_cast<uint32_t>(low), static_cast<uint32_t>(high)});
+}
+
+void FilterCompiler::normalize(QVector<FE::IdRange> &ranges)
+{
+    std::sort(ranges.begin(), ranges.end(), [](const FE::IdRange &a, const FE::IdRange &b) { return a.low < b.low; });
+    int kept = 0;
+    for (int i = 0; i < ranges.count(); i++)
+    {
+        if (kept > 0 && ranges[i].low <= ranges[kept - 1].high + 1)
+            ranges[kept - 1].high = qMax(ranges[kept - 1].high, ranges[i].high);
+        else ranges[kept++] = ranges[i];
+    }
+    ranges.resize(kept);
+}
+
+QVector<FilterExpression::IdRange> FilterCompiler::intersect(const QVector<FE::IdRange> &a, const QVector<FE::IdRange> &b)
+{
+    QVector<FE::IdRange> result;
+    int i = 0, j = 0;
+    while (i < a.count() && j < b.count())
+    {
+        uint32_t low = qMax(a[i].low, b[j].low);
+        uint32_t high = qMin(a[i].high, b[j].high);
+        if (low <= high) result.append({low, high});
+        if (a[i].high < b[j].high) i++;
+        else j++;
+    }
+    return result;
+}
+
+bool FilterCompiler::build(QString &errorOut)
+{
+    out->source = text.trimmed();
+    out->dbcRevision = DBCHandler::getRevision();
+    int root = parseOr();
+    skip();
+    if (root >= 0 && pos < text.length()) fail(QObject::tr("Unexpected '%1'").arg(text[pos]));
+    if (!error.isEmpty())
+    {
+        errorOut = error;
+        return false;
+    }
+
+    IdSet ids = idSet(root);
+    out->anyId = ids.any;
+    for (const FE::IdRange &range : qAsConst(ids.ranges))
+    {
+        for (uint32_t id = range.low; id <= range.high && id < FE::STD_IDS; id++) out->stdIds[id >> 5] |= 1u << (id & 31);
+        if (range.high >= FE::STD_IDS) out->extIds.append({range.low < FE::STD_IDS ? 2048u : range.low, range.high});
+    }
+    out->needsProgram = asValue || !isIdTest(root);
+    if (out->needsProgram)
+    {
+        emitNode(root);
+        if (maxDepth > FE::MAX_DEPTH)
+        {
+            errorOut = QObject::tr("Too many values waiting on each other, simplify the expression");
+            return false;
+        }
+    }
+    for (const FE::Step &step : qAsConst(out->steps))
+    {
+        switch (step.op)
+        {
+        case FE::OP_LEN:
+        case FE::OP_FD:
+        case FE::OP_RX:
+        case FE::OP_TIME:
+        case FE::OP_BYTE:
+        case FE::OP_SIGNAL:
+            out->idOnly = false;
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+FilterExpression::FilterExpression() :
+    anyId(true),
+    needsProgram(true),
+    usesSignals(false),
+    idOnly(true),
+    dbcRevision(0)
+{
+    memset(stdIds, 0, sizeof(stdIds));
+}
+
+QSharedPointer<const FilterExpression> FilterExpression::compile(const QString &text, QString *error)
+{
+    if (error) error->clear();
+    if (text.trimmed().isEmpty()) return QSharedPointer<const FilterExpression>();
+
+    QSharedPointer<FilterExpression> expr(new FilterExpression);
+    FilterCompiler compiler(text, expr.data(), false);
+    QString why;
+    if (!compiler.build(why))
+    {
+        if (error) *error = why;
+        return QSharedPointer<const FilterExpression>();
+    }
+    return expr;
+}
+
+QSharedPointer<const FilterExpression> FilterExpression::compileValue(const QString &text, QString *error)
+{
+    if (error) error->clear();
+    if (text.trimmed().isEmpty())
+    {
+        if (error) *error = QObject::tr("Expected a value");
+        return QSharedPointer<const FilterExpression>();
+    }
+
+    QSharedPointer<FilterExpression> expr(new FilterExpression);
+    FilterCompiler compiler(text, expr.data(), true);
+    QString why;
+    if (!compiler.build(why))
+    {
+        if (error) *error = why;
+        return QSharedPointer<const FilterExpression>();
+    }
+    return expr;
+}
+
+bool FilterExpression::isCurrent() const
+{
+    return !usesSignals || dbcRevision == DBCHandler::getRevision();
+}
+
+bool FilterExpression::matches(const CANFrame &frame) const
+{
+    if (!mayMatchId(frame.frameId())) return false;
+    if (!needsProgram) return true;
+    const QByteArray payload = frame.payload();
+    FrameView view;
+    view.id = frame.frameId();
+    view.extended = frame.hasExtendedFrameFormat();
+    view.bus = frame.bus;
+    view.len = payload.length();
+    view.data = reinterpret_cast<const uint8_t *>(payload.constData());
+    view.timestamp = static_cast<uint64_t>(frame.timeStamp().microSeconds());
+    view.fd = frame.hasFlexibleDataRateFormat();
+    view.received = frame.isReceived;
+    return run(view);
+}
+
+FilterExpression::FrameView FilterExpression::viewOf(const CANFrameRecord &rec, const uint8_t *payload)
+{
+    FrameView view;
+    view.id = rec.frameId();
+    view.extended = rec.isExtended();
+    view.bus = rec.bus;
+    view.len = rec.len;
+    view.data = payload;
+    view.timestamp = rec.timestamp;
+    view.fd = (rec.flags & CANFrameRecord::FLAG_FD) != 0;
+    view.received = rec.isReceived();
+    return view;
+}
+
+bool FilterExpression::matches(const CANFrameRecord &rec, const uint8_t *payload) const
+{
+    if (!mayMatchId(rec.frameId())) return false;
+    if (!needsProgram) return true;
+    return run(viewOf(rec, payload));
+}
+
+double FilterExpression::valueOf(const CANFrameRecord &rec, const uint8_t *payload) const
+{
+    return evaluate(viewOf(rec, payload));
+}
+
+FilterExpression::Verdict FilterExpression::pairVerdict(uint32_t id, int bus) const
+{
+    if (!mayMatchId(id)) return NoFrames;
+    if (!needsProgram) return AllFrames;
+    if (!idOnly) return SomeFrames;
+    FrameView view;
+    view.id = id;
+    view.extended = true;
+    view.bus = bus;
+    view.len = 0;
+    view.data = nullptr;
+    view.timestamp = 0;
+    view.fd = false;
+    view.received = false;
+    const bool asExtended = run(view);
+    //an ID above 0x7FF can only be extended. Below that the pair can hold either kind of frame
+    if (id >= STD_IDS) return asExtended ? AllFrames : NoFrames;
+    view.extended = false;
+    const bool asStandard = run(view);
+    if (asExtended != asStandard) return SomeFrames;
+    return asExtended ? AllFrames : NoFrames;
+}
+
+bool FilterExpression::inExtRanges(uint32_t id) const
+{
+    //last range starting at or below id
+    auto it = std::upper_bound(extIds.constBegin(), extIds.constEnd(), id, [](uint32_t v, const IdRange &r) { return v < r.low; });
+    return it != extIds.constBegin() && id <= (it - 1)->high;
+}
+
+bool FilterExpression::mayMatchIds(uint32_t low, uint32_t high) const
+{
+    if (anyId) return true;
+    for (uint32_t id = low; id <= high && id < STD_IDS; id++)
+    {
+        if ((stdIds[id >> 5] >> (id & 31)) & 1) return true;
+    }
+    if (high < STD_IDS) return false;
+    //first range ending at or after low, if it starts by high it overlaps
+    auto it = std::lower_bound(extIds.constBegin(), extIds.constEnd(), low, [](const IdRange &r, uint32_t v) { return r.high < v; });
+    return it != extIds.constEnd() && it->low <= high;
+}
+
+double FilterExpression::signalValue(const Step &step, const FrameView &frame) const
+{
+    for (int i = step.arg; i < step.arg + step.count; i++)
+    {
+        const SignalRef &ref = signalRefs.at(i);
+        if (ref.id != frame.id) continue;
+        if (!signalPresent(ref.sig, frame.data, frame.len)) return NO_VALUE;
+        double value;
+        int32_t mux;
+        return ref.sig->decodeValue(frame.data, frame.len, value, mux) ? value : NO_VALUE;
+    }
+    return NO_VALUE;
+}
+
+bool FilterExpression::run(const FrameView &frame) const
+{
+    return truth(evaluate(frame));
+}
+
+double FilterExpression::evaluate(const FrameView &frame) const
+{
+    double stack[MAX_DEPTH];
+    int top = -1;
+    const Step *code = steps.constData();
+    const int count = steps.count();
+    for (int pc = 0; pc < count; pc++)
+    {
+        const Step &s = code[pc];
+        switch (s.op)
+        {
+        case OP_CONST: stack[++top] = s.value; continue;
+        case OP_ID: stack[++top] = frame.id; continue;
+        case OP_BUS: stack[++top] = frame.bus; continue;
+        case OP_LEN: stack[++top] = frame.len; continue;
+        case OP_EXT: stack[++top] = frame.extended ? 1.0 : 0.0; continue;
+        case OP_FD: stack[++top] = frame.fd ? 1.0 : 0.0; continue;
+        case OP_RX: stack[++top] = frame.received ? 1.0 : 0.0; continue;
+        case OP_TIME: stack[++top] = frame.timestamp / 1000000.0; continue;
+        case OP_PGN: stack[++top] = frame.extended ? CANIdParts::j1939Pgn(frame.id) : NO_VALUE; continue;
+        case OP_SA: stack[++top] = frame.extended ? CANIdParts::j1939Source(frame.id) : NO_VALUE; continue;
+        case OP_DA: stack[++top] = frame.extended ? CANIdParts::j1939Dest(frame.id) : NO_VALUE; continue;
+        case OP_PRIO: stack[++top] = frame.extended ? CANIdParts::priority(frame.id) : NO_VALUE; continue;
+        case OP_GMARB: stack[++top] = frame.extended ? CANIdParts::gmlanArbitrationId(frame.id) : NO_VALUE; continue;
+        case OP_GMSENDER: stack[++top] = frame.extended ? CANIdParts::gmlanSenderId(frame.id) : NO_VALUE; continue;
+        case OP_BYTE: stack[++top] = s.arg < frame.len ? frame.data[s.arg] : NO_VALUE; continue;
+        case OP_SIGNAL: stack[++top] = signalValue(s, frame); continue;
+        case OP_NEG: stack[top] = -stack[top]; continue;
+        case OP_NOT: if (!std::isnan(stack[top])) stack[top] = stack[top] == 0.0 ? 1.0 : 0.0; continue;
+        case OP_BITNOT:
+        {
+            int64_t v;
+            stack[top] = toInt(stack[top], v) ? static_cast<double>(~v) : NO_VALUE;
+            continue;
+        }
+        case OP_IN:
+        {
+            double v = stack[top];
+            bool found = false;
+            for (int i = s.arg; i < s.arg + s.count && !found; i++) found = v >= ranges[i].low && v <= ranges[i].high;
+            stack[top] = found ? 1.0 : 0.0;
+            continue;
+        }
+        case OP_AND_JUMP:
+            if (truth(stack[top])) top--;
+            else
+            {
+                stack[top] = 0.0;
+                pc = s.arg - 1;
+            }
+            continue;
+        case OP_OR_JUMP:
+            if (!truth(stack[top])) top--;
+            else
+            {
+                stack[top] = 1.0;
+                pc = s.arg - 1;
+            }
+            continue;
+        case OP_BOOL: stack[top] = truth(stack[top]) ? 1.0 : 0.0; continue;
+        default:
+            break;
+        }
+
+        //the rest take two values
+        const double b = stack[top--];
+        double &a = stack[top];
+        switch (s.op)
+        {
+        case OP_ADD: a += b; break;
+        case OP_SUB: a -= b; break;
+        case OP_MUL: a *= b; break;
+        case OP_DIV: a = (b == 0.0) ? NO_VALUE : a / b; break;
+        case OP_EQ: a = (a == b) ? 1.0 : 0.0; break; //NaN never compares equal so no value gives false
+        case OP_NE: a = (a != b && !std::isnan(a) && !std::isnan(b)) ? 1.0 : 0.0; break;
+        case OP_LT: a = (a < b) ? 1.0 : 0.0; break;
+        case OP_LE: a = (a <= b) ? 1.0 : 0.0; break;
+        case OP_GT: a = (a > b) ? 1.0 : 0.0; break;
+        case OP_GE: a = (a >= b) ? 1.0 : 0.0; break;
+        default:
+        {
+            int64_t x, y;
+            if (!toInt(a, x) || !toInt(b, y))
+            {
+                a = NO_VALUE;
+                break;
+            }
+            switch (s.op)
+            {
+            case OP_MOD: a = (y == 0) ? NO_VALUE : static_cast<double>(x % y); break;
+            case OP_BITAND: a = static_cast<double>(x & y); break;
+            case OP_BITOR: a = static_cast<double>(x | y); break;
+            case OP_BITXOR: a = static_cast<double>(x ^ y); break;
+            case OP_SHL: a = (y < 0 || y > 63) ? NO_VALUE : static_cast<double>(static_cast<uint64_t>(x) << y); break;
+            case OP_SHR: a = (y < 0 || y > 63) ? NO_VALUE : static_cast<double>(x >> y); break;
+            default: break;
+            }
+            break;
+        }
+        }
+    }
+    return top >= 0 ? stack[top] : NO_VALUE;
+}
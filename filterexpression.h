@@ -0,0 +1,188 @@
+#ifndef FILTEREXPRESSION_H
+#define FILTEREXPRESSION_H
+
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "can_structs.h"
+
+class DBC_SIGNAL;
+class DBCMessageHandler;
+
+/*
+ * A frame filter written out as text, like
+ *     id in 0x700..0x7FF && bus == 1 && d[0] & 0x80 && sig(EngineSpeed) > 3000
+ * and compiled once to a flat stack program, so checking a frame is a short loop over a handful of steps with no
+ * allocation and no lookups. Signals are looked up in the DBC files when compiling.
+ *
+ * Whatever the expression says about the ID alone (id == x, id in ranges, id < x and && / || of those) is also
+ * turned into an ID set: a 2048 bit map for the standard IDs and sorted ranges above that. The set is checked
+ * first and throws out frames that can't match before the program runs. An expression that's nothing but an ID
+ * set never runs a program at all. Loaders and indexes can ask mayMatchId() / mayMatchIds() to skip whole IDs
+ * or blocks of them.
+ *
+ * pgn, sa, da and prio pull the J1939 fields out of an extended ID, gmarb and gmsender the GMLAN ones. They're
+ * worked out from the ID like id itself, which makes an expression that only looks at those and the bus something
+ * that holds or doesn't for every frame of a bus / ID pair. pairVerdict() says so, so an indexed store can pick out
+ * a PGN or source address by its posting lists instead of putting every frame through the program.
+ *
+ * Values are doubles. A byte past the end of the frame or a signal the frame doesn't carry has no value, anything
+ * worked out from it has none either and every comparison with it is false. See the main screen help for the syntax.
+ *
+ * compileValue() takes the same text as something to work out rather than a test, like sig(EngineSpeed) / 4 or
+ * d[1] & 0x0F, and valueOf() gives what it comes to for a frame (a comparison gives 1 or 0). The ID set isn't used
+ * for those, every frame runs the program.
+ *
+ * Compiled expressions don't change and can be shared between threads. One that uses signals holds pointers into
+ * the DBC files so it has to be compiled again once they change, isCurrent() says when. It also holds on to the
+ * message set of every file it took a signal from, so a file reloaded or removed while a search or load is still
+ * running on another thread stays around until the last expression using it is gone.
+ */
+class FilterExpression
+{
+public:
+    //null with what's wrong in error if the text doesn't parse. Blank text is null with no error, it filters nothing
+    static QSharedPointer<const FilterExpression> compile(const QString &text, QString *error = nullptr);
+    //same but always as a program, for valueOf. Blank text is an error
+    static QSharedPointer<const FilterExpression> compileValue(const QString &text, QString *error = nullptr);
+
+    bool matches(const CANFrame &frame) const;
+    //payload is rec.len bytes, CANFrameStore::payloadData for a stored row
+    bool matches(const CANFrameRecord &rec, const uint8_t *payload) const;
+    //what the expression works out to for the frame, NaN when it has no value
+    double valueOf(const CANFrameRecord &rec, const uint8_t *payload) const;
+
+    //false when no frame with this ID can match, whatever else is in it
+    bool mayMatchId(uint32_t id) const
+    {
+        if (anyId) return true;
+        if (id < STD_IDS) return (stdIds[id >> 5] >> (id & 31)) & 1;
+        return inExtRanges(id);
+    }
+    //false when no ID from low to high can match
+    bool mayMatchIds(uint32_t low, uint32_t high) const;
+    bool filtersIds() const { return !anyId; }
+    //true when only the ID and bus (and what comes from the ID) are looked at, so pairVerdict() never says SomeFrames
+    bool readsIdOnly() const { return idOnly; }
+    enum Verdict
+    {
+        NoFrames,
+        AllFrames,
+        SomeFrames  //depends on more than the ID, each frame has to be matched
+    };
+    Verdict pairVerdict(uint32_t id, int bus) const;
+    bool needsDbc() const { return usesSignals; }
+    bool isCurrent() const;
+    const QString &text() const { return source; }
+
+private:
+    static constexpr uint32_t STD_IDS = 2048;
+    static constexpr int MAX_DEPTH = 32;
+
+    enum OpCode : quint8
+    {
+        OP_CONST,
+        OP_ID,
+        OP_BUS,
+        OP_LEN,
+        OP_EXT,
+        OP_FD,
+        OP_RX,
+        OP_TIME,
+        OP_PGN,         //J1939 and GMLAN fields of an extended ID, no value for standard ones
+        OP_SA,
+        OP_DA,
+        OP_PRIO,
+        OP_GMARB,
+        OP_GMSENDER,
+        OP_BYTE,        //arg is the byte
+        OP_SIGNAL,      //arg / count pick the candidates out of signalRefs
+        OP_NEG,
+        OP_NOT,
+        OP_BITNOT,
+        OP_ADD,
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_MOD,
+        OP_BITAND,
+        OP_BITOR,
+        OP_BITXOR,
+        OP_SHL,
+        OP_SHR,
+        OP_EQ,
+        OP_NE,
+        OP_LT,
+        OP_LE,
+        OP_GT,
+        OP_GE,
+        OP_IN,          //arg / count pick the ranges out of ranges
+        OP_AND_JUMP,    //false: leaves 0 and jumps to arg. true: drops it and goes on
+        OP_OR_JUMP,     //true: leaves 1 and jumps to arg. false: drops it and goes on
+        OP_BOOL
+    };
+
+    struct Step
+    {
+        OpCode op;
+        int arg;
+        int count;
+        double value;
+    };
+
+    struct Range
+    {
+        double low;
+        double high;
+    };
+
+    struct IdRange
+    {
+        uint32_t low;
+        uint32_t high;
+    };
+
+    //a signal name can be in more than one message, the frame's ID picks which
+    struct SignalRef
+    {
+        uint32_t id;
+        const DBC_SIGNAL *sig;
+    };
+
+    //the parts of a frame the program reads, from either a CANFrame or a stored record
+    struct FrameView
+    {
+        uint32_t id;
+        bool extended;
+        int bus;
+        int len;
+        const uint8_t *data;
+        uint64_t timestamp;
+        bool fd;
+        bool received;
+    };
+
+    FilterExpression();
+    static FrameView viewOf(const CANFrameRecord &rec, const uint8_t *payload);
+    bool run(const FrameView &frame) const;
+    double evaluate(const FrameView &frame) const;
+    double signalValue(const Step &step, const FrameView &frame) const;
+    bool inExtRanges(uint32_t id) const;
+
+    friend class FilterCompiler;
+
+    QString source;
+    QVector<Step> steps;
+    QVector<Range> ranges;
+    QVector<SignalRef> signalRefs;
+    QVector<QSharedPointer<DBCMessageHandler>> dbcMessages; //what the signalRefs point into
+    uint32_t stdIds[STD_IDS / 32];
+    QVector<IdRange> extIds; //sorted, not overlapping, all at or above STD_IDS
+    bool anyId;
+    bool needsProgram; //false when the ID set says it all
+    bool usesSignals;
+    bool idOnly;
+    quint32 dbcRevision;
+};
+
+#endif // FILTEREXPRESSION_H
@@ -0,0 +1,134 @@
+#include "filterlistmodel.h"
+
+#include <QSettings>
+#include "filterutility.h"
+
+FilterListModel::FilterListModel(CANFrameModel *frameModel, QObject *parent)
+    : QAbstractListModel(parent)
+{
+    this->frameModel = frameModel;
+    QSettings settings;
+    labeling = settings.value("Main/FilterLabeling", false).toBool();
+}
+
+int FilterListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return ids.count();
+}
+
+QVariant FilterListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= ids.count()) return QVariant();
+    uint32_t id = ids.at(index.row());
+
+    switch (role)
+    {
+    case Qt::DisplayRole:
+        if (labels.at(index.row()).isNull()) labels[index.row()] = FilterUtility::filterText(id, labeling);
+        return labels.at(index.row());
+    case Qt::ToolTipRole:
+    {
+        //rare enough that it isn't worth keeping
+        QString tooltip;
+        FilterUtility::filterText(id, labeling, &tooltip);
+        if (tooltip.isEmpty()) return QVariant();
+        return tooltip;
+    }
+    case Qt::CheckStateRole:
+        return (frameModel->getFilterTable()->idState(id) == CANFilterTable::On) ? Qt::Checked : Qt::Unchecked;
+    default:
+        return QVariant();
+    }
+}
+
+bool FilterListModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (role != Qt::CheckStateRole || !index.isValid() || index.row() >= ids.count()) return false;
+    uint32_t id = ids.at(index.row());
+    bool on = (value.toInt() == Qt::Checked);
+    frameModel->setFilterState(id, on);
+    emit dataChanged(index, index, {Qt::CheckStateRole});
+    emit filterToggled(id, on);
+    return true;
+}
+
+Qt::ItemFlags FilterListModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) return Qt::NoItemFlags;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable;
+}
+
+/*
+ * IDs only ever get added to the table, except when it's cleared (or a filter file replaces it) and then the list
+ * starts over. So walk the two in step, put each run of new IDs in with one insert, and fall back to a reset if
+ * the list has an ID the table doesn't.
+ */
+void FilterListModel::sync()
+{
+    const QMap<int, bool> now = frameModel->getFilterTable()->ids();
+    if (now.count() < ids.count())
+    {
+        reset();
+        return;
+    }
+
+    int row = 0;
+    QMap<int, bool>::const_iterator it = now.constBegin();
+    while (it != now.constEnd())
+    {
+        uint32_t id = static_cast<uint32_t>(it.key());
+        if (row < ids.count() && ids.at(row) == id)
+        {
+            row++;
+            ++it;
+            continue;
+        }
+        if (row < ids.count() && ids.at(row) < id)
+        {
+            reset();
+            return;
+        }
+
+        QVector<uint32_t> run;
+        while (it != now.constEnd() && (row >= ids.count() || static_cast<uint32_t>(it.key()) < ids.at(row)))
+        {
+            run.append(static_cast<uint32_t>(it.key()));
+            ++it;
+        }
+        beginInsertRows(QModelIndex(), row, row + run.count() - 1);
+        ids.insert(row, run.count(), 0);
+        labels.insert(row, run.count(), QString());
+        for (int i = 0; i < run.count(); i++) ids[row + i] = run.at(i);
+        endInsertRows();
+        row += run.count();
+    }
+    if (row < ids.count())
+    {
+        reset();
+        return;
+    }
+
+    //all / none or a loaded filter file might have flipped any of them
+    if (!ids.isEmpty()) emit dataChanged(index(0), index(ids.count() - 1), {Qt::CheckStateRole});
+}
+
+void FilterListModel::relabel()
+{
+    QSettings settings;
+    labeling = settings.value("Main/FilterLabeling", false).toBool();
+    labels.fill(QString());
+    if (!ids.isEmpty()) emit dataChanged(index(0), index(ids.count() - 1), {Qt::DisplayRole, Qt::ToolTipRole});
+}
+
+void FilterListModel::reset()
+{
+    const QMap<int, bool> now = frameModel->getFilterTable()->ids();
+    beginResetModel();
+    ids.clear();
+    ids.reserve(now.count());
+    for (QMap<int, bool>::const_iterator it = now.constBegin(); it != now.constEnd(); ++it)
+        ids.append(static_cast<uint32_t>(it.key()));
+    labels = QVector<QString>(ids.count());
+    endResetModel();
+}
@@ -0,0 +1,46 @@
+#ifndef FILTERLISTMODEL_H
+#define FILTERLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "canframemodel.h"
+
+/*
+ * The ID filter list of the main window as a list model straight over the frame model's CANFilterTable. It used to
+ * be a QListWidget that got cleared and refilled, an item and a settings lookup per ID, every time a new ID showed
+ * up. Now:
+ * - sync() only inserts the IDs it hasn't got yet. Anything else that changed is just the check states
+ * - the check state is read from the table whenever the view asks so it can't get out of step
+ * - labels (the ID plus the DBC message name with filter labeling on) are only made for rows the view draws and
+ *   then kept until relabel()
+ * - ticking a row sets the filter on the frame model and then emits filterToggled
+ */
+class FilterListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    FilterListModel(CANFrameModel *frameModel, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role) const;
+    bool setData(const QModelIndex &index, const QVariant &value, int role);
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+
+    uint32_t idAt(int row) const { return ids.at(row); }
+    void sync(); //catch up with the filter table
+    void relabel(); //the filter labeling setting or the DBC files changed
+
+signals:
+    void filterToggled(uint32_t id, bool on);
+
+private:
+    void reset();
+
+    CANFrameModel *frameModel;
+    QVector<uint32_t> ids; //same order as the table, by ID
+    mutable QVector<QString> labels; //parallel to ids. Null until the row has been drawn
+    bool labeling; //Main/FilterLabeling, read once per relabel instead of once per row
+};
+
+#endif // FILTERLISTMODEL_H
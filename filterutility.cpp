@@ -1,6 +1,7 @@
 #include "utility.h"
 #include "filterutility.h"
 #include "dbc/dbchandler.h"
+#include "bus_protocols/canidparts.h"
 #include <QSettings>
 
 uint32_t FilterUtility::getIdAsInt( QListWidgetItem * item )
@@ -24,17 +25,17 @@ QString FilterUtility::getId( QListWidgetItem * item )
 
 uint32_t FilterUtility::getGMLanArbitrationId(int32_t id)
 {
-    return (id  >> 13) & 0x1FFF;
+    return CANIdParts::gmlanArbitrationId(static_cast<uint32_t>(id));
 }
 
 uint32_t FilterUtility::getGMLanPriorityBits(int32_t id)
 {
-    return (id  >> 26) & 0x7;
+    return CANIdParts::priority(static_cast<uint32_t>(id));
 }
 
 uint32_t FilterUtility::getGMLanSenderId(int32_t id)
 {
-    return id & 0x1FFF;
+    return CANIdParts::gmlanSenderId(static_cast<uint32_t>(id));
 }
 
 QListWidgetItem * FilterUtility::createCheckableFilterItem(uint32_t id, bool checked, QListWidget* parent)
@@ -63,14 +64,22 @@ QListWidgetItem * FilterUtility::createCheckableBusFilterItem(uint32_t id, bool
 QListWidgetItem * FilterUtility::createFilterItem(uint32_t id, QListWidget* parent)
 {
     QSettings settings;
-    DBCHandler * dbcHandler = DBCHandler::getReference();
     QListWidgetItem *thisItem = new QListWidgetItem(parent);
+    QString tooltip;
+    thisItem->setText(filterText(id, settings.value("Main/FilterLabeling", false).toBool(), &tooltip));
+    if (!tooltip.isEmpty()) thisItem->setToolTip(tooltip);
+    return thisItem;
+}
+
+QString FilterUtility::filterText(uint32_t id, bool labeling, QString *tooltip)
+{
+    DBCHandler * dbcHandler = DBCHandler::getReference();
     QString filterItemName = Utility::formatCANID(id);
 
     //Note, there are multiple filter labeling preferences. There is one in main settings to globally
     //enable or disable them all. Then each loaded DBC file also can be selected on/off
     //Both must be enabled for you to see labeling.
-    if (settings.value("Main/FilterLabeling", false).toBool())
+    if (labeling)
     {
         // Filter labeling (show interpreted frame names next to the CAN addr ID)
         MatchingCriteria_t matchingCriteria;
@@ -82,16 +91,17 @@ QListWidgetItem * FilterUtility::createFilterItem(uint32_t id, QListWidget* pare
 
             // Create tooltip to show the whole name just in case it's too long to fit in the filter window.
             // Also if the matching criteria is set to GMLAN, show the Arbitration ID as well
-            QString tooltip;
-            if (matchingCriteria == GMLAN)
-                tooltip.append("0x" + QString::number(FilterUtility::getGMLanArbitrationId(id), 16).toUpper().rightJustified(4,'0') + ": ");
-            tooltip.append(msg->name);
-            thisItem->setToolTip(tooltip);
+            if (tooltip)
+            {
+                tooltip->clear();
+                if (matchingCriteria == GMLAN)
+                    tooltip->append("0x" + QString::number(FilterUtility::getGMLanArbitrationId(id), 16).toUpper().rightJustified(4,'0') + ": ");
+                tooltip->append(msg->name);
+            }
         }
     }
 
-    thisItem->setText(filterItemName);
-    return thisItem;
+    return filterItemName;
 }
 
 QListWidgetItem * FilterUtility::createBusFilterItem(uint32_t id, QListWidget* parent)
@@ -12,6 +12,8 @@ public:
     static QListWidgetItem * createCheckableFilterItem(uint32_t id, bool checked, QListWidget* parent=NULL);
     static QListWidgetItem * createBusFilterItem(uint32_t id, QListWidget* parent=NULL);   // if parent is given, add item automatically to listwidget
     static QListWidgetItem * createCheckableBusFilterItem(uint32_t id, bool checked, QListWidget* parent=NULL);
+    //the text for an ID in a filter list. With labeling on that's followed by the DBC message name, if any
+    static QString filterText(uint32_t id, bool labeling, QString *tooltip=NULL);
 
     static uint32_t getIdAsInt( QListWidgetItem * item );
     static QString getId( QListWidgetItem * item );
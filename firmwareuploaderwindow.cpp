@@ -1,9 +1,12 @@
 #include "firmwareuploaderwindow.h"
 #include "ui_firmwareuploaderwindow.h"
 #include "mainwindow.h"
+#include "pipelinetrace.h"
 
 #include <QFile>
 
+#include <algorithm>
+
 //You might wonder: Collin, what in the hell is this for? Firmware uploader? For what? I'm interested! Well, it's a custom
 //firmware uploader for a motor controller I built. Why would that be in this project. Cuz. It's not really relevant
 //to anyone else but might serve as a decent reference for a few things: How to make an uploader interface that runs over CAN,
@@ -11,7 +14,7 @@
 //for firmware updates and wouldn't need this specific code. But, it might be able to be turned into a UDS firmware uploader or downloader.
 //Note that this screen is specifically hidden by default because of it's oddball status. You have to re-enable it in mainwindow.cpp to see it.
 
-FirmwareUploaderWindow::FirmwareUploaderWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+FirmwareUploaderWindow::FirmwareUploaderWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::FirmwareUploaderWindow)
 {
@@ -22,6 +25,11 @@ FirmwareUploaderWindow::FirmwareUploaderWindow(const QVector<CANFrame> *frames,
     startedProcess = false;
     firmwareSize = 0;
     currentSendingPosition = 0;
+    totalChunks = 0;
+    nextToSend = 0;
+    windowSize = 1;
+    retransmits = 0;
+    ackLatency = 0.0;
     baseAddress = 0;
     bus = 0;
     modelFrames = frames;
@@ -32,8 +40,12 @@ FirmwareUploaderWindow::FirmwareUploaderWindow(const QVector<CANFrame> *frames,
     ui->txtBaseAddr->setText("0x100");
     updateProgress();
 
+    QSettings settings;
+    ui->spinWindow->setValue(settings.value("FirmwareUploader/Window", 1).toInt());
+
     timer = new QTimer();
-    timer->setInterval(100); //100ms without a reply will cause us to attempt a resend
+    timer->setTimerType(Qt::PreciseTimer);
+    timer->setInterval(10); //checks for chunks that went too long without a reply and sends them again
 
     connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
     connect(ui->btnLoadFile, SIGNAL(clicked(bool)), this, SLOT(handleLoadFile()));
@@ -51,11 +63,20 @@ FirmwareUploaderWindow::~FirmwareUploaderWindow()
 
 void FirmwareUploaderWindow::updateProgress()
 {
-    ui->lblProgress->setText(QString::number(currentSendingPosition * 4) + " of " + QString::number(firmwareSize) + " transferred");
+    int done = std::min(currentSendingPosition * 4, firmwareSize);
+    QString text = QString::number(done) + " of " + QString::number(firmwareSize) + " transferred";
+    //rate from what the device said it got, not from what went out
+    if (transferInProgress && clock.isValid() && clock.elapsed() > 0)
+    {
+        text += QString(" - %1 KB/s").arg(done / 1.024 / clock.elapsed(), 0, 'f', 1);
+        if (retransmits) text += ", " + QString::number(retransmits) + " resent";
+    }
+    ui->lblProgress->setText(text);
 }
 
 void FirmwareUploaderWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("FirmwareUploaderWindow::updatedFrames");
     //CANFrame thisFrame;
     if (numFrames == -1) //all frames deleted.
     {
@@ -67,7 +88,7 @@ void FirmwareUploaderWindow::updatedFrames(int numFrames)
     {
         /*
         //run through the supposedly new frames in order
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
         {
             thisFrame = modelFrames->at(i);
         }
@@ -76,11 +97,25 @@ void FirmwareUploaderWindow::updatedFrames(int numFrames)
 }
 
 void FirmwareUploaderWindow::gotTargettedFrame(CANFrame frame)
+{
+    gotTargettedFrames(QVector<CANFrame>{frame});
+}
+
+//all the acknowledgements of one drain, so whatever they make room for goes out in one batch
+void FirmwareUploaderWindow::gotTargettedFrames(const QVector<CANFrame> &frames)
+{
+    QList<CANFrame> toSend;
+    bool any = false;
+    for (const CANFrame &frame : frames) any |= handleReply(frame, toSend);
+    if (!toSend.isEmpty()) CANConManager::getInstance()->sendFrames(toSend, TX_BULK);
+    if (any && transferInProgress) updateProgress();
+}
+
+bool FirmwareUploaderWindow::handleReply(const CANFrame &frame, QList<CANFrame> &toSend)
 {
     const unsigned char *data = reinterpret_cast<const unsigned char *>(frame.payload().constData());
     int dataLen = frame.payload().count();
 
-    qDebug() << "FUW: Got targetted frame with id " << frame.frameId();
     if (frame.frameId() == (uint32_t)(baseAddress + 0x10) && (dataLen == 8) ) {
         qDebug() << "Start firmware reply";
         if ((data[0] == 0xAD) && (data[1] == 0xDE))
@@ -92,56 +127,100 @@ void FirmwareUploaderWindow::gotTargettedFrame(CANFrame frame)
                 {
                     if ((data[6] == ((token >> 16) & 0xFF)) && (data[7] == ((token >> 24) & 0xFF)))
                     {
+                        if (transferInProgress || totalChunks == 0) return true; //already going, or nothing to send
                         qDebug() << "starting firmware process";
-                        //MainWindow::getReference()->setTargettedID(baseAddress + 0x20);
                         transferInProgress = true;
-                        sendFirmwareChunk();
+                        currentSendingPosition = 0;
+                        nextToSend = 0;
+                        retransmits = 0;
+                        ackLatency = 0.0;
+                        acked.fill(false, totalChunks);
+                        sentAt.fill(-1, totalChunks);
+                        clock.start();
+                        fillWindow(toSend);
+                        timer->start();
                     }
                 }
             }
         }
+        return true;
     }
 
-    if (frame.frameId() == (uint32_t)(baseAddress + 0x20)) {
-        qDebug() << "Firmware reception success reply";
+    if (frame.frameId() == (uint32_t)(baseAddress + 0x20) && dataLen >= 2) {
+        if (!transferInProgress) return true;
         int seq = data[0] + (256 * data[1]);
-        if (seq == currentSendingPosition)
+        //anything outside the window is a late duplicate of something already taken care of
+        if (seq < currentSendingPosition || seq >= nextToSend || acked.testBit(seq)) return true;
+        acked.setBit(seq);
+
+        double latency = static_cast<double>(clock.elapsed() - sentAt[seq]);
+        ackLatency = (ackLatency == 0.0) ? latency : 0.875 * ackLatency + 0.125 * latency;
+
+        while (currentSendingPosition < totalChunks && acked.testBit(currentSendingPosition)) currentSendingPosition++;
+        if (currentSendingPosition >= totalChunks)
         {
-            currentSendingPosition++;
-            if (currentSendingPosition * 4 > firmwareSize || currentSendingPosition > 65535)
-            {
-                transferInProgress = false;
-                timer->stop();
-                handleStartStopTransfer();
-                ui->progressBar->setValue(100);
-                sendFirmwareEnding();
-            }
-            else
-            {
-                ui->progressBar->setValue((400 * currentSendingPosition) / firmwareSize);
-                updateProgress();
-                sendFirmwareChunk();
-            }
+            finishTransfer();
+            return true;
         }
+        fillWindow(toSend);
+        ui->progressBar->setValue((400 * currentSendingPosition) / std::max(1, firmwareSize));
+        return true;
     }
+    return false;
+}
+
+//chunks not sent yet, up to windowSize past the oldest one not acknowledged
+void FirmwareUploaderWindow::fillWindow(QList<CANFrame> &toSend)
+{
+    qint64 now = clock.elapsed();
+    while (nextToSend < totalChunks && nextToSend < currentSendingPosition + windowSize)
+    {
+        sentAt[nextToSend] = now;
+        toSend.append(firmwareChunk(nextToSend++));
+    }
+}
+
+void FirmwareUploaderWindow::finishTransfer()
+{
+    updateProgress(); //while the rate is still shown
+    transferInProgress = false;
+    timer->stop();
+    handleStartStopTransfer();
+    ui->progressBar->setValue(100);
+    sendFirmwareEnding();
 }
 
+//only the chunks that went too long without their own acknowledgement are sent again, not the whole window
 void FirmwareUploaderWindow::timerElapsed()
 {
-    sendFirmwareChunk(); //resend
+    if (!transferInProgress) return;
+    qint64 now = clock.elapsed();
+    //100ms was the only timeout there was and stays the longest. Fast devices get it sent again sooner
+    qint64 timeout = (ackLatency == 0.0) ? 100 : std::min<qint64>(100, std::max<qint64>(20, static_cast<qint64>(ackLatency * 3.0)));
+    QList<CANFrame> toSend;
+    for (int i = currentSendingPosition; i < nextToSend; i++)
+    {
+        if (acked.testBit(i) || now - sentAt[i] < timeout) continue;
+        sentAt[i] = now;
+        retransmits++;
+        toSend.append(firmwareChunk(i));
+    }
+    if (!toSend.isEmpty()) CANConManager::getInstance()->sendFrames(toSend, TX_BULK);
+    updateProgress();
 }
 
-void FirmwareUploaderWindow::sendFirmwareChunk()
+CANFrame FirmwareUploaderWindow::firmwareChunk(int position)
 {
     CANFrame output;
-    int firmwareLocation = currentSendingPosition * 4;
+    int firmwareLocation = position * 4;
     int xorByte = 0;
     output.setExtendedFrameFormat(false);
+    output.setFrameType(QCanBusFrame::DataFrame);
     QByteArray bytes(7,0);
     output.bus = bus;
     output.setFrameId(baseAddress + 0x16);
-    bytes[0] = currentSendingPosition & 0xFF;
-    bytes[1] = (currentSendingPosition >> 8) & 0xFF;
+    bytes[0] = position & 0xFF;
+    bytes[1] = (position >> 8) & 0xFF;
     bytes[2] = firmwareData[firmwareLocation++];
     bytes[3] = firmwareData[firmwareLocation++];
     bytes[4] = firmwareData[firmwareLocation++];
@@ -149,8 +228,7 @@ void FirmwareUploaderWindow::sendFirmwareChunk()
     for (int i = 0; i < 6; i++) xorByte ^= static_cast<unsigned char>(bytes[i]);
     bytes[6] = xorByte;
     output.setPayload(bytes);
-    CANConManager::getInstance()->sendFrame(output);
-    timer->start();
+    return output;
 }
 
 void FirmwareUploaderWindow::sendFirmwareEnding()
@@ -179,6 +257,9 @@ void FirmwareUploaderWindow::handleStartStopTransfer()
         token = Utility::ParseStringToNum(ui->txtToken->text());
         bus = ui->spinBus->value();
         baseAddress = Utility::ParseStringToNum(ui->txtBaseAddr->text());
+        windowSize = ui->spinWindow->value();
+        QSettings settings;
+        settings.setValue("FirmwareUploader/Window", windowSize);
         qDebug() << "Base address: " + QString::number(baseAddress);
         CANConManager::getInstance()->addTargettedFrame(bus, baseAddress + 0x10, 0x7FF, this);
         CANConManager::getInstance()->addTargettedFrame(bus, baseAddress + 0x20, 0x7FF, this);
@@ -198,10 +279,12 @@ void FirmwareUploaderWindow::handleStartStopTransfer()
         bytes[6] = (token >> 16) & 0xFF;
         bytes[7] = (token >> 24) & 0xFF;
         output.setPayload(bytes);
-        CANConManager::getInstance()->sendFrame(output);
+        CANConManager::getInstance()->sendFrame(output, TX_BULK);
     }
     else //stop anything in process
     {
+        transferInProgress = false;
+        timer->stop();
         ui->btnStartStop->setText("Start Upload");
         CANConManager::getInstance()->removeAllTargettedFrames(this);
     }
@@ -242,6 +325,10 @@ void FirmwareUploaderWindow::loadBinaryFile(QString filename)
 
     currentSendingPosition = 0;
     firmwareSize = firmwareData.length();
+    //chunks go up to and including the one at firmwareSize / 4, the device takes that as the end. Padded so the
+    //last of them never reads past the data
+    totalChunks = std::min(firmwareSize / 4 + 1, 65536);
+    firmwareData.append(QByteArray(totalChunks * 4 - firmwareSize, 0));
 
     updateProgress();
 
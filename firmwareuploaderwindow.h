@@ -1,9 +1,12 @@
 #ifndef FIRMWAREUPLOADERWINDOW_H
 #define FIRMWAREUPLOADERWINDOW_H
 
+#include <QBitArray>
 #include <QDialog>
+#include <QElapsedTimer>
 #include <QTimer>
 #include "can_structs.h"
+#include "canframestore.h"
 #include "connections/canconmanager.h"
 #include "utility.h"
 
@@ -16,11 +19,12 @@ class FirmwareUploaderWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit FirmwareUploaderWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit FirmwareUploaderWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~FirmwareUploaderWindow();
 
 public slots:
     void gotTargettedFrame(CANFrame frame);
+    void gotTargettedFrames(const QVector<CANFrame> &frames);
 
 private slots:
     void handleLoadFile();
@@ -31,19 +35,30 @@ private slots:
 private:
     void updateProgress();
     void loadBinaryFile(QString);
-    void sendFirmwareChunk();
+    bool handleReply(const CANFrame &frame, QList<CANFrame> &toSend); //true if it was a reply at all
+    CANFrame firmwareChunk(int position);
+    void fillWindow(QList<CANFrame> &toSend);
+    void finishTransfer();
     void sendFirmwareEnding();
 
     Ui::FirmwareUploaderWindow *ui;
     bool transferInProgress;
     bool startedProcess;
     int firmwareSize;
-    int currentSendingPosition;
+    int currentSendingPosition; //first chunk not acknowledged yet
+    int totalChunks;
+    int nextToSend; //first chunk never sent
+    int windowSize; //chunks allowed out without an acknowledgement
+    QBitArray acked; //of every chunk
+    QVector<qint64> sentAt; //clock ms each chunk last went out
+    QElapsedTimer clock;
+    int retransmits;
+    double ackLatency; //smoothed, ms. Sets how long a chunk gets before it's sent again
     int baseAddress;
     int bus;
     uint32_t token;
     QByteArray firmwareData;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     QTimer *timer;
 };
 
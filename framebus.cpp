@@ -0,0 +1,195 @@
+#include "framebus.h"
+#include "pipelinetrace.h"
+
+#include <QSet>
+#include <QThread>
+#include <algorithm>
+
+FrameBus::FrameBus(const CANFrameStore *store, QObject *parent) :
+    QObject(parent),
+    store(store),
+    cursor(store->baseSequence() + static_cast<quint64>(store->count())),
+    missed(0),
+    nextHandle(1)
+{
+}
+
+int FrameBus::subscribe(QObject *context, const Options &options, FrameHandler onFrames, ResetHandler onReset)
+{
+    Subscriber sub;
+    sub.handle = nextHandle++;
+    sub.context = context;
+    sub.options = options;
+    if (sub.options.sampleEvery < 1) sub.options.sampleEvery = 1;
+    sub.onFrames = onFrames;
+    sub.onReset = onReset;
+    subs.append(sub);
+
+    //only the first subscription of a context needs the hook
+    bool hooked = false;
+    for (int i = 0; i < subs.count() - 1; i++) hooked |= (subs[i].context == context);
+    if (!hooked && context->thread() == thread())
+        connect(context, &QObject::destroyed, this, [this, context]() { unsubscribeAll(context); });
+    return sub.handle;
+}
+
+void FrameBus::unsubscribe(int handle)
+{
+    for (int i = 0; i < subs.count(); i++)
+    {
+        if (subs[i].handle != handle) continue;
+        subs.removeAt(i);
+        return;
+    }
+}
+
+void FrameBus::unsubscribeAll(QObject *context)
+{
+    for (int i = subs.count() - 1; i >= 0; i--)
+    {
+        if (subs[i].context == context) subs.removeAt(i);
+    }
+}
+
+void FrameBus::setFilters(int handle, const QVector<FrameBusFilter> &filters)
+{
+    for (Subscriber &sub : subs)
+    {
+        if (sub.handle == handle) sub.options.filters = filters;
+    }
+}
+
+void FrameBus::replay(int handle)
+{
+    for (Subscriber &sub : subs)
+    {
+        if (sub.handle != handle) continue;
+        deliver(sub, 0, store->count());
+        break;
+    }
+}
+
+void FrameBus::publish()
+{
+    TRACE_SCOPE("FrameBus::publish");
+    const quint64 base = store->baseSequence();
+    const quint64 end = base + static_cast<quint64>(store->count());
+    if (cursor < base)
+    {
+        //published too slowly for the store. Those frames are gone
+        missed += base - cursor;
+        cursor = base;
+    }
+    if (cursor >= end) return;
+
+    const int first = static_cast<int>(cursor - base);
+    cursor = end;
+    //a handler can unsubscribe, even itself, so go by handle rather than position
+    QVector<int> handles;
+    handles.reserve(subs.count());
+    for (const Subscriber &sub : qAsConst(subs)) handles.append(sub.handle);
+    for (int handle : qAsConst(handles))
+    {
+        for (Subscriber &sub : subs)
+        {
+            if (sub.handle != handle) continue;
+            deliver(sub, first, store->count());
+            break;
+        }
+    }
+}
+
+void FrameBus::reset(ResetReason reason)
+{
+    const QVector<Subscriber> current = subs;
+    for (const Subscriber &sub : current)
+    {
+        if (!sub.onReset) continue;
+        if (sub.context->thread() == QThread::currentThread()) sub.onReset(reason);
+        else
+        {
+            ResetHandler handler = sub.onReset;
+            QMetaObject::invokeMethod(sub.context, [handler, reason]() { handler(reason); }, Qt::QueuedConnection);
+        }
+    }
+    for (Subscriber &sub : subs) sub.sampleCountdown.clear();
+    //everything in the store is new to the subscribers now, whichever way it got replaced
+    cursor = store->baseSequence();
+    publish();
+}
+
+void FrameBus::modelUpdated(int numFrames)
+{
+    if (numFrames == -1) reset(CLEARED);
+    else if (numFrames == -2) reset(REPLACED);
+    else publish();
+}
+
+bool FrameBus::accepts(const Subscriber &sub, const CANFrameRecord &rec) const
+{
+    if (sub.options.filters.isEmpty()) return true;
+    for (const FrameBusFilter &filter : sub.options.filters)
+    {
+        if (filter.matches(rec)) return true;
+    }
+    return false;
+}
+
+//rows first up to last of the store through the subscriber's filter and policy
+void FrameBus::deliver(Subscriber &sub, int first, int last)
+{
+    QVector<CANFrame> out;
+    switch (sub.options.delivery)
+    {
+    case EVERY_FRAME:
+        for (int i = first; i < last; i++)
+        {
+            if (accepts(sub, store->record(i))) out.append(store->at(i));
+        }
+        break;
+    case LATEST_PER_ID:
+    {
+        //walk backwards so the first row seen of each ID is its newest, then hand them over oldest first
+        QSet<uint64_t> seen;
+        QVector<int> rows;
+        for (int i = last - 1; i >= first; i--)
+        {
+            const CANFrameRecord &rec = store->record(i);
+            if (!accepts(sub, rec)) continue;
+            uint64_t key = CANFrameStore::idKey(rec.frameId(), rec.bus);
+            if (seen.contains(key)) continue;
+            seen.insert(key);
+            rows.append(i);
+        }
+        std::reverse(rows.begin(), rows.end());
+        out.reserve(rows.count());
+        for (int row : qAsConst(rows)) out.append(store->at(row));
+        break;
+    }
+    case SAMPLED:
+        for (int i = first; i < last; i++)
+        {
+            const CANFrameRecord &rec = store->record(i);
+            if (!accepts(sub, rec)) continue;
+            int &countdown = sub.sampleCountdown[CANFrameStore::idKey(rec.frameId(), rec.bus)];
+            if (countdown-- > 0) continue;
+            countdown = sub.options.sampleEvery - 1;
+            out.append(store->at(i));
+        }
+        break;
+    }
+    if (!out.isEmpty()) post(sub, out);
+}
+
+void FrameBus::post(Subscriber &sub, const QVector<CANFrame> &frames)
+{
+    if (sub.context->thread() == QThread::currentThread())
+    {
+        //copied in case the handler unsubscribes and takes sub with it
+        FrameHandler handler = sub.onFrames;
+        handler(frames);
+        return;
+    }
+    FrameHandler handler = sub.onFrames;
+    QMetaObject::invokeMethod(sub.context, [handler, frames]() { handler(frames); }, Qt::QueuedConnection);
+}
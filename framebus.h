@@ -0,0 +1,117 @@
+#ifndef FRAMEBUS_H
+#define FRAMEBUS_H
+
+#include <QHash>
+#include <QObject>
+#include <QVector>
+#include <functional>
+
+#include "can_structs.h"
+#include "canframestore.h"
+
+/*
+ * Hands out the frames the frame list takes in to whichever windows want them, instead of every window getting
+ * framesUpdated(count) and rescanning the tail of the model's store for itself.
+ *
+ * A window subscribes with the IDs and buses it cares about and how it wants them: every frame, only the newest
+ * frame of each ID since the last delivery, or one in every so many frames of each ID. Matching is done on the
+ * packed records so frames nobody wants are never turned into CANFrames. Each delivery is just the new matching
+ * frames, in order, once per GUI tick.
+ *
+ * The bus keeps its place in the store by sequence number so it isn't thrown by the store evicting old frames or
+ * by the frame list being sorted. When the frame list is cleared or replaced subscribers get a reset call first,
+ * then whatever is in the store now comes to them as new frames.
+ *
+ * Subscribing, unsubscribing and publishing are GUI thread only. Handlers are called on the thread of the context
+ * object they were subscribed with, straight away when that's the GUI thread and queued over otherwise. A context
+ * on the GUI thread is unsubscribed automatically when it's destroyed, one on another thread has to unsubscribe
+ * itself before it goes.
+ */
+
+//frames whose ID masked with mask equals id masked with mask. bus -1 is any bus
+struct FrameBusFilter
+{
+    quint32 id;
+    quint32 mask;
+    int bus;
+
+    static FrameBusFilter exact(quint32 id, int bus = -1) { return {id, CANFrameRecord::ID_MASK, bus}; }
+    static FrameBusFilter anyId(int bus = -1) { return {0, 0, bus}; }
+    inline bool matches(const CANFrameRecord &rec) const
+    {
+        return ((rec.frameId() ^ id) & mask) == 0 && (bus < 0 || bus == rec.bus);
+    }
+};
+
+class FrameBus : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Delivery
+    {
+        EVERY_FRAME,    //all matching frames
+        LATEST_PER_ID,  //newest matching frame of each ID / bus pair since the last delivery
+        SAMPLED         //the first frame of each ID / bus pair and then one in every sampleEvery
+    };
+
+    enum ResetReason
+    {
+        CLEARED,        //the old frames are gone. Whatever is in the store now gets delivered as new
+        REPLACED        //same frames but changed (timestamps normalized and such). All of them get delivered again
+    };
+
+    struct Options
+    {
+        QVector<FrameBusFilter> filters; //empty takes every frame
+        Delivery delivery = EVERY_FRAME;
+        int sampleEvery = 10;
+    };
+
+    typedef std::function<void(const QVector<CANFrame> &)> FrameHandler;
+    typedef std::function<void(ResetReason)> ResetHandler;
+
+    explicit FrameBus(const CANFrameStore *store, QObject *parent = nullptr);
+
+    //returns a handle for unsubscribe / setFilters / replay
+    int subscribe(QObject *context, const Options &options, FrameHandler onFrames, ResetHandler onReset = ResetHandler());
+    void unsubscribe(int handle);
+    void unsubscribeAll(QObject *context);
+    //changes what a subscription matches from the next delivery on
+    void setFilters(int handle, const QVector<FrameBusFilter> &filters);
+    //delivers every matching frame already in the store, through the subscription's delivery policy
+    void replay(int handle);
+
+    int subscriberCount() const { return subs.count(); }
+    quint64 missedFrames() const { return missed; } //evicted from the store before they could be published
+
+public slots:
+    //new frames in the store since the last call get delivered
+    void publish();
+    void reset(ResetReason reason);
+    //framesUpdated(int) from the main window. Counts are ignored apart from -1 and -2
+    void modelUpdated(int numFrames);
+
+private:
+    struct Subscriber
+    {
+        int handle;
+        QObject *context;
+        Options options;
+        FrameHandler onFrames;
+        ResetHandler onReset;
+        QHash<uint64_t, int> sampleCountdown; //frames of each ID to skip before the next sample
+    };
+
+    bool accepts(const Subscriber &sub, const CANFrameRecord &rec) const;
+    void deliver(Subscriber &sub, int first, int last);
+    void post(Subscriber &sub, const QVector<CANFrame> &frames);
+
+    const CANFrameStore *store;
+    QVector<Subscriber> subs;
+    quint64 cursor; //sequence number of the first frame not yet published
+    quint64 missed;
+    int nextHandle;
+};
+
+#endif // FRAMEBUS_H
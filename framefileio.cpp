@@ -1,19 +1,56 @@
 #include "framefileio.h"
 
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
 #include <QMessageBox>
 #include <QProgressDialog>
 #include <QDateTime>
 #include <QRegularExpression>
+#include <QSaveFile>
 #include <QtEndian>
 #include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInteger>
+#include <QTimer>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <vector>
+#include <cstring>
 #include "pcaplite.h"
 
 #include "utility.h"
 #include "blfhandler.h"
-
-QFile FrameFileIO::continuousFile;
+#include "compressedlog.h"
+#include "binarycapture.h"
+#include "utils/lfqueue.h"
+#include "textlogindex.h"
+#include "lograngedialog.h"
+
+//how much of a file autoDetectLoadFile reads for the probes to look at
+#define AUTODETECT_SAMPLE_BYTES 16384
+
+//frames that can wait between the GUI thread and the continuous log writer before new ones get dropped
+#define CONTINUOUS_QUEUE_FRAMES 131072
+//frames the writer formats before it looks at the rotation limits again
+#define CONTINUOUS_BATCH_FRAMES 4096
+//how long the writer sleeps when the queue is empty and nobody wakes it
+#define CONTINUOUS_POLL_MS 20
+
+ContinuousLogger *FrameFileIO::continuousLogger = nullptr;
+QFile FrameFileIO::spillFile;
+BinaryCaptureWriter *FrameFileIO::spillBinary = nullptr;
 
 struct TeslaAPCANRecord
 {
@@ -28,124 +65,885 @@ struct TeslaAPCANRecord
     #pragma pack(pop)
 };
 
-FrameFileIO::FrameFileIO()
+//Collects records for one block and writes it out once it fills up. Shared by the one shot save and continuous logging
+class BinaryCaptureWriter
 {
-}
+public:
+    explicit BinaryCaptureWriter(QFileDevice *file) : file(file), totalFrames(0)
+    {
+        records.reserve(BINARY_FRAMES_PER_BLOCK);
+        resetBlock();
+    }
 
-bool FrameFileIO::saveFrameFile(QString &fileName, const QVector<CANFrame>* frameCache)
-{
-    QString filename;
-    QFileDialog dialog(qApp->activeWindow());
-    QSettings settings;
-    bool result = false;
+    bool begin()
+    {
+        BinaryFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BINARY_FILE_MAGIC, sizeof(header.magic));
+        header.byteOrder = BINARY_BYTE_ORDER;
+        header.version = BINARY_VERSION;
+        header.recordSize = sizeof(CANFrameRecord);
+        header.framesPerBlock = BINARY_FRAMES_PER_BLOCK;
+        return file->write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+    }
 
-    QStringList filters;
-    filters.append(QString(tr("GVRET Logs (*.csv *.CSV)")));
-    filters.append(QString(tr("CRTD Logs (*.crt *.crtd *.CRT *.CRTD)")));
-    filters.append(QString(tr("Generic ID/Data CSV (*.csv *.CSV)")));
-    filters.append(QString(tr("BusMaster Log (*.log *.LOG)")));
-    filters.append(QString(tr("Microchip Log (*.can *.CAN *.log *.LOG)")));
-    filters.append(QString(tr("Vector Trace Files (*.trace *.TRACE)")));
-    filters.append(QString(tr("IXXAT MiniLog (*.csv *.CSV)")));
-    filters.append(QString(tr("CAN-DO Log (*.can *.avc *.evc *.qcc *.CAN *.AVC *.EVC *.QCC)")));
-    filters.append(QString(tr("Vehicle Spy (*.csv *.CSV)")));
-    filters.append(QString(tr("Candump/Kayak (*.log)")));
-    filters.append(QString(tr("Cabana Log (*.csv *.CSV)")));
-    filters.append(QString(tr("CANalyzer Ascii Log (*.asc *.ASC)")));
-    filters.append(QString(tr("CARBUS Analyzer (*.trc *.TRC)")));
+    bool addFrame(const CANFrame &frame)
+    {
+        CANFrameRecord rec;
+        rec.setFrom(frame);
+        return addRecord(rec, reinterpret_cast<const uint8_t *>(frame.payload().constData()));
+    }
 
-    dialog.setDirectory(settings.value("FileIO/LoadSaveDirectory", dialog.directory().path()).toString());
-    dialog.setFileMode(QFileDialog::AnyFile);
-    dialog.setNameFilters(filters);
-    dialog.setViewMode(QFileDialog::Detail);
-    dialog.setAcceptMode(QFileDialog::AcceptSave);
+    //payload is only read for FD records, inline ones already carry theirs
+    bool addRecord(CANFrameRecord rec, const uint8_t *payload)
+    {
+        if (!rec.isInline())
+        {
+            rec.fdSlot = block.fdCount++;
+            int pos = fdBytes.count();
+            fdBytes.resize(pos + CANFrameRecord::MAX_BYTES);
+            memset(fdBytes.data() + pos, 0, CANFrameRecord::MAX_BYTES);
+            memcpy(fdBytes.data() + pos, payload, rec.len);
+        }
+
+        if (records.isEmpty()) block.firstTimestamp = rec.timestamp;
+        block.lastTimestamp = rec.timestamp;
+        if (rec.frameId() < block.idMin) block.idMin = rec.frameId();
+        if (rec.frameId() > block.idMax) block.idMax = rec.frameId();
+        int bit = binaryBloomBit(rec.frameId());
+        block.idBloom[bit / 64] |= (1ull << (bit % 64));
+
+        records.append(rec);
+        if (records.count() >= BINARY_FRAMES_PER_BLOCK) return flushBlock();
+        return true;
+    }
 
-    if (dialog.exec() == QDialog::Accepted)
+    //writes whatever is pending as a (possibly short) block
+    bool flushBlock()
     {
-        filename = dialog.selectedFiles()[0];
+        if (records.isEmpty()) return true;
+        block.frameCount = static_cast<uint32_t>(records.count());
 
-        QProgressDialog progress(qApp->activeWindow());
+        BinaryIndexEntry entry;
+        entry.offset = static_cast<uint64_t>(file->pos());
+        entry.header = block;
+        index.append(entry);
+        totalFrames += block.frameCount;
+
+        bool ok = file->write(reinterpret_cast<const char *>(&block), sizeof(block)) == sizeof(block);
+        qint64 recordBytes = static_cast<qint64>(records.count()) * sizeof(CANFrameRecord);
+        ok &= file->write(reinterpret_cast<const char *>(records.constData()), recordBytes) == recordBytes;
+        if (!fdBytes.isEmpty())
+            ok &= file->write(reinterpret_cast<const char *>(fdBytes.constData()), fdBytes.count()) == fdBytes.count();
+
+        records.clear();
+        fdBytes.clear();
+        resetBlock();
+        return ok;
+    }
+
+    //extra, if there is any, goes in as the extra section between the last block and the index
+    bool finish(const QByteArray &extra = QByteArray())
+    {
+        bool ok = flushBlock();
+
+        if (!extra.isEmpty())
+        {
+            BinaryExtraHeader extraHeader;
+            memset(&extraHeader, 0, sizeof(extraHeader));
+            memcpy(extraHeader.magic, BINARY_EXTRA_MAGIC, sizeof(extraHeader.magic));
+            extraHeader.length = static_cast<uint64_t>(extra.size());
+            uint64_t extraOffset = static_cast<uint64_t>(file->pos());
+            static const char padding[8] = {0};
+            int padBytes = (8 - (extra.size() % 8)) % 8;
+            ok &= file->write(reinterpret_cast<const char *>(&extraHeader), sizeof(extraHeader)) == sizeof(extraHeader);
+            ok &= file->write(extra) == extra.size();
+            if (padBytes) ok &= file->write(padding, padBytes) == padBytes;
+
+            qint64 resume = file->pos();
+            ok &= file->seek(offsetof(BinaryFileHeader, extraOffset));
+            ok &= file->write(reinterpret_cast<const char *>(&extraOffset), sizeof(extraOffset)) == sizeof(extraOffset);
+            ok &= file->seek(resume);
+        }
+
+        BinaryFileTrailer trailer;
+        memset(&trailer, 0, sizeof(trailer));
+        trailer.indexOffset = static_cast<uint64_t>(file->pos());
+        trailer.totalFrames = totalFrames;
+        trailer.blockCount = static_cast<uint32_t>(index.count());
+        memcpy(trailer.magic, BINARY_INDEX_MAGIC, sizeof(trailer.magic));
+
+        qint64 indexBytes = static_cast<qint64>(index.count()) * sizeof(BinaryIndexEntry);
+        if (indexBytes > 0)
+            ok &= file->write(reinterpret_cast<const char *>(index.constData()), indexBytes) == indexBytes;
+        ok &= file->write(reinterpret_cast<const char *>(&trailer), sizeof(trailer)) == sizeof(trailer);
+        return ok;
+    }
+
+private:
+    void resetBlock()
+    {
+        memset(&block, 0, sizeof(block));
+        block.magic = BINARY_BLOCK_MAGIC;
+        block.idMin = CANFrameRecord::ID_MASK;
+    }
+
+    QFileDevice *file;
+    BinaryBlockHeader block;
+    QVector<CANFrameRecord> records;
+    QVector<uint8_t> fdBytes;
+    QVector<BinaryIndexEntry> index;
+    quint64 totalFrames;
+};
+
+//Loading progress of the parallel text loader in 1/1000ths. Written by the workers, read by the load dialog.
+static QAtomicInt textLoadProgress;
+
+//Modal progress dialog for the length of a load. Loaders that parse on the thread pool fill the bar in, the rest
+//leave it spinning
+class TextLoadProgress
+{
+public:
+    explicit TextLoadProgress(const QString &label) : progress(qApp->activeWindow())
+    {
         progress.setWindowModality(Qt::WindowModal);
-        progress.setLabelText("Saving file...");
+        progress.setLabelText(label);
         progress.setCancelButton(nullptr);
         progress.setRange(0,0);
         progress.setMinimumDuration(0);
         progress.show();
 
+        textLoadProgress.storeRelaxed(0);
+        QProgressDialog *bar = &progress;
+        QObject::connect(&timer, &QTimer::timeout, &progress, [bar]()
+        {
+            int permille = textLoadProgress.loadRelaxed();
+            if (permille <= 0) return;
+            if (bar->maximum() == 0) bar->setRange(0, 1000);
+            bar->setValue(permille);
+        });
+        timer.start(100);
         qApp->processEvents();
+    }
+    ~TextLoadProgress() { progress.cancel(); }
+
+private:
+    QProgressDialog progress;
+    QTimer timer;
+};
+
+//What the load that's running keeps, see FrameLoadOptions. Null loads every frame. Loaders hand each frame to
+//keepFrame instead of appending it themselves and check the cheap parts (time, ID) earlier where they can.
+//One per thread so loads on different threads (the command line tool runs several at once) keep their own
+static thread_local FrameLoadFilter *loadFilter = nullptr;
+
+static inline void keepFrame(QVector<CANFrame> *frames, const CANFrame &frame)
+{
+    if (!loadFilter || loadFilter->keep(frame)) frames->append(frame);
+}
+
+//sets loadFilter for as long as it's around
+class LoadFilterScope
+{
+public:
+    explicit LoadFilterScope(FrameLoadFilter *filter) : previous(loadFilter) { loadFilter = filter; }
+    ~LoadFilterScope() { loadFilter = previous; }
+
+private:
+    FrameLoadFilter *previous;
+};
+
+//Saving progress in 1/1000ths and the save dialog's cancel button. The savers run on a worker thread, see saveFrameFile
+static QAtomicInt saveProgress;
+static QAtomicInt saveCancel;
+
+//the savers call this for every frame. Keeps the progress up to date and tells them to stop if saving was cancelled
+static bool saveStopped(int idx, int count)
+{
+    if ((idx & 4095) != 0) return false;
+    saveProgress.storeRelaxed(count > 0 ? static_cast<int>(static_cast<qint64>(idx) * 1000 / count) : 0);
+    //called straight from the GUI thread (not through saveFrameFile) it has to keep the GUI going itself
+    if (QThread::currentThread() == qApp->thread()) qApp->processEvents();
+    return saveCancel.loadRelaxed() != 0;
+}
+
+#define SAVE_BUFFER_SIZE 1048576
+
+/*
+ * What the text savers write to. Lines are formatted straight into one byte buffer with the Utility::write*
+ * functions, and the buffer is written a megabyte at a time. Formatting every field with QString::number and
+ * writing it separately was where nearly all the time saving went.
+ */
+class SaveBuffer
+{
+public:
+    explicit SaveBuffer(QIODevice *out) : out(out)
+    {
+        data.reserve(SAVE_BUFFER_SIZE + 1024);
+    }
+    ~SaveBuffer() { flush(); }
+
+    void put(char c) { data.append(c); }
+    void put(const char *text) { data.append(text); }
+    void put(const QByteArray &text) { data.append(text); }
+    void putByte(uint8_t value)
+    {
+        char text[2];
+        data.append(text, static_cast<int>(Utility::writeByteAsHex(text, value) - text));
+    }
+    //upper case, zero padded to digits
+    void putHex(uint32_t value, int digits)
+    {
+        char text[UTILITY_FORMAT_CHARS];
+        data.append(text, static_cast<int>(Utility::writeHex(text, value, digits) - text));
+    }
+    void putDec(int64_t value)
+    {
+        char text[UTILITY_FORMAT_CHARS];
+        data.append(text, static_cast<int>(Utility::writeSignedDecimal(text, value) - text));
+    }
+    //microseconds as seconds with 0 to 6 digits after the point, rounded like QString::number(x, 'f', precision)
+    //would and right justified to width
+    void putSeconds(int64_t micros, int precision, int width = 0)
+    {
+        char text[UTILITY_FORMAT_CHARS];
+        int len = static_cast<int>(Utility::writeFixed(text, micros, 6, precision) - text);
+        if (width > len) data.append(width - len, ' ');
+        data.append(text, len);
+    }
+    //call once a line is done
+    void lineDone()
+    {
+        if (data.size() >= SAVE_BUFFER_SIZE) flush();
+    }
+    bool flush()
+    {
+        if (!data.isEmpty() && out->write(data) != data.size()) ok = false;
+        data.clear();
+        return ok;
+    }
+    bool isOk() const { return ok; }
+
+private:
+    QIODevice *out;
+    QByteArray data;
+    bool ok = true;
+};
 
-        if (dialog.selectedNameFilter() == filters[0])
+//one line of a GVRET CSV file, shared by saveNativeCSVFile and continuous logging
+static void putNativeCSVLine(SaveBuffer &out, const CANFrame &frame)
+{
+    const QByteArray payload = frame.payload();
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(payload.constData());
+    int dataLen = payload.count();
+
+    out.putDec(frame.timeStamp().microSeconds());
+    out.put(',');
+    out.putHex(frame.frameId(), 8);
+    out.put(',');
+    out.put(frame.hasExtendedFrameFormat() ? "true," : "false,");
+    out.put(frame.isReceived ? "Rx," : "Tx,");
+    out.putDec(frame.bus);
+    out.put(',');
+    out.putDec(dataLen);
+    out.put(',');
+    //classic frames are padded out to the D1..D8 columns, CAN-FD ones just keep going past them
+    int columns = qMax(dataLen, 8);
+    for (int temp = 0; temp < columns; temp++)
+    {
+        if (temp < dataLen) out.putByte(data[temp]);
+        else out.put("00");
+        out.put(',');
+    }
+    out.put('\n');
+    out.lineDone();
+}
+
+/*
+ * One slice of a text log handed to a pool thread. Every worker gets its own copy of the line parser and its own
+ * output vector so nothing is shared while parsing. Parsers have to be plain data (no QRegularExpression and the
+ * like) so copies don't end up sharing anything behind the scenes. When the log is being indexed each worker also
+ * builds the index blocks for its own slice.
+ */
+template <typename Parser>
+class LineChunkWorker : public QRunnable
+{
+public:
+    LineChunkWorker(const char *fileStart, const char *begin, const char *end, const Parser &prototype,
+                    QAtomicInteger<qint64> *bytesDone, bool indexing, const FrameLoadOptions *options)
+        : parser(prototype), fileStart(fileStart), begin(begin), end(end), bytesDone(bytesDone), indexing(indexing),
+          options(options)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        CANFrame thisFrame;
+        const char *pos = begin;
+        const char *lastReport = begin;
+        while (pos < end)
         {
-            if (!filename.contains('.')) filename += ".csv";
-            result = saveNativeCSVFile(filename, frameCache);
+            const char *eol = static_cast<const char *>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+            if (!eol) eol = end;
+            //no copy here, parsers that need to modify the line make their own
+            QByteArray line = QByteArray::fromRawData(pos, static_cast<int>(eol - pos));
+            const char *next = (eol < end) ? eol + 1 : end;
+            if (parser.parseLine(line, thisFrame))
+            {
+                if (indexing) index.add(pos - fileStart, next - fileStart, thisFrame);
+                if (!options || options->matches(thisFrame)) frames.append(thisFrame);
+            }
+            pos = next;
+            if (pos - lastReport > 65536)
+            {
+                bytesDone->fetchAndAddRelaxed(pos - lastReport);
+                lastReport = pos;
+            }
         }
-        if (dialog.selectedNameFilter() == filters[1])
+        bytesDone->fetchAndAddRelaxed(pos - lastReport);
+        if (indexing) index.finish();
+    }
+
+    QVector<CANFrame> frames;
+    Parser parser;
+    TextIndexBuilder index;
+
+private:
+    const char *fileStart;
+    const char *begin;
+    const char *end;
+    QAtomicInteger<qint64> *bytesDone;
+    bool indexing;
+    const FrameLoadOptions *options; //decimation is left to the caller, it needs the frames in file order
+};
+
+/*
+ * Line oriented formats where every line stands on its own can be loaded with this instead of a readLine loop.
+ * The file is mapped (or read in one go), cut into chunks at line boundaries and the chunks are parsed on a thread
+ * pool. The results get stitched back together in file order. The calling thread just waits and keeps the GUI
+ * alive while the workers report how far they've got through textLoadProgress.
+ *
+ * Giving the format lets the log have a sidecar index (see TextLogIndex). A full parse writes one if there isn't an
+ * up to date one already. With loadFilter set only the frames it keeps come out and, when there is an index,
+ * only the blocks that can hold any of them get read at all.
+ */
+template <typename Parser>
+static bool loadLinesInParallel(const QString &filename, int headerLines, const Parser &prototype,
+                                QVector<CANFrame> *frames, bool &foundErrors,
+                                TextLogFormat format = TextLogFormat::NONE)
+{
+    const FrameLoadOptions *options = loadFilter ? &loadFilter->options : nullptr;
+
+    QFile inFile(filename);
+    QByteArray fallback;
+
+    if (!inFile.open(QIODevice::ReadOnly)) return false;
+
+    qint64 size = inFile.size();
+    const char *data = nullptr;
+    uchar *mapped = (size > 0) ? inFile.map(0, size) : nullptr;
+    if (mapped) data = reinterpret_cast<const char *>(mapped);
+    else
+    {
+        fallback = inFile.readAll();
+        data = fallback.constData();
+        size = fallback.size();
+    }
+    const char *end = data + size;
+
+    const char *start = data;
+    for (int i = 0; i < headerLines && start < end; i++)
+    {
+        const char *eol = static_cast<const char *>(memchr(start, '\n', static_cast<size_t>(end - start)));
+        start = eol ? eol + 1 : end;
+    }
+
+    //inflated copies of compressed logs are gone again after loading so there's no point indexing them
+    if (QFileInfo(filename).absolutePath() == QDir::temp().absolutePath()) format = TextLogFormat::NONE;
+
+    QSettings settings;
+    TextLogIndex index;
+    bool indexed = format != TextLogFormat::NONE && index.load(filename, format);
+    bool indexing = format != TextLogFormat::NONE && !indexed
+            && (options || settings.value("FileIO/TextLogIndex", true).toBool());
+
+    //the stretches of the file to parse. All of it unless the index can narrow things down
+    QVector<QPair<const char *, const char *>> ranges;
+    if (indexed && options && !options->isEverything())
+    {
+        for (int b : index.blocksFor(*options))
         {
-            if (!filename.contains('.')) filename += ".txt";
-            result = saveCRTDFile(filename, frameCache);
+            const TextIndexBlock &block = index.blocks[b];
+            const char *blockStart = data + qBound<qint64>(0, block.offset, size);
+            const char *blockEnd = data + qBound<qint64>(0, block.offset + block.length, size);
+            //neighbours get read as one stretch, whatever was between them is just lines with no frames
+            if (!ranges.isEmpty() && blockStart - ranges.last().second < 4096) ranges.last().second = blockEnd;
+            else ranges.append(qMakePair(blockStart, blockEnd));
         }
-        if (dialog.selectedNameFilter() == filters[2])
+    }
+    else ranges.append(qMakePair(start, end));
+
+    //a few chunks per thread so one slow chunk doesn't hold everyone up, but not so small they aren't worth it
+    int threads = qMax(1, QThread::idealThreadCount());
+    qint64 total = 0;
+    for (const auto &range : ranges) total += range.second - range.first;
+    qint64 chunkSize = qMax<qint64>(total / (threads * 4) + 1, 1 << 20);
+
+    QAtomicInteger<qint64> bytesDone(0);
+    std::vector<std::unique_ptr<LineChunkWorker<Parser>>> workers;
+    for (const auto &range : ranges)
+    {
+        const char *pos = range.first;
+        while (pos < range.second)
         {
-            if (!filename.contains('.')) filename += ".csv";
-            result = saveGenericCSVFile(filename, frameCache);
+            const char *chunkEnd = range.second;
+            if (range.second - pos > chunkSize)
+            {
+                const char *eol = static_cast<const char *>(memchr(pos + chunkSize, '\n', static_cast<size_t>(range.second - pos - chunkSize)));
+                chunkEnd = eol ? eol + 1 : range.second;
+            }
+            workers.emplace_back(new LineChunkWorker<Parser>(data, pos, chunkEnd, prototype, &bytesDone, indexing, options));
+            pos = chunkEnd;
         }
-        if (dialog.selectedNameFilter() == filters[3])
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    textLoadProgress.storeRelaxed(0);
+    for (auto &worker : workers) pool.start(worker.get());
+
+    total = qMax<qint64>(total, 1);
+    while (!pool.waitForDone(50))
+    {
+        textLoadProgress.storeRelaxed(static_cast<int>(bytesDone.loadRelaxed() * 1000 / total));
+        qApp->processEvents();
+    }
+    textLoadProgress.storeRelaxed(1000);
+
+    int firstNew = frames->count();
+    int totalFrames = firstNew;
+    for (auto &worker : workers) totalFrames += worker->frames.count();
+    frames->reserve(totalFrames);
+    for (auto &worker : workers)
+    {
+        frames->append(worker->frames);
+        worker->frames.clear();
+        if (worker->parser.foundErrors) foundErrors = true;
+    }
+
+    if (options && options->decimate > 1)
+    {
+        int kept = firstNew;
+        for (int i = firstNew; i < frames->count(); i++)
+            if (loadFilter->decimated(frames->at(i))) (*frames)[kept++] = frames->at(i);
+        frames->resize(kept);
+    }
+
+    if (indexing)
+    {
+        QVector<const TextIndexBuilder *> parts;
+        for (auto &worker : workers) parts.append(&worker->index);
+        TextIndexBuilder::merge(format, parts).save(filename);
+    }
+
+    if (mapped) inFile.unmap(mapped);
+    inFile.close();
+    return true;
+}
+
+//GVRET native CSV. Lines without a usable timestamp come out with -1 and get numbered afterward on one thread
+struct NativeCSVLineParser
+{
+    int fileVersion = 1;
+    bool foundErrors = false;
+
+    bool parseLine(const QByteArray &rawLine, CANFrame &thisFrame)
+    {
+        QByteArray line = rawLine.simplified();
+        if (line.length() <= 2) return false;
+
+        QList<QByteArray> tokens = line.split(',');
+        if (tokens.length() < 5)
         {
-            if (!filename.contains('.')) filename += ".log";
-            result = saveLogFile(filename, frameCache);
+            foundErrors = true;
+            return false;
+        }
+
+        if (tokens[0].length() > 3)
+        {
+            thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, tokens[0].toULongLong()));
+        }
+        else
+        {
+            thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, -1));
+        }
+
+        thisFrame.setFrameId(tokens[1].toUInt(nullptr, 16));
+        if (tokens[2].toUpper().contains("TRUE")) thisFrame.setExtendedFrameFormat(true);
+            else thisFrame.setExtendedFrameFormat(false);
+
+        //fix for faulty files that fail to set the extended flag when they should
+        if (thisFrame.frameId() > 0x7FF) thisFrame.setExtendedFrameFormat(true);
+
+        thisFrame.setFrameType(QCanBusFrame::DataFrame);
+
+        if (fileVersion == 1)
+        {
+            thisFrame.isReceived = true;
+            thisFrame.bus = tokens[3].toInt();
+            int lng = tokens[4].toInt();
+            if (lng > 64) lng = 64;
+            if (lng < 0) lng = 0;
+            if (lng + 5 > tokens.length()) lng = tokens.length() - 5;
+            thisFrame.setFlexibleDataRateFormat(lng > 8);
+            QByteArray bytes(lng, 0);
+            for (int d = 0; d < lng; d++)
+                bytes[d] = static_cast<char>(tokens[5 + d].toInt(nullptr, 16));
+            thisFrame.setPayload(bytes);
+        }
+        else if (fileVersion == 2)
+        {
+            if (tokens.length() < 6)
+            {
+                foundErrors = true;
+                return false;
+            }
+            if (tokens[3].length() > 0 && tokens[3].at(0) == 'R') thisFrame.isReceived = true;
+            else thisFrame.isReceived = false;
+            thisFrame.bus = tokens[4].toInt();
+            int lng = tokens[5].toInt();
+            if (lng > 64) lng = 64;
+            if (lng < 0) lng = 0;
+            if (lng + 6 > tokens.length()) lng = tokens.length() - 6;
+            thisFrame.setFlexibleDataRateFormat(lng > 8);
+            QByteArray bytes(lng, 0);
+            for (int d = 0; d < lng; d++)
+                bytes[d] = static_cast<char>(tokens[6 + d].toInt(nullptr, 16));
+            thisFrame.setPayload(bytes);
         }
-        if (dialog.selectedNameFilter() == filters[4])
+        return true;
+    }
+};
+
+struct CRTDLineParser
+{
+    bool foundErrors = false;
+
+    bool parseLine(const QByteArray &rawLine, CANFrame &thisFrame)
+    {
+        QByteArray line = rawLine.simplified();
+        if (line.length() <= 2) return false;
+
+        QList<QByteArray> tokens = line.split(' ');
+        if (tokens.length() <= 2)
         {
-            if (!filename.contains('.')) filename += ".log";
-            result = saveMicrochipFile(filename, frameCache);
+            foundErrors = true;
+            return false;
         }
 
-        if (dialog.selectedNameFilter() == filters[5])
+        int multiplier;
+        int idxOfDecimal = tokens[0].indexOf('.');
+        if (idxOfDecimal > -1) {
+            //This program deals in microsecond so turn the value into microseconds
+            multiplier = 1000000; //turn the decimal into full microseconds
+        }
+        else
         {
-            if (!filename.contains('.')) filename += ".trace";
-            result = saveTraceFile(filename, frameCache);
+            multiplier = 1; //special case. Assume no decimal means microseconds
         }
+        thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<int64_t>((tokens[0].toDouble() * multiplier))));
+        thisFrame.bus = 0;
+        char firstChar = tokens[1].left(1)[0];
+        if (firstChar >= '1' && firstChar <= '9')
+        {
+            thisFrame.bus = tokens[1].left(1)[0] - '1';
+            tokens[1].remove(0,1); // Remove leading digit (bus number)
+            firstChar = tokens[1].left(1)[0];
+        }
+        if (firstChar != 'R' && firstChar != 'T') return false;
 
-        if (dialog.selectedNameFilter() == filters[6])
+        thisFrame.setFrameId(static_cast<uint32_t>(tokens[2].toInt(nullptr, 16)));
+        if (tokens[1] == "R29" || tokens[1] == "T29") thisFrame.setExtendedFrameFormat(true);
+            else thisFrame.setExtendedFrameFormat(false);
+        if (firstChar == 'T') thisFrame.isReceived = false;
+            else thisFrame.isReceived = true;
+        QByteArray bytes(tokens.length() - 3, 0);
+        thisFrame.setFrameType(QCanBusFrame::DataFrame);
+        for (int d = 0; d < bytes.length(); d++)
         {
-            if (!filename.contains('.')) filename += ".csv";
-            result = saveIXXATFile(filename, frameCache);
+            if (tokens[d + 3] != "")
+            {
+                bytes[d] = static_cast<char>(tokens[d + 3].toInt(nullptr, 16));
+            }
+            else bytes[d] = 0;
         }
+        thisFrame.setPayload(bytes);
+        return true;
+    }
+};
 
-        if (dialog.selectedNameFilter() == filters[7])
+/*
+ * candump -L / kayak. Two flavors:
+ * (1551774790.942758) can1 7A8#F4DCD1830E020000
+ * (1551774790.942758) can1 7A8 [8] F4 DC D1 83 0E 02 00 00
+ * The token checks here used to be regular expressions. They're spelled out by hand so the parser stays plain data.
+ */
+struct CanDumpLineParser
+{
+    bool foundErrors = false;
+
+    bool parseLine(const QByteArray &rawLine, CANFrame &thisFrame)
+    {
+        bool ret;
+        QByteArray line = rawLine.toUpper();
+        if (line.length() < 1) return false;
+
+        /* tokenize */
+        QList<QByteArray> tokens = line.simplified().split(' ');
+        if (tokens.count() < 3) return false;
+
+        /* timestamp, must be exactly (something) */
+        const QByteArray &timeToken = tokens[0];
+        if (timeToken.length() < 3 || !timeToken.startsWith('(') || !timeToken.endsWith(')')) return false;
+
+        //Sort out the bus. Skip the can or vcan text and take whatever number comes after it
+        const QByteArray &busToken = tokens[1];
+        int busNum = 0;
+        for (int i = 0; i < busToken.length(); i++)
         {
-            if (!filename.contains('.')) filename += ".can";
-            result = saveCANDOFile(filename, frameCache);
+            if (busToken[i] >= '0' && busToken[i] <= '9')
+            {
+                busNum = atoi(busToken.constData() + i);
+                break;
+            }
         }
+        thisFrame.bus = busNum;
+
+        thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, (uint64_t)(timeToken.mid(1, timeToken.length() - 2).toDouble(&ret) * (double)1000000.0)));
+        if (!ret) return false;
 
-        if (dialog.selectedNameFilter() == filters[8])
+        if (line.contains('[')) //the expanded format (second one from the above list)
         {
-            if (!filename.contains('.')) filename += ".csv";
-            result = saveVehicleSpyFile(filename, frameCache);
+            //(1551774790.942758) can1 7A8 [8] F4 DC D1 83 0E 02 00 00
+            //     0               1     2   3  4 5  6  7  8  9  10 11
+            if (tokens.count() < 4 || tokens[3].length() < 2) return false;
+            thisFrame.setFrameId(tokens[2].toLong(nullptr, 16));
+            if (thisFrame.frameId() > 0x7FF) thisFrame.setExtendedFrameFormat(true);
+            else thisFrame.setExtendedFrameFormat(false);
+            thisFrame.setFrameType(QCanBusFrame::DataFrame);
+            int numBytes = tokens[3].at(1) - '0';
+            if (numBytes < 0) numBytes = 0;
+            QByteArray bytes(numBytes, 0);
+            for (int c = 0; c < numBytes; c++)
+            {
+                if ((4 + c) < tokens.size()) bytes[c] = static_cast<char>(tokens[4 + c].toInt(nullptr, 16));
+            }
+            thisFrame.setPayload(bytes);
         }
-        if (dialog.selectedNameFilter() == filters[9])
+        else  //the more concise format (first one from list above)
         {
-            if (!filename.contains('.')) filename += ".log";
-            saveCanDumpFile(filename,frameCache);
+            /* ID & value. Same split as the old (\S+)#(\S+) regex which was greedy on the ID side */
+            const QByteArray &idVal = tokens[2];
+            int hash = idVal.lastIndexOf('#');
+            if (hash < 1 || hash >= idVal.length() - 1)
+            {
+                qDebug() << "ID token didn't match!";
+                return false;
+            }
+            QByteArray idText = idVal.left(hash);
+            QByteArray val = idVal.mid(hash + 1);
+
+            /* ID */
+            thisFrame.setFrameId(static_cast<uint32_t>(idText.toInt(&ret, 16)));
+            if (idText.length() > 3)
+            {
+                thisFrame.setExtendedFrameFormat(true);
+            }
+            else
+            {
+                thisFrame.setExtendedFrameFormat(false);
+            }
+
+            QByteArray bytes;
+            if (val.startsWith('R') && val.length() > 1 && val.at(1) >= '0' && val.at(1) <= '9') {
+                thisFrame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+            } else {
+                thisFrame.setFrameType(QCanBusFrame::DataFrame);
+                /* val byte per byte */
+                for (int c = 0; c + 1 < val.length(); c += 2)
+                {
+                    bytes.append(static_cast<char>(val.mid(c, 2).toInt(&ret, 16)));
+                }
+            }
+            thisFrame.setPayload(bytes);
         }
-        if (dialog.selectedNameFilter() == filters[10])
+
+        /*NB: should we make sure len <= 8? */
+        thisFrame.isReceived = true;
+        return true;
+    }
+};
+
+FrameFileIO::FrameFileIO()
+{
+}
+
+bool FrameFileIO::saveFrameFile(QString &fileName, const CANFrameStore* frameStore)
+{
+    //the writers all work on full CANFrame objects so unpack the packed store once up front
+    QVector<CANFrame> frameCache = frameStore->toVector();
+    return saveFrameFile(fileName, &frameCache);
+}
+
+bool FrameFileIO::saveFrameFile(QString &fileName, const QVector<CANFrame>* frameCache)
+{
+    //the saver runs on its own thread over a copy of the frames. Copying is cheap, the vector is shared until
+    //the capture appends to it, and the GUI keeps going in the meantime
+    const QVector<CANFrame> snapshot = *frameCache;
+    return saveOnWorker(fileName, [&snapshot](QString &filename, int filterIdx)
+    {
+        return saveWithFilter(filename, filterIdx, &snapshot);
+    });
+}
+
+/*
+ * Saves just the frames of the store a LogRangeDialog picks, without unpacking the whole store or filtering the
+ * frame list first. The time index gives the first and last row of the window and with IDs picked the ID index
+ * gives their rows in it, so only those get looked at. The worker then builds just the frames that are kept, with
+ * the expression and decimation checked on them, and hands them to the saver.
+ */
+bool FrameFileIO::saveFrameRange(QString &fileName, const CANFrameStore* frameStore)
+{
+    LogRangeDialog range(nullptr, qApp->activeWindow());
+    range.setWindowTitle(tr("Save Range of Frames"));
+    if (range.exec() != QDialog::Accepted) return false;
+    const FrameLoadOptions options = range.options();
+    if (options.nothing) return false;
+
+    //the time index is exact at the end of the window. At the start it takes the frames to be in time order
+    int first = 0;
+    int last = frameStore->count() - 1;
+    if (options.from > 0) first = frameStore->lastRowAtTime(static_cast<uint64_t>(options.from - 1)) + 1;
+    if (options.to != std::numeric_limits<qint64>::max())
+        last = (options.to < 0) ? -1 : frameStore->lastRowAtTime(static_cast<uint64_t>(options.to));
+
+    QVector<int> rows;
+    bool byRows = !options.ids.isEmpty() && frameStore->isIndexed() && first <= last;
+    if (byRows)
+    {
+        const QVector<CANFrameStore::IdInfo> pairs = frameStore->idList();
+        for (const CANFrameStore::IdInfo &pair : pairs)
         {
-            if (!filename.contains('.')) filename += ".csv";
-            result = saveCabanaFile(filename, frameCache);
+            if (!options.matchesBus(pair.bus)) continue;
+            const QVector<int> pairRows = frameStore->rowsOf(pair.id, pair.bus);
+            if (pairRows.isEmpty()) continue;
+            if (!options.matchesKey(frameLoadKey(pair.id, frameStore->record(pairRows.first()).isExtended()))) continue;
+            QVector<int>::const_iterator from = std::lower_bound(pairRows.constBegin(), pairRows.constEnd(), first);
+            QVector<int>::const_iterator to = std::upper_bound(from, pairRows.constEnd(), last);
+            for (; from != to; ++from) rows.append(*from);
         }
-        if (dialog.selectedNameFilter() == filters[11])
+        std::sort(rows.begin(), rows.end());
+    }
+    if (first > last || (byRows && rows.isEmpty()))
+    {
+        QMessageBox::information(qApp->activeWindow(), tr("Save"), tr("No frames are in that range"));
+        return false;
+    }
+
+    //rows are counted from row 0 as it is now, so is the snapshot
+    const CANFrameSnapshot snapshot = frameStore->snapshot(last + 1);
+    return saveOnWorker(fileName, [&](QString &filename, int filterIdx)
+    {
+        FrameLoadFilter filter(options);
+        QVector<CANFrame> frames;
+        frames.reserve(byRows ? rows.count() : last - first + 1);
+        auto take = [&](int row)
+        {
+            const CANFrameRecord &rec = snapshot.record(row);
+            if (!options.matches(static_cast<qint64>(rec.timestamp), frameLoadKey(rec.frameId(), rec.isExtended()), rec.bus)) return;
+            CANFrame frame = snapshot.at(row);
+            if (options.expression && !options.expression->matches(frame)) return;
+            if (filter.decimated(frame)) frames.append(frame);
+        };
+        if (byRows)
         {
-            if (!filename.contains('.')) filename += ".asc";
-            result = saveCanalyzerASC(filename, frameCache);
+            for (int row : qAsConst(rows)) take(row);
         }
-        if (dialog.selectedNameFilter() == filters[12])
+        else
         {
-            if (!filename.contains('.')) filename += ".trc";
-            result = saveCARBUSAnalzyer(filename, frameCache);
+            for (int row = first; row <= last; row++) take(row);
         }
+        return saveWithFilter(filename, filterIdx, &frames);
+    });
+}
+
+bool FrameFileIO::saveOnWorker(QString &fileName, const std::function<bool(QString &, int)> &save)
+{
+    QString filename;
+    QFileDialog dialog(qApp->activeWindow());
+    QSettings settings;
+    bool result = false;
+
+    QStringList filters = saveFilters();
+
+    dialog.setDirectory(settings.value("FileIO/LoadSaveDirectory", dialog.directory().path()).toString());
+    dialog.setFileMode(QFileDialog::AnyFile);
+    dialog.setNameFilters(filters);
+    dialog.setViewMode(QFileDialog::Detail);
+    dialog.setAcceptMode(QFileDialog::AcceptSave);
+
+    if (dialog.exec() == QDialog::Accepted)
+    {
+        filename = dialog.selectedFiles()[0];
+        int filterIdx = filters.indexOf(dialog.selectedNameFilter());
+
+        LogCompression compression = CompressedLog::fromFileName(filename);
+        if (!CompressedLog::isSupported(compression))
+        {
+            QMessageBox::warning(qApp->activeWindow(), tr("Save"), tr("This build can't write %1 files").arg(CompressedLog::suffix(compression)));
+            return false;
+        }
+
+        saveProgress.storeRelaxed(0);
+        saveCancel.storeRelaxed(0);
+
+        QProgressDialog progress(qApp->activeWindow());
+        progress.setWindowModality(Qt::WindowModal);
+        progress.setLabelText("Saving file...");
+        progress.setRange(0, 1000);
+        progress.setMinimumDuration(0);
+        progress.setAutoReset(false);
+        progress.setAutoClose(false);
+        QObject::connect(&progress, &QProgressDialog::canceled, []() { saveCancel.storeRelaxed(1); });
+        progress.show();
+
+        QThread *worker = QThread::create([&filename, filterIdx, &save, &result]()
+        {
+            result = save(filename, filterIdx);
+        });
+        QEventLoop waitLoop;
+        QObject::connect(worker, &QThread::finished, &waitLoop, &QEventLoop::quit);
+        QTimer progressTimer;
+        QObject::connect(&progressTimer, &QTimer::timeout, &progress, [&progress]()
+        {
+            if (!saveCancel.loadRelaxed()) progress.setValue(saveProgress.loadRelaxed());
+        });
+        progressTimer.start(100);
+        worker->start();
+        waitLoop.exec();
+        worker->wait();
+        delete worker;
 
         progress.cancel();
 
+        if (saveCancel.loadRelaxed())
+        {
+            //whatever got written so far is of no use
+            QFile::remove(filename);
+            return false;
+        }
+
         if (result)
         {
             QStringList fileList = filename.split('/');
@@ -158,13 +956,138 @@ bool FrameFileIO::saveFrameFile(QString &fileName, const QVector<CANFrame>* fram
     return false;
 }
 
-bool FrameFileIO::loadFrameFile(QString &fileName, QVector<CANFrame>* frameCache)
+//The save dialog's file types. saveWithFilter takes an index into this list
+QStringList FrameFileIO::saveFilters()
+{
+    QStringList filters;
+    filters.append(QString(tr("GVRET Logs (*.csv *.CSV)")));
+    filters.append(QString(tr("CRTD Logs (*.crt *.crtd *.CRT *.CRTD)")));
+    filters.append(QString(tr("Generic ID/Data CSV (*.csv *.CSV)")));
+    filters.append(QString(tr("BusMaster Log (*.log *.LOG)")));
+    filters.append(QString(tr("Microchip Log (*.can *.CAN *.log *.LOG)")));
+    filters.append(QString(tr("Vector Trace Files (*.trace *.TRACE)")));
+    filters.append(QString(tr("IXXAT MiniLog (*.csv *.CSV)")));
+    filters.append(QString(tr("CAN-DO Log (*.can *.avc *.evc *.qcc *.CAN *.AVC *.EVC *.QCC)")));
+    filters.append(QString(tr("Vehicle Spy (*.csv *.CSV)")));
+    filters.append(QString(tr("Candump/Kayak (*.log)")));
+    filters.append(QString(tr("Cabana Log (*.csv *.CSV)")));
+    filters.append(QString(tr("CANalyzer Ascii Log (*.asc *.ASC)")));
+    filters.append(QString(tr("CARBUS Analyzer (*.trc *.TRC)")));
+    filters.append(QString(tr("SavvyCAN Binary Capture (*.scb *.SCB)")));
+    filters.append(QString(tr("CANalyzer Binary Log Files (*.blf *.BLF)")));
+    filters.append(QString(tr("Wireshark pcapng (*.pcapng *.PCAPNG)")));
+    return filters;
+}
+
+/*
+ * Saves with the saver for one of saveFilters(), adding its extension if there is none. Names ending in .gz, .zst or
+ * .lz4 are saved to a temporary file first and compressed into place from there. Safe to run off the GUI thread.
+ */
+bool FrameFileIO::saveWithFilter(QString &filename, int filterIdx, const QVector<CANFrame>* frameCache)
+{
+    bool result = false;
+    QString compressedName;
+    QTemporaryFile spool;
+    if (CompressedLog::fromFileName(filename) != LogCompression::NONE)
+    {
+        compressedName = filename;
+        spool.setFileTemplate(QDir::temp().filePath("SavvyCAN-XXXXXX.tmp"));
+        if (!spool.open()) return false;
+        spool.close();
+        filename = spool.fileName();
+    }
+    if (filterIdx == 0)
+    {
+        if (!filename.contains('.')) filename += ".csv";
+        result = saveNativeCSVFile(filename, frameCache);
+    }
+    if (filterIdx == 1)
+    {
+        if (!filename.contains('.')) filename += ".txt";
+        result = saveCRTDFile(filename, frameCache);
+    }
+    if (filterIdx == 2)
+    {
+        if (!filename.contains('.')) filename += ".csv";
+        result = saveGenericCSVFile(filename, frameCache);
+    }
+    if (filterIdx == 3)
+    {
+        if (!filename.contains('.')) filename += ".log";
+        result = saveLogFile(filename, frameCache);
+    }
+    if (filterIdx == 4)
+    {
+        if (!filename.contains('.')) filename += ".log";
+        result = saveMicrochipFile(filename, frameCache);
+    }
+    if (filterIdx == 5)
+    {
+        if (!filename.contains('.')) filename += ".trace";
+        result = saveTraceFile(filename, frameCache);
+    }
+    if (filterIdx == 6)
+    {
+        if (!filename.contains('.')) filename += ".csv";
+        result = saveIXXATFile(filename, frameCache);
+    }
+    if (filterIdx == 7)
+    {
+        if (!filename.contains('.')) filename += ".can";
+        result = saveCANDOFile(filename, frameCache);
+    }
+    if (filterIdx == 8)
+    {
+        if (!filename.contains('.')) filename += ".csv";
+        result = saveVehicleSpyFile(filename, frameCache);
+    }
+    if (filterIdx == 9)
+    {
+        if (!filename.contains('.')) filename += ".log";
+        result = saveCanDumpFile(filename, frameCache);
+    }
+    if (filterIdx == 10)
+    {
+        if (!filename.contains('.')) filename += ".csv";
+        result = saveCabanaFile(filename, frameCache);
+    }
+    if (filterIdx == 11)
+    {
+        if (!filename.contains('.')) filename += ".asc";
+        result = saveCanalyzerASC(filename, frameCache);
+    }
+    if (filterIdx == 12)
+    {
+        if (!filename.contains('.')) filename += ".trc";
+        result = saveCARBUSAnalzyer(filename, frameCache);
+    }
+    if (filterIdx == 13)
+    {
+        if (!filename.contains('.')) filename += ".scb";
+        result = saveBinaryNativeFile(filename, frameCache);
+    }
+    if (filterIdx == 14)
+    {
+        if (!filename.contains('.')) filename += ".blf";
+        result = saveCanalyzerBLF(filename, frameCache);
+    }
+    if (filterIdx == 15)
+    {
+        if (!filename.contains('.')) filename += ".pcapng";
+        result = saveWiresharkFile(filename, frameCache);
+    }
+
+    if (!compressedName.isEmpty())
+    {
+        if (result && !saveCancel.loadRelaxed()) result = CompressedLog::compress(filename, compressedName);
+        filename = compressedName;
+    }
+    return result;
+}
+
+//The load dialog's file types. loadWithFilter takes an index into this list
+QStringList FrameFileIO::loadFilters()
 {
-    QString filename;
-    QFileDialog dialog;
-    QSettings settings;
-    bool result = false;
-
     QStringList filters;
     filters.append(QString(tr("Autodetect File Type (*.*)")));
     filters.append(QString(tr("GVRET Logs (*.csv *.CSV)")));
@@ -191,6 +1114,55 @@ bool FrameFileIO::loadFrameFile(QString &fileName, QVector<CANFrame>* frameCache
     filters.append(QString(tr("CLX000 (*.txt *.TXT)")));
     filters.append(QString(tr("CANServer Binary Log (*.log *.LOG)")));
     filters.append(QString(tr("Wireshark (*.pcap *.PCAP *.pcapng *.PCAPNG)")));
+    filters.append(QString(tr("SavvyCAN Binary Capture (*.scb *.SCB)")));
+    return filters;
+}
+
+bool FrameFileIO::loadWithFilter(QString filename, int filterIdx, QVector<CANFrame>* frameCache, const FrameLoadOptions *options)
+{
+    bool result = false;
+    std::unique_ptr<FrameLoadFilter> filter;
+    if (options && !options->isEverything()) filter.reset(new FrameLoadFilter(*options));
+    LoadFilterScope scope(filter ? filter.get() : loadFilter);
+    QTemporaryFile inflated;
+    if (!inflateIfCompressed(filename, inflated)) return false;
+    if (filterIdx == 0) result = autoDetectLoadFile(filename, frameCache);
+    if (filterIdx == 1) result = loadNativeCSVFile(filename, frameCache);
+    if (filterIdx == 2) result = loadCRTDFile(filename, frameCache);
+    if (filterIdx == 3) result = loadLogFile(filename, frameCache);
+    if (filterIdx == 4) result = loadMicrochipFile(filename, frameCache);
+    if (filterIdx == 5) result = loadTraceFile(filename, frameCache);
+    if (filterIdx == 6) result = loadIXXATFile(filename, frameCache);
+    if (filterIdx == 7) result = loadCANDOFile(filename, frameCache);
+    if (filterIdx == 8) result = loadVehicleSpyFile(filename, frameCache);
+    if (filterIdx == 9) result = loadCanDumpFile(filename, frameCache);
+    if (filterIdx == 10) result = loadLawicelFile(filename, frameCache);
+    if (filterIdx == 11) result = loadPCANFile(filename, frameCache);
+    if (filterIdx == 12) result = loadKvaserFile(filename, frameCache, false);
+    if (filterIdx == 13) result = loadKvaserFile(filename, frameCache, true);
+    if (filterIdx == 14) result = loadCanalyzerASC(filename, frameCache);
+    if (filterIdx == 15) result = loadCanalyzerBLF(filename, frameCache);
+    if (filterIdx == 16) result = loadCARBUSAnalyzerFile(filename, frameCache);
+    if (filterIdx == 17) result = loadCANHackerFile(filename, frameCache);
+    if (filterIdx == 18) result = loadGenericCSVFile(filename, frameCache);
+    if (filterIdx == 19) result = loadCabanaFile(filename, frameCache);
+    if (filterIdx == 20) result = loadCANOpenFile(filename, frameCache);
+    if (filterIdx == 21) result = loadTeslaAPFile(filename, frameCache);
+    if (filterIdx == 22) result = loadCLX000File(filename, frameCache);
+    if (filterIdx == 23) result = loadCANServerFile(filename, frameCache);
+    if (filterIdx == 24) result = loadWiresharkFile(filename, frameCache);
+    if (filterIdx == 25) result = loadBinaryNativeFile(filename, frameCache);
+    return result;
+}
+
+bool FrameFileIO::loadFrameFile(QString &fileName, QVector<CANFrame>* frameCache, QString *mappedFile)
+{
+    QString filename;
+    QFileDialog dialog;
+    QSettings settings;
+    bool result = false;
+
+    QStringList filters = loadFilters();
 
     dialog.setDirectory(settings.value("FileIO/LoadSaveDirectory", dialog.directory().path()).toString());
     dialog.setFileMode(QFileDialog::ExistingFile);
@@ -202,44 +1174,20 @@ bool FrameFileIO::loadFrameFile(QString &fileName, QVector<CANFrame>* frameCache
         filename = dialog.selectedFiles()[0];
         QString selectedNameFilter = dialog.selectedNameFilter();
 
-        QProgressDialog progress(qApp->activeWindow());
-        progress.setWindowModality(Qt::WindowModal);
-        progress.setLabelText("Loading file...");
-        progress.setCancelButton(nullptr);
-        progress.setRange(0,0);
-        progress.setMinimumDuration(0);
-        progress.show();
-
-        qApp->processEvents();
-
-        if (selectedNameFilter == filters[0]) result = autoDetectLoadFile(filename, frameCache);
-        if (selectedNameFilter == filters[1]) result = loadNativeCSVFile(filename, frameCache);
-        if (selectedNameFilter == filters[2]) result = loadCRTDFile(filename, frameCache);
-        if (selectedNameFilter == filters[3]) result = loadLogFile(filename, frameCache);
-        if (selectedNameFilter == filters[4]) result = loadMicrochipFile(filename, frameCache);
-        if (selectedNameFilter == filters[5]) result = loadTraceFile(filename, frameCache);
-        if (selectedNameFilter == filters[6]) result = loadIXXATFile(filename, frameCache);
-        if (selectedNameFilter == filters[7]) result = loadCANDOFile(filename, frameCache);
-        if (selectedNameFilter == filters[8]) result = loadVehicleSpyFile(filename, frameCache);
-        if (selectedNameFilter == filters[9]) result = loadCanDumpFile(filename, frameCache);
-        if (selectedNameFilter == filters[10]) result = loadLawicelFile(filename, frameCache);
-        if (selectedNameFilter == filters[11]) result = loadPCANFile(filename, frameCache);
-        if (selectedNameFilter == filters[12]) result = loadKvaserFile(filename, frameCache, false);
-        if (selectedNameFilter == filters[13]) result = loadKvaserFile(filename, frameCache, true);
-        if (selectedNameFilter == filters[14]) result = loadCanalyzerASC(filename, frameCache);
-        if (selectedNameFilter == filters[15]) result = loadCanalyzerBLF(filename, frameCache);
-        if (selectedNameFilter == filters[16]) result = loadCARBUSAnalyzerFile(filename, frameCache);
-        if (selectedNameFilter == filters[17]) result = loadCANHackerFile(filename, frameCache);
-        if (selectedNameFilter == filters[18]) result = loadGenericCSVFile(filename, frameCache);
-        if (selectedNameFilter == filters[19]) result = loadCabanaFile(filename, frameCache);
-        if (selectedNameFilter == filters[20]) result = loadCANOpenFile(filename, frameCache);
-        if (selectedNameFilter == filters[21]) result = loadTeslaAPFile(filename, frameCache);
-        if (selectedNameFilter == filters[22]) result = loadCLX000File(filename, frameCache);
-        if (selectedNameFilter == filters[23]) result = loadCANServerFile(filename, frameCache);
-        if (selectedNameFilter == filters[24]) result = loadWiresharkFile(filename, frameCache);
+        std::unique_ptr<TextLoadProgress> progress(new TextLoadProgress("Loading file..."));
 
+        //binary captures can be viewed in place. Hand the name back so the caller can map it instead of loading it
+        if (mappedFile && (selectedNameFilter == filters[25] || (selectedNameFilter == filters[0] && isBinaryNativeFile(filename))))
+        {
+            *mappedFile = filename;
+            result = true;
+        }
+        else
+        {
+            result = loadWithFilter(filename, filters.indexOf(selectedNameFilter), frameCache);
+        }
 
-        progress.cancel();
+        progress.reset();
 
         if (result)
         {
@@ -262,267 +1210,334 @@ bool FrameFileIO::loadFrameFile(QString &fileName, QVector<CANFrame>* frameCache
     return false;
 }
 
-
-//Try every format by first using the "is" functions which try to detect whether a given file is a good match to that
-//file format or not. Those functions are much less tolerant than the load functions and so should help to discriminate
-//whether a file could be loaded or not by a given loader. The loader return is still used in case the guess was wrong.
-bool FrameFileIO::autoDetectLoadFile(QString filename, QVector<CANFrame>* frames)
+//Picks a file like loadFrameFile does, then which of its frames to keep (see LogRangeDialog). Text logs the sidecar
+//index can cover get indexed first so after that only what was picked has to be read
+bool FrameFileIO::loadFrameFilePart(QString &fileName, QVector<CANFrame>* frameCache)
 {
-    qDebug() << "Attempting Canalyzer BLF";
-    if (isCanalyzerBLF(filename))
-    {
-        if (loadCanalyzerBLF(filename, frames))
-        {
-            qDebug() << "Loaded as Canalyzer BLF successfully!";
-            return true;
-        }
-    }
+    QFileDialog dialog;
+    QSettings settings;
+    QStringList filters = loadFilters();
 
-    qDebug() << "Attempting native CSV";
-    if (isNativeCSVFile(filename))
-    {
-        if (loadNativeCSVFile(filename, frames))
-        {
-            qDebug() << "Loaded as native CSV successfully!";
-            return true;
-        }
-    }
+    dialog.setWindowTitle(tr("Load Part of Log File"));
+    dialog.setDirectory(settings.value("FileIO/LoadSaveDirectory", dialog.directory().path()).toString());
+    dialog.setFileMode(QFileDialog::ExistingFile);
+    dialog.setNameFilters(filters);
+    dialog.setViewMode(QFileDialog::Detail);
 
-    qDebug() << "Attempting Tesla AP Snapshot";
-    if (isTeslaAPFile(filename))
-    {
-        if (loadTeslaAPFile(filename, frames))
-        {
-            qDebug() << "Loaded as Tesla AP Snapshot successfully!";
-            return true;
-        }
-    }
+    if (dialog.exec() != QDialog::Accepted) return false;
 
-    qDebug() << "Attempting CANServer Binary Log";
-    if (isCANServerFile(filename))
-    {
-        if (loadCANServerFile(filename, frames))
-        {
-            qDebug() << "Loaded as CANServer Binary Log successfully!";
-            return true;
-        }
-    }
+    QString filename = dialog.selectedFiles()[0];
+    int filterIdx = filters.indexOf(dialog.selectedNameFilter());
+    settings.setValue("FileIO/LoadSaveDirectory", dialog.directory().path());
+    fileName = filename.split('/').last();
 
-    qDebug() << "Attempting Wireshark Log";
-    if (isWiresharkFile(filename))
-    {
-        if (loadWiresharkFile(filename, frames))
-        {
-            qDebug() << "Loaded as Wireshark Log successfully!";
-            return true;
-        }
-    }
+    TextLogIndex index;
+    bool indexed = indexTextLog(filename, index);
+    LogRangeDialog range(indexed ? &index : nullptr, qApp->activeWindow());
+    if (range.exec() != QDialog::Accepted) return false;
+    FrameLoadOptions options = range.options();
 
-    qDebug() << "Attempting canalyzer ASC";
-    if (isCanalyzerASC(filename))
-    {
-        if (loadCanalyzerASC(filename, frames))
-        {
-            qDebug() << "Loaded as Canalyzer ASC successfully!";
-            return true;
-        }
-    }
+    std::unique_ptr<TextLoadProgress> progress(new TextLoadProgress("Loading part of the file..."));
+    bool result = loadWithFilter(filename, filterIdx, frameCache, &options);
+    progress.reset();
 
-    qDebug() << "Attempting CRTD";
-    if (isCRTDFile(filename))
+    if (!result && filterIdx != 0)
     {
-        if (loadCRTDFile(filename, frames))
-        {
-            qDebug() << "Loaded as CRTD successfully!";
-            return true;
-        }
+        QMessageBox msgBox;
+        msgBox.setText("File load completed with errors.\r\nPerhaps you selected the wrong file type?");
+        msgBox.exec();
     }
+    return result;
+}
 
+//Same as loadFrameFile but any number of files can be picked. They all have to be of the one file type picked
+//in the dialog (autodetect works per file). Each file loaded ends up as its own entry in frameSets and its name in
+//fileNames. Returns false if nothing at all could be loaded
+bool FrameFileIO::loadFrameFiles(QStringList &fileNames, QVector<QVector<CANFrame>>* frameSets)
+{
+    QFileDialog dialog;
+    QSettings settings;
+    QStringList filters = loadFilters();
 
-    qDebug() << "Attempting trace file";
-    if (isTraceFile(filename))
-    {
-        if (loadTraceFile(filename, frames))
-        {
-            qDebug() << "Loaded as trace successfully!";
-            return true;
-        }
-    }
+    dialog.setDirectory(settings.value("FileIO/LoadSaveDirectory", dialog.directory().path()).toString());
+    dialog.setFileMode(QFileDialog::ExistingFiles);
+    dialog.setNameFilters(filters);
+    dialog.setViewMode(QFileDialog::Detail);
 
-    qDebug() << "Attempting vehicle spy";
-    if (isVehicleSpyFile(filename))
-    {
-        if (loadVehicleSpyFile(filename, frames))
-        {
-            qDebug() << "Loaded as vehicle spy successfully!";
-            return true;
-        }
-    }
+    if (dialog.exec() != QDialog::Accepted) return false;
 
-    qDebug() << "Attempting candump";
-    if (isCanDumpFile(filename))
-    {
-        if (loadCanDumpFile(filename, frames))
-        {
-            qDebug() << "Loaded as candump successfully!";
-            return true;
-        }
-    }
+    QStringList selected = dialog.selectedFiles();
+    int filterIdx = filters.indexOf(dialog.selectedNameFilter());
+    settings.setValue("FileIO/LoadSaveDirectory", dialog.directory().path());
 
-    qDebug() << "Attempting 'CARBUS Analyzer'";
-    if (isCARBUSAnalyzerFile(filename))
-    {
-        if (loadCARBUSAnalyzerFile(filename, frames))
-        {
-            qDebug() << "Loaded as 'CARBUS Analyzer' successfully!";
-            return true;
-        }
-    }
+    QVector<QVector<CANFrame>> loaded;
+    QVector<bool> ok;
+    loadFilesConcurrently(selected, filterIdx, &loaded, &ok);
 
-    qDebug() << "Attempting canhacker";
-    if (isCANHackerFile(filename))
+    QStringList failed;
+    for (int i = 0; i < selected.count(); i++)
     {
-        if (loadCANHackerFile(filename, frames))
+        if (ok[i])
         {
-            qDebug() << "Loaded as CANHacker successfully!";
-            return true;
+            frameSets->append(loaded[i]);
+            fileNames.append(selected[i].split('/').last());
         }
+        else failed.append(selected[i].split('/').last());
+        loaded[i] = QVector<CANFrame>();
     }
 
-    qDebug() << "Attempting cabana";
-    if (isCabanaFile(filename))
+    if (!failed.isEmpty())
     {
-        if (loadCabanaFile(filename, frames))
-        {
-            qDebug() << "Loaded as Cabana successfully!";
-            return true;
-        }
+        QMessageBox msgBox;
+        msgBox.setText(QString::number(failed.count()) + " file(s) did not load:\r\n" + failed.join("\r\n")
+                       + "\r\nPerhaps you selected the wrong file type?");
+        msgBox.exec();
     }
+    return !frameSets->isEmpty();
+}
 
-    qDebug() << "Attempting canopen";
-    if (isCANOpenFile(filename))
-    {
-        if (loadCANOpenFile(filename, frames))
-        {
-            qDebug() << "Loaded as CANOpen Magic successfully!";
-            return true;
-        }
-    }
+//one of the files loadFilesConcurrently was given, loaded on a pool thread
+class FileLoadTask : public QRunnable
+{
+public:
+    FileLoadTask(const QString &file, int filterIdx, QVector<CANFrame> *frames, bool *ok, QAtomicInt *done)
+        : file(file), filterIdx(filterIdx), frames(frames), ok(ok), done(done) {}
 
-    qDebug() << "Attempting busmaster log";
-    if (isLogFile(filename))
+    void run() override
     {
-        if (loadLogFile(filename, frames))
-        {
-            qDebug() << "Loaded as Busmaster Log successfully!";
-            return true;
-        }
+        *ok = FrameFileIO::loadWithFilter(file, filterIdx, frames);
+        done->fetchAndAddRelaxed(1);
     }
 
-    qDebug() << "Attempting pcan";
-    if (isPCANFile(filename))
-    {
-        if (loadPCANFile(filename, frames))
-        {
-            qDebug() << "Loaded as PCAN successfully!";
-            return true;
-        }
-    }
+private:
+    QString file;
+    int filterIdx;
+    QVector<CANFrame> *frames;
+    bool *ok;
+    QAtomicInt *done;
+};
 
-    qDebug() << "Attempting ixxat";
-    if (isIXXATFile(filename))
-    {
-        if (loadIXXATFile(filename, frames))
-        {
-            qDebug() << "Loaded as IXXAT successfully!";
-            return true;
-        }
+/*
+ * Every file gets a pool thread of its own (as many at once as there are cores) and the loaders run there just as
+ * they would for one file. The text loaders split each file over a pool of their own on top of that. The GUI keeps
+ * going with a progress dialog that counts finished files.
+ */
+bool FrameFileIO::loadFilesConcurrently(const QStringList &files, int filterIdx, QVector<QVector<CANFrame>> *frameSets, QVector<bool> *loaded)
+{
+    int count = files.count();
+    frameSets->clear();
+    frameSets->resize(count);
+    loaded->fill(false, count);
+    if (count == 0) return false;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), count));
+    QAtomicInt done;
+    QVector<CANFrame> *sets = frameSets->data();
+    bool *ok = loaded->data();
+    for (int i = 0; i < count; i++) pool.start(new FileLoadTask(files[i], filterIdx, &sets[i], &ok[i], &done));
+
+    QProgressDialog progress(qApp->activeWindow());
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setLabelText("Loading " + QString::number(count) + " files...");
+    progress.setCancelButton(nullptr);
+    progress.setRange(0, count);
+    progress.setMinimumDuration(0);
+    progress.show();
+    while (!pool.waitForDone(50))
+    {
+        progress.setValue(done.loadRelaxed());
+        qApp->processEvents();
     }
+    progress.cancel();
+
+    return loaded->contains(true);
+}
 
-    qDebug() << "Attempting microchip";
-    if (isMicrochipFile(filename))
+/*
+ * A k-way merge on a heap of each set's next timestamp, so a merge of k files costs log k per frame and nothing gets
+ * sorted as a whole. Files are nearly always in order already. One that isn't gets sorted on its own first, which
+ * keeps whatever order frames with the same time had. Ties between files go to the earlier file.
+ */
+FrameSetMerge::FrameSetMerge(QVector<QVector<CANFrame>> &frameSets) : sets(frameSets)
+{
+    remaining = 0;
+    cursor.fill(0, sets.count());
+    for (int i = 0; i < sets.count(); i++)
     {
-        if (loadMicrochipFile(filename, frames))
+        QVector<CANFrame> &set = sets[i];
+        remaining += set.count();
+        auto earlier = [](const CANFrame &a, const CANFrame &b)
         {
-            qDebug() << "Loaded as microchip successfully!";
-            return true;
-        }
+            return a.timeStamp().microSeconds() < b.timeStamp().microSeconds();
+        };
+        if (!std::is_sorted(set.cbegin(), set.cend(), earlier)) std::stable_sort(set.begin(), set.end(), earlier);
+        if (!set.isEmpty()) heap.push_back(std::make_pair(set.constFirst().timeStamp().microSeconds(), i));
     }
+    std::make_heap(heap.begin(), heap.end(), std::greater<std::pair<qint64, int>>());
+}
 
-    qDebug() << "Attempting CANDo";
-    if (isCANDOFile(filename))
-    {
-        if (loadCANDOFile(filename, frames))
+bool FrameSetMerge::next(QVector<CANFrame> &out, int count)
+{
+    out.clear();
+    const std::greater<std::pair<qint64, int>> later;
+    while (!heap.empty() && out.count() < count)
+    {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        int set = heap.back().second;
+        const QVector<CANFrame> &frames = sets.at(set);
+        int &pos = cursor[set];
+        //the same file keeps going for as long as it's still the earliest, which is most of the time
+        const std::pair<qint64, int> limit = (heap.size() > 1) ? heap.front() : std::make_pair(std::numeric_limits<qint64>::max(), 0);
+        while (pos < frames.count() && out.count() < count && std::make_pair(frames.at(pos).timeStamp().microSeconds(), set) < limit)
         {
-            qDebug() << "Loaded as CANDO successfully!";
-            return true;
+            out.append(frames.at(pos));
+            pos++;
         }
-    }
-
-    qDebug() << "Attempting kvaser";
-    if (isKvaserFile(filename))
-    {
-        if (loadKvaserFile(filename, frames,true))
+        if (pos < frames.count())
         {
-            qDebug() << "Loaded as Kvaser HEX successfully!";
-            return true;
+            heap.back().first = frames.at(pos).timeStamp().microSeconds();
+            std::push_heap(heap.begin(), heap.end(), later);
         }
-        if (loadKvaserFile(filename, frames,false))
+        else
         {
-            qDebug() << "Loaded as KVaser Decimal successfully!";
-            return true;
+            heap.pop_back();
+            sets[set] = QVector<CANFrame>(); //done with it, no need to hold on until the whole merge is
         }
     }
+    remaining -= out.count();
+    return !out.isEmpty();
+}
+
 
-    qDebug() << "Attempting CLX000";
-    if (isCLX000File(filename))
+//Try every format by first using the "is" functions which try to detect whether a given file is a good match to that
+//file format or not. Those functions are much less tolerant than the load functions and so should help to discriminate
+//whether a file could be loaded or not by a given loader. The loader return is still used in case the guess was wrong.
+/*
+ * Reads the start of the file once and runs every format's probe against that copy instead of each probe opening
+ * and reading the file again. Formats with a header or magic number nothing else has are tried before the ones that
+ * only look at what the lines are shaped like, each lot in the order they always were. Only formats whose probe
+ * matched are loaded, the next match is tried if a load fails.
+ */
+bool FrameFileIO::autoDetectLoadFile(QString filename, QVector<CANFrame>* frames)
+{
+    struct DetectFormat
     {
-        if (loadCLX000File(filename, frames))
-        {
-            qDebug() << "Loaded as CLX000 successfully!";
-            return true;
-        }
-    }
+        const char *name;
+        bool textMode;
+        bool signature;
+        bool (*probe)(QIODevice *);
+        bool (*load)(QString, QVector<CANFrame>*);
+    };
+    static const DetectFormat formats[] =
+    {
+        {"SavvyCAN binary capture", false, true, isBinaryNativeFile, loadBinaryNativeFile},
+        {"Canalyzer BLF", false, true, isCanalyzerBLF, loadCanalyzerBLF},
+        {"native CSV", true, true, isNativeCSVFile, loadNativeCSVFile},
+        {"Tesla AP Snapshot", false, false, isTeslaAPFile, loadTeslaAPFile},
+        {"CANServer Binary Log", false, true, isCANServerFile, loadCANServerFile},
+        {"Wireshark Log", false, true, isWiresharkFile, loadWiresharkFile},
+        {"Canalyzer ASC", true, true, isCanalyzerASC, loadCanalyzerASC},
+        {"CRTD", true, false, isCRTDFile, loadCRTDFile},
+        {"trace", true, false, isTraceFile, loadTraceFile},
+        {"vehicle spy", true, true, isVehicleSpyFile, loadVehicleSpyFile},
+        {"candump", true, false, isCanDumpFile, loadCanDumpFile},
+        {"'CARBUS Analyzer'", false, true, isCARBUSAnalyzerFile, loadCARBUSAnalyzerFile},
+        {"CANHacker", true, false, isCANHackerFile, loadCANHackerFile},
+        {"Cabana", true, false, isCabanaFile, loadCabanaFile},
+        {"CANOpen Magic", true, true, isCANOpenFile, loadCANOpenFile},
+        {"Busmaster Log", true, true, isLogFile, loadLogFile},
+        {"PCAN", true, true, isPCANFile, loadPCANFile},
+        {"IXXAT", true, true, isIXXATFile, loadIXXATFile},
+        {"microchip", true, false, isMicrochipFile, loadMicrochipFile},
+        {"CANDO", false, false, isCANDOFile, loadCANDOFile},
+        {"Kvaser", true, true, isKvaserFile, [](QString name, QVector<CANFrame> *out) { return loadKvaserFile(name, out, true) || loadKvaserFile(name, out, false); }},
+        {"CLX000", true, true, isCLX000File, loadCLX000File},
+        {"lawicel", true, false, isLawicelFile, loadLawicelFile},
+        {"generic CSV", true, false, isGenericCSVFile, loadGenericCSVFile},
+    };
 
-    qDebug() << "Attempting lawicel";
-    if (isLawicelFile(filename))
+    QTemporaryFile inflated;
+    if (!inflateIfCompressed(filename, inflated)) return false;
+
+    QByteArray sample;
+    bool wholeFile = false;
     {
-        if (loadLawicelFile(filename, frames))
+        QFile inFile(filename);
+        if (inFile.open(QIODevice::ReadOnly))
         {
-            qDebug() << "Loaded as lawicel successfully!";
-            return true;
+            sample = inFile.read(AUTODETECT_SAMPLE_BYTES);
+            wholeFile = inFile.atEnd();
         }
     }
+    //a line cut in half at the end of the sample would look malformed to the line based probes
+    QByteArray textSample = sample;
+    if (!wholeFile && textSample.lastIndexOf('\n') >= 0) textSample.truncate(textSample.lastIndexOf('\n') + 1);
 
-    qDebug() << "Attempting generic CSV";
-    if (isGenericCSVFile(filename))
+    QBuffer buffer;
+    for (int pass = 0; pass < 2 && !sample.isEmpty(); pass++)
     {
-        if (loadGenericCSVFile(filename, frames))
+        for (const DetectFormat &format : formats)
         {
-            qDebug() << "Loaded as generic CSV successfully!";
-            return true;
+            if (format.signature != (pass == 0)) continue;
+            buffer.setData(format.textMode ? textSample : sample);
+            buffer.open(format.textMode ? (QIODevice::ReadOnly | QIODevice::Text) : QIODevice::OpenMode(QIODevice::ReadOnly));
+            bool matched = format.probe(&buffer);
+            buffer.close();
+            if (!matched) continue;
+
+            qDebug() << "Attempting" << format.name;
+            if (loadFilter) loadFilter->reset();
+            if (format.load(filename, frames))
+            {
+                qDebug() << "Loaded as" << format.name << "successfully!";
+                return true;
+            }
         }
     }
 
-    QMessageBox msgBox;
-    msgBox.setText("Could not autodetect the file type.\rPlease try to manually select the file format.");
-    msgBox.exec();
+    //off the GUI thread (several files loading at once, the command line tool) the caller reports it
+    if (QThread::currentThread() == qApp->thread())
+    {
+        QMessageBox msgBox;
+        msgBox.setText("Could not autodetect the file type.\rPlease try to manually select the file format.");
+        msgBox.exec();
+    }
     qDebug() << "Nothing worked... sorry...";
     return false;
 }
 
+//a gzip, zstd or LZ4 log is inflated into tmp and filename pointed at that, anything else is left alone
+bool FrameFileIO::inflateIfCompressed(QString &filename, QTemporaryFile &tmp)
+{
+    if (CompressedLog::fromFile(filename) == LogCompression::NONE) return true;
+    textLoadProgress.storeRelaxed(0);
+    if (!CompressedLog::decompress(filename, tmp, &textLoadProgress)) return false;
+    filename = tmp.fileName();
+    return true;
+}
+
+//opens the file for one of the probes below. autoDetectLoadFile hands them a buffer instead
+bool FrameFileIO::probeFile(const QString &filename, bool textMode, bool (*probe)(QIODevice *))
+{
+    QFile inFile(filename);
+    QIODevice::OpenMode mode = QIODevice::ReadOnly;
+    if (textMode) mode |= QIODevice::Text;
+    if (!inFile.open(mode)) return false;
+    return probe(&inFile);
+}
+
 
 bool FrameFileIO::isVehicleSpyFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isVehicleSpyFile);
+}
+
+bool FrameFileIO::isVehicleSpyFile(QIODevice *inFile)
+{
     QByteArray line;
     bool foundProbableHeader = false;
     bool isMatch = false;
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try {
         for (int i = 0; i < 10; i++)
         {
@@ -540,7 +1555,6 @@ bool FrameFileIO::isVehicleSpyFile(QString filename)
             if (!inFile->atEnd())
             {
                 line = inFile->readLine().simplified().toUpper();
-                inFile->close();
                 QList<QByteArray> tokens = line.split(',');
                 if (tokens.length() > 20)
                 {
@@ -553,7 +1567,6 @@ bool FrameFileIO::isVehicleSpyFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
     return isMatch;
 }
 
@@ -620,7 +1633,7 @@ bool FrameFileIO::loadVehicleSpyFile(QString filename, QVector<CANFrame> *frames
                 else break;
             }
             thisFrame.setPayload(bytes);
-            frames->append(thisFrame);
+            keepFrame(frames, thisFrame);
         }
         else foundErrors = true;
     }
@@ -638,17 +1651,15 @@ bool FrameFileIO::saveVehicleSpyFile(QString filename, const QVector<CANFrame> *
 
 bool FrameFileIO::isCRTDFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isCRTDFile);
+}
+
+bool FrameFileIO::isCRTDFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool isMatch = false;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         line = inFile->readLine().toUpper(); //read out the header first and discard it.
@@ -682,8 +1693,6 @@ bool FrameFileIO::isCRTDFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -713,100 +1722,24 @@ tokens:
 1 = line type
 2 = ID
 3-x = The data bytes
-*/
-bool FrameFileIO::loadCRTDFile(QString filename, QVector<CANFrame>* frames)
-{
-    QFile *inFile = new QFile(filename);
-    CANFrame thisFrame;
-    QByteArray line;
-    int lineCounter = 0;
-    bool foundErrors = false;
-
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
-    line = inFile->readLine().toUpper(); //read out the header first and discard it.
-
-    while (!inFile->atEnd()) {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
-        line = inFile->readLine().simplified();
-        if (line.length() > 2)
-        {
-            QList<QByteArray> tokens = line.split(' ');
-            int multiplier;
-            if (tokens.length() > 2)
-            {
-                int idxOfDecimal = tokens[0].indexOf('.');
-                if (idxOfDecimal > -1) {
-                    //int decimalPlaces = tokens[0].length() - tokens[0].indexOf('.') - 1;
-                    //the result of the above is the # of digits after the decimal.
-                    //This program deals in microsecond so turn the value into microseconds
-                    multiplier = 1000000; //turn the decimal into full microseconds
-                }
-                else
-                {
-                    multiplier = 1; //special case. Assume no decimal means microseconds
-                }
-                //qDebug() << "decimal places " << decimalPlaces;
-                thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<int64_t>((tokens[0].toDouble() * multiplier))));
-                thisFrame.bus = 0;
-                char firstChar = tokens[1].left(1)[0];
-                if (firstChar >= '1' && firstChar <= '9')
-                {
-                    thisFrame.bus = tokens[1].left(1)[0] - '1';
-                    tokens[1].remove(0,1); // Remove leading digit (bus number)
-                    firstChar = tokens[1].left(1)[0];
-                }
-                if (firstChar == 'R' || firstChar == 'T')
-                {
-                    thisFrame.setFrameId(static_cast<uint32_t>(tokens[2].toInt(nullptr, 16)));
-                    if (tokens[1] == "R29" || tokens[1] == "T29") thisFrame.setExtendedFrameFormat(true);
-                        else thisFrame.setExtendedFrameFormat(false);
-                    if (firstChar == 'T') thisFrame.isReceived = false;
-                        else thisFrame.isReceived = true;
-                    QByteArray bytes(tokens.length() - 3, 0);
-                    thisFrame.setFrameType(QCanBusFrame::DataFrame);
-                    for (int d = 0; d < bytes.length(); d++)
-                    {
-                        if (tokens[d + 3] != "")
-                        {
-                            bytes[d] = static_cast<char>(tokens[d + 3].toInt(nullptr, 16));
-                        }
-                        else bytes[d] = 0;
-                    }
-                    thisFrame.setPayload(bytes);
-                    frames->append(thisFrame);
-                }
-            }
-            else foundErrors = true;
-        }
-    }
-    inFile->close();
-    delete inFile;
-    return !foundErrors;
+*/
+bool FrameFileIO::loadCRTDFile(QString filename, QVector<CANFrame>* frames)
+{
+    return loadTextLog(filename, TextLogFormat::CRTD, nullptr, frames);
 }
 
 bool FrameFileIO::isCARBUSAnalyzerFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, false, isCARBUSAnalyzerFile);
+}
+
+bool FrameFileIO::isCARBUSAnalyzerFile(QIODevice *inFile)
+{
     QByteArray line;
 
     bool isMatch = false;
 
     // not Text mode because file contains `\r` new lines
-    if (!inFile->open(QIODevice::ReadOnly))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         //read header
@@ -817,8 +1750,6 @@ bool FrameFileIO::isCARBUSAnalyzerFile(QString filename)
         isMatch = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -893,7 +1824,7 @@ bool FrameFileIO::loadCARBUSAnalyzerFile(QString filename, QVector<CANFrame>* fr
                     else bytes[d] = 0;
                 }
                 thisFrame.setPayload(bytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
             else
             {
@@ -916,7 +1847,6 @@ bool FrameFileIO::saveCARBUSAnalzyer(QString filename, const QVector<CANFrame>*
     }
     QTextStream outTextStream(outFile);
 
-    int lineCounter = 0;
 
     qint64 minTime = frames->at(0).timeStamp().microSeconds();
     qint64 maxTime = minTime;
@@ -944,12 +1874,7 @@ bool FrameFileIO::saveCARBUSAnalzyer(QString filename, const QVector<CANFrame>*
     const unsigned char *data;
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
         auto frame = frames->at(c);
 
         uint64_t timeStamp = frame.timeStamp().microSeconds();
@@ -1006,16 +1931,15 @@ bool FrameFileIO::saveCARBUSAnalzyer(QString filename, const QVector<CANFrame>*
 
 bool FrameFileIO::isCANHackerFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isCANHackerFile);
+}
+
+bool FrameFileIO::isCANHackerFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool isMatch = false;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         line = inFile->readLine().toUpper(); //read out the header first and discard it.
@@ -1047,8 +1971,6 @@ bool FrameFileIO::isCANHackerFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -1126,7 +2048,7 @@ bool FrameFileIO::loadCANHackerFile(QString filename, QVector<CANFrame>* frames)
                     else bytes[d] = 0;
                 }
                 thisFrame.setPayload(bytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
             else foundErrors = true;
         }
@@ -1138,17 +2060,15 @@ bool FrameFileIO::loadCANHackerFile(QString filename, QVector<CANFrame>* frames)
 
 bool FrameFileIO::isCANOpenFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isCANOpenFile);
+}
+
+bool FrameFileIO::isCANOpenFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool isMatch = false;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         line = inFile->readLine().toUpper();
@@ -1185,8 +2105,6 @@ bool FrameFileIO::isCANOpenFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -1244,7 +2162,7 @@ bool FrameFileIO::loadCANOpenFile(QString filename, QVector<CANFrame>* frames)
                     else bytes[d] = 0;
                 }
                 thisFrame.setPayload(bytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
             else foundErrors = true;
         }
@@ -1256,80 +2174,59 @@ bool FrameFileIO::loadCANOpenFile(QString filename, QVector<CANFrame>* frames)
 
 bool FrameFileIO::saveCRTDFile(QString filename, const QVector<CANFrame>* frames)
 {
-    QFile *outFile = new QFile(filename);
-    int lineCounter = 0;
-
-    const unsigned char *data;
-    int dataLen;
-    const CANFrame *frame;
+    QFile outFile(filename);
 
-    if (!outFile->open(QIODevice::WriteOnly | QIODevice::Text))
+    if (frames->isEmpty() || !outFile.open(QIODevice::WriteOnly | QIODevice::Text))
     {
-        delete outFile;
         return false;
     }
 
+    SaveBuffer out(&outFile);
     //write in float format with 6 digits after the decimal point
-    outFile->write(QString::number(frames->at(0).timeStamp().microSeconds() / 1000000.0, 'f', 6).toUtf8() + tr(" CXX GVRET-PC Reverse Engineering Tool Output V").toUtf8() + QString::number(VERSION).toUtf8());
-    outFile->write("\n");
+    out.putSeconds(frames->at(0).timeStamp().microSeconds(), 6);
+    out.put(tr(" CXX GVRET-PC Reverse Engineering Tool Output V").toUtf8() + QString::number(VERSION).toUtf8());
+    out.put('\n');
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
-
-        frame = &frames->at(c);
-        data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
-        dataLen = frame->payload().count();
-
-        outFile->write(QString::number(frame->timeStamp().microSeconds() / 1000000.0, 'f', 6).toUtf8());
-        outFile->putChar(' ');
+        if (saveStopped(c, frames->count())) break;
 
-        outFile->write(QString::number(frame->bus + 1).toUtf8());
-        if (frame->isReceived) outFile->putChar('R');
-        else outFile->putChar('T');
+        const CANFrame &frame = frames->at(c);
+        const QByteArray payload = frame.payload();
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(payload.constData());
 
-        if (frame->hasExtendedFrameFormat())
+        out.putSeconds(frame.timeStamp().microSeconds(), 6);
+        out.put(' ');
+        out.putDec(frame.bus + 1);
+        out.put(frame.isReceived ? 'R' : 'T');
+        out.put(frame.hasExtendedFrameFormat() ? "29 " : "11 ");
+        out.putHex(frame.frameId(), 8);
+        out.put(' ');
+        for (int temp = 0; temp < payload.count(); temp++)
         {
-            outFile->write("29 ");
+            out.putByte(data[temp]);
+            out.put(' ');
         }
-        else outFile->write("11 ");
-        outFile->write(QString::number(frame->frameId(), 16).toUpper().rightJustified(8, '0').toUtf8());
-        outFile->putChar(' ');
-
-        for (int temp = 0; temp < dataLen; temp++)
-        {
-            outFile->write(QString::number(data[temp], 16).toUpper().rightJustified(2, '0').toUtf8());
-            outFile->putChar(' ');
-        }
-
-        outFile->write("\n");
+        out.put('\n');
+        out.lineDone();
     }
-    outFile->close();
-    delete outFile;
 
-    return true;
+    return out.flush();
 }
 
 
 bool FrameFileIO::isPCANFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isPCANFile);
+}
+
+bool FrameFileIO::isPCANFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool hasFileVer = false;
     bool isMatch = false;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         while (!inFile->atEnd()) {
@@ -1347,8 +2244,6 @@ bool FrameFileIO::isPCANFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -1466,7 +2361,7 @@ bool FrameFileIO::loadPCANFile(QString filename, QVector<CANFrame>* frames)
                             }
                         }
                         thisFrame.setPayload(bytes);
-                        frames->append(thisFrame);
+                        keepFrame(frames, thisFrame);
                     }
                 }
             }
@@ -1517,7 +2412,7 @@ bool FrameFileIO::loadPCANFile(QString filename, QVector<CANFrame>* frames)
                             }
                         }
                         thisFrame.setPayload(bytes);
-                        frames->append(thisFrame);
+                        keepFrame(frames, thisFrame);
                     }
                 }
             }
@@ -1559,7 +2454,7 @@ bool FrameFileIO::loadPCANFile(QString filename, QVector<CANFrame>* frames)
                             }
                         }
                         thisFrame.setPayload(bytes);
-                        frames->append(thisFrame);
+                        keepFrame(frames, thisFrame);
                     }
                 }
             }
@@ -1611,7 +2506,7 @@ bool FrameFileIO::loadPCANFile(QString filename, QVector<CANFrame>* frames)
                             }
                         }
                         thisFrame.setPayload(bytes);
-                        frames->append(thisFrame);
+                        keepFrame(frames, thisFrame);
                     }
                 }
             }
@@ -1626,18 +2521,17 @@ bool FrameFileIO::loadPCANFile(QString filename, QVector<CANFrame>* frames)
 //supporting two styles now and they have very different line layouts. Just checking for the header for now. That should still match only ASC files.
 bool FrameFileIO::isCanalyzerASC(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isCanalyzerASC);
+}
+
+bool FrameFileIO::isCanalyzerASC(QIODevice *inFile)
+{
     QByteArray line;
     //int lineCounter = 0;
     //bool inHeader = true;
     bool isMatch = true;
     QList<QByteArray> tokens;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         if (!inFile->atEnd())
@@ -1665,8 +2559,6 @@ bool FrameFileIO::isCanalyzerASC(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -1867,7 +2759,7 @@ bool FrameFileIO::loadCanalyzerASC(QString filename, QVector<CANFrame>* frames)
                         }
                         thisFrame.setPayload(bytes);
                     }
-                    frames->append(thisFrame);
+                    keepFrame(frames, thisFrame);
                 }
             }
         }
@@ -1880,118 +2772,99 @@ bool FrameFileIO::loadCanalyzerASC(QString filename, QVector<CANFrame>* frames)
 
 bool FrameFileIO::saveCanalyzerASC(QString filename, const QVector<CANFrame>* frames)
 {
-    QFile *outFile = new QFile(filename);
-    int lineCounter = 0;
-    int64_t offsetTime = frames->at(0).timeStamp().microSeconds();
+    QFile outFile(filename);
 
-    const unsigned char *data;
-    int dataLen;
-    const CANFrame *frame;
+    if (frames->isEmpty()) return false;
 
-    for (int c = 0; c < frames->count(); c++)
-    {
-        if (frames->at(c).timeStamp().microSeconds() < offsetTime) offsetTime = frames->at(c).timeStamp().microSeconds();
-    }
+    //timestamps are written from the earliest frame, which isn't always the first one
+    int64_t offsetTime = frames->at(0).timeStamp().microSeconds();
+    for (const CANFrame &frame : *frames) offsetTime = qMin<int64_t>(offsetTime, frame.timeStamp().microSeconds());
 
-    if (!outFile->open(QIODevice::WriteOnly | QIODevice::Text))
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text))
     {
-        delete outFile;
         return false;
     }
 
+    SaveBuffer out(&outFile);
     QDateTime now;
     now = QDateTime::currentDateTime();
     if (offsetTime > 10000000000) //chances are the input file had times as system time so load it
     {
         now.setMSecsSinceEpoch(offsetTime / 1000); //offsetTime was in microseconds
     }
-    outFile->write("date " + now.toString("ddd MMM dd h:mm:ss.zzz a yyyy").toUtf8());
+    out.put("date " + now.toString("ddd MMM dd h:mm:ss.zzz a yyyy").toUtf8());
 
-    outFile->write("\nbase hex  timestamps absolute\n");
-    outFile->write("no internal event logging\n");
-    outFile->write("// version 11.0.0\n");
+    out.put("\nbase hex  timestamps absolute\n");
+    out.put("no internal event logging\n");
+    out.put("// version 11.0.0\n");
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
 
-        frame = &frames->at(c);
-        data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
-        dataLen = frame->payload().count();
+        const CANFrame &frame = frames->at(c);
+        const QByteArray payload = frame.payload();
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(payload.constData());
+        int dataLen = payload.count();
 
-        uint64_t timeStamp = (frame->timeStamp().microSeconds() - offsetTime) / 1000000ull;
-        int tsLen = QString::number(timeStamp).length();
+        int64_t relative = frame.timeStamp().microSeconds() - offsetTime;
+        uint64_t seconds = static_cast<uint64_t>(relative) / 1000000ull;
+        int tsLen = 1;
+        for (uint64_t rest = seconds / 10; rest; rest /= 10) tsLen++;
         int precision = 6;
         //vector seems to keep 10 bytes at the start of the line for the timestamp. It should never exceed this
         //and there should never be a precision over 6 digits after the decimal
-        if (tsLen > 3) precision = 9 - tsLen;
-        outFile->write(QString::number((frame->timeStamp().microSeconds() - offsetTime) / 1000000.0, 'f', precision).rightJustified(10, ' ').toUtf8());
-        outFile->putChar(' ');
-        outFile->write(QString::number(frame->bus + 1).toUtf8());
-        outFile->write("  ");
-        if (frames->at(c).hasExtendedFrameFormat())
+        if (tsLen > 3) precision = qMax(0, 9 - tsLen);
+        out.putSeconds(relative, precision, 10);
+        out.put(' ');
+        out.putDec(frame.bus + 1);
+        out.put("  ");
+        if (frame.hasExtendedFrameFormat())
         {
-            outFile->write(QString::number(frame->frameId(), 16).toUpper().rightJustified(8, '0').toUtf8());
-            outFile->write("x");
+            out.putHex(frame.frameId(), 8);
+            out.put('x');
         }
         else
         {
-            outFile->write(QString::number(frame->frameId(), 16).toUpper().rightJustified(3, '0').toUtf8());
-            outFile->write("      ");
-        }
-        outFile->write("   ");
-
-        if (frames->at(c).isReceived) outFile->write("Rx ");
-        else outFile->write("Tx ");
-
-        if (frames->at(c).frameType() == QCanBusFrame::RemoteRequestFrame) outFile->write("r ");
-        else outFile->write("d ");
-
-        outFile->write(QString::number(dataLen).toUtf8());
-        outFile->write("  ");
-
+            out.putHex(frame.frameId(), 3);
+            out.put("      ");
+        }
+        out.put("   ");
+        out.put(frame.isReceived ? "Rx " : "Tx ");
+        out.put(frame.frameType() == QCanBusFrame::RemoteRequestFrame ? "r " : "d ");
+        out.putDec(dataLen);
+        out.put("  ");
         for (int temp = 0; temp < dataLen; temp++)
         {
-            outFile->write(QString::number(data[temp], 16).toUpper().rightJustified(2, '0').toUtf8());
-            outFile->write("  ");
+            out.putByte(data[temp]);
+            out.put("  ");
         }
-
-        outFile->write("\n");
+        out.put('\n');
+        out.lineDone();
     }
-    outFile->close();
-    delete outFile;
 
-    return true;
+    return out.flush();
 }
 
 bool FrameFileIO::isCanalyzerBLF(QString filename)
+{
+    return probeFile(filename, false, isCanalyzerBLF);
+}
+
+bool FrameFileIO::isCanalyzerBLF(QIODevice *inFile)
 {
     BLF_FILE_HEADER header;
 
-    QFile *inFile = new QFile(filename);
     bool isMatch = false;
 
-    if (!inFile->open(QIODevice::ReadOnly))
-    {
-        delete inFile;
-        return false;
-    }
     inFile->read(reinterpret_cast<char *>(&header), sizeof(header));
-    if (qFromLittleEndian(header.sig) == 0x47474F4C)
+    if (qFromLittleEndian(header.sig) == BLF_FILE_SIG)
     {
         qDebug() << "Proper BLF file header token";
         isMatch = true;
     }
     else isMatch = false;
 
-    inFile->close();
-    delete inFile;
-
     return isMatch;
 }
 
@@ -1999,21 +2872,30 @@ bool FrameFileIO::isCanalyzerBLF(QString filename)
 bool FrameFileIO::loadCanalyzerBLF(QString filename, QVector<CANFrame> *frames)
 {
     BLFHandler blf;
-    return blf.loadBLF(filename, frames);
+    return blf.loadBLF(filename, [frames](QVector<CANFrame> &chunk)
+    {
+        if (!loadFilter) frames->append(chunk);
+        else for (const CANFrame &frame : chunk) keepFrame(frames, frame);
+    }, &textLoadProgress);
+}
+
+bool FrameFileIO::saveCanalyzerBLF(QString filename, const QVector<CANFrame> *frames)
+{
+    BLFHandler blf;
+    return blf.saveBLF(filename, frames, &saveProgress, &saveCancel);
 }
 
 bool FrameFileIO::isNativeCSVFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isNativeCSVFile);
+}
+
+bool FrameFileIO::isNativeCSVFile(QIODevice *inFile)
+{
     QByteArray line;
     int fileVersion = 1;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         line = inFile->readLine().toUpper(); //read out the header first and discard it.
@@ -2033,11 +2915,11 @@ bool FrameFileIO::isNativeCSVFile(QString filename)
                 {
                     if (fileVersion == 1)
                     {
-                        if (tokens[4].toUInt() > 8) isMatch = false;
+                        if (tokens[4].toUInt() > 64) isMatch = false;
                     }
                     else if (fileVersion == 2)
                     {
-                        if ( tokens[5].toUInt() > 8) isMatch = false;
+                        if (tokens[5].toUInt() > 64) isMatch = false;
                     }
                 }
                 else isMatch = false;
@@ -2048,8 +2930,6 @@ bool FrameFileIO::isNativeCSVFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
 
     return isMatch;
 }
@@ -2057,164 +2937,342 @@ bool FrameFileIO::isNativeCSVFile(QString filename)
 //The "native" file format for this program
 //Time Stamp,ID,Extended,Dir,Bus,LEN,D1,D2,D3,D4,D5,D6,D7,D8
 //39747828,000005EB,false,Rx,0,8,E8,45,85,4B,4A,28,36,69,
+//CAN-FD frames have a LEN past 8 and that many data columns, the header still stops at D8
 bool FrameFileIO::loadNativeCSVFile(QString filename, QVector<CANFrame>* frames)
 {
-    QFile *inFile = new QFile(filename);
-    CANFrame thisFrame;
-    QByteArray line;
-    int fileVersion = 1;
-    uint64_t timeStamp = Utility::GetTimeMS();
-    int lineCounter = 0;
-    bool foundErrors = false;
-    thisFrame.setFrameType(QCanBusFrame::DataFrame);
+    return loadTextLog(filename, TextLogFormat::GVRET_CSV, nullptr, frames);
+}
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
+bool FrameFileIO::saveNativeCSVFile(QString filename, const QVector<CANFrame>* frames)
+{
+    QFile outFile(filename);
+
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text))
     {
-        delete inFile;
         return false;
     }
 
-    line = inFile->readLine().toUpper(); //read out the header first and discard it.
-    if (line.at(23) == 'D') fileVersion = 2; //Dir is found starting at position 23 if this is a V2 file
+    SaveBuffer out(&outFile);
+    out.put("Time Stamp,ID,Extended,Dir,Bus,LEN,D1,D2,D3,D4,D5,D6,D7,D8");
+    out.put('\n');
 
-    while (!inFile->atEnd()) {
-        lineCounter++;
-        if (lineCounter > 100)
+    for (int c = 0; c < frames->count(); c++)
+    {
+        if (saveStopped(c, frames->count())) break;
+        putNativeCSVLine(out, frames->at(c));
+    }
+    return out.flush();
+}
+
+/*
+ * Continuous logging, on a thread of its own. The GUI thread only copies frames into an LFQueue, the writer thread
+ * takes them out, formats them and writes them to the current file. If the disk can't keep up the queue fills and
+ * the frames that don't fit are counted as dropped instead of holding up the GUI.
+ *
+ * With a size or age limit the log is split into files named after the one picked plus the time each was started,
+ * log-20240131-142500.csv and so on, each of them complete on its own (CSV header, binary index, compressed stream
+ * end). Without limits it's the one file, under exactly the name picked.
+ */
+class ContinuousLogger
+{
+public:
+    enum Format
+    {
+        CSV,
+        BINARY
+    };
+    //when files are fsynced. Flushing to the OS happens regardless, this is about surviving a power cut
+    enum SyncPolicy
+    {
+        SYNC_NONE,
+        SYNC_ROTATE, //each file once it's closed
+        SYNC_FLUSH //on every periodic flush as well
+    };
+
+    ContinuousLogger(const QString &filename, Format format, qint64 maxBytes, qint64 maxMsecs, SyncPolicy sync)
+        : filename(filename), format(format), maxBytes(maxBytes), maxMsecs(maxMsecs), sync(sync)
+    {
+        compression = format == CSV ? CompressedLog::fromFileName(filename) : LogCompression::NONE;
+        QString plain = filename;
+        if (compression != LogCompression::NONE)
         {
-            qApp->processEvents();
-            lineCounter = 0;
+            compressionSuffix = plain.right(CompressedLog::suffix(compression).length());
+            plain.chop(compressionSuffix.length());
         }
-
-        line = inFile->readLine().simplified();
-        if (line.length() > 2)
+        int dot = plain.lastIndexOf('.');
+        if (dot > plain.lastIndexOf('/'))
         {
-            QList<QByteArray> tokens = line.split(',');
-            if (tokens.length() >= 5)
-            {
-                if (tokens[0].length() > 3)
-                {
-                    thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, tokens[0].toULongLong()));
-                }
-                else
-                {
-                    timeStamp += 5;
-                    thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, timeStamp));
-                }
-
-                thisFrame.setFrameId(tokens[1].toUInt(nullptr, 16));
-                if (tokens[2].toUpper().contains("TRUE")) thisFrame.setExtendedFrameFormat(true);
-                    else thisFrame.setExtendedFrameFormat(false);
+            stem = plain.left(dot);
+            extension = plain.mid(dot);
+        }
+        else stem = plain;
+        queue.setSize(CONTINUOUS_QUEUE_FRAMES);
+    }
 
-                //fix for faulty files that fail to set the extended flag when they should
-                if (thisFrame.frameId() > 0x7FF) thisFrame.setExtendedFrameFormat(true);
+    ~ContinuousLogger()
+    {
+        stop();
+    }
 
-                thisFrame.setFrameType(QCanBusFrame::DataFrame);
+    //opens the first file here so a bad name or directory shows up right away
+    bool start()
+    {
+        if (compression != LogCompression::NONE && !CompressedLog::isSupported(compression)) return false;
+        if (!openFile()) return false;
+        worker = QThread::create([this]{ run(); });
+        worker->start();
+        return true;
+    }
 
-                if (fileVersion == 1)
-                {
-                    thisFrame.isReceived = true;
-                    thisFrame.bus = tokens[3].toInt();
-                    int lng = tokens[4].toInt();
-                    if (lng > 8) lng = 8;
-                    if (lng < 0) lng = 0;
-                    if (lng + 5 > tokens.length()) lng = tokens.length() - 5;
-                    QByteArray bytes(lng, 0);
-                    for (int c = 0; c < lng; c++) bytes[c] = 0;
-                    for (int d = 0; d < lng; d++)
-                        bytes[d] = static_cast<char>(tokens[5 + d].toInt(nullptr, 16));
-                    thisFrame.setPayload(bytes);
-                }
-                else if (fileVersion == 2)
-                {
-                    if (tokens[3].at(0) == 'R') thisFrame.isReceived = true;
-                    else thisFrame.isReceived = false;
-                    thisFrame.bus = tokens[4].toInt();                    
-                    int lng = tokens[5].toInt();
-                    if (lng > 8) lng = 8;
-                    if (lng < 0) lng = 0;
-                    if (lng + 6 > tokens.length()) lng = tokens.length() - 6;
-                    QByteArray bytes(lng, 0);
-                    for (int c = 0; c < lng; c++) bytes[c] = 0;
-                    for (int d = 0; d < lng; d++)
-                        bytes[d] = static_cast<char>(tokens[6 + d].toInt(nullptr, 16));
-                    thisFrame.setPayload(bytes);
-                }
+    bool stop()
+    {
+        if (!worker) return false;
+        {
+            QMutexLocker locker(&lock);
+            quit = true;
+            wake.wakeOne();
+        }
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+        return error.loadRelaxed() == 0;
+    }
 
-                frames->append(thisFrame);
+    //GUI thread only, it's the one producer the queue allows
+    bool add(const QVector<CANFrame> &frames, int first)
+    {
+        int c = first;
+        while (c < frames.count())
+        {
+            int granted;
+            CANFrame *dest = queue.reserve(frames.count() - c, granted);
+            if (!dest)
+            {
+                queue.drop(frames.count() - c);
+                return false;
             }
-            else foundErrors = true;
+            for (int i = 0; i < granted; i++) dest[i] = frames[c + i];
+            queue.commit(granted);
+            c += granted;
         }
+        return true;
     }
-    inFile->close();
-    delete inFile;
-    return !foundErrors;
-}
 
-bool FrameFileIO::saveNativeCSVFile(QString filename, const QVector<CANFrame>* frames)
-{
-    QFile *outFile = new QFile(filename);
-    int lineCounter = 0;
+    void requestFlush()
+    {
+        QMutexLocker locker(&lock);
+        flushWanted = true;
+        wake.wakeOne();
+    }
 
-    const unsigned char *data;
-    int dataLen;
-    const CANFrame *frame;
+    ContinuousLogStatus status()
+    {
+        ContinuousLogStatus stat;
+        stat.active = worker != nullptr;
+        stat.failed = error.loadRelaxed() != 0;
+        stat.framesWritten = written.loadRelaxed();
+        stat.framesDropped = queue.dropped() + lost.loadRelaxed();
+        QMutexLocker locker(&lock);
+        stat.currentFile = currentFile;
+        stat.files = files;
+        return stat;
+    }
+
+private:
+    void run()
+    {
+        for (;;)
+        {
+            bool stopping;
+            bool flushing;
+            {
+                QMutexLocker locker(&lock);
+                if (!quit && !flushWanted && queue.count() == 0) wake.wait(&lock, CONTINUOUS_POLL_MS);
+                stopping = quit;
+                flushing = flushWanted;
+                flushWanted = false;
+            }
+
+            drain();
+            if (isOpen() && rotationDue())
+            {
+                if (!closeFile()) error.storeRelaxed(1);
+            }
+            if (flushing && isOpen() && !flushFile(sync == SYNC_FLUSH)) error.storeRelaxed(1);
+
+            if (stopping)
+            {
+                drain();
+                if (isOpen() && !closeFile()) error.storeRelaxed(1);
+                return;
+            }
+        }
+    }
 
-    if (!outFile->open(QIODevice::WriteOnly | QIODevice::Text))
+    void drain()
     {
-        delete outFile;
-        return false;
+        int available;
+        CANFrame *frames;
+        while ((frames = queue.peekSpan(available)))
+        {
+            int batch = qMin(available, CONTINUOUS_BATCH_FRAMES);
+            //the new file is opened when there are frames for it so a quiet bus doesn't leave empty ones behind
+            if (!isOpen() && !openFile()) error.storeRelaxed(1);
+            if (isOpen())
+            {
+                if (!writeFrames(frames, batch)) error.storeRelaxed(1);
+                written.fetchAndAddRelaxed(batch);
+                if (rotationDue() && !closeFile()) error.storeRelaxed(1);
+            }
+            else lost.fetchAndAddRelaxed(batch);
+            queue.dequeue(batch);
+        }
     }
 
-    outFile->write("Time Stamp,ID,Extended,Dir,Bus,LEN,D1,D2,D3,D4,D5,D6,D7,D8");
-    outFile->write("\n");
-
-    for (int c = 0; c < frames->count(); c++)
+    bool writeFrames(const CANFrame *frames, int count)
     {
-        lineCounter++;
-        if (lineCounter > 100)
+        if (binary)
         {
-            qApp->processEvents();
-            lineCounter = 0;
+            bool ok = true;
+            for (int c = 0; c < count; c++) ok &= binary->addFrame(frames[c]);
+            return ok;
         }
 
-        frame = &frames->at(c);
-        data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
-        dataLen = frame->payload().count();
-
-        outFile->write(QString::number(frame->timeStamp().microSeconds()).toUtf8());
-        outFile->putChar(44);
-
-        outFile->write(QString::number(frame->frameId(), 16).toUpper().rightJustified(8, '0').toUtf8());
-        outFile->putChar(44);
+        SaveBuffer buffer(out);
+        for (int c = 0; c < count; c++) putNativeCSVLine(buffer, frames[c]);
+        return buffer.flush();
+    }
 
-        if (frame->hasExtendedFrameFormat()) outFile->write("true,");
-        else outFile->write("false,");
+    bool rotating() const { return maxBytes > 0 || maxMsecs > 0; }
 
-        if (frame->isReceived) outFile->write("Rx,");
-        else outFile->write("Tx,");
+    bool rotationDue() const
+    {
+        if (maxMsecs > 0 && age.elapsed() >= maxMsecs) return true;
+        if (maxBytes <= 0) return false;
+        //compressed files go by what's actually on the disk, not what went into the compressor
+        qint64 size = compressed ? compressed->compressedSize() : file.pos();
+        return size >= maxBytes;
+    }
 
-        outFile->write(QString::number(frame->bus).toUtf8());
-        outFile->putChar(44);
+    QString nextFileName() const
+    {
+        if (!rotating()) return filename;
+        QString base = stem + "-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+        QString name = base + extension + compressionSuffix;
+        //small limits on a busy bus can fill more than one file a second
+        for (int n = 2; QFile::exists(name); n++) name = base + "-" + QString::number(n) + extension + compressionSuffix;
+        return name;
+    }
 
-        outFile->write(QString::number(dataLen).toUtf8());
-        outFile->putChar(44);
+    bool isOpen() const { return compressed || file.isOpen(); }
 
-        for (int temp = 0; temp < 8; temp++)
+    bool openFile()
+    {
+        QString name = nextFileName();
+        if (compression != LogCompression::NONE)
         {
-            if (temp < dataLen)
-                outFile->write(QString::number(data[temp], 16).toUpper().rightJustified(2, '0').toUtf8());
-            else
-                outFile->write("00");
-            outFile->putChar(44);
+            compressed = new CompressedLogWriter(name, compression);
+            if (!compressed->open(QIODevice::WriteOnly | QIODevice::Text))
+            {
+                delete compressed;
+                compressed = nullptr;
+                return false;
+            }
+            out = compressed;
         }
+        else
+        {
+            file.setFileName(name);
+            if (!file.open(format == BINARY ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Text)) return false;
+            if (format == BINARY)
+            {
+                binary = new BinaryCaptureWriter(&file);
+                if (!binary->begin())
+                {
+                    delete binary;
+                    binary = nullptr;
+                    file.close();
+                    return false;
+                }
+            }
+            else out = &file;
+        }
+        if (out) out->write("Time Stamp,ID,Extended,Dir,Bus,LEN,D1,D2,D3,D4,D5,D6,D7,D8\n");
+        age.start();
 
-        outFile->write("\n");
-
+        QMutexLocker locker(&lock);
+        currentFile = name;
+        files++;
+        return true;
     }
-    outFile->close();
-    delete outFile;
-    return true;
-}
+
+    bool closeFile()
+    {
+        bool ok = true;
+        bool toDisk = sync != SYNC_NONE;
+        if (compressed)
+        {
+            if (toDisk) ok = compressed->syncToDisk();
+            compressed->close();
+            ok &= !compressed->failed();
+            delete compressed;
+            compressed = nullptr;
+        }
+        else
+        {
+            if (binary)
+            {
+                ok = binary->finish();
+                delete binary;
+                binary = nullptr;
+            }
+            if (toDisk) ok &= Utility::syncToDisk(file);
+            file.close();
+        }
+        out = nullptr;
+        return ok;
+    }
+
+    //pushes out the partial binary block or compressor block too so a crash loses at most the last couple of seconds
+    bool flushFile(bool toDisk)
+    {
+        if (compressed) return toDisk ? compressed->syncToDisk() : compressed->flushBlock();
+        bool ok = true;
+        if (binary) ok = binary->flushBlock();
+        return ok && (toDisk ? Utility::syncToDisk(file) : file.flush());
+    }
+
+    const QString filename;
+    const Format format;
+    const qint64 maxBytes; //0 for no limit
+    const qint64 maxMsecs;
+    const SyncPolicy sync;
+    LogCompression compression;
+    QString stem; //filename split up for the rotated names
+    QString extension;
+    QString compressionSuffix;
+
+    LFQueue<CANFrame> queue;
+    QThread *worker = nullptr;
+    QMutex lock;
+    QWaitCondition wake;
+    bool quit = false; //under lock
+    bool flushWanted = false; //under lock
+    QString currentFile; //under lock
+    int files = 0; //under lock
+    QAtomicInteger<quint64> written;
+    QAtomicInteger<quint64> lost; //dequeued while no file could be opened
+    QAtomicInt error;
+
+    //writer thread only once it's started
+    QFile file;
+    BinaryCaptureWriter *binary = nullptr;
+    CompressedLogWriter *compressed = nullptr;
+    QIODevice *out = nullptr; //null for binary
+    QElapsedTimer age;
+
+    Q_DISABLE_COPY(ContinuousLogger)
+};
 
 bool FrameFileIO::openContinuousNative()
 {
@@ -2224,6 +3282,7 @@ bool FrameFileIO::openContinuousNative()
 
     QStringList filters;
     filters.append(QString(tr("GVRET Logs (*.csv *.CSV)")));
+    filters.append(QString(tr("SavvyCAN Binary Capture (*.scb *.SCB)")));
 
     dialog.setDirectory(settings.value("FileIO/LoadSaveDirectory", dialog.directory().path()).toString());
     dialog.setFileMode(QFileDialog::AnyFile);
@@ -2234,14 +3293,28 @@ bool FrameFileIO::openContinuousNative()
     if (dialog.exec() == QDialog::Accepted)
     {
         filename = dialog.selectedFiles()[0];
-        continuousFile.setFileName(filename);
 
-        if (!continuousFile.open(QIODevice::WriteOnly | QIODevice::Text))
+        //binary captures can't be compressed as they go, their index needs to know where each block landed.
+        //The CSV can by ending the name in .gz, .zst or .lz4
+        ContinuousLogger::Format format = ContinuousLogger::CSV;
+        if (dialog.selectedNameFilter() == filters[1])
+        {
+            if (!filename.contains('.')) filename += ".scb";
+            format = ContinuousLogger::BINARY;
+        }
+        else if (!filename.contains('.')) filename += ".csv";
+
+        closeContinuousNative();
+        qint64 maxBytes = settings.value("FileIO/ContinuousRotateMB", 0).toLongLong() * 1024 * 1024;
+        qint64 maxMsecs = settings.value("FileIO/ContinuousRotateMinutes", 0).toLongLong() * 60000;
+        int sync = qBound(0, settings.value("FileIO/ContinuousSync", 0).toInt(), 2);
+        continuousLogger = new ContinuousLogger(filename, format, maxBytes, maxMsecs, static_cast<ContinuousLogger::SyncPolicy>(sync));
+        if (!continuousLogger->start())
         {
+            delete continuousLogger;
+            continuousLogger = nullptr;
             return false;
         }
-        continuousFile.write("Time Stamp,ID,Extended,Dir,Bus,LEN,D1,D2,D3,D4,D5,D6,D7,D8");
-        continuousFile.write("\n");
         settings.setValue("FileIO/LoadSaveDirectory", dialog.directory().path());
         return true;
     }
@@ -2250,82 +3323,76 @@ bool FrameFileIO::openContinuousNative()
 
 bool FrameFileIO::closeContinuousNative()
 {
-    if (continuousFile.isOpen())
-    {
-        continuousFile.close();
-        return true;
-    }
-    return false;
+    if (!continuousLogger) return false;
+    bool ok = continuousLogger->stop();
+    delete continuousLogger;
+    continuousLogger = nullptr;
+    return ok;
 }
 
-bool FrameFileIO::writeContinuousNative(const QVector<CANFrame>* frames, int beginningFrame)
+ContinuousLogStatus FrameFileIO::continuousStatus()
 {
+    if (!continuousLogger) return ContinuousLogStatus();
+    return continuousLogger->status();
+}
 
-    const unsigned char *data;
-    int dataLen;
-    const CANFrame *frame;
-
-    if (!continuousFile.isOpen()) return false;
-    qDebug() << "Bgn: " << beginningFrame << "  Count: " << frames->count();
-    for (int c = beginningFrame; c < frames->count(); c++)
-    {
-        frame = &frames->at(c);
-        data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
-        dataLen = frame->payload().count();
-
-        continuousFile.write(QString::number(frame->timeStamp().microSeconds()).toUtf8());
-        continuousFile.putChar(44);
-
-        continuousFile.write(QString::number(frame->frameId(), 16).toUpper().rightJustified(8, '0').toUtf8());
-        continuousFile.putChar(44);
-
-        if (frame->hasExtendedFrameFormat()) continuousFile.write("true,");
-        else continuousFile.write("false,");
-
-        if (frame->isReceived) continuousFile.write("Rx,");
-        else continuousFile.write("Tx,");
-
-        continuousFile.write(QString::number(frame->bus).toUtf8());
-        continuousFile.putChar(44);
+bool FrameFileIO::openSpillFile(const QString &filename)
+{
+    closeSpillFile();
+    spillFile.setFileName(filename);
+    if (!spillFile.open(QIODevice::WriteOnly)) return false;
+    spillBinary = new BinaryCaptureWriter(&spillFile);
+    if (!spillBinary->begin())
+    {
+        delete spillBinary;
+        spillBinary = nullptr;
+        spillFile.close();
+        return false;
+    }
+    return true;
+}
 
-        continuousFile.write(QString::number(dataLen).toUtf8());
-        continuousFile.putChar(44);
+//straight from the packed record, no CANFrame in between
+bool FrameFileIO::spillFrame(const CANFrameStore *store, int idx)
+{
+    if (!spillBinary) return false;
+    return spillBinary->addRecord(store->record(idx), store->payloadData(idx));
+}
 
-        for (int temp = 0; temp < 8; temp++)
-        {
-            if (temp < dataLen)
-                continuousFile.write(QString::number(data[temp], 16).toUpper().rightJustified(2, '0').toUtf8());
-            else
-                continuousFile.write("00");
-            continuousFile.putChar(44);
-        }
+bool FrameFileIO::closeSpillFile()
+{
+    if (!spillBinary) return false;
+    bool ok = spillBinary->finish();
+    delete spillBinary;
+    spillBinary = nullptr;
+    spillFile.close();
+    return ok;
+}
 
-        continuousFile.write("\n");
-    }
-    return true;
+bool FrameFileIO::writeContinuousNative(const QVector<CANFrame>* frames, int beginningFrame)
+{
+    if (!continuousLogger) return false;
+    return continuousLogger->add(*frames, beginningFrame);
 }
 
 bool FrameFileIO::flushContinuousNative()
 {
-    if (continuousFile.isOpen())
-    {
-        return continuousFile.flush();
-    }
-    return false;
+    if (!continuousLogger) return false;
+    continuousLogger->requestFlush();
+    return true;
 }
 
 
 bool FrameFileIO::isGenericCSVFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isGenericCSVFile);
+}
+
+bool FrameFileIO::isGenericCSVFile(QIODevice *inFile)
+{
     QByteArray line;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         line = inFile->readLine(); //read out the header first and discard it.
@@ -2359,8 +3426,6 @@ bool FrameFileIO::isGenericCSVFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -2410,7 +3475,7 @@ bool FrameFileIO::loadGenericCSVFile(QString filename, QVector<CANFrame>* frames
                 QByteArray bytes(dLen, 0);
                 for (int d = 0; d < dLen; d++) bytes[d] = static_cast<char>(dataTok[d].toInt(nullptr, 16));
                 thisFrame.setPayload(bytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
         }
         else foundErrors = true;
@@ -2423,64 +3488,48 @@ bool FrameFileIO::loadGenericCSVFile(QString filename, QVector<CANFrame>* frames
 //4f5,ff 34 23 45 24 e4
 bool FrameFileIO::saveGenericCSVFile(QString filename, const QVector<CANFrame>* frames)
 {
-    QFile *outFile = new QFile(filename);
-    int lineCounter = 0;
-
-    const unsigned char *data;
-    int dataLen;
-    const CANFrame *frame;
+    QFile outFile(filename);
 
-    if (!outFile->open(QIODevice::WriteOnly | QIODevice::Text))
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text))
     {
-        delete outFile;
         return false;
     }
 
-    outFile->write("ID,Data Bytes");
-    outFile->write("\n");
+    SaveBuffer out(&outFile);
+    out.put("ID,Data Bytes");
+    out.put('\n');
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
-
-        frame = &frames->at(c);
-        data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
-        dataLen = frame->payload().count();
+        if (saveStopped(c, frames->count())) break;
 
-        outFile->write(QString::number(frame->frameId(), 16).toUpper().rightJustified(8, '0').toUtf8());
-        outFile->putChar(44);
+        const CANFrame &frame = frames->at(c);
+        const QByteArray payload = frame.payload();
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(payload.constData());
 
-        for (int temp = 0; temp < dataLen; temp++)
+        out.putHex(frame.frameId(), 8);
+        out.put(',');
+        for (int temp = 0; temp < payload.count(); temp++)
         {
-            outFile->write(QString::number(data[temp], 16).toUpper().rightJustified(2, '0').toUtf8());
-            outFile->putChar(' ');
+            out.putByte(data[temp]);
+            out.put(' ');
         }
-
-        outFile->write("\n");
-
+        out.put('\n');
+        out.lineDone();
     }
-    outFile->close();
-    delete outFile;
-    return true;
+    return out.flush();
 }
 
 bool FrameFileIO::isLogFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isLogFile);
+}
+
+bool FrameFileIO::isLogFile(QIODevice *inFile)
+{
     QByteArray line;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         line = inFile->readLine().toUpper();
@@ -2516,8 +3565,6 @@ bool FrameFileIO::isLogFile(QString filename)
         isMatch = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -2616,7 +3663,7 @@ bool FrameFileIO::loadLogFile(QString filename, QVector<CANFrame>* frames)
                         bytes[d] = static_cast<char>(tokens[d + 6].toInt(nullptr, 16));
                 }
                 thisFrame.setPayload(bytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
             else foundErrors = true;
         }
@@ -2630,7 +3677,6 @@ bool FrameFileIO::saveLogFile(QString filename, const QVector<CANFrame>* frames)
 {
     QFile *outFile = new QFile(filename);
     QDateTime timestamp, tempStamp;
-    int lineCounter = 0;
 
     const unsigned char *data;
     int dataLen;
@@ -2662,12 +3708,7 @@ bool FrameFileIO::saveLogFile(QString filename, const QVector<CANFrame>* frames)
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
 
         frame = &frames->at(c);
         data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
@@ -2709,16 +3750,14 @@ bool FrameFileIO::saveLogFile(QString filename, const QVector<CANFrame>* frames)
 
 bool FrameFileIO::isIXXATFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isIXXATFile);
+}
+
+bool FrameFileIO::isIXXATFile(QIODevice *inFile)
+{
     QByteArray line;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         line = inFile->readLine().toUpper();
@@ -2737,8 +3776,6 @@ bool FrameFileIO::isIXXATFile(QString filename)
         isMatch = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -2813,7 +3850,7 @@ bool FrameFileIO::loadIXXATFile(QString filename, QVector<CANFrame>* frames)
                 if (numBytes > 8) return false;
                 for (int d = 0; d < numBytes; d++) bytes[d] = static_cast<char>(dataToks[d].toInt(nullptr, 16));
                 thisFrame.setPayload(bytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
             else return false;
         }
@@ -2827,7 +3864,6 @@ bool FrameFileIO::saveIXXATFile(QString filename, const QVector<CANFrame>* frame
 {
     QFile *outFile = new QFile(filename);
     QDateTime timestamp, tempStamp;
-    int lineCounter = 0;
 
     const unsigned char *data;
     int dataLen;
@@ -2852,12 +3888,7 @@ bool FrameFileIO::saveIXXATFile(QString filename, const QVector<CANFrame>* frame
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
 
         frame = &frames->at(c);
         data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
@@ -2887,17 +3918,15 @@ bool FrameFileIO::saveIXXATFile(QString filename, const QVector<CANFrame>* frame
 
 bool FrameFileIO::isCANDOFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, false, isCANDOFile);
+}
+
+bool FrameFileIO::isCANDOFile(QIODevice *inFile)
+{
     int lineCounter = 0;
     QByteArray data;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly))
-    {
-        delete inFile;
-        return false;
-    }
-
     //this file format is in static 12 byte blocks.
     //Bytes 0 - 1 are a time stamp
     //Bytes 2 - 3 are the data length (top 4 bits) then ID (bottom 11 bits)
@@ -2928,8 +3957,6 @@ bool FrameFileIO::isCANDOFile(QString filename)
         isMatch = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -2989,7 +4016,7 @@ bool FrameFileIO::loadCANDOFile(QString filename, QVector<CANFrame>* frames)
         {
             for (int d = 0; d < numBytes; d++) bytes[d] = data[4 + d];
             thisFrame.setPayload(bytes);
-            frames->append(thisFrame);
+            keepFrame(frames, thisFrame);
         }
         else foundErrors = true;
     }
@@ -3002,7 +4029,6 @@ bool FrameFileIO::loadCANDOFile(QString filename, QVector<CANFrame>* frames)
 bool FrameFileIO::saveCANDOFile(QString filename, const QVector<CANFrame>* frames)
 {
     QFile *outFile = new QFile(filename);
-    int lineCounter = 0;
     QByteArray data;
     CANFrame thisFrame;
     int id;
@@ -3032,12 +4058,7 @@ bool FrameFileIO::saveCANDOFile(QString filename, const QVector<CANFrame>* frame
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
 
         frame = &frames->at(c);
         inData = reinterpret_cast<const unsigned char *>(frame->payload().constData());
@@ -3064,17 +4085,16 @@ bool FrameFileIO::saveCANDOFile(QString filename, const QVector<CANFrame>* frame
 
 bool FrameFileIO::isMicrochipFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isMicrochipFile);
+}
+
+bool FrameFileIO::isMicrochipFile(QIODevice *inFile)
+{
     QByteArray line;
     bool inComment = false;
     int lineCounter = 0;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         while (!inFile->atEnd() && lineCounter < 100) {
@@ -3110,8 +4130,6 @@ bool FrameFileIO::isMicrochipFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -3180,7 +4198,7 @@ bool FrameFileIO::loadMicrochipFile(QString filename, QVector<CANFrame>* frames)
                         if (thisFrame.payload().length() + 4 > tokens.length()) thisFrame.payload().resize( tokens.length() - 4 );
                         for (int d = 0; d < numBytes; d++) bytes[d] = static_cast<char>( Utility::ParseStringToNum(tokens[4 + d]) );
                         thisFrame.setPayload(bytes);
-                        frames->append(thisFrame);
+                        keepFrame(frames, thisFrame);
                     }
                     else foundErrors = true;
                 }
@@ -3207,7 +4225,6 @@ bool FrameFileIO::saveMicrochipFile(QString filename, const QVector<CANFrame>* f
 {
     QFile *outFile = new QFile(filename);
     QDateTime timestamp, tempStamp;
-    int lineCounter = 0;
 
     const unsigned char *data;
     int dataLen;
@@ -3232,12 +4249,7 @@ bool FrameFileIO::saveMicrochipFile(QString filename, const QVector<CANFrame>* f
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
 
         frame = &frames->at(c);
         data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
@@ -3265,17 +4277,15 @@ bool FrameFileIO::saveMicrochipFile(QString filename, const QVector<CANFrame>* f
 
 bool FrameFileIO::isTraceFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isTraceFile);
+}
+
+bool FrameFileIO::isTraceFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         while (!inFile->atEnd() && lineCounter < 100) {
@@ -3314,8 +4324,6 @@ bool FrameFileIO::isTraceFile(QString filename)
         isMatch = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -3406,7 +4414,7 @@ bool FrameFileIO::loadTraceFile(QString filename, QVector<CANFrame>* frames)
                     //if (numBytes > dataToks.length()) thisFrame.payload().resize(dataToks.length());
                     for (int d = 0; d < numBytes; d++) bytes[d] = static_cast<char>(dataToks[d].toInt(nullptr, 16));
                     thisFrame.setPayload(bytes);
-                    frames->append(thisFrame);
+                    keepFrame(frames, thisFrame);
                 }
                 else foundErrors = true;
             }
@@ -3461,11 +4469,7 @@ bool FrameFileIO::saveTraceFile(QString filename, const QVector<CANFrame> * fram
     for (int c = 0; c < frames->count(); c++)
     {
         lineCounter++;
-        if ((lineCounter % 100) == 0)
-        {
-            qApp->processEvents();
-            //lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
 
         frame = &frames->at(c);
         data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
@@ -3517,7 +4521,6 @@ bool FrameFileIO::saveCanDumpFile(QString filename, const QVector<CANFrame> * fr
 {
     QFile *outFile = new QFile(filename);
     QDateTime timestamp;
-    int lineCounter = 0;
     double tempTime;
 
     const unsigned char *data;
@@ -3534,11 +4537,7 @@ bool FrameFileIO::saveCanDumpFile(QString filename, const QVector<CANFrame> * fr
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if ((lineCounter % 100) == 0)
-        {
-            qApp->processEvents();
-        }
+        if (saveStopped(c, frames->count())) break;
 
         frame = &frames->at(c);
         data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
@@ -3578,23 +4577,22 @@ bool FrameFileIO::saveCanDumpFile(QString filename, const QVector<CANFrame> * fr
 
 bool FrameFileIO::isCanDumpFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isCanDumpFile);
+}
+
+bool FrameFileIO::isCanDumpFile(QIODevice *inFile)
+{
     QByteArray line;
     QList<QByteArray> tokens;
-    QRegularExpression timeExp(QRegularExpression::anchoredPattern("^\\((\\S+)\\)$")); //anchored pattern causes exact match
-    QRegularExpression IdValExp(QRegularExpression::anchoredPattern("^(\\S+)#(\\S+)$"));
-    QRegularExpression valExp("(\\S{2})");
+    //compiled once, the probe runs for every file that gets auto detected
+    static const QRegularExpression timeExp(QRegularExpression::anchoredPattern("^\\((\\S+)\\)$")); //anchored pattern causes exact match
+    static const QRegularExpression IdValExp(QRegularExpression::anchoredPattern("^(\\S+)#(\\S+)$"));
+    static const QRegularExpression valExp("(\\S{2})");
     int lineCounter = 0;
     int pos = 0;
     bool isMatch = true;
     bool ret;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         while (!inFile->atEnd() && lineCounter < 100) {
@@ -3645,7 +4643,6 @@ bool FrameFileIO::isCanDumpFile(QString filename)
                         continue;
                     }
 
-
                     QRegularExpressionMatch IdValExpMatched = IdValExp.match(tokens[2]);
                     if(!IdValExpMatched.hasMatch())
                     {
@@ -3697,8 +4694,6 @@ bool FrameFileIO::isCanDumpFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -3709,146 +4704,88 @@ bool FrameFileIO::isCanDumpFile(QString filename)
 */
 bool FrameFileIO::loadCanDumpFile(QString filename, QVector<CANFrame>* frames)
 {
-    QFile *inFile = new QFile(filename);
-    CANFrame thisFrame;
-    QByteArray line;
-    QList<QByteArray> tokens;
-    QRegularExpression timeExp(QRegularExpression::anchoredPattern("^\\((\\S+)\\)$")); //anchored pattern causes exact match
-    QRegularExpression IdValExp(QRegularExpression::anchoredPattern("^(\\S+)#(\\S+)$"));
-    QRegularExpression valExp("(\\S{2})");
-    int lineCounter = 0;
-    bool ret;
+    return loadTextLog(filename, TextLogFormat::CANDUMP, frames);
+}
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
+//the loaders that go through loadLinesInParallel and so can have a sidecar index
+bool FrameFileIO::loadTextLog(const QString &filename, TextLogFormat format, QVector<CANFrame>* frames)
+{
+    bool foundErrors = false;
+
+    switch (format)
     {
-        delete inFile;
-        return false;
-    }
+    case TextLogFormat::GVRET_CSV:
+    {
+        NativeCSVLineParser parser;
+        uint64_t timeStamp = Utility::GetTimeMS();
 
-    while (!inFile->atEnd()) {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        QFile inFile(filename);
+        if (!inFile.open(QIODevice::ReadOnly | QIODevice::Text)) return false;
+        QByteArray line = inFile.readLine().toUpper(); //read out the header first and discard it.
+        if (line.length() > 23 && line.at(23) == 'D') parser.fileVersion = 2; //Dir is found starting at position 23 if this is a V2 file
+        inFile.close();
 
-        line = inFile->readLine().toUpper();
-        if (line.length() > 1)
-        {
-            /* tokenize */
-            tokens.clear();
-            tokens = line.simplified().split(' ');
-            if(tokens.count()<3) continue;
-
-            /* timestamp */
-            QRegularExpressionMatch timeExpMatched = timeExp.match(tokens[0]);
-            if(!timeExpMatched.hasMatch()) continue;
-            
-            //Sort out the bus
-            std::string busString = tokens[1].toStdString();
-            const char* busStringPtr = busString.c_str();
-            
-            int busNum = 0;
-            
-            //Search for where we have a bus number (skipping the can or vcan text)
-            for (unsigned int i = 0; i < busString.length(); i++)
-            {
-                if (busStringPtr[i] >= '0' && busStringPtr[i] <= '9')
-                {
-                    //Found where the number starts
-                    busNum = atoi(busStringPtr + i);
-                    break;
-                }
-            }
-            
-            thisFrame.bus = busNum;
-            
-            thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, (uint64_t)(timeExpMatched.captured(1).toDouble(&ret) * (double)1000000.0)));
-            if(!ret) continue;
+        int firstNew = frames->count();
+        if (!loadLinesInParallel(filename, 1, parser, frames, foundErrors, format)) return false;
 
-            if (line.contains('[')) //the expanded format (second one from the above list)
+        //frames that came without a timestamp get made up ones 5us apart, in file order
+        for (int i = firstNew; i < frames->count(); i++)
+        {
+            if ((*frames)[i].timeStamp().microSeconds() < 0)
             {
-                //(1551774790.942758) can1 7A8 [8] F4 DC D1 83 0E 02 00 00
-                //     0               1     2   3  4 5  6  7  8  9  10 11
-                thisFrame.setFrameId(tokens[2].toLong(nullptr, 16));
-                if (thisFrame.frameId() > 0x7FF) thisFrame.setExtendedFrameFormat(true);
-                else thisFrame.setExtendedFrameFormat(false);
-                thisFrame.setFrameType(QCanBusFrame::DataFrame);
-                int numBytes = tokens[3].at(1) - '0';
-                QByteArray bytes(numBytes, 0);
-                for (int c = 0; c < numBytes; c++)
-                {
-                    if ((4 + c) < tokens.size()) bytes[c] = static_cast<char>(tokens[4 + c].toInt(nullptr, 16));
-                }
-                thisFrame.setPayload(bytes);
+                timeStamp += 5;
+                (*frames)[i].setTimeStamp(QCanBusFrame::TimeStamp(0, timeStamp));
             }
-            else  //the more concise format (first one from list above)
-            {
-                /* ID & value */
-                //qDebug() << tokens[2];
-                QRegularExpressionMatch IdValExpMatched = IdValExp.match(tokens[2]);
-                if(!IdValExpMatched.hasMatch())
-                {
-                    qDebug() << "ID regex didn't match!";
-                    continue;
-                }
-
-                /* ID */
-                thisFrame.setFrameId(static_cast<uint32_t>(IdValExpMatched.captured(1).toInt(&ret, 16)));
-                if (IdValExpMatched.captured(1).length() > 3)
-                {
-                    thisFrame.setExtendedFrameFormat(true);
-                }
-                else
-                {
-                    thisFrame.setExtendedFrameFormat(false);
-                }
-
-                QString val = IdValExpMatched.captured(2);
+        }
+        return !foundErrors;
+    }
+    case TextLogFormat::CRTD:
+        //first line is the header and gets skipped
+        if (!loadLinesInParallel(filename, 1, CRTDLineParser(), frames, foundErrors, format)) return false;
+        return !foundErrors;
+    case TextLogFormat::CANDUMP:
+        return loadLinesInParallel(filename, 0, CanDumpLineParser(), frames, foundErrors, format);
+    default:
+        return false;
+    }
+}
 
-                QByteArray bytes;
-                if (val.startsWith("R") && val.at(1).isDigit()) {
-                    thisFrame.payload().resize( val.at(1).toLatin1() - '0' );
-                    thisFrame.setFrameType(QCanBusFrame::RemoteRequestFrame);
-                } else {
-                    thisFrame.setFrameType(QCanBusFrame::DataFrame);
-                    /* val byte per byte */
-                    QRegularExpressionMatch valExpMatch;
-                    QRegularExpressionMatchIterator i = valExp.globalMatch(val);
-                    while (i.hasNext())
-                    {
-                        valExpMatch = i.next();
-                        bytes.append((char)valExpMatch.captured(1).toInt(&ret, 16));
-                        if(!ret) continue;
-                    }
-                }
-                thisFrame.setPayload(bytes);
-            }
+TextLogFormat FrameFileIO::textLogFormat(QString filename)
+{
+    if (isNativeCSVFile(filename)) return TextLogFormat::GVRET_CSV;
+    if (isCRTDFile(filename)) return TextLogFormat::CRTD;
+    if (isCanDumpFile(filename)) return TextLogFormat::CANDUMP;
+    return TextLogFormat::NONE;
+}
 
-            /*NB: should we make sure len <= 8? */
-            thisFrame.isReceived = true;
-       }
-       frames->append(thisFrame);
-    }
-    inFile->close();
-    delete inFile;
-    return true;
+//a pass over the whole log that keeps no frames, just to get the index written
+bool FrameFileIO::indexTextLog(QString filename, TextLogIndex &index)
+{
+    TextLogFormat format = textLogFormat(filename);
+    if (format == TextLogFormat::NONE) return false;
+    if (index.load(filename, format)) return true;
+
+    FrameLoadOptions none;
+    none.nothing = true;
+    FrameLoadFilter filter(none);
+    LoadFilterScope scope(&filter);
+    QVector<CANFrame> frames;
+    TextLoadProgress progress("Indexing log...");
+    loadTextLog(filename, format, &frames);
+    return index.load(filename, format);
 }
 
 bool FrameFileIO::isLawicelFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isLawicelFile);
+}
+
+bool FrameFileIO::isLawicelFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool isMatch = false;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
-
     try
     {
         while (!inFile->atEnd() && lineCounter < 100) {
@@ -3871,8 +4808,6 @@ bool FrameFileIO::isLawicelFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -3920,7 +4855,7 @@ bool FrameFileIO::loadLawicelFile(QString filename, QVector<CANFrame>* frames)
                 bytes[d] = static_cast<char>(line.mid(d * 2, 2).toInt(nullptr, 16));
             }
             thisFrame.setPayload(bytes);
-            frames->append(thisFrame);
+            keepFrame(frames, thisFrame);
         }
     }
     inFile->close();
@@ -3930,16 +4865,15 @@ bool FrameFileIO::loadLawicelFile(QString filename, QVector<CANFrame>* frames)
 
 bool FrameFileIO::isKvaserFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isKvaserFile);
+}
+
+bool FrameFileIO::isKvaserFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         line = inFile->readLine().simplified().toUpper();
@@ -3967,8 +4901,6 @@ bool FrameFileIO::isKvaserFile(QString filename)
     {
         isMatch = false;
     }
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -4025,7 +4957,7 @@ bool FrameFileIO::loadKvaserFile(QString filename, QVector<CANFrame> *frames, bo
             if (line.mid(72, 1).toUpper() == "R") thisFrame.isReceived = true;
                 else thisFrame.isReceived = false;
             thisFrame.setPayload(bytes);
-            frames->append(thisFrame);
+            keepFrame(frames, thisFrame);
         }
         //else foundErrors = true;
     }
@@ -4036,16 +4968,15 @@ bool FrameFileIO::loadKvaserFile(QString filename, QVector<CANFrame> *frames, bo
 
 bool FrameFileIO::isCabanaFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, true, isCabanaFile);
+}
+
+bool FrameFileIO::isCabanaFile(QIODevice *inFile)
+{
     QByteArray line;
     int lineCounter = 0;
     bool isMatch = true;
 
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         line = inFile->readLine().toUpper(); //read out the header first and discard it.
@@ -4073,8 +5004,6 @@ bool FrameFileIO::isCabanaFile(QString filename)
         isMatch = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -4176,7 +5105,7 @@ bool FrameFileIO::loadCabanaFile(QString filename, QVector<CANFrame>* frames)
                 }
                 
                 thisFrame.setPayload(finalbytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
             else foundErrors = true;
         }
@@ -4189,7 +5118,6 @@ bool FrameFileIO::loadCabanaFile(QString filename, QVector<CANFrame>* frames)
 bool FrameFileIO::saveCabanaFile(QString filename, const QVector<CANFrame>* frames)
 {
     QFile *outFile = new QFile(filename);
-    int lineCounter = 0;
 
     const unsigned char *data;
     int dataLen;
@@ -4206,12 +5134,7 @@ bool FrameFileIO::saveCabanaFile(QString filename, const QVector<CANFrame>* fram
 
     for (int c = 0; c < frames->count(); c++)
     {
-        lineCounter++;
-        if (lineCounter > 100)
-        {
-            qApp->processEvents();
-            lineCounter = 0;
-        }
+        if (saveStopped(c, frames->count())) break;
 
         frame = &frames->at(c);
         data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
@@ -4248,18 +5171,16 @@ bool FrameFileIO::saveCabanaFile(QString filename, const QVector<CANFrame>* fram
 
 bool FrameFileIO::isTeslaAPFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, false, isTeslaAPFile);
+}
+
+bool FrameFileIO::isTeslaAPFile(QIODevice *inFile)
+{
     CANFrame thisFrame;
     QByteArray data;
     bool isValidFile = true;
     TeslaAPCANRecord record;
 
-    if (!inFile->open(QIODevice::ReadOnly))
-    {
-        delete inFile;
-        return false;
-    }
-
     while (!inFile->atEnd())
     {
         inFile->read((char *)&record, sizeof(TeslaAPCANRecord));
@@ -4268,8 +5189,6 @@ bool FrameFileIO::isTeslaAPFile(QString filename)
         if ((record.ctr & 0xF) > 6) isValidFile = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isValidFile;
 }
 
@@ -4317,7 +5236,7 @@ bool FrameFileIO::loadTeslaAPFile(QString filename, QVector<CANFrame>* frames)
         {
             for (int d = 0; d < numBytes; d++) bytes[d] = record.data[d];
             thisFrame.setPayload(bytes);
-            frames->append(thisFrame);
+            keepFrame(frames, thisFrame);
         }
         else foundErrors = true;
     }
@@ -4328,15 +5247,11 @@ bool FrameFileIO::loadTeslaAPFile(QString filename, QVector<CANFrame>* frames)
 }
 
 bool FrameFileIO::isCLX000File(QString filename) {
-    std::unique_ptr<QFile> inFile = std::unique_ptr<QFile>(new QFile(filename));
-
-    if (!inFile->open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        qDebug() << "Could not open the file!";
-        return false;
-    }
+    return probeFile(filename, true, isCLX000File);
+}
 
-    QTextStream fileStream(inFile.get());
+bool FrameFileIO::isCLX000File(QIODevice *inFile) {
+    QTextStream fileStream(inFile);
     //bool foundErrors = false;
 
     // Contains 16 lines of header prior to (potential) data.
@@ -4759,7 +5674,7 @@ bool FrameFileIO::loadCLX000File(QString filename, QVector<CANFrame>* frames) {
                 currentFrame.setPayload(QByteArray());
             }
 
-            frames->append(currentFrame);
+            keepFrame(frames, currentFrame);
         } else {
             qDebug() << "Could not parse:" << recordLine;
         }
@@ -4775,15 +5690,14 @@ bool FrameFileIO::loadCLX000File(QString filename, QVector<CANFrame>* frames) {
 
 bool FrameFileIO::isCANServerFile(QString filename)
 {
-    QFile *inFile = new QFile(filename);
+    return probeFile(filename, false, isCANServerFile);
+}
+
+bool FrameFileIO::isCANServerFile(QIODevice *inFile)
+{
     QByteArray headerData;
     bool isMatch = false;
 
-    if (!inFile->open(QIODevice::ReadOnly))
-    {
-        delete inFile;
-        return false;
-    }
     try
     {
         //Read the first 20 bytes from the file to check for the matching signature
@@ -4806,8 +5720,6 @@ bool FrameFileIO::isCANServerFile(QString filename)
         isMatch = false;
     }
 
-    inFile->close();
-    delete inFile;
     return isMatch;
 }
 
@@ -4911,7 +5823,7 @@ bool FrameFileIO::loadCANServerFile(QString filename, QVector<CANFrame>* frames)
                 markFrame.isMark = true;
                 markFrame.markMessage = QString(markData);
                 
-                frames->append(markFrame);
+                keepFrame(frames, markFrame);
                  */
             }
             else if ((logVersion == 1 && data[0] == 0xCE) || (logVersion == 2 && data[0] == 0xA0))
@@ -4993,7 +5905,7 @@ bool FrameFileIO::loadCANServerFile(QString filename, QVector<CANFrame>* frames)
                 }
                 
                 thisFrame.setPayload(bytes);
-                frames->append(thisFrame);
+                keepFrame(frames, thisFrame);
             }
         }
     }
@@ -5007,6 +5919,63 @@ bool FrameFileIO::loadCANServerFile(QString filename, QVector<CANFrame>* frames)
     return !foundErrors;
 }
 
+//pulls the CAN frame out of one packet, depending on what the link layer puts in front of it
+static bool decodeWiresharkPacket(const unsigned char *packet, const pcap_pkthdr &header, CANFrame &frame)
+{
+    int offset = 0;
+    bool hostOrder = false; //cooked captures keep the ID the way the kernel had it, which is little endian anywhere this runs
+    bool outbound = header.outbound;
+    switch (header.linktype)
+    {
+    case DLT_CAN_SOCKETCAN:
+        break;
+    case DLT_LINUX_SLL:
+        if (header.caplen < 16) return false;
+        offset = 16;
+        hostOrder = true;
+        outbound = outbound || qFromBigEndian<quint16>(packet) == 4; //sent by us
+        break;
+    case DLT_LINUX_SLL2:
+        if (header.caplen < 20) return false;
+        offset = 20;
+        hostOrder = true;
+        outbound = outbound || packet[10] == 4;
+        break;
+    default:
+        return false;
+    }
+
+    int frameBytes = static_cast<int>(header.caplen) - offset;
+    if (frameBytes < 8) return false;
+    const unsigned char *can = packet + offset;
+    quint32 rawId = hostOrder ? qFromLittleEndian<quint32>(can) : qFromBigEndian<quint32>(can);
+    if (rawId & 0x20000000) return false; //error frame
+
+    bool fd = (can[5] & 0x04) || frameBytes >= 72; //FDF flag, or the size of a canfd_frame for captures older than the flag
+    int numBytes = qMin<int>(can[4], qMin(fd ? 64 : 8, frameBytes - 8));
+
+    frame.setExtendedFrameFormat((rawId & 0x80000000) != 0);
+    frame.setFrameId(rawId & 0x1FFFFFFF);
+    frame.isReceived = !outbound;
+    frame.bus = static_cast<int>(header.interface_id);
+    if (rawId & 0x40000000)
+    {
+        frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+        frame.setFlexibleDataRateFormat(false);
+        frame.setBitrateSwitch(false);
+        frame.setPayload(QByteArray(numBytes, 0));
+    }
+    else
+    {
+        frame.setFrameType(QCanBusFrame::DataFrame);
+        frame.setFlexibleDataRateFormat(fd);
+        frame.setBitrateSwitch(fd && (can[5] & 0x01));
+        frame.setPayload(QByteArray(reinterpret_cast<const char *>(can + 8), numBytes));
+    }
+    return true;
+}
+
+//straight out of the mapped file, see pcaplite. pcapng interfaces become buses
 bool FrameFileIO::loadWiresharkFile(QString filename, QVector<CANFrame>* frames)
 {
     pcap_t *pcap_data_file;
@@ -5014,63 +5983,105 @@ bool FrameFileIO::loadWiresharkFile(QString filename, QVector<CANFrame>* frames)
     long long startTimestamp = 0;
     long long timeStamp;
     int lineCounter = 0;
-    bool foundErrors = false;
-    pcap_pkthdr    packetHeader;
-	const char     *packetData = NULL;
-	char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_pkthdr packetHeader;
+    const unsigned char *packetData = NULL;
+    char errbuf[PCAP_ERRBUF_SIZE];
 
-    thisFrame.setFrameType(QCanBusFrame::DataFrame);
-    
     QByteArray ba = filename.toLocal8Bit();
 
     pcap_data_file = pcap_open_offline(ba.data(), errbuf);
-	if (!pcap_data_file) {
-		return false;
-	}
+    if (!pcap_data_file) {
+        return false;
+    }
+    frames->reserve(frames->count() + static_cast<int>(qMin<unsigned long long>(pcap_data_file->size / 48, 50000000)));
 
-    packetData = (const char*)pcap_next(pcap_data_file, &packetHeader);
+    packetData = pcap_next(pcap_data_file, &packetHeader);
 
     while (packetData) {
         lineCounter++;
-        if (lineCounter > 100)
+        if (lineCounter > 65536)
         {
+            textLoadProgress.storeRelaxed(pcap_progress(pcap_data_file));
             qApp->processEvents();
             lineCounter = 0;
         }
-        
-        timeStamp = packetHeader.ts.tv_sec * 1000000 + packetHeader.ts.tv_usec;
-        if (0 == startTimestamp) 
+
+        timeStamp = static_cast<long long>(packetHeader.ts.tv_sec) * 1000000 + packetHeader.ts.tv_usec;
+        //packets outside the time window don't get decoded at all once there's a start time to go by
+        if (loadFilter && startTimestamp != 0 && !loadFilter->options.matchesTime(timeStamp - startTimestamp))
         {
-            startTimestamp = timeStamp;
+            packetData = pcap_next(pcap_data_file, &packetHeader);
+            continue;
         }
 
-        timeStamp -= startTimestamp;
-
-        thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, timeStamp));
-        thisFrame.isReceived = true; // TODO: check if tx detection is possible
-            
-        thisFrame.setFrameType(QCanBusFrame::DataFrame);
-        thisFrame.setFrameId((0xff & *(packetData+17)) << 8 | (0xff & *(packetData+16)));
-        if (thisFrame.frameId() <= 0x7FF) thisFrame.setExtendedFrameFormat(false);
-            else thisFrame.setExtendedFrameFormat(true);
-        thisFrame.bus = 0;
-        int numBytes = *(packetData+20);
-        QByteArray bytes(numBytes, 0);
-        if (thisFrame.payload().length() > 8) thisFrame.payload().resize(8);
-        for (int d = 0; d < numBytes; d++) 
-        { 
-            bytes[d] = *(packetData + 24 + d);
+        if (decodeWiresharkPacket(packetData, packetHeader, thisFrame))
+        {
+            if (0 == startTimestamp)
+            {
+                startTimestamp = timeStamp;
+            }
+            thisFrame.setTimeStamp(QCanBusFrame::TimeStamp(0, timeStamp - startTimestamp));
+            keepFrame(frames, thisFrame);
         }
-        thisFrame.setPayload(bytes);
-        frames->append(thisFrame);
 
-        packetData = (const char*)pcap_next(pcap_data_file, &packetHeader);
+        packetData = pcap_next(pcap_data_file, &packetHeader);
     }
 
     pcap_close(pcap_data_file);
-	pcap_data_file = NULL;
-    
-    return !foundErrors;
+    pcap_data_file = NULL;
+    textLoadProgress.storeRelaxed(1000);
+
+    return true;
+}
+
+//pcapng with one SocketCAN interface per bus, so Wireshark shows the bus as the interface
+bool FrameFileIO::saveWiresharkFile(QString filename, const QVector<CANFrame>* frames)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    QByteArray ba = filename.toLocal8Bit();
+    pcapng_dumper *dumper = pcapng_dump_open(ba.data(), errbuf);
+    if (!dumper) return false;
+
+    QHash<int, unsigned int> interfaces;
+    unsigned char record[72];
+
+    for (int c = 0; c < frames->count(); c++)
+    {
+        const CANFrame &frame = frames->at(c);
+        if (saveStopped(c, frames->count())) break;
+
+        auto iface = interfaces.find(frame.bus);
+        if (iface == interfaces.end())
+        {
+            QByteArray name = QString("can%1").arg(frame.bus).toLatin1();
+            iface = interfaces.insert(frame.bus, static_cast<unsigned int>(pcapng_add_interface(dumper, DLT_CAN_SOCKETCAN, 72, name.constData())));
+        }
+
+        const QByteArray payload = frame.payload();
+        bool remote = frame.frameType() == QCanBusFrame::RemoteRequestFrame;
+        bool fd = !remote && (frame.hasFlexibleDataRateFormat() || payload.length() > 8);
+        int numBytes = qMin(payload.length(), fd ? 64 : 8);
+        quint32 rawId = frame.frameId() | (frame.hasExtendedFrameFormat() ? 0x80000000 : 0) | (remote ? 0x40000000 : 0);
+
+        memset(record, 0, sizeof(record));
+        qToBigEndian<quint32>(rawId, record);
+        record[4] = static_cast<unsigned char>(numBytes);
+        if (fd) record[5] = 0x04 | (frame.hasBitrateSwitch() ? 0x01 : 0);
+        if (!remote) memcpy(record + 8, payload.constData(), static_cast<size_t>(numBytes));
+        pcapng_dump(dumper, iface.value(), static_cast<unsigned long long>(frame.timeStamp().microSeconds()), record, fd ? 72 : 16, !frame.isReceived);
+    }
+
+    return pcapng_dump_close(dumper);
+}
+
+//only the magic number of a pcap or pcapng file, the real check is opening it with pcap
+bool FrameFileIO::isWiresharkFile(QIODevice *inFile)
+{
+    QByteArray magic = inFile->read(4);
+    if (magic.length() < 4) return false;
+    quint32 value = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(magic.constData()));
+    //pcapng, then pcap in microseconds and nanoseconds in either byte order
+    return value == 0x0A0D0D0A || value == 0xA1B2C3D4 || value == 0xD4C3B2A1 || value == 0xA1B23C4D || value == 0x4D3CB2A1;
 }
 
 bool FrameFileIO::isWiresharkFile(QString filename)
@@ -5089,3 +6100,123 @@ bool FrameFileIO::isWiresharkFile(QString filename)
 
     return true;
 }
+
+bool FrameFileIO::saveBinaryNativeFile(QString filename, const QVector<CANFrame>* frames)
+{
+    QFile outFile(filename);
+
+    if (!outFile.open(QIODevice::WriteOnly))
+        return false;
+
+    BinaryCaptureWriter writer(&outFile);
+    bool ok = writer.begin();
+    for (int c = 0; c < frames->count(); c++)
+    {
+        if (saveStopped(c, frames->count())) break;
+        ok &= writer.addFrame(frames->at(c));
+    }
+    ok &= writer.finish();
+    outFile.close();
+    return ok;
+}
+
+bool FrameFileIO::saveBinaryNativeStore(const QString &filename, const CANFrameSnapshot &frames, const QByteArray &extra)
+{
+    QSaveFile outFile(filename);
+    saveCancel.storeRelaxed(0);
+
+    if (!outFile.open(QIODevice::WriteOnly))
+        return false;
+
+    BinaryCaptureWriter writer(&outFile);
+    bool ok = writer.begin();
+    for (int c = 0; c < frames.count() && ok; c++)
+    {
+        if (saveStopped(c, frames.count())) return false; //the QSaveFile is thrown away, the old file stays
+        ok &= writer.addRecord(frames.record(c), frames.payloadData(c));
+    }
+    ok &= writer.finish(extra);
+    return ok && outFile.commit();
+}
+
+bool FrameFileIO::isBinaryNativeFile(QString filename)
+{
+    return probeFile(filename, false, isBinaryNativeFile);
+}
+
+bool FrameFileIO::isBinaryNativeFile(QIODevice *inFile)
+{
+    BinaryFileHeader header;
+
+    if (inFile->read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)) return false;
+    if (memcmp(header.magic, BINARY_FILE_MAGIC, sizeof(header.magic)) != 0) return false;
+    if (header.byteOrder != BINARY_BYTE_ORDER) return false;
+    if (header.recordSize != sizeof(CANFrameRecord)) return false;
+    return true;
+}
+
+//Whether a block of a binary capture can hold anything the options keep, going by its header. Captures are written
+//in the order frames came in so a block's timestamps run from its first to its last
+static bool binaryBlockMayMatch(const BinaryBlockHeader &header, const FrameLoadOptions &options)
+{
+    if (options.nothing) return false;
+    if (options.filtersTime())
+    {
+        qint64 first = static_cast<qint64>(qMin(header.firstTimestamp, header.lastTimestamp));
+        qint64 last = static_cast<qint64>(qMax(header.firstTimestamp, header.lastTimestamp));
+        if (last < options.from || first > options.to) return false;
+    }
+    if (options.expression && !options.expression->mayMatchIds(header.idMin, header.idMax)) return false;
+    if (options.ids.isEmpty()) return true;
+
+    for (const FrameLoadID &id : options.ids)
+    {
+        //the lowest and highest IDs the entry can match, the header doesn't say which kind of ID it has
+        quint32 bits = id.mask & FRAME_LOAD_ID_BITS;
+        quint32 low = id.key & bits;
+        quint32 high = low | (~bits & FRAME_LOAD_ID_BITS);
+        if (high < header.idMin || low > header.idMax) continue;
+        if (bits != FRAME_LOAD_ID_BITS) return true;
+        int bit = binaryBloomBit(low);
+        if (header.idBloom[bit / 64] & (1ull << (bit % 64))) return true;
+    }
+    return false;
+}
+
+bool FrameFileIO::loadBinaryNativeFile(QString filename, QVector<CANFrame>* frames)
+{
+    MappedCapture capture;
+
+    if (!capture.open(filename))
+        return false;
+
+    if (!loadFilter)
+    {
+        frames->reserve(frames->count() + capture.count());
+        for (int i = 0; i < capture.count(); i++)
+        {
+            if ((i & 0xFFFF) == 0) qApp->processEvents();
+            frames->append(capture.at(i));
+        }
+        return !capture.isDamaged();
+    }
+
+    //whole blocks are ruled out by their header and the rest by the record, a CANFrame only gets built for keepers
+    const FrameLoadOptions &options = loadFilter->options;
+    for (int b = 0; b < capture.blockCount(); b++)
+    {
+        qApp->processEvents();
+        if (!binaryBlockMayMatch(capture.blockHeader(b), options)) continue;
+        int last = (b + 1 < capture.blockCount()) ? capture.blockFirst(b + 1) : capture.count();
+        for (int i = capture.blockFirst(b); i < last; i++)
+        {
+            const CANFrameRecord &rec = capture.record(i);
+            if (!options.matches(static_cast<qint64>(rec.timestamp), rec.idFlags & FRAME_LOAD_EXACT, rec.bus)) continue;
+            if (options.expression && !options.expression->matches(rec, capture.payloadData(i))) continue;
+            CANFrame frame = capture.at(i);
+            if (loadFilter->decimated(frame)) frames->append(frame);
+        }
+    }
+
+    return !capture.isDamaged();
+}
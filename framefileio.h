@@ -12,9 +12,49 @@
 #include <QString>
 #include <QStringList>
 #include <QFileDialog>
+#include <functional>
+#include <utility>
+#include <vector>
 #include "can_structs.h"
+#include "canframestore.h"
+#include "frameloadoptions.h"
+#include "textlogindex.h"
 #include "utility.h"
 
+class BinaryCaptureWriter;
+class ContinuousLogger;
+class QTemporaryFile;
+
+//how continuous logging is getting on, for the status bar
+struct ContinuousLogStatus
+{
+    bool active = false;
+    bool failed = false; //something couldn't be written, logging carries on with the next file
+    QString currentFile;
+    int files = 0; //started so far, including the current one
+    quint64 framesWritten = 0;
+    quint64 framesDropped = 0; //didn't fit in the queue because the writer fell behind
+};
+
+/*
+ * Interleaves frame sets, one per loaded file, into a single list in time order. next() hands out the next count
+ * frames so the caller can pass them on a block at a time and never holds a second copy of the whole lot. A set
+ * is freed as soon as its last frame has gone out. frameSets has to stay around for as long as the merge does.
+ */
+class FrameSetMerge
+{
+public:
+    explicit FrameSetMerge(QVector<QVector<CANFrame>> &frameSets);
+    bool next(QVector<CANFrame> &out, int count); //false once there's nothing left
+    int remainingFrames() const { return remaining; }
+
+private:
+    QVector<QVector<CANFrame>> &sets;
+    QVector<int> cursor; //next frame of each set
+    std::vector<std::pair<qint64, int>> heap; //timestamp of a set's next frame and the set, earliest on top
+    int remaining;
+};
+
 class FrameFileIO: public QObject
 {
     Q_OBJECT
@@ -26,10 +66,22 @@ public:
     //The QString returns the filename that was selected and so is really a sort of return value
     //The QVector is used as either the target for loading or the source for saving.
     //These routines call the below loading/saving functions so no need to use them directly if you don't want.
-    static bool loadFrameFile(QString &, QVector<CANFrame>*);
+    //If mappedFile is given binary captures aren't loaded at all. Their path comes back there to be mapped instead
+    static bool loadFrameFile(QString &, QVector<CANFrame>*, QString *mappedFile = nullptr);
+    static bool loadFrameFiles(QStringList &, QVector<QVector<CANFrame>>*); //pick several, each file loads separately
+    //loads them all at once on a thread pool. frameSets and loaded line up with files, false if none loaded
+    static bool loadFilesConcurrently(const QStringList &files, int filterIdx, QVector<QVector<CANFrame>> *frameSets, QVector<bool> *loaded);
+    static bool loadFrameFilePart(QString &, QVector<CANFrame>*); //pick a file then which of its frames to keep
     static bool saveFrameFile(QString &, const QVector<CANFrame>*);
+    static bool saveFrameFile(QString &, const CANFrameStore*); //unpacks the store then saves as above
+    static bool saveFrameRange(QString &, const CANFrameStore*); //pick a time window and IDs, then the file to save them to
 
     //These do the actual loading and saving and can be used directly if you'd prefer
+    static QStringList loadFilters();
+    //options limits what gets kept (see FrameLoadOptions), null keeps every frame
+    static bool loadWithFilter(QString filename, int filterIdx, QVector<CANFrame>*, const FrameLoadOptions *options = nullptr);
+    static QStringList saveFilters();
+    static bool saveWithFilter(QString &filename, int filterIdx, const QVector<CANFrame>*); //filename gets the extension added
     static bool autoDetectLoadFile(QString, QVector<CANFrame>*);
     static bool loadCRTDFile(QString, QVector<CANFrame>*);
     static bool loadNativeCSVFile(QString, QVector<CANFrame>*);
@@ -54,6 +106,7 @@ public:
     static bool loadCLX000File(QString filename, QVector<CANFrame>* frames);
     static bool loadCANServerFile(QString filename, QVector<CANFrame>* frames);
     static bool loadWiresharkFile(QString filename, QVector<CANFrame>* frames);
+    static bool loadBinaryNativeFile(QString filename, QVector<CANFrame>* frames);
 
     //functions that pre-scan a file to try to figure out if they could read it. Used to automatically determine
     //file type and load it.
@@ -80,6 +133,38 @@ public:
     static bool isCLX000File(QString filename);
     static bool isCANServerFile(QString filename);
     static bool isWiresharkFile(QString filename);
+    static bool isBinaryNativeFile(QString filename);
+
+    //the same probes on a device that is already open (in text mode for the line based ones) and at its start
+    static bool isCRTDFile(QIODevice *);
+    static bool isNativeCSVFile(QIODevice *);
+    static bool isGenericCSVFile(QIODevice *);
+    static bool isLogFile(QIODevice *);
+    static bool isMicrochipFile(QIODevice *);
+    static bool isTraceFile(QIODevice *);
+    static bool isIXXATFile(QIODevice *);
+    static bool isCANDOFile(QIODevice *);
+    static bool isVehicleSpyFile(QIODevice *);
+    static bool isCanDumpFile(QIODevice *);
+    static bool isLawicelFile(QIODevice *);
+    static bool isPCANFile(QIODevice *);
+    static bool isKvaserFile(QIODevice *);
+    static bool isCanalyzerASC(QIODevice *);
+    static bool isCanalyzerBLF(QIODevice *);
+    static bool isCARBUSAnalyzerFile(QIODevice *);
+    static bool isCANHackerFile(QIODevice *);
+    static bool isCabanaFile(QIODevice *);
+    static bool isCANOpenFile(QIODevice *);
+    static bool isTeslaAPFile(QIODevice *);
+    static bool isCLX000File(QIODevice *);
+    static bool isCANServerFile(QIODevice *);
+    static bool isWiresharkFile(QIODevice *); //pcap or pcapng magic number only
+    static bool isBinaryNativeFile(QIODevice *);
+
+    //GVRET CSV, CRTD and candump logs get a sidecar index the first time they're loaded, see TextLogIndex.
+    //indexTextLog parses the whole log just for the index if there isn't an up to date one yet
+    static TextLogFormat textLogFormat(QString filename); //NONE for anything else
+    static bool indexTextLog(QString filename, TextLogIndex &index);
 
     static bool saveCRTDFile(QString, const QVector<CANFrame>*);
     static bool saveNativeCSVFile(QString, const QVector<CANFrame>*);
@@ -93,15 +178,39 @@ public:
     static bool saveCanDumpFile(QString filename, const QVector<CANFrame> * frames);
     static bool saveCabanaFile(QString filename, const QVector<CANFrame>* frames);
     static bool saveCanalyzerASC(QString filename, const QVector<CANFrame>* frames);
+    static bool saveCanalyzerBLF(QString filename, const QVector<CANFrame>* frames);
+    static bool saveWiresharkFile(QString filename, const QVector<CANFrame>* frames);
     static bool saveCARBUSAnalzyer(QString filename, const QVector<CANFrame>* frames);
+    static bool saveBinaryNativeFile(QString filename, const QVector<CANFrame>* frames);
+    //the records go across without becoming CANFrames and extra goes in as the file's extra section. Written to
+    //the side and renamed into place so an existing file is never left half overwritten. Takes a snapshot since
+    //it keeps the GUI going while it writes and the store could change under it
+    static bool saveBinaryNativeStore(const QString &filename, const CANFrameSnapshot &frames, const QByteArray &extra);
 
+    //continuous logging writes on its own thread, rotating files as set up under FileIO/Continuous* in the settings.
+    //writeContinuousNative only queues the frames and flushContinuousNative only asks the thread to flush
     static bool openContinuousNative();
     static bool closeContinuousNative();
     static bool writeContinuousNative(const QVector<CANFrame>*, int);
     static bool flushContinuousNative();
+    static ContinuousLogStatus continuousStatus();
+
+    //binary log of the frames the live capture lets go of (see CANFrameModel::setRetention)
+    static bool openSpillFile(const QString &filename);
+    static bool isSpilling() { return spillBinary != nullptr; }
+    static bool spillFrame(const CANFrameStore *store, int idx);
+    static bool closeSpillFile();
 
 private:
-    static QFile continuousFile;
+    static bool probeFile(const QString &filename, bool textMode, bool (*probe)(QIODevice *));
+    static bool inflateIfCompressed(QString &filename, QTemporaryFile &tmp);
+    static bool loadTextLog(const QString &filename, TextLogFormat format, QVector<CANFrame>* frames);
+    //the save dialog, then save on a worker thread with progress and cancel. save gets the filename and filter index
+    static bool saveOnWorker(QString &fileName, const std::function<bool(QString &, int)> &save);
+
+    static ContinuousLogger *continuousLogger; //null when not logging
+    static QFile spillFile;
+    static BinaryCaptureWriter *spillBinary;
 };
 
 #endif // FRAMEFILEIO_H
@@ -0,0 +1,102 @@
+#ifndef FRAMELOADOPTIONS_H
+#define FRAMELOADOPTIONS_H
+
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+#include <limits>
+#include "can_structs.h"
+#include "filterexpression.h"
+
+//masks for FrameLoadID. The top bit of a key is the extended flag so leaving it out of the mask matches either
+#define FRAME_LOAD_ID_BITS  0x1FFFFFFFu
+#define FRAME_LOAD_EXACT    0x9FFFFFFFu
+
+//both ID spaces in one number, extended IDs have the top bit set
+static inline quint32 frameLoadKey(uint32_t id, bool extended)
+{
+    return (id & FRAME_LOAD_ID_BITS) | (extended ? 0x80000000u : 0);
+}
+
+//one entry of an ID filter. A frame matches when its key and this one agree on every bit of the mask
+struct FrameLoadID
+{
+    quint32 key;
+    quint32 mask;
+};
+
+/*
+ * Which frames a load keeps. Loaders check these as early as they can, on a record header or a block index
+ * before any CANFrame is built where the format allows it, so a load of a few IDs out of a huge log only costs
+ * what it keeps. Anything left at its default doesn't filter.
+ */
+struct FrameLoadOptions
+{
+    qint64 from = std::numeric_limits<qint64>::min(); //microseconds as the file has them, both ends included
+    qint64 to = std::numeric_limits<qint64>::max();
+    QVector<FrameLoadID> ids; //any one of them, empty for every ID
+    QSet<int> buses; //empty for every bus
+    QSharedPointer<const FilterExpression> expression; //frames have to match this as well, null for none
+    int decimate = 1; //keep one in every this many frames of each ID, counted after the rest of the filtering
+    bool nothing = false; //keep no frames at all, for a pass that's only after the text log index
+
+    bool filtersTime() const
+    {
+        return from != std::numeric_limits<qint64>::min() || to != std::numeric_limits<qint64>::max();
+    }
+    bool isEverything() const
+    {
+        return !nothing && ids.isEmpty() && buses.isEmpty() && !expression && decimate <= 1 && !filtersTime();
+    }
+    bool matchesTime(qint64 stamp) const { return stamp >= from && stamp <= to; }
+    bool matchesBus(int bus) const { return buses.isEmpty() || buses.contains(bus); }
+    //the expression only gets a say through its ID set here, it needs the whole frame for the rest
+    bool matchesKey(quint32 key) const
+    {
+        if (expression && !expression->mayMatchId(key & FRAME_LOAD_ID_BITS)) return false;
+        if (ids.isEmpty()) return true;
+        for (const FrameLoadID &id : ids)
+            if (((key ^ id.key) & id.mask) == 0) return true;
+        return false;
+    }
+    //everything but decimation and whatever the expression looks at past the ID
+    bool matches(qint64 stamp, quint32 key, int bus) const
+    {
+        return !nothing && matchesTime(stamp) && matchesBus(bus) && matchesKey(key);
+    }
+    bool matches(const CANFrame &frame) const
+    {
+        return matches(frame.timeStamp().microSeconds(), frameLoadKey(frame.frameId(), frame.hasExtendedFrameFormat()), frame.bus)
+                && (!expression || expression->matches(frame));
+    }
+};
+
+//the per load half of FrameLoadOptions, the decimation counts. Frames have to come through in file order
+class FrameLoadFilter
+{
+public:
+    explicit FrameLoadFilter(const FrameLoadOptions &options) : options(options) {}
+
+    bool keep(const CANFrame &frame) { return options.matches(frame) && decimated(frame); }
+
+    //for frames that were already checked against everything else
+    bool decimated(const CANFrame &frame)
+    {
+        if (options.decimate <= 1) return true;
+        int &seen = counts[frameLoadKey(frame.frameId(), frame.hasExtendedFrameFormat())];
+        bool first = seen == 0;
+        if (++seen >= options.decimate) seen = 0;
+        return first;
+    }
+
+    //start the decimation counts over, for a loader that gets tried again from the top
+    void reset() { counts.clear(); }
+
+    const FrameLoadOptions &options;
+
+private:
+    QHash<quint32, int> counts;
+};
+
+#endif // FRAMELOADOPTIONS_H
@@ -1,10 +1,14 @@
 #include "frameplaybackobject.h"
+#include "threadpolicy.h"
+
+#include <algorithm>
 
 FramePlaybackObject::FramePlaybackObject()
 {
     mThread_p = new QThread();
 
-    currentPosition = 0;
+    currentStep = 0;
+    playbackBaseOffset = 0;
     playbackInterval = 1;
     playbackBurst = 1;
     statusCounter = 0;
@@ -14,6 +18,11 @@ FramePlaybackObject::FramePlaybackObject()
     useOrigTiming = false;
     whichBusSend = 0;
     currentSeqItem = nullptr;
+    mScheduler_p = nullptr;
+    mSchedulerRun.storeRelaxed(0);
+    mTimedFrames.storeRelaxed(0);
+    mTimingErrorSum.storeRelaxed(0);
+    mTimingErrorMax.storeRelaxed(0);
 }
 
 FramePlaybackObject::~FramePlaybackObject()
@@ -23,108 +32,140 @@ FramePlaybackObject::~FramePlaybackObject()
     delete mThread_p;
 }
 
-quint64 FramePlaybackObject::updatePosition(bool forward)
+/*
+ * The schedule is the frames that pass the filters with their time from the first of them, nothing else. Offsets
+ * are signed since a capture can have the odd frame stamped before the one ahead of it. Streamed captures are
+ * scheduled straight from the records so nothing gets decoded just for this.
+ */
+void SequenceItem::buildSchedule()
 {
-    //qDebug() << "updatePosition";
-    if (!currentSeqItem) {
-        playbackTimer->stop(); //pushing this button halts automatic playback
-        playbackActive = false;
-        currentPosition = 0;
-        return 0;
-    }
-
-    //only send frame out if its ID is checked in the list. Otherwise discard it.
-    CANFrame *thisFrame = &currentSeqItem->data[currentPosition];
-    uint32_t originalBus = thisFrame->bus;
-    if (currentSeqItem->idFilters.find(thisFrame->frameId()).value())
+    schedule.clear();
+    bool haveFirst = false;
+    quint64 first = 0;
+    auto add = [&](int idx, quint64 stamp, uint32_t id)
     {
-        if (whichBusSend > -1)
+        if (!idFilters.value(id, false)) return;
+        if (!haveFirst)
         {
-            thisFrame->bus = whichBusSend;
-            sendingBuffer.append(*thisFrame);
+            first = stamp;
+            haveFirst = true;
         }
-        else if (whichBusSend == -1)
+        schedule.append({static_cast<qint64>(stamp - first), idx});
+    };
+
+    if (stream)
+    {
+        const MappedCapture &capture = stream->source();
+        for (int i = 0; i < capture.count(); i++)
         {
-            for (int c = 0; c < numBuses; c++)
-            {
-                thisFrame->bus = c;
-                sendingBuffer.append(*thisFrame);
-            }
+            const CANFrameRecord &record = capture.record(i);
+            add(i, record.timestamp, record.frameId());
         }
-        else //from file so retain original bus and send as-is
+    }
+    else
+    {
+        for (int i = 0; i < data.count(); i++) add(i, data[i].timeStamp().microSeconds(), data[i].frameId());
+    }
+    schedule.squeeze();
+}
+
+int SequenceItem::stepAtFrame(int frameIdx) const
+{
+    auto it = std::lower_bound(schedule.constBegin(), schedule.constEnd(), frameIdx,
+                               [](const PlaybackStep &step, int idx) { return step.frame < idx; });
+    return (it == schedule.constEnd()) ? 0 : static_cast<int>(it - schedule.constBegin());
+}
+
+//queues the frame at the current step and moves one step on, wrapping around at either end of the schedule
+void FramePlaybackObject::updatePosition(bool forward)
+{
+    //qDebug() << "updatePosition";
+    if (!currentSeqItem) {
+        haltPlayback();
+        currentStep = 0;
+        return;
+    }
+
+    const QVector<PlaybackStep> &schedule = currentSeqItem->schedule;
+    if (schedule.isEmpty()) //every ID is filtered out, so there's nothing to play in this one
+    {
+        currentStep = 0;
+        haltPlayback();
+        emit EndOfFrameCache();
+        return;
+    }
+    if (currentStep >= schedule.count()) currentStep = 0;
+
+    CANFrame thisFrame = currentSeqItem->frame(schedule.at(currentStep).frame);
+    if (transforms && !transforms->apply(thisFrame))
+    {
+        //dropped by a transform, it still takes its step
+    }
+    else if (whichBusSend > -1)
+    {
+        thisFrame.bus = whichBusSend;
+        sendingBuffer.append(thisFrame);
+    }
+    else if (whichBusSend == -1)
+    {
+        for (int c = 0; c < numBuses; c++)
         {
-            sendingBuffer.append(*thisFrame);
+            thisFrame.bus = c;
+            sendingBuffer.append(thisFrame);
         }
-
-        thisFrame->bus = originalBus;
+    }
+    else //from file so retain original bus and send as-is
+    {
+        sendingBuffer.append(thisFrame);
     }
 
     if (forward)
     {
-        if (currentPosition < (currentSeqItem->data.count() - 1)) currentPosition++; //still in same file so keep going
+        if (currentStep < (schedule.count() - 1)) currentStep++; //still in same file so keep going
         else //hit the end of the current file
         {
             qDebug() << "hit end of current sequence";
             currentSeqItem->currentLoopCount++;
-            currentPosition = 0;
+            currentStep = 0;
             if (currentSeqItem->currentLoopCount == currentSeqItem->maxLoops) //have we looped enough times?
             {
-                playbackActive = false;
-                playbackTimer->stop();
+                haltPlayback();
                 emit EndOfFrameCache();
             }
         }
     }
     else
     {
-        if (currentPosition > 0) currentPosition--;
+        if (currentStep > 0) currentStep--;
         else //hit the beginning of the current sequence
         {
             qDebug() << "hit start of current sequence";
             currentSeqItem->currentLoopCount++;
-            currentPosition = currentSeqItem->data.count() - 1;
+            currentStep = schedule.count() - 1;
             if (currentSeqItem->currentLoopCount == currentSeqItem->maxLoops) //have we looped enough times?
             {
-                playbackActive = false;
-                playbackTimer->stop();
+                haltPlayback();
                 emit EndOfFrameCache();
             }
         }
     }
-
-    return thisFrame->timeStamp().microSeconds();
 }
 
-quint64 FramePlaybackObject::peekPosition(bool forward)
+//the frame the current step is, which is what the window shows as the position
+int FramePlaybackObject::currentFrame() const
 {
-    int peekCurrentPosition = currentPosition;
-    if (forward)
-    {
-        if (peekCurrentPosition < (currentSeqItem->data.count() - 1)) peekCurrentPosition++; //still in same file so keep going
-        else //hit the end of the current file
-        {
-            return 0xFFFFFFFFFFFFFFFFull;
-        }
-    }
-    else
-    {
-        if (peekCurrentPosition > 0) peekCurrentPosition--;
-        else //hit the beginning of the current sequence
-        {
-            return 0xFFFFFFFFFFFFFFFFull;
-        }
-    }
-    CANFrame *thisFrame = &currentSeqItem->data[peekCurrentPosition];
-    return thisFrame->timeStamp().microSeconds();
+    if (!currentSeqItem || currentStep >= currentSeqItem->schedule.count()) return 0;
+    return currentSeqItem->schedule.at(currentStep).frame;
 }
 
 void FramePlaybackObject::piStart()
 {
+    ThreadPolicy::apply(ThreadPolicy::PLAYBACK);
     playbackTimer = new QTimer();
     playbackTimer->setTimerType(Qt::PreciseTimer);
     playbackTimer->setInterval(1);
 
-    currentPosition = 0;
+    currentStep = 0;
     playbackActive = false;
     playbackForward = true;
     whichBusSend = 0;
@@ -134,6 +175,7 @@ void FramePlaybackObject::piStart()
 
 void FramePlaybackObject::piStop()
 {
+    stopScheduler();
     playbackTimer->stop();
     delete playbackTimer;
 }
@@ -192,16 +234,15 @@ void FramePlaybackObject::startPlaybackForward()
         return;
     }
 
+    stopScheduler();
     playbackActive = true;
     playbackForward = true;
 
     if (useOrigTiming)
     {
-        playbackTimer->setInterval(1);
-        playbackElapsed.start();
-        if (currentSeqItem->data[currentPosition].timeStamp().microSeconds() > 2000)
-            playbackLastTimeStamp = currentSeqItem->data[currentPosition].timeStamp().microSeconds() - 2000;
-        else playbackLastTimeStamp = 0;
+        playbackTimer->stop();
+        startTimedPlayback();
+        return;
     }
     playbackTimer->start();
 }
@@ -215,13 +256,14 @@ void FramePlaybackObject::startPlaybackBackward()
         return;
     }
 
+    stopScheduler();
     playbackActive = true;
     playbackForward = false;
     if (useOrigTiming)
     {
-        playbackElapsed.start();
-        playbackTimer->setInterval(1);
-        playbackLastTimeStamp = currentSeqItem->data[currentPosition].timeStamp().microSeconds() + 2000;
+        playbackTimer->stop();
+        startTimedPlayback();
+        return;
     }
     playbackTimer->start();
 }
@@ -235,12 +277,13 @@ void FramePlaybackObject::stepPlaybackForward()
         return;
     }
 
+    stopScheduler();
     sendingBuffer.clear();
     playbackTimer->stop();
     playbackActive = false;
     updatePosition(true);
-    CANConManager::getInstance()->sendFrames(sendingBuffer);
-    emit statusUpdate(currentPosition);
+    CANConManager::getInstance()->sendFrames(sendingBuffer, TX_BULK);
+    emit statusUpdate(currentFrame());
 }
 
 void FramePlaybackObject::stepPlaybackBackward()
@@ -252,13 +295,14 @@ void FramePlaybackObject::stepPlaybackBackward()
         return;
     }
 
+    stopScheduler();
     sendingBuffer.clear();
     playbackTimer->stop(); //pushing this button halts automatic playback
     playbackActive = false;
 
     updatePosition(false);
-    CANConManager::getInstance()->sendFrames(sendingBuffer);
-    emit statusUpdate(currentPosition);
+    CANConManager::getInstance()->sendFrames(sendingBuffer, TX_BULK);
+    emit statusUpdate(currentFrame());
 }
 
 void FramePlaybackObject::stopPlayback()
@@ -270,10 +314,11 @@ void FramePlaybackObject::stopPlayback()
         return;
     }
 
+    stopScheduler();
     playbackTimer->stop(); //pushing this button halts automatic playback
     playbackActive = false;
-    currentPosition = 0;
-    emit statusUpdate(currentPosition);
+    currentStep = 0;
+    emit statusUpdate(currentFrame());
 }
 
 void FramePlaybackObject::pausePlayback()
@@ -285,14 +330,54 @@ void FramePlaybackObject::pausePlayback()
         return;
     }
 
+    stopScheduler();
     playbackActive = false;
     playbackTimer->stop();
-    emit statusUpdate(currentPosition);
+    emit statusUpdate(currentFrame());
 }
 
 void FramePlaybackObject::setSequenceObject(SequenceItem *item)
 {
+    stopScheduler(); //it might be in the middle of the old one
     currentSeqItem = item;
+    currentStep = 0;
+}
+
+void FramePlaybackObject::rebuildSchedule(SequenceItem *item)
+{
+    /* make sure we execute in mThread context */
+    if( mThread_p && (mThread_p != QThread::currentThread()) ) {
+        QMetaObject::invokeMethod(this, [this, item]() { rebuildSchedule(item); }, Qt::BlockingQueuedConnection);
+        return;
+    }
+
+    if (!item) return;
+    if (item != currentSeqItem) //nothing is playing it
+    {
+        item->buildSchedule();
+        return;
+    }
+
+    bool timed = (mScheduler_p != nullptr);
+    stopScheduler();
+    int frame = currentFrame();
+    item->buildSchedule();
+    currentStep = item->stepAtFrame(frame);
+    if (timed && playbackActive) startTimedPlayback();
+}
+
+void FramePlaybackObject::setTransforms(QSharedPointer<PlaybackTransforms> compiled)
+{
+    /* make sure we execute in mThread context */
+    if( mThread_p && (mThread_p != QThread::currentThread()) ) {
+        QMetaObject::invokeMethod(this, [this, compiled]() { setTransforms(compiled); }, Qt::BlockingQueuedConnection);
+        return;
+    }
+
+    bool timed = (mScheduler_p != nullptr);
+    stopScheduler(); //it's using the old ones
+    transforms = compiled;
+    if (timed && playbackActive) startTimedPlayback();
 }
 
 void FramePlaybackObject::setUseOriginalTiming(bool state)
@@ -335,79 +420,250 @@ void FramePlaybackObject::timerTriggered()
 {
     sendingBuffer.clear();
 
-    if (useOrigTiming)
+    for (int count = 0; count < playbackBurst; count++)
     {
-        //get elapsed microseconds since last tick (in case timer skips or is otherwise inaccurate, though there are no guarantees about elapsed timer either)
-        quint64 elapsed = playbackElapsed.nsecsElapsed() / 1000;
-        playbackElapsed.start();
-        if (playbackForward)
+        if (!playbackActive)
         {
-            playbackLastTimeStamp += elapsed;
-            //qDebug() << playbackLastTimeStamp;
-            //qDebug() << "El: " << elapsed;
-            while (peekPosition(true) <= playbackLastTimeStamp)
-            {
-                updatePosition(true);
-            }
-            if (peekPosition(true) == 0xFFFFFFFFFFFFFFFFull)
-            {
-                updatePosition(true); //this'll go to the next log (if there is one)
-                if (currentSeqItem->data[currentPosition].timeStamp().microSeconds() > 1000)
-                    playbackLastTimeStamp = currentSeqItem->data[currentPosition].timeStamp().microSeconds() - 1000;
-                else playbackLastTimeStamp = 0;
-            }
+            playbackTimer->stop();
+            return;
         }
-        else
+        if (playbackForward)
         {
-            if (playbackLastTimeStamp > elapsed)
-                playbackLastTimeStamp -= elapsed;
-            else playbackLastTimeStamp = 0;
-            while (peekPosition(false) >= playbackLastTimeStamp && peekPosition(false) != 0xFFFFFFFFFFFFFFFFull)
-            {
-                updatePosition(false);
-            }
-            if (peekPosition(false) == 0xFFFFFFFFFFFFFFFFull)
-            {
-                updatePosition(false); //this'll go to the next log (if there is one)
-                playbackLastTimeStamp = currentSeqItem->data[currentPosition].timeStamp().microSeconds() + 1000;
-            }
+            updatePosition(true);
         }
-        statusCounter++;
-    }
-    else
-    {
-        for (int count = 0; count < playbackBurst; count++)
+        else
         {
-            if (!playbackActive)
-            {
-                playbackTimer->stop();
-                return;
-            }
-            if (playbackForward)
-            {
-                updatePosition(true);
-            }
-            else
-            {
-                updatePosition(false);
-            }
+            updatePosition(false);
         }
-        statusCounter += playbackInterval;
     }
+    statusCounter += playbackInterval;
 
     if (statusCounter > 249)
     {
         statusCounter = 0;
-        emit statusUpdate(currentPosition);
+        emit statusUpdate(currentFrame());
     }
 
     //qDebug() << "sb: " << sendingBuffer.count();
-    if (sendingBuffer.count() > 0) CANConManager::getInstance()->sendFrames(sendingBuffer);
+    if (sendingBuffer.count() > 0) CANConManager::getInstance()->sendFrames(sendingBuffer, TX_BULK);
 }
 
+//stops playback from wherever it's running. The timer can only be stopped from the thread that owns it
+void FramePlaybackObject::haltPlayback()
+{
+    playbackActive = false;
+    if (QThread::currentThread() == thread()) playbackTimer->stop();
+}
 
+//original timing playback from the current step, which goes out 2ms from now (see runScheduler)
+void FramePlaybackObject::startTimedPlayback()
+{
+    qint64 offset = 0;
+    if (currentSeqItem && currentStep < currentSeqItem->schedule.count()) offset = currentSeqItem->schedule.at(currentStep).offset;
+    playbackBaseOffset = offset;
+    startScheduler();
+}
 
+void FramePlaybackObject::startScheduler()
+{
+    stopScheduler();
+    mTimedFrames.storeRelaxed(0);
+    mTimingErrorSum.storeRelaxed(0);
+    mTimingErrorMax.storeRelaxed(0);
+    mSchedulerRun.storeRelaxed(1);
+    mScheduler_p = QThread::create([this]{ runScheduler(); });
+    mScheduler_p->start(QThread::TimeCriticalPriority);
+}
 
+void FramePlaybackObject::stopScheduler()
+{
+    if (!mScheduler_p) return;
+    mSchedulerRun.storeRelaxed(0);
+    mScheduler_p->wait();
+    delete mScheduler_p;
+    mScheduler_p = nullptr;
+}
 
+void FramePlaybackObject::getTimingError(quint64 &frames, double &meanUs, qint64 &maxUs) const
+{
+    frames = mTimedFrames.loadRelaxed();
+    meanUs = (frames > 0) ? static_cast<double>(mTimingErrorSum.loadRelaxed()) / frames : 0.0;
+    maxUs = mTimingErrorMax.loadRelaxed();
+}
 
+void FramePlaybackObject::setBusRateLimit(int bus, int framesPerSecond)
+{
+    if (bus < 0 || bus >= PLAYBACK_MAX_BUSES) return;
+    mBusRates[bus].storeRelaxed(qMax(0, framesPerSecond));
+}
 
+int FramePlaybackObject::getBusQueueDepth(int bus) const
+{
+    if (bus < 0 || bus >= PLAYBACK_MAX_BUSES) return 0;
+    return mBusQueued[bus].loadRelaxed();
+}
+
+/*
+ * Hands each bus whatever of its queue it's allowed to have right now: no more than its rate limit has built up
+ * credit for, and nothing at all while its connection says there's more than PLAYBACK_TX_BACKLOG_LIMIT still to go
+ * out. Returns the most frames left waiting on any one bus.
+ */
+int FramePlaybackObject::drainLanes(QHash<int, PlaybackLane> &lanes, const QElapsedTimer &clock)
+{
+    int longest = 0;
+    QList<CANFrame> out;
+    for (auto it = lanes.begin(); it != lanes.end(); ++it)
+    {
+        PlaybackLane &lane = it.value();
+        if (lane.waiting.isEmpty()) continue;
+        qint64 now = clock.nsecsElapsed() / 1000;
+
+        int allowed = lane.waiting.count();
+        int rate = (it.key() >= 0 && it.key() < PLAYBACK_MAX_BUSES) ? mBusRates[it.key()].loadRelaxed() : 0;
+        if (rate > 0)
+        {
+            //at most a poll interval's worth saved up so a limited bus doesn't burst after a quiet spell
+            double cap = qMax(1.0, rate * (PLAYBACK_LANE_POLL_US / 1000000.0));
+            lane.tokens = qMin(cap, lane.tokens + (now - lane.lastRefill) * (rate / 1000000.0));
+            allowed = qMin(allowed, static_cast<int>(lane.tokens));
+        }
+        lane.lastRefill = now;
+
+        if (allowed > 0 && now - lane.lastBacklogCheck >= PLAYBACK_LANE_POLL_US)
+        {
+            lane.lastBacklogCheck = now;
+            lane.held = (CANConManager::getInstance()->getTxBacklog(it.key()) > PLAYBACK_TX_BACKLOG_LIMIT);
+        }
+
+        if (allowed > 0 && !lane.held)
+        {
+            out.clear();
+            for (int i = 0; i < allowed; i++)
+            {
+                QPair<qint64, CANFrame> entry = lane.waiting.dequeue();
+                qint64 error = qAbs(now - entry.first);
+                mTimingErrorSum.fetchAndAddRelaxed(static_cast<quint64>(error));
+                if (error > mTimingErrorMax.loadRelaxed()) mTimingErrorMax.storeRelaxed(error);
+                out.append(entry.second);
+            }
+            mTimedFrames.fetchAndAddRelaxed(static_cast<quint64>(allowed));
+            if (rate > 0) lane.tokens -= allowed;
+            CANConManager::getInstance()->sendFrames(out, TX_BULK);
+        }
+
+        if (it.key() >= 0 && it.key() < PLAYBACK_MAX_BUSES) mBusQueued[it.key()].storeRelaxed(lane.waiting.count());
+        longest = qMax(longest, lane.waiting.count());
+    }
+    return longest;
+}
+
+/*
+ * Runs on the scheduler thread for as long as original timing playback does. playbackBaseOffset is the schedule
+ * time that lines up with the moment it starts, every step is then due that far in schedule time from there on the
+ * clock, 2ms after starting. When the sequence wraps around the next step is due 1ms later and the timing starts
+ * over from it. Only steps that get sent are in the schedule so every wait is for a frame that actually goes out.
+ * The transforms' time scale multiplies the schedule time between steps, not those lead ins.
+ *
+ * Frames that come due go into a queue for their output bus and each of those drains at its own pace (drainLanes),
+ * so one slow or rate limited bus falls behind on its own instead of holding up the others. The timeline only stops
+ * for everybody when some bus has PLAYBACK_LANE_MAX_QUEUE frames waiting, and then it picks up again from where it
+ * stopped so the buses keep their timing relative to each other.
+ */
+void FramePlaybackObject::runScheduler()
+{
+    ThreadPolicy::apply(ThreadPolicy::PLAYBACK);
+    QElapsedTimer clock;
+    clock.start();
+    const bool forward = playbackForward;
+    qint64 baseOffset = playbackBaseOffset;
+    qint64 clockBase = 2000;
+    const double timeScale = transforms ? transforms->timeScale() : 1.0;
+    qint64 slack = PLAYBACK_SPIN_START_US - PLAYBACK_SPIN_MIN_US;
+    qint64 spinMargin = PLAYBACK_SPIN_START_US;
+    qint64 lastStatus = 0;
+    QHash<int, PlaybackLane> lanes;
+    int waiting = 0;
+
+    while (mSchedulerRun.loadRelaxed() && playbackActive && currentSeqItem)
+    {
+        //some bus is too far behind. Hold the timeline until it catches up and then shift it by however long that took
+        if (waiting >= PLAYBACK_LANE_MAX_QUEUE)
+        {
+            qint64 stalled = clock.nsecsElapsed() / 1000;
+            while (mSchedulerRun.loadRelaxed() && (waiting = drainLanes(lanes, clock)) >= PLAYBACK_LANE_MAX_QUEUE)
+                QThread::usleep(PLAYBACK_LANE_POLL_US);
+            clockBase += clock.nsecsElapsed() / 1000 - stalled;
+        }
+
+        const QVector<PlaybackStep> &schedule = currentSeqItem->schedule;
+        if (schedule.isEmpty())
+        {
+            updatePosition(forward); //ends this item
+            break;
+        }
+        qint64 offset = schedule.at(currentStep).offset;
+        qint64 due = clockBase + static_cast<qint64>((forward ? offset - baseOffset : baseOffset - offset) * timeScale);
+
+        for (;;)
+        {
+            if (waiting > 0) waiting = drainLanes(lanes, clock);
+            qint64 remaining = due - clock.nsecsElapsed() / 1000;
+            if (remaining <= 0 || !mSchedulerRun.loadRelaxed()) break;
+            if (remaining > spinMargin)
+            {
+                qint64 sleepFor = qMin(remaining - spinMargin, static_cast<qint64>(PLAYBACK_MAX_SLEEP_US));
+                if (waiting > 0) sleepFor = qMin(sleepFor, static_cast<qint64>(PLAYBACK_LANE_POLL_US));
+                qint64 before = clock.nsecsElapsed() / 1000;
+                QThread::usleep(static_cast<unsigned long>(sleepFor));
+                qint64 over = clock.nsecsElapsed() / 1000 - before - sleepFor;
+                //follow the worst recent oversleep but let it fade so one bad wakeup doesn't mean spinning forever
+                slack = qMax(over, slack - slack / 8);
+                spinMargin = qBound(static_cast<qint64>(PLAYBACK_SPIN_MIN_US), slack + PLAYBACK_SPIN_MIN_US,
+                                    static_cast<qint64>(PLAYBACK_SPIN_MAX_US));
+            }
+            else QThread::yieldCurrentThread();
+        }
+        if (!mSchedulerRun.loadRelaxed()) break;
+        ThreadPolicy::recordWakeup(ThreadPolicy::PLAYBACK, clock.nsecsElapsed() / 1000 - due);
+
+        //this step and every other one stamped the same come due together
+        sendingBuffer.clear();
+        bool wrapped = false;
+        do
+        {
+            int pos = currentStep;
+            updatePosition(forward);
+            wrapped = forward ? (currentStep <= pos) : (currentStep >= pos);
+        } while (playbackActive && !wrapped && schedule.at(currentStep).offset == offset);
+
+        if (sendingBuffer.count() > 0)
+        {
+            for (const CANFrame &frame : qAsConst(sendingBuffer))
+            {
+                lanes[frame.bus].waiting.enqueue(qMakePair(due, frame));
+            }
+            waiting = drainLanes(lanes, clock);
+        }
+
+        qint64 now = clock.nsecsElapsed() / 1000;
+        if (wrapped && playbackActive)
+        {
+            baseOffset = schedule.at(currentStep).offset;
+            clockBase = now + 1000;
+        }
+        if (now - lastStatus >= 250000)
+        {
+            lastStatus = now;
+            emit statusUpdate(currentFrame());
+        }
+    }
+
+    //the end of the sequence was reached but some buses might still have frames to get out
+    while (mSchedulerRun.loadRelaxed() && waiting > 0)
+    {
+        QThread::usleep(PLAYBACK_LANE_POLL_US);
+        waiting = drainLanes(lanes, clock);
+    }
+    for (int bus = 0; bus < PLAYBACK_MAX_BUSES; bus++) mBusQueued[bus].storeRelaxed(0);
+    emit statusUpdate(currentFrame());
+}
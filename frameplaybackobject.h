@@ -1,22 +1,62 @@
 #ifndef FRAMEPLAYBACKOBJECT_H
 #define FRAMEPLAYBACKOBJECT_H
 
+#include <QAtomicInteger>
 #include <QElapsedTimer>
 #include <QTimer>
 #include <QHash>
+#include <QPair>
+#include <QQueue>
+#include <QSharedPointer>
 #include <QThread>
 #include <QDebug>
 #include "can_structs.h"
+#include "capturestreamer.h"
 #include "connections/canconmanager.h"
+#include "playbacktransform.h"
+
+//how close to a frame's time the scheduler stops sleeping and starts spinning, to begin with and at most.
+//In between it follows how late the OS has actually been waking it up
+#define PLAYBACK_SPIN_MIN_US    200
+#define PLAYBACK_SPIN_START_US  2000
+#define PLAYBACK_SPIN_MAX_US    20000
+//longest single sleep, so a stop request never waits on a long gap in the capture
+#define PLAYBACK_MAX_SLEEP_US   50000
+//output buses that can be given a rate limit of their own
+#define PLAYBACK_MAX_BUSES      32
+//a bus gets nothing more while its connection has more than this many bytes still to send
+#define PLAYBACK_TX_BACKLOG_LIMIT   4096
+//how often a held up bus gets its backlog checked again, and the longest sleep while any bus has frames waiting
+#define PLAYBACK_LANE_POLL_US   1000
+//all buses hold when one of them has this many frames waiting
+#define PLAYBACK_LANE_MAX_QUEUE 20000
+
+//one frame playback will actually send: which frame of the sequence item it is and when it goes
+struct PlaybackStep
+{
+    qint64 offset;  //us from the first frame that passes the filters
+    int frame;      //index into the item's frames. The output bus is picked when it's sent, it can change while playing
+};
 
 //one entry in the sequence of data to use
 struct SequenceItem
 {
     QString filename;
-    QVector<CANFrame> data;
+    QVector<CANFrame> data; //empty if the frames are streamed from a binary capture instead
+    QSharedPointer<CaptureStreamer> stream;
     QHash<int, bool> idFilters;
+    QVector<PlaybackStep> schedule; //the frames idFilters lets through, in order. See buildSchedule
     int maxLoops;
     int currentLoopCount;
+
+    int frameCount() const { return stream ? stream->count() : data.count(); }
+    //only good until the next call when streaming
+    const CANFrame &frame(int idx) { return stream ? stream->at(idx) : data[idx]; }
+
+    //builds the schedule from the frames and idFilters. Has to be done again whenever either changes
+    void buildSchedule();
+    //first step at or after the frame, 0 if there isn't one
+    int stepAtFrame(int frameIdx) const;
 };
 
 /*
@@ -26,6 +66,24 @@ struct SequenceItem
   and thus is better scheduled and doesn't block the GUI thread. Really all functionality in this program should be broken into
   a separate thread from GUI if it is prone to running a long time and/or taking up a lot of CPU time (unless it really does
   have to interface with the GUI in some way. All gui touching code must run on its thread).
+
+  Original timing playback doesn't use the timer at all. A timer tick is 1ms at best and 15ms on some systems so frames
+  came out in clumps. Instead a scheduler thread of its own sleeps until just before each frame is due and spins the rest
+  of the way on a monotonic clock, then sends that frame together with any others stamped the same. How late each send
+  was goes into the timing error figures (getTimingError). Everything that touches the playback position stops the
+  scheduler first, so while it runs it's the only thing using it.
+
+  Due frames are queued per output bus and every bus drains on its own, limited by its rate limit (setBusRateLimit)
+  and by its connection's TX backlog, while all of them stay on the one timeline.
+
+  Playback walks the sequence item's schedule rather than its frames, so the ID filters were already applied when
+  the schedule was built and nothing it steps over gets looked at and thrown away. The position is a step in the
+  schedule, statusUpdate still reports the frame that step is. Changing an item's filters goes through
+  rebuildSchedule so the schedule never changes under a running playback.
+
+  Transforms (setTransforms) work on the copy of each frame that's about to be queued, on whichever thread is
+  playing, so the sequence item's frames stay as they were loaded. Their time scale stretches the gaps between
+  schedule offsets in the scheduler rather than the schedule itself.
 */
 class FramePlaybackObject : public QObject
 {
@@ -61,6 +119,17 @@ public slots:
     void setPlaybackInterval(int interval);
     void setPlaybackBurst(int burst);
     void setNumBuses(int buses);
+    //builds the item's schedule again after its ID filters changed. Playback carries on from the same frame
+    void rebuildSchedule(SequenceItem *item);
+    //compiled transform rules for every frame sent from now on, null for none. Playback carries on from the same frame
+    void setTransforms(QSharedPointer<PlaybackTransforms> compiled);
+
+    //original timing playback only: how many frames have gone out since it was started and how late they were, in us
+    void getTimingError(quint64 &frames, double &meanUs, qint64 &maxUs) const;
+    //original timing playback only, most frames per second a bus is given. 0 is no limit. Can be changed while playing
+    void setBusRateLimit(int bus, int framesPerSecond);
+    //frames that were due but are waiting on their bus because of the rate limit or TX backlog
+    int getBusQueueDepth(int bus) const;
 
 signals:
     void EndOfFrameCache(); //we hit the end/beginning of the frame cache (depending on direction of playback)
@@ -72,10 +141,9 @@ private slots:
 private:
      QList<CANFrame> sendingBuffer;
      SequenceItem *currentSeqItem;
-     int currentPosition;
+     int currentStep; //in currentSeqItem's schedule
      QTimer *playbackTimer;
-     QElapsedTimer playbackElapsed;
-     quint64 playbackLastTimeStamp;
+     qint64 playbackBaseOffset; //schedule time of the step original timing playback starts from
      int playbackInterval;
      int playbackBurst;
      int numBuses;
@@ -84,10 +152,35 @@ private:
      bool playbackForward;
      bool useOrigTiming;
      int whichBusSend;
+     QSharedPointer<PlaybackTransforms> transforms;
      QThread*            mThread_p;
+     QThread*            mScheduler_p;
+     QAtomicInt          mSchedulerRun;
+     QAtomicInteger<quint64> mTimedFrames;
+     QAtomicInteger<quint64> mTimingErrorSum;
+     QAtomicInteger<qint64>  mTimingErrorMax;
+     QAtomicInt          mBusRates[PLAYBACK_MAX_BUSES];
+     QAtomicInt          mBusQueued[PLAYBACK_MAX_BUSES];
+
+     //frames for one output bus that are due but haven't been handed to its connection yet
+     struct PlaybackLane
+     {
+         QQueue<QPair<qint64, CANFrame>> waiting; //with the time they were due
+         double tokens = 0.0;
+         qint64 lastRefill = 0;
+         qint64 lastBacklogCheck = -PLAYBACK_LANE_POLL_US;
+         bool held = false;
+     };
+
+     void startScheduler();
+     void stopScheduler();
+     void runScheduler();
+     int drainLanes(QHash<int, PlaybackLane> &lanes, const QElapsedTimer &clock);
+     void haltPlayback();
+     void startTimedPlayback();
+     int currentFrame() const;
 
-     quint64 updatePosition(bool forward);
-     quint64 peekPosition(bool forward);
+     void updatePosition(bool forward);
      /**
       * @brief starts the device
       */
@@ -3,13 +3,16 @@
 #include "ui_frameplaybackwindow.h"
 #include <QDebug>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMenu>
 #include <QSettings>
 #include <qevent.h>
 #include <QScrollBar>
+#include <QHeaderView>
 #include "connections/canconmanager.h"
 #include "helpwindow.h"
 #include "filterutility.h"
+#include "pipelinetrace.h"
 
 /*
  * Notes about new functionality:
@@ -24,7 +27,7 @@
  *
 */
 
-FramePlaybackWindow::FramePlaybackWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+FramePlaybackWindow::FramePlaybackWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::FramePlaybackWindow)
 {
@@ -39,6 +42,7 @@ FramePlaybackWindow::FramePlaybackWindow(const QVector<CANFrame> *frames, QWidge
 
     playbackObject.initialize();
     playbackObject.setNumBuses(numBuses);
+    setupBusRates(numBuses);
 
     readSettings();
 
@@ -52,6 +56,10 @@ FramePlaybackWindow::FramePlaybackWindow(const QVector<CANFrame> *frames, QWidge
     wantPlaying = false;
     haveIncomingTraffic = false;
 
+    QSettings settings;
+    ui->txtTransforms->setPlainText(settings.value("Playback/Transforms").toString());
+    applyTransforms();
+
     updateFrameLabel();
 
     connect(ui->btnStepBack, &QAbstractButton::clicked, this, &FramePlaybackWindow::btnBackOneClick);
@@ -72,6 +80,8 @@ FramePlaybackWindow::FramePlaybackWindow(const QVector<CANFrame> *frames, QWidge
     connect(ui->btnLoadLive, &QAbstractButton::clicked, this, &FramePlaybackWindow::btnLoadLive);
     connect(ui->tblSequence, &QTableWidget::cellPressed, this, &FramePlaybackWindow::seqTableCellClicked);
     connect(ui->tblSequence, &QTableWidget::cellChanged, this, &FramePlaybackWindow::seqTableCellChanged);
+    connect(ui->tblBusRates, &QTableWidget::cellChanged, this, &FramePlaybackWindow::busRateChanged);
+    connect(ui->btnApplyTransforms, &QAbstractButton::clicked, this, &FramePlaybackWindow::applyTransforms);
     connect(ui->btnLoadFilters, &QAbstractButton::clicked, this, &FramePlaybackWindow::loadFilters);
     connect(ui->btnSaveFilters, &QAbstractButton::clicked, this, &FramePlaybackWindow::saveFilters);
     connect(ui->cbOriginalTiming, &QCheckBox::toggled, this, &FramePlaybackWindow::useOrigTimingClicked);
@@ -116,6 +126,7 @@ void FramePlaybackWindow::showEvent(QShowEvent *)
 
     playbackObject.initialize();
     playbackObject.setNumBuses(numBuses);
+    setupBusRates(numBuses);
 }
 
 void FramePlaybackWindow::closeEvent(QCloseEvent *event)
@@ -251,6 +262,8 @@ void FramePlaybackWindow::loadFilters()
 
         btnSelectNoneClick();
 
+        //one schedule rebuild for the whole file rather than one per ID
+        ui->listID->blockSignals(true);
         while (!inFile->atEnd()) {
             line = inFile->readLine().simplified();
             if (line.length() > 2)
@@ -281,12 +294,32 @@ void FramePlaybackWindow::loadFilters()
             }
         }
         inFile->close();
+        ui->listID->blockSignals(false);
+        playbackObject.rebuildSchedule(currentSeqItem);
         dialog.setDirectory(settings.value("Filters/LoadSaveDirectory", dialog.directory().path()).toString());
     }
 }
 
+//sequences streamed from a binary capture only hold a window of it, the file itself is mapped and not counted
+void FramePlaybackWindow::reportMemory(QVector<MemoryUsage> &out) const
+{
+    QString owner = memoryOwner("Playback Window");
+    for (const SequenceItem &item : seqItems)
+        out.append({owner, QFileInfo(item.filename).fileName(), MemoryAccounting::bytesOf(item.data) + MemoryAccounting::bytesOf(item.idFilters)
+                                                                + MemoryAccounting::bytesOf(item.schedule)});
+    out.append({owner, "frame cache", MemoryAccounting::bytesOf(frameCache)});
+}
+
+qint64 FramePlaybackWindow::purgeMemory()
+{
+    qint64 freed = MemoryAccounting::bytesOf(frameCache);
+    frameCache.clear();
+    return freed;
+}
+
 void FramePlaybackWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("FramePlaybackWindow::updatedFrames");
     CANFrame thisFrame;
 
     if (numFrames == -1) //all frames deleted. Don't care
@@ -426,15 +459,102 @@ void FramePlaybackWindow::updateFrameLabel()
     {
         ui->lblCurrPlayback->setText("");
         ui->lblPosition->setText("");
+        ui->lblTiming->setText("");
         return;
     }
 
     ui->lblCurrPlayback->setText(currentSeqItem->filename);
 
     if (wantPlaying && !isPlaying)
-        ui->lblPosition->setText(QString::number(currentPosition) + tr(" of ") + QString::number(seqItems[row].data.count()) + "  (WAITING)");
+        ui->lblPosition->setText(QString::number(currentPosition) + tr(" of ") + QString::number(seqItems[row].frameCount()) + "  (WAITING)");
+    else
+        ui->lblPosition->setText(QString::number(currentPosition) + tr(" of ") + QString::number(seqItems[row].frameCount()));
+
+    //how close original timing playback is getting to the capture's own timing
+    quint64 sentFrames;
+    double meanError;
+    qint64 maxError;
+    playbackObject.getTimingError(sentFrames, meanError, maxError);
+    if (ui->cbOriginalTiming->isChecked() && sentFrames > 0)
+        ui->lblTiming->setText(tr("Timing error: mean ") + QString::number(meanError, 'f', 1) + tr("us, max ")
+                               + QString::number(maxError) + tr("us (") + QString::number(sentFrames) + tr(" frames)"));
     else
-        ui->lblPosition->setText(QString::number(currentPosition) + tr(" of ") + QString::number(seqItems[row].data.count()));
+        ui->lblTiming->setText("");
+
+    for (int bus = 0; bus < ui->tblBusRates->rowCount(); bus++)
+    {
+        QTableWidgetItem *waiting = ui->tblBusRates->item(bus, 2);
+        if (waiting) waiting->setText(QString::number(playbackObject.getBusQueueDepth(bus)));
+    }
+}
+
+//one row per bus. The limits are remembered from last time
+void FramePlaybackWindow::setupBusRates(int numBuses)
+{
+    QSettings settings;
+    QStringList headers;
+    headers << tr("Bus") << tr("Max frames/s") << tr("Waiting");
+
+    ui->tblBusRates->blockSignals(true);
+    ui->tblBusRates->clear();
+    ui->tblBusRates->setColumnCount(3);
+    ui->tblBusRates->setHorizontalHeaderLabels(headers);
+    ui->tblBusRates->verticalHeader()->setVisible(false);
+    ui->tblBusRates->setRowCount(qMin(numBuses, PLAYBACK_MAX_BUSES));
+    for (int bus = 0; bus < ui->tblBusRates->rowCount(); bus++)
+    {
+        int rate = settings.value("Playback/BusRate" + QString::number(bus), 0).toInt();
+        playbackObject.setBusRateLimit(bus, rate);
+
+        QTableWidgetItem *busItem = new QTableWidgetItem(QString::number(bus));
+        busItem->setFlags(busItem->flags() & ~Qt::ItemIsEditable);
+        ui->tblBusRates->setItem(bus, 0, busItem);
+        ui->tblBusRates->setItem(bus, 1, new QTableWidgetItem(QString::number(rate)));
+        QTableWidgetItem *waiting = new QTableWidgetItem("0");
+        waiting->setFlags(waiting->flags() & ~Qt::ItemIsEditable);
+        ui->tblBusRates->setItem(bus, 2, waiting);
+    }
+    ui->tblBusRates->blockSignals(false);
+}
+
+void FramePlaybackWindow::busRateChanged(int row, int col)
+{
+    if (col != 1) return;
+    QSettings settings;
+    int rate = qMax(0, static_cast<int>(Utility::ParseStringToNum(ui->tblBusRates->item(row, col)->text())));
+    playbackObject.setBusRateLimit(row, rate);
+    settings.setValue("Playback/BusRate" + QString::number(row), rate);
+}
+
+//nothing changes unless every line parses, the first bad one is shown instead
+void FramePlaybackWindow::applyTransforms()
+{
+    QVector<PlaybackTransformRule> rules;
+    QStringList lines = ui->txtTransforms->toPlainText().split('\n');
+    for (int i = 0; i < lines.count(); i++)
+    {
+        QString line = lines[i].trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        PlaybackTransformRule rule;
+        QString why;
+        if (!PlaybackTransformRule::parse(line, rule, why))
+        {
+            ui->lblTransforms->setText(tr("Line %1: %2").arg(i + 1).arg(why));
+            return;
+        }
+        rules.append(rule);
+    }
+
+    QSettings settings;
+    settings.setValue("Playback/Transforms", ui->txtTransforms->toPlainText());
+    transforms.clear();
+    if (!rules.isEmpty())
+    {
+        transforms = PlaybackTransforms::compile(rules, modelFrames);
+        if (transforms->isEmpty()) transforms.clear(); //only "time 1" lines
+    }
+    playbackObject.setTransforms(transforms);
+    ui->lblTransforms->setText(rules.isEmpty() ? tr("No transforms") : tr("%n transform(s) in use", "", rules.count()));
 }
 
 void FramePlaybackWindow::seqTableCellClicked(int row, int col)
@@ -463,14 +583,23 @@ void FramePlaybackWindow::fillIDHash(SequenceItem &item)
 
     item.idFilters.clear();
 
-    for (int i = 0; i < item.data.count(); i++)
+    if (item.stream) //straight from the records so nothing gets decoded just for this
+    {
+        const MappedCapture &capture = item.stream->source();
+        for (int i = 0; i < capture.count(); i++) item.idFilters.insert(capture.record(i).frameId(), true);
+    }
+    else
     {
-        id = item.data[i].frameId();
-        if (!item.idFilters.contains(id))
+        for (int i = 0; i < item.data.count(); i++)
         {
-            item.idFilters.insert(id, true);
+            id = item.data[i].frameId();
+            if (!item.idFilters.contains(id))
+            {
+                item.idFilters.insert(id, true);
+            }
         }
     }
+    item.buildSchedule(); //not handed to playback yet so it can be done right here
 }
 
 void FramePlaybackWindow::useOrigTimingClicked()
@@ -514,11 +643,23 @@ void FramePlaybackWindow::btnDeleteCurrSeq()
 void FramePlaybackWindow::btnLoadFile()
 {
     QString filename;
+    QString mappedFile;
     SequenceItem item;
 
-    if (FrameFileIO::loadFrameFile(filename, &item.data))
+    if (FrameFileIO::loadFrameFile(filename, &item.data, &mappedFile))
     {
-        std::sort(item.data.begin(), item.data.end()); //sort by timestamp to be sure it's in order
+        if (!mappedFile.isEmpty())
+        {
+            //binary captures get played from disk instead of loaded. They're already in the order they were captured
+            QSharedPointer<MappedCapture> capture(new MappedCapture);
+            if (!capture->open(mappedFile))
+            {
+                QMessageBox::warning(this, tr("Error Loading"), tr("Could not open the binary capture ") + mappedFile);
+                return;
+            }
+            item.stream.reset(new CaptureStreamer(capture));
+        }
+        else std::sort(item.data.begin(), item.data.end()); //sort by timestamp to be sure it's in order
         QStringList fileList = filename.split('/');
         item.filename = fileList[fileList.length() - 1];
         item.currentLoopCount = 0;
@@ -551,7 +692,7 @@ void FramePlaybackWindow::btnLoadLive()
     item.filename = "<CAPTURED DATA>";
     item.currentLoopCount = 0;
     item.maxLoops = 1;
-    item.data = QVector<CANFrame>(*modelFrames); //create a copy of the current frames from the main view
+    item.data = modelFrames->toVector(); //create a copy of the current frames from the main view
     std::sort(item.data.begin(), item.data.end()); //be sure it's all in time based order
     fillIDHash(item);
     if (ui->tblSequence->currentRow() == -1)
@@ -595,6 +736,7 @@ void FramePlaybackWindow::btnPauseClick()
 void FramePlaybackWindow::btnReverseClick()
 {
     if (!checkNoSeqLoaded()) return;
+    if (transforms && !transforms->isCurrent()) applyTransforms(); //the DBC changed since they were compiled
     forward = false;
     wantPlaying = true;
     if (!ui->ckWaitForTraffic->isChecked())
@@ -631,6 +773,7 @@ void FramePlaybackWindow::btnStopClick()
 void FramePlaybackWindow::btnPlayClick()
 {
     if (!checkNoSeqLoaded()) return;
+    if (transforms && !transforms->isCurrent()) applyTransforms(); //the DBC changed since they were compiled
     forward = true;
     wantPlaying = true;
     if (!ui->ckWaitForTraffic->isChecked())
@@ -687,24 +830,33 @@ void FramePlaybackWindow::changeIDFiltering(QListWidgetItem *item)
     qDebug() << "Changed ID filter " << item->text() << " : " << item->checkState();
     int ID = FilterUtility::getIdAsInt(item);
     currentSeqItem->idFilters[ID] = (item->checkState() == Qt::Checked) ? true : false;
+    playbackObject.rebuildSchedule(currentSeqItem);
 }
 
 void FramePlaybackWindow::btnSelectAllClick()
 {
+    if (!currentSeqItem) return;
+    ui->listID->blockSignals(true); //every ID at once, then one schedule rebuild
     for (int i = 0; i < ui->listID->count(); i++)
     {
         QListWidgetItem *item = ui->listID->item(i);
         item->setCheckState(Qt::Checked);
         currentSeqItem->idFilters[Utility::ParseStringToNum(item->text())] = true;
     }
+    ui->listID->blockSignals(false);
+    playbackObject.rebuildSchedule(currentSeqItem);
 }
 
 void FramePlaybackWindow::btnSelectNoneClick()
 {
+    if (!currentSeqItem) return;
+    ui->listID->blockSignals(true);
     for (int i = 0; i < ui->listID->count(); i++)
     {
         QListWidgetItem *item = ui->listID->item(i);
         item->setCheckState(Qt::Unchecked);
         currentSeqItem->idFilters[Utility::ParseStringToNum(item->text())] = false;
     }
+    ui->listID->blockSignals(false);
+    playbackObject.rebuildSchedule(currentSeqItem);
 }
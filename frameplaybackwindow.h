@@ -4,20 +4,24 @@
 #include <QDialog>
 #include <QListWidget>
 #include "can_structs.h"
+#include "canframestore.h"
 #include "framefileio.h"
 #include "frameplaybackobject.h"
+#include "memoryaccounting.h"
 
 namespace Ui {
 class FramePlaybackWindow;
 }
 
-class FramePlaybackWindow : public QDialog
+class FramePlaybackWindow : public QDialog, public MemoryReporter
 {
     Q_OBJECT
 
 public:
-    explicit FramePlaybackWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit FramePlaybackWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~FramePlaybackWindow();
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+    qint64 purgeMemory() override;
 
 private slots:
     void btnBackOneClick();
@@ -38,6 +42,8 @@ private slots:
     void btnLoadLive();
     void seqTableCellClicked(int row, int col);
     void seqTableCellChanged(int row, int col);
+    void busRateChanged(int row, int col);
+    void applyTransforms();
     void contextMenuFilters(QPoint);
     void saveFilters();
     void loadFilters();
@@ -50,7 +56,7 @@ private:
     Ui::FramePlaybackWindow *ui;
     QList<int> foundID;
     QList<CANFrame> frameCache;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     QList<SequenceItem> seqItems;
     SequenceItem *currentSeqItem;
     int currentSeqNum;
@@ -60,10 +66,12 @@ private:
     bool isPlaying;
     int currentPosition;
     bool haveIncomingTraffic = false;
+    QSharedPointer<PlaybackTransforms> transforms; //what the playback object was last given
 
     void refreshIDList();
     void updateFrameLabel();
     void fillIDHash(SequenceItem &item);
+    void setupBusRates(int numBuses);
     void showEvent(QShowEvent *);
     void closeEvent(QCloseEvent *event);
     void readSettings();
@@ -0,0 +1,501 @@
+#include "framequery.h"
+#include "pipelinetrace.h"
+#include "utility.h"
+
+#include <QHash>
+#include <QObject>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+const double NO_VALUE = std::numeric_limits<double>::quiet_NaN();
+
+inline bool isWordChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+//where one of select / where / group by / limit starts and where what follows it starts
+struct Clause
+{
+    QString word;
+    int start;
+    int body;
+};
+
+//the clause words at the top level of the text, outside any brackets so sig(...) or in {...} can hold anything
+QVector<Clause> findClauses(const QString &text)
+{
+    QVector<Clause> clauses;
+    int depth = 0;
+    int i = 0;
+    while (i < text.length())
+    {
+        QChar c = text[i];
+        if (c == '(' || c == '[' || c == '{') depth++;
+        else if (c == ')' || c == ']' || c == '}') depth = qMax(0, depth - 1);
+        if (depth > 0 || !c.isLetter() || (i > 0 && isWordChar(text[i - 1])))
+        {
+            i++;
+            continue;
+        }
+        int end = i;
+        while (end < text.length() && isWordChar(text[end])) end++;
+        QString word = text.mid(i, end - i).toLower();
+        if (word == "group")
+        {
+            int next = end;
+            while (next < text.length() && text[next].isSpace()) next++;
+            int byEnd = next;
+            while (byEnd < text.length() && isWordChar(text[byEnd])) byEnd++;
+            if (text.mid(next, byEnd - next).compare(QLatin1String("by"), Qt::CaseInsensitive) == 0)
+            {
+                clauses.append({word, i, byEnd});
+                i = byEnd;
+                continue;
+            }
+        }
+        else if (word == "select" || word == "where" || word == "limit") clauses.append({word, i, end});
+        i = end;
+    }
+    return clauses;
+}
+
+//the comma separated parts of a clause, again only at the top level
+QStringList splitTopLevel(const QString &text)
+{
+    QStringList parts;
+    int depth = 0;
+    int start = 0;
+    for (int i = 0; i < text.length(); i++)
+    {
+        QChar c = text[i];
+        if (c == '(' || c == '[' || c == '{') depth++;
+        else if (c == ')' || c == ']' || c == '}') depth = qMax(0, depth - 1);
+        else if (c == ',' && depth == 0)
+        {
+            parts.append(text.mid(start, i - start).trimmed());
+            start = i + 1;
+        }
+    }
+    parts.append(text.mid(start).trimmed());
+    return parts;
+}
+
+//"name(inner)" split up. False if it isn't a call
+bool splitCall(const QString &text, QString &name, QString &inner)
+{
+    int paren = text.indexOf('(');
+    if (paren <= 0 || !text.endsWith(')')) return false;
+    name = text.left(paren).trimmed().toLower();
+    for (QChar c : name)
+    {
+        if (!isWordChar(c)) return false;
+    }
+    inner = text.mid(paren + 1, text.length() - paren - 2).trimmed();
+    return true;
+}
+
+//one group's worth of one aggregate. Sees the group's frames in order, later chunks are merged on the end
+struct Accumulator
+{
+    qint64 count = 0;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double first = 0.0;
+    double last = 0.0;
+    uint64_t firstStamp = 0;
+    uint64_t lastStamp = 0;
+    uint64_t maxGap = 0; //us. Frames from a few connections can be slightly out of order, those aren't a gap
+
+    inline void add(double v, uint64_t stamp)
+    {
+        if (count == 0)
+        {
+            first = v;
+            firstStamp = stamp;
+        }
+        else if (stamp > lastStamp && stamp - lastStamp > maxGap) maxGap = stamp - lastStamp;
+        last = v;
+        lastStamp = stamp;
+        count++;
+        sum += v;
+        sumSquares += v * v;
+        if (v < min) min = v;
+        if (v > max) max = v;
+    }
+
+    void merge(const Accumulator &later)
+    {
+        if (later.count == 0) return;
+        if (count == 0)
+        {
+            *this = later;
+            return;
+        }
+        if (later.firstStamp > lastStamp) maxGap = qMax(maxGap, later.firstStamp - lastStamp);
+        maxGap = qMax(maxGap, later.maxGap);
+        count += later.count;
+        sum += later.sum;
+        sumSquares += later.sumSquares;
+        min = qMin(min, later.min);
+        max = qMax(max, later.max);
+        last = later.last;
+        lastStamp = later.lastStamp;
+    }
+};
+
+}
+
+//one chunk of rows grouped and aggregated on a pool thread. The calling thread joins the chunks up once all are done
+class QueryWorker : public QRunnable
+{
+public:
+    QueryWorker(const CANFrameSnapshot &frames, const FrameQuery *query, int from, int to,
+                QAtomicInteger<qint64> *rowsDone, const QAtomicInt *cancel)
+        : frames(frames), query(query), from(from), to(to), rowsDone(rowsDone), cancel(cancel)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        const FilterExpression *where = query->where.data();
+        const int numKeys = query->keys.count();
+        const int numItems = query->items.count();
+        const int numValues = query->values.count();
+        QVector<double> probe(numKeys);
+        QVector<double> vals(numValues);
+
+        for (int start = from; start < to && !cancel->loadRelaxed(); start += 4096)
+        {
+            int end = qMin(start + 4096, to);
+            for (int row = start; row < end; row++)
+            {
+                const CANFrameRecord &rec = frames.record(row);
+                const uint8_t *payload = frames.payloadData(row);
+                if (where && !where->matches(rec, payload)) continue;
+
+                bool keyed = true;
+                for (int k = 0; k < numKeys && keyed; k++)
+                {
+                    probe[k] = keyValue(query->keys.at(k), rec, payload);
+                    keyed = !std::isnan(probe[k]);
+                }
+                if (!keyed) continue;
+                matched++;
+
+                int group;
+                auto it = groups.constFind(probe);
+                if (it != groups.constEnd()) group = it.value();
+                else
+                {
+                    group = groupKeys.count();
+                    groups.insert(probe, group);
+                    groupKeys.append(probe);
+                    accs.resize(accs.count() + numItems);
+                }
+
+                //every value once, however many aggregates want it
+                for (int v = 0; v < numValues; v++) vals[v] = query->values.at(v)->valueOf(rec, payload);
+                Accumulator *acc = accs.data() + group * numItems;
+                for (int i = 0; i < numItems; i++)
+                {
+                    const int v = query->items.at(i).value;
+                    const double value = (v < 0) ? 0.0 : vals.at(v);
+                    if (!std::isnan(value)) acc[i].add(value, rec.timestamp);
+                }
+            }
+            rowsDone->fetchAndAddRelaxed(end - start);
+        }
+    }
+
+    QHash<QVector<double>, int> groups; //group values -> index into groupKeys
+    QVector<QVector<double>> groupKeys; //in the order the groups turned up
+    QVector<Accumulator> accs; //items of each group one after another
+    qint64 matched = 0;
+
+private:
+    static inline double keyValue(const FrameQuery::Key &key, const CANFrameRecord &rec, const uint8_t *payload)
+    {
+        switch (key.source)
+        {
+        case FrameQuery::KEY_ID: return rec.frameId();
+        case FrameQuery::KEY_BUS: return rec.bus;
+        case FrameQuery::KEY_BUCKET: return std::floor(rec.timestamp / 1000000.0 / key.width) * key.width;
+        default: return key.value->valueOf(rec, payload);
+        }
+    }
+
+    CANFrameSnapshot frames;
+    const FrameQuery *query;
+    int from, to;
+    QAtomicInteger<qint64> *rowsDone;
+    const QAtomicInt *cancel;
+};
+
+QSharedPointer<const FrameQuery> FrameQuery::compile(const QString &text, QString *error)
+{
+    QString why;
+    auto fail = [&](const QString &what)
+    {
+        if (error) *error = what;
+        return QSharedPointer<const FrameQuery>();
+    };
+    if (error) error->clear();
+
+    QSharedPointer<FrameQuery> query(new FrameQuery);
+    query->source = text.trimmed();
+
+    const QVector<Clause> clauses = findClauses(text);
+    if (clauses.isEmpty() || clauses.first().word != "select" || !text.left(clauses.first().start).trimmed().isEmpty())
+        return fail(QObject::tr("A query starts with select"));
+    static const QStringList order = {"select", "where", "group", "limit"};
+    for (int c = 1; c < clauses.count(); c++)
+    {
+        if (order.indexOf(clauses[c].word) <= order.indexOf(clauses[c - 1].word))
+            return fail(QObject::tr("'%1' at character %2 is out of place, the order is select, where, group by, limit")
+                        .arg(clauses[c].word).arg(clauses[c].start + 1));
+    }
+
+    for (int c = 0; c < clauses.count(); c++)
+    {
+        const Clause &clause = clauses.at(c);
+        int bodyEnd = (c + 1 < clauses.count()) ? clauses.at(c + 1).start : text.length();
+        QString body = text.mid(clause.body, bodyEnd - clause.body).trimmed();
+        if (body.isEmpty()) return fail(QObject::tr("Nothing after %1").arg(clause.word == "group" ? "group by" : clause.word));
+
+        if (clause.word == "where")
+        {
+            query->where = FilterExpression::compile(body, &why);
+            if (!query->where) return fail(QObject::tr("In the where clause: %1").arg(why));
+        }
+        else if (clause.word == "limit")
+        {
+            bool ok;
+            query->limit = body.toInt(&ok);
+            if (!ok || query->limit < 0) return fail(QObject::tr("limit takes a number of rows, not '%1'").arg(body));
+        }
+        else if (clause.word == "group")
+        {
+            for (const QString &part : splitTopLevel(body))
+            {
+                Key key;
+                key.width = 0.0;
+                QString name, inner;
+                ColumnKind kind = ValueColumn;
+                if (part.compare(QLatin1String("id"), Qt::CaseInsensitive) == 0)
+                {
+                    key.source = KEY_ID;
+                    kind = IdColumn;
+                }
+                else if (part.compare(QLatin1String("bus"), Qt::CaseInsensitive) == 0) key.source = KEY_BUS;
+                else if (splitCall(part, name, inner) && name == "bucket")
+                {
+                    bool ok;
+                    key.source = KEY_BUCKET;
+                    key.width = inner.toDouble(&ok);
+                    if (!ok || !(key.width > 0.0)) return fail(QObject::tr("bucket takes a number of seconds, not '%1'").arg(inner));
+                    kind = TimeColumn;
+                }
+                else
+                {
+                    key.source = KEY_VALUE;
+                    key.value = FilterExpression::compileValue(part, &why);
+                    if (!key.value) return fail(QObject::tr("In '%1': %2").arg(part, why));
+                }
+                query->keys.append(key);
+                query->columns.append(part);
+                query->kinds.append(kind);
+            }
+        }
+    }
+
+    //aggregates go after the group columns, so they're done last
+    QStringList valueTexts;
+    for (const QString &part : splitTopLevel(text.mid(clauses.first().body, (clauses.count() > 1 ? clauses.at(1).start : text.length()) - clauses.first().body)))
+    {
+        QString name, inner;
+        if (!splitCall(part, name, inner))
+            return fail(QObject::tr("Expected an aggregate like count() or mean(value), not '%1'").arg(part));
+
+        Item item;
+        if (name == "count") item.op = AGG_COUNT;
+        else if (name == "sum") item.op = AGG_SUM;
+        else if (name == "mean" || name == "avg") item.op = AGG_MEAN;
+        else if (name == "min") item.op = AGG_MIN;
+        else if (name == "max") item.op = AGG_MAX;
+        else if (name == "first") item.op = AGG_FIRST;
+        else if (name == "last") item.op = AGG_LAST;
+        else if (name == "stddev") item.op = AGG_STDDEV;
+        else if (name == "rate") item.op = AGG_RATE;
+        else if (name == "maxgap") item.op = AGG_MAXGAP;
+        else return fail(QObject::tr("Unknown aggregate '%1'").arg(name));
+
+        item.value = -1;
+        if (inner.isEmpty())
+        {
+            if (item.op != AGG_COUNT && item.op != AGG_RATE && item.op != AGG_MAXGAP)
+                return fail(QObject::tr("%1 needs a value to work on").arg(name));
+        }
+        else
+        {
+            QString normal = inner.simplified();
+            item.value = valueTexts.indexOf(normal);
+            if (item.value < 0)
+            {
+                QSharedPointer<const FilterExpression> value = FilterExpression::compileValue(inner, &why);
+                if (!value) return fail(QObject::tr("In '%1': %2").arg(part, why));
+                item.value = query->values.count();
+                query->values.append(value);
+                valueTexts.append(normal);
+            }
+        }
+        query->items.append(item);
+        query->columns.append(part);
+        query->kinds.append(ValueColumn);
+    }
+    return query;
+}
+
+bool FrameQuery::isCurrent() const
+{
+    if (where && !where->isCurrent()) return false;
+    for (const QSharedPointer<const FilterExpression> &value : values)
+    {
+        if (!value->isCurrent()) return false;
+    }
+    for (const Key &key : keys)
+    {
+        if (key.value && !key.value->isCurrent()) return false;
+    }
+    return true;
+}
+
+FrameQuery::Result FrameQuery::run(const CANFrameSnapshot &frames, Progress progress) const
+{
+    TRACE_SCOPE("FrameQuery::run");
+    Result result;
+    result.columns = columns;
+    result.kinds = kinds;
+
+    const int total = frames.count();
+    std::vector<std::unique_ptr<QueryWorker>> workers;
+    QAtomicInteger<qint64> rowsDone(0);
+    QAtomicInt cancel(0);
+    for (int from = 0; from < total; from += FRAMEQUERY_CHUNK_ROWS)
+        workers.emplace_back(new QueryWorker(frames, this, from, qMin(from + FRAMEQUERY_CHUNK_ROWS, total), &rowsDone, &cancel));
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    for (auto &worker : workers) pool.start(worker.get());
+    while (!pool.waitForDone(50))
+    {
+        if (progress && !progress(rowsDone.loadRelaxed(), total)) cancel.storeRelaxed(1);
+    }
+    if (cancel.loadRelaxed()) return result;
+
+    //chunks joined up in row order so first, last and the gaps between chunks come out right
+    const int numItems = items.count();
+    QHash<QVector<double>, int> groups;
+    QVector<QVector<double>> groupKeys;
+    QVector<Accumulator> accs;
+    if (keys.isEmpty())
+    {
+        //no groups is one row, even with nothing in it
+        groups.insert(QVector<double>(), 0);
+        groupKeys.append(QVector<double>());
+        accs.resize(numItems);
+    }
+    for (auto &worker : workers)
+    {
+        result.framesMatched += worker->matched;
+        for (int g = 0; g < worker->groupKeys.count(); g++)
+        {
+            const QVector<double> &key = worker->groupKeys.at(g);
+            int group;
+            auto it = groups.constFind(key);
+            if (it != groups.constEnd()) group = it.value();
+            else
+            {
+                group = groupKeys.count();
+                groups.insert(key, group);
+                groupKeys.append(key);
+                accs.resize(accs.count() + numItems);
+            }
+            for (int i = 0; i < numItems; i++) accs[group * numItems + i].merge(worker->accs.at(g * numItems + i));
+        }
+    }
+
+    QVector<int> ordered(groupKeys.count());
+    for (int g = 0; g < ordered.count(); g++) ordered[g] = g;
+    std::sort(ordered.begin(), ordered.end(), [&](int a, int b)
+    {
+        return std::lexicographical_compare(groupKeys[a].constBegin(), groupKeys[a].constEnd(), groupKeys[b].constBegin(), groupKeys[b].constEnd());
+    });
+    if (limit >= 0 && ordered.count() > limit) ordered.resize(limit);
+
+    result.rows.reserve(ordered.count());
+    for (int group : qAsConst(ordered))
+    {
+        QVector<double> row = groupKeys.at(group);
+        for (int i = 0; i < numItems; i++)
+        {
+            const Accumulator &acc = accs.at(group * numItems + i);
+            const bool any = acc.count > 0;
+            double value = NO_VALUE;
+            switch (items.at(i).op)
+            {
+            case AGG_COUNT: value = acc.count; break;
+            case AGG_SUM: if (any) value = acc.sum; break;
+            case AGG_MEAN: if (any) value = acc.sum / acc.count; break;
+            case AGG_MIN: if (any) value = acc.min; break;
+            case AGG_MAX: if (any) value = acc.max; break;
+            case AGG_FIRST: if (any) value = acc.first; break;
+            case AGG_LAST: if (any) value = acc.last; break;
+            case AGG_STDDEV:
+                if (any)
+                {
+                    double mean = acc.sum / acc.count;
+                    value = std::sqrt(qMax(0.0, acc.sumSquares / acc.count - mean * mean));
+                }
+                break;
+            case AGG_RATE:
+                if (acc.count > 1 && acc.lastStamp > acc.firstStamp)
+                    value = (acc.count - 1) * 1000000.0 / static_cast<double>(acc.lastStamp - acc.firstStamp);
+                break;
+            case AGG_MAXGAP: if (acc.count > 1) value = acc.maxGap / 1000000.0; break;
+            }
+            row.append(value);
+        }
+        result.rows.append(row);
+    }
+    result.framesScanned = total;
+    result.complete = true;
+    return result;
+}
+
+QString FrameQuery::formatValue(ColumnKind kind, double value)
+{
+    if (std::isnan(value)) return QString();
+    switch (kind)
+    {
+    case IdColumn:
+        return Utility::formatCANID(static_cast<uint64_t>(value));
+    case TimeColumn:
+        return QString::number(value, 'f', 3);
+    default:
+        if (value == std::floor(value) && std::fabs(value) < 1e15) return QString::number(static_cast<qint64>(value));
+        return QString::number(value, 'g', 10);
+    }
+}
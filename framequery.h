@@ -0,0 +1,120 @@
+#ifndef FRAMEQUERY_H
+#define FRAMEQUERY_H
+
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+#include "canframestore.h"
+#include "filterexpression.h"
+
+//rows of the capture each pool task aggregates
+#define FRAMEQUERY_CHUNK_ROWS   (1 << 18)
+
+/*
+ * Aggregate questions over a whole capture without exporting it, like
+ *     select mean(sig(EngineSpeed)), max(sig(EngineSpeed)) where sig(Gear) == 3
+ *     select count() group by id, bucket(60)
+ *     select maxgap(), rate() where bus == 1 group by id limit 20
+ *
+ * The where clause is a filter expression and every value (what's aggregated, what's grouped on) is one compiled
+ * with FilterExpression::compileValue, so anything the filter box takes works here and signals are decoded
+ * straight out of the stored payloads. Aggregates: count, sum, mean (or avg), min, max, first, last, stddev,
+ * rate (frames a second) and maxgap (longest time between two frames, seconds). count, rate and maxgap can go
+ * without a value and then look at every frame of the group. The others skip frames their value has none for, so
+ * mean(sig(EngineSpeed)) is over the frames that carry EngineSpeed. Group on id, bus, bucket(seconds) for time
+ * slots or any value. Frames where a group value has none are left out. Rows come back ordered by the group values.
+ *
+ * Runs the same way as FrameSearch: over a snapshot, cut into chunks for a thread pool. Each chunk builds its own
+ * table of groups, those get joined up in chunk order at the end so first, last and maxgap come out the same as
+ * one pass would give. The ID set of the where clause throws out frames of other IDs before any program runs.
+ *
+ * Compiled queries don't change and can be shared between threads. Ones using signals have to be compiled again
+ * once the DBC files change, like filter expressions.
+ */
+class FrameQuery
+{
+public:
+    enum ColumnKind
+    {
+        IdColumn,       //a group on id
+        TimeColumn,     //a bucket() group, the start of the slot in seconds
+        ValueColumn     //any other group value or an aggregate
+    };
+
+    struct Result
+    {
+        QStringList columns; //group values first then the aggregates, as written in the query
+        QVector<ColumnKind> kinds;
+        QVector<QVector<double>> rows; //NaN where an aggregate has no value, like the mean of no frames
+        qint64 framesScanned = 0;
+        qint64 framesMatched = 0; //passed the where clause and had every group value
+        bool complete = false; //false when it was stopped
+    };
+
+    //called on the calling thread a few times a second with rows done so far. Return false to stop
+    typedef std::function<bool(qint64 done, qint64 total)> Progress;
+
+    //null with what's wrong in error if the text doesn't parse
+    static QSharedPointer<const FrameQuery> compile(const QString &text, QString *error = nullptr);
+
+    Result run(const CANFrameSnapshot &frames, Progress progress = Progress()) const;
+    bool isCurrent() const;
+    const QString &text() const { return source; }
+
+    //how a value of the column is shown, the same for the query window and scripts
+    static QString formatValue(ColumnKind kind, double value);
+
+private:
+    enum Aggregate
+    {
+        AGG_COUNT,
+        AGG_SUM,
+        AGG_MEAN,
+        AGG_MIN,
+        AGG_MAX,
+        AGG_FIRST,
+        AGG_LAST,
+        AGG_STDDEV,
+        AGG_RATE,
+        AGG_MAXGAP
+    };
+
+    struct Item
+    {
+        Aggregate op;
+        int value; //into values, -1 looks at every frame of the group
+    };
+
+    enum KeySource
+    {
+        KEY_ID,
+        KEY_BUS,
+        KEY_BUCKET,
+        KEY_VALUE
+    };
+
+    struct Key
+    {
+        KeySource source;
+        double width; //seconds, for a bucket
+        QSharedPointer<const FilterExpression> value;
+    };
+
+    friend class QueryWorker;
+
+    FrameQuery() : limit(-1) {}
+
+    QString source;
+    QSharedPointer<const FilterExpression> where;
+    QVector<Item> items;
+    QVector<QSharedPointer<const FilterExpression>> values; //each different one once, however many items use it
+    QVector<Key> keys;
+    QStringList columns;
+    QVector<ColumnKind> kinds;
+    int limit; //-1 for every row
+};
+
+#endif // FRAMEQUERY_H
@@ -0,0 +1,266 @@
+#include "framesearch.h"
+#include "pipelinetrace.h"
+
+#include <QHash>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QtEndian>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+bool patternAt(const uint8_t *data, const uint8_t *pattern, const uint8_t *mask, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        if ((data[i] ^ pattern[i]) & mask[i]) return false;
+    }
+    return true;
+}
+
+//one chunk of rows checked on a pool thread. The GUI thread picks up what it found once they're all done
+class SearchWorker : public QRunnable
+{
+public:
+    struct Seen
+    {
+        int firstRow;
+        quint8 first;
+        quint8 last;
+    };
+
+    SearchWorker(const CANFrameSnapshot &frames, const FrameSearch::Query *query, int from, int to,
+                 QAtomicInteger<qint64> *rowsDone, const QAtomicInt *cancel)
+        : frames(frames), query(query), from(from), to(to), rowsDone(rowsDone), cancel(cancel)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        for (int start = from; start < to && !cancel->loadRelaxed(); start += 4096)
+        {
+            int end = qMin(start + 4096, to);
+            switch (query->mode)
+            {
+            case FrameSearch::BYTE_PATTERN:
+                searchPattern(start, end);
+                break;
+            case FrameSearch::EXPRESSION:
+                searchExpression(start, end);
+                break;
+            case FrameSearch::CHANGED_BITS:
+                searchChanges(start, end);
+                break;
+            }
+            rowsDone->fetchAndAddRelaxed(end - start);
+        }
+    }
+
+    QVector<int> found;
+    //changed bits: first and last value this chunk saw of each ID so the chunks can be joined up afterwards
+    QHash<quint64, Seen> seen;
+
+private:
+    inline bool inScope(const CANFrameRecord &rec, int row) const
+    {
+        const FilterExpression *expr = query->expression.data();
+        return !expr || expr->matches(rec, frames.payloadData(row));
+    }
+
+    void searchPattern(int start, int end)
+    {
+        const int length = query->pattern.length();
+        const uint8_t *pattern = reinterpret_cast<const uint8_t *>(query->pattern.constData());
+        const uint8_t *mask = reinterpret_cast<const uint8_t *>(query->patternMask.constData());
+        const int offset = query->offset;
+
+        //the pattern as a word to hold against the inline bytes, shifted along one byte at a time
+        const bool wordable = length <= CANFrameRecord::INLINE_BYTES;
+        quint64 wordValue = 0, wordMask = 0;
+        for (int i = 0; i < length && wordable; i++)
+        {
+            wordValue |= static_cast<quint64>(pattern[i] & mask[i]) << (8 * i);
+            wordMask |= static_cast<quint64>(mask[i]) << (8 * i);
+        }
+
+        for (int row = start; row < end; row++)
+        {
+            const CANFrameRecord &rec = frames.record(row);
+            const int last = rec.len - length; //last place the pattern can start
+            if (last < 0) continue;
+            int low = 0, high = last;
+            if (offset >= 0)
+            {
+                if (offset > last) continue;
+                low = high = offset;
+            }
+
+            bool hit = false;
+            if (wordable && rec.isInline())
+            {
+                const quint64 word = qFromLittleEndian<quint64>(rec.data);
+                for (int o = low; o <= high && !hit; o++) hit = (((word >> (8 * o)) ^ wordValue) & wordMask) == 0;
+            }
+            else
+            {
+                const uint8_t *data = frames.payloadData(row);
+                for (int o = low; o <= high && !hit; o++) hit = patternAt(data + o, pattern, mask, length);
+            }
+            if (hit && inScope(rec, row)) found.append(row);
+        }
+    }
+
+    void searchExpression(int start, int end)
+    {
+        const FilterExpression *expr = query->expression.data();
+        for (int row = start; row < end; row++)
+        {
+            const CANFrameRecord &rec = frames.record(row);
+            if (!expr->mayMatchId(rec.frameId())) continue;
+            if (expr->matches(rec, frames.payloadData(row))) found.append(row);
+        }
+    }
+
+    void searchChanges(int start, int end)
+    {
+        const int byte = query->changedByte;
+        const quint8 mask = query->changedMask;
+        for (int row = start; row < end; row++)
+        {
+            const CANFrameRecord &rec = frames.record(row);
+            if (rec.len <= byte) continue; //doesn't carry the byte, isn't part of the sequence
+            if (!inScope(rec, row)) continue;
+            const quint8 value = (rec.isInline() ? rec.data[byte] : frames.payloadData(row)[byte]) & mask;
+            auto it = seen.find(CANFrameStore::idKey(rec.frameId(), rec.bus));
+            if (it == seen.end())
+            {
+                seen.insert(CANFrameStore::idKey(rec.frameId(), rec.bus), {row, value, value});
+                continue;
+            }
+            if (it->last != value) found.append(row);
+            it->last = value;
+        }
+    }
+
+    CANFrameSnapshot frames; //own copy, a snapshot is one thread at a time
+    const FrameSearch::Query *query;
+    int from, to;
+    QAtomicInteger<qint64> *rowsDone;
+    const QAtomicInt *cancel;
+};
+}
+
+bool FrameSearch::parsePattern(const QString &text, QByteArray &bytes, QByteArray &mask, QString *error)
+{
+    bytes.clear();
+    mask.clear();
+    QString digits;
+    for (QChar c : text)
+    {
+        if (c.isSpace() || c == ',') continue;
+        digits.append(c.toLower());
+    }
+    if (digits.isEmpty())
+    {
+        if (error) *error = "Nothing to search for";
+        return false;
+    }
+    if (digits.length() & 1)
+    {
+        if (error) *error = "Bytes are two hex digits each";
+        return false;
+    }
+    if (digits.length() / 2 > CANFrameRecord::MAX_BYTES)
+    {
+        if (error) *error = QString("A pattern can't be longer than %1 bytes").arg(CANFrameRecord::MAX_BYTES);
+        return false;
+    }
+
+    for (int i = 0; i < digits.length(); i += 2)
+    {
+        int value = 0, care = 0;
+        for (int n = 0; n < 2; n++)
+        {
+            QChar c = digits.at(i + n);
+            value <<= 4;
+            care <<= 4;
+            if (c == '?' || c == 'x') continue;
+            int nibble = c.isDigit() ? c.digitValue() : ((c >= 'a' && c <= 'f') ? c.unicode() - 'a' + 10 : -1);
+            if (nibble < 0)
+            {
+                if (error) *error = QString("'%1' isn't a hex digit or ?").arg(c);
+                return false;
+            }
+            value |= nibble;
+            care |= 0xF;
+        }
+        bytes.append(static_cast<char>(value));
+        mask.append(static_cast<char>(care));
+    }
+    return true;
+}
+
+QVector<quint64> FrameSearch::run(const CANFrameSnapshot &frames, const Query &query, Progress progress)
+{
+    TRACE_SCOPE("FrameSearch::run");
+    QVector<quint64> out;
+    if (query.mode == EXPRESSION && !query.expression) return out;
+    if (query.mode == BYTE_PATTERN && (query.pattern.isEmpty() || query.patternMask.length() != query.pattern.length())) return out;
+    if (query.mode == CHANGED_BITS && (query.changedByte < 0 || query.changedMask == 0)) return out;
+
+    const int total = frames.count();
+    std::vector<std::unique_ptr<SearchWorker>> workers;
+    QAtomicInteger<qint64> rowsDone(0);
+    QAtomicInt cancel(0);
+    for (int from = 0; from < total; from += FRAMESEARCH_CHUNK_ROWS)
+        workers.emplace_back(new SearchWorker(frames, &query, from, qMin(from + FRAMESEARCH_CHUNK_ROWS, total), &rowsDone, &cancel));
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    for (auto &worker : workers) pool.start(worker.get());
+    while (!pool.waitForDone(50))
+    {
+        if (progress && !progress(rowsDone.loadRelaxed(), total)) cancel.storeRelaxed(1);
+    }
+    if (cancel.loadRelaxed()) return out;
+
+    QVector<int> rows;
+    int found = 0;
+    for (auto &worker : workers) found += worker->found.count();
+    rows.reserve(found);
+    for (auto &worker : workers) rows.append(worker->found);
+
+    if (query.mode == CHANGED_BITS)
+    {
+        //the first frame of an ID in a chunk is a change if it differs from the last one the chunks before saw
+        QHash<quint64, quint8> last;
+        bool stitched = false;
+        for (auto &worker : workers)
+        {
+            for (auto it = worker->seen.constBegin(); it != worker->seen.constEnd(); ++it)
+            {
+                auto prev = last.find(it.key());
+                if (prev == last.end())
+                {
+                    last.insert(it.key(), it->last);
+                    continue;
+                }
+                if (prev.value() != it->first)
+                {
+                    rows.append(it->firstRow);
+                    stitched = true;
+                }
+                prev.value() = it->last;
+            }
+        }
+        if (stitched) std::sort(rows.begin(), rows.end());
+    }
+
+    out.reserve(rows.count());
+    for (int row : qAsConst(rows)) out.append(frames.sequenceOf(row));
+    return out;
+}
@@ -0,0 +1,61 @@
+#ifndef FRAMESEARCH_H
+#define FRAMESEARCH_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+#include "canframestore.h"
+#include "filterexpression.h"
+
+//rows of the capture each pool task looks through
+#define FRAMESEARCH_CHUNK_ROWS  (1 << 18)
+
+/*
+ * Searches a whole capture for frames by what's in them rather than by ID: a run of bytes (with don't care bits)
+ * anywhere in the payload or at a set offset, frames a filter expression matches (which covers signal values in a
+ * range), or frames where some bits of a byte changed from the previous frame with the same ID and bus.
+ *
+ * Works on a snapshot of the store so the frame list can keep taking frames while it runs. The rows are cut into
+ * chunks that go to a thread pool. Short patterns are checked on the 8 inline bytes of each packed record as one
+ * 64 bit word, shifting a byte at a time, so the common case never touches a payload byte by byte. Longer patterns
+ * and CAN-FD payloads go through the plain byte loop.
+ *
+ * Changed bits needs the previous frame of each ID, which may be in the chunk before. Each chunk notes the first and
+ * last value it saw for each ID and those get stitched together in order once all chunks are done.
+ */
+class FrameSearch
+{
+public:
+    enum Mode
+    {
+        BYTE_PATTERN,
+        EXPRESSION,
+        CHANGED_BITS
+    };
+
+    struct Query
+    {
+        Mode mode = BYTE_PATTERN;
+        QByteArray pattern;     //bytes to look for
+        QByteArray patternMask; //bits of each pattern byte that have to match, same length as pattern
+        int offset = -1;        //payload byte the pattern has to start at, -1 for anywhere
+        int changedByte = 0;
+        quint8 changedMask = 0xFF;
+        //what to find in EXPRESSION mode. In the others only frames it matches are looked at, null looks at all
+        QSharedPointer<const FilterExpression> expression;
+    };
+
+    //called on the calling thread a few times a second with rows done so far. Return false to stop
+    typedef std::function<bool(qint64 done, qint64 total)> Progress;
+
+    //"12 ?? 3x 0F" - hex bytes, ? or x for a nibble that can be anything. false with error filled in if it's no good
+    static bool parsePattern(const QString &text, QByteArray &bytes, QByteArray &mask, QString *error = nullptr);
+
+    //sequence numbers of the matching frames, oldest first. A search that gets stopped returns nothing
+    static QVector<quint64> run(const CANFrameSnapshot &frames, const Query &query, Progress progress = Progress());
+};
+
+#endif // FRAMESEARCH_H
@@ -0,0 +1,232 @@
+#include "framesearchdialog.h"
+#include "ui_framesearchdialog.h"
+#include "canframemodel.h"
+#include "utility.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QProgressDialog>
+#include <QSettings>
+
+//more than this many hits still get stepped through with Previous / Next but aren't all listed
+#define FRAMESEARCH_MAX_LISTED  10000
+
+FrameSearchDialog::FrameSearchDialog(const CANFrameModel *model, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::FrameSearchDialog),
+    model(model),
+    currentHit(-1)
+{
+    ui->setupUi(this);
+
+    QSettings settings;
+    ui->comboMode->setCurrentIndex(settings.value("FrameSearch/Mode", 0).toInt());
+    ui->editPattern->setText(settings.value("FrameSearch/Pattern").toString());
+    ui->editSignal->setText(settings.value("FrameSearch/Signal").toString());
+    ui->editExpression->setText(settings.value("FrameSearch/Expression").toString());
+
+    connect(ui->comboMode, SIGNAL(currentIndexChanged(int)), this, SLOT(modeChanged()));
+    connect(ui->btnSearch, &QPushButton::clicked, this, &FrameSearchDialog::search);
+    connect(ui->btnPrevious, &QPushButton::clicked, this, &FrameSearchDialog::previousHit);
+    connect(ui->btnNext, &QPushButton::clicked, this, &FrameSearchDialog::nextHit);
+    connect(ui->listResults, &QListWidget::itemActivated, this, &FrameSearchDialog::resultActivated);
+    connect(ui->listResults, &QListWidget::itemClicked, this, &FrameSearchDialog::resultActivated);
+    modeChanged();
+    ui->btnPrevious->setEnabled(false);
+    ui->btnNext->setEnabled(false);
+}
+
+FrameSearchDialog::~FrameSearchDialog()
+{
+    QSettings settings;
+    settings.setValue("FrameSearch/Mode", ui->comboMode->currentIndex());
+    settings.setValue("FrameSearch/Pattern", ui->editPattern->text());
+    settings.setValue("FrameSearch/Signal", ui->editSignal->text());
+    settings.setValue("FrameSearch/Expression", ui->editExpression->text());
+    delete ui;
+}
+
+//combo order: byte pattern, signal in range, changed bits, expression only
+void FrameSearchDialog::modeChanged()
+{
+    int mode = ui->comboMode->currentIndex();
+    ui->editPattern->setEnabled(mode == 0);
+    ui->spinOffset->setEnabled(mode == 0);
+    ui->editSignal->setEnabled(mode == 1);
+    ui->editLow->setEnabled(mode == 1);
+    ui->editHigh->setEnabled(mode == 1);
+    ui->spinByte->setEnabled(mode == 2);
+    ui->editMask->setEnabled(mode == 2);
+    ui->lblExpression->setText(mode == 3 ? tr("Frames matching:") : tr("Only frames matching:"));
+}
+
+bool FrameSearchDialog::buildQuery(FrameSearch::Query &query)
+{
+    QString error;
+    QString exprText = ui->editExpression->text().trimmed();
+
+    switch (ui->comboMode->currentIndex())
+    {
+    case 0:
+        query.mode = FrameSearch::BYTE_PATTERN;
+        if (!FrameSearch::parsePattern(ui->editPattern->text(), query.pattern, query.patternMask, &error))
+        {
+            showError(tr("Pattern: %1").arg(error));
+            return false;
+        }
+        query.offset = ui->spinOffset->value(); //-1 is "Anywhere"
+        break;
+    case 1:
+    {
+        //signal ranges are just an expression. The user's text goes after so a bad one gets its own error
+        bool lowOk, highOk;
+        double low = ui->editLow->text().toDouble(&lowOk);
+        double high = ui->editHigh->text().toDouble(&highOk);
+        QString name = ui->editSignal->text().trimmed();
+        if (name.isEmpty() || !lowOk || !highOk)
+        {
+            showError(tr("Signal ranges need a signal name and two numbers"));
+            return false;
+        }
+        QString range = QString("sig(%1) in %2..%3").arg(name, QString::number(low, 'f', 6), QString::number(high, 'f', 6));
+        exprText = exprText.isEmpty() ? range : QString("(%1) && (%2)").arg(range, exprText);
+        query.mode = FrameSearch::EXPRESSION;
+        break;
+    }
+    case 2:
+    {
+        query.mode = FrameSearch::CHANGED_BITS;
+        query.changedByte = ui->spinByte->value();
+        bool ok;
+        uint mask = ui->editMask->text().trimmed().toUInt(&ok, 16);
+        if (!ok || mask == 0 || mask > 0xFF)
+        {
+            showError(tr("The bit mask is one hex byte, 01 to FF"));
+            return false;
+        }
+        query.changedMask = static_cast<quint8>(mask);
+        break;
+    }
+    default:
+        query.mode = FrameSearch::EXPRESSION;
+        if (exprText.isEmpty())
+        {
+            showError(tr("Nothing to search for"));
+            return false;
+        }
+        break;
+    }
+
+    if (!exprText.isEmpty())
+    {
+        query.expression = FilterExpression::compile(exprText, &error);
+        if (!query.expression)
+        {
+            showError(error);
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrameSearchDialog::showError(const QString &error)
+{
+    QPalette pal = ui->lblStatus->palette();
+    pal.setColor(QPalette::WindowText, QColor(Qt::red));
+    ui->lblStatus->setPalette(pal);
+    ui->lblStatus->setText(error);
+}
+
+void FrameSearchDialog::search()
+{
+    FrameSearch::Query query;
+    if (!buildQuery(query)) return;
+    ui->lblStatus->setPalette(QApplication::palette());
+
+    CANFrameSnapshot frames = model->getListReference()->snapshot();
+    QProgressDialog progress(tr("Searching"), tr("Cancel"), 0, 1000, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+
+    QElapsedTimer timer;
+    timer.start();
+    bool canceled = false;
+    bool dbcChanged = false;
+    //the expression keeps the DBC message sets it reads alive, but edits change signals in place, so a DBC change
+    //while the events run stops the search
+    hits = FrameSearch::run(frames, query, [&](qint64 done, qint64 total)
+    {
+        progress.setValue(static_cast<int>(done * 1000 / qMax<qint64>(total, 1)));
+        qApp->processEvents();
+        canceled = progress.wasCanceled();
+        dbcChanged = query.expression && !query.expression->isCurrent();
+        return !canceled && !dbcChanged;
+    });
+    progress.reset();
+
+    currentHit = -1;
+    if (dbcChanged) showError(tr("The DBC files changed while searching, search again"));
+    else if (canceled) ui->lblStatus->setText(tr("Search canceled"));
+    else ui->lblStatus->setText(tr("%1 of %2 frames found in %3 ms").arg(hits.count()).arg(frames.count()).arg(timer.elapsed()));
+    listResults();
+}
+
+void FrameSearchDialog::listResults()
+{
+    const CANFrameStore *store = model->getListReference();
+    ui->listResults->clear();
+    int listed = qMin(hits.count(), FRAMESEARCH_MAX_LISTED);
+    for (int i = 0; i < listed; i++)
+    {
+        int idx = store->indexOfSequence(hits.at(i));
+        QString text;
+        if (idx < 0) text = tr("(no longer in the frame list)");
+        else
+        {
+            const CANFrameRecord &rec = store->record(idx);
+            const uint8_t *data = store->payloadData(idx);
+            QString bytes;
+            for (int b = 0; b < rec.len; b++) bytes += Utility::formatByteAsHex(data[b]) + " ";
+            text = QString("%1  %2  bus %3  [%4]  %5").arg(Utility::formatTimestamp(rec.timestamp).toString(),
+                                                           Utility::formatCANID(rec.frameId(), rec.isExtended()))
+                       .arg(rec.bus).arg(rec.len).arg(bytes.trimmed());
+        }
+        QListWidgetItem *item = new QListWidgetItem(text, ui->listResults);
+        item->setData(Qt::UserRole, i);
+    }
+    if (hits.count() > listed)
+        ui->lblStatus->setText(ui->lblStatus->text() + tr(", the first %1 listed").arg(listed));
+    ui->btnPrevious->setEnabled(!hits.isEmpty());
+    ui->btnNext->setEnabled(!hits.isEmpty());
+}
+
+void FrameSearchDialog::gotoHit(int idx)
+{
+    if (idx < 0 || idx >= hits.count()) return;
+    currentHit = idx;
+    if (idx < ui->listResults->count())
+    {
+        ui->listResults->blockSignals(true);
+        ui->listResults->setCurrentRow(idx);
+        ui->listResults->blockSignals(false);
+    }
+    emit jumpToFrame(hits.at(idx));
+}
+
+void FrameSearchDialog::resultActivated()
+{
+    QListWidgetItem *item = ui->listResults->currentItem();
+    if (item) gotoHit(item->data(Qt::UserRole).toInt());
+}
+
+void FrameSearchDialog::previousHit()
+{
+    if (hits.isEmpty()) return;
+    gotoHit(currentHit <= 0 ? hits.count() - 1 : currentHit - 1);
+}
+
+void FrameSearchDialog::nextHit()
+{
+    if (hits.isEmpty()) return;
+    gotoHit(currentHit + 1 >= hits.count() ? 0 : currentHit + 1);
+}
@@ -0,0 +1,50 @@
+#ifndef FRAMESEARCHDIALOG_H
+#define FRAMESEARCHDIALOG_H
+
+#include <QDialog>
+#include <QVector>
+
+#include "framesearch.h"
+
+class CANFrameModel;
+
+namespace Ui {
+class FrameSearchDialog;
+}
+
+/*
+ * Front end for FrameSearch. Runs a search over everything in the frame list (not just what the filters show) and
+ * lists the hits. Picking one, or stepping through them with Previous / Next, selects that frame in the main list.
+ * Hits are kept by sequence number so they still point at the right frames as new ones come in and old ones go.
+ */
+class FrameSearchDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FrameSearchDialog(const CANFrameModel *model, QWidget *parent = nullptr);
+    ~FrameSearchDialog();
+
+signals:
+    void jumpToFrame(quint64 sequence);
+
+private slots:
+    void modeChanged();
+    void search();
+    void resultActivated();
+    void previousHit();
+    void nextHit();
+
+private:
+    bool buildQuery(FrameSearch::Query &query);
+    void showError(const QString &error);
+    void listResults();
+    void gotoHit(int idx);
+
+    Ui::FrameSearchDialog *ui;
+    const CANFrameModel *model;
+    QVector<quint64> hits;
+    int currentHit;
+};
+
+#endif // FRAMESEARCHDIALOG_H
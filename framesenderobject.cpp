@@ -1,13 +1,22 @@
 #include "framesenderobject.h"
 #include "mainwindow.h"
+#include "pipelinetrace.h"
+#include "threadpolicy.h"
 
-FrameSenderObject::FrameSenderObject(const QVector<CANFrame> *frames)
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+FrameSenderObject::FrameSenderObject(const CANFrameStore *frames)
 {
     mThread_p = new QThread();
 
     statusCounter = 0;
     modelFrames = frames;
+    lastFrames.setSource(frames);
     dbcHandler = DBCHandler::getReference();
+    sendingElapsed.start();
 }
 
 FrameSenderObject::~FrameSenderObject()
@@ -19,6 +28,7 @@ FrameSenderObject::~FrameSenderObject()
 
 void FrameSenderObject::piStart()
 {
+    ThreadPolicy::apply(ThreadPolicy::SENDER);
     sendingTimer = new QTimer();
     sendingTimer->setTimerType(Qt::PreciseTimer);
     sendingTimer->setInterval(1);
@@ -49,6 +59,8 @@ void FrameSenderObject::initialize()
     //mStarted = true;
 
     connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    //connections added later need the targetted frames too
+    connect(CANConManager::getInstance(), &CANConManager::connectionStatusUpdated, this, &FrameSenderObject::rebuildReactions);
 
     /* in multithread case, this will be called before entering thread event loop */
     return piStart();
@@ -89,6 +101,8 @@ void FrameSenderObject::startSending()
     }
 
     sendingElapsed.start();
+    rebuildSchedule(); //the clock just started over
+    rebuildReactions();
     sendingTimer->start();
 }
 
@@ -96,7 +110,7 @@ void FrameSenderObject::stopSending()
 {
     /* make sure we execute in mThread context */
     if( mThread_p && (mThread_p != QThread::currentThread()) ) {
-        QMetaObject::invokeMethod(this, "stopPlayback",
+        QMetaObject::invokeMethod(this, "stopSending",
                                   Qt::BlockingQueuedConnection);
         return;
     }
@@ -115,6 +129,10 @@ void FrameSenderObject::addSendRecord(FrameSendData record)
         return;
     }
     sendingData.append(record);
+    recordSerials.append(0);
+    sentCounts.append(QAtomicInt(record.count));
+    scheduleRecord(sendingData.count() - 1);
+    rebuildReactions();
 }
 
 void FrameSenderObject::removeSendRecord(int idx)
@@ -127,6 +145,26 @@ void FrameSenderObject::removeSendRecord(int idx)
         return;
     }
     sendingData.removeAt(idx);
+    recordSerials.removeAt(idx);
+    sentCounts.removeAt(idx);
+    rebuildSchedule(); //everything after it moved down one
+    rebuildReactions();
+}
+
+void FrameSenderObject::sendRecordChanged(int idx)
+{
+    /* make sure we execute in mThread context */
+    if( mThread_p && (mThread_p != QThread::currentThread()) ) {
+        QMetaObject::invokeMethod(this, "sendRecordChanged",
+                                  Qt::BlockingQueuedConnection,
+                                  Q_ARG(int, idx));
+        return;
+    }
+    if (idx < 0 || idx >= sendingData.count()) return;
+    sendingData[idx].program.reset(); //compiled again the next time it goes out
+    sentCounts[idx].storeRelaxed(sendingData[idx].count);
+    scheduleRecord(idx);
+    rebuildReactions();
 }
 
 /*
@@ -140,72 +178,101 @@ FrameSendData *FrameSenderObject::getSendRecordRef(int idx)
     return &sendingData[idx];
 }
 
+/*
+ * Records are only added and removed with the caller blocked until it's done, so the GUI thread never sees
+ * sentCounts move under it. The values themselves are written here as frames go out, hence the atomics.
+ */
+int FrameSenderObject::sendCount(int idx) const
+{
+    if (idx < 0 || idx >= sentCounts.count()) return 0;
+    return sentCounts[idx].loadRelaxed();
+}
+
+quint64 FrameSenderObject::nowUs() const
+{
+    return static_cast<quint64>(sendingElapsed.nsecsElapsed() / 1000);
+}
+
+void FrameSenderObject::scheduleTrigger(int record, int trigger, quint64 due)
+{
+    TriggerTimer timer;
+    timer.due = due;
+    timer.record = record;
+    timer.trigger = trigger;
+    timer.serial = recordSerials[record];
+    timerHeap.append(timer);
+    std::push_heap(timerHeap.begin(), timerHeap.end(), std::greater<TriggerTimer>());
+}
+
+//whatever was scheduled for the record before is stale from here on. Its periodic triggers start over from now
+void FrameSenderObject::scheduleRecord(int record)
+{
+    recordSerials[record]++;
+    FrameSendData &sendData = sendingData[record];
+    if (!sendData.enabled)
+    {
+        for (int j = 0; j < sendData.triggers.count(); j++) sendData.triggers[j].currCount = 0; //resetting currCount when line is disabled
+        return;
+    }
+    quint64 now = nowUs();
+    for (int j = 0; j < sendData.triggers.count(); j++)
+    {
+        const Trigger &trigger = sendData.triggers[j];
+        if (!trigger.readyCount || trigger.milliseconds <= 0) continue; //ID triggers get scheduled when their frame shows up
+        scheduleTrigger(record, j, now + static_cast<quint64>(trigger.milliseconds) * 1000);
+    }
+}
+
+void FrameSenderObject::rebuildSchedule()
+{
+    timerHeap.clear();
+    for (int i = 0; i < sendingData.count(); i++) scheduleRecord(i);
+}
+
 /// <summary>
-/// Called every millisecond to set the system update figures and send frames if necessary.
+/// Called every millisecond to send whatever triggers have come due since the last tick.
 /// </summary>
-/// <param name="sender"></param>
-/// <param name="timerEventArgs"></param>
-///
 void FrameSenderObject::timerTriggered()
 {
-    FrameSendData *sendData;
-    Trigger *trigger;
-
     sendingList.clear();
     if(mutex.tryLock())
     {
         /*
-         * Requested tick interval was 1ms but the actual interval could be wildly different. So, we track
-         * by counting microseconds and accumulating. This creates decent stability even for long intervals
+         * Requested tick interval was 1ms but the actual interval could be wildly different. Due times are on
+         * a monotonic clock and each one is the last plus the interval so long intervals stay stable anyway
          */
-        quint64 elapsed = sendingElapsed.nsecsElapsed() / 1000ul;
-        if (elapsed == 0) elapsed = 1;
-        sendingElapsed.start();
-        sendingLastTimeStamp += elapsed;
-        //qDebug() << sendingLastTimeStamp;
-        //qDebug() << "El: " << elapsed;
+        quint64 now = nowUs();
         statusCounter++;
-        for (int i = 0; i < sendingData.count(); i++)
+        QVector<TriggerTimer> again;
+        while (!timerHeap.isEmpty() && timerHeap.first().due <= now)
         {
-            sendData = &sendingData[i];
-            if (!sendData->enabled)
-            {
-                if (sendData->triggers.count() > 0)
-                {
-                    for (int j = 0; j < sendData->triggers.count(); j++)    //resetting currCount when line is disabled
-                    {
-                        sendData->triggers[j].currCount = 0;
-                    }
-                }
-                continue; //abort any processing on this if it is not enabled.
-            }
-            if (sendData->triggers.count() == 0)
-            {
-                //qDebug() << "No triggers to process";
-                break;
-            }
-            for (int j = 0; j < sendData->triggers.count(); j++)
+            std::pop_heap(timerHeap.begin(), timerHeap.end(), std::greater<TriggerTimer>());
+            TriggerTimer timer = timerHeap.takeLast();
+            if (timer.record >= sendingData.count() || timer.serial != recordSerials[timer.record]) continue; //changed since
+            FrameSendData *sendData = &sendingData[timer.record];
+            if (!sendData->enabled || timer.trigger >= sendData->triggers.count()) continue;
+            Trigger *trigger = &sendData->triggers[timer.trigger];
+            if (!trigger->readyCount || trigger->milliseconds <= 0) continue;
+            ThreadPolicy::recordWakeup(ThreadPolicy::SENDER, static_cast<qint64>(now - timer.due));
+
+            sendData->count++;
+            sentCounts[timer.record].storeRelaxed(sendData->count);
+            trigger->currCount++;
+            doModifiers(timer.record);
+            sendingList.append(*sendData); //queue it instead of immediate sending
+            if (trigger->ID > 0) trigger->readyCount = false; //reset flag if this is a timed ID trigger
+            else
             {
-                trigger = &sendData->triggers[j];
-                //if ( (trigger->currCount >= trigger->maxCount) || (trigger->maxCount == -1) ) continue; //don't process if we've sent max frames we were supposed to
-                if (!trigger->readyCount) continue; //don't tick if not ready to tick
-                //is it time to fire?
-                trigger->msCounter += elapsed; //gives proper tracking even if timer doesn't fire as fast as it should
-                //qDebug() << trigger->msCounter;
-                if (trigger->msCounter >= (trigger->milliseconds * 1000))
-                {
-                    trigger->msCounter -= (trigger->milliseconds * 1000);
-                    sendData->count++;
-                    trigger->currCount++;
-                    doModifiers(i);
-                    //updateGridRow(i);
-                    //qDebug() << "About to try to send a frame";
-                    //CANConManager::getInstance()->sendFrame(sendingData[i]);
-                    sendingList.append(sendingData[i]); //queue it instead of immediate sending
-                    if (trigger->ID > 0) trigger->readyCount = false; //reset flag if this is a timed ID trigger
-                }
+                //pushed back after this tick so one that fell behind catches up a frame per tick instead of all at once
+                timer.due += static_cast<quint64>(trigger->milliseconds) * 1000;
+                again.append(timer);
             }
         }
+        for (const TriggerTimer &timer : qAsConst(again))
+        {
+            timerHeap.append(timer);
+            std::push_heap(timerHeap.begin(), timerHeap.end(), std::greater<TriggerTimer>());
+        }
 
         //if we have any frames to send after the above then send as a batch
         if (sendingList.count() > 0) CANConManager::getInstance()->sendFrames(sendingList);
@@ -217,241 +284,160 @@ void FrameSenderObject::timerTriggered()
     }
 }
 
-void FrameSenderObject::buildFrameCache()
+//remember, negative numbers are special -1 = all frames deleted, -2 = totally new set of frames.
+void FrameSenderObject::updatedFrames(int numFrames)
 {
-    CANFrame thisFrame;
-    frameCache.clear();
-    for (int i = 0; i < modelFrames->count(); i++)
-    {
-        thisFrame = modelFrames->at(i);
-        if (!frameCache.contains(thisFrame.frameId()))
-        {
-            frameCache.insert(thisFrame.frameId(), thisFrame);
-        }
-        else
-        {
-            frameCache[thisFrame.frameId()] = thisFrame;
-        }
-    }
+    TRACE_SCOPE("FrameSenderObject::updatedFrames");
+    //frames that were received are already in the live frame table, the connections keep that up to date.
+    //Only a whole new set of frames changes what was loaded
+    if (numFrames == -2) lastFrames.reseed();
 }
 
-//remember, negative numbers are special -1 = all frames deleted, -2 = totally new set of frames.
-void FrameSenderObject::updatedFrames(int numFrames)
+/*
+ * Compiles the incoming frame triggers of every enabled record and registers them as targetted frames. Done on this
+ * thread whenever records change, connections come and go or the DBC changes under the compiled signals.
+ */
+void FrameSenderObject::rebuildReactions()
 {
-    CANFrame thisFrame;
-    if (numFrames == -1) //all frames deleted.
-    {
-    }
-    else if (numFrames == -2) //all new set of frames.
-    {
-        buildFrameCache();
-    }
-    else //just got some new frames. See if they are relevant.
+    reactionRebuildPending.storeRelaxed(0);
+    QSharedPointer<ReactionTable> table(new ReactionTable);
+    table->dbcRevision = DBCHandler::getRevision();
+    table->dbcMessages = DBCHandler::getReference()->sharedMessageSets();
+    QSet<QPair<int, quint32>> exact;
+    QSet<int> anyIdBuses;
+
+    for (int sd = 0; sd < sendingData.count(); sd++)
     {
-        if (numFrames > modelFrames->count()) return;
-        qDebug() << "New frames in sender window";
-        //run through the supposedly new frames in order
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        const FrameSendData &sendData = sendingData[sd];
+        if (!sendData.enabled) continue;
+        for (int trig = 0; trig < sendData.triggers.count(); trig++)
         {
-            thisFrame = modelFrames->at(i);
-            if (!frameCache.contains(thisFrame.frameId()))
+            const Trigger &thisTrigger = sendData.triggers[trig];
+            //Only triggers with BUS and/or ID set are about incoming frames
+            if (!(thisTrigger.triggerMask & (TriggerMask::TRG_BUS | TriggerMask::TRG_ID))) continue;
+
+            Reaction reaction;
+            reaction.record = sd;
+            reaction.trigger = trig;
+            reaction.serial = recordSerials[sd];
+            reaction.bus = (thisTrigger.triggerMask & TriggerMask::TRG_BUS) ? thisTrigger.bus : -1;
+            reaction.sig = nullptr;
+            reaction.matchValue = (thisTrigger.triggerMask & TriggerMask::TRG_SIGVAL) != 0;
+            reaction.value = thisTrigger.sigValueDbl;
+            if (thisTrigger.triggerMask & TriggerMask::TRG_SIGNAL)
             {
-                frameCache.insert(thisFrame.frameId(), thisFrame);
+                DBC_MESSAGE *msg = dbcHandler->findMessage(thisTrigger.ID);
+                reaction.sig = msg ? msg->sigHandler->findSignalByName(thisTrigger.sigName) : nullptr;
+                if (!reaction.sig) continue; //can never pass
+            }
+
+            if (thisTrigger.triggerMask & TriggerMask::TRG_ID)
+            {
+                table->byId[static_cast<quint32>(thisTrigger.ID)].append(reaction);
+                exact.insert(qMakePair(reaction.bus, static_cast<quint32>(thisTrigger.ID)));
             }
             else
             {
-                frameCache[thisFrame.frameId()] = thisFrame;
+                table->anyId.append(reaction);
+                anyIdBuses.insert(reaction.bus);
             }
-            processIncomingFrame(&thisFrame);
         }
     }
-}
 
-void FrameSenderObject::processIncomingFrame(CANFrame *frame)
-{
-    for (int sd = 0; sd < sendingData.count(); sd++)
     {
-        if (sendingData[sd].triggers.count() == 0) continue;
-        bool passedChecks = true;
-        for (int trig = 0; trig < sendingData[sd].triggers.count(); trig++)
-        {
-            Trigger *thisTrigger = &sendingData[sd].triggers[trig];
-            //need to ensure that this trigger is actually related to frames incoming.
-            //Otherwise ignore it here. Only frames that have BUS and/or ID set as trigger will work here.
-            if (!(thisTrigger->triggerMask & (TriggerMask::TRG_BUS | TriggerMask::TRG_ID) ) ) continue;
-
-            passedChecks = true;
-            //qDebug() << "Trigger ID: " << thisTrigger->ID;
-            //qDebug() << "Frame ID: " << frame->frameId();
+        QMutexLocker lock(&reactionLock);
+        reactions = table;
+    }
 
-            //Check to see if we have a bus trigger condition and if so does it match
-            if (thisTrigger->bus != frame->bus && (thisTrigger->triggerMask & TriggerMask::TRG_BUS) )
-                passedChecks = false;
+    CANConManager *manager = CANConManager::getInstance();
+    manager->removeAllTargettedFrames(this);
+    for (const QPair<int, quint32> &target : qAsConst(exact)) manager->addTargettedFrame(target.first, target.second, 0x1FFFFFFF, this);
+    for (int bus : qAsConst(anyIdBuses)) manager->addTargettedFrame(bus, 0, 0, this);
+}
 
-            //check to see if we have an ID trigger condition and if so does it match
-            if ((thisTrigger->triggerMask & TriggerMask::TRG_ID) && (uint32_t)thisTrigger->ID != frame->frameId() )
-                passedChecks = false;
+void FrameSenderObject::reactToFrame(const CANFrame &frame)
+{
+    QSharedPointer<const ReactionTable> table;
+    {
+        QMutexLocker lock(&reactionLock);
+        table = reactions;
+    }
+    if (!table) return;
 
-            //check to see if we're limiting the trigger by max count and have we reached that count?
-            if ( (thisTrigger->triggerMask & TriggerMask::TRG_COUNT) && (thisTrigger->currCount >= thisTrigger->maxCount) )
-                passedChecks = false;
+    //signal pointers might not be good anymore. Those wait for the rebuild, the rest can still go
+    bool dbcCurrent = (table->dbcRevision == DBCHandler::getRevision());
+    if (!dbcCurrent && reactionRebuildPending.testAndSetRelaxed(0, 1))
+        QMetaObject::invokeMethod(this, "rebuildReactions", Qt::QueuedConnection);
 
-            //if the above passed then are we triggering not only on ID but also signal?
-            if (passedChecks && (thisTrigger->triggerMask & (TriggerMask::TRG_SIGNAL | TriggerMask::TRG_ID) ) )
-            {
-                bool sigCheckPassed = false;
-                DBC_MESSAGE *msg = dbcHandler->findMessage(thisTrigger->ID);
-                if (msg)
-                {
-                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByName(thisTrigger->sigName);
-                    if (sig)
-                    {
-                        //first of all, is this signal really in this message we got?
-                        if (sig->isSignalInMessage(*frame)) sigCheckPassed = true;
-                        //if it was and we're also filtering on value then try that next
-                        if (sigCheckPassed && (thisTrigger->triggerMask & TriggerMask::TRG_SIGVAL))
-                        {
-                            double sigval = 0.0;
-                            if (sig->processAsDouble(*frame, sigval))
-                            {
-                                if (abs(sigval - thisTrigger->sigValueDbl) > 0.001)
-                                {
-                                    sigCheckPassed = false;
-                                }
-                            }
-                            else sigCheckPassed = false;
-                        }
-                    }
-                    else sigCheckPassed = false;
-                }
-                else sigCheckPassed = false;
-                passedChecks &= sigCheckPassed; //passedChecks can only be true if both are
-            }
-
-            //if all the above says it's OK then we'll go ahead and send that message.
-            //If a message that comes through here has a MS value then we use it as a delay
-            //after the check passes. This allows for delaying the sending of the frame if that
-            //is required. Otherwise, just send it immediately.
-            if (passedChecks)
-            {
-                if (thisTrigger->milliseconds == 0) //immediate reply
-                {
-                    thisTrigger->currCount++;
-                    sendingData[sd].count++;
-                    doModifiers(sd);
-                    //updateGridRow(sd);
-                    CANConManager::getInstance()->sendFrame(sendingData[sd]);
-                }
-                else //delayed sending frame
-                {
-                    thisTrigger->readyCount = true;
-                }
-            }
-        }
+    auto it = table->byId.constFind(frame.frameId());
+    if (it != table->byId.constEnd())
+    {
+        for (const Reaction &reaction : it.value()) checkReaction(reaction, frame, dbcCurrent);
     }
+    for (const Reaction &reaction : table->anyId) checkReaction(reaction, frame, dbcCurrent);
 }
 
-
-/// <summary>
-/// given an index into the sendingData list we run the modifiers that it has set up
-/// </summary>
-/// <param name="idx">The index into the sendingData list</param>
-void FrameSenderObject::doModifiers(int idx)
+//connection thread. Only the compiled table and the frame are looked at here
+void FrameSenderObject::checkReaction(const Reaction &reaction, const CANFrame &frame, bool dbcCurrent)
 {
-    int shadowReg = 0; //shadow register we use to accumulate results
-    int first=0, second=0;
-
-    FrameSendData *sendData = &sendingData[idx];
-    Modifier *mod;
-    ModifierOp op;
-
-    if (sendData->modifiers.count() == 0) return; //if no modifiers just leave right now
-
-    //qDebug() << "Executing mods";
-
-    for (int i = 0; i < sendData->modifiers.count(); i++)
+    if (reaction.bus >= 0 && reaction.bus != frame.bus) return;
+    if (reaction.sig)
     {
-        mod = &sendData->modifiers[i];
-        for (int j = 0; j < mod->operations.count(); j++)
+        if (!dbcCurrent || !reaction.sig->isSignalInMessage(frame)) return;
+        if (reaction.matchValue)
         {
-            op = mod->operations.at(j);
-            if (op.first.ID == -1)
-            {
-                first = shadowReg;
-            }
-            else first = fetchOperand(idx, op.first);
-            second = fetchOperand(idx, op.second);
-            switch (op.operation)
-            {
-            case ADDITION:
-                shadowReg = first + second;
-                break;
-            case AND:
-                shadowReg = first & second;
-                break;
-            case DIVISION:
-                shadowReg = first / second;
-                break;
-            case MULTIPLICATION:
-                shadowReg = first * second;
-                break;
-            case OR:
-                shadowReg = first | second;
-                break;
-            case SUBTRACTION:
-                shadowReg = first - second;
-                break;
-            case XOR:
-                shadowReg = first ^ second;
-                break;
-            case MOD:
-                shadowReg = first % second;
-            }
+            double sigval = 0.0;
+            int32_t muxValue;
+            const QByteArray payload = frame.payload();
+            if (!reaction.sig->decodeValue(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length(), sigval, muxValue))
+                return;
+            if (fabs(sigval - reaction.value) > 0.001) return;
         }
-        //Finally, drop the result into the proper data byte
-        QByteArray newArr(sendData->payload());
-        newArr[mod->destByte] = (char) shadowReg;
-        sendData->setPayload(newArr);
     }
+    QMetaObject::invokeMethod(this, "fireReaction", Qt::QueuedConnection, Q_ARG(int, reaction.record),
+                              Q_ARG(int, reaction.trigger), Q_ARG(quint32, reaction.serial), Q_ARG(CANFrame, frame));
 }
 
-int FrameSenderObject::fetchOperand(int idx, ModifierOperand op)
+/*
+ * A frame passed one of the triggers. If the trigger has a MS value it's used as a delay after the check passes,
+ * which allows for delaying the sending of the frame if that is required. Otherwise it's sent immediately.
+ */
+void FrameSenderObject::fireReaction(int record, int trigger, quint32 serial, CANFrame frame)
 {
-    CANFrame *tempFrame = nullptr;
-    if (op.ID == 0) //numeric constant
-    {
-        if (op.notOper) return ~op.databyte;
-        else return op.databyte;
-    }
-    else if (op.ID == -2) //fetch data from a data byte within the output frame
+    if (record >= sendingData.count() || serial != recordSerials[record]) return; //changed since it was compiled
+    FrameSendData &sendData = sendingData[record];
+    if (!sendData.enabled || trigger >= sendData.triggers.count()) return;
+    Trigger *thisTrigger = &sendData.triggers[trigger];
+
+    //check to see if we're limiting the trigger by max count and have we reached that count?
+    if ((thisTrigger->triggerMask & TriggerMask::TRG_COUNT) && (thisTrigger->currCount >= thisTrigger->maxCount)) return;
+
+    if (thisTrigger->milliseconds == 0) //immediate reply
     {
-        if (op.notOper) return ~((unsigned char)sendingData.at(idx).payload()[op.databyte]);
-        else return (unsigned char)sendingData.at(idx).payload()[op.databyte];
+        thisTrigger->currCount++;
+        sendData.count++;
+        sentCounts[record].storeRelaxed(sendData.count);
+        doModifiers(record);
+        CANConManager::getInstance()->sendFrame(sendData);
     }
-    else //look up external data byte
+    else if (!thisTrigger->readyCount) //delayed sending frame
     {
-        tempFrame = lookupFrame(op.ID, op.bus);
-        if (tempFrame != nullptr)
-        {
-            if (op.notOper) return ~((unsigned char)tempFrame->payload()[op.databyte]);
-            else return (unsigned char)tempFrame->payload()[op.databyte];
-        }
-        else return 0;
+        thisTrigger->readyCount = true;
+        if (thisTrigger->milliseconds > 0) scheduleTrigger(record, trigger, nowUs() + static_cast<quint64>(thisTrigger->milliseconds) * 1000);
     }
 }
 
+
 /// <summary>
-/// Try to find the most recent frame given the input criteria
+/// given an index into the sendingData list we run the modifiers that it has set up
 /// </summary>
-/// <param name="ID">The ID to find</param>
-/// <param name="bus">Which bus to look on (-1 if you don't care)</param>
-/// <returns></returns>
-CANFrame* FrameSenderObject::lookupFrame(int ID, int bus)
+/// <param name="idx">The index into the sendingData list</param>
+void FrameSenderObject::doModifiers(int idx)
 {
-    if (!frameCache.contains(ID)) return nullptr;
-
-    if (bus == -1 || frameCache[ID].bus == bus) return &frameCache[ID];
+    FrameSendData &sendData = sendingData[idx];
+    if (sendData.modifiers.count() == 0) return; //if no modifiers just leave right now
 
-    return nullptr;
+    if (!sendData.program || !sendData.program->isCurrent(sendData, lastFrames))
+        sendData.program = ModifierProgram::compile(sendData, lastFrames);
+    sendData.program->run(sendData);
 }
-
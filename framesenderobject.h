@@ -7,17 +7,34 @@
 #include <QThread>
 #include <QDebug>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
 #include "can_structs.h"
+#include "canframestore.h"
 #include "connections/canconmanager.h"
 #include "can_trigger_structs.h"
 #include "dbc/dbchandler.h"
+#include "modifierprogram.h"
 
-class FrameSenderObject : public QObject
+/*
+ * Periodic triggers are kept in a min-heap keyed by when they next fire, so a tick only pops the ones that are due
+ * instead of walking every send record. Heap entries carry the serial their record had when they were pushed. Any
+ * change to a record bumps the serial and pushes fresh entries, so the old ones are just dropped when they come up.
+ * A trigger fires at most once per tick even if it fell behind, same as when the counters were ticked by hand.
+ *
+ * Triggers on incoming frames (bus and/or ID, optionally a signal value) are compiled into a table by ID with their
+ * signals already looked up, and registered as targetted frames. Matching then runs on the connection's own
+ * reading thread as each frame arrives (reactToFrame) instead of waiting for the GUI to see the frame. A match is
+ * handed to this object's thread to do the counting, modifiers and sending, so nothing else ever touches the send
+ * records and no connection thread ends up blocked on another one's send.
+ */
+class FrameSenderObject : public QObject, public CANFrameReactor
 {
     Q_OBJECT
+    Q_INTERFACES(CANFrameReactor)
 
 public:
-    FrameSenderObject(const QVector<CANFrame> *frames);
+    FrameSenderObject(const CANFrameStore *frames);
     ~FrameSenderObject();
 
 public slots:
@@ -39,33 +56,80 @@ public slots:
     void addSendRecord(FrameSendData record);
     void removeSendRecord(int idx);
     FrameSendData *getSendRecordRef(int idx);
+    //call after changing a record through getSendRecordRef so its triggers get scheduled again
+    void sendRecordChanged(int idx);
+
+public:
+    //frames sent by a record so far. Safe from the GUI thread without going through this object's thread
+    int sendCount(int idx) const;
+
+public:
+    //called from connection threads, see above
+    void reactToFrame(const CANFrame &frame) override;
 
 signals:
 
 private slots:
     void timerTriggered();
     void updatedFrames(int);
+    void fireReaction(int record, int trigger, quint32 serial, CANFrame frame);
+    void rebuildReactions();
 
 private:
     QList<CANFrame> sendingList;
     int currentPosition;
     QTimer *sendingTimer;
     QElapsedTimer sendingElapsed;
-    quint64 sendingLastTimeStamp;
     int statusCounter;
     QList<FrameSendData> sendingData;
     QThread*            mThread_p;    
-    QHash<int, CANFrame> frameCache; //hash with frame ID as the key and the most recent frame as the value
-    const QVector<CANFrame> *modelFrames;
+    LastFrameTable lastFrames; //newest frame of every ID the modifiers read from
+    const CANFrameStore *modelFrames;
     bool inhibitChanged = false;
     QMutex mutex;
     DBCHandler *dbcHandler;
 
+    struct TriggerTimer
+    {
+        quint64 due; //us on sendingElapsed
+        int record;
+        int trigger;
+        quint32 serial;
+        bool operator>(const TriggerTimer &other) const { return due > other.due; }
+    };
+    QVector<TriggerTimer> timerHeap;
+    QVector<quint32> recordSerials; //one per sendingData entry
+    QVector<QAtomicInt> sentCounts; //copy of each record's count the GUI can read while this thread sends
+
+    //one incoming frame trigger, everything the connection thread needs to check it without the send record
+    struct Reaction
+    {
+        int record;
+        int trigger;
+        quint32 serial;
+        int bus; //-1 for any
+        const DBC_SIGNAL *sig; //signal that has to be in the frame, if any
+        bool matchValue;
+        double value;
+    };
+    struct ReactionTable
+    {
+        QHash<quint32, QVector<Reaction>> byId;
+        QVector<Reaction> anyId; //bus only triggers
+        quint32 dbcRevision; //signals have to be looked up again once the DBC changes
+        QVector<QSharedPointer<DBCMessageHandler>> dbcMessages; //what the signals live in, held for the table's life
+    };
+    QSharedPointer<const ReactionTable> reactions;
+    QMutex reactionLock; //guards reactions
+    QAtomicInt reactionRebuildPending;
+
+    quint64 nowUs() const;
+    void scheduleTrigger(int record, int trigger, quint64 due);
+    void scheduleRecord(int record);
+    void rebuildSchedule();
+
     void doModifiers(int);
-    int fetchOperand(int, ModifierOperand);
-    CANFrame* lookupFrame(int, int);
-    void buildFrameCache();
-    void processIncomingFrame(CANFrame *frame);
+    void checkReaction(const Reaction &reaction, const CANFrame &frame, bool dbcCurrent);
 
     /**
      * @brief starts the device
@@ -8,6 +8,7 @@
 #include "helpwindow.h"
 #include "connections/canconmanager.h"
 #include "triggerdialog.h"
+#include "pipelinetrace.h"
 
 /*
  * notes: need to ensure that you grab pointers when modifying data structures and dont
@@ -16,7 +17,7 @@
  * Also, rows default to enabled which is odd because the button state does not reflect that.
 */
 
-FrameSenderWindow::FrameSenderWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+FrameSenderWindow::FrameSenderWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::FrameSenderWindow)
 {
@@ -24,6 +25,7 @@ FrameSenderWindow::FrameSenderWindow(const QVector<CANFrame> *frames, QWidget *p
     setWindowFlags(Qt::Window);
 
     modelFrames = frames;
+    lastFrames.setSource(frames);
 
     dbcHandler = DBCHandler::getReference();
 
@@ -31,12 +33,16 @@ FrameSenderWindow::FrameSenderWindow(const QVector<CANFrame> *frames, QWidget *p
     intervalTimer->setTimerType(Qt::PreciseTimer);
     intervalTimer->setInterval(1);
 
+    //counts and modified data only go to the screen this often no matter how fast the rows send
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(100);
+
     setupGrid();
-    createBlankRow();
 
-    connect(ui->tableSender, SIGNAL(cellChanged(int,int)), this, SLOT(onCellChanged(int,int)));
-    connect(ui->tableSender, SIGNAL(cellDoubleClicked(int, int)), SLOT(onCellDoubleTap(int, int)));
+    connect(grid, &SendGridModel::cellEdited, this, &FrameSenderWindow::processCellChange);
+    connect(ui->tableSender, &QAbstractItemView::doubleClicked, this, &FrameSenderWindow::onCellDoubleTap);
     connect(intervalTimer, SIGNAL(timeout()), this, SLOT(handleTick()));
+    connect(refreshTimer, &QTimer::timeout, grid, &SendGridModel::refreshCounts);
     connect(ui->btnClearGrid, SIGNAL(clicked(bool)), this, SLOT(clearGrid()));
     connect(ui->btnDisableAll, SIGNAL(clicked(bool)), this, SLOT(disableAll()));
     connect(ui->btnEnableAll, SIGNAL(clicked(bool)), this, SLOT(enableAll()));
@@ -45,6 +51,7 @@ FrameSenderWindow::FrameSenderWindow(const QVector<CANFrame> *frames, QWidget *p
     connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
 
     intervalTimer->start();
+    refreshTimer->start();
     elapsedTimer.start();
     installEventFilter(this);
 }
@@ -54,7 +61,18 @@ void FrameSenderWindow::setupGrid()
     QStringList headers;
     headers << "En" << "Bus" << "ID" << "MsgName" << "Len" << "Ext" << "Rem" << "Data"
             << "Trigger" << "Modifications" << "Count";
-    ui->tableSender->setColumnCount(11);
+    //msgname is looked up via DBC interface and not able to be edited.
+    //Though, it might be perhaps interesting to allow renaming it to
+    //a shorter name in some cases? Jury is still out on this one...
+    QVector<SendGridModel::ColumnKind> kinds;
+    kinds << SendGridModel::CheckColumn << SendGridModel::TextColumn << SendGridModel::TextColumn
+          << SendGridModel::FixedColumn << SendGridModel::TextColumn << SendGridModel::CheckColumn
+          << SendGridModel::CheckColumn << SendGridModel::TextColumn << SendGridModel::TextColumn
+          << SendGridModel::TextColumn << SendGridModel::CountColumn;
+    grid = new SendGridModel(headers, kinds, this);
+    //sending happens on this thread so the counts can be read straight from the send records
+    grid->setCountSource([this](int row) { return (row < sendingData.count()) ? sendingData[row].count : 0; });
+    ui->tableSender->setModel(grid);
     ui->tableSender->setColumnWidth(ST_COLS::SENDTAB_COL_EN, 50);
     ui->tableSender->setColumnWidth(ST_COLS::SENDTAB_COL_BUS, 50);
     ui->tableSender->setColumnWidth(ST_COLS::SENDTAB_COL_ID, 50);
@@ -66,7 +84,6 @@ void FrameSenderWindow::setupGrid()
     ui->tableSender->setColumnWidth(ST_COLS::SENDTAB_COL_TRIGGER, 270);
     ui->tableSender->setColumnWidth(ST_COLS::SENDTAB_COL_MODS, 270);
     ui->tableSender->setColumnWidth(ST_COLS::SENDTAB_COL_COUNT, 80);
-    ui->tableSender->setHorizontalHeaderLabels(headers);
 }
 
 FrameSenderWindow::~FrameSenderWindow()
@@ -96,87 +113,37 @@ bool FrameSenderWindow::eventFilter(QObject *obj, QEvent *event)
     return false;
 }
 
-void FrameSenderWindow::createBlankRow()
-{
-    int row = ui->tableSender->rowCount();
-    ui->tableSender->insertRow(row);
-
-    QTableWidgetItem *item = new QTableWidgetItem();
-    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-    item->setCheckState(Qt::Unchecked);
-    inhibitChanged = true;
-    ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_EN, item);
-
-    item = new QTableWidgetItem();
-    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-    item->setCheckState(Qt::Unchecked);
-    ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_EXT, item);
-
-    item = new QTableWidgetItem();
-    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-    item->setCheckState(Qt::Unchecked);
-    ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_REM, item);
-
-    for (int i = 1; i <= ST_COLS::SENDTAB_COL_COUNT; i++)
-    {
-        if (i != ST_COLS::SENDTAB_COL_EXT && i != ST_COLS::SENDTAB_COL_REM) {
-            item = new QTableWidgetItem("");
-            //msgname is looked up via DBC interface and not able to be edited.
-            //Though, it might be perhaps interesting to allow renaming it to
-            //a shorter name in some cases? Jury is still out on this one...
-            if (i == ST_COLS::SENDTAB_COL_MSGNAME) item->setFlags(item->flags() & ~Qt::ItemIsEditable);
-            ui->tableSender->setItem(row, i, item);
-         }
-    }
-
-    inhibitChanged = false;
-}
-
-void FrameSenderWindow::buildFrameCache()
+//remember, negative numbers are special -1 = all frames deleted, -2 = totally new set of frames.
+void FrameSenderWindow::reportMemory(QVector<MemoryUsage> &out) const
 {
-    CANFrame thisFrame;
-    frameCache.clear();
-    for (int i = 0; i < modelFrames->count(); i++)
+    qint64 bytes = 0;
+    for (const FrameSendData &data : sendingData)
     {
-        thisFrame = modelFrames->at(i);
-        if (!frameCache.contains(thisFrame.frameId()))
-        {
-            frameCache.insert(thisFrame.frameId(), thisFrame);
-        }
-        else
-        {
-            frameCache[thisFrame.frameId()] = thisFrame;
-        }
+        bytes += static_cast<qint64>(sizeof(FrameSendData)) + MemoryAccounting::bytesOf(data.payload())
+               + MemoryAccounting::bytesOf(data.triggers) + MemoryAccounting::bytesOf(data.modifiers);
     }
+    out.append({memoryOwner("Frame Sender Window"), QString("%1 send rows").arg(sendingData.count()), bytes});
 }
 
-//remember, negative numbers are special -1 = all frames deleted, -2 = totally new set of frames.
 void FrameSenderWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("FrameSenderWindow::updatedFrames");
     CANFrame thisFrame;
     if (numFrames == -1) //all frames deleted.
     {
     }
     else if (numFrames == -2) //all new set of frames.
     {
-        buildFrameCache();
+        lastFrames.reseed();
     }
     else //just got some new frames. See if they are relevant.
     {
         if (numFrames > modelFrames->count()) return;
         qDebug() << "New frames in sender window";
         //run through the supposedly new frames in order
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
         {
             thisFrame = modelFrames->at(i);
-            if (!frameCache.contains(thisFrame.frameId()))
-            {
-                frameCache.insert(thisFrame.frameId(), thisFrame);
-            }
-            else
-            {
-                frameCache[thisFrame.frameId()] = thisFrame;
-            }
             processIncomingFrame(&thisFrame);
         }
     }
@@ -268,31 +235,26 @@ void FrameSenderWindow::processIncomingFrame(CANFrame *frame)
 
 void FrameSenderWindow::enableAll()
 {
-    for (int i = 0; i < ui->tableSender->rowCount() - 1; i++)
+    for (int i = 0; i < grid->recordCount(); i++)
     {
-        ui->tableSender->item(i, ST_COLS::SENDTAB_COL_EN)->setCheckState(Qt::Checked);
+        grid->setChecked(i, ST_COLS::SENDTAB_COL_EN, true);
         sendingData[i].enabled = true;
     }
 }
 
 void FrameSenderWindow::disableAll()
 {
-    for (int i = 0; i < ui->tableSender->rowCount() - 1; i++)
+    for (int i = 0; i < grid->recordCount(); i++)
     {
-        ui->tableSender->item(i, ST_COLS::SENDTAB_COL_EN)->setCheckState(Qt::Unchecked);
+        grid->setChecked(i, ST_COLS::SENDTAB_COL_EN, false);
         sendingData[i].enabled = false;
     }
 }
 
 void FrameSenderWindow::clearGrid()
 {
-    if (ui->tableSender->rowCount() == 1) return;
-    for (int i = ui->tableSender->rowCount() - 2; i >= 0; i--)
-    {
-        sendingData[i].enabled = false;
-        sendingData.removeAt(i);
-        ui->tableSender->removeRow(i);
-    }
+    sendingData.clear();
+    grid->clearRecords();
 }
 
 void FrameSenderWindow::saveGrid()
@@ -347,10 +309,6 @@ void FrameSenderWindow::loadGrid()
             settings.setValue("FrameSender/LoadSaveDirectory", dialog.directory().path());
         }
     }
-
-    createBlankRow();
-
-    setupGrid();
 }
 
 void FrameSenderWindow::saveSenderFile(QString filename)
@@ -367,7 +325,7 @@ void FrameSenderWindow::saveSenderFile(QString filename)
     for (int c = 0; c < sendingData.count(); c++)
     {
         outString.clear();
-        if (ui->tableSender->item(c, ST_COLS::SENDTAB_COL_EN)->checkState() == Qt::Checked)
+        if (grid->isChecked(c, ST_COLS::SENDTAB_COL_EN))
         {
             outString = "T#";
         }
@@ -375,13 +333,13 @@ void FrameSenderWindow::saveSenderFile(QString filename)
         for (int i = 1; i < ST_COLS::SENDTAB_COL_COUNT; i++)
         {
             if (i == ST_COLS::SENDTAB_COL_EXT || i == ST_COLS::SENDTAB_COL_REM) {
-                if (ui->tableSender->item(c, i)->checkState() == Qt::Checked) {
+                if (grid->isChecked(c, i)) {
                     outString.append("T");
                 } else {
                     outString.append("F");
                 }
             } else {
-                outString.append(ui->tableSender->item(c, i)->text());
+                outString.append(grid->text(c, i));
             }
             outString.append("#");
         }
@@ -404,57 +362,33 @@ void FrameSenderWindow::loadSenderFile(QString filename)
         return;
     }
 
-    ui->tableSender->clear();
-    while (ui->tableSender->rowCount() > 0) ui->tableSender->removeRow(0);
+    grid->clearRecords();
     sendingData.clear();
 
     while (!inFile->atEnd()) {
-        inhibitChanged = true;
         line = inFile->readLine().simplified();
         if (line.length() > 2)
         {
             QList<QByteArray> tokens = line.split('#');
-            int row = ui->tableSender->rowCount();
-            ui->tableSender->insertRow(row);
-            QTableWidgetItem *item = new QTableWidgetItem();
-            ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_EN, item);
-            ui->tableSender->item(row, ST_COLS::SENDTAB_COL_EN)->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-
-            item = new QTableWidgetItem();
-            ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_EXT, item);
-            ui->tableSender->item(row, ST_COLS::SENDTAB_COL_EN)->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-            item->setCheckState(Qt::Unchecked);
-
-            item = new QTableWidgetItem();
-            ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_REM, item);
-            ui->tableSender->item(row, ST_COLS::SENDTAB_COL_REM)->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-            item->setCheckState(Qt::Unchecked);
-
-            if (tokens[0] == "T")
-            {
-                ui->tableSender->item(row, ST_COLS::SENDTAB_COL_EN)->setCheckState(Qt::Checked);
-            }
-            else ui->tableSender->item(row, ST_COLS::SENDTAB_COL_EN)->setCheckState(Qt::Unchecked);
+            int row = grid->recordCount();
+            grid->setChecked(row, ST_COLS::SENDTAB_COL_EN, tokens[0] == "T");
             if (tokens.length() >= 9) {
                 for (int i = 1; i < ST_COLS::SENDTAB_COL_COUNT; i++)
                 {
                     if (i != ST_COLS::SENDTAB_COL_EXT && i != ST_COLS::SENDTAB_COL_REM) {
-                        ui->tableSender->setItem(row, i, new QTableWidgetItem(QString(tokens[i])));
+                        grid->setText(row, i, QString(tokens[i]));
                     } else {
-                        if (tokens[i] == "T") {
-                            ui->tableSender->item(row, i)->setCheckState(Qt::Checked);
-                        }
+                        grid->setChecked(row, i, tokens[i] == "T");
                     }
                 }
             } else {
-                ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_BUS, new QTableWidgetItem(QString(tokens[1])));
-                ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_ID, new QTableWidgetItem(QString(tokens[2])));
-                ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_LEN, new QTableWidgetItem(QString(tokens[3])));
-                ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_DATA, new QTableWidgetItem(QString(tokens[4])));
-                ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_TRIGGER, new QTableWidgetItem(QString(tokens[5])));
-                ui->tableSender->setItem(row, ST_COLS::SENDTAB_COL_MODS, new QTableWidgetItem(QString(tokens[6])));
+                grid->setText(row, ST_COLS::SENDTAB_COL_BUS, QString(tokens[1]));
+                grid->setText(row, ST_COLS::SENDTAB_COL_ID, QString(tokens[2]));
+                grid->setText(row, ST_COLS::SENDTAB_COL_LEN, QString(tokens[3]));
+                grid->setText(row, ST_COLS::SENDTAB_COL_DATA, QString(tokens[4]));
+                grid->setText(row, ST_COLS::SENDTAB_COL_TRIGGER, QString(tokens[5]));
+                grid->setText(row, ST_COLS::SENDTAB_COL_MODS, QString(tokens[6]));
             }
-            inhibitChanged = false;
             for (int k = 0; k < ST_COLS::SENDTAB_COL_COUNT; k++) processCellChange(row, k);
 
         }
@@ -463,14 +397,12 @@ void FrameSenderWindow::loadSenderFile(QString filename)
     delete inFile;
 }
 
-void FrameSenderWindow::onCellDoubleTap(int row, int column)
+void FrameSenderWindow::onCellDoubleTap(const QModelIndex &index)
 {
-    if (column == ST_COLS::SENDTAB_COL_TRIGGER)
+    int row = index.row();
+    if (index.column() == ST_COLS::SENDTAB_COL_TRIGGER)
     {
-        if (row == ui->tableSender->rowCount() - 1)
-        {
-            createBlankRow();
-        }
+        grid->ensureRecord(row);
         if (row >= sendingData.count())
         {
             FrameSendData tempData;
@@ -493,27 +425,13 @@ void FrameSenderWindow::onCellDoubleTap(int row, int column)
                 output += td->buildEntry(trig) + ",";
             }
             output.chop(1); //don't want the trailing ,
-            inhibitChanged = true;
-            ui->tableSender->item(row, ST_COLS::SENDTAB_COL_TRIGGER)->setText(output);
-            inhibitChanged = false;
+            grid->setText(row, ST_COLS::SENDTAB_COL_TRIGGER, output);
         }
         delete td;
         td = nullptr;
     }
 }
 
-void FrameSenderWindow::onCellChanged(int row, int col)
-{
-    if (inhibitChanged) return;
-    qDebug() << "onCellChanged";
-    if (row == ui->tableSender->rowCount() - 1)
-    {
-        createBlankRow();
-    }
-
-    processCellChange(row, col);
-}
-
 /// <summary>
 /// Called every millisecond to set the system update figures and send frames if necessary.
 /// </summary>
@@ -579,101 +497,12 @@ void FrameSenderWindow::handleTick()
 /// <param name="idx">The index into the sendingData list</param>
 void FrameSenderWindow::doModifiers(int idx)
 {
-    int shadowReg = 0; //shadow register we use to accumulate results
-    int first=0, second=0;
-
-    FrameSendData *sendData = &sendingData[idx];
-    Modifier *mod;
-    ModifierOp op;
-
-    if (sendData->modifiers.count() == 0) return; //if no modifiers just leave right now
-
-    //qDebug() << "Executing mods";
-
-    for (int i = 0; i < sendData->modifiers.count(); i++)
-    {
-        mod = &sendData->modifiers[i];
-        for (int j = 0; j < mod->operations.count(); j++)
-        {
-            op = mod->operations.at(j);
-            if (op.first.ID == -1)
-            {
-                first = shadowReg;
-            }
-            else first = fetchOperand(idx, op.first);
-            second = fetchOperand(idx, op.second);
-            switch (op.operation)
-            {
-            case ADDITION:
-                shadowReg = first + second;
-                break;
-            case AND:
-                shadowReg = first & second;
-                break;
-            case DIVISION:
-                shadowReg = first / second;
-                break;
-            case MULTIPLICATION:
-                shadowReg = first * second;
-                break;
-            case OR:
-                shadowReg = first | second;
-                break;
-            case SUBTRACTION:
-                shadowReg = first - second;
-                break;
-            case XOR:
-                shadowReg = first ^ second;
-                break;
-            case MOD:
-                shadowReg = first % second;
-            }
-        }
-        //Finally, drop the result into the proper data byte
-        QByteArray newArr(sendData->payload());
-        newArr[mod->destByte] = (char) shadowReg;
-        sendData->setPayload(newArr);
-    }
-}
-
-int FrameSenderWindow::fetchOperand(int idx, ModifierOperand op)
-{
-    CANFrame *tempFrame = nullptr;
-    if (op.ID == 0) //numeric constant
-    {
-        if (op.notOper) return ~op.databyte;
-        else return op.databyte;
-    }
-    else if (op.ID == -2) //fetch data from a data byte within the output frame
-    {
-        if (op.notOper) return ~((unsigned char)sendingData.at(idx).payload()[op.databyte]);
-        else return (unsigned char)sendingData.at(idx).payload()[op.databyte];
-    }
-    else //look up external data byte
-    {
-        tempFrame = lookupFrame(op.ID, op.bus);
-        if (tempFrame != nullptr)
-        {
-            if (op.notOper) return ~((unsigned char)tempFrame->payload()[op.databyte]);
-            else return (unsigned char)tempFrame->payload()[op.databyte];
-        }
-        else return 0;
-    }
-}
-
-/// <summary>
-/// Try to find the most recent frame given the input criteria
-/// </summary>
-/// <param name="ID">The ID to find</param>
-/// <param name="bus">Which bus to look on (-1 if you don't care)</param>
-/// <returns></returns>
-CANFrame* FrameSenderWindow::lookupFrame(int ID, int bus)
-{
-    if (!frameCache.contains(ID)) return nullptr;
+    FrameSendData &sendData = sendingData[idx];
+    if (sendData.modifiers.count() == 0) return; //if no modifiers just leave right now
 
-    if (bus == -1 || frameCache[ID].bus == bus) return &frameCache[ID];
-
-    return nullptr;
+    if (!sendData.program || !sendData.program->isCurrent(sendData, lastFrames))
+        sendData.program = ModifierProgram::compile(sendData, lastFrames);
+    sendData.program->run(sendData);
 }
 
 /// <summary>
@@ -684,116 +513,9 @@ CANFrame* FrameSenderWindow::lookupFrame(int ID, int bus)
 void FrameSenderWindow::processModifierText(int line)
 {
     qDebug() << "processModifierText";
-    QString modString;
-    //bool firstOp = true;
-    bool abort = false;
-    QString token;
-    ModifierOp thisOp;
-
-    //Example line:
-    //d0 = D0 + 1,d1 = id:0x200:d3 + id:0x200:d4 AND 0xF0 - Original version
-    //D0=D0+1,D1=ID:0x200:D3+ID:0x200:D4&0xF0
-
-    //[BMS_TargetVoltage]=45 would set the value of signal BMS_TargetVoltage to 45
-
-    //[BMS_TargetVoltage]=[0x234:BMS_CurrentVoltage] + 4 would instead grab the value
-    //of BMS_CurrentVoltage from ID 0x234, add 4 to it, and set BMS_TargetVoltage to that value.
-
-    //This is certainly much harder to parse than the trigger definitions.
-    //the left side of the = has to be D0 to D7. After that there is a string of
-    //data. Spaces used to be required but no longer are. This makes parsing harder but data entry easier
-
-    //yeah, lots of operations on this one line but it's for a good cause. Removes the convenience English versions of the
-    //logical operators and replaces them with the math equivs. Also uppercases and removes all superfluous whitespace
-    modString = ui->tableSender->item(line, 8)->text().toUpper().trimmed().replace("AND", "&").replace("XOR", "^").replace("OR", "|").replace(" ", "");
-    if (modString != "")
-    {
-        QStringList mods = modString.split(',');
-        sendingData[line].modifiers.clear();
-        sendingData[line].modifiers.reserve(mods.length());
-        for (int i = 0; i < mods.length(); i++)
-        {
-            Modifier thisMod;
-            thisMod.destByte = 0;
-
-            QRegularExpression regex;
-            QRegularExpressionMatch match;
-
-            regex.setPattern("^\\[(\\w+)]=(\\w+)");
-            match = regex.match(mods[i]);
-            if (match.hasMatch())
-            {
-                thisMod.destByte = -1;
-                thisMod.signalName = match.captured(1);
-                mods[i] = match.captured(2);
-                thisMod.operations.clear();
-            }
-            else
-            {
-                QString leftSide = Utility::grabAlphaNumeric(mods[i]);
-                if (leftSide.startsWith("D") && leftSide.length() == 2)
-                {
-                    thisMod.destByte = leftSide.right(1).toInt();
-                    thisMod.operations.clear();
-                    if (!(Utility::grabOperation(mods[i]) == "="))
-                    {
-                        qDebug() << "Err: No = after lefthand val";
-                        continue;
-                    }
-                }
-            }
-
-            abort = false;
-
-            token = Utility::grabAlphaNumeric(mods[i]);
-            if (token[0] == '~')
-            {
-                thisOp.first.notOper = true;
-                token = token.remove(0, 1); //remove the ~ character
-            }
-            else thisOp.first.notOper = false;
-            parseOperandString(token.split(":"), thisOp.first);
-
-            if (mods[i].length() < 2) {
-                abort = true;
-                thisOp.operation = ADDITION;
-                thisOp.second.ID = 0;
-                thisOp.second.databyte = 0;
-                thisOp.second.notOper = false;
-                thisMod.operations.append(thisOp);
-            }
-
-            while (!abort)
-            {
-                QString operation = Utility::grabOperation(mods[i]);
-                if (operation == "")
-                {
-                    abort = true;
-                }
-                else
-                {
-                    thisOp.operation = parseOperation(operation);
-                    QString secondOp = Utility::grabAlphaNumeric(mods[i]);
-                    if (secondOp.length() > 0 && secondOp[0] == '~')
-                    {
-                        thisOp.second.notOper = true;
-                        secondOp = secondOp.remove(0, 1); //remove the ~ character
-                    }
-                    else thisOp.second.notOper = false;
-                    thisOp.second.bus = sendingData[line].bus;
-                    thisOp.second.ID = sendingData[line].frameId();
-                    parseOperandString(secondOp.split(":"), thisOp.second);
-                    thisMod.operations.append(thisOp);
-                }
-
-                thisOp.first.ID = -1; //shadow register
-                if (mods[i].length() < 2) abort = true;
-            }
-
-            sendingData[line].modifiers.append(thisMod);
-        }
-    }
-    //there is no else for the modifiers. We'll accept there not being any
+    FrameSendData &sendData = sendingData[line];
+    sendData.modifiers = ModifierProgram::parse(grid->text(line, ST_COLS::SENDTAB_COL_MODS));
+    sendData.program.reset();
 }
 
 void FrameSenderWindow::processTriggerText(int line)
@@ -805,7 +527,7 @@ void FrameSenderWindow::processTriggerText(int line)
     //id0x200 5ms 10x bus0,1000ms,ID0x202 SIG[BMS_maxChargeCurrent;300]
     //trigger has two levels of syntactic parsing. First you split by comma to get each
     //actual trigger. Then you split by spaces to get the tokens within each trigger
-    trigger = ui->tableSender->item(line, ST_COLS::SENDTAB_COL_TRIGGER)->text().toUpper();
+    trigger = grid->text(line, ST_COLS::SENDTAB_COL_TRIGGER).toUpper();
     if (trigger != "")
     {
         QStringList triggers = trigger.split(',');
@@ -899,79 +621,20 @@ void FrameSenderWindow::processTriggerText(int line)
     }
 }
 
-//Turn a set of tokens into an operand
-void FrameSenderWindow::parseOperandString(QStringList tokens, ModifierOperand &operand)
-{
-    qDebug() << "parseOperandString";
-    //example string -> bus:0:id:200:d3
-
-    operand.bus = -1;
-    operand.ID = -2;
-    operand.databyte = 0;
-
-    for (int i = 0; i < tokens.length(); i++)
-    {
-        if (tokens[i] == "BUS")
-        {
-            operand.bus = Utility::ParseStringToNum(tokens[++i]);
-        }
-        else if (tokens[i] == "ID")
-        {
-            operand.ID = Utility::ParseStringToNum(tokens[++i]);
-        }
-        else if (tokens[i].length() == 2 && tokens[i].startsWith("D"))
-        {
-            operand.databyte = Utility::ParseStringToNum(tokens[i].right(tokens[i].length() - 1));
-        }
-        else
-        {
-            operand.databyte = Utility::ParseStringToNum(tokens[i]);
-            operand.ID = 0; //special ID to show this is a number not a look up.
-        }
-    }
-}
-
-ModifierOperationType FrameSenderWindow::parseOperation(QString op)
-{
-    qDebug() << "parseOperation";
-    if (op == "+") return ADDITION;
-    if (op == "-") return SUBTRACTION;
-    if (op == "*") return MULTIPLICATION;
-    if (op == "/") return DIVISION;
-    if (op == "&") return AND;
-    if (op == "|") return OR;
-    if (op == "^") return XOR;
-    if (op == "%") return MOD;
-    return ADDITION;
-}
-
 /// <summary>
-/// Update the DataGridView with the newest info from sendingData
+/// Update the grid with the newest data from sendingData. The count comes along on its own, both show up at
+/// the next refresh
 /// </summary>
 /// <param name="idx"></param>
 void FrameSenderWindow::updateGridRow(int idx)
 {
     //qDebug() << "updateGridRow";
 
-    inhibitChanged = true;
     FrameSendData *temp = &sendingData[idx];
-    int gridLine = idx;
     QString dataString;
-    QTableWidgetItem *item = ui->tableSender->item(gridLine, ST_COLS::SENDTAB_COL_COUNT);
     const unsigned char *data = reinterpret_cast<const unsigned char *>(temp->payload().constData());
     int dataLen = temp->payload().length();
 
-    if (item == nullptr)
-    {
-        item = new QTableWidgetItem();
-        item->setText(QString::number(temp->count));
-        ui->tableSender->setItem(gridLine, ST_COLS::SENDTAB_COL_COUNT, item);
-    }
-    else
-    {
-        item->setText(QString::number(temp->count));
-    }
-
     if (temp->frameType() != QCanBusFrame::RemoteRequestFrame)
     {
         for (int i = 0; i < dataLen; i++)
@@ -979,13 +642,8 @@ void FrameSenderWindow::updateGridRow(int idx)
             dataString.append(Utility::formatNumber(data[i]));
             dataString.append(" ");
         }
-        ui->tableSender->item(gridLine, ST_COLS::SENDTAB_COL_DATA)->setText(dataString);
-    }
-    else
-    {
-        ui->tableSender->item(gridLine, ST_COLS::SENDTAB_COL_DATA)->setText("");
     }
-    inhibitChanged = false;
+    grid->updateText(idx, ST_COLS::SENDTAB_COL_DATA, dataString);
 }
 
 void FrameSenderWindow::processCellChange(int line, int col)
@@ -1014,7 +672,7 @@ void FrameSenderWindow::processCellChange(int line, int col)
     switch (col)
     {
         case ST_COLS::SENDTAB_COL_EN: //Enable check box
-            if (ui->tableSender->item(line, 0)->checkState() == Qt::Checked)
+            if (grid->isChecked(line, ST_COLS::SENDTAB_COL_EN))
             {
                 sendingData[line].enabled = true;
             }
@@ -1022,49 +680,45 @@ void FrameSenderWindow::processCellChange(int line, int col)
             qDebug() << "Setting enabled to " << sendingData[line].enabled;
             break;
         case ST_COLS::SENDTAB_COL_BUS: //Bus designation
-            tempVal = Utility::ParseStringToNum(ui->tableSender->item(line, ST_COLS::SENDTAB_COL_BUS)->text());
+            tempVal = Utility::ParseStringToNum(grid->text(line, ST_COLS::SENDTAB_COL_BUS));
             if (tempVal < -1) tempVal = -1;
             if (tempVal >= numBuses) tempVal = numBuses - 1;
             sendingData[line].bus = tempVal;
             qDebug() << "Setting bus to " << tempVal;
             break;
         case ST_COLS::SENDTAB_COL_ID: //ID field
-            tempVal = Utility::ParseStringToNum(ui->tableSender->item(line, ST_COLS::SENDTAB_COL_ID)->text());
+            tempVal = Utility::ParseStringToNum(grid->text(line, ST_COLS::SENDTAB_COL_ID));
             if (tempVal < 0) tempVal = 0;
             if (tempVal > 0x7FFFFFFF) tempVal = 0x7FFFFFFF;
             sendingData[line].setFrameId(tempVal);
             if (sendingData[line].frameId() > 0x7FF) {
                 sendingData[line].setExtendedFrameFormat(true);
-                ui->tableSender->blockSignals(true);
-                ui->tableSender->item(line, ST_COLS::SENDTAB_COL_EXT)->setCheckState(Qt::Checked);
-                ui->tableSender->blockSignals(false);
+                grid->setChecked(line, ST_COLS::SENDTAB_COL_EXT, true);
             }
             msg = dbcHandler->findMessage(sendingData[line].frameId());
             if (msg)
             {
-                ui->tableSender->blockSignals(true);
-                ui->tableSender->item(line, ST_COLS::SENDTAB_COL_MSGNAME)->setText(msg->name);
-                ui->tableSender->item(line, ST_COLS::SENDTAB_COL_LEN)->setText(QString::number(msg->len));
-                ui->tableSender->blockSignals(false);
+                grid->setText(line, ST_COLS::SENDTAB_COL_MSGNAME, msg->name);
+                grid->setText(line, ST_COLS::SENDTAB_COL_LEN, QString::number(msg->len));
             }
             qDebug() << "setting ID to " << tempVal;
             break;
         case ST_COLS::SENDTAB_COL_LEN:
-            tempVal = Utility::ParseStringToNum(ui->tableSender->item(line, 3)->text());
+            tempVal = Utility::ParseStringToNum(grid->text(line, ST_COLS::SENDTAB_COL_LEN));
             if (tempVal < 0) tempVal = 0;
             if (tempVal > 8) tempVal = 8;            
             arr.resize(tempVal);
             sendingData[line].setPayload(arr);
             break;
         case ST_COLS::SENDTAB_COL_EXT:
-            if (ui->tableSender->item(line, 4)->checkState() == Qt::Checked) {
+            if (grid->isChecked(line, ST_COLS::SENDTAB_COL_EXT)) {
                 sendingData[line].setExtendedFrameFormat(true);
             } else {
                 sendingData[line].setExtendedFrameFormat(false);
             }
             break;
         case ST_COLS::SENDTAB_COL_REM:
-            if (ui->tableSender->item(line, 5)->checkState() == Qt::Checked) {
+            if (grid->isChecked(line, ST_COLS::SENDTAB_COL_REM)) {
                 sendingData[line].setFrameType(QCanBusFrame::RemoteRequestFrame);
             } else {
                 sendingData[line].setFrameType(QCanBusFrame::DataFrame);
@@ -1072,9 +726,9 @@ void FrameSenderWindow::processCellChange(int line, int col)
             break;
         case ST_COLS::SENDTAB_COL_DATA: //Data bytes
 #if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
-            tokens = ui->tableSender->item(line, ST_COLS::SENDTAB_COL_DATA)->text().split(" ", Qt::SkipEmptyParts);
+            tokens = grid->text(line, ST_COLS::SENDTAB_COL_DATA).split(" ", Qt::SkipEmptyParts);
 #else
-            tokens = ui->tableSender->item(line, ST_COLS::SENDTAB_COL_DATA)->text().split(" ", QString::SkipEmptyParts);
+            tokens = grid->text(line, ST_COLS::SENDTAB_COL_DATA).split(" ", QString::SkipEmptyParts);
 #endif
             arr.clear();
             arr.reserve(tokens.count());
@@ -7,9 +7,13 @@
 #include <QTime>
 #include <QMutex>
 #include "can_structs.h"
+#include "canframestore.h"
 #include "can_trigger_structs.h"
 #include "dbc/dbchandler.h"
+#include "modifierprogram.h"
 #include "triggerdialog.h"
+#include "memoryaccounting.h"
+#include "sendgridmodel.h"
 
 namespace Ui {
 class FrameSenderWindow;
@@ -30,17 +34,17 @@ enum ST_COLS
     SENDTAB_COL_COUNT = 10,
 };
 
-class FrameSenderWindow : public QDialog
+class FrameSenderWindow : public QDialog, public MemoryReporter
 {
     Q_OBJECT
 
 public:
-    explicit FrameSenderWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit FrameSenderWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~FrameSenderWindow();
+    void reportMemory(QVector<MemoryUsage> &out) const override;
 
 private slots:
-    void onCellChanged(int, int);
-    void onCellDoubleTap(int, int);
+    void onCellDoubleTap(const QModelIndex &index);
     void handleTick();
     void enableAll();
     void disableAll();
@@ -51,30 +55,25 @@ private slots:
 
 private:
     Ui::FrameSenderWindow *ui;
+    SendGridModel *grid;
     QList<FrameSendData> sendingData;
-    QHash<int, CANFrame> frameCache; //hash with frame ID as the key and the most recent frame as the value
-    const QVector<CANFrame> *modelFrames;
+    LastFrameTable lastFrames; //newest frame of every ID the modifiers read from
+    const CANFrameStore *modelFrames;
     QTimer *intervalTimer;
+    QTimer *refreshTimer; //puts counts and modified data on the grid
     QElapsedTimer elapsedTimer;
-    bool inhibitChanged = false;
     QMutex mutex;
     DBCHandler *dbcHandler;
     TriggerDialog *td;
     FrameSendData *sendData;
 
-    void createBlankRow();
     void doModifiers(int);
-    int fetchOperand(int, ModifierOperand);
-    CANFrame* lookupFrame(int, int);
     void processModifierText(int);
     void processTriggerText(int);
-    void parseOperandString(QStringList tokens, ModifierOperand&);
-    ModifierOperationType parseOperation(QString);
     void saveSenderFile(QString filename);
     void loadSenderFile(QString filename);
     void updateGridRow(int idx);
     void processCellChange(int line, int col);
-    void buildFrameCache();
     void processIncomingFrame(CANFrame *frame);
     bool eventFilter(QObject *obj, QEvent *event);
     void setupGrid();
@@ -0,0 +1,58 @@
+#include "framestorefollower.h"
+#include "mainwindow.h"
+#include "pipelinetrace.h"
+
+FrameStoreFollower::FrameStoreFollower(const CANFrameStore *frames) : frames(frames)
+{
+    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+}
+
+void FrameStoreFollower::rebuild()
+{
+    TRACE_SCOPE(metaObject()->className());
+    clearState();
+    addAll();
+    syncedTo = frames->baseSequence() + static_cast<quint64>(frames->count());
+    emit updated();
+}
+
+void FrameStoreFollower::addAll()
+{
+    for (int i = 0; i < frames->count(); i++) add(i);
+}
+
+void FrameStoreFollower::sync()
+{
+    if (isStale())
+    {
+        rebuild();
+        return;
+    }
+
+    quint64 end = frames->baseSequence() + static_cast<quint64>(frames->count());
+    if (end == syncedTo) return;
+    if (end < syncedTo) //fewer frames than ever were appended, it was cleared without a framesUpdated
+    {
+        rebuild();
+        return;
+    }
+
+    //-1 when the store has already evicted frames we never saw, all that's left is new then
+    int first = frames->indexOfSequence(syncedTo);
+    if (first < 0) first = 0;
+    for (int i = first; i < frames->count(); i++) add(i);
+    syncedTo = end;
+    caughtUp();
+    emit updated();
+}
+
+void FrameStoreFollower::updatedFrames(int numFrames)
+{
+    TRACE_SCOPE(metaObject()->className());
+    if (numFrames < 0) //cleared or a whole new set of frames
+    {
+        rebuild();
+        return;
+    }
+    sync();
+}
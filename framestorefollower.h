@@ -0,0 +1,64 @@
+#ifndef FRAMESTOREFOLLOWER_H
+#define FRAMESTOREFOLLOWER_H
+
+#include <QHash>
+#include <QObject>
+#include "canframestore.h"
+
+/*
+ * One T per frame store, made by make the first time something asks for it. They live as long as the program does.
+ * make is there so a class can keep its constructor private and still use this from its own forFrames.
+ */
+template<class T> T *perFrameStore(const CANFrameStore *frames, T *(*make)(const CANFrameStore *))
+{
+    static QHash<const CANFrameStore *, T *> stores;
+    T *&store = stores[frames];
+    if (!store) store = make(frames);
+    return store;
+}
+
+/*
+ * The part every running summary of a frame store has in common (signal series, periodicity, error and latency
+ * stats, node load, the traffic overview). It follows framesUpdated and hands each appended frame to add() once,
+ * in arrival order. On a reset (-1 / -2), when the store turns out to have gone backwards without saying, or when
+ * isStale() asks for it, it starts over with clearState() and addAll(). Frames the store evicts stay counted unless
+ * the subclass drops them itself in caughtUp().
+ *
+ * Made before a window's own framesUpdated connect (forFrames in the window's constructor) a follower has the new
+ * frames by the time the window hears about them. Anything can also call sync() to catch up right away.
+ *
+ * The subclass calls rebuild() at the end of its constructor, its overrides aren't there yet in this one.
+ *
+ * GUI thread only.
+ */
+class FrameStoreFollower : public QObject
+{
+    Q_OBJECT
+
+public:
+    void sync(); //catch up with anything appended to the frame store. Nothing to do if it's already current
+    quint64 nextSequence() const { return syncedTo; } //sequence number of the first frame not taken in yet
+
+signals:
+    void updated(); //after a sync that took in new frames, or a rebuild
+
+protected:
+    explicit FrameStoreFollower(const CANFrameStore *frames);
+    void rebuild();
+
+    virtual void clearState() = 0;
+    virtual void add(int row) = 0;
+    virtual void addAll(); //the whole store after a clearState, every row through add unless there's a better way
+    virtual bool isStale() const { return false; } //start over at the next sync even if no frames came in
+    virtual void caughtUp() {} //after a sync took in appended frames
+
+    const CANFrameStore *frames;
+
+private slots:
+    void updatedFrames(int numFrames);
+
+private:
+    quint64 syncedTo = 0;
+};
+
+#endif // FRAMESTOREFOLLOWER_H
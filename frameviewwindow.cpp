@@ -0,0 +1,156 @@
+#include "frameviewwindow.h"
+#include "ui_frameviewwindow.h"
+#include "helpwindow.h"
+#include "utility.h"
+
+#include <QFontDatabase>
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QSettings>
+
+FrameViewWindow::FrameViewWindow(CANFrameModel *list, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::FrameViewWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+
+    view = new CANFrameView(list, this);
+    ui->tableFrames->setModel(view);
+
+    //same font and columns as the main list
+    QSettings settings;
+    QFont font;
+    if (settings.value("Main/FontFixedWidth", false).toBool()) font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPointSize(settings.value("Main/FontSize", 9).toUInt());
+    ui->tableFrames->setFont(font);
+    QHeaderView *vertHdr = ui->tableFrames->verticalHeader();
+    vertHdr->setSectionResizeMode(QHeaderView::Fixed);
+    vertHdr->setDefaultSectionSize(QFontMetrics(font).height() + 4);
+    vertHdr->setFont(QFont());
+    QHeaderView *horzHdr = ui->tableFrames->horizontalHeader();
+    horzHdr->setFont(QFont());
+    horzHdr->setStretchLastSection(true);
+    for (int col = static_cast<int>(Column::Priority); col <= static_cast<int>(Column::GMLanSender); col++)
+        horzHdr->moveSection(horzHdr->visualIndex(col), horzHdr->visualIndex(static_cast<int>(Column::ASCII)));
+    bool j1939 = settings.value("Main/J1939Columns", false).toBool();
+    bool gmlan = settings.value("Main/GMLanColumns", false).toBool();
+    ui->tableFrames->setColumnHidden(static_cast<int>(Column::Priority), !j1939 && !gmlan);
+    ui->tableFrames->setColumnHidden(static_cast<int>(Column::PGN), !j1939);
+    ui->tableFrames->setColumnHidden(static_cast<int>(Column::Source), !j1939);
+    ui->tableFrames->setColumnHidden(static_cast<int>(Column::Dest), !j1939);
+    ui->tableFrames->setColumnHidden(static_cast<int>(Column::GMLanArb), !gmlan);
+    ui->tableFrames->setColumnHidden(static_cast<int>(Column::GMLanSender), !gmlan);
+    ui->tableFrames->setColumnWidth(static_cast<int>(Column::TimeStamp), 150);
+    ui->tableFrames->setColumnWidth(static_cast<int>(Column::FrameId), 70);
+    for (int col = static_cast<int>(Column::Extended); col <= static_cast<int>(Column::Length); col++)
+        ui->tableFrames->setColumnWidth(col, 40);
+
+    connect(ui->spinBus, QOverload<int>::of(&QSpinBox::valueChanged), this, &FrameViewWindow::busChanged);
+    connect(ui->btnApplyFilter, &QPushButton::clicked, this, &FrameViewWindow::applyFilter);
+    connect(ui->lineFilter, &QLineEdit::returnPressed, this, &FrameViewWindow::applyFilter);
+    connect(ui->cbOverwrite, &QCheckBox::toggled, this, &FrameViewWindow::overwriteToggled);
+    connect(ui->cbChangesOnly, &QCheckBox::toggled, this, &FrameViewWindow::changesOnlyToggled);
+    connect(ui->lineName, &QLineEdit::textChanged, this, &FrameViewWindow::nameChanged);
+    connect(horzHdr, &QHeaderView::sectionClicked, this, &FrameViewWindow::headerClicked);
+    connect(view, &QAbstractItemModel::rowsInserted, this, &FrameViewWindow::rowsChanged);
+    connect(view, &QAbstractItemModel::modelReset, this, &FrameViewWindow::rowsChanged);
+    rowsChanged();
+}
+
+FrameViewWindow::~FrameViewWindow()
+{
+    delete ui;
+}
+
+void FrameViewWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+    readSettings();
+    installEventFilter(this);
+}
+
+void FrameViewWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool FrameViewWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("frameview.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void FrameViewWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("FrameView/WindowSize", QSize(800, 600)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("FrameView/WindowPos", QPoint(100, 100)).toPoint()));
+    }
+}
+
+void FrameViewWindow::writeSettings()
+{
+    QSettings settings;
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("FrameView/WindowSize", size());
+        settings.setValue("FrameView/WindowPos", pos());
+    }
+}
+
+void FrameViewWindow::busChanged(int bus)
+{
+    view->setBus(bus);
+}
+
+void FrameViewWindow::applyFilter()
+{
+    QString error;
+    if (view->setFilterExpression(ui->lineFilter->text(), error)) ui->lblFilterError->clear();
+    else ui->lblFilterError->setText(error);
+}
+
+void FrameViewWindow::overwriteToggled(bool checked)
+{
+    view->setOverwriteMode(checked);
+    ui->cbChangesOnly->setEnabled(!checked); //overwrite wins over it
+}
+
+void FrameViewWindow::changesOnlyToggled(bool checked)
+{
+    view->setChangesOnlyMode(checked);
+}
+
+void FrameViewWindow::headerClicked(int column)
+{
+    view->sortByColumn(column);
+}
+
+void FrameViewWindow::nameChanged(const QString &name)
+{
+    setWindowTitle(name.trimmed().isEmpty() ? tr("Frame View") : tr("Frame View - %1").arg(name.trimmed()));
+}
+
+void FrameViewWindow::rowsChanged()
+{
+    ui->lblCount->setText(tr("%1 of %2 frames").arg(view->rowCount()).arg(view->totalFrameCount()));
+    if (ui->cbAutoScroll->isChecked() && !view->getOverwriteMode()) ui->tableFrames->scrollToBottom();
+}
@@ -0,0 +1,45 @@
+#ifndef FRAMEVIEWWINDOW_H
+#define FRAMEVIEWWINDOW_H
+
+#include <QDialog>
+#include "canframemodel.h"
+#include "canframeview.h"
+
+namespace Ui {
+class FrameViewWindow;
+}
+
+/*
+ * A frame list of its own next to the main one: one bus or all of them, a filter expression, overwrite and
+ * changes only modes and a sort, none of which touch the main list or any other frame view. Any number can be
+ * open, each one a CANFrameView over the main list's frames. Shown the way the main list shows them.
+ */
+class FrameViewWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FrameViewWindow(CANFrameModel *list, QWidget *parent = 0);
+    ~FrameViewWindow();
+    void showEvent(QShowEvent*);
+
+private slots:
+    void busChanged(int bus);
+    void applyFilter();
+    void overwriteToggled(bool checked);
+    void changesOnlyToggled(bool checked);
+    void headerClicked(int column);
+    void nameChanged(const QString &name);
+    void rowsChanged();
+
+private:
+    Ui::FrameViewWindow *ui;
+    CANFrameView *view;
+
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // FRAMEVIEWWINDOW_H
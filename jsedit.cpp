@@ -31,11 +31,22 @@
 #include "jsedit.h"
 
 #include <QtGui>
+#include <QThreadPool>
+#include <QTimer>
+#include <functional>
+
+// blocks re-highlighted per idle pass after a color, keyword or mark change
+#define JSEDIT_REHIGHLIGHT_CHUNK 400
+// how long typing has to stop before brackets and folds get paired up again, in ms
+#define JSEDIT_ANALYSIS_DELAY 150
 
 class JSBlockData: public QTextBlockUserData
 {
 public:
+    JSBlockData() : generation(-1) {}
     QList<int> bracketPositions;
+    QByteArray bracketKinds; // '{' or '}' for each of bracketPositions
+    int generation; // JSHighlighter::generation() the block was last highlighted with
 };
 
 class JSHighlighter : public QSyntaxHighlighter
@@ -48,10 +59,15 @@ public:
     QStringList keywords() const;
     void setKeywords(const QStringList &keywords);
 
+    // bumped by every change that needs all blocks highlighted again. JSEdit does that
+    // for what's on screen straight away and for the rest of the document when idle
+    int generation() const { return m_generation; }
+
 protected:
     void highlightBlock(const QString &text);
 
 private:
+    int m_generation;
     QSet<QString> m_keywords;
     QSet<QString> m_knownIds;
     QSet<QString> m_customIds;
@@ -62,6 +78,7 @@ private:
 
 JSHighlighter::JSHighlighter(QTextDocument *parent)
     : QSyntaxHighlighter(parent)
+    , m_generation(0)
     , m_markCaseSensitivity(Qt::CaseInsensitive)
 {
     // default color scheme
@@ -277,7 +294,7 @@ JSHighlighter::JSHighlighter(QTextDocument *parent)
 void JSHighlighter::setColor(JSEdit::ColorComponent component, const QColor &color)
 {
     m_colors[component] = color;
-    rehighlight();
+    ++m_generation;
 }
 
 void JSHighlighter::highlightBlock(const QString &text)
@@ -294,15 +311,14 @@ void JSHighlighter::highlightBlock(const QString &text)
     };
 
     QList<int> bracketPositions;
+    QByteArray bracketKinds;
     QString previousToken;
 
-    int blockState = previousBlockState();
-    int bracketLevel = blockState >> 4;
-    int state = blockState & 15;
-    if (blockState < 0) {
-        bracketLevel = 0;
+    // only the lexer state goes from block to block, so after an edit re-highlighting stops
+    // at the first block that comes out the same. Bracket depth is the bracket index's job
+    int state = previousBlockState();
+    if (state < 0)
         state = Start;
-    }
 
     int start = 0;
     int i = 0;
@@ -344,10 +360,7 @@ void JSHighlighter::highlightBlock(const QString &text)
                     setFormat(start, 1, m_colors[JSEdit::Operator]);
                 if (ch =='{' || ch == '}') {
                     bracketPositions += i;
-                    if (ch == '{')
-                        bracketLevel++;
-                    else
-                        bracketLevel--;
+                    bracketKinds += ch.toLatin1();
                 }
                 ++i;
                 state = Start;
@@ -459,24 +472,24 @@ void JSHighlighter::highlightBlock(const QString &text)
         }
     }
 
-    if (!bracketPositions.isEmpty()) {
-        JSBlockData *blockData = reinterpret_cast<JSBlockData*>(currentBlock().userData());
-        if (!blockData) {
-            blockData = new JSBlockData;
-            currentBlock().setUserData(blockData);
-        }
-        blockData->bracketPositions = bracketPositions;
+    // every block gets one, a block whose last bracket was deleted mustn't keep the old positions
+    JSBlockData *blockData = reinterpret_cast<JSBlockData*>(currentBlock().userData());
+    if (!blockData) {
+        blockData = new JSBlockData;
+        currentBlock().setUserData(blockData);
     }
+    blockData->bracketPositions = bracketPositions;
+    blockData->bracketKinds = bracketKinds;
+    blockData->generation = m_generation;
 
-    blockState = (state & 15) | (bracketLevel << 4);
-    setCurrentBlockState(blockState);
+    setCurrentBlockState(state);
 }
 
 void JSHighlighter::mark(const QString &str, Qt::CaseSensitivity caseSensitivity)
 {
     m_markString = str;
     m_markCaseSensitivity = caseSensitivity;
-    rehighlight();
+    ++m_generation;
 }
 
 QStringList JSHighlighter::keywords() const
@@ -487,7 +500,7 @@ QStringList JSHighlighter::keywords() const
 void JSHighlighter::setKeywords(const QStringList &keywords)
 {
     m_keywords = QSet<QString>(keywords.begin(), keywords.end());
-    rehighlight();
+    ++m_generation;
 }
 
 struct BlockInfo {
@@ -660,6 +673,63 @@ static int findOpeningMatch(const QTextDocument *doc, int cursorPosition)
     return -1;
 }
 
+struct JSBracket {
+    int position; // in the document
+    int block;
+    char kind;
+};
+
+// how every bracket in the document pairs up, built on a pool thread from the positions the
+// highlighter leaves in each block. Exact only for the document revision it was built from
+struct JSBracketIndex {
+    JSBracketIndex() : revision(-1) {}
+    int revision;
+    QHash<int, int> matches; // bracket position -> position of the one it pairs with
+    QVector<int> closingPosition; // per block, the partner of its first paired '{', or -1
+    QVector<int> closingBlock; // and the block that partner is in
+};
+
+// pairs them with a stack, which gives the same answers as the findClosingMatch() and
+// findOpeningMatch() walks but for the whole document in one go
+static JSBracketIndex buildBracketIndex(const QVector<JSBracket> &brackets, int blockCount, int revision)
+{
+    JSBracketIndex index;
+    index.revision = revision;
+    index.closingPosition.fill(-1, blockCount);
+    index.closingBlock.fill(-1, blockCount);
+
+    QVector<int> partner(brackets.count(), -1);
+    QVector<int> open;
+    for (int i = 0; i < brackets.count(); ++i) {
+        if (brackets.at(i).kind == '{') {
+            open.append(i);
+        } else if (!open.isEmpty()) {
+            int o = open.takeLast();
+            partner[o] = i;
+            partner[i] = o;
+            index.matches.insert(brackets.at(o).position, brackets.at(i).position);
+            index.matches.insert(brackets.at(i).position, brackets.at(o).position);
+        }
+    }
+    for (int i = 0; i < brackets.count(); ++i) {
+        const JSBracket &b = brackets.at(i);
+        if (b.kind != '{' || partner.at(i) < 0 || index.closingPosition.at(b.block) >= 0)
+            continue;
+        index.closingPosition[b.block] = brackets.at(partner.at(i)).position;
+        index.closingBlock[b.block] = brackets.at(partner.at(i)).block;
+    }
+    return index;
+}
+
+class JSAnalysisTask : public QRunnable
+{
+public:
+    explicit JSAnalysisTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() { task(); }
+private:
+    std::function<void()> task;
+};
+
 class JSDocLayout: public QPlainTextDocumentLayout
 {
 public:
@@ -693,6 +763,13 @@ public:
     QList<int> errorPositions;
     QColor bracketErrorColor;
     bool codeFolding : 1;
+    QTimer rehighlightTimer;
+    int rehighlightNext;
+    QTimer analysisTimer;
+    QThreadPool analysisPool;
+    bool analysisRunning;
+    bool analysisPending;
+    JSBracketIndex brackets;
 };
 
 JSEdit::JSEdit(QWidget *parent)
@@ -710,9 +787,21 @@ JSEdit::JSEdit(QWidget *parent)
     d_ptr->bracketMatchColor = QColor(180, 238, 180);
     d_ptr->bracketErrorColor = QColor(224, 128, 128);
     d_ptr->codeFolding = true;
+    d_ptr->rehighlightNext = 0;
+    d_ptr->rehighlightTimer.setSingleShot(true);
+    d_ptr->rehighlightTimer.setInterval(0);
+    d_ptr->analysisTimer.setSingleShot(true);
+    d_ptr->analysisTimer.setInterval(JSEDIT_ANALYSIS_DELAY);
+    d_ptr->analysisPool.setMaxThreadCount(1);
+    d_ptr->analysisRunning = false;
+    d_ptr->analysisPending = false;
 
     document()->setDocumentLayout(d_ptr->layout);
 
+    connect(&d_ptr->rehighlightTimer, SIGNAL(timeout()), this, SLOT(rehighlightStep()));
+    connect(&d_ptr->analysisTimer, SIGNAL(timeout()), this, SLOT(startAnalysis()));
+    connect(document(), SIGNAL(contentsChanged()), &d_ptr->analysisTimer, SLOT(start()));
+
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(updateCursor()));
     connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(updateSidebar()));
     connect(this, SIGNAL(updateRequest(QRect, int)), this, SLOT(updateSidebar(QRect, int)));
@@ -731,6 +820,8 @@ JSEdit::JSEdit(QWidget *parent)
 
 JSEdit::~JSEdit()
 {
+    // a result still on its way back gets dropped along with this object
+    d_ptr->analysisPool.waitForDone();
     delete d_ptr->layout;
 }
 
@@ -768,6 +859,7 @@ void JSEdit::setColor(ColorComponent component, const QColor &color)
         updateSidebar();
     } else {
         d->highlighter->setColor(component, color);
+        scheduleRehighlight();
         updateCursor();
     }
 }
@@ -780,6 +872,7 @@ QStringList JSEdit::keywords() const
 void JSEdit::setKeywords(const QStringList &keywords)
 {
     d_ptr->highlighter->setKeywords(keywords);
+    scheduleRehighlight();
 }
 
 bool JSEdit::isLineNumbersVisible() const
@@ -850,6 +943,14 @@ static int findClosingConstruct(const QTextBlock &block)
 
 bool JSEdit::isFoldable(int line) const
 {
+    // the sidebar asks for every line on screen, so this goes by the last index even if a few
+    // edits behind rather than walking to every closing bracket. The next index redraws it
+    const JSBracketIndex &index = d_ptr->brackets;
+    if (index.revision >= 0) {
+        if (line < 1 || line > index.closingBlock.count())
+            return false;
+        return index.closingBlock.at(line - 1) > line;
+    }
     int matchPos = findClosingConstruct(document()->findBlockByNumber(line - 1));
     if (matchPos >= 0) {
         QTextBlock matchBlock = document()->findBlock(matchPos);
@@ -873,7 +974,7 @@ bool JSEdit::isFolded(int line) const
 void JSEdit::fold(int line)
 {
     QTextBlock startBlock = document()->findBlockByNumber(line - 1);
-    int endPos = findClosingConstruct(startBlock);
+    int endPos = closingConstruct(startBlock);
     if (endPos < 0)
         return;
     QTextBlock endBlock = document()->findBlock(endPos);
@@ -896,7 +997,7 @@ void JSEdit::fold(int line)
 void JSEdit::unfold(int line)
 {
     QTextBlock startBlock = document()->findBlockByNumber(line - 1);
-    int endPos = findClosingConstruct(startBlock);
+    int endPos = closingConstruct(startBlock);
 
     QTextBlock block = startBlock.next();
     while (block.isValid() && !block.isVisible()) {
@@ -925,6 +1026,8 @@ void JSEdit::toggleFold(int line)
 void JSEdit::resizeEvent(QResizeEvent *e)
 {
     QPlainTextEdit::resizeEvent(e);
+    if (d_ptr->rehighlightTimer.isActive())
+        rehighlightVisible();
     updateSidebar();
 }
 
@@ -963,7 +1066,7 @@ void JSEdit::updateCursor()
             int cursorPosition = cursor.position();
 
             if (document()->characterAt(cursorPosition) == '{') {
-                int matchPos = findClosingMatch(document(), cursorPosition);
+                int matchPos = matchingBracket(cursorPosition);
                 if (matchPos < 0) {
                     d->errorPositions += cursorPosition;
                 } else {
@@ -973,7 +1076,7 @@ void JSEdit::updateCursor()
             }
 
             if (document()->characterAt(cursorPosition - 1) == '}') {
-                int matchPos = findOpeningMatch(document(), cursorPosition);
+                int matchPos = matchingBracket(cursorPosition - 1);
                 if (matchPos < 0) {
                     d->errorPositions += cursorPosition - 1;
                 } else {
@@ -1019,8 +1122,12 @@ void JSEdit::updateCursor()
 void JSEdit::updateSidebar(const QRect &rect, int d)
 {
     Q_UNUSED(rect)
-    if (d != 0)
+    if (d != 0) {
+        // scrolled to blocks the idle pass hasn't got to yet
+        if (d_ptr->rehighlightTimer.isActive())
+            rehighlightVisible();
         updateSidebar();
+    }
 }
 
 void JSEdit::updateSidebar()
@@ -1083,4 +1190,112 @@ void JSEdit::updateSidebar()
 void JSEdit::mark(const QString &str, Qt::CaseSensitivity sens)
 {
     d_ptr->highlighter->mark(str, sens);
+    scheduleRehighlight();
+}
+
+// what's on screen first so the change shows straight away, everything else a chunk at a
+// time from the event loop. Blocks already done with the current generation get skipped
+void JSEdit::scheduleRehighlight()
+{
+    Q_D(JSEdit);
+    rehighlightVisible();
+    d->rehighlightNext = 0;
+    d->rehighlightTimer.start();
+}
+
+void JSEdit::rehighlightVisible()
+{
+    Q_D(JSEdit);
+    const int generation = d->highlighter->generation();
+    const QRectF view = viewport()->rect();
+    for (QTextBlock block = firstVisibleBlock(); block.isValid(); block = block.next()) {
+        if (!block.isVisible())
+            continue;
+        if (blockBoundingGeometry(block).translated(contentOffset()).top() > view.bottom())
+            break;
+        JSBlockData *blockData = reinterpret_cast<JSBlockData*>(block.userData());
+        if (!blockData || blockData->generation != generation)
+            d->highlighter->rehighlightBlock(block);
+    }
+}
+
+void JSEdit::rehighlightStep()
+{
+    Q_D(JSEdit);
+    const int generation = d->highlighter->generation();
+    QTextBlock block = document()->findBlockByNumber(d->rehighlightNext);
+    for (int done = 0; block.isValid() && done < JSEDIT_REHIGHLIGHT_CHUNK; block = block.next(), ++done) {
+        JSBlockData *blockData = reinterpret_cast<JSBlockData*>(block.userData());
+        if (!blockData || blockData->generation != generation)
+            d->highlighter->rehighlightBlock(block);
+    }
+    if (block.isValid()) {
+        d->rehighlightNext = block.blockNumber();
+        d->rehighlightTimer.start();
+    }
+}
+
+// copies the bracket positions out of the blocks (cheap, the highlighter already found them)
+// and pairs them up on the pool thread. Typing in the meantime just asks for another one
+void JSEdit::startAnalysis()
+{
+    Q_D(JSEdit);
+    if (d->analysisRunning) {
+        d->analysisPending = true;
+        return;
+    }
+    d->analysisPending = false;
+
+    QVector<JSBracket> brackets;
+    int number = 0;
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next(), ++number) {
+        JSBlockData *blockData = reinterpret_cast<JSBlockData*>(block.userData());
+        if (!blockData || blockData->bracketKinds.size() != blockData->bracketPositions.count())
+            continue;
+        const int offset = block.position();
+        for (int c = 0; c < blockData->bracketPositions.count(); ++c) {
+            JSBracket bracket;
+            bracket.position = offset + blockData->bracketPositions.at(c);
+            bracket.block = number;
+            bracket.kind = blockData->bracketKinds.at(c);
+            brackets.append(bracket);
+        }
+    }
+
+    const int revision = document()->revision();
+    d->analysisRunning = true;
+    d->analysisPool.start(new JSAnalysisTask([this, brackets, number, revision]() {
+        JSBracketIndex index = buildBracketIndex(brackets, number, revision);
+        QMetaObject::invokeMethod(this, [this, index]() {
+            Q_D(JSEdit);
+            d->analysisRunning = false;
+            d->brackets = index;
+            if (d->analysisPending)
+                startAnalysis();
+            updateSidebar();
+            updateCursor();
+        }, Qt::QueuedConnection);
+    }));
+}
+
+bool JSEdit::bracketIndexCurrent() const
+{
+    return d_ptr->brackets.revision == document()->revision();
+}
+
+// the paired up position if the index is current, otherwise a walk through the document
+int JSEdit::matchingBracket(int position) const
+{
+    if (bracketIndexCurrent())
+        return d_ptr->brackets.matches.value(position, -1);
+    if (document()->characterAt(position) == '{')
+        return findClosingMatch(document(), position);
+    return findOpeningMatch(document(), position + 1);
+}
+
+int JSEdit::closingConstruct(const QTextBlock &block) const
+{
+    if (block.isValid() && bracketIndexCurrent())
+        return d_ptr->brackets.closingPosition.value(block.blockNumber(), -1);
+    return findClosingConstruct(block);
 }
@@ -36,6 +36,7 @@
 #include <QScopedPointer>
 
 class JSEditPrivate;
+class QTextBlock;
 
 class JSEdit: public QPlainTextEdit
 {
@@ -102,8 +103,16 @@ protected:
 private slots:
     void updateCursor();
     void updateSidebar(const QRect &rect, int d);
+    void rehighlightStep();
+    void startAnalysis();
 
 private:
+    void scheduleRehighlight();
+    void rehighlightVisible();
+    bool bracketIndexCurrent() const;
+    int matchingBracket(int position) const;
+    int closingConstruct(const QTextBlock &block) const;
+
     QScopedPointer<JSEditPrivate> d_ptr;
     Q_DECLARE_PRIVATE(JSEdit);
     Q_DISABLE_COPY(JSEdit);
@@ -0,0 +1,185 @@
+#include "lograngedialog.h"
+#include "ui_lograngedialog.h"
+#include "utility.h"
+
+#include <QPushButton>
+#include <QRegularExpression>
+#include <cmath>
+
+LogRangeDialog::LogRangeDialog(const TextLogIndex *index, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::LogRangeDialog),
+    index(index)
+{
+    ui->setupUi(this);
+    expressionHint = ui->editExpression->toolTip();
+
+    if (index)
+    {
+        bool hasTimes = index->minTime <= index->maxTime;
+        double duration = hasTimes ? (index->maxTime - index->minTime) / 1000000.0 : 0.0;
+        QString summary = tr("%1 frames with %2 different IDs").arg(index->totalFrames).arg(index->ids.count());
+        if (hasTimes) summary += tr(" over %1 seconds").arg(duration, 0, 'f', 3);
+        ui->lblSummary->setText(summary);
+
+        //the spin boxes count from the first frame, timestamps in logs tend to be huge
+        ui->spinFrom->setRange(0.0, std::ceil(duration));
+        ui->spinTo->setRange(0.0, std::ceil(duration));
+        ui->spinTo->setValue(std::ceil(duration));
+        ui->groupTime->setEnabled(hasTimes);
+
+        for (const TextIndexID &id : index->ids)
+        {
+            bool extended = (id.key & 0x80000000u) != 0;
+            uint32_t frameId = id.key & FRAME_LOAD_ID_BITS;
+            QListWidgetItem *item = new QListWidgetItem(tr("%1  -  %2 frames").arg(Utility::formatCANID(frameId, extended)).arg(id.count), ui->listIDs);
+            item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+            item->setCheckState(Qt::Checked);
+            item->setData(Qt::UserRole, id.key);
+        }
+        ui->editIDs->hide();
+    }
+    else
+    {
+        //nothing known about the file up front, times are whatever the file has and off unless asked for
+        ui->lblSummary->setText(tr("Only the frames that match get kept. Times are in seconds as the file has them."));
+        ui->groupTime->setCheckable(true);
+        ui->groupTime->setChecked(false);
+        ui->spinFrom->setRange(0.0, 1e10);
+        ui->spinTo->setRange(0.0, 1e10);
+        ui->spinTo->setValue(ui->spinTo->maximum());
+        ui->spinFrom->setToolTip(QString());
+        ui->spinTo->setToolTip(QString());
+        ui->listIDs->hide();
+        ui->btnAll->hide();
+        ui->btnNone->hide();
+        ui->lblEstimate->hide();
+    }
+
+    connect(ui->spinFrom, SIGNAL(valueChanged(double)), this, SLOT(updateEstimate()));
+    connect(ui->spinTo, SIGNAL(valueChanged(double)), this, SLOT(updateEstimate()));
+    connect(ui->groupTime, &QGroupBox::toggled, this, &LogRangeDialog::updateEstimate);
+    connect(ui->listIDs, &QListWidget::itemChanged, this, &LogRangeDialog::updateEstimate);
+    connect(ui->editIDs, &QLineEdit::textChanged, this, &LogRangeDialog::updateEstimate);
+    connect(ui->editBuses, &QLineEdit::textChanged, this, &LogRangeDialog::updateEstimate);
+    connect(ui->editExpression, &QLineEdit::textChanged, this, &LogRangeDialog::updateEstimate);
+    connect(ui->btnAll, &QPushButton::clicked, this, [this]() { checkAll(true); });
+    connect(ui->btnNone, &QPushButton::clicked, this, [this]() { checkAll(false); });
+    updateEstimate();
+}
+
+LogRangeDialog::~LogRangeDialog()
+{
+    delete ui;
+}
+
+FrameLoadOptions LogRangeDialog::options() const
+{
+    FrameLoadOptions opts;
+    if (index)
+    {
+        if (ui->groupTime->isEnabled())
+        {
+            //a window covering the whole log is left open ended so frames without a timestamp stay in
+            if (ui->spinFrom->value() > ui->spinFrom->minimum())
+                opts.from = index->minTime + static_cast<qint64>(ui->spinFrom->value() * 1000000.0);
+            if (ui->spinTo->value() < ui->spinTo->maximum())
+                opts.to = index->minTime + static_cast<qint64>(ui->spinTo->value() * 1000000.0);
+        }
+
+        bool all = true;
+        for (int i = 0; i < ui->listIDs->count(); i++)
+        {
+            QListWidgetItem *item = ui->listIDs->item(i);
+            if (item->checkState() == Qt::Checked) opts.ids.append({item->data(Qt::UserRole).toUInt(), FRAME_LOAD_EXACT});
+            else all = false;
+        }
+        if (all) opts.ids.clear();
+        else if (opts.ids.isEmpty()) opts.nothing = true;
+    }
+    else
+    {
+        if (ui->groupTime->isChecked())
+        {
+            opts.from = static_cast<qint64>(ui->spinFrom->value() * 1000000.0);
+            if (ui->spinTo->value() < ui->spinTo->maximum()) opts.to = static_cast<qint64>(ui->spinTo->value() * 1000000.0);
+        }
+        parseIDs(ui->editIDs->text(), opts.ids);
+    }
+
+    parseBuses(ui->editBuses->text(), opts.buses);
+    opts.expression = FilterExpression::compile(ui->editExpression->text());
+    opts.decimate = ui->spinDecimate->value();
+    return opts;
+}
+
+//hex IDs, or ID/MASK pairs. Plain IDs match standard and extended alike since typing them in doesn't say which
+bool LogRangeDialog::parseIDs(const QString &text, QVector<FrameLoadID> &ids)
+{
+    ids.clear();
+    const QStringList tokens = text.split(QRegularExpression("[,;\\s]+"), Qt::SkipEmptyParts);
+    for (const QString &token : tokens)
+    {
+        QStringList parts = token.split('/');
+        bool ok = parts.count() <= 2;
+        FrameLoadID id;
+        if (ok) id.key = parts[0].toUInt(&ok, 16) & FRAME_LOAD_ID_BITS;
+        id.mask = FRAME_LOAD_ID_BITS;
+        if (ok && parts.count() == 2) id.mask = parts[1].toUInt(&ok, 16) & FRAME_LOAD_ID_BITS;
+        if (!ok)
+        {
+            ids.clear();
+            return false;
+        }
+        ids.append(id);
+    }
+    return true;
+}
+
+bool LogRangeDialog::parseBuses(const QString &text, QSet<int> &buses)
+{
+    buses.clear();
+    const QStringList tokens = text.split(QRegularExpression("[,;\\s]+"), Qt::SkipEmptyParts);
+    for (const QString &token : tokens)
+    {
+        bool ok;
+        int bus = token.toInt(&ok);
+        if (!ok || bus < 0)
+        {
+            buses.clear();
+            return false;
+        }
+        buses.insert(bus);
+    }
+    return true;
+}
+
+//whole blocks get read so this is an upper bound on what comes out
+void LogRangeDialog::updateEstimate()
+{
+    FrameLoadOptions opts = options();
+    QVector<FrameLoadID> ids;
+    QSet<int> buses;
+    QString expressionError;
+    FilterExpression::compile(ui->editExpression->text(), &expressionError);
+    ui->editExpression->setToolTip(expressionError.isEmpty() ? expressionHint : expressionError);
+    bool valid = !opts.nothing && ui->spinFrom->value() <= ui->spinTo->value() && expressionError.isEmpty()
+            && parseIDs(ui->editIDs->text(), ids) && parseBuses(ui->editBuses->text(), buses);
+    if (index)
+    {
+        quint64 frames = 0;
+        QVector<int> blocks = index->blocksFor(opts);
+        for (int b : blocks) frames += index->blocks[b].frames;
+        ui->lblEstimate->setText(tr("Reads %1 of %2 blocks, up to %3 frames").arg(blocks.count()).arg(index->blocks.count()).arg(frames));
+    }
+    ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(valid);
+}
+
+void LogRangeDialog::checkAll(bool checked)
+{
+    //one estimate at the end instead of one per item
+    ui->listIDs->blockSignals(true);
+    for (int i = 0; i < ui->listIDs->count(); i++) ui->listIDs->item(i)->setCheckState(checked ? Qt::Checked : Qt::Unchecked);
+    ui->listIDs->blockSignals(false);
+    updateEstimate();
+}
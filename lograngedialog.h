@@ -0,0 +1,41 @@
+#ifndef LOGRANGEDIALOG_H
+#define LOGRANGEDIALOG_H
+
+#include <QDialog>
+#include "frameloadoptions.h"
+#include "textlogindex.h"
+
+namespace Ui {
+class LogRangeDialog;
+}
+
+/*
+ * Picks which frames of a log to load: a time window, IDs, buses and decimation. Given the sidecar index of a text
+ * log it lists the IDs the log has and shows how much of it would be read, everything shown comes from the index
+ * so it opens straight away whatever size the log is. Without one IDs and times get typed in.
+ */
+class LogRangeDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit LogRangeDialog(const TextLogIndex *index, QWidget *parent = nullptr);
+    ~LogRangeDialog();
+
+    FrameLoadOptions options() const;
+
+    //the ID and bus boxes' syntax, also what the command line tool takes
+    static bool parseIDs(const QString &text, QVector<FrameLoadID> &ids);
+    static bool parseBuses(const QString &text, QSet<int> &buses);
+
+private slots:
+    void updateEstimate();
+    void checkAll(bool checked);
+
+private:
+    Ui::LogRangeDialog *ui;
+    const TextLogIndex *index;
+    QString expressionHint; //tool tip of the expression box when it holds no error
+};
+
+#endif // LOGRANGEDIALOG_H
@@ -4,6 +4,7 @@
 #include <qevent.h>
 #include <QDebug>
 #include "simplecrypt.h"
+#include "threadpolicy.h"
 
 //using this simple encryption library to obfuscate stored password a bit. It's not super secure but better than
 //storing a password in straight plaintext. You have the source to this application anyway, whatever algorithm used,
@@ -44,6 +45,9 @@ MainSettingsDialog::MainSettingsDialog(QWidget *parent) :
     QByteArray encPass = settings.value("Remote/Pass", "").toByteArray();
     QString decPass = crypto.decryptToString(encPass);
     ui->lineRemotePassword->setText(decPass);
+    ui->cbRemotePacked->setChecked(settings.value("Remote/Packed", false).toBool());
+    ui->spinRemotePackFrames->setValue(settings.value("Remote/PackFrames", 256).toInt());
+    ui->spinRemotePackDelay->setValue(settings.value("Remote/PackDelay", 50).toInt());
 
     ui->cbLoadConnections->setChecked(settings.value("Main/SaveRestoreConnections", false).toBool());
 
@@ -88,7 +92,9 @@ MainSettingsDialog::MainSettingsDialog(QWidget *parent) :
     ui->cbCSVAbsTime->setChecked(settings.value("Main/CSVAbsTime", false).toBool());
     ui->comboSendingBus->setCurrentIndex(settings.value("Playback/SendingBus", 4).toInt());
     ui->cbUseFiltered->setChecked(settings.value("Main/UseFiltered", false).toBool());
+    ui->cbHardwareFilters->setChecked(settings.value("Main/HardwareFilters", false).toBool());
     ui->cbUseOpenGL->setChecked(settings.value("Main/UseOpenGL", false).toBool());
+    ui->cbOffscreenPlots->setChecked(settings.value("Main/OffscreenPlots", false).toBool());
     ui->cbFilterLabeling->setChecked(settings.value("Main/FilterLabeling", true).toBool());
     ui->cbIgnoreDBCColors->setChecked(settings.value("Main/IgnoreDBCColors", false).toBool());
 
@@ -105,7 +111,29 @@ MainSettingsDialog::MainSettingsDialog(QWidget *parent) :
     }
 
     ui->spinMaximumFrames->setValue(settings.value("Main/MaximumFrames", maxFramesDefault).toInt());
+    ui->cbSharedPayloads->setChecked(settings.value("Main/SharedPayloads", true).toBool());
     ui->spinBytesPerLine->setValue(settings.value("Main/BytesPerLine", 8).toInt());
+    ui->spinRetentionSeconds->setValue(settings.value("Main/RetentionSeconds", 0).toInt());
+    ui->spinRetentionMB->setValue(settings.value("Main/RetentionMB", 0).toInt());
+    ui->cbRetentionSpill->setChecked(settings.value("Main/RetentionSpill", false).toBool());
+    ui->spinTXFlushDeadline->setValue(settings.value("Main/TXFlushDeadline", 0).toInt());
+    ui->spinContinuousRotateMB->setValue(settings.value("FileIO/ContinuousRotateMB", 0).toInt());
+    ui->spinContinuousRotateMinutes->setValue(settings.value("FileIO/ContinuousRotateMinutes", 0).toInt());
+    ui->comboContinuousSync->setCurrentIndex(settings.value("FileIO/ContinuousSync", 0).toInt());
+    ui->spinCaptureOnlyPreview->setValue(settings.value("Main/CaptureOnlyPreview", 100).toInt());
+
+    for (int role = 0; role < ThreadPolicy::ROLE_COUNT; role++)
+    {
+        QLineEdit *cores;
+        QCheckBox *realTime;
+        threadWidgets(static_cast<ThreadPolicy::Role>(role), cores, realTime);
+        ThreadPolicy::Settings policy = ThreadPolicy::load(static_cast<ThreadPolicy::Role>(role));
+        cores->setText(ThreadPolicy::coresText(policy.cores));
+        realTime->setChecked(policy.realTime);
+        connect(cores, SIGNAL(editingFinished()), this, SLOT(updateSettings()));
+        connect(realTime, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
+    }
+    showThreadJitter();
 
     //just for simplicity they all call the same function and that function updates all settings at once
     connect(ui->cbDisplayHex, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
@@ -124,20 +152,34 @@ MainSettingsDialog::MainSettingsDialog(QWidget *parent) :
     connect(ui->cbCSVAbsTime, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->comboSendingBus, SIGNAL(currentIndexChanged(int)), this, SLOT(updateSettings()));
     connect(ui->cbUseFiltered, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
+    connect(ui->cbHardwareFilters, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->lineClockFormat, SIGNAL(editingFinished()), this, SLOT(updateSettings()));
     connect(ui->cbUseOpenGL, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
+    connect(ui->cbOffscreenPlots, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->lineRemoteHost, SIGNAL(editingFinished()), this, SLOT(updateSettings()));
     connect(ui->lineRemotePort, SIGNAL(editingFinished()), this, SLOT(updateSettings()));
     connect(ui->lineRemoteUser, SIGNAL(editingFinished()), this, SLOT(updateSettings()));
     connect(ui->lineRemotePassword, SIGNAL(editingFinished()), this, SLOT(updateSettings()));
+    connect(ui->cbRemotePacked, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
+    connect(ui->spinRemotePackFrames, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->spinRemotePackDelay, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
     connect(ui->cbLoadConnections, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->cbFilterLabeling, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->cbHexGraphFlow, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->cbHexGraphInfo, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->cbIgnoreDBCColors, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->spinMaximumFrames, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->cbSharedPayloads, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->cbFontFixedWidth, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
     connect(ui->spinBytesPerLine, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->spinRetentionSeconds, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->spinRetentionMB, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->cbRetentionSpill, SIGNAL(toggled(bool)), this, SLOT(updateSettings()));
+    connect(ui->spinTXFlushDeadline, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->spinContinuousRotateMB, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->spinContinuousRotateMinutes, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->comboContinuousSync, SIGNAL(currentIndexChanged(int)), this, SLOT(updateSettings()));
+    connect(ui->spinCaptureOnlyPreview, SIGNAL(valueChanged(int)), this, SLOT(updateSettings()));
 
     installEventFilter(this);
 }
@@ -147,6 +189,44 @@ MainSettingsDialog::~MainSettingsDialog()
     delete ui;
 }
 
+void MainSettingsDialog::threadWidgets(ThreadPolicy::Role role, QLineEdit *&cores, QCheckBox *&realTime) const
+{
+    switch (role)
+    {
+    case ThreadPolicy::PLAYBACK:
+        cores = ui->lineCoresPlayback;
+        realTime = ui->cbRealTimePlayback;
+        break;
+    case ThreadPolicy::SENDER:
+        cores = ui->lineCoresSender;
+        realTime = ui->cbRealTimeSender;
+        break;
+    case ThreadPolicy::ISOTP:
+        cores = ui->lineCoresIsoTp;
+        realTime = ui->cbRealTimeIsoTp;
+        break;
+    default:
+        cores = ui->lineCoresCapture;
+        realTime = ui->cbRealTimeCapture;
+        break;
+    }
+}
+
+//how late the threads that wait for deadlines have woken up since the program started
+void MainSettingsDialog::showThreadJitter()
+{
+    QStringList lines;
+    for (int role = 0; role < ThreadPolicy::ROLE_COUNT; role++)
+    {
+        ThreadPolicy::Jitter jitter = ThreadPolicy::jitter(static_cast<ThreadPolicy::Role>(role));
+        if (!jitter.wakeups) continue;
+        lines.append(tr("%1: mean %2 us, worst %3 us over %4 wakeups").arg(ThreadPolicy::roleName(static_cast<ThreadPolicy::Role>(role)))
+                     .arg(jitter.meanUs, 0, 'f', 1).arg(jitter.maxUs).arg(jitter.wakeups));
+    }
+    if (lines.isEmpty()) lines.append(tr("No timed wakeups measured yet"));
+    ui->lblThreadJitter->setText(tr("Wakeup jitter:") + "\n" + lines.join("\n"));
+}
+
 void MainSettingsDialog::closeEvent(QCloseEvent *event)
 {
     Q_UNUSED(event);
@@ -195,7 +275,9 @@ void MainSettingsDialog::updateSettings()
     settings.setValue("Main/CSVAbsTime", ui->cbCSVAbsTime->isChecked());
     settings.setValue("Playback/SendingBus", ui->comboSendingBus->currentIndex());
     settings.setValue("Main/UseFiltered", ui->cbUseFiltered->isChecked());
+    settings.setValue("Main/HardwareFilters", ui->cbHardwareFilters->isChecked());
     settings.setValue("Main/UseOpenGL", ui->cbUseOpenGL->isChecked());
+    settings.setValue("Main/OffscreenPlots", ui->cbOffscreenPlots->isChecked());
     settings.setValue("Main/TimeFormat", ui->lineClockFormat->text());
     settings.setValue("Main/FontSize", ui->spinFontSize->value());
     settings.setValue("Remote/Host", ui->lineRemoteHost->text());
@@ -203,12 +285,37 @@ void MainSettingsDialog::updateSettings()
     settings.setValue("Remote/User", ui->lineRemoteUser->text());
     QByteArray encPass = crypto.encryptToByteArray(ui->lineRemotePassword->text());
     settings.setValue("Remote/Pass", encPass);
+    settings.setValue("Remote/Packed", ui->cbRemotePacked->isChecked());
+    settings.setValue("Remote/PackFrames", ui->spinRemotePackFrames->value());
+    settings.setValue("Remote/PackDelay", ui->spinRemotePackDelay->value());
     settings.setValue("Main/FilterLabeling", ui->cbFilterLabeling->isChecked());
     settings.setValue("Main/IgnoreDBCColors", ui->cbIgnoreDBCColors->isChecked());
     settings.setValue("Main/MaximumFrames", ui->spinMaximumFrames->value());
+    settings.setValue("Main/SharedPayloads", ui->cbSharedPayloads->isChecked());
     settings.setValue("Main/BytesPerLine", ui->spinBytesPerLine->value());
+    settings.setValue("Main/RetentionSeconds", ui->spinRetentionSeconds->value());
+    settings.setValue("Main/RetentionMB", ui->spinRetentionMB->value());
+    settings.setValue("Main/RetentionSpill", ui->cbRetentionSpill->isChecked());
+    settings.setValue("Main/TXFlushDeadline", ui->spinTXFlushDeadline->value());
+    settings.setValue("FileIO/ContinuousRotateMB", ui->spinContinuousRotateMB->value());
+    settings.setValue("FileIO/ContinuousRotateMinutes", ui->spinContinuousRotateMinutes->value());
+    settings.setValue("FileIO/ContinuousSync", ui->comboContinuousSync->currentIndex());
+    settings.setValue("Main/CaptureOnlyPreview", ui->spinCaptureOnlyPreview->value());
     settings.setValue("Main/FontFixedWidth", ui->cbFontFixedWidth->isChecked());
 
+    for (int role = 0; role < ThreadPolicy::ROLE_COUNT; role++)
+    {
+        QLineEdit *cores;
+        QCheckBox *realTime;
+        threadWidgets(static_cast<ThreadPolicy::Role>(role), cores, realTime);
+        ThreadPolicy::Settings policy = ThreadPolicy::load(static_cast<ThreadPolicy::Role>(role));
+        //a list that doesn't parse keeps what was there before
+        if (!ThreadPolicy::parseCores(cores->text(), policy.cores)) policy = ThreadPolicy::load(static_cast<ThreadPolicy::Role>(role));
+        cores->setText(ThreadPolicy::coresText(policy.cores));
+        policy.realTime = realTime->isChecked();
+        ThreadPolicy::save(static_cast<ThreadPolicy::Role>(role), policy);
+    }
+
     settings.sync();
     emit updatedSettings();
 }
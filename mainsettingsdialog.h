@@ -3,6 +3,10 @@
 
 #include <QDialog>
 #include <QSettings>
+#include "threadpolicy.h"
+
+class QCheckBox;
+class QLineEdit;
 
 namespace Ui {
 class MainSettingsDialog;
@@ -25,6 +29,8 @@ public slots:
 private:
     Ui::MainSettingsDialog *ui;
 
+    void threadWidgets(ThreadPolicy::Role role, QLineEdit *&cores, QCheckBox *&realTime) const;
+    void showThreadJitter();
     void closeEvent(QCloseEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
 };
@@ -1,14 +1,29 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "can_structs.h"
+#include <QBuffer>
 #include <QDateTime>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QScrollBar>
+#include <QSortFilterProxyModel>
+#include <QThreadPool>
+#include <functional>
 #include <QtSerialPort/QSerialPortInfo>
 #include "connections/canconmanager.h"
 #include "connections/connectionwindow.h"
+#include "connections/captureagent.h"
+#include "connections/sharedcapture.h"
+#include "connections/frameserver.h"
 #include "helpwindow.h"
 #include "utility.h"
 #include "filterutility.h"
+#include "pipelinetrace.h"
+#include "memorydiagnosticsdialog.h"
+#include "workspace.h"
+#include "restbusengine.h"
+#include "dbc/dbccache.h"
 
 /*
 Some notes on things I'd like to put into the program but haven't put on github (yet)
@@ -17,6 +32,29 @@ Allow scripts to read/write signals from DBC files
 allow scripts to load DBC files in support of the script - maybe the graphing system too.
 */
 
+//The GUI tick adapts its interval so the main window's own work, the tick plus the painting it causes, stays
+//under this share of the GUI thread. At high frame rates that means fewer, bigger refreshes instead of falling behind
+#define GUI_TARGET_LOAD     0.3
+#define GUI_TICK_MIN_MS     250
+#define GUI_TICK_MAX_MS     2000
+
+//decoded text exports hand out this many frames at a time to the thread pool
+#define EXPORT_DECODE_BLOCK 16384
+//frames merged from several loaded files that go into the model at a time
+#define MULTILOAD_MERGE_BLOCK 65536
+
+namespace
+{
+class ExportTask : public QRunnable
+{
+public:
+    explicit ExportTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() override { task(); }
+private:
+    std::function<void()> task;
+};
+}
+
 QString MainWindow::loadedFileName = "";
 MainWindow *MainWindow::selfRef = nullptr;
 
@@ -42,12 +80,25 @@ MainWindow::MainWindow(QWidget *parent) :
     this->setWindowTitle("Savvy CAN V" + QString::number(VERSION) + " [Built " + QString(__DATE__) +"]");
 
     model = new CANFrameModel(this); // set parent to mainwindow to prevent canframemodel to change thread (might be done by setModel but just in case)
+    //connected ahead of every window so subscribers have had their frames by the time framesUpdated reaches them
+    frameBus = new FrameBus(model->getListReference(), this);
+    connect(this, &MainWindow::framesUpdated, frameBus, &FrameBus::modelUpdated);
 
     QSortFilterProxyModel* proxyModel = new QSortFilterProxyModel;
     proxyModel->setSourceModel(model);
 
     ui->canFramesView->setModel(proxyModel);
 
+    //the whole capture at a glance above the frame list. Clicking it goes to that time
+    overviewStrip = new TrafficOverviewStrip(model->getListReference(), this);
+    ui->verticalLayout_3->insertWidget(0, overviewStrip);
+    connect(overviewStrip, &TrafficOverviewStrip::jumpToTime, this, &MainWindow::gotoTime);
+
+    filterListModel = new FilterListModel(model, this);
+    ui->listFilters->setModel(filterListModel);
+    ui->listFilters->setUniformItemSizes(true); //lets the view skip measuring every row
+    filterListsPending = false;
+
     settingsDialog = new MainSettingsDialog(); //instantiate the settings dialog so it can initialize settings if this is the first run or the config file was deleted.
     settingsDialog->updateSettings(); //write out all the settings. If this is the first run it'll write defaults out.
 
@@ -71,6 +122,12 @@ MainWindow::MainWindow(QWidget *parent) :
     HorzHdr->setFont(QFont());
     HorzHdr->setStretchLastSection(true); //causes the data column to automatically fill the tableview
     connect(HorzHdr, SIGNAL(sectionClicked(int)), this, SLOT(headerClicked(int)));
+    //the J1939 / GMLAN ID columns sit with the other short ones ahead of ASCII and data. Right click the header for them
+    for (int col = static_cast<int>(Column::Priority); col <= static_cast<int>(Column::GMLanSender); col++)
+        HorzHdr->moveSection(HorzHdr->visualIndex(col), HorzHdr->visualIndex(static_cast<int>(Column::ASCII)));
+    HorzHdr->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(HorzHdr, &QHeaderView::customContextMenuRequested, this, &MainWindow::headerContextMenuRequest);
+    showIdColumns();
 
     lastGraphingWindow = nullptr;
     frameInfoWindow = nullptr;
@@ -85,8 +142,15 @@ MainWindow::MainWindow(QWidget *parent) :
     connectionWindow = nullptr;
     scriptingWindow = nullptr;
     rangeWindow = nullptr;
+    correlationWindow = nullptr;
+    counterChecksumWindow = nullptr;
+    errorStatsWindow = nullptr;
+    latencyWindow = nullptr;
+    nodeLoadWindow = nullptr;
+    queryWindow = nullptr;
     dbcFileWindow = nullptr;
     fuzzingWindow = nullptr;
+    restbusWindow = nullptr;
     udsScanWindow = nullptr;
     motorctrlConfigWindow = nullptr;
     isoWindow = nullptr;
@@ -96,7 +160,15 @@ MainWindow::MainWindow(QWidget *parent) :
     temporalGraphWindow = nullptr;
     dbcComparatorWindow = nullptr;
     canBridgeWindow = nullptr;
+    triggeredCaptureWindow = nullptr;
+    frameSearchDialog = nullptr;
+    captureAgent = nullptr;
+    sharedCaptureHub = nullptr;
+    frameServer = nullptr;
     dbcHandler = DBCHandler::getReference();
+    //DBCs from the last session load in the background. Decoding picks each one up as it arrives
+    connect(dbcHandler, &DBCHandler::fileLoaded, this, &MainWindow::DBCSettingsUpdated);
+    connect(dbcHandler, &DBCHandler::fileReloaded, this, &MainWindow::DBCFileReloaded);
     bDirty = false;
     inhibitFilterUpdate = false;
     rxFrames = 0;
@@ -107,10 +179,17 @@ MainWindow::MainWindow(QWidget *parent) :
     //handlers for all menu entries
     connect(ui->actionSetup, SIGNAL(triggered(bool)), SLOT(showConnectionSettingsWindow()));
     connect(ui->actionOpen_Log_File, &QAction::triggered, this, &MainWindow::handleLoadFile);
+    connect(ui->actionLoad_Part_of_Log_File, &QAction::triggered, this, &MainWindow::handleLoadPartialFile);
+    connect(ui->actionLoad_Multiple_Log_Files, &QAction::triggered, this, &MainWindow::handleLoadMultipleFiles);
     connect(ui->actionGraph_Dta, &QAction::triggered, this, &MainWindow::showGraphingWindow);
+    connect(ui->actionFrame_View, &QAction::triggered, this, &MainWindow::showFrameViewWindow);
+    connect(ui->actionQuery_Frames, &QAction::triggered, this, &MainWindow::showQueryWindow);
     connect(ui->actionFrame_Data_Analysis, &QAction::triggered, this, &MainWindow::showFrameDataAnalysis);
     connect(ui->actionSave_Log_File, &QAction::triggered, this, &MainWindow::handleSaveFile);
+    connect(ui->actionSave_Workspace, &QAction::triggered, this, &MainWindow::handleSaveWorkspace);
+    connect(ui->actionOpen_Workspace, &QAction::triggered, this, &MainWindow::handleOpenWorkspace);
     connect(ui->actionSave_Filtered_Log_File, &QAction::triggered, this, &MainWindow::handleSaveFilteredFile);
+    connect(ui->actionSave_Range_of_Log_File, &QAction::triggered, this, &MainWindow::handleSaveRangeFile);
     connect(ui->actionLoad_Filter_Definition, &QAction::triggered, this, &MainWindow::handleLoadFilters);
     connect(ui->actionSave_Filter_Definition, &QAction::triggered, this, &MainWindow::handleSaveFilters);
     connect(ui->action_Playback, &QAction::triggered, this, &MainWindow::showPlaybackWindow);
@@ -119,6 +198,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionExit_Application, &QAction::triggered, this, &MainWindow::exitApp);
     connect(ui->actionFuzzy_Scope, &QAction::triggered, this, &MainWindow::showFuzzyScopeWindow);
     connect(ui->actionRange_State_2, &QAction::triggered, this, &MainWindow::showRangeWindow);
+    connect(ui->actionSignal_Correlation, &QAction::triggered, this, &MainWindow::showCorrelationWindow);
+    connect(ui->actionCounters_Checksums, &QAction::triggered, this, &MainWindow::showCounterChecksumWindow);
+    connect(ui->actionBus_Errors, &QAction::triggered, this, &MainWindow::showErrorStatsWindow);
+    connect(ui->actionResponse_Latency, &QAction::triggered, this, &MainWindow::showLatencyWindow);
+    connect(ui->actionNode_Load, &QAction::triggered, this, &MainWindow::showNodeLoadWindow);
     connect(ui->actionSave_Decoded_Frames, &QAction::triggered, this, &MainWindow::handleSaveDecoded);
     connect(ui->actionSave_Decoded_Frames_CSV, &QAction::triggered, this, &MainWindow::handleSaveDecodedCsv);
     connect(ui->actionSingle_Multi_State_2, &QAction::triggered, this, &MainWindow::showSingleMultiWindow);
@@ -129,6 +213,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionFirmware_Update, &QAction::triggered, this, &MainWindow::showFirmwareUploaderWindow);
     connect(ui->actionDBC_File_Manager, &QAction::triggered, this, &MainWindow::showDBCFileWindow);
     connect(ui->actionFuzzing, &QAction::triggered, this, &MainWindow::showFuzzingWindow);
+    connect(ui->actionRestbus, &QAction::triggered, this, &MainWindow::showRestbusWindow);
     connect(ui->actionUDS_Scanner, &QAction::triggered, this, &MainWindow::showUDSScanWindow);
     connect(ui->actionISO_TP_Decoder, &QAction::triggered, this, &MainWindow::showISOInterpreterWindow);
     connect(ui->actionSniffer, &QAction::triggered, this, &MainWindow::showSnifferWindow);
@@ -136,14 +221,32 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionCapture_Bisector, &QAction::triggered, this, &MainWindow::showBisectWindow);
     connect(ui->actionSignal_Viewer, &QAction::triggered, this, &MainWindow::showSignalViewer);
     connect(ui->actionSave_Continuous_Logfile, &QAction::triggered, this, &MainWindow::handleContinousLogging);
+    connect(ui->actionCapture_Only, &QAction::toggled, this, &MainWindow::handleCaptureOnly);
+    connect(ui->actionPipeline_Trace, &QAction::toggled, this, &MainWindow::handlePipelineTrace);
+    if (!PipelineTrace::isCompiledIn())
+    {
+        ui->actionPipeline_Trace->setEnabled(false);
+        ui->actionPipeline_Trace->setToolTip(tr("Only in builds made with qmake CONFIG+=pipeline_trace"));
+    }
+    connect(ui->actionMemory_Usage, &QAction::triggered, this, &MainWindow::showMemoryUsage);
     connect(ui->actionTemporal_Graph, &QAction::triggered, this, &MainWindow::showTemporalGraphWindow);
+    connect(ui->actionSearch_Payloads, &QAction::triggered, this, &MainWindow::showFrameSearch);
     connect(ui->actionCAN_Bridge, &QAction::triggered, this, &MainWindow::showCANBridgeWindow);
+    connect(ui->actionTriggered_Capture, &QAction::triggered, this, &MainWindow::showTriggeredCaptureWindow);
+    connect(ui->actionServe_Capture, &QAction::toggled, this, &MainWindow::handleServeCapture);
+    connect(ui->actionShare_Capture, &QAction::toggled, this, &MainWindow::handleShareCapture);
+    connect(ui->actionServe_Frames, &QAction::toggled, this, &MainWindow::handleServeFrames);
 
     //handlers fror interactions with the main can frame view table
     connect(ui->canFramesView, &QAbstractItemView::clicked, this, &MainWindow::gridClicked);
     connect(ui->canFramesView, &QAbstractItemView::doubleClicked, this, &MainWindow::gridDoubleClicked);
     ui->canFramesView->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(ui->canFramesView, &QAbstractItemView::customContextMenuRequested, this, &MainWindow::gridContextMenuRequest);
+    connect(ui->canFramesView->verticalScrollBar(), &QScrollBar::valueChanged, this, &MainWindow::prefetchVisibleRows);
+    connect(ui->canFramesView->verticalScrollBar(), &QScrollBar::valueChanged, this, [this]()
+    {
+        if (rowExpansionActive) sizeVisibleRows();
+    });
 
     connect(model, &CANFrameModel::updatedFiltersList, this, &MainWindow::updateFilterList);
     connect(CANConManager::getInstance(), &CANConManager::framesReceived, model, &CANFrameModel::addFrames);
@@ -152,8 +255,16 @@ MainWindow::MainWindow(QWidget *parent) :
 
     connect(ui->cbInterpret, &QAbstractButton::toggled, this, &MainWindow::interpretToggled);
     connect(ui->cbOverwrite, &QAbstractButton::toggled, this, &MainWindow::overwriteToggled);
+    connect(ui->cbChangesOnly, &QAbstractButton::toggled, model, &CANFrameModel::setChangesOnlyMode);
+    connect(ui->lineChangeMask, &QLineEdit::editingFinished,
+            [=]()
+            {
+                //hex bytes, anything that isn't a hex digit (spaces, commas) gets skipped
+                QByteArray mask = QByteArray::fromHex(ui->lineChangeMask->text().toLatin1());
+                if (mask != model->getChangeIgnoreMask()) model->setChangeIgnoreMask(mask);
+            });
     connect(ui->cbPersistentFilters, &QAbstractButton::toggled, this, &MainWindow::presistentFiltersToggled);
-    connect(ui->listFilters, &QListWidget::itemChanged, this, &MainWindow::filterListItemChanged);
+    connect(filterListModel, &FilterListModel::filterToggled, this, &MainWindow::filterToggled);
     connect(ui->listBusFilters, &QListWidget::itemChanged, this, &MainWindow::busFilterListItemChanged);
 
     connect(ui->btnCaptureToggle, &QAbstractButton::clicked, this, &MainWindow::toggleCapture);
@@ -161,10 +272,22 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->btnNormalize, &QAbstractButton::clicked, this, &MainWindow::normalizeTiming);
     connect(ui->btnFilterAll, &QAbstractButton::clicked, this, &MainWindow::filterSetAll);
     connect(ui->btnFilterNone, &QAbstractButton::clicked, this, &MainWindow::filterClearAll);
+    connect(ui->lineFilterExpression, &QLineEdit::editingFinished, this, &MainWindow::filterExpressionChanged);
+    filterExpressionHint = ui->lineFilterExpression->toolTip();
     connect(ui->btnExpandAll, &QAbstractButton::clicked, this, &MainWindow::expandAllRows);
     connect(ui->btnCollapseAll, &QAbstractButton::clicked, this, &MainWindow::collapseAllRows);
 
-    connect(ui->tableSimpleSender, SIGNAL(cellChanged(int,int)), this, SLOT(onSenderCellChanged(int,int)));
+    QStringList headers;
+    headers << "En" << "Bus" << "ID" << "Ext" << "Rem" << "Data"
+            << "Interval" << "Count";
+    QVector<SendGridModel::ColumnKind> kinds;
+    kinds << SendGridModel::CheckColumn << SendGridModel::TextColumn << SendGridModel::TextColumn
+          << SendGridModel::CheckColumn << SendGridModel::CheckColumn << SendGridModel::TextColumn
+          << SendGridModel::TextColumn << SendGridModel::CountColumn;
+    senderGrid = new SendGridModel(headers, kinds, this);
+    senderGrid->setCountSource([this](int row) { return frameSender->sendCount(row); });
+    ui->tableSimpleSender->setModel(senderGrid);
+    connect(senderGrid, &SendGridModel::cellEdited, this, &MainWindow::processSenderCellChange);
 
     lbStatusConnected.setText(tr("Connected to 0 buses"));
     lbHelp.setText(tr("Press F1 on any screen for help"));
@@ -188,8 +311,12 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->listFilters->horizontalScrollBar()->setEnabled(false);
 
     connect(&updateTimer, &QTimer::timeout, this, &MainWindow::tickGUIUpdate);
-    updateTimer.setInterval(250);
+    updateTimer.setInterval(GUI_TICK_MIN_MS);
     updateTimer.start();
+    paintNsSinceTick = 0;
+    tickCostMs = 0.0;
+    shownRowCount = 0;
+    shownFPS = 0;
 
     elapsedTime = new QElapsedTimer;
     elapsedTime->start();
@@ -229,10 +356,6 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->actionMotorControlConfig->setVisible(false);
     ui->actionSingle_Multi_State_2->setVisible(false);
 
-    QStringList headers;
-    headers << "En" << "Bus" << "ID" << "Ext" << "Rem" << "Data"
-            << "Interval" << "Count";
-    ui->tableSimpleSender->setColumnCount(8);
     ui->tableSimpleSender->setColumnWidth(SIMP_COL::SC_COL_EN, 70);
     ui->tableSimpleSender->setColumnWidth(SIMP_COL::SC_COL_BUS, 70);
     ui->tableSimpleSender->setColumnWidth(SIMP_COL::SC_COL_ID, 70);
@@ -241,9 +364,6 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->tableSimpleSender->setColumnWidth(SIMP_COL::SC_COL_DATA, 300);
     ui->tableSimpleSender->setColumnWidth(SIMP_COL::SC_COL_INTERVAL, 100);
     ui->tableSimpleSender->setColumnWidth(SIMP_COL::SC_COL_COUNT, 100);
-    ui->tableSimpleSender->setHorizontalHeaderLabels(headers);
-
-    createSenderRow();
 
     frameSender = new FrameSenderObject(model->getListReference());
 
@@ -257,6 +377,7 @@ MainWindow::~MainWindow()
 {
     updateTimer.stop();
     frameSender->stopSending();
+    if (continuousLogging) FrameFileIO::closeContinuousNative(); //lets the writer thread finish the file
     killEmAll(); //Ride the lightning
     delete ui;
     delete model;
@@ -272,6 +393,10 @@ void MainWindow::killEmAll()
     {
         killWindow(win);
     }
+    foreach (FrameViewWindow *win, frameViewWindows)
+    {
+        killWindow(win);
+    }
     killWindow(frameInfoWindow);
     killWindow(playbackWindow);
     killWindow(flowViewWindow);
@@ -282,8 +407,16 @@ void MainWindow::killEmAll()
     killWindow(discreteStateWindow);
     killWindow(scriptingWindow);
     killWindow(rangeWindow);
+    killWindow(correlationWindow);
+    killWindow(counterChecksumWindow);
+    killWindow(errorStatsWindow);
+    killWindow(latencyWindow);
+    killWindow(nodeLoadWindow);
+    killWindow(queryWindow);
     killWindow(dbcFileWindow);
     killWindow(fuzzingWindow);
+    killWindow(restbusWindow);
+    RestbusEngine::getReference()->stop(); //sends on its own, it mustn't outlive the connections
     killWindow(udsScanWindow);
     killWindow(isoWindow);
     killWindow(snifferWindow);
@@ -293,6 +426,7 @@ void MainWindow::killEmAll()
     killWindow(signalViewerWindow);
     killWindow(temporalGraphWindow);
     killWindow(canBridgeWindow);
+    killWindow(triggeredCaptureWindow);
 
     //trying to kill this window can cause a fault to happen. It's closed last just in case.
     killWindow(connectionWindow);
@@ -426,11 +560,14 @@ void MainWindow::readUpdateableSettings()
     model->setTimeStyle(ts);
 
     useFiltered = settings.value("Main/UseFiltered", false).toBool();
+    useHardwareFilters = settings.value("Main/HardwareFilters", false).toBool();
     model->setTimeFormat(settings.value("Main/TimeFormat", "MMM-dd HH:mm:ss.zzz").toString());
     ignoreDBCColors = settings.value("Main/IgnoreDBCColors", false).toBool();
     model->setIgnoreDBCColors(ignoreDBCColors);
     int bpl = settings.value("Main/BytesPerLine", 8).toInt();
     model->setBytesPerLine(bpl);
+    model->setRetention(settings.value("Main/RetentionSeconds", 0).toInt(), settings.value("Main/RetentionMB", 0).toInt(),
+                        settings.value("Main/RetentionSpill", false).toBool());
 
     CSVAbsTime = settings.value("Main/CSVAbsTime", false).toBool();
 
@@ -438,7 +575,9 @@ void MainWindow::readUpdateableSettings()
         ui->listFilters->setMaximumWidth(250);
     else
         ui->listFilters->setMaximumWidth(175);
+    filterListModel->relabel();
     updateFilterList();    
+    updateHardwareFilters();
 }    
 
 
@@ -462,18 +601,6 @@ void MainWindow::writeSettings()
     }
 }
 
-void MainWindow::onSenderCellChanged(int row, int col)
-{
-    if (inhibitSenderChanged) return;
-    qDebug() << "onCellChanged";
-    if (row == ui->tableSimpleSender->rowCount() - 1)
-    {
-        createSenderRow();
-    }
-
-    processSenderCellChange(row, col);
-}
-
 void MainWindow::processSenderCellChange(int line, int col)
 {
     qDebug() << "processSenderCellChange";
@@ -507,7 +634,7 @@ void MainWindow::processSenderCellChange(int line, int col)
     switch (col)
     {
     case SIMP_COL::SC_COL_EN: //Enable check box
-        if (ui->tableSimpleSender->item(line, 0)->checkState() == Qt::Checked)
+        if (senderGrid->isChecked(line, SIMP_COL::SC_COL_EN))
         {
             tempData->enabled = true;
         }
@@ -515,34 +642,32 @@ void MainWindow::processSenderCellChange(int line, int col)
         qDebug() << "Setting enabled to " << tempData->enabled;
         break;
     case SIMP_COL::SC_COL_BUS: //Bus designation
-        tempVal = Utility::ParseStringToNum(ui->tableSimpleSender->item(line, SIMP_COL::SC_COL_BUS)->text());
+        tempVal = Utility::ParseStringToNum(senderGrid->text(line, SIMP_COL::SC_COL_BUS));
         if (tempVal < -1) tempVal = -1;
         if (tempVal >= numBuses) tempVal = numBuses - 1;
         tempData->bus = tempVal;
         qDebug() << "Setting bus to " << tempVal;
         break;
     case SIMP_COL::SC_COL_ID: //ID field
-        tempVal = Utility::ParseStringToNum(ui->tableSimpleSender->item(line, SIMP_COL::SC_COL_ID)->text());
+        tempVal = Utility::ParseStringToNum(senderGrid->text(line, SIMP_COL::SC_COL_ID));
         if (tempVal < 0) tempVal = 0;
         if (tempVal > 0x7FFFFFFF) tempVal = 0x7FFFFFFF;
         tempData->setFrameId(tempVal);
         if (tempData->frameId() > 0x7FF) {
             tempData->setExtendedFrameFormat(true);
-            ui->tableSimpleSender->blockSignals(true);
-            ui->tableSimpleSender->item(line, ST_COLS::SENDTAB_COL_EXT)->setCheckState(Qt::Checked);
-            ui->tableSimpleSender->blockSignals(false);
+            senderGrid->setChecked(line, SIMP_COL::SC_COL_EXT, true);
         }
         qDebug() << "setting ID to " << tempVal;
         break;
     case SIMP_COL::SC_COL_EXT:
-        if (ui->tableSimpleSender->item(line, SIMP_COL::SC_COL_EXT)->checkState() == Qt::Checked) {
+        if (senderGrid->isChecked(line, SIMP_COL::SC_COL_EXT)) {
             tempData->setExtendedFrameFormat(true);
         } else {
             tempData->setExtendedFrameFormat(false);
         }
         break;
     case SIMP_COL::SC_COL_REM:
-        if (ui->tableSimpleSender->item(line, SIMP_COL::SC_COL_REM)->checkState() == Qt::Checked) {
+        if (senderGrid->isChecked(line, SIMP_COL::SC_COL_REM)) {
             tempData->setFrameType(QCanBusFrame::RemoteRequestFrame);
         } else {
             tempData->setFrameType(QCanBusFrame::DataFrame);
@@ -552,9 +677,9 @@ void MainWindow::processSenderCellChange(int line, int col)
         for (int i = 0; i < 8; i++) tempData->payload().data()[i] = 0;
 
 #if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
-        tokens = ui->tableSimpleSender->item(line, SIMP_COL::SC_COL_DATA)->text().split(" ", Qt::SkipEmptyParts);
+        tokens = senderGrid->text(line, SIMP_COL::SC_COL_DATA).split(" ", Qt::SkipEmptyParts);
 #else
-        tokens = ui->tableSimpleSender->item(line, SIMP_COL::SC_COL_DATA)->text().split(" ", QString::SkipEmptyParts);
+        tokens = senderGrid->text(line, SIMP_COL::SC_COL_DATA).split(" ", QString::SkipEmptyParts);
 #endif
         arr.clear();
         arr.reserve(tokens.count());
@@ -566,7 +691,7 @@ void MainWindow::processSenderCellChange(int line, int col)
         break;
     case SIMP_COL::SC_COL_INTERVAL: //interval in ms
 
-        QString trigger = ui->tableSimpleSender->item(line, SIMP_COL::SC_COL_INTERVAL)->text().toUpper();
+        QString trigger = senderGrid->text(line, SIMP_COL::SC_COL_INTERVAL).toUpper();
 
         Trigger thisTrigger;
         thisTrigger.bus = -1; //-1 means we don't care which
@@ -593,38 +718,8 @@ void MainWindow::processSenderCellChange(int line, int col)
 
         break;
     }
-}
-
-void MainWindow::createSenderRow()
-{
-    int row = ui->tableSimpleSender->rowCount();
-    ui->tableSimpleSender->insertRow(row);
-
-    QTableWidgetItem *item = new QTableWidgetItem();
-    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-    item->setCheckState(Qt::Unchecked);
-    inhibitSenderChanged = true;
-    ui->tableSimpleSender->setItem(row, SIMP_COL::SC_COL_EN, item);
-
-    item = new QTableWidgetItem();
-    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-    item->setCheckState(Qt::Unchecked);
-    ui->tableSimpleSender->setItem(row, SIMP_COL::SC_COL_EXT, item);
-
-    item = new QTableWidgetItem();
-    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-    item->setCheckState(Qt::Unchecked);
-    ui->tableSimpleSender->setItem(row, SIMP_COL::SC_COL_REM, item);
 
-    for (int i = 1; i <= SIMP_COL::SC_COL_COUNT; i++)
-    {
-        if (i != SIMP_COL::SC_COL_EXT && i != SIMP_COL::SC_COL_REM) {
-            item = new QTableWidgetItem("");
-            ui->tableSimpleSender->setItem(row, i, item);
-        }
-    }
-
-    inhibitSenderChanged = false;
+    frameSender->sendRecordChanged(line);
 }
 
 void MainWindow::updateConnectionSettings(QString connectionType, QString port, int speed0, int speed1)
@@ -652,69 +747,108 @@ void MainWindow::headerClicked(int logicalIndex)
     manageRowExpansion();
 }
 
-void MainWindow::expandAllRows()
+void MainWindow::headerContextMenuRequest(QPoint pos)
 {
-    bool goAhead = false;
-    int numRows = ui->canFramesView->model()->rowCount();
-
-    if (numRows > 20000)
+    QSettings settings;
+    QMenu *menu = new QMenu(this);
+    menu->setAttribute(Qt::WA_DeleteOnClose);
+    QAction *j1939 = menu->addAction(tr("J1939 Columns (Priority, PGN, Source, Destination)"));
+    j1939->setCheckable(true);
+    j1939->setChecked(settings.value("Main/J1939Columns", false).toBool());
+    connect(j1939, &QAction::toggled, [this](bool on)
     {
-        QMessageBox::StandardButton confirmDialog;
-        confirmDialog = QMessageBox::question(this, "Really?", "It's not recommended to use this\non more than 20000 frames.\nIt can take a long time.\n\nYou have been warned!\nStill do it?",
-                                  QMessageBox::Yes|QMessageBox::No);
-
-        if (confirmDialog == QMessageBox::Yes) goAhead = true;
-    }
-    else goAhead = true;
-
-    if (goAhead)
+        QSettings().setValue("Main/J1939Columns", on);
+        showIdColumns();
+    });
+    QAction *gmlan = menu->addAction(tr("GMLAN Columns (Priority, Arbitration ID, Sender)"));
+    gmlan->setCheckable(true);
+    gmlan->setChecked(settings.value("Main/GMLanColumns", false).toBool());
+    connect(gmlan, &QAction::toggled, [this](bool on)
     {
-        ui->canFramesView->resizeRowsToContents();
+        QSettings().setValue("Main/GMLanColumns", on);
+        showIdColumns();
+    });
+    menu->popup(ui->canFramesView->horizontalHeader()->mapToGlobal(pos));
+}
 
-        rowExpansionActive = true;
-    }
+void MainWindow::showIdColumns()
+{
+    QSettings settings;
+    bool j1939 = settings.value("Main/J1939Columns", false).toBool();
+    bool gmlan = settings.value("Main/GMLanColumns", false).toBool();
+    ui->canFramesView->setColumnHidden(static_cast<int>(Column::Priority), !j1939 && !gmlan);
+    ui->canFramesView->setColumnHidden(static_cast<int>(Column::PGN), !j1939);
+    ui->canFramesView->setColumnHidden(static_cast<int>(Column::Source), !j1939);
+    ui->canFramesView->setColumnHidden(static_cast<int>(Column::Dest), !j1939);
+    ui->canFramesView->setColumnHidden(static_cast<int>(Column::GMLanArb), !gmlan);
+    ui->canFramesView->setColumnHidden(static_cast<int>(Column::GMLanSender), !gmlan);
+}
+
+void MainWindow::expandAllRows()
+{
+    rowExpansionActive = true;
+    sizeVisibleRows();
 }
 
 void MainWindow::manageRowExpansion()
 {
-    int numRows = ui->canFramesView->model()->rowCount();
-    if(numRows < 20000)
-    {
-        if(rowExpansionActive && model->getInterpretMode())
-            ui->canFramesView->resizeRowsToContents();
+    if (rowExpansionActive) sizeVisibleRows();
+}
+
+/*
+ * Expanded rows are as tall as the model says their data column is (CANFrameModel::dataLines), so nothing gets
+ * measured. Only the rows on screen are looked at, the rest get sized once they're scrolled to. While those all
+ * come out the same height that just becomes the default height for every row, which costs nothing per row,
+ * and only once they differ do rows get heights of their own.
+ */
+void MainWindow::sizeVisibleRows()
+{
+    QTableView *view = ui->canFramesView;
+    QHeaderView *header = view->verticalHeader();
+    int rows = view->model()->rowCount();
+    int first = view->rowAt(0);
+    if (rows == 0 || first < 0) return;
+
+    QSortFilterProxyModel *proxy = qobject_cast<QSortFilterProxyModel *>(view->model());
+    int lineSpacing = QFontMetrics(view->font()).lineSpacing();
+    int viewHeight = view->viewport()->height();
+
+    QVector<int> heights;
+    bool uniform = true;
+    int y = header->sectionViewportPosition(first);
+    for (int row = first; row < rows && y < viewHeight; row++)
+    {
+        int src = proxy ? proxy->mapToSource(proxy->index(row, 0)).row() : row;
+        int height = normalRowHeight + (model->dataLines(src) - 1) * lineSpacing;
+        if (!heights.isEmpty() && height != heights.first()) uniform = false;
+        heights.append(height);
+        y += height;
+    }
+    if (heights.isEmpty()) return;
+
+    if (uniform && !rowsSizedSingly)
+    {
+        if (header->defaultSectionSize() != heights.first()) header->setDefaultSectionSize(heights.first());
+        return;
     }
-    else
+    for (int i = 0; i < heights.count(); i++)
     {
-        disableAutoRowExpansion();
+        if (view->rowHeight(first + i) != heights.at(i)) view->setRowHeight(first + i, heights.at(i));
     }
+    rowsSizedSingly = true;
 }
 
+//every row back to one line. Setting the default height sets it for each row, no need to go through them
 void MainWindow::disableAutoRowExpansion()
 {
     rowExpansionActive = false;
+    rowsSizedSingly = false;
+    ui->canFramesView->verticalHeader()->setDefaultSectionSize(normalRowHeight);
 }
 
 void MainWindow::collapseAllRows()
 {
-    bool goAhead = false;
-    int numRows = ui->canFramesView->model()->rowCount();
-
-    if (numRows > 50000)
-    {
-        QMessageBox::StandardButton confirmDialog;
-        confirmDialog = QMessageBox::question(this, "Really?", "It's not recommended to use this\non more than 50000 frames.\nIt can take a long time.\n\nYou have been warned!\nStill do it?",
-                                  QMessageBox::Yes|QMessageBox::No);
-
-        if (confirmDialog == QMessageBox::Yes) goAhead = true;
-    }
-    else goAhead = true;
-
-    if (goAhead)
-    {
-        for (int i = 0; i < numRows; i++) ui->canFramesView->setRowHeight(i, normalRowHeight);
-
-        rowExpansionActive = false;
-    }
+    disableAutoRowExpansion();
 }
 
 void MainWindow::gridClicked(QModelIndex idx)
@@ -725,8 +859,12 @@ void MainWindow::gridClicked(QModelIndex idx)
         ui->canFramesView->setRowHeight(idx.row(), normalRowHeight);
     }
     else {
-        ui->canFramesView->resizeRowToContents(idx.row());
+        QSortFilterProxyModel *proxy = qobject_cast<QSortFilterProxyModel *>(ui->canFramesView->model());
+        int src = proxy ? proxy->mapToSource(idx).row() : idx.row();
+        int lineSpacing = QFontMetrics(ui->canFramesView->font()).lineSpacing();
+        ui->canFramesView->setRowHeight(idx.row(), normalRowHeight + (model->dataLines(src) - 1) * lineSpacing);
     }
+    rowsSizedSingly = true;
 }
 
 void MainWindow::gridDoubleClicked(QModelIndex idx)
@@ -870,48 +1008,43 @@ void MainWindow::presistentFiltersToggled(bool state)
     }
 }
 
+/*
+ * New IDs, a cleared capture, a loaded filter file and the GUI tick all land here, often several in a row. They
+ * all get handled together once control gets back to the event loop.
+ */
 void MainWindow::updateFilterList()
 {
-    if (model == nullptr) return;
-    const QMap<int, bool> *filters = model->getFiltersReference();
-    const QMap<int, bool> *busFilters = model->getBusFiltersReference();
-    if (filters == nullptr || busFilters == nullptr) return;
+    if (model == nullptr || filterListsPending) return;
+    filterListsPending = true;
+    QTimer::singleShot(0, this, &MainWindow::refreshFilterLists);
+}
 
-    qDebug() << "updateFilterList called on MainWindow";
+void MainWindow::refreshFilterLists()
+{
+    filterListsPending = false;
+    const CANFilterTable *table = model->getFilterTable();
+    if (table == nullptr) return;
 
-    inhibitFilterUpdate = true;
+    //the ID list only takes in the IDs it hasn't seen
+    filterListModel->sync();
 
-    ui->listFilters->clear();
+    //there are only ever a handful of buses so that list is still just rebuilt
+    const QMap<int, bool> buses = table->buses();
+    inhibitFilterUpdate = true;
     ui->listBusFilters->clear();
-
-    if (filters->isEmpty()) return;
-
-    QMap<int, bool>::const_iterator filterIter;
-    for (filterIter = filters->begin(); filterIter != filters->end(); ++filterIter)
-    {
-        /*QListWidgetItem *thisItem = */FilterUtility::createCheckableFilterItem(filterIter.key(), filterIter.value(), ui->listFilters);
-    }
-
-    if (busFilters->isEmpty()) return;
-
-    for (filterIter = busFilters->begin(); filterIter != busFilters->end(); ++filterIter)
+    for (QMap<int, bool>::const_iterator filterIter = buses.begin(); filterIter != buses.end(); ++filterIter)
     {
         /*QListWidgetItem *thisItem = */ FilterUtility::createCheckableBusFilterItem(filterIter.key(), filterIter.value(), ui->listBusFilters);
     }
     inhibitFilterUpdate = false;
 }
 
-void MainWindow::filterListItemChanged(QListWidgetItem *item)
+//the filter list model already told the frame model
+void MainWindow::filterToggled(uint32_t id, bool on)
 {
-    if (inhibitFilterUpdate) return;
-    //qDebug() << item->text();
-
-    // strip away possible filter label
-    int ID = FilterUtility::getIdAsInt(item);
-    bool isSet = false;
-    if (item->checkState() == Qt::Checked) isSet = true;
-
-    model->setFilterState(ID, isSet);
+    Q_UNUSED(id);
+    Q_UNUSED(on);
+    updateHardwareFilters();
 
     manageRowExpansion();
 }
@@ -933,32 +1066,75 @@ void MainWindow::busFilterListItemChanged(QListWidgetItem *item)
 
 void MainWindow::filterSetAll()
 {
-    inhibitFilterUpdate = true;
-    for (int i = 0; i < ui->listFilters->count(); i++)
-    {
-        ui->listFilters->item(i)->setCheckState(Qt::Checked);
-    }
-    inhibitFilterUpdate = false;
     model->setAllFilters(true);
+    filterListModel->sync();
+    updateHardwareFilters();
 
     manageRowExpansion();
 }
 
 void MainWindow::filterClearAll()
 {
-    inhibitFilterUpdate = true;
-    for (int i = 0; i < ui->listFilters->count(); i++)
-    {
-        ui->listFilters->item(i)->setCheckState(Qt::Unchecked);
-    }
-    inhibitFilterUpdate = false;
     model->setAllFilters(false);
+    filterListModel->sync();
+    updateHardwareFilters();
+}
+
+void MainWindow::filterExpressionChanged()
+{
+    QString text = ui->lineFilterExpression->text();
+    //editingFinished comes again when focus leaves, don't refilter for that
+    if (text.trimmed() == model->getFilterExpression() && ui->lineFilterExpression->toolTip() == filterExpressionHint) return;
+    QString error;
+    bool ok = model->setFilterExpression(text, error);
+    //a bad expression leaves the last good one in place and says what's wrong with this one
+    QPalette pal = ui->lineFilterExpression->palette();
+    pal.setColor(QPalette::Text, ok ? QApplication::palette().color(QPalette::Text) : QColor(Qt::red));
+    ui->lineFilterExpression->setPalette(pal);
+    ui->lineFilterExpression->setToolTip(ok ? filterExpressionHint : error);
+    if (ok) manageRowExpansion();
+}
+
+/*
+ * With hardware filtering turned on the IDs that are switched on become device acceptance filters so the rest don't
+ * even make it to the host. Filtered out frames aren't captured at all then, which is why it's an option. Nothing
+ * switched off means there's nothing to gain and everything switched off is left to the software filtering rather
+ * than silencing the bus. Devices that can't express the filters just keep passing everything.
+ */
+void MainWindow::updateHardwareFilters()
+{
+    QVector<CANAcceptanceFilter> accepted;
+    if (useHardwareFilters)
+    {
+        const QMap<int, bool> ids = model->getFilterTable()->ids();
+        const QMap<int, bool> *filters = &ids;
+        bool anyOff = false;
+        QMap<int, bool>::const_iterator filterIter;
+        for (filterIter = filters->begin(); filterIter != filters->end(); ++filterIter)
+        {
+            if (!filterIter.value())
+            {
+                anyOff = true;
+                continue;
+            }
+            CANAcceptanceFilter accept;
+            accept.id = static_cast<quint32>(filterIter.key());
+            accept.mask = 0x1FFFFFFF;
+            accepted.append(accept);
+        }
+        if (!anyOff) accepted.clear();
+    }
+
+    int filtering = CANConManager::getInstance()->setAcceptanceFilters(accepted);
+    if (!accepted.isEmpty()) qDebug() << "Hardware filtering active on" << filtering << "buses";
 }
 
-void MainWindow::logReceivedFrame(CANConnection* conn, QVector<CANFrame> frames)
+void MainWindow::logReceivedFrame(CANConnection* conn, const QVector<CANFrame>& frames)
 {
+    TRACE_SCOPE("MainWindow::logReceivedFrame");
     Q_UNUSED(conn);
-    if (continuousLogging)
+    //in capture only mode the manager already logged the whole batch, this is just the preview
+    if (continuousLogging && !CANConManager::getInstance()->isCaptureOnly())
     {
         FrameFileIO::writeContinuousNative(&frames, 0);
     }
@@ -966,6 +1142,9 @@ void MainWindow::logReceivedFrame(CANConnection* conn, QVector<CANFrame> frames)
 
 void MainWindow::tickGUIUpdate()
 {
+    TRACE_SCOPE("MainWindow::tickGUIUpdate");
+    QElapsedTimer tickTimer;
+    tickTimer.start();
     rxFrames = model->sendBulkRefresh();
     //if(rxFrames>0)
     //{
@@ -977,22 +1156,32 @@ void MainWindow::tickGUIUpdate()
         else
             framesPerSec = 0;
 
-        ui->lbNumFrames->setText(QString::number(model->rowCount()));
+        //only touch the widgets whose numbers actually changed. Each update is another repaint
+        if (model->rowCount() != shownRowCount)
+        {
+            shownRowCount = model->rowCount();
+            ui->lbNumFrames->setText(QString::number(shownRowCount));
+        }
         if (rxFrames > 0 && /*allowCapture && */ ui->cbAutoScroll->isChecked())
                 ui->canFramesView->scrollToBottom();
-        ui->lbFPS->setText(QString::number(framesPerSec));
+        if (framesPerSec != shownFPS)
+        {
+            shownFPS = framesPerSec;
+            ui->lbFPS->setText(QString::number(framesPerSec));
+        }
         if (rxFrames > 0)
         {
             bDirty = true;
             emit framesUpdated(rxFrames); //anyone care that frames were updated?
             manageRowExpansion();
+            prefetchVisibleRows();
         }
 
         if (model->needsFilterRefresh()) updateFilterList();
 
         if (continuousLogging)
         {
-//            const QVector<CANFrame> *modelFrames = model->getListReference();
+//            const CANFrameStore *modelFrames = model->getListReference();
 //            FrameFileIO::writeContinuousNative(modelFrames, modelFrames->count() - rxFrames);
 
             continuousLogFlushCounter++;
@@ -1004,7 +1193,14 @@ void MainWindow::tickGUIUpdate()
                 }
                 else
                 {
-                    ui->lblContMsg->setText("LOGGING");
+                    ContinuousLogStatus logStatus = FrameFileIO::continuousStatus();
+                    QString text = "LOGGING";
+                    if (CANConManager::getInstance()->isCaptureOnly()) text += tr(" ONLY");
+                    if (logStatus.framesDropped > 0) text += tr(" (%1 dropped)").arg(logStatus.framesDropped);
+                    if (logStatus.failed) text += tr(" - WRITE ERROR");
+                    ui->lblContMsg->setText(text);
+                    ui->lblContMsg->setToolTip(tr("%1\n%2 frames written to %3 file(s)").arg(logStatus.currentFile)
+                                               .arg(logStatus.framesWritten).arg(logStatus.files));
                 }
             }
             if (continuousLogFlushCounter > 8)
@@ -1014,20 +1210,38 @@ void MainWindow::tickGUIUpdate()
             }
         }
 
-        //refresh the count for all the frame senders
-        FrameSendData *tempData;
-        int numRows = ui->tableSimpleSender->rowCount();
-        for (int i = 0; i < numRows; i++)
-        {
-            tempData = frameSender->getSendRecordRef(i);
-            if (tempData)
-            {
-                ui->tableSimpleSender->item(i, SIMP_COL::SC_COL_COUNT)->setText(QString::number( tempData->count ));
-            }
-        }
+        //only the senders whose count moved since the last tick get repainted
+        senderGrid->refreshCounts();
 
         rxFrames = 0;
     //}
+    scheduleNextTick(tickTimer.nsecsElapsed());
+}
+
+/*
+ * Work out when the next tick should be from what this one cost plus the painting since the last one. Smoothed
+ * so one slow tick (a filter list rebuild, a window opening) doesn't throw the rate around.
+ */
+void MainWindow::scheduleNextTick(qint64 tickNs)
+{
+    double costMs = static_cast<double>(tickNs + paintNsSinceTick) / 1000000.0;
+    paintNsSinceTick = 0;
+    tickCostMs = (tickCostMs * 3.0 + costMs) / 4.0;
+
+    int interval = qBound(GUI_TICK_MIN_MS, static_cast<int>(tickCostMs / GUI_TARGET_LOAD), GUI_TICK_MAX_MS);
+    //changing the interval restarts the timer so don't bother over small differences
+    if (qAbs(interval - updateTimer.interval()) > updateTimer.interval() / 8) updateTimer.setInterval(interval);
+}
+
+//all the painting of the window and its widgets happens in its UpdateRequest so that's where to time it
+bool MainWindow::event(QEvent *event)
+{
+    if (event->type() != QEvent::UpdateRequest) return QMainWindow::event(event);
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    bool ret = QMainWindow::event(event);
+    paintNsSinceTick += paintTimer.nsecsElapsed();
+    return ret;
 }
 
 void MainWindow::gotFrames(int framesSinceLastUpdate)
@@ -1057,6 +1271,29 @@ void MainWindow::gotCenterTimeID(uint32_t ID, double timestamp)
     }
 }
 
+//the search dialog picked a frame. It may be filtered out of the list, then there's nothing to show
+void MainWindow::gotoFrameSequence(quint64 sequence)
+{
+    int idx = model->getIndexFromSequence(sequence);
+    if (idx > -1)
+    {
+        ui->canFramesView->selectRow(idx);
+        ui->canFramesView->scrollTo(model->index(idx, 0), QAbstractItemView::PositionAtCenter);
+    }
+    else statusBar()->showMessage(tr("That frame is hidden by the filters"), 4000);
+}
+
+//the overview strip was clicked. Scrolls to the shown frame nearest that time without touching the selection
+void MainWindow::gotoTime(uint64_t stamp)
+{
+    int idx = model->getIndexFromTime(stamp);
+    if (idx < 0) return;
+    QModelIndex index = model->index(idx, 0);
+    QSortFilterProxyModel *proxy = qobject_cast<QSortFilterProxyModel *>(ui->canFramesView->model());
+    if (proxy) index = proxy->mapFromSource(index);
+    ui->canFramesView->scrollTo(index, QAbstractItemView::PositionAtTop);
+}
+
 void MainWindow::clearFrames()
 {
     ui->canFramesView->scrollToTop();
@@ -1079,10 +1316,17 @@ void MainWindow::handleLoadFile()
 {
     QString filename;
     QVector<CANFrame> tempFrames;
+    QString mappedFile;
 
     QMessageBox::StandardButton confirmDialog;
 
-    bool loadResult = FrameFileIO::loadFrameFile(filename, &tempFrames);
+    bool loadResult = FrameFileIO::loadFrameFile(filename, &tempFrames, &mappedFile);
+
+    if (loadResult && !mappedFile.isEmpty())
+    {
+        loadMappedCapture(mappedFile, filename);
+        return;
+    }
 
     if (!loadResult)
     {
@@ -1096,24 +1340,118 @@ void MainWindow::handleLoadFile()
         }
     }
 
-    if (loadResult)
+    if (loadResult) showLoadedFrames(tempFrames, filename);
+}
+
+//replaces whatever was in the frame list with a freshly loaded file
+void MainWindow::showLoadedFrames(QVector<CANFrame> &frames, const QString &displayName)
+{
+    disableAutoRowExpansion();
+    ui->canFramesView->scrollToTop();
+    model->clearFrames();
+    model->insertFrames(frames);
+    loadedFileName = displayName;
+    model->recalcOverwrite();
+    ui->lbNumFrames->setText(QString::number(model->rowCount()));
+    if (ui->cbAutoScroll->isChecked()) ui->canFramesView->scrollToBottom();
+
+    updateFileStatus();
+    emit framesUpdated(-1);
+}
+
+void MainWindow::handleLoadPartialFile()
+{
+    QString filename;
+    QVector<CANFrame> tempFrames;
+
+    bool loadResult = FrameFileIO::loadFrameFilePart(filename, &tempFrames);
+    if (!loadResult && tempFrames.count() > 0)
     {
-        disableAutoRowExpansion();
-        ui->canFramesView->scrollToTop();
-        model->clearFrames();
-        model->insertFrames(tempFrames);
-        loadedFileName = filename;
-        model->recalcOverwrite();
-        ui->lbNumFrames->setText(QString::number(model->rowCount()));
-        if (ui->cbAutoScroll->isChecked()) ui->canFramesView->scrollToBottom();
+        if (QMessageBox::question(this, "Error Loading", "Do you want to salvage what could be loaded?",
+                                  QMessageBox::Yes|QMessageBox::No) == QMessageBox::Yes) loadResult = true;
+    }
 
-        updateFileStatus();
-        emit framesUpdated(-1);
+    if (loadResult) showLoadedFrames(tempFrames, filename);
+}
+
+/*
+ * Several logs of the same session, one per logger or per bus as often as not. They're loaded side by side and
+ * merged into the frame list in time order instead of one after the other. Loggers that each call their bus 0 can
+ * have every file's buses moved up past the ones of the files before it.
+ */
+void MainWindow::handleLoadMultipleFiles()
+{
+    QStringList names;
+    QVector<QVector<CANFrame>> sets;
+    if (!FrameFileIO::loadFrameFiles(names, &sets)) return;
+
+    if (sets.count() > 1 && QMessageBox::question(this, "Load Multiple Log Files",
+                                                  "Give each file its own bus numbers?\r\n"
+                                                  "Pick No if the files already number their buses apart.",
+                                                  QMessageBox::Yes|QMessageBox::No) == QMessageBox::Yes)
+    {
+        int offset = 0;
+        for (QVector<CANFrame> &set : sets)
+        {
+            int highest = -1;
+            for (CANFrame &frame : set)
+            {
+                frame.bus += offset;
+                highest = qMax(highest, frame.bus);
+            }
+            if (highest >= offset) offset = highest + 1;
+        }
+    }
+
+    disableAutoRowExpansion();
+    ui->canFramesView->scrollToTop();
+    model->clearFrames();
+    FrameSetMerge merge(sets);
+    QVector<CANFrame> block;
+    block.reserve(MULTILOAD_MERGE_BLOCK);
+    while (merge.next(block, MULTILOAD_MERGE_BLOCK)) model->insertFrames(block);
+    loadedFileName = names.join(", ");
+    model->recalcOverwrite();
+    ui->lbNumFrames->setText(QString::number(model->rowCount()));
+    if (ui->cbAutoScroll->isChecked()) ui->canFramesView->scrollToBottom();
+
+    updateFileStatus();
+    emit framesUpdated(-1);
+}
+
+//binary captures don't get loaded. The model views them straight out of the mapped file
+void MainWindow::loadMappedCapture(const QString &path, const QString &displayName)
+{
+    disableAutoRowExpansion();
+    ui->canFramesView->scrollToTop();
+    if (!model->loadMappedFile(path))
+    {
+        QMessageBox::warning(this, "Error Loading", "Could not open the binary capture " + displayName);
+        return;
     }
+    loadedFileName = displayName;
+    model->recalcOverwrite();
+    ui->lbNumFrames->setText(QString::number(model->rowCount()));
+    if (ui->cbAutoScroll->isChecked()) ui->canFramesView->scrollToBottom();
+
+    updateFileStatus();
+    emit framesUpdated(-1);
 }
 
 void MainWindow::handleDroppedFile(const QString &filename)
 {
+    if (filename.endsWith(".scw", Qt::CaseInsensitive))
+    {
+        openWorkspace(filename);
+        return;
+    }
+
+    if (FrameFileIO::isBinaryNativeFile(filename))
+    {
+        loadMappedCapture(filename, filename);
+        return;
+    }
+
     QProgressDialog progress(qApp->activeWindow());
     progress.setWindowModality(Qt::WindowModal);
     progress.setLabelText("Loading file...");
@@ -1168,23 +1506,348 @@ void MainWindow::handleSaveFile()
     }
 }
 
+void MainWindow::handleSaveWorkspace()
+{
+    QString filename;
+    QFileDialog dialog(this);
+    QSettings settings;
+
+    QStringList filters;
+    filters.append(QString(tr("SavvyCAN workspace (*.scw)")));
+
+    dialog.setDirectory(settings.value("Workspace/LoadSaveDirectory", dialog.directory().path()).toString());
+    dialog.setFileMode(QFileDialog::AnyFile);
+    dialog.setNameFilters(filters);
+    dialog.setViewMode(QFileDialog::Detail);
+    dialog.setAcceptMode(QFileDialog::AcceptSave);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+    filename = dialog.selectedFiles()[0];
+    if (!filename.contains('.')) filename += ".scw";
+    settings.setValue("Workspace/LoadSaveDirectory", dialog.directory().path());
+
+    WorkspaceState state;
+    state.captureName = loadedFileName;
+    for (int i = 0; i < dbcHandler->getFileCount(); i++)
+    {
+        DBCFile *file = dbcHandler->getFileByIdx(i);
+        WorkspaceDbc dbc;
+        dbc.path = file->getFullFilename();
+        dbc.bus = file->getAssocBus();
+        dbc.compiled = DBCCache::compile(dbc.path, *file);
+        state.dbcFiles.append(dbc);
+    }
+    state.idFilters = model->getFilterTable()->ids();
+    state.busFilters = model->getFilterTable()->buses();
+    state.filterExpression = model->getFilterExpression();
+    state.mainGeometry = saveGeometry();
+    state.mainState = saveState();
+
+    foreach (GraphingWindow *win, graphWindows)
+    {
+        if (!win->isVisible()) continue;
+        WorkspaceWindow saved;
+        saved.name = "Graphing";
+        saved.geometry = win->saveGeometry();
+        QBuffer buffer(&saved.contents);
+        buffer.open(QIODevice::WriteOnly);
+        win->writeDefinitions(buffer);
+        state.windows.append(saved);
+    }
+    for (const ToolWindow &tool : toolWindows())
+    {
+        if (!tool.window || !tool.window->isVisible()) continue;
+        WorkspaceWindow saved;
+        saved.name = tool.name;
+        saved.geometry = tool.window->saveGeometry();
+        state.windows.append(saved);
+    }
+
+    //the index has to be of exactly the frames that get written so both are taken before anything else comes in
+    state.index = model->getListReference()->savedIndex();
+    CANFrameSnapshot frames = model->getListReference()->snapshot();
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool saved = Workspace::save(filename, frames, state);
+    QApplication::restoreOverrideCursor();
+    if (!saved) QMessageBox::warning(this, "Error Saving", "Could not write the workspace " + filename);
+}
+
+void MainWindow::handleOpenWorkspace()
+{
+    QFileDialog dialog(this);
+    QSettings settings;
+
+    QStringList filters;
+    filters.append(QString(tr("SavvyCAN workspace (*.scw)")));
+
+    dialog.setDirectory(settings.value("Workspace/LoadSaveDirectory", dialog.directory().path()).toString());
+    dialog.setFileMode(QFileDialog::ExistingFile);
+    dialog.setNameFilters(filters);
+    dialog.setViewMode(QFileDialog::Detail);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+    settings.setValue("Workspace/LoadSaveDirectory", dialog.directory().path());
+    openWorkspace(dialog.selectedFiles()[0]);
+}
+
+/*
+ * Replaces the frames and DBC files with the workspace's and opens the windows it had open on top of whatever is
+ * already open. The frames stay in the workspace file, mapped, same as viewing a binary capture.
+ */
+void MainWindow::openWorkspace(const QString &filename)
+{
+    WorkspaceState state;
+    QSharedPointer<MappedCapture> capture = Workspace::open(filename, state);
+    if (!capture)
+    {
+        QMessageBox::warning(this, "Error Loading", "Could not open the workspace " + filename);
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    dbcHandler->removeAllFiles();
+    for (const WorkspaceDbc &dbc : state.dbcFiles)
+    {
+        DBCFile *file = dbcHandler->restoreDBCFile(dbc.path, dbc.compiled);
+        if (file) file->setAssocBus(dbc.bus);
+    }
+
+    //set before the frames go in so they only get filtered the once
+    ui->lineFilterExpression->setText(state.filterExpression);
+    filterExpressionChanged();
+
+    disableAutoRowExpansion();
+    ui->canFramesView->scrollToTop();
+    model->loadWorkspaceFrames(capture, state.index, state.idFilters, state.busFilters);
+    loadedFileName = state.captureName.isEmpty() ? filename : state.captureName;
+    model->recalcOverwrite();
+    ui->lbNumFrames->setText(QString::number(model->rowCount()));
+    if (ui->cbAutoScroll->isChecked()) ui->canFramesView->scrollToBottom();
+    updateFileStatus();
+    emit framesUpdated(-1);
+
+    if (!state.mainGeometry.isEmpty()) restoreGeometry(state.mainGeometry);
+    if (!state.mainState.isEmpty()) restoreState(state.mainState);
+    for (const WorkspaceWindow &win : state.windows)
+    {
+        if (win.name == "Graphing")
+        {
+            showGraphingWindow();
+            lastGraphingWindow->restoreGeometry(win.geometry);
+            QBuffer buffer;
+            buffer.setData(win.contents);
+            buffer.open(QIODevice::ReadOnly);
+            lastGraphingWindow->readDefinitions(buffer);
+            continue;
+        }
+        for (const ToolWindow &tool : toolWindows())
+        {
+            if (win.name != tool.name) continue;
+            QMetaObject::invokeMethod(this, tool.opener);
+            break;
+        }
+        //the window only exists once its slot has run
+        for (const ToolWindow &tool : toolWindows())
+        {
+            if (win.name == tool.name && tool.window) tool.window->restoreGeometry(win.geometry);
+        }
+    }
+    QApplication::restoreOverrideCursor();
+}
+
+QVector<MainWindow::ToolWindow> MainWindow::toolWindows() const
+{
+    return {
+        {"FrameInfo", "showFrameDataAnalysis", frameInfoWindow},
+        {"Playback", "showPlaybackWindow", playbackWindow},
+        {"FlowView", "showFlowViewWindow", flowViewWindow},
+        {"FrameSender", "showFrameSenderWindow", frameSenderWindow},
+        {"Restbus", "showRestbusWindow", restbusWindow},
+        {"DiscreteState", "showSingleMultiWindow", discreteStateWindow},
+        {"RangeState", "showRangeWindow", rangeWindow},
+        {"Correlation", "showCorrelationWindow", correlationWindow},
+        {"CounterChecksum", "showCounterChecksumWindow", counterChecksumWindow},
+        {"ErrorStats", "showErrorStatsWindow", errorStatsWindow},
+        {"Latency", "showLatencyWindow", latencyWindow},
+        {"NodeLoad", "showNodeLoadWindow", nodeLoadWindow},
+        {"Query", "showQueryWindow", queryWindow},
+        {"Scripting", "showScriptingWindow", scriptingWindow},
+        {"UDSScan", "showUDSScanWindow", udsScanWindow},
+        {"ISOTP", "showISOInterpreterWindow", isoWindow},
+        {"Sniffer", "showSnifferWindow", snifferWindow},
+        {"Bisect", "showBisectWindow", bisectWindow},
+        {"SignalViewer", "showSignalViewer", signalViewerWindow},
+        {"Temporal", "showTemporalGraphWindow", temporalGraphWindow},
+    };
+}
+
 void MainWindow::handleContinousLogging()
 {
     continuousLogging = !continuousLogging;
 
     if (continuousLogging)
     {
+        if (!FrameFileIO::openContinuousNative())
+        {
+            continuousLogging = false;
+            return;
+        }
         ui->actionSave_Continuous_Logfile->setText(tr("Cease Continuous Logging"));
-        FrameFileIO::openContinuousNative();
     }
     else
     {
         ui->actionSave_Continuous_Logfile->setText(tr("Start Continuous Logging"));
         ui->lblContMsg->setText("");
+        ui->lblContMsg->setToolTip("");
+        ui->actionCapture_Only->setChecked(false); //nothing left for it to write to
         FrameFileIO::closeContinuousNative();
     }
 }
 
+//on starts recording, off stops and asks where to save what was recorded
+//other SavvyCANs connect to this with a Remote Capture Agent connection, see CaptureAgent
+void MainWindow::handleServeCapture(bool enabled)
+{
+    if (!enabled)
+    {
+        delete captureAgent;
+        captureAgent = nullptr;
+        return;
+    }
+
+    QSettings settings;
+    quint16 port = static_cast<quint16>(settings.value("CaptureAgent/Port", CAPTURELINK_PORT).toUInt());
+    if (!captureAgent) captureAgent = new CaptureAgent(this);
+    QString error;
+    if (!captureAgent->start(port, error))
+    {
+        delete captureAgent;
+        captureAgent = nullptr;
+        ui->actionServe_Capture->setChecked(false);
+        QMessageBox::warning(this, tr("Serve Capture"), tr("Could not listen on port %1: %2").arg(port).arg(error));
+    }
+}
+
+//other SavvyCANs on this machine read it with a Local Capture Hub connection, see SharedCaptureHub
+void MainWindow::handleShareCapture(bool enabled)
+{
+    if (!enabled)
+    {
+        delete sharedCaptureHub;
+        sharedCaptureHub = nullptr;
+        return;
+    }
+
+    QSettings settings;
+    QString name = settings.value("SharedCapture/Name", "savvycan").toString();
+    int slots = settings.value("SharedCapture/Slots", SHAREDCAPTURE_SLOTS).toInt();
+    if (!sharedCaptureHub) sharedCaptureHub = new SharedCaptureHub(this);
+    QString error;
+    if (!sharedCaptureHub->start(name, slots, error))
+    {
+        delete sharedCaptureHub;
+        sharedCaptureHub = nullptr;
+        ui->actionShare_Capture->setChecked(false);
+        QMessageBox::warning(this, tr("Share Capture"), tr("Could not share the capture: %1").arg(error));
+    }
+}
+
+//socketcand clients (python-can, socketcandcl, another SavvyCAN's socketcand connection) connect to this, see FrameServer
+void MainWindow::handleServeFrames(bool enabled)
+{
+    if (!enabled)
+    {
+        delete frameServer;
+        frameServer = nullptr;
+        return;
+    }
+
+    QSettings settings;
+    quint16 port = static_cast<quint16>(settings.value("FrameServer/Port", FRAMESERVER_PORT).toUInt());
+    if (!frameServer) frameServer = new FrameServer(this);
+    QString error;
+    if (!frameServer->start(port, error))
+    {
+        delete frameServer;
+        frameServer = nullptr;
+        ui->actionServe_Frames->setChecked(false);
+        QMessageBox::warning(this, tr("Serve Frames"), tr("Could not serve frames on port %1: %2").arg(port).arg(error));
+    }
+}
+
+void MainWindow::handlePipelineTrace(bool enabled)
+{
+    if (enabled)
+    {
+        PipelineTrace::start();
+        return;
+    }
+    PipelineTrace::stop();
+
+    QFileDialog dialog(this);
+    QSettings settings;
+    QStringList filters;
+    filters.append(QString(tr("Chrome trace JSON (*.json)")));
+    filters.append(QString(tr("Perfetto trace (*.perfetto-trace)")));
+    dialog.setFileMode(QFileDialog::AnyFile);
+    dialog.setNameFilters(filters);
+    dialog.setViewMode(QFileDialog::Detail);
+    dialog.setAcceptMode(QFileDialog::AcceptSave);
+    dialog.setDirectory(settings.value("FileIO/LoadSaveDirectory", dialog.directory().path()).toString());
+    if (!dialog.exec() || dialog.selectedFiles().isEmpty()) return;
+
+    QString filename = dialog.selectedFiles()[0];
+    bool perfetto = dialog.selectedNameFilter() == filters[1];
+    if (perfetto && !filename.contains('.')) filename += ".perfetto-trace";
+    if (!perfetto && !filename.contains('.')) filename += ".json";
+    bool ok = perfetto ? PipelineTrace::exportPerfetto(filename) : PipelineTrace::exportChromeJson(filename);
+    if (!ok) QMessageBox::warning(this, tr("Pipeline Trace"), tr("Could not write %1").arg(filename));
+}
+
+//a fresh snapshot every time it's opened, so it isn't kept around as a window
+void MainWindow::showMemoryUsage()
+{
+    MemoryDiagnosticsDialog *dialog = new MemoryDiagnosticsDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
+void MainWindow::showFrameSearch()
+{
+    if (!frameSearchDialog)
+    {
+        frameSearchDialog = new FrameSearchDialog(model, this);
+        connect(frameSearchDialog, &FrameSearchDialog::jumpToFrame, this, &MainWindow::gotoFrameSequence);
+    }
+    frameSearchDialog->show();
+    frameSearchDialog->raise();
+}
+
+//frames skip the model entirely and only get queued for the continuous log, see CANConManager::setCaptureOnly
+void MainWindow::handleCaptureOnly(bool enabled)
+{
+    if (!enabled)
+    {
+        CANConManager::getInstance()->setCaptureOnly(nullptr, 0);
+        return;
+    }
+
+    if (!continuousLogging) handleContinousLogging();
+    if (!continuousLogging)
+    {
+        ui->actionCapture_Only->setChecked(false);
+        return;
+    }
+
+    QSettings settings;
+    int previewEvery = settings.value("Main/CaptureOnlyPreview", 100).toInt();
+    CANConManager::getInstance()->setCaptureOnly([](const QVector<CANFrame> &frames)
+    {
+        FrameFileIO::writeContinuousNative(&frames, 0);
+    }, previewEvery);
+}
+
 void MainWindow::handleSaveFilteredFile()
 {
     QString filename;
@@ -1196,6 +1859,13 @@ void MainWindow::handleSaveFilteredFile()
     }
 }
 
+//a part of the capture, picked by time and ID, saved without touching the frame list's filters
+void MainWindow::handleSaveRangeFile()
+{
+    QString filename;
+    FrameFileIO::saveFrameRange(filename, model->getListReference());
+}
+
 void MainWindow::handleSaveFilters()
 {
     QString filename;
@@ -1290,11 +1960,12 @@ void MainWindow::handleSaveDecodedMethod(bool csv)
 void MainWindow::saveDecodedTextFileAsColumns(QString filename)
 {
     QFile *outFile = new QFile(filename);
-    const QVector<CANFrame> *frames = model->getFilteredListReference();
+    const CANFrameStore *frames = model->getFilteredListReference();
 
     //const unsigned char *data;
     int dataLen;
-    const CANFrame *frame;
+    CANFrame currentFrame;
+    const CANFrame *frame = &currentFrame;
 
     if (!outFile->open(QIODevice::WriteOnly | QIODevice::Text))
         return;
@@ -1336,7 +2007,7 @@ Data Bytes: 88 10 00 13 BB 00 06 00
     //loop through all the frames and the message data therein
     for (int c = 0; c < frames->count(); c++)
     {
-        frame = &frames->at(c);
+        currentFrame = frames->at(c);
         //data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
         dataLen = frame->payload().count();
 
@@ -1393,7 +2064,7 @@ Data Bytes: 88 10 00 13 BB 00 06 00
     for (int c = 0; c < frames->count(); c++)
     {
         dataColumnsAdded = 0;
-        frame = &frames->at(c);
+        currentFrame = frames->at(c);
         //data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
         dataLen = frame->payload().count();
 
@@ -1462,14 +2133,15 @@ Data Bytes: 88 10 00 13 BB 00 06 00
     outFile->close();
 }
 
+/*
+ * Decoding every signal of every frame is most of the work here so it gets spread over all cores. Messages are
+ * looked up on this thread (the message index builds itself lazily) and then each thread turns its share of a
+ * block into text with the re-entrant DBC_SIGNAL::decodeText. Blocks are written out in order.
+ */
 void MainWindow::saveDecodedTextFile(QString filename)
 {
     QFile *outFile = new QFile(filename);
-    const QVector<CANFrame> *frames = model->getFilteredListReference();
-
-    const unsigned char *data;
-    int dataLen;
-    const CANFrame *frame;
+    const CANFrameStore *frames = model->getFilteredListReference();
 
     if (!outFile->open(QIODevice::WriteOnly | QIODevice::Text))
         return;
@@ -1478,49 +2150,79 @@ Time: 205.173000   ID: 0x20E Std Bus: 0 Len: 8
 Data Bytes: 88 10 00 13 BB 00 06 00
     SignalName	Value
 */
-    for (int c = 0; c < frames->count(); c++)
-    {
-        frame = &frames->at(c);
-        data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
-        dataLen = frame->payload().count();
-
-        QString builderString;
-        builderString += tr("Time: ") + QString::number((frame->timeStamp().microSeconds() / 1000000.0), 'f', 6);
-        builderString += tr("    ID: ") + Utility::formatCANID(frame->frameId(), frame->hasExtendedFrameFormat());
-        if (frame->hasExtendedFrameFormat()) builderString += tr(" Ext ");
-        else builderString += tr(" Std ");
-        builderString += tr("Bus: ") + QString::number(frame->bus);
-        builderString += " Len: " + QString::number(dataLen) + "\n";
-        outFile->write(builderString.toUtf8());
-
-        builderString = tr("Data Bytes: ");
-        for (int temp = 0; temp < dataLen; temp++)
+    QThreadPool pool;
+    int threads = qMax(1, QThread::idealThreadCount());
+    pool.setMaxThreadCount(threads);
+    QVector<CANFrame> block;
+    QVector<const DBC_MESSAGE *> msgs;
+    QVector<QByteArray> out(threads);
+    bool decode = (dbcHandler != nullptr);
+
+    for (int base = 0; base < frames->count(); base += EXPORT_DECODE_BLOCK)
+    {
+        int n = qMin(EXPORT_DECODE_BLOCK, frames->count() - base);
+        block.resize(n);
+        msgs.resize(n);
+        for (int c = 0; c < n; c++)
         {
-            builderString += Utility::formatNumber(data[temp]) + " ";
+            block[c] = frames->at(base + c);
+            msgs[c] = decode ? dbcHandler->findMessage(block[c]) : nullptr;
         }
-        builderString += "\n";
-        outFile->write(builderString.toUtf8());
 
-        builderString = "";
-        if (dbcHandler != nullptr)
+        for (int t = 0; t < threads; t++)
         {
-            DBC_MESSAGE *msg = dbcHandler->findMessage(*frame);
-            if (msg != nullptr)
+            int lo = static_cast<int>(static_cast<qint64>(n) * t / threads);
+            int hi = static_cast<int>(static_cast<qint64>(n) * (t + 1) / threads);
+            QByteArray *dest = &out[t];
+            const CANFrame *blockFrames = block.constData();
+            const DBC_MESSAGE * const *blockMsgs = msgs.constData();
+            pool.start(new ExportTask([dest, blockFrames, blockMsgs, lo, hi, decode]()
             {
-                for (int j = 0; j < msg->sigHandler->getCount(); j++)
+                QString builderString;
+                dest->clear();
+                for (int c = lo; c < hi; c++)
                 {
+                    const CANFrame *frame = &blockFrames[c];
+                    const unsigned char *data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
+                    int dataLen = frame->payload().count();
+
+                    builderString.clear();
+                    builderString += tr("Time: ") + QString::number((frame->timeStamp().microSeconds() / 1000000.0), 'f', 6);
+                    builderString += tr("    ID: ") + Utility::formatCANID(frame->frameId(), frame->hasExtendedFrameFormat());
+                    if (frame->hasExtendedFrameFormat()) builderString += tr(" Ext ");
+                    else builderString += tr(" Std ");
+                    builderString += tr("Bus: ") + QString::number(frame->bus);
+                    builderString += " Len: " + QString::number(dataLen) + "\n";
+
+                    builderString += tr("Data Bytes: ");
+                    for (int temp = 0; temp < dataLen; temp++)
+                    {
+                        builderString += Utility::formatNumber(data[temp]) + " ";
+                    }
+                    builderString += "\n";
 
-                    QString temp;
-                    if (msg->sigHandler->findSignalByIdx(j)->processAsText(*frame, temp))
+                    if (decode)
                     {
-                        builderString.append("\t" + temp);
+                        const DBC_MESSAGE *msg = blockMsgs[c];
+                        if (msg != nullptr)
+                        {
+                            const DBCSignalHandler *sigs = msg->sigHandler;
+                            for (int j = 0; j < sigs->getCount(); j++)
+                            {
+                                int mark = builderString.length();
+                                builderString.append("\t");
+                                if (sigs->findSignalByIdx(j)->decodeText(*frame, builderString)) builderString.append("\n");
+                                else builderString.truncate(mark);
+                            }
+                        }
                         builderString.append("\n");
                     }
+                    dest->append(builderString.toUtf8());
                 }
-            }
-            builderString.append("\n");
-            outFile->write(builderString.toUtf8());
+            }));
         }
+        pool.waitForDone();
+        for (int t = 0; t < threads; t++) outFile->write(out[t]);
     }
     outFile->close();
 }
@@ -1572,6 +2274,11 @@ CANFrameModel* MainWindow::getCANFrameModel()
     return model;
 }
 
+FrameBus* MainWindow::getFrameBus()
+{
+    return frameBus;
+}
+
 
 /*
  * All functions past this point set up the various other windows that can be opened
@@ -1618,12 +2325,18 @@ void MainWindow::showGraphingWindow()
     lastGraphingWindow->show();
 }
 
+GraphingWindow *MainWindow::latestGraphingWindow()
+{
+    if (!lastGraphingWindow) showGraphingWindow();
+    return lastGraphingWindow;
+}
+
 void MainWindow::showTemporalGraphWindow()
 {
     //only create an instance of the object if we dont have one. Otherwise just display the existing one.
     if (!temporalGraphWindow)
     {
-        const QVector<CANFrame> *frames;
+        const CANFrameStore *frames;
         if (!useFiltered)
             frames = model->getListReference();
         else
@@ -1696,6 +2409,15 @@ void MainWindow::showCANBridgeWindow()
     canBridgeWindow->show();
 }
 
+void MainWindow::showTriggeredCaptureWindow()
+{
+    if (!triggeredCaptureWindow)
+    {
+        triggeredCaptureWindow = new TriggeredCaptureWindow();
+    }
+    triggeredCaptureWindow->show();
+}
+
 void MainWindow::showFrameSenderWindow()
 {
     if (!frameSenderWindow)
@@ -1765,6 +2487,15 @@ void MainWindow::showFuzzingWindow()
     fuzzingWindow->show();
 }
 
+void MainWindow::showRestbusWindow()
+{
+    if (!restbusWindow)
+    {
+        restbusWindow = new RestbusWindow();
+    }
+    restbusWindow->show();
+}
+
 void MainWindow::showMCConfigWindow()
 {
     if (!motorctrlConfigWindow)
@@ -1803,6 +2534,68 @@ void MainWindow::showRangeWindow()
     rangeWindow->show();
 }
 
+void MainWindow::showCorrelationWindow()
+{
+    if (!correlationWindow)
+    {
+        correlationWindow = new CorrelationWindow(model->getListReference());
+    }
+    correlationWindow->show();
+}
+
+void MainWindow::showCounterChecksumWindow()
+{
+    if (!counterChecksumWindow)
+    {
+        counterChecksumWindow = new CounterChecksumWindow(model->getListReference());
+    }
+    counterChecksumWindow->show();
+}
+
+//like the graphing windows a new one every time, so several can show different buses or filters side by side
+void MainWindow::showFrameViewWindow()
+{
+    FrameViewWindow *win = new FrameViewWindow(model);
+    frameViewWindows.append(win);
+    win->show();
+}
+
+void MainWindow::showErrorStatsWindow()
+{
+    if (!errorStatsWindow)
+    {
+        errorStatsWindow = new ErrorStatsWindow(model->getListReference());
+    }
+    errorStatsWindow->show();
+}
+
+void MainWindow::showLatencyWindow()
+{
+    if (!latencyWindow)
+    {
+        latencyWindow = new LatencyWindow(model->getListReference());
+    }
+    latencyWindow->show();
+}
+
+void MainWindow::showNodeLoadWindow()
+{
+    if (!nodeLoadWindow)
+    {
+        nodeLoadWindow = new NodeLoadWindow(model->getListReference());
+    }
+    nodeLoadWindow->show();
+}
+
+void MainWindow::showQueryWindow()
+{
+    if (!queryWindow)
+    {
+        queryWindow = new QueryWindow(model->getListReference());
+    }
+    queryWindow->show();
+}
+
 void MainWindow::showFuzzyScopeWindow()
 {
     //not done yet
@@ -1830,12 +2623,42 @@ void MainWindow::showFlowViewWindow()
 }
 
 
+//get the text for the rows around what's on screen made ahead of time so scrolling doesn't have to
+void MainWindow::prefetchVisibleRows()
+{
+    QTableView *view = ui->canFramesView;
+    int first = view->rowAt(0);
+    if (first < 0) return;
+    int last = view->rowAt(view->viewport()->height() - 1);
+    if (last < 0) last = view->model()->rowCount() - 1;
+
+    QSortFilterProxyModel *proxy = qobject_cast<QSortFilterProxyModel *>(view->model());
+    if (proxy)
+    {
+        first = proxy->mapToSource(proxy->index(first, 0)).row();
+        last = proxy->mapToSource(proxy->index(last, 0)).row();
+        if (first > last) std::swap(first, last);
+    }
+    model->prefetchRows(first, last);
+
+    const CANFrameStore *shown = model->getFilteredListReference();
+    if (first >= 0 && first < shown->count()) overviewStrip->setViewTime(shown->record(first).timestamp);
+}
+
 void MainWindow::DBCSettingsUpdated()
     {
+    filterListModel->relabel();
     updateFilterList();
     model->sendRefresh();
     }
 
+//a loaded DBC file was edited on disk. The model already knows which IDs to decode again
+void MainWindow::DBCFileReloaded()
+{
+    filterListModel->relabel();
+    model->redecode();
+}
+
 void MainWindow::showDBCFileWindow()
 {
     if (!dbcFileWindow)
@@ -6,14 +6,18 @@
 #include <QSerialPort>
 #include <QSerialPortInfo>
 #include "canframemodel.h"
+#include "framebus.h"
+#include "filterlistmodel.h"
 #include "can_structs.h"
 #include "framefileio.h"
 #include "dbc/dbchandler.h"
 #include "bus_protocols/isotp_handler.h"
 #include "framesenderobject.h"
+#include "sendgridmodel.h"
 #include "re/graphingwindow.h"
 #include "re/frameinfowindow.h"
 #include "frameplaybackwindow.h"
+#include "frameviewwindow.h"
 #include "bisectwindow.h"
 #include "re/flowviewwindow.h"
 #include "framesenderwindow.h"
@@ -24,8 +28,16 @@
 #include "re/discretestatewindow.h"
 #include "scriptingwindow.h"
 #include "re/rangestatewindow.h"
+#include "re/correlationwindow.h"
+#include "re/counterchecksumwindow.h"
+#include "re/errorstatswindow.h"
+#include "re/latencywindow.h"
+#include "re/nodeloadwindow.h"
+#include "re/querywindow.h"
+#include "trafficoverviewstrip.h"
 #include "dbc/dbcloadsavewindow.h"
 #include "re/fuzzingwindow.h"
+#include "restbuswindow.h"
 #include "re/udsscanwindow.h"
 #include "re/sniffer/snifferwindow.h"
 #include "re/isotp_interpreterwindow.h"
@@ -34,8 +46,13 @@
 #include "re/temporalgraphwindow.h"
 #include "re/dbccomparatorwindow.h"
 #include "canbridgewindow.h"
+#include "triggeredcapturewindow.h"
+#include "framesearchdialog.h"
 
 class CANConnection;
+class CaptureAgent;
+class FrameServer;
+class SharedCaptureHub;
 class ConnectionWindow;
 class ISOTP_InterpreterWindow;
 class ScriptingWindow;
@@ -65,18 +82,34 @@ public:
     static QString loadedFileName;
     static MainWindow *getReference();
     CANFrameModel * getCANFrameModel();
+    FrameBus *getFrameBus(); //subscriptions to the frames coming into the frame list, see framebus.h
     ~MainWindow();
 
     void handleDroppedFile(const QString &filename);
+    GraphingWindow *latestGraphingWindow(); //makes one if there isn't one yet
+    const QList<GraphingWindow *> &getGraphingWindows() const { return graphWindows; }
 
 private slots:
     void handleLoadFile();
+    void handleLoadPartialFile();
+    void handleLoadMultipleFiles();
     void handleSaveFile();
     void handleSaveFilteredFile();
+    void handleSaveRangeFile();
+    void handleSaveWorkspace();
+    void handleOpenWorkspace();
     void handleSaveFilters();
     void handleLoadFilters();
     void handleContinousLogging();
+    void handleCaptureOnly(bool enabled);
+    void handlePipelineTrace(bool enabled);
+    void handleServeCapture(bool enabled);
+    void handleShareCapture(bool enabled);
+    void handleServeFrames(bool enabled);
+    void showMemoryUsage();
+    void showFrameSearch();
     void showGraphingWindow();
+    void showFrameViewWindow();
     void showFrameDataAnalysis();
     void clearFrames();
     void expandAllRows();
@@ -86,6 +119,12 @@ private slots:
     void showFrameSenderWindow();
     void showSingleMultiWindow();
     void showRangeWindow();
+    void showCorrelationWindow();
+    void showCounterChecksumWindow();
+    void showErrorStatsWindow();
+    void showLatencyWindow();
+    void showNodeLoadWindow();
+    void showQueryWindow();
     void showFuzzyScopeWindow();
     void showComparisonWindow();
     void showSettingsDialog();
@@ -94,6 +133,7 @@ private slots:
     void showScriptingWindow();
     void showDBCFileWindow();
     void showFuzzingWindow();
+    void showRestbusWindow();
     void showMCConfigWindow();
     void showUDSScanWindow();
     void showISOInterpreterWindow();
@@ -103,6 +143,7 @@ private slots:
     void showTemporalGraphWindow();
     void showDBCComparisonWindow();
     void showCANBridgeWindow();
+    void showTriggeredCaptureWindow();
     void exitApp();
     void handleSaveDecoded();
     void handleSaveDecodedCsv();
@@ -115,24 +156,28 @@ private slots:
     void interpretToggled(bool);
     void overwriteToggled(bool);
     void presistentFiltersToggled(bool state);
-    void logReceivedFrame(CANConnection*, QVector<CANFrame>);
+    void logReceivedFrame(CANConnection*, const QVector<CANFrame>&);
     void tickGUIUpdate();
     void toggleCapture();
     void normalizeTiming();
     void updateFilterList();
-    void filterListItemChanged(QListWidgetItem *item);
+    void filterToggled(uint32_t id, bool on);
     void busFilterListItemChanged(QListWidgetItem *item);
     void filterSetAll();
     void filterClearAll();
+    void filterExpressionChanged();
     void headerClicked (int logicalIndex);
+    void headerContextMenuRequest(QPoint pos);
     void DBCSettingsUpdated();
-    void onSenderCellChanged(int, int);
+    void DBCFileReloaded();
 
 public slots:
     void gotFrames(int);
     void updateSettings();
     void readUpdateableSettings();
     void gotCenterTimeID(uint32_t ID, double timestamp);
+    void gotoFrameSequence(quint64 sequence);
+    void gotoTime(uint64_t stamp);
     void updateConnectionSettings(QString connectionType, QString port, int speed0, int speed1);
 
 signals:
@@ -146,26 +191,36 @@ signals:
     void sendCenterTimeID(uint32_t ID, double timestamp);
 
 private:
+    void showIdColumns();
     Ui::MainWindow *ui;
     static MainWindow *selfRef;
 
     //canbus related data
     CANFrameModel *model;
+    FrameBus *frameBus;
+    TrafficOverviewStrip *overviewStrip;
+    FilterListModel *filterListModel; //behind listFilters
     DBCHandler *dbcHandler;
     QByteArray inputBuffer;
     QTimer updateTimer;
     QElapsedTimer *elapsedTime;
     FrameSenderObject *frameSender;
+    SendGridModel *senderGrid; //the simple sender under the frame list
     int framesPerSec;
     int rxFrames;
+    qint64 paintNsSinceTick; //time the window spent painting since the last GUI tick
+    double tickCostMs; //smoothed cost of a tick, its own work plus the painting that came of it
+    int shownRowCount, shownFPS; //what the labels already say
     bool inhibitFilterUpdate;
+    QString filterExpressionHint; //tool tip of the expression box when it holds no error
+    bool filterListsPending; //an updateFilterList is already queued for this pass of the event loop
     bool useHex;
     bool allowCapture;
     bool ignoreDBCColors;
     bool CSVAbsTime;
     bool bDirty; //have frames been added or subtracted since the last save/load?
     bool useFiltered; //should sub-windows use the unfiltered or filtered frames list?
-    bool inhibitSenderChanged;
+    bool useHardwareFilters; //push the ID filters down to devices that can do acceptance filtering
 
     bool continuousLogging;
     int continuousLogFlushCounter;
@@ -175,6 +230,7 @@ private:
     //Graph window is allowed to instantiate more than once. All the rest are not (yet).
     GraphingWindow *lastGraphingWindow;
     QList<GraphingWindow *> graphWindows;
+    QList<FrameViewWindow *> frameViewWindows; //any number, each with its own filters over the list's frames
 
     FrameInfoWindow *frameInfoWindow;
     FramePlaybackWindow *playbackWindow;
@@ -188,8 +244,15 @@ private:
     ConnectionWindow *connectionWindow;
     ScriptingWindow *scriptingWindow;
     RangeStateWindow *rangeWindow;
+    CorrelationWindow *correlationWindow;
+    CounterChecksumWindow *counterChecksumWindow;
+    ErrorStatsWindow *errorStatsWindow;
+    LatencyWindow *latencyWindow;
+    NodeLoadWindow *nodeLoadWindow;
+    QueryWindow *queryWindow;
     DBCLoadSaveWindow *dbcFileWindow;
     FuzzingWindow *fuzzingWindow;
+    RestbusWindow *restbusWindow;
     UDSScanWindow *udsScanWindow;
     ISOTP_InterpreterWindow *isoWindow;
     SnifferWindow* snifferWindow;
@@ -199,6 +262,11 @@ private:
     TemporalGraphWindow *temporalGraphWindow;
     DBCComparatorWindow *dbcComparatorWindow;
     CANBridgeWindow *canBridgeWindow;
+    TriggeredCaptureWindow *triggeredCaptureWindow;
+    FrameSearchDialog *frameSearchDialog;
+    CaptureAgent *captureAgent; //serves the capture to other SavvyCANs while Serve Capture is checked
+    SharedCaptureHub *sharedCaptureHub; //the same for SavvyCANs on this machine, through shared memory
+    FrameServer *frameServer; //socketcand raw mode for other tools while Serve Frames is checked
 
     //various private storage
     QLabel lbStatusConnected;
@@ -209,6 +277,7 @@ private:
     bool isConnected;
     QPoint contextMenuPosition;
     bool rowExpansionActive = false;
+    bool rowsSizedSingly = false; //some rows have a height of their own, otherwise they all go by the default
 
     //private methods
     QString getSignalNameFromPosition(QPoint pos);
@@ -218,15 +287,31 @@ private:
     void saveDecodedTextFileAsColumns(QString);
     void addFrameToDisplay(CANFrame &, bool);
     void updateFileStatus();
+    void loadMappedCapture(const QString &path, const QString &displayName);
+    void showLoadedFrames(QVector<CANFrame> &frames, const QString &displayName);
     void closeEvent(QCloseEvent *event);
+    bool event(QEvent *event);
+    void scheduleNextTick(qint64 tickNs);
     void killEmAll();
     void killWindow(QDialog *win);
+    //sub windows a workspace remembers, by the name they're saved under and the slot that opens them
+    struct ToolWindow
+    {
+        const char *name;
+        const char *opener;
+        QDialog *window; //nullptr if it isn't open
+    };
+    QVector<ToolWindow> toolWindows() const;
+    void openWorkspace(const QString &filename);
     void readSettings();
     void writeSettings();
     bool eventFilter(QObject *obj, QEvent *event);
     void manageRowExpansion();
+    void sizeVisibleRows();
+    void refreshFilterLists();
+    void prefetchVisibleRows();
+    void updateHardwareFilters();
     void disableAutoRowExpansion();
-    void createSenderRow();
     void processSenderCellChange(int line, int col);
 };
 
@@ -0,0 +1,80 @@
+#include "memoryaccounting.h"
+#include "qcustomplot.h"
+
+#include <QFile>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+static QList<MemoryReporter *> &reporters()
+{
+    static QList<MemoryReporter *> list;
+    return list;
+}
+
+MemoryReporter::MemoryReporter()
+{
+    static int nextSerial = 1;
+    serial = nextSerial++;
+    reporters().append(this);
+}
+
+MemoryReporter::~MemoryReporter()
+{
+    reporters().removeAll(this);
+}
+
+QVector<MemoryUsage> MemoryAccounting::collect()
+{
+    QVector<MemoryUsage> out;
+    for (const MemoryReporter *reporter : reporters()) reporter->reportMemory(out);
+    return out;
+}
+
+qint64 MemoryAccounting::purgeAll()
+{
+    qint64 freed = 0;
+    //a copy since purging could end up deleting a reporter
+    const QList<MemoryReporter *> list = reporters();
+    for (MemoryReporter *reporter : list)
+    {
+        if (reporters().contains(reporter)) freed += reporter->purgeMemory();
+    }
+    return freed;
+}
+
+qint64 MemoryAccounting::processBytes()
+{
+#ifdef Q_OS_LINUX
+    //second field of statm is the resident set in pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) return -1;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.count() < 2) return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+qint64 MemoryAccounting::bytesOf(const CANFrame &frame)
+{
+    //the payload lives in its own allocation unless it's shared with another copy, count it anyway
+    return static_cast<qint64>(sizeof(CANFrame)) + bytesOf(frame.payload());
+}
+
+qint64 MemoryAccounting::bytesOf(const QVector<CANFrame> &frames)
+{
+    qint64 bytes = static_cast<qint64>(frames.capacity()) * static_cast<qint64>(sizeof(CANFrame));
+    for (const CANFrame &frame : frames) bytes += bytesOf(frame.payload());
+    return bytes;
+}
+
+qint64 MemoryAccounting::plotBytes(const QCustomPlot *plot)
+{
+    if (!plot) return 0;
+    qint64 bytes = 0;
+    for (int i = 0; i < plot->graphCount(); i++)
+        bytes += static_cast<qint64>(plot->graph(i)->data()->size()) * static_cast<qint64>(sizeof(QCPGraphData));
+    return bytes;
+}
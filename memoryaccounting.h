@@ -0,0 +1,70 @@
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "can_structs.h"
+
+class QCustomPlot;
+
+/*
+ * Where the memory is going. Anything that holds on to a lot of data (the frame list, graph series, DBC files,
+ * script engines and so on) derives from MemoryReporter and says how many bytes it holds when asked. The memory
+ * usage dialog adds those up next to what the OS says the process uses.
+ *
+ * The numbers are what the containers have allocated (capacity, not just what's in use) plus a rough allowance
+ * for hash nodes and string headers. Close enough to see which window is sitting on gigabytes, not to the byte.
+ * Memory mapped captures are counted by the OS as file cache and aren't in here.
+ *
+ * GUI thread only. Reporters register themselves on construction and go away on destruction.
+ */
+
+struct MemoryUsage
+{
+    QString owner;  //the window or subsystem, "Graphing Window 2"
+    QString item;   //what in it, "frame store" or a graph's name
+    qint64 bytes;
+};
+
+class MemoryReporter
+{
+public:
+    MemoryReporter();
+    virtual ~MemoryReporter();
+
+    virtual void reportMemory(QVector<MemoryUsage> &out) const = 0;
+    //throw away whatever can be rebuilt or isn't needed (spare capacity, garbage). Returns about how much went
+    virtual qint64 purgeMemory() { return 0; }
+
+protected:
+    //"Graphing Window #3" so two of the same window can be told apart
+    QString memoryOwner(const QString &kind) const { return QString("%1 #%2").arg(kind).arg(serial); }
+
+private:
+    int serial;
+};
+
+namespace MemoryAccounting
+{
+    QVector<MemoryUsage> collect();
+    qint64 purgeAll();
+    //resident set size of the whole process as the OS sees it, -1 where that isn't known
+    qint64 processBytes();
+
+    template<typename T> inline qint64 bytesOf(const QVector<T> &v) { return static_cast<qint64>(v.capacity()) * static_cast<qint64>(sizeof(T)); }
+#if QT_VERSION < QT_VERSION_CHECK( 6, 0, 0 )
+    //Qt 5 lists hold pointers to separately allocated items. In Qt 6 QList is QVector and the one above covers it
+    template<typename T> inline qint64 bytesOf(const QList<T> &l) { return static_cast<qint64>(l.size()) * static_cast<qint64>(sizeof(T) + sizeof(void *)); }
+#endif
+    template<typename K, typename V> inline qint64 bytesOf(const QHash<K, V> &h) { return static_cast<qint64>(h.size()) * static_cast<qint64>(sizeof(K) + sizeof(V) + 2 * sizeof(void *)); }
+    inline qint64 bytesOf(const QString &s) { return static_cast<qint64>(s.capacity()) * 2 + 24; }
+    inline qint64 bytesOf(const QByteArray &b) { return static_cast<qint64>(b.capacity()) + 24; }
+    qint64 bytesOf(const CANFrame &frame);
+    qint64 bytesOf(const QVector<CANFrame> &frames);
+    qint64 plotBytes(const QCustomPlot *plot); //the points every graph on the plot holds
+}
+
+#endif // MEMORYACCOUNTING_H
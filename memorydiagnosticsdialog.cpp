@@ -0,0 +1,96 @@
+#include "memorydiagnosticsdialog.h"
+#include "ui_memorydiagnosticsdialog.h"
+#include "memoryaccounting.h"
+
+#include <QHeaderView>
+#include <QMap>
+#include <algorithm>
+
+MemoryDiagnosticsDialog::MemoryDiagnosticsDialog(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::MemoryDiagnosticsDialog),
+    lastPurged(-1)
+{
+    ui->setupUi(this);
+    ui->treeUsage->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    ui->treeUsage->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    ui->treeUsage->header()->setStretchLastSection(false);
+
+    connect(ui->btnRefresh, &QPushButton::clicked, this, &MemoryDiagnosticsDialog::refresh);
+    connect(ui->btnPurge, &QPushButton::clicked, this, &MemoryDiagnosticsDialog::purge);
+    refresh();
+}
+
+MemoryDiagnosticsDialog::~MemoryDiagnosticsDialog()
+{
+    delete ui;
+}
+
+QString MemoryDiagnosticsDialog::formatBytes(qint64 bytes)
+{
+    if (bytes < 1024) return tr("%1 B").arg(bytes);
+    if (bytes < 1024 * 1024) return tr("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+    if (bytes < 1024ll * 1024 * 1024) return tr("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+    return tr("%1 GB").arg(bytes / (1024.0 * 1024.0 * 1024.0), 0, 'f', 2);
+}
+
+void MemoryDiagnosticsDialog::refresh()
+{
+    const QVector<MemoryUsage> usage = MemoryAccounting::collect();
+
+    //owners in the order they first reported, biggest items first under each
+    QStringList owners;
+    QMap<QString, QVector<MemoryUsage>> byOwner;
+    for (const MemoryUsage &entry : usage)
+    {
+        if (!byOwner.contains(entry.owner)) owners.append(entry.owner);
+        byOwner[entry.owner].append(entry);
+    }
+
+    ui->treeUsage->clear();
+    qint64 total = 0;
+    for (const QString &owner : qAsConst(owners))
+    {
+        QVector<MemoryUsage> &items = byOwner[owner];
+        std::sort(items.begin(), items.end(), [](const MemoryUsage &a, const MemoryUsage &b) { return a.bytes > b.bytes; });
+        qint64 ownerTotal = 0;
+        QTreeWidgetItem *ownerItem = new QTreeWidgetItem(ui->treeUsage);
+        for (const MemoryUsage &entry : qAsConst(items))
+        {
+            QTreeWidgetItem *item = new QTreeWidgetItem(ownerItem);
+            item->setText(0, entry.item);
+            item->setText(1, formatBytes(entry.bytes));
+            item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+            ownerTotal += entry.bytes;
+        }
+        ownerItem->setText(0, owner);
+        ownerItem->setText(1, formatBytes(ownerTotal));
+        ownerItem->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        ownerItem->setData(1, Qt::UserRole, ownerTotal);
+        total += ownerTotal;
+    }
+    //biggest owner first, by size rather than by the text of the size
+    QList<QTreeWidgetItem *> top;
+    while (ui->treeUsage->topLevelItemCount()) top.append(ui->treeUsage->takeTopLevelItem(0));
+    std::sort(top.begin(), top.end(), [](QTreeWidgetItem *a, QTreeWidgetItem *b)
+    {
+        return a->data(1, Qt::UserRole).toLongLong() > b->data(1, Qt::UserRole).toLongLong();
+    });
+    ui->treeUsage->addTopLevelItems(top);
+
+    QString text = tr("Accounted for: %1").arg(formatBytes(total));
+    qint64 process = MemoryAccounting::processBytes();
+    if (process >= 0)
+    {
+        text += tr("    Process resident: %1").arg(formatBytes(process));
+        text += tr("    Elsewhere (Qt, libraries, heap overhead): %1").arg(formatBytes(qMax<qint64>(0, process - total)));
+    }
+    if (lastPurged >= 0) text += tr("\nLast purge gave back about %1").arg(formatBytes(lastPurged));
+    ui->lblTotals->setText(text);
+}
+
+void MemoryDiagnosticsDialog::purge()
+{
+    lastPurged = MemoryAccounting::purgeAll();
+    refresh();
+}
@@ -0,0 +1,33 @@
+#ifndef MEMORYDIAGNOSTICSDIALOG_H
+#define MEMORYDIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+
+namespace Ui {
+class MemoryDiagnosticsDialog;
+}
+
+/*
+ * Lists what every MemoryReporter says it holds, grouped by window or subsystem, next to what the OS says the whole
+ * process uses. Purge Caches asks every reporter to let go of whatever can be rebuilt.
+ */
+class MemoryDiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MemoryDiagnosticsDialog(QWidget *parent = nullptr);
+    ~MemoryDiagnosticsDialog();
+
+private slots:
+    void refresh();
+    void purge();
+
+private:
+    static QString formatBytes(qint64 bytes);
+
+    Ui::MemoryDiagnosticsDialog *ui;
+    qint64 lastPurged;
+};
+
+#endif // MEMORYDIAGNOSTICSDIALOG_H
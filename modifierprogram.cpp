@@ -0,0 +1,498 @@
+#include "modifierprogram.h"
+#include "canframestore.h"
+#include "dbc/dbchandler.h"
+#include "utility.h"
+
+#include <QDebug>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+//SAE J1850: poly 0x1D, init and final xor 0xFF. Table built the first time anything needs it
+const uint8_t *crc8Table()
+{
+    static uint8_t table[256];
+    static bool built = [] {
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t crc = static_cast<uint8_t>(i);
+            for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x1D) : static_cast<uint8_t>(crc << 1);
+            table[i] = crc;
+        }
+        return true;
+    }();
+    Q_UNUSED(built);
+    return table;
+}
+
+int signalValue(const DBC_SIGNAL *sig, const uint8_t *data, int len)
+{
+    double value = 0.0;
+    int32_t muxValue;
+    if (!sig->decodeValue(data, len, value, muxValue)) return 0;
+    return static_cast<int>(value);
+}
+
+//same layout as CANFrameStore::idKey but with room for bus -1
+quint64 slotKey(uint32_t id, int bus)
+{
+    return (static_cast<quint64>(static_cast<quint32>(bus + 1)) << 32) | id;
+}
+
+const DBC_SIGNAL *findSignal(uint32_t id, const QString &name)
+{
+    DBC_MESSAGE *msg = DBCHandler::getReference()->findMessage(id);
+    return msg ? msg->sigHandler->findSignalByName(name) : nullptr;
+}
+}
+
+const LastFrame *LastFrameTable::slot(uint32_t id, int bus)
+{
+    LastFrame *&slot = entries[slotKey(id, bus)];
+    if (!slot)
+    {
+        slot = arena.create();
+        slot->live = LiveFrameTable::getReference()->slot(bus, id);
+        fill(id, bus, slot);
+    }
+    return slot;
+}
+
+void LastFrameTable::reseed()
+{
+    for (QHash<quint64, LastFrame *>::iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        fill(static_cast<uint32_t>(it.key()), static_cast<int>(it.key() >> 32) - 1, it.value());
+    }
+}
+
+//newest frame of the pair in the store, by way of its per ID index
+void LastFrameTable::fill(uint32_t id, int bus, LastFrame *slot)
+{
+    slot->seen = false;
+    slot->len = 0;
+    if (!source) return;
+    QVector<int> rows = source->rowsOf(id, bus);
+    if (rows.isEmpty()) return;
+    int row = rows.last();
+    slot->seen = true;
+    slot->len = std::min(source->payloadLength(row), 64);
+    memcpy(slot->data, source->payloadData(row), slot->len);
+}
+
+QList<Modifier> ModifierProgram::parse(const QString &text)
+{
+    QList<Modifier> modifiers;
+    QString modString;
+    //bool firstOp = true;
+    bool abort = false;
+    QString token;
+    ModifierOp thisOp;
+
+    //Example line:
+    //d0 = D0 + 1,d1 = id:0x200:d3 + id:0x200:d4 AND 0xF0 - Original version
+    //D0=D0+1,D1=ID:0x200:D3+ID:0x200:D4&0xF0
+
+    //[BMS_TargetVoltage]=45 would set the value of signal BMS_TargetVoltage to 45
+
+    //[BMS_TargetVoltage]=[0x234:BMS_CurrentVoltage] + 4 would instead grab the value
+    //of BMS_CurrentVoltage from ID 0x234, add 4 to it, and set BMS_TargetVoltage to that value.
+    //[BMS_Voltage] on the right side without an ID is a signal of this frame.
+
+    //D7=COUNTER&0xF puts a rolling counter in D7, D7=CRC8 a CRC-8 (SAE J1850) of the other bytes
+    //and D7=XSUM the XOR of the other bytes. Put counters before the checksum so they're covered.
+
+    //This is certainly much harder to parse than the trigger definitions.
+    //the left side of the = has to be D0 to D7. After that there is a string of
+    //data. Spaces used to be required but no longer are. This makes parsing harder but data entry easier
+
+    //Removes the convenience English versions of the logical operators and replaces them with the math equivs.
+    //Also uppercases and removes all superfluous whitespace. Signal names in [] are left alone, plenty of
+    //them have OR or AND in them
+    QStringList pieces = text.toUpper().trimmed().split('[');
+    for (int p = 0; p < pieces.count(); p++)
+    {
+        int nameEnd = (p == 0) ? 0 : pieces[p].indexOf(']') + 1; //every piece but the first starts with a name
+        if (p > 0 && nameEnd == 0) continue;
+        pieces[p] = pieces[p].left(nameEnd) + pieces[p].mid(nameEnd).replace("AND", "&").replace("XOR", "^").replace("OR", "|");
+    }
+    modString = pieces.join('[').replace(" ", "");
+    if (modString != "")
+    {
+        QStringList mods = modString.split(',');
+        modifiers.reserve(mods.length());
+        for (int i = 0; i < mods.length(); i++)
+        {
+            Modifier thisMod;
+            thisMod.destByte = 0;
+
+            QRegularExpression regex;
+            QRegularExpressionMatch match;
+
+            regex.setPattern("^\\[(\\w+)]=");
+            match = regex.match(mods[i]);
+            if (match.hasMatch())
+            {
+                thisMod.destByte = -1;
+                thisMod.signalName = match.captured(1);
+                mods[i].remove(0, match.capturedLength(0));
+                thisMod.operations.clear();
+            }
+            else
+            {
+                QString leftSide = Utility::grabAlphaNumeric(mods[i]);
+                if (leftSide.startsWith("D") && leftSide.length() == 2)
+                {
+                    thisMod.destByte = leftSide.right(1).toInt();
+                    thisMod.operations.clear();
+                    if (!(Utility::grabOperation(mods[i]) == "="))
+                    {
+                        qDebug() << "Err: No = after lefthand val";
+                        continue;
+                    }
+                }
+            }
+
+            abort = false;
+
+            token = Utility::grabAlphaNumeric(mods[i]);
+            if (token[0] == '~')
+            {
+                thisOp.first.notOper = true;
+                token = token.remove(0, 1); //remove the ~ character
+            }
+            else thisOp.first.notOper = false;
+            parseOperand(token.split(":"), thisOp.first);
+
+            if (mods[i].length() < 2) {
+                abort = true;
+                thisOp.operation = ADDITION;
+                thisOp.second.ID = 0;
+                thisOp.second.databyte = 0;
+                thisOp.second.notOper = false;
+                thisMod.operations.append(thisOp);
+            }
+
+            while (!abort)
+            {
+                QString operation = Utility::grabOperation(mods[i]);
+                if (operation == "")
+                {
+                    abort = true;
+                }
+                else
+                {
+                    thisOp.operation = parseOperation(operation);
+                    QString secondOp = Utility::grabAlphaNumeric(mods[i]);
+                    if (secondOp.length() > 0 && secondOp[0] == '~')
+                    {
+                        thisOp.second.notOper = true;
+                        secondOp = secondOp.remove(0, 1); //remove the ~ character
+                    }
+                    else thisOp.second.notOper = false;
+                    parseOperand(secondOp.split(":"), thisOp.second);
+                    thisMod.operations.append(thisOp);
+                }
+
+                thisOp.first.ID = -1; //shadow register
+                thisOp.first.signalName.clear();
+                if (mods[i].length() < 2) abort = true;
+            }
+
+            modifiers.append(thisMod);
+        }
+    }
+    //there is no else for the modifiers. We'll accept there not being any
+    return modifiers;
+}
+
+//Turn a set of tokens into an operand
+void ModifierProgram::parseOperand(const QStringList &tokens, ModifierOperand &operand)
+{
+    //example string -> bus:0:id:200:d3
+
+    operand.bus = -1;
+    operand.ID = -2;
+    operand.databyte = 0;
+    operand.signalName.clear();
+
+    //[SIGNAL] of this frame or [ID:SIGNAL] of the newest frame with that ID
+    if (tokens.count() > 0 && tokens[0].startsWith("["))
+    {
+        QString name = tokens.join(":").remove('[').remove(']');
+        int colon = name.indexOf(':');
+        if (colon > -1)
+        {
+            operand.ID = Utility::ParseStringToNum(name.left(colon));
+            name = name.mid(colon + 1);
+        }
+        operand.signalName = name;
+        return;
+    }
+
+    for (int i = 0; i < tokens.length(); i++)
+    {
+        if (tokens[i] == "BUS")
+        {
+            operand.bus = Utility::ParseStringToNum(tokens[++i]);
+        }
+        else if (tokens[i] == "ID")
+        {
+            operand.ID = Utility::ParseStringToNum(tokens[++i]);
+        }
+        else if (tokens[i] == "COUNTER")
+        {
+            operand.ID = -3;
+        }
+        else if (tokens[i] == "CRC8")
+        {
+            operand.ID = -4;
+        }
+        else if (tokens[i] == "XSUM")
+        {
+            operand.ID = -5;
+        }
+        else if (tokens[i].length() == 2 && tokens[i].startsWith("D"))
+        {
+            operand.databyte = Utility::ParseStringToNum(tokens[i].right(tokens[i].length() - 1));
+        }
+        else
+        {
+            operand.databyte = Utility::ParseStringToNum(tokens[i]);
+            operand.ID = 0; //special ID to show this is a number not a look up.
+        }
+    }
+}
+
+ModifierOperationType ModifierProgram::parseOperation(const QString &op)
+{
+    if (op == "+") return ADDITION;
+    if (op == "-") return SUBTRACTION;
+    if (op == "*") return MULTIPLICATION;
+    if (op == "/") return DIVISION;
+    if (op == "&") return AND;
+    if (op == "|") return OR;
+    if (op == "^") return XOR;
+    if (op == "%") return MOD;
+    return ADDITION;
+}
+
+QSharedPointer<const ModifierProgram> ModifierProgram::compile(const FrameSendData &record, LastFrameTable &frames)
+{
+    QSharedPointer<ModifierProgram> program(new ModifierProgram);
+    program->table = &frames;
+    program->frameId = record.frameId();
+    program->dbcRevision = DBCHandler::getRevision();
+
+    for (const Modifier &mod : record.modifiers)
+    {
+        Target target;
+        target.destByte = mod.destByte;
+        target.sig = nullptr;
+        if (mod.destByte < 0) //[signal]=... goes through the DBC definition of this ID
+        {
+            program->usesSignals = true;
+            target.sig = findSignal(record.frameId(), mod.signalName);
+            if (!target.sig) target.destByte = -2;
+        }
+        target.firstStep = program->steps.count();
+        target.stepCount = mod.operations.count();
+        for (const ModifierOp &op : mod.operations)
+        {
+            Step step;
+            step.first = program->resolve(op.first, record, frames);
+            step.second = program->resolve(op.second, record, frames);
+            step.operation = op.operation;
+            program->steps.append(step);
+        }
+        program->targets.append(target);
+    }
+    if (program->usesSignals) program->dbcMessages = DBCHandler::getReference()->sharedMessageSets();
+    return program;
+}
+
+ModifierProgram::Operand ModifierProgram::resolve(const ModifierOperand &op, const FrameSendData &record, LastFrameTable &frames)
+{
+    Operand out;
+    out.src = SRC_CONST;
+    out.invert = op.notOper;
+    out.value = op.databyte;
+    out.frame = nullptr;
+    out.sig = nullptr;
+
+    if (!op.signalName.isEmpty() && (op.ID == -2 || op.ID > 0))
+    {
+        usesSignals = true;
+        out.sig = findSignal((op.ID == -2) ? record.frameId() : static_cast<uint32_t>(op.ID), op.signalName);
+        if (!out.sig) //nothing to read, same as a frame that hasn't been seen
+        {
+            out.invert = false;
+            out.value = 0;
+            return out;
+        }
+        if (op.ID == -2) out.src = SRC_OWN_SIGNAL;
+        else
+        {
+            out.src = SRC_FRAME_SIGNAL;
+            out.frame = frames.slot(op.ID, op.bus);
+        }
+        return out;
+    }
+
+    switch (op.ID)
+    {
+    case 0:
+        out.src = SRC_CONST;
+        break;
+    case -1:
+        out.src = SRC_SHADOW;
+        break;
+    case -2:
+        out.src = SRC_OWN_BYTE;
+        break;
+    case -3:
+        out.src = SRC_COUNTER;
+        break;
+    case -4:
+        out.src = SRC_CRC8;
+        break;
+    case -5:
+        out.src = SRC_XOR8;
+        break;
+    default:
+        if (op.ID > 0)
+        {
+            out.src = SRC_FRAME_BYTE;
+            out.frame = frames.slot(op.ID, op.bus);
+        }
+        else out.value = 0;
+        break;
+    }
+    return out;
+}
+
+bool ModifierProgram::isCurrent(const FrameSendData &record, const LastFrameTable &frames) const
+{
+    if (table != &frames || frameId != record.frameId()) return false;
+    return !usesSignals || dbcRevision == DBCHandler::getRevision();
+}
+
+int ModifierProgram::fetch(const Operand &op, const uint8_t *own, int ownLen, int dest, int shadow, int count) const
+{
+    int value = 0;
+    switch (op.src)
+    {
+    case SRC_CONST:
+        value = op.value;
+        break;
+    case SRC_SHADOW:
+        return shadow;
+    case SRC_OWN_BYTE:
+        if (op.value >= ownLen) return 0;
+        value = own[op.value];
+        break;
+    case SRC_FRAME_BYTE:
+        if (op.frame->live && op.frame->live->isSet())
+        {
+            value = op.frame->live->byteAt(op.value);
+            if (value < 0) return 0;
+        }
+        else if (op.frame->seen && op.value < op.frame->len) value = op.frame->data[op.value];
+        else return 0;
+        break;
+    case SRC_OWN_SIGNAL:
+        value = signalValue(op.sig, own, ownLen);
+        break;
+    case SRC_FRAME_SIGNAL:
+    {
+        LiveFrame received;
+        if (op.frame->live && LiveFrameTable::read(op.frame->live, received)) value = signalValue(op.sig, received.data, received.len);
+        else if (op.frame->seen) value = signalValue(op.sig, op.frame->data, op.frame->len);
+        else return 0;
+        break;
+    }
+    case SRC_COUNTER:
+        value = count;
+        break;
+    case SRC_CRC8:
+    {
+        const uint8_t *table = crc8Table();
+        uint8_t crc = 0xFF;
+        for (int i = 0; i < ownLen; i++)
+        {
+            if (i != dest) crc = table[crc ^ own[i]];
+        }
+        value = crc ^ 0xFF;
+        break;
+    }
+    case SRC_XOR8:
+    {
+        uint8_t sum = 0;
+        for (int i = 0; i < ownLen; i++)
+        {
+            if (i != dest) sum ^= own[i];
+        }
+        value = sum;
+        break;
+    }
+    }
+    return op.invert ? ~value : value;
+}
+
+void ModifierProgram::run(FrameSendData &record) const
+{
+    if (targets.isEmpty()) return;
+
+    uint8_t bytes[64];
+    const QByteArray payload = record.payload();
+    int len = std::min(static_cast<int>(payload.length()), 64);
+    memcpy(bytes, payload.constData(), len);
+
+    int shadow = 0; //carries over from one modifier to the next like it always has
+    for (const Target &target : targets)
+    {
+        const Step *step = steps.constData() + target.firstStep;
+        for (int s = 0; s < target.stepCount; s++, step++)
+        {
+            int first = fetch(step->first, bytes, len, target.destByte, shadow, record.count);
+            int second = fetch(step->second, bytes, len, target.destByte, shadow, record.count);
+            switch (step->operation)
+            {
+            case ADDITION:
+                shadow = first + second;
+                break;
+            case SUBTRACTION:
+                shadow = first - second;
+                break;
+            case MULTIPLICATION:
+                shadow = first * second;
+                break;
+            case DIVISION:
+                shadow = second ? first / second : 0;
+                break;
+            case AND:
+                shadow = first & second;
+                break;
+            case OR:
+                shadow = first | second;
+                break;
+            case XOR:
+                shadow = first ^ second;
+                break;
+            case MOD:
+                shadow = second ? first % second : 0;
+                break;
+            }
+        }
+        if (target.destByte >= 0)
+        {
+            if (target.destByte < len) bytes[target.destByte] = static_cast<uint8_t>(shadow);
+        }
+        else if (target.sig) target.sig->encodeValue(shadow, bytes, len);
+    }
+
+    record.setPayload(QByteArray(reinterpret_cast<const char *>(bytes), len));
+}
@@ -0,0 +1,129 @@
+#ifndef MODIFIERPROGRAM_H
+#define MODIFIERPROGRAM_H
+
+#include <QHash>
+#include <QSharedPointer>
+#include <QVector>
+#include "can_structs.h"
+#include "can_trigger_structs.h"
+#include "objectarena.h"
+#include "connections/liveframetable.h"
+
+class CANFrameStore;
+class DBC_SIGNAL;
+class DBCMessageHandler;
+
+//newest payload of one bus / ID pair (bus -1 for any). Compiled modifiers point straight at these
+struct LastFrame
+{
+    const LiveFrameSlot *live = nullptr; //straight from the connections, used as soon as anything came in there
+    bool seen = false; //the rest is the newest in the frame store, for frames that were loaded instead of received
+    int len = 0;
+    uint8_t data[64];
+};
+
+/*
+ * Newest frame of every bus / ID pair a modifier reads bytes or signals from. Received frames come from the shared
+ * LiveFrameTable, which the connections keep up to date themselves, so nothing here has to follow the frame store as
+ * it grows. The store is only looked at, through its per ID index, for pairs nothing has been received for yet, to
+ * cover frames loaded from a file.
+ *
+ * A slot is made the first time a modifier that needs it is compiled and never moves after that, so compiled
+ * modifiers just keep a pointer to it.
+ */
+class LastFrameTable
+{
+public:
+    LastFrameTable() {}
+    void setSource(const CANFrameStore *frames) { source = frames; }
+    //made and filled in from the source store the first time anyone asks for the pair
+    const LastFrame *slot(uint32_t id, int bus);
+    //the source store was swapped out or cleared, fill every slot from it again
+    void reseed();
+
+private:
+    Q_DISABLE_COPY(LastFrameTable)
+    void fill(uint32_t id, int bus, LastFrame *slot);
+
+    const CANFrameStore *source = nullptr;
+    QHash<quint64, LastFrame *> entries;
+    ObjectArena<LastFrame> arena;
+};
+
+/*
+ * The modifiers of one send record compiled to a flat list of steps. Operands are resolved once when compiling:
+ * numbers become constants, bytes of other IDs become pointers into a LastFrameTable and signals are looked up in
+ * the DBC. Running it is then a switch per operand and a single payload write at the end, instead of copying the
+ * operations and searching for frames and signals every time the record goes out.
+ *
+ * Operand sources on top of constants and data bytes (see ModifierOperand for the IDs):
+ * - signals, of this ID or of the newest frame of another one, as an integer
+ * - the record's send count, for rolling counters
+ * - CRC-8 (SAE J1850) or XOR of this frame's bytes as they are when that modifier runs, leaving out the byte the
+ *   modifier writes to so the checksum can sit anywhere in the frame
+ *
+ * Compiled programs don't change after compile() and are shared between copies of the record. They're only good
+ * for the table they were compiled against, the record's ID at that time and the DBC revision if they use signals,
+ * isCurrent() checks all of that.
+ */
+class ModifierProgram
+{
+public:
+    //the modifier text of a frame sender line, like "D0=D0+1,D7=CRC8". See the frame sender help for the syntax
+    static QList<Modifier> parse(const QString &text);
+    static QSharedPointer<const ModifierProgram> compile(const FrameSendData &record, LastFrameTable &frames);
+    bool isCurrent(const FrameSendData &record, const LastFrameTable &frames) const;
+    void run(FrameSendData &record) const;
+    //reads or writes signals, so it has to be compiled again when the DBC changes
+    bool needsDbc() const { return usesSignals; }
+
+private:
+    enum Source : quint8
+    {
+        SRC_CONST,
+        SRC_SHADOW,
+        SRC_OWN_BYTE,
+        SRC_FRAME_BYTE,
+        SRC_OWN_SIGNAL,
+        SRC_FRAME_SIGNAL,
+        SRC_COUNTER,
+        SRC_CRC8,
+        SRC_XOR8
+    };
+    struct Operand
+    {
+        Source src;
+        bool invert;
+        int value; //the constant, or the byte to read
+        const LastFrame *frame;
+        const DBC_SIGNAL *sig;
+    };
+    struct Step
+    {
+        Operand first;
+        Operand second;
+        ModifierOperationType operation;
+    };
+    struct Target
+    {
+        int destByte; //-1 writes sig instead, -2 writes nothing (signal that isn't in the DBC)
+        const DBC_SIGNAL *sig;
+        int firstStep;
+        int stepCount;
+    };
+
+    QVector<Step> steps;
+    QVector<Target> targets;
+    const LastFrameTable *table = nullptr;
+    uint32_t frameId = 0;
+    bool usesSignals = false;
+    quint32 dbcRevision = 0;
+    QVector<QSharedPointer<DBCMessageHandler>> dbcMessages; //keeps what the sig pointers point into around
+
+    static void parseOperand(const QStringList &tokens, ModifierOperand &operand);
+    static ModifierOperationType parseOperation(const QString &op);
+    Operand resolve(const ModifierOperand &op, const FrameSendData &record, LastFrameTable &frames);
+    int fetch(const Operand &op, const uint8_t *own, int ownLen, int dest, int shadow, int count) const;
+};
+
+#endif // MODIFIERPROGRAM_H
@@ -2,6 +2,7 @@
 #include "ui_motorcontrollerconfigwindow.h"
 
 #include "mainwindow.h"
+#include "pipelinetrace.h"
 #include <QDebug>
 
 /*
@@ -13,9 +14,15 @@
  * custom motor controller project I was working on. It's hidden by default. You could re-enable it and play around
  * with it if you're bored. It might be a good basis for how to set a list of parameters on a device. But, it could be broken
  * these days too. It is not maintained any longer as the project it was meant for is abandoned. YMMV.
+ *
+ * Reads and writes are pipelined. Up to the In Flight count of 0xC1 requests are out at once and each 0xC2 reply
+ * is matched back to its request by parameter ID, so the order the controller answers in doesn't matter. Every
+ * tick tops the window back up with one batch of frames and sends again whatever timed out, a few times before
+ * giving up on that parameter. Save works out up front which cells differ from what was last read and only writes
+ * those.
 */
 
-MotorControllerConfigWindow::MotorControllerConfigWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+MotorControllerConfigWindow::MotorControllerConfigWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::MotorControllerConfigWindow)
 {
@@ -24,9 +31,9 @@ MotorControllerConfigWindow::MotorControllerConfigWindow(const QVector<CANFrame>
 
     modelFrames = frames;
 
-    timer.setInterval(40);
-    transmitStep = 0;
-    doingRequest = false;
+    timer.setInterval(MCCONFIG_TICK_MS);
+    clock.start();
+    total = finished = failed = 0;
 
     QStringList headers;
     headers << "Param" << "Value";
@@ -36,7 +43,9 @@ MotorControllerConfigWindow::MotorControllerConfigWindow(const QVector<CANFrame>
     ui->tableParams->setHorizontalHeaderLabels(headers);
 
 
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    FrameBus::Options subscription;
+    subscription.filters.append(FrameBusFilter::exact(0xC2));
+    MainWindow::getReference()->getFrameBus()->subscribe(this, subscription, [this](const QVector<CANFrame> &frames) { gotFrames(frames); });
     connect(ui->btnRefresh, SIGNAL(clicked(bool)), this, SLOT(refreshData()));
     connect(ui->btnSave, SIGNAL(clicked(bool)), this, SLOT(saveData()));
     connect(&timer, SIGNAL(timeout()), this, SLOT(timerTick()));
@@ -48,64 +57,81 @@ MotorControllerConfigWindow::~MotorControllerConfigWindow()
     delete ui;
 }
 
-void MotorControllerConfigWindow::updatedFrames(int numFrames)
+//replies to our queries, only ever 0xC2 comes through. Byte 2 is 0 when bytes 4 and 5 hold the value
+void MotorControllerConfigWindow::gotFrames(const QVector<CANFrame> &frames)
 {
-    CANFrame thisFrame;
-    uint32_t id;
-    QTableWidgetItem *item = nullptr;
-    if (numFrames == -1) //all frames deleted
+    TRACE_SCOPE("MotorControllerConfigWindow::gotFrames");
+    bool answered = false;
+    for (const CANFrame &thisFrame : frames)
     {
-
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(thisFrame.payload().constData());
+        if (thisFrame.payload().length() < 6) continue;
+        uint32_t paramID = static_cast<uint32_t>(data[0] + (data[1] * 256));
+        auto row = paramRows.constFind(paramID);
+        if (row == paramRows.constEnd()) continue;
+
+        auto req = inFlight.find(paramID);
+        if (req != inFlight.end())
+        {
+            if (req->write) params[row.value()].value = req->value;
+            inFlight.erase(req);
+            finished++;
+            answered = true;
+        }
+        if (data[2] != 0) continue;
+        params[row.value()].value = static_cast<uint16_t>(data[4] + (data[5] * 256));
+        showValue(row.value());
     }
-    else if (numFrames == -2) //all new set of frames. Reset
-    {
+    if (answered) timerTick(); //room for more right away rather than on the next tick
+}
 
+void MotorControllerConfigWindow::showValue(int row)
+{
+    const PARAM &param = params.at(row);
+    QTableWidgetItem *item = nullptr;
+    if (param.paramType == ASCII) item = new QTableWidgetItem(); //QString::fromUtf8((char *)params[i].value, 2));
+    if (param.paramType == HEX) item = new QTableWidgetItem(Utility::formatHexNum(param.value));
+    if (param.paramType == DEC)
+    {
+        if (param.signedType == UNSIGNED) item = new QTableWidgetItem(QString::number(param.value));
+        if (param.signedType == SIGNED) item = new QTableWidgetItem(QString::number(static_cast<int16_t>(param.value)));
+        if (param.signedType == Q15) item = new QTableWidgetItem(QString::number(static_cast<int16_t>(param.value) / 32768.0));
     }
-    else //just got some new frames. See if they are relevant.
+    if (item) ui->tableParams->setItem(row, 1, item);
+}
+
+//the reverse of showValue. False if the text isn't a value this parameter can take
+bool MotorControllerConfigWindow::parseValue(const PARAM &param, const QString &text, uint16_t &value) const
+{
+    QString trimmed = text.trimmed();
+    if (trimmed.isEmpty() || param.paramType == ASCII) return false;
+    if (param.paramType == HEX)
     {
-        if (numFrames > modelFrames->count()) return;
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
-        {
-            thisFrame = modelFrames->at(i);
-            id = thisFrame.frameId();
+        value = static_cast<uint16_t>(Utility::ParseStringToNum(trimmed));
+        return true;
+    }
 
-            if (id == 0xC2) //response to a query we made
-            {
-                if ((char)thisFrame.payload()[2] == 0)
-                {
-                    uint32_t paramID = static_cast<uint32_t>(thisFrame.payload()[0] + (thisFrame.payload()[1] * 256));
-                    for (int i = 0; i < params.length(); i++)
-                    {
-                        if (params[i].paramID == paramID)
-                        {
-                            params[i].value = static_cast<uint16_t>(thisFrame.payload()[4] + (thisFrame.payload()[5] * 256));
-                            if (params[i].paramType == ASCII) item = new QTableWidgetItem(); //QString::fromUtf8((char *)params[i].value, 2));
-                            if (params[i].paramType == HEX) item = new QTableWidgetItem(Utility::formatHexNum(params[i].value));
-                            if (params[i].paramType == DEC)
-                            {
-                                if (params[i].signedType == UNSIGNED) item = new QTableWidgetItem(QString::number(params[i].value));
-                                if (params[i].signedType == SIGNED)
-                                {
-                                    if (params[i].value < 0x8000) item = new QTableWidgetItem(QString::number(params[i].value));
-                                    else item = new QTableWidgetItem(QString::number(params[i].value - 0x10000));
-                                }
-                                if (params[i].signedType == Q15) item = new QTableWidgetItem(QString::number(params[i].value / 32768.0));
-                            }
-                            ui->tableParams->setItem(i, 1, item);
-                            break;
-                        }
-                    }
-                }
-            }
-        }
+    bool ok = false;
+    if (param.signedType == Q15)
+    {
+        double q = trimmed.toDouble(&ok) * 32768.0;
+        if (!ok || q < -32768.0 || q > 32767.0) return false;
+        value = static_cast<uint16_t>(static_cast<int16_t>(qRound(q)));
+        return true;
     }
+    int v = trimmed.toInt(&ok);
+    if (!ok) return false;
+    if (param.signedType == SIGNED && (v < -32768 || v > 32767)) return false;
+    if (param.signedType == UNSIGNED && (v < 0 || v > 65535)) return false;
+    value = static_cast<uint16_t>(v);
+    return true;
 }
 
 void MotorControllerConfigWindow::refreshData()
 {
-    doingRequest = true;
-    transmitStep = 0;
-    timer.start();
+    QVector<Request> requests;
+    for (int i = 0; i < params.count(); i++) requests.append({i, false, 0, 0, 0});
+    startRequests(requests);
 }
 
 void MotorControllerConfigWindow::loadFile()
@@ -134,8 +160,12 @@ void MotorControllerConfigWindow::loadFile()
             return;
         }
 
-        ui->tableParams->clear();
+        timer.stop();
+        queued.clear();
+        inFlight.clear();
+        ui->tableParams->setRowCount(0);
         params.clear();
+        paramRows.clear();
 
         while (!inFile->atEnd())
         {
@@ -163,6 +193,7 @@ void MotorControllerConfigWindow::loadFile()
                 item = new QTableWidgetItem("");
                 ui->tableParams->setItem(row, 1, item);
 
+                paramRows.insert(param.paramID, params.count());
                 params.append(param);
             }
         }
@@ -174,72 +205,102 @@ void MotorControllerConfigWindow::loadFile()
     }
 }
 
+//only the cells that don't match what the controller last said, all worked out before anything is sent
 void MotorControllerConfigWindow::saveData()
 {
-    doingRequest = false;
-    transmitStep = 0;
-    timer.start();
+    QVector<Request> requests;
+    for (int i = 0; i < params.count(); i++)
+    {
+        QTableWidgetItem *cell = ui->tableParams->item(i, 1);
+        uint16_t value;
+        if (!cell || !parseValue(params.at(i), cell->text(), value)) continue;
+        if (value != params.at(i).value) requests.append({i, true, value, 0, 0});
+    }
+    startRequests(requests);
+}
+
+void MotorControllerConfigWindow::startRequests(const QVector<Request> &requests)
+{
+    queued.clear();
+    inFlight.clear();
+    for (const Request &req : requests) queued.append(req);
+    total = requests.count();
+    finished = failed = 0;
+    updateStatus();
+    if (!queued.isEmpty()) timer.start();
+}
+
+CANFrame MotorControllerConfigWindow::requestFrame(const Request &req) const
+{
+    CANFrame outFrame;
+    outFrame.setFrameId(0xC1);
+    outFrame.bus = 0;
+    outFrame.setExtendedFrameFormat(false);
+    QByteArray bytes(8, 0);
+    uint32_t paramID = params.at(req.row).paramID;
+    bytes[0] = paramID & 0xFF;
+    bytes[1] = (paramID >> 8) & 0xFF;
+    bytes[2] = req.write ? 1 : 0; //0 = read, 1 = write
+    bytes[3] = 0; //reserved
+    bytes[4] = req.value & 0xFF; //value goes in bytes 4,5 when writing
+    bytes[5] = (req.value >> 8) & 0xFF;
+    bytes[6] = 0; //reserved
+    bytes[7] = 0; //reserved
+    outFrame.setPayload(bytes);
+    return outFrame;
 }
 
 void MotorControllerConfigWindow::timerTick()
 {
-    if (doingRequest) //send requests for data
+    qint64 now = clock.elapsed();
+
+    //timed out ones go to the front so they don't wait behind everything else
+    for (auto it = inFlight.begin(); it != inFlight.end();)
     {
-        qDebug() << "Request: " << QString::number(transmitStep);
-
-        outFrame.setFrameId(0xC1);
-        QByteArray bytes(8, 0);
-        outFrame.bus = 0;
-        outFrame.setExtendedFrameFormat(false);
-        bytes[0] = params[transmitStep].paramID & 0xFF;
-        bytes[1] = (params[transmitStep].paramID >> 8) & 0xFF;
-        bytes[2] = 0; //0 = read, 1 = write
-        bytes[3] = 0; //reserved
-        bytes[4] = 0; //value goes in bytes 4,5 when writing
-        bytes[5] = 0;
-        bytes[6] = 0; //reserved
-        bytes[7] = 0; //reserved
-        outFrame.setPayload(bytes);
-
-        CANConManager::getInstance()->sendFrame(outFrame);
-
-        transmitStep++;
-        if (transmitStep == params.length())
+        if (now - it->sentAt < MCCONFIG_TIMEOUT_MS)
         {
-            timer.stop();
-            return;
+            ++it;
+            continue;
         }
-    }
-    else //save current value of all data items
-    {
-        uint16_t thisValue;
-        qDebug() << "Transmission: " << QString::number(transmitStep);
-
-        QString cellVal = ui->tableParams->item(transmitStep, 1)->text();
-
-        if (params[transmitStep].paramType != HEX)
-            thisValue = (uint16_t)Utility::ParseStringToNum(cellVal);
+        if (it->tries < MCCONFIG_MAX_TRIES) queued.prepend(it.value());
         else
-            thisValue = (uint16_t)Utility::ParseStringToNum(cellVal);
+        {
+            qDebug() << "No reply for parameter" << params.at(it->row).paramName;
+            failed++;
+        }
+        it = inFlight.erase(it);
+    }
 
-        if (thisValue != params[transmitStep].value)
+    QList<CANFrame> batch;
+    while (!queued.isEmpty() && inFlight.count() < ui->spinInFlight->value())
+    {
+        Request req = queued.takeFirst();
+        uint32_t paramID = params.at(req.row).paramID;
+        if (inFlight.contains(paramID)) //replies can't be told apart, so one request per parameter at a time
         {
-            outFrame.setFrameId(0xC1);
-            QByteArray bytes(8, 0);
-            outFrame.bus = 0;
-            outFrame.setExtendedFrameFormat(false);
-            bytes[0] = params[transmitStep].paramID & 0xFF;
-            bytes[1] = (params[transmitStep].paramID >> 8) & 0xFF;
-            bytes[2] = 1; //0 = read, 1 = write
-            bytes[3] = 0; //reserved
-            bytes[4] = params[transmitStep].value & 0xFF;
-            bytes[5] = (params[transmitStep].value >> 8) & 0xFF;
-            bytes[6] = 0; //reserved
-            bytes[7] = 0; //reserved
-
-            CANConManager::getInstance()->sendFrame(outFrame);
+            queued.prepend(req);
+            break;
         }
+        req.tries++;
+        req.sentAt = now;
+        inFlight.insert(paramID, req);
+        batch.append(requestFrame(req));
+    }
+    if (!batch.isEmpty()) CANConManager::getInstance()->sendFrames(batch);
+
+    if (queued.isEmpty() && inFlight.isEmpty()) timer.stop();
+    updateStatus();
+}
 
-        transmitStep++;
+void MotorControllerConfigWindow::updateStatus()
+{
+    if (total == 0)
+    {
+        ui->lblStatus->setText(QString());
+        return;
     }
+    QString text = tr("%1 of %2 done").arg(finished).arg(total);
+    if (inFlight.count()) text += tr(", %1 waiting on replies").arg(inFlight.count());
+    if (failed) text += tr(", %1 got no reply").arg(failed);
+    ui->lblStatus->setText(text);
 }
@@ -2,8 +2,18 @@
 #define MOTORCONTROLLERCONFIGWINDOW_H
 
 #include <QDialog>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QTimer>
 #include "can_structs.h"
+#include "canframestore.h"
+
+//how often requests are sent and timeouts looked at while a read or write is going
+#define MCCONFIG_TICK_MS            10
+//a request with no reply this long after it went out gets sent again
+#define MCCONFIG_TIMEOUT_MS         250
+//times a request goes out before the parameter is given up on
+#define MCCONFIG_MAX_TRIES          3
 
 namespace Ui {
 class MotorControllerConfigWindow;
@@ -41,7 +51,7 @@ class MotorControllerConfigWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit MotorControllerConfigWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit MotorControllerConfigWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~MotorControllerConfigWindow();
 
 signals:
@@ -49,20 +59,40 @@ signals:
     void sendFrameBatch(const QList<CANFrame> *);
 
 private slots:
-    void updatedFrames(int numFrames);
     void refreshData();
     void saveData();
     void timerTick();
     void loadFile();
 
 private:
+    //one read or write of a parameter, queued or waiting on its reply
+    struct Request
+    {
+        int row;            //into params and the table
+        bool write;
+        uint16_t value;     //what gets written
+        int tries;
+        qint64 sentAt;      //ms on the clock
+    };
+
+    void gotFrames(const QVector<CANFrame> &frames);
+    void startRequests(const QVector<Request> &requests);
+    CANFrame requestFrame(const Request &req) const;
+    void showValue(int row);
+    bool parseValue(const PARAM &param, const QString &text, uint16_t &value) const;
+    void updateStatus();
+
     Ui::MotorControllerConfigWindow *ui;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     QTimer timer;
-    CANFrame outFrame;
-    bool doingRequest;
-    int transmitStep;
+    QElapsedTimer clock;
     QList<PARAM> params;
+    QHash<uint32_t, int> paramRows; //param ID -> row
+    QList<Request> queued; //not sent yet, retries go to the front
+    QHash<uint32_t, Request> inFlight; //sent and waiting on a reply, by param ID
+    int total; //requests in the current read or write
+    int finished;
+    int failed;
 
 };
 
@@ -249,6 +249,30 @@ void QMQTT::Client::setAutoReconnectInterval(const int autoReconnectInterval)
     d->setAutoReconnectInterval(autoReconnectInterval);
 }
 
+bool QMQTT::Client::writeCoalescing() const
+{
+    Q_D(const Client);
+    return d->writeCoalescing();
+}
+
+void QMQTT::Client::setWriteCoalescing(const bool coalesce)
+{
+    Q_D(Client);
+    d->setWriteCoalescing(coalesce);
+}
+
+bool QMQTT::Client::noDelay() const
+{
+    Q_D(const Client);
+    return d->noDelay();
+}
+
+void QMQTT::Client::setNoDelay(const bool noDelay)
+{
+    Q_D(Client);
+    d->setNoDelay(noDelay);
+}
+
 QString QMQTT::Client::willTopic() const
 {
     Q_D(const Client);
@@ -341,6 +365,12 @@ quint16 QMQTT::Client::publish(const Message& message)
     return d->publish(message);
 }
 
+QList<quint16> QMQTT::Client::publish(const QList<Message>& messages)
+{
+    Q_D(Client);
+    return d->publish(messages);
+}
+
 void QMQTT::Client::subscribe(const QString& topic, const quint8 qos)
 {
     Q_D(Client);
@@ -194,6 +194,8 @@ public:
     bool cleanSession() const;
     bool autoReconnect() const;
     int autoReconnectInterval() const;
+    bool writeCoalescing() const;
+    bool noDelay() const;
     ConnectionState connectionState() const;
     QString willTopic() const;
     quint8 willQos() const;
@@ -218,6 +220,10 @@ public slots:
     void setCleanSession(const bool cleanSession);
     void setAutoReconnect(const bool value);
     void setAutoReconnectInterval(const int autoReconnectInterval);
+    // hold frames until back in the event loop and write them all at once
+    void setWriteCoalescing(const bool coalesce);
+    // TCP_NODELAY on the connection, applied when it connects
+    void setNoDelay(const bool noDelay);
     void setWillTopic(const QString& willTopic);
     void setWillQos(const quint8 willQos);
     void setWillRetain(const bool willRetain);
@@ -230,6 +236,8 @@ public slots:
     void unsubscribe(const QString& topic);
 
     quint16 publish(const QMQTT::Message& message);
+    // publishes all of them with a single socket write, returns their message ids in the same order
+    QList<quint16> publish(const QList<QMQTT::Message>& messages);
 
 #ifndef QT_NO_SSL
     void ignoreSslErrors();
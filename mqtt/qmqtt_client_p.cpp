@@ -250,17 +250,17 @@ quint16 QMQTT::ClientPrivate::sendPublish(const Message &message)
     header = SETRETAIN(header, message.retain() ? 1 : 0);
     header = SETQOS(header, message.qos());
     header = SETDUP(header, message.dup() ? 1 : 0);
-    Frame frame(header);
-    frame.writeString(message.topic());
+    _publishFrame.reset(header);
+    _publishFrame.writeString(message.topic());
     if(message.qos() > QOS0) {
         if (msgid == 0)
             msgid = nextmid();
-        frame.writeInt(msgid);
+        _publishFrame.writeInt(msgid);
     }
     if(!message.payload().isEmpty()) {
-        frame.writeRawData(message.payload());
+        _publishFrame.writeRawData(message.payload());
     }
-    sendFrame(frame);
+    sendFrame(_publishFrame);
     return msgid;
 }
 
@@ -352,6 +352,22 @@ quint16 QMQTT::ClientPrivate::publish(const Message& message)
     return msgid;
 }
 
+QList<quint16> QMQTT::ClientPrivate::publish(const QList<Message>& messages)
+{
+    QList<quint16> msgids;
+    msgids.reserve(messages.size());
+
+    // the whole batch goes out in one socket write, right after the last one unless coalescing was on already
+    bool coalescing = _network->writeCoalescing();
+    _network->setWriteCoalescing(true);
+    foreach (const Message& message, messages)
+        msgids.append(publish(message));
+    if (!coalescing)
+        _network->setWriteCoalescing(false);
+
+    return msgids;
+}
+
 void QMQTT::ClientPrivate::puback(const quint8 type, const quint16 msgid)
 {
     sendPuback(type, msgid);
@@ -537,6 +553,26 @@ void QMQTT::ClientPrivate::setAutoReconnectInterval(const int autoReconnectInter
     _network->setAutoReconnectInterval(autoReconnectInterval);
 }
 
+bool QMQTT::ClientPrivate::writeCoalescing() const
+{
+    return _network->writeCoalescing();
+}
+
+void QMQTT::ClientPrivate::setWriteCoalescing(const bool coalesce)
+{
+    _network->setWriteCoalescing(coalesce);
+}
+
+bool QMQTT::ClientPrivate::noDelay() const
+{
+    return _network->noDelay();
+}
+
+void QMQTT::ClientPrivate::setNoDelay(const bool noDelay)
+{
+    _network->setNoDelay(noDelay);
+}
+
 bool QMQTT::ClientPrivate::isConnectedToHost() const
 {
     return _network->isConnectedToHost();
@@ -33,6 +33,7 @@
 #define QMQTT_CLIENT_P_H
 
 #include "qmqtt_client.h"
+#include "qmqtt_frame.h"
 
 #include <QHostAddress>
 #include <QString>
@@ -105,6 +106,7 @@ public:
     QByteArray _willMessage;
     QHash<quint16, QString> _midToTopic;
     QHash<quint16, Message> _midToMessage;
+    Frame _publishFrame; // reused by sendPublish so its buffer isn't allocated again for every message
 
     Client* const q_ptr;
 
@@ -124,6 +126,7 @@ public:
     void onNetworkConnected();
     void onNetworkDisconnected();
     quint16 publish(const Message& message);
+    QList<quint16> publish(const QList<Message>& messages);
     void puback(const quint8 type, const quint16 msgid);
     void subscribe(const QString& topic, const quint8 qos);
     void unsubscribe(const QString& topic);
@@ -138,6 +141,10 @@ public:
     void setAutoReconnect(const bool autoReconnect);
     int autoReconnectInterval() const;
     void setAutoReconnectInterval(const int autoReconnectInterval);
+    bool writeCoalescing() const;
+    void setWriteCoalescing(const bool coalesce);
+    bool noDelay() const;
+    void setNoDelay(const bool noDelay);
     bool isConnectedToHost() const;
     QMQTT::ConnectionState connectionState() const;
     void setCleanSession(const bool cleanSession);
@@ -164,6 +164,15 @@ void Frame::writeRawData(const QByteArray &data)
     _data.append(data);
 }
 
+void Frame::reset(const quint8 header)
+{
+    _header = header;
+    // Qt 5 only keeps the buffer over resize(0) once it has been reserved
+    if (_data.capacity() < 64)
+        _data.reserve(64);
+    _data.resize(0);
+}
+
 void Frame::write(QDataStream &stream) const
 {
     QByteArray lenbuf;
@@ -190,6 +199,28 @@ void Frame::write(QDataStream &stream) const
     }
 }
 
+bool Frame::encode(QByteArray &out) const
+{
+    int length = _data.size();
+    if (length > 268435455)
+    {
+        qCritical("qmqtt: Control packet bigger than 256 MB, dropped!");
+        return false;
+    }
+
+    out.append(static_cast<char>(_header));
+    do {
+        quint8 d = length % 128;
+        length /= 128;
+        if (length > 0) {
+            d |= 0x80;
+        }
+        out.append(static_cast<char>(d));
+    } while (length > 0);
+    out.append(_data);
+    return true;
+}
+
 bool Frame::encodeLength(QByteArray &lenbuf, int length) const
 {
     lenbuf.clear();
@@ -121,8 +121,13 @@ public:
     void writeString(const QString &string);
     void writeRawData(const QByteArray &data);
 
+    // start over as an empty frame, keeping the data buffer for the next one
+    void reset(const quint8 header);
+
     //TODO: FIXME LATER
     void write(QDataStream &stream) const;
+    // appends the whole control packet (header, length and data) to out
+    bool encode(QByteArray &out) const;
     bool encodeLength(QByteArray &lenbuf, int length) const;
 
 private:
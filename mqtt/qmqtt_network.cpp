@@ -38,11 +38,13 @@
 #include "qmqtt_frame.h"
 
 #include <QDataStream>
+#include <QAbstractSocket>
 
 const quint16 DEFAULT_PORT = 1883;
 const quint16 DEFAULT_SSL_PORT = 8883;
 const bool DEFAULT_AUTORECONNECT = false;
 const int DEFAULT_AUTORECONNECT_INTERVAL_MS = 5000;
+const int DEFAULT_WRITE_BUFFER_SIZE = 4096;
 
 QMQTT::Network::Network(QObject* parent)
     : NetworkInterface(parent)
@@ -52,6 +54,9 @@ QMQTT::Network::Network(QObject* parent)
     , _socket(new QMQTT::Socket)
     , _autoReconnectTimer(new QMQTT::Timer)
     , _readState(Header)
+    , _coalesceWrites(false)
+    , _flushQueued(false)
+    , _noDelay(false)
 {
     initialize();
 }
@@ -65,6 +70,9 @@ QMQTT::Network::Network(const QSslConfiguration& config, QObject *parent)
     , _socket(new QMQTT::SslSocket(config))
     , _autoReconnectTimer(new QMQTT::Timer)
     , _readState(Header)
+    , _coalesceWrites(false)
+    , _flushQueued(false)
+    , _noDelay(false)
 {
     initialize();
     connect(_socket, &QMQTT::SslSocket::sslErrors, this, &QMQTT::Network::sslErrors);
@@ -84,6 +92,9 @@ QMQTT::Network::Network(const QString& origin,
     , _socket(new QMQTT::WebSocket(origin, version, sslConfig))
     , _autoReconnectTimer(new QMQTT::Timer)
     , _readState(Header)
+    , _coalesceWrites(false)
+    , _flushQueued(false)
+    , _noDelay(false)
 {
     initialize();
 }
@@ -99,6 +110,9 @@ QMQTT::Network::Network(const QString& origin,
     , _socket(new QMQTT::WebSocket(origin, version))
     , _autoReconnectTimer(new QMQTT::Timer)
     , _readState(Header)
+    , _coalesceWrites(false)
+    , _flushQueued(false)
+    , _noDelay(false)
 {
     initialize();
 }
@@ -113,6 +127,9 @@ QMQTT::Network::Network(SocketInterface* socketInterface, TimerInterface* timerI
     , _socket(socketInterface)
     , _autoReconnectTimer(timerInterface)
     , _readState(Header)
+    , _coalesceWrites(false)
+    , _flushQueued(false)
+    , _noDelay(false)
 {
     initialize();
 }
@@ -123,8 +140,9 @@ void QMQTT::Network::initialize()
     _autoReconnectTimer->setParent(this);
     _autoReconnectTimer->setSingleShot(true);
     _autoReconnectTimer->setInterval(_autoReconnectInterval);
+    _pending.reserve(DEFAULT_WRITE_BUFFER_SIZE);
 
-    QObject::connect(_socket, &SocketInterface::connected, this, &Network::connected);
+    QObject::connect(_socket, &SocketInterface::connected, this, &Network::onSocketConnected);
     QObject::connect(_socket, &SocketInterface::disconnected, this, &Network::onDisconnected);
     QObject::connect(_socket->ioDevice(), &QIODevice::readyRead, this, &Network::onSocketReadReady);
     QObject::connect(
@@ -163,6 +181,7 @@ void QMQTT::Network::connectToHost(const QString& hostName, const quint16 port)
 void QMQTT::Network::connectToHost()
 {
     _readState = Header;
+    _pending.resize(0); // whatever was held back was for the last connection
     if (_hostName.isEmpty())
     {
         _socket->connectToHost(_host, _port);
@@ -182,17 +201,74 @@ void QMQTT::Network::onSocketError(QAbstractSocket::SocketError socketError)
     }
 }
 
+void QMQTT::Network::onSocketConnected()
+{
+    // socket options only stick once there is a socket to put them on
+    QAbstractSocket *socket = qobject_cast<QAbstractSocket *>(_socket->ioDevice());
+    if (socket)
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, _noDelay ? 1 : 0);
+    emit connected();
+}
+
 void QMQTT::Network::sendFrame(const Frame& frame)
 {
-    if(_socket->state() == QAbstractSocket::ConnectedState)
+    if(_socket->state() != QAbstractSocket::ConnectedState)
+        return;
+
+    frame.encode(_pending);
+    if (!_coalesceWrites)
+    {
+        flush();
+    }
+    else if (!_flushQueued)
+    {
+        // one write for every frame sent before we get back to the event loop
+        _flushQueued = true;
+        QMetaObject::invokeMethod(this, [this]() { flush(); }, Qt::QueuedConnection);
+    }
+}
+
+void QMQTT::Network::flush()
+{
+    _flushQueued = false;
+    if (_pending.isEmpty())
+        return;
+    if (_socket->state() == QAbstractSocket::ConnectedState)
     {
-        QDataStream out(_socket->ioDevice());
-        frame.write(out);
+        if (_socket->ioDevice()->write(_pending) != _pending.size())
+            qCritical("qmqtt: Control packet write error!");
     }
+    _pending.resize(0); // keep allocated buffer
+}
+
+bool QMQTT::Network::writeCoalescing() const
+{
+    return _coalesceWrites;
+}
+
+void QMQTT::Network::setWriteCoalescing(const bool coalesce)
+{
+    _coalesceWrites = coalesce;
+    if (!coalesce)
+        flush();
+}
+
+bool QMQTT::Network::noDelay() const
+{
+    return _noDelay;
+}
+
+void QMQTT::Network::setNoDelay(const bool noDelay)
+{
+    _noDelay = noDelay;
+    QAbstractSocket *socket = qobject_cast<QAbstractSocket *>(_socket->ioDevice());
+    if (socket && socket->state() == QAbstractSocket::ConnectedState)
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, _noDelay ? 1 : 0);
 }
 
 void QMQTT::Network::disconnectFromHost()
 {
+    flush(); // a DISCONNECT that was held back still has to go out first
     _socket->disconnectFromHost();
 }
 
@@ -265,6 +341,7 @@ void QMQTT::Network::onSocketReadReady()
 
 void QMQTT::Network::onDisconnected()
 {
+    _pending.resize(0);
     emit disconnected();
     if(_autoReconnect)
     {
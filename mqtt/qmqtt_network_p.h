@@ -79,6 +79,11 @@ public:
     ~Network();
 
     void sendFrame(const Frame &frame);
+    bool writeCoalescing() const;
+    void setWriteCoalescing(const bool coalesce);
+    bool noDelay() const;
+    void setNoDelay(const bool noDelay);
+    void flush();
     bool isConnectedToHost() const;
     bool autoReconnect() const;
     void setAutoReconnect(const bool autoReconnect);
@@ -125,7 +130,13 @@ protected:
     int _shift;
     QByteArray _data;
 
+    QByteArray _pending; // encoded frames not written to the socket yet
+    bool _coalesceWrites;
+    bool _flushQueued;
+    bool _noDelay;
+
 protected slots:
+    void onSocketConnected();
     void onSocketReadReady();
     void onDisconnected();
     void connectToHost();
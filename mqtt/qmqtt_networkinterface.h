@@ -63,6 +63,14 @@ public:
     virtual int autoReconnectInterval() const = 0;
     virtual void setAutoReconnectInterval(const int autoReconnectInterval) = 0;
     virtual QAbstractSocket::SocketState state() const = 0;
+    // Coalescing holds frames back until control returns to the event loop and writes them in one go.
+    // Turning it off writes out anything held right away.
+    virtual bool writeCoalescing() const { return false; }
+    virtual void setWriteCoalescing(const bool coalesce) { Q_UNUSED(coalesce); }
+    // TCP_NODELAY, for connections that send small frames and don't want them held up by Nagle
+    virtual bool noDelay() const { return false; }
+    virtual void setNoDelay(const bool noDelay) { Q_UNUSED(noDelay); }
+    virtual void flush() {}
 #ifndef QT_NO_SSL
     virtual void ignoreSslErrors(const QList<QSslError>& errors) = 0;
     virtual QSslConfiguration sslConfiguration() const = 0;
@@ -0,0 +1,84 @@
+#ifndef OBJECTARENA_H
+#define OBJECTARENA_H
+
+#include <QVector>
+#include <new>
+#include <utility>
+
+//about how much one block of an arena takes. Types bigger than this get a block each
+#define OBJECTARENA_BLOCK_BYTES     65536
+
+/*
+ * Home for the small objects kept per ID (or per sender) that live until the whole lot is cleared: reassembly
+ * sessions, per ID statistics and the like. They're made in blocks of as many as fit in OBJECTARENA_BLOCK_BYTES
+ * and never freed one at a time, so a bus with thousands of IDs costs a few dozen allocations instead of thousands,
+ * neighbouring IDs end up next to each other in memory and clear() is one pass over the blocks rather than a free
+ * per object.
+ *
+ * Pointers from create() stay good until clear() or the arena going away, so the usual QHash<key, T *> in front of
+ * it doesn't change. Not thread safe, whoever owns the hash owns the arena.
+ */
+template<typename T>
+class ObjectArena
+{
+public:
+    ObjectArena() {}
+    ~ObjectArena() { release(); }
+
+    template<typename... Args>
+    T *create(Args &&... args)
+    {
+        if (used == perBlock)
+        {
+            current++;
+            used = 0;
+        }
+        if (current >= blocks.count()) blocks.append(static_cast<T *>(::operator new(sizeof(T) * perBlock)));
+        T *obj = new (blocks.at(current) + used) T(std::forward<Args>(args)...);
+        used++;
+        live++;
+        return obj;
+    }
+
+    //destroys every object. The first block is kept for next time since the same IDs usually come straight back
+    void clear()
+    {
+        destroyAll();
+        for (int i = 1; i < blocks.count(); i++) ::operator delete(blocks.at(i));
+        if (blocks.count() > 1) blocks.resize(1);
+    }
+
+    int count() const { return live; }
+    qint64 bytes() const { return static_cast<qint64>(blocks.count()) * perBlock * static_cast<qint64>(sizeof(T)); }
+
+private:
+    Q_DISABLE_COPY(ObjectArena)
+    static const int perBlock = (sizeof(T) >= OBJECTARENA_BLOCK_BYTES) ? 1 : static_cast<int>(OBJECTARENA_BLOCK_BYTES / sizeof(T));
+
+    void destroyAll()
+    {
+        //every block before current is full, current has used of them
+        for (int b = 0; b <= current && b < blocks.count(); b++)
+        {
+            int n = (b < current) ? perBlock : used;
+            for (int i = 0; i < n; i++) blocks.at(b)[i].~T();
+        }
+        current = 0;
+        used = 0;
+        live = 0;
+    }
+
+    void release()
+    {
+        destroyAll();
+        for (T *block : qAsConst(blocks)) ::operator delete(block);
+        blocks.clear();
+    }
+
+    QVector<T *> blocks;
+    int current = 0; //block create() is filling
+    int used = 0; //objects in it so far
+    int live = 0;
+};
+
+#endif // OBJECTARENA_H
@@ -0,0 +1,102 @@
+#include "payloadchangetable.h"
+#include "canframestore.h"
+
+#include <cstring>
+
+PayloadChangeTable::PayloadChangeTable()
+{
+    defaultMask = makeMask(QByteArray());
+}
+
+PayloadChangeTable::Mask PayloadChangeTable::makeMask(const QByteArray &ignore)
+{
+    Mask mask;
+    uint8_t bytes[PAYLOADCHANGE_WORDS * 8];
+    memset(bytes, 0xFF, sizeof(bytes));
+    int len = qMin(static_cast<int>(ignore.length()), static_cast<int>(sizeof(bytes)));
+    for (int i = 0; i < len; i++) bytes[i] = static_cast<uint8_t>(~ignore.at(i));
+    memcpy(mask.keep, bytes, sizeof(bytes)); //same byte order the payloads get loaded in
+    return mask;
+}
+
+void PayloadChangeTable::setIgnoreMask(const QByteArray &mask)
+{
+    defaultMaskBytes = mask;
+    defaultMask = makeMask(mask);
+}
+
+void PayloadChangeTable::setIgnoreMask(uint32_t id, const QByteArray &mask)
+{
+    if (mask.isEmpty()) idMasks.remove(id);
+    else idMasks.insert(id, makeMask(mask));
+}
+
+void PayloadChangeTable::clearIdMasks()
+{
+    idMasks.clear();
+}
+
+void PayloadChangeTable::reset()
+{
+    last.clear();
+    fdWords.clear();
+}
+
+qint64 PayloadChangeTable::bytes() const
+{
+    return static_cast<qint64>(last.capacity()) * static_cast<qint64>(sizeof(uint64_t) + sizeof(Last) + 2 * sizeof(void *))
+           + static_cast<qint64>(fdWords.capacity()) * static_cast<qint64>(sizeof(uint64_t));
+}
+
+bool PayloadChangeTable::update(uint32_t id, int bus, int len, const uint8_t *payload)
+{
+    len = qBound(0, len, PAYLOADCHANGE_WORDS * 8);
+    const Mask *mask = &defaultMask;
+    if (!idMasks.isEmpty())
+    {
+        QHash<uint32_t, Mask>::const_iterator it = idMasks.constFind(id);
+        if (it != idMasks.constEnd()) mask = &it.value();
+    }
+
+    uint64_t words[PAYLOADCHANGE_WORDS] = {0};
+    memcpy(words, payload, len);
+    const int used = (len + 7) / 8;
+    for (int w = 0; w < used; w++) words[w] &= mask->keep[w];
+
+    QHash<uint64_t, Last>::iterator it = last.find(CANFrameStore::idKey(id, bus));
+    if (it == last.end())
+    {
+        Last entry;
+        entry.first = words[0];
+        entry.len = static_cast<uint8_t>(len);
+        entry.fdSlot = -1;
+        if (used > 1)
+        {
+            entry.fdSlot = fdWords.count();
+            for (int w = 1; w < PAYLOADCHANGE_WORDS; w++) fdWords.append(words[w]);
+        }
+        last.insert(CANFrameStore::idKey(id, bus), entry);
+        return true;
+    }
+
+    Last &prev = it.value();
+    bool changed = (prev.len != len) || (prev.first != words[0]);
+    prev.first = words[0];
+    prev.len = static_cast<uint8_t>(len);
+    if (used > 1 || prev.fdSlot >= 0)
+    {
+        if (prev.fdSlot < 0)
+        {
+            prev.fdSlot = fdWords.count();
+            fdWords.resize(fdWords.count() + PAYLOADCHANGE_WORDS - 1);
+        }
+        //words past the end are zero so a shorter payload leaves them that way for the next compare
+        uint64_t *rest = fdWords.data() + prev.fdSlot;
+        for (int w = 1; w < PAYLOADCHANGE_WORDS; w++)
+        {
+            changed |= (rest[w - 1] != words[w]);
+            rest[w - 1] = words[w];
+        }
+    }
+    return changed;
+}
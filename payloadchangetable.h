@@ -0,0 +1,68 @@
+#ifndef PAYLOADCHANGETABLE_H
+#define PAYLOADCHANGETABLE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include "can_structs.h"
+
+//64 bit words in the largest (CAN-FD) payload
+#define PAYLOADCHANGE_WORDS     8
+
+/*
+ * The last payload of every bus / ID pair, for the changes only view of the main frame list. Each frame gets
+ * compared with the one before it from the same pair and only counts if something's different. Classic payloads
+ * are one 64 bit compare. FD pairs keep their other seven words off to the side so the table stays small for the
+ * usual classic bus.
+ *
+ * Ignore masks take bits out of the compare, so a rolling counter or checksum doesn't make every frame look new.
+ * There's one for every ID and any ID can have its own instead. Payloads are kept with the masked bits already
+ * cleared, so change a mask and reset() before feeding the frames through again.
+ */
+class PayloadChangeTable
+{
+public:
+    PayloadChangeTable();
+
+    //true if this frame's payload isn't the same as the last one of its bus / ID once the ignored bits are out.
+    //A different length or the first frame of a pair counts as a change. Either way it becomes the last one
+    bool update(uint32_t id, int bus, int len, const uint8_t *payload);
+    bool update(const CANFrameRecord &rec, const uint8_t *payload) { return update(rec.frameId(), rec.bus, rec.len, payload); }
+    bool update(const CANFrame &frame)
+    {
+        return update(frame.frameId(), frame.bus, frame.payload().length(), reinterpret_cast<const uint8_t *>(frame.payload().constData()));
+    }
+
+    //set bits get ignored. Bytes past the end of the mask are all compared. Empty takes the mask off
+    void setIgnoreMask(const QByteArray &mask);
+    void setIgnoreMask(uint32_t id, const QByteArray &mask);
+    QByteArray ignoreMask() const { return defaultMaskBytes; }
+    void clearIdMasks(); //the one for every ID stays
+
+    void reset(); //forgets the payloads, keeps the masks
+    int count() const { return last.count(); }
+    qint64 bytes() const;
+
+private:
+    struct Mask
+    {
+        uint64_t keep[PAYLOADCHANGE_WORDS]; //bits that get compared
+    };
+
+    struct Last
+    {
+        uint64_t first; //first eight bytes, masked
+        int fdSlot; //where the other words are in fdWords, -1 for a pair only seen with classic payloads
+        uint8_t len;
+    };
+
+    static Mask makeMask(const QByteArray &ignore);
+
+    QHash<uint64_t, Last> last; //CANFrameStore::idKey -> last payload
+    QVector<uint64_t> fdWords; //PAYLOADCHANGE_WORDS - 1 words for each FD pair
+    Mask defaultMask;
+    QByteArray defaultMaskBytes;
+    QHash<uint32_t, Mask> idMasks;
+};
+
+#endif // PAYLOADCHANGETABLE_H
@@ -1,214 +1,345 @@
 #include <math.h>
+#include <string.h>
+#include <QFile>
+#include <QtEndian>
 #include "pcaplite.h"
 
 #define MAGIC_NG 0x0A0D0D0A
-#define MACIG 0xA1B2C3D4  
-
-#define MAX_CAN_PACKET_SIZE 256
+#define MACIG 0xA1B2C3D4
+#define MAGIC_NANO 0xA1B23C4D
+#define BYTE_ORDER_MAGIC 0x1A2B3C4D
 
 // some pcap format constants
 #define PCAP_FILE_HEADER_LENGTH 24
 #define PCAP_FRAME_HEADER_LENGTH 16
 #define PCAP_CAP_FRAME_LENGTH_OFFSET 8
 #define PCAP_FRAME_LENGTH_OFFSET 12
+#define PCAP_LINKTYPE_OFFSET 20
 
 // some pcapng format constants
+#define SECTION_HEADER_BLOCK MAGIC_NG
 #define INTERFACE_DESCRITION_BLOCK 0x01
 #define ENCHANCED_PACKET_BLOCK 0x06
+#define EPB_HEADER_LENGTH 28 //type, size, interface, two timestamp halves, both lengths
+#define OPT_ENDOFOPT 0
+#define OPT_IF_NAME 2
+#define OPT_IF_TSRESOL 9
+#define OPT_EPB_FLAGS 2
+#define EPB_DIRECTION_OUTBOUND 2
 
-static unsigned char pcap_buffer[MAX_CAN_PACKET_SIZE];
-static pcap_t p;
+#define PCAPNG_FLUSH_SIZE (1024 * 1024)
 
-pcap *pcap_open_offline(const char *filename, char *error_text) {
-	FILE *file;
+static unsigned int pad4(unsigned int len)
+{
+    return (len + 3) & ~3u;
+}
 
-    snprintf(error_text, PCAP_ERRBUF_SIZE, "OK");
+static unsigned int read32(const pcap_t *p, unsigned long long at)
+{
+    unsigned int value = qFromLittleEndian<quint32>(p->data + at);
+    return p->swapped ? qbswap(value) : value;
+}
+
+static unsigned short read16(const pcap_t *p, unsigned long long at)
+{
+    unsigned short value = qFromLittleEndian<quint16>(p->data + at);
+    return p->swapped ? qbswap(value) : value;
+}
 
-    file = fopen(filename,"rb");
+static double resolution_multiplier(unsigned char res)
+{
+    if ((0x80 & res) == 0) return 1/pow(10, res);
+    return 1/pow(2, (res & 0x7f));
+}
+
+pcap *pcap_open_offline(const char *filename, char *error_text) {
+    snprintf(error_text, PCAP_ERRBUF_SIZE, "OK");
 
-    if (NULL == file) {
-        snprintf(error_text, PCAP_ERRBUF_SIZE,
-               "Cannot open input file");
+    QFile *file = new QFile(QString::fromLocal8Bit(filename));
+    if (!file->open(QIODevice::ReadOnly)) {
+        snprintf(error_text, PCAP_ERRBUF_SIZE, "Cannot open input file");
+        delete file;
         return NULL;
     }
 
-	unsigned int magic;
-	size_t bytes_read;
+    pcap_t *p = new pcap_t;
+    p->file = file;
+    p->size = static_cast<unsigned long long>(file->size());
+    p->data = file->size() > 0 ? file->map(0, file->size()) : NULL;
+    if (!p->data) {
+        p->copy = file->readAll();
+        p->data = reinterpret_cast<const unsigned char *>(p->copy.constData());
+        p->size = static_cast<unsigned long long>(p->copy.size());
+    }
+    p->pos = 0;
+    p->swapped = false;
+    p->linktype = DLT_LINUX_SLL;
+    p->timestamp_multiplier = 0.000001; //microseconds resolution
+
+    if (p->size < PCAP_FILE_HEADER_LENGTH) {
+        snprintf(error_text, PCAP_ERRBUF_SIZE, "Cannot read magic word");
+        pcap_close(p);
+        return NULL;
+    }
 
-	bytes_read = fread(&magic, 1, sizeof(magic), file);
-	if (bytes_read != sizeof(magic)) {
-		snprintf(error_text, PCAP_ERRBUF_SIZE, "Cannot read magic word");
-        fclose(file);
-		return (NULL);
-	}
+    unsigned int magic = qFromLittleEndian<quint32>(p->data);
+    if (MAGIC_NG == magic) {
+        // the first section header gets read like any other block by pcap_next
+        p->is_ng = true;
+        return p;
+    }
 
-    if (magic != MACIG && magic != MAGIC_NG) {
+    p->is_ng = false;
+    if (magic == qbswap<quint32>(MACIG) || magic == qbswap<quint32>(MAGIC_NANO)) {
+        p->swapped = true;
+        magic = qbswap(magic);
+    }
+    if (magic != MACIG && magic != MAGIC_NANO) {
         snprintf(error_text, PCAP_ERRBUF_SIZE, "Not a supported format %04x", magic);
-        fclose(file);
-		return (NULL);
+        pcap_close(p);
+        return NULL;
     }
+    if (MAGIC_NANO == magic) p->timestamp_multiplier = 0.000000001;
+    p->linktype = static_cast<int>(read32(p, PCAP_LINKTYPE_OFFSET) & 0xFFFF);
+    p->pos = PCAP_FILE_HEADER_LENGTH;
 
-    // set the format
-    // and seek past file header
-    if (MAGIC_NG == magic) {
-        p.is_ng = 1;
-        fseek(file, sizeof(magic), SEEK_SET);
-        unsigned int  section_length;
-        bytes_read = fread(&section_length, 1, sizeof(section_length), file);
-        if (bytes_read != sizeof(section_length)) {
-		    snprintf(error_text, PCAP_ERRBUF_SIZE, "Cannot read section length");
-            fclose(file);
-		    return (NULL);
-	    }
-        fseek(file, section_length, SEEK_SET);
-        
-    } else {
-        p.is_ng = 0;
-        fseek(file, PCAP_FILE_HEADER_LENGTH, SEEK_SET);
+    return p;
+}
+
+//a new section, which sets the byte order and throws out the interfaces of the last one
+static bool pcap_read_section(pcap_t *p, unsigned long long at)
+{
+    if (at + 12 > p->size) return false;
+    unsigned int bom = qFromLittleEndian<quint32>(p->data + at + 8);
+    if (bom == BYTE_ORDER_MAGIC) p->swapped = false;
+    else if (bom == qbswap<quint32>(BYTE_ORDER_MAGIC)) p->swapped = true;
+    else return false;
+    p->interfaces.clear();
+    return true;
+}
+
+static void pcap_read_interface(pcap_t *p, unsigned long long at, unsigned int block_size)
+{
+    pcap_interface iface;
+    iface.linktype = read16(p, at + 8);
+    iface.timestamp_multiplier = 0.000001; //microseconds resolution
+
+    // options start after type, size, link type, reserved and snaplen
+    unsigned long long opt = at + 16;
+    unsigned long long end = at + block_size - 4;
+    while (opt + 4 <= end) {
+        unsigned short option_type = read16(p, opt);
+        unsigned short option_length = read16(p, opt + 2);
+        if (OPT_ENDOFOPT == option_type) break;
+        if (OPT_IF_TSRESOL == option_type && option_length >= 1 && opt + 5 <= end) {
+            iface.timestamp_multiplier = resolution_multiplier(p->data[opt + 4]);
+        }
+        opt += 4 + pad4(option_length);
     }
+    p->interfaces.push_back(iface);
+}
+
+static const unsigned char *pcap_next_ng(pcap_t *p, struct pcap_pkthdr *h) {
+    while (p->pos + 12 <= p->size) {
+        unsigned long long at = p->pos;
+        unsigned int block_type = qFromLittleEndian<quint32>(p->data + at);
+        if (SECTION_HEADER_BLOCK == block_type && !pcap_read_section(p, at)) return NULL;
 
-    p.file = file;
-	
-	return(&p);
-}
-
-const unsigned char *pcap_next_ng(pcap_t *p, struct pcap_pkthdr *h) {
-    // this is for ENCHANCED_PACKET_BLOCK
-    struct block_header { 
-        unsigned int block_type;
-        unsigned int block_size;
-        unsigned int interface_id;
-        unsigned int timestamp_hi;
-        unsigned int timestamp_lo;
-        unsigned int cap_len;
-        unsigned int len;
-    } bh;
-
-    struct option_header {
-        unsigned short option_type;
-        unsigned short option_length;
-    } oh;
-
-    size_t bytes_read;
-
-    static double timestamp_multiplier = 0.000001; //microseconds resolution
-
-    long fpos = ftell(p->file);
-    
-    do {
-        bytes_read = fread(&bh, 1, sizeof(bh), p->file);
-        if (bytes_read != sizeof(bh)) {
-            //probably EOF
-            return (NULL);
+        unsigned int block_size = read32(p, at + 4);
+        if (block_size < 12 || at + block_size > p->size) {
+            //probably a cut off file
+            return NULL;
         }
+        p->pos = at + pad4(block_size);
 
-        if (bh.block_type != ENCHANCED_PACKET_BLOCK) {
-            if (INTERFACE_DESCRITION_BLOCK == bh.block_type) {
-                // Seek to start of options part in the header
-                fseek(p->file, fpos + 16, SEEK_SET);
-                do {
-                    bytes_read = fread(&oh, 1, sizeof(oh), p->file);
-                    if (bytes_read != sizeof(oh)) {
-                        //probably EOF
-                        return (NULL);
-                    }
-                    
-                    // calculate option length aligned on 4 byte boundary
-                    unsigned int option_file_length = 4*(oh.option_length/4) + ((oh.option_length%4) ? 4:0);
-
-                    
-                    // read in the buffer if it's large enough or skip
-                    if (option_file_length <= sizeof(pcap_buffer)) {
-                        bytes_read = fread(pcap_buffer, 1, option_file_length, p->file);
-                        if (bytes_read != option_file_length) {
-                            //probably EOF
-		                    return (NULL);
-	                    }
-                        //check if time resolution option
-                        if (0x09 == oh.option_type) {
-                            unsigned int res = *(unsigned int*)pcap_buffer;
-                            if ((0x80000000 & res) == 0) {
-                                timestamp_multiplier = 1/pow(10, res); 
-                            } else {
-                               timestamp_multiplier = 1/pow(2, (res & 0x7fffffff));  
-                            }
-                        }
-                    } else if (fseek(p->file, option_file_length, SEEK_CUR)) {
-                        //probably EOF
-		                return (NULL);
-                    }
-
-                } while(ftell(p->file) < fpos + bh.block_size - sizeof(bh.block_size));
-
-                if (fseek(p->file, sizeof(bh.block_size), SEEK_CUR)) {
-                        //probably EOF
-		                return (NULL);
-                }
-            }
+        if (INTERFACE_DESCRITION_BLOCK == read32(p, at)) {
+            pcap_read_interface(p, at, block_size);
+            continue;
+        }
+        if (ENCHANCED_PACKET_BLOCK != read32(p, at) || block_size < EPB_HEADER_LENGTH + 4) continue;
+
+        h->interface_id = read32(p, at + 8);
+        h->caplen = read32(p, at + 20);
+        h->len = read32(p, at + 24);
+        if (EPB_HEADER_LENGTH + static_cast<unsigned long long>(pad4(h->caplen)) + 4 > block_size) return NULL;
+
+        double timestamp_multiplier = 0.000001;
+        h->linktype = DLT_LINUX_SLL;
+        if (h->interface_id < p->interfaces.size()) {
+            timestamp_multiplier = p->interfaces[h->interface_id].timestamp_multiplier;
+            h->linktype = p->interfaces[h->interface_id].linktype;
+        }
 
-            // skip to the next block
-            if (fseek(p->file, fpos + bh.block_size, SEEK_SET)) {
-                //probably EOF
-		        return (NULL);
+        double timestamp = ((unsigned long long)read32(p, at + 12) << 32 | read32(p, at + 16)) * timestamp_multiplier;
+        double fractional, integer;
+        fractional = modf(timestamp, &integer);
+        h->ts.tv_sec = (long)integer;
+        h->ts.tv_usec = (long)(fractional * 1000000);
+
+        h->outbound = false;
+        unsigned long long opt = at + EPB_HEADER_LENGTH + pad4(h->caplen);
+        unsigned long long end = at + block_size - 4;
+        while (opt + 4 <= end) {
+            unsigned short option_type = read16(p, opt);
+            unsigned short option_length = read16(p, opt + 2);
+            if (OPT_ENDOFOPT == option_type) break;
+            if (OPT_EPB_FLAGS == option_type && option_length >= 4 && opt + 8 <= end) {
+                h->outbound = (read32(p, opt + 4) & 3) == EPB_DIRECTION_OUTBOUND;
             }
-            fpos = ftell(p->file);
+            opt += 4 + pad4(option_length);
         }
-    } while (bh.block_type != ENCHANCED_PACKET_BLOCK);
-
-    h->caplen = bh.cap_len;
-    
-    double timestamp = ((unsigned long long)bh.timestamp_hi << 32 | bh.timestamp_lo) * timestamp_multiplier;
-    double fractional, integer;
-
-    fractional = modf(timestamp, &integer);
-    h->ts.tv_sec = (long)integer;
-    h->ts.tv_usec = (long)(fractional * 1000000);
-    
-    bytes_read = fread(pcap_buffer, 1, h->caplen, p->file);
-    if (bytes_read != h->caplen) {
-        //probably EOF
-		return (NULL);
-	}
-   
-    //seek to the next block (go back with bytes read of the block and seek fwd with the block size)
-    if (fseek(p->file, fpos + bh.block_size, SEEK_SET)) {
-        //probably EOF
-		return (NULL);
-    }
 
-    return pcap_buffer;
+        return p->data + at + EPB_HEADER_LENGTH;
+    }
+    return NULL;
 }
 
-
 const unsigned char *pcap_next(pcap_t *p, struct pcap_pkthdr *h)
 {
     if (p->is_ng) {
         return pcap_next_ng(p, h);
     }
 
-	size_t bytes_read;
-
-	bytes_read = fread(pcap_buffer, 1, PCAP_FRAME_HEADER_LENGTH, p->file);
-    if (bytes_read != PCAP_FRAME_HEADER_LENGTH) {
+    if (p->pos + PCAP_FRAME_HEADER_LENGTH > p->size) {
         //probably EOF
-		return (NULL);
-	}
+        return NULL;
+    }
 
-    h->ts.tv_sec = *(unsigned int*)(pcap_buffer);
-    h->ts.tv_usec = *(unsigned int*)(pcap_buffer + 4);
+    unsigned long long at = p->pos;
+    h->caplen = read32(p, at + PCAP_CAP_FRAME_LENGTH_OFFSET);
+    h->len = read32(p, at + PCAP_FRAME_LENGTH_OFFSET);
+    if (at + PCAP_FRAME_HEADER_LENGTH + h->caplen > p->size) {
+        //probably EOF
+        return NULL;
+    }
 
-    h->caplen = *(unsigned int*)(pcap_buffer + PCAP_CAP_FRAME_LENGTH_OFFSET);
-    h->len = *(unsigned int*)(pcap_buffer + PCAP_FRAME_LENGTH_OFFSET);
+    h->ts.tv_sec = read32(p, at);
+    h->ts.tv_usec = read32(p, at + 4);
+    if (p->timestamp_multiplier < 0.000001) h->ts.tv_usec /= 1000;
+    h->linktype = p->linktype;
+    h->interface_id = 0;
+    h->outbound = false;
+    p->pos = at + PCAP_FRAME_HEADER_LENGTH + h->caplen;
 
-    bytes_read = fread(pcap_buffer, 1, h->caplen, p->file);
-    if (bytes_read != h->caplen) {
-        //probably EOF
-		return (NULL);
-	}
+    return p->data + at + PCAP_FRAME_HEADER_LENGTH;
+}
 
-    return pcap_buffer;
+int pcap_progress(pcap_t *p)
+{
+    return p->size ? static_cast<int>(p->pos * 1000 / p->size) : 1000;
 }
 
 void pcap_close(pcap_t *p) {
-    fclose(p->file);
+    p->file->close();
+    delete p->file;
+    delete p;
+}
+
+static void put32(QByteArray &out, unsigned int value)
+{
+    uchar bytes[4];
+    qToLittleEndian<quint32>(value, bytes);
+    out.append(reinterpret_cast<const char *>(bytes), 4);
+}
+
+static void put16(QByteArray &out, unsigned short value)
+{
+    uchar bytes[2];
+    qToLittleEndian<quint16>(value, bytes);
+    out.append(reinterpret_cast<const char *>(bytes), 2);
+}
+
+static void pcapng_flush(pcapng_dumper *d)
+{
+    if (d->buffer.isEmpty()) return;
+    if (d->file->write(d->buffer) != d->buffer.size()) d->failed = true;
+    d->buffer.clear();
+}
+
+pcapng_dumper *pcapng_dump_open(const char *filename, char *error_text)
+{
+    snprintf(error_text, PCAP_ERRBUF_SIZE, "OK");
+
+    QFile *file = new QFile(QString::fromLocal8Bit(filename));
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        snprintf(error_text, PCAP_ERRBUF_SIZE, "Cannot open output file");
+        delete file;
+        return NULL;
+    }
+
+    pcapng_dumper *d = new pcapng_dumper;
+    d->file = file;
+    d->interfaces = 0;
+    d->failed = false;
+    d->buffer.reserve(PCAPNG_FLUSH_SIZE + 1024);
+
+    // section header, version 1.0 and unknown section length
+    put32(d->buffer, SECTION_HEADER_BLOCK);
+    put32(d->buffer, 28);
+    put32(d->buffer, BYTE_ORDER_MAGIC);
+    put16(d->buffer, 1);
+    put16(d->buffer, 0);
+    put32(d->buffer, 0xFFFFFFFF);
+    put32(d->buffer, 0xFFFFFFFF);
+    put32(d->buffer, 28);
+
+    return d;
+}
+
+int pcapng_add_interface(pcapng_dumper *d, int linktype, unsigned int snaplen, const char *name)
+{
+    unsigned int name_length = static_cast<unsigned int>(strlen(name));
+    unsigned int block_size = 20 + 4 + pad4(name_length) + 8 + 4 + 4;
+
+    put32(d->buffer, INTERFACE_DESCRITION_BLOCK);
+    put32(d->buffer, block_size);
+    put16(d->buffer, static_cast<unsigned short>(linktype));
+    put16(d->buffer, 0);
+    put32(d->buffer, snaplen);
+    put16(d->buffer, OPT_IF_NAME);
+    put16(d->buffer, static_cast<unsigned short>(name_length));
+    d->buffer.append(name, static_cast<int>(name_length));
+    d->buffer.append(static_cast<int>(pad4(name_length) - name_length), 0);
+    put16(d->buffer, OPT_IF_TSRESOL);
+    put16(d->buffer, 1);
+    d->buffer.append(static_cast<char>(6)); //microseconds
+    d->buffer.append(3, 0);
+    put32(d->buffer, OPT_ENDOFOPT);
+    put32(d->buffer, block_size);
+
+    return static_cast<int>(d->interfaces++);
+}
+
+void pcapng_dump(pcapng_dumper *d, unsigned int interface_id, unsigned long long timestamp_us, const unsigned char *data, unsigned int len, bool outbound)
+{
+    unsigned int block_size = EPB_HEADER_LENGTH + pad4(len) + (outbound ? 12 : 0) + 4;
+
+    put32(d->buffer, ENCHANCED_PACKET_BLOCK);
+    put32(d->buffer, block_size);
+    put32(d->buffer, interface_id);
+    put32(d->buffer, static_cast<unsigned int>(timestamp_us >> 32));
+    put32(d->buffer, static_cast<unsigned int>(timestamp_us & 0xFFFFFFFF));
+    put32(d->buffer, len);
+    put32(d->buffer, len);
+    d->buffer.append(reinterpret_cast<const char *>(data), static_cast<int>(len));
+    d->buffer.append(static_cast<int>(pad4(len) - len), 0);
+    if (outbound) {
+        put16(d->buffer, OPT_EPB_FLAGS);
+        put16(d->buffer, 4);
+        put32(d->buffer, EPB_DIRECTION_OUTBOUND);
+        put32(d->buffer, OPT_ENDOFOPT);
+    }
+    put32(d->buffer, block_size);
+
+    if (d->buffer.size() >= PCAPNG_FLUSH_SIZE) pcapng_flush(d);
+}
+
+bool pcapng_dump_close(pcapng_dumper *d)
+{
+    pcapng_flush(d);
+    d->file->close();
+    bool ok = !d->failed;
+    delete d->file;
+    delete d;
+    return ok;
 }
@@ -7,26 +7,82 @@
 #else
 #include <winsock.h>
 #endif
+#include <QByteArray>
+#include <vector>
+
+class QFile;
 
 #define PCAP_ERRBUF_SIZE 256
 
+//link types pcaplite knows how to pull CAN frames out of
+#define DLT_LINUX_SLL 113 //Linux cooked capture, 16 byte header then the SocketCAN frame in host byte order
+#define DLT_CAN_SOCKETCAN 227 //SocketCAN frame, ID big endian
+#define DLT_LINUX_SLL2 276 //Linux cooked capture v2, 20 byte header
+
 struct pcap_pkthdr {
 	struct timeval ts;	/* time stamp */
 	unsigned int caplen;	/* length of portion present */
 	unsigned int len;	/* length of this packet (off wire) */
+    //pcaplite only, libpcap gives these per file
+    int linktype;
+    unsigned int interface_id; //always 0 for pcap files
+    bool outbound; //from the pcapng epb_flags option, false when it isn't there
+};
+
+struct pcap_interface {
+    int linktype;
+    double timestamp_multiplier; //seconds per timestamp unit
 };
 
+/*
+ * The whole file is mapped (or read in one go when it can't be) and packets come straight out of the mapping, so
+ * pcap_next is just a few header reads and never copies. Both byte orders of pcap and pcapng are handled, pcapng
+ * files can have any number of interfaces and sections.
+ */
 struct pcap {
-    FILE *file;
+    QFile *file;
+    QByteArray copy; //the file, when mapping didn't work
+    const unsigned char *data;
+    unsigned long long size;
+    unsigned long long pos;
     bool is_ng;
+    bool swapped;
+    int linktype; //pcap only
+    double timestamp_multiplier; //pcap only
+    std::vector<pcap_interface> interfaces; //pcapng, of the current section
 };
 
 typedef struct pcap pcap_t;
 
 pcap *pcap_open_offline(const char *, char *);
 
+//the packet stays good until pcap_close
 const unsigned char *pcap_next(pcap_t *, struct pcap_pkthdr *);
 
+//how far through the file pcap_next has got, 0 to 1000
+int pcap_progress(pcap_t *);
+
 void pcap_close(pcap_t *);
 
+/*
+ * pcapng writer. Blocks are gathered in memory and written a megabyte or so at a time. Interfaces can be added
+ * whenever, as long as it's before the first packet on them.
+ */
+struct pcapng_dumper {
+    QFile *file;
+    QByteArray buffer;
+    unsigned int interfaces;
+    bool failed;
+};
+
+pcapng_dumper *pcapng_dump_open(const char *filename, char *error_text);
+
+//returns the new interface's ID. Timestamps on it are in microseconds
+int pcapng_add_interface(pcapng_dumper *, int linktype, unsigned int snaplen, const char *name);
+
+void pcapng_dump(pcapng_dumper *, unsigned int interface_id, unsigned long long timestamp_us, const unsigned char *data, unsigned int len, bool outbound);
+
+//false if anything couldn't be written
+bool pcapng_dump_close(pcapng_dumper *);
+
 #endif// PCAPLITE_H
@@ -0,0 +1,321 @@
+#include "pipelinetrace.h"
+#include "qcustomplot.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 startNs;
+    qint64 endNs;
+};
+
+/*
+ * One thread's slices. Only that thread writes, it stores the slice then moves written on with a release so an
+ * exporter that loads written with acquire sees every slice up to there. Buffers outlive their threads so what they
+ * recorded can still be exported, a thread that starts later takes over a free one.
+ */
+struct ThreadBuffer
+{
+    QVector<TraceEvent> events;
+    QAtomicInteger<quint64> written;
+    QAtomicInt inUse;
+    QString threadName;
+    int tid;
+};
+
+QAtomicInt recording;
+QMutex buffersLock; //only for handing buffers out and for exporting, never on the recording path
+QList<ThreadBuffer *> buffers;
+
+const QElapsedTimer &traceClock()
+{
+    static QElapsedTimer clock = []() { QElapsedTimer timer; timer.start(); return timer; }();
+    return clock;
+}
+
+ThreadBuffer *claimBuffer()
+{
+    QMutexLocker lock(&buffersLock);
+    ThreadBuffer *buffer = nullptr;
+    for (ThreadBuffer *candidate : qAsConst(buffers))
+    {
+        if (candidate->inUse.loadRelaxed()) continue;
+        buffer = candidate;
+        break;
+    }
+    if (!buffer)
+    {
+        buffer = new ThreadBuffer;
+        buffer->events.resize(TRACE_BUFFER_EVENTS);
+        buffer->tid = buffers.count() + 1;
+        buffers.append(buffer);
+    }
+    buffer->inUse.storeRelaxed(1);
+    buffer->written.storeRelease(0);
+
+    QThread *thread = QThread::currentThread();
+    if (!thread->objectName().isEmpty()) buffer->threadName = thread->objectName();
+    else if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) buffer->threadName = "GUI";
+    else buffer->threadName = QString("Thread %1").arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    return buffer;
+}
+
+//gives the buffer back when its thread ends
+struct ThreadBufferHandle
+{
+    ThreadBuffer *buffer = nullptr;
+    ~ThreadBufferHandle() { if (buffer) buffer->inUse.storeRelease(0); }
+};
+
+thread_local ThreadBufferHandle threadBuffer;
+
+//a copy of every slice recorded, per buffer and in the order they finished
+QVector<QPair<ThreadBuffer *, QVector<TraceEvent>>> snapshot()
+{
+    QVector<QPair<ThreadBuffer *, QVector<TraceEvent>>> out;
+    QMutexLocker lock(&buffersLock);
+    for (ThreadBuffer *buffer : qAsConst(buffers))
+    {
+        quint64 written = buffer->written.loadAcquire();
+        if (written == 0) continue;
+        quint64 first = written > TRACE_BUFFER_EVENTS ? written - TRACE_BUFFER_EVENTS : 0;
+        QVector<TraceEvent> events;
+        events.reserve(static_cast<int>(written - first));
+        for (quint64 i = first; i < written; i++) events.append(buffer->events.at(static_cast<int>(i % TRACE_BUFFER_EVENTS)));
+        out.append(qMakePair(buffer, events));
+    }
+    return out;
+}
+
+QByteArray jsonString(const QString &text)
+{
+    QByteArray out = "\"";
+    for (QChar c : text)
+    {
+        if (c == '"' || c == '\\') out += '\\';
+        if (c.unicode() < 0x20) out += ' ';
+        else out += QString(c).toUtf8();
+    }
+    out += '"';
+    return out;
+}
+
+//the bits of protobuf a Perfetto trace needs, written by hand so there's nothing extra to build against
+void putVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void putVarintField(QByteArray &out, int field, quint64 value)
+{
+    putVarint(out, static_cast<quint64>(field) << 3);
+    putVarint(out, value);
+}
+
+void putBytesField(QByteArray &out, int field, const QByteArray &bytes)
+{
+    putVarint(out, (static_cast<quint64>(field) << 3) | 2);
+    putVarint(out, static_cast<quint64>(bytes.size()));
+    out += bytes;
+}
+
+//Trace.packet = 1. TracePacket: timestamp = 8, trusted_packet_sequence_id = 10, track_event = 11, track_descriptor = 60
+//TrackDescriptor: uuid = 1, name = 2. TrackEvent: type = 9 (1 begin, 2 end), track_uuid = 11, name = 23
+#define PERFETTO_SEQUENCE_ID 1
+
+void putPacket(QByteArray &out, const QByteArray &packet)
+{
+    putBytesField(out, 1, packet);
+}
+
+void putTrack(QByteArray &out, quint64 uuid, const QString &name)
+{
+    QByteArray descriptor;
+    putVarintField(descriptor, 1, uuid);
+    putBytesField(descriptor, 2, name.toUtf8());
+    QByteArray packet;
+    putVarintField(packet, 10, PERFETTO_SEQUENCE_ID);
+    putBytesField(packet, 60, descriptor);
+    putPacket(out, packet);
+}
+
+void putSlice(QByteArray &out, quint64 uuid, qint64 ns, const char *name)
+{
+    QByteArray event;
+    putVarintField(event, 9, name ? 1 : 2);
+    putVarintField(event, 11, uuid);
+    if (name) putBytesField(event, 23, QByteArray(name));
+    QByteArray packet;
+    putVarintField(packet, 8, static_cast<quint64>(ns));
+    putVarintField(packet, 10, PERFETTO_SEQUENCE_ID);
+    putBytesField(packet, 11, event);
+    putPacket(out, packet);
+}
+
+//a tracing build hooks replots up this way so the vendored QCustomPlot doesn't need trace points put into it
+class ReplotTracer : public QObject
+{
+public:
+    explicit ReplotTracer(QCustomPlot *plot) : QObject(plot)
+    {
+        connect(plot, &QCustomPlot::beforeReplot, this, [this]() { startNs = PipelineTrace::isRecording() ? PipelineTrace::now() : -1; });
+        connect(plot, &QCustomPlot::afterReplot, this, [this]()
+        {
+            if (startNs >= 0 && PipelineTrace::isRecording()) PipelineTrace::record("QCustomPlot::replot", startNs, PipelineTrace::now());
+            startNs = -1;
+        });
+    }
+
+private:
+    qint64 startNs = -1;
+};
+
+}
+
+bool PipelineTrace::isCompiledIn()
+{
+#ifdef SAVVYCAN_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PipelineTrace::isRecording()
+{
+    return recording.loadRelaxed() != 0;
+}
+
+void PipelineTrace::start()
+{
+    traceClock();
+    {
+        QMutexLocker lock(&buffersLock);
+        for (ThreadBuffer *buffer : qAsConst(buffers)) buffer->written.storeRelease(0);
+    }
+    recording.storeRelease(1);
+}
+
+void PipelineTrace::stop()
+{
+    recording.storeRelease(0);
+}
+
+qint64 PipelineTrace::now()
+{
+    return traceClock().nsecsElapsed();
+}
+
+void PipelineTrace::record(const char *name, qint64 startNs, qint64 endNs)
+{
+    if (!threadBuffer.buffer) threadBuffer.buffer = claimBuffer();
+    ThreadBuffer *buffer = threadBuffer.buffer;
+    quint64 idx = buffer->written.loadRelaxed();
+    TraceEvent &event = buffer->events[static_cast<int>(idx % TRACE_BUFFER_EVENTS)];
+    event.name = name;
+    event.startNs = startNs;
+    event.endNs = endNs;
+    buffer->written.storeRelease(idx + 1);
+}
+
+void PipelineTrace::traceReplots(QCustomPlot *plot)
+{
+#ifdef SAVVYCAN_TRACE
+    if (!plot || plot->property("pipelineTraced").toBool()) return;
+    plot->setProperty("pipelineTraced", true);
+    new ReplotTracer(plot);
+#else
+    Q_UNUSED(plot)
+#endif
+}
+
+bool PipelineTrace::exportChromeJson(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    QByteArray out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto &thread : snapshot())
+    {
+        if (!first) out += ",\n";
+        first = false;
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(thread.first->tid)
+             + ",\"args\":{\"name\":" + jsonString(thread.first->threadName) + "}}";
+        for (const TraceEvent &event : thread.second)
+        {
+            out += ",\n{\"name\":" + jsonString(QString::fromUtf8(event.name)) + ",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                 + QByteArray::number(thread.first->tid)
+                 + ",\"ts\":" + QByteArray::number(event.startNs / 1000.0, 'f', 3)
+                 + ",\"dur\":" + QByteArray::number((event.endNs - event.startNs) / 1000.0, 'f', 3) + "}";
+            if (out.size() > 1048576)
+            {
+                file.write(out);
+                out.clear();
+            }
+        }
+    }
+    out += "\n]}\n";
+    return file.write(out) == out.size();
+}
+
+bool PipelineTrace::exportPerfetto(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    QByteArray out;
+    for (auto &thread : snapshot())
+    {
+        quint64 uuid = static_cast<quint64>(thread.first->tid);
+        putTrack(out, uuid, thread.first->threadName);
+
+        //slices come in as they finish, inner ones first. Perfetto wants begin and end events nested and in time
+        //order, so sort outer before inner and close whatever has ended before each begin
+        QVector<TraceEvent> &events = thread.second;
+        std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b)
+        {
+            if (a.startNs != b.startNs) return a.startNs < b.startNs;
+            return a.endNs > b.endNs;
+        });
+        QVector<qint64> open;
+        for (const TraceEvent &event : events)
+        {
+            while (!open.isEmpty() && open.last() <= event.startNs)
+            {
+                putSlice(out, uuid, open.last(), nullptr);
+                open.removeLast();
+            }
+            putSlice(out, uuid, event.startNs, event.name);
+            //a slice sticking out past its parent (can't happen with scopes, can with the ring cutting in) is cut off
+            open.append(open.isEmpty() ? event.endNs : qMin(event.endNs, open.last()));
+        }
+        while (!open.isEmpty())
+        {
+            putSlice(out, uuid, open.last(), nullptr);
+            open.removeLast();
+        }
+        if (out.size() > 1048576)
+        {
+            if (file.write(out) != out.size()) return false;
+            out.clear();
+        }
+    }
+    return file.write(out) == out.size();
+}
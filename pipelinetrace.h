@@ -0,0 +1,72 @@
+#ifndef PIPELINETRACE_H
+#define PIPELINETRACE_H
+
+#include <QString>
+
+class QCustomPlot;
+
+/*
+ * Timing of the stages frames go through on their way to the screen (the manager's drain, the frame model, every
+ * updatedFrames handler, script callbacks, replots) so a hitch can be pinned on whichever one caused it.
+ *
+ * Only built with "qmake CONFIG+=pipeline_trace", which defines SAVVYCAN_TRACE. Without it TRACE_SCOPE is nothing
+ * at all. With it a trace point that isn't recording costs one relaxed atomic load. While recording each thread
+ * writes finished slices into a ring of its own, no locks and nothing shared on the way, keeping the newest
+ * TRACE_BUFFER_EVENTS per thread. Files are Chrome trace JSON (chrome://tracing, ui.perfetto.dev) or a native
+ * Perfetto protobuf trace.
+ *
+ * Names have to be string literals or otherwise live for the rest of the run, only the pointer is kept.
+ */
+
+//slices kept per thread while recording, older ones get overwritten
+#define TRACE_BUFFER_EVENTS     65536
+
+#ifdef SAVVYCAN_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) PipelineTraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) (void)0
+#endif
+
+class PipelineTrace
+{
+public:
+    static bool isCompiledIn();
+    static bool isRecording();
+
+    static void start(); //throws away whatever was recorded before
+    static void stop();
+
+    //what was recorded since the last start. Call after stop()
+    static bool exportChromeJson(const QString &filename);
+    static bool exportPerfetto(const QString &filename);
+
+    //from the trace points only
+    static qint64 now();
+    static void record(const char *name, qint64 startNs, qint64 endNs);
+    //slices for every replot of the plot, timed by its beforeReplot/afterReplot. Does nothing if already hooked up
+    static void traceReplots(QCustomPlot *plot);
+};
+
+#ifdef SAVVYCAN_TRACE
+class PipelineTraceScope
+{
+public:
+    explicit PipelineTraceScope(const char *name) : name(PipelineTrace::isRecording() ? name : nullptr)
+    {
+        if (this->name) startNs = PipelineTrace::now();
+    }
+    ~PipelineTraceScope()
+    {
+        if (name) PipelineTrace::record(name, startNs, PipelineTrace::now());
+    }
+
+private:
+    const char *name;
+    qint64 startNs = 0;
+    Q_DISABLE_COPY(PipelineTraceScope)
+};
+#endif
+
+#endif // PIPELINETRACE_H
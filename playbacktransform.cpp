@@ -0,0 +1,182 @@
+#include "playbacktransform.h"
+#include "dbc/dbchandler.h"
+#include "utility.h"
+
+#include <QStringList>
+
+bool PlaybackTransformRule::parse(const QString &line, PlaybackTransformRule &rule, QString &error)
+{
+    QStringList words = line.simplified().split(' ', Qt::SkipEmptyParts);
+    rule = PlaybackTransformRule();
+    rule.text = line.trimmed();
+    if (words.count() < 2)
+    {
+        error = "Expected an ID and an action";
+        return false;
+    }
+
+    if (words[0].toUpper() == "TIME")
+    {
+        bool ok = false;
+        rule.action = TIME;
+        rule.timeScale = words[1].toDouble(&ok);
+        if (!ok || rule.timeScale <= 0.0)
+        {
+            error = "Time needs a scale above 0, like 0.5 for twice as fast";
+            return false;
+        }
+        if (words.count() > 2)
+        {
+            error = "Unexpected " + words[2];
+            return false;
+        }
+        return true;
+    }
+
+    int word = 0;
+    if (words[word] != "*")
+    {
+        rule.id = static_cast<int>(Utility::ParseStringToNum(words[word]));
+        if (rule.id < 0 || static_cast<uint32_t>(rule.id) > 0x1FFFFFFF)
+        {
+            error = "Bad ID " + words[word];
+            return false;
+        }
+    }
+    word++;
+
+    QString action = words[word++].toUpper();
+    if (action == "REWRITE")
+    {
+        rule.action = REWRITE;
+        rule.modifiers = ModifierProgram::parse(words.mid(word).join(""));
+        if (rule.modifiers.isEmpty())
+        {
+            error = "Rewrite needs modifiers";
+            return false;
+        }
+        return true;
+    }
+
+    if (rule.id < 0)
+    {
+        error = "Drop and remap need an exact ID";
+        return false;
+    }
+    if (action == "DROP") rule.action = DROP;
+    else if (action == "REMAP")
+    {
+        rule.action = REMAP;
+        if (word >= words.count())
+        {
+            error = "Remap needs the ID to send it as";
+            return false;
+        }
+        rule.newId = Utility::ParseStringToNum(words[word++]);
+        if (rule.newId > 0x1FFFFFFF)
+        {
+            error = "Bad ID " + words[word - 1];
+            return false;
+        }
+    }
+    else
+    {
+        error = "Unknown action " + action;
+        return false;
+    }
+
+    if (word < words.count())
+    {
+        error = "Unexpected " + words[word];
+        return false;
+    }
+    return true;
+}
+
+QSharedPointer<PlaybackTransforms> PlaybackTransforms::compile(const QVector<PlaybackTransformRule> &rules, const CANFrameStore *frames)
+{
+    QSharedPointer<PlaybackTransforms> compiled(new PlaybackTransforms);
+    compiled->frames.setSource(frames);
+    compiled->dbcRevision = DBCHandler::getRevision();
+
+    for (const PlaybackTransformRule &rule : rules)
+    {
+        StepType type = (rule.action == PlaybackTransformRule::REMAP) ? STEP_REMAP : STEP_DROP;
+        switch (rule.action)
+        {
+        case PlaybackTransformRule::TIME:
+            compiled->scale *= rule.timeScale;
+            continue;
+        case PlaybackTransformRule::REMAP:
+        case PlaybackTransformRule::DROP:
+            //lines of the same kind next to each other share one table, so a frame is remapped at most once by them
+            if (compiled->steps.isEmpty() || compiled->steps.last().type != type)
+            {
+                Step step;
+                step.type = type;
+                step.id = -1;
+                step.runs = 0;
+                compiled->steps.append(step);
+            }
+            if (type == STEP_REMAP) compiled->steps.last().remap.insert(static_cast<uint32_t>(rule.id), rule.newId);
+            else compiled->steps.last().drop.insert(static_cast<uint32_t>(rule.id));
+            continue;
+        case PlaybackTransformRule::REWRITE:
+            break;
+        }
+
+        FrameSendData record;
+        record.setFrameId(rule.id < 0 ? 0 : static_cast<uint32_t>(rule.id));
+        record.modifiers = rule.modifiers;
+        Step step;
+        step.type = STEP_REWRITE;
+        step.id = rule.id;
+        step.runs = 0;
+        step.program = ModifierProgram::compile(record, compiled->frames);
+        if (step.program && step.program->needsDbc()) compiled->usesDbc = true;
+        compiled->steps.append(step);
+    }
+    return compiled;
+}
+
+bool PlaybackTransforms::isCurrent() const
+{
+    return !usesDbc || dbcRevision == DBCHandler::getRevision();
+}
+
+bool PlaybackTransforms::apply(CANFrame &frame)
+{
+    //a DBC change leaves signal lookups pointing at old definitions until the window compiles the rules again
+    bool dbcCurrent = isCurrent();
+    for (Step &step : steps)
+    {
+        switch (step.type)
+        {
+        case STEP_REMAP:
+        {
+            QHash<uint32_t, uint32_t>::const_iterator remapped = step.remap.constFind(frame.frameId());
+            if (remapped != step.remap.constEnd())
+            {
+                frame.setFrameId(remapped.value());
+                if (remapped.value() > 0x7FF) frame.setExtendedFrameFormat(true);
+            }
+            break;
+        }
+        case STEP_DROP:
+            if (step.drop.contains(frame.frameId())) return false;
+            break;
+        case STEP_REWRITE:
+            if (step.id >= 0 && static_cast<uint32_t>(step.id) != frame.frameId()) break;
+            if (!step.program || (step.program->needsDbc() && !dbcCurrent)) break;
+            {
+                FrameSendData record;
+                static_cast<CANFrame &>(record) = frame;
+                record.count = step.runs++;
+                step.program->run(record);
+                frame.setPayload(record.payload());
+            }
+            break;
+        }
+    }
+    return true;
+}
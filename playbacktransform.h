@@ -0,0 +1,84 @@
+#ifndef PLAYBACKTRANSFORM_H
+#define PLAYBACKTRANSFORM_H
+
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+#include "can_structs.h"
+#include "can_trigger_structs.h"
+#include "modifierprogram.h"
+
+class CANFrameStore;
+
+//one line of the playback window's transform box
+struct PlaybackTransformRule
+{
+    enum Action
+    {
+        REMAP, //sent with newId instead
+        DROP, //not sent at all
+        REWRITE, //modifiers run on the sent copy, same syntax as the frame sender
+        TIME //time between frames multiplied by timeScale, original timing only
+    };
+
+    int id = -1; //-1 for any ID
+    Action action = REWRITE;
+    uint32_t newId = 0;
+    QList<Modifier> modifiers;
+    double timeScale = 1.0;
+    QString text; //the line it came from
+
+    //"<ID> remap <ID>", "<ID> drop", "<ID|*> rewrite <modifiers>" or "time <scale>"
+    static bool parse(const QString &line, PlaybackTransformRule &rule, QString &error);
+};
+
+/*
+ * The transform rules compiled for the playback thread. Runs of remap and drop lines become one hash lookup each,
+ * rewrites become ModifierPrograms over a LastFrameTable of the main frame store, and time lines are folded into a
+ * single scale. apply() then goes over the steps in the order they were written on the frame that is about to be
+ * sent, which is already a copy of the sequence item's frame, so the loaded frames are never touched.
+ *
+ * Compiled once in the GUI thread and handed to FramePlaybackObject::setTransforms. After that only the thread
+ * that plays uses it (the rewrite counters change as it goes), and never more than one at a time.
+ */
+class PlaybackTransforms
+{
+public:
+    //rules as they were written, frames is where rewrites read other IDs from
+    static QSharedPointer<PlaybackTransforms> compile(const QVector<PlaybackTransformRule> &rules, const CANFrameStore *frames);
+    //false if a drop rule took the frame
+    bool apply(CANFrame &frame);
+    double timeScale() const { return scale; }
+    bool isEmpty() const { return steps.isEmpty() && scale == 1.0; }
+    //compiled against the DBC that's loaded now. Rewrites that use signals are skipped when it isn't
+    bool isCurrent() const;
+
+private:
+    PlaybackTransforms() {}
+    Q_DISABLE_COPY(PlaybackTransforms)
+
+    enum StepType
+    {
+        STEP_REMAP,
+        STEP_DROP,
+        STEP_REWRITE
+    };
+    struct Step
+    {
+        StepType type;
+        int id; //rewrites only, -1 for any
+        QHash<uint32_t, uint32_t> remap;
+        QSet<uint32_t> drop;
+        QSharedPointer<const ModifierProgram> program;
+        int runs; //send count the rewrite sees, for COUNTER
+    };
+
+    QVector<Step> steps;
+    double scale = 1.0;
+    bool usesDbc = false;
+    quint32 dbcRevision = 0;
+    LastFrameTable frames;
+};
+
+#endif // PLAYBACKTRANSFORM_H
@@ -4,6 +4,7 @@ import uuid
 import can
 import paho.mqtt.client as mqtt
 import ssl
+import struct
 
 #def sender(id):
 #	for i in range(10):
@@ -11,6 +12,66 @@ import ssl
 #		bus.send(msg)
 #	time.sleep(1)
 
+# Packed mode puts many frames in one message on <topic>/b. Layout (little endian) is the one in
+# SavvyCAN connections/mqtt_bus.h:
+#   u8 version, u16 frame count, u64 timestamp of the first frame in microseconds
+#   then per frame: varint microseconds since the previous frame, u8 flags, u16 ID (u32 if extended), u8 length, data
+PACK_VERSION = 1
+
+def frame_flags(msg):
+	flags = 0
+	if (msg.is_extended_id): flags += 1
+	if (msg.is_remote_frame): flags += 2
+	if (msg.is_fd): flags += 4
+	if (msg.is_error_frame): flags += 8
+	if (msg.bitrate_switch): flags += 16
+	return flags
+
+def varint(value):
+	out = bytearray()
+	while True:
+		byt = value & 0x7F
+		value >>= 7
+		if value:
+			out.append(byt | 0x80)
+		else:
+			out.append(byt)
+			return out
+
+class Packer:
+	def __init__(self):
+		self.body = bytearray()
+		self.count = 0
+		self.first = 0
+		self.last = 0
+		self.started = 0.0
+
+	def add(self, msg):
+		micros = int(msg.timestamp * 1000000)
+		if self.count == 0:
+			self.first = micros
+			self.last = micros
+			self.started = time.monotonic()
+		delta = max(0, micros - self.last)
+		self.last = max(self.last, micros)
+		flags = frame_flags(msg)
+		self.body += varint(delta)
+		self.body.append(flags)
+		self.body += msg.arbitration_id.to_bytes(4 if msg.is_extended_id else 2, 'little')
+		self.body.append(len(msg.data))
+		self.body += msg.data
+		self.count += 1
+
+	def due(self, max_frames, max_delay):
+		if self.count == 0: return False
+		return self.count >= max_frames or (time.monotonic() - self.started) * 1000 >= max_delay
+
+	def take(self):
+		out = struct.pack('<BHQ', PACK_VERSION, self.count, self.first) + self.body
+		self.body = bytearray()
+		self.count = 0
+		return out
+
 # The callback for when the client receives a CONNACK response from the server.
 def on_connect(client, userdata, flags, rc):
 	    print("Connected with result code "+str(rc))
@@ -34,6 +95,9 @@ parser.add_argument('-s', action='store', dest='speed', default=500000, type=int
 parser.add_argument('-t', action='store', dest='topic', default="can", help='Set MQTT topic to use')
 parser.add_argument('-H', action='store', dest='mqtthost', default="api.savvycan.com", help='Set hostname of MQTT Broker')
 parser.add_argument('-P', action='store', dest='mqttport', default=8883, type=int, help='Set port to connect to on MQTT Broker')
+parser.add_argument('--packed', action='store_true', dest='packed', help='Send many frames per MQTT message (needs Packed multi-frame messages on the SavvyCAN side)')
+parser.add_argument('-n', action='store', dest='packframes', default=256, type=int, help='Most frames in one packed message')
+parser.add_argument('-d', action='store', dest='packdelay', default=50, type=int, help='Longest a packed message waits before it is sent, in ms')
 
 arg_results = parser.parse_args()
 
@@ -50,18 +114,24 @@ if len(arg_results.username) > 0:
 
 client.connect(arg_results.mqtthost, arg_results.mqttport, 60)
 
+packer = Packer()
+packTopic = arg_results.topic + "/b"
+packFrames = max(1, min(arg_results.packframes, 65535))
+
 run = True
 while run:
-	client.loop(timeout=0.02)
-	for msg in bus:
-		print(msg.arbitration_id)
+	client.loop(timeout=0.001)
+	#short timeout so the MQTT client and the packed message deadline both get looked after
+	msg = bus.recv(timeout=0.005)
+	if msg is not None:
 		#msg.arbitration_id, msg.timestamp, and msg.data
-		flags = 0
-		if (msg.is_extended_id): flags += 1
-		if (msg.is_remote_frame): flags += 2
-		if (msg.is_fd): flags += 4
-		if (msg.error_state_indicator): flags += 8
-		microsStamp = int(msg.timestamp * 1000000).to_bytes(8, 'little')
-		fullTopic = arg_results.topic + "/" + str(msg.arbitration_id)
-		client.publish(fullTopic, microsStamp + int(flags).to_bytes(1, 'little') + msg.data, qos=0)
-
+		if arg_results.packed:
+			packer.add(msg)
+		else:
+			print(msg.arbitration_id)
+			flags = frame_flags(msg)
+			microsStamp = int(msg.timestamp * 1000000).to_bytes(8, 'little')
+			fullTopic = arg_results.topic + "/" + str(msg.arbitration_id)
+			client.publish(fullTopic, microsStamp + int(flags).to_bytes(1, 'little') + msg.data, qos=0)
+	if packer.due(packFrames, arg_results.packdelay):
+		client.publish(packTopic, bytes(packer.take()), qos=0)
@@ -0,0 +1,103 @@
+#include "columnstore.h"
+#include "framestorefollower.h"
+#include "mainwindow.h"
+#include "pipelinetrace.h"
+
+//not a FrameStoreFollower, appended frames are only read when their ID is asked for. Just the one per frame store
+ColumnStore *ColumnStore::forFrames(const CANFrameStore *frames)
+{
+    return perFrameStore<ColumnStore>(frames, [](const CANFrameStore *f) { return new ColumnStore(f); });
+}
+
+ColumnStore::ColumnStore(const CANFrameStore *frames) : frames(frames)
+{
+    useCounter = 0;
+    totalBytes = 0;
+    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+}
+
+qint64 ColumnStore::bytesOf(const RangeColumns &cols)
+{
+    using MemoryAccounting::bytesOf;
+    return bytesOf(cols.intel) + bytesOf(cols.motorola) + bytesOf(cols.lens) + bytesOf(cols.stamps) + bytesOf(cols.buses);
+}
+
+QSharedPointer<const RangeColumns> ColumnStore::columnsOf(uint32_t id, QVector<int> *rows)
+{
+    TRACE_SCOPE("ColumnStore::columnsOf");
+    QVector<int> idRows = frames->rowsOf(id);
+    if (rows) *rows = idRows;
+    QHash<uint32_t, Entry>::iterator it = entries.find(id);
+    if (idRows.isEmpty())
+    {
+        if (it != entries.end())
+        {
+            totalBytes -= bytesOf(*it->cols);
+            entries.erase(it);
+        }
+        return QSharedPointer<const RangeColumns>();
+    }
+
+    //still good as far as it goes if the frames it was made from are the first ones of the ID in the store
+    bool reuse = false;
+    if (it != entries.end())
+    {
+        int had = it->cols->frames;
+        reuse = had <= idRows.count() && frames->sequenceOf(idRows.first()) == it->firstSequence
+                && frames->sequenceOf(idRows[had - 1]) == it->lastSequence;
+        if (reuse && had == idRows.count())
+        {
+            it->lastUsed = ++useCounter;
+            return it->cols;
+        }
+        totalBytes -= bytesOf(*it->cols);
+    }
+
+    RangeColumns *cols = new RangeColumns;
+    if (reuse) cols->extend(*it->cols, frames, idRows);
+    else cols->build(frames, idRows);
+    Entry entry;
+    entry.cols.reset(cols);
+    entry.firstSequence = frames->sequenceOf(idRows.first());
+    entry.lastSequence = frames->sequenceOf(idRows.last());
+    entry.lastUsed = ++useCounter;
+    entries.insert(id, entry);
+    totalBytes += bytesOf(*cols);
+    trim();
+    return entry.cols;
+}
+
+//least recently used first, but never the one just asked for
+void ColumnStore::trim()
+{
+    while (totalBytes > COLUMNSTORE_MAX_BYTES && entries.count() > 1)
+    {
+        QHash<uint32_t, Entry>::iterator oldest = entries.begin();
+        for (QHash<uint32_t, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+            if (it->lastUsed < oldest->lastUsed) oldest = it;
+        totalBytes -= bytesOf(*oldest->cols);
+        entries.erase(oldest);
+    }
+}
+
+void ColumnStore::updatedFrames(int numFrames)
+{
+    if (numFrames >= 0) return; //appended frames are picked up the next time their ID is asked for
+    entries.clear();
+    totalBytes = 0;
+}
+
+void ColumnStore::reportMemory(QVector<MemoryUsage> &out) const
+{
+    if (entries.isEmpty()) return;
+    out.append({"Search columns", QString("%1 IDs, shared by the range state and correlation searches").arg(entries.count()),
+                totalBytes + MemoryAccounting::bytesOf(entries)});
+}
+
+qint64 ColumnStore::purgeMemory()
+{
+    qint64 freed = totalBytes;
+    entries.clear();
+    totalBytes = 0;
+    return freed;
+}
@@ -0,0 +1,63 @@
+#ifndef COLUMNSTORE_H
+#define COLUMNSTORE_H
+
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include "canframestore.h"
+#include "memoryaccounting.h"
+#include "re/rangecolumns.h"
+
+//most the cached columns of one frame store are allowed to take before the least recently used IDs are dropped
+#define COLUMNSTORE_MAX_BYTES   (256LL * 1024 * 1024)
+
+/*
+ * The RangeColumns of every ID a search has asked for, shared between the searches that look at one frame store.
+ * The range state search, the signal correlator and anything else that wants an ID's payloads turned on their
+ * side ask here instead of building columns of their own, so running a second search or the same one again with
+ * other settings doesn't read the store again.
+ *
+ * Columns are made the first time an ID is asked for. When the ID has had frames appended since, only the new
+ * frames are read and the old columns copied across (RangeColumns::extend). When the store evicted or replaced any
+ * of the frames they came from they're built again from scratch. A reset of the store (-1 / -2 framesUpdated)
+ * drops everything.
+ *
+ * Columns handed out never change, so a search can keep using its pointer on pool threads while the store moves on.
+ * GUI thread only otherwise.
+ */
+class ColumnStore : public QObject, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    static ColumnStore *forFrames(const CANFrameStore *frames);
+
+    //every frame of the ID in the store right now, on any bus. Null if there are none. rows gets the store rows
+    QSharedPointer<const RangeColumns> columnsOf(uint32_t id, QVector<int> *rows = nullptr);
+
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+    qint64 purgeMemory() override; //all of it, it's only a cache
+
+private slots:
+    void updatedFrames(int numFrames);
+
+private:
+    explicit ColumnStore(const CANFrameStore *frames);
+    static qint64 bytesOf(const RangeColumns &cols);
+    void trim();
+
+    struct Entry
+    {
+        QSharedPointer<const RangeColumns> cols;
+        quint64 firstSequence; //of the first and last frame they were built from
+        quint64 lastSequence;
+        quint64 lastUsed;
+    };
+
+    const CANFrameStore *frames;
+    QHash<uint32_t, Entry> entries;
+    quint64 useCounter;
+    qint64 totalBytes;
+};
+
+#endif // COLUMNSTORE_H
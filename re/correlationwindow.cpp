@@ -0,0 +1,642 @@
+#include "correlationwindow.h"
+#include "ui_correlationwindow.h"
+#include "mainwindow.h"
+#include "windowupdategate.h"
+#include "utility.h"
+#include "helpwindow.h"
+#include "filterutility.h"
+#include "signalseriesstore.h"
+#include "dbc/dbchandler.h"
+#include "dbc/dbcsignalindex.h"
+#include "re/columnstore.h"
+#include "re/graphingwindow.h"
+
+#include <QAbstractProxyModel>
+#include <QAtomicInt>
+#include <QCompleter>
+#include <QFileDialog>
+#include <QRandomGenerator>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <memory>
+
+//fewest candidates handed to one pool task, below this the task overhead isn't worth it
+#define CORRELATION_MIN_TASK_CANDIDATES 16
+
+namespace
+{
+//a run of candidates for one ID scored on a pool thread. The GUI thread takes its best matches once the pool is done
+class CorrelationWorker : public QRunnable
+{
+public:
+    CorrelationWorker(uint32_t id, const RangeColumns *cols, const CorrelationPlan *plan,
+                      const std::vector<RangeCandidate> *cands, int from, int to, QAtomicInt *cancel)
+        : id(id), cols(cols), plan(plan), cands(cands), from(from), to(to), cancel(cancel)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        QVector<int64_t> vals;
+        double r;
+        for (int c = from; c < to && !cancel->loadRelaxed(); c++)
+        {
+            if (!extractColumn(*cols, (*cands)[c], vals) || !plan->score(vals, r)) continue;
+            found.append({id, (*cands)[c], r, plan->points()});
+        }
+        keepBestMatches(found, CORRELATOR_MAX_RESULTS);
+    }
+
+    QVector<CorrelationMatch> found;
+
+private:
+    uint32_t id;
+    const RangeColumns *cols;
+    const CorrelationPlan *plan;
+    const std::vector<RangeCandidate> *cands;
+    int from, to;
+    QAtomicInt *cancel;
+};
+
+//the samples of one series in the shared store, put through toValue
+template <typename F>
+void copySeries(const CANFrameStore *frames, const SignalSeriesKey &key, CorrelationReference &ref, F toValue)
+{
+    SignalSeriesStore *store = SignalSeriesStore::forFrames(frames);
+    const SignalSeries *series = store->acquire(key);
+    store->sync();
+    ref.stamps = series->stamps;
+    ref.values.resize(series->count());
+    for (int i = 0; i < series->count(); i++) ref.values[i] = toValue(series->values.at(i));
+    store->release(series);
+}
+}
+
+CorrelationWindow::CorrelationWindow(const CANFrameStore *frames, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::CorrelationWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+
+    modelFrames = frames;
+    refMessageId = 0;
+
+    ui->cbSource->addItem(tr("DBC Signal"));
+    ui->cbSource->addItem(tr("Graph"));
+    ui->cbSource->addItem(tr("CSV Column"));
+
+    ui->cbSignalMode->addItem(tr("Big Endian"));
+    ui->cbSignalMode->addItem(tr("Little Endian"));
+    ui->cbSignalMode->addItem(tr("Try Both"));
+    ui->cbSignalMode->setCurrentIndex(2);
+
+    ui->cbSignedMode->addItem(tr("Signed Value"));
+    ui->cbSignedMode->addItem(tr("Unsigned Value"));
+    ui->cbSignedMode->addItem(tr("Try Both"));
+    ui->cbSignedMode->setCurrentIndex(2);
+
+    ui->spinStep->setValue(CORRELATOR_DEFAULT_STEP_US / 1000);
+
+    QStringList headers;
+    headers << tr("ID") << tr("Start Bit") << tr("Length") << tr("Byte Order") << tr("Signed") << tr("Correlation") << tr("Points");
+    ui->tableResults->setColumnCount(headers.count());
+    ui->tableResults->setHorizontalHeaderLabels(headers);
+
+    //same search box the new graph dialog has, going through the shared signal index
+    signalPicker = new DBCSignalPickerModel(this);
+    signalCompleter = new QCompleter(signalPicker, this);
+    signalCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    signalCompleter->setMaxVisibleItems(20);
+    signalCompleter->setWidget(ui->txtSignalSearch);
+    connect(ui->txtSignalSearch, &QLineEdit::textEdited, this, &CorrelationWindow::searchSignals);
+    connect(signalCompleter, QOverload<const QModelIndex &>::of(&QCompleter::activated), this, &CorrelationWindow::pickSearchedSignal);
+
+    connect(ui->spinMaxSigSize, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            [=](int newVal)
+            {
+                if (newVal < ui->spinMinSigSize->value()) ui->spinMinSigSize->setValue(newVal);
+            });
+
+    connect(ui->spinMinSigSize, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            [=](int newVal)
+            {
+                if (newVal > ui->spinMaxSigSize->value()) ui->spinMaxSigSize->setValue(newVal);
+            });
+
+    connect(ui->btnAllFilter, &QAbstractButton::clicked,
+            [=]()
+            {
+                for (int i = 0; i < ui->listFilter->count(); i++)
+                {
+                    QListWidgetItem *item = ui->listFilter->item(i);
+                    item->setCheckState(Qt::Checked);
+                    idFilters[Utility::ParseStringToNum(item->text())] = true;
+                }
+            });
+
+    connect(ui->btnNoneFilter, &QAbstractButton::clicked,
+            [=]()
+            {
+                for (int i = 0; i < ui->listFilter->count(); i++)
+                {
+                    QListWidgetItem *item = ui->listFilter->item(i);
+                    item->setCheckState(Qt::Unchecked);
+                    idFilters[Utility::ParseStringToNum(item->text())] = false;
+                }
+            });
+
+    connect(ui->listFilter, &QListWidget::itemChanged,
+            [=](QListWidgetItem *item)
+            {
+                idFilters[FilterUtility::getIdAsInt(item)] = (item->checkState() == Qt::Checked);
+            });
+
+    connect(ui->cbSource, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &CorrelationWindow::sourceChanged);
+    connect(ui->btnLoadCsv, &QAbstractButton::clicked, this, &CorrelationWindow::loadCsv);
+    connect(ui->btnSearch, &QAbstractButton::clicked, this, &CorrelationWindow::searchButton);
+    connect(ui->btnGraph, &QAbstractButton::clicked, this, &CorrelationWindow::graphSelected);
+    connect(ui->tableResults, &QTableWidget::cellDoubleClicked,
+            [=](int row, int)
+            {
+                if (row >= 0 && row < matches.count()) graphMatch(matches.at(row));
+            });
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
+}
+
+CorrelationWindow::~CorrelationWindow()
+{
+    delete ui;
+}
+
+void CorrelationWindow::reportMemory(QVector<MemoryUsage> &out) const
+{
+    QString owner = memoryOwner("Correlation Window");
+    out.append({owner, "matches", MemoryAccounting::bytesOf(matches)});
+    qint64 csvBytes = 0;
+    for (const QVector<double> &column : csvColumns) csvBytes += MemoryAccounting::bytesOf(column);
+    out.append({owner, "CSV reference", csvBytes});
+}
+
+void CorrelationWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+
+    readSettings();
+
+    refreshFilterList();
+    refreshGraphList();
+
+    installEventFilter(this);
+}
+
+void CorrelationWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool CorrelationWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("correlation.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void CorrelationWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("CorrelationView/WindowSize", QSize(765, 820)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("CorrelationView/WindowPos", QPoint(50, 50)).toPoint()));
+    }
+}
+
+void CorrelationWindow::writeSettings()
+{
+    QSettings settings;
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("CorrelationView/WindowSize", size());
+        settings.setValue("CorrelationView/WindowPos", pos());
+    }
+}
+
+void CorrelationWindow::updatedFrames(int numFrames)
+{
+    if (numFrames == -1)
+    {
+        ui->listFilter->clear();
+        idFilters.clear();
+    }
+    else if (numFrames == -2)
+    {
+        refreshFilterList();
+    }
+    else //new IDs get added to the filters, nothing gets searched again until the button is pressed
+    {
+        if (numFrames > modelFrames->count()) return;
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
+        {
+            uint32_t id = modelFrames->record(i).frameId();
+            if (!idFilters.contains(id))
+            {
+                idFilters.insert(id, true);
+                FilterUtility::createCheckableFilterItem(id, true, ui->listFilter);
+            }
+        }
+    }
+}
+
+void CorrelationWindow::refreshFilterList()
+{
+    idFilters.clear();
+    ui->listFilter->clear();
+
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
+    {
+        if (!idFilters.contains(info.id))
+        {
+            idFilters.insert(info.id, true);
+            FilterUtility::createCheckableFilterItem(info.id, true, ui->listFilter);
+        }
+    }
+
+    ui->listFilter->sortItems();
+}
+
+//every graph of every graphing window. The data is which window and which graph in it
+void CorrelationWindow::refreshGraphList()
+{
+    QString current = ui->cbGraphs->currentText();
+    ui->cbGraphs->clear();
+    const QList<GraphingWindow *> &windows = MainWindow::getReference()->getGraphingWindows();
+    for (int w = 0; w < windows.count(); w++)
+    {
+        for (int g = 0; g < windows[w]->graphCount(); g++)
+        {
+            QString name = windows[w]->graphAt(g).graphName;
+            if (windows.count() > 1) name = tr("Window %1: %2").arg(w + 1).arg(name);
+            ui->cbGraphs->addItem(name, QPoint(w, g));
+        }
+    }
+    int idx = ui->cbGraphs->findText(current);
+    if (idx > -1) ui->cbGraphs->setCurrentIndex(idx);
+}
+
+void CorrelationWindow::sourceChanged(int idx)
+{
+    ui->stackReference->setCurrentIndex(idx);
+    if (idx == SOURCE_GRAPH) refreshGraphList();
+}
+
+void CorrelationWindow::searchSignals(const QString &text)
+{
+    signalPicker->setQuery(text);
+    if (signalPicker->rowCount() > 0) signalCompleter->complete();
+    else signalCompleter->popup()->hide();
+}
+
+void CorrelationWindow::pickSearchedSignal(const QModelIndex &index)
+{
+    QAbstractProxyModel *proxy = qobject_cast<QAbstractProxyModel*>(signalCompleter->completionModel());
+    DBC_SIGNAL *sig = signalPicker->signalAt(proxy ? proxy->mapToSource(index).row() : index.row());
+    if (!sig) return;
+
+    ui->txtSignalSearch->setText(sig->parentMessage->name + "." + sig->name);
+    refMessageId = sig->parentMessage->ID;
+    refSignalName = sig->name;
+}
+
+/*
+ * Reads a CSV with a header line. The first column is the time in seconds, counted from the first frame of the
+ * capture (the time offset moves it), the others are the series to pick from. Commas, semicolons and tabs all work.
+ * Rows are sorted by time since the timebase needs them in order.
+ */
+void CorrelationWindow::loadCsv()
+{
+    QSettings settings;
+    QString filename = QFileDialog::getOpenFileName(this, tr("Load Reference CSV"),
+                                                    settings.value("FileIO/LoadSaveDirectory", QString()).toString(),
+                                                    tr("CSV Files (*.csv *.txt)"));
+    if (filename.isEmpty()) return;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        QMessageBox::warning(this, tr("Load Reference CSV"), tr("Could not open %1").arg(filename));
+        return;
+    }
+
+    QTextStream in(&file);
+    QString header = in.readLine();
+    QChar sep = ',';
+    if (!header.contains(sep)) sep = header.contains(';') ? QChar(';') : QChar('\t');
+    QStringList names = header.split(sep);
+    if (names.count() < 2)
+    {
+        QMessageBox::warning(this, tr("Load Reference CSV"), tr("Need a time column and at least one value column"));
+        return;
+    }
+
+    QVector<QVector<double>> columns(names.count());
+    int skipped = 0;
+    while (!in.atEnd())
+    {
+        QStringList fields = in.readLine().split(sep);
+        if (fields.count() < names.count()) continue;
+        bool ok = true;
+        QVector<double> row(names.count());
+        for (int c = 0; c < names.count() && ok; c++) row[c] = fields.at(c).trimmed().toDouble(&ok);
+        if (!ok)
+        {
+            skipped++;
+            continue;
+        }
+        for (int c = 0; c < names.count(); c++) columns[c].append(row[c]);
+    }
+
+    QVector<int> order(columns[0].count());
+    for (int i = 0; i < order.count(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&columns](int a, int b) { return columns[0][a] < columns[0][b]; });
+    csvColumns.resize(names.count());
+    for (int c = 0; c < names.count(); c++)
+    {
+        csvColumns[c].resize(order.count());
+        for (int i = 0; i < order.count(); i++) csvColumns[c][i] = columns[c][order[i]];
+    }
+    csvHeaders = names;
+
+    ui->cbCsvColumn->clear();
+    for (int c = 1; c < names.count(); c++) ui->cbCsvColumn->addItem(names.at(c).trimmed());
+    if (skipped) qDebug() << "Skipped" << skipped << "CSV rows that weren't all numbers";
+}
+
+bool CorrelationWindow::buildReference(CorrelationReference &ref, QString &error)
+{
+    switch (ui->cbSource->currentIndex())
+    {
+    case SOURCE_SIGNAL:
+    {
+        DBC_MESSAGE *msg = DBCHandler::getReference()->findMessage(refMessageId);
+        DBC_SIGNAL *sig = msg ? msg->sigHandler->findSignalByName(refSignalName) : nullptr;
+        if (!sig)
+        {
+            error = tr("Pick a DBC signal to search for first");
+            return false;
+        }
+        ref.name = msg->name + "." + sig->name;
+        copySeries(modelFrames, SignalSeriesKey::forSignal(sig), ref, [sig](int64_t raw) { return sig->physicalValue(raw); });
+        break;
+    }
+    case SOURCE_GRAPH:
+    {
+        QPoint which = ui->cbGraphs->currentData().toPoint();
+        const QList<GraphingWindow *> &windows = MainWindow::getReference()->getGraphingWindows();
+        if (ui->cbGraphs->currentIndex() < 0 || which.x() >= windows.count() || which.y() >= windows[which.x()]->graphCount())
+        {
+            error = tr("Pick a graph to search for first");
+            refreshGraphList();
+            return false;
+        }
+        //the same bits the graph reads, scaled the way it scales them
+        const GraphParams &params = windows[which.x()]->graphAt(which.y());
+        SignalSeriesKey key;
+        if (params.associatedSignal) key = SignalSeriesKey::forSignal(params.associatedSignal, params.bus);
+        else
+        {
+            key.id = params.ID;
+            key.bus = (params.bus < 0) ? -1 : params.bus;
+            key.startBit = params.startBit;
+            key.bits = params.numBits;
+            key.intel = params.intelFormat;
+            key.isSigned = params.isSigned;
+        }
+        double scale = params.scale, bias = params.bias;
+        ref.name = params.graphName;
+        copySeries(modelFrames, key, ref, [scale, bias](int64_t raw) { return raw * scale + bias; });
+        break;
+    }
+    case SOURCE_CSV:
+    {
+        int column = ui->cbCsvColumn->currentIndex() + 1;
+        if (column < 1 || column >= csvColumns.count())
+        {
+            error = tr("Load a CSV and pick a column first");
+            return false;
+        }
+        uint64_t captureStart = UINT64_MAX;
+        for (const CANFrameStore::IdInfo &info : modelFrames->idList()) captureStart = qMin(captureStart, info.firstStamp);
+        if (captureStart == UINT64_MAX) captureStart = 0;
+
+        ref.name = csvHeaders.at(column).trimmed();
+        double offset = ui->spinCsvOffset->value();
+        const QVector<double> &times = csvColumns.at(0);
+        for (int i = 0; i < times.count(); i++)
+        {
+            double us = static_cast<double>(captureStart) + (times.at(i) + offset) * 1000000.0;
+            if (us < 0) continue; //from before the capture's clock started
+            ref.stamps.append(static_cast<uint64_t>(us));
+            ref.values.append(csvColumns.at(column).at(i));
+        }
+        break;
+    }
+    }
+
+    if (ref.stamps.count() < 2)
+    {
+        error = tr("The reference needs at least two samples in the capture");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Same search RangeStateWindow does, but each candidate gets a score instead of a yes or no. The reference goes
+ * onto its timebase once, then every checked ID is put into columns and lined up with the timebase, and its
+ * candidates are split over a thread pool. Only the best CORRELATOR_MAX_RESULTS are kept as the IDs go by.
+ */
+void CorrelationWindow::searchButton()
+{
+    CorrelationReference ref;
+    QString error;
+    if (!buildReference(ref, error))
+    {
+        QMessageBox::warning(this, tr("Signal Correlation"), error);
+        return;
+    }
+    CorrelationTimebase base;
+    if (!base.build(ref, static_cast<uint64_t>(ui->spinStep->value()) * 1000))
+    {
+        QMessageBox::warning(this, tr("Signal Correlation"), tr("The reference doesn't cover any time"));
+        return;
+    }
+    qDebug() << "Correlating against" << ref.name << "on" << base.count() << "points every" << base.stepUs() << "us";
+
+    matches.clear();
+    ui->tableResults->setRowCount(0);
+
+    int numIds = 0;
+    for (auto iter = idFilters.constBegin(); iter != idFilters.constEnd(); ++iter)
+    {
+        if (iter.value()) numIds++;
+    }
+
+    QProgressDialog progress(qApp->activeWindow());
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setLabelText("Calculating");
+    progress.setRange(0, numIds);
+    progress.setMinimumDuration(0);
+    progress.show();
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QAtomicInt cancel(0);
+    int idsDone = 0;
+
+    for (auto iter = idFilters.constBegin(); iter != idFilters.constEnd() && !cancel.loadRelaxed(); ++iter)
+    {
+        if (!iter.value()) continue;
+        uint32_t id = iter.key();
+        progress.setLabelText(tr("Scoring ID ") + Utility::formatCANID(id));
+        progress.setValue(idsDone++);
+
+        QVector<int> rows;
+        QSharedPointer<const RangeColumns> cols = ColumnStore::forFrames(modelFrames)->columnsOf(id, &rows);
+        if (!cols) continue;
+        CorrelationPlan plan;
+        if (!plan.build(base, modelFrames, rows)) continue; //not enough of the ID while the reference runs
+        std::vector<RangeCandidate> cands = signalsFactory(*std::max_element(cols->lens.constBegin(), cols->lens.constEnd()) * 8);
+        if (cands.empty()) continue;
+
+        int chunk = qMax(CORRELATION_MIN_TASK_CANDIDATES, static_cast<int>(cands.size()) / (threads * 4) + 1);
+        std::vector<std::unique_ptr<CorrelationWorker>> workers;
+        for (int from = 0; from < static_cast<int>(cands.size()); from += chunk)
+        {
+            int to = qMin(from + chunk, static_cast<int>(cands.size()));
+            workers.emplace_back(new CorrelationWorker(id, cols.data(), &plan, &cands, from, to, &cancel));
+        }
+        for (auto &worker : workers) pool.start(worker.get());
+        while (!pool.waitForDone(50))
+        {
+            qApp->processEvents();
+            if (progress.wasCanceled()) cancel.storeRelaxed(1);
+        }
+        for (auto &worker : workers) matches += worker->found;
+        keepBestMatches(matches, CORRELATOR_MAX_RESULTS);
+        showMatches();
+    }
+
+    progress.cancel();
+    qDebug() << "Kept" << matches.count() << "correlated candidates";
+}
+
+//candidate layouts the same way RangeStateWindow makes them, off the same settings
+std::vector<RangeCandidate> CorrelationWindow::signalsFactory(int maxBits)
+{
+    std::vector<RangeCandidate> cands;
+    int minSig = ui->spinMinSigSize->value();
+    int maxSig = ui->spinMaxSigSize->value();
+    int granularity = qMax(1, ui->spinGranularity->value());
+    int sigType = ui->cbSignalMode->currentIndex() + 1;
+    int signedType = ui->cbSignedMode->currentIndex() + 1;
+
+    for (int sigSize = maxSig; sigSize >= minSig; sigSize -= granularity)
+    {
+        for (int startBit = 0; startBit < maxBits; startBit += granularity)
+        {
+            if (sigType & 1)
+            {
+                if (signedType & 1) cands.push_back({startBit, sigSize, true, true});
+                if (signedType & 2) cands.push_back({startBit, sigSize, true, false});
+            }
+            if (sigType & 2)
+            {
+                //a little endian signal can't start so late it would run off the end of the payload
+                if (startBit + sigSize > maxBits) continue;
+                if (signedType & 1) cands.push_back({startBit, sigSize, false, true});
+                if (signedType & 2) cands.push_back({startBit, sigSize, false, false});
+            }
+        }
+    }
+    return cands;
+}
+
+void CorrelationWindow::showMatches()
+{
+    ui->tableResults->setRowCount(matches.count());
+    for (int i = 0; i < matches.count(); i++)
+    {
+        const CorrelationMatch &match = matches.at(i);
+        QStringList cells;
+        cells << Utility::formatCANID(match.id) << QString::number(match.cand.startBit) << QString::number(match.cand.bitLength)
+              << (match.cand.bigEndian ? tr("Big Endian") : tr("Little Endian")) << (match.cand.isSigned ? tr("Signed") : tr("Unsigned"))
+              << QString::number(match.r, 'f', 4) << QString::number(match.points);
+        for (int c = 0; c < cells.count(); c++)
+        {
+            QTableWidgetItem *item = ui->tableResults->item(i, c);
+            if (!item)
+            {
+                item = new QTableWidgetItem();
+                ui->tableResults->setItem(i, c, item);
+            }
+            item->setText(cells.at(c));
+        }
+    }
+}
+
+void CorrelationWindow::graphSelected()
+{
+    QList<QTableWidgetSelectionRange> ranges = ui->tableResults->selectedRanges();
+    for (const QTableWidgetSelectionRange &range : ranges)
+    {
+        for (int row = range.topRow(); row <= range.bottomRow(); row++)
+        {
+            if (row < matches.count()) graphMatch(matches.at(row));
+        }
+    }
+}
+
+//into the newest graphing window, a new one if there isn't one yet
+void CorrelationWindow::graphMatch(const CorrelationMatch &match)
+{
+    GraphParams param;
+    param.ID = match.id;
+    param.startBit = match.cand.startBit;
+    param.numBits = match.cand.bitLength;
+    param.intelFormat = !match.cand.bigEndian;
+    param.isSigned = match.cand.isSigned;
+    param.stride = 1;
+    param.graphName = QString("%1 %2:%3 r=%4").arg(Utility::formatCANID(match.id)).arg(match.cand.startBit)
+                          .arg(match.cand.bitLength).arg(match.r, 0, 'f', 3);
+    param.lineColor = QColor(QRandomGenerator::global()->bounded(160), QRandomGenerator::global()->bounded(160), QRandomGenerator::global()->bounded(160));
+    param.lineWidth = 1;
+    param.fillColor = QColor(128, 128, 128, 0);
+    param.mask = 0xFFFFFFFFFFFFFFFFull;
+    param.drawOnlyPoints = false;
+    param.pointType = 0;
+
+    GraphingWindow *window = MainWindow::getReference()->latestGraphingWindow();
+    window->createGraph(param);
+    window->show();
+    window->raise();
+}
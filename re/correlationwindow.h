@@ -0,0 +1,74 @@
+#ifndef CORRELATIONWINDOW_H
+#define CORRELATIONWINDOW_H
+
+#include <QDialog>
+#include <QMap>
+#include <vector>
+#include "canframestore.h"
+#include "memoryaccounting.h"
+#include "signalcorrelator.h"
+
+class QCompleter;
+class DBCSignalPickerModel;
+
+namespace Ui {
+class CorrelationWindow;
+}
+
+/*
+ * Finds the bits of the capture that follow a series you already know, like vehicle speed off a GPS log. The
+ * reference is a DBC signal, a graph in one of the graphing windows or a column of a CSV file. Every candidate
+ * layout of every checked ID gets resampled onto the reference's timebase and scored by how well it correlates,
+ * and the best ones are listed strongest first. Double clicking one graphs it.
+ */
+class CorrelationWindow : public QDialog, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    explicit CorrelationWindow(const CANFrameStore *frames, QWidget *parent = 0);
+    ~CorrelationWindow();
+    void showEvent(QShowEvent*);
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+
+private slots:
+    void updatedFrames(int);
+    void searchButton();
+    void graphSelected();
+    void sourceChanged(int idx);
+    void searchSignals(const QString &text);
+    void pickSearchedSignal(const QModelIndex &index);
+    void loadCsv();
+
+private:
+    enum Source
+    {
+        SOURCE_SIGNAL = 0,
+        SOURCE_GRAPH,
+        SOURCE_CSV
+    };
+
+    Ui::CorrelationWindow *ui;
+    const CANFrameStore *modelFrames;
+    QMap<int, bool> idFilters;
+    DBCSignalPickerModel *signalPicker;
+    QCompleter *signalCompleter;
+    uint32_t refMessageId; //the picked DBC signal, looked up again when searching in case the files changed
+    QString refSignalName;
+    QStringList csvHeaders;
+    QVector<QVector<double>> csvColumns; //column 0 is the time in seconds
+    QVector<CorrelationMatch> matches;
+
+    void refreshFilterList();
+    void refreshGraphList();
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    std::vector<RangeCandidate> signalsFactory(int maxBits);
+    bool buildReference(CorrelationReference &ref, QString &error);
+    void showMatches();
+    void graphMatch(const CorrelationMatch &match);
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // CORRELATIONWINDOW_H
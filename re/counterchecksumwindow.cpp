@@ -0,0 +1,400 @@
+#include "counterchecksumwindow.h"
+#include "ui_counterchecksumwindow.h"
+#include "mainwindow.h"
+#include "windowupdategate.h"
+#include "utility.h"
+#include "helpwindow.h"
+#include "filterutility.h"
+#include "dbc/dbchandler.h"
+#include "re/periodicity.h"
+
+#include <QAtomicInt>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <memory>
+
+//DBC message attributes the findings go into, one key=value spec per field separated by ;
+#define COUNTER_ATTRIBUTE           "CounterSpec"
+#define CHECKSUM_ATTRIBUTE          "ChecksumSpec"
+
+namespace
+{
+//one bus / ID pair scanned on a pool thread. The sample was copied out of the store before it started
+class IntegrityWorker : public QRunnable
+{
+public:
+    IntegrityWorker(QAtomicInt *cancel) : cancel(cancel)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        if (!cancel->loadRelaxed()) found = IntegrityScanner::scan(sample);
+    }
+
+    IntegritySample sample;
+    QVector<IntegrityField> found;
+
+private:
+    QAtomicInt *cancel;
+};
+
+bool fieldBefore(const IntegrityField &a, const IntegrityField &b)
+{
+    if (a.bus != b.bus) return a.bus < b.bus;
+    if (a.id != b.id) return a.id < b.id;
+    if (a.byte != b.byte) return a.byte < b.byte;
+    return a.shift < b.shift;
+}
+}
+
+CounterChecksumWindow::CounterChecksumWindow(const CANFrameStore *frames, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::CounterChecksumWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+
+    modelFrames = frames;
+
+    QStringList headers;
+    headers << tr("ID") << tr("Bus") << tr("Kind") << tr("Byte") << tr("Bits") << tr("Details") << tr("Fit") << tr("Frames") << tr("Modifier");
+    ui->tableResults->setColumnCount(headers.count());
+    ui->tableResults->setHorizontalHeaderLabels(headers);
+
+    connect(ui->btnAllFilter, &QAbstractButton::clicked,
+            [=]()
+            {
+                for (int i = 0; i < ui->listFilter->count(); i++)
+                {
+                    QListWidgetItem *item = ui->listFilter->item(i);
+                    item->setCheckState(Qt::Checked);
+                    idFilters[Utility::ParseStringToNum(item->text())] = true;
+                }
+            });
+
+    connect(ui->btnNoneFilter, &QAbstractButton::clicked,
+            [=]()
+            {
+                for (int i = 0; i < ui->listFilter->count(); i++)
+                {
+                    QListWidgetItem *item = ui->listFilter->item(i);
+                    item->setCheckState(Qt::Unchecked);
+                    idFilters[Utility::ParseStringToNum(item->text())] = false;
+                }
+            });
+
+    connect(ui->listFilter, &QListWidget::itemChanged,
+            [=](QListWidgetItem *item)
+            {
+                idFilters[FilterUtility::getIdAsInt(item)] = (item->checkState() == Qt::Checked);
+            });
+
+    connect(ui->btnScan, &QAbstractButton::clicked, this, &CounterChecksumWindow::scanButton);
+    connect(ui->btnExportDbc, &QAbstractButton::clicked, this, &CounterChecksumWindow::exportDbc);
+    connect(ui->btnExportSender, &QAbstractButton::clicked, this, &CounterChecksumWindow::exportSender);
+    connect(ui->btnIgnoreChanges, &QAbstractButton::clicked, this, &CounterChecksumWindow::ignoreChanges);
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
+}
+
+CounterChecksumWindow::~CounterChecksumWindow()
+{
+    delete ui;
+}
+
+void CounterChecksumWindow::reportMemory(QVector<MemoryUsage> &out) const
+{
+    out.append({memoryOwner("Counter and Checksum Window"), "fields found", MemoryAccounting::bytesOf(fields)});
+}
+
+void CounterChecksumWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+
+    readSettings();
+
+    refreshFilterList();
+
+    installEventFilter(this);
+}
+
+void CounterChecksumWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool CounterChecksumWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("counterchecksum.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void CounterChecksumWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("CounterChecksumView/WindowSize", QSize(900, 700)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("CounterChecksumView/WindowPos", QPoint(50, 50)).toPoint()));
+    }
+}
+
+void CounterChecksumWindow::writeSettings()
+{
+    QSettings settings;
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("CounterChecksumView/WindowSize", size());
+        settings.setValue("CounterChecksumView/WindowPos", pos());
+    }
+}
+
+void CounterChecksumWindow::updatedFrames(int numFrames)
+{
+    if (numFrames == -1)
+    {
+        ui->listFilter->clear();
+        idFilters.clear();
+    }
+    else if (numFrames == -2)
+    {
+        refreshFilterList();
+    }
+    else //new IDs get added to the filters, nothing gets scanned again until the button is pressed
+    {
+        if (numFrames > modelFrames->count()) return;
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
+        {
+            uint32_t id = modelFrames->record(i).frameId();
+            if (!idFilters.contains(id))
+            {
+                idFilters.insert(id, true);
+                FilterUtility::createCheckableFilterItem(id, true, ui->listFilter);
+            }
+        }
+    }
+}
+
+void CounterChecksumWindow::refreshFilterList()
+{
+    idFilters.clear();
+    ui->listFilter->clear();
+
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
+    {
+        if (!idFilters.contains(info.id))
+        {
+            idFilters.insert(info.id, true);
+            FilterUtility::createCheckableFilterItem(info.id, true, ui->listFilter);
+        }
+    }
+
+    ui->listFilter->sortItems();
+}
+
+/*
+ * Every bus / ID pair of a checked ID gets scanned on its own. The samples are copied out a few pool loads at a
+ * time so a capture with thousands of IDs doesn't copy all of them at once, each load is scanned while the GUI
+ * thread waits on the pool.
+ */
+void CounterChecksumWindow::scanButton()
+{
+    QVector<CANFrameStore::IdInfo> pairs;
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
+    {
+        if (idFilters.value(info.id, false)) pairs.append(info);
+    }
+
+    fields.clear();
+    ui->tableResults->setRowCount(0);
+
+    QProgressDialog progress(qApp->activeWindow());
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setLabelText("Scanning");
+    progress.setRange(0, pairs.count());
+    progress.setMinimumDuration(0);
+    progress.show();
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QAtomicInt cancel(0);
+
+    for (int from = 0; from < pairs.count() && !cancel.loadRelaxed(); from += threads * 4)
+    {
+        int to = qMin(from + threads * 4, static_cast<int>(pairs.count()));
+        progress.setLabelText(tr("Scanning ID ") + Utility::formatCANID(pairs.at(from).id));
+        progress.setValue(from);
+
+        std::vector<std::unique_ptr<IntegrityWorker>> workers;
+        for (int p = from; p < to; p++)
+        {
+            const CANFrameStore::IdInfo &info = pairs.at(p);
+            std::unique_ptr<IntegrityWorker> worker(new IntegrityWorker(&cancel));
+            if (!worker->sample.build(modelFrames, modelFrames->rowsOf(info.id, info.bus), info.id, info.bus)) continue;
+            pool.start(worker.get());
+            workers.push_back(std::move(worker));
+        }
+        while (!pool.waitForDone(50))
+        {
+            qApp->processEvents();
+            if (progress.wasCanceled()) cancel.storeRelaxed(1);
+        }
+        for (auto &worker : workers) fields += worker->found;
+    }
+
+    std::sort(fields.begin(), fields.end(), fieldBefore);
+    showFields();
+    progress.cancel();
+    qDebug() << "Found" << fields.count() << "counters and checksums in" << pairs.count() << "bus / ID pairs";
+}
+
+void CounterChecksumWindow::showFields()
+{
+    ui->tableResults->setRowCount(fields.count());
+    for (int i = 0; i < fields.count(); i++)
+    {
+        const IntegrityField &field = fields.at(i);
+        QString modifier = field.modifier();
+        QStringList cells;
+        cells << Utility::formatCANID(field.id) << QString::number(field.bus)
+              << (field.kind == INTEGRITY_COUNTER ? tr("Counter") : tr("Checksum")) << QString::number(field.byte)
+              << ((field.bits == 8) ? QString("0-7") : QString("%1-%2").arg(field.shift).arg(field.shift + 3))
+              << field.details() << QString::number(field.fit, 'f', 3) << QString::number(field.frames)
+              << (modifier.isEmpty() ? tr("(the frame sender can't make this one)") : modifier);
+        for (int c = 0; c < cells.count(); c++)
+        {
+            QTableWidgetItem *item = ui->tableResults->item(i, c);
+            if (!item)
+            {
+                item = new QTableWidgetItem();
+                ui->tableResults->setItem(i, c, item);
+            }
+            item->setText(cells.at(c));
+        }
+    }
+}
+
+//into the first loaded DBC file, a new blank one if none are loaded. Specs already there for an ID get replaced
+void CounterChecksumWindow::exportDbc()
+{
+    if (fields.isEmpty()) return;
+    DBCHandler *handler = DBCHandler::getReference();
+    if (handler->getFileCount() == 0) handler->createBlankFile();
+    DBCFile *file = handler->getFileByIdx(0);
+    if (!file) return;
+
+    QMap<uint32_t, QStringList> counters, checksums;
+    QMap<uint32_t, int> lengths;
+    for (const IntegrityField &field : qAsConst(fields))
+    {
+        uint32_t key = field.id | ((field.id > 0x7FF) ? 0x80000000ul : 0);
+        if (field.kind == INTEGRITY_COUNTER) counters[key].append(field.spec());
+        else checksums[key].append(field.spec());
+        lengths[key] = qMax(lengths.value(key, 0), field.length);
+    }
+    for (auto iter = lengths.constBegin(); iter != lengths.constEnd(); ++iter)
+    {
+        if (counters.contains(iter.key())) file->setMessageString(iter.key(), iter.value(), COUNTER_ATTRIBUTE, counters[iter.key()].join("; "));
+        if (checksums.contains(iter.key())) file->setMessageString(iter.key(), iter.value(), CHECKSUM_ATTRIBUTE, checksums[iter.key()].join("; "));
+    }
+    QMessageBox::information(this, tr("Counters and Checksums"),
+                             tr("Set %1 and %2 on %3 messages of %4").arg(COUNTER_ATTRIBUTE).arg(CHECKSUM_ATTRIBUTE)
+                                 .arg(lengths.count()).arg(file->getFilename().isEmpty() ? tr("a new DBC file") : file->getFilename()));
+}
+
+/*
+ * A frame sender file with one line per bus / ID pair that has something the sender can make. Each starts out as
+ * the newest frame of the pair, is sent at the period the pair was seen at (100ms when it wasn't regular) and has
+ * the counters ahead of the checksums in its modifiers so they're covered. Lines start disabled.
+ */
+void CounterChecksumWindow::exportSender()
+{
+    QSettings settings;
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export Frame Sender File"),
+                                                    settings.value("FrameSender/LoadSaveDirectory", QString()).toString(),
+                                                    tr("Frame Sender Definition (*.fsd)"));
+    if (filename.isEmpty()) return;
+    if (!filename.contains('.')) filename += ".fsd";
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QMessageBox::warning(this, tr("Export Frame Sender File"), tr("Could not open %1").arg(filename));
+        return;
+    }
+
+    PeriodicityStore *periods = PeriodicityStore::forFrames(modelFrames);
+    periods->sync();
+
+    int lines = 0;
+    for (int i = 0; i < fields.count();)
+    {
+        //fields are ordered by bus and ID, so each pair's are together. Counters go first
+        int end = i;
+        QStringList counterMods, checksumMods;
+        while (end < fields.count() && fields.at(end).id == fields.at(i).id && fields.at(end).bus == fields.at(i).bus)
+        {
+            QString mod = fields.at(end).modifier();
+            if (!mod.isEmpty()) (fields.at(end).kind == INTEGRITY_COUNTER ? counterMods : checksumMods).append(mod);
+            end++;
+        }
+        const IntegrityField &field = fields.at(i);
+        i = end;
+        if (counterMods.isEmpty() && checksumMods.isEmpty()) continue;
+
+        QVector<int> rows = modelFrames->rowsOf(field.id, field.bus);
+        if (rows.isEmpty()) continue;
+        const CANFrameRecord &rec = modelFrames->record(rows.last());
+        const uint8_t *payload = modelFrames->payloadData(rows.last());
+        QStringList bytes;
+        for (int b = 0; b < rec.len; b++) bytes << Utility::formatHexNum(payload[b]);
+
+        const PeriodStats *stats = periods->find(field.id, field.bus);
+        quint32 ms = (stats && stats->isPeriodic()) ? qMax<quint32>(1, (stats->period + 500) / 1000) : 100;
+        DBC_MESSAGE *msg = DBCHandler::getReference()->findMessage(field.id);
+
+        QString line = "F#" + QString::number(field.bus) + "#" + Utility::formatCANID(field.id) + "#"
+                       + (msg ? msg->name : QString()) + "#" + QString::number(rec.len) + "#"
+                       + (rec.isExtended() ? "T" : "F") + "#F#" + bytes.join(' ') + "#"
+                       + QString::number(ms) + "ms#" + (counterMods + checksumMods).join(',') + "#\n";
+        file.write(line.toUtf8());
+        lines++;
+    }
+    file.close();
+    settings.setValue("FrameSender/LoadSaveDirectory", QFileInfo(filename).absolutePath());
+    QMessageBox::information(this, tr("Export Frame Sender File"), tr("Wrote %1 frames to %2").arg(lines).arg(filename));
+}
+
+//the bits of every field found, as per ID ignore masks for the main list's changes only view
+void CounterChecksumWindow::ignoreChanges()
+{
+    QHash<uint32_t, QByteArray> masks;
+    for (const IntegrityField &field : qAsConst(fields))
+    {
+        QByteArray &mask = masks[field.id];
+        if (mask.length() <= field.byte) mask.append(QByteArray(field.byte + 1 - mask.length(), 0));
+        mask[field.byte] = static_cast<char>(mask.at(field.byte) | (((1 << field.bits) - 1) << field.shift));
+    }
+    MainWindow::getReference()->getCANFrameModel()->setChangeIgnoreMasks(masks);
+}
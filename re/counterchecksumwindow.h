@@ -0,0 +1,51 @@
+#ifndef COUNTERCHECKSUMWINDOW_H
+#define COUNTERCHECKSUMWINDOW_H
+
+#include <QDialog>
+#include <QMap>
+#include "canframestore.h"
+#include "memoryaccounting.h"
+#include "integrityscan.h"
+
+namespace Ui {
+class CounterChecksumWindow;
+}
+
+/*
+ * Looks through the checked IDs for rolling counters and checksum bytes, the two things a node usually has to get
+ * right before anything on the bus will take its frames. Every bus / ID pair is scanned on its own pool thread.
+ * What's found can go into the first DBC file as message attributes or out to a frame sender file with the
+ * modifiers that make the same counters and checksums, so sent frames look like the real ones.
+ */
+class CounterChecksumWindow : public QDialog, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    explicit CounterChecksumWindow(const CANFrameStore *frames, QWidget *parent = 0);
+    ~CounterChecksumWindow();
+    void showEvent(QShowEvent*);
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+
+private slots:
+    void updatedFrames(int);
+    void scanButton();
+    void exportDbc();
+    void exportSender();
+    void ignoreChanges();
+
+private:
+    Ui::CounterChecksumWindow *ui;
+    const CANFrameStore *modelFrames;
+    QMap<int, bool> idFilters;
+    QVector<IntegrityField> fields; //ordered by bus, ID and then byte
+
+    void refreshFilterList();
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    void showFields();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // COUNTERCHECKSUMWINDOW_H
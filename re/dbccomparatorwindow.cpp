@@ -15,6 +15,7 @@ DBCComparatorWindow::DBCComparatorWindow(QWidget *parent) :
     connect(ui->btnDBCFile1, SIGNAL(clicked(bool)), this, SLOT(loadFirstFile()));
     connect(ui->btnDBCFile2, SIGNAL(clicked(bool)), this, SLOT(loadSecondFile()));
     connect(ui->btnSaveDetails, SIGNAL(clicked(bool)), this, SLOT(saveDetails()));
+    connect(ui->treeDetails, &QTreeWidget::itemExpanded, this, &DBCComparatorWindow::detailsExpanded);
 
     ui->lblFirstFile->setText("");
     ui->lblSecondFile->setText("");
@@ -154,6 +155,7 @@ void DBCComparatorWindow::calculateDetails()
     firstDBC->sort();
     secondDBC->sort();
 
+    diff.compare(firstDBC, secondDBC);
 
     ui->treeDetails->clear();
 
@@ -169,34 +171,22 @@ void DBCComparatorWindow::calculateDetails()
     nodeDiffRoot->addChild(nodesMissingDBCSecond);
     ui->treeDetails->addTopLevelItem(nodeDiffRoot);
 
-    for (int i = 0; i < firstDBC->dbc_nodes.count(); i++)
+    foreach (QString nodeName, diff.nodesOnlyFirst)
     {
-        QString nodeName = firstDBC->dbc_nodes[i].name;
-        DBC_NODE *node = secondDBC->findNodeByName(nodeName);
-        if (!node)
-        {
-            QTreeWidgetItem *missingNodeItem = new QTreeWidgetItem();
-            missingNodeItem->setText(0, nodeName);
-            nodesMissingDBCSecond->addChild(missingNodeItem);
-        }
+        QTreeWidgetItem *missingNodeItem = new QTreeWidgetItem();
+        missingNodeItem->setText(0, nodeName);
+        nodesMissingDBCSecond->addChild(missingNodeItem);
     }
 
-    for (int i = 0; i < secondDBC->dbc_nodes.count(); i++)
+    foreach (QString nodeName, diff.nodesOnlySecond)
     {
-        QString nodeName = secondDBC->dbc_nodes[i].name;
-        DBC_NODE *node = firstDBC->findNodeByName(nodeName);
-        if (!node)
-        {
-            QTreeWidgetItem *missingNodeItem = new QTreeWidgetItem();
-            missingNodeItem->setText(0, nodeName);
-            nodesMissingDBCFirst->addChild(missingNodeItem);
-        }
+        QTreeWidgetItem *missingNodeItem = new QTreeWidgetItem();
+        missingNodeItem->setText(0, nodeName);
+        nodesMissingDBCFirst->addChild(missingNodeItem);
     }
 
-
-
-    //Find messages that are missing in one of the DBC files
-    //If a message exists in both then check for missing signals
+    //Messages that are missing in one of the DBC files, then for messages in both any missing or changed signals
+    //and changes to the message itself. The details under each message get filled in when it's first expanded
 
     QTreeWidgetItem *msgDiffRoot = new QTreeWidgetItem();
     msgDiffRoot->setText(0, "Message Differences");
@@ -212,6 +202,8 @@ void DBCComparatorWindow::calculateDetails()
     sigDiffTwo->setText(0, "Missing from second DBC");
     QTreeWidgetItem *sigModifiedRoot = new QTreeWidgetItem();
     sigModifiedRoot->setText(0, "Modified Signals");
+    QTreeWidgetItem *msgModifiedRoot = new QTreeWidgetItem();
+    msgModifiedRoot->setText(0, "Modified Messages");
     msgSignalsDiff->addChild(sigDiffOne);
     msgSignalsDiff->addChild(sigDiffTwo);
 
@@ -219,133 +211,37 @@ void DBCComparatorWindow::calculateDetails()
     msgDiffRoot->addChild(msgMissingDBCSecond);
     msgDiffRoot->addChild(msgSignalsDiff);
     msgDiffRoot->addChild(sigModifiedRoot);
+    msgDiffRoot->addChild(msgModifiedRoot);
 
     ui->treeDetails->addTopLevelItem(msgDiffRoot);
 
-    QTreeWidgetItem *msgItem {};
-    QTreeWidgetItem *sigTemp {};
-
-    for (int i = 0; i < firstDBC->messageHandler->getCount(); i++)
+    for (int i = 0; i < diff.messages.count(); i++)
     {
-        DBC_MESSAGE *thisMsg = firstDBC->messageHandler->findMsgByIdx(i);
-        QString msgName = thisMsg->name;
-        DBC_MESSAGE *otherMsg = secondDBC->messageHandler->findMsgByName(msgName);
-        if (!otherMsg)
+        const DBCMessageChange &change = diff.messages[i];
+        if (!change.inSecond)
         {
             QTreeWidgetItem *missingMsgItem = new QTreeWidgetItem();
-            missingMsgItem->setText(0, msgName+ " (" + Utility::formatCANID(thisMsg->ID) + ")");
+            missingMsgItem->setText(0, change.label());
             msgMissingDBCSecond->addChild(missingMsgItem);
+            continue;
         }
-        else //both have Msg. Check sigs for missing
-        {
-            bool thisMsgHasMissing = false;
-            bool thisMsgHasMods = false;
-
-            for (int i = 0; i < thisMsg->sigHandler->getCount(); i++)
-            {
-                DBC_SIGNAL *thisSig = thisMsg->sigHandler->findSignalByIdx(i);
-                QString sigName = thisSig->name;
-                DBC_SIGNAL *otherSig = otherMsg->sigHandler->findSignalByName(sigName);
-                if (!otherSig)
-                {
-                    QTreeWidgetItem *missingSigItem = new QTreeWidgetItem();
-                    missingSigItem->setText(0, sigName);
-                    if (!thisMsgHasMissing)
-                    {
-                        thisMsgHasMissing = true;
-                        msgItem = new QTreeWidgetItem();
-                        msgItem->setText(0, msgName + " (" + Utility::formatCANID(thisMsg->ID) + ")");
-                        sigDiffTwo->addChild(msgItem);
-                    }
-                    if (msgItem)
-                        msgItem->addChild(missingSigItem);
-                }
-                else //signal exists on both sides. See if it as changed position or length
-                {
-                    bool didChange = false;
-                    QTreeWidgetItem *sigItem = new QTreeWidgetItem();
-                    sigItem->setText(0, sigName);
-                    if (thisSig->startBit != otherSig->startBit)
-                    {
-                        didChange = true;
-                        QTreeWidgetItem *sigStartBit = new QTreeWidgetItem();
-                        sigStartBit->setText(0, "Start Bit       First DBC: " + QString::number(thisSig->startBit) + "     Second: " + QString::number(otherSig->startBit));
-                        sigItem->addChild(sigStartBit);
-                    }
-                    if (thisSig->signalSize != otherSig->signalSize)
-                    {
-                        didChange = true;
-                        QTreeWidgetItem *sigSize = new QTreeWidgetItem();
-                        sigSize->setText(0, "Size          First DBC: " + QString::number(thisSig->signalSize) + "      Second: " + QString::number(otherSig->signalSize));
-                        sigItem->addChild(sigSize);
-                    }
-                    if (thisSig->bias != otherSig->bias)
-                    {
-                        didChange = true;
-                        QTreeWidgetItem *sigBias = new QTreeWidgetItem();
-                        sigBias->setText(0, "Bias          First DBC: " + QString::number(thisSig->bias) + "      Second: " + QString::number(otherSig->bias));
-                        sigItem->addChild(sigBias);
-                    }
-                    if (thisSig->factor != otherSig->factor)
-                    {
-                        didChange = true;
-                        QTreeWidgetItem *sigFactor = new QTreeWidgetItem();
-                        sigFactor->setText(0, "Factor        First DBC: " + QString::number(thisSig->factor) + "      Second: " + QString::number(otherSig->factor));
-                        sigItem->addChild(sigFactor);
-                    }
-                    if (didChange)
-                    {
-                        if (!thisMsgHasMods)
-                        {
-                            thisMsgHasMods = true;
-                            sigTemp = new QTreeWidgetItem();
-                            sigTemp->setText(0, msgName + " (" + Utility::formatCANID(thisMsg->ID) + ")");
-                            sigModifiedRoot->addChild(sigTemp);
-                        }
-                        if (sigTemp)
-                            sigTemp->addChild(sigItem);
-                    }
-                }
-            }
-            thisMsgHasMissing = false;
-            for (int i = 0; i < otherMsg->sigHandler->getCount(); i++)
-            {
-                DBC_SIGNAL *thisSig = otherMsg->sigHandler->findSignalByIdx(i);
-                QString sigName = thisSig->name;
-                DBC_SIGNAL *otherSig = thisMsg->sigHandler->findSignalByName(sigName);
-                if (!otherSig)
-                {
-                    QTreeWidgetItem *missingSigItem = new QTreeWidgetItem();
-                    missingSigItem->setText(0, sigName);
-                    if (!thisMsgHasMissing)
-                    {
-                        thisMsgHasMissing = true;
-                        msgItem = new QTreeWidgetItem();
-                        msgItem->setText(0, msgName + " (" + Utility::formatCANID(thisMsg->ID) + ")");
-                        sigDiffOne->addChild(msgItem);
-                    }
-                    msgItem->addChild(missingSigItem);
-                }
-            }
-        }
-    }
-
-    for (int i = 0; i < secondDBC->messageHandler->getCount(); i++)
-    {
-        DBC_MESSAGE *origMsg = secondDBC->messageHandler->findMsgByIdx(i);
-        QString msgName = origMsg->name;
-        DBC_MESSAGE *msg = firstDBC->messageHandler->findMsgByName(msgName);
-        if (!msg)
+        if (!change.inFirst)
         {
             QTreeWidgetItem *missingMsgItem = new QTreeWidgetItem();
-            missingMsgItem->setText(0, msgName + " (" + Utility::formatCANID(origMsg->ID) + ")");
+            missingMsgItem->setText(0, change.label());
             msgMissingDBCFirst->addChild(missingMsgItem);
+            continue;
         }
+        if (!change.signalsOnlySecond.isEmpty()) sigDiffOne->addChild(pendingItem(i, PendingSignalsOnlySecond));
+        if (!change.signalsOnlyFirst.isEmpty()) sigDiffTwo->addChild(pendingItem(i, PendingSignalsOnlyFirst));
+        if (!change.modifiedSignals.isEmpty()) sigModifiedRoot->addChild(pendingItem(i, PendingModifiedSignals));
+        if (!change.fields.isEmpty()) msgModifiedRoot->addChild(pendingItem(i, PendingModifiedMessage));
     }
 
     QSettings settings;
     if (settings.value("InfoCompare/AutoExpand", false).toBool())
     {
+        fillAllPending();
         ui->treeDetails->expandAll();
     }
 
@@ -354,6 +250,79 @@ void DBCComparatorWindow::calculateDetails()
     qApp->processEvents();
 }
 
+//a message node whose children only get made once somebody looks
+QTreeWidgetItem *DBCComparatorWindow::pendingItem(int change, PendingKind kind) const
+{
+    QTreeWidgetItem *item = new QTreeWidgetItem();
+    item->setText(0, diff.messages[change].label());
+    item->setData(0, Qt::UserRole, change);
+    item->setData(0, Qt::UserRole + 1, static_cast<int>(kind));
+    item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    return item;
+}
+
+void DBCComparatorWindow::detailsExpanded(QTreeWidgetItem *item)
+{
+    QVariant idx = item->data(0, Qt::UserRole);
+    if (!idx.isValid()) return;
+    item->setData(0, Qt::UserRole, QVariant());
+    if (idx.toInt() >= diff.messages.count()) return;
+
+    const DBCMessageChange &change = diff.messages[idx.toInt()];
+    switch (static_cast<PendingKind>(item->data(0, Qt::UserRole + 1).toInt()))
+    {
+    case PendingSignalsOnlyFirst:
+        foreach (QString sigName, change.signalsOnlyFirst)
+        {
+            QTreeWidgetItem *missingSigItem = new QTreeWidgetItem();
+            missingSigItem->setText(0, sigName);
+            item->addChild(missingSigItem);
+        }
+        break;
+    case PendingSignalsOnlySecond:
+        foreach (QString sigName, change.signalsOnlySecond)
+        {
+            QTreeWidgetItem *missingSigItem = new QTreeWidgetItem();
+            missingSigItem->setText(0, sigName);
+            item->addChild(missingSigItem);
+        }
+        break;
+    case PendingModifiedSignals:
+        for (const DBCSignalChange &sig : change.modifiedSignals)
+        {
+            QTreeWidgetItem *sigItem = new QTreeWidgetItem();
+            sigItem->setText(0, sig.name);
+            addFieldItems(sigItem, sig.fields);
+            item->addChild(sigItem);
+        }
+        break;
+    case PendingModifiedMessage:
+        addFieldItems(item, change.fields);
+        break;
+    }
+}
+
+void DBCComparatorWindow::addFieldItems(QTreeWidgetItem *parent, const QVector<DBCFieldChange> &fields) const
+{
+    for (const DBCFieldChange &field : fields)
+    {
+        QTreeWidgetItem *fieldItem = new QTreeWidgetItem();
+        fieldItem->setText(0, field.field.leftJustified(14) + "First DBC: " + field.first + "      Second: " + field.second);
+        parent->addChild(fieldItem);
+    }
+}
+
+//saving and expanding everything both want the whole tree
+void DBCComparatorWindow::fillAllPending()
+{
+    QTreeWidgetItemIterator it(ui->treeDetails);
+    while (*it)
+    {
+        detailsExpanded(*it);
+        ++it;
+    }
+}
+
 void DBCComparatorWindow::saveDetails()
 {
     QString filename;
@@ -380,6 +349,7 @@ void DBCComparatorWindow::saveDetails()
             return;
 
         QTreeWidget *tree = ui->treeDetails;
+        fillAllPending(); //nodes nobody opened yet still belong in the file
 
 
         QTreeWidgetItemIterator it(tree);
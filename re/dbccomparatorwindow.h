@@ -8,6 +8,7 @@
 #include "dbc/dbc_classes.h"
 #include "dbc/dbchandler.h"
 #include "utility.h"
+#include "dbcdiff.h"
 
 namespace Ui {
 class DBCComparatorWindow;
@@ -25,15 +26,29 @@ private slots:
     void loadFirstFile();
     void loadSecondFile();
     void saveDetails();
+    void detailsExpanded(QTreeWidgetItem *item);
 
 private:
+    //what a message node in the tree fills in when it's first expanded
+    enum PendingKind
+    {
+        PendingSignalsOnlyFirst = 1,
+        PendingSignalsOnlySecond,
+        PendingModifiedSignals,
+        PendingModifiedMessage
+    };
+
     Ui::DBCComparatorWindow *ui;
     DBCFile *firstDBC;
     DBCFile *secondDBC;
     QString firstDBCFilename;
     QString secondDBCFilename;
+    DBCDiff diff;
 
     void calculateDetails();
+    QTreeWidgetItem *pendingItem(int change, PendingKind kind) const;
+    void addFieldItems(QTreeWidgetItem *parent, const QVector<DBCFieldChange> &fields) const;
+    void fillAllPending();
     void showEvent(QShowEvent *);
     void closeEvent(QCloseEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
@@ -0,0 +1,218 @@
+#include "dbcdiff.h"
+
+#include <QHash>
+#include <QSet>
+
+namespace
+{
+void addChange(QVector<DBCFieldChange> &fields, const QString &field, const QString &first, const QString &second)
+{
+    if (first != second) fields.append({field, first, second});
+}
+
+QString nodeName(const DBC_NODE *node)
+{
+    return node ? node->name : QString();
+}
+
+QString byteOrderName(bool intel)
+{
+    return intel ? "Intel" : "Motorola";
+}
+
+QString valTypeName(DBC_SIG_VAL_TYPE type)
+{
+    switch (type)
+    {
+    case UNSIGNED_INT: return "Unsigned";
+    case SIGNED_INT: return "Signed";
+    case SP_FLOAT: return "Float";
+    case DP_FLOAT: return "Double";
+    case STRING: return "String";
+    }
+    return QString();
+}
+
+QString multiplexText(const DBC_SIGNAL *sig)
+{
+    QString text;
+    if (sig->isMultiplexor) text = "Multiplexor";
+    if (sig->isMultiplexed)
+    {
+        if (!text.isEmpty()) text += ", ";
+        text += "Multiplexed " + QString::number(sig->multiplexLowValue);
+        if (sig->multiplexHighValue != sig->multiplexLowValue) text += "-" + QString::number(sig->multiplexHighValue);
+    }
+    return text.isEmpty() ? "None" : text;
+}
+}
+
+void DBCDiff::clear()
+{
+    nodesOnlyFirst.clear();
+    nodesOnlySecond.clear();
+    messages.clear();
+}
+
+void DBCDiff::compare(DBCFile *first, DBCFile *second)
+{
+    clear();
+
+    QSet<QString> firstNodes, secondNodes;
+    for (int i = 0; i < first->dbc_nodes.count(); i++) firstNodes.insert(first->dbc_nodes[i].name.toCaseFolded());
+    for (int i = 0; i < second->dbc_nodes.count(); i++) secondNodes.insert(second->dbc_nodes[i].name.toCaseFolded());
+    for (int i = 0; i < first->dbc_nodes.count(); i++)
+    {
+        if (!secondNodes.contains(first->dbc_nodes[i].name.toCaseFolded())) nodesOnlyFirst.append(first->dbc_nodes[i].name);
+    }
+    for (int i = 0; i < second->dbc_nodes.count(); i++)
+    {
+        if (!firstNodes.contains(second->dbc_nodes[i].name.toCaseFolded())) nodesOnlySecond.append(second->dbc_nodes[i].name);
+    }
+
+    DBCMessageHandler *firstMsgs = first->messageHandler;
+    DBCMessageHandler *secondMsgs = second->messageHandler;
+    int firstCount = firstMsgs->getCount();
+    int secondCount = secondMsgs->getCount();
+
+    QHash<QString, int> firstByName, secondByName;
+    QHash<uint32_t, int> secondByID;
+    for (int i = 0; i < firstCount; i++) firstByName.insert(firstMsgs->findMsgByIdx(i)->name.toCaseFolded(), i);
+    for (int i = secondCount - 1; i >= 0; i--) //backwards so the first of any duplicates wins, same as a search would
+    {
+        DBC_MESSAGE *msg = secondMsgs->findMsgByIdx(i);
+        secondByName.insert(msg->name.toCaseFolded(), i);
+        secondByID.insert(msg->ID, i);
+    }
+
+    QVector<bool> secondMatched(secondCount, false);
+    for (int i = 0; i < firstCount; i++)
+    {
+        DBC_MESSAGE *thisMsg = firstMsgs->findMsgByIdx(i);
+        DBCMessageChange change;
+        change.inFirst = true;
+        change.name = thisMsg->name;
+        change.ID = thisMsg->ID;
+
+        int other = secondByName.value(thisMsg->name.toCaseFolded(), -1);
+        if (other < 0)
+        {
+            //renamed? Only if the message with our ID over there didn't have a match by name on this side either
+            int byID = secondByID.value(thisMsg->ID, -1);
+            if (byID >= 0 && !secondMatched[byID] && !firstByName.contains(secondMsgs->findMsgByIdx(byID)->name.toCaseFolded()))
+                other = byID;
+        }
+
+        if (other >= 0)
+        {
+            secondMatched[other] = true;
+            change.inSecond = true;
+            compareMessage(thisMsg, secondMsgs->findMsgByIdx(other), change);
+            if (change.fields.isEmpty() && change.signalsOnlyFirst.isEmpty() && change.signalsOnlySecond.isEmpty()
+                && change.modifiedSignals.isEmpty()) continue;
+        }
+        messages.append(change);
+    }
+
+    for (int i = 0; i < secondCount; i++)
+    {
+        if (secondMatched[i]) continue;
+        DBC_MESSAGE *msg = secondMsgs->findMsgByIdx(i);
+        DBCMessageChange change;
+        change.inSecond = true;
+        change.name = msg->name;
+        change.ID = msg->ID;
+        messages.append(change);
+    }
+}
+
+void DBCDiff::compareMessage(DBC_MESSAGE *first, DBC_MESSAGE *second, DBCMessageChange &change)
+{
+    addChange(change.fields, "Name", first->name, second->name);
+    addChange(change.fields, "ID", Utility::formatCANID(first->ID), Utility::formatCANID(second->ID));
+    addChange(change.fields, "Length", QString::number(first->len), QString::number(second->len));
+    addChange(change.fields, "Sender", nodeName(first->sender), nodeName(second->sender));
+    addChange(change.fields, "Comment", first->comment, second->comment);
+    compareAttributes(first->attributes, second->attributes, change.fields);
+
+    //findSignalByName is a hash lookup already so each signal costs one lookup on the other side
+    DBCSignalHandler *firstSigs = first->sigHandler;
+    DBCSignalHandler *secondSigs = second->sigHandler;
+    for (int i = 0; i < firstSigs->getCount(); i++)
+    {
+        DBC_SIGNAL *thisSig = firstSigs->findSignalByIdx(i);
+        DBC_SIGNAL *otherSig = secondSigs->findSignalByName(thisSig->name);
+        if (!otherSig)
+        {
+            change.signalsOnlyFirst.append(thisSig->name);
+            continue;
+        }
+        DBCSignalChange sigChange;
+        sigChange.name = thisSig->name;
+        compareSignal(thisSig, otherSig, sigChange.fields);
+        if (!sigChange.fields.isEmpty()) change.modifiedSignals.append(sigChange);
+    }
+    for (int i = 0; i < secondSigs->getCount(); i++)
+    {
+        DBC_SIGNAL *thisSig = secondSigs->findSignalByIdx(i);
+        if (!firstSigs->findSignalByName(thisSig->name)) change.signalsOnlySecond.append(thisSig->name);
+    }
+}
+
+void DBCDiff::compareSignal(DBC_SIGNAL *first, DBC_SIGNAL *second, QVector<DBCFieldChange> &fields)
+{
+    addChange(fields, "Start Bit", QString::number(first->startBit), QString::number(second->startBit));
+    addChange(fields, "Size", QString::number(first->signalSize), QString::number(second->signalSize));
+    addChange(fields, "Byte Order", byteOrderName(first->intelByteOrder), byteOrderName(second->intelByteOrder));
+    addChange(fields, "Type", valTypeName(first->valType), valTypeName(second->valType));
+    addChange(fields, "Bias", QString::number(first->bias), QString::number(second->bias));
+    addChange(fields, "Factor", QString::number(first->factor), QString::number(second->factor));
+    addChange(fields, "Min", QString::number(first->min), QString::number(second->min));
+    addChange(fields, "Max", QString::number(first->max), QString::number(second->max));
+    addChange(fields, "Unit", first->unitName, second->unitName);
+    addChange(fields, "Receiver", nodeName(first->receiver), nodeName(second->receiver));
+    addChange(fields, "Multiplexing", multiplexText(first), multiplexText(second));
+    addChange(fields, "Comment", first->comment, second->comment);
+    compareValues(first->valList, second->valList, fields);
+    compareAttributes(first->attributes, second->attributes, fields);
+}
+
+//attribute values by name. Missing on one side shows up as an empty value there
+void DBCDiff::compareAttributes(const QList<DBC_ATTRIBUTE_VALUE> &first, const QList<DBC_ATTRIBUTE_VALUE> &second,
+                                QVector<DBCFieldChange> &fields)
+{
+    if (first.isEmpty() && second.isEmpty()) return;
+
+    QHash<QString, QString> secondVals;
+    for (const DBC_ATTRIBUTE_VALUE &val : second) secondVals.insert(val.attrName, val.value.toString());
+    QSet<QString> seen;
+    for (const DBC_ATTRIBUTE_VALUE &val : first)
+    {
+        seen.insert(val.attrName);
+        addChange(fields, "Attribute " + val.attrName, val.value.toString(), secondVals.value(val.attrName));
+    }
+    for (const DBC_ATTRIBUTE_VALUE &val : second)
+    {
+        if (!seen.contains(val.attrName)) addChange(fields, "Attribute " + val.attrName, QString(), val.value.toString());
+    }
+}
+
+//value table entries by value, one change per value that was added, dropped or renamed
+void DBCDiff::compareValues(const QList<DBC_VAL_ENUM_ENTRY> &first, const QList<DBC_VAL_ENUM_ENTRY> &second,
+                            QVector<DBCFieldChange> &fields)
+{
+    if (first.isEmpty() && second.isEmpty()) return;
+
+    QHash<int, QString> secondVals;
+    for (const DBC_VAL_ENUM_ENTRY &entry : second) secondVals.insert(entry.value, entry.descript);
+    QSet<int> seen;
+    for (const DBC_VAL_ENUM_ENTRY &entry : first)
+    {
+        seen.insert(entry.value);
+        addChange(fields, "Value " + QString::number(entry.value), entry.descript, secondVals.value(entry.value));
+    }
+    for (const DBC_VAL_ENUM_ENTRY &entry : second)
+    {
+        if (!seen.contains(entry.value)) addChange(fields, "Value " + QString::number(entry.value), QString(), entry.descript);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef DBCDIFF_H
+#define DBCDIFF_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "dbc/dbchandler.h"
+
+//one property that isn't the same on both sides, already in display form
+struct DBCFieldChange
+{
+    QString field;
+    QString first;
+    QString second;
+};
+
+struct DBCSignalChange
+{
+    QString name;
+    QVector<DBCFieldChange> fields;
+};
+
+//A message that is different in some way. Either side can be missing (inFirst / inSecond)
+struct DBCMessageChange
+{
+    bool inFirst = false;
+    bool inSecond = false;
+    QString name; //from the first file if it's there, the second if not
+    uint32_t ID = 0;
+    QVector<DBCFieldChange> fields; //the message itself: name (when matched up by ID), ID, length, sender, attributes
+    QStringList signalsOnlyFirst;
+    QStringList signalsOnlySecond;
+    QVector<DBCSignalChange> modifiedSignals;
+
+    QString label() const { return name + " (" + Utility::formatCANID(ID) + ")"; }
+};
+
+/*
+ * Everything that differs between two DBC files. Messages and nodes are matched by name (ignoring case, like the
+ * rest of the DBC lookups) through hash indexes built once per side so the whole thing is a single pass over each
+ * file. A message whose name only exists on one side is matched by ID if the other side has a message with that
+ * ID that also didn't match anything by name, in other words it was renamed.
+ *
+ * Only changed messages end up in messages, first file order then whatever is only in the second file.
+ */
+class DBCDiff
+{
+public:
+    void compare(DBCFile *first, DBCFile *second);
+    void clear();
+
+    QStringList nodesOnlyFirst;
+    QStringList nodesOnlySecond;
+    QVector<DBCMessageChange> messages;
+
+private:
+    static void compareMessage(DBC_MESSAGE *first, DBC_MESSAGE *second, DBCMessageChange &change);
+    static void compareSignal(DBC_SIGNAL *first, DBC_SIGNAL *second, QVector<DBCFieldChange> &fields);
+    static void compareAttributes(const QList<DBC_ATTRIBUTE_VALUE> &first, const QList<DBC_ATTRIBUTE_VALUE> &second,
+                                  QVector<DBCFieldChange> &fields);
+    static void compareValues(const QList<DBC_VAL_ENUM_ENTRY> &first, const QList<DBC_VAL_ENUM_ENTRY> &second,
+                              QVector<DBCFieldChange> &fields);
+};
+
+#endif // DBCDIFF_H
@@ -0,0 +1,139 @@
+#include "discreterangesets.h"
+
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+DiscreteRangeSets::DiscreteRangeSets()
+{
+    reset(1, 8, 1, 1);
+}
+
+void DiscreteRangeSets::reset(int minBits, int maxBits, int buckets, int capacity)
+{
+    this->minBits = qBound(1, minBits, 8);
+    this->maxBits = qBound(this->minBits, maxBits, 8);
+    widths = this->maxBits - this->minBits + 1;
+    this->buckets = qMax(1, buckets);
+    this->capacity = qBound(1, capacity, 254); //count has to be able to go one past it
+    stride = 1 + this->capacity;
+    ids.clear();
+}
+
+void DiscreteRangeSets::add(uint32_t id, const uint8_t *payload, int len, int bucket)
+{
+    if (bucket < 0 || bucket >= buckets) return;
+
+    IdSets &s = ids[id];
+    if (s.dead.isEmpty())
+    {
+        s.sets.fill(0, 64 * widths * buckets * stride);
+        s.dead.fill(0, 64 * widths);
+    }
+
+    int bytes = qMin(len, 8);
+    uint8_t word[8];
+    memset(word, 0, 8);
+    memcpy(word, payload, bytes);
+    quint64 data = qFromLittleEndian<quint64>(word);
+    int totalBits = bytes * 8;
+    if (totalBits > s.maxBits) s.maxBits = totalBits;
+
+    for (int bits = minBits; bits <= maxBits; bits++)
+    {
+        quint64 mask = (1ull << bits) - 1;
+        for (int start = 0; start + bits <= totalBits; start++)
+        {
+            int range = rangeIndex(start, bits);
+            if (s.dead[range]) continue;
+
+            uint8_t value = static_cast<uint8_t>((data >> start) & mask);
+            uint8_t *slot = s.sets.data() + (range * buckets + bucket) * stride;
+            if (contains(slot, value)) continue;
+            if (slot[0] == capacity) s.dead[range] = 1; //one too many, this range can't be what we're after
+            else slot[1 + slot[0]++] = value;
+        }
+    }
+}
+
+bool DiscreteRangeSets::contains(const uint8_t *set, uint8_t value) const
+{
+    for (int i = 0; i < set[0]; i++)
+    {
+        if (set[1 + i] == value) return true;
+    }
+    return false;
+}
+
+/*
+ * Every live range pred accepts, narrowest first. A range that covers one already reported for the ID is left out
+ * since the extra bits in it didn't add anything.
+ */
+template <typename Pred>
+QVector<DiscreteRangeSets::Match> DiscreteRangeSets::collect(Pred pred) const
+{
+    QVector<Match> out;
+    QList<uint32_t> keys = ids.keys();
+    std::sort(keys.begin(), keys.end());
+    for (uint32_t id : keys)
+    {
+        const IdSets &s = ids[id];
+        int first = out.count();
+        for (int bits = minBits; bits <= maxBits; bits++)
+        {
+            for (int start = 0; start + bits <= s.maxBits; start++)
+            {
+                int range = rangeIndex(start, bits);
+                if (s.dead[range] || !pred(s, range)) continue;
+
+                bool covers = false;
+                for (int m = first; m < out.count() && !covers; m++)
+                {
+                    covers = out[m].startBit >= start && out[m].startBit + out[m].bits <= start + bits;
+                }
+                if (covers) continue;
+
+                Match match;
+                match.id = id;
+                match.startBit = start;
+                match.bits = bits;
+                for (int b = 0; b < buckets; b++)
+                {
+                    const uint8_t *values = set(s, range, b);
+                    QVector<uint8_t> list(values + 1, values + 1 + values[0]);
+                    std::sort(list.begin(), list.end());
+                    match.values.append(list);
+                }
+                out.append(match);
+            }
+        }
+    }
+    return out;
+}
+
+QVector<DiscreteRangeSets::Match> DiscreteRangeSets::distinctStates() const
+{
+    return collect([this](const IdSets &s, int range)
+    {
+        for (int b = 0; b < buckets; b++)
+        {
+            const uint8_t *mine = set(s, range, b);
+            bool unique = false;
+            for (int i = 0; i < mine[0] && !unique; i++)
+            {
+                unique = true;
+                for (int o = 0; o < buckets && unique; o++)
+                {
+                    if (o != b && contains(set(s, range, o), mine[1 + i])) unique = false;
+                }
+            }
+            if (!unique) return false; //also catches a bucket that hasn't seen anything yet
+        }
+        return true;
+    });
+}
+
+QVector<DiscreteRangeSets::Match> DiscreteRangeSets::valueCount(int count) const
+{
+    return collect([this, count](const IdSets &s, int range) { return set(s, range, 0)[0] == count; });
+}
@@ -0,0 +1,58 @@
+#ifndef DISCRETERANGESETS_H
+#define DISCRETERANGESETS_H
+
+#include <QHash>
+#include <QVector>
+#include "can_structs.h"
+
+/*
+ * Distinct values seen in every small bit range of every ID, kept separately for a handful of buckets (the states of
+ * a discrete state session). Ranges are 1 to 8 bits wide at any start bit in the first 8 bytes, bits numbered
+ * little endian. Each range / bucket pair is a tiny fixed capacity set: up to capacity values and a count. One more
+ * distinct value than that saturates it and the whole range is dropped for good, so after the first few frames
+ * most ranges cost a single byte compare per frame.
+ *
+ * Frames just get added as they come in. Nothing is buffered so a session can run as long as it likes.
+ */
+class DiscreteRangeSets
+{
+public:
+    struct Match
+    {
+        uint32_t id;
+        int startBit;
+        int bits;
+        QVector<QVector<uint8_t>> values; //per bucket
+    };
+
+    DiscreteRangeSets();
+    void reset(int minBits, int maxBits, int buckets, int capacity);
+    void add(uint32_t id, const uint8_t *payload, int len, int bucket);
+    bool isEmpty() const { return ids.isEmpty(); }
+
+    //ranges where every bucket saw something and each one has a value none of the others did
+    QVector<Match> distinctStates() const;
+    //ranges that took exactly count distinct values in bucket 0
+    QVector<Match> valueCount(int count) const;
+
+private:
+    struct IdSets
+    {
+        QVector<uint8_t> sets; //per range then bucket: count, then capacity value slots
+        QVector<uint8_t> dead; //per range, saturated somewhere
+        int maxBits = 0; //widest payload seen, in bits
+    };
+
+    int rangeIndex(int startBit, int bits) const { return startBit * widths + (bits - minBits); }
+    const uint8_t *set(const IdSets &s, int range, int bucket) const { return s.sets.constData() + (range * buckets + bucket) * stride; }
+    bool contains(const uint8_t *set, uint8_t value) const;
+    template <typename Pred> QVector<Match> collect(Pred pred) const;
+
+    int minBits, maxBits, widths;
+    int buckets;
+    int capacity;
+    int stride; //bytes in one set
+    QHash<uint32_t, IdSets> ids;
+};
+
+#endif // DISCRETERANGESETS_H
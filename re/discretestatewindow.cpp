@@ -2,8 +2,15 @@
 #include "ui_discretestatewindow.h"
 #include "mainwindow.h"
 #include "helpwindow.h"
+#include "pipelinetrace.h"
 
-DiscreteStateWindow::DiscreteStateWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+//distinct values one state of a realtime session can show in a bit range before the range is dropped. A bit of
+//slack for a frame or two caught mid change
+#define DISCRETE_STATE_VALUES   2
+//ticks (100ms each) at the start of every idle / state period that are ignored while things settle
+#define DISCRETE_SETTLE_TICKS   5
+
+DiscreteStateWindow::DiscreteStateWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::DiscreteStateWindow)
 {
@@ -12,10 +19,14 @@ DiscreteStateWindow::DiscreteStateWindow(const QVector<CANFrame> *frames, QWidge
 
     modelFrames = frames;
     operatingState = DWStates::IDLE;
+    resultsDirty = false;
+    ticksPerStateChange = ticksUntilStateChange = 0;
 
     timer = new QTimer();
     timer->setInterval(100);
 
+    ui->treeMatches->setHeaderHidden(true);
+
     isRealtime = ui->rbRealtime->isChecked();
     typeChanged();
 
@@ -65,12 +76,6 @@ DiscreteStateWindow::~DiscreteStateWindow()
     removeEventFilter(this);
     timer->stop();
 
-    for (int i = 0; i < stateFrames.count(); i++)
-    {
-        stateFrames[i]->clear();
-        delete(stateFrames[i]);
-    }
-
     delete timer;
     delete ui;
 }
@@ -112,8 +117,8 @@ void DiscreteStateWindow::typeChanged()
         ui->spinFreq->setEnabled(true);
         ui->spinIterations->setEnabled(true);
         ui->lblStatus->setEnabled(true);
-        ui->spinMaxBits->setEnabled(false);
-        ui->spinMinBits->setEnabled(false);
+        ui->spinMaxBits->setEnabled(true);
+        ui->spinMinBits->setEnabled(true);
         ui->listID->setEnabled(false);
         ui->btnAll->setEnabled(false);
         ui->btnNone->setEnabled(false);
@@ -123,7 +128,7 @@ void DiscreteStateWindow::typeChanged()
 
 void DiscreteStateWindow::updatedFrames(int numFrames)
 {
-    CANFrame thisFrame;
+    TRACE_SCOPE("DiscreteStateWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted. Kill the display
     {
         ui->listID->clear();
@@ -136,20 +141,25 @@ void DiscreteStateWindow::updatedFrames(int numFrames)
     else //just got some new frames. See if they are relevant.
     {
         if (numFrames > modelFrames->count()) return;
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        //a realtime session files every frame under the state the user should be in right now
+        int bucket = isRealtime ? currentBucket() : -1;
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
         {
-            thisFrame = modelFrames->at(i);
+            const CANFrameRecord &rec = modelFrames->record(i);
 
-            if (!idFilters.contains(thisFrame.frameId()))
+            if (!idFilters.contains(rec.frameId()))
             {
-                idFilters.insert(thisFrame.frameId(), true);
-                QListWidgetItem* listItem = new QListWidgetItem(Utility::formatCANID(thisFrame.frameId(), thisFrame.hasExtendedFrameFormat()), ui->listID);
+                idFilters.insert(rec.frameId(), true);
+                QListWidgetItem* listItem = new QListWidgetItem(Utility::formatCANID(rec.frameId(), rec.isExtended()), ui->listID);
                 listItem->setFlags(listItem->flags() | Qt::ItemIsUserCheckable); // set checkable flag
                 listItem->setCheckState(Qt::Checked); //default all filters to be set active
             }
 
-            //if (operatingState == DWStates::IDLE) stateFrames[0]->append(thisFrame);
-            //else stateFrames[currToggleState + 1]->append(thisFrame);
+            if (bucket >= 0)
+            {
+                rangeSets.add(rec.frameId(), modelFrames->payloadData(i), rec.len, bucket);
+                resultsDirty = true;
+            }
         }
     }
 }
@@ -163,12 +173,12 @@ void DiscreteStateWindow::refreshFilterList()
 
     for (int i = 0; i < modelFrames->length(); i++)
     {
-        CANFrame thisFrame = modelFrames->at(i);
-        id = thisFrame.frameId();
+        const CANFrameRecord &rec = modelFrames->record(i);
+        id = rec.frameId();
         if (!idFilters.contains(id))
         {
             idFilters.insert(id, true);
-            QListWidgetItem* listItem = new QListWidgetItem(Utility::formatCANID(id, thisFrame.hasExtendedFrameFormat()), ui->listID);
+            QListWidgetItem* listItem = new QListWidgetItem(Utility::formatCANID(id, rec.isExtended()), ui->listID);
             listItem->setFlags(listItem->flags() | Qt::ItemIsUserCheckable); // set checkable flag
             listItem->setCheckState(Qt::Checked); //default all filters to be set active
         }
@@ -265,16 +275,10 @@ void DiscreteStateWindow::handleStartButton()
         currToggleState = 0;
         currIteration = 0;
 
-        for (int i = stateFrames.count() - 1; i > 0; i--)
-        {
-            stateFrames[i]->clear();
-            stateFrames.removeAt(i);
-        }
-
-        for (int j = 0; j <= numToggleStates; j++)
-        {
-            stateFrames.append(new QVector<CANFrame>());
-        }
+        //bucket 0 is idle, then one for each state the user gets asked to go to
+        rangeSets.reset(ui->spinMinBits->value(), ui->spinMaxBits->value(), numToggleStates, DISCRETE_STATE_VALUES);
+        resultsDirty = false;
+        ui->treeMatches->clear();
 
         timer->start();
     }
@@ -305,10 +309,10 @@ void DiscreteStateWindow::handleTick()
         if (ticksUntilStateChange == 0)
         {
             ticksUntilStateChange = ticksPerStateChange;
-            currIteration++;
-            if (currIteration > numIterations)
+            if (currToggleState == 0) currIteration++; //been through every state once more
+            if (currIteration >= numIterations)
             {
-                operatingState = DWStates::IDLE;
+                operatingState = DWStates::DONE;
                 timer->stop();
                 calculateResults();
             }
@@ -322,11 +326,37 @@ void DiscreteStateWindow::handleTick()
             ticksUntilStateChange = ticksPerStateChange;
             operatingState = DWStates::COUNTDOWN_WAITING;
             currToggleState++;
-            if (currToggleState > numToggleStates) currToggleState = 0;
+            if (currToggleState >= numToggleStates - 1) currToggleState = 0;
         }
         break;
     }
     updateStateLabel();
+
+    //matches update live, at most once a tick however fast frames come in
+    if (resultsDirty && operatingState != DWStates::DONE)
+    {
+        resultsDirty = false;
+        showMatches(rangeSets.distinctStates());
+    }
+}
+
+/*
+ * Which bucket frames coming in right now belong to. -1 outside of a session, while the user is going back to idle
+ * and for the first moments of each period while they get into the new state.
+ */
+int DiscreteStateWindow::currentBucket() const
+{
+    int settle = qMin(DISCRETE_SETTLE_TICKS, ticksPerStateChange / 2);
+    bool settled = (ticksPerStateChange - ticksUntilStateChange) >= settle;
+    switch (operatingState)
+    {
+    case DWStates::COUNTDOWN_SIGNAL:
+        return settled ? 0 : -1;
+    case DWStates::GETTING_SIGNAL:
+        return settled ? (currToggleState + 1) : -1;
+    default:
+        return -1;
+    }
 }
 
 void DiscreteStateWindow::calculateResults()
@@ -334,38 +364,61 @@ void DiscreteStateWindow::calculateResults()
     int minBits, maxBits;
     if (isRealtime)
     {
-
+        //everything was already sorted into the sets as it came in
+        resultsDirty = false;
+        showMatches(rangeSets.distinctStates());
     }
     else //use already loaded frames from main cache
     {
         //basic overview: run through all ID filters and see if it is enabled.
-        //If so add it to a giant list of messages by ID where each ID has its own
-        //list of messages
-        //Then, for each ID start a loop that runs from largest bits to smallest bits for scan
-        //For each value run through the algorithm for all messages. At the end list any matches
-        //the simplest approach seems to be to grab that number of bits and then record every
-        //unique value. IF the # of unique values is the same as the number of states then
+        //If so every one of its frames goes through the range sets once, which records every unique value of
+        //every bit range. IF the # of unique values is the same as the number of states then
         //we've got a match.It should be noted that the # of states must be at least 2 - the idle
         //state is 1 and then a second state at the minimum. Turn signals might be 3 states then
 
         minBits = ui->spinMinBits->value();
         maxBits = ui->spinMaxBits->value();
+        int numStates = ui->spinStates->value();
+        rangeSets.reset(minBits, maxBits, 1, numStates);
         QHash<int, bool>::const_iterator it;
-        QList<CANFrame> frameCache;
         for (it = idFilters.begin(); it != idFilters.end(); ++it)
         {
             if (it.value())
             {
-                frameCache.clear();
-                for (int i = 0; i < modelFrames->count(); i++)
+                for (int row : modelFrames->rowsOf(static_cast<uint32_t>(it.key())))
                 {
-                    if (modelFrames->at(i).frameId() == (unsigned int)it.key()) frameCache.append(modelFrames->at(i));
-                }
-                for (int bits = maxBits; bits >= minBits; bits--)
-                {
-                    QList<int> values;
+                    rangeSets.add(static_cast<uint32_t>(it.key()), modelFrames->payloadData(row), modelFrames->record(row).len, 0);
                 }
             }
         }
+        showMatches(rangeSets.valueCount(numStates));
+    }
+}
+
+void DiscreteStateWindow::showMatches(const QVector<DiscreteRangeSets::Match> &matches)
+{
+    ui->treeMatches->clear();
+    QTreeWidgetItem *idItem = nullptr;
+    for (const DiscreteRangeSets::Match &match : matches)
+    {
+        if (!idItem || idItem->data(0, Qt::UserRole).toUInt() != match.id)
+        {
+            idItem = new QTreeWidgetItem(ui->treeMatches);
+            idItem->setText(0, "ID: " + Utility::formatCANID(match.id));
+            idItem->setData(0, Qt::UserRole, match.id);
+        }
+
+        QString text = "Bits " + QString::number(match.startBit);
+        if (match.bits > 1) text += "-" + QString::number(match.startBit + match.bits - 1);
+        QStringList states;
+        for (int b = 0; b < match.values.count(); b++)
+        {
+            QStringList vals;
+            for (uint8_t v : match.values[b]) vals.append(Utility::formatNumber(v));
+            states.append(((match.values.count() > 1) ? ((b == 0) ? tr("idle") : tr("state ") + QString::number(b)) + ": " : QString()) + vals.join(","));
+        }
+        QTreeWidgetItem *item = new QTreeWidgetItem(idItem);
+        item->setText(0, text + "  (" + states.join("  ") + ")");
     }
+    ui->treeMatches->expandAll();
 }
@@ -4,6 +4,8 @@
 #include <QDialog>
 #include <QTimer>
 #include "can_structs.h"
+#include "canframestore.h"
+#include "discreterangesets.h"
 
 namespace Ui {
 class DiscreteStateWindow;
@@ -26,7 +28,7 @@ class DiscreteStateWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit DiscreteStateWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit DiscreteStateWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~DiscreteStateWindow();
     void showEvent(QShowEvent*);
 
@@ -38,8 +40,9 @@ private slots:
 
 private:
     Ui::DiscreteStateWindow *ui;
-    const QVector<CANFrame> *modelFrames;
-    QList< QVector<CANFrame> *> stateFrames;
+    const CANFrameStore *modelFrames;
+    DiscreteRangeSets rangeSets;
+    bool resultsDirty;
     QTimer *timer;
     DiscreteWindowState operatingState;
     int ticksUntilStateChange;
@@ -58,6 +61,8 @@ private:
     void writeSettings();
     void updateStateLabel();
     void calculateResults();
+    int currentBucket() const;
+    void showMatches(const QVector<DiscreteRangeSets::Match> &matches);
 };
 
 #endif // DISCRETESTATEWINDOW_H
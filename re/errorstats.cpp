@@ -0,0 +1,257 @@
+#include "errorstats.h"
+
+#include <algorithm>
+
+//SocketCAN error frame payload. Byte 1 is the controller status when ControllerError is set
+#define CTRL_STATUS_BYTE        1
+#define CTRL_WARNING_BITS       0x0C //RX / TX warning
+#define CTRL_PASSIVE_BITS       0x30 //RX / TX passive
+#define CTRL_ACTIVE_BIT         0x40 //back to error active
+//bytes 6 and 7 carry the TX and RX error counters when the last class bit is set
+#define ERROR_COUNTER_BIT       0x200
+#define TX_COUNTER_BYTE         6
+#define RX_COUNTER_BYTE         7
+
+void BusErrorStats::place(uint64_t stamp, bool error)
+{
+    uint64_t offset = (stamp > bucketStart) ? stamp - bucketStart : 0;
+    uint64_t idx = offset / bucketWidth;
+    while (idx >= ERRORSTATS_BUCKETS)
+    {
+        //out of room, pairs of buckets become one and the whole timeline goes on at half the resolution
+        int half = (buckets.count() + 1) / 2;
+        for (int i = 0; i < half; i++)
+        {
+            ErrorBucket merged = buckets[2 * i];
+            if (2 * i + 1 < buckets.count())
+            {
+                merged.frames += buckets[2 * i + 1].frames;
+                merged.errors += buckets[2 * i + 1].errors;
+            }
+            buckets[i] = merged;
+        }
+        buckets.resize(half);
+        bucketWidth *= 2;
+        idx = offset / bucketWidth;
+    }
+    if (static_cast<int>(idx) >= buckets.count()) buckets.resize(static_cast<int>(idx) + 1);
+    if (error) buckets[static_cast<int>(idx)].errors++;
+    else buckets[static_cast<int>(idx)].frames++;
+}
+
+double BusErrorStats::lift(const ErrorSuspect &suspect) const
+{
+    if (suspect.frames == 0 || frames == 0 || errors == 0) return 0.0;
+    double after = static_cast<double>(suspect.lastBefore) / static_cast<double>(suspect.frames);
+    double overall = static_cast<double>(errors) / static_cast<double>(frames);
+    return after / overall;
+}
+
+//IDs that had an error come in after them, the ones most often right before an error first
+QVector<QPair<uint32_t, const ErrorSuspect *>> BusErrorStats::rankedSuspects() const
+{
+    QVector<QPair<uint32_t, const ErrorSuspect *>> ranked;
+    for (QHash<uint32_t, ErrorSuspect>::const_iterator it = suspects.constBegin(); it != suspects.constEnd(); ++it)
+    {
+        if (it.value().lastBefore > 0 || it.value().nearBefore > 0) ranked.append(qMakePair(it.key(), &it.value()));
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const QPair<uint32_t, const ErrorSuspect *> &a, const QPair<uint32_t, const ErrorSuspect *> &b)
+    {
+        if (a.second->lastBefore != b.second->lastBefore) return a.second->lastBefore > b.second->lastBefore;
+        if (a.second->nearBefore != b.second->nearBefore) return a.second->nearBefore > b.second->nearBefore;
+        return a.first < b.first;
+    });
+    return ranked;
+}
+
+ErrorStats::~ErrorStats()
+{
+    clear();
+}
+
+void ErrorStats::clear()
+{
+    qDeleteAll(buses);
+    buses.clear();
+    haveOrigin = false;
+    origin = 0;
+}
+
+//payload is only looked at for error frames and can be null for anything else
+void ErrorStats::add(const CANFrameRecord &rec, const uint8_t *payload)
+{
+    if (!haveOrigin)
+    {
+        origin = rec.timestamp;
+        haveOrigin = true;
+    }
+    const int busNum = rec.bus;
+    if (busNum >= buses.count()) buses.resize(busNum + 1);
+    BusErrorStats *&slot = buses[busNum];
+    if (!slot)
+    {
+        slot = new BusErrorStats;
+        slot->bus = busNum;
+        slot->bucketStart = origin;
+    }
+    BusErrorStats &bus = *slot;
+
+    if (rec.type() != QCanBusFrame::ErrorFrame)
+    {
+        const uint32_t id = rec.idFlags & (CANFrameRecord::ID_MASK | CANFrameRecord::EXTENDED_BIT);
+        bus.frames++;
+        bus.place(rec.timestamp, false);
+        bus.suspects[id].frames++;
+        bus.recent[bus.recentPos].id = id;
+        bus.recent[bus.recentPos].stamp = rec.timestamp;
+        bus.recentPos = (bus.recentPos + 1) % ERRORSTATS_RECENT;
+        if (bus.recentCount < ERRORSTATS_RECENT) bus.recentCount++;
+        return;
+    }
+
+    bus.errors++;
+    bus.lastErrorStamp = rec.timestamp;
+    bus.place(rec.timestamp, true);
+
+    //an error frame's ID bits are its QCanBusFrame::FrameErrors
+    const uint32_t flags = rec.idFlags & CANFrameRecord::ID_MASK;
+    if ((flags & ((1u << ERRORSTATS_CLASSES) - 1)) == 0) bus.classCounts[ERRORSTATS_CLASSES - 1]++; //says nothing, so other
+    for (int c = 0; c < ERRORSTATS_CLASSES; c++)
+    {
+        if (flags & (1u << c)) bus.classCounts[c]++;
+    }
+
+    ErrorBusState next = bus.state;
+    bool stateGiven = false;
+    if (flags & QCanBusFrame::BusOffError)
+    {
+        next = ErrorBusState::BusOff;
+        stateGiven = true;
+    }
+    else
+    {
+        if (flags & QCanBusFrame::ControllerRestartError)
+        {
+            next = ErrorBusState::Active;
+            stateGiven = true;
+        }
+        if ((flags & QCanBusFrame::ControllerError) && payload && rec.len > CTRL_STATUS_BYTE)
+        {
+            const uint8_t status = payload[CTRL_STATUS_BYTE];
+            stateGiven = true;
+            if (status & CTRL_PASSIVE_BITS) next = ErrorBusState::Passive;
+            else if (status & CTRL_WARNING_BITS) next = ErrorBusState::Warning;
+            else if (status & CTRL_ACTIVE_BIT) next = ErrorBusState::Active;
+            else stateGiven = false;
+        }
+    }
+    if ((flags & ERROR_COUNTER_BIT) && payload && rec.len > RX_COUNTER_BYTE)
+    {
+        bus.txErrorCounter = payload[TX_COUNTER_BYTE];
+        bus.rxErrorCounter = payload[RX_COUNTER_BYTE];
+        bus.maxTxErrorCounter = std::max(bus.maxTxErrorCounter, bus.txErrorCounter);
+        bus.maxRxErrorCounter = std::max(bus.maxRxErrorCounter, bus.rxErrorCounter);
+        //the thresholds every CAN controller uses, for frames that only have the counters
+        if (!stateGiven)
+        {
+            const int worst = std::max(bus.txErrorCounter, bus.rxErrorCounter);
+            if (worst >= 128) next = ErrorBusState::Passive;
+            else if (worst >= 96) next = ErrorBusState::Warning;
+            else next = ErrorBusState::Active;
+        }
+    }
+    if (next != bus.state)
+    {
+        bus.state = next;
+        bus.stateEntered[static_cast<int>(next)]++;
+    }
+
+    //the newest frame takes the blame, and everything within ERRORSTATS_BLAME_US before the error shares it
+    if (bus.recentCount > 0)
+    {
+        const int newest = (bus.recentPos + ERRORSTATS_RECENT - 1) % ERRORSTATS_RECENT;
+        bus.suspects[bus.recent[newest].id].lastBefore++;
+        uint32_t counted[ERRORSTATS_RECENT];
+        int numCounted = 0;
+        for (int i = 0; i < bus.recentCount; i++)
+        {
+            const BusErrorStats::Recent &r = bus.recent[(newest + ERRORSTATS_RECENT - i) % ERRORSTATS_RECENT];
+            if (rec.timestamp > r.stamp + ERRORSTATS_BLAME_US) break; //older ones are further away still
+            if (std::find(counted, counted + numCounted, r.id) != counted + numCounted) continue;
+            counted[numCounted++] = r.id;
+            bus.suspects[r.id].nearBefore++;
+        }
+    }
+}
+
+QVector<const BusErrorStats *> ErrorStats::all() const
+{
+    QVector<const BusErrorStats *> found;
+    for (const BusErrorStats *bus : buses)
+    {
+        if (bus) found.append(bus);
+    }
+    return found;
+}
+
+qint64 ErrorStats::bytes() const
+{
+    using MemoryAccounting::bytesOf;
+    qint64 total = bytesOf(buses);
+    for (const BusErrorStats *bus : buses)
+    {
+        if (bus) total += static_cast<qint64>(sizeof(BusErrorStats)) + bytesOf(bus->buckets) + bytesOf(bus->suspects);
+    }
+    return total;
+}
+
+QString ErrorStats::className(int errorClass)
+{
+    switch (errorClass)
+    {
+    case 0: return "TX Timeout";
+    case 1: return "Lost Arbitration";
+    case 2: return "Controller Error";
+    case 3: return "Protocol Violation";
+    case 4: return "Transceiver Error";
+    case 5: return "Missing ACK";
+    case 6: return "Bus Off";
+    case 7: return "Bus Error";
+    case 8: return "Controller Restarted";
+    default: return "Other";
+    }
+}
+
+QString ErrorStats::stateName(ErrorBusState state)
+{
+    switch (state)
+    {
+    case ErrorBusState::Active: return "Error Active";
+    case ErrorBusState::Warning: return "Error Warning";
+    case ErrorBusState::Passive: return "Error Passive";
+    case ErrorBusState::BusOff: return "Bus Off";
+    default: return "Unknown";
+    }
+}
+
+ErrorStatsStore *ErrorStatsStore::forFrames(const CANFrameStore *frames)
+{
+    return perFrameStore<ErrorStatsStore>(frames, [](const CANFrameStore *f) { return new ErrorStatsStore(f); });
+}
+
+ErrorStatsStore::ErrorStatsStore(const CANFrameStore *frames) : FrameStoreFollower(frames)
+{
+    rebuild();
+}
+
+void ErrorStatsStore::reportMemory(QVector<MemoryUsage> &out) const
+{
+    out.append({memoryOwner("Error Analytics"), "per bus counters", errorStats.bytes()});
+}
+
+//in arrival order, the correlation needs to see what came just before each error
+void ErrorStatsStore::add(int row)
+{
+    const CANFrameRecord &rec = frames->record(row);
+    errorStats.add(rec, rec.type() == QCanBusFrame::ErrorFrame ? frames->payloadData(row) : nullptr);
+}
@@ -0,0 +1,140 @@
+#ifndef ERRORSTATS_H
+#define ERRORSTATS_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "framestorefollower.h"
+#include "memoryaccounting.h"
+
+//width of a timeline bucket to start with, in us. Doubles whenever a bus's capture outgrows ERRORSTATS_BUCKETS
+#define ERRORSTATS_FIRST_BUCKET_US  100000
+//buckets in each bus's timeline
+#define ERRORSTATS_BUCKETS          1024
+//error classes, one per QCanBusFrame::FrameError bit
+#define ERRORSTATS_CLASSES          10
+//frames on the same bus this long before an error share the blame for it, in us
+#define ERRORSTATS_BLAME_US         2000
+//how many of the frames before an error are looked at for that
+#define ERRORSTATS_RECENT           4
+
+enum class ErrorBusState
+{
+    Unknown,
+    Active,
+    Warning,
+    Passive,
+    BusOff
+};
+
+struct ErrorBucket
+{
+    quint32 frames = 0; //data and remote frames
+    quint32 errors = 0;
+};
+
+//one ID's share of the errors on its bus
+struct ErrorSuspect
+{
+    quint64 frames = 0;
+    quint64 lastBefore = 0; //errors where this ID was the frame right before
+    quint64 nearBefore = 0; //errors within ERRORSTATS_BLAME_US of one of its frames
+};
+
+/*
+ * Error analytics for one bus, kept up to date one frame at a time:
+ * - frame and error counts over time in ERRORSTATS_BUCKETS buckets. When the capture outgrows them neighbouring
+ *   buckets get merged and the width doubles, so the whole capture is always covered at whatever resolution fits
+ * - a count per error class (the QCanBusFrame::FrameError bits)
+ * - the controller state as far as the error frames tell it (SocketCAN layout: controller status in byte 1,
+ *   TX / RX error counters in bytes 6 and 7) and how often it went into each state
+ * - for every ID, how often an error came right after one of its frames
+ */
+struct BusErrorStats
+{
+    int bus = 0;
+    quint64 frames = 0;
+    quint64 errors = 0;
+    quint64 classCounts[ERRORSTATS_CLASSES] = {0};
+    uint64_t lastErrorStamp = 0;
+
+    ErrorBusState state = ErrorBusState::Unknown;
+    quint64 stateEntered[5] = {0}; //by ErrorBusState
+    int txErrorCounter = -1; //from the last error frame that had them, -1 if none did yet
+    int rxErrorCounter = -1;
+    int maxTxErrorCounter = 0;
+    int maxRxErrorCounter = 0;
+
+    uint64_t bucketStart = 0; //timestamp bucket 0 starts at
+    uint64_t bucketWidth = ERRORSTATS_FIRST_BUCKET_US;
+    QVector<ErrorBucket> buckets; //only as many as the capture has reached
+
+    QHash<uint32_t, ErrorSuspect> suspects; //frame ID with the extended bit, as in CANFrameRecord::idFlags
+
+    //ID and what the error rate is after its frames compared to the bus as a whole, highest first
+    QVector<QPair<uint32_t, const ErrorSuspect *>> rankedSuspects() const;
+    double lift(const ErrorSuspect &suspect) const;
+
+private:
+    friend class ErrorStats;
+    struct Recent
+    {
+        uint32_t id;
+        uint64_t stamp;
+    };
+    Recent recent[ERRORSTATS_RECENT];
+    int recentCount = 0;
+    int recentPos = 0;
+
+    void place(uint64_t stamp, bool error);
+};
+
+class ErrorStats
+{
+public:
+    ErrorStats() {}
+    ~ErrorStats();
+    void clear();
+    void add(const CANFrameRecord &rec, const uint8_t *payload);
+    const BusErrorStats *find(int bus) const { return (bus >= 0 && bus < buses.count()) ? buses[bus] : nullptr; }
+    QVector<const BusErrorStats *> all() const;
+    qint64 bytes() const;
+
+    static QString className(int errorClass);
+    static QString stateName(ErrorBusState state);
+
+private:
+    Q_DISABLE_COPY(ErrorStats)
+    QVector<BusErrorStats *> buses; //by bus number, nullptr for buses nothing came in on
+    uint64_t origin = 0; //first timestamp seen, every bus's timeline starts there so they line up
+    bool haveOrigin = false;
+};
+
+/*
+ * Error analytics for one frame store, shared by everything that wants them. A FrameStoreFollower going through
+ * the store in arrival order since the error to ID correlation needs to know what came just before each error.
+ * Frames the store evicts stay counted.
+ *
+ * GUI thread only.
+ */
+class ErrorStatsStore : public FrameStoreFollower, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    static ErrorStatsStore *forFrames(const CANFrameStore *frames);
+
+    const ErrorStats &stats() const { return errorStats; }
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+
+protected:
+    void clearState() override { errorStats.clear(); }
+    void add(int row) override;
+
+private:
+    explicit ErrorStatsStore(const CANFrameStore *frames);
+
+    ErrorStats errorStats;
+};
+
+#endif // ERRORSTATS_H
@@ -0,0 +1,253 @@
+#include "errorstatswindow.h"
+#include "ui_errorstatswindow.h"
+#include "mainwindow.h"
+#include "utility.h"
+#include "helpwindow.h"
+#include "re/errorstats.h"
+#include "re/offscreenplot.h"
+
+//at most this often the tables and graph get redrawn while frames are coming in, in ms
+#define ERRORSTATS_REFRESH_MS       250
+//rows in the suspect table, the rest are very unlikely to be interesting
+#define ERRORSTATS_MAX_SUSPECTS     200
+
+namespace
+{
+QString counterText(int value, int max)
+{
+    if (value < 0) return QString("-");
+    return QString("%1 (max %2)").arg(value).arg(max);
+}
+}
+
+ErrorStatsWindow::ErrorStatsWindow(const CANFrameStore *frames, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::ErrorStatsWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+
+    store = ErrorStatsStore::forFrames(frames);
+    selectedBus = -1;
+
+    QStringList headers;
+    headers << tr("Bus") << tr("Frames") << tr("Errors") << tr("Errors / 1000 Frames") << tr("State")
+            << tr("TX Errors") << tr("RX Errors") << tr("Warning / Passive / Bus Off Entered");
+    ui->tableBuses->setColumnCount(headers.count());
+    ui->tableBuses->setHorizontalHeaderLabels(headers);
+
+    headers.clear();
+    headers << tr("Class") << tr("Errors");
+    ui->tableClasses->setColumnCount(headers.count());
+    ui->tableClasses->setHorizontalHeaderLabels(headers);
+    ui->tableClasses->setRowCount(ERRORSTATS_CLASSES);
+    for (int c = 0; c < ERRORSTATS_CLASSES; c++) Utility::setTableCell(ui->tableClasses, c, 0, ErrorStats::className(c));
+
+    headers.clear();
+    headers << tr("ID") << tr("Frames") << tr("Errors Right After") << tr("Errors Within 2ms") << tr("Lift");
+    ui->tableSuspects->setColumnCount(headers.count());
+    ui->tableSuspects->setHorizontalHeaderLabels(headers);
+
+    ui->graphErrors->xAxis->setLabel(tr("Time (s)"));
+    ui->graphErrors->yAxis->setLabel(tr("Errors / s"));
+    ui->graphErrors->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+    ui->graphErrors->legend->setVisible(true);
+    OffscreenPlot::setup(ui->graphErrors);
+
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(ERRORSTATS_REFRESH_MS);
+    connect(&refreshTimer, &QTimer::timeout, this, &ErrorStatsWindow::refresh);
+    connect(store, &ErrorStatsStore::updated, this, &ErrorStatsWindow::statsUpdated);
+    connect(ui->tableBuses, &QTableWidget::itemSelectionChanged, this, &ErrorStatsWindow::busSelected);
+}
+
+ErrorStatsWindow::~ErrorStatsWindow()
+{
+    delete ui;
+}
+
+void ErrorStatsWindow::reportMemory(QVector<MemoryUsage> &out) const
+{
+    qint64 points = 0;
+    for (int i = 0; i < ui->graphErrors->graphCount(); i++) points += ui->graphErrors->graph(i)->data()->size();
+    out.append({memoryOwner("Bus Error Window"), "graph points", points * static_cast<qint64>(sizeof(QCPGraphData))});
+}
+
+void ErrorStatsWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+
+    readSettings();
+
+    store->sync();
+    refresh();
+
+    installEventFilter(this);
+}
+
+void ErrorStatsWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool ErrorStatsWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("errorstats.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void ErrorStatsWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("ErrorStatsView/WindowSize", QSize(900, 750)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("ErrorStatsView/WindowPos", QPoint(50, 50)).toPoint()));
+    }
+}
+
+void ErrorStatsWindow::writeSettings()
+{
+    QSettings settings;
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("ErrorStatsView/WindowSize", size());
+        settings.setValue("ErrorStatsView/WindowPos", pos());
+    }
+}
+
+//the store updates on every framesUpdated, the window only every ERRORSTATS_REFRESH_MS
+void ErrorStatsWindow::statsUpdated()
+{
+    if (!isVisible()) return;
+    if (!refreshTimer.isActive()) refreshTimer.start();
+}
+
+void ErrorStatsWindow::refresh()
+{
+    showBuses();
+    showPlot();
+    showDetails();
+}
+
+void ErrorStatsWindow::busSelected()
+{
+    QList<QTableWidgetItem *> items = ui->tableBuses->selectedItems();
+    if (items.isEmpty()) return;
+    QTableWidgetItem *busItem = ui->tableBuses->item(items.first()->row(), 0);
+    if (!busItem) return;
+    selectedBus = busItem->text().toInt();
+    showDetails();
+}
+
+void ErrorStatsWindow::showBuses()
+{
+    QVector<const BusErrorStats *> buses = store->stats().all();
+    ui->tableBuses->blockSignals(true);
+    ui->tableBuses->setRowCount(buses.count());
+    for (int i = 0; i < buses.count(); i++)
+    {
+        const BusErrorStats *bus = buses.at(i);
+        double perThousand = bus->frames ? (1000.0 * static_cast<double>(bus->errors) / static_cast<double>(bus->frames)) : 0.0;
+        QStringList cells;
+        cells << QString::number(bus->bus) << QString::number(bus->frames) << QString::number(bus->errors)
+              << QString::number(perThousand, 'f', 2) << ErrorStats::stateName(bus->state)
+              << counterText(bus->txErrorCounter, bus->maxTxErrorCounter)
+              << counterText(bus->rxErrorCounter, bus->maxRxErrorCounter)
+              << QString("%1 / %2 / %3").arg(bus->stateEntered[static_cast<int>(ErrorBusState::Warning)])
+                                        .arg(bus->stateEntered[static_cast<int>(ErrorBusState::Passive)])
+                                        .arg(bus->stateEntered[static_cast<int>(ErrorBusState::BusOff)]);
+        for (int c = 0; c < cells.count(); c++) Utility::setTableCell(ui->tableBuses, i, c, cells.at(c));
+        if (bus->bus == selectedBus) ui->tableBuses->selectRow(i);
+    }
+    //nothing picked yet, the first bus with errors is the likely one
+    if (selectedBus < 0)
+    {
+        for (int i = 0; i < buses.count(); i++)
+        {
+            if (buses.at(i)->errors > 0 || i == buses.count() - 1)
+            {
+                selectedBus = buses.at(i)->bus;
+                ui->tableBuses->selectRow(i);
+                break;
+            }
+        }
+    }
+    ui->tableBuses->blockSignals(false);
+}
+
+//errors per second in every bucket, one graph per bus that had any
+void ErrorStatsWindow::showPlot()
+{
+    static const QColor busColors[] = {Qt::red, Qt::blue, Qt::darkGreen, Qt::magenta, Qt::darkYellow, Qt::darkCyan, Qt::black, Qt::gray};
+    const int numColors = sizeof(busColors) / sizeof(busColors[0]);
+
+    ui->graphErrors->clearGraphs();
+    QVector<const BusErrorStats *> buses = store->stats().all();
+    double maxRate = 0.0;
+    double maxTime = 0.0;
+    for (const BusErrorStats *bus : buses)
+    {
+        if (bus->errors == 0) continue;
+        const double width = static_cast<double>(bus->bucketWidth) / 1000000.0;
+        QVector<double> x(bus->buckets.count());
+        QVector<double> y(bus->buckets.count());
+        for (int i = 0; i < bus->buckets.count(); i++)
+        {
+            x[i] = i * width;
+            y[i] = bus->buckets[i].errors / width;
+            maxRate = std::max(maxRate, y[i]);
+        }
+        maxTime = std::max(maxTime, bus->buckets.count() * width);
+        QCPGraph *graph = ui->graphErrors->addGraph();
+        graph->setName(tr("Bus %1").arg(bus->bus));
+        graph->setPen(QPen(busColors[bus->bus % numColors]));
+        graph->setLineStyle(QCPGraph::lsStepLeft);
+        graph->setData(x, y, true);
+    }
+    ui->graphErrors->xAxis->setRange(0, (maxTime > 0.0) ? maxTime : 1.0);
+    ui->graphErrors->yAxis->setRange(0, (maxRate > 0.0) ? maxRate * 1.1 : 1.0);
+    ui->graphErrors->replot();
+}
+
+void ErrorStatsWindow::showDetails()
+{
+    const BusErrorStats *bus = store->stats().find(selectedBus);
+    for (int c = 0; c < ERRORSTATS_CLASSES; c++) Utility::setTableCell(ui->tableClasses, c, 1, bus ? QString::number(bus->classCounts[c]) : QString());
+    if (!bus)
+    {
+        ui->tableSuspects->setRowCount(0);
+        return;
+    }
+    ui->labelClasses->setText(tr("Error Classes on Bus %1:").arg(bus->bus));
+    ui->labelSuspects->setText(tr("IDs Sent Right Before Errors on Bus %1:").arg(bus->bus));
+
+    QVector<QPair<uint32_t, const ErrorSuspect *>> ranked = bus->rankedSuspects();
+    int rows = std::min(static_cast<int>(ranked.count()), ERRORSTATS_MAX_SUSPECTS);
+    ui->tableSuspects->setRowCount(rows);
+    for (int i = 0; i < rows; i++)
+    {
+        const uint32_t id = ranked.at(i).first;
+        const ErrorSuspect *suspect = ranked.at(i).second;
+        QStringList cells;
+        cells << Utility::formatCANID(id & CANFrameRecord::ID_MASK, (id & CANFrameRecord::EXTENDED_BIT) != 0) << QString::number(suspect->frames)
+              << QString::number(suspect->lastBefore) << QString::number(suspect->nearBefore)
+              << QString::number(bus->lift(*suspect), 'f', 2);
+        for (int c = 0; c < cells.count(); c++) Utility::setTableCell(ui->tableSuspects, i, c, cells.at(c));
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef ERRORSTATSWINDOW_H
+#define ERRORSTATSWINDOW_H
+
+#include <QDialog>
+#include <QTimer>
+#include "canframestore.h"
+#include "memoryaccounting.h"
+
+namespace Ui {
+class ErrorStatsWindow;
+}
+
+class ErrorStatsStore;
+
+/*
+ * Shows what ErrorStatsStore keeps for every bus: frame and error counts, the controller state and error
+ * counters as the error frames report them, errors over time, the error classes and which IDs were on the bus
+ * right before the errors. Nothing here walks the frames, it just shows the counters, so it can stay open during
+ * a busy capture. The tables are redrawn at most once per ERRORSTATS_REFRESH_MS.
+ */
+class ErrorStatsWindow : public QDialog, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    explicit ErrorStatsWindow(const CANFrameStore *frames, QWidget *parent = 0);
+    ~ErrorStatsWindow();
+    void showEvent(QShowEvent*);
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+
+private slots:
+    void statsUpdated();
+    void refresh();
+    void busSelected();
+
+private:
+    Ui::ErrorStatsWindow *ui;
+    ErrorStatsStore *store;
+    QTimer refreshTimer;
+    int selectedBus; //-1 until one is picked, then the row that was
+
+    void showBuses();
+    void showPlot();
+    void showDetails();
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // ERRORSTATSWINDOW_H
@@ -1,9 +1,16 @@
 #include "filecomparatorwindow.h"
 #include "ui_filecomparatorwindow.h"
 #include "helpwindow.h"
+#include "mainwindow.h"
 #include <QProgressDialog>
 #include <QSettings>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
 #include <qevent.h>
+#include <memory>
+#include <vector>
 
 FileComparatorWindow::FileComparatorWindow(QWidget *parent) :
     QDialog(parent),
@@ -16,11 +23,20 @@ FileComparatorWindow::FileComparatorWindow(QWidget *parent) :
     connect(ui->btnLoadRefFile, SIGNAL(clicked(bool)), this, SLOT(loadReferenceFile()));
     connect(ui->btnSaveDetails, SIGNAL(clicked(bool)), this, SLOT(saveDetails()));
     connect(ui->btnClear, SIGNAL(clicked(bool)), this, SLOT(clearReference()));
+    connect(ui->treeDetails, &QTreeWidget::itemExpanded, this, &FileComparatorWindow::detailsExpanded);
+    connect(ui->btnLive, &QPushButton::toggled, this, &FileComparatorWindow::toggleLive);
 
     ui->lblFirstFile->setText("");
     ui->lblRefFrames->setText("Loaded frames: 0");
 
     dbcHandler = DBCHandler::getReference();
+    interestedFrameCount = 0;
+    referenceFrameCount = 0;
+    referenceFileCount = 0;
+    treeUniqueInterested = false;
+    interestedOnlyBase = referenceOnlyBase = sharedBase = nullptr;
+    liveSubscription = 0;
+    liveHighlight = false;
 
     installEventFilter(this);
 }
@@ -83,428 +99,494 @@ void FileComparatorWindow::writeSettings()
 
 void FileComparatorWindow::loadInterestedFile()
 {
-    interestedFrames.clear();
+    QVector<QVector<CANFrame>> frames(1);
     QString resultingFileName;
 
     qApp->processEvents();
 
-    if (FrameFileIO::loadFrameFile(resultingFileName, &interestedFrames))
+    if (FrameFileIO::loadFrameFile(resultingFileName, &frames[0]))
     {
+        ui->btnLive->setChecked(false); //a file takes side 1 over from the live capture
+        liveFresh.clear();
         ui->lblFirstFile->setText(resultingFileName);
         interestedFilename = resultingFileName;
-        if (interestedFrames.count() > 0 && referenceFrames.count() > 0) calculateDetails();
+        interestedIDs.clear();
+        interestedFrameCount = frames[0].count();
+        digestFrames(frames, interestedIDs);
+        if (interestedFrameCount > 0 && referenceFrameCount > 0) calculateDetails();
     }
 
 }
 
 void FileComparatorWindow::loadReferenceFile()
 {
-    //secondFileFrames.clear();
-    QString resultingFileName;
+    //every file loaded goes into the same reference bucket, on top of whatever was loaded before
+    QVector<QVector<CANFrame>> frameSets;
+    QStringList resultingFileNames;
 
     qApp->processEvents();
 
-    if (FrameFileIO::loadFrameFile(resultingFileName, &referenceFrames))
+    if (FrameFileIO::loadFrameFiles(resultingFileNames, &frameSets))
     {
-        ui->lblRefFrames->setText("Loaded frames: " + QString::number(referenceFrames.length()));
-        if (interestedFrames.count() > 0 && referenceFrames.count() > 0) calculateDetails();
+        for (int i = 0; i < frameSets.count(); i++) referenceFrameCount += frameSets[i].count();
+        referenceFileCount += frameSets.count();
+        digestFrames(frameSets, referenceIDs);
+        updateReferenceLabel();
+        if ((interestedFrameCount > 0 || liveSubscription) && referenceFrameCount > 0) calculateDetails();
     }
 }
 
 void FileComparatorWindow::clearReference()
 {
-    referenceFrames.clear();
+    referenceIDs.clear();
+    referenceFrameCount = 0;
+    referenceFileCount = 0;
     ui->treeDetails->clear();
-    ui->lblRefFrames->setText("Loaded frames: " + QString::number(referenceFrames.length()));
+    interestedOnlyBase = referenceOnlyBase = sharedBase = nullptr;
+    idItems.clear();
+    updateReferenceLabel();
 }
 
-void FileComparatorWindow::calculateDetails()
+void FileComparatorWindow::updateReferenceLabel()
 {
-    QMap<uint32_t, FrameData> interestedIDs;
-    QMap<uint32_t, FrameData> referenceIDs;
-    QTreeWidgetItem *interestedOnlyBase, *referenceOnlyBase = nullptr, *sharedBase, *bitmapBaseInterested, *bitmapBaseReference = nullptr;
-    QTreeWidgetItem *valuesBase, *detail, *sharedItem, *valuesInterested, *valuesReference = nullptr;
-    uint64_t tmp;
-    const unsigned char *data;
-    int dataLen;
-
-    bool uniqueInterested = ui->ckUniqueToInterested->isChecked();
+    QString text = "Loaded frames: " + QString::number(referenceFrameCount);
+    if (referenceFileCount > 1) text += " from " + QString::number(referenceFileCount) + " files";
+    ui->lblRefFrames->setText(text);
+}
 
-    QProgressDialog progress(this);
-    progress.setWindowModality(Qt::WindowModal);
-    progress.setLabelText("Calculating differences");
-    progress.setCancelButton(nullptr);
-    progress.setRange(0,0);
-    progress.setMinimumDuration(0);
-    progress.show();
+/*
+ * Side 1 follows the frame list. What it already holds is the starting point, anything that turns up after that
+ * goes straight into the summary and into the tree, highlighted, with nothing worked out again from scratch.
+ */
+void FileComparatorWindow::toggleLive(bool live)
+{
+    FrameBus *bus = MainWindow::getReference()->getFrameBus();
+    if (!live)
+    {
+        if (liveSubscription) bus->unsubscribe(liveSubscription);
+        liveSubscription = 0;
+        updateLiveLabel();
+        return;
+    }
 
-    qApp->processEvents();
+    interestedFilename = tr("live capture");
+    interestedIDs.clear();
+    interestedFrameCount = 0;
+    liveFresh.clear();
+    liveMessages.clear();
+    liveHighlight = false;
+    liveSubscription = bus->subscribe(this, FrameBus::Options(),
+        [this](const QVector<CANFrame> &frames) { gotLiveFrames(frames); },
+        [this](FrameBus::ResetReason) { liveReset(); });
+    if (referenceFrameCount > 0) calculateDetails();
+    bus->replay(liveSubscription);
+    liveHighlight = true;
+    updateLiveLabel();
+}
 
-    ui->treeDetails->clear();
+//the frame list was cleared or replaced. Whatever it holds now comes through next and is the new starting point
+void FileComparatorWindow::liveReset()
+{
+    interestedIDs.clear();
+    interestedFrameCount = 0;
+    liveFresh.clear();
+    liveMessages.clear();
+    liveHighlight = false;
+    if (referenceFrameCount > 0) calculateDetails();
+    //the bus hands the frames over before returning to the event loop
+    QTimer::singleShot(0, this, [this]() { liveHighlight = true; });
+    updateLiveLabel();
+}
 
-    interestedOnlyBase = new QTreeWidgetItem();
-    interestedOnlyBase->setText(0,"IDs found only in " + interestedFilename);
-    if (!uniqueInterested)
+void FileComparatorWindow::gotLiveFrames(const QVector<CANFrame> &frames)
+{
+    QSet<uint32_t> changed;
+    for (const CANFrame &frame : frames)
     {
-        referenceOnlyBase = new QTreeWidgetItem();
-        referenceOnlyBase->setText(0, "IDs found only in Side 2 - Reference frames");
+        uint32_t id = frame.frameId();
+        FrameData &idData = interestedIDs[id];
+        idData.ID = id;
+        if (digestLiveFrame(frame, idData, liveHighlight ? &liveFresh[id] : nullptr)) changed.insert(id);
     }
-    sharedBase = new QTreeWidgetItem();
-    sharedBase->setText(0,"IDs found on both sides");
+    interestedFrameCount += frames.count();
+    updateLiveLabel();
 
-    //first we have to fill out the data structures to get ready to do the report
-    for (int x = 0; x < interestedFrames.count(); x++)
-    {
-        CANFrame frame = interestedFrames.at(x);
-        DBC_MESSAGE *msg = dbcHandler->findMessage(frame.frameId());
-        data = reinterpret_cast<const unsigned char *>(frame.payload().constData());
-        dataLen = frame.payload().count();
+    if (!sharedBase) return; //no tree until there's a reference to compare with
+    for (uint32_t id : qAsConst(changed)) updateLiveItem(id);
+}
 
-        if (interestedIDs.contains(frame.frameId())) //if we saw this ID before then add to the QList in there
+//the same as DigestTask does but one frame at a time. True if the frame showed anything the summary didn't have
+bool FileComparatorWindow::digestLiveFrame(const CANFrame &frame, FrameData &idData, FrameData *fresh)
+{
+    bool gained = false;
+    if (fresh) fresh->dataLen = idData.dataLen; //so the bytes it covers are the ones looked at
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(frame.payload().constData());
+    int dataLen = qMin(static_cast<int>(frame.payload().count()), FILECOMPARE_BYTES);
+    if (dataLen > idData.dataLen)
+    {
+        idData.dataLen = dataLen;
+        if (fresh) fresh->dataLen = dataLen;
+        gained = true;
+    }
+    for (int y = 0; y < dataLen; y++)
+    {
+        uint64_t valueBit = 1ull << (data[y] & 63);
+        uint64_t &values = idData.values[y][data[y] >> 6];
+        if (!(values & valueBit))
         {
-            for (int y = 0; y < dataLen; y++)
-            {
-                interestedIDs[frame.frameId()].values[y][data[y]]++;
-                tmp = data[y];
-                tmp = tmp << (8 * y);
-                interestedIDs[frame.frameId()].bitmap |= tmp;
-                //qDebug() << "bitmap: " << QString::number(interestedIDs[frame.frameId()].bitmap, 16);
-            }            
-            if (msg)
-            {
-                int numSignals = msg->sigHandler->getCount();
-                for (int i = 0; i < numSignals; i++)
-                {
-                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
-                    if (sig)
-                    {
-                        if (sig->isSignalInMessage(frame))
-                        {
-                            QString sigVal;
-                            if (sig->processAsText(frame, sigVal, false))
-                            {
-                                QList<QString> tempList = interestedIDs[frame.frameId()].signalInstances[sig->name];
-                                if (!tempList.contains(sigVal)) tempList.append(sigVal);
-                                interestedIDs[frame.frameId()].signalInstances[sig->name] = tempList;
-                            }
-                        }
-                    }
-                }
-                qApp->processEvents();
-            }
+            values |= valueBit;
+            if (fresh) fresh->values[y][data[y] >> 6] |= valueBit;
+            gained = true;
         }
-        else //never seen this ID before so add one
+        uint64_t newBits = (static_cast<uint64_t>(data[y]) << (8 * (y & 7))) & ~idData.bitmap[y >> 3];
+        if (newBits)
         {
-            FrameData *newData = new FrameData();
-            newData->ID = frame.frameId();
-            newData->dataLen = dataLen;
-            //it would be possible to implement a constructor for FrameData
-            //that sets the bitmap and values to zero. That would be cleaner and better.
-            newData->bitmap = 0;
-            for (int x = 0; x < 8; x++)
-            {
-                for (int y = 0; y < 256; y++)
-                {
-                    newData->values[x][y] = 0;
-                }
-            }
-            //memset(newData->values, 0, 256 * 8);
-            for (int y = 0; y < dataLen; y++)
-            {
-                newData->values[y][data[y]] = 1;
-                tmp = data[y];
-                tmp = tmp << (8 * y);
-                newData->bitmap |= tmp;
-                //qDebug() << "bitmap: " << QString::number(newData->bitmap, 16);
-            }
-            if (msg)
-            {
-                int numSignals = msg->sigHandler->getCount();
-                for (int i = 0; i < numSignals; i++)
-                {
-                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
-                    if (sig)
-                    {
-                        if (sig->isSignalInMessage(frame))
-                        {
-                            QString sigVal;
-                            if (sig->processAsText(frame, sigVal, false))
-                            {
-                                QList<QString> tempList;
-                                tempList.append(sigVal);
-                                newData->signalInstances[sig->name] = tempList;
-                            }
-                        }
-                    }
-                }
-            }
-
-            interestedIDs.insert(frame.frameId(), *newData);
+            idData.bitmap[y >> 3] |= newBits;
+            if (fresh) fresh->bitmap[y >> 3] |= newBits;
+            gained = true;
         }
     }
 
-    qApp->processEvents();
+    QHash<uint32_t, DBC_MESSAGE *>::const_iterator known = liveMessages.constFind(frame.frameId());
+    if (known == liveMessages.constEnd()) known = liveMessages.insert(frame.frameId(), dbcHandler->findMessage(frame.frameId()));
+    DBC_MESSAGE *msg = known.value();
+    if (!msg) return gained;
+    QString sigVal;
+    int numSignals = msg->sigHandler->getCount();
+    for (int s = 0; s < numSignals; s++)
+    {
+        DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(s);
+        if (!sig || !sig->isSignalInMessage(frame)) continue;
+        sigVal.clear();
+        if (!sig->decodeText(frame, sigVal, false)) continue;
+        QSet<QString> &instances = idData.signalInstances[sig->name];
+        if (instances.contains(sigVal)) continue;
+        instances.insert(sigVal);
+        if (fresh) fresh->signalInstances[sig->name].insert(sigVal);
+        gained = true;
+    }
+    return gained;
+}
 
-    for (int x = 0; x < referenceFrames.count(); x++)
+//puts one ID that gained something where it belongs in the tree now, the way calculateDetails would have
+void FileComparatorWindow::updateLiveItem(uint32_t id)
+{
+    QHash<uint32_t, FrameData>::const_iterator freshIt = liveFresh.constFind(id);
+    const FrameData *fresh = (freshIt != liveFresh.constEnd()) ? &freshIt.value() : nullptr;
+    QTreeWidgetItem *item = idItems.value(id, nullptr);
+
+    QMap<uint32_t, FrameData>::const_iterator ref = referenceIDs.constFind(id);
+    if (ref == referenceIDs.constEnd())
     {
-        CANFrame frame = referenceFrames.at(x);
-        DBC_MESSAGE *msg = dbcHandler->findMessage(frame.frameId());
-        data = reinterpret_cast<const unsigned char *>(frame.payload().constData());
-        dataLen = frame.payload().count();
+        if (item) return; //nothing is listed under these
+        item = new QTreeWidgetItem();
+        item->setText(0, idLabel(id));
+        if (fresh) item->setForeground(0, QBrush(Qt::darkGreen));
+        interestedOnlyBase->addChild(item);
+        idItems.insert(id, item);
+        return;
+    }
 
-        if (referenceIDs.contains(frame.frameId())) //if we saw this ID before then add to the QList in there
+    if (item && item->parent() == referenceOnlyBase)
+    {
+        delete item; //not only in the reference any longer
+        item = nullptr;
+        idItems.remove(id);
+    }
+    if (treeUniqueInterested && !interestedIDs[id].hasUniqueAgainst(ref.value())) return;
+
+    if (!item)
+    {
+        item = new QTreeWidgetItem();
+        item->setText(0, idLabel(id));
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+        sharedBase->addChild(item);
+        idItems.insert(id, item);
+    }
+    else if (!item->data(0, Qt::UserRole).isValid())
+    {
+        //already filled in, so it's filled in again. Right away if it's open
+        qDeleteAll(item->takeChildren());
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    }
+    item->setData(0, Qt::UserRole, id);
+    if (item->isExpanded()) detailsExpanded(item);
+    if (fresh && fresh->hasUniqueAgainst(ref.value())) item->setForeground(0, QBrush(Qt::darkGreen));
+}
+
+void FileComparatorWindow::updateLiveLabel()
+{
+    QString text = tr("Live capture: %1 frames").arg(interestedFrameCount);
+    if (!liveSubscription) text += tr(" (stopped)");
+    ui->lblFirstFile->setText(text);
+}
+
+bool FrameData::hasUniqueAgainst(const FrameData &other) const
+{
+    for (int w = 0; w < FILECOMPARE_BYTES / 8; w++)
+    {
+        if (bitmap[w] & ~other.bitmap[w]) return true;
+    }
+    for (int b = 0; b < qMax(dataLen, other.dataLen); b++)
+    {
+        for (int w = 0; w < 4; w++)
         {
-            for (int y = 0; y < dataLen; y++)
-            {
-                referenceIDs[frame.frameId()].values[y][data[y]]++;
-                tmp = data[y];
-                tmp = tmp << (8 * y);
-                referenceIDs[frame.frameId()].bitmap |= tmp;
-                //qDebug() << "bitmap: " << QString::number(referenceIDs[frame.frameId()].bitmap, 16);
-            }
-            if (msg)
-            {
-                int numSignals = msg->sigHandler->getCount();
-                for (int i = 0; i < numSignals; i++)
-                {
-                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
-                    if (sig)
-                    {
-                        if (sig->isSignalInMessage(frame))
-                        {
-                            QString sigVal;
-                            if (sig->processAsText(frame, sigVal, false))
-                            {
-                                QList<QString> tempList = referenceIDs[frame.frameId()].signalInstances[sig->name];
-                                if (!tempList.contains(sigVal)) tempList.append(sigVal);
-                                referenceIDs[frame.frameId()].signalInstances[sig->name] = tempList;
-                            }
-                        }
-                    }
-                }
-            }
+            if (values[b][w] & ~other.values[b][w]) return true;
         }
-        else //never seen this ID before so add one
+    }
+    return false;
+}
+
+void FrameData::merge(const FrameData &other)
+{
+    ID = other.ID;
+    dataLen = qMax(dataLen, other.dataLen);
+    for (int w = 0; w < FILECOMPARE_BYTES / 8; w++) bitmap[w] |= other.bitmap[w];
+    for (int b = 0; b < FILECOMPARE_BYTES; b++)
+    {
+        for (int w = 0; w < 4; w++) values[b][w] |= other.values[b][w];
+    }
+    QHash<QString, QSet<QString>>::const_iterator it;
+    for (it = other.signalInstances.constBegin(); it != other.signalInstances.constEnd(); ++it)
+    {
+        signalInstances[it.key()].unite(it.value());
+    }
+}
+
+namespace
+{
+/*
+ * Boils one slice of one file down to per ID FrameData. The first run does the bits and byte values. Once the
+ * window has looked up which IDs have a DBC message it sets messages and runs it again for the signal values.
+ * That way the DBC lookups (which aren't thread safe) stay on the GUI thread and the decoding, which is, doesn't.
+ */
+class DigestTask : public QRunnable
+{
+public:
+    DigestTask(const QVector<CANFrame> *frames, int from, int to, QAtomicInt *done)
+        : frames(frames), from(from), to(to), done(done)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        if (messages) digestSignals();
+        else digestBits();
+    }
+
+    const QHash<uint32_t, DBC_MESSAGE *> *messages = nullptr;
+    QHash<uint32_t, FrameData> result;
+
+private:
+    void digestBits()
+    {
+        FrameData *idData = nullptr;
+        uint32_t lastID = 0;
+        for (int i = from; i < to; i++)
         {
-            FrameData *newData = new FrameData();
-            newData->ID = frame.frameId();
-            newData->dataLen = dataLen;
-            newData->bitmap = 0;
-            for (int x = 0; x < 8; x++)
+            const CANFrame &frame = frames->at(i);
+            //frames of one ID tend to come in bunches, skip the hash lookup for those
+            if (!idData || frame.frameId() != lastID)
             {
-                for (int y = 0; y < 256; y++)
-                {
-                    newData->values[x][y] = 0;
-                }
+                lastID = frame.frameId();
+                idData = &result[lastID];
+                idData->ID = lastID;
             }
-            //memset(newData->values, 0, 256 * 8);
+            const unsigned char *data = reinterpret_cast<const unsigned char *>(frame.payload().constData());
+            int dataLen = qMin(static_cast<int>(frame.payload().count()), FILECOMPARE_BYTES);
+            if (dataLen > idData->dataLen) idData->dataLen = dataLen;
             for (int y = 0; y < dataLen; y++)
             {
-                newData->values[y][data[y]] = 1;
-                tmp = data[y];
-                tmp = tmp << (8 * y);
-                newData->bitmap |= tmp;
-                //qDebug() << "bitmap: " << QString::number(newData->bitmap, 16);
+                idData->values[y][data[y] >> 6] |= 1ull << (data[y] & 63);
+                idData->bitmap[y >> 3] |= static_cast<uint64_t>(data[y]) << (8 * (y & 7));
             }
-            if (msg)
+            if (((i - from) & 0xFFF) == 0xFFF) done->fetchAndAddRelaxed(0x1000);
+        }
+        done->fetchAndAddRelaxed((to - from) & 0xFFF);
+    }
+
+    void digestSignals()
+    {
+        QString sigVal;
+        for (int i = from; i < to; i++)
+        {
+            const CANFrame &frame = frames->at(i);
+            DBC_MESSAGE *msg = messages->value(frame.frameId(), nullptr);
+            if (!msg) continue;
+            QHash<QString, QSet<QString>> &instances = result[frame.frameId()].signalInstances;
+            int numSignals = msg->sigHandler->getCount();
+            for (int s = 0; s < numSignals; s++)
             {
-                int numSignals = msg->sigHandler->getCount();
-                for (int i = 0; i < numSignals; i++)
+                DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(s);
+                if (sig && sig->isSignalInMessage(frame))
                 {
-                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
-                    if (sig)
-                    {
-                        if (sig->isSignalInMessage(frame))
-                        {
-                            QString sigVal;
-                            if (sig->processAsText(frame, sigVal, false))
-                            {
-                                QList<QString> tempList;
-                                tempList.append(sigVal);
-                                newData->signalInstances[sig->name] = tempList;
-                            }
-                        }
-                    }
+                    sigVal.clear();
+                    if (sig->decodeText(frame, sigVal, false)) instances[sig->name].insert(sigVal);
                 }
             }
-            referenceIDs.insert(frame.frameId(), *newData);
+            if (((i - from) & 0xFFF) == 0xFFF) done->fetchAndAddRelaxed(0x1000);
         }
+        done->fetchAndAddRelaxed((to - from) & 0xFFF);
     }
 
-    qApp->processEvents();
+    const QVector<CANFrame> *frames;
+    int from, to;
+    QAtomicInt *done;
+};
+}
 
-    //now we iterate through the IDs within both files and see which are unique to one file and which
-    //are shared
-    bool interestedHadUnique = false;
-    QMap<uint32_t, FrameData>::iterator i;
-    int framesCounter = 0;
-    for (i = interestedIDs.begin(); i != interestedIDs.end(); ++i)
+/*
+ * Works out the FrameData of every ID in the given files on the thread pool and merges it into into. The files
+ * are cut into chunks so one big file and lots of little ones both keep every thread busy.
+ */
+bool FileComparatorWindow::digestFrames(const QVector<QVector<CANFrame>> &frameSets, QMap<uint32_t, FrameData> &into)
+{
+    QAtomicInt done(0);
+    std::vector<std::unique_ptr<DigestTask>> tasks;
+    int totalFrames = 0;
+    for (int f = 0; f < frameSets.count(); f++)
     {
-        framesCounter++;
-        if (framesCounter > 50)
+        const QVector<CANFrame> &frames = frameSets[f];
+        for (int from = 0; from < frames.count(); from += FILECOMPARE_CHUNK_FRAMES)
         {
-            framesCounter = 0;
-            qApp->processEvents();
+            tasks.emplace_back(new DigestTask(&frames, from, qMin(from + FILECOMPARE_CHUNK_FRAMES, frames.count()), &done));
         }
+        totalFrames += frames.count();
+    }
+    if (tasks.empty()) return false;
 
-        uint32_t keyone = i.key();
-        if (!referenceIDs.contains(keyone))
+    QProgressDialog progress(this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setLabelText("Summarizing frames");
+    progress.setCancelButton(nullptr);
+    progress.setRange(0, 1000);
+    progress.setMinimumDuration(0);
+    progress.show();
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+
+    auto runAll = [&](int pass)
+    {
+        done.storeRelaxed(0);
+        for (auto &task : tasks) pool.start(task.get());
+        while (!pool.waitForDone(50))
         {
-            valuesBase = new QTreeWidgetItem();
-            DBC_MESSAGE *msg = dbcHandler->findMessage(keyone);
-            if (msg)
-            {
-                valuesBase->setText(0, Utility::formatHexNum(keyone) + " (" + msg->name + ")");
-            }
-            else valuesBase->setText(0, Utility::formatHexNum(keyone));
-            interestedOnlyBase->addChild(valuesBase);
+            qint64 permille = static_cast<qint64>(done.loadRelaxed()) * 500 / qMax(totalFrames, 1);
+            progress.setValue(static_cast<int>(pass * 500 + permille));
+            qApp->processEvents();
         }
-        else //ID was in both files
+    };
+
+    runAll(0);
+
+    //look up the DBC message of every ID seen, here on the GUI thread. Only IDs that have one need the signal pass
+    QHash<uint32_t, DBC_MESSAGE *> messages;
+    for (auto &task : tasks)
+    {
+        QHash<uint32_t, FrameData>::const_iterator it;
+        for (it = task->result.constBegin(); it != task->result.constEnd(); ++it)
         {
-            interestedHadUnique = false;
-            sharedItem = new QTreeWidgetItem();
-            DBC_MESSAGE *msg = dbcHandler->findMessage(keyone);
-            if (msg)
-            {
-                sharedItem->setText(0, Utility::formatHexNum(keyone) + " (" + msg->name + ")");
-            }
-            else sharedItem->setText(0, Utility::formatHexNum(keyone));
-            //if the ID was in both files then we can use the data accumulated above in bitmap
-            //and values to figure out what has changed between the two files
+            if (messages.contains(it.key())) continue;
+            messages.insert(it.key(), dbcHandler->findMessage(it.key()));
+        }
+    }
+    bool anyMessages = false;
+    for (DBC_MESSAGE *msg : qAsConst(messages))
+    {
+        if (msg) anyMessages = true;
+    }
 
-            FrameData interested = interestedIDs[keyone];
-            FrameData reference = referenceIDs[keyone];
+    if (anyMessages)
+    {
+        progress.setLabelText("Decoding signals");
+        for (auto &task : tasks) task->messages = &messages;
+        runAll(1);
+    }
 
-            bitmapBaseInterested = new QTreeWidgetItem();
-            bitmapBaseInterested->setText(0, "Bits set only in " + interestedFilename);
-            if (!uniqueInterested)
-            {
-                bitmapBaseReference = new QTreeWidgetItem();
-                bitmapBaseReference->setText(0, "Bits set only in Side 2 - Reference frames");
-            }
-            sharedItem->addChild(bitmapBaseInterested);
-            if (!uniqueInterested) sharedItem->addChild(bitmapBaseReference);
+    for (auto &task : tasks)
+    {
+        QHash<uint32_t, FrameData>::const_iterator it;
+        for (it = task->result.constBegin(); it != task->result.constEnd(); ++it) into[it.key()].merge(it.value());
+        task->result.clear();
+    }
 
-            uint64_t interestedBits = interested.bitmap;
-            uint64_t referenceBits = reference.bitmap;
+    progress.cancel();
+    return true;
+}
 
-            //first up, which bits were set in one file but not the other
-            for (int b = 0; b < (8 * interested.dataLen); b++)
-            {
-                detail = new QTreeWidgetItem();
-                detail->setText(0, QString::number(b) + " (" + QString::number(b / 8) + ":" + QString::number(b % 8) + ")");
-                if ( (interestedBits & 1) && !(referenceBits & 1) )
-                {
-                    bitmapBaseInterested->addChild(detail);
-                    interestedHadUnique = true;
-                }
-                else if ( !(interestedBits & 1) && (referenceBits & 1) )
-                {
-                    if (!uniqueInterested) bitmapBaseReference->addChild(detail);
-                }
-                //qDebug() << b << "  " << QString::number(interestedBits, 16) << "  " << QString::number(referenceBits, 16);
-                interestedBits = interestedBits >> 1;
-                referenceBits = referenceBits >> 1;
-            }
+/*
+ * Builds the tree from the two summaries. The top levels and the shared ID nodes all get made up front (that's
+ * where hiding IDs with nothing unique to the file of interest gets decided) but the bits, bytes and signals
+ * under a shared ID only get made when it's expanded the first time. A big corpus has thousands of those.
+ */
+void FileComparatorWindow::calculateDetails()
+{
+    QTreeWidgetItem *valuesBase, *sharedItem;
 
-            for (int i = 0; i < qMax(interested.dataLen, reference.dataLen); i++)
-            {
-                valuesBase = new QTreeWidgetItem();
-                valuesBase->setText(0, "Byte " + QString::number(i));
-                sharedItem->addChild(valuesBase);
-                valuesInterested = new QTreeWidgetItem();
-                valuesInterested->setText(0, "Values found only in " + interestedFilename);
-                if (!uniqueInterested)
-                {
-                    valuesReference = new QTreeWidgetItem();
-                    valuesReference->setText(0, "Values found only in Side 2 - Reference frames");
-                }
-                valuesBase->addChild(valuesInterested);
-                if (!uniqueInterested) valuesBase->addChild(valuesReference);
-                for (int j = 0; j < 256; j++)
-                {
-                    detail = new QTreeWidgetItem();
-                    detail->setText(0, Utility::formatHexNum(static_cast<unsigned int>(j)));
-                    if ((interested.values[i][j] > 0) && (reference.values[i][j] == 0) )
-                    {
-                        valuesInterested->addChild(detail);
-                        interestedHadUnique = true;
-                    }
-                    if ((reference.values[i][j] > 0) && (interested.values[i][j] == 0) )
-                    {
-                        if (!uniqueInterested) valuesReference->addChild(detail);
-                    }
-                }
-            }
+    bool uniqueInterested = ui->ckUniqueToInterested->isChecked();
+    treeUniqueInterested = uniqueInterested; //the nodes filled in later have to match what's built here
 
-            //presumably both include the same signals so for this first attempt just
-            //take all signals from the reference and then find that same signal in
-            //the interested frames and then see what unique values there were in either one
+    ui->treeDetails->clear();
+    idItems.clear();
+    referenceOnlyBase = nullptr;
 
-            QHash<QString, QList<QString>>::const_iterator it = reference.signalInstances.constBegin();
-            while (it != reference.signalInstances.constEnd())
-            {
-                valuesBase = new QTreeWidgetItem();
-                valuesBase->setText(0, "Signal " + it.key());
-                sharedItem->addChild(valuesBase);
-                valuesInterested = new QTreeWidgetItem();
-                valuesInterested->setText(0, "Values found only in " + interestedFilename);
-                if (!uniqueInterested)
-                {
-                    valuesReference = new QTreeWidgetItem();
-                    valuesReference->setText(0, "Values found only in Side 2 - Reference frames");
-                }
-                valuesBase->addChild(valuesInterested);
-                if (!uniqueInterested) valuesBase->addChild(valuesReference);
+    interestedOnlyBase = new QTreeWidgetItem();
+    interestedOnlyBase->setText(0,"IDs found only in " + interestedFilename);
+    if (!uniqueInterested)
+    {
+        referenceOnlyBase = new QTreeWidgetItem();
+        referenceOnlyBase->setText(0, "IDs found only in Side 2 - Reference frames");
+    }
+    sharedBase = new QTreeWidgetItem();
+    sharedBase->setText(0,"IDs found on both sides");
 
-                QList<QString> refVals = it.value();
-                QList<QString> interestedVals = interested.signalInstances[it.key()];
-                foreach (QString str, refVals)
-                {
-                    if (!interestedVals.contains(str))
-                    {
-                        qDebug() << "Interested frames didn't contain value: " << str << " in signal " << it.key();
-                        detail = new QTreeWidgetItem();
-                        detail->setText(0, str);
-                        valuesReference->addChild(detail);
-                    }
-                }
-                qApp->processEvents();
-                foreach (QString str, interestedVals)
-                {
-                    if (!refVals.contains(str))
-                    {
-                        qDebug() << "Reference frames didn't contain value: " << str << " in signal " << it.key();
-                        detail = new QTreeWidgetItem();
-                        detail->setText(0, str);
-                        valuesInterested->addChild(detail);
-                    }
-                }
-                ++it;
-            }
+    //now we iterate through the IDs within both files and see which are unique to one file and which
+    //are shared
+    QMap<uint32_t, FrameData>::const_iterator i;
+    for (i = interestedIDs.constBegin(); i != interestedIDs.constEnd(); ++i)
+    {
+        uint32_t keyone = i.key();
+        QHash<uint32_t, FrameData>::const_iterator fresh = liveFresh.constFind(keyone);
 
-            if (interestedHadUnique || !uniqueInterested) sharedBase->addChild(sharedItem);
+        QMap<uint32_t, FrameData>::const_iterator ref = referenceIDs.constFind(keyone);
+        if (ref == referenceIDs.constEnd())
+        {
+            valuesBase = new QTreeWidgetItem();
+            valuesBase->setText(0, idLabel(keyone));
+            if (fresh != liveFresh.constEnd()) valuesBase->setForeground(0, QBrush(Qt::darkGreen));
+            interestedOnlyBase->addChild(valuesBase);
+            idItems.insert(keyone, valuesBase);
+            continue;
         }
-    }
 
-    qApp->processEvents();
+        //ID was in both files. Only worth showing if some bit or byte value turned up in the file of interest and nowhere else
+        if (uniqueInterested && !i.value().hasUniqueAgainst(ref.value())) continue;
+
+        sharedItem = new QTreeWidgetItem();
+        sharedItem->setText(0, idLabel(keyone));
+        //filled in by detailsExpanded when it's first opened
+        sharedItem->setData(0, Qt::UserRole, keyone);
+        sharedItem->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+        if (fresh != liveFresh.constEnd() && fresh.value().hasUniqueAgainst(ref.value()))
+            sharedItem->setForeground(0, QBrush(Qt::darkGreen));
+        sharedBase->addChild(sharedItem);
+        idItems.insert(keyone, sharedItem);
+    }
 
     if (!uniqueInterested)
     {
-        QMap<uint32_t, FrameData>::iterator itwo;
-        for (itwo = referenceIDs.begin(); itwo != referenceIDs.end(); ++itwo)
+        QMap<uint32_t, FrameData>::const_iterator itwo;
+        for (itwo = referenceIDs.constBegin(); itwo != referenceIDs.constEnd(); ++itwo)
         {
             unsigned int keytwo = itwo.key();
             if (!interestedIDs.contains(keytwo))
             {
                 valuesBase = new QTreeWidgetItem();
-                DBC_MESSAGE *msg = dbcHandler->findMessage(keytwo);
-                if (msg)
-                {
-                    valuesBase->setText(0, Utility::formatHexNum(keytwo) + " (" + msg->name + ")" );
-                }
-                else valuesBase->setText(0, Utility::formatHexNum(keytwo));
+                valuesBase->setText(0, idLabel(keytwo));
                 referenceOnlyBase->addChild(valuesBase);
+                idItems.insert(keytwo, valuesBase);
             }
         }
     }
@@ -519,10 +601,156 @@ void FileComparatorWindow::calculateDetails()
     QSettings settings;
     if (settings.value("InfoCompare/AutoExpand", false).toBool())
     {
+        fillAllPending();
         ui->treeDetails->expandAll();
     }
+}
 
-    progress.cancel();
+QString FileComparatorWindow::idLabel(uint32_t id) const
+{
+    QString label = Utility::formatHexNum(id);
+    DBC_MESSAGE *msg = dbcHandler->findMessage(id);
+    if (msg) label += " (" + msg->name + ")";
+    return label;
+}
+
+void FileComparatorWindow::detailsExpanded(QTreeWidgetItem *item)
+{
+    QVariant id = item->data(0, Qt::UserRole);
+    if (!id.isValid()) return;
+    item->setData(0, Qt::UserRole, QVariant());
+
+    uint32_t key = id.toUInt();
+    if (!interestedIDs.contains(key) || !referenceIDs.contains(key)) return;
+    QHash<uint32_t, FrameData>::const_iterator fresh = liveFresh.constFind(key);
+    fillSharedItem(item, interestedIDs[key], referenceIDs[key], (fresh != liveFresh.constEnd()) ? &fresh.value() : nullptr);
+    if (item->childCount() == 0) item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+}
+
+//saving and expanding everything both want the whole tree
+void FileComparatorWindow::fillAllPending()
+{
+    for (int t = 0; t < ui->treeDetails->topLevelItemCount(); t++)
+    {
+        QTreeWidgetItem *base = ui->treeDetails->topLevelItem(t);
+        for (int c = 0; c < base->childCount(); c++) detailsExpanded(base->child(c));
+    }
+}
+
+//if the ID was in both files then we can use the data accumulated in bitmap and values to figure out what
+//has changed between the two files. Whatever of that is in fresh came in live and gets highlighted
+void FileComparatorWindow::fillSharedItem(QTreeWidgetItem *sharedItem, const FrameData &interested, const FrameData &reference, const FrameData *fresh) const
+{
+    QTreeWidgetItem *bitmapBaseInterested, *bitmapBaseReference = nullptr;
+    QTreeWidgetItem *valuesBase, *detail, *valuesInterested, *valuesReference = nullptr;
+
+    bool uniqueInterested = treeUniqueInterested;
+
+    bitmapBaseInterested = new QTreeWidgetItem();
+    bitmapBaseInterested->setText(0, "Bits set only in " + interestedFilename);
+    if (!uniqueInterested)
+    {
+        bitmapBaseReference = new QTreeWidgetItem();
+        bitmapBaseReference->setText(0, "Bits set only in Side 2 - Reference frames");
+    }
+    sharedItem->addChild(bitmapBaseInterested);
+    if (!uniqueInterested) sharedItem->addChild(bitmapBaseReference);
+
+    //first up, which bits were set in one file but not the other
+    for (int b = 0; b < (8 * interested.dataLen); b++)
+    {
+        bool inInterested = interested.hasBit(b);
+        bool inReference = reference.hasBit(b);
+        if (inInterested == inReference) continue;
+        if (!inInterested && uniqueInterested) continue;
+        detail = new QTreeWidgetItem();
+        detail->setText(0, QString::number(b) + " (" + QString::number(b / 8) + ":" + QString::number(b % 8) + ")");
+        if (inInterested && fresh && fresh->hasBit(b)) detail->setForeground(0, QBrush(Qt::darkGreen));
+        if (inInterested) bitmapBaseInterested->addChild(detail);
+        else bitmapBaseReference->addChild(detail);
+    }
+
+    for (int i = 0; i < qMax(interested.dataLen, reference.dataLen); i++)
+    {
+        valuesBase = new QTreeWidgetItem();
+        valuesBase->setText(0, "Byte " + QString::number(i));
+        sharedItem->addChild(valuesBase);
+        valuesInterested = new QTreeWidgetItem();
+        valuesInterested->setText(0, "Values found only in " + interestedFilename);
+        if (!uniqueInterested)
+        {
+            valuesReference = new QTreeWidgetItem();
+            valuesReference->setText(0, "Values found only in Side 2 - Reference frames");
+        }
+        valuesBase->addChild(valuesInterested);
+        if (!uniqueInterested) valuesBase->addChild(valuesReference);
+        for (int j = 0; j < 256; j++)
+        {
+            bool inInterested = interested.hasValue(i, j);
+            bool inReference = reference.hasValue(i, j);
+            if (inInterested == inReference) continue;
+            if (!inInterested && uniqueInterested) continue;
+            detail = new QTreeWidgetItem();
+            detail->setText(0, Utility::formatHexNum(static_cast<unsigned int>(j)));
+            if (inInterested && fresh && fresh->hasValue(i, j)) detail->setForeground(0, QBrush(Qt::darkGreen));
+            if (inInterested) valuesInterested->addChild(detail);
+            else valuesReference->addChild(detail);
+        }
+    }
+
+    //presumably both include the same signals so for this first attempt just
+    //take all signals from the reference and then find that same signal in
+    //the interested frames and then see what unique values there were in either one
+
+    QHash<QString, QSet<QString>>::const_iterator it = reference.signalInstances.constBegin();
+    while (it != reference.signalInstances.constEnd())
+    {
+        valuesBase = new QTreeWidgetItem();
+        valuesBase->setText(0, "Signal " + it.key());
+        sharedItem->addChild(valuesBase);
+        valuesInterested = new QTreeWidgetItem();
+        valuesInterested->setText(0, "Values found only in " + interestedFilename);
+        if (!uniqueInterested)
+        {
+            valuesReference = new QTreeWidgetItem();
+            valuesReference->setText(0, "Values found only in Side 2 - Reference frames");
+        }
+        valuesBase->addChild(valuesInterested);
+        if (!uniqueInterested) valuesBase->addChild(valuesReference);
+
+        const QSet<QString> &refVals = it.value();
+        QSet<QString> interestedVals = interested.signalInstances.value(it.key());
+        QStringList onlyReference, onlyInterested;
+        for (const QString &str : refVals)
+        {
+            if (!interestedVals.contains(str)) onlyReference.append(str);
+        }
+        for (const QString &str : qAsConst(interestedVals))
+        {
+            if (!refVals.contains(str)) onlyInterested.append(str);
+        }
+        //sets don't keep any order so put them in one
+        onlyReference.sort();
+        onlyInterested.sort();
+        if (!uniqueInterested)
+        {
+            foreach (QString str, onlyReference)
+            {
+                detail = new QTreeWidgetItem();
+                detail->setText(0, str);
+                valuesReference->addChild(detail);
+            }
+        }
+        QSet<QString> freshVals = fresh ? fresh->signalInstances.value(it.key()) : QSet<QString>();
+        foreach (QString str, onlyInterested)
+        {
+            detail = new QTreeWidgetItem();
+            detail->setText(0, str);
+            if (freshVals.contains(str)) detail->setForeground(0, QBrush(Qt::darkGreen));
+            valuesInterested->addChild(detail);
+        }
+        ++it;
+    }
 }
 
 void FileComparatorWindow::saveDetails()
@@ -551,6 +779,7 @@ void FileComparatorWindow::saveDetails()
             return;
 
         QTreeWidget *tree = ui->treeDetails;
+        fillAllPending(); //nodes nobody opened yet still belong in the file
 
 
         QTreeWidgetItemIterator it(tree);
@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QDebug>
 #include <QTreeWidget>
+#include <QSet>
 #include "framefileio.h"
 #include "can_structs.h"
 #include "utility.h"
@@ -13,13 +14,25 @@ namespace Ui {
 class FileComparatorWindow;
 }
 
+//bytes of each frame that get compared. Enough for CAN FD
+#define FILECOMPARE_BYTES           64
+//frames per worker when boiling the files down. A big single file still gets spread across every thread
+#define FILECOMPARE_CHUNK_FRAMES    100000
+
+//Everything the comparison needs to know about one ID on one side, however many frames or files that came from
 struct FrameData
 {
-    uint32_t ID;
-    int dataLen;
-    uint64_t bitmap;
-    int values[8][256]; //first index is the data byte, second is # of times we saw that value
-    QHash<QString, QList<QString>> signalInstances;
+    uint32_t ID = 0;
+    int dataLen = 0; //longest frame seen
+    uint64_t bitmap[FILECOMPARE_BYTES / 8] = {}; //every bit that was ever set, byte 0 in the low bits of word 0
+    uint64_t values[FILECOMPARE_BYTES][4] = {}; //first index is the data byte, then one bit for each of the 256 values it took
+    QHash<QString, QSet<QString>> signalInstances;
+
+    bool hasBit(int bit) const { return (bitmap[bit >> 6] >> (bit & 63)) & 1; }
+    bool hasValue(int byte, int val) const { return (values[byte][val >> 6] >> (val & 63)) & 1; }
+    void merge(const FrameData &other);
+    //any bit or byte value here that other never had
+    bool hasUniqueAgainst(const FrameData &other) const;
 };
 
 class FileComparatorWindow : public QDialog
@@ -35,15 +48,39 @@ private slots:
     void loadReferenceFile();
     void clearReference();
     void saveDetails();
+    void detailsExpanded(QTreeWidgetItem *item);
+    void toggleLive(bool live);
 
 private:
     Ui::FileComparatorWindow *ui;
-    QVector<CANFrame> interestedFrames;
-    QVector<CANFrame> referenceFrames;
+    QMap<uint32_t, FrameData> interestedIDs;
+    QMap<uint32_t, FrameData> referenceIDs;
+    int interestedFrameCount;
+    int referenceFrameCount;
+    int referenceFileCount;
+    bool treeUniqueInterested;
     QString interestedFilename;
     DBCHandler *dbcHandler;
+    //the tree as calculateDetails last built it, so live frames can be slotted in without building it again
+    QTreeWidgetItem *interestedOnlyBase, *referenceOnlyBase, *sharedBase;
+    QHash<uint32_t, QTreeWidgetItem *> idItems;
+    //side 1 is the live capture while this is subscribed to the frame bus
+    int liveSubscription;
+    bool liveHighlight; //off while the frames already in the frame list are taken in
+    QHash<uint32_t, FrameData> liveFresh; //what turned up since then, shown highlighted
+    QHash<uint32_t, DBC_MESSAGE *> liveMessages;
 
+    bool digestFrames(const QVector<QVector<CANFrame>> &frameSets, QMap<uint32_t, FrameData> &into);
+    bool digestLiveFrame(const CANFrame &frame, FrameData &idData, FrameData *fresh);
+    void gotLiveFrames(const QVector<CANFrame> &frames);
+    void liveReset();
+    void updateLiveItem(uint32_t id);
+    void updateLiveLabel();
     void calculateDetails();
+    QString idLabel(uint32_t id) const;
+    void fillSharedItem(QTreeWidgetItem *sharedItem, const FrameData &interested, const FrameData &reference, const FrameData *fresh) const;
+    void fillAllPending();
+    void updateReferenceLabel();
     void showEvent(QShowEvent *);
     void closeEvent(QCloseEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
@@ -1,15 +1,21 @@
 #include "flowviewwindow.h"
 #include "ui_flowviewwindow.h"
 #include "mainwindow.h"
+#include "windowupdategate.h"
 #include "helpwindow.h"
 #include "filterutility.h"
 #include "qcpaxistickerhex.h"
+#include "replotscheduler.h"
+#include "offscreenplot.h"
+#include "pipelinetrace.h"
+
+#include <algorithm>
 
 const QColor FlowViewWindow::graphColors[8] = {Qt::blue, Qt::green, Qt::black, Qt::red, //0 1 2 3
                                                Qt::gray, Qt::darkYellow, Qt::cyan, Qt::darkMagenta}; //4 5 6 7
 
 
-FlowViewWindow::FlowViewWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+FlowViewWindow::FlowViewWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::FlowViewWindow)
 {
@@ -23,13 +29,21 @@ FlowViewWindow::FlowViewWindow(const QVector<CANFrame> *frames, QWidget *parent)
     playbackTimer = new QTimer();
 
     currentPosition = 0;
+    bytesShown = 0;
     playbackActive = false;
     playbackForward = true;
 
     memset(refBytes, 0, 64);
     memset(currBytes, 0, 64);
     memset(triggerValues, -1, sizeof(int) * 8);
-    for (int i = 0; i < 8; i++) triggerBits[i] = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        triggerBits[i] = 0;
+        graphRef[i] = nullptr;
+    }
+    idSelected = false;
+    currentID = 0;
+    firstFrameNum = 0;
 
     //ui->graphView->setInteractions();
 
@@ -87,6 +101,7 @@ FlowViewWindow::FlowViewWindow(const QVector<CANFrame> *frames, QWidget *parent)
     }
 
     ui->graphView->setBufferDevicePixelRatio(1);
+    OffscreenPlot::setup(ui->graphView);
 
     connect(ui->btnBackOne, SIGNAL(clicked(bool)), this, SLOT(btnBackOneClick()));
     connect(ui->btnPause, SIGNAL(clicked(bool)), this, SLOT(btnPauseClick()));
@@ -127,7 +142,7 @@ FlowViewWindow::FlowViewWindow(const QVector<CANFrame> *frames, QWidget *parent)
             changeID(FilterUtility::getId(itemText));
             } );
 
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
 
     ui->graphView->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(ui->graphView, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(contextMenuRequestGraph(QPoint)));
@@ -296,7 +311,7 @@ void FlowViewWindow::plottableDoubleClick(QCPAbstractPlottable* plottable, QMous
     int id = 0;
     //apply transforms to get the X axis value where we double clicked
     double coord = plottable->keyAxis()->pixelToCoord(event->localPos().x());
-    if (frameCache.count() > 0) id = frameCache[0].frameId();
+    if (idSelected) id = currentID;
     if (secondsMode) emit sendCenterTimeID(id, coord);
     else emit sendCenterTimeID(id, coord / 1000000.0);
 }
@@ -309,7 +324,8 @@ void FlowViewWindow::gotCenterTimeID(uint32_t ID, double timestamp)
 
     qDebug() << "timestamp: " << t_stamp;
 
-    changeID(QString::number(ID)); //to be sure we're focused on the proper ID
+    //to be sure we're focused on the proper ID. The cached frames are still good if we already are
+    if (!idSelected || currentID != ID) changeID(QString::number(ID));
 
     for (int j = 0; j < ui->listFrameID->count(); j++)
     {
@@ -321,27 +337,19 @@ void FlowViewWindow::gotCenterTimeID(uint32_t ID, double timestamp)
         }
     }
 
-    int bestIdx = -1;
-    for (int i = 0; i < frameCache.count(); i++)
-    {
-        if (frameCache[i].timeStamp().microSeconds() > t_stamp)
-        {
-            bestIdx = i - 1;
-            break;
-        }
-    }
+    //newest frame at or before the timestamp
+    int bestIdx = static_cast<int>(std::upper_bound(frameStamps.constBegin(), frameStamps.constEnd(), static_cast<uint64_t>(qMax(t_stamp, (int64_t)0)))
+                                   - frameStamps.constBegin()) - 1;
     qDebug() << "Best index " << bestIdx;
     if (bestIdx > -1)
     {
         currentPosition = bestIdx;
         if (ui->cbAutoRef->isChecked())
         {
-            memcpy(refBytes, currBytes, 8);
+            memcpy(refBytes, currBytes, 64);
         }
 
-        memset(currBytes, 0, 8); //first zero out all 8 bytes
-
-        memcpy(currBytes, frameCache.at(currentPosition).payload().data(), frameCache.at(currentPosition).payload().length());
+        loadFrame(currentPosition, currBytes);
 
         updateDataView();
     }
@@ -443,16 +451,13 @@ void FlowViewWindow::saveFileFlow()
 
 void FlowViewWindow::updatedFrames(int numFrames)
 {
-    QVector<double>newX[8];
-    QVector<double>newY[8];
-    const unsigned char *data;
-    int dataLen = 0;
-
-    const CANFrame *thisFrame;
+    TRACE_SCOPE("FlowViewWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted. Kill the display
     {
         ui->listFrameID->clear();
         foundID.clear();
+        clearFrames();
+        idSelected = false;
         currentPosition = 0;
         refreshIDList();
         updateFrameLabel();
@@ -477,65 +482,53 @@ void FlowViewWindow::updatedFrames(int numFrames)
     else //just got some new frames. See if they are relevant.
     {
         if (numFrames > modelFrames->count()) return;
-        unsigned int refID;
-        if (frameCache.count() > 0) refID = frameCache[0].frameId();
-            else refID = 0;
-        bool needRefresh = false;
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        bool needRefresh = dropEvicted();
+        int oldCount = frameSeqs.count();
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
         {
-            thisFrame = &modelFrames->at(i);
-            data = reinterpret_cast<const unsigned char *>(thisFrame->payload().constData());
-            dataLen = thisFrame->payload().length();
+            uint32_t id = modelFrames->record(i).frameId();
 
-            if (!foundID.contains(thisFrame->frameId()))
+            if (!foundID.contains(id))
             {
-                foundID.append(thisFrame->frameId());
-                FilterUtility::createFilterItem(thisFrame->frameId(), ui->listFrameID);
+                foundID.append(id);
+                FilterUtility::createFilterItem(id, ui->listFrameID);
             }
 
-            if (thisFrame->frameId() == refID)
+            //changeID might already have picked this one up straight from the store
+            if (idSelected && id == currentID && (frameSeqs.isEmpty() || modelFrames->sequenceOf(i) > frameSeqs.last()))
             {
-                frameCache.append(*thisFrame);
-
-                for (int k = 0; k < dataLen; k++)
+                appendFrame(i);
+                //a longer CAN-FD frame than any so far needs a bigger grid
+                if (modelFrames->record(i).len > bytesShown)
                 {
-                    if (ui->cbTimeGraph->isChecked())
-                    {
-                        if (secondsMode){
-                            newX[k].append((double)(thisFrame->timeStamp().microSeconds()) / 1000000.0);
-                        }
-                        else
-                        {
-                            newX[k].append(thisFrame->timeStamp().microSeconds());
-                        }
-                    }
-                    else
-                    {
-                        newX[k].append(x[k].count());
-                    }
-                    newY[k].append(data[k]);
-                    needRefresh = true;
+                    bytesShown = modelFrames->record(i).len;
+                    ui->flowView->setBytesToDraw(bytesShown);
                 }
             }
         }
-        if (ui->cbLiveMode->checkState() == Qt::Checked)
-        {
-            currentPosition = frameCache.count() - 1;
-            memset(currBytes, 0, 64);
-            memcpy(currBytes, frameCache.at(currentPosition).payload().data(), frameCache.at(currentPosition).payload().length());
-            memcpy(refBytes, currBytes, 64);
 
-        }
-        if (needRefresh)
+        if (frameSeqs.count() > oldCount)
         {
-            for (int k = 0; k < dataLen; k++)
+            //just the new tail of each series goes to the graphs
+            QVector<double> newX = graphX.mid(oldCount);
+            for (int k = 0; k < 8; k++)
             {
-                if (graphRef[k] && graphRef[k]->data())
-                    graphRef[k]->addData(newX[k], newY[k]);
+                if (graphRef[k]) graphRef[k]->addData(newX, graphY[k].mid(oldCount), true);
             }
-            ui->graphView->replot();
+            needRefresh = true;
+        }
+
+        if (ui->cbLiveMode->checkState() == Qt::Checked && frameSeqs.count() > 0)
+        {
+            currentPosition = frameSeqs.count() - 1;
+            loadFrame(currentPosition, currBytes);
+            memcpy(refBytes, currBytes, 64);
+        }
+        if (needRefresh && frameSeqs.count() > 0)
+        {
+            ReplotScheduler::getReference()->request(ui->graphView);
             updateDataView();
-            if (ui->cbSync->checkState() == Qt::Checked) emit sendCenterTimeID(frameCache[currentPosition].frameId(), frameCache[currentPosition].timeStamp().microSeconds() / 1000000.0);
+            if (ui->cbSync->checkState() == Qt::Checked) emit sendCenterTimeID(currentID, frameStamps[currentPosition] / 1000000.0);
         }
     }
     updateFrameLabel();
@@ -544,59 +537,84 @@ void FlowViewWindow::updatedFrames(int numFrames)
 void FlowViewWindow::removeAllGraphs()
 {
   ui->graphView->clearGraphs();
+  for (int k = 0; k < 8; k++) graphRef[k] = nullptr;
   ui->graphView->replot();
 }
 
-void FlowViewWindow::createGraph(int byteNum)
+void FlowViewWindow::clearFrames()
 {
-    int tempVal;
-    double minval = 1000000.0, maxval = -100000.0;
-    const unsigned char *data;
-    const CANFrame *frame;
+    frameSeqs.clear();
+    frameStamps.clear();
+    graphX.clear();
+    for (int k = 0; k < 8; k++) graphY[k].clear();
+    firstFrameNum = 0;
+}
 
-    qDebug() << "Create Graph " << byteNum;
+//adds store row idx to the end of the current ID's frames and the byte series
+void FlowViewWindow::appendFrame(int idx)
+{
+    const CANFrameRecord &rec = modelFrames->record(idx);
+    const uint8_t *data = modelFrames->payloadData(idx);
+    frameSeqs.append(modelFrames->sequenceOf(idx));
+    frameStamps.append(rec.timestamp);
 
-    bool graphByTime = ui->cbTimeGraph->isChecked();
+    if (ui->cbTimeGraph->isChecked())
+    {
+        if (secondsMode) graphX.append(rec.timestamp / 1000000.0);
+        else graphX.append(static_cast<double>(rec.timestamp));
+    }
+    else graphX.append(static_cast<double>(firstFrameNum + frameSeqs.count() - 1));
 
-    int numEntries = frameCache.count();
+    for (int k = 0; k < 8; k++) graphY[k].append((k < rec.len) ? data[k] : 0);
+}
 
-    x[byteNum].clear();
-    y[byteNum].clear();
-    x[byteNum].resize(numEntries);
-    y[byteNum].resize(numEntries);
+/*
+ * Takes the current ID's frames the store has evicted off the front of the list. Their payloads are gone so there'd
+ * be nothing to show for them. Returns true if there were any.
+ */
+bool FlowViewWindow::dropEvicted()
+{
+    quint64 base = modelFrames->baseSequence();
+    if (frameSeqs.isEmpty() || frameSeqs.first() >= base) return false;
+
+    int num = static_cast<int>(std::lower_bound(frameSeqs.constBegin(), frameSeqs.constEnd(), base) - frameSeqs.constBegin());
+    frameSeqs.remove(0, num);
+    frameStamps.remove(0, num);
+    graphX.remove(0, num);
+    for (int k = 0; k < 8; k++)
+    {
+        graphY[k].remove(0, num);
+        if (graphRef[k]) graphRef[k]->setData(graphX, graphY[k], true);
+    }
+    firstFrameNum += num;
 
-    for (int j = 0; j < numEntries; j++)
+    currentPosition -= num;
+    if (currentPosition < 0)
     {
-        frame = &frameCache[j];
-        data = reinterpret_cast<const unsigned char *>(frame->payload().constData());
-        if (byteNum < frameCache[j].payload().length())
-            tempVal = data[byteNum];
-        else
-            tempVal = 0;
+        currentPosition = 0;
+        if (frameSeqs.count() > 0) loadFrame(currentPosition, currBytes);
+    }
+    return true;
+}
 
-        if (graphByTime)
-        {
-            if (secondsMode){
-                x[byteNum][j] = frame->timeStamp().microSeconds() / 1000000.0;
-            }
-            else
-            {
-                x[byteNum][j] = frame->timeStamp().microSeconds();
-            }
-        }
-        else
-        {
-            x[byteNum][j] = j;
-        }
+//zero padded payload of the frame at pos, which has to still be in the store
+int FlowViewWindow::loadFrame(int pos, unsigned char *bytes) const
+{
+    memset(bytes, 0, 64);
+    int idx = modelFrames->indexOfSequence(frameSeqs[pos]);
+    if (idx < 0) return 0;
+    int len = qMin(static_cast<int>(modelFrames->record(idx).len), 64);
+    memcpy(bytes, modelFrames->payloadData(idx), len);
+    return len;
+}
 
-        y[byteNum][j] = tempVal;
-        if (y[byteNum][j] < minval) minval = y[byteNum][j];
-        if (y[byteNum][j] > maxval) maxval = y[byteNum][j];
-    }
+void FlowViewWindow::createGraph(int byteNum)
+{
+    qDebug() << "Create Graph " << byteNum;
 
     graphRef[byteNum] = ui->graphView->addGraph();
     ui->graphView->graph()->setName(QString("Graph %1").arg(ui->graphView->graphCount()-1));
-    ui->graphView->graph()->setData(x[byteNum],y[byteNum]);
+    ui->graphView->graph()->setData(graphX, graphY[byteNum], true);
     ui->graphView->graph()->setLineStyle(QCPGraph::lsLine); //connect points with lines
     QPen graphPen;
     graphPen.setColor(graphColors[byteNum]);
@@ -608,10 +626,9 @@ void FlowViewWindow::createGraph(int byteNum)
 void FlowViewWindow::refreshIDList()
 {
     int id;
-    for (int i = 0; i < modelFrames->count(); i++)
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
     {
-        CANFrame thisFrame = modelFrames->at(i);
-        id = thisFrame.frameId();
+        id = info.id;
         if (!foundID.contains(id))
         {
             foundID.append(id);
@@ -624,38 +641,40 @@ void FlowViewWindow::refreshIDList()
 
 void FlowViewWindow::updateFrameLabel()
 {
-    ui->lblNumFrames->setText(QString::number(currentPosition) + tr(" of ") + QString::number(frameCache.count()));
+    ui->lblNumFrames->setText(QString::number(currentPosition) + tr(" of ") + QString::number(frameSeqs.count()));
 }
 
 void FlowViewWindow::changeID(QString newID)
 {
     qDebug() << "change id " << newID;
-    //parse the ID and then load up the frame cache with just messages with that ID.
+    //parse the ID and then pull the list of that ID's frames and their byte series out of the store in one pass
     uint32_t id = (uint32_t)Utility::ParseStringToNum(newID);
-    frameCache.clear();
+    clearFrames();
+    currentID = id;
+    idSelected = true;
 
     if (modelFrames->count() == 0) return;
 
     playbackTimer->stop();
     playbackActive = false;
     int maxBytes = 0;
-    for (int x = 0; x < modelFrames->count(); x++)
+    QVector<int> rows = modelFrames->rowsOf(id);
+    frameSeqs.reserve(rows.count());
+    frameStamps.reserve(rows.count());
+    graphX.reserve(rows.count());
+    for (int k = 0; k < 8; k++) graphY[k].reserve(rows.count());
+    for (int row : rows)
     {
-        CANFrame thisFrame = modelFrames->at(x);
-        if (thisFrame.frameId() == id)
-        {
-            thisFrame.payload().clear();
-            frameCache.append(thisFrame);
-            if (thisFrame.payload().length() > maxBytes) maxBytes = thisFrame.payload().length();
-        }
+        appendFrame(row);
+        if (modelFrames->record(row).len > maxBytes) maxBytes = modelFrames->record(row).len;
     }
+    bytesShown = maxBytes;
     ui->flowView->setBytesToDraw(maxBytes);
     currentPosition = 0;
 
-    if (frameCache.count() == 0) return;
+    if (frameSeqs.count() == 0) return;
 
     removeAllGraphs();
-    //for (uint32_t c = 0; c < frameCache.at(0).len; c++)
     for (uint32_t c = 0; c < 8; c++)
     {
         createGraph(c);
@@ -663,8 +682,7 @@ void FlowViewWindow::changeID(QString newID)
 
     updateGraphLocation();
 
-    memset(currBytes, 0, 64);
-    memcpy(currBytes, frameCache.at(currentPosition).payload().constData(), frameCache.at(currentPosition).payload().length());
+    loadFrame(currentPosition, currBytes);
     memcpy(refBytes, currBytes, 64);
 
     updateDataView();
@@ -710,9 +728,9 @@ void FlowViewWindow::btnStopClick()
     playbackTimer->stop(); //pushing this button halts automatic playback
     playbackActive = false;
     currentPosition = 0;
+    if (frameSeqs.count() == 0) return;
 
-    memset(currBytes, 0, 64);
-    memcpy(currBytes, frameCache.at(currentPosition).payload().constData(), frameCache.at(currentPosition).payload().length());
+    loadFrame(currentPosition, currBytes);
     memcpy(refBytes, currBytes, 64);
 
     updateFrameLabel();
@@ -767,7 +785,7 @@ void FlowViewWindow::timerTriggered()
     if (!ui->cbLoopPlayback->isChecked())
     {
         if (currentPosition == 0) playbackActive = false;
-        if (currentPosition == (frameCache.count() - 1)) playbackActive = false;
+        if (currentPosition == (frameSeqs.count() - 1)) playbackActive = false;
     }
 }
 
@@ -795,7 +813,7 @@ void FlowViewWindow::updateDataView()
     ui->flowView->setReference(refBytes, false);
     ui->flowView->updateData(currBytes, true);
 
-    ui->timelineSlider->setMaximum(frameCache.count() - 1);
+    ui->timelineSlider->setMaximum(frameSeqs.count() - 1);
     ui->timelineSlider->setValue(currentPosition);
 
     for (int i = 0; i < 8; i++)
@@ -815,24 +833,34 @@ void FlowViewWindow::updateDataView()
 }
 
 void FlowViewWindow::gotoFrame(int frame) {
-    if (frameCache.count() >= frame) currentPosition = frame;
-    else currentPosition = 0;
+    if (frameSeqs.count() == 0) return;
+    if (frame < 0 || frame >= frameSeqs.count()) frame = 0;
+    if (frame == currentPosition) return; //our own setValue from stepping, already showing it
 
-    if (ui->cbSync->checkState() == Qt::Checked) emit sendCenterTimeID(frameCache[currentPosition].frameId(), frameCache[currentPosition].timeStamp().microSeconds() / 1000000.0);
+    if (ui->cbAutoRef->isChecked())
+    {
+        memcpy(refBytes, currBytes, 64);
+    }
+    currentPosition = frame;
+    loadFrame(currentPosition, currBytes);
+
+    if (ui->cbSync->checkState() == Qt::Checked) emit sendCenterTimeID(currentID, frameStamps[currentPosition] / 1000000.0);
+    updateDataView();
 }
 
 void FlowViewWindow::updatePosition(bool forward)
 {
+    if (frameSeqs.count() == 0) return;
 
     if (forward)
     {
-        if (currentPosition < (frameCache.count() - 1)) currentPosition++;
+        if (currentPosition < (frameSeqs.count() - 1)) currentPosition++;
         else if (ui->cbLoopPlayback->isChecked()) currentPosition = 0;
     }
     else
     {
         if (currentPosition > 0) currentPosition--;
-        else if (ui->cbLoopPlayback->isChecked()) currentPosition = frameCache.count() - 1;
+        else if (ui->cbLoopPlayback->isChecked()) currentPosition = frameSeqs.count() - 1;
     }
 
     if (ui->cbAutoRef->isChecked())
@@ -840,76 +868,49 @@ void FlowViewWindow::updatePosition(bool forward)
         memcpy(refBytes, currBytes, 64);
     }
 
+    unsigned char nextBytes[64];
+    int len = loadFrame(currentPosition, nextBytes);
+
     //figure out which bits changed since the previous frame and then AND that with the trigger bits. If any bits
     //get through that then they're changed and a trigger so we stop playback at this frame.
     //This is complicated by the fact that CAN-FD frames might have far more than 64 bits. It is necessary
     //to thus process them 64 bits at a time and just move chunk to chunk until done.
-    for (int chunk = 0; chunk < frameCache.at(currentPosition).payload().length(); chunk += 8)
+    for (int chunk = 0; chunk * 8 < len; chunk++)
     {
         uint64_t changedBits = 0;
-        uint8_t cngByte;
-        int maxVal = qMin(chunk * 8 + 8, frameCache.at(currentPosition).payload().length());
+        int maxVal = qMin(chunk * 8 + 8, len);
         for (int i = chunk * 8; i < maxVal; i++)
         {
-            unsigned char thisByte = static_cast<unsigned char>(frameCache.at(currentPosition).payload()[i]);
-            cngByte = currBytes[i] ^ thisByte;
+            uint8_t cngByte = currBytes[i] ^ nextBytes[i];
             changedBits |= (uint64_t)cngByte << (8ull * (i & 7));
         }
 
-        qDebug() << "ChangedBits: " << QString::number(changedBits, 16);
-        qDebug() << "TriggerBits: " << QString::number(triggerBits[chunk / 8], 16);
-        changedBits &= triggerBits[chunk / 8];
-        qDebug() << "Final ChangedBits: " << QString::number(changedBits, 16);
+        changedBits &= triggerBits[chunk];
         if (changedBits)
         {
             playbackActive = false;
             playbackTimer->stop();
         }
     }
-    memset(currBytes, 0, 64);
-    memcpy(currBytes, frameCache.at(currentPosition).payload().constData(), frameCache.at(currentPosition).payload().length());
+    memcpy(currBytes, nextBytes, 64);
 
-    if (ui->cbSync->checkState() == Qt::Checked) emit sendCenterTimeID(frameCache[currentPosition].frameId(), frameCache[currentPosition].timeStamp().microSeconds() / 1000000.0);
+    if (ui->cbSync->checkState() == Qt::Checked) emit sendCenterTimeID(currentID, frameStamps[currentPosition] / 1000000.0);
     ui->timelineSlider->setValue(currentPosition);
 }
 
 void FlowViewWindow::updateGraphLocation()
 {
-    if (frameCache.count() == 0) return;
+    if (frameSeqs.count() == 0) return;
     int start = currentPosition - ui->graphRangeSlider->value();
     if (start < 0) start = 0;
     int end = currentPosition + ui->graphRangeSlider->value();
-    if (end >= frameCache.count()) end = frameCache.count() - 1;
-    if (ui->cbTimeGraph->isChecked())
+    if (end >= frameSeqs.count()) end = frameSeqs.count() - 1;
+    //graphX is already in whichever units the graph is in
+    ui->graphView->xAxis->setRange(graphX[start], graphX[end]);
+    if (!ui->cbTimeGraph->isChecked())
     {
-        if (secondsMode)
-        {
-            ui->graphView->xAxis->setRange(frameCache[start].timeStamp().microSeconds() / 1000000.0, frameCache[end].timeStamp().microSeconds() / 1000000.0);
-            /*
-            ui->graphView->xAxis->setTickStep((frameCache[end].timeStamp().microSeconds() - frameCache[start].timeStamp().microSeconds())/ 3000000.0);
-            ui->graphView->xAxis->setSubTickCount(0);
-            ui->graphView->xAxis->setNumberFormat("f");
-            ui->graphView->xAxis->setNumberPrecision(6);
-            */
-        }
-        else
-        {
-            ui->graphView->xAxis->setRange(frameCache[start].timeStamp().microSeconds(), frameCache[end].timeStamp().microSeconds());
-            /*
-            ui->graphView->xAxis->setTickStep((frameCache[end].timeStamp().microSeconds() - frameCache[start].timeStamp().microSeconds())/ 3.0);
-            ui->graphView->xAxis->setSubTickCount(0);
-            ui->graphView->xAxis->setNumberFormat("f");
-            ui->graphView->xAxis->setNumberPrecision(0); */
-        }
-    }
-    else
-    {
-        ui->graphView->xAxis->setRange(start, end);
-        //ui->graphView->xAxis->setTickStep(5.0);
-        //ui->graphView->xAxis->setSubTickCount(0);
         ui->graphView->xAxis->setNumberFormat("gb");
     }
 
     ui->graphView->replot();
 }
-
@@ -6,6 +6,7 @@
 #include <QSlider>
 #include "qcustomplot.h"
 #include "can_structs.h"
+#include "canframestore.h"
 
 namespace Ui {
 class FlowViewWindow;
@@ -16,7 +17,7 @@ class FlowViewWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit FlowViewWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit FlowViewWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~FlowViewWindow();
     void showEvent(QShowEvent*);
 
@@ -49,13 +50,21 @@ signals:
 private:
     Ui::FlowViewWindow *ui;
     QList<quint32> foundID;
-    QList<CANFrame> frameCache;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
+    //the selected ID's frames, oldest first. Store sequence numbers so they survive eviction, stamps and the byte
+    //series for the graphs are cached alongside so stepping, seeking and live updates never go back through the store
+    bool idSelected;
+    uint32_t currentID;
+    QVector<quint64> frameSeqs;
+    QVector<uint64_t> frameStamps;
+    QVector<double> graphX, graphY[8];
+    qint64 firstFrameNum; //graph x of frameSeqs[0] when graphing by frame number
     unsigned char refBytes[64];
     unsigned char currBytes[64];
     int triggerValues[8];
     uint64_t triggerBits[8];
     int currentPosition;
+    int bytesShown; //longest frame of the current ID, what the grid is laid out for
     QTimer *playbackTimer;
     bool playbackActive;
     bool playbackForward;
@@ -63,7 +72,6 @@ private:
     bool secondsMode;
     bool openGLMode;
     bool useHexTicker;
-    QVector<double> x[8], y[8];
     QCPGraph *graphRef[8];
 
     void refreshIDList();
@@ -72,6 +80,10 @@ private:
     void gotoFrame(int frame);
     void updateDataView();
     void removeAllGraphs();
+    void clearFrames();
+    void appendFrame(int idx);
+    bool dropEvicted();
+    int loadFrame(int pos, unsigned char *bytes) const;
     void createGraph(int);
     void updateGraphLocation();
     void closeEvent(QCloseEvent *event);
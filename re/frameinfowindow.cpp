@@ -1,11 +1,15 @@
 #include "frameinfowindow.h"
 #include "ui_frameinfowindow.h"
 #include "mainwindow.h"
+#include "windowupdategate.h"
 #include "helpwindow.h"
 #include <QtDebug>
-#include <vector>
+#include <algorithm>
 #include "filterutility.h"
 #include "qcpaxistickerhex.h"
+#include "replotscheduler.h"
+#include "offscreenplot.h"
+#include "pipelinetrace.h"
 
 const QColor FrameInfoWindow::byteGraphColors[8] = {Qt::blue, Qt::green,  Qt::black, Qt::red, //0 1 2 3
                                                     Qt::gray, Qt::darkYellow, Qt::cyan,  Qt::darkMagenta}; //4 5 6 7
@@ -13,7 +17,7 @@ QPen FrameInfoWindow::bytePens[8];
 
 const int numIntervalHistBars = 20;
 
-FrameInfoWindow::FrameInfoWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+FrameInfoWindow::FrameInfoWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::FrameInfoWindow)
 {
@@ -23,6 +27,7 @@ FrameInfoWindow::FrameInfoWindow(const QVector<CANFrame> *frames, QWidget *paren
     readSettings();
 
     modelFrames = frames;
+    periodStore = PeriodicityStore::forFrames(modelFrames); //ahead of our own framesUpdated connect so it's current first
 
     // Using lambda expression to strip away the possible filter label before passing the ID to updateDetailsWindow
     connect(ui->listFrameID, &QListWidget::currentTextChanged, 
@@ -31,7 +36,8 @@ FrameInfoWindow::FrameInfoWindow(const QVector<CANFrame> *frames, QWidget *paren
             FrameInfoWindow::updateDetailsWindow(FilterUtility::getId(itemText));
             } );
 
-    connect(MainWindow::getReference(), &MainWindow::framesUpdated, this, &FrameInfoWindow::updatedFrames);
+    rebuildStats();
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
     connect(ui->btnSave, &QAbstractButton::clicked, this, &FrameInfoWindow::saveDetails);
 
     ui->splitter->setStretchFactor(0, 1); //idx, stretch factor
@@ -109,6 +115,8 @@ FrameInfoWindow::FrameInfoWindow(const QVector<CANFrame> *frames, QWidget *paren
         ui->timeHistogram->setOpenGl(false);
         ui->timeHistogram->setAntialiasedElements(QCP::aeNone);
     }
+    OffscreenPlot::setup(graphHistogram);
+    OffscreenPlot::setup(ui->timeHistogram);
 
     // Prevent annoying accidental horizontal scrolling when filter list is populated with long interpreted message names
     ui->listFrameID->horizontalScrollBar()->setEnabled(false);
@@ -161,6 +169,7 @@ void FrameInfoWindow::setupByteGraph(QCustomPlot *plot, int num)
         plot->setOpenGl(false);
         plot->setAntialiasedElements(QCP::aeNone);
     }
+    OffscreenPlot::setup(plot);
 
     connect(plot, SIGNAL(mousePress(QMouseEvent*)), this, SLOT(mousePress()));
     connect(plot, SIGNAL(mouseWheel(QWheelEvent*)), this, SLOT(mouseWheel()));
@@ -306,9 +315,11 @@ void FrameInfoWindow::writeSettings()
 //remember, negative numbers are special -1 = all frames deleted, -2 = totally new set of frames.
 void FrameInfoWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("FrameInfoWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted. Kill the display
     {
         //qDebug() << "Delete all frames in Info Window";
+        rebuildStats();
         ui->listFrameID->clear();
         ui->treeDetails->clear();
         foundID.clear();
@@ -317,6 +328,7 @@ void FrameInfoWindow::updatedFrames(int numFrames)
     else if (numFrames == -2) //all new set of frames. Reset
     {
         //qDebug() << "All new set of frames in Info Window";
+        rebuildStats();
         ui->listFrameID->clear();
         ui->treeDetails->clear();
         foundID.clear();
@@ -330,23 +342,23 @@ void FrameInfoWindow::updatedFrames(int numFrames)
     else //just got some new frames. See if they are relevant.
     {
         //qDebug() << "Got frames in Info Window";
+        feedStats();
         if (numFrames > modelFrames->count()) return;
 
         unsigned int currID = 0;
         if (ui->listFrameID->currentItem())
             currID = static_cast<unsigned int>(FilterUtility::getIdAsInt(ui->listFrameID->currentItem()));
         bool thisID = false;
-        for (int x = modelFrames->count() - numFrames; x < modelFrames->count(); x++)
+        for (int x = modelFrames->tailIndex(numFrames); x < modelFrames->count(); x++)
         {
-            CANFrame thisFrame = modelFrames->at(x);
-            int32_t id = static_cast<int32_t>(thisFrame.frameId());
+            int32_t id = static_cast<int32_t>(modelFrames->record(x).frameId());
             if (!foundID.contains(id))
             {
                 foundID.append(id);
                 FilterUtility::createFilterItem(id, ui->listFrameID);
             }
 
-            if (currID == modelFrames->at(x).frameId())
+            if (currID == static_cast<unsigned int>(id))
             {
                 thisID = true;
                 break;
@@ -368,31 +380,84 @@ void FrameInfoWindow::updatedFrames(int numFrames)
     }
 }
 
+//starts the statistics over from whatever the store holds right now
+void FrameInfoWindow::rebuildStats()
+{
+    stats.clear();
+    signalTallies.clear();
+    statsSequence = modelFrames->baseSequence();
+    feedStats();
+}
+
+//adds every frame the store got since the last call. Anything evicted before we saw it is skipped
+void FrameInfoWindow::feedStats()
+{
+    quint64 base = modelFrames->baseSequence();
+    quint64 end = base + static_cast<quint64>(modelFrames->count());
+    if (statsSequence < base) statsSequence = base;
+    for (; statsSequence < end; statsSequence++)
+    {
+        int idx = static_cast<int>(statsSequence - base);
+        stats.add(modelFrames->record(idx), modelFrames->payloadData(idx));
+    }
+}
+
+/*
+ * How many frames had each value of each signal in the ID's DBC message. Decoding signals needs whole frames so this
+ * is only done for IDs somebody looks at and then kept, each later look only decodes the frames that came in since.
+ * A change to the loaded DBC files starts the ID over.
+ */
+const QHash<QString, QHash<QString, int>> &FrameInfoWindow::tallySignals(uint32_t id, const QVector<int> &rows)
+{
+    SignalTally &tally = signalTallies[id];
+    quint32 revision = DBCHandler::getRevision();
+    quint64 base = modelFrames->baseSequence();
+    if (!tally.built || tally.revision != revision)
+    {
+        tally.instances.clear();
+        tally.nextSequence = base;
+        tally.revision = revision;
+        tally.built = true;
+    }
+
+    //rows are oldest first so the new ones are all at the end
+    int first = rows.count();
+    while (first > 0 && modelFrames->sequenceOf(rows[first - 1]) >= tally.nextSequence) first--;
+
+    DBC_MESSAGE *msg = dbcHandler->findMessageForFilter(id, nullptr);
+    if (msg && first < rows.count())
+    {
+        int numSignals = msg->sigHandler->getCount();
+        for (int j = first; j < rows.count(); j++)
+        {
+            CANFrame frame = modelFrames->at(rows[j]);
+            for (int i = 0; i < numSignals; i++)
+            {
+                DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
+                if (sig && sig->isSignalInMessage(frame))
+                {
+                    QString sigVal;
+                    if (sig->processAsText(frame, sigVal, false))
+                    {
+                        tally.instances[sig->name][sigVal]++;
+                    }
+                }
+            }
+        }
+    }
+    tally.nextSequence = base + static_cast<quint64>(modelFrames->count());
+    return tally.instances;
+}
+
 void FrameInfoWindow::updateDetailsWindow(QString newID)
 {
     int targettedID;
-    int minLen, maxLen, thisLen;
-    int64_t avgInterval;
-    int64_t minInterval;
-    int64_t maxInterval;
-    int64_t thisInterval;
-    int minData[8];
-    int maxData[8];
-    int dataHistogram[256][8];
-    int bitfieldHistogram[64];
     QVector<double> histGraphX, histGraphY;
     QVector<double> byteGraphX, byteGraphY[8];
     QVector<double> timeGraphX, timeGraphY;
-    QHash<QString, QHash<QString, int>> signalInstances;
     double maxY = -1000.0;
-    uint8_t changedBits[8];
-    uint8_t referenceBits[8];
     uint8_t heatVals[512];
 
-    //these two used by bitflip heatmap functionality
-    uint8_t refByte[8];
-    double bitFlipHeat[64];
-
     QTreeWidgetItem *baseNode, *dataBase, *histBase, *tempItem;
 
     if (modelFrames->count() == 0) return;
@@ -401,31 +466,18 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
 
     qDebug() << "Started update details window with id " << targettedID;
 
-    avgInterval = 0;
-
     if (targettedID > -1)
     {
-
-        frameCache.clear();
-        for (int i = 0; i < modelFrames->count(); i++)
-        {
-            CANFrame thisFrame = modelFrames->at(i);
-            if (thisFrame.frameId() == static_cast<uint32_t>(targettedID)) frameCache.append(thisFrame);
-        }
-
-        if (frameCache.count() == 0) return; //nothing to do if there are no frames!
-
-        const unsigned char *data = reinterpret_cast<const unsigned char *>(frameCache.at(0).payload().constData());
-        int dataLen = frameCache.at(0).payload().length();
+        //everything but the byte graphs and the signal values was worked out as the frames came in
+        const FrameStats::IdStats *idStats = stats.find(static_cast<uint32_t>(targettedID));
+        if (!idStats || idStats->frames == 0) return; //nothing to do if there are no frames!
 
         ui->treeDetails->clear();
 
-        if (frameCache.count() == 0) return;
-
         baseNode = new QTreeWidgetItem();
         baseNode->setText(0, QString("ID: ") + newID );
 
-        if (frameCache[0].hasExtendedFrameFormat()) //if these frames seem to be extended then try for J1939 decoding
+        if (idStats->extended) //if these frames seem to be extended then try for J1939 decoding
         {
             // ------- J1939 decoding ----------
             J1939ID jid;
@@ -488,170 +540,31 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
         }
 
         tempItem = new QTreeWidgetItem();
-        tempItem->setText(0, tr("# of frames: ") + QString::number(frameCache.count(),10));
+        tempItem->setText(0, tr("# of frames: ") + QString::number(idStats->frames,10));
         baseNode->addChild(tempItem);
 
-        //clear out all the counters and accumulators
-        minLen = 8;
-        maxLen = 0;
-        minInterval = 0x7FFFFFFF;
-        maxInterval = 0;
-        for (int i = 0; i < 8; i++)
-        {
-            minData[i] = 256;
-            maxData[i] = -1;
-            for (int k = 0; k < 256; k++) dataHistogram[k][i] = 0;
-        }
-        for (int j = 0; j < 64; j++)
+        QVector<int> rows = modelFrames->rowsOf(static_cast<uint32_t>(targettedID));
+        byteGraphX.reserve(rows.count());
+        for (int j = 0; j < rows.count(); j++)
         {
-            bitfieldHistogram[j] = 0;
-            bitFlipHeat[j] = 0;
-        }
-        signalInstances.clear();
-
-        data = reinterpret_cast<const unsigned char *>(frameCache.at(0).payload().constData());
-        dataLen = frameCache.at(0).payload().length();
-
-        for (int c = 0; c < dataLen; c++)
-        {
-            changedBits[c] = 0;
-            referenceBits[c] = data[c];
-            refByte[c] = data[c];
-            //qDebug() << referenceBits[c];
-        }
-
-        std::vector<int64_t> sortedIntervals;
-        int64_t intervalSum = 0;
-
-        DBC_MESSAGE *msg = dbcHandler->findMessageForFilter(targettedID, nullptr);
-
-        //then find all data points
-        for (int j = 0; j < frameCache.count(); j++)
-        {
-            data = reinterpret_cast<const unsigned char *>(frameCache.at(j).payload().constData());
-            dataLen = frameCache.at(j).payload().length();
-
+            const uint8_t *data = modelFrames->payloadData(rows[j]);
+            int dataLen = std::min(static_cast<int>(modelFrames->record(rows[j]).len), 8);
             byteGraphX.append(j);
-            for (int bytcnt = 0; bytcnt < dataLen; bytcnt++)
-            {
-                byteGraphY[bytcnt].append(data[bytcnt]);
-            }
-
-            if (j != 0)
-            {
-                //TODO - we try the interval whichever way doesn't go negative. But, we should probably sort the frame list before
-                //starting so that the intervals are all correct.
-                if (frameCache[j].timeStamp().microSeconds() > frameCache[j-1].timeStamp().microSeconds())
-                    thisInterval = (frameCache[j].timeStamp().microSeconds() - frameCache[j-1].timeStamp().microSeconds());
-                else
-                    thisInterval = (frameCache[j-1].timeStamp().microSeconds() - frameCache[j].timeStamp().microSeconds());
-
-                sortedIntervals.push_back(thisInterval);
-                intervalSum += thisInterval;
-                if (thisInterval > maxInterval) maxInterval = thisInterval;
-                if (thisInterval < minInterval) minInterval = thisInterval;
-                avgInterval += thisInterval;
-            }
-            thisLen = dataLen;
-            if (thisLen > maxLen) maxLen = thisLen;
-            if (thisLen < minLen) minLen = thisLen;
-            for (int c = 0; c < thisLen; c++)
-            {
-                unsigned char dat = data[c];
-                if (minData[c] > dat) minData[c] = dat;
-                if (maxData[c] < dat) maxData[c] = dat;
-                dataHistogram[dat][c]++; //add one to count for this
-                for (int l = 0; l < 8; l++)
-                {
-                    int bit = dat & (1 << l);
-                    if (bit == (1 << l))
-                    {
-                        bitfieldHistogram[c * 8 + l]++;
-                    }
-                }
-                changedBits[c] |= referenceBits[c] ^ dat;
-
-                if (refByte[c] != dat) //if this byte doesn't match the value it last had
-                {
-                    uint8_t newBits = refByte[c] ^ dat; //get changed bits since last ref
-                    for (int l = 0; l < 8; l++)
-                    {
-                        if (newBits & (1 << l)) bitFlipHeat[(c * 8) + l]++;
-                    }
-                    refByte[c] = dat; //set the reference to this current byte now that processing is done
-                }
-            }
-
-            //Search every signal in the selected message and give output of the range the signal took and
-            //how many messages contained each discrete value.
-            if (msg)
-            {
-                int numSignals = msg->sigHandler->getCount();
-                for (int i = 0; i < numSignals; i++)
-                {
-                    DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(i);
-                    if (sig)
-                    {
-                        if (sig->isSignalInMessage(frameCache.at(j)))
-                        {
-                            QString sigVal;
-                            if (sig->processAsText(frameCache.at(j), sigVal, false))
-                            {
-                                signalInstances[sig->name][sigVal] = signalInstances[sig->name][sigVal] + 1;
-                            }
-                        }
-                    }
-                }
-            }
+            for (int bytcnt = 0; bytcnt < dataLen; bytcnt++) byteGraphY[bytcnt].append(data[bytcnt]);
         }
 
-        //Divide all the bit flip heat values by the number of frames to get a ratio
-        for (int j = 0; j < 64; j++) bitFlipHeat[j] /= (double)frameCache.count();
+        const QHash<QString, QHash<QString, int>> &signalInstances = tallySignals(static_cast<uint32_t>(targettedID), rows);
 
-        std::sort(sortedIntervals.begin(), sortedIntervals.end());
-        int64_t intervalStdDiv = 0, intervalPctl5 = 0, intervalPctl95 = 0, intervalMean = 0, intervalVariance = 0;
-
-        int maxTimeCounter = -1;
-        if (sortedIntervals.size() > 0)
-        {
-            intervalMean = intervalSum / sortedIntervals.size();
-
-            for(int l = 0; l < static_cast<int>(sortedIntervals.size()); l++) {
-                intervalVariance += ((sortedIntervals[l] - intervalMean) * (sortedIntervals[l] - intervalMean));
-            }
-
-            intervalVariance /= sortedIntervals.size();
-            intervalStdDiv = static_cast<int>(sqrt(intervalVariance));
-
-            intervalPctl5 = sortedIntervals[static_cast<unsigned int>(floor(0.05 * sortedIntervals.size()))];
-            intervalPctl95 = sortedIntervals[static_cast<unsigned int>(floor(0.95 * sortedIntervals.size()))];
-
-            uint64_t step = static_cast<unsigned int>(ceil((maxInterval - minInterval) / numIntervalHistBars));
-            qDebug() << "Step: " << step << " minInt: " << minInterval << " maxInt: " << maxInterval;
-            unsigned int index = 0;
-            int counter = 0;
-            for(int l = 0; l <= numIntervalHistBars; l++) {
-                int64_t currentMax = maxInterval - ((numIntervalHistBars - l) * step);	// avoid missing the biggest value due to rounding errors
-                qDebug() << "CurrentMax: " << currentMax;
-                while(index < sortedIntervals.size()) {
-                    if(sortedIntervals[index] <= currentMax) {
-                        counter++;
-                        index++;
-                    }
-                    else {
-                        break;
-                    }
-                }
-                timeGraphX.append(currentMax / 1000.0);
-                timeGraphY.append(counter);
-                if(counter > maxTimeCounter) maxTimeCounter = counter;
-                counter = 0;
-            }
-        }
-
-        if (frameCache.count() > 1)
-            avgInterval = avgInterval / (frameCache.count() - 1);
-        else avgInterval = 0;
+        int minLen = idStats->minLen;
+        int maxLen = idStats->maxLen;
+        int byteLen = idStats->bytes.count(); //the longest frame, up to 64 bytes for CAN-FD
+        int64_t minInterval = idStats->minInterval;
+        int64_t maxInterval = idStats->maxInterval;
+        double avgInterval = idStats->intervalMean;
+        double intervalStdDiv = idStats->intervalStdDev();
+        int64_t intervalPctl5 = idStats->intervalPercentile(0.05);
+        int64_t intervalPctl95 = idStats->intervalPercentile(0.95);
+        idStats->intervalHistogram(numIntervalHistBars, timeGraphX, timeGraphY);
 
         //now that data processing is done, create all of our output
 
@@ -683,9 +596,25 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
         tempItem->setText(0, tr("Minimum range to fit 90% of inter-frame intervals: ") + QString::number((intervalPctl95 - intervalPctl5) / 1000.0) + "ms");
         baseNode->addChild(tempItem);
 
+        //cycle time per bus, an ID sent on two buses is two separate schedules
+        periodStore->sync();
+        for (const QPair<int, const PeriodStats *> &period : periodStore->findAll(static_cast<uint32_t>(targettedID)))
+        {
+            tempItem = new QTreeWidgetItem();
+            tempItem->setText(0, tr("Cycle time on bus ") + QString::number(period.first));
+            for (const QString &line : period.second->summary().split('\n'))
+            {
+                QTreeWidgetItem *periodItem = new QTreeWidgetItem();
+                periodItem->setText(0, line);
+                tempItem->addChild(periodItem);
+            }
+            baseNode->addChild(tempItem);
+        }
+
         //display accumulated data for all the bytes in the message
-        for (int c = 0; c < maxLen; c++)
+        for (int c = 0; c < byteLen; c++)
         {
+            const FrameStats::ByteStats &byteStats = idStats->bytes[c];
             dataBase = new QTreeWidgetItem();
             histBase = new QTreeWidgetItem();
 
@@ -694,22 +623,22 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
 
             tempItem = new QTreeWidgetItem();
             QString builder;
-            builder = tr("Changed bits: 0x") + QString::number(changedBits[c], 16) + "  (" + Utility::formatByteAsBinary(changedBits[c]) + ")";
+            builder = tr("Changed bits: 0x") + QString::number(byteStats.changedBits, 16) + "  (" + Utility::formatByteAsBinary(byteStats.changedBits) + ")";
             tempItem->setText(0, builder);
             dataBase->addChild(tempItem);
 
             tempItem = new QTreeWidgetItem();
-            tempItem->setText(0, tr("Range: ") + Utility::formatNumber((unsigned int)minData[c]) + tr(" to ") + Utility::formatNumber((unsigned int)maxData[c]));
+            tempItem->setText(0, tr("Range: ") + Utility::formatNumber((unsigned int)byteStats.minData) + tr(" to ") + Utility::formatNumber((unsigned int)byteStats.maxData));
             dataBase->addChild(tempItem);
             histBase->setText(0, tr("Histogram"));
             dataBase->addChild(histBase);
 
             for (int d = 0; d < 256; d++)
             {
-                if (dataHistogram[d][c] > 0)
+                if (byteStats.histogram[d] > 0)
                 {
                     tempItem = new QTreeWidgetItem();
-                    tempItem->setText(0, QString::number(d) + "/0x" + QString::number(d, 16) +" (" + Utility::formatByteAsBinary(static_cast<uint8_t>(d)) +") -> " + QString::number(dataHistogram[d][c]));
+                    tempItem->setText(0, QString::number(d) + "/0x" + QString::number(d, 16) +" (" + Utility::formatByteAsBinary(static_cast<uint8_t>(d)) +") -> " + QString::number(byteStats.histogram[d]));
                     histBase->addChild(tempItem);
                 }
             }
@@ -717,16 +646,17 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
 
         dataBase = new QTreeWidgetItem();
         dataBase->setText(0, tr("Bitfield Histogram"));
-        for (int c = 0; c < 8 * maxLen; c++)
+        for (int c = 0; c < 8 * byteLen; c++)
         {
+            quint32 bitCount = idStats->bytes[c / 8].bitCounts[c % 8];
             tempItem = new QTreeWidgetItem();
             tempItem->setText(0, QString::number(c) + " (Byte " + QString::number(c / 8) + " Bit "
-                            + QString::number(c % 8) + ") : " + QString::number(bitfieldHistogram[c]));
+                            + QString::number(c % 8) + ") : " + QString::number(bitCount));
 
             dataBase->addChild(tempItem);
             histGraphX.append(c);
-            histGraphY.append(bitfieldHistogram[c]);
-            if (bitfieldHistogram[c] > maxY) maxY = bitfieldHistogram[c];
+            histGraphY.append(bitCount);
+            if (bitCount > maxY) maxY = bitCount;
         }
         baseNode->addChild(dataBase);
 
@@ -734,30 +664,34 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
         dataBase = new QTreeWidgetItem();
         dataBase->setText(0, tr("Bitchange Heatmap"));
         memset(heatVals, 0, 512); //always clear the array before populating it.
-        for (int c = 0; c < 8 * maxLen; c++)
+        for (int c = 0; c < 8 * byteLen; c++)
         {
+            //flips as a ratio of the number of frames
+            quint32 bitCount = idStats->bytes[c / 8].bitCounts[c % 8];
+            double bitFlipHeat = idStats->bytes[c / 8].bitFlips[c % 8] / static_cast<double>(idStats->frames);
             tempItem = new QTreeWidgetItem();
             tempItem->setText(0, QString::number(c) + " (Byte " + QString::number(c / 8) + " Bit "
-                            + QString::number(c % 8) + ") : " + QString::number(bitFlipHeat[c] * 100.0, 'f', 2));
+                            + QString::number(c % 8) + ") : " + QString::number(bitFlipHeat * 100.0, 'f', 2));
 
             dataBase->addChild(tempItem);
             histGraphX.append(c);
-            histGraphY.append(bitfieldHistogram[c]);
-            if (bitfieldHistogram[c] > maxY) maxY = bitfieldHistogram[c];
-            uint8_t heat = bitFlipHeat[c] * 255;
-            if ((heat < 1) && (bitFlipHeat[c] > 0.0001)) heat = 1; //make sure any little bit of heat causes at least some output
+            histGraphY.append(bitCount);
+            if (bitCount > maxY) maxY = bitCount;
+            uint8_t heat = bitFlipHeat * 255;
+            if ((heat < 1) && (bitFlipHeat > 0.0001)) heat = 1; //make sure any little bit of heat causes at least some output
             //qDebug() << "Heat for bit " << c <<  " is " << heat;
             heatVals[c] = heat;
         }
         baseNode->addChild(dataBase);
+        heatmap->setBytesToDraw(std::max(byteLen, 8));
         heatmap->setHeat(heatVals);
 
         QHash<QString, QHash<QString, int>>::const_iterator it = signalInstances.constBegin();
         while (it != signalInstances.constEnd()) {
             dataBase = new QTreeWidgetItem();
             dataBase->setText(0, it.key());
-            QHash<QString,int>::const_iterator itVal = signalInstances[it.key()].constBegin();
-            while (itVal != signalInstances[it.key()].constEnd())
+            QHash<QString,int>::const_iterator itVal = it.value().constBegin();
+            while (itVal != it.value().constEnd())
             {
                 tempItem = new QTreeWidgetItem();
                 tempItem->setText(0, itVal.key() + ": " + QString::number(itVal.value()));
@@ -782,7 +716,7 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
         graphHistogram->yAxis->setRange(0.8, maxY * 1.2);
         graphHistogram->yAxis->setScaleType(QCPAxis::stLogarithmic);
         graphHistogram->axisRect()->setupFullAxesBox();
-        graphHistogram->replot();
+        ReplotScheduler::getReference()->request(graphHistogram);
 
         for (int graphs = 0; graphs < 8; graphs++)
         {
@@ -791,7 +725,7 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
             graphByte[graphs]->graph()->setData(byteGraphX, byteGraphY[graphs]);
             graphByte[graphs]->graph()->setPen(bytePens[graphs]);
             graphByte[graphs]->xAxis->setRange(0, byteGraphX.count());
-            graphByte[graphs]->replot();
+            ReplotScheduler::getReference()->request(graphByte[graphs]);
         }
 
         ui->timeHistogram->clearGraphs();
@@ -807,7 +741,7 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
         //ui->timeHistogram->xAxis->setRange(minInterval / 1000.0, maxInterval / 1000.0); //graph is in ms while intervals are in us
         ui->timeHistogram->axisRect()->setupFullAxesBox();
         ui->timeHistogram->rescaleAxes();
-        ui->timeHistogram->replot();
+        ReplotScheduler::getReference()->request(ui->timeHistogram);
     }
     else
     {
@@ -823,10 +757,9 @@ void FrameInfoWindow::updateDetailsWindow(QString newID)
 void FrameInfoWindow::refreshIDList()
 {
     int id;
-    for (int i = 0; i < modelFrames->count(); i++)
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
     {
-        CANFrame thisFrame = modelFrames->at(i);
-        id = (int)thisFrame.frameId();
+        id = (int)info.id;
         if (!foundID.contains(id))
         {
             foundID.append(id);
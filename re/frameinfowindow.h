@@ -7,6 +7,9 @@
 #include <QTreeWidget>
 #include <candatagrid.h>
 #include "can_structs.h"
+#include "canframestore.h"
+#include "framestats.h"
+#include "periodicity.h"
 #include "bus_protocols/j1939_handler.h"
 #include "dbc/dbchandler.h"
 
@@ -21,7 +24,7 @@ class FrameInfoWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit FrameInfoWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit FrameInfoWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~FrameInfoWindow();
     void showEvent(QShowEvent*);
 
@@ -39,9 +42,21 @@ private:
     QCustomPlot *graphHistogram;
     CANDataGrid *heatmap;
 
+    //DBC signal value counts for one ID, see tallySignals
+    struct SignalTally
+    {
+        bool built = false;
+        quint32 revision = 0; //DBCHandler revision they were decoded with
+        quint64 nextSequence = 0; //store sequence of the first frame not counted yet
+        QHash<QString, QHash<QString, int>> instances;
+    };
+
     QList<int> foundID;
-    QList<CANFrame> frameCache;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
+    FrameStats stats;
+    quint64 statsSequence; //store sequence of the next frame stats hasn't seen
+    PeriodicityStore *periodStore;
+    QHash<uint32_t, SignalTally> signalTallies;
     bool useOpenGL;
     bool useHexTicker;
     static const QColor byteGraphColors[8];
@@ -51,6 +66,9 @@ private:
     QCPGraph *graphRef[8];
 
     void refreshIDList();
+    void rebuildStats();
+    void feedStats();
+    const QHash<QString, QHash<QString, int>> &tallySignals(uint32_t id, const QVector<int> &rows);
     void closeEvent(QCloseEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
     void setupByteGraph(QCustomPlot *plot, int num);
@@ -0,0 +1,149 @@
+#include "framestats.h"
+
+#include <algorithm>
+#include <cmath>
+
+FrameStats::IdStats::IdStats()
+{
+    intervalBins.fill(0, FRAMESTATS_INTERVAL_BINS);
+}
+
+FrameStats::~FrameStats()
+{
+    clear();
+}
+
+void FrameStats::clear()
+{
+    ids.clear();
+    arena.clear();
+}
+
+void FrameStats::add(const CANFrameRecord &rec, const uint8_t *payload)
+{
+    IdStats *&slot = ids[rec.frameId()];
+    if (!slot) slot = arena.create();
+    IdStats &s = *slot;
+
+    int len = rec.len;
+    int bytes = std::min(len, FRAMESTATS_BYTES);
+    if (bytes > s.bytes.count())
+    {
+        //a longer frame than before. The new bytes start out as if earlier frames had them at 0
+        int had = s.bytes.count();
+        s.bytes.resize(bytes);
+        if (s.frames == 0)
+        {
+            for (int c = had; c < bytes; c++) s.bytes[c].first = s.bytes[c].last = payload[c];
+        }
+    }
+    if (s.frames == 0)
+    {
+        s.extended = rec.isExtended();
+    }
+    else
+    {
+        //whichever way doesn't go negative, frames from different sources can be a little out of order
+        int64_t interval = (rec.timestamp > s.lastStamp) ? static_cast<int64_t>(rec.timestamp - s.lastStamp)
+                                                          : static_cast<int64_t>(s.lastStamp - rec.timestamp);
+        s.intervals++;
+        double delta = interval - s.intervalMean;
+        s.intervalMean += delta / s.intervals;
+        s.intervalM2 += delta * (interval - s.intervalMean);
+        if (s.intervals == 1 || interval < s.minInterval) s.minInterval = interval;
+        if (s.intervals == 1 || interval > s.maxInterval) s.maxInterval = interval;
+        s.intervalBins[binOf(interval)]++;
+    }
+    s.frames++;
+    s.lastStamp = rec.timestamp;
+    if (len < s.minLen) s.minLen = len;
+    if (len > s.maxLen) s.maxLen = len;
+
+    ByteStats *b = s.bytes.data();
+    for (int c = 0; c < bytes; c++, b++)
+    {
+        uint8_t dat = payload[c];
+        if (dat < b->minData) b->minData = dat;
+        if (dat > b->maxData) b->maxData = dat;
+        b->histogram[dat]++;
+        for (int l = 0; l < 8; l++)
+        {
+            if (dat & (1 << l)) b->bitCounts[l]++;
+        }
+        b->changedBits |= b->first ^ dat;
+        uint8_t flipped = b->last ^ dat;
+        if (flipped)
+        {
+            for (int l = 0; l < 8; l++)
+            {
+                if (flipped & (1 << l)) b->bitFlips[l]++;
+            }
+            b->last = dat;
+        }
+    }
+}
+
+int FrameStats::binOf(int64_t interval)
+{
+    if (interval <= 0) return 0;
+    int bin = 1 + static_cast<int>(std::log2(static_cast<double>(interval)) * FRAMESTATS_BINS_PER_OCTAVE);
+    return std::min(bin, FRAMESTATS_INTERVAL_BINS - 1);
+}
+
+//geometric middle of a bin
+double FrameStats::binValue(int bin)
+{
+    if (bin == 0) return 0.0;
+    return std::exp2((bin - 1 + 0.5) / FRAMESTATS_BINS_PER_OCTAVE);
+}
+
+double FrameStats::IdStats::intervalStdDev() const
+{
+    if (intervals == 0) return 0.0;
+    return std::sqrt(intervalM2 / intervals);
+}
+
+//the interval at the given rank, same as indexing a sorted list of them at floor(fraction * count)
+int64_t FrameStats::IdStats::intervalPercentile(double fraction) const
+{
+    if (intervals == 0) return 0;
+    quint64 rank = static_cast<quint64>(std::floor(fraction * intervals));
+    quint64 seen = 0;
+    for (int b = 0; b < intervalBins.count(); b++)
+    {
+        seen += intervalBins[b];
+        if (seen > rank)
+        {
+            double v = std::round(binValue(b));
+            return std::max(minInterval, std::min(maxInterval, static_cast<int64_t>(v)));
+        }
+    }
+    return maxInterval;
+}
+
+/*
+ * bars + 1 evenly spaced bars from the minimum interval up to the maximum one, each bin of the log histogram going
+ * into the bar its middle lands in.
+ */
+void FrameStats::IdStats::intervalHistogram(int bars, QVector<double> &x, QVector<double> &y) const
+{
+    x.clear();
+    y.clear();
+    if (intervals == 0 || bars <= 0) return;
+
+    int64_t step = static_cast<int64_t>(std::ceil(static_cast<double>((maxInterval - minInterval) / bars)));
+    for (int l = 0; l <= bars; l++)
+    {
+        x.append((maxInterval - ((bars - l) * step)) / 1000.0); //tops counted back from the max so it always has a bar
+        y.append(0);
+    }
+    for (int b = 0; b < intervalBins.count(); b++)
+    {
+        if (!intervalBins[b]) continue;
+        int64_t v = std::max(minInterval, std::min(maxInterval, static_cast<int64_t>(std::round(binValue(b)))));
+        int l = 0;
+        if (step > 0) l = bars - static_cast<int>((maxInterval - v) / step);
+        l = std::max(0, std::min(bars, l));
+        y[l] += intervalBins[b];
+    }
+}
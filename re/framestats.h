@@ -0,0 +1,80 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <QHash>
+#include <QVector>
+#include "can_structs.h"
+#include "objectarena.h"
+
+//interval histogram resolution. Each bin is 1/16 of an octave wide, about 4.4%
+#define FRAMESTATS_BINS_PER_OCTAVE  16
+//bin 0 is intervals of 0, the rest cover 1us up to 2^40us (about 12 days)
+#define FRAMESTATS_INTERVAL_BINS    (1 + 40 * FRAMESTATS_BINS_PER_OCTAVE)
+//the byte statistics go as far as a CAN-FD frame does. Each ID only has as many as its longest frame
+#define FRAMESTATS_BYTES            64
+
+/*
+ * Running per ID statistics for the frame info window. Every frame updates its ID's aggregates once as it comes
+ * in so looking at an ID just reads them out, no matter how many frames it has:
+ * - inter-frame interval count / mean / variance by Welford's method plus min / max. The 5th / 95th percentiles
+ *   and the interval histogram come from a log scale histogram so they're within a bin width (about 4%)
+ * - per byte min / max, value histogram, changed bits and bit flip counts
+ * - per bit set counts
+ *
+ * The per byte part grows with the longest frame an ID has sent so classic IDs don't carry 64 bytes' worth.
+ *
+ * Frames are counted by ID alone, all buses together, and in the order they arrive. Frames the store later evicts
+ * stay counted.
+ */
+class FrameStats
+{
+public:
+    struct ByteStats
+    {
+        uint8_t first = 0; //what changedBits is relative to. Bytes the first frame didn't have count from 0
+        uint8_t last = 0; //what bit flips are relative to
+        uint8_t changedBits = 0;
+        int minData = 256, maxData = -1;
+        quint32 histogram[256] = {0};
+        quint32 bitCounts[8] = {0};
+        quint32 bitFlips[8] = {0};
+    };
+
+    struct IdStats
+    {
+        quint64 frames = 0;
+        bool extended = false; //of the first frame
+        int minLen = 64, maxLen = 0;
+        uint64_t lastStamp = 0;
+
+        quint64 intervals = 0;
+        double intervalMean = 0.0;
+        double intervalM2 = 0.0; //sum of squared differences from the mean, Welford style
+        int64_t minInterval = 0, maxInterval = 0;
+        QVector<quint32> intervalBins;
+
+        QVector<ByteStats> bytes; //as many as the longest frame so far
+
+        IdStats();
+        double intervalStdDev() const;
+        int64_t intervalPercentile(double fraction) const;
+        //bars + 1 points, x is the top of each bar in ms, y the intervals that fall in it
+        void intervalHistogram(int bars, QVector<double> &x, QVector<double> &y) const;
+    };
+
+    FrameStats() {}
+    ~FrameStats();
+    void clear();
+    void add(const CANFrameRecord &rec, const uint8_t *payload);
+    const IdStats *find(uint32_t id) const { return ids.value(id, nullptr); }
+
+private:
+    Q_DISABLE_COPY(FrameStats)
+    static int binOf(int64_t interval);
+    static double binValue(int bin);
+
+    QHash<uint32_t, IdStats *> ids;
+    ObjectArena<IdStats> arena;
+};
+
+#endif // FRAMESTATS_H
@@ -0,0 +1,270 @@
+#include "fuzzengine.h"
+#include <algorithm>
+#include <QDebug>
+#include "connections/canconmanager.h"
+
+FuzzEngine::FuzzEngine()
+{
+    qRegisterMetaType<FuzzPlan>("FuzzPlan");
+    mThread_p = new QThread();
+    mTimer = nullptr;
+    mPacedBase = 0;
+    mID = 0;
+    mIdx = 0;
+    mBitAccum = 0;
+    mSweepIdx = 0;
+    mSent.storeRelaxed(0);
+    mCurrentID.storeRelaxed(0);
+    mCurrentBytes.storeRelaxed(0);
+    mRate.storeRelaxed(0);
+    mRunning.storeRelaxed(0);
+}
+
+FuzzEngine::~FuzzEngine()
+{
+    mThread_p->quit();
+    mThread_p->wait();
+    delete mThread_p;
+}
+
+void FuzzEngine::piStart()
+{
+    mTimer = new QTimer();
+    mTimer->setTimerType(Qt::PreciseTimer);
+    connect(mTimer, &QTimer::timeout, this, &FuzzEngine::timerTriggered);
+}
+
+void FuzzEngine::piStop()
+{
+    mTimer->stop();
+    delete mTimer;
+    mTimer = nullptr;
+}
+
+void FuzzEngine::initialize()
+{
+    if( mThread_p && (mThread_p != QThread::currentThread()) )
+    {
+        moveToThread(mThread_p);
+        connect(mThread_p, SIGNAL(started()), this, SLOT(initialize()));
+        mThread_p->start(QThread::HighPriority);
+        return;
+    }
+
+    return piStart();
+}
+
+void FuzzEngine::finalize()
+{
+    if( mThread_p && (mThread_p != QThread::currentThread()) )
+    {
+        if( !mThread_p->isFinished() )
+        {
+            QMetaObject::invokeMethod(this, "finalize",
+                                      Qt::BlockingQueuedConnection);
+            mThread_p->quit();
+            if(!mThread_p->wait()) {
+                qDebug() << "can't stop thread";
+            }
+        }
+        return;
+    }
+
+    return piStop();
+}
+
+void FuzzEngine::setRate(int framesPerSecond)
+{
+    mRate.storeRelaxed(framesPerSecond);
+    if (isRunning()) QMetaObject::invokeMethod(this, "applyTimerInterval", Qt::QueuedConnection);
+}
+
+void FuzzEngine::startFuzzing(FuzzPlan plan)
+{
+    if( mThread_p && (mThread_p != QThread::currentThread()) ) {
+        QMetaObject::invokeMethod(this, "startFuzzing",
+                                  Qt::BlockingQueuedConnection,
+                                  Q_ARG(FuzzPlan, plan));
+        return;
+    }
+
+    mPlan = plan;
+    if (mPlan.batchSize < 1) mPlan.batchSize = 1;
+    if (mPlan.endID < mPlan.startID) std::swap(mPlan.startID, mPlan.endID);
+    mRandom.seed(mPlan.seed);
+    mIdx = 0;
+    mID = mPlan.startID;
+    if (!mPlan.useRange) mID = mPlan.ids.isEmpty() ? 0 : mPlan.ids[0];
+    if (mPlan.randomIDs) nextID();
+    mBitAccum = 0;
+    mSweepIdx = 0;
+    mBatch.clear();
+    mBatch.reserve(mPlan.batchSize * std::max(1, static_cast<int>(mPlan.buses.count())));
+
+    mSent.storeRelaxed(0);
+    mPacedBase = 0;
+    mRunning.storeRelaxed(1);
+    mElapsed.start();
+    applyTimerInterval();
+    mTimer->start();
+}
+
+void FuzzEngine::stopFuzzing()
+{
+    if( mThread_p && (mThread_p != QThread::currentThread()) ) {
+        QMetaObject::invokeMethod(this, "stopFuzzing",
+                                  Qt::BlockingQueuedConnection);
+        return;
+    }
+
+    mRunning.storeRelaxed(0);
+    mTimer->stop();
+}
+
+//unpaced runs go again as soon as the event loop is free, paced ones check in every millisecond
+void FuzzEngine::applyTimerInterval()
+{
+    if (!mTimer) return;
+    if (mRate.loadRelaxed() > 0)
+    {
+        mTimer->setInterval(1);
+        //pace from here on so a rate change doesn't try to catch up on the old one
+        mPacedBase = mSent.loadRelaxed();
+        mElapsed.restart();
+    }
+    else mTimer->setInterval(0);
+}
+
+void FuzzEngine::timerTriggered()
+{
+    if (!isRunning() || mPlan.buses.isEmpty()) return;
+    if (!mPlan.useRange && mPlan.ids.isEmpty()) return;
+
+    int perIteration = mPlan.buses.count();
+    quint64 sent = mSent.loadRelaxed();
+    qint64 due;
+    int rate = mRate.loadRelaxed();
+    if (rate > 0)
+    {
+        quint64 target = mPacedBase + static_cast<quint64>(mElapsed.nsecsElapsed() / 1000) * rate / 1000000;
+        due = (target > sent) ? static_cast<qint64>(target - sent) : 0;
+        //more than a second behind means the connection can't keep up. Don't try to make it up later in a burst
+        if (due > rate)
+        {
+            mPacedBase = sent;
+            mElapsed.restart();
+            due = rate;
+        }
+        if (due > FUZZ_MAX_FRAMES_PER_TICK) due = FUZZ_MAX_FRAMES_PER_TICK;
+    }
+    else due = static_cast<qint64>(mPlan.batchSize) * perIteration;
+
+    int iterations = static_cast<int>((due + perIteration - 1) / perIteration);
+    if (iterations == 0) return;
+
+    const QVector<int> &buses = mPlan.buses;
+    CANFrame frame;
+    QByteArray bytes;
+    while (iterations > 0)
+    {
+        int thisBatch = std::min(iterations, mPlan.batchSize);
+        mBatch.clear();
+        for (int count = 0; count < thisBatch; count++)
+        {
+            fillPattern(bytes);
+            frame.setFrameId(mID);
+            frame.setPayload(bytes);
+            frame.setExtendedFrameFormat(mID > 0x7FF);
+            for (int bus : buses)
+            {
+                frame.bus = bus;
+                mBatch.append(frame);
+            }
+            nextID();
+            advancePattern();
+        }
+        CANConManager::getInstance()->sendFrames(mBatch, TX_BULK);
+        iterations -= thisBatch;
+
+        quint64 shown = 0;
+        for (int i = 0; i < std::min(8, static_cast<int>(bytes.length())); i++)
+            shown |= static_cast<quint64>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        mCurrentBytes.storeRelaxed(shown);
+        mCurrentID.storeRelaxed(frame.frameId());
+        mSent.fetchAndAddRelaxed(static_cast<quint64>(mBatch.count()));
+    }
+}
+
+void FuzzEngine::nextID()
+{
+    if (mPlan.useRange)
+    {
+        if (mPlan.randomIDs)
+        {
+            quint32 range = mPlan.endID - mPlan.startID + 1;
+            mID = (range > 1) ? mPlan.startID + mRandom.bounded(range) : mPlan.startID;
+        }
+        else
+        {
+            mID++;
+            if (mID > mPlan.endID || mID < mPlan.startID) mID = mPlan.startID;
+        }
+    }
+    else
+    {
+        if (mPlan.ids.isEmpty()) return;
+        if (mPlan.randomIDs) mIdx = static_cast<int>(mRandom.bounded(static_cast<quint32>(mPlan.ids.count())));
+        else if (++mIdx >= mPlan.ids.count()) mIdx = 0;
+        mID = mPlan.ids[mIdx];
+    }
+}
+
+//the always set bits plus whichever fuzzed bits the current step turns on
+void FuzzEngine::fillPattern(QByteArray &bytes)
+{
+    bytes = mPlan.baseBytes;
+    char *data = bytes.data();
+    int numFuzz = mPlan.fuzzBits.count();
+    if (numFuzz == 0) return;
+
+    switch (mPlan.bitSequenceType)
+    {
+    case BitSequenceType::Sequential:
+        //the counter covers the first 64 fuzzed bits, which is already more steps than anyone will wait for
+        for (int k = 0; k < std::min(numFuzz, 64); k++)
+        {
+            if ((mBitAccum >> k) & 1) data[mPlan.fuzzBits[k] >> 3] |= static_cast<char>(1 << (mPlan.fuzzBits[k] & 7));
+        }
+        break;
+    case BitSequenceType::Sweeping:
+        data[mPlan.fuzzBits[mSweepIdx] >> 3] |= static_cast<char>(1 << (mPlan.fuzzBits[mSweepIdx] & 7));
+        break;
+    case BitSequenceType::Random:
+    {
+        quint64 word = 0;
+        for (int k = 0; k < numFuzz; k++)
+        {
+            if ((k & 63) == 0) word = mRandom.generate64();
+            if ((word >> (k & 63)) & 1) data[mPlan.fuzzBits[k] >> 3] |= static_cast<char>(1 << (mPlan.fuzzBits[k] & 7));
+        }
+        break;
+    }
+    }
+}
+
+void FuzzEngine::advancePattern()
+{
+    int numFuzz = mPlan.fuzzBits.count();
+    if (numFuzz == 0) return;
+
+    switch (mPlan.bitSequenceType)
+    {
+    case BitSequenceType::Sequential:
+        mBitAccum++;
+        if (numFuzz < 64) mBitAccum &= ((1ull << numFuzz) - 1);
+        break;
+    case BitSequenceType::Sweeping:
+        if (++mSweepIdx >= numFuzz) mSweepIdx = 0;
+        break;
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef FUZZENGINE_H
+#define FUZZENGINE_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include "can_structs.h"
+
+//most frames handed to the connections in one timer tick, so a stop request never waits long
+#define FUZZ_MAX_FRAMES_PER_TICK    5000
+
+namespace BitSequenceType
+{
+    enum
+    {
+        Sequential,
+        Sweeping,
+        Random
+    };
+}
+
+/*
+ * Everything the engine needs for a run, worked out once by the window when fuzzing starts so the
+ * sending thread never touches the GUI. The bit grid boils down to the bytes that are always set
+ * plus the positions of the bits being fuzzed, in order.
+ */
+struct FuzzPlan
+{
+    bool useRange = true; //start/end ID range, otherwise ids
+    bool randomIDs = false;
+    quint32 startID = 0;
+    quint32 endID = 0;
+    QVector<quint32> ids;
+    int bitSequenceType = BitSequenceType::Sequential;
+    QByteArray baseBytes; //always set bits, also sets the number of data bytes
+    QVector<int> fuzzBits;
+    QVector<int> buses; //every iteration goes out once on each of these
+    quint32 seed = 0;
+    int batchSize = 1;
+};
+Q_DECLARE_METATYPE(FuzzPlan)
+
+/*
+ * Generates and sends fuzzing frames on its own thread, in batches through CANConManager::sendFrames.
+ * The rate is frames per second across all target buses. Zero means no pacing at all, the connections'
+ * blocking sendFrames is what holds it back, which ends up being about what the bus will take.
+ *
+ * The window never gets called back, it reads sentFrames(), currentID() and currentBytes() whenever it
+ * wants to show progress.
+ */
+class FuzzEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    FuzzEngine();
+    ~FuzzEngine();
+
+    quint64 sentFrames() const { return mSent.loadRelaxed(); }
+    quint32 currentID() const { return mCurrentID.loadRelaxed(); }
+    //first 8 data bytes of the most recent frame, byte 0 in the low bits
+    quint64 currentBytes() const { return mCurrentBytes.loadRelaxed(); }
+    bool isRunning() const { return mRunning.loadRelaxed() != 0; }
+    //can be changed while running
+    void setRate(int framesPerSecond);
+
+public slots:
+    void initialize();
+    void finalize();
+
+    void startFuzzing(FuzzPlan plan);
+    void stopFuzzing();
+
+private slots:
+    void timerTriggered();
+    void applyTimerInterval();
+
+private:
+    FuzzPlan mPlan;
+    QRandomGenerator mRandom;
+    QTimer *mTimer;
+    QThread *mThread_p;
+    QElapsedTimer mElapsed;
+    quint64 mPacedBase; //frames already accounted for by the pacing when mElapsed was last restarted
+    quint32 mID;
+    int mIdx;
+    quint64 mBitAccum;
+    int mSweepIdx;
+    QList<CANFrame> mBatch;
+
+    QAtomicInteger<quint64> mSent;
+    QAtomicInteger<quint32> mCurrentID;
+    QAtomicInteger<quint64> mCurrentBytes;
+    QAtomicInteger<int> mRate;
+    QAtomicInteger<int> mRunning;
+
+    void piStart();
+    void piStop();
+    void nextID();
+    void fillPattern(QByteArray &bytes);
+    void advancePattern();
+};
+
+#endif // FUZZENGINE_H
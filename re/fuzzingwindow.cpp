@@ -3,12 +3,14 @@
 #include "utility.h"
 #include <QDebug>
 #include <QRandomGenerator>
+#include <QMessageBox>
 #include "mainwindow.h"
 #include "helpwindow.h"
 #include "connections/canconmanager.h"
 #include "filterutility.h"
+#include "pipelinetrace.h"
 
-FuzzingWindow::FuzzingWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+FuzzingWindow::FuzzingWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::FuzzingWindow)
 {
@@ -17,13 +19,16 @@ FuzzingWindow::FuzzingWindow(const QVector<CANFrame> *frames, QWidget *parent) :
 
     modelFrames = frames;
 
-    fuzzTimer = new QTimer();
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(250);
+    engine = new FuzzEngine();
+    engine->initialize();
 
     connect(ui->btnStartStop, &QPushButton::clicked, this, &FuzzingWindow::toggleFuzzing);
     connect(ui->btnAllFilters, &QPushButton::clicked, this, &FuzzingWindow::setAllFilters);
     connect(ui->btnNoFilters, &QPushButton::clicked, this, &FuzzingWindow::clearAllFilters);
-    connect(fuzzTimer, &QTimer::timeout, this, &FuzzingWindow::timerTriggered);
-    connect(ui->spinTiming, SIGNAL(valueChanged(int)), this, SLOT(changePlaybackSpeed(int)));
+    connect(progressTimer, &QTimer::timeout, this, &FuzzingWindow::updateProgress);
+    connect(ui->spinRate, SIGNAL(valueChanged(int)), this, SLOT(changeRate(int)));
     connect(ui->listID, &QListWidget::itemChanged, this, &FuzzingWindow::idListChanged);
     connect(ui->spinBytes, SIGNAL(valueChanged(int)), this, SLOT(changedNumDataBytes(int)));
     connect(ui->bitfield, SIGNAL(gridClicked(int)), this, SLOT(bitfieldClicked(int)));
@@ -37,7 +42,12 @@ FuzzingWindow::FuzzingWindow(const QVector<CANFrame> *frames, QWidget *parent) :
     connect(ui->txtByte7, &QLineEdit::returnPressed, this, [=](){changedDataByteText(7, ui->txtByte7->text());});
 
 
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    FrameBus::Options subscription;
+    subscription.delivery = FrameBus::LATEST_PER_ID;
+    //after a reset whatever the frame list holds now comes through as new frames and fills the list back in
+    MainWindow::getReference()->getFrameBus()->subscribe(this, subscription,
+        [this](const QVector<CANFrame> &frames) { gotFrames(frames); },
+        [this](FrameBus::ResetReason) { ui->listID->clear(); foundIDs.clear(); });
 
     refreshIDList();
 
@@ -45,11 +55,8 @@ FuzzingWindow::FuzzingWindow(const QVector<CANFrame> *frames, QWidget *parent) :
 
     for (int j = 0; j < 512; j++) bitGrid[j] = 1;
     numBits = 64;
-    bitAccum = 0;
     redrawGrid();
 
-    fuzzTimer->setInterval(ui->spinTiming->value());
-
     int numBuses = CANConManager::getInstance()->getNumBuses();
     for (int n = 0; n < numBuses; n++) ui->cbBuses->addItem(QString::number(n));
     ui->cbBuses->addItem(tr("All"));
@@ -63,6 +70,9 @@ FuzzingWindow::FuzzingWindow(const QVector<CANFrame> *frames, QWidget *parent) :
 FuzzingWindow::~FuzzingWindow()
 {
     removeEventFilter(this);
+    engine->stopFuzzing();
+    engine->finalize();
+    delete engine;
     delete ui;
 }
 
@@ -84,40 +94,32 @@ bool FuzzingWindow::eventFilter(QObject *obj, QEvent *event)
     return false;
 }
 
-void FuzzingWindow::updatedFrames(int numFrames)
+//only new IDs matter here so the frame bus hands over just the newest frame of each ID that showed up
+void FuzzingWindow::gotFrames(const QVector<CANFrame> &frames)
 {
+    TRACE_SCOPE("FuzzingWindow::gotFrames");
     int id;
-    if (numFrames == -1) //all frames deleted. Kill the display
-    {
-        ui->listID->clear();
-        foundIDs.clear();
-        refreshIDList();
-    }
-    else if (numFrames == -2) //all new set of frames. Reset
+    for (const CANFrame &frame : frames)
     {
-        ui->listID->clear();
-        foundIDs.clear();
-        refreshIDList();
-    }
-    else //just got some new frames. See if they are relevant.
-    {
-        if (numFrames > modelFrames->count()) return;
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        id = frame.frameId();
+        if (!foundIDs.contains(id))
         {
-            id = modelFrames->at(i).frameId();
-            if (!foundIDs.contains(id))
-            {
-                foundIDs.append(id);
-                selectedIDs.append(id);
-                FilterUtility::createCheckableFilterItem(id, true, ui->listID);
-            }
+            foundIDs.append(id);
+            selectedIDs.append(id);
+            FilterUtility::createCheckableFilterItem(id, true, ui->listID);
         }
     }
 }
 
-void FuzzingWindow::changePlaybackSpeed(int newSpeed)
+void FuzzingWindow::changeRate(int newRate)
 {
-    fuzzTimer->setInterval(newSpeed);
+    if (!currentlyFuzzing) return;
+    QVector<int> buses;
+    int sel = ui->cbBuses->currentIndex();
+    if (sel < (ui->cbBuses->count() - 1)) buses.append(sel);
+    else for (int j = 0; j < ui->cbBuses->count() - 1; j++) buses.append(j);
+    int limit = busFrameLimit(buses, ui->spinBytes->value());
+    engine->setRate((newRate == 0 || (limit > 0 && newRate > limit)) ? limit : newRate);
 }
 
 void FuzzingWindow::changedDataByteText(int which, QString valu)
@@ -165,54 +167,14 @@ void FuzzingWindow::changedNumDataBytes(int newVal)
     redrawGrid();
 }
 
-void FuzzingWindow::timerTriggered()
+//The engine never calls back, four times a second we just look at where it has got to
+void FuzzingWindow::updateProgress()
 {
-    static uint64_t lastByteUpdate = 0;
-    CANFrame thisFrame;
-    sendingBuffer.clear();
-    //Every 250ms update the text fields to show our progress and what's going on.
-    if (QDateTime::currentMSecsSinceEpoch() - lastByteUpdate > 250)
-    {
-        ui->txtByte0->setText(QString::number(currentBytes[0], 16));
-        ui->txtByte1->setText(QString::number(currentBytes[1], 16));
-        ui->txtByte2->setText(QString::number(currentBytes[2], 16));
-        ui->txtByte3->setText(QString::number(currentBytes[3], 16));
-        ui->txtByte4->setText(QString::number(currentBytes[4], 16));
-        ui->txtByte5->setText(QString::number(currentBytes[5], 16));
-        ui->txtByte6->setText(QString::number(currentBytes[6], 16));
-        ui->txtByte7->setText(QString::number(currentBytes[7], 16));
-    }
-    int buses = ui->cbBuses->currentIndex();
-    for (int count = 0; count < ui->spinBurst->value(); count++)
-    {
-        thisFrame.setFrameId(currentID);
-        QByteArray bytes(ui->spinBytes->value(), 0);
-        for (int i = 0; i < bytes.length(); i++) bytes[i] = currentBytes[i];
-        thisFrame.setPayload(bytes);
-        if (currentID > 0x7FF) thisFrame.setExtendedFrameFormat(true);
-        else thisFrame.setExtendedFrameFormat(false);
-        thisFrame.bus = 0; //hard coded for now. TODO: do not hard code        
-
-        if (buses < (ui->cbBuses->count() - 1))
-        {
-            thisFrame.bus = buses;
-            sendingBuffer.append(thisFrame);
-        }
-        else //fuzz all the buses! HACK THE PLANET! Er, something...
-        {
-            for (int j = 0; j < ui->cbBuses->count() - 1; j++)
-            {
-                thisFrame.bus = j;
-                sendingBuffer.append(thisFrame);
-            }
-        }
-
-        calcNextID();
-        calcNextBitPattern();
-        numSentFrames++;
-    }
-    CANConManager::getInstance()->sendFrames(sendingBuffer);
-    ui->lblNumFrames->setText("# of sent frames: " + QString::number(numSentFrames));
+    quint64 bytes = engine->currentBytes();
+    QLineEdit *byteEdits[8] = {ui->txtByte0, ui->txtByte1, ui->txtByte2, ui->txtByte3,
+                               ui->txtByte4, ui->txtByte5, ui->txtByte6, ui->txtByte7};
+    for (int i = 0; i < 8; i++) byteEdits[i]->setText(QString::number((bytes >> (8 * i)) & 0xFF, 16));
+    ui->lblNumFrames->setText("# of sent frames: " + QString::number(engine->sentFrames()));
 }
 
 void FuzzingWindow::clearAllFilters()
@@ -231,111 +193,97 @@ void FuzzingWindow::setAllFilters()
     }
 }
 
-void FuzzingWindow::calcNextID()
+/*
+ * Bus capacity in frames per second for the slowest of the target buses, split between them since
+ * every iteration goes out on all of them. Worst case bit stuffing on an extended ID frame, so it's
+ * a little under what the bus can really do. Returns 0 (no pacing) if no bus speed is known.
+*/
+int FuzzingWindow::busFrameLimit(const QVector<int> &buses, int numBytes)
 {
-    if (seqIDScan)
+    QList<CANConnection*> &conns = CANConManager::getInstance()->getConnections();
+    double slowest = 0.0;
+    for (int bus : buses)
     {
-        if (rangeIDSelect)
+        int busBase = 0;
+        for (CANConnection *conn : conns)
         {
-            currentID++;
-            if (currentID > endID) currentID = startID;
-        }
-        else //IDs by filter. So, select the first filter
-        {
-            currentIdx++;
-            if (currentIdx >= selectedIDs.length()) currentIdx = 0;
-            currentID = selectedIDs[currentIdx];
-            qDebug() << "idx id: " << currentID;
+            if (bus < busBase + conn->getNumBuses())
+            {
+                CANBus settings;
+                if (conn->getBusSettings(bus - busBase, settings) && settings.getSpeed() > 0)
+                {
+                    //arbitration, control and CRC at the nominal speed, the data at the data rate on FD buses
+                    double dataSpeed = (numBytes > 8 && settings.getDataRate() > 0) ? settings.getDataRate() : settings.getSpeed();
+                    double frameTime = (67.0 * 1.2) / settings.getSpeed() + (8.0 * numBytes * 1.2) / dataSpeed;
+                    double frames = 1.0 / frameTime;
+                    if (slowest == 0.0 || frames < slowest) slowest = frames;
+                }
+                break;
+            }
+            busBase += conn->getNumBuses();
         }
     }
-    else //random IDs
+    if (slowest == 0.0) return 0;
+    return std::max(1, static_cast<int>(slowest) * static_cast<int>(buses.count()));
+}
+
+/*
+ * Turns the window settings into a FuzzPlan. The bit grid becomes the always set bytes plus the
+ * list of bit positions to fuzz so the engine never has to look at the grid itself.
+*/
+bool FuzzingWindow::buildPlan(FuzzPlan &plan)
+{
+    plan.useRange = ui->rbRangeIDSel->isChecked();
+    plan.randomIDs = !ui->rbSequentialID->isChecked();
+    plan.startID = static_cast<quint32>(Utility::ParseStringToNum(ui->txtStartID->text()));
+    plan.endID = static_cast<quint32>(Utility::ParseStringToNum(ui->txtEndID->text()));
+    plan.ids.clear();
+    if (!plan.useRange)
     {
-        if (rangeIDSelect)
-        {
-            int range = endID - startID + 1;
-            if (range != 1) currentID = startID + QRandomGenerator::global()->bounded(range);
-            else currentID = startID;
-        }
-        else //IDs by filter so pick a random selected ID from the filter list
+        for (int id : qAsConst(selectedIDs)) plan.ids.append(static_cast<quint32>(id));
+        if (plan.ids.isEmpty())
         {
-            currentIdx = QRandomGenerator::global()->bounded(selectedIDs.length());
-            currentID = selectedIDs[currentIdx];
+            QMessageBox::warning(this, tr("Fuzzing"), tr("No IDs are selected in the filter list."));
+            return false;
         }
     }
-}
 
-void FuzzingWindow::calcNextBitPattern()
-{
-    uint64_t accum;
+    if (ui->rbRandomBits->isChecked()) plan.bitSequenceType = BitSequenceType::Random;
+    else if (ui->rbSweep->isChecked()) plan.bitSequenceType = BitSequenceType::Sweeping;
+    else plan.bitSequenceType = BitSequenceType::Sequential;
 
-    switch (bitSequenceType)
+    int numBytes = ui->spinBytes->value();
+    plan.baseBytes = QByteArray(numBytes, 0);
+    plan.fuzzBits.clear();
+    for (int i = 0; i < numBytes * 8; i++)
     {
-    case BitSequenceType::Random:
-        int thisBit;
-        for (int byt = 0; byt < ui->spinBytes->value(); byt++)
-        {
-            currentBytes[byt] = 0;
-            for (int bit = 0; bit < 8; bit++)
-            {
-                thisBit = bitGrid[byt * 8 + bit];
-                if (thisBit == 1)
-                {
-                    if ((QRandomGenerator::global()->bounded(2)) == 1) currentBytes[byt] |= (1 << bit);
-                }
-                if (thisBit == 2) currentBytes[byt] |= (1 << bit);
-            }
-        }
-        break;
-    case BitSequenceType::Sequential:
-        bitAccum++;
-        bitAccum &= ((1 << numBits) - 1);
-        accum = bitAccum;
-        for (int byt = 0; byt < ui->spinBytes->value(); byt++)
-        {
-            currentBytes[byt] = 0;
-            for (int bit = 0; bit < 8; bit++)
-            {
-                thisBit = bitGrid[byt * 8 + bit];
-                if (thisBit == 1)
-                {
-                    if (accum & 1) currentBytes[byt] |= (1 << bit);
-                    accum >>= 1;
-                }
-                if (thisBit == 2) currentBytes[byt] |= (1 << bit);
-            }
-        }
-        break;
-    case BitSequenceType::Sweeping:
-        qDebug() << "Start " << bitAccum;
-        accum = bitAccum;
+        if (bitGrid[i] == 1) plan.fuzzBits.append(i);
+        else if (bitGrid[i] == 2) plan.baseBytes[i / 8] = static_cast<char>(plan.baseBytes[i / 8] | (1 << (i % 8)));
+    }
 
-        int offset;
-        for (int i = 1; i < 64; i++)
-        {
-            offset = (i + bitAccum) % 64;
-            if (bitGrid[offset] == 1)
-            {
-                bitAccum = offset;
-                qDebug() << "End " << bitAccum;
-                break;
-            }
-        }
+    plan.buses.clear();
+    int sel = ui->cbBuses->currentIndex();
+    if (sel < (ui->cbBuses->count() - 1)) plan.buses.append(sel);
+    else //fuzz all the buses! HACK THE PLANET! Er, something...
+    {
+        for (int j = 0; j < ui->cbBuses->count() - 1; j++) plan.buses.append(j);
+    }
+    if (plan.buses.isEmpty())
+    {
+        QMessageBox::warning(this, tr("Fuzzing"), tr("There are no buses to send on."));
+        return false;
+    }
 
-        for (int byt = 0; byt < ui->spinBytes->value(); byt++)
-        {
-            currentBytes[byt] = 0;
-            for (int bit = 0; bit < 8; bit++)
-            {
-                thisBit = bitGrid[byt * 8 + bit];
-                if ( (thisBit == 1) && (unsigned int)(byt * 8 + bit) == bitAccum)
-                {
-                    currentBytes[byt] |= (1 << bit);
-                }
-                if (thisBit == 2) currentBytes[byt] |= (1 << bit);
-            }
-        }
-        break;
+    //a blank seed gets a fresh one, shown as the placeholder so a run worth repeating can be
+    QString seedText = ui->txtSeed->text().trimmed();
+    if (!seedText.isEmpty()) plan.seed = static_cast<quint32>(Utility::ParseStringToNum(seedText));
+    else
+    {
+        plan.seed = QRandomGenerator::global()->generate();
+        ui->txtSeed->setPlaceholderText(tr("Last run: 0x") + QString::number(plan.seed, 16).toUpper());
     }
+    plan.batchSize = ui->spinBurst->value();
+    return true;
 }
 
 void FuzzingWindow::toggleFuzzing()
@@ -344,69 +292,20 @@ void FuzzingWindow::toggleFuzzing()
     {
         ui->btnStartStop->setText("Start Fuzzing");
         currentlyFuzzing = false;
-        fuzzTimer->stop();
+        engine->stopFuzzing();
+        progressTimer->stop();
+        updateProgress();
     }
     else //start it then
     {
+        FuzzPlan plan;
+        if (!buildPlan(plan)) return;
+
         ui->btnStartStop->setText("Stop Fuzzing");
         currentlyFuzzing = true;
-
-        startID = Utility::ParseStringToNum(ui->txtStartID->text());
-        endID = Utility::ParseStringToNum(ui->txtEndID->text());
-
-        seqIDScan = ui->rbSequentialID->isChecked();
-        rangeIDSelect = ui->rbRangeIDSel->isChecked();
-        if (ui->rbSequentialBits->isChecked()) bitSequenceType = BitSequenceType::Sequential;
-        if (ui->rbRandomBits->isChecked())
-        {
-            bitSequenceType = BitSequenceType::Random;
-            bitAccum = 0;
-        }
-        if (ui->rbSweep->isChecked())
-        {
-            bitSequenceType = BitSequenceType::Sweeping;
-            for (int i = 0; i < 64; i++)
-            {
-                if (bitGrid[i] == 1)
-                {
-                    bitAccum = i;
-                    break;
-                }
-            }
-        }
-
-        numSentFrames = 0;
-
-        if (seqIDScan)
-        {
-            if (rangeIDSelect)
-            {
-                currentID = startID;
-            }
-            else //IDs by filter. So, select the first filter
-            {
-                currentIdx = 0;
-                currentID = selectedIDs[currentIdx];
-            }
-        }
-        else //random IDs
-        {
-            if (rangeIDSelect)
-            {
-                int range = endID - startID;
-                if (range != 0) currentID = startID + QRandomGenerator::global()->bounded(range);
-                else currentID = startID;
-            }
-            else //IDs by filter so pick a random selected ID from the filter list
-            {
-                currentIdx = QRandomGenerator::global()->bounded(selectedIDs.length());
-                currentID = selectedIDs[currentIdx];
-            }
-        }
-
-        calcNextBitPattern();
-
-        fuzzTimer->start();
+        changeRate(ui->spinRate->value());
+        engine->startFuzzing(plan);
+        progressTimer->start();
     }
 }
 
@@ -416,10 +315,9 @@ void FuzzingWindow::refreshIDList()
     foundIDs.clear();
 
     int id;
-    for (int i = 0; i < modelFrames->count(); i++)
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
     {
-        CANFrame thisFrame = modelFrames->at(i);
-        id = thisFrame.frameId();
+        id = info.id;
         if (!foundIDs.contains(id))
         {
             foundIDs.append(id);
@@ -5,27 +5,19 @@
 #include <QListWidget>
 #include <QTimer>
 #include "can_structs.h"
+#include "canframestore.h"
+#include "fuzzengine.h"
 
 namespace Ui {
 class FuzzingWindow;
 }
 
-namespace BitSequenceType
-{
-    enum
-    {
-        Sequential,
-        Sweeping,
-        Random
-    };
-}
-
 class FuzzingWindow : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit FuzzingWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit FuzzingWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~FuzzingWindow();
 
 signals:
@@ -33,36 +25,30 @@ signals:
     void sendFrameBatch(const QList<CANFrame> *);
 
 private slots:
-    void changePlaybackSpeed(int newSpeed);
-    void timerTriggered();
+    void changeRate(int newRate);
+    void updateProgress();
     void clearAllFilters();
     void setAllFilters();
     void toggleFuzzing();
     void idListChanged(QListWidgetItem *item);
     void bitfieldClicked(int);
     void changedNumDataBytes(int newVal);
-    void updatedFrames(int numFrames);
 
 private:
     Ui::FuzzingWindow *ui;
-    const QVector<CANFrame> *modelFrames;
-    QTimer *fuzzTimer;
+    const CANFrameStore *modelFrames;
+    QTimer *progressTimer;
+    FuzzEngine *engine;
     QList<int> foundIDs;
     QList<int> selectedIDs;
-    QList<CANFrame> sendingBuffer;
-    int startID, endID, currentID, currentIdx;
-    bool seqIDScan, rangeIDSelect;
-    int bitSequenceType;
     bool currentlyFuzzing;
-    uint8_t currentBytes[64];
     uint8_t bitGrid[512];
-    uint8_t numBits;
-    uint64_t bitAccum;
-    int numSentFrames;
+    int numBits;
 
     void refreshIDList();
-    void calcNextID();
-    void calcNextBitPattern();
+    void gotFrames(const QVector<CANFrame> &frames);
+    bool buildPlan(FuzzPlan &plan);
+    int busFrameLimit(const QVector<int> &buses, int numBytes);
     void redrawGrid();
     bool eventFilter(QObject *obj, QEvent *event);
     void changedDataByteText(int which, QString valu);
@@ -0,0 +1,181 @@
+#include "graphexport.h"
+#include "utility.h"
+
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+void GraphExport::addSeries(const QString &name, const GraphSamples &samples)
+{
+    Series s;
+    s.name = name;
+    s.samples = samples;
+    s.cursor = -1;
+    if (!samples.isEmpty()) series.append(s);
+}
+
+bool GraphExport::write(QIODevice &out, Format format)
+{
+    for (int k = 0; k < series.count(); k++) series[k].cursor = -1;
+    text.clear();
+    columns.clear();
+    if (!writeHeader(out, format)) return false;
+
+    if (rowStep > 0.0)
+    {
+        double first = std::numeric_limits<double>::max();
+        double last = -std::numeric_limits<double>::max();
+        for (const Series &s : series)
+        {
+            first = std::min(first, s.samples.firstX());
+            last = std::max(last, s.samples.lastX());
+        }
+        //counting steps instead of adding rowStep each time so long exports don't drift
+        for (qint64 j = 0; !series.isEmpty(); j++)
+        {
+            double time = first + j * rowStep;
+            if (time > last) break;
+            for (int k = 0; k < series.count(); k++) advance(series[k], time);
+            if (!writeRow(out, format, time)) return false;
+        }
+    }
+    else
+    {
+        //min heap of each series' next sample time. Equal times from several series make one row
+        typedef std::pair<double, int> Next;
+        std::priority_queue<Next, std::vector<Next>, std::greater<Next>> heap;
+        for (int k = 0; k < series.count(); k++) heap.push(Next(series[k].samples.firstX(), k));
+
+        while (!heap.empty())
+        {
+            double time = heap.top().first;
+            while (!heap.empty() && heap.top().first == time)
+            {
+                int k = heap.top().second;
+                heap.pop();
+                Series &s = series[k];
+                advance(s, time);
+                if (s.cursor + 1 < s.samples.count()) heap.push(Next(s.samples.x(s.cursor + 1), k));
+            }
+            if (!writeRow(out, format, time)) return false;
+        }
+    }
+    return finish(out, format);
+}
+
+//moves the cursor up to the last sample at or before time. Rows only ever go forward so this is amortized O(1)
+void GraphExport::advance(Series &s, double time) const
+{
+    while (s.cursor + 1 < s.samples.count() && s.samples.x(s.cursor + 1) <= time) s.cursor++;
+}
+
+double GraphExport::valueAt(const Series &s, double time) const
+{
+    int c = s.cursor;
+    if (c < 0) return s.samples.y(0); //row is before this graph starts
+    if (c == s.samples.count() - 1 || s.samples.x(c) == time) return s.samples.y(c);
+    double span = s.samples.x(c + 1) - s.samples.x(c);
+    if (span <= 0.0) return s.samples.y(c);
+    return Utility::Lerp(s.samples.y(c), s.samples.y(c + 1), (time - s.samples.x(c)) / span);
+}
+
+bool GraphExport::writeHeader(QIODevice &out, Format format)
+{
+    if (format == CSV)
+    {
+        text.append("TimeStamp");
+        for (const Series &s : series)
+        {
+            text.append(',');
+            text.append(s.name.toUtf8());
+        }
+        text.append('\n');
+        return true;
+    }
+
+    QByteArray header("SVCAND01", 8);
+    uchar word[4];
+    qToLittleEndian<quint32>(static_cast<quint32>(series.count() + 1), word);
+    header.append(reinterpret_cast<const char *>(word), 4);
+    QStringList names;
+    names.append("TimeStamp");
+    for (const Series &s : series) names.append(s.name);
+    for (const QString &name : names)
+    {
+        QByteArray utf = name.toUtf8();
+        qToLittleEndian<quint32>(static_cast<quint32>(utf.size()), word);
+        header.append(reinterpret_cast<const char *>(word), 4);
+        header.append(utf);
+    }
+    columns.resize(series.count() + 1);
+    for (int c = 0; c < columns.count(); c++) columns[c].reserve(GRAPHEXPORT_GROUP_ROWS);
+    return out.write(header) == header.size();
+}
+
+bool GraphExport::writeRow(QIODevice &out, Format format, double time)
+{
+    if (format == CSV)
+    {
+        text.append(QByteArray::number(time, 'f'));
+        for (const Series &s : series)
+        {
+            text.append(',');
+            text.append(QByteArray::number(valueAt(s, time)));
+        }
+        text.append('\n');
+        if (text.size() < GRAPHEXPORT_FLUSH_BYTES) return true;
+        bool ok = out.write(text) == text.size();
+        text.clear();
+        return ok;
+    }
+
+    columns[0].append(time);
+    for (int k = 0; k < series.count(); k++) columns[k + 1].append(valueAt(series[k], time));
+    if (columns[0].count() < GRAPHEXPORT_GROUP_ROWS) return true;
+    return flushGroup(out);
+}
+
+bool GraphExport::flushGroup(QIODevice &out)
+{
+    int rows = columns.isEmpty() ? 0 : columns[0].count();
+    if (rows == 0) return true;
+
+    QByteArray group;
+    group.resize(4 + rows * 8 * columns.count());
+    uchar *ptr = reinterpret_cast<uchar *>(group.data());
+    qToLittleEndian<quint32>(static_cast<quint32>(rows), ptr);
+    ptr += 4;
+    for (int c = 0; c < columns.count(); c++)
+    {
+        for (int r = 0; r < rows; r++)
+        {
+            quint64 bits;
+            memcpy(&bits, &columns[c][r], 8);
+            qToLittleEndian<quint64>(bits, ptr);
+            ptr += 8;
+        }
+        columns[c].clear();
+    }
+    return out.write(group) == group.size();
+}
+
+bool GraphExport::finish(QIODevice &out, Format format)
+{
+    if (format == CSV)
+    {
+        bool ok = out.write(text) == text.size();
+        text.clear();
+        return ok;
+    }
+
+    if (!flushGroup(out)) return false;
+    uchar word[4];
+    qToLittleEndian<quint32>(0, word);
+    columns.clear();
+    return out.write(reinterpret_cast<const char *>(word), 4) == 4;
+}
@@ -0,0 +1,65 @@
+#ifndef GRAPHEXPORT_H
+#define GRAPHEXPORT_H
+
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+#include "graphsamples.h"
+
+//rows held per column before a row group of the columnar format gets written out
+#define GRAPHEXPORT_GROUP_ROWS      16384
+//CSV text gets collected up to about this many bytes before it goes to the file
+#define GRAPHEXPORT_FLUSH_BYTES     (1 << 20)
+
+/*
+ * Writes a set of graphs out as one table with a row per time step and a column per graph. Rows are produced one
+ * at a time by a k-way merge walking a cursor down each graph's (time sorted) samples, so nothing but the current
+ * row and a small output buffer are ever held no matter how many graphs or samples there are.
+ *
+ * With no rate set there's a row for every distinct sample time of any graph. With a rate there's a row every
+ * 1 / rate (in the graphs' X units) from the earliest sample to the latest. A graph that has no sample right at a
+ * row's time gets the value interpolated between its neighbours, or its first / last value off either end.
+ *
+ * The columnar format is for loading into analysis tools without parsing text. All little endian:
+ *   "SVCAND01"                          8 byte magic
+ *   uint32 column count                 the time column plus one per graph
+ *   per column: uint32 length, UTF-8 name
+ *   row groups, each: uint32 rows (never 0) then for each column in order that many float64 values
+ *   uint32 0                            end marker
+ */
+class GraphExport
+{
+public:
+    enum Format
+    {
+        CSV,
+        Columnar
+    };
+
+    //the samples are implicitly shared so this doesn't copy them
+    void addSeries(const QString &name, const GraphSamples &samples);
+    void setRowStep(double step) { rowStep = step; } //0 = a row at every sample time
+    bool write(QIODevice &out, Format format);
+
+private:
+    struct Series
+    {
+        QString name;
+        GraphSamples samples;
+        int cursor; //last sample at or before the current row, -1 before the first
+    };
+
+    double valueAt(const Series &s, double time) const;
+    void advance(Series &s, double time) const;
+    bool writeHeader(QIODevice &out, Format format);
+    bool writeRow(QIODevice &out, Format format, double time);
+    bool finish(QIODevice &out, Format format);
+    bool flushGroup(QIODevice &out);
+
+    QVector<Series> series;
+    double rowStep = 0.0;
+    QByteArray text;
+    QVector<QVector<double>> columns; //time first, then one per series. Only for Columnar
+};
+
+#endif // GRAPHEXPORT_H
@@ -2,14 +2,39 @@
 #include "ui_graphingwindow.h"
 #include "newgraphdialog.h"
 #include "mainwindow.h"
+#include "windowupdategate.h"
 #include "helpwindow.h"
 #include "utility.h"
+#include "graphexport.h"
+#include "replotscheduler.h"
+#include "offscreenplot.h"
+#include "pipelinetrace.h"
 #include <QDebug>
 
+#include <QRunnable>
+#include <QThreadPool>
+
 #include <algorithm>
+#include <functional>
 #include <limits>
 
-GraphingWindow::GraphingWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+//fewest old samples worth taking off the front of a graph in live scope mode
+#define GRAPH_SCOPE_MIN_EVICT   1024
+
+namespace
+{
+//one graph's series being decoded on buildPool
+class GraphBuildTask : public QRunnable
+{
+public:
+    explicit GraphBuildTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() override { task(); }
+private:
+    std::function<void()> task;
+};
+}
+
+GraphingWindow::GraphingWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::GraphingWindow)
 {
@@ -77,13 +102,17 @@ GraphingWindow::GraphingWindow(const QVector<CANFrame> *frames, QWidget *parent)
     // make bottom and left axes transfer their ranges to top and right axes:
     connect(ui->graphingView->xAxis, SIGNAL(rangeChanged(QCPRange)), ui->graphingView->xAxis2, SLOT(setRange(QCPRange)));
     connect(ui->graphingView->yAxis, SIGNAL(rangeChanged(QCPRange)), ui->graphingView->yAxis2, SLOT(setRange(QCPRange)));
+    //pick the right level of detail out of each graph's pyramid whenever the visible time span moves
+    connect(ui->graphingView->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(xRangeChanged(QCPRange)));
 
     //connect(ui->graphingView, SIGNAL(titleDoubleClick(QMouseEvent*,QCPTextElement*)), this, SLOT(titleDoubleClick(QMouseEvent*,QCPTextElement*)));
     connect(ui->graphingView, SIGNAL(axisDoubleClick(QCPAxis*,QCPAxis::SelectablePart,QMouseEvent*)), this, SLOT(axisDoubleClick(QCPAxis*,QCPAxis::SelectablePart)));
     connect(ui->graphingView, SIGNAL(legendDoubleClick(QCPLegend*,QCPAbstractLegendItem*,QMouseEvent*)), this, SLOT(legendDoubleClick(QCPLegend*,QCPAbstractLegendItem*)));
     connect(ui->graphingView, SIGNAL(legendClick(QCPLegend*,QCPAbstractLegendItem*,QMouseEvent*)), this, SLOT(legendSingleClick(QCPLegend*,QCPAbstractLegendItem*)));
 
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    //the store has to hear about new frames before this window does so get it hooked up first
+    seriesStore = SignalSeriesStore::forFrames(modelFrames);
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
 
     // setup policy and connect slot for context menu popup:
     ui->graphingView->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -109,21 +138,61 @@ GraphingWindow::GraphingWindow(const QVector<CANFrame> *frames, QWidget *parent)
         ui->graphingView->setOpenGl(false);
         ui->graphingView->setAntialiasedElements(QCP::aeNone);
     }
+    OffscreenPlot::setup(ui->graphingView);
 
     needScaleSetup = true;
     followGraphEnd = false;
+    scopeMode = false;
+    scopeSeconds = 10.0;
+    lastBuildId = 0;
+    buildsCancelled = false;
 }
 
 GraphingWindow::~GraphingWindow()
 {
+    buildGeneration.ref(); //anything still running bails out at its next check
+    buildPool.clear();
+    buildPool.waitForDone();
+    for (int i = 0; i < graphParams.count(); i++) seriesStore->release(graphParams[i].series);
     delete ui;
 }
 
+//samples and the LOD per graph. The decoded series behind them belong to the shared store and are reported there
+void GraphingWindow::reportMemory(QVector<MemoryUsage> &out) const
+{
+    using MemoryAccounting::bytesOf;
+    QString owner = memoryOwner("Graphing Window");
+    for (const GraphParams &params : graphParams)
+        out.append({owner, params.graphName, params.samples.memoryBytes() + params.lod.memoryBytes()});
+    out.append({owner, "points on the plot", MemoryAccounting::plotBytes(ui->graphingView)});
+}
+
+qint64 GraphingWindow::purgeMemory()
+{
+    QVector<MemoryUsage> before;
+    reportMemory(before);
+    for (GraphParams &params : graphParams)
+    {
+        //a build in flight hands over a fresh copy anyway, squeezing ours doesn't get in its way
+        params.samples.squeeze();
+    }
+    QVector<MemoryUsage> after;
+    reportMemory(after);
+    qint64 freed = 0;
+    for (int i = 0; i < before.count() && i < after.count(); i++) freed += before[i].bytes - after[i].bytes;
+    return freed;
+}
+
 void GraphingWindow::showEvent(QShowEvent* event)
 {
     QDialog::showEvent(event);
     installEventFilter(this);
     readSettings();
+    if (buildsCancelled)
+    {
+        buildsCancelled = false;
+        resumeBuilds();
+    }
     ui->graphingView->replot();
 }
 
@@ -132,6 +201,10 @@ void GraphingWindow::closeEvent(QCloseEvent *event)
     Q_UNUSED(event);
     removeEventFilter(this);
     writeSettings();
+    //no point finishing graphs nobody is looking at. showEvent starts them over
+    buildGeneration.ref();
+    buildPool.clear();
+    buildsCancelled = true;
 }
 
 void GraphingWindow::changeEvent(QEvent *event)
@@ -179,9 +252,7 @@ void GraphingWindow::writeSettings()
 
 void GraphingWindow::updatedFrames(int numFrames)
 {
-    CANFrame thisFrame;
-    QVector<double> x, y;
-    bool appendedToGraph = false;
+    TRACE_SCOPE("GraphingWindow::updatedFrames");
     bool needReplot = false;
 
     if (numFrames == -1) //all frames deleted. Kill the display
@@ -190,6 +261,7 @@ void GraphingWindow::updatedFrames(int numFrames)
         //now instead of removing the graphs regenerate them which will blank them out but leave them there in case
         //more traffic that matches comes in or someone otherwise loads more data
         ui->graphingView->clearGraphs(); //temporarily remove the graphs from the graph view
+        for (int i = 0; i < graphParams.count(); i++) graphParams[i].ref = nullptr; //gone until createGraph makes a new one
         for (int i = 0; i < graphParams.count(); i++)
         {
             createGraph(graphParams[i], false); //regenerate each one
@@ -202,6 +274,7 @@ void GraphingWindow::updatedFrames(int numFrames)
         //there shouldn't be any need to actually remove the graphs.
         //regenerate them instead
         ui->graphingView->clearGraphs(); //temporarily remove the graphs from the graph view
+        for (int i = 0; i < graphParams.count(); i++) graphParams[i].ref = nullptr; //gone until createGraph makes a new one
         //needScaleSetup = true;
         for (int i = 0; i < graphParams.count(); i++)
         {
@@ -213,50 +286,163 @@ void GraphingWindow::updatedFrames(int numFrames)
     {  
         if (numFrames > modelFrames->count()) return;
 
+        //the series store has already decoded the new frames (it gets framesUpdated first), each graph just picks
+        //up what its series gained since it last looked
+        QVector<QVector<double>> newX(graphParams.count()), newY(graphParams.count());
         for (int j = 0; j < graphParams.count(); j++)
         {
-            appendedToGraph = false;
-            x.clear();
-            y.clear();
-            for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
-            {
-                thisFrame = modelFrames->at(i);
-                if ( graphParams[j].ID == thisFrame.frameId() && ( (graphParams[j].bus == -1) || (graphParams[j].bus == thisFrame.bus) ) )
-                {
-                    appendToGraph(graphParams[j], thisFrame, x, y);
-                    appendedToGraph = true;
-                }
-            }
-            if (appendedToGraph)
+            //graphs still building pick these up when they're installed
+            if (graphParams[j].ref) appendNewSamples(graphParams[j], newX[j], newY[j]);
+        }
+
+        for (int j = 0; j < graphParams.count(); j++)
+        {
+            if (newX[j].isEmpty()) continue;
+            graphParams[j].lod.update(graphParams[j].samples);
+            if (scopeMode) evictOldSamples(graphParams[j]);
+            //a small graph holds everything so just tack the new points on. Otherwise regenerate what's shown
+            if (graphParams[j].lod.levelCount() == 0 && graphParams[j].lodShown.level == 0)
             {
-                graphParams[j].ref->addData(x, y);
-                needReplot = true;
+                graphParams[j].ref->addData(newX[j], newY[j]);
+                if (scopeMode) graphParams[j].ref->data()->removeBefore(graphParams[j].samples.firstX());
+                graphParams[j].lodShown.to = graphParams[j].samples.count() - 1;
             }
+            else refreshGraphData(graphParams[j], true);
+            needReplot = true;
         }
 
         if (needReplot)
         {
-            if (followGraphEnd)
+            if (followGraphEnd || scopeMode)
             {
                 //find the current X span and maintain that span but move the end of it over to match the new end
                 //of the actual graph. This causes the view to move with the data to always show the end
+                //the samples are in time order so the end of the graph is just the last one
+                //in scope mode the span is always the scope window
                 QCPRange range = ui->graphingView->xAxis->range();
-                double size = range.size();
-                bool foundRange;
-                QCPRange keyRange = ui->graphingView->graph()->getKeyRange(foundRange);
-                if (foundRange)
+                double size = scopeMode ? scopeSpan() : range.size();
+                for (int j = 0; j < graphParams.count(); j++)
                 {
+                    if (graphParams[j].ref != ui->graphingView->graph() || graphParams[j].samples.isEmpty()) continue;
                     double end, start;
-                    end = keyRange.upper;
+                    end = graphParams[j].samples.lastX();
                     start = end - size;
                     ui->graphingView->xAxis->setRange(start, end);
+                    break;
                 }
             }
-            ui->graphingView->replot();
+            ReplotScheduler::getReference()->request(ui->graphingView);
         }
     }
 }
 
+//samples the graph's series has from seriesRead on. Returns how many went onto the graph
+int GraphingWindow::appendNewSamples(GraphParams &params, QVector<double> &x, QVector<double> &y)
+{
+    if (!params.series) return 0;
+    seriesStore->sync();
+    const SignalSeries &series = *params.series;
+    int before = params.samples.count();
+    for (int i = series.indexOfSequence(params.seriesRead); i < series.count(); i++)
+    {
+        appendToGraph(params, series.stamps[i], series.values[i], x, y);
+    }
+    params.seriesRead = seriesStore->nextSequence();
+    return params.samples.count() - before;
+}
+
+//what a graph reads out of the series store. The DBC signal only matters when it's multiplexed
+SignalSeriesKey GraphingWindow::seriesKey(const GraphParams &params) const
+{
+    SignalSeriesKey key;
+    key.id = params.ID;
+    key.bus = (params.bus < 0) ? -1 : params.bus;
+    key.startBit = params.startBit;
+    key.bits = params.numBits;
+    key.intel = params.intelFormat;
+    key.isSigned = params.isSigned;
+    if (params.associatedSignal && params.associatedSignal->isMultiplexed) key.signal = params.associatedSignal;
+    return key;
+}
+
+//takes a graph out of graphParams along with its hold on the series. The plot side is up to the caller
+void GraphingWindow::removeGraphParams(int idx)
+{
+    seriesStore->release(graphParams[idx].series);
+    graphParams.removeAt(idx);
+}
+
+double GraphingWindow::scopeSpan() const
+{
+    if (Utility::timeStyle == TS_SECONDS || Utility::timeStyle == TS_CLOCK) return scopeSeconds;
+    return scopeSeconds * 1000000.0;
+}
+
+//the finest X step the samples keep: a microsecond, except clock time which only goes down to milliseconds
+double GraphingWindow::sampleTick() const
+{
+    if (Utility::timeStyle == TS_SECONDS) return 0.000001;
+    if (Utility::timeStyle == TS_CLOCK) return 0.001;
+    return 1.0;
+}
+
+/*
+ * Drops samples older than the scope window off the front of a graph. They're only taken once a good sized run
+ * of them has built up (a quarter of the graph or 1024, whichever is more) so the cost of moving the rest down
+ * works out to a constant per sample. The run is rounded down to a multiple of what the LOD pyramid can drop
+ * without a rebuild. Value table brackets that scrolled off go with them.
+ */
+void GraphingWindow::evictOldSamples(GraphParams &params)
+{
+    if (params.samples.isEmpty()) return;
+    double cutoff = params.samples.lastX() - scopeSpan();
+    int old = params.samples.lowerBound(cutoff);
+    if (old < std::max(GRAPH_SCOPE_MIN_EVICT, params.samples.count() / 4)) return;
+    old -= old % params.lod.dropAlignment();
+    if (old <= 0) return;
+
+    params.samples.removeFront(old);
+    params.lod.dropFront(old, params.samples);
+
+    while (!params.brackets.isEmpty() && params.brackets.first() != params.lastBracket
+           && params.brackets.first()->right->coords().x() < params.samples.firstX())
+    {
+        ui->graphingView->removeItem(params.brackets.takeFirst());
+        if (!params.bracketTexts.isEmpty()) ui->graphingView->removeItem(params.bracketTexts.takeFirst());
+    }
+}
+
+void GraphingWindow::xRangeChanged(const QCPRange &range)
+{
+    Q_UNUSED(range);
+    for (int i = 0; i < graphParams.count(); i++) refreshGraphData(graphParams[i], false);
+}
+
+/*
+ * Hands the graph only as many points as the plot has room for. Nothing happens unless the view needs a different
+ * level of detail or has moved outside of what the graph already holds, unless force is set because the samples
+ * themselves changed.
+ */
+void GraphingWindow::refreshGraphData(GraphParams &params, bool force)
+{
+    if (!params.ref) return;
+    QCPRange range = ui->graphingView->xAxis->range();
+    int pixels = ui->graphingView->axisRect()->width();
+    if (pixels <= 0) pixels = 1000; //not laid out yet
+
+    GraphLOD::View view = params.lod.view(params.samples, range.lower, range.upper, pixels);
+    if (!force && params.lodShown.level >= 0)
+    {
+        bool sameLevel = (view.level == params.lodShown.level) || (view.level >= params.lod.levelCount() && params.lodShown.level >= params.lod.levelCount());
+        if (sameLevel && view.from >= params.lodShown.from && view.to <= params.lodShown.to) return;
+    }
+
+    QVector<QCPGraphData> points;
+    params.lod.fill(params.samples, view, points);
+    params.ref->data()->set(points);
+    params.lodShown = view;
+}
+
 void GraphingWindow::plottableClick(QCPAbstractPlottable* plottable, int dataIdx, QMouseEvent* event)
 {
     Q_UNUSED(dataIdx);
@@ -506,12 +692,15 @@ void GraphingWindow::resetView()
     double xminval=100000000000, xmaxval = -10000000000.0;
     for (int i = 0; i < graphParams.count(); i++)
     {
-        for (int j = 0; j < graphParams[i].x.count(); j++)
+        const GraphSamples &samples = graphParams[i].samples;
+        if (samples.isEmpty()) continue;
+        //time order, so the ends are the X extent
+        if (samples.firstX() < xminval) xminval = samples.firstX();
+        if (samples.lastX() > xmaxval) xmaxval = samples.lastX();
+        for (int j = 0; j < samples.count(); j++)
         {
-            if (graphParams[i].x[j] < xminval) xminval = graphParams[i].x[j];
-            if (graphParams[i].x[j] > xmaxval) xmaxval = graphParams[i].x[j];
-            if (graphParams[i].y[j] < yminval) yminval = graphParams[i].y[j];
-            if (graphParams[i].y[j] > ymaxval) ymaxval = graphParams[i].y[j];
+            if (samples.y(j) < yminval) yminval = samples.y(j);
+            if (samples.y(j) > ymaxval) ymaxval = samples.y(j);
         }
     }
 
@@ -588,7 +777,7 @@ void GraphingWindow::removeSelectedGraph()
             ui->graphingView->removeItem(txt);
         }
 
-        graphParams.removeAt(idx);
+        removeGraphParams(idx);
 
         ui->graphingView->removeGraph(ui->graphingView->selectedGraphs().constFirst());
 
@@ -629,7 +818,7 @@ void GraphingWindow::removeAllGraphs()
     {
         ui->graphingView->clearGraphs();
         ui->graphingView->clearItems();
-        graphParams.clear();
+        while (!graphParams.isEmpty()) removeGraphParams(graphParams.count() - 1);
         needScaleSetup = true;
         ui->graphingView->replot();
     }
@@ -652,6 +841,33 @@ void GraphingWindow::toggleFollowMode()
     followGraphEnd = !followGraphEnd;
 }
 
+void GraphingWindow::toggleScopeMode()
+{
+    if (!scopeMode)
+    {
+        QSettings settings;
+        bool ok;
+        double secs = QInputDialog::getDouble(this, "SavvyCAN Graphing", "Seconds of data to keep on each graph:",
+                                              settings.value("Graphing/ScopeSeconds", 10.0).toDouble(), 0.1, 86400.0, 1, &ok);
+        if (!ok) return;
+        settings.setValue("Graphing/ScopeSeconds", secs);
+        scopeSeconds = secs;
+    }
+    scopeMode = !scopeMode;
+    if (!scopeMode) return;
+
+    //trim what's there now and jump to the end. From here on updatedFrames keeps it that way
+    double end = -std::numeric_limits<double>::max();
+    for (int j = 0; j < graphParams.count(); j++)
+    {
+        evictOldSamples(graphParams[j]);
+        refreshGraphData(graphParams[j], true);
+        if (!graphParams[j].samples.isEmpty()) end = std::max(end, graphParams[j].samples.lastX());
+    }
+    if (end > -std::numeric_limits<double>::max()) ui->graphingView->xAxis->setRange(end - scopeSpan(), end);
+    ui->graphingView->replot();
+}
+
 void GraphingWindow::contextMenuRequest(QPoint pos)
 {
   QMenu *menu = new QMenu(this);
@@ -674,6 +890,9 @@ void GraphingWindow::contextMenuRequest(QPoint pos)
     QAction *act = menu->addAction(tr("Follow end of graph"), this, SLOT(toggleFollowMode()));
     act->setCheckable(true);
     act->setChecked(followGraphEnd);
+    act = menu->addAction(tr("Live scope mode"), this, SLOT(toggleScopeMode()));
+    act->setCheckable(true);
+    act->setChecked(scopeMode);
     menu->addAction(tr("Add new graph"), this, SLOT(addNewGraph()));
     if (ui->graphingView->selectedGraphs().size() > 0)
     {
@@ -738,6 +957,11 @@ void GraphingWindow::saveGraphs()
     }
 }
 
+/*
+ * Writes every graph out as one table, a row per time step and a column per graph. Rows go straight to the file as
+ * they're worked out (see GraphExport) so big exports don't pile up in memory. Asks for a resample rate first, 0
+ * keeps a row for every time any of the graphs has a sample.
+ */
 void GraphingWindow::saveSpreadsheet()
 {
     QFileDialog dialog(this);
@@ -745,6 +969,7 @@ void GraphingWindow::saveSpreadsheet()
 
     QStringList filters;
     filters.append(QString(tr("Spreadsheet (*.csv)")));
+    filters.append(QString(tr("Binary columns (*.svcol)")));
 
     dialog.setFileMode(QFileDialog::AnyFile);
     dialog.setNameFilters(filters);
@@ -757,110 +982,33 @@ void GraphingWindow::saveSpreadsheet()
         QString filename = dialog.selectedFiles().constFirst();
         settings.setValue("Graphing/LoadSaveDirectory", dialog.directory().path());
 
-        if (!filename.contains('.')) filename += ".csv";
-
-        QFile outFile(filename);
-
-        if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text))
-            return;
+        bool columnar = (dialog.selectedNameFilter() == filters[1]);
+        if (!filename.contains('.')) filename += columnar ? ".svcol" : ".csv";
+        if (filename.endsWith(".svcol", Qt::CaseInsensitive)) columnar = true;
 
-        /*
-         * save some data
-         * The problem here is that we've got X number of graphs that all have different
-         * timestamps but a spreadsheet would be best if each graph were taken at the same slice
-         * such that you have a list of slices with the value of each graph at that slice.
-         *
-         * But, for now export each graph in turn with the proper timestamp for each piece of data
-         * and a reference for which graph it came from. This is better than nothing.
-        */
-
-        QList<GraphParams>::iterator iter;
-        double xMin = std::numeric_limits<double>::max(),
-               xMax = std::numeric_limits<double>::min();
-        int maxCount = 0;
-        int numGraphs = graphParams.length();
-        for (auto && graph : graphParams) {
-            xMin = std::min(xMin, graph.x[0]);
-            xMax = std::max(xMax, graph.x[graph.x.count() - 1]);
-            maxCount = std::max(maxCount, graph.x.count());
-        }
-        qDebug() << "xMin: " << xMin;
-        qDebug() << "xMax: " << xMax;
-        qDebug() << "MaxCount: " << maxCount;
-        //The idea now is to iterate from xMin to xMax slicing all graphs up into MaxCount slices.
-        //But, actually, don't visit actual xMin or xMax, inset from there by one slice. Then, if
-        //a given graph doesn't exist there use the value from the nearest place that does exist.
-        double xSize = xMax - xMin;
-        double sliceSize = xSize / ((double)maxCount);
-        double equivValue = sliceSize / 100.0;
-        QList<int> indices;
-        indices.reserve(numGraphs);
-
-        outFile.write("TimeStamp");
-        for (auto && graph : graphParams) {
-            indices.append(0);
-            outFile.putChar(',');
-            outFile.write(graph.graphName.toUtf8());
-        }
-        outFile.write("\n");
+        bool ok;
+        double rate = QInputDialog::getDouble(this, "SavvyCAN Graphing", "Rows per second (0 = a row at every sample):",
+                                              settings.value("Graphing/ExportRate", 0.0).toDouble(), 0.0, 1000000.0, 3, &ok);
+        if (!ok) return;
+        settings.setValue("Graphing/ExportRate", rate);
 
-        for (int j = 1; j < (maxCount - 1); j++)
-        {
-            double currentX = xMin + (j * sliceSize);
-            qDebug() << "X: " << currentX;
-            outFile.write(QString::number(currentX, 'f').toUtf8());
-            for (int k = 0; k < numGraphs; k++)
-            {
-                double value = 0.0;
+        GraphExport exporter;
+        for (const GraphParams &graph : graphParams) exporter.addSeries(graph.graphName, graph.samples);
+        //graph X is seconds or microseconds depending on the time style
+        double second = (Utility::timeStyle == TS_SECONDS || Utility::timeStyle == TS_CLOCK) ? 1.0 : 1000000.0;
+        if (rate > 0.0) exporter.setRowStep(second / rate);
 
-                // move cursor to last sample before currentX
-                while (graphParams[k].x[indices[k]+1] < currentX)
-                {
-                    indices[k]++;
-                }
-
-                //five possibilities.
-                //1: we're at the beginning for this graph but the slice is before this graph even starts
-                if (indices[k] == 0 && graphParams[k].x[indices[k]] > currentX)
-                {
-                    value = graphParams[k].y[indices[k]];
-                }
-                //2: The opposite, we're at the end of this graph but the slices keep going
-                else if (indices[k] == (graphParams[k].x.count() - 1) && graphParams[k].x[indices[k]] < currentX)
-                {
-                    value = graphParams[k].y[indices[k]];
-                }
-                //3: the slice is right near the current value we're at for this graph
-                else if (fabs(graphParams[k].x[indices[k]] - currentX) < equivValue)
-                {
-                    value = graphParams[k].y[indices[k]];
-                }
-                //4: the slice is right next to the next value for this graph
-                else if (fabs(graphParams[k].x[indices[k] + 1] - currentX) < equivValue)
-                {
-                    value = graphParams[k].y[indices[k] + 1];
-                }
-                //5: it's somewhere in between two values for this graph
-                //the two values will be indices[k] and indices[k] + 1
-                else
-                {
-                    // find index, where x >= currentX
-                    int cursor = indices[k];
-                    double span = graphParams[k].x[cursor+1] - graphParams[k].x[cursor];
-                    double progress = (currentX - graphParams[k].x[cursor]) / span;
-                    Q_ASSERT(progress >= 0.0 && progress <= 1.0);
-                    value = Utility::Lerp(graphParams[k].y[cursor], graphParams[k].y[cursor+1], progress);
-                    qDebug() << "Span: " << span << " Prog: " << progress << " Value: " << value;
-                }
-                outFile.putChar(',');
-                outFile.write(QString::number(value).toUtf8());
-            }
-            outFile.write("\n");
-        }
+        QFile outFile(filename);
+        QIODevice::OpenMode mode = QIODevice::WriteOnly;
+        if (!columnar) mode |= QIODevice::Text;
+        if (!outFile.open(mode)) return;
 
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool written = exporter.write(outFile, columnar ? GraphExport::Columnar : GraphExport::CSV);
+        QApplication::restoreOverrideCursor();
         outFile.close();
+        if (!written) QMessageBox::warning(this, "SavvyCAN Graphing", "Could not write all of " + filename);
     }
-
 }
 
 void GraphingWindow::saveDefinitions()
@@ -889,63 +1037,69 @@ void GraphingWindow::saveDefinitions()
         if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text))
             return;
 
-        QList<GraphParams>::iterator iter;
-        for (iter = graphParams.begin(); iter != graphParams.end(); ++iter)
+        writeDefinitions(outFile);
+        outFile.close();
+    }
+}
+
+//one line per graph, the same lines loadDefinitions reads. Workspaces keep these for every graph window too
+void GraphingWindow::writeDefinitions(QIODevice &outFile) const
+{
+    QList<GraphParams>::const_iterator iter;
+    for (iter = graphParams.constBegin(); iter != graphParams.constEnd(); ++iter)
+    {
+        outFile.write("Z,");
+        outFile.write(QString::number(iter->ID, 16).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->mask, 16).toUtf8());
+        outFile.putChar(',');
+        if (iter->intelFormat) outFile.write(QString::number(iter->startBit).toUtf8());
+            else outFile.write(QString::number(iter->startBit * -1).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->numBits).toUtf8());
+        outFile.putChar(',');
+        if (iter->isSigned) outFile.putChar('Y');
+            else outFile.putChar('N');
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->bias).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->scale).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->stride).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->bus).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->lineColor.red()).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->lineColor.green()).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->lineColor.blue()).toUtf8());
+        outFile.putChar(',');
+        outFile.write(iter->graphName.toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->fillColor.red()).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->fillColor.green()).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->fillColor.blue()).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->fillColor.alpha()).toUtf8());
+        outFile.putChar(',');
+        if (iter->drawOnlyPoints) outFile.putChar('Y');
+            else outFile.putChar('N');
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->pointType).toUtf8());
+        outFile.putChar(',');
+        outFile.write(QString::number(iter->lineWidth).toUtf8());
+        if (iter->associatedSignal)
         {
-            outFile.write("Z,");
-            outFile.write(QString::number(iter->ID, 16).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->mask, 16).toUtf8());
-            outFile.putChar(',');
-            if (iter->intelFormat) outFile.write(QString::number(iter->startBit).toUtf8());
-                else outFile.write(QString::number(iter->startBit * -1).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->numBits).toUtf8());
-            outFile.putChar(',');
-            if (iter->isSigned) outFile.putChar('Y');
-                else outFile.putChar('N');
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->bias).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->scale).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->stride).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->bus).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->lineColor.red()).toUtf8());
             outFile.putChar(',');
-            outFile.write(QString::number(iter->lineColor.green()).toUtf8());
+            outFile.write(iter->associatedSignal->parentMessage->name.toUtf8());
             outFile.putChar(',');
-            outFile.write(QString::number(iter->lineColor.blue()).toUtf8());
-            outFile.putChar(',');
-            outFile.write(iter->graphName.toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->fillColor.red()).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->fillColor.green()).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->fillColor.blue()).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->fillColor.alpha()).toUtf8());
-            outFile.putChar(',');
-            if (iter->drawOnlyPoints) outFile.putChar('Y');
-                else outFile.putChar('N');
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->pointType).toUtf8());
-            outFile.putChar(',');
-            outFile.write(QString::number(iter->lineWidth).toUtf8());
-            if (iter->associatedSignal)
-            {
-                outFile.putChar(',');
-                outFile.write(iter->associatedSignal->parentMessage->name.toUtf8());
-                outFile.putChar(',');
-                outFile.write(iter->associatedSignal->name.toUtf8());
-            }
-
-            outFile.write("\n");
+            outFile.write(iter->associatedSignal->name.toUtf8());
         }
-        outFile.close();
+
+        outFile.write("\n");
     }
 }
 
@@ -971,235 +1125,245 @@ void GraphingWindow::loadDefinitions()
         settings.setValue("Graphing/LoadSaveDirectory", dialog.directory().path());
 
         QFile inFile(filename);
-        QByteArray line;
 
         if (!inFile.open(QIODevice::ReadOnly | QIODevice::Text))
             return;
 
-        while (!inFile.atEnd()) {
-            line = inFile.readLine().simplified();
-            if (line.length() > 2)
-            {
-                GraphParams gp;
+        readDefinitions(inFile);
+        inFile.close();
+    }
+}
 
-                QList<QByteArray> tokens = line.split(',');
+//makes a graph for every line of a graph definition file, any of the formats it has had over the years
+void GraphingWindow::readDefinitions(QIODevice &inFile)
+{
+    QByteArray line;
 
-                gp.associatedSignal = nullptr; //might not be saved in the graph definition so default it to nothing
+    if (dbcHandler == nullptr) return;
+    if (dbcHandler->getFileCount() == 0) dbcHandler->createBlankFile();
 
-                //should probably do better at merging all the code that is the same between all these formats instead of duplication...
-                if (tokens[0] == "Z") //very newest format, adds ability to set bus number
-                {
-                    gp.ID = tokens[1].toUInt(nullptr, 16);
-                    gp.mask = tokens[2].toULongLong(nullptr, 16);
-                    gp.startBit = tokens[3].toInt();
-                    if (gp.startBit < 0) {
-                        gp.intelFormat = false;
-                        gp.startBit *= -1;
-                    }
-                    else gp.intelFormat = true;
-                    gp.numBits = tokens[4].toInt();
-                    if (tokens[5] == "Y") gp.isSigned = true;
-                        else gp.isSigned = false;
-                    gp.bias = tokens[6].toFloat();
-                    gp.scale = tokens[7].toFloat();
-                    gp.stride = tokens[8].toInt();
-                    gp.bus = tokens[9].toInt();
-
-                    gp.lineColor.setRed( tokens[10].toInt() );
-                    gp.lineColor.setGreen( tokens[11].toInt() );
-                    gp.lineColor.setBlue( tokens[12].toInt() );
-                    if (tokens.length() > 13)
-                        gp.graphName = tokens[13];
-                    else
-                        gp.graphName = QString();
-                   if (tokens.length() > 20) //even newer format with extra graph formatting options
-                   {
-                       gp.fillColor.setRed( tokens[14].toInt() );
-                       gp.fillColor.setGreen( tokens[15].toInt() );
-                       gp.fillColor.setBlue( tokens[16].toInt() );
-                       gp.fillColor.setAlpha( tokens[17].toInt() );
-                       if (tokens[18] == "Y") gp.drawOnlyPoints = true;
-                       else gp.drawOnlyPoints = false;
-                       gp.pointType = tokens[19].toInt();
-                       gp.lineWidth = tokens[20].toInt();
-                   }
-                   if (tokens.length() > 22)
-                   {
-                       DBC_MESSAGE *msg = dbcHandler->findMessage(gp.ID);
-                       if (msg)
-                       {
-                            gp.associatedSignal = msg->sigHandler->findSignalByName(tokens[22]);
-                       }
-                       else qDebug() << "Couldn't find the message by name! " << tokens[21] << "  " << tokens[22];
-                   }
+    while (!inFile.atEnd()) {
+        line = inFile.readLine().simplified();
+        if (line.length() > 2)
+        {
+            GraphParams gp;
+
+            QList<QByteArray> tokens = line.split(',');
 
-                   createGraph(gp, true);
+            gp.associatedSignal = nullptr; //might not be saved in the graph definition so default it to nothing
+
+            //should probably do better at merging all the code that is the same between all these formats instead of duplication...
+            if (tokens[0] == "Z") //very newest format, adds ability to set bus number
+            {
+                gp.ID = tokens[1].toUInt(nullptr, 16);
+                gp.mask = tokens[2].toULongLong(nullptr, 16);
+                gp.startBit = tokens[3].toInt();
+                if (gp.startBit < 0) {
+                    gp.intelFormat = false;
+                    gp.startBit *= -1;
                 }
-                else if (tokens[0] == "X") //second newest format based around signals
-                {
-                    gp.ID = tokens[1].toUInt(nullptr, 16);
-                    gp.mask = tokens[2].toULongLong(nullptr, 16);
-                    gp.startBit = tokens[3].toInt();
-                    if (gp.startBit < 0) {
-                        gp.intelFormat = false;
-                        gp.startBit *= -1;
-                    }
-                    else gp.intelFormat = true;
-                    gp.numBits = tokens[4].toInt();
-                    if (tokens[5] == "Y") gp.isSigned = true;
-                        else gp.isSigned = false;
-                    gp.bias = tokens[6].toFloat();
-                    gp.scale = tokens[7].toFloat();
-                    gp.stride = tokens[8].toInt();
-                    gp.bus = -1;
-
-                    gp.lineColor.setRed( tokens[9].toInt() );
-                    gp.lineColor.setGreen( tokens[10].toInt() );
-                    gp.lineColor.setBlue( tokens[11].toInt() );
-                    if (tokens.length() > 12)
-                        gp.graphName = tokens[12];
-                    else
-                        gp.graphName = QString();
-                   if (tokens.length() > 19) //even newer format with extra graph formatting options
+                else gp.intelFormat = true;
+                gp.numBits = tokens[4].toInt();
+                if (tokens[5] == "Y") gp.isSigned = true;
+                    else gp.isSigned = false;
+                gp.bias = tokens[6].toFloat();
+                gp.scale = tokens[7].toFloat();
+                gp.stride = tokens[8].toInt();
+                gp.bus = tokens[9].toInt();
+
+                gp.lineColor.setRed( tokens[10].toInt() );
+                gp.lineColor.setGreen( tokens[11].toInt() );
+                gp.lineColor.setBlue( tokens[12].toInt() );
+                if (tokens.length() > 13)
+                    gp.graphName = tokens[13];
+                else
+                    gp.graphName = QString();
+               if (tokens.length() > 20) //even newer format with extra graph formatting options
+               {
+                   gp.fillColor.setRed( tokens[14].toInt() );
+                   gp.fillColor.setGreen( tokens[15].toInt() );
+                   gp.fillColor.setBlue( tokens[16].toInt() );
+                   gp.fillColor.setAlpha( tokens[17].toInt() );
+                   if (tokens[18] == "Y") gp.drawOnlyPoints = true;
+                   else gp.drawOnlyPoints = false;
+                   gp.pointType = tokens[19].toInt();
+                   gp.lineWidth = tokens[20].toInt();
+               }
+               if (tokens.length() > 22)
+               {
+                   DBC_MESSAGE *msg = dbcHandler->findMessage(gp.ID);
+                   if (msg)
                    {
-                       gp.fillColor.setRed( tokens[13].toInt() );
-                       gp.fillColor.setGreen( tokens[14].toInt() );
-                       gp.fillColor.setBlue( tokens[15].toInt() );
-                       gp.fillColor.setAlpha( tokens[16].toInt() );
-                       if (tokens[17] == "Y") gp.drawOnlyPoints = true;
-                       else gp.drawOnlyPoints = false;
-                       gp.pointType = tokens[18].toInt();
-                       gp.lineWidth = tokens[19].toInt();
+                        gp.associatedSignal = msg->sigHandler->findSignalByName(tokens[22]);
                    }
-                   if (tokens.length() > 21)
+                   else qDebug() << "Couldn't find the message by name! " << tokens[21] << "  " << tokens[22];
+               }
+
+               createGraph(gp, true);
+            }
+            else if (tokens[0] == "X") //second newest format based around signals
+            {
+                gp.ID = tokens[1].toUInt(nullptr, 16);
+                gp.mask = tokens[2].toULongLong(nullptr, 16);
+                gp.startBit = tokens[3].toInt();
+                if (gp.startBit < 0) {
+                    gp.intelFormat = false;
+                    gp.startBit *= -1;
+                }
+                else gp.intelFormat = true;
+                gp.numBits = tokens[4].toInt();
+                if (tokens[5] == "Y") gp.isSigned = true;
+                    else gp.isSigned = false;
+                gp.bias = tokens[6].toFloat();
+                gp.scale = tokens[7].toFloat();
+                gp.stride = tokens[8].toInt();
+                gp.bus = -1;
+
+                gp.lineColor.setRed( tokens[9].toInt() );
+                gp.lineColor.setGreen( tokens[10].toInt() );
+                gp.lineColor.setBlue( tokens[11].toInt() );
+                if (tokens.length() > 12)
+                    gp.graphName = tokens[12];
+                else
+                    gp.graphName = QString();
+               if (tokens.length() > 19) //even newer format with extra graph formatting options
+               {
+                   gp.fillColor.setRed( tokens[13].toInt() );
+                   gp.fillColor.setGreen( tokens[14].toInt() );
+                   gp.fillColor.setBlue( tokens[15].toInt() );
+                   gp.fillColor.setAlpha( tokens[16].toInt() );
+                   if (tokens[17] == "Y") gp.drawOnlyPoints = true;
+                   else gp.drawOnlyPoints = false;
+                   gp.pointType = tokens[18].toInt();
+                   gp.lineWidth = tokens[19].toInt();
+               }
+               if (tokens.length() > 21)
+               {
+                   DBC_MESSAGE *msg = dbcHandler->findMessage(gp.ID);
+                   if (msg)
                    {
-                       DBC_MESSAGE *msg = dbcHandler->findMessage(gp.ID);
-                       if (msg)
-                       {
-                            gp.associatedSignal = msg->sigHandler->findSignalByName(tokens[21]);
-                       }
-                       else qDebug() << "Couldn't find the message by name! " << tokens[20] << "  " << tokens[21];
+                        gp.associatedSignal = msg->sigHandler->findSignalByName(tokens[21]);
                    }
+                   else qDebug() << "Couldn't find the message by name! " << tokens[20] << "  " << tokens[21];
+               }
 
-                   createGraph(gp, true);
-                }
-                else //one of the two older formats then
+               createGraph(gp, true);
+            }
+            else //one of the two older formats then
+            {
+                gp.ID = tokens[0].toUInt(nullptr, 16);
+                gp.bus = -1;
+                if (tokens[1] == "S") //old signal based graph definition
                 {
-                    gp.ID = tokens[0].toUInt(nullptr, 16);
-                    gp.bus = -1;
-                    if (tokens[1] == "S") //old signal based graph definition
+                    //tokens[2] is the signal name. Need to use the message ID and this name to look it up
+                    DBC_MESSAGE *msg = dbcHandler->getFileByIdx(0)->messageHandler->findMsgByID(gp.ID);
+                    if (msg != nullptr)
                     {
-                        //tokens[2] is the signal name. Need to use the message ID and this name to look it up
-                        DBC_MESSAGE *msg = dbcHandler->getFileByIdx(0)->messageHandler->findMsgByID(gp.ID);
-                        if (msg != nullptr)
+                        DBC_SIGNAL *sig = msg->sigHandler->findSignalByName(tokens[2]);
+                        if (sig)
                         {
-                            DBC_SIGNAL *sig = msg->sigHandler->findSignalByName(tokens[2]);
-                            if (sig)
-                            {
-                                gp.mask = 0xFFFFFFFF;
-                                gp.bias = (float)sig->bias;
-                                gp.lineColor.setRed(tokens[3].toInt());
-                                gp.lineColor.setGreen(tokens[4].toInt());
-                                gp.lineColor.setBlue(tokens[5].toInt());
-                                gp.graphName = sig->name;
-                                gp.intelFormat = sig->intelByteOrder;
-                                if (sig->valType == SIGNED_INT) gp.isSigned = true;
-                                    else gp.isSigned = false;
-                                gp.numBits = sig->signalSize;
-                                gp.scale = (float)sig->factor;
-                                gp.startBit = sig->startBit;
-                                gp.stride = 1;
-                                createGraph(gp, true);
-                            }
+                            gp.mask = 0xFFFFFFFF;
+                            gp.bias = (float)sig->bias;
+                            gp.lineColor.setRed(tokens[3].toInt());
+                            gp.lineColor.setGreen(tokens[4].toInt());
+                            gp.lineColor.setBlue(tokens[5].toInt());
+                            gp.graphName = sig->name;
+                            gp.intelFormat = sig->intelByteOrder;
+                            if (sig->valType == SIGNED_INT) gp.isSigned = true;
+                                else gp.isSigned = false;
+                            gp.numBits = sig->signalSize;
+                            gp.scale = (float)sig->factor;
+                            gp.startBit = sig->startBit;
+                            gp.stride = 1;
+                            createGraph(gp, true);
                         }
                     }
-                    else //old standard graph definition
+                }
+                else //old standard graph definition
+                {
+                    //hard part - this all changed drastically
+                    //the difference between intel and motorola format is whether
+                    //start is larger than end byte or not.
+                    uint64_t oldMask = tokens[1].toULongLong(nullptr, 16);
+                    int oldStart = tokens[2].toInt();
+                    int oldEnd = tokens[3].toInt();
+
+                    if (oldEnd > oldStart) //motorola / big endian - hell...
                     {
-                        //hard part - this all changed drastically
-                        //the difference between intel and motorola format is whether
-                        //start is larger than end byte or not.
-                        uint64_t oldMask = tokens[1].toULongLong(nullptr, 16);
-                        int oldStart = tokens[2].toInt();
-                        int oldEnd = tokens[3].toInt();
-
-                        if (oldEnd > oldStart) //motorola / big endian - hell...
-                        {
-                            gp.intelFormat = false;
-                            //for now just naively use the entire bytes called for.
-                            gp.startBit = 8 * oldStart + 7;
-                            gp.numBits = (oldEnd - oldStart + 1) * 8;
-                        }
-                        else if (oldStart > oldEnd) //intel / little endian - easiest of multi-byte types
-                        {
-                            //have to find both ends. start bit is somewhere in oldEnd and last bit is somewhere in
-                            //oldStart.
+                        gp.intelFormat = false;
+                        //for now just naively use the entire bytes called for.
+                        gp.startBit = 8 * oldStart + 7;
+                        gp.numBits = (oldEnd - oldStart + 1) * 8;
+                    }
+                    else if (oldStart > oldEnd) //intel / little endian - easiest of multi-byte types
+                    {
+                        //have to find both ends. start bit is somewhere in oldEnd and last bit is somewhere in
+                        //oldStart.
 
-                            gp.intelFormat = true;
+                        gp.intelFormat = true;
 
-                            //start by setting a safe default if nothing else pans out.
-                            gp.startBit = 8 * oldEnd;
+                        //start by setting a safe default if nothing else pans out.
+                        gp.startBit = 8 * oldEnd;
 
-                            int numBytes = oldStart - oldEnd + 1;
-                            gp.numBits = numBytes * 8;
+                        int numBytes = oldStart - oldEnd + 1;
+                        gp.numBits = numBytes * 8;
 
-                            for (int b = 0; b < 8; b++)
+                        for (int b = 0; b < 8; b++)
+                        {
+                            if (oldMask & (1ull << b))
                             {
-                                if (oldMask & (1ull << b))
-                                {
-                                    gp.startBit = (8 * oldEnd) + b;
-                                    break;
-                                }
+                                gp.startBit = (8 * oldEnd) + b;
+                                break;
                             }
+                        }
 
-                            for (int c = 7; c >= 0; c--)
+                        for (int c = 7; c >= 0; c--)
+                        {
+                            if ( oldMask & (1ull << (((numBytes - 1) * 8) + c)) )
                             {
-                                if ( oldMask & (1ull << (((numBytes - 1) * 8) + c)) )
-                                {
-                                    gp.numBits -= (7-c);
-                                    break;
-                                }
+                                gp.numBits -= (7-c);
+                                break;
                             }
                         }
-                        else //within a single byte - easier than the above two by a bit - always use intel format for this
+                    }
+                    else //within a single byte - easier than the above two by a bit - always use intel format for this
+                    {
+                        gp.intelFormat = true;
+                        oldMask = oldMask & 0xFF; //only this part matters
+                        //for intel format we give startbit as the lowest bit number in the signal
+                        //we can find that by going backward from bit 0 to 7 and picking the first bit that is 1.
+                        //that's our start bit (+ 8*oldStart)
+                        //set default first in case the rest falls through
+                        gp.startBit = 8 * oldStart;
+                        gp.numBits = 8;
+                        for (int b = 0; b < 8; b++)
                         {
-                            gp.intelFormat = true;
-                            oldMask = oldMask & 0xFF; //only this part matters
-                            //for intel format we give startbit as the lowest bit number in the signal
-                            //we can find that by going backward from bit 0 to 7 and picking the first bit that is 1.
-                            //that's our start bit (+ 8*oldStart)
-                            //set default first in case the rest falls through
-                            gp.startBit = 8 * oldStart;
-                            gp.numBits = 8;
-                            for (int b = 0; b < 8; b++)
+                            if (oldMask & (1ull << b))
                             {
-                                if (oldMask & (1ull << b))
-                                {
-                                    gp.startBit = 8 * oldStart + b;
-                                    gp.numBits = 8 - b;
-                                    break;
-                                }
+                                gp.startBit = 8 * oldStart + b;
+                                gp.numBits = 8 - b;
+                                break;
                             }
                         }
-
-                        //the rest is easy stuff
-                        if (tokens[4] == "Y") gp.isSigned = true;
-                            else gp.isSigned = false;
-                        gp.bias = tokens[5].toFloat();
-                        gp.scale = tokens[6].toFloat();
-                        gp.stride = tokens[7].toInt();
-                        gp.lineColor.setRed(tokens[8].toInt());
-                        gp.lineColor.setGreen(tokens[9].toInt());
-                        gp.lineColor.setBlue(tokens[10].toInt());
-                        if (tokens.length() > 11)
-                            gp.graphName = tokens[11];
-                        else
-                            gp.graphName = QString();
-                        createGraph(gp, true);
                     }
+
+                    //the rest is easy stuff
+                    if (tokens[4] == "Y") gp.isSigned = true;
+                        else gp.isSigned = false;
+                    gp.bias = tokens[5].toFloat();
+                    gp.scale = tokens[6].toFloat();
+                    gp.stride = tokens[7].toInt();
+                    gp.lineColor.setRed(tokens[8].toInt());
+                    gp.lineColor.setGreen(tokens[9].toInt());
+                    gp.lineColor.setBlue(tokens[10].toInt());
+                    if (tokens.length() > 11)
+                        gp.graphName = tokens[11];
+                    else
+                        gp.graphName = QString();
+                    createGraph(gp, true);
                 }
             }
         }
-        inFile.close();
     }
 }
 
@@ -1219,8 +1383,8 @@ void GraphingWindow::showParamsDialog(int idx = -1)
     {
         if (idx > -1) //if there was an existing graph then delete it
         {
-            graphParams.removeAt(idx);
-            ui->graphingView->removeGraph(idx);
+            if (graphParams[idx].ref) ui->graphingView->removeGraph(graphParams[idx].ref);
+            removeGraphParams(idx);
         }
         //create a new graph with the returned parameters.
         GraphParams params;
@@ -1235,33 +1399,32 @@ void GraphingWindow::addNewGraph()
     showParamsDialog(-1);
 }
 
-void GraphingWindow::appendToGraph(GraphParams &params, CANFrame &frame, QVector<double> &x, QVector<double> &y)
+void GraphingWindow::appendToGraph(GraphParams &params, uint64_t stamp, int64_t rawValue, QVector<double> &x, QVector<double> &y)
 {
     params.strideSoFar++;
     if (params.strideSoFar >= params.stride)
     {
         params.strideSoFar = 0;
-        int64_t tempVal; //64 bit temp value.
-        tempVal = Utility::processIntegerSignal(frame.payload(), params.startBit, params.numBits, params.intelFormat, params.isSigned); //& params.mask;
+        int64_t tempVal = rawValue; //64 bit temp value.
         double xVal, yVal;
         if (Utility::timeStyle == TS_SECONDS)
         {
-            xVal = ((double)(frame.timeStamp().microSeconds()) / 1000000.0 - params.xbias);
+            xVal = ((double)(stamp) / 1000000.0 - params.xbias);
         }
         else if (Utility::timeStyle == TS_CLOCK)
         {
-            QDateTime dt = QDateTime::fromMSecsSinceEpoch((frame.timeStamp().microSeconds() / 1000) - params.xbias);
+            QDateTime dt = QDateTime::fromMSecsSinceEpoch((stamp / 1000) - params.xbias);
             xVal = (dt.time().second() + dt.time().minute() * 60 + dt.time().hour() * 3600);
         }
         else
         {
-            xVal = (frame.timeStamp().microSeconds() - params.xbias);
+            xVal = (stamp - params.xbias);
         }
         yVal = (tempVal * params.scale) + params.bias;
-        params.x.append(xVal);
-        params.y.append(yVal);
-        x.append(xVal);
-        y.append(yVal);
+        params.samples.append(xVal, yVal);
+        //what the samples kept, so these points match the ones a refill would give the plot
+        x.append(params.samples.lastX());
+        y.append(params.samples.y(params.samples.count() - 1));
 
         //now see if we've got to do anything with the brackets and labels for value table stuff
         QString tempStr;
@@ -1313,15 +1476,15 @@ void GraphingWindow::appendToGraph(GraphParams &params, CANFrame &frame, QVector
     }
 }
 
+/*
+ * The decoding itself is the series store's job. Graphs turn the decoded values into points on buildPool so a pile
+ * of them (loadDefinitions) doesn't freeze the window. The entry goes into graphParams straight away without a
+ * QCPGraph (ref is null while it's pending) and installGraph adds it to the plot once its points are done. The
+ * build works off copies of the series vectors which are cheap, they share everything with the store's. If frames
+ * come in while a build is running the store ends up copying its vectors once.
+ */
 void GraphingWindow::createGraph(GraphParams &params, bool createGraphParam)
 {
-    int64_t tempVal; //64 bit temp value.
-    double yminval=10000000.0, ymaxval = -1000000.0;
-    double xminval=10000000000.0, xmaxval = -10000000000.0;
-    GraphParams *refParam = &params;
-    QString tempStr;
-    double x{}, y{};
-
     qDebug() << "New Graph ID: " << params.ID;
     qDebug() << "Start bit: " << params.startBit;
     qDebug() << "Data length: " << params.numBits;
@@ -1329,82 +1492,142 @@ void GraphingWindow::createGraph(GraphParams &params, bool createGraphParam)
     qDebug() << "Signed: " << params.isSigned;
     qDebug() << "Mask: " << params.mask;
 
-    frameCache.clear();
-    for (int i = 0; i < modelFrames->count(); i++)
+    if (params.graphName == nullptr || params.graphName.length() == 0)
+    {
+        params.graphName = QString("0x") + QString::number(params.ID, 16) + ":" + QString::number(params.startBit);
+        params.graphName += "-" + QString::number(params.numBits);
+    }
+    params.xbias = 0;
+
+    GraphParams *refParam = &params;
+    if (createGraphParam)
     {
-        CANFrame thisFrame = modelFrames->at(i);
-        if ( (thisFrame.frameId() == params.ID) && (thisFrame.frameType() == QCanBusFrame::DataFrame)
-       &&  ( ( params.bus == -1) ||  (params.bus == thisFrame.bus) ) ) frameCache.append(thisFrame);
+        params.series = nullptr; //only graphParams entries hold series
+        graphParams.append(params);
+        refParam = &graphParams.last();
+    }
+    //regenerating an existing graph keeps its series unless the graph got changed to read something else
+    SignalSeriesKey key = seriesKey(*refParam);
+    if (refParam->series && !(refParam->series->key == key))
+    {
+        seriesStore->release(refParam->series);
+        refParam->series = nullptr;
     }
+    if (!refParam->series) refParam->series = seriesStore->acquire(key);
+    startBuild(*refParam);
+}
+
+void GraphingWindow::startBuild(GraphParams &params)
+{
+    params.ref = nullptr;
+    params.buildId = ++lastBuildId;
+
+    seriesStore->sync();
+    QVector<uint64_t> stamps = params.series->stamps;
+    QVector<int64_t> values = params.series->values;
+    quint64 endSequence = seriesStore->nextSequence();
+    GraphParams work = params;
+    quint32 generation = buildGeneration.loadRelaxed();
+    buildPool.start(new GraphBuildTask([this, stamps, values, work, endSequence, generation]()
+    {
+        GraphBuild build;
+        build.params = work;
+        build.stamps = stamps;
+        build.values = values;
+        build.endSequence = endSequence;
+        if (!buildSeries(build, generation)) return;
+        QMetaObject::invokeMethod(this, [this, build, generation]() mutable
+        {
+            if (buildGeneration.loadRelaxed() != generation) return;
+            installGraph(build);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+//picks up builds that closing the window cancelled
+void GraphingWindow::resumeBuilds()
+{
+    for (int i = 0; i < graphParams.count(); i++)
+    {
+        if (!graphParams[i].ref) startBuild(graphParams[i]);
+    }
+}
+
+/*
+ * Runs on buildPool. Turns the copied series into build.params.samples and works out where the value table brackets
+ * go. Nothing in here touches the plot. False if the build was cancelled part way.
+ */
+bool GraphingWindow::buildSeries(GraphBuild &build, quint32 generation) const
+{
+    GraphParams &params = build.params;
+    bool multiplexed = params.associatedSignal && params.associatedSignal->isMultiplexed;
 
     //to fix weirdness where a graph that has no data won't be able to be edited, selected, or deleted properly
-    //we'll check for the condition that there is nothing to graph and add a single dummy frame to the cache
-    //that has all data bytes = 0. This allows the graph to be edited and deleted. No idea why you can't otherwise.
-    if (frameCache.count() == 0)
+    //we'll check for the condition that there is nothing to graph and add a single dummy sample
+    //of 0 at time 0. This allows the graph to be edited and deleted. No idea why you can't otherwise.
+    //A multiplexed signal only gets it if it would have been in an all zero frame
+    if (build.values.isEmpty())
     {
         CANFrame dummy;
         dummy.setFrameId(params.ID);
         dummy.bus = 0;
         dummy.setPayload(QByteArray(8, 0));
         dummy.setFrameType(QCanBusFrame::DataFrame);
-        frameCache.append(dummy);
+        if (!multiplexed || params.associatedSignal->isSignalInMessage(dummy))
+        {
+            build.stamps.append(0);
+            build.values.append(0);
+        }
     }
+    int frameCount = build.values.isEmpty() ? 1 : build.values.count();
 
-    int numEntries = frameCache.count() / params.stride;
+    int numEntries = frameCount / params.stride;
     if (numEntries < 1) numEntries = 1; //could happen if stride is larger than frame count
 
-    params.x.clear();
-    params.y.clear();
-    params.x.reserve(numEntries);
-    params.y.reserve(numEntries);
-    //params.x.fill(0, numEntries);
-    //params.y.fill(0, numEntries);
+    params.samples = GraphSamples(sampleTick());
+    params.samples.reserve(numEntries);
 
-    int sBit = params.startBit;
-    int bits = params.numBits;
-    bool intelFormat = params.intelFormat;
-    bool isSigned = params.isSigned;
+    build.yminval = 10000000.0;
+    build.ymaxval = -1000000.0;
+    build.xminval = 10000000000.0;
+    build.xmaxval = -10000000000.0;
+    int64_t tempVal = 0; //64 bit temp value.
+    QString tempStr;
+    double x{}, y{};
 
-    for (int j = 0; j < numEntries; j++)
+    for (int j = 0; j < numEntries && !build.values.isEmpty(); j++)
     {
+        if ((j & 0xFFF) == 0 && buildGeneration.loadRelaxed() != generation) return false;
+
+        //the store only has samples from frames the signal is really in so multiplexing is already taken care of
         int k = j * params.stride;
-        if (params.associatedSignal)
-        {
-            //skip all the rest of the stuff in this loop and don't add this to the graph if this signal isn't in this frame
-            if (!params.associatedSignal->isSignalInMessage(frameCache[k]))
-            {
-                qDebug() << "Signal was not in this frame";
-                continue;
-            }
-            else qDebug() << "Signal in the frame!";
-        }
-        tempVal = Utility::processIntegerSignal(frameCache[k].payload(), sBit, bits, intelFormat, isSigned); //& params.mask;
-        //qDebug() << tempVal;
+        uint64_t stamp = build.stamps[k];
+        tempVal = build.values[k]; //& params.mask;
         y = (tempVal * params.scale) + params.bias;
-        params.y.append( y );
 
         if (Utility::timeStyle == TS_SECONDS)
         {
-            x = (frameCache[k].timeStamp().microSeconds()) / 1000000.0;
+            x = stamp / 1000000.0;
         }
         else if (Utility::timeStyle == TS_CLOCK)
         {
-            QDateTime dt = QDateTime::fromMSecsSinceEpoch((frameCache[k].timeStamp().microSeconds() / 1000) - params.xbias);
+            QDateTime dt = QDateTime::fromMSecsSinceEpoch((stamp / 1000) - params.xbias);
             x = (dt.time().msecsSinceStartOfDay() / 1000.0);
         }
         else
         {
-            x = frameCache[k].timeStamp().microSeconds();
+            x = stamp;
         }
 
-        params.x.append( x );
+        params.samples.append(x, y);
 
         if (params.associatedSignal && numEntries > 1)
         {
-
-            bool isValid = params.associatedSignal->getValueString(tempVal, tempStr);
-            if (isValid)
+            //const lookup, the DBC's own value index may be getting rebuilt on the GUI thread
+            const DBC_VAL_ENUM_ENTRY *entry = static_cast<const DBC_SIGNAL *>(params.associatedSignal)->findValue(tempVal);
+            if (entry)
             {
+                tempStr = entry->descript;
                 if (params.prevValLocation == QPointF(0,0)) {
                     params.prevValLocation = QPointF(x, y);
                     params.prevValStr = tempStr;
@@ -1412,63 +1635,88 @@ void GraphingWindow::createGraph(GraphParams &params, bool createGraphParam)
                 }
                 if (tempVal != params.prevValTable)
                 {
-                    qDebug() << "New Value: " << tempStr;
-
                     //Adding a bracket is a neat idea but you can't do that unless:
                     //1. you wait until the value changes again so you can put the bracket where it belongs or
                     //2. you constantly update the bracket in size then relocate the text too to match.
                     //since this code runs at the beginning of a graph operation it could center the bracket
                     //but supporting this all in realtime updating code is a bit more complicated.
-                    // add the bracket at the top:
-                    QCPItemBracket *bracket = new QCPItemBracket(ui->graphingView);
-                    bracket->left->setCoords(params.prevValLocation);
-                    bracket->right->setCoords(x, params.prevValLocation.y());
-                    bracket->setLength(12);
-                    params.brackets.append(bracket);
-
-                    // add text label for this value table entry
-                    QCPItemText *valueText = new QCPItemText(ui->graphingView);
-                    valueText->position->setParentAnchor(bracket->center);
-                    valueText->position->setCoords(0, -10.0); // move 10 pixels to the top from bracket center anchor
-                    valueText->setPositionAlignment(Qt::AlignBottom|Qt::AlignHCenter);
-                    valueText->setText(params.prevValStr);
-                    valueText->setFont(QFont(font().family(), 10));
-                    params.bracketTexts.append(valueText);
+                    build.spans.append({params.prevValLocation, x, params.prevValStr});
                     params.prevValLocation = QPointF(x, y);
                     params.prevValStr = tempStr;
-                    params.lastBracket = bracket;
                 }
                 params.prevValTable = tempVal;
             }
         }
 
-        if (y < yminval) yminval = y;
-        if (y > ymaxval) ymaxval = y;
-        if (x < xminval) xminval = x;
-        if (x > xmaxval) xmaxval = x;
+        if (y < build.yminval) build.yminval = y;
+        if (y > build.ymaxval) build.ymaxval = y;
+        if (x < build.xminval) build.xminval = x;
+        if (x > build.xmaxval) build.xmaxval = x;
     }
 
-    if (params.prevValLocation != QPointF(0,0))
+    //the bracket still open at the end. It becomes lastBracket and appendToGraph keeps stretching it
+    build.haveLastSpan = (params.prevValLocation != QPointF(0,0));
+    if (build.haveLastSpan)
     {
-        QCPItemBracket *bracket = new QCPItemBracket(ui->graphingView);
-        bracket->left->setCoords(params.prevValLocation);
-        bracket->right->setCoords(x, params.prevValLocation.y());
-        bracket->setLength(12);
-
-        // add text label for this value table entry
-        QCPItemText *valueText = new QCPItemText(ui->graphingView);
-        valueText->position->setParentAnchor(bracket->center);
-        valueText->position->setCoords(0, -10.0); // move 10 pixels to the top from bracket center anchor
-        valueText->setPositionAlignment(Qt::AlignBottom|Qt::AlignHCenter);
-        valueText->setText(params.prevValStr);
-        valueText->setFont(QFont(font().family(), 10));
+        build.lastSpan = {params.prevValLocation, x, params.prevValStr};
         params.prevValLocation = QPointF(x, y);
         params.prevValStr = tempStr;
         params.prevValTable = tempVal;
+    }
+    return true;
+}
+
+QCPItemBracket *GraphingWindow::addValueBracket(const GraphBuild::ValueSpan &span, QCPItemText *&text)
+{
+    // add the bracket at the top:
+    QCPItemBracket *bracket = new QCPItemBracket(ui->graphingView);
+    bracket->left->setCoords(span.left);
+    bracket->right->setCoords(span.rightX, span.left.y());
+    bracket->setLength(12);
+
+    // add text label for this value table entry
+    QCPItemText *valueText = new QCPItemText(ui->graphingView);
+    valueText->position->setParentAnchor(bracket->center);
+    valueText->position->setCoords(0, -10.0); // move 10 pixels to the top from bracket center anchor
+    valueText->setPositionAlignment(Qt::AlignBottom|Qt::AlignHCenter);
+    valueText->setText(span.text);
+    valueText->setFont(QFont(font().family(), 10));
+    text = valueText;
+    return bracket;
+}
+
+//back on the GUI thread with a finished series. Puts it into the plot unless the graph was removed or edited meanwhile
+void GraphingWindow::installGraph(GraphBuild &build)
+{
+    GraphParams *refParam = nullptr;
+    for (int i = 0; i < graphParams.count(); i++)
+    {
+        if (graphParams[i].buildId == build.params.buildId && !graphParams[i].ref)
+        {
+            refParam = &graphParams[i];
+            break;
+        }
+    }
+    if (!refParam) return;
+    GraphParams &params = *refParam;
+
+    params.samples = build.params.samples;
+    params.prevValLocation = build.params.prevValLocation;
+    params.prevValStr = build.params.prevValStr;
+    params.prevValTable = build.params.prevValTable;
+    QCPItemText *valueText;
+    for (int i = 0; i < build.spans.count(); i++)
+    {
+        QCPItemBracket *bracket = addValueBracket(build.spans[i], valueText);
+        params.brackets.append(bracket);
+        params.bracketTexts.append(valueText);
         params.lastBracket = bracket;
     }
+    if (build.haveLastSpan) params.lastBracket = addValueBracket(build.lastSpan, valueText);
 
-    if (numEntries == 0)
+    double yminval = build.yminval, ymaxval = build.ymaxval;
+    double xminval = build.xminval, xmaxval = build.xmaxval;
+    if (params.samples.isEmpty()) //nothing ended up on the graph
     {
         yminval = -128.0;
         ymaxval = 128.0;
@@ -1476,30 +1724,31 @@ void GraphingWindow::createGraph(GraphParams &params, bool createGraphParam)
         xmaxval = 100;
     }
 
-    params.xbias = 0;
-
     ui->graphingView->addGraph();
     params.ref = ui->graphingView->graph();
-    if (createGraphParam)
-    {
-        graphParams.append(params);
-        refParam = &graphParams.last();
-    }
 
     selDecorator = new QCPSelectionDecorator(); //this has to be a pointer as it is freed internally to qcustomplot classes
     selDecorator->setBrush(Qt::NoBrush);
     selDecorator->setPen(selectedPen);
     ui->graphingView->graph()->setSelectionDecorator(selDecorator);
 
-    if (params.graphName == nullptr || params.graphName.length() == 0)
-    {
-        params.graphName = QString("0x") + QString::number(params.ID, 16) + ":" + QString::number(params.startBit);
-        params.graphName += "-" + QString::number(params.numBits);
-    }
     ui->graphingView->graph()->setName(params.graphName);
     ui->graphingView->graph()->setProperty("id", params.ID);
 
-    ui->graphingView->graph()->setData(refParam->x,refParam->y);
+    //samples from frames that came in after the build took its copies. updatedFrames skipped this graph while it
+    //was pending
+    params.seriesRead = build.endSequence;
+    QVector<double> newX, newY;
+    appendNewSamples(params, newX, newY);
+
+    if (scopeMode && !params.samples.isEmpty()) //the history from before the scope window isn't wanted either
+    {
+        double cutoff = params.samples.lastX() - scopeSpan();
+        params.samples.removeFront(params.samples.lowerBound(cutoff));
+    }
+    params.lod.rebuild(params.samples);
+    params.lodShown = GraphLOD::View();
+    refreshGraphData(params, true);
 
     ui->graphingView->graph()->setScatterStyle(QCPScatterStyle((QCPScatterStyle::ScatterShape)params.pointType));
 
@@ -1591,4 +1840,7 @@ GraphParams::GraphParams()
     prevValLocation = QPointF(0,0);
     prevValStr = "";
     lastBracket = nullptr;
+    buildId = 0;
+    series = nullptr;
+    seriesRead = 0;
 }
@@ -3,9 +3,16 @@
 
 #include "qcustomplot.h"
 #include "can_structs.h"
+#include "canframestore.h"
 #include "dbc/dbchandler.h"
+#include "graphlod.h"
+#include "graphsamples.h"
+#include "signalseriesstore.h"
+#include "utility.h"
+#include "memoryaccounting.h"
 
 #include <QDialog>
+#include <QThreadPool>
 
 namespace Ui {
 class GraphingWindow;
@@ -36,7 +43,12 @@ public:
     DBC_SIGNAL *associatedSignal;
 
     //the below stuff is used for internal purposes only - code should be refactored so these can be private
-    QVector<double> x, y;
+    GraphSamples samples; //every point of the graph, in time order
+    const SignalSeries *series; //decoded values from the shared store. The graphParams entry holds the reference
+    quint64 seriesRead; //sequence number of the first frame whose sample isn't on the graph yet
+    GraphLOD lod; //min / max pyramid over samples. ref only gets what the current view needs out of this
+    GraphLOD::View lodShown; //level and sample range ref currently holds
+    quint32 buildId; //which build of this graph installGraph should accept
     double xbias;
     int64_t prevValTable;
     QPointF prevValLocation;
@@ -46,15 +58,25 @@ public:
     QList<QCPItemText *> bracketTexts;
 };
 
-class GraphingWindow : public QDialog
+class GraphingWindow : public QDialog, public MemoryReporter
 {
     Q_OBJECT
 
 public:
-    explicit GraphingWindow(const QVector<CANFrame> *, QWidget *parent = 0);
+    explicit GraphingWindow(const CANFrameStore *, QWidget *parent = 0);
     ~GraphingWindow();
     void showEvent(QShowEvent*);
 
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+    qint64 purgeMemory() override;
+
+    //the graphs as they're set up now, for other windows that want to reuse one
+    int graphCount() const { return graphParams.count(); }
+    const GraphParams &graphAt(int idx) const { return graphParams.at(idx); }
+    //the graphs as graph definition (.gdf) lines and back, for workspaces to keep with the frames
+    void writeDefinitions(QIODevice &outFile) const;
+    void readDefinitions(QIODevice &inFile);
+
 public slots:
     void createGraph(GraphParams &params, bool createGraphParam = true);
 
@@ -79,8 +101,9 @@ private slots:
     void rescaleAxis(QCPAxis* axis);
     void rescaleToData();
     void toggleFollowMode();
+    void toggleScopeMode();
     void addNewGraph();    
-    void appendToGraph(GraphParams &params, CANFrame &frame, QVector<double> &x, QVector<double> &y);
+    void xRangeChanged(const QCPRange &range);
     void editSelectedGraph();
     void updatedFrames(int);
     void gotCenterTimeID(uint32_t ID, double timestamp);
@@ -94,8 +117,7 @@ signals:
 private:
     Ui::GraphingWindow *ui;
     DBCHandler *dbcHandler;
-    QList<CANFrame> frameCache;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     QList<GraphParams> graphParams;
     QPen selectedPen;
     QCPSelectionDecorator *selDecorator;
@@ -104,8 +126,47 @@ private:
     bool needScaleSetup; //do we need to set x,y graphing extents?
     bool useOpenGL;
     bool followGraphEnd;
+    bool scopeMode; //live scope: graphs only keep the last scopeSeconds of data and the view follows the end
+    double scopeSeconds;
+    SignalSeriesStore *seriesStore;
+    QThreadPool buildPool;
+    QAtomicInteger<quint32> buildGeneration; //bumped to cancel every build in flight
+    quint32 lastBuildId;
+    bool buildsCancelled; //closing the window stopped some builds, showEvent restarts them
+
+    //what a build task hands back to installGraph
+    struct GraphBuild
+    {
+        struct ValueSpan
+        {
+            QPointF left;
+            double rightX;
+            QString text;
+        };
+        GraphParams params; //samples and the value table state filled in
+        QVector<uint64_t> stamps; //copies of the series as it was when the build started
+        QVector<int64_t> values;
+        QVector<ValueSpan> spans;
+        ValueSpan lastSpan;
+        bool haveLastSpan = false;
+        double xminval, xmaxval, yminval, ymaxval;
+        quint64 endSequence; //sequence number of the first frame the copies don't have
+    };
 
     void showParamsDialog(int idx);
+    void refreshGraphData(GraphParams &params, bool force);
+    void appendToGraph(GraphParams &params, uint64_t stamp, int64_t rawValue, QVector<double> &x, QVector<double> &y);
+    int appendNewSamples(GraphParams &params, QVector<double> &x, QVector<double> &y);
+    SignalSeriesKey seriesKey(const GraphParams &params) const;
+    void removeGraphParams(int idx);
+    void startBuild(GraphParams &params);
+    void resumeBuilds();
+    bool buildSeries(GraphBuild &build, quint32 generation) const;
+    QCPItemBracket *addValueBracket(const GraphBuild::ValueSpan &span, QCPItemText *&text);
+    void installGraph(GraphBuild &build);
+    double scopeSpan() const;
+    double sampleTick() const;
+    void evictOldSamples(GraphParams &params);
     void closeEvent(QCloseEvent *event);
     void readSettings();
     void writeSettings();
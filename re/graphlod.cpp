@@ -0,0 +1,221 @@
+#include "graphlod.h"
+
+#include <algorithm>
+
+void GraphLOD::clear()
+{
+    levels.clear();
+    covered = 0;
+}
+
+qint64 GraphLOD::memoryBytes() const
+{
+    qint64 bytes = static_cast<qint64>(levels.capacity()) * static_cast<qint64>(sizeof(QVector<Bucket>));
+    for (const QVector<Bucket> &level : levels) bytes += static_cast<qint64>(level.capacity()) * static_cast<qint64>(sizeof(Bucket));
+    return bytes;
+}
+
+void GraphLOD::rebuild(const GraphSamples &samples)
+{
+    clear();
+    update(samples);
+}
+
+void GraphLOD::update(const GraphSamples &samples)
+{
+    int count = samples.count();
+    if (count < covered) //somebody shrank the series out from under us. Start over
+    {
+        rebuild(samples);
+        return;
+    }
+
+    for (int i = covered; i < count; i++)
+    {
+        //sample i lands in bucket i >> (SHIFT * level) on every level, always the last or a brand new one
+        double yi = samples.y(i);
+        for (int lvl = 0; lvl < levels.count(); lvl++)
+        {
+            QVector<Bucket> &buckets = levels[lvl];
+            int idx = i >> (GRAPHLOD_SHIFT * (lvl + 1));
+            if (idx == buckets.count()) buckets.append({i, i});
+            else
+            {
+                Bucket &b = buckets[idx];
+                if (yi < samples.y(b.minAt)) b.minAt = i;
+                if (yi > samples.y(b.maxAt)) b.maxAt = i;
+            }
+        }
+    }
+    covered = count;
+
+    while ((levels.isEmpty() ? covered : levels.last().count()) > GRAPHLOD_TOP_BUCKETS) addLevel(samples);
+}
+
+void GraphLOD::dropFront(int num, const GraphSamples &samples)
+{
+    if (num <= 0) return;
+    if (num > covered || (num % dropAlignment()) != 0)
+    {
+        rebuild(samples);
+        return;
+    }
+    //num is a whole number of buckets on every level so each one just loses its first few. The indices in the
+    //rest all move down by num
+    for (int lvl = 0; lvl < levels.count(); lvl++)
+    {
+        QVector<Bucket> &buckets = levels[lvl];
+        buckets.remove(0, num >> (GRAPHLOD_SHIFT * (lvl + 1)));
+        for (Bucket &b : buckets)
+        {
+            b.minAt -= num;
+            b.maxAt -= num;
+        }
+    }
+    covered -= num;
+}
+
+//builds a new top level from the one below it (or from the raw samples for the first level)
+void GraphLOD::addLevel(const GraphSamples &samples)
+{
+    QVector<Bucket> level;
+    if (levels.isEmpty())
+    {
+        level.reserve((covered >> GRAPHLOD_SHIFT) + 1);
+        for (int i = 0; i < covered; i++)
+        {
+            int idx = i >> GRAPHLOD_SHIFT;
+            if (idx == level.count()) level.append({i, i});
+            else
+            {
+                Bucket &b = level[idx];
+                if (samples.y(i) < samples.y(b.minAt)) b.minAt = i;
+                if (samples.y(i) > samples.y(b.maxAt)) b.maxAt = i;
+            }
+        }
+    }
+    else
+    {
+        const QVector<Bucket> &below = levels.last();
+        level.reserve((below.count() >> GRAPHLOD_SHIFT) + 1);
+        for (int j = 0; j < below.count(); j++)
+        {
+            int idx = j >> GRAPHLOD_SHIFT;
+            if (idx == level.count()) level.append(below[j]);
+            else
+            {
+                Bucket &b = level[idx];
+                if (samples.y(below[j].minAt) < samples.y(b.minAt)) b.minAt = below[j].minAt;
+                if (samples.y(below[j].maxAt) > samples.y(b.maxAt)) b.maxAt = below[j].maxAt;
+            }
+        }
+    }
+    levels.append(level);
+}
+
+/*
+ * Sample range covering lower to upper (plus the sample just outside on each side so lines run off the edge) and
+ * the finest level that stays within the point budget for that many pixels.
+ */
+GraphLOD::View GraphLOD::view(const GraphSamples &samples, double lower, double upper, int pixels) const
+{
+    View v;
+    int count = std::min(samples.count(), covered);
+    if (count == 0)
+    {
+        v.level = 0;
+        return v;
+    }
+
+    v.from = samples.lowerBound(lower) - 1;
+    v.to = samples.upperBound(upper);
+    if (v.from < 0) v.from = 0;
+    if (v.to > count - 1) v.to = count - 1;
+    if (v.to < v.from) v.to = v.from;
+
+    int budget = std::max(pixels, 1) * GRAPHLOD_POINTS_PER_PIXEL;
+    int visible = v.to - v.from + 1;
+    v.level = 0;
+    while (v.level < levels.count())
+    {
+        int cost = (v.level == 0) ? visible : 2 * ((visible >> (GRAPHLOD_SHIFT * v.level)) + 1);
+        if (cost <= budget) break;
+        v.level++;
+    }
+    return v;
+}
+
+void GraphLOD::fill(const GraphSamples &samples, View &view, QVector<QCPGraphData> &out) const
+{
+    out.clear();
+    int count = std::min(samples.count(), covered);
+    if (count == 0) return;
+
+    int top = levels.count();
+    if (top == 0 || view.level >= top) //the level asked for is the whole thing anyway
+    {
+        view.from = 0;
+        view.to = count - 1;
+        if (top == 0)
+        {
+            view.level = 0;
+            out.reserve(count);
+            for (int i = 0; i < count; i++) out.append(QCPGraphData(samples.x(i), samples.y(i)));
+            return;
+        }
+        view.level = top;
+        const QVector<Bucket> &topLevel = levels[top - 1];
+        out.reserve(topLevel.count() * 2 + 2);
+        out.append(QCPGraphData(samples.x(0), samples.y(0)));
+        for (int b = 0; b < topLevel.count(); b++) appendBucket(samples, out, topLevel[b]);
+        out.append(QCPGraphData(samples.x(count - 1), samples.y(count - 1)));
+        return;
+    }
+
+    //pad by a view width each side then line both ends up with top level buckets so the two levels meet cleanly
+    int topShift = GRAPHLOD_SHIFT * top;
+    int span = view.to - view.from + 1;
+    int lo = std::max(0, view.from - span);
+    int hi = std::min(count - 1, view.to + span);
+    lo = (lo >> topShift) << topShift;
+    hi = std::min(count - 1, (((hi >> topShift) + 1) << topShift) - 1);
+
+    const QVector<Bucket> &topLevel = levels[top - 1];
+    int detailShift = GRAPHLOD_SHIFT * view.level;
+    out.reserve(topLevel.count() * 2 + ((hi - lo + 1) >> detailShift) * 2 + 4);
+
+    if (lo > 0 || view.level > 0) out.append(QCPGraphData(samples.x(0), samples.y(0)));
+    for (int b = 0; b < (lo >> topShift); b++) appendBucket(samples, out, topLevel[b]);
+
+    if (view.level == 0)
+    {
+        for (int i = lo; i <= hi; i++) out.append(QCPGraphData(samples.x(i), samples.y(i)));
+    }
+    else
+    {
+        const QVector<Bucket> &detail = levels[view.level - 1];
+        for (int b = (lo >> detailShift); b <= (hi >> detailShift); b++) appendBucket(samples, out, detail[b]);
+    }
+
+    for (int b = (hi >> topShift) + 1; b < topLevel.count(); b++) appendBucket(samples, out, topLevel[b]);
+    if (hi < count - 1 || view.level > 0) out.append(QCPGraphData(samples.x(count - 1), samples.y(count - 1)));
+
+    view.from = lo;
+    view.to = hi;
+}
+
+//both extremes in the order they happened. A bucket that only ever saw one value is one point
+void GraphLOD::appendBucket(const GraphSamples &samples, QVector<QCPGraphData> &out, const Bucket &b) const
+{
+    if (b.minAt < b.maxAt)
+    {
+        out.append(QCPGraphData(samples.x(b.minAt), samples.y(b.minAt)));
+        out.append(QCPGraphData(samples.x(b.maxAt), samples.y(b.maxAt)));
+    }
+    else if (b.maxAt < b.minAt)
+    {
+        out.append(QCPGraphData(samples.x(b.maxAt), samples.y(b.maxAt)));
+        out.append(QCPGraphData(samples.x(b.minAt), samples.y(b.minAt)));
+    }
+    else out.append(QCPGraphData(samples.x(b.minAt), samples.y(b.minAt)));
+}
@@ -0,0 +1,67 @@
+#ifndef GRAPHLOD_H
+#define GRAPHLOD_H
+
+#include <QVector>
+#include "qcustomplot.h"
+#include "graphsamples.h"
+
+//each level's buckets cover 2^GRAPHLOD_SHIFT of the buckets (or samples) below it
+#define GRAPHLOD_SHIFT              2
+//another level gets added once the current top one has more buckets than this
+#define GRAPHLOD_TOP_BUCKETS        4096
+//how many points per pixel of plot width are worth handing to QCustomPlot
+#define GRAPHLOD_POINTS_PER_PIXEL   4
+
+/*
+ * Min/max pyramid over one graph's samples so QCustomPlot only ever gets about as many points as the plot is wide.
+ * Level 0 is the raw samples themselves (GraphParams samples, not stored again here). Each level above that keeps
+ * which sample was the lowest and which the highest of every 4 buckets in the level below. Drawing a bucket as
+ * those two samples in time order keeps every spike visible no matter how far out the view is. Buckets only hold
+ * the two sample indices, the values are read back out of the samples when they're needed.
+ *
+ * The samples have to be in time order, which is how they come out of a capture.
+ *
+ * update() picks up whatever was appended to the samples since the last call, so building as frames come in costs a
+ * handful of compares per sample. view() works out which level suits a visible range and fill() produces the points:
+ * the visible part (plus a view width either side so small pans don't need a refill) at that level and the rest of
+ * the series at the top level, so rescaling and the ends of the graph still see all of it.
+ */
+class GraphLOD
+{
+public:
+    struct View
+    {
+        int level = -1; //0 = raw samples
+        int from = 0; //sample index range, inclusive
+        int to = -1;
+    };
+
+    void clear();
+    void rebuild(const GraphSamples &samples);
+    void update(const GraphSamples &samples);
+    //samples that can come off the front without disturbing any bucket boundaries have to be a multiple of this
+    int dropAlignment() const { return levels.isEmpty() ? 1 : (1 << (GRAPHLOD_SHIFT * levels.count())); }
+    //num samples were just taken off the front of the samples. Cheap when num is a multiple of dropAlignment()
+    void dropFront(int num, const GraphSamples &samples);
+
+    int levelCount() const { return levels.count(); }
+    qint64 memoryBytes() const;
+    View view(const GraphSamples &samples, double lower, double upper, int pixels) const;
+    //view.from / to get widened to what was actually filled in at view.level
+    void fill(const GraphSamples &samples, View &view, QVector<QCPGraphData> &out) const;
+
+private:
+    struct Bucket
+    {
+        int minAt; //sample index of the lowest and the highest value
+        int maxAt;
+    };
+
+    void addLevel(const GraphSamples &samples);
+    void appendBucket(const GraphSamples &samples, QVector<QCPGraphData> &out, const Bucket &b) const;
+
+    QVector<QVector<Bucket>> levels; //levels[0] is level 1
+    int covered = 0; //samples the levels have taken in
+};
+
+#endif // GRAPHLOD_H
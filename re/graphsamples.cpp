@@ -0,0 +1,108 @@
+#include "graphsamples.h"
+
+#include <cmath>
+
+//largest delta a uint32 holds
+#define GRAPHSAMPLES_MAX_DELTA  4294967295.0
+
+double GraphSamples::x(int i) const
+{
+    int slot = front + i;
+    const Block &b = blocks[slot >> GRAPHSAMPLES_BLOCK_SHIFT];
+    return b.base + std::ldexp(static_cast<double>(deltas[slot]), b.shift) * tick;
+}
+
+void GraphSamples::append(double x, double y)
+{
+    int slot = values.count();
+    int idx = slot >> GRAPHSAMPLES_BLOCK_SHIFT;
+    values.append(static_cast<float>(y));
+    if (idx == blocks.count()) //first sample of a new block is its base
+    {
+        blocks.append({x, 0});
+        deltas.append(0);
+        return;
+    }
+
+    Block &b = blocks[idx];
+    double ticks = (x - b.base) / tick;
+    if (ticks < 0.0) ticks = 0.0; //out of order, it gets pinned to the start of its block
+    while (std::ldexp(ticks, -b.shift) > GRAPHSAMPLES_MAX_DELTA)
+    {
+        //too far from the base at this resolution. Halve it for the whole block
+        b.shift++;
+        for (int j = idx << GRAPHSAMPLES_BLOCK_SHIFT; j < slot; j++)
+            deltas[j] = static_cast<quint32>((static_cast<quint64>(deltas[j]) + 1) >> 1);
+    }
+    deltas.append(static_cast<quint32>(std::llround(std::ldexp(ticks, -b.shift))));
+}
+
+void GraphSamples::reserve(int num)
+{
+    values.reserve(front + num);
+    deltas.reserve(front + num);
+    blocks.reserve(((front + num) >> GRAPHSAMPLES_BLOCK_SHIFT) + 1);
+}
+
+void GraphSamples::clear()
+{
+    values.clear();
+    deltas.clear();
+    blocks.clear();
+    front = 0;
+}
+
+void GraphSamples::squeeze()
+{
+    values.squeeze();
+    deltas.squeeze();
+    blocks.squeeze();
+}
+
+void GraphSamples::removeFront(int num)
+{
+    if (num <= 0) return;
+    if (num >= count())
+    {
+        clear();
+        return;
+    }
+    front += num;
+    int drop = front >> GRAPHSAMPLES_BLOCK_SHIFT;
+    if (drop == 0) return;
+    blocks.remove(0, drop);
+    values.remove(0, drop << GRAPHSAMPLES_BLOCK_SHIFT);
+    deltas.remove(0, drop << GRAPHSAMPLES_BLOCK_SHIFT);
+    front -= drop << GRAPHSAMPLES_BLOCK_SHIFT;
+}
+
+int GraphSamples::lowerBound(double t) const
+{
+    int lo = 0, hi = count();
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (x(mid) < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int GraphSamples::upperBound(double t) const
+{
+    int lo = 0, hi = count();
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (x(mid) <= t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+qint64 GraphSamples::memoryBytes() const
+{
+    return static_cast<qint64>(values.capacity()) * static_cast<qint64>(sizeof(float))
+            + static_cast<qint64>(deltas.capacity()) * static_cast<qint64>(sizeof(quint32))
+            + static_cast<qint64>(blocks.capacity()) * static_cast<qint64>(sizeof(Block));
+}
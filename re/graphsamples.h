@@ -0,0 +1,64 @@
+#ifndef GRAPHSAMPLES_H
+#define GRAPHSAMPLES_H
+
+#include <QVector>
+
+//samples per block, each block has its own time base. 2^this
+#define GRAPHSAMPLES_BLOCK_SHIFT    10
+
+/*
+ * One graph's samples, 8 bytes each instead of the 16 two doubles take. Values are float32. Times are grouped into
+ * blocks of 1024 samples. Each block has a 64 bit (double) base, and each sample stores how many ticks it comes
+ * after that base in a uint32. A tick is the finest step of X worth keeping: a microsecond in whatever units the
+ * graph's X is in. A block whose samples are more than 2^32 ticks apart (71 minutes of microseconds) drops to
+ * twice the tick, as often as it needs to. That costs time resolution in that one block only, and only for sparse
+ * signals where a microsecond doesn't matter anyway.
+ *
+ * Samples have to be appended in time order. Reading one back is a couple of loads and a multiply, so everything
+ * reads through x() / y() rather than keeping its own copy. The vectors are implicitly shared, so copying the whole
+ * thing for another thread or an export is cheap until one side appends.
+ *
+ * float32 has 24 bits of mantissa, so a value with more significant digits than that (a raw 32 bit counter, say)
+ * comes back rounded. The value table and everything else that needs exact values use the raw series instead.
+ */
+class GraphSamples
+{
+public:
+    explicit GraphSamples(double tick = 1.0) : tick(tick) {}
+
+    int count() const { return values.count() - front; }
+    bool isEmpty() const { return count() == 0; }
+    double x(int i) const;
+    double y(int i) const { return values[front + i]; }
+    double firstX() const { return x(0); }
+    double lastX() const { return x(count() - 1); }
+    double xTick() const { return tick; }
+
+    void append(double x, double y);
+    void reserve(int num);
+    void clear();
+    void squeeze();
+    //takes num samples off the front. Whole blocks get freed, a partial one stays until the rest of it goes
+    void removeFront(int num);
+
+    //first sample at or after t / first one after t, count() if none
+    int lowerBound(double t) const;
+    int upperBound(double t) const;
+
+    qint64 memoryBytes() const;
+
+private:
+    struct Block
+    {
+        double base;
+        int shift; //deltas are in units of tick << shift
+    };
+
+    QVector<float> values; //from the first block's first slot on, including the front ones already removed
+    QVector<quint32> deltas;
+    QVector<Block> blocks;
+    int front = 0; //slots of the first block that were removed
+    double tick;
+};
+
+#endif // GRAPHSAMPLES_H
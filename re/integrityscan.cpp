@@ -0,0 +1,429 @@
+#include "integrityscan.h"
+#include "utility.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <cstring>
+
+//looser than INTEGRITY_CHECKSUM_FIT so one bad frame early on doesn't throw out a real checksum
+#define INTEGRITY_PROBE_FIT         0.90
+
+namespace
+{
+struct ChecksumSpec
+{
+    const char *name;
+    uint8_t poly;   //0 for the two that aren't CRCs
+    bool reflected;
+};
+
+const ChecksumSpec checksumSpecs[CHECKSUM_ALGORITHMS] =
+{
+    {"XOR", 0, false},
+    {"SUM8", 0, false},
+    {"CRC8_J1850", 0x1D, false},
+    {"CRC8_AUTOSAR", 0x2F, false},
+    {"CRC8_SMBUS", 0x07, false},
+    {"CRC8_MAXIM", 0x31, true},
+    {"CRC8_CDMA2000", 0x9B, false},
+    {"CRC8_DVBS2", 0xD5, false},
+};
+
+//a byte at a time table for every CRC above. Reflected or not an 8 bit CRC steps the same way, only the table differs
+const uint8_t *crcTable(int algorithm)
+{
+    static uint8_t tables[CHECKSUM_ALGORITHMS][256];
+    static bool built = [] {
+        for (int a = 0; a < CHECKSUM_ALGORITHMS; a++)
+        {
+            const ChecksumSpec &spec = checksumSpecs[a];
+            if (!spec.poly) continue;
+            uint8_t rpoly = 0;
+            for (int b = 0; b < 8; b++) if (spec.poly & (1 << b)) rpoly |= static_cast<uint8_t>(0x80 >> b);
+            for (int i = 0; i < 256; i++)
+            {
+                uint8_t crc = static_cast<uint8_t>(i);
+                for (int b = 0; b < 8; b++)
+                {
+                    if (spec.reflected) crc = (crc & 1) ? static_cast<uint8_t>((crc >> 1) ^ rpoly) : static_cast<uint8_t>(crc >> 1);
+                    else crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ spec.poly) : static_cast<uint8_t>(crc << 1);
+                }
+                tables[a][i] = crc;
+            }
+        }
+        return true;
+    }();
+    Q_UNUSED(built);
+    return tables[algorithm];
+}
+
+QString hexByte(uint8_t value)
+{
+    return "0x" + QString("%1").arg(value, 2, 16, QChar('0')).toUpper();
+}
+
+//what the rest of the frame has to be XORed with (added to for SUM8) to give the checksum byte
+inline uint8_t residualOf(int algorithm, uint8_t observed, uint8_t computed)
+{
+    return (algorithm == CHECKSUM_SUM8) ? static_cast<uint8_t>(observed - computed) : static_cast<uint8_t>(observed ^ computed);
+}
+
+/*
+ * A counter in one field of every frame. The most common change from one frame to the next is taken as the step,
+ * the smallest and largest values seen as the range, and then every frame is checked against the one before
+ * moved on by a step round that range. A counter has to go right round at least once to be believed.
+ */
+bool findCounter(const uint8_t *data, int frames, int length, int byte, int shift, int bits, IntegrityField &out)
+{
+    const int mask = (1 << bits) - 1;
+    int deltas[256] = {0};
+    int lo = mask, hi = 0, prev = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        int v = (data[i * length + byte] >> shift) & mask;
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        if (i) deltas[(v - prev) & mask]++;
+        prev = v;
+    }
+    int range = hi - lo + 1;
+    if (range < 4) return false;
+
+    int step = 0;
+    for (int d = 1; d <= mask; d++)
+    {
+        if (deltas[d] > deltas[step] || !step) step = d;
+    }
+    if (step >= range) step = step - (mask + 1) + range; //counting down round a range narrower than the field
+    if (step <= 0 || step >= range) return false;
+
+    int hits = 0, wraps = 0;
+    prev = (data[byte] >> shift) & mask;
+    for (int i = 1; i < frames; i++)
+    {
+        int v = (data[i * length + byte] >> shift) & mask;
+        int moved = prev - lo + step;
+        if (v == lo + moved % range)
+        {
+            hits++;
+            if (moved >= range) wraps++;
+        }
+        prev = v;
+    }
+    double fit = static_cast<double>(hits) / (frames - 1);
+    if (fit < INTEGRITY_COUNTER_FIT || !wraps || hits < range) return false;
+
+    out.kind = INTEGRITY_COUNTER;
+    out.byte = byte;
+    out.shift = shift;
+    out.bits = bits;
+    out.step = step;
+    out.low = lo;
+    out.high = hi;
+    out.algorithm = -1;
+    out.residual = 0;
+    out.length = length;
+    out.fit = fit;
+    out.frames = frames;
+    return true;
+}
+
+//how often the commonest residual of the first frames of data turns up
+int residualMajority(int algorithm, const uint8_t *data, int frames, int length, int pos, uint8_t &residual)
+{
+    int counts[256] = {0};
+    for (int i = 0; i < frames; i++)
+    {
+        const uint8_t *frame = data + i * length;
+        counts[residualOf(algorithm, frame[pos], IntegrityScanner::checksum(algorithm, frame, length, pos))]++;
+    }
+    int best = 0;
+    for (int r = 1; r < 256; r++)
+    {
+        if (counts[r] > counts[best]) best = r;
+    }
+    residual = static_cast<uint8_t>(best);
+    return counts[best];
+}
+}
+
+QString IntegrityScanner::algorithmName(int algorithm)
+{
+    if (algorithm < 0 || algorithm >= CHECKSUM_ALGORITHMS) return QString();
+    return QString(checksumSpecs[algorithm].name);
+}
+
+uint8_t IntegrityScanner::checksum(int algorithm, const uint8_t *data, int len, int skip)
+{
+    uint8_t value = 0;
+    switch (algorithm)
+    {
+    case CHECKSUM_XOR:
+        for (int i = 0; i < len; i++) if (i != skip) value ^= data[i];
+        break;
+    case CHECKSUM_SUM8:
+        for (int i = 0; i < len; i++) if (i != skip) value = static_cast<uint8_t>(value + data[i]);
+        break;
+    default:
+    {
+        const uint8_t *table = crcTable(algorithm);
+        for (int i = 0; i < len; i++) if (i != skip) value = table[value ^ data[i]];
+        break;
+    }
+    }
+    return value;
+}
+
+bool IntegritySample::build(const CANFrameStore *store, const QVector<int> &rows, uint32_t id, int bus)
+{
+    this->id = id;
+    this->bus = bus;
+    length = 0;
+    frames = 0;
+    data.clear();
+    int first = std::max(0, static_cast<int>(rows.count()) - INTEGRITY_MAX_FRAMES);
+    if (rows.count() - first < INTEGRITY_MIN_FRAMES) return false;
+
+    //remote and error frames don't carry either, and frames of some other length are usually another layout
+    //sharing the ID
+    int lengthCounts[65] = {0};
+    for (int r = first; r < rows.count(); r++)
+    {
+        const CANFrameRecord &rec = store->record(rows[r]);
+        if (rec.type() == QCanBusFrame::DataFrame) lengthCounts[std::min<int>(rec.len, 64)]++;
+    }
+    length = static_cast<int>(std::max_element(lengthCounts + 1, lengthCounts + 65) - lengthCounts);
+    if (lengthCounts[length] < INTEGRITY_MIN_FRAMES) return false;
+
+    frames = lengthCounts[length];
+    data.resize(frames * length);
+    uint8_t *out = data.data();
+    for (int r = first; r < rows.count(); r++)
+    {
+        const CANFrameRecord &rec = store->record(rows[r]);
+        if (rec.len != length || rec.type() != QCanBusFrame::DataFrame) continue;
+        memcpy(out, store->payloadData(rows[r]), length);
+        out += length;
+    }
+    return true;
+}
+
+/*
+ * Counters first, every byte whole and as two nibbles. A counter that fits in a nibble also shows up as the
+ * whole byte, so the byte only stays if it counts past 16. Then checksums over the bytes that aren't counters,
+ * each tried with every algorithm on a few frames and only the ones still standing given the whole run.
+ */
+QVector<IntegrityField> IntegrityScanner::scan(const IntegritySample &sample)
+{
+    QVector<IntegrityField> found;
+    const int length = sample.length;
+    const int frames = sample.frames;
+    if (frames < INTEGRITY_MIN_FRAMES || length < 1) return found;
+    const uint8_t *bytes = sample.data.constData();
+
+    IntegrityField field;
+    field.id = sample.id;
+    field.bus = sample.bus;
+    QVector<bool> isCounter(length, false);
+    for (int b = 0; b < length; b++)
+    {
+        IntegrityField whole = field, lowNibble = field, highNibble = field;
+        bool haveWhole = findCounter(bytes, frames, length, b, 0, 8, whole);
+        bool haveLow = findCounter(bytes, frames, length, b, 0, 4, lowNibble);
+        bool haveHigh = findCounter(bytes, frames, length, b, 4, 4, highNibble);
+        if (haveWhole && (whole.high - whole.low >= 16 || !haveLow)) found.append(whole);
+        else
+        {
+            if (haveLow) found.append(lowNibble);
+            if (haveHigh) found.append(highNibble);
+        }
+        isCounter[b] = haveWhole || haveLow || haveHigh;
+    }
+
+    //CAN-FD payloads only get their first and last few bytes tried, that's where checksums go. A constant XOR or
+    //sum of the whole frame fits every byte equally well, so it's only listed for the last byte it fits, that's
+    //where they usually are
+    const int probes = std::min(frames, INTEGRITY_PROBE_FRAMES);
+    bool wholeFrame[CHECKSUM_SUM8 + 1] = {false, false};
+    for (int p = length - 1; p >= 0; p--)
+    {
+        if (isCounter[p] || length < 2) continue;
+        if (length > 16 && p >= 8 && p < length - 8) continue;
+
+        bool seen[256] = {false};
+        int distinct = 0;
+        for (int i = 0; i < frames && distinct < INTEGRITY_MIN_CHECKSUM_VALUES; i++)
+        {
+            uint8_t v = bytes[i * length + p];
+            if (!seen[v]) distinct++;
+            seen[v] = true;
+        }
+        if (distinct < INTEGRITY_MIN_CHECKSUM_VALUES) continue;
+
+        IntegrityField best = field;
+        best.fit = 0.0;
+        for (int a = 0; a < CHECKSUM_ALGORITHMS; a++)
+        {
+            if (a <= CHECKSUM_SUM8 && wholeFrame[a]) continue;
+            uint8_t residual;
+            if (residualMajority(a, bytes, probes, length, p, residual) < probes * INTEGRITY_PROBE_FIT) continue;
+            double fit = static_cast<double>(residualMajority(a, bytes, frames, length, p, residual)) / frames;
+            if (fit < INTEGRITY_CHECKSUM_FIT || fit <= best.fit) continue;
+            best.kind = INTEGRITY_CHECKSUM;
+            best.byte = p;
+            best.shift = 0;
+            best.bits = 8;
+            best.step = 0;
+            best.low = 0;
+            best.high = 0;
+            best.algorithm = a;
+            best.residual = residual;
+            best.length = length;
+            best.fit = fit;
+            best.frames = frames;
+        }
+        if (best.fit <= 0.0) continue;
+        if (best.algorithm <= CHECKSUM_SUM8) wholeFrame[best.algorithm] = true;
+        found.append(best);
+    }
+    return found;
+}
+
+QString IntegrityField::details() const
+{
+    if (kind == INTEGRITY_COUNTER)
+    {
+        return QString("Counts %1 to %2 by %3").arg(low).arg(high).arg(step);
+    }
+    QString text = IntegrityScanner::algorithmName(algorithm);
+    if (residual) text += QString(", %1 %2").arg(algorithm == CHECKSUM_SUM8 ? "plus" : "XOR").arg(hexByte(residual));
+    return text + QString(" of the other %1 bytes").arg(length - 1);
+}
+
+QString IntegrityField::spec() const
+{
+    if (kind == INTEGRITY_COUNTER)
+    {
+        return QString("counter byte=%1 shift=%2 bits=%3 step=%4 low=%5 high=%6")
+            .arg(byte).arg(shift).arg(bits).arg(step).arg(low).arg(high);
+    }
+    return QString("checksum byte=%1 algorithm=%2 residual=%3 length=%4")
+            .arg(byte).arg(IntegrityScanner::algorithmName(algorithm)).arg(hexByte(residual)).arg(length);
+}
+
+void IntegrityField::apply(uint8_t *data, int len, quint64 count) const
+{
+    if (byte < 0 || byte >= len) return;
+    if (kind == INTEGRITY_COUNTER)
+    {
+        quint64 range = static_cast<quint64>(std::max(high - low + 1, 1));
+        uint8_t value = static_cast<uint8_t>(low + static_cast<int>((count * static_cast<quint64>(step)) % range));
+        if (bits == 8) data[byte] = value;
+        else
+        {
+            uint8_t mask = static_cast<uint8_t>(0x0F << shift);
+            data[byte] = static_cast<uint8_t>((data[byte] & ~mask) | ((value << shift) & mask));
+        }
+        return;
+    }
+
+    if (len != length) return;
+    uint8_t value = IntegrityScanner::checksum(algorithm, data, len, byte);
+    if (algorithm == CHECKSUM_SUM8) data[byte] = static_cast<uint8_t>(value + residual);
+    else data[byte] = value ^ residual;
+}
+
+QVector<IntegrityField> IntegrityField::parseSpecs(const QString &specs, uint32_t id, int bus)
+{
+    QVector<IntegrityField> fields;
+    for (const QString &entry : specs.split(';', Qt::SkipEmptyParts))
+    {
+        QStringList words = entry.simplified().split(' ', Qt::SkipEmptyParts);
+        if (words.isEmpty()) continue;
+        IntegrityField field = {};
+        field.id = id;
+        field.bus = bus;
+        field.byte = -1;
+        field.bits = 8;
+        field.step = 1;
+        field.high = 255;
+        field.algorithm = -1;
+        if (words[0] == "counter") field.kind = INTEGRITY_COUNTER;
+        else if (words[0] == "checksum") field.kind = INTEGRITY_CHECKSUM;
+        else continue;
+
+        for (int w = 1; w < words.count(); w++)
+        {
+            QString key = words[w].section('=', 0, 0);
+            QString value = words[w].section('=', 1);
+            if (key == "byte") field.byte = value.toInt();
+            else if (key == "shift") field.shift = value.toInt();
+            else if (key == "bits") field.bits = value.toInt();
+            else if (key == "step") field.step = value.toInt();
+            else if (key == "low") field.low = value.toInt();
+            else if (key == "high") field.high = value.toInt();
+            else if (key == "residual") field.residual = static_cast<uint8_t>(Utility::ParseStringToNum(value));
+            else if (key == "length") field.length = value.toInt();
+            else if (key == "algorithm")
+            {
+                for (int a = 0; a < CHECKSUM_ALGORITHMS; a++)
+                {
+                    if (value.compare(IntegrityScanner::algorithmName(a), Qt::CaseInsensitive) == 0) field.algorithm = a;
+                }
+            }
+        }
+        if (field.byte < 0) continue;
+        if (field.kind == INTEGRITY_COUNTER && ((field.bits != 8 && field.bits != 4) || field.high < field.low)) continue;
+        if (field.kind == INTEGRITY_CHECKSUM && field.algorithm < 0) continue;
+        fields.append(field);
+    }
+    return fields;
+}
+
+/*
+ * Modifiers only reach D0 to D7 and only know COUNTER, XSUM, CRC8 (SAE J1850 with init and final XOR of 0xFF) and
+ * plain arithmetic, so counters in the first eight bytes and XOR, SUM8 and J1850 checksums of classic frames are
+ * the ones that can be made. They run strictly left to right, which is what the expressions below count on.
+ */
+QString IntegrityField::modifier() const
+{
+    QString dest = QString("D%1").arg(byte);
+
+    if (kind == INTEGRITY_COUNTER)
+    {
+        if (byte > 7) return QString();
+        int range = high - low + 1;
+        QString expr = "COUNTER";
+        if (step != 1) expr += QString("*%1").arg(step);
+        if (range != 256) expr += QString("%%1").arg(range);
+        if (low) expr += QString("+%1").arg(low);
+        if (bits == 8) return dest + "=" + expr;
+        if (shift) return QString("%1=%1&0x0F,%1=%2*16|%1").arg(dest, expr);
+        return QString("%1=%1&0xF0,%1=%2|%1").arg(dest, expr);
+    }
+
+    if (byte > 7 || length > 8) return QString();
+    switch (algorithm)
+    {
+    case CHECKSUM_XOR:
+        return dest + "=XSUM" + (residual ? "^" + hexByte(residual) : QString());
+    case CHECKSUM_SUM8:
+    {
+        QStringList terms;
+        for (int i = 0; i < length; i++) if (i != byte) terms << QString("D%1").arg(i);
+        if (residual) terms << hexByte(residual);
+        return dest + "=" + terms.join('+');
+    }
+    case CHECKSUM_CRC8_J1850:
+    {
+        //the sender's CRC8 starts from 0xFF and XORs 0xFF on the end. Starting from 0xFF is the same as an
+        //init zero CRC with the first byte flipped, which comes to this much over the zeros of the other bytes
+        uint8_t lead[8] = {0xFF, 0, 0, 0, 0, 0, 0, 0};
+        uint8_t standard = (length > 1) ? (IntegrityScanner::checksum(CHECKSUM_CRC8_J1850, lead, length - 1, -1) ^ 0xFF) : 0;
+        uint8_t r = residual ^ standard;
+        return dest + "=CRC8" + (r ? "^" + hexByte(r) : QString());
+    }
+    }
+    return QString();
+}
@@ -0,0 +1,104 @@
+#ifndef INTEGRITYSCAN_H
+#define INTEGRITYSCAN_H
+
+#include <QString>
+#include <QVector>
+#include "canframestore.h"
+
+//newest frames of an ID a scan looks at. Plenty to see a counter wrap many times over
+#define INTEGRITY_MAX_FRAMES        20000
+//fewer frames than this and nothing found would mean much
+#define INTEGRITY_MIN_FRAMES        32
+//share of steps a counter has to get right. Dropped frames make it miss the odd one
+#define INTEGRITY_COUNTER_FIT       0.90
+//share of frames a checksum has to get right
+#define INTEGRITY_CHECKSUM_FIT      0.98
+//frames a checksum candidate is tried on before the whole run, most candidates are thrown out here
+#define INTEGRITY_PROBE_FRAMES      64
+//a checksum byte has to take at least this many values, a byte that hardly moves matches everything
+#define INTEGRITY_MIN_CHECKSUM_VALUES 4
+
+enum IntegrityKind
+{
+    INTEGRITY_COUNTER,
+    INTEGRITY_CHECKSUM
+};
+
+//the ones the frame sender can make come first, they win a tie
+enum ChecksumAlgorithm
+{
+    CHECKSUM_XOR = 0,
+    CHECKSUM_SUM8,
+    CHECKSUM_CRC8_J1850,
+    CHECKSUM_CRC8_AUTOSAR,
+    CHECKSUM_CRC8_SMBUS,
+    CHECKSUM_CRC8_MAXIM,
+    CHECKSUM_CRC8_CDMA2000,
+    CHECKSUM_CRC8_DVBS2,
+    CHECKSUM_ALGORITHMS
+};
+
+/*
+ * A counter or checksum found in one ID. Counters are a whole byte or one nibble of it going up by step every
+ * frame from low to high and back round to low. A checksum is a whole byte worked out from every other byte of
+ * the frame. The CRCs are all run with an init and final XOR of zero, whatever the real ones are folds into a
+ * residual that gets XORed on (added on for SUM8), so one pass tells the polynomial and the constant together.
+ * A residual only holds for one length, which is why a scan only looks at the ID's most common one.
+ */
+struct IntegrityField
+{
+    uint32_t id;
+    int bus;
+    IntegrityKind kind;
+    int byte;
+    int shift;      //0 for the low nibble or a whole byte, 4 for the high nibble
+    int bits;       //8 or 4
+    int step;       //counter only
+    int low, high;
+    int algorithm;  //checksum only, a ChecksumAlgorithm
+    uint8_t residual;
+    int length;     //payload length a checksum was found over
+    double fit;     //share of frames (counters, of steps) it got right
+    int frames;     //how many it was tried on
+
+    QString details() const;
+    //a DBC attribute value that says the same as details() in a fixed key=value form
+    QString spec() const;
+    //what goes in the frame sender's modifier column to make this field, empty if it can't
+    QString modifier() const;
+    //writes the field into a payload: a counter as it is on the count'th frame, a checksum over what's there now.
+    //A checksum is left alone on a payload of a different length than it was found over
+    void apply(uint8_t *data, int len, quint64 count) const;
+
+    //the fields in a CounterSpec / ChecksumSpec attribute value, the ; separated spec() strings. Bad ones are skipped
+    static QVector<IntegrityField> parseSpecs(const QString &specs, uint32_t id, int bus);
+};
+
+/*
+ * The newest INTEGRITY_MAX_FRAMES data frames of one bus / ID pair at its most common length, payloads one after
+ * another. Copied out on the GUI thread so the scan can run on a pool thread while frames keep arriving.
+ */
+struct IntegritySample
+{
+    uint32_t id = 0;
+    int bus = 0;
+    int length = 0;
+    int frames = 0;
+    QVector<uint8_t> data;
+
+    //rows are the pair's rows in the store, oldest first. False if there aren't enough frames to go on
+    bool build(const CANFrameStore *store, const QVector<int> &rows, uint32_t id, int bus);
+};
+
+class IntegrityScanner
+{
+public:
+    //counters and checksums in one bus / ID pair's frames
+    static QVector<IntegrityField> scan(const IntegritySample &sample);
+
+    static QString algorithmName(int algorithm);
+    //the checksum over every byte of data but skip, with init and final XOR of zero
+    static uint8_t checksum(int algorithm, const uint8_t *data, int len, int skip);
+};
+
+#endif // INTEGRITYSCAN_H
@@ -3,8 +3,25 @@
 #include "mainwindow.h"
 #include "helpwindow.h"
 #include "filterutility.h"
+#include "pipelinetrace.h"
 
-ISOTP_InterpreterWindow::ISOTP_InterpreterWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+#include <QRunnable>
+#include <functional>
+
+namespace
+{
+//a pass over the captured frames on interpretPool
+class InterpretTask : public QRunnable
+{
+public:
+    explicit InterpretTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() override { task(); }
+private:
+    std::function<void()> task;
+};
+}
+
+ISOTP_InterpreterWindow::ISOTP_InterpreterWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::ISOTP_InterpreterWindow)
 {
@@ -20,8 +37,8 @@ ISOTP_InterpreterWindow::ISOTP_InterpreterWindow(const QVector<CANFrame> *frames
 
     udsDecoder->setReception(false);
 
+    //the decoder isn't given framesUpdated, a new set of frames is gone over on interpretPool instead
     connect(MainWindow::getReference(), &MainWindow::framesUpdated, this, &ISOTP_InterpreterWindow::updatedFrames);
-    connect(MainWindow::getReference(), &MainWindow::framesUpdated, decoder, &ISOTP_HANDLER::updatedFrames);
     connect(decoder, &ISOTP_HANDLER::newISOMessage, this, &ISOTP_InterpreterWindow::newISOMessage);
     connect(udsDecoder, &UDS_HANDLER::newUDSMessage, this, &ISOTP_InterpreterWindow::newUDSMessage);
     connect(ui->listFilter, &QListWidget::itemChanged, this, &ISOTP_InterpreterWindow::listFilterItemChanged);
@@ -29,20 +46,22 @@ ISOTP_InterpreterWindow::ISOTP_InterpreterWindow(const QVector<CANFrame> *frames
     connect(ui->btnNone, &QPushButton::clicked, this, &ISOTP_InterpreterWindow::filterNone);
     connect(ui->btnCaptured, &QPushButton::clicked, this, &ISOTP_InterpreterWindow::interpretCapturedFrames);
 
-    connect(ui->tableIsoFrames, &QTableWidget::itemSelectionChanged, this, &ISOTP_InterpreterWindow::showDetailView);
     connect(ui->btnClearList, &QPushButton::clicked, this, &ISOTP_InterpreterWindow::clearList);
     connect(ui->cbUseExtendedAddressing, SIGNAL(toggled(bool)), this, SLOT(useExtendedAddressing(bool)));
 
-    QStringList headers;
-    headers << "Timestamp" << "ID" << "Bus" << "Dir" << "Length" << "Data";
-    ui->tableIsoFrames->setColumnCount(6);
+    messageModel = new ISOTPMessageModel(this);
+    ui->tableIsoFrames->setModel(messageModel);
+    ui->tableIsoFrames->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->tableIsoFrames->setSelectionMode(QAbstractItemView::SingleSelection);
+    ui->tableIsoFrames->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ui->tableIsoFrames->verticalHeader()->setDefaultSectionSize(QFontMetrics(ui->tableIsoFrames->font()).height() + 6);
+    connect(ui->tableIsoFrames->selectionModel(), &QItemSelectionModel::currentRowChanged, this, &ISOTP_InterpreterWindow::showDetailView);
     ui->tableIsoFrames->setColumnWidth(0, 100);
     ui->tableIsoFrames->setColumnWidth(1, 50);
     ui->tableIsoFrames->setColumnWidth(2, 50);
     ui->tableIsoFrames->setColumnWidth(3, 50);
     ui->tableIsoFrames->setColumnWidth(4, 75);
     ui->tableIsoFrames->setColumnWidth(5, 200);
-    ui->tableIsoFrames->setHorizontalHeaderLabels(headers);
     QHeaderView *HorzHdr = ui->tableIsoFrames->horizontalHeader();
     HorzHdr->setStretchLastSection(true);
     connect(HorzHdr, SIGNAL(sectionClicked(int)), this, SLOT(headerClicked(int)));
@@ -50,10 +69,19 @@ ISOTP_InterpreterWindow::ISOTP_InterpreterWindow(const QVector<CANFrame> *frames
     decoder->setReception(true);
     decoder->setFlowCtrl(false);
     decoder->setProcessAll(true);
+
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(ISOTP_INTERPRETER_FLUSH_MS);
+    connect(&flushTimer, &QTimer::timeout, this, &ISOTP_InterpreterWindow::flushPending);
+    interpretPool.setMaxThreadCount(1);
 }
 
 ISOTP_InterpreterWindow::~ISOTP_InterpreterWindow()
 {
+    //a pass still running uses the decoder
+    interpretGeneration.ref();
+    interpretPool.clear();
+    interpretPool.waitForDone();
     delete decoder;
     delete ui;
 }
@@ -63,20 +91,7 @@ void ISOTP_InterpreterWindow::showEvent(QShowEvent* event)
     QDialog::showEvent(event);
     readSettings();
 
-    QProgressDialog progress(qApp->activeWindow());
-    progress.setWindowModality(Qt::WindowModal);
-    progress.setLabelText("Analyzing Frames...");
-    progress.setCancelButton(nullptr);
-    progress.setRange(0,0);
-    progress.setMinimumDuration(0);
-    progress.show();
-
-    qApp->processEvents();
-
-    decoder->updatedFrames(-2);
-    //decoder->rapidFrames(nullptr, *modelFrames);
-
-    progress.cancel();
+    interpretCapturedFrames();
 
     installEventFilter(this);
 }
@@ -127,11 +142,52 @@ void ISOTP_InterpreterWindow::writeSettings()
     }
 }
 
-//erase current list then repopulate as if all the previously captured frames just came in again.
+/*
+ * Erase the current list then repopulate it as if all the previously captured frames just came in again. The frames
+ * are put together on interpretPool from a snapshot, with sessions apart from the live ones, and come back in one
+ * go. Starting again or clearing meanwhile bumps the generation so whatever the old pass finds is dropped.
+ */
 void ISOTP_InterpreterWindow::interpretCapturedFrames()
 {
     clearList();
-    decoder->updatedFrames(-2);
+    decoder->updatedFrames(-1); //whatever the live sessions were in the middle of doesn't continue into the capture
+
+    CANFrameSnapshot frames;
+    QVector<quint32> keys;
+    if (modelFrames->isView())
+    {
+        frames = modelFrames->viewSource()->snapshot();
+        keys = modelFrames->keys();
+        if (keys.isEmpty()) return;
+    }
+    else frames = modelFrames->snapshot();
+    if (frames.isEmpty()) return;
+
+    quint32 generation = interpretGeneration.loadRelaxed();
+    setInterpreting(true);
+    interpretPool.start(new InterpretTask([this, frames, keys, generation]()
+    {
+        QVector<ISOTP_MESSAGE> found = decoder->reassemble(frames, keys, [this, generation]()
+        {
+            return interpretGeneration.loadRelaxed() == generation;
+        });
+        QMetaObject::invokeMethod(this, [this, found, generation]()
+        {
+            if (interpretGeneration.loadRelaxed() != generation) return;
+            for (const ISOTP_MESSAGE &msg : found)
+            {
+                if (acceptMessage(msg)) pending.append(msg);
+            }
+            flushPending();
+            setInterpreting(false);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void ISOTP_InterpreterWindow::setInterpreting(bool running)
+{
+    ui->btnCaptured->setEnabled(!running);
+    ui->btnCaptured->setText(running ? tr("Interpreting Captured Frames...") : tr("Interpret Previously Captured Frames"));
 }
 
 void ISOTP_InterpreterWindow::listFilterItemChanged(QListWidgetItem *item)
@@ -166,9 +222,12 @@ void ISOTP_InterpreterWindow::filterNone()
 void ISOTP_InterpreterWindow::clearList()
 {
     qDebug() << "Clearing the table";
-    ui->tableIsoFrames->clearContents();
-    ui->tableIsoFrames->model()->removeRows(0, ui->tableIsoFrames->rowCount());
-    messages.clear();
+    interpretGeneration.ref();
+    setInterpreting(false);
+    flushTimer.stop();
+    pending.clear();
+    messageModel->clear();
+    ui->txtFrameDetails->clear();
     //idFilters.clear();
 }
 
@@ -180,13 +239,20 @@ void ISOTP_InterpreterWindow::useExtendedAddressing(bool checked)
 
 void ISOTP_InterpreterWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("ISOTP_InterpreterWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted. Kill the display
     {
         clearList();
+        decoder->updatedFrames(-1);
     }
     else if (numFrames == -2) //all new set of frames. Reset
     {
-        clearList();
+        if (isVisible()) interpretCapturedFrames();
+        else
+        {
+            clearList();
+            decoder->updatedFrames(-1);
+        }
     }
     else //just got some new frames. See if they are relevant.
     {
@@ -195,28 +261,27 @@ void ISOTP_InterpreterWindow::updatedFrames(int numFrames)
 
 void ISOTP_InterpreterWindow::headerClicked(int logicalIndex)
 {
-    ui->tableIsoFrames->setSortingEnabled(false);
-    ui->tableIsoFrames->sortByColumn(logicalIndex, Qt::SortOrder::AscendingOrder);
+    messageModel->sort(logicalIndex, Qt::SortOrder::AscendingOrder);
 }
 
 void ISOTP_InterpreterWindow::showDetailView()
 {
     QString buildString;
-    ISOTP_MESSAGE *msg;
-    int rowNum = ui->tableIsoFrames->currentRow();
+    int rowNum = ui->tableIsoFrames->currentIndex().row();
 
     ui->txtFrameDetails->clear();
     if (rowNum == -1) return;
 
-    msg = &messages[rowNum];
+    //only the selected message is put back together and decoded
+    ISOTP_MESSAGE msg = messageModel->message(rowNum);
 
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(msg->payload().constData());
-    int dataLen = msg->payload().length();
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(msg.payload().constData());
+    int dataLen = msg.payload().length();
 
-    if (msg->reportedLength != dataLen)
+    if (msg.reportedLength != dataLen)
     {
         buildString.append("Message didn't have the correct number of bytes.\rExpected "
-                           + QString::number(msg->reportedLength) + " got "
+                           + QString::number(msg.reportedLength) + " got "
                            + QString::number(dataLen) + "\r\r");
     }
 
@@ -232,7 +297,7 @@ void ISOTP_InterpreterWindow::showDetailView()
     ui->txtFrameDetails->setPlainText(buildString);
 
     //pass this frame to the UDS decoder to see if it feels it could be a UDS related message
-    udsDecoder->gotISOTPFrame(messages[rowNum]);
+    udsDecoder->gotISOTPFrame(msg);
 }
 
 void ISOTP_InterpreterWindow::newUDSMessage(UDS_MESSAGE msg)
@@ -247,15 +312,10 @@ void ISOTP_InterpreterWindow::newUDSMessage(UDS_MESSAGE msg)
     ui->txtFrameDetails->setPlainText(buildText);
 }
 
-void ISOTP_InterpreterWindow::newISOMessage(ISOTP_MESSAGE msg)
+//the incomplete and ID filters. An ID not seen before gets its filter entry here, checked
+bool ISOTP_InterpreterWindow::acceptMessage(const ISOTP_MESSAGE &msg)
 {
-    int rowNum;
-    QString tempString;
-
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(msg.payload().constData());
-    int dataLen = msg.payload().length();
-
-    if ((msg.reportedLength != dataLen) && !ui->cbShowIncomplete->isChecked()) return;
+    if ((msg.reportedLength != msg.payload().length()) && !ui->cbShowIncomplete->isChecked()) return false;
 
     if (idFilters.find(msg.frameId()) == idFilters.end())
     {
@@ -263,27 +323,19 @@ void ISOTP_InterpreterWindow::newISOMessage(ISOTP_MESSAGE msg)
 
         FilterUtility::createCheckableFilterItem(msg.frameId(), true, ui->listFilter);
     }
-    if (!idFilters[msg.frameId()]) return;
-    messages.append(msg);
-
-    rowNum = ui->tableIsoFrames->rowCount();
-
-    ui->tableIsoFrames->insertRow(rowNum);
+    return idFilters[msg.frameId()];
+}
 
-    QTableWidgetItem *item = new QTableWidgetItem;
-    item->setData(Qt::EditRole, Utility::formatTimestamp(msg.timeStamp().microSeconds()));
-    //ui->tableIsoFrames->setItem(rowNum, 0, (double)msg.timestamp, Utility::formatTimestamp(msg.timestamp)));
-    ui->tableIsoFrames->setItem(rowNum, 0, item);
-    ui->tableIsoFrames->setItem(rowNum, 1, new QTableWidgetItem(QString::number(msg.frameId(), 16)));
-    ui->tableIsoFrames->setItem(rowNum, 2, new QTableWidgetItem(QString::number(msg.bus)));
-    if (msg.isReceived) ui->tableIsoFrames->setItem(rowNum, 3, new QTableWidgetItem("Rx"));
-    else ui->tableIsoFrames->setItem(rowNum, 3, new QTableWidgetItem("Tx"));
-    ui->tableIsoFrames->setItem(rowNum, 4, new QTableWidgetItem(QString::number(msg.payload().length())));
+void ISOTP_InterpreterWindow::newISOMessage(ISOTP_MESSAGE msg)
+{
+    if (!acceptMessage(msg)) return;
+    pending.append(msg);
+    if (!flushTimer.isActive()) flushTimer.start();
+}
 
-    for (int i = 0; i < dataLen; i++)
-    {
-        tempString.append(Utility::formatNumber(data[i]));
-        tempString.append(" ");
-    }
-    ui->tableIsoFrames->setItem(rowNum, 5, new QTableWidgetItem(tempString));
+void ISOTP_InterpreterWindow::flushPending()
+{
+    flushTimer.stop();
+    messageModel->append(pending);
+    pending.clear();
 }
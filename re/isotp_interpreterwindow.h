@@ -2,7 +2,13 @@
 #define ISOTP_INTERPRETERWINDOW_H
 
 #include <QDialog>
+#include <QThreadPool>
+#include <QTimer>
 #include "bus_protocols/isotp_handler.h"
+#include "isotpmessagemodel.h"
+
+//messages that came in are put in the table at most this often, all of them in one go
+#define ISOTP_INTERPRETER_FLUSH_MS      100
 
 class ISOTP_MESSAGE;
 class ISOTP_HANDLER;
@@ -16,7 +22,7 @@ class ISOTP_InterpreterWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit ISOTP_InterpreterWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit ISOTP_InterpreterWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~ISOTP_InterpreterWindow();
     void showEvent(QShowEvent*);
 
@@ -32,20 +38,27 @@ private slots:
     void interpretCapturedFrames();
     void useExtendedAddressing(bool checked);
     void headerClicked(int logicalIndex);
+    void flushPending();
 
 private:
     Ui::ISOTP_InterpreterWindow *ui;
     ISOTP_HANDLER *decoder;
     UDS_HANDLER *udsDecoder;
 
-    const QVector<CANFrame> *modelFrames;
-    QVector<ISOTP_MESSAGE> messages;
+    const CANFrameStore *modelFrames;
+    ISOTPMessageModel *messageModel;
+    QVector<ISOTP_MESSAGE> pending; //passed the filters, not in the table yet
+    QTimer flushTimer;
     QHash<int, bool> idFilters;
+    QThreadPool interpretPool; //one thread, for going back over the captured frames
+    QAtomicInteger<quint32> interpretGeneration; //bumped to throw away a pass in flight
 
     void closeEvent(QCloseEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
     void readSettings();
     void writeSettings();
+    bool acceptMessage(const ISOTP_MESSAGE &msg);
+    void setInterpreting(bool running);
 
 };
 
@@ -0,0 +1,163 @@
+#include "isotpmessagemodel.h"
+#include "utility.h"
+
+#include <algorithm>
+
+ISOTPMessageModel::ISOTPMessageModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+QVariant ISOTPMessageModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) return QVariant();
+    if (orientation == Qt::Vertical) return QString::number(section + 1);
+
+    switch (section)
+    {
+    case TIME_COL:
+        return tr("Timestamp");
+    case ID_COL:
+        return tr("ID");
+    case BUS_COL:
+        return tr("Bus");
+    case DIR_COL:
+        return tr("Dir");
+    case LENGTH_COL:
+        return tr("Length");
+    case DATA_COL:
+        return tr("Data");
+    }
+    return QVariant();
+}
+
+int ISOTPMessageModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return COLUMNS;
+}
+
+int ISOTPMessageModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return rows.count();
+}
+
+QVariant ISOTPMessageModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.count() || role != Qt::DisplayRole) return QVariant();
+    const Entry &entry = entries.at(rows.at(index.row()));
+
+    switch (index.column())
+    {
+    case TIME_COL:
+        return Utility::formatTimestamp(entry.stamp);
+    case ID_COL:
+        return QString::number(entry.id, 16);
+    case BUS_COL:
+        return QString::number(entry.bus);
+    case DIR_COL:
+        return entry.received ? QString("Rx") : QString("Tx");
+    case LENGTH_COL:
+        return QString::number(entry.length);
+    case DATA_COL:
+    {
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(payloads.constData()) + entry.offset;
+        int shown = qMin(entry.length, ISOTPMESSAGEMODEL_SHOWN_BYTES);
+        QString text;
+        text.reserve(shown * 5 + 3);
+        for (int i = 0; i < shown; i++)
+        {
+            text.append(Utility::formatNumber(data[i]));
+            text.append(" ");
+        }
+        if (shown < entry.length) text.append("...");
+        return text;
+    }
+    }
+    return QVariant();
+}
+
+qint64 ISOTPMessageModel::sortKey(const Entry &entry, int column) const
+{
+    switch (column)
+    {
+    case TIME_COL:
+        return static_cast<qint64>(entry.stamp);
+    case ID_COL:
+        return entry.id;
+    case BUS_COL:
+        return entry.bus;
+    case DIR_COL:
+        return entry.received ? 0 : 1;
+    case LENGTH_COL:
+        return entry.length;
+    case DATA_COL:
+        return (entry.length > 0) ? static_cast<unsigned char>(payloads.at(entry.offset)) : -1;
+    }
+    return 0;
+}
+
+void ISOTPMessageModel::sort(int column, Qt::SortOrder order)
+{
+    if (column < 0 || column >= COLUMNS) return;
+    emit layoutAboutToBeChanged();
+    std::stable_sort(rows.begin(), rows.end(), [this, column, order](int a, int b)
+    {
+        qint64 ka = sortKey(entries.at(a), column);
+        qint64 kb = sortKey(entries.at(b), column);
+        return (order == Qt::AscendingOrder) ? ka < kb : kb < ka;
+    });
+    emit layoutChanged();
+}
+
+void ISOTPMessageModel::append(const QVector<ISOTP_MESSAGE> &msgs)
+{
+    if (msgs.isEmpty()) return;
+    beginInsertRows(QModelIndex(), rows.count(), rows.count() + msgs.count() - 1);
+    for (const ISOTP_MESSAGE &msg : msgs)
+    {
+        Entry entry;
+        entry.stamp = static_cast<uint64_t>(msg.timeStamp().microSeconds());
+        entry.id = msg.frameId();
+        entry.bus = msg.bus;
+        entry.received = msg.isReceived;
+        entry.extended = msg.hasExtendedFrameFormat();
+        entry.multiframe = msg.isMultiframe;
+        entry.reportedLength = msg.reportedLength;
+        entry.lastSequence = msg.lastSequence;
+        entry.offset = payloads.count();
+        entry.length = msg.payload().count();
+        payloads.append(msg.payload());
+        rows.append(entries.count());
+        entries.append(entry);
+    }
+    endInsertRows();
+}
+
+void ISOTPMessageModel::clear()
+{
+    beginResetModel();
+    entries.clear();
+    payloads.clear();
+    rows.clear();
+    endResetModel();
+}
+
+ISOTP_MESSAGE ISOTPMessageModel::message(int row) const
+{
+    ISOTP_MESSAGE msg;
+    if (row < 0 || row >= rows.count()) return msg;
+    const Entry &entry = entries.at(rows.at(row));
+    msg.bus = entry.bus;
+    msg.setFrameType(QCanBusFrame::FrameType::DataFrame);
+    msg.setExtendedFrameFormat(entry.extended);
+    msg.setFrameId(entry.id);
+    msg.isReceived = entry.received;
+    msg.setTimeStamp(QCanBusFrame::TimeStamp(0, static_cast<qint64>(entry.stamp)));
+    msg.reportedLength = entry.reportedLength;
+    msg.lastSequence = entry.lastSequence;
+    msg.isMultiframe = entry.multiframe;
+    msg.setPayload(payloads.mid(entry.offset, entry.length));
+    return msg;
+}
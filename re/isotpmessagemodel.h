@@ -0,0 +1,67 @@
+#ifndef ISOTPMESSAGEMODEL_H
+#define ISOTPMESSAGEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QByteArray>
+#include <QVector>
+#include "bus_protocols/isotp_message.h"
+
+//bytes the data column shows of a message before it gives up with "...". The details pane has all of them
+#define ISOTPMESSAGEMODEL_SHOWN_BYTES   64
+
+/*
+ * The reassembled messages of the ISO-TP interpreter. Each is a small fixed entry with its payload kept end to end
+ * in one byte array, instead of a whole ISOTP_MESSAGE (and six table items) per message. Cell text is only made
+ * when the view asks for it. message() puts an ISOTP_MESSAGE back together for the details of one row.
+ */
+class ISOTPMessageModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        TIME_COL = 0,
+        ID_COL,
+        BUS_COL,
+        DIR_COL,
+        LENGTH_COL,
+        DATA_COL,
+        COLUMNS
+    };
+
+    explicit ISOTPMessageModel(QObject *parent = nullptr);
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    void append(const QVector<ISOTP_MESSAGE> &msgs); //one insert for all of them, after whatever order a sort left
+    void clear();
+    ISOTP_MESSAGE message(int row) const;
+
+private:
+    struct Entry
+    {
+        uint64_t stamp;
+        uint32_t id;
+        int bus;
+        bool received;
+        bool extended;
+        bool multiframe;
+        int reportedLength;
+        int lastSequence;
+        int offset; //of the payload in payloads
+        int length;
+    };
+
+    qint64 sortKey(const Entry &entry, int column) const;
+
+    QVector<Entry> entries; //in the order they came
+    QByteArray payloads;
+    QVector<int> rows; //row -> entry
+};
+
+#endif // ISOTPMESSAGEMODEL_H
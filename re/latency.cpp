@@ -0,0 +1,281 @@
+#include "latency.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+int latencyBinOf(quint32 latency)
+{
+    if (latency == 0) return 0;
+    int bin = 1 + static_cast<int>(std::log2(static_cast<double>(latency)) * LATENCY_BINS_PER_OCTAVE);
+    return std::min(bin, LATENCY_BINS - 1);
+}
+
+//geometric middle of a bin
+double latencyBinValue(int bin)
+{
+    if (bin == 0) return 0.0;
+    return std::exp2((bin - 1 + 0.5) / LATENCY_BINS_PER_OCTAVE);
+}
+
+//ISO-TP frame type, the high nibble of the first byte
+enum IsoTpFrameType
+{
+    SINGLE_FRAME = 0,
+    FIRST_FRAME = 1,
+    CONSECUTIVE_FRAME = 2,
+    FLOW_CONTROL = 3
+};
+
+//UDS service byte of a single or first frame, -1 for anything else
+int serviceOf(int len, const uint8_t *payload)
+{
+    if (len < 2) return -1;
+    int type = payload[0] >> 4;
+    if (type == SINGLE_FRAME) return payload[1];
+    if (type == FIRST_FRAME && len >= 3) return payload[2];
+    return -1;
+}
+
+//where a request on this ID gets answered with the usual diagnostic addressing, false if it isn't one
+bool responseIdFor(uint32_t id, bool extended, uint32_t &responseId)
+{
+    if (!extended)
+    {
+        if (id < 0x700 || id > 0x7F7 || id == 0x7DF) return false; //0x7DF is functional, every ECU answers it
+        responseId = id + 8;
+        return true;
+    }
+    if ((id & 0x1FFF0000u) != 0x18DA0000u) return false;
+    responseId = 0x18DA0000u | ((id & 0xFFu) << 8) | ((id >> 8) & 0xFFu);
+    return true;
+}
+}
+
+QString LatencyPairSpec::label() const
+{
+    QString text = Utility::formatCANID(requestId) + " -> " + Utility::formatCANID(responseId);
+    if (bus < 0) text += QObject::tr(" (any bus)");
+    else if (responseBus >= 0 && responseBus != bus) text += QObject::tr(" (bus %1 -> %2)").arg(bus).arg(responseBus);
+    else text += QObject::tr(" (bus %1)").arg(bus);
+    return text;
+}
+
+QString LatencyPairSpec::toString() const
+{
+    return QString("%1,%2,%3,%4,%5").arg(requestId).arg(responseId).arg(bus).arg(responseBus).arg(isoTp ? 1 : 0);
+}
+
+bool LatencyPairSpec::fromString(const QString &text, LatencyPairSpec &spec)
+{
+    QStringList parts = text.split(',');
+    if (parts.count() != 5) return false;
+    spec.requestId = parts[0].toUInt();
+    spec.responseId = parts[1].toUInt();
+    spec.bus = parts[2].toInt();
+    spec.responseBus = parts[3].toInt();
+    spec.isoTp = parts[4].toInt() != 0;
+    return true;
+}
+
+//the latency at the given rank, same as indexing a sorted list of them at floor(fraction * count)
+quint32 LatencyStats::percentile(double fraction) const
+{
+    if (samples == 0) return 0;
+    quint64 rank = static_cast<quint64>(std::floor(fraction * samples));
+    quint64 seen = 0;
+    for (int b = 0; b < LATENCY_BINS; b++)
+    {
+        seen += bins[b];
+        if (seen > rank)
+        {
+            quint32 value = static_cast<quint32>(std::round(latencyBinValue(b)));
+            return std::max(minLatency, std::min(maxLatency, value));
+        }
+    }
+    return maxLatency;
+}
+
+QVector<QPair<double, quint32>> LatencyStats::histogram() const
+{
+    QVector<QPair<double, quint32>> filled;
+    for (int b = 0; b < LATENCY_BINS; b++)
+    {
+        if (bins[b]) filled.append(qMakePair(latencyBinValue(b), bins[b]));
+    }
+    return filled;
+}
+
+void LatencyStats::request(uint64_t stamp)
+{
+    if (waiting) unanswered++;
+    waiting = true;
+    requestStamp = stamp;
+}
+
+void LatencyStats::response(uint64_t stamp)
+{
+    if (!waiting)
+    {
+        unsolicited++;
+        return;
+    }
+    waiting = false;
+    //frames from different sources can be a little out of order
+    uint64_t latency = (stamp > requestStamp) ? stamp - requestStamp : 0;
+    if (latency > LATENCY_TIMEOUT_US)
+    {
+        unanswered++;
+        unsolicited++;
+        return;
+    }
+    quint32 value = static_cast<quint32>(latency);
+    if (samples == 0 || value < minLatency) minLatency = value;
+    if (value > maxLatency) maxLatency = value;
+    totalLatency += value;
+    bins[latencyBinOf(value)]++;
+    samples++;
+}
+
+LatencyTracker::~LatencyTracker()
+{
+    pairs.clear();
+    arena.clear();
+}
+
+void LatencyTracker::configure(const QVector<LatencyPairSpec> &newSpecs, bool detectPairs)
+{
+    specs = newSpecs;
+    detect = detectPairs;
+    clear();
+}
+
+void LatencyTracker::clear()
+{
+    pairs.clear();
+    endpoints.clear();
+    anyBus.clear();
+    candidates.clear();
+    arena.clear();
+    for (int i = 0; i < specs.count(); i++)
+    {
+        if (specs[i].bus < 0) anyBus[specs[i].requestId].append(i);
+        else addPair(specs[i], i);
+    }
+}
+
+LatencyStats *LatencyTracker::addPair(const LatencyPairSpec &spec, int specIndex)
+{
+    LatencyStats *stats = arena.create();
+    stats->spec = spec;
+    stats->specIndex = specIndex;
+    pairs.append(stats);
+    int responseBus = (spec.responseBus < 0) ? spec.bus : spec.responseBus;
+    endpoints[CANFrameStore::idKey(spec.requestId, spec.bus)].append({stats, true});
+    endpoints[CANFrameStore::idKey(spec.responseId, responseBus)].append({stats, false});
+    return stats;
+}
+
+void LatencyTracker::add(const CANFrameRecord &rec, const uint8_t *payload)
+{
+    if (rec.type() != QCanBusFrame::DataFrame) return;
+    uint64_t key = CANFrameStore::idKey(rec.frameId(), rec.bus);
+    QHash<uint64_t, QVector<Endpoint>>::const_iterator it = endpoints.constFind(key);
+    //first request of an any bus pair on this bus. It gets a pair of its own from now on
+    if (it == endpoints.constEnd() && !anyBus.isEmpty())
+    {
+        QHash<uint32_t, QVector<int>>::const_iterator wanted = anyBus.constFind(rec.frameId());
+        if (wanted != anyBus.constEnd())
+        {
+            for (int idx : wanted.value())
+            {
+                LatencyPairSpec onBus = specs.at(idx);
+                onBus.bus = rec.bus;
+                addPair(onBus, idx);
+            }
+            it = endpoints.constFind(key);
+        }
+    }
+    if (it != endpoints.constEnd())
+    {
+        for (const Endpoint &end : it.value()) frame(end.stats, end.request, rec.timestamp, rec.len, payload);
+        return;
+    }
+    if (detect) detectPair(rec, payload);
+}
+
+void LatencyTracker::frame(LatencyStats *stats, bool request, uint64_t stamp, int len, const uint8_t *payload)
+{
+    if (!stats->spec.isoTp)
+    {
+        if (request) stats->request(stamp);
+        else stats->response(stamp);
+        return;
+    }
+    if (len < 1) return;
+    int type = payload[0] >> 4;
+    if (request)
+    {
+        if (type == SINGLE_FRAME || type == FIRST_FRAME) stats->request(stamp);
+        else if (type == CONSECUTIVE_FRAME && stats->waiting) stats->requestStamp = stamp; //the last one ends the request
+        return;
+    }
+    if (type == SINGLE_FRAME && len >= 4 && payload[1] == 0x7F && payload[3] == 0x78)
+    {
+        stats->responsePending++;
+        return;
+    }
+    if (type == SINGLE_FRAME || type == FIRST_FRAME) stats->response(stamp);
+}
+
+void LatencyTracker::detectPair(const CANFrameRecord &rec, const uint8_t *payload)
+{
+    int service = serviceOf(rec.len, payload);
+    if (service < 0) return;
+    uint32_t id = rec.frameId();
+    if (service < 0x40)
+    {
+        uint32_t responseId;
+        if ((payload[0] >> 4) == SINGLE_FRAME && responseIdFor(id, rec.isExtended(), responseId))
+        {
+            candidates.insert(CANFrameStore::idKey(responseId, rec.bus), {id, rec.timestamp});
+        }
+        return;
+    }
+    QHash<uint64_t, Candidate>::iterator it = candidates.find(CANFrameStore::idKey(id, rec.bus));
+    if (it == candidates.end()) return;
+    LatencyPairSpec spec;
+    spec.requestId = it->requestId;
+    spec.responseId = id;
+    spec.bus = rec.bus;
+    spec.isoTp = true;
+    LatencyStats *stats = addPair(spec, -1);
+    stats->request(it->stamp);
+    candidates.erase(it);
+    frame(stats, false, rec.timestamp, rec.len, payload);
+}
+
+LatencyStore *LatencyStore::forFrames(const CANFrameStore *frames)
+{
+    return perFrameStore<LatencyStore>(frames, [](const CANFrameStore *f) { return new LatencyStore(f); });
+}
+
+LatencyStore::LatencyStore(const CANFrameStore *frames) : FrameStoreFollower(frames)
+{
+    latency.configure(QVector<LatencyPairSpec>(), true);
+    rebuild();
+}
+
+void LatencyStore::configure(const QVector<LatencyPairSpec> &specs, bool detect)
+{
+    latency.configure(specs, detect);
+    rebuild();
+}
+
+//in arrival order, a response only means something after its request
+void LatencyStore::add(int row)
+{
+    latency.add(frames->record(row), frames->payloadData(row));
+}
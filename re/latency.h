@@ -0,0 +1,144 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "framestorefollower.h"
+#include "objectarena.h"
+
+//latency sketch resolution, 1/8 of an octave or about 9% of the latency itself
+#define LATENCY_BINS_PER_OCTAVE 8
+//bin 0 is no delay at all, the rest cover 1us up to 2^32us
+#define LATENCY_BINS            (1 + 32 * LATENCY_BINS_PER_OCTAVE)
+//a request still waiting this long has gone unanswered, the answer counts as unsolicited, in us
+#define LATENCY_TIMEOUT_US      5000000
+
+//a request / response ID pair to measure. Bus -1 takes requests on any bus and answers on the same bus
+struct LatencyPairSpec
+{
+    uint32_t requestId = 0;
+    uint32_t responseId = 0;
+    int bus = -1;
+    int responseBus = -1; //-1 for the same bus as the request, anything else for a gateway forwarding across
+    bool isoTp = false; //frames are ISO-TP, see LatencyTracker
+
+    QString label() const;
+    QString toString() const; //for settings, fromString reads it back
+    static bool fromString(const QString &text, LatencyPairSpec &spec);
+};
+
+/*
+ * Latency of one request / response pair on one bus (or across two), kept up to date one frame at a time. The
+ * latencies go into a log scale histogram, the sketch the percentiles come from, same as the jitter in PeriodStats.
+ *
+ * All times are microseconds.
+ */
+struct LatencyStats
+{
+    LatencyPairSpec spec; //bus filled in even if the pair it came from takes any bus
+    int specIndex = -1; //the configured pair it came from, -1 if it was detected
+    quint64 samples = 0;
+    quint64 unanswered = 0;  //a new request came (or the time ran out) before an answer did
+    quint64 unsolicited = 0; //answers without a request waiting
+    quint64 responsePending = 0; //UDS "response pending" replies, the request keeps waiting for the real answer
+    quint32 minLatency = 0;
+    quint32 maxLatency = 0;
+    quint64 totalLatency = 0;
+
+    quint32 percentile(double fraction) const;
+    quint32 mean() const { return samples ? static_cast<quint32>(totalLatency / samples) : 0; }
+    //the sketch's bins that have anything in them as (latency in the middle of the bin, count)
+    QVector<QPair<double, quint32>> histogram() const;
+
+private:
+    friend class LatencyTracker;
+    bool waiting = false;
+    uint64_t requestStamp = 0;
+    quint32 bins[LATENCY_BINS] = {0};
+
+    void request(uint64_t stamp);
+    void response(uint64_t stamp);
+};
+
+/*
+ * Matches requests with responses for the pairs it's given and, if asked to, for UDS pairs it finds by itself.
+ *
+ * A plain pair (a gateway forwarding one ID to another bus, say) takes every frame: a request starts the clock and
+ * the next response stops it. An ISO-TP pair only takes the frames that end a message. On the request side that's a
+ * single frame or the latest consecutive frame, on the response side a single or first frame. Flow control goes the
+ * other way and never counts, and a UDS "response pending" keeps the request waiting for the real answer.
+ *
+ * Detection looks for the usual diagnostic addressing: 11 bit requests on 0x700 - 0x7F7 answered on the ID 8 above,
+ * 29 bit normal fixed addressing (0x18DAttss answered on 0x18DAsstt). A request is a single frame with a UDS / OBD
+ * service below 0x40, an answer a single or first frame with the service plus 0x40 or a negative response. The pair
+ * gets made on the first answer that comes after such a request.
+ *
+ * Frames with IDs no pair uses cost one hash lookup, plus a few comparisons while detection is on, so it keeps up
+ * with a full bus.
+ */
+class LatencyTracker
+{
+public:
+    LatencyTracker() {}
+    ~LatencyTracker();
+    void configure(const QVector<LatencyPairSpec> &specs, bool detect);
+    void clear(); //forgets the stats, keeps the configuration
+    void add(const CANFrameRecord &rec, const uint8_t *payload);
+    const QVector<LatencyStats *> &all() const { return pairs; }
+
+private:
+    Q_DISABLE_COPY(LatencyTracker)
+    struct Endpoint
+    {
+        LatencyStats *stats;
+        bool request;
+    };
+    //a request that might be the start of a detected pair, keyed by where its answer would come from
+    struct Candidate
+    {
+        uint32_t requestId;
+        uint64_t stamp;
+    };
+
+    QVector<LatencyPairSpec> specs;
+    bool detect = false;
+    QVector<LatencyStats *> pairs;
+    ObjectArena<LatencyStats> arena;
+    QHash<uint64_t, QVector<Endpoint>> endpoints; //CANFrameStore::idKey of the frame
+    QHash<uint32_t, QVector<int>> anyBus;         //request ID -> specs with bus -1 that haven't seen that bus yet
+    QHash<uint64_t, Candidate> candidates;
+
+    LatencyStats *addPair(const LatencyPairSpec &spec, int specIndex);
+    void frame(LatencyStats *stats, bool request, uint64_t stamp, int len, const uint8_t *payload);
+    void detectPair(const CANFrameRecord &rec, const uint8_t *payload);
+};
+
+/*
+ * Response latencies for one frame store. A FrameStoreFollower that also starts over, in arrival order, on a new
+ * configuration. Timestamps are the store's. With more than one
+ * connection merged those are already all on the host clock (see ClockSync) so pairs across devices line up.
+ *
+ * GUI thread only.
+ */
+class LatencyStore : public FrameStoreFollower
+{
+    Q_OBJECT
+
+public:
+    static LatencyStore *forFrames(const CANFrameStore *frames);
+
+    void configure(const QVector<LatencyPairSpec> &specs, bool detect);
+    const LatencyTracker &tracker() const { return latency; }
+
+protected:
+    void clearState() override { latency.clear(); }
+    void add(int row) override;
+
+private:
+    explicit LatencyStore(const CANFrameStore *frames);
+
+    LatencyTracker latency;
+};
+
+#endif // LATENCY_H
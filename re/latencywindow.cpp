@@ -0,0 +1,251 @@
+#include "latencywindow.h"
+#include "ui_latencywindow.h"
+#include "mainwindow.h"
+#include "utility.h"
+#include "helpwindow.h"
+#include "re/offscreenplot.h"
+
+#include <QMessageBox>
+
+//at most this often the table and histogram get redrawn while frames are coming in, in ms
+#define LATENCY_REFRESH_MS      250
+
+namespace
+{
+QString msText(quint32 us)
+{
+    return QString::number(us / 1000.0, 'f', 3);
+}
+}
+
+LatencyWindow::LatencyWindow(const CANFrameStore *frames, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::LatencyWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+
+    store = LatencyStore::forFrames(frames);
+    selectedPair = -1;
+
+    QStringList headers;
+    headers << tr("Pair") << tr("Answered") << tr("Unanswered") << tr("Unsolicited") << tr("Response Pending")
+            << tr("Min (ms)") << tr("Mean (ms)") << tr("Median (ms)") << tr("95% (ms)") << tr("99% (ms)") << tr("Max (ms)");
+    ui->tablePairs->setColumnCount(headers.count());
+    ui->tablePairs->setHorizontalHeaderLabels(headers);
+
+    ui->graphLatency->xAxis->setLabel(tr("Latency (ms)"));
+    ui->graphLatency->yAxis->setLabel(tr("Responses"));
+    ui->graphLatency->xAxis->setScaleType(QCPAxis::stLogarithmic);
+    ui->graphLatency->xAxis->setTicker(QSharedPointer<QCPAxisTickerLog>(new QCPAxisTickerLog));
+    ui->graphLatency->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+    OffscreenPlot::setup(ui->graphLatency);
+
+    //the saved pairs, the store goes through the whole capture again with them
+    QSettings settings;
+    for (const QString &text : settings.value("Latency/Pairs").toStringList())
+    {
+        LatencyPairSpec spec;
+        if (LatencyPairSpec::fromString(text, spec)) specs.append(spec);
+    }
+    ui->cbDetect->setChecked(settings.value("Latency/DetectPairs", true).toBool());
+    store->configure(specs, ui->cbDetect->isChecked());
+
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(LATENCY_REFRESH_MS);
+    connect(&refreshTimer, &QTimer::timeout, this, &LatencyWindow::refresh);
+    connect(store, &LatencyStore::updated, this, &LatencyWindow::statsUpdated);
+    connect(ui->tablePairs, &QTableWidget::itemSelectionChanged, this, &LatencyWindow::pairSelected);
+    connect(ui->btnAdd, &QPushButton::clicked, this, &LatencyWindow::addPair);
+    connect(ui->btnRemove, &QPushButton::clicked, this, &LatencyWindow::removePair);
+    connect(ui->cbDetect, &QCheckBox::toggled, this, &LatencyWindow::detectToggled);
+}
+
+LatencyWindow::~LatencyWindow()
+{
+    delete ui;
+}
+
+void LatencyWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+
+    readSettings();
+
+    store->sync();
+    refresh();
+
+    installEventFilter(this);
+}
+
+void LatencyWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool LatencyWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("latency.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void LatencyWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("LatencyView/WindowSize", QSize(900, 650)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("LatencyView/WindowPos", QPoint(50, 50)).toPoint()));
+    }
+}
+
+void LatencyWindow::writeSettings()
+{
+    QSettings settings;
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("LatencyView/WindowSize", size());
+        settings.setValue("LatencyView/WindowPos", pos());
+    }
+}
+
+//saves the pairs and has the store go through the frames again with them
+void LatencyWindow::configure()
+{
+    QStringList saved;
+    for (const LatencyPairSpec &spec : specs) saved.append(spec.toString());
+    QSettings settings;
+    settings.setValue("Latency/Pairs", saved);
+    settings.setValue("Latency/DetectPairs", ui->cbDetect->isChecked());
+    selectedPair = -1;
+    store->configure(specs, ui->cbDetect->isChecked());
+}
+
+void LatencyWindow::addPair()
+{
+    bool requestOk = false;
+    bool responseOk = false;
+    LatencyPairSpec spec;
+    spec.requestId = Utility::ParseStringToNum2(ui->editRequestID->text(), &requestOk);
+    spec.responseId = Utility::ParseStringToNum2(ui->editResponseID->text(), &responseOk);
+    if (!requestOk || !responseOk)
+    {
+        QMessageBox::warning(this, tr("Add Pair"), tr("Request and response need to be IDs, like 0x7E0."));
+        return;
+    }
+    spec.bus = ui->spinBus->value();
+    spec.responseBus = ui->spinResponseBus->value();
+    spec.isoTp = ui->cbIsoTp->isChecked();
+    specs.append(spec);
+    configure();
+}
+
+void LatencyWindow::removePair()
+{
+    const QVector<LatencyStats *> &pairs = store->tracker().all();
+    if (selectedPair < 0 || selectedPair >= pairs.count()) return;
+    int specIndex = pairs.at(selectedPair)->specIndex;
+    if (specIndex < 0) return; //detected, it'd only be found again
+    specs.remove(specIndex);
+    configure();
+}
+
+void LatencyWindow::detectToggled()
+{
+    configure();
+}
+
+//the store updates on every framesUpdated, the window only every LATENCY_REFRESH_MS
+void LatencyWindow::statsUpdated()
+{
+    if (!isVisible()) return;
+    if (!refreshTimer.isActive()) refreshTimer.start();
+}
+
+void LatencyWindow::refresh()
+{
+    showPairs();
+    showHistogram();
+}
+
+void LatencyWindow::pairSelected()
+{
+    QList<QTableWidgetItem *> items = ui->tablePairs->selectedItems();
+    if (items.isEmpty()) return;
+    selectedPair = items.first()->row();
+    const QVector<LatencyStats *> &pairs = store->tracker().all();
+    ui->btnRemove->setEnabled(selectedPair < pairs.count() && pairs.at(selectedPair)->specIndex >= 0);
+    showHistogram();
+}
+
+void LatencyWindow::showPairs()
+{
+    const QVector<LatencyStats *> &pairs = store->tracker().all();
+    ui->tablePairs->blockSignals(true);
+    ui->tablePairs->setRowCount(pairs.count());
+    for (int i = 0; i < pairs.count(); i++)
+    {
+        const LatencyStats *stats = pairs.at(i);
+        QString label = stats->spec.label();
+        if (stats->specIndex < 0) label += tr(" (found)");
+        QStringList cells;
+        cells << label << QString::number(stats->samples) << QString::number(stats->unanswered)
+              << QString::number(stats->unsolicited) << QString::number(stats->responsePending);
+        if (stats->samples)
+        {
+            cells << msText(stats->minLatency) << msText(stats->mean()) << msText(stats->percentile(0.5))
+                  << msText(stats->percentile(0.95)) << msText(stats->percentile(0.99)) << msText(stats->maxLatency);
+        }
+        else for (int c = 0; c < 6; c++) cells << "-";
+        for (int c = 0; c < cells.count(); c++) Utility::setTableCell(ui->tablePairs, i, c, cells.at(c));
+    }
+    if (selectedPair >= 0 && selectedPair < pairs.count()) ui->tablePairs->selectRow(selectedPair);
+    ui->tablePairs->blockSignals(false);
+}
+
+//one bar per sketch bin. The bins are log scale so the axis is too
+void LatencyWindow::showHistogram()
+{
+    ui->graphLatency->clearPlottables();
+    const QVector<LatencyStats *> &pairs = store->tracker().all();
+    if (selectedPair < 0 || selectedPair >= pairs.count() || pairs.at(selectedPair)->samples == 0)
+    {
+        ui->graphLatency->replot();
+        return;
+    }
+    const LatencyStats *stats = pairs.at(selectedPair);
+    ui->labelHistogram->setText(tr("Latencies of %1:").arg(stats->spec.label()));
+
+    QVector<QPair<double, quint32>> bins = stats->histogram();
+    QVector<double> x;
+    QVector<double> y;
+    double maxCount = 0.0;
+    for (const QPair<double, quint32> &bin : bins)
+    {
+        x.append(std::max(bin.first, 1.0) / 1000.0); //no delay at all still needs a place on a log axis
+        y.append(bin.second);
+        maxCount = std::max(maxCount, static_cast<double>(bin.second));
+    }
+    QCPBars *bars = new QCPBars(ui->graphLatency->xAxis, ui->graphLatency->yAxis);
+    bars->setWidthType(QCPBars::wtAxisRectRatio);
+    bars->setWidth(0.004);
+    bars->setData(x, y, true);
+    ui->graphLatency->xAxis->setRange(x.first() / 2.0, x.last() * 2.0);
+    ui->graphLatency->yAxis->setRange(0, maxCount * 1.1);
+    ui->graphLatency->replot();
+}
@@ -0,0 +1,52 @@
+#ifndef LATENCYWINDOW_H
+#define LATENCYWINDOW_H
+
+#include <QDialog>
+#include <QTimer>
+#include "canframestore.h"
+#include "re/latency.h"
+
+namespace Ui {
+class LatencyWindow;
+}
+
+/*
+ * Shows what LatencyStore keeps for every request / response pair: how many requests got answered, how many didn't
+ * and the latency percentiles, plus the latency histogram of the selected pair. Pairs can be typed in and UDS pairs
+ * found by themselves. Like the bus error window it only shows counters, redrawn at most once per
+ * LATENCY_REFRESH_MS, so it can stay open during a busy capture.
+ */
+class LatencyWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit LatencyWindow(const CANFrameStore *frames, QWidget *parent = 0);
+    ~LatencyWindow();
+    void showEvent(QShowEvent*);
+
+private slots:
+    void statsUpdated();
+    void refresh();
+    void pairSelected();
+    void addPair();
+    void removePair();
+    void detectToggled();
+
+private:
+    Ui::LatencyWindow *ui;
+    LatencyStore *store;
+    QTimer refreshTimer;
+    QVector<LatencyPairSpec> specs;
+    int selectedPair; //row in the table, -1 for none
+
+    void showPairs();
+    void showHistogram();
+    void configure();
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // LATENCYWINDOW_H
@@ -1,6 +1,9 @@
 #include "newgraphdialog.h"
 #include "ui_newgraphdialog.h"
+#include <QAbstractItemView>
+#include <QAbstractProxyModel>
 #include <QColorDialog>
+#include <QSet>
 #include <QRandomGenerator>
 #include "utility.h"
 #include "helpwindow.h"
@@ -51,6 +54,16 @@ NewGraphDialog::NewGraphDialog(DBCHandler *handler, QWidget *parent) :
     connect(ui->btnCopySignal, SIGNAL(clicked(bool)), this, SLOT(copySignalToParamsUI()));
     connect(ui->cbSignals, SIGNAL(currentIndexChanged(int)), this, SLOT(drawBitfield()));
 
+    //the search box goes through the shared signal index instead of the combo boxes. The completer is only attached
+    //with setWidget so it shows exactly the model's matches rather than filtering them again
+    signalPicker = new DBCSignalPickerModel(this);
+    signalCompleter = new QCompleter(signalPicker, this);
+    signalCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    signalCompleter->setMaxVisibleItems(20);
+    signalCompleter->setWidget(ui->txtSignalSearch);
+    connect(ui->txtSignalSearch, &QLineEdit::textEdited, this, &NewGraphDialog::searchSignals);
+    connect(signalCompleter, QOverload<const QModelIndex &>::of(&QCompleter::activated), this, &NewGraphDialog::pickSearchedSignal);
+
     startBit = 0;
     dataLen = 1;
     assocSignal = nullptr;
@@ -227,62 +240,65 @@ void NewGraphDialog::setParams(GraphParams &params)
 
     loadNodes();
 
-    if (assocSignal)
+    if (assocSignal) selectSignal(assocSignal);
+    //ui->cbNodes->model()->
+
+
+    //loadSignals(0);
+    drawBitfield();
+    checkSignalAgreement();
+}
+
+//points the node, message and signal combo boxes at sig
+void NewGraphDialog::selectSignal(DBC_SIGNAL *sig)
+{
+    auto msg = sig->parentMessage;
+    auto node = msg->sender;
+
+    bool nodeFound = false;
+    for(int i=0; i<ui->cbNodes->count(); i++)
     {
-        auto msg = assocSignal->parentMessage;
-        auto node = msg->sender;
+        if(ui->cbNodes->itemText(i) == node->sourceFileName + Utility::fullyQualifiedNameSeperator + node->name)
+        {
+            ui->cbNodes->setCurrentIndex(i);
+            nodeFound = true;
+            break;
+        }
+    }
+
+    qDebug() << "Matching plot params to Node: " << nodeFound;
 
-        bool nodeFound = false;
-        for(int i=0; i<ui->cbNodes->count(); i++)
+    if(nodeFound)
+    {
+        bool msgFound = false;
+        for(int i=0; i<ui->cbMessages->count(); i++)
         {
-            if(ui->cbNodes->itemText(i) == node->sourceFileName + Utility::fullyQualifiedNameSeperator + node->name)
+            if(ui->cbMessages->itemText(i) == msg->name)
             {
-                ui->cbNodes->setCurrentIndex(i);
-                nodeFound = true;
+                ui->cbMessages->setCurrentIndex(i);
+                msgFound = true;
                 break;
             }
         }
 
-        qDebug() << "Matching plot params to Node: " << nodeFound;
+        qDebug() << "Matching plot params to Msg: " << msgFound;
 
-        if(nodeFound)
+        if(msgFound)
         {
-            bool msgFound = false;
-            for(int i=0; i<ui->cbMessages->count(); i++)
+            bool sigFound = false;
+            for(int i=0; i<ui->cbSignals->count(); i++)
             {
-                if(ui->cbMessages->itemText(i) == msg->name)
+                if(ui->cbSignals->itemText(i) == sig->name)
                 {
-                    ui->cbMessages->setCurrentIndex(i);
-                    msgFound = true;
+                    ui->cbSignals->setCurrentIndex(i);
+                    sigFound = true;
                     break;
                 }
             }
 
-            qDebug() << "Matching plot params to Msg: " << msgFound;
-
-            if(msgFound)
-            {
-                bool sigFound = false;
-                for(int i=0; i<ui->cbSignals->count(); i++)
-                {
-                    if(ui->cbSignals->itemText(i) == assocSignal->name)
-                    {
-                        ui->cbSignals->setCurrentIndex(i);
-                        sigFound = true;
-                        break;
-                    }
-                }
-
-                qDebug() << "Matching plot params to Signal: " << sigFound;
-            }
+            qDebug() << "Matching plot params to Signal: " << sigFound;
         }
     }
-    //ui->cbNodes->model()->
-
-
-    //loadSignals(0);
-    drawBitfield();
-    checkSignalAgreement();
 }
 
 void NewGraphDialog::getParams(GraphParams &params)
@@ -329,18 +345,14 @@ void NewGraphDialog::loadNodes()
 
         QList<QString> names;
 
+        //senders gathered in one pass, going through the messages once per node is slow on big files
+        QSet<QString> senders;
+        for (int m = 0; m < thisFile->messageHandler->getCount(); m++)
+            senders.insert(thisFile->messageHandler->findMsgByIdx(m)->sender->name);
+
         for (int x = 0; x < thisFile->dbc_nodes.count(); x++)
         {
-            bool messagesInNode = false;
-            for (int m = 0; m < thisFile->messageHandler->getCount(); m++)
-            {
-                if(thisFile->messageHandler->findMsgByIdx(m)->sender->name == thisFile->dbc_nodes[x].name)
-                {
-                    messagesInNode = true;
-                    break;
-                }
-            }
-            if(messagesInNode)
+            if(senders.contains(thisFile->dbc_nodes[x].name))
             {
                 QString fullyQualifiedNodeName = thisFile->getFilenameNoExt() + Utility::fullyQualifiedNameSeperator + thisFile->dbc_nodes[x].name;
                 names.append(fullyQualifiedNodeName);
@@ -410,6 +422,25 @@ void NewGraphDialog::loadSignals(int idx)
     checkSignalAgreement();
 }
 
+void NewGraphDialog::searchSignals(const QString &text)
+{
+    signalPicker->setQuery(text);
+    if (signalPicker->rowCount() > 0) signalCompleter->complete();
+    else signalCompleter->popup()->hide();
+}
+
+void NewGraphDialog::pickSearchedSignal(const QModelIndex &index)
+{
+    QAbstractProxyModel *proxy = qobject_cast<QAbstractProxyModel*>(signalCompleter->completionModel());
+    DBC_SIGNAL *sig = signalPicker->signalAt(proxy ? proxy->mapToSource(index).row() : index.row());
+    if (!sig) return;
+
+    ui->txtSignalSearch->setText(sig->parentMessage->name + "." + sig->name);
+    assocSignal = sig;
+    selectSignal(sig);
+    copySignalToParamsUI();
+}
+
 void NewGraphDialog::bitfieldClicked(int bit)
 {
     qDebug() << "Clicked bit: " << bit;
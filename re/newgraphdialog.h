@@ -2,8 +2,10 @@
 #define NEWGRAPHDIALOG_H
 
 #include <QDialog>
+#include <QCompleter>
 #include "graphingwindow.h"
 #include "dbc/dbchandler.h"
+#include "dbc/dbcsignalindex.h"
 
 namespace Ui {
 class NewGraphDialog;
@@ -32,14 +34,19 @@ private slots:
     void handleDataLenUpdate();
     void drawBitfield();
     void copySignalToParamsUI();
+    void searchSignals(const QString &text);
+    void pickSearchedSignal(const QModelIndex &index);
 
 private:
     bool eventFilter(QObject *obj, QEvent *event);
     void checkSignalAgreement();
+    void selectSignal(DBC_SIGNAL *sig);
 
     Ui::NewGraphDialog *ui;
     DBCHandler *dbcHandler;
     DBC_SIGNAL *assocSignal;
+    DBCSignalPickerModel *signalPicker;
+    QCompleter *signalCompleter;
     int startBit, dataLen;
     bool shownFromPlotEdit;
 };
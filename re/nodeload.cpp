@@ -0,0 +1,229 @@
+#include "nodeload.h"
+#include "restbusengine.h"
+#include "dbc/dbchandler.h"
+
+namespace
+{
+//who the DBC says sends the message, empty for nobody in particular
+QString transmitterOf(const DBC_MESSAGE *msg)
+{
+    if (!msg->sender || msg->sender->name.isEmpty() || msg->sender->name == "Vector__XXX") return QString();
+    return msg->sender->name;
+}
+}
+
+double NodeLoadCounters::busySeconds(int nominalRate, int dataRate) const
+{
+    if (nominalRate <= 0) return 0.0;
+    if (dataRate <= 0) dataRate = nominalRate;
+    return nominalBits / static_cast<double>(nominalRate) + dataBits / static_cast<double>(dataRate);
+}
+
+void NodeLoadCounters::add(uint64_t stamp, int len, const CANFrameBits &bits)
+{
+    if (frames == 0 || stamp < firstStamp) firstStamp = stamp;
+    if (stamp > lastStamp) lastStamp = stamp;
+    frames++;
+    bytes += static_cast<quint64>(len);
+    nominalBits += static_cast<quint64>(bits.nominal);
+    dataBits += static_cast<quint64>(bits.data);
+
+    //a frame a little out of order goes in the slot that's open rather than reopening an old one
+    uint64_t frameSlot = stamp / NODELOAD_PEAK_US;
+    if (slot == ~0ull || frameSlot > slot)
+    {
+        slot = frameSlot;
+        slotFrames = 0;
+        slotBytes = 0;
+    }
+    slotFrames++;
+    slotBytes += static_cast<quint32>(len);
+    if (slotFrames > peakFrames) peakFrames = slotFrames;
+    if (slotBytes > peakBytes) peakBytes = slotBytes;
+}
+
+void NodeLoad::clear()
+{
+    routes.clear();
+    nodeIndex.clear();
+    cycles.clear();
+    nodeList.clear();
+    messageList.clear();
+    buses.clear();
+    revision = DBCHandler::getRevision();
+    haveCycles = false;
+}
+
+bool NodeLoad::isCurrent() const
+{
+    return revision == DBCHandler::getRevision();
+}
+
+void NodeLoad::add(const CANFrameRecord &rec, const uint8_t *payload)
+{
+    const QCanBusFrame::FrameType type = rec.type();
+    if (type != QCanBusFrame::DataFrame && type != QCanBusFrame::RemoteRequestFrame) return;
+
+    const Route r = route(rec);
+    const CANFrameBits bits = CANFrameBits::of(rec, payload);
+    const int len = (type == QCanBusFrame::RemoteRequestFrame) ? 0 : rec.len;
+    if (rec.bus >= buses.count()) buses.resize(rec.bus + 1);
+    buses[rec.bus].add(rec.timestamp, len, bits);
+    nodeList[r.node].counters.add(rec.timestamp, len, bits);
+    if (r.message < 0) return;
+
+    NodeLoadMessage &msg = messageList[r.message];
+    if (msg.frames && rec.timestamp > msg.lastStamp)
+    {
+        const uint64_t gap = rec.timestamp - msg.lastStamp;
+        if (gap > msg.maxGap) msg.maxGap = gap;
+        if (msg.cycleMs > 0 && gap >= static_cast<uint64_t>(msg.cycleMs) * 1000 * NODELOAD_DROPOUT_CYCLES) msg.dropouts++;
+    }
+    if (rec.timestamp > msg.lastStamp) msg.lastStamp = rec.timestamp;
+    msg.frames++;
+}
+
+//first frame of a bus / ID pair decides where all of them go
+NodeLoad::Route NodeLoad::route(const CANFrameRecord &rec)
+{
+    const uint64_t key = CANFrameStore::idKey(rec.frameId(), rec.bus);
+    QHash<uint64_t, Route>::const_iterator it = routes.constFind(key);
+    if (it != routes.constEnd()) return it.value();
+
+    DBCHandler *dbc = DBCHandler::getReference();
+    if (!haveCycles)
+    {
+        for (int f = 0; f < dbc->getFileCount(); f++)
+        {
+            DBCFile *file = dbc->getFileByIdx(f);
+            for (int m = 0; m < file->messageHandler->getCount(); m++)
+            {
+                DBC_MESSAGE *msg = file->messageHandler->findMsgByIdx(m);
+                if (!msg) continue;
+                int cycle = RestbusEngine::cycleTimeMs(file, msg);
+                if (cycle > 0) cycles.insert(msg, cycle);
+            }
+        }
+        haveCycles = true;
+    }
+
+    Route r;
+    r.message = -1;
+    DBC_MESSAGE *msg = dbc->findMessage(rec.frameId(), rec.bus);
+    if (!msg) r.node = nodeFor(rec.bus, QObject::tr("(unknown)"), false);
+    else
+    {
+        QString sender = transmitterOf(msg);
+        r.node = sender.isEmpty() ? nodeFor(rec.bus, QObject::tr("(none)"), false) : nodeFor(rec.bus, sender, true);
+        NodeLoadMessage out;
+        out.name = msg->name;
+        out.id = rec.frameId();
+        out.bus = rec.bus;
+        out.node = r.node;
+        out.cycleMs = cycles.value(msg, 0);
+        out.msg = msg;
+        r.message = messageList.count();
+        messageList.append(out);
+        nodeList[r.node].messages.append(r.message);
+    }
+    routes.insert(key, r);
+    return r;
+}
+
+int NodeLoad::nodeFor(int bus, const QString &name, bool known)
+{
+    const QPair<int, QString> key(bus, name);
+    QHash<QPair<int, QString>, int>::const_iterator it = nodeIndex.constFind(key);
+    if (it != nodeIndex.constEnd()) return it.value();
+    NodeLoadNode node;
+    node.name = name;
+    node.bus = bus;
+    node.known = known;
+    nodeList.append(node);
+    nodeIndex.insert(key, nodeList.count() - 1);
+    return nodeList.count() - 1;
+}
+
+/*
+ * A message counts as heard on a bus / ID pair it was seen on, and is judged against the newest frame of that bus
+ * so a capture that simply ended doesn't make everything look missing. Files tied to a bus only count frames on
+ * that bus, the others any bus. Nothing is missing in a capture with no frames at all.
+ */
+QVector<NodeLoadMissing> NodeLoad::missing() const
+{
+    QVector<NodeLoadMissing> out;
+    if (!isCurrent() || buses.isEmpty()) return out;
+
+    QHash<const DBC_MESSAGE *, QVector<int>> heard;
+    for (int i = 0; i < messageList.count(); i++) heard[messageList.at(i).msg].append(i);
+
+    DBCHandler *dbc = DBCHandler::getReference();
+    for (int f = 0; f < dbc->getFileCount(); f++)
+    {
+        DBCFile *file = dbc->getFileByIdx(f);
+        const int bus = file->getAssocBus();
+        for (int m = 0; m < file->messageHandler->getCount(); m++)
+        {
+            DBC_MESSAGE *msg = file->messageHandler->findMsgByIdx(m);
+            if (!msg) continue;
+            const int cycle = cycles.value(msg, 0);
+            if (cycle <= 0) continue;
+            const QString sender = transmitterOf(msg);
+            if (sender.isEmpty()) continue;
+
+            NodeLoadMissing miss;
+            miss.node = sender;
+            miss.name = msg->name;
+            miss.id = msg->ID & 0x1FFFFFFF;
+            miss.bus = bus;
+            miss.cycleMs = cycle;
+            for (int idx : heard.value(msg))
+            {
+                const NodeLoadMessage &seen = messageList.at(idx);
+                if (bus >= 0 && seen.bus != bus) continue;
+                const uint64_t newest = buses.at(seen.bus).lastStamp;
+                const uint64_t quiet = newest > seen.lastStamp ? newest - seen.lastStamp : 0;
+                if (!miss.seen || quiet < miss.quietUs)
+                {
+                    miss.quietUs = quiet;
+                    miss.id = seen.id;
+                    miss.bus = seen.bus;
+                }
+                miss.seen = true;
+            }
+            if (miss.seen && miss.quietUs < static_cast<uint64_t>(cycle) * 1000 * NODELOAD_MISSING_CYCLES) continue;
+            out.append(miss);
+        }
+    }
+    return out;
+}
+
+qint64 NodeLoad::bytes() const
+{
+    using MemoryAccounting::bytesOf;
+    qint64 total = bytesOf(routes) + bytesOf(nodeIndex) + bytesOf(cycles) + bytesOf(nodeList) + bytesOf(messageList)
+                 + bytesOf(buses);
+    for (const NodeLoadNode &node : nodeList) total += bytesOf(node.name) + bytesOf(node.messages);
+    for (const NodeLoadMessage &msg : messageList) total += bytesOf(msg.name);
+    return total;
+}
+
+NodeLoadStore *NodeLoadStore::forFrames(const CANFrameStore *frames)
+{
+    return perFrameStore<NodeLoadStore>(frames, [](const CANFrameStore *f) { return new NodeLoadStore(f); });
+}
+
+NodeLoadStore::NodeLoadStore(const CANFrameStore *frames) : FrameStoreFollower(frames)
+{
+    rebuild();
+}
+
+void NodeLoadStore::reportMemory(QVector<MemoryUsage> &out) const
+{
+    out.append({memoryOwner("Node Load"), "per node counters", nodeLoad.bytes()});
+}
+
+void NodeLoadStore::add(int row)
+{
+    nodeLoad.add(frames->record(row), frames->payloadData(row));
+}
@@ -0,0 +1,163 @@
+#ifndef NODELOAD_H
+#define NODELOAD_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include "framestorefollower.h"
+#include "memoryaccounting.h"
+#include "connections/busloadmeter.h"
+
+//slots the peak rates are measured over, in us
+#define NODELOAD_PEAK_US            1000000
+//a gap of this many cycles or more between two frames of a cyclic message is a dropout
+#define NODELOAD_DROPOUT_CYCLES     2
+//a cyclic message quiet for this many of its cycles by the newest frame on its bus is missing
+#define NODELOAD_MISSING_CYCLES     3
+
+class DBC_MESSAGE;
+
+//traffic of one node, or one whole bus, since the store was last rebuilt
+struct NodeLoadCounters
+{
+    quint64 frames = 0;
+    quint64 bytes = 0;          //payload bytes
+    quint64 nominalBits = 0;    //on the wire at the nominal rate, stuff bits and all, see CANFrameBits
+    quint64 dataBits = 0;       //CAN-FD data phases sent at the data rate
+    uint64_t firstStamp = 0;
+    uint64_t lastStamp = 0;
+    quint32 peakFrames = 0;     //most in one NODELOAD_PEAK_US slot
+    quint32 peakBytes = 0;
+
+    //how long the frames kept the bus busy at these rates, in seconds. Rates in bits per second
+    double busySeconds(int nominalRate, int dataRate) const;
+
+private:
+    friend class NodeLoad;
+    uint64_t slot = ~0ull; //NODELOAD_PEAK_US slot the two below are for
+    quint32 slotFrames = 0;
+    quint32 slotBytes = 0;
+
+    void add(uint64_t stamp, int len, const CANFrameBits &bits);
+};
+
+//one bus / ID pair and the DBC message it decodes as
+struct NodeLoadMessage
+{
+    QString name;
+    uint32_t id = 0;
+    int bus = 0;
+    int node = -1;      //into NodeLoad::nodes()
+    int cycleMs = 0;    //from the DBC, 0 if it isn't cyclic
+    quint64 frames = 0;
+    uint64_t lastStamp = 0;
+    uint64_t maxGap = 0;    //us
+    quint64 dropouts = 0;   //gaps of NODELOAD_DROPOUT_CYCLES cycles or more
+
+private:
+    friend class NodeLoad;
+    const DBC_MESSAGE *msg = nullptr; //only compared, it may be gone once the DBC revision moves
+};
+
+//everything one transmitter sent on one bus
+struct NodeLoadNode
+{
+    QString name;
+    int bus = 0;
+    bool known = true;  //false for the catch alls: IDs no DBC file has, messages without a transmitter
+    NodeLoadCounters counters;
+    QVector<int> messages; //into NodeLoad::messages(), in the order they turned up
+};
+
+//a cyclic message with a transmitter that hasn't been heard for NODELOAD_MISSING_CYCLES of its cycles, or at all
+struct NodeLoadMissing
+{
+    QString node;
+    QString name;
+    uint32_t id = 0;
+    int bus = -1;       //-1 when the DBC file isn't tied to a bus, then any bus would do
+    int cycleMs = 0;
+    bool seen = false;
+    uint64_t quietUs = 0; //from its last frame to the newest one on the bus, when seen
+};
+
+/*
+ * Traffic per transmitting ECU, from the transmitter the DBC files give each message. Every frame is looked up
+ * once per bus / ID pair through DBCHandler's (bus, ID) -> message index and from then on costs one hash lookup
+ * and working out its bit stream. Per node and per bus it keeps frames, payload bytes and bits on the wire, the
+ * busiest NODELOAD_PEAK_US slot and, for every bus / ID pair, the gaps against the DBC cycle time. Frames of IDs no
+ * file has go to an "(unknown)" node on their bus, messages without a transmitter (or Vector__XXX) to "(none)".
+ *
+ * The lookups hold as long as the DBC revision does. Once it moves, isCurrent() is false and everything has to be
+ * added again, which is what NodeLoadStore does.
+ *
+ * Frames come in arrival order. Ones from a few connections can be slightly out of order, those never count as a
+ * gap. Bus time is worked out per frame at whatever rates the reader picks since a capture file doesn't say.
+ */
+class NodeLoad
+{
+public:
+    NodeLoad() {}
+    void clear(); //forgets everything, the DBC lookups too
+    void add(const CANFrameRecord &rec, const uint8_t *payload);
+    bool isCurrent() const;
+
+    const QVector<NodeLoadNode> &nodes() const { return nodeList; }
+    const QVector<NodeLoadMessage> &messages() const { return messageList; }
+    const NodeLoadCounters *bus(int bus) const { return (bus >= 0 && bus < buses.count()) ? &buses[bus] : nullptr; }
+    int numBuses() const { return buses.count(); }
+    //goes through every loaded DBC file, so for when it's shown rather than per frame
+    QVector<NodeLoadMissing> missing() const;
+    qint64 bytes() const;
+
+private:
+    struct Route
+    {
+        int node;
+        int message; //-1 for frames no DBC message has
+    };
+
+    QHash<uint64_t, Route> routes; //CANFrameStore::idKey of the frame
+    QHash<QPair<int, QString>, int> nodeIndex; //bus and node name -> into nodeList
+    QHash<const DBC_MESSAGE *, int> cycles; //cyclic messages of every loaded file, filled on first use
+    QVector<NodeLoadNode> nodeList;
+    QVector<NodeLoadMessage> messageList;
+    QVector<NodeLoadCounters> buses;
+    quint32 revision = 0;
+    bool haveCycles = false;
+
+    Route route(const CANFrameRecord &rec);
+    int nodeFor(int bus, const QString &name, bool known);
+};
+
+/*
+ * Node traffic for one frame store. A FrameStoreFollower that also starts over when the DBC files change, as well
+ * as on a reset or a newly loaded file. Frames the store evicts stay
+ * counted.
+ *
+ * GUI thread only.
+ */
+class NodeLoadStore : public FrameStoreFollower, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    static NodeLoadStore *forFrames(const CANFrameStore *frames);
+
+    const NodeLoad &load() const { return nodeLoad; }
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+
+protected:
+    void clearState() override { nodeLoad.clear(); }
+    void add(int row) override;
+    //which node a frame belongs to came from the DBC files as they were
+    bool isStale() const override { return !nodeLoad.isCurrent(); }
+
+private:
+    explicit NodeLoadStore(const CANFrameStore *frames);
+
+    NodeLoad nodeLoad;
+};
+
+#endif // NODELOAD_H
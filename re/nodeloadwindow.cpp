@@ -0,0 +1,221 @@
+#include "nodeloadwindow.h"
+#include "ui_nodeloadwindow.h"
+#include "utility.h"
+#include "helpwindow.h"
+#include "dbc/dbchandler.h"
+
+#include <QKeyEvent>
+#include <QSettings>
+#include <algorithm>
+
+namespace
+{
+QString rateText(double count, double seconds)
+{
+    if (seconds <= 0.0) return "-";
+    return QString::number(count / seconds, 'f', 1);
+}
+
+QString percentText(double part, double whole)
+{
+    if (whole <= 0.0) return "-";
+    return QString::number(part * 100.0 / whole, 'f', 2);
+}
+}
+
+NodeLoadWindow::NodeLoadWindow(const CANFrameStore *frames, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::NodeLoadWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+
+    store = NodeLoadStore::forFrames(frames);
+
+    QStringList headers;
+    headers << tr("Bus") << tr("Node") << tr("Frames") << tr("Frames/s") << tr("Bytes/s") << tr("Peak Frames/s")
+            << tr("Peak Bytes/s") << tr("Share of Bus %") << tr("Bus Load %") << tr("Messages") << tr("Missing");
+    ui->tableNodes->setColumnCount(headers.count());
+    ui->tableNodes->setHorizontalHeaderLabels(headers);
+
+    headers.clear();
+    headers << tr("Bus") << tr("Node") << tr("Message") << tr("ID") << tr("Cycle (ms)") << tr("Quiet For (s)");
+    ui->tableMissing->setColumnCount(headers.count());
+    ui->tableMissing->setHorizontalHeaderLabels(headers);
+
+    QSettings settings;
+    ui->spinNominal->setValue(settings.value("NodeLoad/NominalRate", 500).toInt());
+    ui->spinData->setValue(settings.value("NodeLoad/DataRate", 2000).toInt());
+
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(NODELOAD_REFRESH_MS);
+    connect(&refreshTimer, &QTimer::timeout, this, &NodeLoadWindow::refresh);
+    connect(store, &NodeLoadStore::updated, this, &NodeLoadWindow::statsUpdated);
+    //which node sends what can change without a single new frame
+    connect(DBCHandler::getReference(), &DBCHandler::fileLoaded, this, &NodeLoadWindow::statsUpdated);
+    connect(DBCHandler::getReference(), &DBCHandler::fileReloaded, this, &NodeLoadWindow::statsUpdated);
+    connect(ui->spinNominal, QOverload<int>::of(&QSpinBox::valueChanged), this, &NodeLoadWindow::ratesChanged);
+    connect(ui->spinData, QOverload<int>::of(&QSpinBox::valueChanged), this, &NodeLoadWindow::ratesChanged);
+}
+
+NodeLoadWindow::~NodeLoadWindow()
+{
+    delete ui;
+}
+
+void NodeLoadWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+
+    readSettings();
+
+    refresh();
+
+    installEventFilter(this);
+}
+
+void NodeLoadWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool NodeLoadWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("nodeload.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void NodeLoadWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("NodeLoad/WindowSize", QSize(1000, 650)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("NodeLoad/WindowPos", QPoint(50, 50)).toPoint()));
+    }
+}
+
+void NodeLoadWindow::writeSettings()
+{
+    QSettings settings;
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("NodeLoad/WindowSize", size());
+        settings.setValue("NodeLoad/WindowPos", pos());
+    }
+}
+
+void NodeLoadWindow::ratesChanged()
+{
+    QSettings settings;
+    settings.setValue("NodeLoad/NominalRate", ui->spinNominal->value());
+    settings.setValue("NodeLoad/DataRate", ui->spinData->value());
+    refresh();
+}
+
+//the store updates on every framesUpdated, the window only every NODELOAD_REFRESH_MS
+void NodeLoadWindow::statsUpdated()
+{
+    if (!isVisible()) return;
+    if (!refreshTimer.isActive()) refreshTimer.start();
+}
+
+void NodeLoadWindow::refresh()
+{
+    store->sync(); //starts over by itself if the DBC files changed
+    QVector<NodeLoadMissing> missing = store->load().missing();
+    showNodes(missing);
+    showMissing(missing);
+}
+
+//each bus's totals, then its nodes by name with the catch alls last
+void NodeLoadWindow::showNodes(const QVector<NodeLoadMissing> &missing)
+{
+    const NodeLoad &load = store->load();
+    const QVector<NodeLoadNode> &nodes = load.nodes();
+    const int nominal = ui->spinNominal->value() * 1000;
+    const int data = ui->spinData->value() * 1000;
+
+    QVector<int> order(nodes.count());
+    for (int i = 0; i < order.count(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&nodes](int a, int b)
+    {
+        const NodeLoadNode &na = nodes.at(a);
+        const NodeLoadNode &nb = nodes.at(b);
+        if (na.bus != nb.bus) return na.bus < nb.bus;
+        if (na.known != nb.known) return na.known;
+        return na.name < nb.name;
+    });
+
+    int row = 0;
+    int next = 0;
+    ui->tableNodes->setRowCount(load.numBuses() + nodes.count());
+    for (int bus = 0; bus < load.numBuses(); bus++)
+    {
+        const NodeLoadCounters *total = load.bus(bus);
+        if (!total->frames) continue;
+        const double seconds = (total->lastStamp - total->firstStamp) / 1000000.0;
+        const double busBusy = total->busySeconds(nominal, data);
+        const double slot = NODELOAD_PEAK_US / 1000000.0;
+
+        auto addRow = [&](const QString &name, const NodeLoadCounters &counters, int messages, int quiet)
+        {
+            const double busy = counters.busySeconds(nominal, data);
+            QStringList cells;
+            cells << QString::number(bus) << name << QString::number(counters.frames) << rateText(counters.frames, seconds)
+                  << rateText(counters.bytes, seconds) << rateText(counters.peakFrames, slot)
+                  << rateText(counters.peakBytes, slot) << percentText(busy, busBusy) << percentText(busy, seconds)
+                  << (messages < 0 ? QString("-") : QString::number(messages))
+                  << (quiet < 0 ? QString("-") : QString::number(quiet));
+            for (int c = 0; c < cells.count(); c++) Utility::setTableCell(ui->tableNodes, row, c, cells.at(c));
+            row++;
+        };
+
+        addRow(tr("All nodes"), *total, -1, -1);
+        for (; next < order.count() && nodes.at(order.at(next)).bus == bus; next++)
+        {
+            const NodeLoadNode &node = nodes.at(order.at(next));
+            int quiet = -1;
+            if (node.known)
+            {
+                quiet = 0;
+                for (const NodeLoadMissing &miss : missing)
+                {
+                    if (miss.node == node.name && (miss.bus == bus || miss.bus < 0)) quiet++;
+                }
+            }
+            addRow(node.name, node.counters, node.messages.count(), quiet);
+        }
+    }
+    ui->tableNodes->setRowCount(row);
+}
+
+void NodeLoadWindow::showMissing(const QVector<NodeLoadMissing> &missing)
+{
+    ui->labelMissing->setText(tr("Cyclic messages not heard from for %1 cycles (%2):").arg(NODELOAD_MISSING_CYCLES).arg(missing.count()));
+    ui->tableMissing->setRowCount(missing.count());
+    for (int i = 0; i < missing.count(); i++)
+    {
+        const NodeLoadMissing &miss = missing.at(i);
+        QStringList cells;
+        cells << (miss.bus < 0 ? tr("Any") : QString::number(miss.bus)) << miss.node << miss.name
+              << Utility::formatCANID(miss.id) << QString::number(miss.cycleMs)
+              << (miss.seen ? QString::number(miss.quietUs / 1000000.0, 'f', 3) : tr("Never"));
+        for (int c = 0; c < cells.count(); c++) Utility::setTableCell(ui->tableMissing, i, c, cells.at(c));
+    }
+}
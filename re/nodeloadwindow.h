@@ -0,0 +1,49 @@
+#ifndef NODELOADWINDOW_H
+#define NODELOADWINDOW_H
+
+#include <QDialog>
+#include <QTimer>
+#include "canframestore.h"
+#include "re/nodeload.h"
+
+//at most this often the tables get redrawn while frames are coming in, in ms
+#define NODELOAD_REFRESH_MS     1000
+
+namespace Ui {
+class NodeLoadWindow;
+}
+
+/*
+ * Shows what NodeLoadStore keeps: for every bus its totals and under them each transmitting node's frames and
+ * bytes a second, the busiest second, its share of the bus time and how much of the bus it takes at the bit rates
+ * picked here. Below that the cyclic messages whose transmitter has gone quiet. Redrawn at most once per
+ * NODELOAD_REFRESH_MS like the latency window.
+ */
+class NodeLoadWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit NodeLoadWindow(const CANFrameStore *frames, QWidget *parent = 0);
+    ~NodeLoadWindow();
+    void showEvent(QShowEvent*);
+
+private slots:
+    void statsUpdated();
+    void refresh();
+    void ratesChanged();
+
+private:
+    Ui::NodeLoadWindow *ui;
+    NodeLoadStore *store;
+    QTimer refreshTimer;
+
+    void showNodes(const QVector<NodeLoadMissing> &missing);
+    void showMissing(const QVector<NodeLoadMissing> &missing);
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // NODELOADWINDOW_H
@@ -0,0 +1,443 @@
+#include "offscreenplot.h"
+
+#include <QSettings>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace
+{
+//the raster engine works in fixed point so points way off the image get pulled in to this many pixels
+const double pixelLimit = 1.0e6;
+
+class RenderTask : public QRunnable
+{
+public:
+    explicit RenderTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() override { task(); }
+private:
+    std::function<void()> task;
+};
+}
+
+OffscreenPlot *OffscreenPlot::setup(QCustomPlot *plot)
+{
+    QSettings settings;
+    if (!plot || !settings.value("Main/OffscreenPlots", false).toBool()) return nullptr;
+    return new OffscreenPlot(plot);
+}
+
+OffscreenPlot::OffscreenPlot(QCustomPlot *plot) :
+    QObject(plot),
+    plot(plot),
+    busy(false),
+    pending(false),
+    ownReplot(false),
+    dispatching(false)
+{
+    pool.setMaxThreadCount(1);
+
+    plot->addLayer("offscreenSource", plot->layer("main"), QCustomPlot::limBelow);
+    sourceLayer = plot->layer("offscreenSource");
+    sourceLayer->setVisible(false);
+    plot->addLayer("offscreenFrame", plot->layer("main"), QCustomPlot::limBelow);
+    frameLayer = plot->layer("offscreenFrame");
+
+    connect(plot, &QCustomPlot::beforeReplot, this, &OffscreenPlot::beforeReplot);
+    connect(plot, &QCustomPlot::afterReplot, this, &OffscreenPlot::afterReplot);
+    plot->installEventFilter(this);
+    adopt();
+    plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+OffscreenPlot::~OffscreenPlot()
+{
+    //a queued result for this object just gets dropped, only the worker itself has to be waited for
+    pool.waitForDone();
+}
+
+bool OffscreenPlot::handles(const QCPAbstractPlottable *plottable) const
+{
+    if (!plottable->keyAxis() || !plottable->valueAxis()) return false;
+    if (plottable->keyAxis()->axisRect() != plot->axisRect() || plottable->valueAxis()->axisRect() != plot->axisRect()) return false;
+    if (qobject_cast<const QCPGraph *>(plottable)) return true;
+    //color map images are only worked out with time going across
+    if (qobject_cast<const QCPColorMap *>(plottable)) return plottable->keyAxis()->orientation() == Qt::Horizontal;
+    return false;
+}
+
+//plottables a window adds later land on the current layer, they get moved over before they're ever drawn there
+void OffscreenPlot::adopt()
+{
+    for (int i = 0; i < plot->plottableCount(); i++)
+    {
+        QCPAbstractPlottable *plottable = plot->plottable(i);
+        bool ours = handles(plottable);
+        if (ours && plottable->layer() != sourceLayer) plottable->setLayer(sourceLayer);
+        else if (!ours && plottable->layer() == sourceLayer) plottable->setLayer("main");
+    }
+}
+
+void OffscreenPlot::beforeReplot()
+{
+    //a slot that replotted in the middle of a click would otherwise draw everything on the GUI thread after all
+    sourceLayer->setVisible(false);
+    adopt();
+}
+
+void OffscreenPlot::afterReplot()
+{
+    if (ownReplot) return;
+    start();
+}
+
+bool OffscreenPlot::eventFilter(QObject *obj, QEvent *event)
+{
+    if (obj == plot && !dispatching)
+    {
+        switch (event->type())
+        {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        {
+            //QCustomPlot only hit tests what's visible, so the plottables come out of hiding for the click
+            dispatching = true;
+            sourceLayer->setVisible(true);
+            static_cast<QObject *>(plot)->event(event);
+            sourceLayer->setVisible(false);
+            dispatching = false;
+            return true;
+        }
+        default:
+            break;
+        }
+    }
+    return QObject::eventFilter(obj, event);
+}
+
+void OffscreenPlot::start()
+{
+    if (busy)
+    {
+        pending = true;
+        return;
+    }
+    pending = false;
+    Snapshot snap;
+    if (!takeSnapshot(snap)) return;
+    busy = true;
+    pool.start(new RenderTask([this, snap]()
+    {
+        QImage image = render(snap);
+        Frame frame = snap.frame;
+        QMetaObject::invokeMethod(this, [this, image, frame]() { finished(image, frame); }, Qt::QueuedConnection);
+    }));
+}
+
+void OffscreenPlot::finished(const QImage &image, const Frame &frame)
+{
+    busy = false;
+    if (!frameItem)
+    {
+        frameItem = new QCPItemPixmap(plot);
+        frameItem->setLayer(frameLayer);
+        frameItem->setSelectable(false);
+        frameItem->setScaled(true, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        frameItem->topLeft->setType(QCPItemPosition::ptPlotCoords);
+        frameItem->bottomRight->setType(QCPItemPosition::ptPlotCoords);
+    }
+    QPixmap pixmap = QPixmap::fromImage(image);
+    pixmap.setDevicePixelRatio(frame.pixelRatio);
+    frameItem->setPixmap(pixmap);
+    frameItem->topLeft->setCoords(frame.topLeft);
+    frameItem->bottomRight->setCoords(frame.bottomRight);
+
+    //only the axes and the blit, and it mustn't set off another image by itself
+    ownReplot = true;
+    plot->replot();
+    ownReplot = false;
+    if (pending) start();
+}
+
+OffscreenPlot::AxisMap OffscreenPlot::axisMap(const QCPAxis *axis)
+{
+    AxisMap map;
+    map.lower = axis->range().lower;
+    map.upper = axis->range().upper;
+    map.logarithmic = (axis->scaleType() == QCPAxis::stLogarithmic);
+    map.reversed = axis->rangeReversed();
+    map.vertical = (axis->orientation() == Qt::Vertical);
+    map.pixels = map.vertical ? axis->axisRect()->height() : axis->axisRect()->width();
+    return map;
+}
+
+//the same sums as QCPAxis::coordToPixel, just from the axis rect's corner
+double OffscreenPlot::AxisMap::toPixel(double coord) const
+{
+    double t;
+    if (logarithmic)
+    {
+        //wrong sign for the range, QCPAxis puts those just off the low end too
+        if (coord / lower <= 0.0) return vertical ? pixels + 200.0 : -200.0;
+        t = std::log(coord / lower) / std::log(upper / lower);
+    }
+    else t = (coord - lower) / (upper - lower);
+    if (reversed) t = 1.0 - t;
+    return vertical ? (pixels - 1.0) - t * pixels : t * pixels;
+}
+
+bool OffscreenPlot::takeSnapshot(Snapshot &snap) const
+{
+    QCPAxisRect *axisRect = plot->axisRect();
+    if (!axisRect || axisRect->width() < 1 || axisRect->height() < 1) return false;
+    const QRect rect = axisRect->rect();
+    snap.size = rect.size();
+    snap.antialiased = plot->antialiasedElements().testFlag(QCP::aePlottables);
+    snap.frame.pixelRatio = plot->bufferDevicePixelRatio();
+    snap.frame.topLeft = QPointF(plot->xAxis->pixelToCoord(rect.left()), plot->yAxis->pixelToCoord(rect.top()));
+    snap.frame.bottomRight = QPointF(plot->xAxis->pixelToCoord(rect.left() + rect.width()),
+                                     plot->yAxis->pixelToCoord(rect.top() + rect.height()));
+
+    for (int i = 0; i < plot->plottableCount(); i++)
+    {
+        QCPAbstractPlottable *plottable = plot->plottable(i);
+        if (!plottable->visible() || plottable->layer() != sourceLayer) continue;
+        Series series;
+        series.keyAxis = axisMap(plottable->keyAxis());
+        series.valueAxis = axisMap(plottable->valueAxis());
+        if (QCPGraph *graph = qobject_cast<QCPGraph *>(plottable))
+        {
+            series.pen = graph->pen();
+            if (graph->selected() && graph->selectionDecorator()) series.pen = graph->selectionDecorator()->pen();
+            series.lineStyle = graph->lineStyle();
+            series.scatter = graph->scatterStyle();
+            //pixmaps can't be touched off the GUI thread
+            if (series.scatter.shape() == QCPScatterStyle::ssPixmap) series.scatter.setShape(QCPScatterStyle::ssNone);
+            copyGraph(graph, series);
+            if (series.points.isEmpty()) continue;
+        }
+        else if (QCPColorMap *map = qobject_cast<QCPColorMap *>(plottable))
+        {
+            series.cells.reset(new QCPColorMapData(*map->data()));
+            series.gradient = map->gradient();
+            series.dataRange = map->dataRange();
+            series.logData = (map->dataScaleType() == QCPAxis::stLogarithmic);
+            series.interpolate = map->interpolate();
+            series.tightBoundary = map->tightBoundary();
+        }
+        snap.series.append(series);
+    }
+    return true;
+}
+
+//the visible part plus a point either side. Past a few points per pixel column only each column's first, lowest,
+//highest and last points are kept (and a gap if there was one), which draws the same
+void OffscreenPlot::copyGraph(const QCPGraph *graph, Series &out)
+{
+    QSharedPointer<QCPGraphDataContainer> data = graph->data();
+    if (data->isEmpty()) return;
+    const double lower = qMin(out.keyAxis.lower, out.keyAxis.upper);
+    const double upper = qMax(out.keyAxis.lower, out.keyAxis.upper);
+    QCPGraphDataContainer::const_iterator begin = data->findBegin(lower);
+    QCPGraphDataContainer::const_iterator end = data->findEnd(upper);
+    const int count = static_cast<int>(end - begin);
+    const int budget = qMax(1, static_cast<int>(out.keyAxis.pixels)) * OFFSCREEN_POINTS_PER_PIXEL;
+    if (count <= budget)
+    {
+        out.points.reserve(count);
+        for (QCPGraphDataContainer::const_iterator it = begin; it != end; ++it) out.points.append(*it);
+        return;
+    }
+
+    out.points.reserve(budget + 8);
+    const QCPGraphData *keep[5];
+    const QCPGraphData *first = nullptr, *low = nullptr, *high = nullptr, *gap = nullptr, *last = nullptr;
+    int column = std::numeric_limits<int>::min();
+    auto flush = [&]()
+    {
+        int num = 0;
+        for (const QCPGraphData *p : {first, low, high, gap, last})
+        {
+            if (p) keep[num++] = p;
+        }
+        std::sort(keep, keep + num);
+        const QCPGraphData *prev = nullptr;
+        for (int i = 0; i < num; i++)
+        {
+            if (keep[i] != prev) out.points.append(*keep[i]);
+            prev = keep[i];
+        }
+    };
+    for (QCPGraphDataContainer::const_iterator it = begin; it != end; ++it)
+    {
+        const QCPGraphData *p = &*it;
+        const double pixel = qBound(-pixelLimit, out.keyAxis.toPixel(p->key), pixelLimit);
+        const int col = static_cast<int>(std::floor(pixel));
+        if (col != column)
+        {
+            if (first) flush();
+            column = col;
+            first = last = p;
+            low = high = gap = nullptr;
+        }
+        last = p;
+        if (std::isnan(p->value))
+        {
+            gap = p;
+            continue;
+        }
+        if (!low || p->value < low->value) low = p;
+        if (!high || p->value > high->value) high = p;
+    }
+    flush();
+}
+
+QImage OffscreenPlot::render(const Snapshot &snap)
+{
+    QImage image(snap.size * snap.frame.pixelRatio, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QCPPainter painter(&image);
+    painter.scale(snap.frame.pixelRatio, snap.frame.pixelRatio);
+    painter.setAntialiasing(snap.antialiased);
+    for (const Series &series : snap.series)
+    {
+        if (series.cells) drawColorMap(painter, series);
+        else drawGraph(painter, series);
+    }
+    painter.end();
+    return image;
+}
+
+void OffscreenPlot::drawGraph(QCPPainter &painter, const Series &series)
+{
+    const bool swapped = series.keyAxis.vertical;
+    auto point = [&](double key, double value)
+    {
+        double k = qBound(-pixelLimit, series.keyAxis.toPixel(key), pixelLimit);
+        double v = qBound(-pixelLimit, series.valueAxis.toPixel(value), pixelLimit);
+        return swapped ? QPointF(v, k) : QPointF(k, v);
+    };
+    auto keyOf = [&](const QPointF &p) { return swapped ? p.y() : p.x(); };
+    auto valueOf = [&](const QPointF &p) { return swapped ? p.x() : p.y(); };
+    auto make = [&](double k, double v) { return swapped ? QPointF(v, k) : QPointF(k, v); };
+
+    const QVector<QCPGraphData> &points = series.points;
+    if (series.pen.style() != Qt::NoPen && series.lineStyle != QCPGraph::lsNone)
+    {
+        painter.setPen(series.pen);
+        painter.setBrush(Qt::NoBrush);
+        if (series.lineStyle == QCPGraph::lsImpulse)
+        {
+            const double base = series.valueAxis.logarithmic ? series.valueAxis.lower : 0.0;
+            QVector<QLineF> lines;
+            lines.reserve(points.count());
+            for (const QCPGraphData &d : points)
+            {
+                if (!std::isnan(d.value)) lines.append(QLineF(point(d.key, d.value), point(d.key, base)));
+            }
+            painter.drawLines(lines);
+        }
+        else
+        {
+            QVector<QPointF> line;
+            line.reserve(series.lineStyle == QCPGraph::lsLine ? points.count() : points.count() * 3);
+            auto flushLine = [&]()
+            {
+                if (line.count() > 1) painter.drawPolyline(line.constData(), line.count());
+                line.clear();
+            };
+            for (const QCPGraphData &d : points)
+            {
+                if (std::isnan(d.value))
+                {
+                    flushLine();
+                    continue;
+                }
+                QPointF p = point(d.key, d.value);
+                if (!line.isEmpty())
+                {
+                    const QPointF prev = line.last();
+                    switch (series.lineStyle)
+                    {
+                    case QCPGraph::lsStepLeft:
+                        line.append(make(keyOf(p), valueOf(prev)));
+                        break;
+                    case QCPGraph::lsStepRight:
+                        line.append(make(keyOf(prev), valueOf(p)));
+                        break;
+                    case QCPGraph::lsStepCenter:
+                    {
+                        double mid = (keyOf(prev) + keyOf(p)) / 2.0;
+                        line.append(make(mid, valueOf(prev)));
+                        line.append(make(mid, valueOf(p)));
+                        break;
+                    }
+                    default:
+                        break;
+                    }
+                }
+                line.append(p);
+            }
+            flushLine();
+        }
+    }
+
+    if (series.scatter.shape() != QCPScatterStyle::ssNone)
+    {
+        series.scatter.applyTo(&painter, series.pen);
+        const QRectF bounds = QRectF(QPointF(0, 0), make(series.keyAxis.pixels, series.valueAxis.pixels)).normalized()
+                                  .adjusted(-series.scatter.size(), -series.scatter.size(), series.scatter.size(), series.scatter.size());
+        for (const QCPGraphData &d : points)
+        {
+            if (std::isnan(d.value)) continue;
+            QPointF p = point(d.key, d.value);
+            if (bounds.contains(p)) series.scatter.drawShape(&painter, p);
+        }
+    }
+}
+
+//one pixel per cell and let the painter stretch it, the way QCPColorMap does it
+void OffscreenPlot::drawColorMap(QCPPainter &painter, const Series &series)
+{
+    QCPColorMapData &cells = *series.cells; //cell() isn't const, this copy is the worker's own anyway
+    const int keySize = cells.keySize();
+    const int valueSize = cells.valueSize();
+    if (keySize < 1 || valueSize < 1 || cells.isEmpty()) return;
+
+    QImage image(keySize, valueSize, QImage::Format_ARGB32_Premultiplied);
+    QCPColorGradient gradient = series.gradient; //colorize builds its lookup table on first use so it can't be shared
+    QVector<double> row(keySize);
+    for (int v = 0; v < valueSize; v++)
+    {
+        for (int k = 0; k < keySize; k++) row[k] = cells.cell(k, v);
+        gradient.colorize(row.constData(), series.dataRange, reinterpret_cast<QRgb *>(image.scanLine(valueSize - 1 - v)),
+                          keySize, 1, series.logData);
+    }
+
+    QCPRange keys = cells.keyRange();
+    QCPRange values = cells.valueRange();
+    if (!series.tightBoundary)
+    {
+        //the ranges are the centres of the outer cells, the image reaches half a cell past them
+        double halfKey = (keySize > 1) ? keys.size() / (keySize - 1) / 2.0 : 0.5;
+        double halfValue = (valueSize > 1) ? values.size() / (valueSize - 1) / 2.0 : 0.5;
+        keys = QCPRange(keys.lower - halfKey, keys.upper + halfKey);
+        values = QCPRange(values.lower - halfValue, values.upper + halfValue);
+    }
+    double left = series.keyAxis.toPixel(keys.lower);
+    double right = series.keyAxis.toPixel(keys.upper);
+    double top = series.valueAxis.toPixel(values.upper);
+    double bottom = series.valueAxis.toPixel(values.lower);
+    bool flipHorz = left > right;
+    bool flipVert = top > bottom;
+    if (flipHorz) std::swap(left, right);
+    if (flipVert) std::swap(top, bottom);
+    if (flipHorz || flipVert) image = image.mirrored(flipHorz, flipVert);
+
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, series.interpolate);
+    painter.drawImage(QRectF(left, top, right - left, bottom - top), image);
+    painter.restore();
+}
@@ -0,0 +1,119 @@
+#ifndef OFFSCREENPLOT_H
+#define OFFSCREENPLOT_H
+
+#include <QImage>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include "qcustomplot.h"
+
+//points per pixel column a graph keeps when it's copied out for the worker (first, lowest, highest, last)
+#define OFFSCREEN_POINTS_PER_PIXEL  4
+
+/*
+ * Draws a plot's graphs and color maps into a QImage on a worker thread instead of in the GUI thread's replot.
+ * The plottables get moved onto a hidden layer so QCustomPlot skips them. After every replot that wasn't ours the
+ * visible part of each one is copied out (graphs squeezed down to a few points per pixel column on the way, so
+ * the copy is cheap however long the capture is) and handed to the worker together with where the axes were.
+ * The finished image goes into a QCPItemPixmap pinned to the plot coordinates it was drawn for, and the plot is
+ * replotted, which now only costs the axes and a blit.
+ *
+ * Because the image is pinned to plot coordinates a pan or zoom moves and stretches the last image along with
+ * the axes straight away. The worker catches up with what's really there a moment later. Only one image is ever
+ * being drawn. Anything that asks while it's busy gets the newest state once it finishes.
+ *
+ * Clicks still reach the plottables. The hidden layer is shown for just as long as QCustomPlot takes to work
+ * out what's under the mouse.
+ *
+ * Other kinds of plottables (bars, curves and so on) aren't touched and keep drawing the usual way.
+ */
+class OffscreenPlot : public QObject
+{
+    Q_OBJECT
+
+public:
+    //takes over the plot's drawing if Main/OffscreenPlots is set. Otherwise does nothing and returns nullptr
+    static OffscreenPlot *setup(QCustomPlot *plot);
+    explicit OffscreenPlot(QCustomPlot *plot); //owned by the plot
+    ~OffscreenPlot();
+
+    struct AxisMap
+    {
+        double lower = 0.0;
+        double upper = 1.0;
+        double pixels = 1.0; //length of the axis rect along this axis
+        bool logarithmic = false;
+        bool reversed = false;
+        bool vertical = false;
+        //pixels from the left / top of the axis rect
+        double toPixel(double coord) const;
+    };
+
+    struct Series
+    {
+        AxisMap keyAxis;
+        AxisMap valueAxis;
+        //graphs
+        QPen pen;
+        QCPGraph::LineStyle lineStyle = QCPGraph::lsLine;
+        QCPScatterStyle scatter;
+        QVector<QCPGraphData> points;
+        //color maps
+        QSharedPointer<QCPColorMapData> cells;
+        QCPColorGradient gradient;
+        QCPRange dataRange;
+        bool logData = false;
+        bool interpolate = false;
+        bool tightBoundary = false;
+    };
+
+    //where the image goes, in xAxis / yAxis coordinates
+    struct Frame
+    {
+        QPointF topLeft;
+        QPointF bottomRight;
+        double pixelRatio = 1.0;
+    };
+
+    struct Snapshot
+    {
+        QSize size; //of the axis rect
+        bool antialiased = false;
+        Frame frame;
+        QVector<Series> series;
+    };
+
+    static QImage render(const Snapshot &snap);
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private slots:
+    void beforeReplot();
+    void afterReplot();
+
+private:
+    bool handles(const QCPAbstractPlottable *plottable) const;
+    void adopt();
+    void start();
+    void finished(const QImage &image, const Frame &frame);
+    bool takeSnapshot(Snapshot &snap) const;
+    static AxisMap axisMap(const QCPAxis *axis);
+    static void copyGraph(const QCPGraph *graph, Series &out);
+    static void drawGraph(QCPPainter &painter, const Series &series);
+    static void drawColorMap(QCPPainter &painter, const Series &series);
+
+    QCustomPlot *plot;
+    QCPLayer *sourceLayer; //hidden, the plottables we draw live here
+    QCPLayer *frameLayer; //just below main so items still go on top
+    QPointer<QCPItemPixmap> frameItem; //a window clearing its items takes this with it, it gets made again
+    QThreadPool pool;
+    bool busy;
+    bool pending;
+    bool ownReplot;
+    bool dispatching;
+};
+
+#endif // OFFSCREENPLOT_H
@@ -0,0 +1,177 @@
+#include "periodicity.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+int jitterBinOf(quint32 jitter)
+{
+    if (jitter == 0) return 0;
+    int bin = 1 + static_cast<int>(std::log2(static_cast<double>(jitter)) * PERIOD_BINS_PER_OCTAVE);
+    return std::min(bin, PERIOD_JITTER_BINS - 1);
+}
+
+//geometric middle of a bin
+double jitterBinValue(int bin)
+{
+    if (bin == 0) return 0.0;
+    return std::exp2((bin - 1 + 0.5) / PERIOD_BINS_PER_OCTAVE);
+}
+}
+
+//the jitter at the given rank, same as indexing a sorted list of them at floor(fraction * count)
+quint32 PeriodStats::jitterPercentile(double fraction) const
+{
+    if (jitterSamples == 0) return 0;
+    quint64 rank = static_cast<quint64>(std::floor(fraction * jitterSamples));
+    quint64 seen = 0;
+    for (int b = 0; b < PERIOD_JITTER_BINS; b++)
+    {
+        seen += jitterBins[b];
+        if (seen > rank) return std::min(maxJitter, static_cast<quint32>(std::round(jitterBinValue(b))));
+    }
+    return maxJitter;
+}
+
+QString PeriodStats::summary() const
+{
+    if (period == 0) return QObject::tr("Not enough frames to estimate a period yet");
+    QString text = QObject::tr("Period: ") + QString::number(period / 1000.0, 'f', 3) + "ms";
+    if (!isPeriodic()) text += QObject::tr(" (irregular)");
+    text += "\n" + QObject::tr("Jitter: ") + QString::number(jitterPercentile(0.5) / 1000.0, 'f', 3) + " / "
+            + QString::number(jitterPercentile(0.95) / 1000.0, 'f', 3) + " / "
+            + QString::number(jitterPercentile(0.99) / 1000.0, 'f', 3) + QObject::tr("ms (median / 95% / 99%), max ")
+            + QString::number(maxJitter / 1000.0, 'f', 3) + "ms";
+    text += "\n" + QObject::tr("Missed cycles: ") + QString::number(missed);
+    return text;
+}
+
+void PeriodStats::addInterval(quint32 interval)
+{
+    ring[ringPos] = interval;
+    ringPos = (ringPos + 1) % PERIOD_RING;
+    if (ringFill < PERIOD_RING) ringFill++;
+    intervals++;
+    sinceEstimate++;
+
+    if (period == 0)
+    {
+        if (intervals >= PERIOD_MIN_INTERVALS && (intervals == PERIOD_MIN_INTERVALS || sinceEstimate >= PERIOD_REESTIMATE)) estimate();
+        return;
+    }
+    account(interval);
+    if (sinceEstimate >= PERIOD_REESTIMATE) estimate();
+}
+
+void PeriodStats::estimate()
+{
+    sinceEstimate = 0;
+    quint32 sorted[PERIOD_RING];
+    std::copy(ring, ring + ringFill, sorted);
+    std::nth_element(sorted, sorted + ringFill / 2, sorted + ringFill);
+    quint32 median = sorted[ringFill / 2];
+    if (median == 0) return; //a burst of frames with the same timestamp. Not a period of anything
+
+    if (period == 0)
+    {
+        //first estimate, everything so far is still in the ring
+        period = median;
+        for (int i = 0; i < ringFill; i++) account(ring[i]);
+        return;
+    }
+
+    quint32 drift = (median > period) ? median - period : period - median;
+    period = median;
+    if (drift > median / 4)
+    {
+        //the sender changed rate. Jitter against the old period means nothing now
+        quint64 keepMissed = missed;
+        resetJitter();
+        for (int i = 0; i < ringFill; i++) account(ring[i]);
+        missed = keepMissed;
+    }
+}
+
+//how far the interval is from the nearest whole number of periods, and how many frames are missing if that's more than one
+void PeriodStats::account(quint32 interval)
+{
+    quint64 cycles = std::max<quint64>(1, (static_cast<quint64>(interval) + period / 2) / period);
+    quint64 expected = cycles * period;
+    quint32 jitter = static_cast<quint32>((interval > expected) ? interval - expected : expected - interval);
+    missed += cycles - 1;
+    jitterBins[jitterBinOf(jitter)]++;
+    jitterSamples++;
+    if (jitter > maxJitter) maxJitter = jitter;
+}
+
+void PeriodStats::resetJitter()
+{
+    std::fill(jitterBins, jitterBins + PERIOD_JITTER_BINS, 0);
+    jitterSamples = 0;
+    maxJitter = 0;
+}
+
+PeriodTracker::~PeriodTracker()
+{
+    clear();
+}
+
+void PeriodTracker::clear()
+{
+    stats.clear();
+    arena.clear();
+}
+
+void PeriodTracker::add(uint64_t key, uint64_t stamp)
+{
+    PeriodStats *&slot = stats[key];
+    if (!slot) slot = arena.create();
+    PeriodStats &s = *slot;
+    if (s.frames > 0)
+    {
+        //whichever way doesn't go negative, frames from different sources can be a little out of order
+        uint64_t interval = (stamp > s.lastStamp) ? stamp - s.lastStamp : s.lastStamp - stamp;
+        s.addInterval(static_cast<quint32>(std::min<uint64_t>(interval, 0xFFFFFFFFu)));
+    }
+    s.frames++;
+    s.lastStamp = stamp;
+}
+
+PeriodicityStore *PeriodicityStore::forFrames(const CANFrameStore *frames)
+{
+    return perFrameStore<PeriodicityStore>(frames, [](const CANFrameStore *f) { return new PeriodicityStore(f); });
+}
+
+PeriodicityStore::PeriodicityStore(const CANFrameStore *frames) : FrameStoreFollower(frames)
+{
+    rebuild();
+}
+
+//everything in the store, one ID at a time by way of its per ID index so each key is only looked up once
+void PeriodicityStore::addAll()
+{
+    for (const CANFrameStore::IdInfo &info : frames->idList())
+    {
+        uint64_t key = CANFrameStore::idKey(info.id, info.bus);
+        for (int row : frames->rowsOf(info.id, info.bus)) tracker.add(key, frames->record(row).timestamp);
+    }
+}
+
+void PeriodicityStore::add(int row)
+{
+    const CANFrameRecord &rec = frames->record(row);
+    tracker.add(CANFrameStore::idKey(rec.frameId(), rec.bus), rec.timestamp);
+}
+
+QVector<QPair<int, const PeriodStats *>> PeriodicityStore::findAll(uint32_t id) const
+{
+    QVector<QPair<int, const PeriodStats *>> found;
+    for (const CANFrameStore::IdInfo &info : frames->idList())
+    {
+        if (info.id != id) continue;
+        const PeriodStats *s = find(id, info.bus);
+        if (s) found.append(qMakePair(info.bus, s));
+    }
+    return found;
+}
@@ -0,0 +1,112 @@
+#ifndef PERIODICITY_H
+#define PERIODICITY_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "framestorefollower.h"
+#include "objectarena.h"
+
+//how many of the latest intervals the period estimate is the median of
+#define PERIOD_RING             64
+//the period is worked out again after this many new intervals
+#define PERIOD_REESTIMATE       16
+//no period (and so no jitter or missed cycles) until there have been this many intervals
+#define PERIOD_MIN_INTERVALS    8
+//jitter sketch resolution, 1/8 of an octave or about 9% of the jitter itself
+#define PERIOD_BINS_PER_OCTAVE  8
+//bin 0 is no jitter at all, the rest cover 1us up to 2^32us
+#define PERIOD_JITTER_BINS      (1 + 32 * PERIOD_BINS_PER_OCTAVE)
+
+/*
+ * Cycle time of one ID on one bus, kept up to date one frame at a time.
+ *
+ * The period is the median of the last PERIOD_RING intervals so the odd late or dropped frame doesn't move it.
+ * Each interval is then compared against the nearest whole number of periods: the difference goes into a log scale
+ * histogram (the jitter sketch the percentiles come from) and an interval that spans more than one period counts the
+ * frames that should have been in between as missed. If the period moves by more than a quarter the sender changed
+ * rate, so the jitter sketch starts over from the intervals still in the ring.
+ *
+ * All times are microseconds.
+ */
+struct PeriodStats
+{
+    quint64 frames = 0;
+    quint64 intervals = 0;
+    uint64_t lastStamp = 0;
+    quint32 period = 0; //0 until there have been PERIOD_MIN_INTERVALS intervals
+    quint64 missed = 0;
+    quint64 jitterSamples = 0;
+    quint32 maxJitter = 0;
+
+    quint32 jitterPercentile(double fraction) const;
+    //regular enough to call periodic: 95% of frames within a quarter period of where they should be
+    bool isPeriodic() const { return period > 0 && jitterPercentile(0.95) < period / 4; }
+    //period, jitter and missed cycles in a few lines of text for tooltips and such
+    QString summary() const;
+
+private:
+    friend class PeriodTracker;
+    quint32 ring[PERIOD_RING];
+    int ringFill = 0;
+    int ringPos = 0;
+    int sinceEstimate = 0;
+    quint32 jitterBins[PERIOD_JITTER_BINS] = {0};
+
+    void addInterval(quint32 interval);
+    void estimate();
+    void account(quint32 interval);
+    void resetJitter();
+};
+
+/*
+ * A PeriodStats per key. Keys are up to the caller, CANFrameStore::idKey(id, bus) is the usual choice. add() is a
+ * hash lookup plus a handful of operations, the median is only taken every PERIOD_REESTIMATE frames of a key, so it
+ * keeps up with a full bus with thousands of IDs on it.
+ */
+class PeriodTracker
+{
+public:
+    PeriodTracker() {}
+    ~PeriodTracker();
+    void clear();
+    void add(uint64_t key, uint64_t stamp);
+    const PeriodStats *find(uint64_t key) const { return stats.value(key, nullptr); }
+    int count() const { return stats.count(); }
+
+private:
+    Q_DISABLE_COPY(PeriodTracker)
+    QHash<uint64_t, PeriodStats *> stats;
+    ObjectArena<PeriodStats> arena;
+};
+
+/*
+ * Periodicity of every bus / ID pair in one frame store, shared by all the windows that want it. A
+ * FrameStoreFollower that starts over from the store's per ID index on a reset, which is also how a loaded file
+ * gets covered. Frames the store evicts stay counted.
+ *
+ * GUI thread only.
+ */
+class PeriodicityStore : public FrameStoreFollower
+{
+    Q_OBJECT
+
+public:
+    static PeriodicityStore *forFrames(const CANFrameStore *frames);
+
+    const PeriodStats *find(uint32_t id, int bus) const { return tracker.find(CANFrameStore::idKey(id, bus)); }
+    //every bus the ID has been seen on, by bus
+    QVector<QPair<int, const PeriodStats *>> findAll(uint32_t id) const;
+
+protected:
+    void clearState() override { tracker.clear(); }
+    void add(int row) override;
+    void addAll() override;
+
+private:
+    explicit PeriodicityStore(const CANFrameStore *frames);
+
+    PeriodTracker tracker;
+};
+
+#endif // PERIODICITY_H
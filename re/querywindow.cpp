@@ -0,0 +1,178 @@
+#include "querywindow.h"
+#include "ui_querywindow.h"
+#include "utility.h"
+#include "helpwindow.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QProgressDialog>
+#include <QSettings>
+#include <cmath>
+
+namespace
+{
+//sorts on the number behind the text, with no value below everything
+class ResultItem : public QTableWidgetItem
+{
+public:
+    ResultItem(const QString &text, double value) : QTableWidgetItem(text), value(value) {}
+
+    bool operator<(const QTableWidgetItem &other) const override
+    {
+        const ResultItem *item = dynamic_cast<const ResultItem *>(&other);
+        if (!item) return QTableWidgetItem::operator<(other);
+        if (std::isnan(value)) return !std::isnan(item->value);
+        return !std::isnan(item->value) && value < item->value;
+    }
+
+private:
+    double value;
+};
+}
+
+QueryWindow::QueryWindow(const CANFrameStore *frames, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::QueryWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+
+    modelFrames = frames;
+
+    QSettings settings;
+    ui->editQuery->setPlainText(settings.value("Query/Text", "select count(), rate(), maxgap() group by id").toString());
+
+    connect(ui->btnRun, &QPushButton::clicked, this, &QueryWindow::runQuery);
+}
+
+QueryWindow::~QueryWindow()
+{
+    QSettings settings;
+    settings.setValue("Query/Text", ui->editQuery->toPlainText());
+    delete ui;
+}
+
+void QueryWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+    readSettings();
+    installEventFilter(this);
+}
+
+void QueryWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool QueryWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("query.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void QueryWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("Query/WindowSize", QSize(800, 600)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("Query/WindowPos", QPoint(100, 100)).toPoint()));
+    }
+}
+
+void QueryWindow::writeSettings()
+{
+    QSettings settings;
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("Query/WindowSize", size());
+        settings.setValue("Query/WindowPos", pos());
+    }
+}
+
+void QueryWindow::showError(const QString &error)
+{
+    QPalette pal = ui->lblStatus->palette();
+    pal.setColor(QPalette::WindowText, QColor(Qt::red));
+    ui->lblStatus->setPalette(pal);
+    ui->lblStatus->setText(error);
+}
+
+void QueryWindow::runQuery()
+{
+    QString error;
+    QSharedPointer<const FrameQuery> query = FrameQuery::compile(ui->editQuery->toPlainText(), &error);
+    if (!query)
+    {
+        showError(error);
+        return;
+    }
+    ui->lblStatus->setPalette(QApplication::palette());
+
+    CANFrameSnapshot frames = modelFrames->snapshot();
+    QProgressDialog progress(tr("Running query"), tr("Cancel"), 0, 1000, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+
+    QElapsedTimer timer;
+    timer.start();
+    //the events let the DBC files change under the workers. query keeps the message sets it reads alive, but edits
+    //change signals in place so the run stops once the revision moves
+    bool dbcChanged = false;
+    FrameQuery::Result result = query->run(frames, [&](qint64 done, qint64 total)
+    {
+        progress.setValue(static_cast<int>(done * 1000 / qMax<qint64>(total, 1)));
+        qApp->processEvents();
+        dbcChanged = !query->isCurrent();
+        return !progress.wasCanceled() && !dbcChanged;
+    });
+    progress.reset();
+
+    if (!result.complete)
+    {
+        if (dbcChanged) showError(tr("The DBC files changed while the query ran, run it again"));
+        else ui->lblStatus->setText(tr("Query canceled"));
+        return;
+    }
+    showResult(result);
+    ui->lblStatus->setText(tr("%1 rows from %2 of %3 frames in %4 ms").arg(result.rows.count())
+                           .arg(result.framesMatched).arg(result.framesScanned).arg(timer.elapsed()));
+}
+
+void QueryWindow::showResult(const FrameQuery::Result &result)
+{
+    QTableWidget *table = ui->tableResults;
+    table->setSortingEnabled(false);
+    table->clear();
+    table->setColumnCount(result.columns.count());
+    table->setHorizontalHeaderLabels(result.columns);
+    table->setRowCount(result.rows.count());
+    for (int r = 0; r < result.rows.count(); r++)
+    {
+        const QVector<double> &row = result.rows.at(r);
+        for (int c = 0; c < row.count(); c++)
+        {
+            ResultItem *item = new ResultItem(FrameQuery::formatValue(result.kinds.at(c), row.at(c)), row.at(c));
+            item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+            table->setItem(r, c, item);
+        }
+    }
+    table->setSortingEnabled(true);
+    table->resizeColumnsToContents();
+}
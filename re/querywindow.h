@@ -0,0 +1,40 @@
+#ifndef QUERYWINDOW_H
+#define QUERYWINDOW_H
+
+#include <QDialog>
+#include "canframestore.h"
+#include "framequery.h"
+
+namespace Ui {
+class QueryWindow;
+}
+
+/*
+ * Front end for FrameQuery. Type a query, run it over everything in the frame list (not just what the filters
+ * show) and the groups come back as a table. Click a header to sort on that column. The last query is kept.
+ */
+class QueryWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit QueryWindow(const CANFrameStore *frames, QWidget *parent = 0);
+    ~QueryWindow();
+    void showEvent(QShowEvent*);
+
+private slots:
+    void runQuery();
+
+private:
+    Ui::QueryWindow *ui;
+    const CANFrameStore *modelFrames;
+
+    void showError(const QString &error);
+    void showResult(const FrameQuery::Result &result);
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // QUERYWINDOW_H
@@ -0,0 +1,101 @@
+#include "rangecolumns.h"
+#include "utility.h"
+
+#include <QtEndian>
+
+void RangeColumns::build(const CANFrameStore *store, const QVector<int> &rows)
+{
+    frames = rows.count();
+    int maxLen = 0;
+    for (int row : rows) maxLen = qMax(maxLen, static_cast<int>(store->record(row).len));
+    words = (maxLen + 7) / 8;
+    intel.fill(0, (words + 1) * frames);
+    motorola.fill(0, (words + 1) * frames);
+    lens.resize(frames);
+    stamps.resize(frames);
+    buses.resize(frames);
+    fill(store, rows, 0);
+}
+
+void RangeColumns::extend(const RangeColumns &prev, const CANFrameStore *store, const QVector<int> &rows)
+{
+    frames = rows.count();
+    int maxLen = 0;
+    for (int i = prev.frames; i < frames; i++) maxLen = qMax(maxLen, static_cast<int>(store->record(rows[i]).len));
+    words = qMax(prev.words, (maxLen + 7) / 8);
+    intel.fill(0, (words + 1) * frames);
+    motorola.fill(0, (words + 1) * frames);
+    //column by column since they start further apart now
+    for (int w = 0; w < prev.words; w++)
+    {
+        memcpy(intel.data() + w * frames, prev.intel.constData() + w * prev.frames, prev.frames * sizeof(quint64));
+        memcpy(motorola.data() + w * frames, prev.motorola.constData() + w * prev.frames, prev.frames * sizeof(quint64));
+    }
+    lens = prev.lens;
+    stamps = prev.stamps;
+    buses = prev.buses;
+    lens.resize(frames);
+    stamps.resize(frames);
+    buses.resize(frames);
+    fill(store, rows, prev.frames);
+}
+
+//rows from "from" on, into columns that are already the right size and zeroed
+void RangeColumns::fill(const CANFrameStore *store, const QVector<int> &rows, int from)
+{
+    for (int i = from; i < frames; i++)
+    {
+        const CANFrameRecord &rec = store->record(rows[i]);
+        int len = rec.len;
+        const uint8_t *data = store->payloadData(rows[i]);
+        lens[i] = len;
+        stamps[i] = rec.timestamp;
+        buses[i] = rec.bus;
+        for (int w = 0; w * 8 < len; w++)
+        {
+            uint8_t word[8];
+            memset(word, 0, 8);
+            memcpy(word, data + w * 8, qMin(8, len - w * 8));
+            intel[w * frames + i] = qFromLittleEndian<quint64>(word);
+            motorola[w * frames + i] = qFromBigEndian<quint64>(word);
+        }
+    }
+}
+
+bool extractColumn(const RangeColumns &cols, const RangeCandidate &cand, QVector<int64_t> &out)
+{
+    int size = cand.bitLength;
+    if (size <= 0 || size > 64 || cand.startBit < 0) return false;
+
+    //the signal's first bit counting up from bit 0 of byte 0 (intel) or down from the top of byte 0 (motorola)
+    int linear = cand.bigEndian ? ((cand.startBit / 8) * 8 + (7 - (cand.startBit % 8))) : cand.startBit;
+    int w = linear / 64;
+    int off = linear % 64;
+    if (w >= cols.words) return false;
+
+    int minLen = SignalExtractor(cand.startBit, size, !cand.bigEndian, cand.isSigned).requiredLength();
+    quint64 mask = (size == 64) ? ~0ULL : ((1ULL << size) - 1);
+    quint64 signBit = (cand.isSigned && size < 64) ? (1ULL << (size - 1)) : 0;
+    int n = cols.frames;
+    const quint64 *lo = (cand.bigEndian ? cols.motorola.constData() : cols.intel.constData()) + w * n;
+    const quint64 *hi = lo + n;
+    const int *lens = cols.lens.constData();
+    out.resize(n);
+    int64_t *dest = out.data();
+
+    for (int i = 0; i < n; i++)
+    {
+        quint64 v;
+        if (cand.bigEndian)
+        {
+            v = (off ? ((lo[i] << off) | (hi[i] >> (64 - off))) : lo[i]) >> (64 - size);
+        }
+        else
+        {
+            v = (off ? ((lo[i] >> off) | (hi[i] << (64 - off))) : lo[i]) & mask;
+        }
+        v = (v ^ signBit) - signBit; //sign extends when signBit is set, does nothing when it's 0
+        dest[i] = (lens[i] >= minLen) ? static_cast<int64_t>(v) : 0;
+    }
+    return true;
+}
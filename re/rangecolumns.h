@@ -0,0 +1,53 @@
+#ifndef RANGECOLUMNS_H
+#define RANGECOLUMNS_H
+
+#include <QVector>
+#include "canframestore.h"
+
+//one signal layout a candidate search tries
+struct RangeCandidate
+{
+    int startBit;
+    int bitLength;
+    bool bigEndian;
+    bool isSigned;
+};
+
+/*
+ * One ID's frames turned on their side for the candidate searches. Column w holds payload bytes 8w to 8w+7 of
+ * every frame as one 64 bit word, once read little endian and once big endian, zero padded past the end of the frame.
+ * A signal of up to 64 bits can then be pulled out of any frame with two words, a couple of shifts and a mask. The
+ * loop over a column is the same few instructions for every frame, with no branches, so the compiler can vectorize it.
+ * There's an extra all zero column on the end so a signal in the last word can always read the next one.
+ *
+ * The frames' timestamps and buses are kept alongside as columns of their own so a search that also looks at when or
+ * where a frame was seen doesn't have to go back to the store.
+ *
+ * Built on the GUI thread, after that it's only read so any number of pool threads can extract from it at once.
+ * ColumnStore keeps them per ID so every search shares one set of columns and only reads new frames from the store.
+ */
+struct RangeColumns
+{
+    int frames = 0;
+    int words = 0;
+    QVector<quint64> intel; //column w starts at w * frames
+    QVector<quint64> motorola;
+    QVector<int> lens;
+    QVector<uint64_t> stamps;
+    QVector<quint8> buses;
+
+    void build(const CANFrameStore *store, const QVector<int> &rows);
+    //same as build, but the frames prev was built from are rows[0] up to prev.frames and get copied from it instead
+    void extend(const RangeColumns &prev, const CANFrameStore *store, const QVector<int> &rows);
+
+private:
+    void fill(const CANFrameStore *store, const QVector<int> &rows, int from);
+};
+
+/*
+ * Same values SignalExtractor gives for every frame of the ID, 0 for frames too short for the signal.
+ * False if the signal doesn't fit in the columns at all, which means every frame would be 0.
+ */
+bool extractColumn(const RangeColumns &cols, const RangeCandidate &cand, QVector<int64_t> &out);
+
+#endif // RANGECOLUMNS_H
@@ -1,11 +1,111 @@
 #include "rangestatewindow.h"
 #include "ui_rangestatewindow.h"
 #include "mainwindow.h"
+#include "windowupdategate.h"
 #include "utility.h"
 #include "helpwindow.h"
 #include "filterutility.h"
+#include "pipelinetrace.h"
+#include "re/columnstore.h"
 
-RangeStateWindow::RangeStateWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+//fewest candidates handed to one pool task, below this the task overhead isn't worth it
+#define RANGESTATE_MIN_TASK_CANDIDATES  16
+
+namespace
+{
+/*
+ * Whether the signal seems to be a smooth range signal. It has to cover enough of its possible range and the first
+ * and second order differences between frames can't jump around too much.
+ */
+bool isRangeSignal(const QVector<int64_t> &vals, const RangeCandidate &cand, int sensitivity)
+{
+    int numFrames = vals.count();
+    if (numFrames == 0) return false;
+    double lerpPoint = ((double)sensitivity - 10.0) / 240.0;
+
+    int64_t highestValue = vals[0];
+    int64_t lowestValue = vals[0];
+    for (int i = 1; i < numFrames; i++)
+    {
+        if (vals[i] < lowestValue) lowestValue = vals[i];
+        if (vals[i] > highestValue) highestValue = vals[i];
+    }
+
+    if (lowestValue == highestValue) return false; //a signal that never changes is worthless and not a range signal
+
+    double range = static_cast<double>(highestValue) - static_cast<double>(lowestValue);
+
+    double maxRange = std::ldexp(1.0, cand.isSigned ? (cand.bitLength - 1) : cand.bitLength);
+    //at highest sensitivity require signal to at least range 20% of max range
+    //at lowest  sensitivity require signal to at least range 1%  of max range
+    double requiredRange = std::floor(Utility::Lerp(maxRange * 0.01, maxRange * 0.2, lerpPoint));
+    if (range < requiredRange)
+        return false; //doesn't range enough.
+
+    //the first and second order differences, counted in one go without storing them
+    double firstLimit = std::floor(Utility::Lerp(range * 0.55, 0, lerpPoint));
+    double secondLimit = std::floor(Utility::Lerp(range * 0.20, 1, lerpPoint));
+    int firstOvers = 0, secondOvers = 0;
+    double prevDiff = 0.0;
+    for (int i = 1; i < numFrames; i++)
+    {
+        double diff = static_cast<double>(vals[i - 1]) - static_cast<double>(vals[i]);
+        if (std::fabs(diff) > firstLimit) firstOvers++;
+        if (i > 1 && std::fabs(prevDiff - diff) > secondLimit) secondOvers++;
+        prevDiff = diff;
+    }
+
+    //for a first test lets let through any signal where the first order diff doesn't seem too large
+    int maxOvers = Utility::Lerp(numFrames / 30.0, 2, lerpPoint);
+    if (firstOvers > maxOvers) return false;
+
+    //now the second order differentials. This is acceleration. There shouldn't be hard acceleration in values for a ranging signal
+    maxOvers = Utility::Lerp(8, 2, lerpPoint); //really clamp down on second order over limits
+    return secondOvers <= maxOvers;
+}
+
+//a run of candidates for one ID checked on a pool thread. The GUI thread picks up what it found once done is set
+class CandidateWorker : public QRunnable
+{
+public:
+    CandidateWorker(const RangeColumns *cols, const std::vector<RangeCandidate> *cands, int from, int to,
+                    int sensitivity, QAtomicInt *cancel)
+        : cols(cols), cands(cands), from(from), to(to), sensitivity(sensitivity), cancel(cancel)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        QVector<int64_t> vals;
+        for (int c = from; c < to && !cancel->loadRelaxed(); c++)
+        {
+            if (extractColumn(*cols, (*cands)[c], vals) && isRangeSignal(vals, (*cands)[c], sensitivity)) found.append(c);
+        }
+        done.storeRelease(1);
+    }
+
+    QVector<int> found;
+    QAtomicInt done;
+
+private:
+    const RangeColumns *cols;
+    const std::vector<RangeCandidate> *cands;
+    int from, to;
+    int sensitivity;
+    QAtomicInt *cancel;
+};
+}
+
+RangeStateWindow::RangeStateWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::RangeStateWindow)
 {
@@ -75,7 +175,7 @@ RangeStateWindow::RangeStateWindow(const QVector<CANFrame> *frames, QWidget *par
             });
 
     connect(ui->btnRecalc, &QAbstractButton::clicked, this, &RangeStateWindow::recalcButton);
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
     connect(ui->listCandidates, &QListWidget::currentRowChanged, this, &RangeStateWindow::clickedSignalList);
 }
 
@@ -84,6 +184,13 @@ RangeStateWindow::~RangeStateWindow()
     delete ui;
 }
 
+void RangeStateWindow::reportMemory(QVector<MemoryUsage> &out) const
+{
+    QString owner = memoryOwner("Range State Window");
+    out.append({owner, "found signals", MemoryAccounting::bytesOf(foundSignals)});
+    out.append({owner, "points on the plot", MemoryAccounting::plotBytes(ui->graphSignal)});
+}
+
 void RangeStateWindow::showEvent(QShowEvent* event)
 {
     QDialog::showEvent(event);
@@ -143,7 +250,7 @@ void RangeStateWindow::writeSettings()
 
 void RangeStateWindow::updatedFrames(int numFrames)
 {
-    CANFrame thisFrame;
+    TRACE_SCOPE("RangeStateWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted. We don't need to do a thing on this window but erase everything in the filters section
     {
         ui->listFilter->clear();
@@ -156,13 +263,13 @@ void RangeStateWindow::updatedFrames(int numFrames)
     else //just got some new frames. See if we need to update the filters list. Otherwise nothing to do - no recalc happens until the button is pressed
     {
         if (numFrames > modelFrames->count()) return;
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
         {
-            thisFrame = modelFrames->at(i);
-            if (!idFilters.contains(thisFrame.frameId()))
+            uint32_t id = modelFrames->record(i).frameId();
+            if (!idFilters.contains(id))
             {
-                idFilters.insert(thisFrame.frameId(), true);
-                FilterUtility::createCheckableFilterItem(thisFrame.frameId(), true, ui->listFilter);
+                idFilters.insert(id, true);
+                FilterUtility::createCheckableFilterItem(id, true, ui->listFilter);
             }
         }
     }
@@ -175,9 +282,9 @@ void RangeStateWindow::refreshFilterList()
     idFilters.clear();
     ui->listFilter->clear();
 
-    for (int i = 0; i < modelFrames->length(); i++)
+    for (const CANFrameStore::IdInfo &info : modelFrames->idList())
     {
-        id = modelFrames->at(i).frameId();
+        id = info.id;
         if (!idFilters.contains(id))
         {
             idFilters.insert(id, true);
@@ -188,6 +295,11 @@ void RangeStateWindow::refreshFilterList()
     ui->listFilter->sortItems();
 }
 
+/*
+ * Searches every checked ID. Each ID's frames get put into columns once and then all of its candidate signals are
+ * split up over a thread pool. Candidates show up in the list as they're found, still in the order they were
+ * generated, and the search can be cancelled from the progress dialog.
+ */
 void RangeStateWindow::recalcButton()
 {
     QMap<int, bool>::iterator iter;
@@ -197,31 +309,67 @@ void RangeStateWindow::recalcButton()
     foundSignals.clear();
     ui->graphSignal->clearGraphs();
 
+    int numIds = 0;
+    for (iter = idFilters.begin(); iter != idFilters.end(); ++iter)
+    {
+        if (iter.value()) numIds++;
+    }
+
     QProgressDialog progress(qApp->activeWindow());
     progress.setWindowModality(Qt::WindowModal);
     progress.setLabelText("Calculating");
-    progress.setCancelButton(0);
-    progress.setRange(0,0);
+    progress.setRange(0, numIds);
     progress.setMinimumDuration(0);
     progress.show();
 
+    int threads = qMax(1, QThread::idealThreadCount());
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QAtomicInt cancel(0);
+    int idsDone = 0;
 
-
-    for (iter = idFilters.begin(); iter != idFilters.end(); ++iter)
+    for (iter = idFilters.begin(); iter != idFilters.end() && !cancel.loadRelaxed(); ++iter)
     {
         if (iter.value() == true)
         {
             qDebug() << "Processing for ID: " << iter.key();
-            //so, we're supposed to process this frame ID. We'll need to create a frame cache for it
-            frameCache.clear();
-            frameCache.reserve(modelFrames->count()); //block allocate more than enough space
             id = iter.key();
-            for (int j = 0; j < modelFrames->count(); j++)
+            progress.setLabelText(tr("Searching ID ") + Utility::formatCANID(id));
+            progress.setValue(idsDone++);
+
+            QVector<int> rows;
+            QSharedPointer<const RangeColumns> cols = ColumnStore::forFrames(modelFrames)->columnsOf(id, &rows);
+            if (!cols) continue;
+            std::vector<RangeCandidate> cands = signalsFactory(modelFrames->record(rows[0]).len * 8);
+            if (cands.empty()) continue;
+
+            //a few tasks per thread so the last ones to finish don't leave the rest of the pool idle
+            int chunk = qMax(RANGESTATE_MIN_TASK_CANDIDATES, static_cast<int>(cands.size()) / (threads * 4) + 1);
+            std::vector<std::unique_ptr<CandidateWorker>> workers;
+            for (int from = 0; from < static_cast<int>(cands.size()); from += chunk)
             {
-                if (modelFrames->at(j).frameId() == id) frameCache.append(modelFrames->at(j));
+                int to = qMin(from + chunk, static_cast<int>(cands.size()));
+                workers.emplace_back(new CandidateWorker(cols.data(), &cands, from, to, ui->slideSensitivity->value(), &cancel));
             }
-            //now we've got a list with all the same ID. Time to send it off for processing
-            signalsFactory();
+            for (auto &worker : workers) pool.start(worker.get());
+
+            //list results from the front of the worker list as soon as they're ready so they stay in order
+            size_t listed = 0;
+            auto listFinished = [&]()
+            {
+                while (listed < workers.size() && workers[listed]->done.loadAcquire())
+                {
+                    for (int c : workers[listed]->found) addCandidate(id, cands[c]);
+                    listed++;
+                }
+            };
+            while (!pool.waitForDone(50))
+            {
+                listFinished();
+                qApp->processEvents();
+                if (progress.wasCanceled()) cancel.storeRelaxed(1);
+            }
+            listFinished();
         }
     }
 
@@ -235,161 +383,68 @@ void RangeStateWindow::recalcButton()
  * Should process from max to min and stop when a valid signal is found (at least as an option) to declutter a bit.
  * Mostly what we're interested in is the largest signal that matches
 */
-void RangeStateWindow::signalsFactory()
+std::vector<RangeCandidate> RangeStateWindow::signalsFactory(int maxBits)
 {
+    std::vector<RangeCandidate> cands;
     int minSig = ui->spinMinSigSize->value();
     int maxSig = ui->spinMaxSigSize->value();
-    int granularity = ui->spinGranularity->value();
+    int granularity = qMax(1, ui->spinGranularity->value());
     int sigType = ui->cbSignalMode->currentIndex() + 1;
     int signedType = ui->cbSignedMode->currentIndex() + 1;
-    int maxBits = frameCache.at(0).payload().length() * 8;
-    int sens = ui->slideSensitivity->value();
 
     for (int sigSize = maxSig; sigSize >= minSig; sigSize -= granularity)
     {
-        qApp->processEvents();
         for (int startBit = 0; startBit < maxBits; startBit += granularity)
         {
             if (sigType & 1)
             {
-                if (signedType & 1) processSignal(startBit, sigSize, sens, true, true);
-                if (signedType & 2) processSignal(startBit, sigSize, sens, true, false);
+                if (signedType & 1) cands.push_back({startBit, sigSize, true, true});
+                if (signedType & 2) cands.push_back({startBit, sigSize, true, false});
             }
             if (sigType & 2)
             {
-                if (signedType & 1) processSignal(startBit, sigSize, sens, false, true);
-                if (signedType & 2) processSignal(startBit, sigSize, sens, false, false);
+                if (signedType & 1) cands.push_back({startBit, sigSize, false, true});
+                if (signedType & 2) cands.push_back({startBit, sigSize, false, false});
             }
             //have to try both types even with 8 bit and smaller signals
             //because they could cross byte boundaries. Could check whether they
             //do and not try both types if it is impossible.
         }
     }
+    return cands;
 }
 
-/*
- * Given the signal we generate the relevant data and figure out whether this signal seems to be a smooth range signal
-*/
-bool RangeStateWindow::processSignal(int startBit, int bitLength, int sensitivity, bool bigEndian, bool isSigned)
+void RangeStateWindow::addCandidate(uint32_t id, const RangeCandidate &cand)
 {
-    qDebug() << "";
-    qDebug() << "S:" << startBit << " B:" << bitLength << " Sens:" << sensitivity << " Big E:" << bigEndian << " Signed: " << isSigned;
-
-    QVector<int> scaledVals;
-    QVector<int> diff1;
-    QVector<int> diff2;
-    int64_t valu;
-    int64_t highestValue = -1000000000000LL;
-    int64_t lowestValue = 1000000000000LL;
-    double lerpPoint = ((double)sensitivity - 10.0) / 240.0;
-    int numFrames = frameCache.count();
-
-    scaledVals.reserve(frameCache.count());
-    diff1.reserve(frameCache.count() - 1);
-    diff2.reserve(frameCache.count() - 2);
-
-    int i;
-
-    for (i = 0; i < numFrames; i++)
+    QString temp;
+    temp = "ID: " + QString::number(id, 16) + " startBit: " + QString::number(cand.startBit) + "  len: " + QString::number(cand.bitLength);
+    int64_t foundSig;
+    foundSig = id;
+    foundSig += (int64_t)cand.startBit << 32;
+    foundSig += (int64_t)cand.bitLength << 40;
+
+    if (cand.isSigned)
     {
-        valu = Utility::processIntegerSignal(frameCache.at(i).payload(), startBit, bitLength, !bigEndian, isSigned);
-        if (valu < lowestValue) lowestValue = valu;
-        if (valu > highestValue) highestValue = valu;
+        temp += " Signed";
+        foundSig += (int64_t)1 << 48;
     }
-
-    qDebug() << "Min: " << lowestValue << " Max: " << highestValue;
-
-    if (lowestValue == highestValue) return false; //a signal that never changes is worthless and not a range signal
-
-    int64_t range = highestValue - lowestValue;
-
-    int64_t maxRange = isSigned?(1<<(bitLength - 1)):(1 << bitLength);
-    //at highest sensitivity require signal to at least range 20% of max range
-    //at lowest  sensitivity require signal to at least range 1%  of max range
-    int64_t requiredRange = Utility::Lerp(maxRange * 0.01, maxRange * 0.2, lerpPoint);
-    if (range < requiredRange)
-        return false; //doesn't range enough.
-
-    for (i = 0; i < numFrames; i++)
-        scaledVals.append((int)((Utility::processIntegerSignal(frameCache.at(i).payload(), startBit, bitLength, !bigEndian, isSigned) - lowestValue)));
-
-    for (i = 1; i < numFrames; i++)
+    else
     {
-        valu = scaledVals[i-1] - scaledVals[i];
-        diff1.append(valu);
+        temp += " Unsigned";
     }
 
-    for (i = 1; i < diff1.count(); i++)
+    if (cand.bigEndian)
     {
-        valu = diff1[i-1] - diff1[i];
-        diff2.append(valu);
+        temp += " BigEndian";
+        foundSig += (int64_t)1 << 49;
     }
-
-    //now the differences are all stored so let's go through and see if first order diffs seem to suggest a ramping sort of signal or not.
-    //for a first test lets let through any signal where the first order diff doesn't seem too large
-    bool isGood = true;
-    int comparisonValue = Utility::Lerp((double)range * 0.55, 0, lerpPoint);
-    qDebug() << " 1st Delta comparisonvalue: " << comparisonValue;
-    int overValues = 0;
-    for (i = 0; i < diff1.count(); i++)
-    {
-        if (abs(diff1[i]) > comparisonValue) overValues++;
-    }
-    int maxOvers = Utility::Lerp(numFrames / 30.0, 2, lerpPoint);
-    qDebug() << "1st order overages: " << overValues << "   Max Overs: " << maxOvers;
-    if (overValues > maxOvers) isGood = false;
-
-    if (isGood)
+    else
     {
-        //now look at the second order differentials. This is acceleration. There shouldn't be hard acceleration in values for a ranging signal
-        comparisonValue = Utility::Lerp((double)range * 0.20, 1, lerpPoint);
-        maxOvers = Utility::Lerp(8, 2, lerpPoint); //really clamp down on second order over limits
-        qDebug() << "2nd Delta comparisonvalue: " << comparisonValue;
-        overValues = 0;
-        for (i = 0; i < diff2.count(); i++)
-        {
-            if (abs(diff2[i]) > comparisonValue) overValues++;
-        }
-        if (overValues > maxOvers) isGood = false;
-        qDebug() << "2nd order overages: " << overValues << "   Max Overs: " << maxOvers;
-        if (overValues > maxOvers) isGood = false;
+        temp += " LittleEndian";
     }
 
-    qDebug() << "Is this signal good: " << isGood << " Num overs: " << overValues;
-    if (isGood)
-    {
-        //createGraph(scaledVals);
-        QString temp;
-        temp = "ID: " + QString::number(frameCache.at(0).frameId(), 16) + " startBit: " + QString::number(startBit) + "  len: " + QString::number(bitLength);
-        int64_t foundSig;
-        foundSig = frameCache.at(0).frameId();
-        foundSig += (int64_t)startBit << 32;
-        foundSig += (int64_t)bitLength << 40;
-
-        if (isSigned)
-        {
-            temp += " Signed";
-            foundSig += (int64_t)1 << 48;
-        }
-        else
-        {
-            temp += " Unsigned";
-        }
-
-        if (bigEndian)
-        {
-            temp += " BigEndian";
-            foundSig += (int64_t)1 << 49;
-        }
-        else
-        {
-            temp += " LittleEndian";
-        }
-
-        ui->listCandidates->addItem(temp);
-        foundSignals.append(foundSig);
-    }
-    return isGood;
+    ui->listCandidates->addItem(temp);
+    foundSignals.append(foundSig);
 }
 
 //graphs the vector such that the X axis is just the index into the vector and Y is perfectly graphed within the window
@@ -464,17 +519,10 @@ void RangeStateWindow::clickedSignalList(int idx)
 
     qDebug() << "I:" << id << " sb:" << startBit << " len:" << bitLength << " signed:" << isSigned << " big:" << isBigEndian;
 
-    frameCache.clear();
-    frameCache.reserve(modelFrames->count()); //block allocate more than enough space
-
-    for (int j = 0; j < modelFrames->count(); j++)
-    {
-        if (modelFrames->at(j).frameId() == id) frameCache.append(modelFrames->at(j));
-    }
-
-    int numFrames = frameCache.count();
+    QVector<int> rows = modelFrames->rowsOf(id);
     QVector<int> values;
-    values.reserve(numFrames);
-    for (int i = 0; i < numFrames; i++) values.append((int)((Utility::processIntegerSignal(frameCache.at(i).payload(), startBit, bitLength, !isBigEndian, isSigned))));
+    values.reserve(rows.count());
+    SignalExtractor extractor(startBit, bitLength, !isBigEndian, isSigned);
+    for (int row : rows) values.append((int)(extractor.extract(modelFrames->payloadData(row), modelFrames->record(row).len)));
     createGraph(values);
 }
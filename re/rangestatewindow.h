@@ -3,20 +3,25 @@
 
 #include <QDialog>
 #include <QMap>
+#include <vector>
 #include "can_structs.h"
+#include "canframestore.h"
+#include "memoryaccounting.h"
+#include "rangecolumns.h"
 
 namespace Ui {
 class RangeStateWindow;
 }
 
-class RangeStateWindow : public QDialog
+class RangeStateWindow : public QDialog, public MemoryReporter
 {
     Q_OBJECT
 
 public:
-    explicit RangeStateWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit RangeStateWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~RangeStateWindow();
     void showEvent(QShowEvent*);
+    void reportMemory(QVector<MemoryUsage> &out) const override;
 
 private slots:
     void updatedFrames(int);
@@ -25,8 +30,7 @@ private slots:
 
 private:
     Ui::RangeStateWindow *ui;
-    const QVector<CANFrame> *modelFrames;
-    QVector<CANFrame> frameCache;
+    const CANFrameStore *modelFrames;
     QList<int64_t> foundSignals;
     QMap<int, bool> idFilters;
 
@@ -34,8 +38,8 @@ private:
     void closeEvent(QCloseEvent *event);
     void readSettings();
     void writeSettings();
-    void signalsFactory();
-    bool processSignal(int startBit, int bitLength, int sensitivity, bool bigEndian, bool isSigned);
+    std::vector<RangeCandidate> signalsFactory(int maxBits);
+    void addCandidate(uint32_t id, const RangeCandidate &cand);
     void createGraph(QVector<int> values);
     bool eventFilter(QObject *obj, QEvent *event);
 };
@@ -0,0 +1,104 @@
+#include "replotscheduler.h"
+#include "pipelinetrace.h"
+
+#include <QSettings>
+
+ReplotScheduler *ReplotScheduler::instance = nullptr;
+
+ReplotScheduler *ReplotScheduler::getReference()
+{
+    if (!instance) instance = new ReplotScheduler();
+    return instance;
+}
+
+ReplotScheduler::ReplotScheduler()
+{
+    QSettings settings;
+    setMaxRate(settings.value("Main/MaxReplotRate", REPLOT_DEFAULT_RATE).toInt());
+    connect(&timer, &QTimer::timeout, this, &ReplotScheduler::tick);
+}
+
+void ReplotScheduler::setMaxRate(int perSecond)
+{
+    if (perSecond < 1) perSecond = 1;
+    timer.setInterval(qMax(1, 1000 / perSecond));
+}
+
+void ReplotScheduler::request(QCustomPlot *plot)
+{
+    if (!plot) return;
+#ifdef SAVVYCAN_TRACE
+    PipelineTrace::traceReplots(plot);
+#endif
+    for (const QPointer<QCustomPlot> &p : queue)
+    {
+        if (p == plot) return; //already waiting, it'll pick up the newest data when it gets drawn
+    }
+    if (!isShowing(plot))
+    {
+        park(plot);
+        return;
+    }
+    queue.append(plot);
+    if (!timer.isActive())
+    {
+        //nothing drawn lately so this one can go right away, the timer spaces out whatever comes after it
+        tick();
+        timer.start();
+    }
+}
+
+void ReplotScheduler::tick()
+{
+    while (!queue.isEmpty())
+    {
+        QPointer<QCustomPlot> plot = queue.takeFirst();
+        if (!plot) continue; //window closed in the meantime
+        if (!isShowing(plot))
+        {
+            park(plot);
+            continue;
+        }
+        plot->replot(QCustomPlot::rpQueuedReplot);
+        return;
+    }
+    timer.stop(); //idle until the next request
+}
+
+bool ReplotScheduler::isShowing(const QCustomPlot *plot)
+{
+    return plot->isVisible() && !plot->window()->isMinimized();
+}
+
+//watches the plot's window so the plot can be queued again once it's showing
+void ReplotScheduler::park(QCustomPlot *plot)
+{
+    for (const QPointer<QCustomPlot> &p : parked)
+    {
+        if (p == plot) return;
+    }
+    parked.append(plot);
+    plot->window()->installEventFilter(this);
+}
+
+bool ReplotScheduler::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::Show || event->type() == QEvent::WindowStateChange)
+    {
+        for (int i = parked.count() - 1; i >= 0; i--)
+        {
+            QPointer<QCustomPlot> plot = parked[i];
+            if (!plot)
+            {
+                parked.removeAt(i);
+                continue;
+            }
+            if (plot->window() != obj) continue;
+            //shown but maybe not laid out yet, go through the queue so it's drawn once the event is done with
+            parked.removeAt(i);
+            queue.append(plot);
+            if (!timer.isActive()) timer.start();
+        }
+    }
+    return QObject::eventFilter(obj, event);
+}
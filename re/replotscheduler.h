@@ -0,0 +1,51 @@
+#ifndef REPLOTSCHEDULER_H
+#define REPLOTSCHEDULER_H
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include "qcustomplot.h"
+
+//replots per second across every plot that goes through the scheduler, unless Main/MaxReplotRate says otherwise
+#define REPLOT_DEFAULT_RATE     60
+
+/*
+ * Replots for plots whose data changed because frames came in. Instead of every window redrawing on every GUI
+ * tick they mark their plot dirty here and the scheduler redraws dirty plots one per tick, oldest first, with
+ * the tick rate capped for all of them together. So four busy windows share the budget instead of each taking a
+ * full redraw per tick, and asking again before the plot got its turn costs nothing.
+ *
+ * A plot that isn't visible (its window is hidden or minimized) isn't drawn at all. It stays dirty and gets
+ * queued again when its window is shown or restored.
+ *
+ * Only for updates driven by incoming data. Anything the user does (zoom, pan, edit) should still replot
+ * directly so it feels immediate.
+ */
+class ReplotScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ReplotScheduler *getReference();
+    void request(QCustomPlot *plot);
+    void setMaxRate(int perSecond);
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private slots:
+    void tick();
+
+private:
+    ReplotScheduler();
+    static bool isShowing(const QCustomPlot *plot);
+    void park(QCustomPlot *plot);
+
+    static ReplotScheduler *instance;
+    QTimer timer;
+    QList<QPointer<QCustomPlot>> queue; //dirty and waiting for a turn, oldest first
+    QList<QPointer<QCustomPlot>> parked; //dirty but not visible
+};
+
+#endif // REPLOTSCHEDULER_H
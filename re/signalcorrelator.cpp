@@ -0,0 +1,105 @@
+#include "signalcorrelator.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool CorrelationTimebase::build(const CorrelationReference &ref, uint64_t stepUs)
+{
+    values.clear();
+    int n = qMin(ref.stamps.count(), ref.values.count());
+    if (n < 2 || ref.stamps.at(n - 1) <= ref.stamps.at(0)) return false;
+
+    first = ref.stamps.at(0);
+    uint64_t span = ref.stamps.at(n - 1) - first;
+    step = qMax<uint64_t>(1, stepUs);
+    if (span / step >= CORRELATOR_MAX_POINTS) step = span / (CORRELATOR_MAX_POINTS - 1) + 1;
+
+    int points = static_cast<int>(span / step) + 1;
+    values.resize(points);
+    int s = 0;
+    for (int i = 0; i < points; i++)
+    {
+        uint64_t t = stampAt(i);
+        while (s < n - 2 && ref.stamps.at(s + 1) <= t) s++;
+        uint64_t t0 = ref.stamps.at(s);
+        uint64_t t1 = ref.stamps.at(s + 1);
+        double v0 = ref.values.at(s);
+        double v1 = ref.values.at(s + 1);
+        if (t <= t0 || t1 <= t0) values[i] = v0;
+        else if (t >= t1) values[i] = v1;
+        else values[i] = v0 + (v1 - v0) * static_cast<double>(t - t0) / static_cast<double>(t1 - t0);
+    }
+    return true;
+}
+
+bool CorrelationPlan::build(const CorrelationTimebase &base, const CANFrameStore *store, const QVector<int> &rows)
+{
+    hold.clear();
+    ref.clear();
+    refSquares = 0.0;
+    if (rows.isEmpty() || base.count() == 0) return false;
+
+    //the frames are oldest first, so one walk along them covers every point
+    int f = -1;
+    double sum = 0.0;
+    for (int i = 0; i < base.count(); i++)
+    {
+        uint64_t t = base.stampAt(i);
+        while (f + 1 < rows.count() && store->record(rows[f + 1]).timestamp <= t) f++;
+        if (f < 0) continue; //the ID hadn't been seen yet
+        hold.append(f);
+        ref.append(base.valueAt(i));
+        sum += base.valueAt(i);
+    }
+    if (hold.count() < CORRELATOR_MIN_POINTS) return false;
+
+    double mean = sum / hold.count();
+    for (double &v : ref)
+    {
+        v -= mean;
+        refSquares += v * v;
+    }
+    return refSquares > 0.0;
+}
+
+bool CorrelationPlan::score(const QVector<int64_t> &column, double &r) const
+{
+    int n = hold.count();
+    if (n == 0 || refSquares <= 0.0) return false;
+
+    const int *idx = hold.constData();
+    const double *y = ref.constData();
+    const int64_t *vals = column.constData();
+    //taking the first value off keeps the sums small for wide signals that don't move much
+    const double origin = static_cast<double>(vals[idx[0]]);
+    double sx = 0.0, sxx = 0.0, sxy = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        double x = static_cast<double>(vals[idx[i]]) - origin;
+        sx += x;
+        sxx += x * x;
+        sxy += x * y[i]; //y has no mean so this is the covariance as it is
+    }
+    double xSquares = sxx - sx * sx / n;
+    if (xSquares <= 0.0) return false;
+    r = sxy / std::sqrt(xSquares * refSquares);
+    return std::isfinite(r);
+}
+
+bool correlationBetter(const CorrelationMatch &a, const CorrelationMatch &b)
+{
+    double ra = std::fabs(a.r);
+    double rb = std::fabs(b.r);
+    if (ra != rb) return ra > rb;
+    return a.cand.bitLength > b.cand.bitLength;
+}
+
+void keepBestMatches(QVector<CorrelationMatch> &matches, int max)
+{
+    if (matches.count() > max)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + max, matches.end(), correlationBetter);
+        matches.resize(max);
+    }
+    else std::sort(matches.begin(), matches.end(), correlationBetter);
+}
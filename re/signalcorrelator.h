@@ -0,0 +1,81 @@
+#ifndef SIGNALCORRELATOR_H
+#define SIGNALCORRELATOR_H
+
+#include <QString>
+#include <QVector>
+#include "rangecolumns.h"
+
+//spacing of the common timebase unless the user picks another
+#define CORRELATOR_DEFAULT_STEP_US      50000
+//most points the timebase gets. A long reference gets a wider step instead, which keeps scoring a candidate cheap
+#define CORRELATOR_MAX_POINTS           20000
+//fewest points a candidate has to share with the reference before its score means anything
+#define CORRELATOR_MIN_POINTS           16
+//how many of the best candidates a search hands back
+#define CORRELATOR_MAX_RESULTS          500
+
+//the series the capture gets searched for. Stamps are on the capture's clock, in us and in order
+struct CorrelationReference
+{
+    QString name;
+    QVector<uint64_t> stamps;
+    QVector<double> values;
+};
+
+struct CorrelationMatch
+{
+    uint32_t id;
+    RangeCandidate cand;
+    double r;       //Pearson correlation, negative when the candidate falls as the reference rises
+    int points;     //timebase points it was scored over
+};
+
+/*
+ * The reference laid out on an even grid. Every stepUs from the reference's first sample to its last gets the value
+ * linearly interpolated between the samples on either side so a reference logged at some other rate (a CSV from a
+ * GPS, say) lines up with the capture. A reference long enough to need more than CORRELATOR_MAX_POINTS at that step
+ * gets a wider one.
+ */
+class CorrelationTimebase
+{
+public:
+    bool build(const CorrelationReference &ref, uint64_t stepUs); //false if the reference has less than two samples
+    int count() const { return values.count(); }
+    uint64_t stepUs() const { return step; }
+    uint64_t stampAt(int idx) const { return first + static_cast<uint64_t>(idx) * step; }
+    double valueAt(int idx) const { return values.at(idx); }
+
+private:
+    uint64_t first = 0;
+    uint64_t step = 1;
+    QVector<double> values;
+};
+
+/*
+ * One ID's frames lined up with the timebase. Each grid point from the ID's first frame on holds the newest frame
+ * at or before it, which is what the value on the bus was at that moment. The reference at those same points is
+ * kept with its mean taken out, so scoring a candidate column is one pass of three sums with nothing else to look up.
+ * Read only once built, any number of pool threads can score against it at once.
+ */
+class CorrelationPlan
+{
+public:
+    //rows are the ID's rows in the store, the same ones its RangeColumns were built from
+    bool build(const CorrelationTimebase &base, const CANFrameStore *store, const QVector<int> &rows);
+    int points() const { return hold.count(); }
+
+    //r of one extracted column against the reference. False for a column that never changes over the points
+    bool score(const QVector<int64_t> &column, double &r) const;
+
+private:
+    QVector<int> hold; //index into the ID's frames for each point
+    QVector<double> ref; //reference at each point, less its mean
+    double refSquares = 0.0; //sum of ref squared
+};
+
+//best first, stronger correlation either way round first and the longer signal on a tie
+bool correlationBetter(const CorrelationMatch &a, const CorrelationMatch &b);
+//keeps only the best max of matches, in order
+void keepBestMatches(QVector<CorrelationMatch> &matches, int max);
+
+#endif // SIGNALCORRELATOR_H
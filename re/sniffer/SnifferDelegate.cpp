@@ -4,6 +4,8 @@
 #include <QDebug>
 #include "utility.h"
 #include "re/sniffer/snifferitem.h"
+#include "re/sniffer/sniffermodel.h"
+#include "re/sniffer/snifferwindow.h"
 
 SnifferDelegate::SnifferDelegate(QWidget *parent) : QItemDelegate(parent)
 {
@@ -23,6 +25,7 @@ SnifferDelegate::SnifferDelegate(QWidget *parent) : QItemDelegate(parent)
     blackBrush = QBrush(Qt::black);
     whiteBrush = QBrush(Qt::white);
     grayBrush = QBrush(QColor(230,230,230));
+    steadyBrush = QBrush(QColor(120,120,120));
     mainFont.setPointSize(10);
     mainFontInfo = new QFontInfo(mainFont);
     mFadeInactive = false;
@@ -43,20 +46,22 @@ void SnifferDelegate::paint(QPainter *painter, const QStyleOptionViewItem &optio
 {
     //qDebug() << "SnifferDelegate Paint Event";
 
-    if (index.column() < 3) //allow default handling of the first two columns
+    if (index.column() < tc::DATA_0) //allow default handling of the delta, frequency and ID columns
     {
         QItemDelegate::paint(painter, option, index);
         return;
     }
 
-    if (index.column() > 10) return;
+    if (index.column() > tc::DATA_LAST) return;
 
     int x;
-    SnifferItem *item = static_cast<SnifferItem*>(index.internalPointer());
-    int idx = index.column() - 3;
+    const SnifferItem *item = static_cast<const SnifferModel*>(index.model())->itemAt(index);
+    if (!item) return;
+    int idx = index.column() - tc::DATA_0;
     int val = item->getData(idx);
     int prevVal = item->getLastData(idx);
     int notchPattern = item->getNotchPattern(idx);
+    int toggledPattern = item->getToggledBits(idx);
     int maskPattern;
     if (val < 0) return;
 
@@ -70,7 +75,7 @@ void SnifferDelegate::paint(QPainter *painter, const QStyleOptionViewItem &optio
     //qDebug() << "XSpan" << xSpan << " YSpan " << ySpan;
 
     int xSector = xSpan / 8;
-    int v = item->getSeqInterval(index.column() - 3) * 10;
+    int v = item->getSeqInterval(idx) * 10;
     if (v > 225) v = 225;
     if (v < 0) v = 0;
 
@@ -81,6 +86,7 @@ void SnifferDelegate::paint(QPainter *painter, const QStyleOptionViewItem &optio
         //straight draw it black if set or white if unset. If it changed then draw it green if it is newly set
         //and red if newly unset
         //But also, if a bit is notched we just plain draw it gray no matter what it's doing
+        //Set bits that have never once changed for this ID are drawn dark gray instead of black so the live ones stand out
         if (notchPattern & maskPattern)
         {
             painter->setBrush(grayBrush);
@@ -89,7 +95,7 @@ void SnifferDelegate::paint(QPainter *painter, const QStyleOptionViewItem &optio
         {
             if (val & maskPattern)
             {
-                painter->setBrush(blackBrush);
+                painter->setBrush((toggledPattern & maskPattern) ? blackBrush : steadyBrush);
             }
             else
             {
@@ -18,7 +18,7 @@ signals:
 public slots:
 
 private:
-    QBrush blackBrush, whiteBrush, redBrush, greenBrush, grayBrush;
+    QBrush blackBrush, whiteBrush, redBrush, greenBrush, grayBrush, steadyBrush;
     QFont mainFont;
     QFontInfo* mainFontInfo;
     bool  mFadeInactive;
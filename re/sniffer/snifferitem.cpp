@@ -1,24 +1,45 @@
 #include <QVariant>
 #include <QDebug>
+#include <QtAlgorithms>
 #include "snifferitem.h"
 
 
+SnifferItem::SnifferItem():
+    mID(0),
+    mWords(0),
+    mCurrentLen(0),
+    mLastLen(0),
+    mLastTime(0),
+    mCurrentTime(0),
+    mCurrSeqVal(0),
+    mDirty(false),
+    mStale(false)
+{
+    memset(mCurrent, 0, sizeof(mCurrent));
+    memset(mLast, 0, sizeof(mLast));
+    memset(mMarker, 0, sizeof(mMarker));
+    memset(mLastMarker, 0, sizeof(mLastMarker));
+    memset(mNotch, 0, sizeof(mNotch));
+    memset(mToggled, 0, sizeof(mToggled));
+    memset(mDataTimestamp, 0, sizeof(mDataTimestamp));
+}
+
 SnifferItem::SnifferItem(const CANFrame& pFrame, quint32 seq):
-    mID(pFrame.frameId())
-{
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(pFrame.payload().constData());
-    int dataLen = pFrame.payload().length();
-
-    for (int i = 0; i < dataLen; i++) {
-        mNotch[i] = 0;
-        mMarker.data[i] = 0;
-        mMarker.dataTimestamp[i] = 0;
-        if (i < dataLen) mCurrent.data[i] = data[i];
-        else mCurrent.data[i] = 0;
-        mCurrent.dataTimestamp[i] = seq;
-    }
-    mLastMarker = mMarker;
-    mCurrent.len = dataLen;
+    mID(pFrame.frameId()),
+    mLastLen(0),
+    mLastTime(0),
+    mCurrentTime(0),
+    mDirty(true),
+    mStale(false)
+{
+    memset(mMarker, 0, sizeof(mMarker));
+    memset(mLastMarker, 0, sizeof(mLastMarker));
+    memset(mNotch, 0, sizeof(mNotch));
+    memset(mToggled, 0, sizeof(mToggled));
+    loadPayload(pFrame, mCurrent, &mCurrentLen);
+    memcpy(mLast, mCurrent, sizeof(mLast));
+    mWords = (mCurrentLen + 7) / 8;
+    for (int i = 0; i < SNIFFER_BYTES; i++) mDataTimestamp[i] = seq;
 
     /* that's dirty */
     update(pFrame, seq, false);
@@ -41,25 +62,25 @@ float SnifferItem::getDelta() const
     return ((float)(mCurrentTime-mLastTime))/1000000;
 }
 
-//Get a data byte by index 0-7 (but not more than the length of the actual frame)
+//Get a data byte by index 0-63 (but not more than the length of the actual frame)
 int SnifferItem::getData(uchar i) const
 {
-    return (i >= mCurrent.len) ? -1 : mCurrent.data[i];
+    return (i >= mCurrentLen) ? -1 : byteOf(mCurrent, i);
 }
 
 quint8 SnifferItem::getNotchPattern(uchar i) const
 {
-    return (i >= mCurrent.len) ? -1 : mNotch[i];
+    return (i >= mCurrentLen) ? -1 : byteOf(mNotch, i);
 }
 
 quint8 SnifferItem::getLastData(uchar i) const
 {
-    return (i >= mLast.len) ? -1 : mLast.data[i];
+    return (i >= mLastLen) ? -1 : byteOf(mLast, i);
 }
 
 quint32 SnifferItem::getDataTimestamp(uchar i) const
 {
-    return (i >= mCurrent.len) ? 0 : mCurrent.dataTimestamp[i];
+    return (i >= mCurrentLen) ? 0 : mDataTimestamp[i];
 }
 
 quint32 SnifferItem::getSeqInterval(uchar i) const
@@ -67,19 +88,19 @@ quint32 SnifferItem::getSeqInterval(uchar i) const
     return mCurrSeqVal - getDataTimestamp(i);
 }
 
-//Return whether a given data byte (by index 0-7) has incremented, deincremented, or stayed the same
+//Return whether a given data byte (by index 0-63) has incremented, deincremented, or stayed the same
 //since the last message
 //The If checks first that we aren't past the actual data length
 // then checks whether lastMarker shows that some bits have changed in the previous 200ms cycle
 // then we check if the byte in mNotch has bits set and if it does we say nothing changed (notched out)
 dc SnifferItem::dataChange(uchar i) const
 {
-    if (i >= mCurrent.len) return dc::NO;
+    if (i >= mCurrentLen) return dc::NO;
 
-    uchar notch = mNotch[i];
-    uchar byt = mCurrent.data[i];
-    uchar last = mLast.data[i];
-    uchar lastMark = mLastMarker.data[i];
+    uchar notch = byteOf(mNotch, i);
+    uchar byt = byteOf(mCurrent, i);
+    uchar last = byteOf(mLast, i);
+    uchar lastMark = byteOf(mLastMarker, i);
     if( lastMark )
     {
         if (!notch) //if no notching is set
@@ -104,64 +125,96 @@ int SnifferItem::elapsed() const
     return mTime.elapsed();
 }
 
+//The payload as words, byte 0 lowest. Anything past the end of the frame is 0
+void SnifferItem::loadPayload(const CANFrame& pFrame, quint64 *words, int *len)
+{
+    const QByteArray payload = pFrame.payload();
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(payload.constData());
+    int dataLen = qMin(payload.length(), SNIFFER_BYTES);
+    memset(words, 0, SNIFFER_WORDS * sizeof(quint64));
+    for (int i = 0; i < dataLen; i++) words[i / 8] |= static_cast<quint64>(data[i]) << ((i % 8) * 8);
+    *len = dataLen;
+}
+
 //called when a new frame comes in that matches our same ID
 //timeSeq is stored so we can figure out the last time a specific byte was updated
 //mute is used to specify whether to mask the byte against the notching filter
 //in order to hide any updates of the notched bits. This is toggleable
 void SnifferItem::update(const CANFrame& pFrame, quint32 timeSeq, bool mute)
 {
-    unsigned char maskedCurr, maskedData;
-    //qDebug() << "update with ts: " << timeSeq;
+    int dataLen;
+    quint64 data[SNIFFER_WORDS];
+    loadPayload(pFrame, data, &dataLen);
+    mWords = qMax(mWords, (dataLen + 7) / 8);
+
     /* copy current to last */
-    mLast = mCurrent;
+    memcpy(mLast, mCurrent, mWords * sizeof(quint64));
+    mLastLen = mCurrentLen;
     mLastTime = mCurrentTime;
     mCurrSeqVal = timeSeq;
 
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(pFrame.payload().constData());
-    int dataLen = pFrame.payload().length();
-
-    /* copy new value */
-    for (int i = 0; i < dataLen; i++)
+    for (int w = 0; w < mWords; w++)
     {
-        maskedData = data[i];
-        if (mute) maskedData &= ~mNotch[i];
-        maskedCurr = mCurrent.data[i];
-        if (mute) maskedCurr &= ~mNotch[i];
-        if (maskedCurr != maskedData)
-        {
-            mCurrent.data[i] = data[i];
-            mCurrent.dataTimestamp[i] = timeSeq;
-        }
+        int wordLen = dataLen - w * 8;
+        quint64 lenMask = (wordLen >= 8) ? ~0ull : (wordLen <= 0) ? 0 : ((1ull << (wordLen * 8)) - 1);
+
+        /* copy new value */
+        //bits that differ, ignoring the notched ones when muting. A byte gets copied over whole if any of its bits did
+        quint64 changed = (mCurrent[w] ^ data[w]) & lenMask;
+        if (mute) changed &= ~mNotch[w];
+        quint64 fold = changed | (changed >> 4);
+        fold |= fold >> 2;
+        fold |= fold >> 1;
+        quint64 changedBytes = fold & 0x0101010101010101ull; //low bit of each byte that changed
+        quint64 byteMask = changedBytes * 0xFF;
+        mCurrent[w] = (mCurrent[w] & ~byteMask) | (data[w] & byteMask);
+        for (; changedBytes; changedBytes &= changedBytes - 1) mDataTimestamp[w * 8 + qCountTrailingZeroBits(changedBytes) / 8] = timeSeq;
+
+        /* update marker */
+        //We "OR" our stored marker with the changed bits.
+        //this accumulates changed bits into the marker
+        quint64 flipped = mLast[w] ^ mCurrent[w]; //XOR causes only changed bits to be 1's
+        mMarker[w] |= flipped;
+        mToggled[w] |= flipped & lenMask;
     }
-    mCurrent.len = dataLen;
+    mCurrentLen = dataLen;
     mCurrentTime = pFrame.timeStamp().microSeconds();
 
-    /* update marker */
-    //We "OR" our stored marker with the changed bits.
-    //this accumulates changed bits into the marker
-    for (int i = 0 ; i < 8; i++) mMarker.data[i] |= mLast.data[i] ^ mCurrent.data[i]; //XOR causes only changed bits to be 1's
-    mMarker.len  |= mLast.len ^ mCurrent.len;
-
     /* restart timeout */
     mTime.restart();
+    mDirty = true;
+}
+
+bool SnifferItem::staleChanged(int staleMs)
+{
+    bool stale = elapsed() > staleMs;
+    if (stale == mStale) return false;
+    mStale = stale;
+    return true;
 }
 
 //Called in refresh from the model. Interval about 200ms currently.
 //So, this means the marker only accumulates for 200ms then resets
 void SnifferItem::updateMarker()
 {
-    mLastMarker = mMarker;
-    for (int i = 0; i < 8; i++) mMarker.data[i] = 0;
+    //the up / down colouring comes from the last marker so the row only needs repainting if either one had bits
+    for (int w = 0; w < mWords; w++)
+    {
+        if (mLastMarker[w] | mMarker[w]) mDirty = true;
+        mLastMarker[w] = mMarker[w];
+        mMarker[w] = 0;
+    }
 }
 
 //Notch or un-notch this snifferitem / frame
 void SnifferItem::notch(bool pNotch)
 {
-    if(pNotch)
+    mDirty = true;
+    for (int w = 0; w < mWords; w++)
     {
-        for (int i = 0; i < 8; i++) mNotch[i] |= mLastMarker.data[i]; //add changed bits to notch value
+        if(pNotch)
+            mNotch[w] |= mLastMarker[w]; //add changed bits to notch value
+        else
+            mNotch[w] = 0;
     }
-
-    else
-        for (int i = 0; i < 8; i++) mNotch[i] = 0;
 }
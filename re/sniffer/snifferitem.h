@@ -3,14 +3,12 @@
 
 #include <QVariant>
 #include <QElapsedTimer>
+#include <QtGlobal>
 #include "can_structs.h"
 
-struct fstCan
-{
-    quint8 data[8];
-    quint32 dataTimestamp[8];
-    int len;
-};
+//64 bit words it takes to hold a whole CAN-FD payload
+#define SNIFFER_WORDS   8
+#define SNIFFER_BYTES   (SNIFFER_WORDS * 8)
 
 enum dc
 {
@@ -23,6 +21,7 @@ enum dc
 class SnifferItem
 {
 public:
+    SnifferItem();
     explicit SnifferItem(const CANFrame& pFrame, quint32 seq);
     virtual ~SnifferItem();
 
@@ -38,17 +37,40 @@ public:
     void update(const CANFrame& pFrame, quint32 timeSeq, bool mute);
     void updateMarker();
     void notch(bool);
+    //every bit of byte i that has changed at least once since the ID showed up
+    quint8 getToggledBits(uchar i) const { return (i >= SNIFFER_BYTES) ? 0 : byteOf(mToggled, i); }
+    //whether anything shown for this item changed since the model last told the view about it
+    bool isDirty() const { return mDirty; }
+    void setDirty() { mDirty = true; }
+    void clearDirty() { mDirty = false; }
+    //true when the ID cell's stale colouring (not heard from in a while) needs to flip
+    bool staleChanged(int staleMs);
 
 private:
+    static void loadPayload(const CANFrame& pFrame, quint64 *words, int *len);
+    static quint8 byteOf(const quint64 *words, int i) { return (words[i / 8] >> ((i % 8) * 8)) & 0xFF; }
+
+    /*
+     * The data bytes, notch mask and changed bit markers are each kept as 64 bit words with byte 0 in the low bits
+     * of the first word so change detection on every frame is a couple of XORs and ANDs per word instead of a loop
+     * over every byte. Only the words a frame of this ID ever reached (mWords) get looked at, one for classic CAN
+     */
     quint32         mID;
-    struct fstCan   mLast;
-    struct fstCan   mCurrent;
-    struct fstCan   mLastMarker;
-    struct fstCan   mMarker;
-    quint8          mNotch[8];
+    quint64         mCurrent[SNIFFER_WORDS];
+    quint64         mLast[SNIFFER_WORDS];
+    quint64         mMarker[SNIFFER_WORDS];
+    quint64         mLastMarker[SNIFFER_WORDS];
+    quint64         mNotch[SNIFFER_WORDS];
+    quint64         mToggled[SNIFFER_WORDS];
+    int             mWords;
+    int             mCurrentLen;
+    int             mLastLen;
+    quint32         mDataTimestamp[SNIFFER_BYTES];
     quint64         mLastTime;
     quint64         mCurrentTime;
     quint64         mCurrSeqVal;
+    bool            mDirty;
+    bool            mStale;
 
     QElapsedTimer   mTime;
 };
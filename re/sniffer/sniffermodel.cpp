@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <QDebug>
 #include <Qt>
 #include <QApplication>
@@ -12,7 +13,8 @@ SnifferModel::SnifferModel(QObject *parent)
       mFadeInactive(false),
       mMuteNotched(false),
       mTimeSequence(0),
-      mExpireInterval(5000)
+      mExpireInterval(5000),
+      mMaxDataLength(0)
 {
     QColor TextColor = QApplication::palette().color(QPalette::Text);
     if (TextColor.red() + TextColor.green() + TextColor.blue() < 200)
@@ -24,9 +26,6 @@ SnifferModel::SnifferModel(QObject *parent)
 
 SnifferModel::~SnifferModel()
 {
-    qDeleteAll(mMap);
-    mMap.clear();
-    mFilters.clear();
 }
 
 void SnifferModel::setExpireInterval(int newVal)
@@ -42,8 +41,13 @@ int SnifferModel::columnCount(const QModelIndex &parent) const
 
 int SnifferModel::rowCount(const QModelIndex &parent) const
 {
-    const QMap<quint32, SnifferItem*>& map = mFilter ? mFilters : mMap;
-    return parent.isValid() ? 0 : map.size();
+    return parent.isValid() ? 0 : mRows.size();
+}
+
+const SnifferItem *SnifferModel::itemAt(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.row() >= mRows.size()) return nullptr;
+    return &mItems[mRows[index.row()]];
 }
 
 
@@ -52,8 +56,8 @@ QVariant SnifferModel::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    SnifferItem *item = static_cast<SnifferItem*>(index.internalPointer());
-    if(!item) QVariant();
+    const SnifferItem *item = itemAt(index);
+    if(!item) return QVariant();
 
     int col = index.column();
 
@@ -73,7 +77,7 @@ QVariant SnifferModel::data(const QModelIndex &index, int role) const
                 default:
                     break;
             }
-            if(tc::DATA_0<=col && col <=tc::DATA_7)
+            if(tc::DATA_0<=col && col <=tc::DATA_LAST)
             {
                 int data = item->getData(col-tc::DATA_0);
                 if(data >= 0)
@@ -83,6 +87,15 @@ QVariant SnifferModel::data(const QModelIndex &index, int role) const
             }
             break;
         }
+        case Qt::ToolTipRole:
+        {
+            if (col == tc::ID || col == tc::DELTA || col == tc::FREQUENCY)
+            {
+                const PeriodStats *period = mPeriods.find(static_cast<quint32>(item->getId()));
+                if (period) return period->summary();
+            }
+            break;
+        }
         case Qt::ForegroundRole:
         {
             if (!mFadeInactive ||  col < 2) return QApplication::palette().brush(QPalette::Text);
@@ -105,13 +118,13 @@ QVariant SnifferModel::data(const QModelIndex &index, int role) const
         {
             if(tc::ID==col)
             {
-                if(item->elapsed() > 4000)
+                if(item->elapsed() > SNIFFER_STALE_MS)
                 {
                     if (!mDarkMode) return QBrush(Qt::red);
                     return QBrush(QColor(128,0,0));
                 }
             }
-            else if(tc::DATA_0<=col && col<=tc::DATA_7)
+            else if(tc::DATA_0<=col && col<=tc::DATA_LAST)
             {
                 dc change = item->dataChange(col-tc::DATA_0);
                 switch(change)
@@ -158,7 +171,7 @@ QVariant SnifferModel::headerData(int section, Qt::Orientation orientation, int
             default:
                 break;
         }
-        if(tc::DATA_0<=section && section <=tc::DATA_7)
+        if(tc::DATA_0<=section && section <=tc::DATA_LAST)
             return QString::number(section-tc::DATA_0);
     }
 
@@ -171,17 +184,10 @@ QModelIndex SnifferModel::index(int row, int column, const QModelIndex &parent)
     if (parent.isValid())
         return QModelIndex();
 
-    const QMap<quint32, SnifferItem*>& map = mFilter ? mFilters : mMap;
-
-    if(column>tc::LAST || row>=map.size())
+    if(column>tc::LAST || row<0 || row>=mRows.size())
         return QModelIndex();
 
-    /* ugly but I can't find best without creating a list to keep indexes */
-    QMap<quint32, SnifferItem*>::const_iterator iter;
-    int i;
-    for(iter = map.begin(), i=0 ; i<row ; ++i, ++iter);
-
-    return createIndex(row, column, iter.value());
+    return createIndex(row, column);
 }
 
 
@@ -213,6 +219,8 @@ void SnifferModel::setNeverExpire(bool val)
 void SnifferModel::setFadeInactive(bool val)
 {
     mFadeInactive = val;
+    //changes the colour of every data cell so they all get repainted next refresh
+    for (int i = 0; i < mItems.count(); i++) mItems[i].setDirty();
 }
 
 void SnifferModel::setMuteNotched(bool val)
@@ -223,63 +231,123 @@ void SnifferModel::setMuteNotched(bool val)
 void SnifferModel::clear()
 {
     beginResetModel();
-    qDeleteAll(mMap);
-    mMap.clear();
+    mItems.clear();
+    mIndex.clear();
+    mRows.clear();
     mFilters.clear();
+    mPeriods.clear();
     mFilter = false;
+    mMaxDataLength = 0;
     endResetModel();
 }
 
 void SnifferModel::updateNotchPoint()
 {
-    QMap<quint32, SnifferItem*>::iterator i;
-
     /* update markers */
-    for (i = mMap.begin(); i != mMap.end(); ++i)
+    for (int i = 0; i < mItems.count(); i++) mItems[i].updateMarker();
+}
+
+//positions of everything from item from onward moved
+void SnifferModel::rebuildIndex(int from)
+{
+    for (int i = from; i < mItems.count(); i++) mIndex[static_cast<quint32>(mItems[i].getId())] = i;
+}
+
+void SnifferModel::rebuildRows()
+{
+    mRows.clear();
+    mRows.reserve(mItems.count());
+    for (int i = 0; i < mItems.count(); i++)
     {
-        i.value()->updateMarker();
+        if (!mFilter || mFilters.contains(static_cast<quint32>(mItems[i].getId()))) mRows.append(i);
     }
 }
 
 //Called from window with a timer (currently 200ms)
 void SnifferModel::refresh()
 {
-    QMap<quint32, SnifferItem*>::iterator i;
-    QVector<quint32> toRemove;
-    SnifferItem* item;
-
     mTimeSequence++;
 
-    for (i = mMap.begin(); i != mMap.end(); ++i)
+    if (!mNeverExpire)
     {
-        //i.value()->updateMarker();
-        if(i.value()->elapsed() > (int)mExpireInterval && !mNeverExpire)
-            toRemove.append(i.key());
+        QVector<bool> expired(mItems.count(), false);
+        bool anyExpired = false;
+        for (int i = 0; i < mItems.count(); i++)
+        {
+            if (mItems[i].elapsed() > (int)mExpireInterval)
+            {
+                expired[i] = true;
+                anyExpired = true;
+            }
+        }
+
+        if (anyExpired)
+        {
+            //take the rows out in runs from the bottom up so the rows above each run stay put
+            int row = mRows.count() - 1;
+            while (row >= 0)
+            {
+                if (!expired[mRows[row]])
+                {
+                    row--;
+                    continue;
+                }
+                int last = row;
+                while (row > 0 && expired[mRows[row - 1]]) row--;
+                beginRemoveRows(QModelIndex(), row, last);
+                mRows.remove(row, last - row + 1);
+                endRemoveRows();
+                row--;
+            }
+
+            //squeeze the dead ones out of the item array. Rows still point at the same items, just renumbered
+            int out = 0;
+            for (int i = 0; i < mItems.count(); i++)
+            {
+                quint32 id = static_cast<quint32>(mItems[i].getId());
+                if (expired[i])
+                {
+                    mIndex.remove(id);
+                    mFilters.remove(id);
+                    /* send notification */
+                    emit idChange(id, false);
+                    continue;
+                }
+                if (out != i) mItems[out] = mItems[i];
+                out++;
+            }
+            mItems.resize(out);
+            rebuildIndex(0);
+            rebuildRows();
+        }
     }
 
-    if(toRemove.size())
+    /* refresh data, only the rows that changed and in as few ranges as possible */
+    int runStart = -1;
+    for (int row = 0; row <= mRows.count(); row++)
     {
-        beginResetModel();
-        foreach(quint32 id, toRemove)
+        bool dirty = false;
+        if (row < mRows.count())
         {
-            /* remove element */
-            item = mMap.take(id);
-            mFilters.remove(id);
-            delete item;
-            /* send notification */
-            emit idChange(id, false);
+            SnifferItem &item = mItems[mRows[row]];
+            if (item.staleChanged(SNIFFER_STALE_MS)) item.setDirty();
+            dirty = item.isDirty();
+            item.clearDirty();
+        }
+        if (dirty && runStart < 0) runStart = row;
+        else if (!dirty && runStart >= 0)
+        {
+            emit dataChanged(createIndex(runStart, 0), createIndex(row - 1, tc::LAST));
+            runStart = -1;
         }
-        endResetModel();
     }
-    else
-        /* refresh data */
-        emit dataChanged(createIndex(0, 0),
-                    createIndex(rowCount()-1, columnCount()-1), QVector<int>(Qt::DisplayRole));
 }
 
 
 void SnifferModel::filter(fltType pType, int pId)
 {
+    quint32 id = static_cast<quint32>(pId);
+
     beginResetModel();
     switch(pType)
     {
@@ -291,14 +359,17 @@ void SnifferModel::filter(fltType pType, int pId)
         case fltType::ADD:
             /* add filter to list */
             mFilter = true;
-            mFilters[pId] = mMap[pId];
+            if (mIndex.contains(id)) mFilters.insert(id);
             break;
         case fltType::REMOVE:
             /* remove filter */
             if(!mFilter)
-                mFilters = mMap;
+            {
+                mFilters.clear();
+                for (int i = 0; i < mItems.count(); i++) mFilters.insert(static_cast<quint32>(mItems[i].getId()));
+            }
             mFilter = true;
-            mFilters.remove(pId);
+            mFilters.remove(id);
             break;
         case fltType::ALL:
             /* stop filtering */
@@ -306,6 +377,7 @@ void SnifferModel::filter(fltType pType, int pId)
             mFilters.clear();
             break;
     }
+    rebuildRows();
     endResetModel();
 }
 
@@ -314,41 +386,52 @@ void SnifferModel::filter(fltType pType, int pId)
 /**********         slots       ****************/
 /***********************************************/
 
-void SnifferModel::update(CANConnection*, QVector<CANFrame>& pFrames)
+void SnifferModel::update(CANConnection*, const QVector<CANFrame>& pFrames)
 {
     foreach(const CANFrame& frame, pFrames)
     {
-        if(!mMap.contains(frame.frameId()))
+        quint32 id = frame.frameId();
+        if (frame.payload().length() > mMaxDataLength) mMaxDataLength = qMin(frame.payload().length(), SNIFFER_BYTES);
+        mPeriods.add(id, static_cast<uint64_t>(frame.timeStamp().microSeconds()));
+        QHash<quint32, int>::const_iterator found = mIndex.constFind(id);
+        if (found != mIndex.constEnd())
         {
-            int index = std::distance(mMap.begin(), mMap.lowerBound(frame.frameId()));
-            /* add the frame */
-            beginInsertRows(QModelIndex(), index, index);
-            mMap[frame.frameId()] = new SnifferItem(frame, mTimeSequence);
-            mMap[frame.frameId()]->update(frame, mTimeSequence, mMuteNotched);
-            endInsertRows();
-
-            emit idChange(frame.frameId(), true);
-        }
-        else
             //updateData
-            mMap[frame.frameId()]->update(frame, mTimeSequence, mMuteNotched);
+            mItems[found.value()].update(frame, mTimeSequence, mMuteNotched);
+            continue;
+        }
+
+        //new ID. Find where it goes in ID order and which view row that ends up being
+        int pos = 0, hi = mItems.count();
+        while (pos < hi)
+        {
+            int mid = (pos + hi) / 2;
+            if (mItems[mid].getId() < id) pos = mid + 1;
+            else hi = mid;
+        }
+        int row = std::lower_bound(mRows.begin(), mRows.end(), pos) - mRows.begin();
+
+        /* add the frame */
+        //new IDs get checked in the filter list so they're shown while filtering too
+        beginInsertRows(QModelIndex(), row, row);
+        mItems.insert(pos, SnifferItem(frame, mTimeSequence));
+        mItems[pos].update(frame, mTimeSequence, mMuteNotched);
+        rebuildIndex(pos);
+        for (int r = row; r < mRows.count(); r++) mRows[r]++;
+        mRows.insert(row, pos);
+        if (mFilter) mFilters.insert(id);
+        endInsertRows();
+
+        emit idChange(id, true);
     }
 }
 
 void SnifferModel::notch()
 {
-    QMap<quint32, SnifferItem*>& map = mFilter ? mFilters : mMap;
-
-    foreach(SnifferItem* item, map)
-        item->notch(true);
+    for (int r = 0; r < mRows.count(); r++) mItems[mRows[r]].notch(true);
 }
 
 void SnifferModel::unNotch()
 {
-    QMap<quint32, SnifferItem*>& map = mFilter ? mFilters : mMap;
-
-    foreach(SnifferItem* item, map)
-        item->notch(false);
+    for (int r = 0; r < mRows.count(); r++) mItems[mRows[r]].notch(false);
 }
-
-
@@ -5,11 +5,16 @@
 #include <QModelIndex>
 #include <QVariant>
 #include <QTimer>
+#include <QHash>
+#include <QSet>
 
 #include "can_structs.h"
 #include "connections/canconnection.h"
 #include "snifferitem.h"
+#include "re/periodicity.h"
 
+//the ID cell goes red once an ID hasn't been heard from in this long
+#define SNIFFER_STALE_MS    4000
 
 enum fltType
 {
@@ -47,11 +52,15 @@ public:
     void setFadeInactive(bool val);
     void setMuteNotched(bool val);
     void setExpireInterval(int newVal);
+    //longest payload seen since the last clear, so the window knows how many data columns to show
+    int getMaxDataLength() const { return mMaxDataLength; }
     void updateNotchPoint();
+    //the item shown on this row. Only valid until the next refresh / update / filter
+    const SnifferItem *itemAt(const QModelIndex &index) const;
 
 
 public slots:
-    void update(CANConnection*, QVector<CANFrame>&);
+    void update(CANConnection*, const QVector<CANFrame>&);
     void notch();
     void unNotch();
 
@@ -59,8 +68,19 @@ signals:
     void idChange(int, bool);
 
 private:
-    QMap<quint32, SnifferItem*> mMap;
-    QMap<quint32, SnifferItem*> mFilters;
+    void rebuildIndex(int from);
+    void rebuildRows();
+
+    /*
+     * Every ID seen lives in mItems, sorted by ID so rows come out in ID order. mIndex finds an ID's position in
+     * there and mRows lists the positions actually shown (all of them unless filtering), one per view row.
+     * Items say when something about them changed and refresh() only sends dataChanged for those rows.
+     */
+    QVector<SnifferItem>        mItems;
+    QHash<quint32, int>         mIndex;
+    QVector<int>                mRows;
+    QSet<quint32>               mFilters;
+    PeriodTracker               mPeriods; //by ID, shown as the tooltip of the ID, delta and frequency cells
     bool                        mFilter;
     bool                        mNeverExpire;
     bool                        mFadeInactive;
@@ -68,6 +88,7 @@ private:
     bool                        mDarkMode;
     quint32                     mTimeSequence;
     quint32                     mExpireInterval;
+    int                         mMaxDataLength;
 };
 
 #endif // SNIFFERMODEL_H
@@ -13,7 +13,8 @@ SnifferWindow::SnifferWindow(QWidget *parent) :
     ui(new Ui::snifferWindow),
     mModel(this),
     mGUITimer(this),
-    mFilter(false)
+    mFilter(false),
+    mDataColumns(SNIFFER_BYTES)
 {
     ui->setupUi(this);
     setWindowFlags(Qt::Window);
@@ -25,8 +26,9 @@ SnifferWindow::SnifferWindow(QWidget *parent) :
     /* set column width */
     ui->treeView->setColumnWidth(tc::ID, 80);
     ui->treeView->setColumnWidth(tc::LAST, 1);
-    for(int i=tc::DATA_0 ; i<=tc::DATA_7 ; i++)
+    for(int i=tc::DATA_0 ; i<=tc::DATA_LAST ; i++)
         ui->treeView->setColumnWidth(i, 92);
+    showDataColumns(8);
     ui->treeView->setUniformRowHeights(true);
     ui->treeView->header()->setDefaultAlignment(Qt::AlignCenter);
     //ui->treeView->setItemDelegate(new SnifferDelegate());
@@ -165,9 +167,28 @@ bool SnifferWindow::eventFilter(QObject *obj, QEvent *event)
     return false;
 }
 
+void SnifferWindow::showDataColumns(int pNum)
+{
+    if (pNum == mDataColumns) return;
+    for (int i = 0; i < SNIFFER_BYTES; i++) ui->treeView->setColumnHidden(tc::DATA_0 + i, i >= pNum);
+    mDataColumns = pNum;
+}
+
 void SnifferWindow::update()
 {
     mModel.refresh();
+    showDataColumns(qMax(8, mModel.getMaxDataLength()));
+
+    QStringList lines;
+    int buses = CANConManager::getInstance()->getNumBuses();
+    for (int bus = 0; bus < buses; bus++)
+    {
+        CANBusLoad load = CANConManager::getInstance()->getBusLoad(bus);
+        if (!load.known) continue;
+        lines << tr("Bus %1: %2%  avg %3%  peak %4%").arg(bus).arg(load.current, 0, 'f', 1)
+                 .arg(load.average, 0, 'f', 1).arg(load.peak, 0, 'f', 1);
+    }
+    ui->lblBusLoad->setText(lines.join("\n"));
 }
 
 void SnifferWindow::notchTick()
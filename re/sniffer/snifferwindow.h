@@ -16,13 +16,8 @@ enum tc
     FREQUENCY,
     ID,
     DATA_0,
-    DATA_1,
-    DATA_2,
-    DATA_3,
-    DATA_4,
-    DATA_5,
-    DATA_6,
-    DATA_7,
+    DATA_7 = DATA_0 + 7,
+    DATA_LAST = DATA_0 + SNIFFER_BYTES - 1, //columns past DATA_7 only show once a CAN-FD frame needs them
     LAST
 };
 
@@ -51,6 +46,7 @@ private:
     bool eventFilter(QObject *obj, QEvent *event);
     void readSettings();
     void writeSettings();
+    void showDataColumns(int pNum);
 
     Ui::snifferWindow*          ui;
     SnifferModel                mModel;
@@ -61,6 +57,7 @@ private:
     SnifferDelegate             *sniffDel;
     QAbstractItemDelegate       *defaultDel;
     bool                        notchPingPong;
+    int                         mDataColumns; //data columns not hidden, 8 until a CAN-FD frame needs more
 };
 
 #endif // SNIFFER_H
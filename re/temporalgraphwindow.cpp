@@ -2,6 +2,33 @@
 #include "ui_temporalgraphwindow.h"
 #include "helpwindow.h"
 #include "mainwindow.h"
+#include "windowupdategate.h"
+#include "replotscheduler.h"
+#include "offscreenplot.h"
+#include "pipelinetrace.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <cmath>
+#include <functional>
+
+namespace
+{
+class CountTask : public QRunnable
+{
+public:
+    explicit CountTask(std::function<void()> task) : task(std::move(task)) { setAutoDelete(true); }
+    void run() override { task(); }
+private:
+    std::function<void()> task;
+};
+}
+
+//below this many frames in view it isn't worth starting threads to count them
+#define TEMPORAL_PARALLEL_MIN   65536
+//how long the view has to sit still before it gets binned again
+#define TEMPORAL_REBIN_DELAY    30
 
 QString HexTicker::getTickLabel (double tick, const QLocale& locale, QChar formatChar, int precision)
 {
@@ -13,7 +40,7 @@ QString HexTicker::getTickLabel (double tick, const QLocale& locale, QChar forma
     return "0x" + QString::number(valu, 16).toUpper().rightJustified(3,'0');
 }
 
-TemporalGraphWindow::TemporalGraphWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+TemporalGraphWindow::TemporalGraphWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::TemporalGraphWindow)
 {
@@ -24,6 +51,18 @@ TemporalGraphWindow::TemporalGraphWindow(const QVector<CANFrame> *frames, QWidge
     readSettings();
 
     modelFrames = frames;
+    colorMap = nullptr;
+    followGraphEnd = false;
+    xminval = xmaxval = 0.0;
+    yminval = ymaxval = 0.0;
+    binCols = binRows = 0;
+    binX0 = binY0 = 0.0;
+    binXScale = binYScale = 1.0;
+    binMax = 0;
+
+    rebinTimer.setSingleShot(true);
+    rebinTimer.setInterval(TEMPORAL_REBIN_DELAY);
+    connect(&rebinTimer, &QTimer::timeout, this, &TemporalGraphWindow::rebin);
 
     ui->graphingView->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom | QCP::iSelectAxes);
 
@@ -46,10 +85,13 @@ TemporalGraphWindow::TemporalGraphWindow(const QVector<CANFrame> *frames, QWidge
     connect(ui->graphingView, SIGNAL(selectionChangedByUser()), this, SLOT(selectionChanged()));
     connect(ui->graphingView, SIGNAL(mousePress(QMouseEvent*)), this, SLOT(mousePress()));
     connect(ui->graphingView, SIGNAL(mouseWheel(QWheelEvent*)), this, SLOT(mouseWheel()));
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
     // make bottom and left axes transfer their ranges to top and right axes:
     connect(ui->graphingView->xAxis, SIGNAL(rangeChanged(QCPRange)), ui->graphingView->xAxis2, SLOT(setRange(QCPRange)));
     connect(ui->graphingView->yAxis, SIGNAL(rangeChanged(QCPRange)), ui->graphingView->yAxis2, SLOT(setRange(QCPRange)));
+    //zooming or panning changes which frames are in view and how big a cell is so bin again once it settles
+    connect(ui->graphingView->xAxis, SIGNAL(rangeChanged(QCPRange)), &rebinTimer, SLOT(start()));
+    connect(ui->graphingView->yAxis, SIGNAL(rangeChanged(QCPRange)), &rebinTimer, SLOT(start()));
 
     if (useOpenGL)
     {
@@ -62,6 +104,7 @@ TemporalGraphWindow::TemporalGraphWindow(const QVector<CANFrame> *frames, QWidge
         ui->graphingView->setOpenGl(false);
         ui->graphingView->setAntialiasedElements(QCP::aeNone);
     }
+    OffscreenPlot::setup(ui->graphingView);
 }
 
 TemporalGraphWindow::~TemporalGraphWindow()
@@ -109,160 +152,228 @@ void TemporalGraphWindow::writeSettings()
 
 void TemporalGraphWindow::updatedFrames(int numFrames)
 {
-    CANFrame thisFrame;
-    QVector<double> x, y;
-    bool appendedToGraph = false;
-    bool needReplot = false;
-
+    TRACE_SCOPE("TemporalGraphWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted. Kill the display
     {
-        //removeAllGraphs();
-        //now instead of removing the graphs regenerate them which will blank them out but leave them there in case
-        //more traffic that matches comes in or someone otherwise loads more data
-        ui->graphingView->clearGraphs(); //temporarily remove the graphs from the graph view
+        rebinTimer.stop();
         ui->graphingView->clearPlottables();
-        ui->graphingView->replot(); //now, redisplay them all
-
+        colorMap = nullptr;
+        binCounts.clear();
+        binCols = binRows = 0;
+        binMax = 0;
+        ui->graphingView->replot();
     }
     else if (numFrames == -2) //all new set of frames. Reset
     {
-        //there shouldn't be any need to actually remove the graphs.
-        //regenerate them instead
-        ui->graphingView->clearGraphs(); //temporarily remove the graphs from the graph view
-        //needScaleSetup = true;
         generateGraph();
-        //ui->graphingView->replot(); //now, redisplay them all
     }
-    else //just got some new frames. See if they are relevant.
+    else //just got some new frames. Count them into whatever cells they land in
     {
-        if (numFrames > modelFrames->count()) return;
+        if (numFrames > modelFrames->count() || numFrames <= 0) return;
+        if (!colorMap)
+        {
+            generateGraph();
+            return;
+        }
 
-            appendedToGraph = false;
-            x.clear();
-            y.clear();
-            for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
-            {
-                thisFrame = modelFrames->at(i);
-                /*
-                if (graphParams[j].ID == thisFrame.ID)
-                {
-                    appendToGraph(graphParams[j], thisFrame, x, y);
-                    appendedToGraph = true;
-                }*/
-            }
-            if (appendedToGraph)
-            {
-                //graphParams[j].ref->addData(x, y);
-                needReplot = true;
-            }
+        quint32 oldMax = binMax;
+        for (int i = modelFrames->tailIndex(numFrames); i < modelFrames->count(); i++)
+        {
+            const CANFrameRecord &rec = modelFrames->record(i);
+            double stamp = rec.timestamp / 1000000.0;
+            if (stamp > xmaxval) xmaxval = stamp;
+            if (stamp < xminval) xminval = stamp;
+            if (rec.frameId() > ymaxval) ymaxval = rec.frameId();
+            if (rec.frameId() < yminval) yminval = rec.frameId();
+
+            int bin = binOf(rec);
+            if (bin < 0) continue;
+            binCounts[bin]++;
+            if (binCounts[bin] > binMax) binMax = binCounts[bin];
+            showCell(bin);
+        }
+        if (binMax != oldMax) colorMap->setDataRange(QCPRange(0.0, std::log1p(static_cast<double>(binMax))));
 
-        if (needReplot)
+        if (followGraphEnd)
         {
-            if (followGraphEnd)
-            {
-                //find the current X span and maintain that span but move the end of it over to match the new end
-                //of the actual graph. This causes the view to move with the data to always show the end
-                QCPRange range = ui->graphingView->xAxis->range();
-                double size = range.size();
-                bool foundRange;
-                QCPRange keyRange = ui->graphingView->graph()->getKeyRange(foundRange);
-                if (foundRange)
-                {
-                    double end, start;
-                    end = keyRange.upper;
-                    start = end - size;
-                    ui->graphingView->xAxis->setRange(start, end);
-                }
-            }
-            ui->graphingView->replot();
+            //keep the current X span but slide it over so it ends where the data ends. The range change bins the
+            //new view once things settle
+            double size = ui->graphingView->xAxis->range().size();
+            ui->graphingView->xAxis->setRange(xmaxval - size, xmaxval);
         }
+        ReplotScheduler::getReference()->request(ui->graphingView);
     }
 }
 
+/*
+ * Works out the extents from the per ID summary (first / last ID and the earliest / latest stamp of any of them),
+ * shows all of it and bins it. No per frame pass here, rebin only ever walks the frames inside the view.
+ */
 void TemporalGraphWindow::generateGraph()
 {
-    if (modelFrames->count() == 0) return;
-
-    ui->graphingView->clearGraphs();
+    rebinTimer.stop();
     ui->graphingView->clearPlottables();
+    colorMap = nullptr;
+    binCounts.clear();
+    binCols = binRows = 0;
+    binMax = 0;
 
-    qDebug() << "Regenerating the graph";
-    ui->graphingView->addGraph();
-    graph = ui->graphingView->graph();
-
-    QVector<double> x, y;
-    int frameCount = modelFrames->count();
-
-    x.reserve(frameCount);
-    y.reserve(frameCount);
-
-    xminval = xmaxval = modelFrames->at(0).timeStamp().microSeconds() / 1000000.0;
-    yminval = ymaxval = modelFrames->at(0).frameId();
-
-    for (int i = 0; i < frameCount; i++)
+    if (modelFrames->count() == 0)
     {
-        x.append(modelFrames->at(i).timeStamp().microSeconds() / 1000000.0);
-        y.append(modelFrames->at(i).frameId());
-        if (x[i] > xmaxval) xmaxval = x[i];
-        if (x[i] < xminval) xminval = x[i];
-        if (y[i] > ymaxval) ymaxval = y[i];
-        if (y[i] < yminval) yminval = y[i];
+        ui->graphingView->replot();
+        return;
     }
 
-    ui->graphingView->graph()->setData(x,y);
-    ui->graphingView->graph()->setLineStyle(QCPGraph::lsNone); //no lines
-    ui->graphingView->graph()->setScatterStyle(QCPScatterStyle::ssCircle);
-    QPen graphPen;
-    graphPen.setColor(Qt::blue);
-    graphPen.setWidth(2);
-    ui->graphingView->graph()->setPen(graphPen);
+    QVector<CANFrameStore::IdInfo> ids = modelFrames->idList();
+    if (ids.isEmpty()) return;
+    yminval = ids.first().id;
+    ymaxval = ids.last().id;
+    uint64_t firstStamp = ids.first().firstStamp;
+    uint64_t lastStamp = ids.first().lastStamp;
+    for (int i = 1; i < ids.count(); i++)
+    {
+        if (ids[i].firstStamp < firstStamp) firstStamp = ids[i].firstStamp;
+        if (ids[i].lastStamp > lastStamp) lastStamp = ids[i].lastStamp;
+    }
+    xminval = firstStamp / 1000000.0;
+    xmaxval = lastStamp / 1000000.0;
+    if (xmaxval <= xminval) xmaxval = xminval + 1.0; //single instant. Give it some width to draw in
 
-    qDebug() << "xmin: " << xminval;
-    qDebug() << "xmax: " << xmaxval;
-    qDebug() << "ymin: " << yminval;
-    qDebug() << "ymax: " << ymaxval;
+    colorMap = new QCPColorMap(ui->graphingView->xAxis, ui->graphingView->yAxis);
+    colorMap->setGradient(QCPColorGradient::gpJet);
+    colorMap->setInterpolate(false); //cells are only a couple pixels, blurring them just smears the activity
 
     ui->graphingView->xAxis->setRange(xminval, xmaxval);
-    ui->graphingView->yAxis->setRange(yminval, ymaxval);
+    ui->graphingView->yAxis->setRange(yminval, ymaxval + 1);
     ui->graphingView->axisRect()->setupFullAxesBox();
 
-    ui->graphingView->replot();
+    rebinTimer.stop(); //the range changes above queued one, doing it now instead
+    rebin();
+}
 
+/*
+ * Bins whatever part of the data is on screen into cells of TEMPORAL_PIXELS_PER_BIN pixels. The time span in
+ * view maps onto a contiguous run of rows so only those get looked at, split across the thread pool when there
+ * are enough of them. Every chunk counts into its own array, those get summed at the end so there's no locking.
+ * The store isn't touched by anything else while this waits on the pool since the GUI thread is what feeds it.
+ */
+void TemporalGraphWindow::rebin()
+{
+    if (!colorMap) return;
 
-    QCPColorMap *colorMap = new QCPColorMap(ui->graphingView->xAxis, ui->graphingView->yAxis);
+    QCPRange xRange = ui->graphingView->xAxis->range();
+    QCPRange yRange = ui->graphingView->yAxis->range();
+    double xlo = std::max(xRange.lower, xminval);
+    double xhi = std::min(xRange.upper, xmaxval);
+    double ylo = std::max(std::floor(yRange.lower), yminval);
+    double yhi = std::min(std::floor(yRange.upper), ymaxval) + 1; //IDs are whole numbers, each one is [id, id + 1)
 
-    int ySize = static_cast<int>(ymaxval - yminval) / 30 + 1;
-    int xSize = static_cast<int>((xmaxval - xminval) * 4.0) + 1;
-    colorMap->data()->setSize(xSize, ySize);
-    colorMap->data()->setRange(QCPRange(xminval, xmaxval), QCPRange(yminval, ymaxval));
-    for (int x = 0; x < xSize; ++x)
+    if (xhi <= xlo || yhi <= ylo) //nothing of the data in view
     {
-      for (int y = 0; y < ySize; ++y)
-      {
-        colorMap->data()->setAlpha(x, y, 180);
-        colorMap->data()->setCell(x, y, 0.0);
-      }
+        binCounts.clear();
+        binCols = binRows = 0;
+        colorMap->setVisible(false);
+        ui->graphingView->replot();
+        return;
     }
-
-    for (int i = 0; i < frameCount; i++)
+    colorMap->setVisible(true);
+
+    QRect rect = ui->graphingView->axisRect()->rect();
+    //the clipped span only gets part of the plot width so size cells by the part it actually covers
+    int width = static_cast<int>(rect.width() * (xhi - xlo) / std::max(xRange.size(), 1e-12));
+    int height = static_cast<int>(rect.height() * (yhi - ylo) / std::max(yRange.size(), 1e-12));
+    binCols = std::max(2, width / TEMPORAL_PIXELS_PER_BIN);
+    binRows = std::max(2, height / TEMPORAL_PIXELS_PER_BIN);
+    if (binRows > yhi - ylo) binRows = static_cast<int>(yhi - ylo); //no point splitting an ID across cells
+    if (binRows < 1) binRows = 1;
+    binX0 = xlo;
+    binXScale = binCols / (xhi - xlo);
+    binY0 = ylo;
+    binYScale = binRows / (yhi - ylo);
+    binCounts.fill(0, binCols * binRows);
+
+    int firstRow = modelFrames->lastRowAtTime(static_cast<uint64_t>(std::max(0.0, xlo * 1000000.0)));
+    int lastRow = modelFrames->lastRowAtTime(static_cast<uint64_t>(std::ceil(xhi * 1000000.0)));
+    if (firstRow < 0) firstRow = 0;
+    if (lastRow >= firstRow)
     {
-        int x = static_cast<int>(((modelFrames->at(i).timeStamp().microSeconds() / 1000000.0) - xminval) * 4.0);
-        int y = static_cast<int>(modelFrames->at(i).frameId() - yminval) / 30;
-        double val = colorMap->data()->cell(x, y);
-        double inc;
-        inc = 1 / (val + 1); //logarithmic decay
-        inc = inc * inc; //square the increment to make it even more stark
-        val = val + inc;
-        qDebug() << "X: " << x << " Y: " << y << "Val: " << val;
-        colorMap->data()->setCell(x, y, val);
+        int rows = lastRow - firstRow + 1;
+        int threads = std::max(1, QThread::idealThreadCount());
+        if (rows < TEMPORAL_PARALLEL_MIN || threads == 1) countFrames(firstRow, lastRow, binCounts.data());
+        else
+        {
+            QVector<QVector<quint32>> partials(threads);
+            QThreadPool pool;
+            pool.setMaxThreadCount(threads);
+            int chunk = (rows + threads - 1) / threads;
+            for (int t = 0; t < threads; t++)
+            {
+                int lo = firstRow + t * chunk;
+                int hi = std::min(lastRow, lo + chunk - 1);
+                if (lo > hi) break;
+                partials[t].fill(0, binCounts.count());
+                quint32 *counts = partials[t].data();
+                pool.start(new CountTask([this, lo, hi, counts]() { countFrames(lo, hi, counts); }));
+            }
+            pool.waitForDone();
+            for (int t = 0; t < threads; t++)
+            {
+                const QVector<quint32> &part = partials[t];
+                for (int c = 0; c < part.count(); c++) binCounts[c] += part[c];
+            }
+        }
     }
 
-    colorMap->setGradient(QCPColorGradient::gpJet);
-    colorMap->rescaleDataRange(true);
-    ui->graphingView->rescaleAxes();
+    //cell coordinates are centres, so the map's range is half a cell in from the edges of the binned area
+    double cellW = (xhi - xlo) / binCols;
+    double cellH = (yhi - ylo) / binRows;
+    QCPColorMapData *data = colorMap->data();
+    data->setSize(binCols, binRows);
+    data->setRange(QCPRange(xlo + cellW / 2, xhi - cellW / 2), QCPRange(ylo + cellH / 2, yhi - cellH / 2));
+    binMax = 0;
+    for (int c = 0; c < binCounts.count(); c++)
+    {
+        if (binCounts[c] > binMax) binMax = binCounts[c];
+        showCell(c);
+    }
+    colorMap->setDataRange(QCPRange(0.0, std::log1p(static_cast<double>(std::max(binMax, 1u)))));
     ui->graphingView->replot();
 }
 
+//records firstRow to lastRow into counts, which is binCols x binRows. Safe to run on several threads at once
+void TemporalGraphWindow::countFrames(int firstRow, int lastRow, quint32 *counts) const
+{
+    for (int i = firstRow; i <= lastRow; i++)
+    {
+        int bin = binOf(modelFrames->record(i));
+        if (bin >= 0) counts[bin]++;
+    }
+}
+
+//which cell of the current binning a frame goes in or -1 if it's outside of it
+int TemporalGraphWindow::binOf(const CANFrameRecord &rec) const
+{
+    if (binCols <= 0 || binRows <= 0) return -1;
+    double col = (rec.timestamp / 1000000.0 - binX0) * binXScale;
+    double row = (rec.frameId() - binY0) * binYScale;
+    if (col < 0.0 || row < 0.0) return -1;
+    int c = static_cast<int>(col);
+    int r = static_cast<int>(row);
+    if (c == binCols && col == binCols) c--; //frame sitting right on the far edge
+    if (c >= binCols || r >= binRows) return -1;
+    return r * binCols + c;
+}
+
+//push one count into the colour map. Log scaled so a few chatty IDs don't wash everything else out
+void TemporalGraphWindow::showCell(int bin)
+{
+    int col = bin % binCols;
+    int row = bin / binCols;
+    quint32 count = binCounts[bin];
+    colorMap->data()->setCell(col, row, std::log1p(static_cast<double>(count)));
+    colorMap->data()->setAlpha(col, row, count ? 255 : 0);
+}
+
 void TemporalGraphWindow::selectionChanged()
 {
   /*
@@ -360,7 +471,7 @@ bool TemporalGraphWindow::eventFilter(QObject *obj, QEvent *event)
 void TemporalGraphWindow::resetView()
 {
     ui->graphingView->xAxis->setRange(xminval, xmaxval);
-    ui->graphingView->yAxis->setRange(yminval, ymaxval);
+    ui->graphingView->yAxis->setRange(yminval, ymaxval + 1);
     ui->graphingView->axisRect()->setupFullAxesBox();
 
     ui->graphingView->replot();
@@ -2,8 +2,10 @@
 #define TEMPORALGRAPHWINDOW_H
 
 #include <QDialog>
+#include <QTimer>
 #include "qcustomplot.h"
 #include "can_structs.h"
+#include "canframestore.h"
 
 namespace Ui {
 class TemporalGraphWindow;
@@ -14,12 +16,22 @@ class HexTicker : public QCPAxisTicker
     QString getTickLabel (double tick, const QLocale& locale, QChar formatChar, int precision);
 };
 
+//screen pixels per density cell along each axis
+#define TEMPORAL_PIXELS_PER_BIN     2
+
+/*
+ * Frame density over time and ID. Instead of a point per frame the visible area gets cut into cells a couple of
+ * pixels across and each cell is coloured by how many frames landed in it (log scaled, empty cells are clear).
+ * The binning is redone whenever the view settles after a zoom or pan and only looks at the frames inside the
+ * visible time span, counted in parallel. So the cost follows the screen size and how much is in view rather than
+ * how big the capture is. New frames just get added to the cells they land in.
+ */
 class TemporalGraphWindow : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit TemporalGraphWindow(const QVector<CANFrame> *, QWidget *parent = nullptr);
+    explicit TemporalGraphWindow(const CANFrameStore *, QWidget *parent = nullptr);
     ~TemporalGraphWindow();
     void showEvent(QShowEvent*);
 
@@ -31,19 +43,29 @@ private slots:
     void zoomIn();
     void zoomOut();
     void selectionChanged();
+    void rebin();
 
 private:
     Ui::TemporalGraphWindow *ui;    
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     bool useOpenGL;
     bool followGraphEnd;
-    QCPGraph *graph;
+    QCPColorMap *colorMap;
+    QTimer rebinTimer; //restarted by every range change so dragging doesn't rebin on each mouse move
     double xminval, xmaxval, yminval, ymaxval;
+    //the binning currently shown. cell = (value - origin) * scale
+    QVector<quint32> binCounts;
+    int binCols, binRows;
+    double binX0, binXScale, binY0, binYScale;
+    quint32 binMax;
     void closeEvent(QCloseEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
     void readSettings();
     void writeSettings();
     void generateGraph();
+    void countFrames(int firstRow, int lastRow, quint32 *counts) const;
+    int binOf(const CANFrameRecord &rec) const;
+    void showCell(int bin);
 
 };
 
@@ -5,6 +5,12 @@
 #include "bus_protocols/uds_handler.h"
 #include "utility.h"
 #include "helpwindow.h"
+#include "pipelinetrace.h"
+
+#include <cmath>
+
+//how long an ECU that answered "response pending" gets for the real reply (P2* of ISO 14229-2)
+#define UDS_PENDING_TIMEOUT 5000
 
 
 static QVector<QString> SCANTYPE_NAMES = {
@@ -23,7 +29,7 @@ static QVector<QString> SCANTYPE_NAMES = {
     QString("Custom UDS"),
 };
 
-UDSScanWindow::UDSScanWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+UDSScanWindow::UDSScanWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::UDSScanWindow)
 {
@@ -33,6 +39,10 @@ UDSScanWindow::UDSScanWindow(const QVector<CANFrame> *frames, QWidget *parent) :
     modelFrames = frames;
 
     currentlyRunning = false;
+    pipelined = false;
+    outstanding = 0;
+    completed = 0;
+    nextTarget = 0;
 
     waitTimer = new QTimer;
     waitTimer->setInterval(100);
@@ -74,6 +84,14 @@ UDSScanWindow::UDSScanWindow(const QVector<CANFrame> *frames, QWidget *parent) :
     connect(ui->spinReplyOffset, SIGNAL(valueChanged(int)), this, SLOT(setReplyOffset()));
     connect(ui->cbSessType, &QComboBox::currentTextChanged, this, &UDSScanWindow::setSessType);
 
+    QSettings settings;
+    ui->spinParallel->setValue(settings.value("UDSScan/ParallelRequests", 1).toInt());
+    ui->ckAdaptiveTimeout->setChecked(settings.value("UDSScan/AdaptiveTimeouts", true).toBool());
+    maxOutstanding = ui->spinParallel->value();
+    ui->ckAdaptiveTimeout->setEnabled(maxOutstanding > 1);
+    connect(ui->spinParallel, SIGNAL(valueChanged(int)), this, SLOT(setParallel()));
+    connect(ui->ckAdaptiveTimeout, &QCheckBox::toggled, this, &UDSScanWindow::setParallel);
+
 //not handling show no reply, max reply delay, reply offset, increment
     int numBuses = CANConManager::getInstance()->getNumBuses();
     for (int n = 0; n < numBuses; n++) ui->cbBuses->addItem(QString::number(n));
@@ -355,6 +373,15 @@ void UDSScanWindow::adaptiveToggled()
     if (currEditEntry) currEditEntry->bAdaptiveOffset = ui->cbAllowAdaptiveOffset->isChecked();
 }
 
+void UDSScanWindow::setParallel()
+{
+    maxOutstanding = ui->spinParallel->value();
+    ui->ckAdaptiveTimeout->setEnabled(maxOutstanding > 1);
+    QSettings settings;
+    settings.setValue("UDSScan/ParallelRequests", maxOutstanding);
+    settings.setValue("UDSScan/AdaptiveTimeouts", ui->ckAdaptiveTimeout->isChecked());
+}
+
 void UDSScanWindow::setSessType()
 {
     if (inhibitUpdates) return;
@@ -562,15 +589,17 @@ void UDSScanWindow::dumpNode(QTreeWidgetItem* item, QFile *file, int indent)
     if (indent == 1) file->write("\n");
 }
 
-void UDSScanWindow::sendOnBuses(UDS_MESSAGE test, int buses)
+void UDSScanWindow::sendOnBuses(UDS_MESSAGE test, int scanIdx)
 {
-    test.bus = buses;
+    test.bus = scanEntries[scanIdx].busToScan;
     sendingFrames.append(test);
+    sendingScan.append(scanIdx);
 }
 
 void UDSScanWindow::scanAll()
 {
     sendingFrames.clear();
+    sendingScan.clear();
     for (int i = 0; i < scanEntries.count(); i++)
     {
         setupScan(i);
@@ -581,6 +610,7 @@ void UDSScanWindow::scanAll()
 void UDSScanWindow::scanSelected()
 {
     sendingFrames.clear();
+    sendingScan.clear();
     int idx = ui->listScansToRun->currentRow();
     if (idx < 0) return;
     setupScan(idx);
@@ -598,20 +628,178 @@ void UDSScanWindow::startScan()
     waitTimer->setInterval(ui->spinDelay->value());
 
     ui->treeResults->clear();
+    idNodes.clear();
     nodeService = nullptr;
     nodeID = nullptr;
     nodeSubFunc = nullptr;
 
-    waitTimer->start();
-    currIdx = -1;
     currentlyRunning = true;
     //ui->btnScan->setText("Abort Scan");
     ui->progressBar->setValue(0);
     ui->progressBar->setMaximum(sendingFrames.length());
     qDebug() << "Number of operations: " << sendingFrames.length();
+
+    if (maxOutstanding > 1)
+    {
+        startPipeline();
+        return;
+    }
+    pipelined = false;
+    waitTimer->start();
+    currIdx = -1;
     sendNextMsg();
 }
 
+/*
+ * Pipelined scan. Requests are grouped by the ID they go to and every ID works through its own list, up to
+ * maxOutstanding of them waiting on a reply at once. waitTimer turns into a fast tick that checks the deadlines,
+ * each of which is the scan's maximum reply delay, or with adaptive timeouts a few deviations over how fast that
+ * ID has been answering.
+ */
+void UDSScanWindow::startPipeline()
+{
+    pipelined = true;
+    targets.clear();
+    targetByReply.clear();
+    udsHandler->clearFlowControlIDs();
+
+    QHash<quint64, int> targetIdx;
+    for (int i = 0; i < sendingFrames.count(); i++)
+    {
+        const UDS_MESSAGE &msg = sendingFrames[i];
+        quint64 key = (static_cast<quint64>(static_cast<quint32>(msg.bus)) << 32) | msg.frameId();
+        auto it = targetIdx.find(key);
+        if (it == targetIdx.end())
+        {
+            const ScanEntry &entry = scanEntries[sendingScan[i]];
+            ScanTarget target;
+            target.bus = msg.bus;
+            target.id = msg.frameId();
+            target.next = 0;
+            target.inFlight = -1;
+            target.sentAt = 0;
+            target.deadline = 0;
+            target.replyOffset = entry.idOffset;
+            target.offsetKnown = !entry.bAdaptiveOffset;
+            target.latency = 0.0;
+            target.latencyDev = 0.0;
+            target.samples = 0;
+            it = targetIdx.insert(key, targets.count());
+            targets.append(target);
+            if (target.offsetKnown)
+            {
+                uint32_t replyID = target.id + target.replyOffset;
+                targetByReply.insert((static_cast<quint64>(static_cast<quint32>(target.bus)) << 32) | replyID, it.value());
+                udsHandler->setFlowControlID(target.bus, replyID, target.id);
+            }
+        }
+        targets[it.value()].requests.append(i);
+    }
+
+    outstanding = 0;
+    completed = 0;
+    nextTarget = 0;
+    scanClock.start();
+    waitTimer->setTimerType(Qt::PreciseTimer);
+    waitTimer->setInterval(5);
+    waitTimer->start();
+    fillPipeline();
+}
+
+//sends requests, round robin over the IDs that aren't waiting on anything, until maxOutstanding are out
+void UDSScanWindow::fillPipeline()
+{
+    qint64 now = scanClock.elapsed();
+    int count = targets.count();
+    for (int tried = 0; tried < count && outstanding < maxOutstanding; tried++)
+    {
+        ScanTarget &target = targets[nextTarget];
+        nextTarget = (nextTarget + 1) % count;
+        if (target.inFlight != -1 || target.next >= target.requests.count()) continue;
+
+        target.inFlight = target.requests[target.next++];
+        target.sentAt = now;
+        target.deadline = now + requestTimeout(target);
+        outstanding++;
+        udsHandler->sendUDSFrame(sendingFrames[target.inFlight]);
+    }
+    if (outstanding == 0) finishScan();
+}
+
+int UDSScanWindow::requestTimeout(const ScanTarget &target) const
+{
+    int maxWait = static_cast<int>(scanEntries[sendingScan[target.inFlight]].maxWaitTime);
+    //a couple of replies before the average means anything
+    if (!ui->ckAdaptiveTimeout->isChecked() || target.samples < 3) return maxWait;
+    int adaptive = static_cast<int>(target.latency + 4.0 * target.latencyDev) + 10;
+    return qBound(10, adaptive, maxWait);
+}
+
+void UDSScanWindow::finishRequest(ScanTarget &target)
+{
+    target.inFlight = -1;
+    outstanding--;
+    completed++;
+    ui->progressBar->setValue(completed);
+}
+
+bool UDSScanWindow::isReplyTo(const UDS_MESSAGE &msg, const UDS_MESSAGE &sent)
+{
+    if (msg.isErrorReply) return msg.service == sent.service && msg.payload().length() > 0;
+    return msg.service == 0x40 + sent.service;
+}
+
+void UDSScanWindow::gotPipelinedReply(const UDS_MESSAGE &msg)
+{
+    qint64 now = scanClock.elapsed();
+    quint64 key = (static_cast<quint64>(static_cast<quint32>(msg.bus)) << 32) | msg.frameId();
+    int idx = targetByReply.value(key, -1);
+    if (idx == -1)
+    {
+        //an ID still learning its reply offset. The one asked the longest ago for this service is the best guess
+        for (int i = 0; i < targets.count(); i++)
+        {
+            const ScanTarget &target = targets[i];
+            if (target.offsetKnown || target.inFlight == -1 || target.bus != msg.bus) continue;
+            if (!isReplyTo(msg, sendingFrames[target.inFlight])) continue;
+            if (idx == -1 || target.sentAt < targets[idx].sentAt) idx = i;
+        }
+        if (idx == -1) return;
+        ScanTarget &target = targets[idx];
+        target.replyOffset = static_cast<int>(msg.frameId()) - static_cast<int>(target.id);
+        target.offsetKnown = true;
+        targetByReply.insert(key, idx);
+        udsHandler->setFlowControlID(target.bus, msg.frameId(), target.id);
+    }
+
+    ScanTarget &target = targets[idx];
+    if (target.inFlight == -1 || !isReplyTo(msg, sendingFrames[target.inFlight])) return;
+
+    if (msg.isErrorReply && static_cast<uint8_t>(msg.payload()[0]) == 0x78)
+    {
+        //response pending, the real answer is still coming
+        target.deadline = now + UDS_PENDING_TIMEOUT;
+        return;
+    }
+
+    double rtt = static_cast<double>(now - target.sentAt);
+    if (target.samples == 0)
+    {
+        target.latency = rtt;
+        target.latencyDev = rtt / 2.0;
+    }
+    else
+    {
+        target.latencyDev = 0.75 * target.latencyDev + 0.25 * std::fabs(target.latency - rtt);
+        target.latency = 0.875 * target.latency + 0.125 * rtt;
+    }
+    target.samples++;
+
+    showReply(target.inFlight, msg);
+    finishRequest(target);
+    fillPipeline();
+}
+
 void UDSScanWindow::stopScan()
 {
     waitTimer->stop();
@@ -619,6 +807,11 @@ void UDSScanWindow::stopScan()
     udsHandler->setReception(false);
     udsHandler->setProcessAllIDs(false);
     udsHandler->setFlowCtrl(false);
+    udsHandler->clearFlowControlIDs();
+    targets.clear();
+    targetByReply.clear();
+    outstanding = 0;
+    pipelined = false;
     currentlyRunning = false;
     //ui->btnScan->setText("Start Scan");
 }
@@ -639,7 +832,7 @@ void UDSScanWindow::setupScan(int idx)
             test.service = UDS_SERVICES::DIAG_CONTROL;
             test.subFuncLen = 1;
             test.subFunc = scanEntries[ idx].sessType;
-            sendOnBuses(test, scanEntries[idx].busToScan);
+            sendOnBuses(test, idx);
         }
 
         test.payload().clear();
@@ -652,7 +845,7 @@ void UDSScanWindow::setupScan(int idx)
             test.service = UDS_SERVICES::TESTER_PRESENT;
             test.subFuncLen = 1;
             test.subFunc = 0;
-            sendOnBuses(test, scanEntries[idx].busToScan);
+            sendOnBuses(test, idx);
             break;
         case ST_SESS_CTRL:
             for (int typ = 1; typ < 4; typ++) //try each type of session access
@@ -660,14 +853,14 @@ void UDSScanWindow::setupScan(int idx)
                 test.service = UDS_SERVICES::DIAG_CONTROL;
                 test.subFuncLen = 1;
                 test.subFunc = typ;
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_COMM_CTRL:
             test.service = UDS_SERVICES::COMM_CTRL;
             test.subFuncLen = 2; //need two bytes for this one
             test.subFunc = 0x100; //00 01 on the bus = enable Rx/Tx
-            sendOnBuses(test, scanEntries[idx].busToScan);
+            sendOnBuses(test, idx);
             break;
         case ST_ECU_RESET:
             for (int typ = 1; typ < 4; typ++) //try each type of session access
@@ -675,20 +868,20 @@ void UDSScanWindow::setupScan(int idx)
                 test.service = UDS_SERVICES::ECU_RESET;
                 test.subFuncLen = 1;
                 test.subFunc = typ;
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_CLEAR_DTC:
             test.service = UDS_SERVICES::CLEAR_DIAG;
             test.subFuncLen = 3; //DTC groups are sent as 3 bytes
             test.subFunc = 0xFFFFFF; //clear everything!
-            sendOnBuses(test, scanEntries[idx].busToScan);
+            sendOnBuses(test, idx);
             break;
         case ST_READ_DTC:
             test.service = UDS_SERVICES::READ_DTC;
             test.subFuncLen = 2;
             test.subFunc = 0x02FF; //get DTCs by mask (FF is the mask)
-            sendOnBuses(test, scanEntries[idx].busToScan);
+            sendOnBuses(test, idx);
             break;
         case ST_SEC_ACCESS:
             for (int typ = 1; typ < 0x42; typ = typ + 2) //try each type of session access. In practice only the first 1-3 are likely to work
@@ -696,7 +889,7 @@ void UDSScanWindow::setupScan(int idx)
                 test.service = UDS_SERVICES::SECURITY_ACCESS;
                 test.subFuncLen = 1;
                 test.subFunc = typ;
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_READ_ID:
@@ -705,7 +898,7 @@ void UDSScanWindow::setupScan(int idx)
             for (int subf = scanEntries[idx].subfunctLower; subf <= scanEntries[idx].subfunctUpper; subf += scanEntries[idx].subfunctIncrement)
             {
                 test.subFunc = subf;
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_READ_ADDR:
@@ -714,7 +907,7 @@ void UDSScanWindow::setupScan(int idx)
             for (int subf = scanEntries[idx].subfunctLower; subf <= scanEntries[idx].subfunctUpper; subf += scanEntries[idx].subfunctIncrement)
             {
                 test.subFunc = subf;
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_READ_SCALING:
@@ -724,7 +917,7 @@ void UDSScanWindow::setupScan(int idx)
             for (int subf = scanEntries[idx].subfunctLower; subf <= scanEntries[idx].subfunctUpper; subf += scanEntries[idx].subfunctIncrement)
             {
                 test.subFunc = subf;
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_IO_CTRL:
@@ -733,7 +926,7 @@ void UDSScanWindow::setupScan(int idx)
             for (int subf = scanEntries[idx].subfunctLower; subf <= scanEntries[idx].subfunctUpper; subf += scanEntries[idx].subfunctIncrement)
             {
                 test.subFunc = subf; //the upper byte will be 0 which is what we want. 0 = Return control to ECU
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_ROUTINE_CTRL:
@@ -745,7 +938,7 @@ void UDSScanWindow::setupScan(int idx)
                 //starting or stopping arbitrary routines is super dangerous. Don't do that unless you really know
                 //what the hell you're doing or something really crazy might happen.
                 test.subFunc = (subf << 8) + 3;
-                sendOnBuses(test, scanEntries[idx].busToScan);
+                sendOnBuses(test, idx);
             }
             break;
         case ST_CUSTOM:
@@ -757,7 +950,7 @@ void UDSScanWindow::setupScan(int idx)
                 for (int subTyp = scanEntries[idx].subfunctLower; subTyp <= scanEntries[idx].subfunctUpper; subTyp += scanEntries[idx].subfunctIncrement)
                 {
                     test.subFunc = subTyp;
-                    sendOnBuses(test, scanEntries[idx].busToScan);
+                    sendOnBuses(test, idx);
                 }
             }
             break;
@@ -768,6 +961,7 @@ void UDSScanWindow::setupScan(int idx)
 //Updates here are sent about every 1/4 second. That's fine for most windows but not this one.
 void UDSScanWindow::updatedFrames(int numFrames)
 {
+    TRACE_SCOPE("UDSScanWindow::updatedFrames");
     if (numFrames == -1) //all frames deleted. We don't care
     {
     }
@@ -781,14 +975,16 @@ void UDSScanWindow::updatedFrames(int numFrames)
 
 void UDSScanWindow::gotUDSReply(UDS_MESSAGE msg)
 {
-    QString result;
-    QString serviceShortName;
+    if (!currentlyRunning) return;
+    if (pipelined)
+    {
+        gotPipelinedReply(msg);
+        return;
+    }
+
     uint32_t id;
     int offset = ui->spinReplyOffset->value();
     UDS_MESSAGE sentFrame;
-    bool gotReply = false;
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(msg.payload().constData());
-    int dataLen = msg.payload().length();
 
     int numSending = sendingFrames.length();
     if (numSending == 0) return;
@@ -801,58 +997,61 @@ void UDSScanWindow::gotUDSReply(UDS_MESSAGE msg)
 
     if ((id == (uint32_t)(sentFrame.frameId() + offset)) || ui->cbAllowAdaptiveOffset->isChecked())
     {
-        serviceShortName = udsHandler->getServiceShortDesc(sentFrame.service);
-        if (serviceShortName.length() < 3) serviceShortName = QString::number(sentFrame.service, 16);
-        if (msg.service == (0x40 + sendingFrames[currIdx].service) )
+        if (isReplyTo(msg, sentFrame))
         {
-            setupNodes(id);
-
-            QTreeWidgetItem *nodePositive = new QTreeWidgetItem();
-            QString reply = "POSITIVE ";
-            for (int i = 0; i < dataLen; i++)
-            {
-                reply.append(" ");
-                reply.append(Utility::formatHexNum(data[i]));
-            }
-            nodePositive->setText(0, reply);
-            nodePositive->setForeground(0, QBrush(Qt::darkGreen));
-            nodeSubFunc->addChild(nodePositive);
-            nodeSubFunc->setForeground(0, QBrush(Qt::darkGreen));
-            gotReply = true;
+            showReply(currIdx, msg);
+            sendNextMsg();
         }
-        else if ( msg.isErrorReply && (msg.service == sendingFrames[currIdx].service) )
+    }
+}
+
+//adds the positive or negative reply msg to the results of request sendIdx
+void UDSScanWindow::showReply(int sendIdx, const UDS_MESSAGE &msg)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(msg.payload().constData());
+    int dataLen = msg.payload().length();
+
+    setupNodes(msg.frameId(), sendIdx);
+    if (!msg.isErrorReply)
+    {
+        QTreeWidgetItem *nodePositive = new QTreeWidgetItem();
+        QString reply = "POSITIVE ";
+        for (int i = 0; i < dataLen; i++)
         {
-            if (dataLen)
-            {
-                setupNodes(id);
-                QTreeWidgetItem *nodeNegative = new QTreeWidgetItem();
-                qDebug() << ui->spinNumBytes->value();
-                nodeNegative->setText(0, "NEGATIVE - " + udsHandler->getNegativeResponseShort(data[0]));
-                nodeNegative->setForeground(0, QBrush(Qt::darkRed));
-                nodeSubFunc->addChild(nodeNegative);
-                nodeSubFunc->setForeground(0, QBrush(Qt::darkRed));
-                gotReply = true;
-            }
+            reply.append(" ");
+            reply.append(Utility::formatHexNum(data[i]));
         }
+        nodePositive->setText(0, reply);
+        nodePositive->setForeground(0, QBrush(Qt::darkGreen));
+        nodeSubFunc->addChild(nodePositive);
+        nodeSubFunc->setForeground(0, QBrush(Qt::darkGreen));
     }
-    if (gotReply)
+    else
     {
-        //ui->listResults->addItem(result);
-        sendNextMsg();
+        QTreeWidgetItem *nodeNegative = new QTreeWidgetItem();
+        nodeNegative->setText(0, "NEGATIVE - " + udsHandler->getNegativeResponseShort(data[0]));
+        nodeNegative->setForeground(0, QBrush(Qt::darkRed));
+        nodeSubFunc->addChild(nodeNegative);
+        nodeSubFunc->setForeground(0, QBrush(Qt::darkRed));
     }
 }
 
-void UDSScanWindow::setupNodes(uint32_t replyID)
+//finds or makes the ID, reply ID and service nodes of request sendIdx and adds its sub function under them
+void UDSScanWindow::setupNodes(uint32_t replyID, int sendIdx)
 {
-    QString serviceShortName = udsHandler->getServiceShortDesc(sendingFrames[currIdx].service);
-    if (serviceShortName.length() < 3) serviceShortName = QString::number(sendingFrames[currIdx].service, 16);
+    const UDS_MESSAGE &sent = sendingFrames[sendIdx];
+    QString serviceShortName = udsHandler->getServiceShortDesc(sent.service);
+    if (serviceShortName.length() < 3) serviceShortName = QString::number(sent.service, 16);
     QTreeWidgetItem *replyNode = nullptr;
 
-    if (!nodeID || nodeID->text(0) != Utility::formatHexNum(sendingFrames[currIdx].frameId()))
+    //a pipelined scan has results of several IDs coming in mixed together
+    nodeID = idNodes.value(sent.frameId(), nullptr);
+    if (!nodeID)
     {
         nodeID = new QTreeWidgetItem();
-        nodeID->setText(0, Utility::formatHexNum(sendingFrames[currIdx].frameId()));
+        nodeID->setText(0, Utility::formatHexNum(sent.frameId()));
         ui->treeResults->addTopLevelItem(nodeID);
+        idNodes.insert(sent.frameId(), nodeID);
         nodeService = nullptr;
     }
 
@@ -895,15 +1094,35 @@ void UDSScanWindow::setupNodes(uint32_t replyID)
     }
 
     nodeSubFunc = new QTreeWidgetItem();
-    nodeSubFunc->setText(0, Utility::formatHexNum(sendingFrames[currIdx].subFunc));
+    nodeSubFunc->setText(0, Utility::formatHexNum(sent.subFunc));
     nodeService->addChild(nodeSubFunc);
 }
 
 void UDSScanWindow::timeOut()
 {
+    if (pipelined)
+    {
+        //tick of the pipelined scan, everything past its deadline is done with
+        qint64 now = scanClock.elapsed();
+        bool freed = false;
+        for (ScanTarget &target : targets)
+        {
+            if (target.inFlight == -1 || now < target.deadline) continue;
+            if (ui->ckShowNoReply->isChecked())
+            {
+                setupNodes(0xDEAD5EA1, target.inFlight);
+                nodeSubFunc->setForeground(0, QBrush(Qt::gray));
+            }
+            finishRequest(target);
+            freed = true;
+        }
+        if (freed) fillPipeline();
+        return;
+    }
+
     if (ui->ckShowNoReply->isChecked())
     {
-        setupNodes(0xDEAD5EA1);
+        setupNodes(0xDEAD5EA1, currIdx);
         nodeSubFunc->setForeground(0, QBrush(Qt::gray));
     }
 
@@ -918,14 +1137,19 @@ void UDSScanWindow::sendNextMsg()
         udsHandler->sendUDSFrame(sendingFrames[currIdx]);
         waitTimer->start();
     }
-    else
-    {
-        waitTimer->stop();
-        udsHandler->setReception(false);
-        udsHandler->setProcessAllIDs(false);
-        udsHandler->setFlowCtrl(false);
-        //ui->btnScan->setText("Start Scan");
-        currentlyRunning = false;
-    }
+    else finishScan();
     ui->progressBar->setValue(currIdx);
 }
+
+void UDSScanWindow::finishScan()
+{
+    waitTimer->stop();
+    waitTimer->setTimerType(Qt::CoarseTimer);
+    udsHandler->setReception(false);
+    udsHandler->setProcessAllIDs(false);
+    udsHandler->setFlowCtrl(false);
+    udsHandler->clearFlowControlIDs();
+    pipelined = false;
+    //ui->btnScan->setText("Start Scan");
+    currentlyRunning = false;
+}
@@ -2,10 +2,12 @@
 #define UDSSCANWINDOW_H
 
 #include "can_structs.h"
+#include "canframestore.h"
 #include "connections/canconnection.h"
 #include "bus_protocols/uds_handler.h"
 
 #include <QDialog>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QTreeWidget>
 
@@ -47,6 +49,26 @@ public:
     uint32_t serviceUpper;
 };
 
+/*
+ * One ID being scanned in the pipelined mode. Its requests go out one at a time and in order, so a session change
+ * still comes before the tests that need it, but any number of IDs can each have one waiting for a reply.
+ */
+struct ScanTarget
+{
+    int bus;
+    uint32_t id;
+    QVector<int> requests; //indexes into sendingFrames
+    int next; //into requests
+    int inFlight; //index into sendingFrames waiting on a reply, -1 for none
+    qint64 sentAt; //scanClock milliseconds
+    qint64 deadline;
+    int replyOffset;
+    bool offsetKnown; //false until the first reply shows which ID answers, with adaptive offset
+    double latency; //smoothed reply time and its variation, for the adaptive timeout
+    double latencyDev;
+    int samples;
+};
+
 namespace Ui {
 class UDSScanWindow;
 }
@@ -56,7 +78,7 @@ class UDSScanWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit UDSScanWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit UDSScanWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~UDSScanWindow();
 
 private slots:
@@ -66,6 +88,7 @@ private slots:
     void scanSelected();
     void saveResults();
     void timeOut();
+    void setParallel();
     void adaptiveToggled();
     void changedScanType();
     void numBytesChanged();
@@ -85,10 +108,20 @@ private slots:
 
 private:
     Ui::UDSScanWindow *ui;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
     UDS_HANDLER *udsHandler;
     QTimer *waitTimer;
     QList<UDS_MESSAGE> sendingFrames;
+    QVector<int> sendingScan; //which scan entry each of sendingFrames came from
+    QHash<uint32_t, QTreeWidgetItem *> idNodes; //top level result node of each ID sent to
+    bool pipelined; //more than one request out at a time
+    int maxOutstanding;
+    QVector<ScanTarget> targets;
+    QHash<quint64, int> targetByReply; //bus and reply ID -> targets
+    int outstanding;
+    int completed;
+    int nextTarget; //round robin start for the next request
+    QElapsedTimer scanClock;
     QTreeWidgetItem *nodeID;
     QTreeWidgetItem *nodeService;
     QTreeWidgetItem *nodeSubFunc;
@@ -104,8 +137,16 @@ private:
     void startScan();
     void stopScan();
     void sendNextMsg();
-    void sendOnBuses(UDS_MESSAGE frame, int buses);
-    void setupNodes(uint32_t replyID);
+    void finishScan();
+    void startPipeline();
+    void fillPipeline();
+    void gotPipelinedReply(const UDS_MESSAGE &msg);
+    void finishRequest(ScanTarget &target);
+    int requestTimeout(const ScanTarget &target) const;
+    static bool isReplyTo(const UDS_MESSAGE &msg, const UDS_MESSAGE &sent);
+    void showReply(int sendIdx, const UDS_MESSAGE &msg);
+    void sendOnBuses(UDS_MESSAGE frame, int scanIdx);
+    void setupNodes(uint32_t replyID, int sendIdx);
     void dumpNode(QTreeWidgetItem* item, QFile *file, int indent);
     bool eventFilter(QObject *obj, QEvent *event);
 
@@ -0,0 +1,355 @@
+#include "restbusengine.h"
+#include "connections/canconmanager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+//DBC message attributes the counters and checksums window writes, see CounterChecksumWindow
+#define COUNTER_ATTRIBUTE           "CounterSpec"
+#define CHECKSUM_ATTRIBUTE          "ChecksumSpec"
+
+namespace
+{
+//a message's own value of an attribute, or the file's default for it. Invalid if the file doesn't define it at all
+QVariant attributeValue(DBCFile *file, DBC_MESSAGE *msg, const QString &name)
+{
+    DBC_ATTRIBUTE_VALUE *val = msg->findAttrValByName(name);
+    if (val) return val->value;
+    DBC_ATTRIBUTE *attr = file->findAttributeByName(name, ATTR_TYPE_MESSAGE);
+    if (attr) return attr->defaultValue;
+    return QVariant();
+}
+
+//all the cyclic send types have Cyclic in their name. No send type at all goes by the cycle time alone
+bool isCyclic(DBCFile *file, DBC_MESSAGE *msg)
+{
+    QVariant value = attributeValue(file, msg, "GenMsgSendType");
+    if (!value.isValid()) return true;
+    QString name = value.toString();
+    bool isIndex;
+    int idx = name.toInt(&isIndex);
+    if (isIndex)
+    {
+        DBC_ATTRIBUTE *attr = file->findAttributeByName("GenMsgSendType", ATTR_TYPE_MESSAGE);
+        if (!attr || idx < 0 || idx >= attr->enumVals.count()) return idx == 0; //Cyclic comes first in the usual list
+        name = attr->enumVals[idx];
+    }
+    return name.contains("Cyclic", Qt::CaseInsensitive);
+}
+}
+
+RestbusEngine *RestbusEngine::getReference()
+{
+    static RestbusEngine *instance = nullptr;
+    if (!instance) instance = new RestbusEngine();
+    return instance;
+}
+
+RestbusEngine::RestbusEngine() :
+    thread(nullptr),
+    stopping(0),
+    running(0)
+{
+}
+
+RestbusEngine::~RestbusEngine()
+{
+    stop();
+}
+
+bool RestbusEngine::start(const QVector<RestbusNodeRef> &nodes, int bus)
+{
+    stop();
+
+    QMutexLocker locker(&lock);
+    messages.clear();
+    heap.clear();
+    pendingSends.clear();
+    messageByName.clear();
+
+    DBCHandler *dbc = DBCHandler::getReference();
+    for (int f = 0; f < dbc->getFileCount(); f++)
+    {
+        DBCFile *file = dbc->getFileByIdx(f);
+        QStringList names;
+        for (const RestbusNodeRef &ref : nodes)
+        {
+            if (ref.file == file->getFilename()) names.append(ref.node);
+        }
+        if (names.isEmpty()) continue;
+
+        DBCMessageHandler *handler = file->messageHandler;
+        for (int m = 0; m < handler->getCount(); m++)
+        {
+            DBC_MESSAGE *msg = handler->findMsgByIdx(m);
+            if (msg && msg->sender && names.contains(msg->sender->name)) addMessage(file, msg, bus);
+        }
+    }
+    if (messages.isEmpty()) return false;
+
+    for (int i = 0; i < messages.count(); i++)
+    {
+        Message &msg = messages[i];
+        if (msg.cycleMs > 0) heap.append({msg.startDelayUs, i});
+        else
+        {
+            msg.pending = true;
+            pendingSends.append(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), std::greater<Due>());
+    clock.start();
+    locker.unlock();
+
+    stopping.storeRelease(0);
+    running.storeRelease(1);
+    thread = QThread::create([this]{ sendLoop(); });
+    thread->start(QThread::HighPriority);
+    emit runningChanged(true);
+    return true;
+}
+
+void RestbusEngine::stop()
+{
+    if (!thread) return;
+    stopping.storeRelease(1);
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+    running.storeRelease(0);
+    emit runningChanged(false);
+}
+
+bool RestbusEngine::isRunning() const
+{
+    return running.loadAcquire() != 0;
+}
+
+int RestbusEngine::cycleTimeMs(DBCFile *file, DBC_MESSAGE *msg)
+{
+    return isCyclic(file, msg) ? qMax(0, attributeValue(file, msg, "GenMsgCycleTime").toInt()) : 0;
+}
+
+//called with lock held, from start()
+void RestbusEngine::addMessage(DBCFile *file, DBC_MESSAGE *msg, int bus)
+{
+    Message out;
+    out.name = msg->name;
+    out.id = msg->ID & 0x1FFFFFFF;
+    out.extended = msg->extendedID || out.id > 0x7FF;
+    out.len = qBound(0, static_cast<int>(msg->len), 64);
+    if (bus >= 0) out.bus = bus;
+    else out.bus = (file->getAssocBus() >= 0) ? file->getAssocBus() : 0;
+    out.cycleMs = cycleTimeMs(file, msg);
+    out.startDelayUs = qMax(0, attributeValue(file, msg, "GenMsgStartDelayTime").toInt()) * 1000LL;
+
+    DBC_ATTRIBUTE_VALUE *counterSpec = msg->findAttrValByName(COUNTER_ATTRIBUTE);
+    DBC_ATTRIBUTE_VALUE *checksumSpec = msg->findAttrValByName(CHECKSUM_ATTRIBUTE);
+    if (counterSpec) out.fields += IntegrityField::parseSpecs(counterSpec->value.toString(), out.id, out.bus);
+    if (checksumSpec) out.fields += IntegrityField::parseSpecs(checksumSpec->value.toString(), out.id, out.bus);
+    bool specCounters = false;
+    for (const IntegrityField &field : out.fields) if (field.kind == INTEGRITY_COUNTER) specCounters = true;
+
+    DBC_ATTRIBUTE *startAttr = file->findAttributeByName("GenSigStartValue", ATTR_TYPE_SIG);
+    for (int s = 0; s < msg->sigHandler->getCount(); s++)
+    {
+        DBC_SIGNAL *sig = msg->sigHandler->findSignalByIdx(s);
+        if (!sig || sig->isMultiplexed || sig->valType == STRING) continue;
+        Signal state;
+        state.sig = *sig;
+        state.sig.prepare();
+        //the start value is a raw value, like the ones in the frame
+        DBC_ATTRIBUTE_VALUE *start = sig->findAttrValByName("GenSigStartValue");
+        double raw = start ? start->value.toDouble() : (startAttr ? startAttr->defaultValue.toDouble() : 0.0);
+        state.startValue = state.sig.physicalValue(static_cast<int64_t>(raw));
+        state.value = state.startValue;
+        state.overridden = false;
+        if (sig->max > sig->min)
+        {
+            state.low = sig->min;
+            state.high = sig->max;
+        }
+        else
+        {
+            //no range in the DBC, use what the raw bits can hold
+            double rawMax = std::ldexp(1.0, qMin(sig->signalSize, 52)) - 1.0;
+            state.low = sig->bias;
+            state.high = sig->bias + rawMax * sig->factor;
+        }
+        state.counter = !specCounters && sig->name.contains("counter", Qt::CaseInsensitive);
+        out.sigByName.insert(sig->name, out.sigs.count());
+        out.sigs.append(state);
+    }
+
+    messageByName.insert(out.name, messages.count());
+    messages.append(out);
+}
+
+//called with lock held. Signals first, then the counters and last the checksums so they cover everything else
+void RestbusEngine::makeFrame(Message &msg, CANFrame &frame)
+{
+    uint8_t data[64];
+    memset(data, 0, sizeof(data));
+    for (Signal &s : msg.sigs)
+    {
+        if (s.counter && !s.overridden)
+        {
+            quint64 range = static_cast<quint64>(qMax(1.0, s.high - s.low + 1.0));
+            s.value = s.low + static_cast<double>(msg.counter % range);
+        }
+        s.sig.encodeValue(s.value, data, msg.len);
+    }
+    for (const IntegrityField &field : msg.fields) field.apply(data, msg.len, msg.counter);
+    msg.counter++;
+
+    frame.setFrameType(QCanBusFrame::DataFrame);
+    frame.setExtendedFrameFormat(msg.extended);
+    frame.setFrameId(msg.id);
+    frame.setFlexibleDataRateFormat(msg.len > 8);
+    frame.setBitrateSwitch(msg.len > 8);
+    frame.bus = msg.bus;
+    frame.isReceived = false;
+    frame.setPayload(QByteArray(reinterpret_cast<const char *>(data), msg.len));
+}
+
+void RestbusEngine::sendLoop()
+{
+    QList<CANFrame> out;
+    while (!stopping.loadAcquire())
+    {
+        qint64 now = clock.nsecsElapsed() / 1000;
+        qint64 next = -1;
+        out.clear();
+        {
+            QMutexLocker locker(&lock);
+            for (int idx : pendingSends)
+            {
+                Message &msg = messages[idx];
+                msg.pending = false;
+                CANFrame frame;
+                makeFrame(msg, frame);
+                msg.sent++;
+                out.append(frame);
+            }
+            pendingSends.clear();
+
+            while (!heap.isEmpty() && heap.first().dueUs <= now)
+            {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<Due>());
+                Due due = heap.takeLast();
+                Message &msg = messages[due.message];
+                qint64 late = now - due.dueUs;
+                msg.maxLateUs = qMax(msg.maxLateUs, late);
+                msg.totalLateUs += late;
+                msg.sent++;
+                CANFrame frame;
+                makeFrame(msg, frame);
+                out.append(frame);
+
+                //once per pass at most. Something that fell a whole cycle behind goes on from now
+                qint64 cycleUs = msg.cycleMs * 1000LL;
+                due.dueUs += cycleUs;
+                if (due.dueUs <= now) due.dueUs = now + cycleUs;
+                heap.append(due);
+                std::push_heap(heap.begin(), heap.end(), std::greater<Due>());
+            }
+            if (!heap.isEmpty()) next = heap.first().dueUs;
+        }
+        if (!out.isEmpty()) CANConManager::getInstance()->sendFrames(out, TX_PERIODIC);
+
+        if (next < 0)
+        {
+            QThread::usleep(RESTBUS_IDLE_US);
+            continue;
+        }
+        qint64 wait = next - clock.nsecsElapsed() / 1000;
+        if (wait > RESTBUS_SPIN_US) QThread::usleep(static_cast<unsigned long>(qMin<qint64>(wait - RESTBUS_SPIN_US, RESTBUS_IDLE_US)));
+        else
+        {
+            //close enough that a sleep could overshoot it
+            while (clock.nsecsElapsed() / 1000 < next && !stopping.loadAcquire()) QThread::yieldCurrentThread();
+        }
+    }
+}
+
+bool RestbusEngine::findSignal(const QString &message, const QString &signal, int &msgIdx, int &sigIdx) const
+{
+    msgIdx = messageByName.value(message, -1);
+    if (msgIdx < 0) return false;
+    sigIdx = messages[msgIdx].sigByName.value(signal, -1);
+    return sigIdx >= 0;
+}
+
+//called with lock held. A message that isn't cyclic goes out with the new value straight away
+void RestbusEngine::setSignalState(int msgIdx, int sigIdx, double value, bool overridden)
+{
+    Message &msg = messages[msgIdx];
+    msg.sigs[sigIdx].value = value;
+    msg.sigs[sigIdx].overridden = overridden;
+    if (msg.cycleMs == 0 && !msg.pending)
+    {
+        msg.pending = true;
+        pendingSends.append(msgIdx);
+    }
+}
+
+bool RestbusEngine::setSignal(const QString &message, const QString &signal, double value)
+{
+    QMutexLocker locker(&lock);
+    int msgIdx, sigIdx;
+    if (!findSignal(message, signal, msgIdx, sigIdx)) return false;
+    setSignalState(msgIdx, sigIdx, value, true);
+    return true;
+}
+
+bool RestbusEngine::clearSignal(const QString &message, const QString &signal)
+{
+    QMutexLocker locker(&lock);
+    int msgIdx, sigIdx;
+    if (!findSignal(message, signal, msgIdx, sigIdx)) return false;
+    setSignalState(msgIdx, sigIdx, messages[msgIdx].sigs[sigIdx].startValue, false);
+    return true;
+}
+
+void RestbusEngine::clearAllSignals()
+{
+    QMutexLocker locker(&lock);
+    for (int m = 0; m < messages.count(); m++)
+    {
+        for (int s = 0; s < messages[m].sigs.count(); s++)
+        {
+            if (messages[m].sigs[s].overridden) setSignalState(m, s, messages[m].sigs[s].startValue, false);
+        }
+    }
+}
+
+bool RestbusEngine::signalValue(const QString &message, const QString &signal, double &value) const
+{
+    QMutexLocker locker(&lock);
+    int msgIdx, sigIdx;
+    if (!findSignal(message, signal, msgIdx, sigIdx)) return false;
+    value = messages[msgIdx].sigs[sigIdx].value;
+    return true;
+}
+
+QVector<RestbusMessageStats> RestbusEngine::stats() const
+{
+    QMutexLocker locker(&lock);
+    QVector<RestbusMessageStats> out;
+    out.reserve(messages.count());
+    for (const Message &msg : messages)
+        out.append({msg.name, msg.id, msg.bus, msg.cycleMs, msg.sent, msg.maxLateUs, msg.totalLateUs});
+    return out;
+}
+
+QVector<RestbusSignalState> RestbusEngine::signalStates(int message) const
+{
+    QMutexLocker locker(&lock);
+    QVector<RestbusSignalState> out;
+    if (message < 0 || message >= messages.count()) return out;
+    for (const Signal &s : messages[message].sigs)
+        out.append({s.sig.name, s.sig.unitName, s.value, s.overridden, s.counter && !s.overridden});
+    return out;
+}
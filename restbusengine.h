@@ -0,0 +1,153 @@
+#ifndef RESTBUSENGINE_H
+#define RESTBUSENGINE_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include "can_structs.h"
+#include "dbc/dbchandler.h"
+#include "re/integrityscan.h"
+
+//how long before a frame is due the send thread stops sleeping and watches the clock instead, in us
+#define RESTBUS_SPIN_US         300
+//longest the send thread sleeps in one go, so stopping and spontaneous sends don't wait long, in us
+#define RESTBUS_IDLE_US         2000
+
+//one node of one loaded DBC file whose messages the restbus sends
+struct RestbusNodeRef
+{
+    QString file; //DBCFile::getFilename()
+    QString node;
+};
+
+//how one message has been doing since the restbus started
+struct RestbusMessageStats
+{
+    QString name;
+    uint32_t id;
+    int bus;
+    int cycleMs;    //0 for messages that only go out when one of their signals is set
+    quint64 sent;
+    qint64 maxLateUs; //worst a frame went out after it was due
+    qint64 totalLateUs;
+};
+
+//one signal of a running message, for the window
+struct RestbusSignalState
+{
+    QString name;
+    QString unit;
+    double value;
+    bool overridden;
+    bool automatic; //a counter the restbus keeps going itself
+};
+
+/*
+ * Stands in for ECUs that aren't there. start() takes the messages the chosen nodes send out of the loaded DBC files
+ * and sends them on their own: cyclic ones (GenMsgSendType cyclic, or no send type, with a GenMsgCycleTime) every
+ * cycle, the rest once at the start and again whenever one of their signals is set. Signals start out at their
+ * GenSigStartValue. Overrides from the window or scripts replace a signal's value until cleared.
+ *
+ * Counters and checksums are filled in on every frame. The CounterSpec and ChecksumSpec attributes the counters and
+ * checksums window writes are used where a message has them, and signals with counter in the name count from their
+ * minimum to their maximum otherwise. Multiplexed signals aren't sent, which of them belongs in a frame is up to
+ * whoever sets the multiplexor.
+ *
+ * Everything is copied out of the DBC files when starting, so they can be edited or unloaded while it runs. The
+ * schedule is a min-heap of due times like the frame sender's, run by a thread of its own at high priority. It
+ * sleeps until shortly before the next frame is due and then watches the clock, so frames go out within a few
+ * microseconds of their time when the machine isn't busy. A message that fell a whole cycle behind starts over from
+ * now instead of catching up in a burst.
+ *
+ * Any thread. The messages are under one lock that's never held while sending.
+ */
+class RestbusEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    static RestbusEngine *getReference();
+    ~RestbusEngine();
+
+    //bus -1 sends each file's messages on the bus the file is associated with, bus 0 if it isn't. False if the
+    //nodes don't send anything
+    bool start(const QVector<RestbusNodeRef> &nodes, int bus);
+    void stop();
+    bool isRunning() const;
+
+    //false if no message of the last start() has that signal. Message names are as in the DBC file
+    bool setSignal(const QString &message, const QString &signal, double value);
+    bool clearSignal(const QString &message, const QString &signal);
+    void clearAllSignals();
+    bool signalValue(const QString &message, const QString &signal, double &value) const;
+
+    QVector<RestbusMessageStats> stats() const;
+    QVector<RestbusSignalState> signalStates(int message) const; //by position in stats()
+
+    //the cycle the file's attributes give the message (GenMsgSendType, GenMsgCycleTime), 0 if it isn't cyclic
+    static int cycleTimeMs(DBCFile *file, DBC_MESSAGE *msg);
+
+signals:
+    void runningChanged(bool running);
+
+private:
+    struct Signal
+    {
+        DBC_SIGNAL sig; //a copy, the DBC can change while we run
+        double startValue;
+        double value;
+        double low; //range a counter goes through
+        double high;
+        bool overridden;
+        bool counter;
+    };
+
+    struct Message
+    {
+        QString name;
+        uint32_t id;
+        bool extended;
+        int bus;
+        int len;
+        int cycleMs;
+        qint64 startDelayUs;
+        QVector<Signal> sigs;
+        QVector<IntegrityField> fields; //counters first, then checksums
+        QHash<QString, int> sigByName;
+        quint64 counter = 0;
+        bool pending = false; //in pendingSends
+        quint64 sent = 0;
+        qint64 maxLateUs = 0;
+        qint64 totalLateUs = 0;
+    };
+
+    struct Due
+    {
+        qint64 dueUs; //on clock
+        int message;
+        bool operator>(const Due &other) const { return dueUs > other.dueUs; }
+    };
+
+    RestbusEngine();
+    void sendLoop();
+    void makeFrame(Message &msg, CANFrame &frame);
+    bool findSignal(const QString &message, const QString &signal, int &msgIdx, int &sigIdx) const;
+    void setSignalState(int msgIdx, int sigIdx, double value, bool overridden);
+    void addMessage(DBCFile *file, DBC_MESSAGE *msg, int bus);
+
+    mutable QMutex lock;
+    QVector<Message> messages;
+    QVector<Due> heap; //cyclic messages
+    QVector<int> pendingSends; //spontaneous messages to go out as soon as the thread looks
+    QHash<QString, int> messageByName;
+    QElapsedTimer clock;
+    QThread *thread;
+    QAtomicInt stopping;
+    QAtomicInt running;
+};
+
+#endif // RESTBUSENGINE_H
@@ -0,0 +1,274 @@
+#include "restbuswindow.h"
+#include "ui_restbuswindow.h"
+#include "restbusengine.h"
+#include "utility.h"
+#include "helpwindow.h"
+#include "dbc/dbchandler.h"
+
+#include <QMessageBox>
+#include <QSettings>
+
+//how often the message stats and signal values get redrawn, in ms
+#define RESTBUS_REFRESH_MS      500
+
+//roles on the node list entries
+#define NODE_FILE_ROLE          Qt::UserRole
+#define NODE_NAME_ROLE          (Qt::UserRole + 1)
+
+RestbusWindow::RestbusWindow(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::RestbusWindow)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Window);
+    inhibitChanges = false;
+
+    QStringList headers;
+    headers << tr("Message") << tr("ID") << tr("Bus") << tr("Cycle (ms)") << tr("Sent") << tr("Worst Late (us)") << tr("Average Late (us)");
+    ui->tableMessages->setColumnCount(headers.count());
+    ui->tableMessages->setHorizontalHeaderLabels(headers);
+
+    headers.clear();
+    headers << tr("Override") << tr("Signal") << tr("Value") << tr("Unit");
+    ui->tableSignals->setColumnCount(headers.count());
+    ui->tableSignals->setHorizontalHeaderLabels(headers);
+
+    QSettings settings;
+    for (const QString &node : settings.value("Restbus/Nodes").toStringList()) checkedNodes.insert(node);
+
+    RestbusEngine *engine = RestbusEngine::getReference();
+    refreshTimer.setInterval(RESTBUS_REFRESH_MS);
+    connect(&refreshTimer, &QTimer::timeout, this, &RestbusWindow::refresh);
+    connect(engine, &RestbusEngine::runningChanged, this, &RestbusWindow::runningChanged);
+    connect(ui->btnRefreshNodes, &QPushButton::clicked, this, &RestbusWindow::refreshNodes);
+    connect(ui->btnStart, &QPushButton::clicked, this, &RestbusWindow::toggleRunning);
+    connect(ui->btnClearOverrides, &QPushButton::clicked, [=]()
+    {
+        RestbusEngine::getReference()->clearAllSignals();
+        refresh();
+    });
+    connect(ui->tableMessages, &QTableWidget::itemSelectionChanged, this, &RestbusWindow::messageSelected);
+    connect(ui->tableSignals, &QTableWidget::itemChanged, this, &RestbusWindow::signalChanged);
+    connect(ui->listNodes, &QListWidget::itemChanged, [=](QListWidgetItem *item)
+    {
+        if (item->checkState() == Qt::Checked) checkedNodes.insert(item->text());
+        else checkedNodes.remove(item->text());
+    });
+
+    refreshNodes();
+    runningChanged(engine->isRunning());
+}
+
+RestbusWindow::~RestbusWindow()
+{
+    delete ui;
+}
+
+void RestbusWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+
+    readSettings();
+    refresh();
+    refreshTimer.start();
+
+    installEventFilter(this);
+}
+
+void RestbusWindow::closeEvent(QCloseEvent *event)
+{
+    Q_UNUSED(event);
+    refreshTimer.stop();
+    removeEventFilter(this);
+    writeSettings();
+}
+
+bool RestbusWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("restbus.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+    return false;
+}
+
+void RestbusWindow::readSettings()
+{
+    QSettings settings;
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        resize(settings.value("RestbusView/WindowSize", QSize(950, 700)).toSize());
+        move(Utility::constrainedWindowPos(settings.value("RestbusView/WindowPos", QPoint(50, 50)).toPoint()));
+    }
+}
+
+void RestbusWindow::writeSettings()
+{
+    QSettings settings;
+    settings.setValue("Restbus/Nodes", QStringList(checkedNodes.values()));
+
+    if (settings.value("Main/SaveRestorePositions", false).toBool())
+    {
+        settings.setValue("RestbusView/WindowSize", size());
+        settings.setValue("RestbusView/WindowPos", pos());
+    }
+}
+
+//every node of every loaded DBC file, the ones checked before stay checked
+void RestbusWindow::refreshNodes()
+{
+    ui->listNodes->blockSignals(true);
+    ui->listNodes->clear();
+    DBCHandler *dbc = DBCHandler::getReference();
+    for (int f = 0; f < dbc->getFileCount(); f++)
+    {
+        DBCFile *file = dbc->getFileByIdx(f);
+        for (const DBC_NODE &node : file->dbc_nodes)
+        {
+            if (node.name == "Vector__XXX") continue; //the placeholder for nobody in particular
+            QListWidgetItem *item = new QListWidgetItem(file->getFilename() + ": " + node.name, ui->listNodes);
+            item->setData(NODE_FILE_ROLE, file->getFilename());
+            item->setData(NODE_NAME_ROLE, node.name);
+            item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+            item->setCheckState(checkedNodes.contains(item->text()) ? Qt::Checked : Qt::Unchecked);
+        }
+    }
+    ui->listNodes->blockSignals(false);
+}
+
+void RestbusWindow::toggleRunning()
+{
+    RestbusEngine *engine = RestbusEngine::getReference();
+    if (engine->isRunning())
+    {
+        engine->stop();
+        return;
+    }
+
+    QVector<RestbusNodeRef> nodes;
+    for (int i = 0; i < ui->listNodes->count(); i++)
+    {
+        QListWidgetItem *item = ui->listNodes->item(i);
+        if (item->checkState() == Qt::Checked)
+            nodes.append({item->data(NODE_FILE_ROLE).toString(), item->data(NODE_NAME_ROLE).toString()});
+    }
+    if (nodes.isEmpty())
+    {
+        QMessageBox::information(this, tr("Restbus"), tr("Check the nodes the restbus should send for first"));
+        return;
+    }
+    if (!engine->start(nodes, ui->spinBus->value()))
+    {
+        QMessageBox::information(this, tr("Restbus"), tr("None of the checked nodes send any messages"));
+        return;
+    }
+    ui->tableMessages->setRowCount(0);
+    refresh();
+    if (ui->tableMessages->rowCount() > 0) ui->tableMessages->selectRow(0);
+}
+
+void RestbusWindow::runningChanged(bool running)
+{
+    ui->btnStart->setText(running ? tr("Stop") : tr("Start"));
+    ui->listNodes->setEnabled(!running);
+    ui->spinBus->setEnabled(!running);
+    ui->btnRefreshNodes->setEnabled(!running);
+}
+
+void RestbusWindow::refresh()
+{
+    QVector<RestbusMessageStats> stats = RestbusEngine::getReference()->stats();
+    ui->tableMessages->setRowCount(stats.count());
+    for (int i = 0; i < stats.count(); i++)
+    {
+        const RestbusMessageStats &msg = stats[i];
+        Utility::setTableCell(ui->tableMessages, i, 0, msg.name);
+        Utility::setTableCell(ui->tableMessages, i, 1, Utility::formatCANID(msg.id));
+        Utility::setTableCell(ui->tableMessages, i, 2, QString::number(msg.bus));
+        Utility::setTableCell(ui->tableMessages, i, 3, msg.cycleMs ? QString::number(msg.cycleMs) : tr("On change"));
+        Utility::setTableCell(ui->tableMessages, i, 4, QString::number(msg.sent));
+        //spontaneous sends aren't on a schedule so they're not counted late
+        bool timed = msg.cycleMs && msg.sent;
+        Utility::setTableCell(ui->tableMessages, i, 5, timed ? QString::number(msg.maxLateUs) : QString("-"));
+        Utility::setTableCell(ui->tableMessages, i, 6, timed ? QString::number(msg.totalLateUs / static_cast<qint64>(msg.sent)) : QString("-"));
+    }
+    showSignals(false);
+}
+
+void RestbusWindow::messageSelected()
+{
+    showSignals(true);
+}
+
+bool RestbusWindow::isEditing() const
+{
+    return ui->tableSignals->state() == QAbstractItemView::EditingState;
+}
+
+//rebuild makes the rows over for a newly selected message. Otherwise only the values are updated
+void RestbusWindow::showSignals(bool rebuild)
+{
+    if (!rebuild && isEditing()) return; //don't yank the value out from under someone typing
+    int message = ui->tableMessages->currentRow();
+    QVector<RestbusSignalState> states = RestbusEngine::getReference()->signalStates(message);
+
+    inhibitChanges = true;
+    if (rebuild || ui->tableSignals->rowCount() != states.count())
+    {
+        ui->tableSignals->setRowCount(0);
+        ui->tableSignals->setRowCount(states.count());
+    }
+    for (int i = 0; i < states.count(); i++)
+    {
+        const RestbusSignalState &state = states[i];
+        QTableWidgetItem *check = ui->tableSignals->item(i, 0);
+        if (!check)
+        {
+            check = new QTableWidgetItem();
+            check->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+            ui->tableSignals->setItem(i, 0, check);
+        }
+        check->setCheckState(state.overridden ? Qt::Checked : Qt::Unchecked);
+        Utility::setTableCell(ui->tableSignals, i, 1, state.name);
+        Utility::setTableCell(ui->tableSignals, i, 2, state.automatic ? tr("%1 (counting)").arg(state.value) : QString::number(state.value));
+        Utility::setTableCell(ui->tableSignals, i, 3, state.unit);
+        ui->tableSignals->item(i, 1)->setFlags(Qt::ItemIsEnabled);
+        ui->tableSignals->item(i, 3)->setFlags(Qt::ItemIsEnabled);
+    }
+    inhibitChanges = false;
+}
+
+void RestbusWindow::signalChanged(QTableWidgetItem *item)
+{
+    if (inhibitChanges) return;
+    int message = ui->tableMessages->currentRow();
+    if (message < 0) return;
+    QString msgName = ui->tableMessages->item(message, 0)->text();
+    QTableWidgetItem *nameItem = ui->tableSignals->item(item->row(), 1);
+    QTableWidgetItem *valueItem = ui->tableSignals->item(item->row(), 2);
+    if (!nameItem || !valueItem) return;
+
+    RestbusEngine *engine = RestbusEngine::getReference();
+    if (item->column() == 0)
+    {
+        if (item->checkState() == Qt::Checked)
+            engine->setSignal(msgName, nameItem->text(), valueItem->text().section(' ', 0, 0).toDouble());
+        else engine->clearSignal(msgName, nameItem->text());
+    }
+    else if (item->column() == 2)
+    {
+        bool ok;
+        double value = item->text().toDouble(&ok);
+        if (ok) engine->setSignal(msgName, nameItem->text(), value);
+    }
+    showSignals(false);
+}
@@ -0,0 +1,50 @@
+#ifndef RESTBUSWINDOW_H
+#define RESTBUSWINDOW_H
+
+#include <QDialog>
+#include <QSet>
+#include <QTimer>
+
+class QTableWidgetItem;
+
+namespace Ui {
+class RestbusWindow;
+}
+
+/*
+ * Front end for RestbusEngine. Pick the nodes of the loaded DBC files to stand in for and start it, then watch how
+ * each message is keeping to its cycle and override signals. The engine keeps running when the window is closed,
+ * it's only stopped with the button or by starting it again.
+ */
+class RestbusWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit RestbusWindow(QWidget *parent = 0);
+    ~RestbusWindow();
+    void showEvent(QShowEvent*);
+
+private slots:
+    void refreshNodes();
+    void toggleRunning();
+    void runningChanged(bool running);
+    void refresh();
+    void messageSelected();
+    void signalChanged(QTableWidgetItem *item);
+
+private:
+    Ui::RestbusWindow *ui;
+    QTimer refreshTimer;
+    QSet<QString> checkedNodes; //"file: node", kept when the list is reloaded
+    bool inhibitChanges; //true while the signal table is being filled in
+
+    void showSignals(bool rebuild);
+    bool isEditing() const;
+    void closeEvent(QCloseEvent *event);
+    void readSettings();
+    void writeSettings();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // RESTBUSWINDOW_H
@@ -1,58 +1,202 @@
+#include <QCoreApplication>
 #include <QJSValueIterator>
 #include <QDebug>
+#include <QSemaphore>
+#include <cmath>
+#include <cstring>
 
 #include "scriptcontainer.h"
 #include "connections/canconmanager.h"
+#include "connections/liveframetable.h"
+#include "dbc/dbchandler.h"
+#include "framequery.h"
+#include "pipelinetrace.h"
+#include "restbusengine.h"
 
-ScriptContainer::ScriptContainer()
+namespace
 {
-    qDebug() << "Script Container Constructor";
-    scriptEngine = new QJSEngine();
-    canHelper = new CANScriptHelper(scriptEngine);
-    isoHelper = new ISOTPScriptHelper(scriptEngine);
-    udsHelper = new UDSScriptHelper(scriptEngine);
-    connect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
+//a typed array of the given kind over a copy of the bytes. One ArrayBuffer for the lot instead of a property per element
+QJSValue toTypedArray(QJSEngine *engine, const char *type, const QByteArray &bytes)
+{
+    QJSValue buffer = engine->toScriptValue(bytes);
+    return engine->globalObject().property(type).callAsConstructor(QJSValueList() << buffer);
 }
 
-ScriptContainer::~ScriptContainer()
+template <typename T>
+QJSValue toTypedArray(QJSEngine *engine, const char *type, const QVector<T> &values)
 {
-    qDebug() << "Script Container Destructor " << (uint64_t)this << "c: " << (uint64_t)canHelper;
-    timer.stop();
-    disconnect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
-    if (scriptEngine)
+    return toTypedArray(engine, type, QByteArray(reinterpret_cast<const char *>(values.constData()), values.size() * static_cast<int>(sizeof(T))));
+}
+
+QJSValue toByteView(QJSEngine *engine, const QByteArray &bytes)
+{
+    return toTypedArray(engine, "Uint8Array", bytes);
+}
+
+bool isTypedArray(const QJSValue &value)
+{
+    return value.isObject() && value.hasProperty("BYTES_PER_ELEMENT") && value.property("buffer").isObject();
+}
+
+//raw bytes of a typed array (only the part it looks at), an ArrayBuffer or a plain array of numbers
+QByteArray bytesFromJS(const QJSValue &value)
+{
+    if (value.isArray())
     {
-        scriptText = "";
-        compileScript();
-        //delete scriptEngine;   //doing this here seems to cause a crash. No crash if you don't.
-        //scriptEngine = nullptr;
+        int len = value.property("length").toInt();
+        QByteArray bytes(len, 0);
+        for (int i = 0; i < len; i++) bytes[i] = static_cast<char>(value.property(static_cast<quint32>(i)).toInt());
+        return bytes;
     }
-    if (canHelper)
+    if (isTypedArray(value))
     {
-        delete canHelper;
-        canHelper = nullptr;
+        QByteArray whole = value.property("buffer").toVariant().toByteArray();
+        return whole.mid(value.property("byteOffset").toInt(), value.property("byteLength").toInt());
     }
-    if (isoHelper)
+    QVariant var = value.toVariant();
+    if (var.userType() == QMetaType::QByteArray) return var.toByteArray();
+    return QByteArray();
+}
+
+//the payload a script handed over, cut or zero padded to the length it asked for
+QByteArray payloadFromJS(const QJSValue &value, int length)
+{
+    if (!value.isArray() && !value.isObject()) qDebug() << "data isn't an array";
+    QByteArray bytes = bytesFromJS(value);
+    bytes.resize(qMax(length, 0));
+    return bytes;
+}
+
+//one number column of a batch. 32 bit integer typed arrays are copied straight out, anything else is read element
+//by element, and a plain number is used for every row
+QVector<quint32> columnFromJS(const QJSValue &value, int count)
+{
+    QVector<quint32> column(count, 0);
+    if (value.isNumber())
     {
-        delete isoHelper;
-        isoHelper = nullptr;
+        column.fill(value.toUInt());
+        return column;
     }
-    if (udsHelper)
+    if (isTypedArray(value))
     {
-        delete udsHelper;
-        udsHelper = nullptr;
+        QString type = value.property("constructor").property("name").toString();
+        if (type == "Uint32Array" || type == "Int32Array")
+        {
+            QByteArray bytes = bytesFromJS(value);
+            memcpy(column.data(), bytes.constData(), static_cast<size_t>(qMin(bytes.length(), count * 4)));
+            return column;
+        }
     }
+    int len = qMin(value.property("length").toInt(), count);
+    for (int i = 0; i < len; i++) column[i] = value.property(static_cast<quint32>(i)).toUInt();
+    return column;
+}
+}
+
+ScriptContainer::ScriptContainer()
+{
+    qDebug() << "Script Container Constructor";
+    scriptEngine = nullptr;
+    timer = nullptr;
+    window = nullptr;
+    canHelper = nullptr;
+    isoHelper = nullptr;
+    udsHelper = nullptr;
+    j1939Helper = nullptr;
+    dbcHelper = nullptr;
+    restbusHelper = nullptr;
+    queryHelper = nullptr;
+    tickIntervalUs = 0;
+    nextTickUs = 0;
+    lastTickUs = 0;
+    preciseTicks = false;
+
+    worker = new QThread();
+    worker->setObjectName("ScriptContainer");
+    moveToThread(worker);
+    worker->start();
+    //the engine has to be made on the thread that runs it, as do the helpers and their protocol handlers
+    QMetaObject::invokeMethod(this, [this]() { setupEngine(); }, Qt::BlockingQueuedConnection);
+}
+
+ScriptContainer::~ScriptContainer()
+{
+    qDebug() << "Script Container Destructor " << (uint64_t)this << "c: " << (uint64_t)canHelper;
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
+    //a script stuck in a loop would never get to the teardown otherwise
+    if (scriptEngine) scriptEngine->setInterrupted(true);
+#endif
+    if (thread() == worker) QMetaObject::invokeMethod(this, [this]() { teardown(); }, Qt::BlockingQueuedConnection);
+    worker->quit();
+    worker->wait();
+    delete worker;
     qDebug() << "end of destruct";
 }
 
+void ScriptContainer::setupEngine()
+{
+    scriptEngine = new QJSEngine();
+    canHelper = new CANScriptHelper(scriptEngine);
+    isoHelper = new ISOTPScriptHelper(scriptEngine);
+    udsHelper = new UDSScriptHelper(scriptEngine);
+    j1939Helper = new J1939ScriptHelper(scriptEngine);
+    dbcHelper = new DBCScriptHelper(scriptEngine);
+    restbusHelper = new RestbusScriptHelper(scriptEngine);
+    queryHelper = new QueryScriptHelper(scriptEngine);
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(tick()));
+    tickClock.start();
+}
+
+void ScriptContainer::teardown()
+{
+    timer->stop();
+    delete timer;
+    timer = nullptr;
+    canHelper->clearFilters();
+    isoHelper->clearFilters();
+    udsHelper->clearFilters();
+    j1939Helper->clearFilters();
+    dbcHelper->unbindAll();
+    delete canHelper;
+    canHelper = nullptr;
+    delete isoHelper;
+    isoHelper = nullptr;
+    delete udsHelper;
+    udsHelper = nullptr;
+    delete j1939Helper;
+    j1939Helper = nullptr;
+    delete dbcHelper;
+    dbcHelper = nullptr;
+    delete restbusHelper;
+    restbusHelper = nullptr;
+    delete queryHelper;
+    queryHelper = nullptr;
+    //delete scriptEngine;   //doing this here seems to cause a crash. No crash if you don't.
+    //hand the container back so the window can finish deleting it once the worker is gone
+    moveToThread(QCoreApplication::instance()->thread());
+}
+
+//takes the current scriptText and compiles it on the worker, so this can be called from the window
 void ScriptContainer::compileScript()
 {
-    QJSValue result = scriptEngine->evaluate(scriptText, fileName);
+    QString text = scriptText;
+    QString name = fileName;
+    QMetaObject::invokeMethod(this, [this, text, name]() { compile(text, name); }, Qt::QueuedConnection);
+}
+
+void ScriptContainer::compile(const QString &text, const QString &name)
+{
+    QJSValue result = scriptEngine->evaluate(text, name);
 
     emit sendLog("Compiling script...");
 
     canHelper->clearFilters();
     isoHelper->clearFilters();
     udsHelper->clearFilters();
+    j1939Helper->clearFilters();
+    dbcHelper->unbindAll();
 
     if (result.isError())
     {
@@ -77,12 +221,24 @@ void ScriptContainer::compileScript()
         scriptEngine->globalObject().setProperty("isotp", isoObj);
         QJSValue udsObj = scriptEngine->newQObject(udsHelper);
         scriptEngine->globalObject().setProperty("uds", udsObj);
+        QJSValue j1939Obj = scriptEngine->newQObject(j1939Helper);
+        scriptEngine->globalObject().setProperty("j1939", j1939Obj);
+        QJSValue dbcObj = scriptEngine->newQObject(dbcHelper);
+        scriptEngine->globalObject().setProperty("dbc", dbcObj);
+        QJSValue restbusObj = scriptEngine->newQObject(restbusHelper);
+        scriptEngine->globalObject().setProperty("restbus", restbusObj);
+        QJSValue queryObj = scriptEngine->newQObject(queryHelper);
+        scriptEngine->globalObject().setProperty("query", queryObj);
 
         //Find out which callbacks the script has created.
         setupFunction = scriptEngine->globalObject().property("setup");
         canHelper->setRxCallback(scriptEngine->globalObject().property("gotCANFrame"));
+        canHelper->setBatchRxCallback(scriptEngine->globalObject().property("gotCANFrames"));
+        canHelper->setColumnRxCallback(scriptEngine->globalObject().property("gotCANBatch"));
         isoHelper->setRxCallback(scriptEngine->globalObject().property("gotISOTPMessage"));
         udsHelper->setRxCallback(scriptEngine->globalObject().property("gotUDSMessage"));
+        j1939Helper->setRxCallback(scriptEngine->globalObject().property("gotJ1939Message"));
+        dbcHelper->setChangeCallback(scriptEngine->globalObject().property("gotSignal"));
 
         tickFunction = scriptEngine->globalObject().property("tick");
 
@@ -104,6 +260,7 @@ void ScriptContainer::setScriptWindow(ScriptingWindow *win)
 {
     window = win;
     connect(this, &ScriptContainer::sendLog, window, &ScriptingWindow::log);
+    queryHelper->setFrameSource(window->frameStore(), window);
 }
 
 void ScriptContainer::log(QJSValue logString)
@@ -112,30 +269,128 @@ void ScriptContainer::log(QJSValue logString)
     emit sendLog(val);
 }
 
+ScriptTickStats ScriptContainer::tickStats()
+{
+    QMutexLocker lock(&valuesLock);
+    return stats;
+}
+
+//QJSEngine doesn't say how big its heap is, so only what's held on this side is counted
+void ScriptContainer::reportMemory(QVector<MemoryUsage> &out) const
+{
+    const QString owner = "Script " + fileName;
+    out.append({owner, "script text", MemoryAccounting::bytesOf(scriptText)});
+    qint64 paramBytes = 0;
+    {
+        QMutexLocker lock(&valuesLock);
+        paramBytes = MemoryAccounting::bytesOf(paramValues);
+        for (const auto &param : paramValues)
+            paramBytes += MemoryAccounting::bytesOf(param.first) + MemoryAccounting::bytesOf(param.second);
+    }
+    out.append({owner, "parameter values", paramBytes});
+}
+
+//a garbage collection on the engine's own thread. How much that gave back can't be seen from here
+qint64 ScriptContainer::purgeMemory()
+{
+    QJSEngine *engine = scriptEngine;
+    if (engine) QMetaObject::invokeMethod(engine, [engine]() { engine->collectGarbage(); }, Qt::QueuedConnection);
+    return 0;
+}
+
+//ticks are kept to a fixed schedule from when the interval was set, so a late tick doesn't push the rest back
 void ScriptContainer::setTickInterval(QJSValue interval)
 {
     int intervalValue = interval.toInt();
     qDebug() << "called set tick interval with value " << intervalValue;
+    {
+        QMutexLocker lock(&valuesLock);
+        stats = ScriptTickStats();
+        stats.intervalMs = qMax(intervalValue, 0);
+        stats.precise = preciseTicks;
+    }
     if (intervalValue > 0)
     {
-        timer.setInterval(intervalValue);
-        timer.start();
+        tickIntervalUs = static_cast<qint64>(intervalValue) * 1000;
+        lastTickUs = tickClock.nsecsElapsed() / 1000;
+        nextTickUs = lastTickUs + tickIntervalUs;
+        armTick();
+    }
+    else
+    {
+        tickIntervalUs = 0;
+        timer->stop();
+    }
+}
+
+//"precise" wakes up just before each tick and waits out the rest on this script's thread, "coarse" (the default)
+//leaves it to the OS timer and can be a few ms off either way
+void ScriptContainer::setTickTimeBase(QJSValue timeBase)
+{
+    preciseTicks = timeBase.isBool() ? timeBase.toBool() : timeBase.toString().compare("precise", Qt::CaseInsensitive) == 0;
+    {
+        QMutexLocker lock(&valuesLock);
+        stats.precise = preciseTicks;
     }
-    else timer.stop();
+    if (tickIntervalUs > 0) armTick();
+}
+
+void ScriptContainer::armTick()
+{
+    qint64 remainingUs = nextTickUs - tickClock.nsecsElapsed() / 1000;
+    timer->setTimerType(preciseTicks ? Qt::PreciseTimer : Qt::CoarseTimer);
+    //precise wakes a ms early and spins the rest in tick()
+    if (preciseTicks) remainingUs -= 1000;
+    timer->start(static_cast<int>(qMax<qint64>(remainingUs, 0) / 1000));
 }
 
 void ScriptContainer::tick()
 {
+    TRACE_SCOPE("ScriptContainer::tick");
+    if (tickIntervalUs <= 0) return;
+
+    qint64 nowUs = tickClock.nsecsElapsed() / 1000;
+    if (preciseTicks)
+    {
+        while (nowUs < nextTickUs) nowUs = tickClock.nsecsElapsed() / 1000;
+    }
+    else if (nowUs < nextTickUs)
+    {
+        //coarse timers can come in a little early, that's still this tick
+        nowUs = nextTickUs;
+    }
+
+    //whole intervals that went by since this tick was due were missed, the schedule skips over them
+    qint64 lateUs = nowUs - nextTickUs;
+    qint64 missed = lateUs / tickIntervalUs;
+    double elapsedMs = (nowUs - lastTickUs) / 1000.0;
+    lastTickUs = nowUs;
+    nextTickUs += (missed + 1) * tickIntervalUs;
+
     if (tickFunction.isCallable())
     {
         //qDebug() << "Calling tick function";
-        QJSValue res = tickFunction.call();
+        QJSValue res = tickFunction.call(QJSValueList() << elapsedMs << static_cast<int>(missed));
         if (res.isError())
         {
             emit sendLog("Error in tick function on line " + res.property("lineNumber").toString());
             emit sendLog(res.property("message").toString());
         }
     }
+
+    qint64 runUs = tickClock.nsecsElapsed() / 1000 - nowUs;
+    {
+        QMutexLocker lock(&valuesLock);
+        stats.ticks++;
+        stats.missed += static_cast<quint64>(missed);
+        if (runUs > tickIntervalUs) stats.overruns++;
+        stats.totalRunUs += runUs;
+        stats.maxRunUs = qMax(stats.maxRunUs, runUs);
+        stats.maxLateUs = qMax(stats.maxLateUs, lateUs - missed * tickIntervalUs);
+    }
+
+    //the script may have stopped or changed the tick itself
+    if (tickIntervalUs > 0 && !timer->isActive()) armTick();
 }
 
 void ScriptContainer::addParameter(QJSValue name)
@@ -143,14 +398,32 @@ void ScriptContainer::addParameter(QJSValue name)
     scriptParams.append(name.toString());
 }
 
+//the values are read on the worker, the table only ever sees the copy that was taken last time
+void ScriptContainer::snapshotValues()
+{
+    QVector<QPair<QString, QString>> values;
+    foreach (QString paramName, scriptParams)
+    {
+        values.append(qMakePair(paramName, scriptEngine->globalObject().property(paramName).toString()));
+    }
+    QMutexLocker lock(&valuesLock);
+    paramValues.swap(values);
+}
+
 void ScriptContainer::updateValuesTable(QTableWidget *widget)
 {
-    QString value;
+    QMetaObject::invokeMethod(this, [this]() { snapshotValues(); }, Qt::QueuedConnection);
 
-    foreach (QString paramName, scriptParams)
+    QVector<QPair<QString, QString>> values;
     {
-        value = scriptEngine->globalObject().property(paramName).toString();
-        qDebug() << paramName << " - " << value;
+        QMutexLocker lock(&valuesLock);
+        values = paramValues;
+    }
+
+    for (const QPair<QString, QString> &param : values)
+    {
+        const QString &paramName = param.first;
+        const QString &value = param.second;
         bool found = false;
         for (int i = 0; i < widget->rowCount(); i++)
         {
@@ -202,6 +475,16 @@ void CANScriptHelper::setRxCallback(QJSValue cb)
     gotFrameFunction = cb;
 }
 
+void CANScriptHelper::setBatchRxCallback(QJSValue cb)
+{
+    gotFramesFunction = cb;
+}
+
+void CANScriptHelper::setColumnRxCallback(QJSValue cb)
+{
+    gotBatchFunction = cb;
+}
+
 void CANScriptHelper::setFilter(QJSValue id, QJSValue mask, QJSValue bus)
 {
     uint32_t idVal = id.toUInt();
@@ -216,6 +499,23 @@ void CANScriptHelper::setFilter(QJSValue id, QJSValue mask, QJSValue bus)
     CANConManager::getInstance()->addTargettedFrame(busVal, idVal, maskVal, this);
 }
 
+bool CANScriptHelper::setFilterExpression(QJSValue text)
+{
+    QString source = (text.isUndefined() || text.isNull()) ? QString() : text.toString();
+    QString error;
+    QSharedPointer<const FilterExpression> expr = FilterExpression::compile(source, &error);
+    if (!error.isEmpty())
+    {
+        qDebug() << "Bad filter expression" << source << error;
+        return false;
+    }
+    //the expression could pass any ID so it needs every frame there is
+    if (expr && !expression) CANConManager::getInstance()->addTargettedFrame(-1, 0, 0, this);
+    else if (!expr && expression) CANConManager::getInstance()->removeTargettedFrame(-1, 0, 0, this);
+    expression = expr;
+    return true;
+}
+
 void CANScriptHelper::clearFilters()
 {
     qDebug() << "Called clear filters";
@@ -225,6 +525,7 @@ void CANScriptHelper::clearFilters()
     }
 
     filters.clear();
+    setFilterExpression(QJSValue());
 }
 
 void CANScriptHelper::sendFrame(QJSValue bus, QJSValue id, QJSValue length, QJSValue data)
@@ -232,15 +533,7 @@ void CANScriptHelper::sendFrame(QJSValue bus, QJSValue id, QJSValue length, QJSV
     CANFrame frame;
     frame.setExtendedFrameFormat(false);
     frame.setFrameId(static_cast<uint32_t>(id.toInt()));
-    QByteArray bytes(length.toUInt(), 0);
-
-    if (!data.isArray()) qDebug() << "data isn't an array";
-
-    for (int i = 0; i < bytes.length(); i++)
-    {
-        bytes[i] = (uint8_t)data.property(i).toInt();
-    }
-    frame.setPayload(bytes);
+    frame.setPayload(payloadFromJS(data, length.toInt()));
     frame.bus = (uint32_t)bus.toInt();
     //if (frame.bus > 1) frame.bus = 1;
 
@@ -250,27 +543,199 @@ void CANScriptHelper::sendFrame(QJSValue bus, QJSValue id, QJSValue length, QJSV
     CANConManager::getInstance()->sendFrame(frame);
 }
 
+/*
+ * Sends a whole lot of frames with one call into the connections. Takes either an array of frame objects
+ * ({bus, id, data} and optionally len) or the same columns gotCANBatch hands out: id, len and data with offset
+ * optional (payloads are taken as back to back without it) and bus either a column or one number for every frame.
+ */
+void CANScriptHelper::sendFrames(QJSValue batch)
+{
+    QList<CANFrame> out;
+    CANFrame frame;
+
+    if (batch.isArray())
+    {
+        int count = batch.property("length").toInt();
+        out.reserve(count);
+        for (int i = 0; i < count; i++)
+        {
+            QJSValue obj = batch.property(static_cast<quint32>(i));
+            QByteArray bytes = bytesFromJS(obj.property("data"));
+            if (obj.hasProperty("len")) bytes.resize(obj.property("len").toInt());
+            frame.bus = obj.property("bus").toInt();
+            frame.setFrameId(obj.property("id").toUInt());
+            frame.setExtendedFrameFormat(frame.frameId() > 0x7FF);
+            frame.setPayload(bytes);
+            out.append(frame);
+        }
+    }
+    else
+    {
+        QJSValue idCol = batch.property("id");
+        int count = batch.hasProperty("count") ? batch.property("count").toInt() : idCol.property("length").toInt();
+        if (count <= 0) return;
+        QVector<quint32> ids = columnFromJS(idCol, count);
+        QVector<quint32> buses = columnFromJS(batch.property("bus"), count);
+        QVector<quint32> lens = columnFromJS(batch.property("len"), count);
+        bool haveOffsets = batch.hasProperty("offset");
+        QVector<quint32> offsets = haveOffsets ? columnFromJS(batch.property("offset"), count) : QVector<quint32>();
+        QByteArray data = bytesFromJS(batch.property("data"));
+
+        out.reserve(count);
+        quint32 pos = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (haveOffsets) pos = offsets[i];
+            int len = static_cast<int>(qMin(lens[i], 64u));
+            QByteArray bytes = data.mid(static_cast<int>(pos), len);
+            bytes.resize(len);
+            pos += static_cast<quint32>(len);
+            frame.bus = static_cast<int>(buses[i]);
+            frame.setFrameId(ids[i]);
+            frame.setExtendedFrameFormat(ids[i] > 0x7FF);
+            frame.setPayload(bytes);
+            out.append(frame);
+        }
+    }
+
+    if (!out.isEmpty()) CANConManager::getInstance()->sendFrames(out);
+}
+
+//newest frame received with the ID, straight from the live frame table so no filter is needed. bus -1 is any bus
+QJSValue CANScriptHelper::getLatestFrame(QJSValue bus, QJSValue id)
+{
+    LiveFrame frame;
+    if (!LiveFrameTable::getReference()->latest(bus.toInt(), id.toUInt(), frame)) return QJSValue();
+
+    QJSValue result = scriptEngine->newObject();
+    result.setProperty("bus", frame.bus);
+    result.setProperty("id", frame.id);
+    result.setProperty("len", frame.len);
+    result.setProperty("timestamp", static_cast<double>(frame.timestamp));
+    result.setProperty("data", toByteView(scriptEngine, QByteArray(reinterpret_cast<const char *>(frame.data), frame.len)));
+    return result;
+}
+
 void CANScriptHelper::gotTargettedFrame(const CANFrame &frame)
 {
-    if (!gotFrameFunction.isCallable()) return; //nothing to do if we can't even call the function
-    //qDebug() << "Got frame in script interface";
+    gotTargettedFrames(QVector<CANFrame>{frame});
+}
 
-    const unsigned char *data = reinterpret_cast<const unsigned char *>(frame.payload().constData());
-    int dataLen = frame.payload().length();
+//one post per drain cycle and connection, the script sees all of it in one go if it has gotCANFrames
+void CANScriptHelper::gotTargettedFrames(const QVector<CANFrame> &frames)
+{
+    if (QThread::currentThread() == thread()) deliverFrames(frames);
+    else QMetaObject::invokeMethod(this, [this, frames]() { deliverFrames(frames); }, Qt::QueuedConnection);
+}
 
+bool CANScriptHelper::matchesFilter(const CANFrame &frame) const
+{
+    if (expression)
+    {
+        if (!expression->matches(frame)) return false;
+        if (filters.isEmpty()) return true; //otherwise it has to pass one of those as well
+    }
     for (int i = 0; i < filters.length(); i++)
     {
-        if (filters[i].checkFilter(frame.frameId(), frame.bus))
+        if (filters[i].checkFilter(frame.frameId(), frame.bus)) return true;
+    }
+    return false;
+}
+
+QJSValue CANScriptHelper::makeDataArray(const CANFrame &frame)
+{
+    return toByteView(scriptEngine, frame.payload());
+}
+
+//the columns of a batch. Payloads sit back to back in data, offset says where each one starts
+QJSValue CANScriptHelper::makeColumns(const QVector<CANFrame> &frames)
+{
+    QVector<qint32> buses;
+    QVector<quint32> ids;
+    QVector<quint8> lens;
+    QVector<double> stamps;
+    QVector<quint32> offsets;
+    QByteArray data;
+    buses.reserve(frames.count());
+    ids.reserve(frames.count());
+    lens.reserve(frames.count());
+    stamps.reserve(frames.count());
+    offsets.reserve(frames.count());
+    data.reserve(frames.count() * 8);
+
+    for (const CANFrame &frame : frames)
+    {
+        if (!matchesFilter(frame)) continue;
+        const QByteArray payload = frame.payload();
+        buses.append(frame.bus);
+        ids.append(frame.frameId());
+        lens.append(static_cast<quint8>(payload.length()));
+        stamps.append(static_cast<double>(frame.timeStamp().microSeconds()));
+        offsets.append(static_cast<quint32>(data.length()));
+        data.append(payload);
+    }
+    if (ids.isEmpty()) return QJSValue();
+
+    QJSValue batch = scriptEngine->newObject();
+    batch.setProperty("count", ids.count());
+    batch.setProperty("bus", toTypedArray(scriptEngine, "Int32Array", buses));
+    batch.setProperty("id", toTypedArray(scriptEngine, "Uint32Array", ids));
+    batch.setProperty("len", toTypedArray(scriptEngine, "Uint8Array", lens));
+    batch.setProperty("timestamp", toTypedArray(scriptEngine, "Float64Array", stamps));
+    batch.setProperty("offset", toTypedArray(scriptEngine, "Uint32Array", offsets));
+    batch.setProperty("data", toByteView(scriptEngine, data));
+    return batch;
+}
+
+void CANScriptHelper::deliverFrames(const QVector<CANFrame> &frames)
+{
+    TRACE_SCOPE("CANScriptHelper::deliverFrames");
+    if (expression && !expression->isCurrent())
+    {
+        //signals it used could be gone with the DBC files that had them
+        QString error;
+        QSharedPointer<const FilterExpression> expr = FilterExpression::compile(expression->text(), &error);
+        if (!expr) qDebug() << "Filter expression no longer compiles:" << error << ". Nothing will match it";
+        expression = expr ? expr : FilterExpression::compile("0");
+    }
+    if (gotBatchFunction.isCallable())
+    {
+        QJSValue batch = makeColumns(frames);
+        if (batch.isUndefined()) return;
+        QJSValue res = gotBatchFunction.call(QJSValueList() << batch);
+        if (res.isError()) qDebug() << "Error in gotCANBatch on line" << res.property("lineNumber").toString() << res.property("message").toString();
+        return;
+    }
+
+    if (gotFramesFunction.isCallable())
+    {
+        QJSValue batch = scriptEngine->newArray();
+        quint32 count = 0;
+        for (const CANFrame &frame : frames)
         {
-            QJSValueList args;
-            args << frame.bus << frame.frameId() << static_cast<uint>(frame.payload().length());
-            QJSValue dataBytes = scriptEngine->newArray(dataLen);
-
-            for (int j = 0; j < dataLen; j++) dataBytes.setProperty(j, QJSValue(data[j]));
-            args.append(dataBytes);
-            gotFrameFunction.call(args);
-            return; //as soon as one filter matches we jump out
+            if (!matchesFilter(frame)) continue;
+            QJSValue obj = scriptEngine->newObject();
+            obj.setProperty("bus", frame.bus);
+            obj.setProperty("id", frame.frameId());
+            obj.setProperty("len", static_cast<uint>(frame.payload().length()));
+            obj.setProperty("timestamp", static_cast<double>(frame.timeStamp().microSeconds()));
+            obj.setProperty("data", makeDataArray(frame));
+            batch.setProperty(count++, obj);
         }
+        if (count == 0) return;
+        QJSValue res = gotFramesFunction.call(QJSValueList() << batch);
+        if (res.isError()) qDebug() << "Error in gotCANFrames on line" << res.property("lineNumber").toString() << res.property("message").toString();
+        return;
+    }
+
+    if (!gotFrameFunction.isCallable()) return; //nothing to do if we can't even call the function
+    for (const CANFrame &frame : frames)
+    {
+        if (!matchesFilter(frame)) continue;
+        QJSValueList args;
+        args << frame.bus << frame.frameId() << static_cast<uint>(frame.payload().length());
+        args.append(makeDataArray(frame));
+        gotFrameFunction.call(args);
     }
 }
 
@@ -308,17 +773,7 @@ void ISOTPScriptHelper::sendISOTP(QJSValue bus, QJSValue id, QJSValue length, QJ
     ISOTP_MESSAGE msg;
     msg.setExtendedFrameFormat(false);
     msg.setFrameId(id.toUInt());
-    QByteArray dataArray(length.toUInt(), 0);
-
-    int dataLen = dataArray.length();
-
-    if (!dataBytes.isArray()) qDebug() << "data isn't an array";
-
-    for (int i = 0; i < dataLen; i++)
-    {
-        dataArray[i] = static_cast<uint8_t>(dataBytes.property(i).toInt());
-    }
-    msg.setPayload(dataArray);
+    msg.setPayload(payloadFromJS(dataBytes, length.toInt()));
 
     msg.bus = bus.toInt();
 
@@ -336,16 +791,58 @@ void ISOTPScriptHelper::setRxCallback(QJSValue cb)
 
 void ISOTPScriptHelper::newISOMessage(ISOTP_MESSAGE msg)
 {
+    TRACE_SCOPE("ISOTPScriptHelper::newISOMessage");
     qDebug() << "isotpScriptHelper got a ISOTP message";
     if (!gotFrameFunction.isCallable()) return; //nothing to do if we can't even call the function
     //qDebug() << "Got frame in script interface";
 
     QJSValueList args;
     args << msg.bus << msg.frameId() << static_cast<uint>(msg.payload().length());
-    QJSValue dataBytes = scriptEngine->newArray(static_cast<uint>(msg.payload().length()));
+    args.append(toByteView(scriptEngine, msg.payload()));
+    gotFrameFunction.call(args);
+}
+
+
+
+
+/* J1939ScriptHelper methods */
+J1939ScriptHelper::J1939ScriptHelper(QJSEngine *engine)
+{
+    scriptEngine = engine;
+    handler = new J1939_HANDLER;
+    connect(handler, &J1939_HANDLER::newJ1939Message, this, &J1939ScriptHelper::newJ1939Message);
+    handler->setReception(true);
+}
+
+void J1939ScriptHelper::clearFilters()
+{
+    handler->clearAllFilters();
+}
+
+void J1939ScriptHelper::setFilter(QJSValue pgn, QJSValue bus)
+{
+    qDebug() << "Called J1939 set filter" << pgn.toInt() << "*" << bus.toInt();
+    handler->addPGNFilter(bus.toInt(), pgn.toInt());
+}
+
+void J1939ScriptHelper::setLocalAddress(QJSValue address)
+{
+    handler->setLocalAddress(address.toInt());
+}
+
+void J1939ScriptHelper::setRxCallback(QJSValue cb)
+{
+    gotFrameFunction = cb;
+}
+
+void J1939ScriptHelper::newJ1939Message(J1939_MESSAGE msg)
+{
+    TRACE_SCOPE("J1939ScriptHelper::newJ1939Message");
+    if (!gotFrameFunction.isCallable()) return; //nothing to do if we can't even call the function
 
-    for (int j = 0; j < msg.payload().length(); j++) dataBytes.setProperty(static_cast<quint32>(j), QJSValue((unsigned char)msg.payload()[j]));
-    args.append(dataBytes);
+    QJSValueList args;
+    args << msg.bus << msg.pgn << msg.src << msg.dest << static_cast<uint>(msg.payload().length());
+    args.append(toByteView(scriptEngine, msg.payload()));
     gotFrameFunction.call(args);
 }
 
@@ -383,20 +880,10 @@ void UDSScriptHelper::sendUDS(QJSValue bus, QJSValue id, QJSValue service, QJSVa
     UDS_MESSAGE msg;
     msg.setExtendedFrameFormat(false);
     msg.setFrameId(id.toUInt());
-    QByteArray dataArray(length.toUInt(), 0);
     msg.service = service.toUInt();
     msg.subFuncLen = sublen.toUInt();
     msg.subFunc = subFunc.toUInt();
-
-    int dataLen = dataArray.length();
-
-    if (!dataBytes.isArray()) qDebug() << "data isn't an array";
-
-    for (int i = 0; i < dataLen; i++)
-    {
-        dataArray[i] = static_cast<uint8_t>(dataBytes.property(i).toInt());
-    }
-    msg.setPayload(dataArray);
+    msg.setPayload(payloadFromJS(dataBytes, length.toInt()));
 
     msg.bus = bus.toInt();
 
@@ -414,6 +901,7 @@ void UDSScriptHelper::setRxCallback(QJSValue cb)
 
 void UDSScriptHelper::newUDSMessage(UDS_MESSAGE msg)
 {
+    TRACE_SCOPE("UDSScriptHelper::newUDSMessage");
     //qDebug() << "udsScriptHelper got a UDS message";
     qDebug() << "UDS script helper. Msg data len: " << msg.payload().length();
     if (!gotFrameFunction.isCallable()) return; //nothing to do if we can't even call the function
@@ -421,10 +909,387 @@ void UDSScriptHelper::newUDSMessage(UDS_MESSAGE msg)
 
     QJSValueList args;
     args << msg.bus << msg.frameId() << msg.service << msg.subFunc << static_cast<uint>(msg.payload().length());
-    QJSValue dataBytes = scriptEngine->newArray(static_cast<unsigned int>(msg.payload().length()));
-
-    for (int j = 0; j < msg.payload().length(); j++) dataBytes.setProperty(static_cast<quint32>(j), QJSValue((unsigned char)msg.payload()[j]));
-    args.append(dataBytes);
+    args.append(toByteView(scriptEngine, msg.payload()));
     gotFrameFunction.call(args);
 }
 
+
+
+
+/* DBCScriptHelper methods */
+DBCScriptHelper::DBCScriptHelper(QJSEngine *engine)
+{
+    scriptEngine = engine;
+}
+
+DBCScriptHelper::~DBCScriptHelper()
+{
+    unbindAll();
+}
+
+void DBCScriptHelper::setChangeCallback(QJSValue cb)
+{
+    gotSignalFunction = cb;
+}
+
+QJSValue DBCScriptHelper::bind(QJSValue name)
+{
+    return bind(name, QJSValue(-1));
+}
+
+//returns the handle to read the values with, -1 if there's no such message or signal in the loaded DBC files
+QJSValue DBCScriptHelper::bind(QJSValue name, QJSValue bus)
+{
+    Binding b;
+    b.name = name.toString();
+    b.bus = bus.isUndefined() ? -1 : bus.toInt();
+    if (!resolve(b))
+    {
+        qDebug() << "Script asked to bind" << b.name << "which isn't in any loaded DBC file";
+        return QJSValue(-1);
+    }
+    CANConManager::getInstance()->addTargettedFrame(b.bus, b.id, 0x1FFFFFFF, this);
+    bindings.append(b);
+    return QJSValue(bindings.count() - 1);
+}
+
+void DBCScriptHelper::unbindAll()
+{
+    for (const Binding &b : bindings)
+    {
+        if (b.msg) CANConManager::getInstance()->removeTargettedFrame(b.bus, b.id, 0x1FFFFFFF, this);
+    }
+    bindings.clear();
+}
+
+/*
+ * The DBC files are only ever changed on the GUI thread so that's where the names get looked up, with this thread
+ * waiting the same way QueryScriptHelper::run does. The binding comes back holding a reference to the message set
+ * msg is in, which keeps it good for decoding here until refresh() sees the revision move and looks it up again.
+ */
+bool DBCScriptHelper::resolve(Binding &b)
+{
+    DBCHandler *dbc = DBCHandler::getReference();
+    if (QThread::currentThread() == dbc->thread()) return lookup(b);
+
+    struct Request
+    {
+        Binding binding;
+        bool found = false;
+        QSemaphore done;
+    };
+    QSharedPointer<Request> request(new Request);
+    request->binding = b;
+    QMetaObject::invokeMethod(dbc, [request]()
+    {
+        request->found = lookup(request->binding);
+        request->done.release();
+    }, Qt::QueuedConnection);
+
+    while (!request->done.tryAcquire(1, 50))
+    {
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
+        if (scriptEngine->isInterrupted())
+        {
+            //unbound until the next refresh tries again
+            b.msg = nullptr;
+            b.messages.reset();
+            return false;
+        }
+#endif
+    }
+    b = request->binding;
+    return request->found;
+}
+
+bool DBCScriptHelper::lookup(Binding &b)
+{
+    DBCHandler *dbc = DBCHandler::getReference();
+    b.revision = DBCHandler::getRevision();
+    b.msg = nullptr;
+    b.messages.reset();
+    b.sigIdx.clear();
+    b.sigNames.clear();
+
+    int dot = b.name.indexOf('.');
+    QString msgName = dot > 0 ? b.name.left(dot) : b.name;
+    DBC_MESSAGE *msg = nullptr;
+    DBCFile *file = nullptr;
+    //first file in order with a message of that name, same as DBCHandler::findMessage(name)
+    for (int f = 0; f < dbc->getFileCount() && !msg; f++)
+    {
+        file = dbc->getFileByIdx(f);
+        msg = file->messageHandler->findMsgByName(msgName);
+    }
+    if (msg && dot > 0)
+    {
+        DBC_SIGNAL *sig = msg->sigHandler->findSignalByName(b.name.mid(dot + 1));
+        if (!sig) return false;
+        b.sigIdx.append(msg->sigHandler->indexOf(sig));
+        b.isSignal = true;
+    }
+    else if (msg)
+    {
+        for (int i = 0; i < msg->sigHandler->getCount(); i++) b.sigIdx.append(i);
+        b.isSignal = false;
+    }
+    else if (dot < 0)
+    {
+        //just a signal name, the first message in file order that has it
+        for (int f = 0; f < dbc->getFileCount() && !msg; f++)
+        {
+            file = dbc->getFileByIdx(f);
+            DBCMessageHandler *messages = file->messageHandler;
+            for (int m = 0; m < messages->getCount() && !msg; m++)
+            {
+                DBC_MESSAGE *candidate = messages->findMsgByIdx(m);
+                DBC_SIGNAL *sig = candidate->sigHandler->findSignalByName(b.name);
+                if (!sig) continue;
+                msg = candidate;
+                b.sigIdx.append(msg->sigHandler->indexOf(sig));
+                b.isSignal = true;
+            }
+        }
+    }
+    if (!msg || b.sigIdx.isEmpty()) return false;
+
+    b.msg = msg;
+    b.messages = file->sharedMessageHandler();
+    b.id = msg->ID;
+    for (int idx : b.sigIdx) b.sigNames.append(msg->sigHandler->findSignalByIdx(idx)->name);
+    b.values.fill(0.0, b.sigIdx.count());
+    b.valid.fill(false, b.sigIdx.count());
+    return true;
+}
+
+void DBCScriptHelper::refresh()
+{
+    quint32 revision = DBCHandler::getRevision();
+    for (Binding &b : bindings)
+    {
+        if (b.revision == revision) continue;
+        bool hadMsg = b.msg != nullptr;
+        uint32_t oldId = b.id;
+        resolve(b);
+        if (hadMsg && (!b.msg || b.id != oldId)) CANConManager::getInstance()->removeTargettedFrame(b.bus, oldId, 0x1FFFFFFF, this);
+        if (b.msg && (!hadMsg || b.id != oldId)) CANConManager::getInstance()->addTargettedFrame(b.bus, b.id, 0x1FFFFFFF, this);
+    }
+}
+
+bool DBCScriptHelper::decodeInto(const Binding &b, const CANFrame &frame, QVector<double> &values, QVector<bool> &valid)
+{
+    if (!b.msg) return false;
+    int numSigs = b.msg->sigHandler->getCount();
+    if (scratchValues.count() < numSigs) scratchValues.resize(numSigs);
+    if (scratchValid.count() < (numSigs + 63) / 64) scratchValid.resize((numSigs + 63) / 64);
+    b.msg->decodeSignals(frame, scratchValues.data(), scratchValid.data(), numSigs);
+
+    bool any = false;
+    for (int i = 0; i < b.sigIdx.count(); i++)
+    {
+        int idx = b.sigIdx[i];
+        if (idx >= numSigs || !DBC_MESSAGE::isDecodedValid(scratchValid.constData(), idx)) continue;
+        values[i] = scratchValues[idx];
+        valid[i] = true;
+        any = true;
+    }
+    return any;
+}
+
+QJSValue DBCScriptHelper::toJS(const Binding &b, const QVector<double> &values, const QVector<bool> &valid)
+{
+    if (b.isSignal) return valid[0] ? QJSValue(values[0]) : QJSValue();
+    QJSValue obj = scriptEngine->newObject();
+    for (int i = 0; i < b.sigIdx.count(); i++)
+    {
+        if (valid[i]) obj.setProperty(b.sigNames[i], values[i]);
+    }
+    return obj;
+}
+
+//newest values seen for the binding: a number for a signal, an object of signal name -> value for a message
+QJSValue DBCScriptHelper::value(QJSValue handle)
+{
+    int idx = handle.toInt();
+    if (idx < 0 || idx >= bindings.count()) return QJSValue();
+    refresh();
+    const Binding &b = bindings[idx];
+    return toJS(b, b.values, b.valid);
+}
+
+//the binding's signals out of a payload the script has, say one that came in through gotCANFrame
+QJSValue DBCScriptHelper::decode(QJSValue handle, QJSValue data)
+{
+    int idx = handle.toInt();
+    if (idx < 0 || idx >= bindings.count()) return QJSValue();
+    refresh();
+    const Binding &b = bindings[idx];
+    if (!b.msg) return QJSValue();
+
+    CANFrame frame;
+    frame.setFrameId(b.id);
+    frame.setExtendedFrameFormat(b.msg->extendedID);
+    frame.setPayload(bytesFromJS(data));
+    QVector<double> values(b.sigIdx.count(), 0.0);
+    QVector<bool> valid(b.sigIdx.count(), false);
+    if (!decodeInto(b, frame, values, valid)) return QJSValue();
+    return toJS(b, values, valid);
+}
+
+void DBCScriptHelper::gotTargettedFrames(const QVector<CANFrame> &frames)
+{
+    if (QThread::currentThread() == thread()) deliverFrames(frames);
+    else QMetaObject::invokeMethod(this, [this, frames]() { deliverFrames(frames); }, Qt::QueuedConnection);
+}
+
+void DBCScriptHelper::deliverFrames(const QVector<CANFrame> &frames)
+{
+    TRACE_SCOPE("DBCScriptHelper::deliverFrames");
+    refresh();
+    bool notify = gotSignalFunction.isCallable();
+    QVector<double> values;
+    QVector<bool> valid;
+
+    for (const CANFrame &frame : frames)
+    {
+        for (Binding &b : bindings)
+        {
+            if (!b.msg || b.id != frame.frameId() || (b.bus != -1 && b.bus != frame.bus)) continue;
+            values = b.values;
+            valid.fill(false, b.sigIdx.count());
+            if (!decodeInto(b, frame, values, valid)) continue;
+
+            for (int i = 0; i < b.sigIdx.count(); i++)
+            {
+                if (!valid[i]) continue;
+                bool changed = !b.valid[i] || b.values[i] != values[i];
+                b.values[i] = values[i];
+                b.valid[i] = true;
+                if (!changed || !notify) continue;
+                QJSValueList args;
+                args << b.sigNames[i] << values[i] << frame.bus << static_cast<double>(frame.timeStamp().microSeconds());
+                QJSValue res = gotSignalFunction.call(args);
+                if (res.isError()) qDebug() << "Error in gotSignal on line" << res.property("lineNumber").toString() << res.property("message").toString();
+            }
+        }
+    }
+}
+
+
+
+/* RestbusScriptHelper methods */
+RestbusScriptHelper::RestbusScriptHelper(QJSEngine *engine)
+{
+    scriptEngine = engine;
+}
+
+//true if the restbus has that signal. name is "Message.Signal"
+QJSValue RestbusScriptHelper::set(QJSValue name, QJSValue value)
+{
+    QString text = name.toString();
+    return QJSValue(RestbusEngine::getReference()->setSignal(text.section('.', 0, 0), text.section('.', 1), value.toNumber()));
+}
+
+QJSValue RestbusScriptHelper::clear(QJSValue name)
+{
+    QString text = name.toString();
+    return QJSValue(RestbusEngine::getReference()->clearSignal(text.section('.', 0, 0), text.section('.', 1)));
+}
+
+void RestbusScriptHelper::clearAll()
+{
+    RestbusEngine::getReference()->clearAllSignals();
+}
+
+//what the signal is being sent as, undefined if the restbus doesn't have it
+QJSValue RestbusScriptHelper::value(QJSValue name)
+{
+    QString text = name.toString();
+    double val;
+    if (!RestbusEngine::getReference()->signalValue(text.section('.', 0, 0), text.section('.', 1), val)) return QJSValue();
+    return QJSValue(val);
+}
+
+QJSValue RestbusScriptHelper::running()
+{
+    return QJSValue(RestbusEngine::getReference()->isRunning());
+}
+
+QueryScriptHelper::QueryScriptHelper(QJSEngine *engine)
+{
+    scriptEngine = engine;
+    frameStore = nullptr;
+    guiContext = nullptr;
+}
+
+void QueryScriptHelper::setFrameSource(const CANFrameStore *frames, QObject *guiObject)
+{
+    frameStore = frames;
+    guiContext = guiObject;
+}
+
+/*
+ * An array with an object per row. Values are plain numbers, IDs too, and an aggregate with no value (the mean of
+ * no frames) is left undefined. Throws with the parse error if the query is wrong.
+ */
+QJSValue QueryScriptHelper::run(QJSValue text)
+{
+    TRACE_SCOPE("QueryScriptHelper::run");
+    QString error;
+    QSharedPointer<const FrameQuery> query = FrameQuery::compile(text.toString(), &error);
+    if (!query)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 12, 0 )
+        scriptEngine->throwError(error);
+#endif
+        return QJSValue();
+    }
+    if (!frameStore || !guiContext) return scriptEngine->newArray();
+
+    //the GUI side only ever touches this, so it's fine if the script gives up before it's done
+    struct Request
+    {
+        CANFrameSnapshot frames;
+        QSemaphore done;
+    };
+    QSharedPointer<Request> request(new Request);
+    const CANFrameStore *store = frameStore;
+    QMetaObject::invokeMethod(guiContext, [request, store]()
+    {
+        request->frames = store->snapshot();
+        request->done.release();
+    }, Qt::QueuedConnection);
+
+    //a blocking call could deadlock with the container being deleted, it waits on this thread the same way
+    while (!request->done.tryAcquire(1, 50))
+    {
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
+        if (scriptEngine->isInterrupted()) return QJSValue();
+#endif
+    }
+
+    QJSEngine *engine = scriptEngine;
+    FrameQuery::Result result = query->run(request->frames, [engine](qint64, qint64)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 14, 0 )
+        return !engine->isInterrupted();
+#else
+        Q_UNUSED(engine);
+        return true;
+#endif
+    });
+    if (!result.complete) return QJSValue();
+
+    QJSValue rows = scriptEngine->newArray(static_cast<uint>(result.rows.count()));
+    for (int r = 0; r < result.rows.count(); r++)
+    {
+        const QVector<double> &row = result.rows.at(r);
+        QJSValue obj = scriptEngine->newObject();
+        for (int c = 0; c < row.count(); c++)
+        {
+            if (!std::isnan(row.at(c))) obj.setProperty(result.columns.at(c), row.at(c));
+        }
+        rows.setProperty(static_cast<quint32>(r), obj);
+    }
+    return rows;
+}
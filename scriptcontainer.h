@@ -3,16 +3,26 @@
 
 #include "can_structs.h"
 #include "canfilter.h"
+#include "filterexpression.h"
+#include "canframestore.h"
+#include "memoryaccounting.h"
 #include "bus_protocols/isotp_handler.h"
 #include "bus_protocols/isotp_message.h"
 #include "bus_protocols/uds_handler.h"
+#include "bus_protocols/j1939_handler.h"
 
 #include <QElapsedTimer>
 #include <QJSEngine>
+#include <QMutex>
+#include <QPair>
+#include <QSharedPointer>
+#include <QThread>
 #include <QTimer>
 #include <qlistwidget.h>
 
 class ScriptingWindow;
+class DBC_MESSAGE;
+class DBCMessageHandler;
 
 class CANScriptHelper: public QObject
 {
@@ -22,16 +32,31 @@ public:
 
 public slots:
     void setFilter(QJSValue id, QJSValue mask, QJSValue bus);
+    bool setFilterExpression(QJSValue text);
     void clearFilters();
     void sendFrame(QJSValue bus, QJSValue id, QJSValue length, QJSValue data);
+    void sendFrames(QJSValue batch);
     void setRxCallback(QJSValue cb);
+    void setBatchRxCallback(QJSValue cb);
+    void setColumnRxCallback(QJSValue cb);
+    QJSValue getLatestFrame(QJSValue bus, QJSValue id);
 
 private slots:
+    //called by the connection manager on its own thread, the frames are passed on to the script's thread
     void gotTargettedFrame(const CANFrame &frame);
+    void gotTargettedFrames(const QVector<CANFrame> &frames);
 
 private:
+    void deliverFrames(const QVector<CANFrame> &frames);
+    bool matchesFilter(const CANFrame &frame) const;
+    QJSValue makeDataArray(const CANFrame &frame);
+    QJSValue makeColumns(const QVector<CANFrame> &frames);
+
     QList<CANFilter> filters;
+    QSharedPointer<const FilterExpression> expression; //frames have to match this too. Takes every frame in while set
     QJSValue gotFrameFunction;
+    QJSValue gotFramesFunction; //batched callback, used instead of gotFrameFunction when the script has one
+    QJSValue gotBatchFunction; //same again but as columns of typed arrays, takes precedence over both
     QJSEngine *scriptEngine;
 };
 
@@ -71,7 +96,141 @@ private:
     UDS_HANDLER *handler;
 };
 
-class ScriptContainer : public QObject
+class J1939ScriptHelper: public QObject
+{
+    Q_OBJECT
+public:
+    J1939ScriptHelper(QJSEngine *engine);
+public slots:
+    void setFilter(QJSValue pgn, QJSValue bus);
+    void clearFilters();
+    void setLocalAddress(QJSValue address);
+    void setRxCallback(QJSValue cb);
+private slots:
+    void newJ1939Message(J1939_MESSAGE msg);
+private:
+    QJSValue gotFrameFunction;
+    QJSEngine *scriptEngine;
+    J1939_HANDLER *handler;
+};
+
+/*
+ * DBC signals for scripts, decoded natively. dbc.bind() looks a message or signal up once and has the frames of
+ * that message sent here, where they go through DBC_MESSAGE::decodeSignals on the script's thread. The newest
+ * values can be read at any time and, if the script has gotSignal, each change is passed to it. Bindings are
+ * looked up again by name whenever the DBC revision moves so they survive files being edited or reloaded.
+ */
+class DBCScriptHelper: public QObject
+{
+    Q_OBJECT
+public:
+    DBCScriptHelper(QJSEngine *engine);
+    ~DBCScriptHelper();
+    void setChangeCallback(QJSValue cb);
+
+public slots:
+    QJSValue bind(QJSValue name);
+    QJSValue bind(QJSValue name, QJSValue bus);
+    void unbindAll();
+    QJSValue value(QJSValue handle);
+    QJSValue decode(QJSValue handle, QJSValue data);
+
+private slots:
+    void gotTargettedFrames(const QVector<CANFrame> &frames);
+
+private:
+    struct Binding
+    {
+        QString name; //as the script gave it: "Message", "Signal" or "Message.Signal"
+        int bus;
+        quint32 revision;
+        DBC_MESSAGE *msg; //null if nothing by that name is loaded right now
+        QSharedPointer<DBCMessageHandler> messages; //what msg lives in, so a reload can't free it from under us
+        uint32_t id;
+        QVector<int> sigIdx; //signals of msg this binding covers, in sigHandler order
+        QStringList sigNames;
+        QVector<double> values;
+        QVector<bool> valid;
+        bool isSignal; //value() hands back a number instead of an object
+    };
+
+    bool resolve(Binding &b);
+    static bool lookup(Binding &b); //GUI thread only
+    void refresh(); //rebinds everything if the DBC changed
+    void deliverFrames(const QVector<CANFrame> &frames);
+    bool decodeInto(const Binding &b, const CANFrame &frame, QVector<double> &values, QVector<bool> &valid);
+    QJSValue toJS(const Binding &b, const QVector<double> &values, const QVector<bool> &valid);
+
+    QVector<Binding> bindings;
+    QJSValue gotSignalFunction;
+    QJSEngine *scriptEngine;
+    QVector<double> scratchValues;
+    QVector<uint64_t> scratchValid;
+};
+
+/*
+ * The restbus's signal overrides for scripts. Names are "Message.Signal" like dbc.bind takes. The engine does its
+ * own locking so these just call straight through from the script's thread. Overrides outlive the script, like
+ * ones set in the restbus window, until they're cleared or the restbus is started again.
+ */
+class RestbusScriptHelper: public QObject
+{
+    Q_OBJECT
+public:
+    RestbusScriptHelper(QJSEngine *engine);
+
+public slots:
+    QJSValue set(QJSValue name, QJSValue value);
+    QJSValue clear(QJSValue name);
+    void clearAll();
+    QJSValue value(QJSValue name);
+    QJSValue running();
+
+private:
+    QJSEngine *scriptEngine;
+};
+
+/*
+ * FrameQuery for scripts. query.run("select count() group by id") goes over the main frame list and hands back an
+ * array with an object per row, keyed by the column names as the query wrote them. The store can only be
+ * snapshotted on the GUI thread so that's asked for there and waited on, giving up if the script gets stopped.
+ * The query itself then runs on the script's thread and the pool like it does from the query window.
+ */
+class QueryScriptHelper: public QObject
+{
+    Q_OBJECT
+public:
+    QueryScriptHelper(QJSEngine *engine);
+    void setFrameSource(const CANFrameStore *frames, QObject *guiObject); //before the script is compiled
+
+public slots:
+    QJSValue run(QJSValue text);
+
+private:
+    QJSEngine *scriptEngine;
+    const CANFrameStore *frameStore;
+    QObject *guiContext; //lives on the GUI thread, the snapshot is taken in its event loop
+};
+
+//how the tick of a script has been keeping up, read by the window for the current script
+struct ScriptTickStats
+{
+    int intervalMs = 0; //0 when the tick isn't running
+    bool precise = false;
+    quint64 ticks = 0;
+    quint64 missed = 0; //whole intervals that went by without a tick
+    quint64 overruns = 0; //ticks where the script took longer than the interval
+    qint64 totalRunUs = 0;
+    qint64 maxRunUs = 0;
+    qint64 maxLateUs = 0; //worst a tick started after it was due
+};
+
+/*
+ * One loaded script. Every container runs on a thread of its own with its own engine, so a busy script can't hold
+ * up the GUI or any of the other scripts. The engine, the helpers and the tick timer are all made on that thread,
+ * and everything the window calls in here is either queued over to it or only reads the values snapshot.
+ */
+class ScriptContainer : public QObject, public MemoryReporter
 {
     Q_OBJECT
 
@@ -79,6 +238,9 @@ public:
     ScriptContainer();
     virtual ~ScriptContainer();
     void setScriptWindow(ScriptingWindow *win);
+    ScriptTickStats tickStats(); //safe from any thread
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+    qint64 purgeMemory() override;
 
     QString fileName;
     QString filePath;
@@ -91,9 +253,10 @@ public:
 public slots:
     void compileScript();
     void setTickInterval(QJSValue interval);
+    void setTickTimeBase(QJSValue timeBase);
     void log(QJSValue logString);
     void addParameter(QJSValue name);
-    void updateValuesTable(QTableWidget *widget);
+    void updateValuesTable(QTableWidget *widget); //GUI thread only, fills the table from the last snapshot
     void updateParameter(QString name, QString value);
 
 signals:
@@ -103,16 +266,36 @@ private slots:
     void tick();
 
 private:
+    //these run on the worker thread
+    void setupEngine();
+    void teardown();
+    void compile(const QString &text, const QString &name);
+    void snapshotValues();
+    void armTick();
+
+    QThread *worker;
     QJSEngine *scriptEngine;
     QJSValue compiledScript;
     QJSValue setupFunction;
     QJSValue tickFunction;
-    QTimer timer;
+    QTimer *timer; //single shot, armed again for the next due time after every tick
+    QElapsedTimer tickClock;
+    qint64 tickIntervalUs;
+    qint64 nextTickUs; //on tickClock
+    qint64 lastTickUs;
+    bool preciseTicks;
+    ScriptTickStats stats; //under valuesLock
     ScriptingWindow *window;
     CANScriptHelper *canHelper;
     ISOTPScriptHelper *isoHelper;
     UDSScriptHelper *udsHelper;
+    J1939ScriptHelper *j1939Helper;
+    DBCScriptHelper *dbcHelper;
+    RestbusScriptHelper *restbusHelper;
+    QueryScriptHelper *queryHelper;
     QVector<QString> scriptParams;
+    mutable QMutex valuesLock;
+    QVector<QPair<QString, QString>> paramValues; //name and value of every parameter, taken on the worker
 };
 
 #endif // SCRIPTCONTAINER_H
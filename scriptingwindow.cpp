@@ -11,7 +11,7 @@
 #include "connections/canconmanager.h"
 #include "helpwindow.h"
 
-ScriptingWindow::ScriptingWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+ScriptingWindow::ScriptingWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::ScriptingWindow)
 {
@@ -175,7 +175,9 @@ void ScriptingWindow::changeCurrentScript()
     currentScript = container;
     editor->setPlainText(container->scriptText);
     editor->setEnabled(true);
-    connect(this, SIGNAL(updateValueTable(QTableWidget*)), currentScript, SLOT(updateValuesTable(QTableWidget*)));
+    showTickStats();
+    //the table is filled in right here on the GUI thread, parameter changes go over to the script's own thread
+    connect(this, SIGNAL(updateValueTable(QTableWidget*)), currentScript, SLOT(updateValuesTable(QTableWidget*)), Qt::DirectConnection);
     connect(this, SIGNAL(updatedParameter(QString,QString)), currentScript, SLOT(updateParameter(QString,QString)));
 }
 
@@ -184,9 +186,30 @@ void ScriptingWindow::valuesTimerElapsed()
     if (currentScript)
     {
         emit updateValueTable(ui->tableVariables);
+        showTickStats();
     }
 }
 
+void ScriptingWindow::showTickStats()
+{
+    if (!currentScript)
+    {
+        ui->lblTickStats->setText(QString());
+        return;
+    }
+    ScriptTickStats stats = currentScript->tickStats();
+    if (stats.intervalMs == 0)
+    {
+        ui->lblTickStats->setText(tr("Tick not running"));
+        return;
+    }
+    double avgRunMs = stats.ticks ? stats.totalRunUs / 1000.0 / stats.ticks : 0.0;
+    ui->lblTickStats->setText(tr("Tick every %1 ms (%2): %3 ticks, %4 missed, %5 overruns\nRun avg %6 ms, max %7 ms. Worst late %8 ms")
+                              .arg(stats.intervalMs).arg(stats.precise ? tr("precise") : tr("coarse"))
+                              .arg(stats.ticks).arg(stats.missed).arg(stats.overruns)
+                              .arg(avgRunMs, 0, 'f', 2).arg(stats.maxRunUs / 1000.0, 0, 'f', 2).arg(stats.maxLateUs / 1000.0, 0, 'f', 2));
+}
+
 void ScriptingWindow::loadNewScript()
 {
     QString filename;
@@ -275,7 +298,7 @@ void ScriptingWindow::deleteCurrentScript()
         ui->listLoadedScripts->takeItem(sel);
         thisScript = scripts.at(sel);
         scripts.removeAt(sel);
-        delete thisScript;  //causes a seg fault. Seems to be due to currently running javascript code. No idea how to stop code from running
+        delete thisScript;  //interrupts the script and waits for its thread to finish up
         thisScript = nullptr;
         currentScript = nullptr;
 
@@ -288,6 +311,7 @@ void ScriptingWindow::deleteCurrentScript()
         {
             editor->setPlainText("");
             editor->setEnabled(false);
+            showTickStats();
         }
         break;
     case QMessageBox::No:
@@ -0,0 +1,211 @@
+#include "sendgridmodel.h"
+
+SendGridModel::SendGridModel(const QStringList &headers, const QVector<ColumnKind> &kinds, QObject *parent)
+    : QAbstractTableModel(parent), headers(headers), kinds(kinds)
+{
+    Row blank;
+    for (int i = 0; i < kinds.count(); i++) blank.text.append(QString());
+    blank.checks = 0;
+    cells.append(blank);
+    shownCounts.append(0);
+    dirtyLow = 1;
+    dirtyHigh = 0;
+}
+
+int SendGridModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return cells.count();
+}
+
+int SendGridModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return kinds.count();
+}
+
+QVariant SendGridModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= cells.count() || index.column() >= kinds.count()) return QVariant();
+    const Row &row = cells.at(index.row());
+    switch (kinds.at(index.column()))
+    {
+    case CheckColumn:
+        if (role == Qt::CheckStateRole) return ((row.checks >> index.column()) & 1) ? Qt::Checked : Qt::Unchecked;
+        return QVariant();
+    case CountColumn:
+        if (role != Qt::DisplayRole || index.row() >= recordCount()) return QVariant();
+        return QString::number(shownCounts.at(index.row()));
+    default:
+        if (role == Qt::DisplayRole || role == Qt::EditRole) return row.text.at(index.column());
+        return QVariant();
+    }
+}
+
+bool SendGridModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.row() >= cells.count() || index.column() >= kinds.count()) return false;
+    int row = index.row();
+    int column = index.column();
+    switch (kinds.at(column))
+    {
+    case CheckColumn:
+        if (role != Qt::CheckStateRole) return false;
+        setChecked(row, column, value.toInt() == Qt::Checked);
+        break;
+    case TextColumn:
+        if (role != Qt::EditRole) return false;
+        if (cells.at(row).text.at(column) == value.toString()) return false;
+        setText(row, column, value.toString());
+        break;
+    default:
+        return false;
+    }
+    emit cellEdited(row, column);
+    return true;
+}
+
+QVariant SendGridModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) return QVariant();
+    if (orientation == Qt::Horizontal) return headers.value(section);
+    return QString::number(section + 1);
+}
+
+Qt::ItemFlags SendGridModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) return Qt::NoItemFlags;
+    Qt::ItemFlags flags = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    switch (kinds.at(index.column()))
+    {
+    case TextColumn:
+        return flags | Qt::ItemIsEditable;
+    case CheckColumn:
+        return flags | Qt::ItemIsUserCheckable;
+    default:
+        return flags;
+    }
+}
+
+QString SendGridModel::text(int row, int column) const
+{
+    if (row < 0 || row >= cells.count() || column < 0 || column >= kinds.count()) return QString();
+    return cells.at(row).text.at(column);
+}
+
+bool SendGridModel::isChecked(int row, int column) const
+{
+    if (row < 0 || row >= cells.count() || column < 0 || column >= kinds.count()) return false;
+    return (cells.at(row).checks >> column) & 1;
+}
+
+//anything put in the blank row on the end makes it a record, so there has to be a new blank one after it
+void SendGridModel::ensureRecord(int row)
+{
+    if (row < recordCount()) return;
+    int first = cells.count();
+    beginInsertRows(QModelIndex(), first, row + 1);
+    Row blank;
+    for (int i = 0; i < kinds.count(); i++) blank.text.append(QString());
+    blank.checks = 0;
+    while (cells.count() <= row + 1)
+    {
+        cells.append(blank);
+        shownCounts.append(0);
+    }
+    endInsertRows();
+}
+
+void SendGridModel::setText(int row, int column, const QString &text)
+{
+    if (row < 0 || column < 0 || column >= kinds.count()) return;
+    ensureRecord(row);
+    cells[row].text[column] = text;
+    emit dataChanged(index(row, column), index(row, column));
+}
+
+void SendGridModel::setChecked(int row, int column, bool checked)
+{
+    if (row < 0 || column < 0 || column >= kinds.count()) return;
+    ensureRecord(row);
+    if (checked) cells[row].checks |= 1u << column;
+    else cells[row].checks &= ~(1u << column);
+    emit dataChanged(index(row, column), index(row, column), {Qt::CheckStateRole});
+}
+
+void SendGridModel::updateText(int row, int column, const QString &text)
+{
+    if (row < 0 || row >= recordCount() || column < 0 || column >= kinds.count()) return;
+    if (cells.at(row).text.at(column) == text) return;
+    cells[row].text[column] = text;
+    markDirty(row);
+}
+
+void SendGridModel::markDirty(int row)
+{
+    if (dirtyLow > dirtyHigh)
+    {
+        dirtyLow = dirtyHigh = row;
+        return;
+    }
+    if (row < dirtyLow) dirtyLow = row;
+    if (row > dirtyHigh) dirtyHigh = row;
+}
+
+void SendGridModel::removeRecord(int row)
+{
+    if (row < 0 || row >= recordCount()) return;
+    beginRemoveRows(QModelIndex(), row, row);
+    cells.removeAt(row);
+    shownCounts.removeAt(row);
+    dirtyLow = 1;
+    dirtyHigh = 0;
+    endRemoveRows();
+}
+
+void SendGridModel::clearRecords()
+{
+    if (recordCount() == 0) return;
+    beginRemoveRows(QModelIndex(), 0, recordCount() - 1);
+    cells.remove(0, recordCount());
+    shownCounts.remove(0, shownCounts.count() - 1);
+    dirtyLow = 1;
+    dirtyHigh = 0;
+    endRemoveRows();
+}
+
+/*
+ * Changed rows are announced in runs, so a block of records sending together is one dataChanged and a lone busy
+ * record among idle ones doesn't drag the whole grid into a repaint.
+ */
+void SendGridModel::refreshCounts()
+{
+    int countColumn = kinds.indexOf(CountColumn);
+    int runStart = -1;
+    int records = recordCount();
+    for (int row = 0; row <= records; row++)
+    {
+        bool changed = false;
+        if (row < records)
+        {
+            if (countSource && countColumn >= 0)
+            {
+                int count = countSource(row);
+                if (count != shownCounts.at(row))
+                {
+                    shownCounts[row] = count;
+                    changed = true;
+                }
+            }
+            if (row >= dirtyLow && row <= dirtyHigh) changed = true;
+        }
+        if (changed && runStart < 0) runStart = row;
+        if (!changed && runStart >= 0)
+        {
+            emit dataChanged(index(runStart, 0), index(row - 1, kinds.count() - 1), {Qt::DisplayRole});
+            runStart = -1;
+        }
+    }
+    dirtyLow = 1;
+    dirtyHigh = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef SENDGRIDMODEL_H
+#define SENDGRIDMODEL_H
+
+#include <QAbstractTableModel>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+/*
+ * The rows of a frame sender grid (the custom sender window and the simple sender under the main list), one per
+ * send record plus a blank one on the end to type a new record into. Holds what was typed in each cell and the
+ * check boxes. Those only change when someone edits them or a record gets rewritten, editing one emits
+ * cellEdited and the owner turns it into its FrameSendData.
+ *
+ * The count column isn't stored with the rest. refreshCounts() reads every record's count through the function
+ * set with setCountSource (an atomic counter when the sending runs on another thread) and only rows whose count
+ * moved get a dataChanged, so a grid of thousands of mostly idle records costs a compare per row per GUI tick
+ * instead of an item update. Text that changes as frames go out (the data column with modifiers) is set with
+ * updateText() and announced at the same time.
+ */
+class SendGridModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum ColumnKind
+    {
+        TextColumn,     //typed in
+        CheckColumn,    //a check box, no text
+        FixedColumn,    //filled in from elsewhere, can't be edited
+        CountColumn     //frames sent, from the count source
+    };
+
+    SendGridModel(const QStringList &headers, const QVector<ColumnKind> &kinds, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    int recordCount() const { return cells.count() - 1; } //rows less the blank one
+    QString text(int row, int column) const;
+    bool isChecked(int row, int column) const;
+    void ensureRecord(int row); //rows up to this one become records
+    //none of these emit cellEdited. A row past the records becomes a record, with a new blank row after it
+    void setText(int row, int column, const QString &text);
+    void setChecked(int row, int column, bool checked);
+    void updateText(int row, int column, const QString &text); //shown at the next refreshCounts
+    void removeRecord(int row);
+    void clearRecords();
+
+    void setCountSource(std::function<int(int)> source) { countSource = source; }
+    void refreshCounts();
+
+signals:
+    void cellEdited(int row, int column);
+
+private:
+    struct Row
+    {
+        QStringList text;
+        quint32 checks; //bit per column
+    };
+
+    void markDirty(int row);
+
+    QStringList headers;
+    QVector<ColumnKind> kinds;
+    QVector<Row> cells;
+    QVector<int> shownCounts; //what the count column last said, per row
+    std::function<int(int)> countSource;
+    int dirtyLow, dirtyHigh; //rows with text from updateText not announced yet. low > high for none
+};
+
+#endif // SENDGRIDMODEL_H
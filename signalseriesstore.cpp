@@ -0,0 +1,173 @@
+#include "signalseriesstore.h"
+#include "dbc/dbc_classes.h"
+
+#include <algorithm>
+
+//fewest samples from evicted frames worth taking off the front of a series
+#define SIGNALSERIES_MIN_TRIM   1024
+
+SignalSeriesKey SignalSeriesKey::forSignal(const DBC_SIGNAL *sig, int bus)
+{
+    SignalSeriesKey key;
+    key.id = sig->parentMessage->ID;
+    key.bus = (bus < 0) ? -1 : bus;
+    key.startBit = sig->startBit;
+    key.bits = sig->signalSize;
+    if (sig->valType == SP_FLOAT) key.bits = 32;
+    else if (sig->valType == DP_FLOAT) key.bits = 64;
+    key.intel = sig->intelByteOrder;
+    key.isSigned = (sig->valType == SIGNED_INT);
+    if (sig->isMultiplexed) key.signal = sig;
+    return key;
+}
+
+int SignalSeries::indexOfSequence(quint64 seq) const
+{
+    return static_cast<int>(std::lower_bound(sequences.constBegin(), sequences.constEnd(), seq) - sequences.constBegin());
+}
+
+SignalSeriesStore *SignalSeriesStore::forFrames(const CANFrameStore *frames)
+{
+    return perFrameStore<SignalSeriesStore>(frames, [](const CANFrameStore *f) { return new SignalSeriesStore(f); });
+}
+
+SignalSeriesStore::SignalSeriesStore(const CANFrameStore *frames) : FrameStoreFollower(frames)
+{
+    rebuild();
+}
+
+const SignalSeries *SignalSeriesStore::acquire(const SignalSeriesKey &key)
+{
+    sync(); //so the new series and all the old ones are caught up to the same frame
+
+    QVector<SignalSeries *> &sameId = byId[CANFrameStore::idKey(key.id, key.bus)];
+    for (SignalSeries *s : sameId)
+    {
+        if (s->key == key)
+        {
+            s->refs++;
+            return s;
+        }
+    }
+
+    SignalSeries *s = new SignalSeries;
+    s->key = key;
+    s->extractor.compile(key.startBit, key.bits, key.intel, key.isSigned);
+    s->refs = 1;
+    fill(*s);
+    sameId.append(s);
+    series.append(s);
+    return s;
+}
+
+void SignalSeriesStore::release(const SignalSeries *s)
+{
+    if (!s) return;
+    int idx = series.indexOf(const_cast<SignalSeries *>(s));
+    if (idx < 0) return;
+    SignalSeries *owned = series[idx];
+    if (--owned->refs > 0) return;
+
+    uint64_t idKey = CANFrameStore::idKey(owned->key.id, owned->key.bus);
+    QVector<SignalSeries *> &sameId = byId[idKey];
+    sameId.removeAll(owned);
+    if (sameId.isEmpty()) byId.remove(idKey);
+    series.removeAt(idx);
+    delete owned;
+}
+
+void SignalSeriesStore::clearState()
+{
+    for (SignalSeries *s : series)
+    {
+        s->sequences.clear();
+        s->stamps.clear();
+        s->values.clear();
+    }
+}
+
+//every series from the per ID index instead of looking each frame up
+void SignalSeriesStore::addAll()
+{
+    for (SignalSeries *s : series) fill(*s);
+}
+
+//everything the frame store has right now for this series' ID, by way of its per ID index. The series starts empty
+void SignalSeriesStore::fill(SignalSeries &s)
+{
+    QVector<int> rows = frames->rowsOf(s.key.id, s.key.bus);
+    s.sequences.reserve(rows.count());
+    s.stamps.reserve(rows.count());
+    s.values.reserve(rows.count());
+    for (int row : rows) appendSample(s, row);
+}
+
+void SignalSeriesStore::appendSample(SignalSeries &s, int row)
+{
+    const CANFrameRecord &rec = frames->record(row);
+    if (rec.type() != QCanBusFrame::DataFrame) return;
+    //only multiplexed signals can be missing from a frame so only they need the whole frame built
+    if (s.key.signal && !s.key.signal->isSignalInMessage(frames->at(row))) return;
+    s.sequences.append(frames->sequenceOf(row));
+    s.stamps.append(rec.timestamp);
+    s.values.append(s.extractor.extract(frames->payloadData(row), rec.len));
+}
+
+//each frame is looked up once for series on its bus and once for series on any bus
+void SignalSeriesStore::add(int row)
+{
+    if (byId.isEmpty()) return;
+    const CANFrameRecord &rec = frames->record(row);
+    if (rec.type() != QCanBusFrame::DataFrame) return;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        QHash<uint64_t, QVector<SignalSeries *>>::const_iterator it = byId.constFind(CANFrameStore::idKey(rec.frameId(), pass ? -1 : rec.bus));
+        if (it == byId.constEnd()) continue;
+        for (SignalSeries *s : it.value()) appendSample(*s, row);
+    }
+}
+
+void SignalSeriesStore::reportMemory(QVector<MemoryUsage> &out) const
+{
+    using MemoryAccounting::bytesOf;
+    if (series.isEmpty()) return;
+    qint64 bytes = bytesOf(series) + bytesOf(byId);
+    for (const SignalSeries *s : series)
+        bytes += static_cast<qint64>(sizeof(SignalSeries)) + bytesOf(s->sequences) + bytesOf(s->stamps) + bytesOf(s->values);
+    out.append({"Decoded signal series", QString("%1 series, shared by the graph and signal windows").arg(series.count()), bytes});
+}
+
+qint64 SignalSeriesStore::purgeMemory()
+{
+    QVector<MemoryUsage> before;
+    reportMemory(before);
+    //a window holding a copy keeps the old buffer alive until it lets go, so this only helps once they catch up
+    for (SignalSeries *s : qAsConst(series))
+    {
+        s->sequences.squeeze();
+        s->stamps.squeeze();
+        s->values.squeeze();
+    }
+    QVector<MemoryUsage> after;
+    reportMemory(after);
+    return (before.isEmpty() || after.isEmpty()) ? 0 : before[0].bytes - after[0].bytes;
+}
+
+/*
+ * Samples whose frames the frame store has evicted. They're only taken off once a good run of them has built up
+ * (a quarter of the series or SIGNALSERIES_MIN_TRIM, whichever is more) so moving the rest down is a constant per
+ * sample. Readers go by sequence number so they don't care when exactly that happens.
+ */
+void SignalSeriesStore::trimEvicted()
+{
+    quint64 base = frames->baseSequence();
+    if (base == 0) return;
+    for (SignalSeries *s : series)
+    {
+        int old = s->indexOfSequence(base);
+        if (old < std::max(SIGNALSERIES_MIN_TRIM, s->count() / 4)) continue;
+        s->sequences.remove(0, old);
+        s->stamps.remove(0, old);
+        s->values.remove(0, old);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef SIGNALSERIESSTORE_H
+#define SIGNALSERIESSTORE_H
+
+#include <QHash>
+#include <QVector>
+#include "framestorefollower.h"
+#include "utility.h"
+#include "memoryaccounting.h"
+
+class DBC_SIGNAL;
+
+/*
+ * What a series holds: one bit range out of the data frames of an ID, on one bus or on any of them (bus -1). When
+ * signal is set only frames that signal is actually in get a sample, which is how multiplexed signals are done.
+ * Plain signals don't need it, the bit range alone says it all, so leaving it off lets a DBC graph and a hand made
+ * graph of the same bits share one series.
+ */
+struct SignalSeriesKey
+{
+    uint32_t id = 0;
+    int bus = -1;
+    int startBit = 0;
+    int bits = 0;
+    bool intel = true;
+    bool isSigned = false;
+    const DBC_SIGNAL *signal = nullptr;
+
+    //the layout getExtractor() would use, with the signal set only if it's multiplexed
+    static SignalSeriesKey forSignal(const DBC_SIGNAL *sig, int bus = -1);
+
+    bool operator==(const SignalSeriesKey &other) const
+    {
+        return id == other.id && bus == other.bus && startBit == other.startBit && bits == other.bits
+                && intel == other.intel && isSigned == other.isSigned && signal == other.signal;
+    }
+};
+
+//the decoded samples of one key, oldest first. Values are straight out of the extractor, scaling is up to the reader
+class SignalSeries
+{
+public:
+    SignalSeriesKey key;
+    QVector<quint64> sequences; //sequence number of the frame each sample came from, always rising
+    QVector<uint64_t> stamps; //frame timestamps, microseconds
+    QVector<int64_t> values;
+
+    int count() const { return values.count(); }
+    //first sample from the frame with this sequence number or a later one. count() when there isn't one yet
+    int indexOfSequence(quint64 seq) const;
+
+private:
+    friend class SignalSeriesStore;
+    SignalExtractor extractor;
+    int refs = 0;
+};
+
+/*
+ * Decoded signal values shared between every window looking at one frame store. Asking for the same signal (or
+ * bit range) from the graphing window and the signal viewer and so on gets the same series, so a frame is decoded
+ * once per signal no matter how many windows show it.
+ *
+ * A series gets built the first time something acquires it, from the frame store's per ID index, and from then
+ * on is kept up to date as frames come in. It goes away when the last user releases it. New frames are looked up
+ * by bus and ID once each and only decoded for the series that want them.
+ *
+ * The store is a FrameStoreFollower made in a window's constructor ahead of the window's own framesUpdated
+ * connect, so by the time a window hears about new frames its series already have them. A window should remember how far it has read by sequence number
+ * (nextSequence / indexOfSequence) rather than by index since samples from frames the store evicted get dropped
+ * off the front. A full reset (-1 / -2) rebuilds every live series before the windows get told.
+ *
+ * GUI thread only. A background job that wants a series should take copies of the vectors, that's cheap since
+ * they're implicitly shared.
+ */
+class SignalSeriesStore : public FrameStoreFollower, public MemoryReporter
+{
+    Q_OBJECT
+
+public:
+    static SignalSeriesStore *forFrames(const CANFrameStore *frames);
+
+    const SignalSeries *acquire(const SignalSeriesKey &key);
+    void release(const SignalSeries *series);
+
+    void reportMemory(QVector<MemoryUsage> &out) const override;
+    qint64 purgeMemory() override; //spare capacity of the series only, they're all still in use
+
+protected:
+    void clearState() override;
+    void add(int row) override;
+    void addAll() override;
+    void caughtUp() override { trimEvicted(); }
+
+private:
+    explicit SignalSeriesStore(const CANFrameStore *frames);
+    void fill(SignalSeries &series);
+    void appendSample(SignalSeries &series, int row);
+    void trimEvicted();
+
+    QVector<SignalSeries *> series;
+    QHash<uint64_t, QVector<SignalSeries *>> byId; //CANFrameStore::idKey(id, bus), bus -1 for any bus
+};
+
+#endif // SIGNALSERIESSTORE_H
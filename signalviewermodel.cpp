@@ -0,0 +1,227 @@
+#include "signalviewermodel.h"
+#include "dbc/dbc_classes.h"
+#include "signalseriesstore.h"
+#include <QtMath>
+
+SignalViewerModel::SignalViewerModel(SignalSeriesStore *store, QObject *parent)
+    : QAbstractTableModel(parent), store(store)
+{
+}
+
+SignalViewerModel::~SignalViewerModel()
+{
+    for (const Row &row : qAsConst(rows))
+    {
+        if (row.series) store->release(row.series);
+    }
+}
+
+QVariant SignalViewerModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) return QVariant();
+    if (orientation == Qt::Vertical) return QString::number(section + 1);
+
+    switch (section)
+    {
+    case NODE_COL:
+        return tr("Node");
+    case SIGNAL_COL:
+        return tr("Signal");
+    case VALUE_COL:
+        return tr("Value");
+    case MIN_COL:
+        return tr("Min");
+    case MAX_COL:
+        return tr("Max");
+    case RATE_COL:
+        return tr("Rate (Hz)");
+    }
+    return QVariant();
+}
+
+int SignalViewerModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return COLUMNS;
+}
+
+int SignalViewerModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return rows.count();
+}
+
+QVariant SignalViewerModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.count() || role != Qt::DisplayRole) return QVariant();
+    const Row &row = rows.at(index.row());
+
+    switch (index.column())
+    {
+    case NODE_COL:
+        return row.sig->parentMessage->sender->name;
+    case SIGNAL_COL:
+        return row.sig->name;
+    case VALUE_COL:
+        return row.value;
+    case MIN_COL:
+        if (!row.hasValue || !row.series) return QString();
+        return QString::number(row.min);
+    case MAX_COL:
+        if (!row.hasValue || !row.series) return QString();
+        return QString::number(row.max);
+    case RATE_COL:
+        if (row.rate < 0) return QString();
+        return QString::number(row.rate, 'f', 1);
+    }
+    return QVariant();
+}
+
+void SignalViewerModel::addSignal(DBC_SIGNAL *sig)
+{
+    Row row;
+    row.sig = sig;
+    row.series = (sig->valType == STRING) ? nullptr : store->acquire(SignalSeriesKey::forSignal(sig));
+
+    beginInsertRows(QModelIndex(), rows.count(), rows.count());
+    rows.append(row);
+    endInsertRows();
+    if (!row.series) rebuildTextIndex();
+}
+
+void SignalViewerModel::removeSignal(int row)
+{
+    if (row < 0 || row >= rows.count()) return;
+    beginRemoveRows(QModelIndex(), row, row);
+    if (rows.at(row).series) store->release(rows.at(row).series);
+    rows.remove(row);
+    endRemoveRows();
+    rebuildTextIndex();
+}
+
+void SignalViewerModel::clear()
+{
+    beginResetModel();
+    for (const Row &row : qAsConst(rows))
+    {
+        if (row.series) store->release(row.series);
+    }
+    rows.clear();
+    textRows.clear();
+    endResetModel();
+}
+
+DBC_SIGNAL *SignalViewerModel::signalAt(int row) const
+{
+    if (row < 0 || row >= rows.count()) return nullptr;
+    return rows.at(row).sig;
+}
+
+QVector<uint32_t> SignalViewerModel::textIds() const
+{
+    QVector<uint32_t> ids;
+    for (auto it = textRows.constBegin(); it != textRows.constEnd(); ++it) ids.append(it.key());
+    return ids;
+}
+
+void SignalViewerModel::rebuildTextIndex()
+{
+    textRows.clear();
+    for (int i = 0; i < rows.count(); i++)
+    {
+        if (!rows.at(i).series) textRows[rows.at(i).sig->parentMessage->ID].append(i);
+    }
+}
+
+//min, max and the rate, inline as each new sample goes by
+void SignalViewerModel::sample(Row &row, double value, uint64_t stamp)
+{
+    if (!row.hasValue)
+    {
+        row.min = row.max = value;
+        row.windowStart = stamp;
+        row.windowSamples = 0;
+    }
+    else
+    {
+        row.min = qMin(row.min, value);
+        row.max = qMax(row.max, value);
+    }
+    row.hasValue = true;
+
+    if (stamp < row.windowStart) row.windowStart = stamp; //timestamps went backwards, start the window over
+    row.windowSamples++;
+    if (stamp - row.windowStart >= SIGNALVIEWER_RATE_WINDOW_US)
+    {
+        row.rate = (row.windowSamples - 1) * 1000000.0 / static_cast<double>(stamp - row.windowStart);
+        row.windowStart = stamp;
+        row.windowSamples = 1;
+    }
+    row.changed = true;
+}
+
+void SignalViewerModel::textFrames(const QVector<CANFrame> &frames)
+{
+    QString text;
+    for (const CANFrame &frame : frames)
+    {
+        auto it = textRows.constFind(frame.frameId());
+        if (it == textRows.constEnd()) continue;
+        for (int idx : it.value())
+        {
+            Row &row = rows[idx];
+            if (!row.sig->isSignalInMessage(frame) || !row.sig->processAsText(frame, text, false)) continue;
+            sample(row, 0.0, frame.timeStamp().microSeconds());
+            row.value = text;
+        }
+    }
+}
+
+void SignalViewerModel::refresh()
+{
+    int first = -1, last = -1;
+    for (int i = 0; i < rows.count(); i++)
+    {
+        Row &row = rows[i];
+        const SignalSeries *series = row.series;
+        if (series)
+        {
+            int from = series->indexOfSequence(row.nextSequence);
+            int count = series->count();
+            if (from < count)
+            {
+                for (int s = from; s < count; s++) sample(row, row.sig->physicalValue(series->values.at(s)), series->stamps.at(s));
+                row.nextSequence = series->sequences.at(count - 1) + 1;
+
+                //the text is only made again when the newest value isn't the one already shown
+                int64_t raw = series->values.at(count - 1);
+                if (row.value.isEmpty() || raw != row.lastRaw)
+                {
+                    row.lastRaw = raw;
+                    double value = row.sig->physicalValue(raw);
+                    bool isInteger = (row.sig->valType == SIGNED_INT || row.sig->valType == UNSIGNED_INT) && (row.sig->factor == qFloor(row.sig->factor));
+                    row.value = row.sig->makePrettyOutput(value, static_cast<int64_t>(value), false, isInteger);
+                }
+            }
+        }
+        if (!row.changed) continue;
+        row.changed = false;
+        if (first < 0) first = i;
+        last = i;
+    }
+    if (first >= 0) emit dataChanged(index(first, VALUE_COL), index(last, RATE_COL), QVector<int>() << Qt::DisplayRole);
+}
+
+void SignalViewerModel::restart()
+{
+    for (Row &row : rows)
+    {
+        row.nextSequence = 0;
+        row.hasValue = false;
+        row.value.clear();
+        row.rate = -1.0;
+        row.changed = false;
+    }
+    if (!rows.isEmpty()) emit dataChanged(index(0, VALUE_COL), index(rows.count() - 1, RATE_COL));
+    refresh();
+}
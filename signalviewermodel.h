@@ -0,0 +1,82 @@
+#ifndef SIGNALVIEWERMODEL_H
+#define SIGNALVIEWERMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QVector>
+#include "can_structs.h"
+
+class DBC_SIGNAL;
+class SignalSeries;
+class SignalSeriesStore;
+
+//stats are worked out over at least this much frame time so a slow signal still gets a steady rate
+#define SIGNALVIEWER_RATE_WINDOW_US     1000000
+
+/*
+ * The signals the signal viewer watches, one row each. Numeric signals read the new samples of their series from
+ * the SignalSeriesStore when refresh() is called, text signals are given their frames through textFrames(), looked
+ * up by ID so a frame only gets decoded for the signals that are in it. Either way a row only keeps its newest
+ * value, its min / max and how often it comes. refresh() only tells the view about rows that actually changed.
+ */
+class SignalViewerModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        NODE_COL = 0,
+        SIGNAL_COL,
+        VALUE_COL,
+        MIN_COL,
+        MAX_COL,
+        RATE_COL,
+        COLUMNS
+    };
+
+    explicit SignalViewerModel(SignalSeriesStore *store, QObject *parent = nullptr);
+    virtual ~SignalViewerModel();
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void addSignal(DBC_SIGNAL *sig);
+    void removeSignal(int row);
+    void clear();
+    DBC_SIGNAL *signalAt(int row) const;
+    int count() const { return rows.count(); }
+
+    QVector<uint32_t> textIds() const; //messages with text signals in them, for the frame subscription
+    void textFrames(const QVector<CANFrame> &frames);
+    void refresh(); //catches up with the series and pushes whatever changed to the view
+    void restart(); //frames were cleared or replaced, every row starts over
+
+private:
+    struct Row
+    {
+        DBC_SIGNAL *sig;
+        const SignalSeries *series; //nullptr for text signals
+        quint64 nextSequence = 0; //first frame not looked at yet
+        bool hasValue = false;
+        int64_t lastRaw = 0;
+        QString value;
+        double min = 0.0;
+        double max = 0.0;
+        double rate = -1.0; //frames per second, -1 until a window's worth
+        uint64_t windowStart = 0; //frame time the rate window started at
+        int windowSamples = 0;
+        bool changed = false;
+    };
+
+    void sample(Row &row, double value, uint64_t stamp);
+    void rebuildTextIndex();
+
+    SignalSeriesStore *store;
+    QVector<Row> rows;
+    QHash<uint32_t, QVector<int>> textRows; //rows of text signals by message ID
+};
+
+#endif // SIGNALVIEWERMODEL_H
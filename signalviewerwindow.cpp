@@ -2,13 +2,12 @@
 #include "ui_signalviewerwindow.h"
 #include "helpwindow.h"
 #include "mainwindow.h"
+#include "windowupdategate.h"
 #include "utility.h"
+#include "pipelinetrace.h"
 #include <QDebug>
 
-#define MSG_COL     1
-#define VALUE_COL   2
-
-SignalViewerWindow::SignalViewerWindow(const QVector<CANFrame> *frames, QWidget *parent) :
+SignalViewerWindow::SignalViewerWindow(const CANFrameStore *frames, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::SignalViewerWindow)
 {
@@ -16,12 +15,19 @@ SignalViewerWindow::SignalViewerWindow(const QVector<CANFrame> *frames, QWidget
     setWindowFlags(Qt::Window);
 
     modelFrames = frames;
-
-    QStringList headers;
-    headers << "Node" << "Signal" << "Value";
-    ui->tableViewer->setHorizontalHeaderLabels(headers);
-    ui->tableViewer->setColumnWidth(0, 100);
-    ui->tableViewer->setColumnWidth(1, 150);
+    dbcHandler = DBCHandler::getReference();
+    currentlySelectedMsg = nullptr;
+    textSubscription = 0;
+    //hooked up ahead of this window so the series are current by the time updatedFrames runs
+    seriesStore = SignalSeriesStore::forFrames(modelFrames);
+
+    model = new SignalViewerModel(seriesStore, this);
+    sortModel = new QSortFilterProxyModel(this);
+    sortModel->setSourceModel(model);
+    ui->tableViewer->setModel(sortModel);
+    ui->tableViewer->setColumnWidth(SignalViewerModel::NODE_COL, 100);
+    ui->tableViewer->setColumnWidth(SignalViewerModel::SIGNAL_COL, 150);
+    ui->tableViewer->sortByColumn(-1, Qt::AscendingOrder); //in the order they were added until a header is clicked
 
     QSettings settings;
     QFont sysFont;
@@ -40,18 +46,23 @@ SignalViewerWindow::SignalViewerWindow(const QVector<CANFrame> *frames, QWidget
     QHeaderView *verticalHeader = ui->tableViewer->verticalHeader();
     verticalHeader->setFont(QFont());
 
-    dbcHandler = DBCHandler::getReference();
-    currentlySelectedMsg = nullptr;
+    ui->ckStats->setChecked(settings.value("SignalViewer/ShowStats", false).toBool());
+    showStats(ui->ckStats->isChecked());
+
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(SIGNALVIEWER_REFRESH_MS);
+    connect(&refreshTimer, &QTimer::timeout, this, &SignalViewerWindow::refreshView);
 
     connect(ui->cbNodes, SIGNAL(currentIndexChanged(int)), this, SLOT(loadMessages(int)));
     connect(ui->cbMessages, SIGNAL(currentIndexChanged(int)), this, SLOT(loadSignals(int)));
     connect(ui->btnAdd, SIGNAL(clicked(bool)), this, SLOT(addSignal()));
-    connect(MainWindow::getReference(), SIGNAL(framesUpdated(int)), this, SLOT(updatedFrames(int)));
+    WindowUpdateGate::attach(this, [this](int numFrames) { updatedFrames(numFrames); });
     connect(ui->btnRemove, SIGNAL(clicked(bool)), this, SLOT(removeSelectedSignal()));
     connect(ui->btnSave, SIGNAL(clicked(bool)), this, SLOT(saveSignalsFile()));
     connect(ui->btnLoad, SIGNAL(clicked(bool)), this, SLOT(loadSignalsFile()));
     connect(ui->btnAppend, SIGNAL(clicked(bool)), this, SLOT(appendSignalsFile()));
     connect(ui->btnClear, SIGNAL(clicked(bool)), this, SLOT(clearSignalsTable()));
+    connect(ui->ckStats, &QCheckBox::toggled, this, &SignalViewerWindow::showStats);
 
     loadNodes();
 }
@@ -61,66 +72,73 @@ SignalViewerWindow::~SignalViewerWindow()
     delete ui;
 }
 
+/*
+ * Numeric signals come out of the shared series store which already decoded the new frames, and text signals get
+ * their frames from the frame bus. Either way the model only looks at what's new when the refresh timer goes off,
+ * so a few thousand frames a second still only update the view SIGNALVIEWER_REFRESH_MS apart.
+ */
 void SignalViewerWindow::updatedFrames(int numFrames)
 {
-    CANFrame thisFrame;
-
-    if (numFrames == -1) //all frames deleted. Don't care
+    TRACE_SCOPE("SignalViewerWindow::updatedFrames");
+    if (numFrames < 0)
     {
+        //cleared or replaced, the series were rebuilt from whatever's there now
+        refreshTimer.stop();
+        model->restart();
+        return;
     }
-    else if (numFrames == -2) //all new set of frames. Reset
-    {
-        for (int i = 0; i < modelFrames->count(); i++)
-        {
-            thisFrame = modelFrames->at(i);
-            processFrame(thisFrame);
-        }
-    }
-    else //just got some new frames. See if they are relevant.
-    {
-        if (numFrames > modelFrames->count()) return;
+    if (!refreshTimer.isActive()) refreshTimer.start();
+}
 
-        for (int i = modelFrames->count() - numFrames; i < modelFrames->count(); i++)
-        {
-            thisFrame = modelFrames->at(i);
-            processFrame(thisFrame);
-        }
-    }
+void SignalViewerWindow::refreshView()
+{
+    TRACE_SCOPE("SignalViewerWindow::refreshView");
+    model->refresh();
+}
+
+void SignalViewerWindow::showStats(bool show)
+{
+    ui->tableViewer->setColumnHidden(SignalViewerModel::MIN_COL, !show);
+    ui->tableViewer->setColumnHidden(SignalViewerModel::MAX_COL, !show);
+    ui->tableViewer->setColumnHidden(SignalViewerModel::RATE_COL, !show);
+    QSettings settings;
+    settings.setValue("SignalViewer/ShowStats", show);
 }
 
-void SignalViewerWindow::processFrame(CANFrame &frame)
+//subscribed while there are text signals, to just their messages
+void SignalViewerWindow::updateTextSubscription()
 {
-    QString sigString;
-    DBC_SIGNAL *sig;
-    for (int i = 0; i < signalList.count(); i++)
+    FrameBus *bus = MainWindow::getReference()->getFrameBus();
+    QVector<uint32_t> ids = model->textIds();
+    if (ids.isEmpty())
     {
-        sig = signalList.at(i);
-        if (!sig) return;
-        if (sig->parentMessage->ID == frame.frameId())
-        {
-            if (sig->isSignalInMessage(frame)) //filter out multiplexed signals that aren't in this message.
-            {
-                if (sig->processAsText(frame, sigString, false)) //if true we could interpret the signal so update it in the list
-                {
-                    QTableWidgetItem *item = ui->tableViewer->item(i, VALUE_COL);
-                    if (!item)
-                    {
-                        item = new QTableWidgetItem(sigString);
-                        ui->tableViewer->setItem(i, VALUE_COL, item);
-                    }
-                    else item->setText(sigString);
-                }
-            }
-        }
+        if (textSubscription) bus->unsubscribe(textSubscription);
+        textSubscription = 0;
+        return;
     }
+
+    QVector<FrameBusFilter> filters;
+    for (uint32_t id : qAsConst(ids)) filters.append(FrameBusFilter::exact(id));
+    if (textSubscription)
+    {
+        bus->setFilters(textSubscription, filters);
+        return;
+    }
+    FrameBus::Options subscription;
+    subscription.filters = filters;
+    textSubscription = bus->subscribe(this, subscription, [this](const QVector<CANFrame> &frames)
+    {
+        model->textFrames(frames);
+        if (!refreshTimer.isActive()) refreshTimer.start();
+    });
 }
 
 void SignalViewerWindow::removeSelectedSignal()
 {
-    int selRow = ui->tableViewer->currentRow();
-    if (selRow < 0) return; //no selected row
-    signalList.removeAt(selRow);
-    ui->tableViewer->removeRow(selRow);
+    QModelIndex selected = ui->tableViewer->currentIndex();
+    if (!selected.isValid()) return; //no selected row
+    model->removeSignal(sortModel->mapToSource(selected).row());
+    updateTextSubscription();
 }
 
 void SignalViewerWindow::loadNodes()
@@ -224,14 +242,9 @@ void SignalViewerWindow::addSignal()
 
 void SignalViewerWindow::addSignal(DBC_SIGNAL *sig)
 {
-    signalList.append(sig);
-
-    int rowIdx = ui->tableViewer->rowCount();
-    ui->tableViewer->insertRow(rowIdx);
-    QTableWidgetItem *nodeitem = new QTableWidgetItem(sig->parentMessage->sender->name);
-    ui->tableViewer->setItem(rowIdx, 0, nodeitem);
-    QTableWidgetItem *msgitem = new QTableWidgetItem(sig->name);
-    ui->tableViewer->setItem(rowIdx, 1, msgitem);
+    model->addSignal(sig);
+    model->refresh(); //whatever is already captured, no need to wait for the next frame
+    if (sig->valType == STRING) updateTextSubscription();
 }
 
 void SignalViewerWindow::saveSignalsFile()
@@ -267,8 +280,8 @@ void SignalViewerWindow::clearSignalsTable(bool askForConfirmation)
         }
     }
 
-    signalList.clear();
-    ui->tableViewer->setRowCount(0);
+    model->clear();
+    updateTextSubscription();
 }
 
 void SignalViewerWindow::saveDefinitions()
@@ -299,9 +312,9 @@ void SignalViewerWindow::saveDefinitions()
             return;
 
         DBC_SIGNAL *sig;
-        for (int i = 0; i < signalList.count(); i++)
+        for (int i = 0; i < model->count(); i++)
         {
-            sig = signalList.at(i);
+            sig = model->signalAt(i);
 
             outFile->write("SV1");
             outFile->putChar(',');
@@ -2,7 +2,15 @@
 #define SIGNALVIEWERWINDOW_H
 
 #include <QDialog>
+#include <QSortFilterProxyModel>
+#include <QTimer>
 #include "dbc/dbchandler.h"
+#include "canframestore.h"
+#include "signalseriesstore.h"
+#include "signalviewermodel.h"
+
+//the view is brought up to date at most this often however fast frames come in
+#define SIGNALVIEWER_REFRESH_MS     100
 
 namespace Ui {
 class SignalViewerWindow;
@@ -13,7 +21,7 @@ class SignalViewerWindow : public QDialog
     Q_OBJECT
 
 public:
-    explicit SignalViewerWindow(const QVector<CANFrame> *frames, QWidget *parent = 0);
+    explicit SignalViewerWindow(const CANFrameStore *frames, QWidget *parent = 0);
     ~SignalViewerWindow();
 
 private slots:
@@ -31,6 +39,8 @@ private slots:
     void clearSignalsTable(bool);
     void saveDefinitions();
     void loadDefinitions(bool);
+    void refreshView();
+    void showStats(bool show);
 
 private:
     Ui::SignalViewerWindow *ui;
@@ -38,10 +48,15 @@ private:
 
     DBC_MESSAGE *currentlySelectedMsg;
 
-    QList<DBC_SIGNAL *> signalList;
-    const QVector<CANFrame> *modelFrames;
+    const CANFrameStore *modelFrames;
+    SignalSeriesStore *seriesStore;
+    SignalViewerModel *model;
+    QSortFilterProxyModel *sortModel;
+    QTimer refreshTimer; //single shot, started by the first frames since the last refresh
+
+    int textSubscription; //frame bus handle, 0 while there are no text signals
 
-    void processFrame(CANFrame &frame);
+    void updateTextSubscription();
 };
 
 #endif // SIGNALVIEWERWINDOW_H
@@ -0,0 +1,42 @@
+# Benchmarks for the ingest, decode and file I/O paths. Builds against all of SavvyCAN's own sources (everything
+# SavvyCAN.pro lists except main.cpp) so it always measures the code as it's shipped. See main.cpp for the output.
+include(../../SavvyCAN.pro)
+
+QT += testlib
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = savvycan_bench
+
+# SavvyCAN.pro's file lists are relative to the top of the tree
+APP_SOURCES = $$SOURCES
+APP_HEADERS = $$HEADERS
+APP_FORMS = $$FORMS
+APP_RESOURCES = $$RESOURCES
+SOURCES =
+HEADERS =
+FORMS =
+RESOURCES =
+for(file, APP_SOURCES): !equals(file, main.cpp): SOURCES += $$PWD/../../$$file
+for(file, APP_HEADERS): HEADERS += $$PWD/../../$$file
+for(file, APP_FORMS): FORMS += $$PWD/../../$$file
+for(file, APP_RESOURCES): RESOURCES += $$PWD/../../$$file
+
+INCLUDEPATH += $$PWD/../.. $$PWD/../../connections
+
+# nothing of the app's gets installed from here
+INSTALLS =
+QMAKE_INFO_PLIST =
+ICON =
+DISTFILES =
+
+SOURCES += \
+    main.cpp \
+    bench_fileio.cpp \
+    bench_decode.cpp \
+    bench_model.cpp
+
+HEADERS += \
+    bench_frames.h \
+    bench_fileio.h \
+    bench_decode.h \
+    bench_model.h
@@ -0,0 +1,226 @@
+#include <QtTest>
+
+#include "bench_decode.h"
+#include "bench_frames.h"
+#include "utility.h"
+#include "dbc/dbchandler.h"
+
+//payloads each decode benchmark goes through per iteration
+#define BENCH_DECODE_FRAMES 4096
+
+void BenchDecode::initTestCase()
+{
+    frames = makeBenchFrames(BENCH_DECODE_FRAMES);
+}
+
+static void addLayouts()
+{
+    QTest::addColumn<int>("startBit");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("intel");
+    QTest::addColumn<bool>("isSigned");
+
+    QTest::newRow("intel 8 bit")            << 0  << 8  << true  << false;
+    QTest::newRow("intel 16 bit")           << 8  << 16 << true  << false;
+    QTest::newRow("intel 13 bit signed")    << 19 << 13 << true  << true;
+    QTest::newRow("intel 64 bit")           << 0  << 64 << true  << false;
+    QTest::newRow("motorola 16 bit")        << 7  << 16 << false << false;
+    QTest::newRow("motorola 12 bit signed") << 23 << 12 << false << true;
+}
+
+void BenchDecode::processIntegerSignal_data()
+{
+    addLayouts();
+}
+
+void BenchDecode::processIntegerSignal()
+{
+    QFETCH(int, startBit);
+    QFETCH(int, size);
+    QFETCH(bool, intel);
+    QFETCH(bool, isSigned);
+
+    int64_t sum = 0;
+    QBENCHMARK
+    {
+        for (const CANFrame &frame : frames)
+            sum += Utility::processIntegerSignal(frame.payload(), startBit, size, intel, isSigned);
+    }
+    QVERIFY(sum != 1); //keeps the loop from being thrown away
+}
+
+void BenchDecode::signalExtractor_data()
+{
+    addLayouts();
+}
+
+void BenchDecode::signalExtractor()
+{
+    QFETCH(int, startBit);
+    QFETCH(int, size);
+    QFETCH(bool, intel);
+    QFETCH(bool, isSigned);
+
+    SignalExtractor extractor(startBit, size, intel, isSigned);
+    int64_t sum = 0;
+    QBENCHMARK
+    {
+        for (const CANFrame &frame : frames) sum += extractor.extract(frame.payload());
+    }
+    //has to agree with the bit by bit version or the numbers above mean nothing
+    for (const CANFrame &frame : frames)
+        QCOMPARE(extractor.extract(frame.payload()), Utility::processIntegerSignal(frame.payload(), startBit, size, intel, isSigned));
+    QVERIFY(sum != 1);
+}
+
+//a temperature looking signal with a few named values so the text decoders have a lookup to do
+static DBC_SIGNAL makeBenchSignal(const QString &name, int startBit, int size, bool intel)
+{
+    DBC_SIGNAL sig;
+    sig.name = name;
+    sig.startBit = startBit;
+    sig.signalSize = size;
+    sig.intelByteOrder = intel;
+    sig.valType = UNSIGNED_INT;
+    sig.factor = 0.1;
+    sig.bias = -40.0;
+    sig.min = -40.0;
+    sig.max = 6513.5;
+    sig.unitName = "C";
+    for (int v = 0; v < 16; v++)
+    {
+        DBC_VAL_ENUM_ENTRY entry;
+        entry.value = v * 1000;
+        entry.descript = "VAL_" + QString::number(v);
+        sig.valList.append(entry);
+    }
+    return sig;
+}
+
+void BenchDecode::signalDecoders_data()
+{
+    QTest::addColumn<int>("decoder");
+
+    QTest::newRow("processAsDouble") << 0;
+    QTest::newRow("processAsInt")    << 1;
+    QTest::newRow("processAsText")   << 2;
+    QTest::newRow("decodeValue")     << 3;
+    QTest::newRow("decodeText")      << 4;
+}
+
+void BenchDecode::signalDecoders()
+{
+    QFETCH(int, decoder);
+
+    DBC_SIGNAL sig = makeBenchSignal("BenchTemp", 8, 16, true);
+    sig.prepare();
+    double total = 0.0;
+    int32_t intValue, muxValue;
+    double value;
+    QString text;
+
+    QBENCHMARK
+    {
+        for (const CANFrame &frame : frames)
+        {
+            const uint8_t *data = reinterpret_cast<const uint8_t *>(frame.payload().constData());
+            switch (decoder)
+            {
+            case 0:
+                sig.processAsDouble(frame, value);
+                total += value;
+                break;
+            case 1:
+                sig.processAsInt(frame, intValue);
+                total += intValue;
+                break;
+            case 2:
+                sig.processAsText(frame, text);
+                total += text.length();
+                break;
+            case 3:
+                sig.decodeValue(data, frame.payload().length(), value, muxValue);
+                total += value;
+                break;
+            case 4:
+                text.clear();
+                sig.decodeText(frame, text);
+                total += text.length();
+                break;
+            }
+        }
+    }
+    QVERIFY(total != 1.0);
+}
+
+//every signal of a message in one go, the way the signal views decode
+void BenchDecode::decodeSignals()
+{
+    DBC_MESSAGE msg;
+    msg.ID = 0x1E5;
+    msg.len = 8;
+    for (int i = 0; i < 8; i++)
+    {
+        DBC_SIGNAL sig = makeBenchSignal("Sig" + QString::number(i), i * 8, 8, (i & 1) == 0);
+        if (!sig.intelByteOrder) sig.startBit = i * 8 + 7;
+        sig.parentMessage = &msg;
+        msg.sigHandler->addSignal(sig);
+    }
+    for (int i = 0; i < msg.sigHandler->getCount(); i++) msg.sigHandler->findSignalByIdx(i)->prepare();
+
+    double values[8];
+    uint64_t validBits[1];
+    int decoded = 0;
+    QBENCHMARK
+    {
+        for (const CANFrame &frame : frames) decoded += msg.decodeSignals(frame, values, validBits, 8);
+    }
+    QVERIFY(decoded > 0);
+}
+
+void BenchDecode::findMsgByID_data()
+{
+    QTest::addColumn<int>("criteria");
+
+    QTest::newRow("exact") << static_cast<int>(EXACT);
+    QTest::newRow("J1939") << static_cast<int>(J1939);
+    QTest::newRow("GMLAN") << static_cast<int>(GMLAN);
+}
+
+//a DBC about the size of a whole vehicle's, looked up with a mix of IDs it has and IDs it doesn't
+void BenchDecode::findMsgByID()
+{
+    QFETCH(int, criteria);
+
+    DBCMessageHandler handler;
+    handler.setMatchingCriteria(static_cast<MatchingCriteria_t>(criteria));
+    for (int i = 0; i < 1000; i++)
+    {
+        DBC_MESSAGE msg;
+        if (criteria == J1939) msg.ID = 0x18000000u | (static_cast<uint32_t>(0xF000 + i) << 8) | 0x00;
+        else if (criteria == GMLAN) msg.ID = 0x10000000u | (static_cast<uint32_t>(i) << 13);
+        else msg.ID = static_cast<uint32_t>(i) * 2; //every other ID so half the lookups miss
+        msg.extendedID = (criteria != EXACT);
+        msg.name = "MSG_" + QString::number(i);
+        msg.len = 8;
+        handler.addMessage(msg);
+    }
+
+    QVector<uint32_t> lookups;
+    quint32 seed = 54321;
+    for (int i = 0; i < BENCH_DECODE_FRAMES; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t n = (seed >> 12) % 2000;
+        if (criteria == J1939) lookups.append(0x18000000u | ((0xF000 + n) << 8) | (seed & 0xFF));
+        else if (criteria == GMLAN) lookups.append(0x10000000u | (n << 13) | (seed & 0x1FFF));
+        else lookups.append(n);
+    }
+
+    int found = 0;
+    QBENCHMARK
+    {
+        for (uint32_t id : lookups) if (handler.findMsgByID(id)) found++;
+    }
+    QVERIFY(found > 0);
+}
@@ -0,0 +1,29 @@
+#ifndef BENCH_DECODE_H
+#define BENCH_DECODE_H
+
+#include <QObject>
+#include <QVector>
+#include "can_structs.h"
+
+//signal extraction, DBC signal decoding and DBC message lookup
+class BenchDecode: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void processIntegerSignal_data();
+    void processIntegerSignal();
+    void signalExtractor_data();
+    void signalExtractor();
+    void signalDecoders_data();
+    void signalDecoders();
+    void decodeSignals();
+    void findMsgByID_data();
+    void findMsgByID();
+
+private:
+    QVector<CANFrame> frames;
+};
+
+#endif // BENCH_DECODE_H
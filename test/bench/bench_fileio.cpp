@@ -0,0 +1,92 @@
+#include <QtTest>
+#include <QSettings>
+
+#include "bench_fileio.h"
+#include "bench_frames.h"
+#include "framefileio.h"
+
+struct BenchFormat
+{
+    const char *name;
+    const char *extension;
+    bool (*save)(QString, const QVector<CANFrame>*);
+    bool (*load)(QString, QVector<CANFrame>*);
+};
+
+static const BenchFormat formats[] =
+{
+    {"GVRET CSV", "csv", FrameFileIO::saveNativeCSVFile, FrameFileIO::loadNativeCSVFile},
+    {"CRTD", "crtd", FrameFileIO::saveCRTDFile, FrameFileIO::loadCRTDFile},
+    {"Generic CSV", "csv", FrameFileIO::saveGenericCSVFile, FrameFileIO::loadGenericCSVFile},
+    {"BusMaster", "log", FrameFileIO::saveLogFile, FrameFileIO::loadLogFile},
+    {"Microchip", "can", FrameFileIO::saveMicrochipFile, FrameFileIO::loadMicrochipFile},
+    {"Vector trace", "trace", FrameFileIO::saveTraceFile, FrameFileIO::loadTraceFile},
+    {"IXXAT", "csv", FrameFileIO::saveIXXATFile, FrameFileIO::loadIXXATFile},
+    {"CAN-DO", "can", FrameFileIO::saveCANDOFile, FrameFileIO::loadCANDOFile},
+    {"Vehicle Spy", "csv", FrameFileIO::saveVehicleSpyFile, FrameFileIO::loadVehicleSpyFile},
+    {"candump", "log", FrameFileIO::saveCanDumpFile, FrameFileIO::loadCanDumpFile},
+    {"Cabana", "csv", FrameFileIO::saveCabanaFile, FrameFileIO::loadCabanaFile},
+    {"CANalyzer ASC", "asc", FrameFileIO::saveCanalyzerASC, FrameFileIO::loadCanalyzerASC},
+    {"CARBUS Analyzer", "trc", FrameFileIO::saveCARBUSAnalzyer, FrameFileIO::loadCARBUSAnalyzerFile},
+    {"SavvyCAN binary", "scb", FrameFileIO::saveBinaryNativeFile, FrameFileIO::loadBinaryNativeFile},
+    {"CANalyzer BLF", "blf", FrameFileIO::saveCanalyzerBLF, FrameFileIO::loadCanalyzerBLF},
+    {"Wireshark pcapng", "pcapng", FrameFileIO::saveWiresharkFile, FrameFileIO::loadWiresharkFile},
+};
+static const int numFormats = sizeof(formats) / sizeof(formats[0]);
+
+void BenchFileIO::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    //the loads should measure parsing, not writing sidecar indexes
+    QSettings settings;
+    settings.setValue("FileIO/TextLogIndex", false);
+    frames = makeBenchFrames(benchFrameCount());
+}
+
+QString BenchFileIO::fileFor(int format) const
+{
+    return dir.filePath(QString("bench%1.%2").arg(format).arg(formats[format].extension));
+}
+
+void BenchFileIO::save_data()
+{
+    QTest::addColumn<int>("format");
+    for (int i = 0; i < numFormats; i++) QTest::newRow(formats[i].name) << i;
+}
+
+void BenchFileIO::save()
+{
+    QFETCH(int, format);
+    bool ok = false;
+    QBENCHMARK_ONCE
+    {
+        ok = formats[format].save(fileFor(format), &frames);
+    }
+    QVERIFY(ok);
+}
+
+void BenchFileIO::load_data()
+{
+    save_data();
+}
+
+//reads back what save wrote, or writes it first when save was skipped
+void BenchFileIO::load()
+{
+    QFETCH(int, format);
+    if (!QFile::exists(fileFor(format))) QVERIFY(formats[format].save(fileFor(format), &frames));
+
+    QVector<CANFrame> loaded;
+    bool ok = false;
+    QBENCHMARK_ONCE
+    {
+        ok = formats[format].load(fileFor(format), &loaded);
+    }
+    QVERIFY(ok);
+    QCOMPARE(loaded.count(), frames.count());
+}
+
+void BenchFileIO::cleanupTestCase()
+{
+    frames.clear();
+}
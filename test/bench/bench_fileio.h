@@ -0,0 +1,29 @@
+#ifndef BENCH_FILEIO_H
+#define BENCH_FILEIO_H
+
+#include <QObject>
+#include <QTemporaryDir>
+#include <QVector>
+#include "can_structs.h"
+
+//every FrameFileIO format that can be both written and read back, on generated captures
+class BenchFileIO: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void save_data();
+    void save();
+    void load_data();
+    void load();
+    void cleanupTestCase();
+
+private:
+    QString fileFor(int format) const;
+
+    QTemporaryDir dir;
+    QVector<CANFrame> frames;
+};
+
+#endif // BENCH_FILEIO_H
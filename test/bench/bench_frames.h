@@ -0,0 +1,52 @@
+#ifndef BENCH_FRAMES_H
+#define BENCH_FRAMES_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+#include "can_structs.h"
+
+//frames the file and model benchmarks work on unless SAVVYCAN_BENCH_FRAMES says otherwise
+#define BENCH_DEFAULT_FRAMES 2000000
+
+static inline int benchFrameCount()
+{
+    bool ok;
+    int count = qEnvironmentVariableIntValue("SAVVYCAN_BENCH_FRAMES", &ok);
+    return (ok && count > 0) ? count : BENCH_DEFAULT_FRAMES;
+}
+
+/*
+ * Something shaped like a real capture: a few dozen IDs at different rates, standard and extended, two buses,
+ * timestamps going up by 100us. The payloads are made up but not constant so text formats have digits to write.
+ * Every call gives the same frames.
+ */
+static inline QVector<CANFrame> makeBenchFrames(int count, bool withFD = false)
+{
+    static const uint32_t ids[] = {0x0C1, 0x0C9, 0x0F1, 0x120, 0x1E5, 0x1F5, 0x2C3, 0x3C9, 0x4C1, 0x4F1,
+                                   0x52A, 0x5C4, 0x7E0, 0x7E8, 0x18DAF110, 0x18DA10F1, 0x18FEF100, 0x0CF00400};
+    const int numIds = sizeof(ids) / sizeof(ids[0]);
+    QVector<CANFrame> frames;
+    frames.reserve(count);
+    quint32 seed = 12345;
+    CANFrame frame;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t id = ids[(seed >> 16) % numIds];
+        frame.setExtendedFrameFormat(id > 0x7FF);
+        frame.setFrameId(id);
+        frame.bus = (seed >> 8) & 1;
+        frame.isReceived = true;
+        frame.setTimeStamp(QCanBusFrame::TimeStamp(0, 1000000 + static_cast<qint64>(i) * 100));
+        int len = (withFD && (i % 16) == 0) ? 64 : 8;
+        frame.setFlexibleDataRateFormat(len > 8);
+        QByteArray payload(len, 0);
+        for (int b = 0; b < len; b++) payload[b] = static_cast<char>((seed >> (b % 4) * 8) + b * 31 + i);
+        frame.setPayload(payload);
+        frames.append(frame);
+    }
+    return frames;
+}
+
+#endif // BENCH_FRAMES_H
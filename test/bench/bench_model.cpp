@@ -0,0 +1,187 @@
+#include <QtTest>
+
+#include "bench_model.h"
+#include "bench_frames.h"
+#include "canframemodel.h"
+#include "framesearch.h"
+#include "connections/canconmanager.h"
+
+//frames handed to the model at a time, about what a drain delivers on a busy bus
+#define BENCH_MODEL_BATCH 4096
+
+/*
+ * A connection with no device behind it. The benchmark fills its queue the way a reader thread would and has the
+ * manager drain it.
+ */
+class BenchConnection : public CANConnection
+{
+public:
+    explicit BenchConnection(int queueLen)
+        : CANConnection("bench", "", CANCon::NONE, 0, 500000, false, 0, 1, queueLen, false) {}
+
+    //as much of frames as fits, starting at from. Returns how many went in
+    int fill(const QVector<CANFrame> &frames, int from, int count)
+    {
+        int done = 0;
+        while (done < count)
+        {
+            int granted;
+            CANFrame *slots_p = getQueue().reserve(count - done, granted);
+            if (!slots_p) break;
+            for (int i = 0; i < granted; i++) slots_p[i] = frames.at((from + done + i) % frames.count());
+            getQueue().commit(granted);
+            done += granted;
+        }
+        return done;
+    }
+
+protected:
+    void piStarted() override {}
+    void piStop() override {}
+    void piSetBusSettings(int, CANBus) override {}
+    bool piGetBusSettings(int, CANBus&) override { return false; }
+    void piSuspend(bool) override {}
+    bool piSendFrame(const CANFrame&) override { return true; }
+};
+
+void BenchModel::initTestCase()
+{
+    frames = makeBenchFrames(benchFrameCount());
+}
+
+void BenchModel::drain_data()
+{
+    QTest::addColumn<int>("batch");
+
+    QTest::newRow("64 frames")    << 64;
+    QTest::newRow("1024 frames")  << 1024;
+    QTest::newRow("16384 frames") << 16384;
+}
+
+//queue to listener, everything refreshCanList does for one connection
+void BenchModel::drain()
+{
+    QFETCH(int, batch);
+
+    CANConManager *manager = CANConManager::getInstance();
+    BenchConnection conn(65536);
+    quint64 received = 0;
+    QMetaObject::Connection counter = QObject::connect(manager, &CANConManager::framesReceived,
+                                                       [&received](CANConnection*, const QVector<CANFrame>& pFrames) { received += pFrames.count(); });
+    manager->add(&conn);
+
+    int next = 0;
+    quint64 queued = 0;
+    QBENCHMARK
+    {
+        int added = conn.fill(frames, next, batch);
+        next = (next + added) % frames.count();
+        queued += added;
+        QMetaObject::invokeMethod(manager, "refreshCanList", Qt::DirectConnection);
+    }
+
+    manager->remove(&conn);
+    QObject::disconnect(counter);
+    QCOMPARE(received, queued);
+}
+
+void BenchModel::addFrames()
+{
+    CANFrameModel model;
+    QBENCHMARK_ONCE
+    {
+        for (int i = 0; i < frames.count(); i += BENCH_MODEL_BATCH)
+            model.addFrames(nullptr, frames.mid(i, BENCH_MODEL_BATCH));
+    }
+    QVERIFY(model.rowCount() > 0);
+}
+
+void BenchModel::sendRefresh()
+{
+    CANFrameModel model;
+    model.insertFrames(frames);
+    QBENCHMARK
+    {
+        model.sendRefresh();
+    }
+    QVERIFY(model.rowCount() > 0); //Main/MaximumFrames may hold fewer than were generated
+}
+
+void BenchModel::filterExpression_data()
+{
+    QTest::addColumn<QString>("expression");
+
+    QTest::newRow("ID range")    << QString("id in 0x100..0x3FF");
+    QTest::newRow("ID and data") << QString("id in 0x100..0x3FF && d[0] & 0x80");
+    QTest::newRow("data only")   << QString("d[0] & 0x80 == 0x80 || len < 4");
+    QTest::newRow("J1939 PGN")   << QString("pgn in 0xFE00..0xFEFF && sa < 0x80");
+}
+
+//sendRefresh with every frame going through a compiled expression as well as the ID and bus filters
+void BenchModel::filterExpression()
+{
+    QFETCH(QString, expression);
+
+    CANFrameModel model;
+    model.insertFrames(frames);
+    QString error;
+    QVERIFY2(model.setFilterExpression(expression, error), qPrintable(error));
+    QBENCHMARK
+    {
+        model.sendRefresh();
+    }
+}
+
+void BenchModel::search_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("pattern anywhere") << static_cast<int>(FrameSearch::BYTE_PATTERN) << QString("12 3?");
+    QTest::newRow("expression")       << static_cast<int>(FrameSearch::EXPRESSION) << QString("d[1] > 0xF0");
+    QTest::newRow("changed bits")     << static_cast<int>(FrameSearch::CHANGED_BITS) << QString();
+}
+
+//the whole store searched from a snapshot, split over the thread pool
+void BenchModel::search()
+{
+    QFETCH(int, mode);
+    QFETCH(QString, text);
+
+    CANFrameModel model;
+    model.insertFrames(frames);
+    FrameSearch::Query query;
+    query.mode = FrameSearch::Mode(mode);
+    if (query.mode == FrameSearch::BYTE_PATTERN) QVERIFY(FrameSearch::parsePattern(text, query.pattern, query.patternMask));
+    if (query.mode == FrameSearch::EXPRESSION) query.expression = FilterExpression::compile(text);
+    query.changedMask = 0x0F;
+    CANFrameSnapshot snapshot = model.getListReference()->snapshot();
+    QBENCHMARK
+    {
+        FrameSearch::run(snapshot, query);
+    }
+}
+
+void BenchModel::sort_data()
+{
+    QTest::addColumn<int>("column");
+
+    QTest::newRow("timestamp") << static_cast<int>(Column::TimeStamp);
+    QTest::newRow("ID")        << static_cast<int>(Column::FrameId);
+    QTest::newRow("bus")       << static_cast<int>(Column::Bus);
+    QTest::newRow("data")      << static_cast<int>(Column::Data);
+}
+
+void BenchModel::sort()
+{
+    QFETCH(int, column);
+
+    CANFrameModel model;
+    model.insertFrames(frames);
+    //only once, sorting the same column again just reverses what's there
+    QBENCHMARK_ONCE
+    {
+        model.sortByColumn(column);
+    }
+    QVERIFY(model.rowCount() > 0); //Main/MaximumFrames may hold fewer than were generated
+}
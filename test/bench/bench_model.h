@@ -0,0 +1,30 @@
+#ifndef BENCH_MODEL_H
+#define BENCH_MODEL_H
+
+#include <QObject>
+#include <QVector>
+#include "can_structs.h"
+
+//the live capture path: draining connections in CANConManager, then CANFrameModel taking the frames and sorting
+class BenchModel: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void drain_data();
+    void drain();
+    void addFrames();
+    void sendRefresh();
+    void filterExpression_data();
+    void filterExpression();
+    void search_data();
+    void search();
+    void sort_data();
+    void sort();
+
+private:
+    QVector<CANFrame> frames;
+};
+
+#endif // BENCH_MODEL_H
@@ -0,0 +1,44 @@
+#include <QtTest>
+#include <QApplication>
+#include <QDir>
+
+#include "bench_fileio.h"
+#include "bench_decode.h"
+#include "bench_model.h"
+
+/*
+ * Runs every benchmark class in turn. Unless -o is given each class also writes its results as QtTest XML to
+ * <results>/<class>.xml so runs can be compared between releases, <results> being SAVVYCAN_BENCH_RESULTS or
+ * bench-results in the current directory. Any other QtTest options (-iterations, -callgrind, a function name...)
+ * are passed straight through.
+ */
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    //own settings so the benchmarks don't touch SavvyCAN's
+    app.setOrganizationName("EVTV");
+    app.setApplicationName("SavvyCAN-bench");
+
+    QStringList args = app.arguments();
+    bool ownOutput = !args.contains("-o");
+    QString results = qEnvironmentVariable("SAVVYCAN_BENCH_RESULTS", "bench-results");
+    if (ownOutput) QDir().mkpath(results);
+
+    int status = 0;
+    auto RUN_BENCH = [&](QObject* obj) {
+        QStringList objArgs = args;
+        if (ownOutput)
+        {
+            objArgs << "-o" << QDir(results).filePath(QString(obj->metaObject()->className()) + ".xml") + ",xml";
+            objArgs << "-o" << "-,txt";
+        }
+        status |= QTest::qExec(obj, objArgs);
+        delete obj;
+    };
+
+    RUN_BENCH(new BenchDecode());
+    RUN_BENCH(new BenchModel());
+    RUN_BENCH(new BenchFileIO());
+
+    return status;
+}
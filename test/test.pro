@@ -11,14 +11,21 @@ SOURCES += \
     tst_cancon.cpp \
     ../connections/canconfactory.cpp \
     ../connections/canconnection.cpp \
+    ../connections/canconworkers.cpp \
+    ../connections/busloadmeter.cpp \
+    ../connections/debuglog.cpp \
     ../connections/gvretserial.cpp \
     ../connections/socketcan.cpp \
+    ../threadpolicy.cpp \
     ../canbus.cpp
 
 
 #HEADERS += \
 #    ../utils/lfqueue.h
 
+win32-msvc*: LIBS += avrt.lib
+win32-g++: LIBS += -lavrt
+
 target.path= .
 INSTALLS += target
 
@@ -28,6 +35,10 @@ HEADERS += \
     ../connections/canconconst.h \
     ../connections/canconfactory.h \
     ../connections/canconnection.h \
+    ../connections/canconworkers.h \
+    ../connections/busloadmeter.h \
+    ../connections/debuglog.h \
     ../connections/gvretserial.h \
     ../connections/socketcan.h \
+    ../threadpolicy.h \
     ../canbus.h
@@ -83,3 +83,167 @@ void TestLFQueue::exchange()
 
     thread.waitForFinished();
 }
+
+
+void TestLFQueue::capacity_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("capacity");
+
+    QTest::newRow("0")      <<  0       << 0;
+    QTest::newRow("1")      <<  1       << 1;
+    QTest::newRow("2")      <<  2       << 2;
+    QTest::newRow("10")     << 10       << 16;
+    QTest::newRow("4096")   << 4096     << 4096;
+}
+
+
+void TestLFQueue::capacity()
+{
+    QFETCH(int, size);
+    QFETCH(int, capacity);
+
+    LFQueue<int> queue;
+    QVERIFY(queue.setSize(size));
+    QCOMPARE(queue.capacity(), capacity);
+
+    /* every slot is usable */
+    for(int i=0; i<capacity ; i++) {
+        QVERIFY(queue.get());
+        queue.queue();
+    }
+    QVERIFY(!queue.get());
+    QCOMPARE(queue.count(), capacity);
+}
+
+
+void TestLFQueue::dropped()
+{
+    LFQueue<int> queue;
+    QVERIFY(queue.setSize(4));
+    QCOMPARE(queue.dropped(), 0u);
+
+    for(int i=0; i<4 ; i++) {
+        QVERIFY(queue.get());
+        queue.queue();
+    }
+    QCOMPARE(queue.dropped(), 0u);
+
+    /* a refused get() counts itself */
+    QVERIFY(!queue.get());
+    QVERIFY(!queue.get());
+    QCOMPARE(queue.dropped(), 2u);
+
+    /* reserve() doesn't, the producer reports what it lost */
+    int granted;
+    QVERIFY(!queue.reserve(8, granted));
+    QCOMPARE(queue.dropped(), 2u);
+    queue.drop(8);
+    QCOMPARE(queue.dropped(), 10u);
+
+    /* making room doesn't reset it */
+    queue.dequeue(4);
+    QVERIFY(queue.get());
+    QCOMPARE(queue.dropped(), 10u);
+}
+
+
+void bulkReaderThread(LFQueue<int>* pQueue_p, int pSize, int pChunk) {
+    int* val_p;
+    int available;
+    int i = 0;
+
+    while(i < pSize) {
+        while(! (val_p = pQueue_p->peekSpan(available)) );
+        if(available > pChunk)
+            available = pChunk;
+
+        for(int j=0; j<available ; j++)
+            QCOMPARE(val_p[j], i + j);
+        i += available;
+        pQueue_p->dequeue(available);
+    }
+}
+
+
+void bulkWriter(LFQueue<int>* pQueue_p, int pSize, int pChunk) {
+    int* val_p;
+    int granted;
+    int i = 0;
+
+    while(i < pSize) {
+        while(! (val_p = pQueue_p->reserve(qMin(pChunk, pSize - i), granted)) );
+
+        for(int j=0; j<granted ; j++)
+            val_p[j] = i + j;
+        i += granted;
+        pQueue_p->commit(granted);
+    }
+}
+
+
+void TestLFQueue::bulkExchange_data()
+{
+    QTest::addColumn<int>("queueSize");
+    QTest::addColumn<int>("writeChunk");
+    QTest::addColumn<int>("readChunk");
+
+    /* odd chunk sizes so spans keep getting cut short at the end of the array */
+    QTest::newRow("small")      << 8    << 3    << 5;
+    QTest::newRow("mixed")      << 64   << 7    << 64;
+    QTest::newRow("whole")      << 64   << 64   << 64;
+}
+
+
+void TestLFQueue::bulkExchange()
+{
+    LFQueue<int> queue;
+    QFETCH(int, queueSize);
+    QFETCH(int, writeChunk);
+    QFETCH(int, readChunk);
+
+    QCOMPARE(queue.setSize(queueSize), true);
+
+    QFuture<void> thread = QtConcurrent::run(bulkReaderThread, &queue, 100000, readChunk);
+    bulkWriter(&queue, 100000, writeChunk);
+    thread.waitForFinished();
+
+    QCOMPARE(queue.count(), 0);
+}
+
+
+/* throughput. Same number of ints pushed through the same size queue one slot at a time and then in spans */
+static const int benchItems = 1000000;
+static const int benchQueueSize = 4096;
+
+void TestLFQueue::benchmarkSingle()
+{
+    LFQueue<int> queue;
+    QCOMPARE(queue.setSize(benchQueueSize), true);
+
+    QBENCHMARK {
+        QFuture<void> thread = QtConcurrent::run(readerThread, &queue, benchItems, false);
+
+        int* val_p;
+        for(int i=0; i<benchItems ; i++) {
+            while(! (val_p = queue.get()) );
+            *val_p = i;
+            queue.queue();
+        }
+
+        thread.waitForFinished();
+    }
+}
+
+
+void TestLFQueue::benchmarkBulk()
+{
+    LFQueue<int> queue;
+    QCOMPARE(queue.setSize(benchQueueSize), true);
+
+    QBENCHMARK {
+        QFuture<void> thread = QtConcurrent::run(bulkReaderThread, &queue, benchItems, benchQueueSize);
+        bulkWriter(&queue, benchItems, 256);
+        thread.waitForFinished();
+    }
+}
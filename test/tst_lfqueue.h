@@ -13,6 +13,13 @@ private slots:
     void setSize();
     void exchange_data();
     void exchange();
+    void capacity_data();
+    void capacity();
+    void dropped();
+    void bulkExchange_data();
+    void bulkExchange();
+    void benchmarkSingle();
+    void benchmarkBulk();
 };
 
 #endif // TST_LFQUEUE_H
@@ -0,0 +1,243 @@
+#include "textlogindex.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+#define TEXT_INDEX_MAGIC    0x58444953 //"SIDX"
+//bump whenever what gets written changes, or a parser starts reading lines differently. Older indexes get rebuilt
+#define TEXT_INDEX_VERSION  1
+
+void TextIndexBuilder::add(qint64 lineStart, qint64 lineEnd, const CANFrame &frame)
+{
+    if (open && current.block.frames >= TEXT_INDEX_BLOCK_FRAMES) finish();
+    if (!open)
+    {
+        current = Part();
+        current.block.offset = lineStart;
+        current.block.frames = 0;
+        current.block.minTime = std::numeric_limits<qint64>::max();
+        current.block.maxTime = std::numeric_limits<qint64>::min();
+        open = true;
+    }
+
+    quint32 key = frameLoadKey(frame.frameId(), frame.hasExtendedFrameFormat());
+    current.block.length = lineEnd - current.block.offset;
+    current.block.frames++;
+    current.counts[key]++;
+
+    qint64 stamp = frame.timeStamp().microSeconds();
+    if (stamp < 0) return; //GVRET CSV lines without one. They get made up times after loading
+    current.block.minTime = qMin(current.block.minTime, stamp);
+    current.block.maxTime = qMax(current.block.maxTime, stamp);
+    auto it = times.find(key);
+    if (it == times.end()) times.insert(key, qMakePair(stamp, stamp));
+    else
+    {
+        it->first = qMin(it->first, stamp);
+        it->second = qMax(it->second, stamp);
+    }
+}
+
+void TextIndexBuilder::finish()
+{
+    if (!open) return;
+    parts.append(current);
+    current = Part();
+    open = false;
+}
+
+TextLogIndex TextIndexBuilder::merge(TextLogFormat format, const QVector<const TextIndexBuilder *> &builders)
+{
+    TextLogIndex index;
+    index.format = format;
+    index.minTime = std::numeric_limits<qint64>::max();
+    index.maxTime = std::numeric_limits<qint64>::min();
+
+    //totals first so the bitmaps have an ID table to refer to
+    QHash<quint32, TextIndexID> totals;
+    for (const TextIndexBuilder *builder : builders)
+    {
+        for (const Part &part : builder->parts)
+        {
+            index.totalFrames += part.block.frames;
+            for (auto it = part.counts.constBegin(); it != part.counts.constEnd(); ++it)
+            {
+                TextIndexID &id = totals[it.key()];
+                if (id.count == 0)
+                {
+                    id.key = it.key();
+                    id.minTime = std::numeric_limits<qint64>::max();
+                    id.maxTime = std::numeric_limits<qint64>::min();
+                }
+                id.count += it.value();
+            }
+        }
+        for (auto it = builder->times.constBegin(); it != builder->times.constEnd(); ++it)
+        {
+            TextIndexID &id = totals[it.key()];
+            id.minTime = qMin(id.minTime, it->first);
+            id.maxTime = qMax(id.maxTime, it->second);
+            index.minTime = qMin(index.minTime, it->first);
+            index.maxTime = qMax(index.maxTime, it->second);
+        }
+    }
+
+    index.ids.reserve(totals.count());
+    for (const TextIndexID &id : totals) index.ids.append(id);
+    std::sort(index.ids.begin(), index.ids.end(), [](const TextIndexID &a, const TextIndexID &b) { return a.key < b.key; });
+
+    QHash<quint32, int> slot;
+    bool tracking = index.ids.count() <= TEXT_INDEX_MAX_IDS;
+    if (tracking) for (int i = 0; i < index.ids.count(); i++) slot.insert(index.ids[i].key, i);
+    int words = (index.ids.count() + 63) / 64;
+
+    for (const TextIndexBuilder *builder : builders)
+    {
+        for (const Part &part : builder->parts)
+        {
+            TextIndexBlock block = part.block;
+            if (tracking)
+            {
+                block.idBits.fill(0, words);
+                for (auto it = part.counts.constBegin(); it != part.counts.constEnd(); ++it)
+                {
+                    int bit = slot.value(it.key());
+                    block.idBits[bit / 64] |= 1ull << (bit % 64);
+                }
+            }
+            index.blocks.append(block);
+        }
+    }
+    return index;
+}
+
+QVector<int> TextLogIndex::blocksFor(const FrameLoadOptions &options) const
+{
+    QVector<int> wanted;
+    if (options.nothing) return wanted;
+
+    //the bits of the IDs the options want. IDs the log doesn't have at all can't match anything
+    QVector<quint64> mask;
+    bool anyID = options.ids.isEmpty();
+    if (!anyID)
+    {
+        mask.fill(0, (ids.count() + 63) / 64);
+        for (int i = 0; i < ids.count(); i++)
+            if (options.matchesKey(ids[i].key)) mask[i / 64] |= 1ull << (i % 64);
+    }
+
+    for (int b = 0; b < blocks.count(); b++)
+    {
+        const TextIndexBlock &block = blocks[b];
+        //blocks without any timestamps can't be ruled out by time
+        if (block.minTime <= block.maxTime && (block.maxTime < options.from || block.minTime > options.to)) continue;
+        if (!anyID && !block.idBits.isEmpty())
+        {
+            bool hit = false;
+            for (int w = 0; w < mask.count() && !hit; w++) hit = (block.idBits[w] & mask[w]) != 0;
+            if (!hit) continue;
+        }
+        wanted.append(b);
+    }
+    return wanted;
+}
+
+QString TextLogIndex::sidecarFilename(const QString &logFilename)
+{
+    return logFilename + ".sci";
+}
+
+//for logs in places that can't be written to, same naming as the DBC cache
+QString TextLogIndex::cacheFilename(const QString &logFilename)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/logindex";
+    QByteArray hash = QCryptographicHash::hash(QFileInfo(logFilename).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+    return dir + "/" + QString::fromLatin1(hash.toHex()) + ".sci";
+}
+
+bool TextLogIndex::load(const QString &logFilename, TextLogFormat wanted)
+{
+    if (read(sidecarFilename(logFilename), logFilename, wanted)) return true;
+    return read(cacheFilename(logFilename), logFilename, wanted);
+}
+
+bool TextLogIndex::save(const QString &logFilename) const
+{
+    if (write(sidecarFilename(logFilename), logFilename)) return true;
+    QString cacheName = cacheFilename(logFilename);
+    QDir().mkpath(QFileInfo(cacheName).path());
+    if (write(cacheName, logFilename)) return true;
+    qDebug() << "Could not write an index for" << logFilename;
+    return false;
+}
+
+bool TextLogIndex::read(const QString &indexFilename, const QString &logFilename, TextLogFormat wanted)
+{
+    QFile in(indexFilename);
+    if (!in.open(QIODevice::ReadOnly)) return false;
+    QDataStream stream(&in);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version;
+    qint32 storedFormat;
+    qint64 size, modified;
+    stream >> magic >> version;
+    if (magic != TEXT_INDEX_MAGIC || version != TEXT_INDEX_VERSION) return false;
+    stream >> storedFormat >> size >> modified;
+    QFileInfo info(logFilename);
+    if (stream.status() != QDataStream::Ok || storedFormat != static_cast<qint32>(wanted) || size != info.size()
+            || modified != info.lastModified().toMSecsSinceEpoch()) return false;
+
+    TextLogIndex loaded;
+    qint32 count;
+    stream >> loaded.totalFrames >> loaded.minTime >> loaded.maxTime;
+    stream >> count;
+    loaded.ids.resize(qMax(0, count));
+    for (TextIndexID &id : loaded.ids) stream >> id.key >> id.count >> id.minTime >> id.maxTime;
+    stream >> count;
+    loaded.blocks.resize(qMax(0, count));
+    for (TextIndexBlock &block : loaded.blocks)
+    {
+        qint32 words;
+        stream >> block.offset >> block.length >> block.frames >> block.minTime >> block.maxTime >> words;
+        if (stream.status() != QDataStream::Ok || words < 0 || words > (loaded.ids.count() + 63) / 64) return false;
+        block.idBits.resize(words);
+        for (quint64 &word : block.idBits) stream >> word;
+    }
+    if (stream.status() != QDataStream::Ok) return false;
+
+    loaded.format = wanted;
+    *this = loaded;
+    return true;
+}
+
+bool TextLogIndex::write(const QString &indexFilename, const QString &logFilename) const
+{
+    //written to the side and renamed over the old one so a half written index never gets read
+    QSaveFile out(indexFilename);
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    QDataStream stream(&out);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    QFileInfo info(logFilename);
+    stream << static_cast<quint32>(TEXT_INDEX_MAGIC) << static_cast<quint32>(TEXT_INDEX_VERSION)
+           << static_cast<qint32>(format) << info.size() << info.lastModified().toMSecsSinceEpoch();
+    stream << totalFrames << minTime << maxTime;
+    stream << static_cast<qint32>(ids.count());
+    for (const TextIndexID &id : ids) stream << id.key << id.count << id.minTime << id.maxTime;
+    stream << static_cast<qint32>(blocks.count());
+    for (const TextIndexBlock &block : blocks)
+    {
+        stream << block.offset << block.length << block.frames << block.minTime << block.maxTime << static_cast<qint32>(block.idBits.count());
+        for (quint64 word : block.idBits) stream << word;
+    }
+    return stream.status() == QDataStream::Ok && out.commit();
+}
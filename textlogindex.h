@@ -0,0 +1,96 @@
+#ifndef TEXTLOGINDEX_H
+#define TEXTLOGINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "frameloadoptions.h"
+
+//frames per block. A partial load reads whole blocks so this is also how much it can read past what was asked for
+#define TEXT_INDEX_BLOCK_FRAMES 4096
+//more distinct IDs than this and the blocks stop keeping track of which IDs they hold. Counts are still kept
+#define TEXT_INDEX_MAX_IDS 8192
+
+//the loaders an index can be made by. Each parses its lines differently so an index only goes with its own
+enum class TextLogFormat
+{
+    NONE,
+    GVRET_CSV,
+    CRTD,
+    CANDUMP
+};
+
+struct TextIndexID
+{
+    quint32 key; //frameLoadKey()
+    quint64 count;
+    qint64 minTime; //microseconds, as loaded. Greater than maxTime when none of the frames had a timestamp
+    qint64 maxTime;
+};
+
+//a run of lines in the log with the frames they hold
+struct TextIndexBlock
+{
+    qint64 offset; //start of the first frame's line
+    qint64 length; //to the end of the last frame's line
+    quint32 frames;
+    qint64 minTime; //greater than maxTime when none of the frames had a timestamp
+    qint64 maxTime;
+    QVector<quint64> idBits; //one bit per entry of TextLogIndex::ids. Empty when there were too many IDs to track
+};
+
+/*
+ * Sidecar index of a line oriented text log, written the first time the log is loaded in full. It's saved next to
+ * the log as <log>.sci, or in the user's cache directory when the log's directory can't be written to. It has
+ * per ID totals for a summary without parsing anything and blocks of TEXT_INDEX_BLOCK_FRAMES frames with their
+ * byte range, time range and IDs so a partial load only reads the blocks that can have something it wants.
+ * An index only counts while the log's size and modification time are what they were when it was made.
+ */
+class TextLogIndex
+{
+public:
+    TextLogFormat format = TextLogFormat::NONE;
+    quint64 totalFrames = 0;
+    qint64 minTime = 0;
+    qint64 maxTime = -1;
+    QVector<TextIndexID> ids; //sorted by key
+    QVector<TextIndexBlock> blocks; //in file order
+
+    bool isValid() const { return format != TextLogFormat::NONE; }
+    bool load(const QString &logFilename, TextLogFormat wanted);
+    bool save(const QString &logFilename) const;
+
+    //blocks that may hold frames the options keep, going by time and ID, in file order
+    QVector<int> blocksFor(const FrameLoadOptions &options) const;
+
+private:
+    static QString sidecarFilename(const QString &logFilename);
+    static QString cacheFilename(const QString &logFilename);
+    bool read(const QString &indexFilename, const QString &logFilename, TextLogFormat wanted);
+    bool write(const QString &indexFilename, const QString &logFilename) const;
+};
+
+/*
+ * Builds the blocks for one stretch of a log. Each loader thread has its own for the lines it parses. merge()
+ * then puts them together in file order and works out the totals and ID bitmaps.
+ */
+class TextIndexBuilder
+{
+public:
+    void add(qint64 lineStart, qint64 lineEnd, const CANFrame &frame);
+    void finish(); //after the last add()
+    static TextLogIndex merge(TextLogFormat format, const QVector<const TextIndexBuilder *> &parts);
+
+private:
+    struct Part
+    {
+        TextIndexBlock block;
+        QHash<quint32, quint32> counts; //by key, within the block
+    };
+    QVector<Part> parts;
+    Part current;
+    QHash<quint32, QPair<qint64, qint64>> times; //earliest and latest timestamp by key, for this stretch
+    bool open = false;
+};
+
+#endif // TEXTLOGINDEX_H
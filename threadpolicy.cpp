@@ -0,0 +1,191 @@
+#include "threadpolicy.h"
+
+#include <QAtomicInteger>
+#include <QDebug>
+#include <QObject>
+#include <QSettings>
+#include <QStringList>
+
+#if defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#include <avrt.h>
+#endif
+
+namespace
+{
+const char *settingNames[ThreadPolicy::ROLE_COUNT] = {"Capture", "Playback", "Sender", "IsoTp"};
+
+struct JitterCounters
+{
+    QAtomicInteger<quint64> wakeups;
+    QAtomicInteger<quint64> totalUs;
+    QAtomicInteger<qint64> maxUs;
+};
+JitterCounters jitterCounters[ThreadPolicy::ROLE_COUNT];
+
+#if defined(Q_OS_LINUX)
+//the scheduler threads of playback and ISO-TP above the readers, which only have to keep up rather than keep time
+int fifoPriority(ThreadPolicy::Role role)
+{
+    int low = sched_get_priority_min(SCHED_FIFO);
+    int high = sched_get_priority_max(SCHED_FIFO);
+    int priority = (role == ThreadPolicy::CAPTURE) ? low + 10 : low + 20;
+    return qMin(priority, high);
+}
+#endif
+}
+
+QString ThreadPolicy::roleName(Role role)
+{
+    switch (role)
+    {
+    case CAPTURE: return QObject::tr("Capture");
+    case PLAYBACK: return QObject::tr("Playback");
+    case SENDER: return QObject::tr("Frame sender");
+    case ISOTP: return QObject::tr("ISO-TP sending");
+    default: return QString();
+    }
+}
+
+ThreadPolicy::Settings ThreadPolicy::load(Role role)
+{
+    QSettings settings;
+    Settings out;
+    QString key = QString("Threads/") + settingNames[role];
+    parseCores(settings.value(key + "Cores", "").toString(), out.cores);
+    out.realTime = settings.value(key + "RealTime", false).toBool();
+    return out;
+}
+
+void ThreadPolicy::save(Role role, const Settings &config)
+{
+    QSettings settings;
+    QString key = QString("Threads/") + settingNames[role];
+    settings.setValue(key + "Cores", coresText(config.cores));
+    settings.setValue(key + "RealTime", config.realTime);
+}
+
+bool ThreadPolicy::parseCores(const QString &text, QVector<int> &cores)
+{
+    cores.clear();
+    for (const QString &part : text.split(',', Qt::SkipEmptyParts))
+    {
+        QStringList range = part.trimmed().split('-');
+        bool okFirst = false;
+        bool okLast = false;
+        int first = range[0].trimmed().toInt(&okFirst);
+        int last = (range.count() == 2) ? range[1].trimmed().toInt(&okLast) : first;
+        if (range.count() == 1) okLast = okFirst;
+        if (!okFirst || !okLast || range.count() > 2 || first < 0 || last < first || last > 1023)
+        {
+            cores.clear();
+            return false;
+        }
+        for (int core = first; core <= last; core++) if (!cores.contains(core)) cores.append(core);
+    }
+    return true;
+}
+
+QString ThreadPolicy::coresText(const QVector<int> &cores)
+{
+    QStringList parts;
+    for (int core : cores) parts.append(QString::number(core));
+    return parts.join(',');
+}
+
+bool ThreadPolicy::apply(Role role)
+{
+    Settings config = load(role);
+    if (config.cores.isEmpty() && !config.realTime) return true;
+    bool ok = true;
+
+#if defined(Q_OS_LINUX)
+    if (!config.cores.isEmpty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int core : config.cores) if (core < CPU_SETSIZE) CPU_SET(core, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err)
+        {
+            qWarning() << roleName(role) << "thread couldn't be pinned to cores" << coresText(config.cores) << ":" << strerror(err);
+            ok = false;
+        }
+    }
+    if (config.realTime)
+    {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = fifoPriority(role);
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err)
+        {
+            qWarning() << roleName(role) << "thread couldn't get real-time priority (needs CAP_SYS_NICE or an rtprio limit):" << strerror(err);
+            ok = false;
+        }
+    }
+#elif defined(Q_OS_WIN)
+    if (!config.cores.isEmpty())
+    {
+        DWORD_PTR mask = 0;
+        for (int core : config.cores) if (core < static_cast<int>(sizeof(DWORD_PTR) * 8)) mask |= static_cast<DWORD_PTR>(1) << core;
+        if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask))
+        {
+            qWarning() << roleName(role) << "thread couldn't be pinned to cores" << coresText(config.cores) << ": error" << GetLastError();
+            ok = false;
+        }
+    }
+    if (config.realTime)
+    {
+        //stays with the thread until it ends, which is as long as it's wanted
+        DWORD taskIndex = 0;
+        HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+        if (!task || !AvSetMmThreadPriority(task, AVRT_PRIORITY_CRITICAL))
+        {
+            qWarning() << roleName(role) << "thread couldn't get MMCSS critical priority: error" << GetLastError();
+            ok = false;
+        }
+    }
+#else
+    qWarning() << roleName(role) << "thread placement and priority aren't supported on this OS";
+    ok = false;
+#endif
+    return ok;
+}
+
+void ThreadPolicy::recordWakeup(Role role, qint64 lateUs)
+{
+    if (role < 0 || role >= ROLE_COUNT) return;
+    if (lateUs < 0) lateUs = 0; //early, as far as the clock can tell
+    JitterCounters &counters = jitterCounters[role];
+    counters.wakeups.fetchAndAddRelaxed(1);
+    counters.totalUs.fetchAndAddRelaxed(static_cast<quint64>(lateUs));
+    //several capture threads share a role, so a plain store could put a smaller maximum over a bigger one
+    qint64 seen = counters.maxUs.loadRelaxed();
+    while (lateUs > seen && !counters.maxUs.testAndSetRelaxed(seen, lateUs, seen)) {}
+}
+
+ThreadPolicy::Jitter ThreadPolicy::jitter(Role role)
+{
+    Jitter out;
+    if (role < 0 || role >= ROLE_COUNT) return out;
+    const JitterCounters &counters = jitterCounters[role];
+    out.wakeups = counters.wakeups.loadRelaxed();
+    out.meanUs = out.wakeups ? static_cast<double>(counters.totalUs.loadRelaxed()) / out.wakeups : 0.0;
+    out.maxUs = counters.maxUs.loadRelaxed();
+    return out;
+}
+
+void ThreadPolicy::resetJitter()
+{
+    for (JitterCounters &counters : jitterCounters)
+    {
+        counters.wakeups.storeRelaxed(0);
+        counters.totalUs.storeRelaxed(0);
+        counters.maxUs.storeRelaxed(0);
+    }
+}
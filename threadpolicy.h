@@ -0,0 +1,63 @@
+#ifndef THREADPOLICY_H
+#define THREADPOLICY_H
+
+#include <QString>
+#include <QVector>
+
+/*
+ * Where the threads that have to keep time run and at what priority. On a machine with a lot of cores most of the
+ * jitter in capture, playback and sending comes from the OS moving those threads from core to core, so each kind
+ * of thread can be pinned to a set of cores of its own and given real-time priority (SCHED_FIFO on Linux, the MMCSS
+ * "Pro Audio" task at critical priority on Windows). Both are set in the main settings and stored per role under
+ * Threads/. Nothing is changed for a role that has no cores and no real-time set, the threads keep the priority
+ * they were started with.
+ *
+ * A thread calls apply() for its role first thing after it starts. Settings changes are picked up by threads
+ * started after them, so connections have to be reconnected and playback restarted. When the OS won't do it
+ * (real-time on Linux needs CAP_SYS_NICE or an rtprio limit, pinning isn't offered on macOS) a warning is logged
+ * and the thread carries on as it was.
+ *
+ * Threads that wait for a deadline report how late they woke up with recordWakeup(). The figures for every role
+ * are shown under the settings so the effect of a change can be seen. Any thread can call any of this.
+ */
+namespace ThreadPolicy
+{
+    enum Role
+    {
+        CAPTURE,    //connection threads and their readers
+        PLAYBACK,   //playback thread and its original timing scheduler
+        SENDER,     //custom frame sender
+        ISOTP,      //ISO-TP transmit pacer
+        ROLE_COUNT
+    };
+
+    struct Settings
+    {
+        QVector<int> cores; //empty for any
+        bool realTime = false;
+    };
+
+    struct Jitter
+    {
+        quint64 wakeups = 0;
+        double meanUs = 0.0;
+        qint64 maxUs = 0;
+    };
+
+    QString roleName(Role role);
+    Settings load(Role role);
+    void save(Role role, const Settings &settings);
+    //"2,3" or "4-7", the way cores are written in the settings. False if it's neither
+    bool parseCores(const QString &text, QVector<int> &cores);
+    QString coresText(const QVector<int> &cores);
+
+    //the role's settings for the calling thread. False if any of it couldn't be done
+    bool apply(Role role);
+
+    //a thread of the role woke up lateUs after it was due to
+    void recordWakeup(Role role, qint64 lateUs);
+    Jitter jitter(Role role);
+    void resetJitter();
+}
+
+#endif // THREADPOLICY_H
@@ -0,0 +1,60 @@
+#include "trafficoverview.h"
+
+#include <algorithm>
+
+void TrafficOverview::clear()
+{
+    buckets.clear();
+    bucketStart = 0;
+    bucketWidth = OVERVIEW_FIRST_BUCKET_US;
+    haveStart = false;
+    totalFrames = 0;
+}
+
+void TrafficOverview::add(const CANFrameRecord &rec)
+{
+    if (!haveStart)
+    {
+        bucketStart = rec.timestamp;
+        haveStart = true;
+    }
+    uint64_t offset = (rec.timestamp > bucketStart) ? rec.timestamp - bucketStart : 0;
+    uint64_t idx = offset / bucketWidth;
+    while (idx >= OVERVIEW_BUCKETS)
+    {
+        //out of room, pairs of buckets become one and the whole strip goes on at half the resolution
+        int half = (buckets.count() + 1) / 2;
+        for (int i = 0; i < half; i++)
+        {
+            OverviewBucket merged = buckets[2 * i];
+            if (2 * i + 1 < buckets.count())
+            {
+                const OverviewBucket &next = buckets[2 * i + 1];
+                merged.frames += next.frames;
+                merged.errors += next.errors;
+                for (int b = 0; b < OVERVIEW_BUSES; b++) merged.busFrames[b] += next.busFrames[b];
+            }
+            buckets[i] = merged;
+        }
+        buckets.resize(half);
+        bucketWidth *= 2;
+        idx = offset / bucketWidth;
+    }
+    if (static_cast<int>(idx) >= buckets.count()) buckets.resize(static_cast<int>(idx) + 1);
+    OverviewBucket &bucket = buckets[static_cast<int>(idx)];
+    bucket.frames++;
+    if (rec.type() == QCanBusFrame::ErrorFrame) bucket.errors++;
+    bucket.busFrames[std::min<int>(rec.bus, OVERVIEW_BUSES - 1)]++;
+    totalFrames++;
+}
+
+TrafficOverviewStore *TrafficOverviewStore::forFrames(const CANFrameStore *frames)
+{
+    return perFrameStore<TrafficOverviewStore>(frames,
+                                               [](const CANFrameStore *f) { return new TrafficOverviewStore(f); });
+}
+
+TrafficOverviewStore::TrafficOverviewStore(const CANFrameStore *frames) : FrameStoreFollower(frames)
+{
+    rebuild();
+}
@@ -0,0 +1,72 @@
+#ifndef TRAFFICOVERVIEW_H
+#define TRAFFICOVERVIEW_H
+
+#include <QVector>
+#include "framestorefollower.h"
+
+//width of a bucket to start with, in us. Doubles whenever the capture outgrows OVERVIEW_BUCKETS
+#define OVERVIEW_FIRST_BUCKET_US    10000
+//buckets the whole capture is split into, about one per pixel of a wide strip
+#define OVERVIEW_BUCKETS            2048
+//buses counted on their own, frames from higher ones count toward the last
+#define OVERVIEW_BUSES              8
+
+struct OverviewBucket
+{
+    quint32 frames = 0; //all of them, errors included
+    quint32 errors = 0;
+    quint32 busFrames[OVERVIEW_BUSES] = {0};
+};
+
+/*
+ * Frames over time for the whole capture in at most OVERVIEW_BUCKETS buckets, kept up to date one frame at a time.
+ * When the capture outgrows them neighbouring buckets get merged and the width doubles, the same as the error
+ * timeline in ErrorStats, so it stays the same size and takes the same time to draw however big the capture gets.
+ * Buckets start at the first timestamp seen. Anything older (frames a little out of order) goes in the first one.
+ */
+class TrafficOverview
+{
+public:
+    void clear();
+    void add(const CANFrameRecord &rec);
+    uint64_t start() const { return bucketStart; }
+    uint64_t width() const { return bucketWidth; }
+    uint64_t end() const { return bucketStart + bucketWidth * static_cast<uint64_t>(buckets.count()); }
+    const QVector<OverviewBucket> &all() const { return buckets; }
+    quint64 frames() const { return totalFrames; }
+
+private:
+    uint64_t bucketStart = 0;
+    uint64_t bucketWidth = OVERVIEW_FIRST_BUCKET_US;
+    bool haveStart = false;
+    quint64 totalFrames = 0;
+    QVector<OverviewBucket> buckets; //only as many as the capture has reached
+};
+
+/*
+ * The overview of one frame store, a FrameStoreFollower. A reset is also how a loaded file gets covered. Only the
+ * record headers are read. Frames the store
+ * evicts stay counted.
+ *
+ * GUI thread only.
+ */
+class TrafficOverviewStore : public FrameStoreFollower
+{
+    Q_OBJECT
+
+public:
+    static TrafficOverviewStore *forFrames(const CANFrameStore *frames);
+
+    const TrafficOverview &overview() const { return traffic; }
+
+protected:
+    void clearState() override { traffic.clear(); }
+    void add(int row) override { traffic.add(frames->record(row)); }
+
+private:
+    explicit TrafficOverviewStore(const CANFrameStore *frames);
+
+    TrafficOverview traffic;
+};
+
+#endif // TRAFFICOVERVIEW_H
@@ -0,0 +1,165 @@
+#include "trafficoverviewstrip.h"
+
+#include <QHelpEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <algorithm>
+#include <cmath>
+
+TrafficOverviewStrip::TrafficOverviewStrip(const CANFrameStore *frames, QWidget *parent) : QWidget(parent)
+{
+    store = TrafficOverviewStore::forFrames(frames);
+    viewTime = 0;
+    haveViewTime = false;
+    setFixedHeight(OVERVIEW_STRIP_HEIGHT);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+
+    repaintTimer.setSingleShot(true);
+    repaintTimer.setInterval(OVERVIEW_REFRESH_MS);
+    connect(&repaintTimer, &QTimer::timeout, this, QOverload<>::of(&QWidget::update));
+    connect(store, &TrafficOverviewStore::updated, this, &TrafficOverviewStrip::overviewUpdated);
+}
+
+//the store updates on every framesUpdated, the strip only every OVERVIEW_REFRESH_MS
+void TrafficOverviewStrip::overviewUpdated()
+{
+    if (!isVisible()) return;
+    if (!repaintTimer.isActive()) repaintTimer.start();
+}
+
+void TrafficOverviewStrip::setViewTime(uint64_t stamp)
+{
+    if (haveViewTime && xOf(stamp) == xOf(viewTime)) return;
+    viewTime = stamp;
+    haveViewTime = true;
+    update();
+}
+
+//the buckets under pixel column x. Always at least one, several columns share it when there are fewer buckets
+void TrafficOverviewStrip::bucketsAt(int x, int &first, int &last) const
+{
+    int count = store->overview().all().count();
+    int w = std::max(1, width());
+    first = static_cast<int>(static_cast<qint64>(x) * count / w);
+    last = std::max(first + 1, static_cast<int>(static_cast<qint64>(x + 1) * count / w));
+}
+
+uint64_t TrafficOverviewStrip::timeAt(int x) const
+{
+    const TrafficOverview &overview = store->overview();
+    double fraction = std::min(1.0, std::max(0.0, static_cast<double>(x) / std::max(1, width())));
+    return overview.start() + static_cast<uint64_t>(fraction * static_cast<double>(overview.end() - overview.start()));
+}
+
+int TrafficOverviewStrip::xOf(uint64_t stamp) const
+{
+    const TrafficOverview &overview = store->overview();
+    if (overview.end() <= overview.start() || stamp <= overview.start()) return 0;
+    double fraction = static_cast<double>(stamp - overview.start()) / static_cast<double>(overview.end() - overview.start());
+    return std::min(width() - 1, static_cast<int>(fraction * width()));
+}
+
+void TrafficOverviewStrip::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    static const QColor busColors[] = {Qt::blue, Qt::darkGreen, Qt::magenta, Qt::darkYellow, Qt::darkCyan, Qt::black, Qt::gray, Qt::darkRed};
+    const int numColors = sizeof(busColors) / sizeof(busColors[0]);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().color(QPalette::Base));
+    const QVector<OverviewBucket> &buckets = store->overview().all();
+    const int w = width();
+    if (buckets.isEmpty() || w <= 0) return;
+
+    //a pass to add up each column and find the tallest, which sets the scale, then one to draw them
+    QVector<quint64> columnFrames(w);
+    QVector<bool> columnErrors(w);
+    QVector<int> columnBus(w);
+    quint64 peak = 1;
+    for (int x = 0; x < w; x++)
+    {
+        int first, last;
+        bucketsAt(x, first, last);
+        quint64 frames = 0;
+        quint64 errors = 0;
+        quint64 busFrames[OVERVIEW_BUSES] = {0};
+        for (int b = first; b < last && b < buckets.count(); b++)
+        {
+            const OverviewBucket &bucket = buckets.at(b);
+            frames += bucket.frames;
+            errors += bucket.errors;
+            for (int bus = 0; bus < OVERVIEW_BUSES; bus++) busFrames[bus] += bucket.busFrames[bus];
+        }
+        columnFrames[x] = frames;
+        columnErrors[x] = errors > 0;
+        columnBus[x] = static_cast<int>(std::max_element(busFrames, busFrames + OVERVIEW_BUSES) - busFrames);
+        peak = std::max(peak, frames);
+    }
+
+    const int barSpace = height() - OVERVIEW_ERROR_HEIGHT;
+    const double scale = barSpace / std::log1p(static_cast<double>(peak));
+    for (int x = 0; x < w; x++)
+    {
+        if (columnErrors[x]) painter.fillRect(x, 0, 1, OVERVIEW_ERROR_HEIGHT, Qt::red);
+        if (columnFrames[x] == 0) continue;
+        int bar = std::max(1, static_cast<int>(std::log1p(static_cast<double>(columnFrames[x])) * scale));
+        painter.fillRect(x, height() - bar, 1, bar, busColors[columnBus[x] % numColors]);
+    }
+
+    if (haveViewTime)
+    {
+        painter.setPen(palette().color(QPalette::Highlight));
+        int x = xOf(viewTime);
+        painter.drawLine(x, 0, x, height() - 1);
+    }
+}
+
+void TrafficOverviewStrip::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || store->overview().all().isEmpty()) return;
+    emit jumpToTime(timeAt(event->pos().x()));
+}
+
+void TrafficOverviewStrip::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton) || store->overview().all().isEmpty()) return;
+    emit jumpToTime(timeAt(event->pos().x()));
+}
+
+//what's under the mouse: the stretch of time, how many frames and errors, and frames by bus
+bool TrafficOverviewStrip::event(QEvent *event)
+{
+    if (event->type() != QEvent::ToolTip) return QWidget::event(event);
+    QHelpEvent *help = static_cast<QHelpEvent *>(event);
+    const TrafficOverview &overview = store->overview();
+    const QVector<OverviewBucket> &buckets = overview.all();
+    if (buckets.isEmpty())
+    {
+        QToolTip::hideText();
+        return true;
+    }
+    int first, last;
+    bucketsAt(help->pos().x(), first, last);
+    first = std::min(first, static_cast<int>(buckets.count()) - 1);
+    last = std::min(last, static_cast<int>(buckets.count()));
+    OverviewBucket sum;
+    for (int b = first; b < last; b++)
+    {
+        sum.frames += buckets.at(b).frames;
+        sum.errors += buckets.at(b).errors;
+        for (int bus = 0; bus < OVERVIEW_BUSES; bus++) sum.busFrames[bus] += buckets.at(b).busFrames[bus];
+    }
+    double from = static_cast<double>(first * overview.width()) / 1000000.0;
+    double to = static_cast<double>(last * overview.width()) / 1000000.0;
+    QString text = tr("%1 - %2 s into the capture").arg(from, 0, 'f', 3).arg(to, 0, 'f', 3);
+    text += "\n" + tr("Frames: %1, errors: %2").arg(sum.frames).arg(sum.errors);
+    for (int bus = 0; bus < OVERVIEW_BUSES; bus++)
+    {
+        if (!sum.busFrames[bus]) continue;
+        QString name = (bus == OVERVIEW_BUSES - 1) ? tr("Bus %1+").arg(bus) : tr("Bus %1").arg(bus);
+        text += "\n" + name + ": " + QString::number(sum.busFrames[bus]);
+    }
+    QToolTip::showText(help->globalPos(), text, this);
+    return true;
+}
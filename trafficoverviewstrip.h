@@ -0,0 +1,54 @@
+#ifndef TRAFFICOVERVIEWSTRIP_H
+#define TRAFFICOVERVIEWSTRIP_H
+
+#include <QTimer>
+#include <QWidget>
+#include "trafficoverview.h"
+
+//at most this often the strip gets redrawn while frames are coming in, in ms
+#define OVERVIEW_REFRESH_MS     250
+#define OVERVIEW_STRIP_HEIGHT   36
+//the row along the top errors are marked in
+#define OVERVIEW_ERROR_HEIGHT   5
+
+/*
+ * The whole capture at a glance, drawn above the frame list: a column per pixel as high as the number of frames
+ * in that stretch of time (log scale so quiet stretches still show), coloured by the bus most of them came in on,
+ * with a red mark along the top where there were errors. The part of the capture the list is scrolled to is marked
+ * with a line. Clicking or dragging asks for the list to go to that time.
+ *
+ * It only ever draws TrafficOverview's buckets so it takes the same time whether there are a thousand frames or
+ * twenty million.
+ */
+class TrafficOverviewStrip : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TrafficOverviewStrip(const CANFrameStore *frames, QWidget *parent = nullptr);
+    void setViewTime(uint64_t stamp); //where the frame list is scrolled to
+
+signals:
+    void jumpToTime(uint64_t stamp);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    bool event(QEvent *event) override;
+
+private slots:
+    void overviewUpdated();
+
+private:
+    TrafficOverviewStore *store;
+    QTimer repaintTimer;
+    uint64_t viewTime;
+    bool haveViewTime;
+
+    void bucketsAt(int x, int &first, int &last) const;
+    uint64_t timeAt(int x) const;
+    int xOf(uint64_t stamp) const;
+};
+
+#endif // TRAFFICOVERVIEWSTRIP_H
@@ -18,7 +18,7 @@ public:
     QList<Trigger> getUpdatedTriggers();
     void showEvent(QShowEvent*);
     ~TriggerDialog();
-    QString buildEntry(Trigger trig);
+    static QString buildEntry(Trigger trig);
 
 private:
     Ui::TriggerDialog *ui;
@@ -0,0 +1,162 @@
+#include "triggeredcapturewindow.h"
+#include "ui_triggeredcapturewindow.h"
+#include "helpwindow.h"
+#include "triggerdialog.h"
+#include "qevent.h"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QSettings>
+
+TriggeredCaptureWindow::TriggeredCaptureWindow(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::TriggeredCaptureWindow)
+{
+    ui->setupUi(this);
+    installEventFilter(this);
+
+    QSettings settings;
+    ui->spinPre->setValue(settings.value("TriggeredCapture/PreSeconds", 10.0).toDouble());
+    ui->spinPost->setValue(settings.value("TriggeredCapture/PostSeconds", 5.0).toDouble());
+    ui->spinMaxFrames->setValue(settings.value("TriggeredCapture/MaxFramesPerBus", 250000).toInt());
+    ui->lineExpression->setText(settings.value("TriggeredCapture/Expression").toString());
+
+    connect(ui->btnEditTriggers, &QPushButton::clicked, this, &TriggeredCaptureWindow::editTriggers);
+    connect(ui->btnBrowse, &QPushButton::clicked, this, &TriggeredCaptureWindow::browseFile);
+    connect(ui->btnArm, &QPushButton::clicked, this, &TriggeredCaptureWindow::toggleArm);
+    connect(CANConManager::getInstance(), &CANConManager::triggeredCaptureChanged, this, &TriggeredCaptureWindow::updateStatus);
+
+    //the rings fill up on their own, this just shows how far along it is
+    statusTimer.setInterval(250);
+    connect(&statusTimer, &QTimer::timeout, this, &TriggeredCaptureWindow::updateStatus);
+    statusTimer.start();
+    refreshTriggerList();
+}
+
+TriggeredCaptureWindow::~TriggeredCaptureWindow()
+{
+    delete ui;
+}
+
+void TriggeredCaptureWindow::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+    updateStatus();
+}
+
+bool TriggeredCaptureWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::KeyRelease) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key())
+        {
+        case Qt::Key_F1:
+            HelpWindow::getRef()->showHelp("triggeredcapture.md");
+            break;
+        }
+        return true;
+    } else {
+        // standard event processing
+        return QObject::eventFilter(obj, event);
+    }
+}
+
+void TriggeredCaptureWindow::editTriggers()
+{
+    TriggerDialog td(triggers, this);
+    if (td.exec() == QDialog::Accepted)
+    {
+        triggers = td.getUpdatedTriggers();
+        refreshTriggerList();
+    }
+}
+
+void TriggeredCaptureWindow::refreshTriggerList()
+{
+    ui->listTriggers->clear();
+    for (const Trigger &trig : qAsConst(triggers)) ui->listTriggers->addItem(TriggerDialog::buildEntry(trig));
+}
+
+void TriggeredCaptureWindow::browseFile()
+{
+    QFileDialog dialog(this);
+    QSettings settings;
+
+    dialog.setDirectory(settings.value("TriggeredCapture/SaveDirectory", dialog.directory().path()).toString());
+    dialog.setFileMode(QFileDialog::AnyFile);
+    dialog.setNameFilters(QStringList(tr("CSV Files (*.csv)")));
+    dialog.setViewMode(QFileDialog::Detail);
+    dialog.setAcceptMode(QFileDialog::AcceptSave);
+
+    if (dialog.exec() == QDialog::Accepted)
+    {
+        ui->lineFile->setText(dialog.selectedFiles()[0]);
+        settings.setValue("TriggeredCapture/SaveDirectory", dialog.directory().path());
+    }
+}
+
+void TriggeredCaptureWindow::toggleArm()
+{
+    CANConManager *manager = CANConManager::getInstance();
+    if (manager->getTriggeredCaptureStatus().state != TriggeredCaptureStatus::IDLE)
+    {
+        manager->disarmTriggeredCapture();
+        return;
+    }
+
+    QString error;
+    FilterExpression::compile(ui->lineExpression->text(), &error);
+    if (!error.isEmpty())
+    {
+        QMessageBox::warning(this, tr("Triggered Capture"), tr("The trigger expression doesn't work: %1").arg(error));
+        return;
+    }
+
+    TriggeredCaptureConfig config;
+    config.triggers = triggers;
+    config.expression = ui->lineExpression->text().trimmed();
+    config.preTriggerUs = static_cast<quint64>(ui->spinPre->value() * 1000000.0);
+    config.postTriggerUs = static_cast<quint64>(ui->spinPost->value() * 1000000.0);
+    config.maxFramesPerBus = ui->spinMaxFrames->value();
+    config.toModel = ui->ckToModel->isChecked();
+    config.fileName = ui->lineFile->text().trimmed();
+    config.rearm = ui->ckRearm->isChecked();
+
+    QSettings settings;
+    settings.setValue("TriggeredCapture/PreSeconds", ui->spinPre->value());
+    settings.setValue("TriggeredCapture/PostSeconds", ui->spinPost->value());
+    settings.setValue("TriggeredCapture/MaxFramesPerBus", config.maxFramesPerBus);
+    settings.setValue("TriggeredCapture/Expression", config.expression);
+
+    manager->armTriggeredCapture(config);
+}
+
+void TriggeredCaptureWindow::updateStatus()
+{
+    if (!isVisible()) return;
+    TriggeredCaptureStatus status = CANConManager::getInstance()->getTriggeredCaptureStatus();
+    QString text;
+    switch (status.state)
+    {
+    case TriggeredCaptureStatus::IDLE:
+        text = tr("Not armed, frames are captured normally");
+        break;
+    case TriggeredCaptureStatus::ARMED:
+        text = tr("Armed, waiting for a trigger. %1 frames buffered").arg(status.buffered);
+        break;
+    case TriggeredCaptureStatus::TRIGGERED:
+        text = tr("Triggered by ID 0x%1 on bus %2, capturing the post-trigger time").arg(status.triggerId, 0, 16).arg(status.triggerBus);
+        break;
+    case TriggeredCaptureStatus::DONE:
+        text = tr("Window captured. Disarm to go back to normal capturing");
+        break;
+    }
+    if (status.windows) text += tr("\nWindows captured: %1").arg(status.windows);
+    if (!status.lastFile.isEmpty()) text += tr("\nLast saved to %1").arg(status.lastFile);
+    if (!status.lastError.isEmpty()) text += "\n" + status.lastError;
+    ui->lblStatus->setText(text);
+
+    bool idle = (status.state == TriggeredCaptureStatus::IDLE);
+    ui->btnArm->setText(idle ? tr("Arm") : tr("Disarm"));
+    ui->groupSetup->setEnabled(idle);
+}
@@ -0,0 +1,36 @@
+#ifndef TRIGGEREDCAPTUREWINDOW_H
+#define TRIGGEREDCAPTUREWINDOW_H
+
+#include <QDialog>
+#include <QTimer>
+#include "connections/canconmanager.h"
+
+namespace Ui {
+class TriggeredCaptureWindow;
+}
+
+class TriggeredCaptureWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit TriggeredCaptureWindow(QWidget *parent = nullptr);
+    ~TriggeredCaptureWindow();
+    void showEvent(QShowEvent*);
+
+private slots:
+    void editTriggers();
+    void browseFile();
+    void toggleArm();
+    void updateStatus();
+
+private:
+    Ui::TriggeredCaptureWindow *ui;
+    QList<Trigger> triggers;
+    QTimer statusTimer;
+
+    void refreshTriggerList();
+    bool eventFilter(QObject *obj, QEvent *event);
+};
+
+#endif // TRIGGEREDCAPTUREWINDOW_H
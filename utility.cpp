@@ -1,6 +1,55 @@
 #include "utility.h"
 
+#include <QFileDevice>
+#include <QTableWidget>
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 bool Utility::decimalMode = false;
 QString Utility::timeFormat = "MMM-dd HH:mm:ss.zzz";
 TimeStyle Utility::timeStyle = TS_MICROS;
 QString Utility::fullyQualifiedNameSeperator = "::";
+
+const char Utility::hexPairs[513] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+const char Utility::decimalPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void Utility::setTableCell(QTableWidget *table, int row, int column, const QString &text)
+{
+    QTableWidgetItem *item = table->item(row, column);
+    if (!item)
+    {
+        item = new QTableWidgetItem();
+        table->setItem(row, column, item);
+    }
+    if (item->text() != text) item->setText(text);
+}
+
+//QFileDevice::flush only gets things as far as the OS, this waits for them to be on the disk
+bool Utility::syncToDisk(QFileDevice &file)
+{
+    if (!file.isOpen() || !file.flush()) return false;
+    int fd = file.handle();
+    if (fd < 0) return false;
+#if defined(Q_OS_WIN)
+    return _commit(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
@@ -10,8 +10,14 @@
 #include <QRect>
 #include <QComboBox>
 #include <QStandardItemModel>
+#include <QtEndian>
+#include <cstring>
+#include <QLatin1String>
 //#include <QDesktopWidget>
 
+//a buffer this long fits whatever any one of the Utility::write* functions puts in it
+#define UTILITY_FORMAT_CHARS    32
+
 enum TimeStyle
 {
     TS_SECONDS,
@@ -20,6 +26,9 @@ enum TimeStyle
     TS_CLOCK
 };
 
+class QFileDevice;
+class QTableWidget;
+
 class Utility
 {
 public:
@@ -30,6 +39,11 @@ public:
 
     static QString fullyQualifiedNameSeperator;
 
+    static bool syncToDisk(QFileDevice &file);
+
+    //for tables filled in again on a timer: makes the item if the cell has none, leaves it alone if the text is the same
+    static void setTableCell(QTableWidget *table, int row, int column, const QString &text);
+
     static void SetComboBoxItemEnabled(QComboBox * comboBox, int index, bool enabled)
     {
         auto * model = qobject_cast<QStandardItemModel*>(comboBox->model());
@@ -113,42 +127,167 @@ public:
                  + (static_cast<uint64_t>(stamp.time().second())) * 1000ull) + static_cast<uint64_t>(stamp.time().msec()));
     }
 
-    //prints hex numbers in uppercase with 0's filling out the number depending
-    //on the size needed. Promotes hex numbers to either 2, 4, or 8 digits
-    static QString formatHexNum(uint64_t input)
+    /*
+     * The formatting below without any allocations. Each write* function puts its text in a buffer the caller owns
+     * (no terminating 0, UTILITY_FORMAT_CHARS is always enough for one call) and returns the end of what it wrote, so
+     * a whole line of fields can go into one buffer back to back and become one QString or one write at the end.
+     * Hex comes out of a table of every byte's two digits and decimal out of a table of every two digit pair.
+     * The *Text ones hand back a QLatin1String over the caller's buffer which QStringBuilder (%) joins up without
+     * any temporary QStrings. The format* functions are thin wrappers over the same code.
+     */
+    static const char hexPairs[513];
+    static const char decimalPairs[201];
+
+    static char *writeByteAsHex(char *out, uint8_t value)
     {
-        if (input < 256)
-            return "0x" + QString::number(input, 16).toUpper().rightJustified(2,'0');
-        if (input < 65536)
-            return "0x" + QString::number(input, 16).toUpper().rightJustified(4,'0');
-        if (input < 4294967296)
-            return "0x" + QString::number(input, 16).toUpper().rightJustified(8,'0');
-        return "0x" + QString::number(input, 16).toUpper().rightJustified(16,'0');
+        memcpy(out, hexPairs + value * 2, 2);
+        return out + 2;
     }
 
-    //uses decimalMode to see if it should show value as decimal or hex
-    static QString formatNumber(uint64_t value)
+    //upper case, exactly digits long (up to 16). Zero padded, higher digits than that are left off
+    static char *writeHex(char *out, uint64_t value, int digits)
     {
-        if (decimalMode)
+        char *end = out + digits;
+        char *pos = end;
+        while (pos - out >= 2)
         {
-            return QString::number(value, 10);
+            pos -= 2;
+            memcpy(pos, hexPairs + (value & 0xFF) * 2, 2);
+            value >>= 8;
         }
-        else return formatHexNum(value);
+        if (pos > out) *--pos = hexPairs[(value & 0xF) * 2 + 1];
+        return end;
     }
 
-    static QString formatCANID(uint64_t id, bool extended)
+    static char *writeDecimal(char *out, uint64_t value)
+    {
+        char text[20];
+        int pos = sizeof(text);
+        while (value >= 100)
+        {
+            pos -= 2;
+            memcpy(text + pos, decimalPairs + (value % 100) * 2, 2);
+            value /= 100;
+        }
+        if (value >= 10)
+        {
+            pos -= 2;
+            memcpy(text + pos, decimalPairs + value * 2, 2);
+        }
+        else text[--pos] = static_cast<char>('0' + value);
+        int len = static_cast<int>(sizeof(text)) - pos;
+        memcpy(out, text + pos, len);
+        return out + len;
+    }
+
+    static char *writeSignedDecimal(char *out, int64_t value)
     {
-        if (decimalMode) return QString::number(id, 10);
+        if (value < 0)
+        {
+            *out++ = '-';
+            return writeDecimal(out, 0 - static_cast<uint64_t>(value));
+        }
+        return writeDecimal(out, static_cast<uint64_t>(value));
+    }
 
-        if (extended)
+    //value counts 10^-scaleDigits units (6 for micros as seconds). precision digits after the point, up to 10,
+    //rounded half up the way QString::number(x, 'f', precision) would
+    static char *writeFixed(char *out, int64_t value, int scaleDigits, int precision)
+    {
+        static const uint64_t powers[19] = {1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+                                            100000000ull, 1000000000ull, 10000000000ull, 100000000000ull,
+                                            1000000000000ull, 10000000000000ull, 100000000000000ull,
+                                            1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+                                            1000000000000000000ull};
+        bool negative = value < 0;
+        uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        int kept = qMin(precision, scaleDigits);
+        uint64_t unit = powers[scaleDigits - kept];
+        uint64_t rounded = (magnitude + unit / 2) / unit; //in 10^-kept
+        uint64_t fraction = rounded % powers[kept];
+
+        if (negative && rounded) *out++ = '-';
+        out = writeDecimal(out, rounded / powers[kept]);
+        if (precision <= 0) return out;
+        *out++ = '.';
+        for (int i = kept - 1; i >= 0; i--)
         {
-            return "0x" + QString::number(id, 16).toUpper().rightJustified(8,'0');
+            out[i] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
         }
-        else
+        out += kept;
+        for (int i = kept; i < precision; i++) *out++ = '0';
+        return out;
+    }
+
+    //0x and then 2, 4, 8 or 16 digits, whatever it needs
+    static char *writeHexNum(char *out, uint64_t input)
+    {
+        int digits = 16;
+        if (input < 256) digits = 2;
+        else if (input < 65536) digits = 4;
+        else if (input < 4294967296) digits = 8;
+        *out++ = '0';
+        *out++ = 'x';
+        return writeHex(out, input, digits);
+    }
+
+    static char *writeNumber(char *out, uint64_t value)
+    {
+        if (decimalMode) return writeDecimal(out, value);
+        return writeHexNum(out, value);
+    }
+
+    static char *writeCANID(char *out, uint64_t id, bool extended)
+    {
+        if (decimalMode) return writeDecimal(out, id);
+        *out++ = '0';
+        *out++ = 'x';
+        if (extended) return writeHex(out, id, (id > 0xFFFFFFFFull) ? 16 : 8);
+        return writeHex(out, id & 0x7FF, 3);
+    }
+
+    //the text formatTimestamp's value gets shown as. TS_CLOCK needs a QDateTime and timeFormat so nothing is written for it
+    static char *writeTimestamp(char *out, uint64_t timestamp, TimeStyle style)
+    {
+        switch (style)
         {
-            id = id & 0x7FF;
-            return "0x" + QString::number(id, 16).toUpper().rightJustified(3,'0');
+        case TS_SECONDS:
+            return writeFixed(out, static_cast<int64_t>(timestamp), 6, 5);
+        case TS_MILLIS:
+            return writeFixed(out, static_cast<int64_t>(timestamp), 3, 5);
+        case TS_MICROS:
+            return writeDecimal(out, timestamp);
+        case TS_CLOCK:
+            break;
         }
+        return out;
+    }
+
+    static QLatin1String hexNumText(char *buf, uint64_t input) { return QLatin1String(buf, writeHexNum(buf, input)); }
+    static QLatin1String numberText(char *buf, uint64_t value) { return QLatin1String(buf, writeNumber(buf, value)); }
+    static QLatin1String canIDText(char *buf, uint64_t id, bool extended) { return QLatin1String(buf, writeCANID(buf, id, extended)); }
+    static QLatin1String byteHexText(char *buf, uint8_t value) { return QLatin1String(buf, writeByteAsHex(buf, value)); }
+
+    //prints hex numbers in uppercase with 0's filling out the number depending
+    //on the size needed. Promotes hex numbers to either 2, 4, or 8 digits
+    static QString formatHexNum(uint64_t input)
+    {
+        char buf[UTILITY_FORMAT_CHARS];
+        return hexNumText(buf, input);
+    }
+
+    //uses decimalMode to see if it should show value as decimal or hex
+    static QString formatNumber(uint64_t value)
+    {
+        char buf[UTILITY_FORMAT_CHARS];
+        return numberText(buf, value);
+    }
+
+    static QString formatCANID(uint64_t id, bool extended)
+    {
+        char buf[UTILITY_FORMAT_CHARS];
+        return canIDText(buf, id, extended);
     }
 
     static QString formatCANID(uint64_t id)
@@ -170,7 +309,8 @@ public:
 
     static QString formatByteAsHex(uint8_t value)
     {
-        return QString::number(value, 16).toUpper().rightJustified(2,'0');
+        char buf[2];
+        return byteHexText(buf, value);
     }
 
     static QVariant formatTimestamp(uint64_t timestamp)
@@ -201,7 +341,7 @@ public:
         for (int i = 0; i < input.length(); i++)
         {
             thisChar = input[i];
-            if (thisChar.isLetterOrNumber() || thisChar == ':' || thisChar == '~') builder.append(input[i]);
+            if (thisChar.isLetterOrNumber() || thisChar == ':' || thisChar == '~' || thisChar == '_' || thisChar == '[' || thisChar == ']') builder.append(input[i]);
             else
             {
                 //qDebug() << "i: "<< i << " len: " << input.length();
@@ -247,7 +387,7 @@ public:
     /* A unified function that can extract a signal from the (up to) 64 bits of data bytes in a CAN frame
      * handles both little and big endian signals (and floats too).
     */
-    static int64_t processIntegerSignal(const QByteArray data, int startBit, int sigSize, bool littleEndian, bool isSigned)
+    static int64_t processIntegerSignal(const QByteArray &data, int startBit, int sigSize, bool littleEndian, bool isSigned)
     {
 
         uint64_t result = 0;
@@ -346,4 +486,180 @@ public:
     }
 };
 
+/*
+ * Precompiled version of processIntegerSignal. The start bit, size, byte order and sign of a signal get turned
+ * into a byte offset, shift and mask once (compile) and after that pulling the value out of a payload is an
+ * 8 byte load, a byte swap for motorola signals, a shift and a mask instead of a loop over every bit.
+ * Intel signals are contiguous going up in a little endian view of the bytes and motorola signals are contiguous
+ * going down in a big endian view so both fit the same scheme. Anything that straddles more than 8 bytes falls back
+ * to the bit by bit code. Results are identical to processIntegerSignal including returning 0 for short payloads.
+ */
+class SignalExtractor
+{
+public:
+    enum Kind : uint8_t
+    {
+        EMPTY,
+        INTEL,
+        MOTOROLA,
+        BITWISE
+    };
+
+    SignalExtractor()
+    {
+        kind = EMPTY;
+        compiled = false;
+        startBit = 0;
+        sigSize = 0;
+        littleEndian = false;
+        isSigned = false;
+        firstByte = 0;
+        shift = 0;
+        minLength = 0;
+        mask = 0;
+        signBit = 0;
+    }
+
+    SignalExtractor(int startBit, int sigSize, bool littleEndian, bool isSigned) : SignalExtractor()
+    {
+        compile(startBit, sigSize, littleEndian, isSigned);
+    }
+
+    void compile(int startBit, int sigSize, bool littleEndian, bool isSigned)
+    {
+        this->startBit = startBit;
+        this->sigSize = sigSize;
+        this->littleEndian = littleEndian;
+        this->isSigned = isSigned;
+        compiled = true;
+
+        if (sigSize <= 0 || sigSize > 64 || startBit < 0)
+        {
+            kind = EMPTY;
+            return;
+        }
+
+        mask = (sigSize == 64) ? ~0ULL : ((1ULL << sigSize) - 1);
+        signBit = (isSigned && sigSize < 64) ? (1ULL << (sigSize - 1)) : 0;
+
+        int lastByte;
+        int offset; //bit offset of the signal in the 64 bit word loaded from firstByte
+        if (littleEndian)
+        {
+            firstByte = startBit / 8;
+            offset = startBit % 8;
+            lastByte = (startBit + sigSize - 1) / 8;
+            kind = INTEL;
+        }
+        else
+        {
+            //position counting from the MSB of byte 0. The signal runs upward from here in this numbering
+            int linear = (startBit / 8) * 8 + (7 - (startBit % 8));
+            firstByte = linear / 8;
+            offset = linear % 8;
+            lastByte = (linear + sigSize - 1) / 8;
+            kind = MOTOROLA;
+        }
+        if (offset + sigSize > 64 || lastByte >= 64) kind = BITWISE;
+        shift = (kind == MOTOROLA) ? (64 - offset - sigSize) : offset;
+
+        //processIntegerSignal bails on either of these
+        minLength = qMax((startBit + sigSize) / 8, lastByte + 1);
+    }
+
+    bool matches(int startBit, int sigSize, bool littleEndian, bool isSigned) const
+    {
+        return compiled && this->startBit == startBit && this->sigSize == sigSize
+                && this->littleEndian == littleEndian && this->isSigned == isSigned;
+    }
+
+    int requiredLength() const { return minLength; }
+
+    int64_t extract(const uint8_t *data, int len) const
+    {
+        if (kind == EMPTY) return 0;
+        if (len < minLength) return 0;
+        if (kind == BITWISE)
+        {
+            return Utility::processIntegerSignal(QByteArray::fromRawData(reinterpret_cast<const char *>(data), len),
+                                                 startBit, sigSize, littleEndian, isSigned);
+        }
+
+        uint8_t word[8];
+        const uint8_t *src = data + firstByte;
+        if (firstByte + 8 > len) //near the end of the payload. Pad it out so the load is always 8 bytes
+        {
+            memset(word, 0, 8);
+            memcpy(word, src, len - firstByte);
+            src = word;
+        }
+
+        uint64_t raw;
+        if (kind == INTEL) raw = qFromLittleEndian<quint64>(src);
+        else raw = qFromBigEndian<quint64>(src);
+        raw = (raw >> shift) & mask;
+        if (raw & signBit) raw |= ~mask;
+        return static_cast<int64_t>(raw);
+    }
+
+    int64_t extract(const QByteArray &payload) const
+    {
+        return extract(reinterpret_cast<const uint8_t *>(payload.constData()), payload.length());
+    }
+
+    /*
+     * The other direction. The low sigSize bits of raw go into the signal's spot with one masked read-modify-write
+     * of the same 8 byte word extract reads, every other bit of the payload is left alone. A payload too short for
+     * the signal is left untouched and returns false, which is where extract would have returned 0.
+     */
+    bool insert(uint8_t *data, int len, uint64_t raw) const
+    {
+        if (kind == EMPTY || len < minLength) return false;
+        raw &= mask;
+        if (kind == BITWISE)
+        {
+            //same bit walk as processIntegerSignal
+            int bit = startBit;
+            for (int bitpos = 0; bitpos < sigSize; bitpos++)
+            {
+                int valueBit = littleEndian ? bitpos : (sigSize - bitpos - 1);
+                if (bit < 512 && bit / 8 < len)
+                {
+                    if ((raw >> valueBit) & 1) data[bit / 8] |= (1 << (bit % 8));
+                    else data[bit / 8] &= ~(1 << (bit % 8));
+                }
+                if (littleEndian) bit++;
+                else if ((bit % 8) == 0) bit += 15;
+                else bit--;
+            }
+            return true;
+        }
+
+        uint8_t word[8];
+        int avail = qMin(8, len - firstByte);
+        memset(word, 0, 8);
+        memcpy(word, data + firstByte, avail);
+
+        uint64_t value = (kind == INTEL) ? qFromLittleEndian<quint64>(word) : qFromBigEndian<quint64>(word);
+        value = (value & ~(mask << shift)) | (raw << shift);
+        if (kind == INTEL) qToLittleEndian<quint64>(value, word);
+        else qToBigEndian<quint64>(value, word);
+        memcpy(data + firstByte, word, avail);
+        return true;
+    }
+
+private:
+    Kind kind;
+    bool compiled;
+    bool littleEndian;
+    bool isSigned;
+    uint8_t firstByte;
+    uint8_t shift;
+    int startBit;
+    int sigSize;
+    int minLength;
+    uint64_t mask;
+    uint64_t signBit;
+};
+
 #endif // UTILITY_H
@@ -3,18 +3,36 @@
 
 #include <QObject>
 #include <QDebug>
-
-
-/* macros */
-#define IS_EMPTY()  (  mWIdx.loadAcquire()             == mRIdx.loadAcquire() )
-#define IS_FULL()   ( (mWIdx.loadAcquire()+1)%mSize    == mRIdx.loadAcquire() )
-
-
+#include <QAtomicInteger>
+
+
+/* bytes between the producer and consumer halves so they never share a cache line */
+#define LFQUEUE_CACHE_LINE  64
+
+
+/*
+ * Single producer, single consumer lock free ring.
+ *
+ * The size is rounded up to a power of two so wrapping is a mask instead of a divide. The read and write indices
+ * just count up forever (unsigned wraparound takes care of itself) which means every slot can be used and full vs
+ * empty is simply how far apart they are.
+ *
+ * Each side works out of its own cache line: its own index plus the last value it saw of the other side's index.
+ * Only when that cached value says the queue is full (producer) or empty (consumer) does it go and read the real
+ * index, so at high rates the two threads mostly aren't touching each other's memory at all.
+ *
+ * One slot at a time: get() / queue() to produce, peek() / dequeue() to consume.
+ * Bulk: reserve() / commit() to produce, peekSpan() / dequeue(n) to consume. A span is always contiguous in memory
+ * so it can come back shorter than asked for when it runs into the end of the array. Call again for the rest.
+ *
+ * get() failing on a full queue counts as one dropped item. A producer using reserve() knows how many it couldn't
+ * fit and reports them with drop(). dropped() is the running total.
+ */
 template<class T>
 class LFQueue
 {
 public:
-    LFQueue() : mSize(0), mArray(nullptr){}
+    LFQueue() : mSize(0), mMask(0), mArray(nullptr), mCachedRIdx(0), mDropped(0), mCachedWIdx(0) {}
 
     ~LFQueue() {setSize(0);}
 
@@ -26,11 +44,20 @@ public:
             delete[] mArray;
             mArray = nullptr;
         }
+        mSize = 0;
+        mMask = 0;
+        flush();
 
         if(size>0) {
-            mArray = new T[size];
-            if(mArray)
-                mSize = size;
+            quint32 pow2 = 1;
+            while(pow2 < static_cast<quint32>(size))
+                pow2 <<= 1;
+
+            mArray = new T[pow2];
+            if(mArray) {
+                mSize = pow2;
+                mMask = pow2 - 1;
+            }
             return ( mArray != nullptr );
         }
 
@@ -38,54 +65,148 @@ public:
     }
 
     void flush() {
+        mCachedRIdx = 0;
+        mCachedWIdx = 0;
         mRIdx.storeRelease(0);
         mWIdx.storeRelease(0);
     }
 
+    /*** producer side ***/
+
     T* get() {
-        if(IS_FULL())
+        quint32 wIdx = mWIdx.loadRelaxed();
+        if(isFull(wIdx)) {
+            drop();
             return nullptr;
+        }
 
-        return &(mArray[mWIdx.loadAcquire()]); /* prevent memory reordering (belt and braces) */
+        return &(mArray[wIdx & mMask]);
     }
 
 
     void queue() {
         #ifdef QT_DEBUG
-        if(IS_FULL())
+        if(isFull(mWIdx.loadRelaxed()))
             qCritical() << "BUG: queueing in full queue";
         #endif
 
-        int wIdx = mWIdx.loadAcquire();
-        mWIdx.storeRelease((wIdx+1)%mSize);
+        mWIdx.storeRelease(mWIdx.loadRelaxed()+1);
+    }
+
+
+    /* up to wanted free slots in a row starting at the returned pointer. granted is how many. nullptr if full */
+    T* reserve(int wanted, int &granted) {
+        granted = 0;
+        quint32 wIdx = mWIdx.loadRelaxed();
+        quint32 space = mSize - (wIdx - mCachedRIdx);
+        if(space < static_cast<quint32>(wanted)) {
+            mCachedRIdx = mRIdx.loadAcquire();
+            space = mSize - (wIdx - mCachedRIdx);
+        }
+        if(space == 0 || wanted <= 0)
+            return nullptr;
+
+        quint32 toEnd = mSize - (wIdx & mMask);
+        quint32 n = qMin(qMin(space, toEnd), static_cast<quint32>(wanted));
+        granted = static_cast<int>(n);
+        return &(mArray[wIdx & mMask]);
     }
 
 
+    /* publish num slots filled in after reserve(). All of them become visible to the consumer at once */
+    void commit(int num) {
+        #ifdef QT_DEBUG
+        if(mWIdx.loadRelaxed() + static_cast<quint32>(num) - mRIdx.loadAcquire() > mSize)
+            qCritical() << "BUG: committing more than was reserved";
+        #endif
+
+        mWIdx.storeRelease(mWIdx.loadRelaxed() + static_cast<quint32>(num));
+    }
+
+    /* the producer had to throw num items away. Only counts, the queue itself doesn't change */
+    void drop(int num = 1) {
+        mDropped.fetchAndAddRelaxed(static_cast<quint32>(num));
+    }
+
+    /*** consumer side ***/
+
     T* peek() {
-        if(IS_EMPTY())
+        quint32 rIdx = mRIdx.loadRelaxed();
+        if(isEmpty(rIdx))
             return nullptr;
 
-        return &(mArray[mRIdx.loadAcquire()]); /* prevent memory reordering (belt and braces) */
+        return &(mArray[rIdx & mMask]);
     }
 
 
-    void dequeue() {
+    /* everything readable in one contiguous run. available is how many. nullptr if empty */
+    T* peekSpan(int &available) {
+        available = 0;
+        quint32 rIdx = mRIdx.loadRelaxed();
+        if(isEmpty(rIdx))
+            return nullptr;
+        mCachedWIdx = mWIdx.loadAcquire(); /* grab anything that came in since the cached value */
+
+        quint32 toEnd = mSize - (rIdx & mMask);
+        available = static_cast<int>(qMin(mCachedWIdx - rIdx, toEnd));
+        return &(mArray[rIdx & mMask]);
+    }
+
+
+    void dequeue(int num = 1) {
         #ifdef QT_DEBUG
-        if(IS_EMPTY())
-            qCritical() << "BUG: dequeueing an empty queue";
+        if(mWIdx.loadAcquire() - mRIdx.loadRelaxed() < static_cast<quint32>(num))
+            qCritical() << "BUG: dequeueing more than the queue has";
         #endif
 
-        int rIdx = mRIdx.loadAcquire();
-        mRIdx.storeRelease((rIdx+1)%mSize);
+        mRIdx.storeRelease(mRIdx.loadRelaxed() + static_cast<quint32>(num));
     }
 
+    /*** either side ***/
+
+    /* number of frames waiting to be dequeued. Only a snapshot if the other side is busy */
+    int count() {
+        return static_cast<int>(mWIdx.loadAcquire() - mRIdx.loadAcquire());
+    }
+
+    int capacity() const { return static_cast<int>(mSize); }
+
+    /* items producers couldn't queue since the queue was made. Wraps at 2^32, take differences */
+    quint32 dropped() const { return mDropped.loadRelaxed(); }
+
 
 private:
-    int mSize;
-    T*  mArray;
+    /* the real index is only read when the cached one says there's no room (or nothing to read) */
+    bool isFull(quint32 wIdx) {
+        if(wIdx - mCachedRIdx < mSize)
+            return false;
+        mCachedRIdx = mRIdx.loadAcquire();
+        return (wIdx - mCachedRIdx >= mSize);
+    }
+
+    bool isEmpty(quint32 rIdx) {
+        if(rIdx != mCachedWIdx)
+            return false;
+        mCachedWIdx = mWIdx.loadAcquire();
+        return (rIdx == mCachedWIdx);
+    }
 
-    QAtomicInt mRIdx;
-    QAtomicInt mWIdx;
+    /* set up once, read by both sides */
+    quint32 mSize;
+    quint32 mMask;
+    T*      mArray;
+    char    mPad0[LFQUEUE_CACHE_LINE];
+
+    /* producer */
+    QAtomicInteger<quint32> mWIdx;
+    quint32                 mCachedRIdx;
+    QAtomicInteger<quint32> mDropped;
+    char                    mPad1[LFQUEUE_CACHE_LINE];
+
+    /* consumer */
+    QAtomicInteger<quint32> mRIdx;
+    quint32                 mCachedWIdx;
+    char                    mPad2[LFQUEUE_CACHE_LINE];
 };
 
 #endif // LFQUEUE_H
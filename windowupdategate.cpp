@@ -0,0 +1,104 @@
+#include "windowupdategate.h"
+#include "mainwindow.h"
+
+#include <QEvent>
+#include <QWidget>
+#include <QWindow>
+
+WindowUpdateGate *WindowUpdateGate::attach(QWidget *window, std::function<void(int)> slot)
+{
+    WindowUpdateGate *gate = new WindowUpdateGate(window, std::move(slot));
+    connect(MainWindow::getReference(), &MainWindow::framesUpdated, gate, &WindowUpdateGate::framesUpdated);
+    return gate;
+}
+
+WindowUpdateGate::WindowUpdateGate(QWidget *window, std::function<void(int)> slot) :
+    QObject(window),
+    window(window),
+    slot(std::move(slot)),
+    frames(MainWindow::getReference()->getCANFrameModel()->getListReference()),
+    pendingFrames(0),
+    pendingReload(false),
+    catchUpQueued(false)
+{
+    window->installEventFilter(this);
+    watchWindowHandle();
+}
+
+bool WindowUpdateGate::isDormant(const QObject *object)
+{
+    const QWidget *widget = qobject_cast<const QWidget *>(object);
+    if (!widget) return false;
+    const QWidget *top = widget->window();
+    if (!top->isVisible() || top->isMinimized()) return true;
+    //null until it's first shown. Desktops that don't track covered windows just leave them all exposed
+    const QWindow *handle = top->windowHandle();
+    return handle && !handle->isExposed();
+}
+
+//the native window only exists once the widget has been shown
+void WindowUpdateGate::watchWindowHandle()
+{
+    QWindow *current = window->windowHandle();
+    if (!current || current == handle) return;
+    if (handle) handle->removeEventFilter(this);
+    handle = current;
+    handle->installEventFilter(this);
+}
+
+bool WindowUpdateGate::eventFilter(QObject *obj, QEvent *event)
+{
+    switch (event->type())
+    {
+    case QEvent::Show:
+        watchWindowHandle();
+        /* fall through */
+    case QEvent::WindowStateChange:
+    case QEvent::Expose:
+        //after the event is done with, the window has to have finished showing to be seen as in sight
+        if ((pendingReload || pendingFrames) && !catchUpQueued)
+        {
+            catchUpQueued = true;
+            QMetaObject::invokeMethod(this, "catchUp", Qt::QueuedConnection);
+        }
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(obj, event);
+}
+
+void WindowUpdateGate::framesUpdated(int numFrames)
+{
+    if (numFrames == -1)
+    {
+        pendingFrames = 0;
+        pendingReload = false;
+        slot(-1);
+        return;
+    }
+    if (isDormant(window))
+    {
+        if (numFrames == -2)
+        {
+            pendingReload = true;
+            pendingFrames = 0;
+        }
+        else if (numFrames > 0) pendingFrames += numFrames;
+        return;
+    }
+    catchUp();
+    slot(numFrames);
+}
+
+void WindowUpdateGate::catchUp()
+{
+    catchUpQueued = false;
+    if (isDormant(window) || (!pendingReload && !pendingFrames)) return;
+    //more than the store has left means some went before the window saw them, so it starts over from what's there
+    bool reload = pendingReload || pendingFrames > frames->count();
+    int count = static_cast<int>(pendingFrames);
+    pendingReload = false;
+    pendingFrames = 0;
+    slot(reload ? -2 : count);
+}
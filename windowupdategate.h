@@ -0,0 +1,53 @@
+#ifndef WINDOWUPDATEGATE_H
+#define WINDOWUPDATEGATE_H
+
+#include <QObject>
+#include <QPointer>
+#include <functional>
+
+class QWidget;
+class QWindow;
+class CANFrameStore;
+
+/*
+ * Stands between MainWindow::framesUpdated and a tool window that only shows things, so a window nobody can see
+ * isn't redrawing during capture. While the window is hidden, minimized or, where the platform says so, covered
+ * up completely, new frame counts are only added up. Once it's on screen again it gets one call for all of them,
+ * the same as if that many frames had come in at once, or -2 (a whole new set) if the store has dropped some of
+ * them since or was replaced meanwhile. -1 goes straight through either way, clearing is cheap and has to happen
+ * before anything after it counts.
+ *
+ * Windows that act on frames (senders, scanners, bridges, protocol handlers) stay on framesUpdated directly.
+ * GUI thread only. The gate belongs to the window and goes with it.
+ */
+class WindowUpdateGate : public QObject
+{
+    Q_OBJECT
+
+public:
+    //connects framesUpdated to slot through a new gate on window
+    static WindowUpdateGate *attach(QWidget *window, std::function<void(int)> slot);
+    //not visible, minimized or not exposed. Anything that isn't a widget is never dormant
+    static bool isDormant(const QObject *object);
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private slots:
+    void framesUpdated(int numFrames);
+    void catchUp();
+
+private:
+    WindowUpdateGate(QWidget *window, std::function<void(int)> slot);
+    void watchWindowHandle();
+
+    QWidget *window;
+    QPointer<QWindow> handle; //filtered too for expose events, once there is one
+    std::function<void(int)> slot;
+    const CANFrameStore *frames;
+    qint64 pendingFrames; //new since the window went out of sight
+    bool pendingReload; //a -2 came while out of sight
+    bool catchUpQueued;
+};
+
+#endif // WINDOWUPDATEGATE_H
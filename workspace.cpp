@@ -0,0 +1,111 @@
+#include "workspace.h"
+#include "framefileio.h"
+
+#include <QDataStream>
+#include <QDebug>
+
+#define WORKSPACE_MAGIC     0x534B5753 //"SWKS"
+//bump whenever what goes into the extra section changes
+#define WORKSPACE_VERSION   1
+
+//raw host order so a few hundred MB of index rows go in and out at memcpy speed, not one element at a time
+template<typename T> static void writeArray(QDataStream &out, const QVector<T> &arr)
+{
+    out << static_cast<qint32>(arr.count());
+    out.writeRawData(reinterpret_cast<const char *>(arr.constData()), static_cast<int>(arr.count() * sizeof(T)));
+}
+
+template<typename T> static bool readArray(QDataStream &in, QVector<T> &arr)
+{
+    qint32 count;
+    in >> count;
+    if (in.status() != QDataStream::Ok || count < 0) return false;
+    arr.resize(count);
+    int bytes = static_cast<int>(count * sizeof(T));
+    return in.readRawData(reinterpret_cast<char *>(arr.data()), bytes) == bytes;
+}
+
+QByteArray Workspace::encode(const WorkspaceState &state)
+{
+    QByteArray extra;
+    QDataStream stream(&extra, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    stream << static_cast<quint32>(WORKSPACE_MAGIC) << static_cast<quint32>(WORKSPACE_VERSION) << state.captureName;
+
+    stream << static_cast<qint32>(state.dbcFiles.count());
+    for (const WorkspaceDbc &dbc : state.dbcFiles) stream << dbc.path << static_cast<qint32>(dbc.bus) << dbc.compiled;
+
+    stream << state.idFilters << state.busFilters << state.filterExpression;
+    stream << state.mainGeometry << state.mainState;
+
+    stream << static_cast<qint32>(state.windows.count());
+    for (const WorkspaceWindow &win : state.windows) stream << win.name << win.geometry << win.contents;
+
+    writeArray(stream, state.index.pairs);
+    writeArray(stream, state.index.starts);
+    writeArray(stream, state.index.rows);
+
+    if (stream.status() != QDataStream::Ok) return QByteArray();
+    return extra;
+}
+
+bool Workspace::decode(const QByteArray &extra, WorkspaceState &state)
+{
+    QDataStream stream(extra);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (magic != WORKSPACE_MAGIC || version != WORKSPACE_VERSION) return false;
+    stream >> state.captureName;
+
+    qint32 count;
+    stream >> count;
+    state.dbcFiles.clear();
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        WorkspaceDbc dbc;
+        qint32 bus;
+        stream >> dbc.path >> bus >> dbc.compiled;
+        dbc.bus = bus;
+        state.dbcFiles.append(dbc);
+    }
+
+    stream >> state.idFilters >> state.busFilters >> state.filterExpression;
+    stream >> state.mainGeometry >> state.mainState;
+
+    stream >> count;
+    state.windows.clear();
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        WorkspaceWindow win;
+        stream >> win.name >> win.geometry >> win.contents;
+        state.windows.append(win);
+    }
+
+    if (stream.status() != QDataStream::Ok) return false;
+    //a bad index only costs building it again, the store checks it before using it
+    if (!readArray(stream, state.index.pairs) || !readArray(stream, state.index.starts) || !readArray(stream, state.index.rows))
+    {
+        qDebug() << "Workspace index is damaged, it gets rebuilt";
+        state.index = CANFrameStore::SavedIndex();
+    }
+    return true;
+}
+
+bool Workspace::save(const QString &filename, const CANFrameSnapshot &frames, const WorkspaceState &state)
+{
+    QByteArray extra = encode(state);
+    if (extra.isEmpty()) return false;
+    return FrameFileIO::saveBinaryNativeStore(filename, frames, extra);
+}
+
+QSharedPointer<MappedCapture> Workspace::open(const QString &filename, WorkspaceState &state)
+{
+    QSharedPointer<MappedCapture> capture(new MappedCapture);
+    if (!capture->open(filename) || capture->isDamaged()) return QSharedPointer<MappedCapture>();
+    //extraSection points into the mapping, decode copies everything out of it
+    if (!decode(capture->extraSection(), state)) return QSharedPointer<MappedCapture>();
+    return capture;
+}
@@ -0,0 +1,65 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "binarycapture.h"
+#include "canframestore.h"
+
+//a DBC file the workspace had loaded, compiled by DBCCache so it doesn't need parsing
+struct WorkspaceDbc
+{
+    QString path;
+    int bus = -1;
+    QByteArray compiled;
+};
+
+//an open sub window. contents is the graph definitions for graphing windows and empty for the rest
+struct WorkspaceWindow
+{
+    QString name;
+    QByteArray geometry;
+    QByteArray contents;
+};
+
+struct WorkspaceState
+{
+    QString captureName; //what the frames were loaded from, for the title bar
+    QVector<WorkspaceDbc> dbcFiles;
+    QMap<int, bool> idFilters;
+    QMap<int, bool> busFilters;
+    QString filterExpression;
+    QByteArray mainGeometry;
+    QByteArray mainState;
+    QVector<WorkspaceWindow> windows;
+    CANFrameStore::SavedIndex index;
+};
+
+/*
+ * Workspace files (.scw), a whole session in one file so big captures can be picked up again in seconds. It's
+ * a binary capture (see binarycapture.h) of the frame list with everything else in the capture's extra section:
+ * the DBC files as DBCCache compiled them, the filters, the frame store's ID index, and which windows were open
+ * where with the graph definitions of every graphing window.
+ *
+ * Opening one maps the frames straight out of the file the same way a binary capture is viewed, takes the ID index
+ * as it was saved instead of making it again and only parses a DBC if it changed on disk since. The index goes
+ * in as raw host order arrays. That's fine since the capture itself refuses files from a machine that disagrees.
+ *
+ * Any binary capture reader can open a workspace as a plain capture.
+ */
+class Workspace
+{
+public:
+    static bool save(const QString &filename, const CANFrameSnapshot &frames, const WorkspaceState &state);
+    //the mapped frames, everything else goes into state. Null if the file isn't a workspace or is damaged
+    static QSharedPointer<MappedCapture> open(const QString &filename, WorkspaceState &state);
+
+private:
+    static QByteArray encode(const WorkspaceState &state);
+    static bool decode(const QByteArray &extra, WorkspaceState &state);
+};
+
+#endif // WORKSPACE_H